@@ -19,9 +19,8 @@
 
 #include "config.h"
 #include "CrossFade.hxx"
-#include "MusicChunk.hxx"
+#include "MixRampCurve.hxx"
 #include "AudioFormat.hxx"
-#include "util/NumberParser.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
@@ -29,67 +28,14 @@
 
 static constexpr Domain cross_fade_domain("cross_fade");
 
-gcc_pure
-static float
-mixramp_interpolate(const char *ramp_list, float required_db)
-{
-	float last_db = 0, last_secs = 0;
-	bool have_last = false;
-
-	/* ramp_list is a string of pairs of dBs and seconds that describe the
-	 * volume profile. Delimiters are semi-colons between pairs and spaces
-	 * between the dB and seconds of a pair.
-	 * The dB values must be monotonically increasing for this to work. */
-
-	while (1) {
-		/* Parse the dB value. */
-		char *endptr;
-		const float db = ParseFloat(ramp_list, &endptr);
-		if (endptr == ramp_list || *endptr != ' ')
-			break;
-
-		ramp_list = endptr + 1;
-
-		/* Parse the time. */
-		float secs = ParseFloat(ramp_list, &endptr);
-		if (endptr == ramp_list || (*endptr != ';' && *endptr != 0))
-			break;
-
-		ramp_list = endptr;
-		if (*ramp_list == ';')
-			++ramp_list;
-
-		/* Check for exact match. */
-		if (db == required_db) {
-			return secs;
-		}
-
-		/* Save if too quiet. */
-		if (db < required_db) {
-			last_db = db;
-			last_secs = secs;
-			have_last = true;
-			continue;
-		}
-
-		/* If required db < any stored value, use the least. */
-		if (!have_last)
-			return secs;
-
-		/* Finally, interpolate linearly. */
-		secs = last_secs + (required_db - last_db) * (secs - last_secs) / (db - last_db);
-		return secs;
-	}
-
-	return -1;
-}
-
 unsigned
 CrossFadeSettings::Calculate(float total_time,
 			     float replay_gain_db, float replay_gain_prev_db,
-			     const char *mixramp_start, const char *mixramp_prev_end,
+			     const MixRampCurve &mixramp_start,
+			     const MixRampCurve &mixramp_prev_end,
 			     const AudioFormat af,
 			     const AudioFormat old_format,
+			     size_t chunk_size,
 			     unsigned max_chunks) const
 {
 	unsigned int chunks = 0;
@@ -103,18 +49,18 @@ CrossFadeSettings::Calculate(float total_time,
 	assert(duration >= 0);
 	assert(af.IsValid());
 
-	chunks_f = (float)af.GetTimeToSize() / (float)CHUNK_SIZE;
+	chunks_f = (float)af.GetTimeToSize() / (float)chunk_size;
 
-	if (mixramp_delay <= 0 || !mixramp_start || !mixramp_prev_end) {
+	if (mixramp_delay <= 0 || !mixramp_start.IsDefined() ||
+	    !mixramp_prev_end.IsDefined()) {
 		chunks = (chunks_f * duration + 0.5);
 	} else {
 		/* Calculate mixramp overlap. */
 		const float mixramp_overlap_current =
-			mixramp_interpolate(mixramp_start,
-					    mixramp_db - replay_gain_db);
+			mixramp_start.Interpolate(mixramp_db - replay_gain_db);
 		const float mixramp_overlap_prev =
-			mixramp_interpolate(mixramp_prev_end,
-					    mixramp_db - replay_gain_prev_db);
+			mixramp_prev_end.Interpolate(mixramp_db -
+						     replay_gain_prev_db);
 		const float mixramp_overlap =
 			mixramp_overlap_current + mixramp_overlap_prev;
 
@@ -51,7 +51,8 @@ bool
 DetachedSong::IsInDatabase() const
 {
 	/* here, we use GetURI() and not GetRealURI() because
-	   GetRealURI() is never relative */
+	   GetRealURI() is only relative if map_song_compact() has
+	   removed the real URI */
 
 	const char *_uri = GetURI();
 	return !uri_has_scheme(_uri) && !PathTraitsUTF8::IsAbsolute(_uri);
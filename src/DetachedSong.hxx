@@ -100,6 +100,8 @@ public:
 
 	DetachedSong(DetachedSong &&) = default;
 
+	DetachedSong &operator=(DetachedSong &&) = default;
+
 	~DetachedSong();
 
 	gcc_pure
@@ -135,6 +137,13 @@ public:
 		real_uri = std::forward<T>(_uri);
 	}
 
+	/**
+	 * Forget the "real" URI and free its memory.
+	 */
+	void ClearRealURI() {
+		std::string().swap(real_uri);
+	}
+
 	/**
 	 * Returns true if both objects refer to the same physical
 	 * song.
@@ -23,93 +23,162 @@
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
+#include "thread/Policy.hxx"
 #include "event/Loop.hxx"
 #include "system/FatalError.hxx"
 #include "util/Error.hxx"
+#include "Log.hxx"
 
 #include <assert.h>
 
+static constexpr unsigned MAX_IO_THREADS = 16;
+
+struct IOThreadSlot {
+	EventLoop *loop;
+	Thread thread;
+};
+
 static struct {
 	Mutex mutex;
 	Cond cond;
 
-	EventLoop *loop;
-	Thread thread;
+	/**
+	 * The first one is the primary I/O thread.
+	 */
+	IOThreadSlot threads[MAX_IO_THREADS];
+
+	/**
+	 * The number of initialized elements in #threads.
+	 */
+	unsigned n;
+
+	/**
+	 * The index of the thread which will be returned by the next
+	 * io_thread_get_next() call.
+	 */
+	unsigned next;
 } io;
 
 void
 io_thread_run(void)
 {
 	assert(io_thread_inside());
-	assert(io.loop != nullptr);
+	assert(io.n > 0);
 
-	io.loop->Run();
+	io.threads[0].loop->Run();
 }
 
 static void
-io_thread_func(gcc_unused void *arg)
+io_thread_func(void *arg)
 {
-	SetThreadName("io");
+	IOThreadSlot &slot = *(IOThreadSlot *)arg;
+	const unsigned i = &slot - io.threads;
+
+	if (i == 0)
+		SetThreadName("io");
+	else
+		FormatThreadName("io:%u", i);
+
+	Error policy_error;
+	if (!ApplyThreadPolicy(ThreadClass::IO, policy_error))
+		LogError(policy_error);
 
 	/* lock+unlock to synchronize with io_thread_start(), to be
-	   sure that io.thread is set */
+	   sure that slot.thread is set */
 	io.mutex.lock();
 	io.mutex.unlock();
 
-	io_thread_run();
+	slot.loop->Run();
 }
 
 void
 io_thread_init(void)
 {
-	assert(io.loop == nullptr);
-	assert(!io.thread.IsDefined());
+	assert(io.n == 0);
+
+	io.threads[0].loop = new EventLoop();
+	io.n = 1;
+}
+
+void
+io_thread_set_count(unsigned n)
+{
+	assert(io.n > 0);
+	assert(!io.threads[0].thread.IsDefined());
+
+	if (n > MAX_IO_THREADS)
+		n = MAX_IO_THREADS;
 
-	io.loop = new EventLoop();
+	for (; io.n < n; ++io.n)
+		io.threads[io.n].loop = new EventLoop();
 }
 
 void
 io_thread_start()
 {
-	assert(io.loop != nullptr);
-	assert(!io.thread.IsDefined());
+	assert(io.n > 0);
+	assert(!io.threads[0].thread.IsDefined());
 
 	const ScopeLock protect(io.mutex);
 
-	Error error;
-	if (!io.thread.Start(io_thread_func, nullptr, error))
-		FatalError(error);
+	for (unsigned i = 0; i < io.n; ++i) {
+		IOThreadSlot &slot = io.threads[i];
+
+		Error error;
+		if (!slot.thread.Start(io_thread_func, &slot, error))
+			FatalError(error);
+	}
 }
 
 void
 io_thread_quit(void)
 {
-	assert(io.loop != nullptr);
+	assert(io.n > 0);
 
-	io.loop->Break();
+	for (unsigned i = 0; i < io.n; ++i)
+		io.threads[i].loop->Break();
 }
 
 void
 io_thread_deinit(void)
 {
-	if (io.thread.IsDefined()) {
-		io_thread_quit();
-		io.thread.Join();
+	for (unsigned i = 0; i < io.n; ++i) {
+		IOThreadSlot &slot = io.threads[i];
+
+		if (slot.thread.IsDefined()) {
+			slot.loop->Break();
+			slot.thread.Join();
+		}
+	}
+
+	for (unsigned i = 0; i < io.n; ++i) {
+		delete io.threads[i].loop;
+		io.threads[i].loop = nullptr;
 	}
 
-	delete io.loop;
+	io.n = 0;
 }
 
 EventLoop &
 io_thread_get()
 {
-	assert(io.loop != nullptr);
+	assert(io.n > 0);
+
+	return *io.threads[0].loop;
+}
+
+EventLoop &
+io_thread_get_next()
+{
+	assert(io.n > 0);
 
-	return *io.loop;
+	EventLoop &loop = *io.threads[io.next].loop;
+	io.next = (io.next + 1) % io.n;
+	return loop;
 }
 
 bool
 io_thread_inside(void)
 {
-	return io.thread.IsInside();
+	return io.threads[0].thread.IsInside();
 }
@@ -27,6 +27,14 @@ class EventLoop;
 void
 io_thread_init(void);
 
+/**
+ * Create additional I/O threads, each with its own #EventLoop, so
+ * there are (up to) the given number in total.  Must be called after
+ * io_thread_init() and before io_thread_start().
+ */
+void
+io_thread_set_count(unsigned n);
+
 void
 io_thread_start();
 
@@ -39,8 +47,8 @@ void
 io_thread_run(void);
 
 /**
- * Ask the I/O thread to quit, but does not wait for it.  Usually, you
- * don't need to call this function, because io_thread_deinit()
+ * Ask the I/O threads to quit, but does not wait for them.  Usually,
+ * you don't need to call this function, because io_thread_deinit()
  * includes this.
  */
 void
@@ -49,12 +57,28 @@ io_thread_quit(void);
 void
 io_thread_deinit(void);
 
+/**
+ * Returns the #EventLoop of the primary I/O thread.  It runs all
+ * subsystems with global state, e.g. CURL and NFS.
+ */
 gcc_const
 EventLoop &
 io_thread_get();
 
 /**
- * Is the current thread the I/O thread?
+ * Returns the #EventLoop of one of the I/O threads, chosen
+ * round-robin.  This is used by objects which are independent from
+ * all others (e.g. a httpd output with its clients), to distribute
+ * them over all I/O threads.  With only one I/O thread, this is the
+ * same as io_thread_get().
+ *
+ * This function is not thread-safe.
+ */
+EventLoop &
+io_thread_get_next();
+
+/**
+ * Is the current thread the primary I/O thread?
  */
 gcc_pure
 bool
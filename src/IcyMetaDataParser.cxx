@@ -35,13 +35,12 @@ IcyMetaDataParser::Reset()
 	if (!IsDefined())
 		return;
 
-	if (data_rest == 0 && meta_size > 0)
-		delete[] meta_data;
-
 	delete tag;
+	tag = nullptr;
 
 	data_rest = data_size;
 	meta_size = 0;
+	have_title = false;
 }
 
 size_t
@@ -64,29 +63,17 @@ IcyMetaDataParser::Data(size_t length)
 	return length;
 }
 
+/**
+ * Strip the single quotes which some servers add inside the quoted
+ * value.
+ */
 static void
-icy_add_item(TagBuilder &tag, TagType type, const char *value)
+icy_strip_quotes(const char *&value, size_t &length)
 {
-	size_t length = strlen(value);
-
 	if (length >= 2 && value[0] == '\'' && value[length - 1] == '\'') {
-		/* strip the single quotes */
 		++value;
 		length -= 2;
 	}
-
-	if (length > 0)
-		tag.AddItem(type, value, length);
-}
-
-static void
-icy_parse_tag_item(TagBuilder &tag, const char *name, const char *value)
-{
-	if (strcmp(name, "StreamTitle") == 0)
-		icy_add_item(tag, TAG_TITLE, value);
-	else
-		FormatDebug(icy_metadata_domain,
-			    "unknown icy-tag: '%s'", name);
 }
 
 /**
@@ -114,14 +101,22 @@ find_end_quote(char *p, char *const end)
 	}
 }
 
-static Tag *
-icy_parse_tag(char *p, char *const end)
+/**
+ * Parse a metadata block in place and find its StreamTitle.
+ *
+ * @param title_r receives a pointer into the block (not
+ * null-terminated), or nullptr if there is no StreamTitle
+ */
+static void
+icy_parse_title(char *p, char *const end,
+		const char *&title_r, size_t &length_r)
 {
 	assert(p != nullptr);
 	assert(end != nullptr);
 	assert(p <= end);
 
-	TagBuilder tag;
+	title_r = nullptr;
+	length_r = 0;
 
 	while (p != end) {
 		const char *const name = p;
@@ -152,17 +147,53 @@ icy_parse_tag(char *p, char *const end)
 		*quote = 0;
 		p = quote + 1;
 
-		icy_parse_tag_item(tag, name, value);
+		if (strcmp(name, "StreamTitle") == 0) {
+			title_r = value;
+			length_r = quote - value;
+			icy_strip_quotes(title_r, length_r);
+		} else
+			FormatDebug(icy_metadata_domain,
+				    "unknown icy-tag: '%s'", name);
 
 		char *semicolon = std::find(p, end, ';');
 		if (semicolon == end)
 			break;
 		p = semicolon + 1;
 	}
+}
+
+static Tag *
+icy_title_tag(const char *title, size_t length)
+{
+	TagBuilder tag;
+	if (length > 0)
+		tag.AddItem(TAG_TITLE, title, length);
 
 	return tag.CommitNew();
 }
 
+void
+IcyMetaDataParser::ParseMeta()
+{
+	const char *title;
+	size_t title_length;
+	icy_parse_title(meta_data, meta_data + meta_size,
+			title, title_length);
+
+	/* most stations repeat the same StreamTitle in every block;
+	   don't create a new tag for it */
+	if (have_title && last_title.length() == title_length &&
+	    memcmp(last_title.data(), title, title_length) == 0)
+		return;
+
+	/* assign() reuses the string's buffer */
+	last_title.assign(title != nullptr ? title : "", title_length);
+	have_title = true;
+
+	delete tag;
+	tag = icy_title_tag(title, title_length);
+}
+
 size_t
 IcyMetaDataParser::Meta(const void *data, size_t length)
 {
@@ -186,10 +217,8 @@ IcyMetaDataParser::Meta(const void *data, size_t length)
 		   return value */
 		--length;
 
-		/* initialize metadata reader, allocate enough
-		   memory (+1 for the null terminator) */
+		/* initialize metadata reader */
 		meta_position = 0;
-		meta_data = new char[meta_size + 1];
 	}
 
 	assert(meta_position < meta_size);
@@ -205,12 +234,7 @@ IcyMetaDataParser::Meta(const void *data, size_t length)
 		++length;
 
 	if (meta_position == meta_size) {
-		/* parse */
-
-		delete tag;
-
-		tag = icy_parse_tag(meta_data, meta_data + meta_size);
-		delete[] meta_data;
+		ParseMeta();
 
 		/* change back to normal data mode */
 
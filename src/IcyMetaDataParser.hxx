@@ -20,15 +20,40 @@
 #ifndef MPD_ICY_META_DATA_PARSER_HXX
 #define MPD_ICY_META_DATA_PARSER_HXX
 
+#include <string>
+
 #include <stddef.h>
 
 struct Tag;
 
 class IcyMetaDataParser {
+	/**
+	 * The maximum size of a metadata block: the length byte is
+	 * multiplied by 16.
+	 */
+	static constexpr size_t MAX_META_SIZE = 255 * 16;
+
 	size_t data_size, data_rest;
 
 	size_t meta_size, meta_position;
-	char *meta_data;
+
+	/**
+	 * The metadata block being received.  It is parsed in place,
+	 * and no memory is allocated per block.
+	 */
+	char meta_data[MAX_META_SIZE];
+
+	/**
+	 * The StreamTitle of the last block.  A block with the same
+	 * title does not produce a new #Tag.  Empty after Start() and
+	 * Reset().
+	 */
+	std::string last_title;
+
+	/**
+	 * Has #last_title been set since Start() / Reset()?
+	 */
+	bool have_title;
 
 	Tag *tag;
 
@@ -45,6 +70,7 @@ public:
 	void Start(size_t _data_size) {
 		data_size = data_rest = _data_size;
 		meta_size = 0;
+		have_title = false;
 		tag = nullptr;
 	}
 
@@ -87,6 +113,13 @@ public:
 		tag = nullptr;
 		return result;
 	}
+
+private:
+	/**
+	 * Parse the complete block in #meta_data, and create a new
+	 * #tag if the title has changed.
+	 */
+	void ParseMeta();
 };
 
 #endif
@@ -33,6 +33,8 @@
 
 static std::atomic_uint idle_flags;
 
+static std::atomic_uint idle_serial;
+
 static const char *const idle_names[] = {
 	"database",
 	"stored_playlist",
@@ -55,6 +57,8 @@ idle_add(unsigned flags)
 {
 	assert(flags != 0);
 
+	++idle_serial;
+
 	unsigned old_flags = idle_flags.fetch_or(flags);
 
 	if ((old_flags & flags) != flags)
@@ -67,6 +71,12 @@ idle_get(void)
 	return idle_flags.exchange(0);
 }
 
+unsigned
+idle_get_serial(void)
+{
+	return idle_serial;
+}
+
 const char*const*
 idle_get_names(void)
 {
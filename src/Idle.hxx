@@ -80,6 +80,15 @@ idle_add(unsigned flags);
 unsigned
 idle_get(void);
 
+/**
+ * Returns a number which is incremented by each idle_add() call.
+ * Caches of state which is announced by idle events compare it to
+ * find out whether they are still valid.
+ */
+gcc_pure
+unsigned
+idle_get_serial(void);
+
 /**
  * Get idle names
  */
@@ -22,6 +22,9 @@
 #include "Partition.hxx"
 #include "Idle.hxx"
 #include "Stats.hxx"
+#include "client/ResponseCache.hxx"
+
+#include <string.h>
 
 #ifdef ENABLE_DATABASE
 #include "db/DatabaseError.hxx"
@@ -31,27 +34,60 @@
 #include "sticker/StickerDatabase.hxx"
 #include "sticker/SongSticker.hxx"
 #endif
+#endif
+
+Partition *
+Instance::FindPartition(const char *name)
+{
+	for (auto partition : partitions)
+		if (partition->name == name)
+			return partition;
+
+	return nullptr;
+}
+
+#ifdef ENABLE_DATABASE
 
 Database *
 Instance::GetDatabase(Error &error)
 {
-	if (database == nullptr)
-		error.Set(db_domain, DB_DISABLED, "No database");
+	if (database == nullptr) {
+		if (database_loading)
+			error.Set(db_domain, DB_LOADING,
+				  "Database is loading");
+		else
+			error.Set(db_domain, DB_DISABLED, "No database");
+	}
+
 	return database;
 }
 
+void
+Instance::OnDatabaseLoaded(Database &db)
+{
+	assert(database == nullptr);
+	assert(database_loading);
+
+	database = &db;
+	database_loading = false;
+
+	OnDatabaseModified();
+}
+
 #endif
 
 void
 Instance::TagModified()
 {
-	partition->TagModified();
+	for (auto partition : partitions)
+		partition->TagModified();
 }
 
 void
 Instance::SyncWithPlayer()
 {
-	partition->SyncWithPlayer();
+	for (auto partition : partitions)
+		partition->SyncWithPlayer();
 }
 
 #ifdef ENABLE_DATABASE
@@ -64,7 +100,9 @@ Instance::OnDatabaseModified()
 	/* propagate the change to all subsystems */
 
 	stats_invalidate();
-	partition->DatabaseModified(*database);
+	client_response_cache.Clear();
+	for (auto partition : partitions)
+		partition->DatabaseModified(*database);
 	idle_add(IDLE_DATABASE);
 }
 
@@ -80,7 +118,8 @@ Instance::OnDatabaseSongRemoved(const LightSong &song)
 #endif
 
 	const auto uri = song.GetURI();
-	partition->DeleteSong(uri.c_str());
+	for (auto partition : partitions)
+		partition->DeleteSong(uri.c_str());
 }
 
 #endif
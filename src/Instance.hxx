@@ -32,9 +32,12 @@ class NeighborGlue;
 #include "db/DatabaseListener.hxx"
 class Database;
 class Storage;
+class StorageListCache;
 class UpdateService;
 #endif
 
+#include <list>
+
 class EventLoop;
 class Error;
 class ClientList;
@@ -69,20 +72,51 @@ struct Instance final
 	 */
 	Storage *storage;
 
+	/**
+	 * Caches directory listings of remote storages for
+	 * "listfiles".  nullptr if there is no #storage.
+	 */
+	StorageListCache *storage_list_cache;
+
 	UpdateService *update;
+
+	/**
+	 * True while the #Database is being loaded in a separate
+	 * thread during startup.  Meanwhile, #database is nullptr.
+	 */
+	bool database_loading;
 #endif
 
 	ClientList *client_list;
 
-	Partition *partition;
+	/**
+	 * All partitions; the first one is the default partition,
+	 * which new clients are attached to.  Each one has its own
+	 * queue, player thread and outputs.
+	 */
+	std::list<Partition *> partitions;
 
 	Instance() {
 #ifdef ENABLE_DATABASE
+		database = nullptr;
 		storage = nullptr;
+		storage_list_cache = nullptr;
 		update = nullptr;
+		database_loading = false;
 #endif
 	}
 
+	Partition &GetDefaultPartition() {
+		return *partitions.front();
+	}
+
+	/**
+	 * Look up a partition by its name.  Returns nullptr if there
+	 * is no such partition.
+	 */
+	gcc_pure
+	Partition *FindPartition(const char *name);
+
 #ifdef ENABLE_DATABASE
 	/**
 	 * Returns the global #Database instance.  May return nullptr
@@ -90,6 +124,13 @@ struct Instance final
 	 * music_directory was configured).
 	 */
 	Database *GetDatabase(Error &error);
+
+	/**
+	 * The #Database has finished loading in the background.
+	 * Install it and notify all subsystems.  Must be called in
+	 * the main thread.
+	 */
+	void OnDatabaseLoaded(Database &db);
 #endif
 
 	/**
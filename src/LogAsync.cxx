@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "LogAsync.hxx"
+#include "LogBackend.hxx"
+#include "Metrics.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/Domain.hxx"
+#include "util/Error.hxx"
+
+#include <atomic>
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+static constexpr Domain log_async_domain("log");
+
+struct LogRecord {
+	/**
+	 * A global sequence number which restores the order of
+	 * messages from different threads.
+	 */
+	uint64_t sequence;
+
+	const Domain *domain;
+	LogLevel level;
+	time_t time;
+
+	/**
+	 * The message text; longer messages are truncated.
+	 */
+	char message[1024];
+};
+
+/**
+ * A single-producer/single-consumer ring buffer.  The producer is the
+ * thread which has claimed it, the consumer is the logger thread.
+ */
+struct LogRing {
+	static constexpr unsigned CAPACITY = 32;
+
+	/**
+	 * Does a thread own this ring?  Rings of threads which have
+	 * exited are released and can be claimed by new threads.
+	 */
+	std::atomic_bool claimed;
+
+	/**
+	 * The index of the next record to be read (owned by the
+	 * consumer) and the next record to be written (owned by the
+	 * producer).  Both only ever increase; the array index is
+	 * modulo #CAPACITY.
+	 */
+	std::atomic_uint head, tail;
+
+	/**
+	 * The number of messages which were discarded because the
+	 * ring was full.
+	 */
+	std::atomic_uint dropped;
+
+	LogRecord records[CAPACITY];
+
+	LogRing():claimed(true), head(0), tail(0), dropped(0) {}
+
+	bool Push(uint64_t sequence, const Domain &domain, LogLevel level,
+		  const char *msg) {
+		const unsigned t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) >= CAPACITY) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		LogRecord &r = records[t % CAPACITY];
+		r.sequence = sequence;
+		r.domain = &domain;
+		r.level = level;
+		r.time = time(nullptr);
+
+		size_t length = strlen(msg);
+		if (length >= sizeof(r.message))
+			length = sizeof(r.message) - 1;
+		memcpy(r.message, msg, length);
+		r.message[length] = 0;
+
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Returns the oldest record, or nullptr if the ring is empty.
+	 * Call Shift() after the record has been processed.
+	 */
+	const LogRecord *Peek() const {
+		const unsigned h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return nullptr;
+
+		return &records[h % CAPACITY];
+	}
+
+	void Shift() {
+		head.fetch_add(1, std::memory_order_release);
+	}
+};
+
+/**
+ * The maximum number of threads which can log asynchronously at the
+ * same time.  Additional threads log synchronously.
+ */
+static constexpr unsigned MAX_RINGS = 64;
+
+static std::atomic<LogRing *> log_rings[MAX_RINGS];
+
+static std::atomic<uint64_t> log_sequence;
+
+/**
+ * The ring claimed by the current thread.
+ */
+static __thread LogRing *thread_ring;
+
+#ifndef WIN32
+/**
+ * Used to release the ring when its thread exits.  There is no such
+ * mechanism on Windows; rings of exited threads are not reused there.
+ */
+static pthread_key_t ring_key;
+#endif
+
+static Thread log_thread;
+static Mutex log_mutex;
+static Cond log_cond;
+static std::atomic_bool log_wakeup, log_quit;
+
+#ifndef WIN32
+
+static void
+ReleaseRing(void *ctx)
+{
+	LogRing &ring = *(LogRing *)ctx;
+	ring.claimed.store(false, std::memory_order_release);
+}
+
+#endif
+
+/**
+ * Find a ring for the current thread: reuse a released one or
+ * allocate a new one.
+ */
+static LogRing *
+ClaimRing()
+{
+	for (auto &slot : log_rings) {
+		LogRing *ring = slot.load(std::memory_order_acquire);
+		if (ring == nullptr) {
+			LogRing *new_ring = new LogRing();
+			if (slot.compare_exchange_strong(ring, new_ring))
+				return new_ring;
+
+			/* another thread was faster; try to claim
+			   its ring when it's gone */
+			delete new_ring;
+			continue;
+		}
+
+		bool expected = false;
+		if (ring->claimed.compare_exchange_strong(expected, true))
+			return ring;
+	}
+
+	return nullptr;
+}
+
+static bool
+LogAsyncPush(const Domain &domain, LogLevel level, const char *msg)
+{
+	LogRing *ring = thread_ring;
+	if (ring == nullptr) {
+		ring = ClaimRing();
+		if (ring == nullptr)
+			return false;
+
+		thread_ring = ring;
+#ifndef WIN32
+		pthread_setspecific(ring_key, ring);
+#endif
+	}
+
+	const uint64_t sequence =
+		log_sequence.fetch_add(1, std::memory_order_relaxed);
+	if (ring->Push(sequence, domain, level, msg) &&
+	    !log_wakeup.exchange(true))
+		log_cond.signal();
+
+	/* a dropped message is still "accepted": writing it
+	   synchronously would block the thread, which is exactly what
+	   this is about */
+	return true;
+}
+
+/**
+ * Write all queued messages, merging the rings by sequence number.
+ */
+static void
+LogAsyncDrain()
+{
+	while (true) {
+		LogRing *oldest = nullptr;
+		const LogRecord *oldest_record = nullptr;
+
+		for (auto &slot : log_rings) {
+			LogRing *ring = slot.load(std::memory_order_acquire);
+			if (ring == nullptr)
+				break;
+
+			const LogRecord *record = ring->Peek();
+			if (record != nullptr &&
+			    (oldest_record == nullptr ||
+			     record->sequence < oldest_record->sequence)) {
+				oldest = ring;
+				oldest_record = record;
+			}
+		}
+
+		if (oldest == nullptr)
+			break;
+
+		LogWrite(*oldest_record->domain, oldest_record->level,
+			 oldest_record->message, oldest_record->time);
+		oldest->Shift();
+	}
+
+	for (auto &slot : log_rings) {
+		LogRing *ring = slot.load(std::memory_order_acquire);
+		if (ring == nullptr)
+			break;
+
+		const unsigned dropped =
+			ring->dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped > 0) {
+			metric_log_dropped.Add(dropped);
+
+			char msg[64];
+			snprintf(msg, sizeof(msg),
+				 "%u log messages dropped", dropped);
+			LogWrite(log_async_domain, LogLevel::WARNING, msg,
+				 time(nullptr));
+		}
+	}
+}
+
+static void
+LogThread(gcc_unused void *ctx)
+{
+	SetThreadName("log");
+
+	while (true) {
+		log_wakeup.store(false);
+		LogAsyncDrain();
+
+		if (log_quit.load())
+			break;
+
+		/* the timeout catches the (rare) wakeup which was
+		   signalled right before we started waiting */
+		const ScopeLock protect(log_mutex);
+		if (!log_wakeup.load() && !log_quit.load())
+			log_cond.timed_wait(log_mutex, 100);
+	}
+}
+
+bool
+LogAsyncStart(Error &error)
+{
+	assert(!log_thread.IsDefined());
+
+#ifndef WIN32
+	int result = pthread_key_create(&ring_key, ReleaseRing);
+	if (result != 0) {
+		error.SetErrno(result, "pthread_key_create() failed");
+		return false;
+	}
+#endif
+
+	log_quit.store(false);
+	if (!log_thread.Start(LogThread, nullptr, error)) {
+#ifndef WIN32
+		pthread_key_delete(ring_key);
+#endif
+		return false;
+	}
+
+	SetLogQueue(LogAsyncPush);
+	return true;
+}
+
+void
+LogAsyncStop()
+{
+	if (!log_thread.IsDefined())
+		return;
+
+	SetLogQueue(nullptr);
+
+	log_mutex.lock();
+	log_quit.store(true);
+	log_cond.signal();
+	log_mutex.unlock();
+
+	log_thread.Join();
+
+	/* catch messages which were queued while the thread was
+	   exiting */
+	LogAsyncDrain();
+
+#ifndef WIN32
+	pthread_key_delete(ring_key);
+#endif
+	thread_ring = nullptr;
+
+	for (auto &slot : log_rings)
+		delete slot.exchange(nullptr);
+}
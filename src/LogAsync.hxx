@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_LOG_ASYNC_HXX
+#define MPD_LOG_ASYNC_HXX
+
+#include "check.h"
+
+class Error;
+
+/**
+ * Start the logger thread.  From now on, log messages below
+ * #LogLevel::ERROR are copied into a lock-free ring buffer owned by
+ * the calling thread, and the logger thread writes them to the log
+ * file (or syslog).  Threads which produce messages faster than they
+ * can be written lose messages; this is counted and reported.
+ *
+ * This must be called after daemonization, because the thread does
+ * not survive fork().
+ */
+bool
+LogAsyncStart(Error &error);
+
+/**
+ * Stop the logger thread after writing all pending messages, and
+ * switch back to synchronous logging.
+ */
+void
+LogAsyncStop();
+
+#endif
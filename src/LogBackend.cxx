@@ -27,6 +27,8 @@
 #include <glib.h>
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -71,6 +73,8 @@ static const char *log_charset;
 
 static bool enable_timestamp;
 
+static std::atomic<LogQueueFunction> log_queue(nullptr);
+
 #ifdef HAVE_SYSLOG
 static bool enable_syslog;
 #endif
@@ -102,12 +106,24 @@ EnableLogTimestamp()
 	enable_timestamp = true;
 }
 
-static const char *log_date(void)
+void
+SetLogQueue(LogQueueFunction f)
+{
+	log_queue.store(f);
+}
+
+static constexpr size_t LOG_DATE_BUF_SIZE = 16;
+
+static const char *
+log_date(char *buf, time_t t)
 {
-	static constexpr size_t LOG_DATE_BUF_SIZE = 16;
-	static char buf[LOG_DATE_BUF_SIZE];
-	time_t t = time(nullptr);
-	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", localtime(&t));
+#ifdef WIN32
+	const struct tm *tm = localtime(&t);
+#else
+	struct tm tm_buffer;
+	const struct tm *tm = localtime_r(&t, &tm_buffer);
+#endif
+	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", tm);
 	return buf;
 }
 
@@ -177,7 +193,7 @@ LogFinishSysLog()
 #endif
 
 static void
-FileLog(const Domain &domain, const char *message)
+FileLog(const Domain &domain, const char *message, time_t t)
 {
 #ifdef HAVE_GLIB
 	char *converted;
@@ -193,8 +209,9 @@ FileLog(const Domain &domain, const char *message)
 		converted = nullptr;
 #endif
 
+	char date_buffer[LOG_DATE_BUF_SIZE];
 	fprintf(stderr, "%s%s: %.*s\n",
-		enable_timestamp ? log_date() : "",
+		enable_timestamp ? log_date(date_buffer, t) : "",
 		domain.GetName(),
 		chomp_length(message), message);
 
@@ -203,6 +220,21 @@ FileLog(const Domain &domain, const char *message)
 #endif
 }
 
+void
+LogWrite(const Domain &domain, LogLevel level, const char *msg, time_t t)
+{
+#ifdef HAVE_SYSLOG
+	if (enable_syslog) {
+		SysLog(domain, level, msg);
+		return;
+	}
+#else
+	(void)level;
+#endif
+
+	FileLog(domain, msg, t);
+}
+
 #endif /* !ANDROID */
 
 void
@@ -216,13 +248,14 @@ Log(const Domain &domain, LogLevel level, const char *msg)
 	if (level < log_threshold)
 		return;
 
-#ifdef HAVE_SYSLOG
-	if (enable_syslog) {
-		SysLog(domain, level, msg);
+	/* errors are always written synchronously, because they may
+	   be followed by exit() */
+	const LogQueueFunction queue =
+		log_queue.load(std::memory_order_relaxed);
+	if (queue != nullptr && level < LogLevel::ERROR &&
+	    queue(domain, level, msg))
 		return;
-	}
-#endif
 
-	FileLog(domain, msg);
+	LogWrite(domain, level, msg, time(nullptr));
 #endif /* !ANDROID */
 }
@@ -23,6 +23,20 @@
 #include "check.h"
 #include "LogLevel.hxx"
 
+#include <time.h>
+
+class Domain;
+
+/**
+ * A function which takes over a log message, to be written later by
+ * somebody else.
+ *
+ * @return false if the message was not accepted; the caller writes
+ * it synchronously then
+ */
+typedef bool (*LogQueueFunction)(const Domain &domain, LogLevel level,
+				 const char *msg);
+
 void
 SetLogThreshold(LogLevel _threshold);
 
@@ -36,6 +50,22 @@ SetLogCharset(const char *_charset);
 void
 EnableLogTimestamp();
 
+/**
+ * Install (or remove with nullptr) a function which queues log
+ * messages instead of writing them.  See LogAsync.hxx.
+ */
+void
+SetLogQueue(LogQueueFunction f);
+
+/**
+ * Write a message to the log file or syslog right now, without
+ * checking the threshold.
+ *
+ * @param t the time when the message was generated
+ */
+void
+LogWrite(const Domain &domain, LogLevel level, const char *msg, time_t t);
+
 void
 LogInitSysLog();
 
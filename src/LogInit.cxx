@@ -20,6 +20,7 @@
 #include "config.h"
 #include "LogInit.hxx"
 #include "LogBackend.hxx"
+#include "LogAsync.hxx"
 #include "Log.hxx"
 #include "config/ConfigData.hxx"
 #include "config/ConfigGlobal.hxx"
@@ -54,6 +55,11 @@ static constexpr Domain log_domain("log");
 static int out_fd;
 static AllocatedPath out_path = AllocatedPath::Null();
 
+/**
+ * Shall setup_log_output() start the asynchronous logger?
+ */
+static bool log_async;
+
 static void redirect_logs(int fd)
 {
 	assert(fd >= 0);
@@ -140,6 +146,8 @@ log_init(bool verbose, bool use_stdout, Error &error)
 		SetLogThreshold(parse_log_level(param->value.c_str(),
 						param->line));
 
+	log_async = config_get_bool(CONF_LOG_ASYNC, false);
+
 	if (use_stdout) {
 		return true;
 	} else {
@@ -185,19 +193,17 @@ void
 log_deinit(void)
 {
 #ifndef ANDROID
+	LogAsyncStop();
 	close_log_files();
 	out_path = AllocatedPath::Null();
 #endif
 }
 
-void setup_log_output(bool use_stdout)
-{
-#ifdef ANDROID
-	(void)use_stdout;
-#else
-	if (use_stdout)
-		return;
+#ifndef ANDROID
 
+static void
+redirect_log_output()
+{
 	fflush(nullptr);
 
 	if (out_fd < 0) {
@@ -217,6 +223,24 @@ void setup_log_output(bool use_stdout)
 #ifdef HAVE_GLIB
 	SetLogCharset(nullptr);
 #endif
+}
+
+#endif
+
+void setup_log_output(bool use_stdout)
+{
+#ifdef ANDROID
+	(void)use_stdout;
+#else
+	if (!use_stdout)
+		redirect_log_output();
+
+	if (log_async) {
+		Error error;
+		if (!LogAsyncStart(error))
+			LogError(error,
+				 "Failed to start the asynchronous logger");
+	}
 #endif
 }
 
@@ -29,24 +29,29 @@
 #include "Mapper.hxx"
 #include "Permission.hxx"
 #include "Listen.hxx"
+#include "MetricsHttp.hxx"
+#include "Trace.hxx"
 #include "client/Client.hxx"
 #include "client/ClientList.hxx"
 #include "command/AllCommands.hxx"
 #include "Partition.hxx"
 #include "tag/TagConfig.hxx"
 #include "ReplayGainConfig.hxx"
+#include "ThreadConfig.hxx"
 #include "Idle.hxx"
 #include "Log.hxx"
 #include "LogInit.hxx"
 #include "GlobalEvents.hxx"
 #include "input/Init.hxx"
 #include "event/Loop.hxx"
+#include "event/DeferredMonitor.hxx"
 #include "IOThread.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Config.hxx"
 #include "playlist/PlaylistRegistry.hxx"
 #include "zeroconf/ZeroconfGlue.hxx"
 #include "decoder/DecoderList.hxx"
+#include "decoder/DecoderCache.hxx"
 #include "AudioConfig.hxx"
 #include "pcm/PcmConvert.hxx"
 #include "unix/SignalHandlers.hxx"
@@ -55,6 +60,9 @@
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "util/HugeAllocator.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 #include "thread/Id.hxx"
 #include "thread/Slack.hxx"
 #include "lib/icu/Init.hxx"
@@ -64,6 +72,7 @@
 #include "config/ConfigOption.hxx"
 #include "config/ConfigError.hxx"
 #include "Stats.hxx"
+#include "MemoryBudget.hxx"
 
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
@@ -72,6 +81,7 @@
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "storage/Configured.hxx"
 #include "storage/CompositeStorage.hxx"
+#include "storage/ListCache.hxx"
 #ifdef ENABLE_INOTIFY
 #include "db/update/InotifyUpdate.hxx"
 #endif
@@ -89,6 +99,10 @@
 #include "archive/ArchiveList.hxx"
 #endif
 
+#ifdef ENABLE_SYNTH_CACHE
+#include "decoder/SynthCache.hxx"
+#endif
+
 #ifdef ANDROID
 #include "java/Global.hxx"
 #include "java/File.hxx"
@@ -102,6 +116,10 @@
 #include <glib.h>
 #endif
 
+#include <algorithm>
+#include <list>
+#include <string>
+
 #include <stdlib.h>
 
 #ifdef HAVE_LOCALE_H
@@ -118,6 +136,21 @@
 static constexpr unsigned DEFAULT_BUFFER_SIZE = 4096;
 static constexpr unsigned DEFAULT_BUFFER_BEFORE_PLAY = 10;
 
+/**
+ * Open the next song this many seconds before the decoder reaches
+ * the end of the current one.
+ */
+static constexpr unsigned DEFAULT_PREFETCH_TIME = 10;
+
+#ifdef ENABLE_DATABASE
+static constexpr unsigned DEFAULT_STORAGE_CACHE_TTL = 10;
+
+/**
+ * The maximum number of directories in the #StorageListCache.
+ */
+static constexpr unsigned STORAGE_CACHE_SIZE = 256;
+#endif
+
 static constexpr Domain main_domain("main");
 
 #ifdef ANDROID
@@ -128,6 +161,17 @@ Instance *instance;
 
 static StateFile *state_file;
 
+/**
+ * The path of the state file, until it is opened by
+ * glue_state_file_open().
+ */
+static AllocatedPath state_file_path = AllocatedPath::Null();
+
+#ifdef ENABLE_DATABASE
+static bool auto_update;
+static unsigned auto_update_depth;
+#endif
+
 #ifndef ANDROID
 
 static bool
@@ -174,35 +218,123 @@ InitStorage(Error &error)
 	CompositeStorage *composite = new CompositeStorage();
 	instance->storage = composite;
 	composite->Mount("", storage);
+
+	instance->storage_list_cache =
+		new StorageListCache(config_get_unsigned(CONF_STORAGE_CACHE_TTL,
+							 DEFAULT_STORAGE_CACHE_TTL),
+				     STORAGE_CACHE_SIZE);
 	return true;
 }
 
 /**
- * Returns the database.  If this function returns false, this has not
- * succeeded, and the caller should create the database after the
- * process has been daemonized.
+ * Loads the #SimpleDatabase file in a separate thread, while the main
+ * thread continues to initialize the other subsystems.  When done,
+ * the database is handed over to the #Instance in the main thread.
+ */
+class DatabaseLoader final : DeferredMonitor {
+	/**
+	 * The database being loaded.  It is owned by this object
+	 * until it has been handed over to the #Instance.
+	 */
+	Database *db;
+
+	void (*const callback)(bool create_db);
+
+	Thread thread;
+
+	Error error;
+
+	bool success;
+
+public:
+	DatabaseLoader(EventLoop &_loop, Database &_db,
+		       void (*_callback)(bool create_db))
+		:DeferredMonitor(_loop), db(&_db), callback(_callback),
+		 success(false) {}
+
+	~DatabaseLoader() {
+		if (thread.IsDefined())
+			thread.Join();
+
+		if (db != nullptr) {
+			/* MPD was shut down before the database
+			   became ready */
+			if (success)
+				db->Close();
+			delete db;
+		}
+	}
+
+	void Start() {
+		Error start_error;
+		if (!thread.Start(Run, this, start_error))
+			FatalError(start_error);
+	}
+
+private:
+	static void Run(void *ctx) {
+		DatabaseLoader &loader = *(DatabaseLoader *)ctx;
+
+		SetThreadName("db_load");
+
+		loader.success = loader.db->Open(loader.error);
+		loader.Schedule();
+	}
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override {
+		thread.Join();
+
+		if (!success)
+			FatalError(error);
+
+		Database &_db = *db;
+		db = nullptr;
+
+		SimpleDatabase &simple = (SimpleDatabase &)_db;
+		instance->update =
+			new UpdateService(*instance->event_loop, simple,
+					  static_cast<CompositeStorage &>(*instance->storage),
+					  *instance);
+
+		instance->OnDatabaseLoaded(_db);
+
+		/* run database update after daemonization? */
+		callback(!simple.FileExists());
+	}
+};
+
+static DatabaseLoader *db_loader;
+
+/**
+ * Creates the database.  A #SimpleDatabase is loaded by a
+ * #DatabaseLoader in a separate thread, and the callback is invoked
+ * in the main thread as soon as it is ready; all other database
+ * plugins are opened right away, and this function returns true.
+ *
+ * @return true if the database is ready (or if there is none), false
+ * if the callback will be invoked later
  */
 static bool
-glue_db_init_and_load(void)
+glue_db_init_and_load(void (*callback)(bool create_db))
 {
 	Error error;
-	instance->database =
+	Database *db =
 		CreateConfiguredDatabase(*instance->event_loop, *instance,
 					 error);
-	if (instance->database == nullptr) {
+	if (db == nullptr) {
 		if (error.IsDefined())
 			FatalError(error);
 		else
 			return true;
 	}
 
-	if (instance->database->GetPlugin().flags & DatabasePlugin::FLAG_REQUIRE_STORAGE) {
+	if (db->GetPlugin().flags & DatabasePlugin::FLAG_REQUIRE_STORAGE) {
 		if (!InitStorage(error))
 			FatalError(error);
 
 		if (instance->storage == nullptr) {
-			delete instance->database;
-			instance->database = nullptr;
+			delete db;
 			LogDefault(config_domain,
 				   "Found database setting without "
 				   "music_directory - disabling database");
@@ -215,26 +347,18 @@ glue_db_init_and_load(void)
 				   "because the database does not need it");
 	}
 
-	if (!instance->database->Open(error))
-		FatalError(error);
+	if (!db->IsPlugin(simple_db_plugin)) {
+		if (!db->Open(error))
+			FatalError(error);
 
-	if (!instance->database->IsPlugin(simple_db_plugin))
+		instance->database = db;
 		return true;
+	}
 
-	SimpleDatabase &db = *(SimpleDatabase *)instance->database;
-	instance->update = new UpdateService(*instance->event_loop, db,
-					     static_cast<CompositeStorage &>(*instance->storage),
-					     *instance);
-
-	/* run database update after daemonization? */
-	return db.FileExists();
-}
-
-static bool
-InitDatabaseAndStorage()
-{
-	const bool create_db = !glue_db_init_and_load();
-	return create_db;
+	instance->database_loading = true;
+	db_loader = new DatabaseLoader(*instance->event_loop, *db, callback);
+	db_loader->Start();
+	return false;
 }
 
 #endif
@@ -254,7 +378,8 @@ glue_sticker_init(void)
 		return;
 	}
 
-	if (!sticker_global_init(std::move(sticker_file), error))
+	if (!sticker_global_init(*instance->event_loop,
+				 std::move(sticker_file), error))
 		FatalError(error);
 #endif
 }
@@ -278,11 +403,66 @@ glue_state_file_init(Error &error)
 #endif
 	}
 
-	state_file = new StateFile(std::move(path_fs),
-				   *instance->partition,
+	state_file_path = std::move(path_fs);
+	return true;
+}
+
+/**
+ * Create the #StateFile and restore the state from it.  This is
+ * postponed until the database is ready, because the saved queue
+ * refers to songs in the database.
+ */
+static void
+glue_state_file_open()
+{
+	if (state_file_path.IsNull())
+		return;
+
+	state_file = new StateFile(std::move(state_file_path),
+				   instance->GetDefaultPartition(),
 				   *instance->event_loop);
 	state_file->Read();
-	return true;
+}
+
+/**
+ * The last startup step, invoked in the main thread as soon as the
+ * database is ready (or right before the main loop if the database
+ * does not need to be loaded in the background).
+ *
+ * @param create_db true if the database file does not exist yet and
+ * must be created by a full update
+ */
+static void
+glue_database_ready(gcc_unused bool create_db)
+{
+#ifdef ENABLE_DATABASE
+	if (create_db) {
+		/* the database failed to load: recreate the
+		   database */
+		unsigned job = instance->update->Enqueue("", true);
+		if (job == 0)
+			FatalError("directory update failed");
+	}
+
+#ifdef ENABLE_INOTIFY
+	if (auto_update && instance->storage != nullptr &&
+	    instance->update != nullptr)
+		mpd_inotify_init(*instance->event_loop,
+				 *instance->storage,
+				 *instance->update,
+				 auto_update_depth);
+#endif
+#endif
+
+	glue_state_file_open();
+
+	for (auto partition : instance->partitions) {
+		partition->outputs.SetReplayGainMode(replay_gain_get_real_mode(partition->playlist.queue.random));
+
+		/* enable all audio outputs (if not already done by
+		   playlist_state_restore() */
+		partition->pc.UpdateAudio();
+	}
 }
 
 /**
@@ -312,6 +492,14 @@ initialize_decoder_and_player(void)
 {
 	const struct config_param *param;
 
+	/* this must be done before the first buffer is allocated */
+	const bool huge_pages =
+		config_get_bool(CONF_BUFFER_HUGE_PAGES, false);
+	const bool lock_buffers = config_get_bool(CONF_BUFFER_LOCK, false);
+	if (!HugeAllocatorConfigure(huge_pages, lock_buffers))
+		LogWarning(main_domain,
+			   "Explicit huge pages are not supported on this system");
+
 	size_t buffer_size;
 	param = config_get_param(CONF_AUDIO_BUFFER_SIZE);
 	if (param != nullptr) {
@@ -327,7 +515,20 @@ initialize_decoder_and_player(void)
 
 	buffer_size *= 1024;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	const size_t chunk_size =
+		config_get_positive(CONF_CHUNK_SIZE, DEFAULT_CHUNK_SIZE);
+	if (chunk_size < MIN_CHUNK_SIZE || chunk_size > MAX_CHUNK_SIZE)
+		FormatFatalError("chunk size \"%lu\" must be between %lu "
+				 "and %lu bytes",
+				 (unsigned long)chunk_size,
+				 (unsigned long)MIN_CHUNK_SIZE,
+				 (unsigned long)MAX_CHUNK_SIZE);
+
+	const unsigned buffered_chunks = buffer_size / chunk_size;
+	if (buffered_chunks == 0)
+		FormatFatalError("buffer size \"%lu\" is smaller than "
+				 "the chunk size",
+				 (unsigned long)buffer_size);
 
 	if (buffered_chunks >= 1 << 15)
 		FormatFatalError("buffer size \"%lu\" is too big",
@@ -355,10 +556,34 @@ initialize_decoder_and_player(void)
 		config_get_positive(CONF_MAX_PLAYLIST_LENGTH,
 				    DEFAULT_PLAYLIST_MAX_LENGTH);
 
-	instance->partition = new Partition(*instance,
-					    max_length,
-					    buffered_chunks,
-					    buffered_before_play);
+	const bool lock_free_pipe =
+		config_get_bool(CONF_LOCK_FREE_PIPE, false);
+
+	const unsigned prefetch_time =
+		config_get_unsigned(CONF_PREFETCH_TIME,
+				    DEFAULT_PREFETCH_TIME);
+
+	/* the default partition always exists; additional ones are
+	   created for each distinct "partition" setting in the
+	   "audio_output" blocks */
+	std::list<std::string> names{Partition::DEFAULT_NAME};
+	for (const config_param *output = config_get_param(CONF_AUDIO_OUTPUT);
+	     output != nullptr; output = output->next) {
+		const char *name = output->GetBlockValue("partition",
+							 Partition::DEFAULT_NAME);
+		if (std::find(names.begin(), names.end(), name) == names.end())
+			names.emplace_back(name);
+	}
+
+	for (const auto &name : names)
+		instance->partitions.push_back(new Partition(*instance,
+							     name.c_str(),
+							     max_length,
+							     buffered_chunks,
+							     chunk_size,
+							     buffered_before_play,
+							     lock_free_pipe,
+							     prefetch_time));
 }
 
 /**
@@ -469,6 +694,18 @@ int mpd_main(int argc, char *argv[])
 	stats_global_init();
 	TagLoadConfig();
 
+	if (!thread_config_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	if (!memory_budget_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	io_thread_set_count(config_get_positive(CONF_IO_THREADS, 1));
+
 	if (!log_init(options.verbose, options.log_stderr, error)) {
 		LogError(error);
 		return EXIT_FAILURE;
@@ -491,16 +728,31 @@ int mpd_main(int argc, char *argv[])
 #endif
 
 	const unsigned max_clients = config_get_positive(CONF_MAX_CONN, 10);
-	instance->client_list = new ClientList(max_clients);
+	const unsigned idle_delay = config_get_unsigned(CONF_IDLE_DELAY, 0);
+	instance->client_list = new ClientList(*instance->event_loop,
+					       max_clients, idle_delay);
 
 	initialize_decoder_and_player();
 
-	if (!listen_global_init(*instance->event_loop, *instance->partition,
+	if (!listen_global_init(*instance->event_loop,
+				instance->GetDefaultPartition(),
 				error)) {
 		LogError(error);
 		return EXIT_FAILURE;
 	}
 
+	if (!metrics_http_init(*instance->event_loop,
+			       instance->GetDefaultPartition().outputs,
+			       error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	if (!TraceInit(*instance->event_loop, error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
 #ifndef ANDROID
 	daemonize_set_user();
 	daemonize_begin(options.daemon);
@@ -521,11 +773,17 @@ int mpd_main(int argc, char *argv[])
 
 	initPermissions();
 	playlist_global_init();
-	spl_global_init();
+	spl_global_init(*instance->event_loop);
 #ifdef ENABLE_ARCHIVE
 	archive_plugin_init_all();
 #endif
 
+#ifdef ENABLE_DATABASE
+	/* start loading the database early; the remaining plugins
+	   are initialized while it is being loaded */
+	const bool db_ready = glue_db_init_and_load(glue_database_ready);
+#endif
+
 	if (!pcm_convert_global_init(error)) {
 		LogError(error);
 		return EXIT_FAILURE;
@@ -533,16 +791,26 @@ int mpd_main(int argc, char *argv[])
 
 	decoder_plugin_init_all();
 
-#ifdef ENABLE_DATABASE
-	const bool create_db = InitDatabaseAndStorage();
+	if (!decoder_cache_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+#ifdef ENABLE_SYNTH_CACHE
+	if (!synth_cache_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
 #endif
 
 	glue_sticker_init();
 
 	command_init();
 	initAudioConfig();
-	instance->partition->outputs.Configure(*instance->event_loop,
-					       instance->partition->pc);
+	for (auto partition : instance->partitions)
+		partition->outputs.Configure(*instance->event_loop,
+					     partition->pc,
+					     partition->name.c_str());
 	client_manager_init();
 	replay_gain_global_init();
 
@@ -571,35 +839,20 @@ int mpd_main(int argc, char *argv[])
 
 	ZeroconfInit(*instance->event_loop);
 
-	player_create(instance->partition->pc);
-
-#ifdef ENABLE_DATABASE
-	if (create_db) {
-		/* the database failed to load: recreate the
-		   database */
-		unsigned job = instance->update->Enqueue("", true);
-		if (job == 0)
-			FatalError("directory update failed");
-	}
-#endif
+	for (auto partition : instance->partitions)
+		player_create(partition->pc);
 
 	if (!glue_state_file_init(error)) {
 		LogError(error);
 		return EXIT_FAILURE;
 	}
 
-	instance->partition->outputs.SetReplayGainMode(replay_gain_get_real_mode(instance->partition->playlist.queue.random));
-
 #ifdef ENABLE_DATABASE
-	if (config_get_bool(CONF_AUTO_UPDATE, false)) {
+	auto_update = config_get_bool(CONF_AUTO_UPDATE, false);
+	if (auto_update) {
 #ifdef ENABLE_INOTIFY
-		if (instance->storage != nullptr &&
-		    instance->update != nullptr)
-			mpd_inotify_init(*instance->event_loop,
-					 *instance->storage,
-					 *instance->update,
-					 config_get_unsigned(CONF_AUTO_UPDATE_DEPTH,
-							     INT_MAX));
+		auto_update_depth = config_get_unsigned(CONF_AUTO_UPDATE_DEPTH,
+							INT_MAX);
 #else
 		FormatWarning(main_domain,
 			      "inotify: auto_update was disabled. enable during compilation phase");
@@ -609,9 +862,10 @@ int mpd_main(int argc, char *argv[])
 
 	config_global_check();
 
-	/* enable all audio outputs (if not already done by
-	   playlist_state_restore() */
-	instance->partition->pc.UpdateAudio();
+#ifdef ENABLE_DATABASE
+	if (db_ready)
+#endif
+		glue_database_ready(false);
 
 #ifdef WIN32
 	win32_app_started();
@@ -642,9 +896,14 @@ int mpd_main(int argc, char *argv[])
 		delete state_file;
 	}
 
-	instance->partition->pc.Kill();
+	spl_global_finish();
+
+	for (auto partition : instance->partitions)
+		partition->pc.Kill();
 	ZeroconfDeinit();
 	listen_global_finish();
+	metrics_http_finish();
+	client_manager_deinit();
 	delete instance->client_list;
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -655,6 +914,7 @@ int mpd_main(int argc, char *argv[])
 #endif
 
 #ifdef ENABLE_DATABASE
+	delete db_loader;
 	delete instance->update;
 
 	if (instance->database != nullptr) {
@@ -662,6 +922,7 @@ int mpd_main(int argc, char *argv[])
 		delete instance->database;
 	}
 
+	delete instance->storage_list_cache;
 	delete instance->storage;
 #endif
 
@@ -678,8 +939,14 @@ int mpd_main(int argc, char *argv[])
 	mapper_finish();
 #endif
 
-	delete instance->partition;
+	for (auto partition : instance->partitions)
+		delete partition;
+	TraceFinish();
 	command_finish();
+#ifdef ENABLE_SYNTH_CACHE
+	synth_cache_global_finish();
+#endif
+	decoder_cache_global_finish();
 	decoder_plugin_deinit_all();
 #ifdef ENABLE_ARCHIVE
 	archive_plugin_deinit_all();
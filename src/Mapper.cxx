@@ -23,6 +23,7 @@
 
 #include "config.h"
 #include "Mapper.hxx"
+#include "DetachedSong.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 #include "fs/Charset.hxx"
@@ -74,15 +75,9 @@ map_uri_fs(const char *uri)
 	if (instance->storage == nullptr)
 		return AllocatedPath::Null();
 
-	const auto music_dir_fs = instance->storage->MapFS("");
-	if (music_dir_fs.IsNull())
-		return AllocatedPath::Null();
-
-	const auto uri_fs = AllocatedPath::FromUTF8(uri);
-	if (uri_fs.IsNull())
-		return AllocatedPath::Null();
-
-	return AllocatedPath::Build(music_dir_fs, uri_fs);
+	/* the storage knows whether a charset conversion is
+	   necessary, and caches converted directories */
+	return instance->storage->MapFS(uri);
 }
 
 std::string
@@ -104,6 +99,29 @@ map_fs_to_utf8(const char *path_fs)
 	return PathToUTF8(path_fs);
 }
 
+void
+map_song_compact(DetachedSong &song)
+{
+	if (!song.HasRealURI() || !song.IsInDatabase() ||
+	    instance->storage == nullptr)
+		return;
+
+	/* only if the real URI was set by DatabaseDetachSong(); a
+	   database plugin may have provided a different one */
+	if (instance->storage->MapUTF8(song.GetURI()) == song.GetRealURI())
+		song.ClearRealURI();
+}
+
+void
+map_song_restore(DetachedSong &song)
+{
+	if (song.HasRealURI() || !song.IsInDatabase() ||
+	    instance->storage == nullptr)
+		return;
+
+	song.SetRealURI(instance->storage->MapUTF8(song.GetURI()));
+}
+
 #endif
 
 const AllocatedPath &
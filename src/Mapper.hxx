@@ -31,6 +31,7 @@
 #define PLAYLIST_FILE_SUFFIX ".m3u"
 
 class AllocatedPath;
+class DetachedSong;
 
 void
 mapper_init(AllocatedPath &&playlist_dir);
@@ -60,6 +61,34 @@ gcc_pure
 std::string
 map_fs_to_utf8(const char *path_fs);
 
+/**
+ * Removes the "real" URI of a song from the database if it can be
+ * derived from the storage.  This saves memory for songs which are
+ * kept for a long time, i.e. in the queue.
+ */
+void
+map_song_compact(DetachedSong &song);
+
+/**
+ * Restores the "real" URI of a song from the database which was
+ * removed by map_song_compact().  This must be done before the song
+ * is opened.
+ */
+void
+map_song_restore(DetachedSong &song);
+
+#else
+
+static inline void
+map_song_compact(gcc_unused DetachedSong &song)
+{
+}
+
+static inline void
+map_song_restore(gcc_unused DetachedSong &song)
+{
+}
+
 #endif
 
 /**
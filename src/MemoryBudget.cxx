@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MemoryBudget.hxx"
+#include "Metrics.hxx"
+#include "MusicBuffer.hxx"
+#include "tag/TagPool.hxx"
+#include "queue/Queue.hxx"
+#include "client/Client.hxx"
+#include "input/InputStream.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigError.hxx"
+#include "util/MemoryAccount.hxx"
+#include "util/Error.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/plugins/simple/Song.hxx"
+#endif
+
+#ifdef ENABLE_HTTPD_OUTPUT
+#include "output/plugins/httpd/Page.hxx"
+#endif
+
+#include <stdlib.h>
+
+const MemoryAccountInfo memory_accounts[] = {
+	{ "music_buffer", &memory_music_buffer },
+	{ "tag_pool", &memory_tag_pool },
+#ifdef ENABLE_DATABASE
+	{ "database", &memory_database },
+#endif
+	{ "queue", &memory_queue },
+	{ "client_output", &memory_client_output },
+	{ "input_buffer", &memory_input_buffer },
+#ifdef ENABLE_HTTPD_OUTPUT
+	{ "httpd", &memory_httpd },
+#endif
+	{ nullptr, nullptr },
+};
+
+bool
+memory_budget_global_init(Error &error)
+{
+	const config_param *param = config_get_param(CONF_MEMORY_BUDGET);
+	if (param == nullptr)
+		return true;
+
+	for (const auto &bp : param->block_params) {
+		bp.used = true;
+
+		const MemoryAccountInfo *i;
+		for (i = memory_accounts; i->name != nullptr; ++i)
+			if (bp.name == i->name)
+				break;
+
+		if (i->name == nullptr) {
+			error.Format(config_domain,
+				     "Unknown memory account \"%s\" on line %i",
+				     bp.name.c_str(), bp.line);
+			return false;
+		}
+
+		char *endptr;
+		const unsigned long kb = strtoul(bp.value.c_str(), &endptr, 10);
+		if (endptr == bp.value.c_str() || *endptr != 0) {
+			error.Format(config_domain,
+				     "Invalid memory budget on line %i",
+				     bp.line);
+			return false;
+		}
+
+		i->account->SetBudget(size_t(kb) * 1024);
+	}
+
+	return true;
+}
+
+void
+memory_visit_metrics(MetricsVisitor &visitor)
+{
+	for (auto i = memory_accounts; i->name != nullptr; ++i)
+		visitor.OnGauge("memory_bytes",
+				"Memory allocated by a subsystem",
+				MetricLabel("subsystem", i->name),
+				i->account->Get());
+
+	for (auto i = memory_accounts; i->name != nullptr; ++i)
+		visitor.OnGauge("memory_budget_bytes",
+				"Configured soft memory limit of a subsystem (0 = unlimited)",
+				MetricLabel("subsystem", i->name),
+				i->account->GetBudget());
+}
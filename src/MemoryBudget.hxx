@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * Memory accounting per subsystem.  The large allocators report
+ * their usage to a #MemoryAccount which is owned by the subsystem
+ * (e.g. #memory_tag_pool); this library collects them for the
+ * "memory" command and the metrics.  The "memory_budget" block
+ * configures soft limits which make some subsystems shed memory
+ * before the system runs out.
+ */
+
+#ifndef MPD_MEMORY_BUDGET_HXX
+#define MPD_MEMORY_BUDGET_HXX
+
+#include "check.h"
+
+class Error;
+class MemoryAccount;
+class MetricsVisitor;
+
+struct MemoryAccountInfo {
+	const char *name;
+	MemoryAccount *account;
+};
+
+/**
+ * All accounts, terminated by an entry with a nullptr name.
+ */
+extern const MemoryAccountInfo memory_accounts[];
+
+/**
+ * Apply the "memory_budget" configuration block.
+ */
+bool
+memory_budget_global_init(Error &error);
+
+void
+memory_visit_metrics(MetricsVisitor &visitor);
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Metrics.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
+
+#ifdef ENABLE_LOCK_PROFILING
+#include "thread/LockProfile.hxx"
+#endif
+
+MetricGauge metric_clients;
+MetricCounter metric_commands;
+MetricHistogram metric_command_latency;
+
+MetricGauge metric_pipe_chunks;
+MetricGauge metric_buffer_free_chunks;
+MetricGauge metric_pipe_low;
+MetricCounter metric_player_silence;
+
+MetricCounter metric_decoder_bytes;
+MetricCounter metric_decoder_chunks;
+MetricCounter metric_decoder_state_changes;
+
+MetricCounter metric_log_dropped;
+
+uint64_t
+MetricHistogram::GetQuantile(double q) const
+{
+	const uint64_t n = GetCount();
+	if (n == 0)
+		return 0;
+
+	const uint64_t rank = uint64_t(q * n);
+
+	uint64_t cumulative = 0;
+	for (unsigned i = 0; i < N_BUCKETS; ++i) {
+		cumulative += GetBucket(i);
+		if (cumulative > rank)
+			return GetBound(i);
+	}
+
+	/* the quantile is in the overflow bucket */
+	return GetBound(N_BUCKETS);
+}
+
+void
+metrics_visit(MetricsVisitor &visitor)
+{
+	const MetricLabel none;
+
+	visitor.OnGauge("clients",
+			"Number of connected clients",
+			none, metric_clients.Get());
+	visitor.OnCounter("commands",
+			  "Number of commands executed",
+			  none, metric_commands.Get());
+	visitor.OnHistogram("command_latency_us",
+			    "Time spent executing a command",
+			    none, metric_command_latency);
+
+	visitor.OnGauge("pipe_chunks",
+			"Number of decoded chunks in the player's pipe",
+			none, metric_pipe_chunks.Get());
+	visitor.OnGauge("buffer_free_chunks",
+			"Number of free chunks in the music buffer",
+			none, metric_buffer_free_chunks.Get());
+	visitor.OnGauge("pipe_low",
+			"Whether the player is running low on decoded chunks",
+			none, metric_pipe_low.Get());
+	visitor.OnCounter("player_silence",
+			  "Number of silence chunks sent because the decoder was too slow",
+			  none, metric_player_silence.Get());
+
+	visitor.OnCounter("decoder_bytes",
+			  "Number of PCM bytes submitted by decoders",
+			  none, metric_decoder_bytes.Get());
+	visitor.OnCounter("decoder_chunks",
+			  "Number of chunks filled by decoders",
+			  none, metric_decoder_chunks.Get());
+	visitor.OnCounter("decoder_state_changes",
+			  "Number of decoder state transitions",
+			  none, metric_decoder_state_changes.Get());
+
+	visitor.OnCounter("log_dropped",
+			  "Number of log messages dropped by the asynchronous logger",
+			  none, metric_log_dropped.Get());
+
+#ifdef ENABLE_DATABASE
+	visitor.OnHistogram("db_lock_hold_us",
+			    "Time the database lock was held exclusively",
+			    none, db_mutex_hold_time);
+#endif
+
+#ifdef ENABLE_LOCK_PROFILING
+	lock_profile_visit(visitor);
+#endif
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/** \file
+ *
+ * Run-time instrumentation: counters, gauges and histograms which
+ * describe the state of MPD's internals.  They are updated lock-free
+ * by the threads which own the measured objects, and exported by
+ * the "metrics" command and by the optional Prometheus listener
+ * (see MetricsHttp.hxx).
+ */
+
+#ifndef MPD_METRICS_HXX
+#define MPD_METRICS_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <stdint.h>
+
+/**
+ * A value which only ever grows.
+ */
+class MetricCounter {
+	std::atomic<uint64_t> value;
+
+public:
+	MetricCounter():value(0) {}
+
+	MetricCounter(const MetricCounter &) = delete;
+	MetricCounter &operator=(const MetricCounter &) = delete;
+
+	void Add(uint64_t delta=1) {
+		value.fetch_add(delta, std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	uint64_t Get() const {
+		return value.load(std::memory_order_relaxed);
+	}
+};
+
+/**
+ * A value which may go up and down, e.g. a fill level.
+ */
+class MetricGauge {
+	std::atomic<int64_t> value;
+
+public:
+	MetricGauge():value(0) {}
+
+	MetricGauge(const MetricGauge &) = delete;
+	MetricGauge &operator=(const MetricGauge &) = delete;
+
+	void Set(int64_t _value) {
+		value.store(_value, std::memory_order_relaxed);
+	}
+
+	void Add(int64_t delta) {
+		value.fetch_add(delta, std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	int64_t Get() const {
+		return value.load(std::memory_order_relaxed);
+	}
+};
+
+/**
+ * A distribution of durations in microseconds.  The buckets have
+ * exponential upper bounds (1us, 2us, 4us, ... ~8s); larger values
+ * go to an overflow bucket.
+ */
+class MetricHistogram {
+public:
+	static constexpr unsigned N_BUCKETS = 24;
+
+private:
+	/**
+	 * Non-cumulative bucket counters; the last one is the
+	 * overflow bucket.
+	 */
+	std::atomic<uint64_t> buckets[N_BUCKETS + 1];
+
+	std::atomic<uint64_t> count, sum;
+
+public:
+	MetricHistogram():count(0), sum(0) {
+		for (auto &i : buckets)
+			i.store(0, std::memory_order_relaxed);
+	}
+
+	MetricHistogram(const MetricHistogram &) = delete;
+	MetricHistogram &operator=(const MetricHistogram &) = delete;
+
+	/**
+	 * Returns the inclusive upper bound of the specified bucket
+	 * in microseconds.
+	 */
+	static constexpr uint64_t GetBound(unsigned i) {
+		return uint64_t(1) << i;
+	}
+
+	void Observe(uint64_t us) {
+		/* the smallest i with us <= 2^i */
+		unsigned i = us > 1
+			? 64 - __builtin_clzll(us - 1)
+			: 0;
+		if (i > N_BUCKETS)
+			i = N_BUCKETS;
+
+		buckets[i].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(us, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the number of values in the specified bucket; #i
+	 * may be #N_BUCKETS for the overflow bucket.
+	 */
+	gcc_pure
+	uint64_t GetBucket(unsigned i) const {
+		return buckets[i].load(std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	uint64_t GetCount() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	uint64_t GetSum() const {
+		return sum.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Estimate a quantile: returns the upper bound of the bucket
+	 * which contains it, or 0 if the histogram is empty.
+	 *
+	 * @param q a value between 0 and 1
+	 */
+	gcc_pure
+	uint64_t GetQuantile(double q) const;
+};
+
+/**
+ * An optional label which distinguishes several objects exporting
+ * the same metric, e.g. the name of an audio output.
+ */
+struct MetricLabel {
+	const char *name;
+	const char *value;
+
+	constexpr MetricLabel():name(nullptr), value(nullptr) {}
+	constexpr MetricLabel(const char *_name, const char *_value)
+		:name(_name), value(_value) {}
+
+	constexpr bool IsDefined() const {
+		return name != nullptr;
+	}
+};
+
+/**
+ * Receives the values of metrics; see metrics_visit().  All
+ * samples of one metric are visited in a row.
+ */
+class MetricsVisitor {
+public:
+	virtual void OnCounter(const char *name, const char *help,
+			       MetricLabel label, uint64_t value) = 0;
+
+	virtual void OnGauge(const char *name, const char *help,
+			     MetricLabel label, int64_t value) = 0;
+
+	virtual void OnHistogram(const char *name, const char *help,
+				 MetricLabel label,
+				 const MetricHistogram &histogram) = 0;
+};
+
+extern MetricGauge metric_clients;
+extern MetricCounter metric_commands;
+extern MetricHistogram metric_command_latency;
+
+extern MetricGauge metric_pipe_chunks;
+extern MetricGauge metric_buffer_free_chunks;
+
+/**
+ * 1 while the player is running low on decoded chunks, i.e. playback
+ * is at risk of being interrupted; 0 otherwise.
+ */
+extern MetricGauge metric_pipe_low;
+
+extern MetricCounter metric_player_silence;
+
+extern MetricCounter metric_decoder_bytes;
+extern MetricCounter metric_decoder_chunks;
+extern MetricCounter metric_decoder_state_changes;
+
+extern MetricCounter metric_log_dropped;
+
+/**
+ * Visit all global metrics.  Metrics which belong to objects (e.g.
+ * audio outputs) are visited by their owners.
+ */
+void
+metrics_visit(MetricsVisitor &visitor);
+
+#endif
@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "MetricsHttp.hxx"
+#include "Metrics.hxx"
+#include "MemoryBudget.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "command/AllCommands.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "event/ServerSocket.hxx"
+#include "event/BufferedSocket.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "system/SocketError.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <string>
+#include <algorithm>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+static constexpr Domain metrics_http_domain("metrics_http");
+
+/**
+ * Formats metrics in the Prometheus text exposition format.
+ */
+class PrometheusMetricsVisitor final : public MetricsVisitor {
+	std::string &out;
+
+	/**
+	 * The name of the previous metric; its "HELP" and "TYPE"
+	 * lines are printed only once.
+	 */
+	const char *last_name;
+
+public:
+	explicit PrometheusMetricsVisitor(std::string &_out)
+		:out(_out), last_name(nullptr) {}
+
+private:
+	void Printf(const char *fmt, ...) gcc_printf(2, 3) {
+		char buffer[512];
+
+		va_list ap;
+		va_start(ap, fmt);
+		vsnprintf(buffer, sizeof(buffer), fmt, ap);
+		va_end(ap);
+
+		out.append(buffer);
+	}
+
+	void Header(const char *name, const char *help, const char *type) {
+		if (last_name != nullptr && strcmp(last_name, name) == 0)
+			return;
+
+		last_name = name;
+		Printf("# HELP mpd_%s %s\n", name, help);
+		Printf("# TYPE mpd_%s %s\n", name, type);
+	}
+
+	void Label(MetricLabel label, const char *extra=nullptr) {
+		if (!label.IsDefined() && extra == nullptr)
+			return;
+
+		out.push_back('{');
+
+		if (label.IsDefined()) {
+			out.append(label.name);
+			out.append("=\"");
+			for (const char *p = label.value; *p != 0; ++p) {
+				if (*p == '"' || *p == '\\')
+					out.push_back('\\');
+				out.push_back(*p);
+			}
+			out.push_back('"');
+
+			if (extra != nullptr)
+				out.push_back(',');
+		}
+
+		if (extra != nullptr)
+			out.append(extra);
+
+		out.push_back('}');
+	}
+
+	virtual void OnCounter(const char *name, const char *help,
+			       MetricLabel label, uint64_t value) override {
+		Header(name, help, "counter");
+		Printf("mpd_%s", name);
+		Label(label);
+		Printf(" %llu\n", (unsigned long long)value);
+	}
+
+	virtual void OnGauge(const char *name, const char *help,
+			     MetricLabel label, int64_t value) override {
+		Header(name, help, "gauge");
+		Printf("mpd_%s", name);
+		Label(label);
+		Printf(" %lld\n", (long long)value);
+	}
+
+	virtual void OnHistogram(const char *name, const char *help,
+				 MetricLabel label,
+				 const MetricHistogram &h) override {
+		Header(name, help, "histogram");
+
+		uint64_t cumulative = 0;
+		for (unsigned i = 0; i <= MetricHistogram::N_BUCKETS; ++i) {
+			cumulative += h.GetBucket(i);
+
+			char le[32];
+			if (i < MetricHistogram::N_BUCKETS)
+				snprintf(le, sizeof(le), "le=\"%llu\"",
+					 (unsigned long long)MetricHistogram::GetBound(i));
+			else
+				strcpy(le, "le=\"+Inf\"");
+
+			Printf("mpd_%s_bucket", name);
+			Label(label, le);
+			Printf(" %llu\n", (unsigned long long)cumulative);
+		}
+
+		Printf("mpd_%s_sum", name);
+		Label(label);
+		Printf(" %llu\n", (unsigned long long)h.GetSum());
+
+		Printf("mpd_%s_count", name);
+		Label(label);
+		Printf(" %llu\n", (unsigned long long)h.GetCount());
+	}
+};
+
+class MetricsListener;
+
+/**
+ * One HTTP connection: reads the request header, sends the
+ * response and closes the socket.  It is freed by the
+ * #MetricsListener afterwards.
+ */
+class MetricsHttpConnection final
+	: BufferedSocket,
+	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+	MetricsListener &listener;
+
+	std::string response;
+	size_t position;
+
+public:
+	MetricsHttpConnection(EventLoop &_loop, int _fd,
+			      MetricsListener &_listener)
+		:BufferedSocket(_fd, _loop), listener(_listener),
+		 position(0) {}
+
+	~MetricsHttpConnection() {
+		if (IsDefined())
+			BufferedSocket::Close();
+	}
+
+	using BufferedSocket::IsDefined;
+
+	void Close();
+
+private:
+	void Respond(const char *status, const std::string &body);
+
+	/* virtual methods from class BufferedSocket */
+	virtual InputResult OnSocketInput(void *data,
+					  size_t length) override;
+	virtual void OnSocketError(Error &&error) override;
+	virtual void OnSocketClosed() override;
+	virtual bool OnSocketReady(unsigned flags) override;
+};
+
+class MetricsListener final : public ServerSocket, DeferredMonitor {
+	const MultipleOutputs &outputs;
+
+	typedef boost::intrusive::list<MetricsHttpConnection,
+				       boost::intrusive::constant_time_size<false>> ConnectionList;
+	ConnectionList connections;
+
+public:
+	MetricsListener(EventLoop &_loop, const MultipleOutputs &_outputs)
+		:ServerSocket(_loop), DeferredMonitor(_loop),
+		 outputs(_outputs) {}
+
+	~MetricsListener() {
+		connections.clear_and_dispose([](MetricsHttpConnection *c){
+				delete c;
+			});
+	}
+
+	void Format(std::string &out) const {
+		PrometheusMetricsVisitor visitor(out);
+		metrics_visit(visitor);
+		memory_visit_metrics(visitor);
+		command_visit_metrics(visitor);
+		outputs.VisitMetrics(visitor);
+	}
+
+	/**
+	 * A connection has been closed; free it later, because it
+	 * cannot delete itself from within its own callback.
+	 */
+	void ScheduleReap() {
+		DeferredMonitor::Schedule();
+	}
+
+private:
+	virtual void OnAccept(int fd, gcc_unused const sockaddr &address,
+			      gcc_unused size_t address_length,
+			      gcc_unused int uid) override {
+		auto *c = new MetricsHttpConnection(ServerSocket::GetEventLoop(),
+						    fd, *this);
+		connections.push_back(*c);
+	}
+
+	virtual void RunDeferred() override {
+		connections.remove_and_dispose_if([](const MetricsHttpConnection &c){
+				return !c.IsDefined();
+			},
+			[](MetricsHttpConnection *c){
+				delete c;
+			});
+	}
+};
+
+void
+MetricsHttpConnection::Close()
+{
+	BufferedSocket::Close();
+	listener.ScheduleReap();
+}
+
+void
+MetricsHttpConnection::Respond(const char *status, const std::string &body)
+{
+	char header[256];
+	snprintf(header, sizeof(header),
+		 "HTTP/1.0 %s\r\n"
+		 "Content-Type: text/plain; version=0.0.4\r\n"
+		 "Content-Length: %lu\r\n"
+		 "Connection: close\r\n"
+		 "\r\n",
+		 status, (unsigned long)body.length());
+
+	response = header;
+	response.append(body);
+	position = 0;
+
+	ScheduleWrite();
+}
+
+BufferedSocket::InputResult
+MetricsHttpConnection::OnSocketInput(void *data, size_t length)
+{
+	if (!response.empty())
+		/* already responding; ignore the rest */
+		return InputResult::PAUSE;
+
+	const char *p = (const char *)data;
+	const char *end = p + length;
+
+	/* wait for the end of the request header */
+	static constexpr char crlf2[] = "\r\n\r\n", lf2[] = "\n\n";
+	if (std::search(p, end, crlf2, crlf2 + 4) == end &&
+	    std::search(p, end, lf2, lf2 + 2) == end)
+		return InputResult::MORE;
+
+	if (length >= 13 && memcmp(p, "GET /metrics", 12) == 0 &&
+	    (p[12] == ' ' || p[12] == '\r' || p[12] == '\n')) {
+		std::string body;
+		listener.Format(body);
+		Respond("200 OK", body);
+	} else
+		Respond("404 Not Found", "Not found\n");
+
+	return InputResult::PAUSE;
+}
+
+void
+MetricsHttpConnection::OnSocketError(Error &&error)
+{
+	LogError(error);
+	Close();
+}
+
+void
+MetricsHttpConnection::OnSocketClosed()
+{
+	Close();
+}
+
+bool
+MetricsHttpConnection::OnSocketReady(unsigned flags)
+{
+	if ((flags & WRITE) == 0 || response.empty())
+		return BufferedSocket::OnSocketReady(flags);
+
+	const ssize_t nbytes = BufferedSocket::Write(response.data() + position,
+						     response.length() - position);
+	if (nbytes < 0) {
+		if (IsSocketErrorAgain(GetSocketError()))
+			return true;
+
+		Close();
+		return false;
+	}
+
+	position += nbytes;
+	if (position < response.length())
+		return true;
+
+	Close();
+	return false;
+}
+
+static MetricsListener *metrics_listener;
+
+bool
+metrics_http_init(EventLoop &loop, const MultipleOutputs &outputs,
+		  Error &error)
+{
+	const unsigned port = config_get_positive(CONF_METRICS_PORT, 0);
+	if (port == 0)
+		return true;
+
+	metrics_listener = new MetricsListener(loop, outputs);
+
+	if (!metrics_listener->AddPort(port, error) ||
+	    !metrics_listener->Open(error)) {
+		delete metrics_listener;
+		metrics_listener = nullptr;
+		error.FormatPrefix("Failed to listen on metrics port %u: ",
+				   port);
+		return false;
+	}
+
+	FormatDebug(metrics_http_domain,
+		    "exporting metrics on port %u", port);
+	return true;
+}
+
+void
+metrics_http_finish()
+{
+	delete metrics_listener;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_MIX_RAMP_CURVE_HXX
+#define MPD_MIX_RAMP_CURVE_HXX
+
+#include "check.h"
+#include "util/NumberParser.hxx"
+#include "Compiler.h"
+
+#include <vector>
+
+/**
+ * A parsed MixRamp tag ("mixramp_start" or "mixramp_end"): a list of
+ * (dB, seconds) pairs describing the volume profile of the song's
+ * beginning or end.  It is parsed once when the tag is loaded, so
+ * the player thread only needs to walk a small table at a song
+ * change.
+ */
+class MixRampCurve {
+	struct Point {
+		float db, seconds;
+	};
+
+	std::vector<Point> points;
+
+	/**
+	 * Was a (non-empty) tag value parsed?  It may be malformed,
+	 * in which case #points is empty.
+	 */
+	bool defined = false;
+
+public:
+	void Clear() {
+		points.clear();
+		defined = false;
+	}
+
+	gcc_pure
+	bool IsDefined() const {
+		return defined;
+	}
+
+	/**
+	 * Parse a MixRamp string: pairs of dB and seconds, with a
+	 * space between the two values of a pair and semicolons
+	 * between pairs, e.g. "1.0 0.00;3.0 0.10;6.0 2.50;".  Parsing
+	 * stops at the first malformed pair.
+	 */
+	void Parse(const char *s) {
+		points.clear();
+
+		defined = s != nullptr && *s != 0;
+		if (!defined)
+			return;
+
+		while (true) {
+			char *endptr;
+			const float db = ParseFloat(s, &endptr);
+			if (endptr == s || *endptr != ' ')
+				break;
+
+			s = endptr + 1;
+
+			const float seconds = ParseFloat(s, &endptr);
+			if (endptr == s || (*endptr != ';' && *endptr != 0))
+				break;
+
+			points.push_back({db, seconds});
+
+			s = endptr;
+			if (*s == ';')
+				++s;
+		}
+	}
+
+	/**
+	 * Determine the time at which the song reaches the specified
+	 * level, interpolating linearly between two points.  The dB
+	 * values must be monotonically increasing for this to work.
+	 *
+	 * @return the time in seconds, or a negative value if the
+	 * song never gets this loud
+	 */
+	gcc_pure
+	float Interpolate(float required_db) const {
+		const Point *last = nullptr;
+
+		for (const auto &p : points) {
+			/* check for exact match */
+			if (p.db == required_db)
+				return p.seconds;
+
+			/* save if too quiet */
+			if (p.db < required_db) {
+				last = &p;
+				continue;
+			}
+
+			/* if required db < any stored value, use the
+			   least */
+			if (last == nullptr)
+				return p.seconds;
+
+			/* finally, interpolate linearly */
+			return last->seconds + (required_db - last->db) *
+				(p.seconds - last->seconds) / (p.db - last->db);
+		}
+
+		return -1;
+	}
+};
+
+#endif
@@ -21,6 +21,7 @@
 #define MPD_MIX_RAMP_INFO_HXX
 
 #include "check.h"
+#include "MixRampCurve.hxx"
 #include "Compiler.h"
 
 #include <string>
@@ -28,12 +29,19 @@
 class MixRampInfo {
 	std::string start, end;
 
+	/**
+	 * The parsed values of #start and #end.
+	 */
+	MixRampCurve start_curve, end_curve;
+
 public:
 	MixRampInfo() = default;
 
 	void Clear() {
 		start.clear();
 		end.clear();
+		start_curve.Clear();
+		end_curve.Clear();
 	}
 
 	gcc_pure
@@ -51,15 +59,26 @@ public:
 		return end.empty() ? nullptr : end.c_str();
 	}
 
+	const MixRampCurve &GetStartCurve() const {
+		return start_curve;
+	}
+
+	const MixRampCurve &GetEndCurve() const {
+		return end_curve;
+	}
+
 	void SetStart(const char *new_value) {
 		if (new_value == nullptr)
 			start.clear();
 		else
 			start = new_value;
+
+		start_curve.Parse(new_value);
 	}
 
 	void SetStart(std::string &&new_value) {
 		start = std::move(new_value);
+		start_curve.Parse(start.c_str());
 	}
 
 	void SetEnd(const char *new_value) {
@@ -67,10 +86,13 @@ public:
 			end.clear();
 		else
 			end = new_value;
+
+		end_curve.Parse(new_value);
 	}
 
 	void SetEnd(std::string &&new_value) {
 		end = std::move(new_value);
+		end_curve.Parse(end.c_str());
 	}
 };
 
@@ -22,19 +22,40 @@
 #include "MusicChunk.hxx"
 #include "system/FatalError.hxx"
 
+#include <algorithm>
+#include <new>
+
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
+MemoryAccount memory_music_buffer;
+
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size)
+	:mutex("music_buffer"),
+	 buffer(num_chunks, music_chunk::GetAllocationSize(_chunk_size)),
+	 chunk_size(_chunk_size) {
 	if (buffer.IsOOM())
 		FatalError("Failed to allocate buffer");
+
+	memory_music_buffer.Add(size_t(num_chunks) *
+				music_chunk::GetAllocationSize(chunk_size));
+}
+
+MusicBuffer::~MusicBuffer()
+{
+	memory_music_buffer.Sub(size_t(buffer.GetCapacity()) *
+				music_chunk::GetAllocationSize(chunk_size));
 }
 
 music_chunk *
 MusicBuffer::Allocate()
 {
 	const ScopeLock protect(mutex);
-	return buffer.Allocate();
+	++stats.global_hits;
+
+	music_chunk *chunk = buffer.Allocate(chunk_size);
+	if (chunk != nullptr)
+		++stats.allocations;
+	return chunk;
 }
 
 void
@@ -43,11 +64,144 @@ MusicBuffer::Return(music_chunk *chunk)
 	assert(chunk != nullptr);
 
 	const ScopeLock protect(mutex);
+	++stats.global_hits;
+	++stats.returns;
 
 	if (chunk->other != nullptr) {
 		assert(chunk->other->other == nullptr);
 		buffer.Free(chunk->other);
+		++stats.returns;
 	}
 
 	buffer.Free(chunk);
 }
+
+unsigned
+MusicBuffer::AllocateBatch(music_chunk **dest, unsigned n)
+{
+	const ScopeLock protect(mutex);
+	++stats.global_hits;
+
+	unsigned i = 0;
+	for (; i < n; ++i) {
+		music_chunk *chunk = buffer.Allocate(chunk_size);
+		if (chunk == nullptr)
+			break;
+
+		dest[i] = chunk;
+	}
+
+	return i;
+}
+
+void
+MusicBuffer::ReturnBatch(music_chunk *const*src, unsigned n)
+{
+	const ScopeLock protect(mutex);
+	++stats.global_hits;
+
+	for (unsigned i = 0; i < n; ++i) {
+		assert(src[i]->other == nullptr);
+		buffer.Free(src[i]);
+	}
+}
+
+void
+MusicBuffer::AddStats(unsigned long allocations, unsigned long returns)
+{
+	const ScopeLock protect(mutex);
+	stats.allocations += allocations;
+	stats.returns += returns;
+}
+
+MusicBuffer::Stats
+MusicBuffer::GetStats()
+{
+	const ScopeLock protect(mutex);
+	return stats;
+}
+
+unsigned
+MusicBuffer::GetFreeCount()
+{
+	const ScopeLock protect(mutex);
+	return buffer.GetCapacity() - buffer.GetAllocatedCount();
+}
+
+MusicBufferCache::MusicBufferCache(MusicBuffer &_buffer)
+	:buffer(_buffer),
+	 batch(std::min(unsigned(MAX_BATCH), _buffer.GetSize() / 16)),
+	 n(0), allocations(0), returns(0)
+{
+}
+
+music_chunk *
+MusicBufferCache::Allocate()
+{
+	if (batch == 0)
+		return buffer.Allocate();
+
+	if (n == 0) {
+		n = buffer.AllocateBatch(chunks, batch);
+		if (n == 0)
+			return nullptr;
+	}
+
+	++allocations;
+	return chunks[--n];
+}
+
+inline void
+MusicBufferCache::Put(music_chunk *chunk)
+{
+	/* reset the chunk to its initial state, just like
+	   SliceBuffer::Free() followed by SliceBuffer::Allocate()
+	   would */
+	const size_t capacity = chunk->capacity;
+	chunk->~music_chunk();
+	::new((void *)chunk) music_chunk(capacity);
+
+	if (n == batch * 2) {
+		/* the cache is full: give a whole batch back to the
+		   global pool */
+		n -= batch;
+		buffer.ReturnBatch(chunks + n, batch);
+	}
+
+	chunks[n++] = chunk;
+	++returns;
+}
+
+void
+MusicBufferCache::Return(music_chunk *chunk)
+{
+	assert(chunk != nullptr);
+
+	if (batch == 0) {
+		buffer.Return(chunk);
+		return;
+	}
+
+	music_chunk *other = chunk->other;
+	if (other != nullptr) {
+		assert(other->other == nullptr);
+		chunk->other = nullptr;
+		Put(other);
+	}
+
+	Put(chunk);
+}
+
+void
+MusicBufferCache::Flush()
+{
+	if (n > 0) {
+		buffer.ReturnBatch(chunks, n);
+		n = 0;
+	}
+
+	if (allocations > 0 || returns > 0) {
+		buffer.AddStats(allocations, returns);
+		allocations = returns = 0;
+	}
+}
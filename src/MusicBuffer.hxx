@@ -22,26 +22,66 @@
 
 #include "util/SliceBuffer.hxx"
 #include "thread/Mutex.hxx"
+#include "util/MemoryAccount.hxx"
 
 struct music_chunk;
 
+/**
+ * The memory reserved by all #MusicBuffer instances.
+ */
+extern MemoryAccount memory_music_buffer;
+
 /**
  * An allocator for #music_chunk objects.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
+	/** a mutex which protects #buffer and #stats */
 	Mutex mutex;
 
 	SliceBuffer<music_chunk> buffer;
 
+	/**
+	 * The payload size of each chunk.
+	 */
+	const size_t chunk_size;
+
+public:
+	struct Stats {
+		/**
+		 * The number of chunks handed out by Allocate() and
+		 * by all #MusicBufferCache instances.
+		 */
+		unsigned long allocations;
+
+		/**
+		 * The number of chunks given back by Return() and by
+		 * all #MusicBufferCache instances.
+		 */
+		unsigned long returns;
+
+		/**
+		 * How often #mutex was locked to access the global
+		 * pool.
+		 */
+		unsigned long global_hits;
+
+		Stats():allocations(0), returns(0), global_hits(0) {}
+	};
+
+private:
+	Stats stats;
+
 public:
 	/**
 	 * Creates a new #MusicBuffer object.
 	 *
 	 * @param num_chunks the number of #music_chunk reserved in
 	 * this buffer
+	 * @param chunk_size the payload size of each chunk in bytes
 	 */
-	MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks, size_t chunk_size);
+
+	~MusicBuffer();
 
 #ifndef NDEBUG
 	/**
@@ -64,6 +104,14 @@ public:
 		return buffer.GetCapacity();
 	}
 
+	/**
+	 * Returns the payload size of each chunk in bytes.
+	 */
+	gcc_pure
+	size_t GetChunkSize() const {
+		return chunk_size;
+	}
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
@@ -78,6 +126,99 @@ public:
 	 * Allocate() then.
 	 */
 	void Return(music_chunk *chunk);
+
+	/**
+	 * Allocates up to #n chunks while locking the mutex only
+	 * once.
+	 *
+	 * @return the number of chunks stored in #dest
+	 */
+	unsigned AllocateBatch(music_chunk **dest, unsigned n);
+
+	/**
+	 * Returns #n chunks while locking the mutex only once.  The
+	 * chunks must not refer to an "other" chunk.
+	 */
+	void ReturnBatch(music_chunk *const*src, unsigned n);
+
+	/**
+	 * Merges statistics collected by a #MusicBufferCache.
+	 */
+	void AddStats(unsigned long allocations, unsigned long returns);
+
+	Stats GetStats();
+
+	/**
+	 * Returns the number of chunks in the global pool which are
+	 * available to Allocate().  Chunks sitting in a
+	 * #MusicBufferCache are not counted.
+	 */
+	unsigned GetFreeCount();
+};
+
+/**
+ * A small cache of free chunks in front of a #MusicBuffer.  It is
+ * owned by one thread, which allocates and returns chunks without
+ * locking the #MusicBuffer mutex; the global pool is only accessed
+ * to refill or drain a whole batch.
+ *
+ * Chunks sitting in the cache are not available to other threads,
+ * therefore the batch size is limited to a small fraction of the
+ * buffer, and the owner must call Flush() before other threads
+ * expect all chunks to be back.
+ */
+class MusicBufferCache {
+	static constexpr unsigned MAX_BATCH = 16;
+
+	MusicBuffer &buffer;
+
+	/**
+	 * The number of chunks moved from/to the #MusicBuffer at a
+	 * time.  0 disables the cache.
+	 */
+	const unsigned batch;
+
+	unsigned n;
+
+	music_chunk *chunks[MAX_BATCH * 2];
+
+	/**
+	 * Number of chunks passed through this cache since the last
+	 * Flush(), for #MusicBuffer::Stats.
+	 */
+	unsigned long allocations, returns;
+
+public:
+	explicit MusicBufferCache(MusicBuffer &_buffer);
+
+	~MusicBufferCache() {
+		Flush();
+	}
+
+	MusicBufferCache(const MusicBufferCache &) = delete;
+	MusicBufferCache &operator=(const MusicBufferCache &) = delete;
+
+	MusicBuffer &GetBuffer() {
+		return buffer;
+	}
+
+	/**
+	 * Like MusicBuffer::Allocate().
+	 */
+	music_chunk *Allocate();
+
+	/**
+	 * Like MusicBuffer::Return().
+	 */
+	void Return(music_chunk *chunk);
+
+	/**
+	 * Returns all cached chunks to the #MusicBuffer.
+	 */
+	void Flush();
+
+private:
+	void Put(music_chunk *chunk);
 };
 
 #endif
@@ -55,7 +55,7 @@ music_chunk::Write(const AudioFormat af,
 	}
 
 	const size_t frame_size = af.GetFrameSize();
-	size_t num_frames = (sizeof(data) - length) / frame_size;
+	size_t num_frames = (capacity - length) / frame_size;
 	if (num_frames == 0)
 		return WritableBuffer<void>::Null();
 
@@ -71,10 +71,10 @@ music_chunk::Expand(const AudioFormat af, size_t _length)
 {
 	const size_t frame_size = af.GetFrameSize();
 
-	assert(length + _length <= sizeof(data));
+	assert(length + _length <= capacity);
 	assert(audio_format == af);
 
 	length += _length;
 
-	return length + frame_size > sizeof(data);
+	return length + frame_size > capacity;
 }
@@ -27,10 +27,19 @@
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
+#include <assert.h>
 #include <stdint.h>
 #include <stddef.h>
 
-static constexpr size_t CHUNK_SIZE = 4096;
+/**
+ * The default payload size of a #music_chunk in bytes.  It can be
+ * changed at runtime with the "chunk_size" setting.
+ */
+static constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
+static constexpr size_t MIN_CHUNK_SIZE = 256;
+static constexpr size_t MAX_CHUNK_SIZE = 32768;
 
 struct AudioFormat;
 struct Tag;
@@ -40,8 +49,12 @@ struct Tag;
  * MusicPipe::Push() caller.
  */
 struct music_chunk {
-	/** the next chunk in a linked list */
-	struct music_chunk *next;
+	/**
+	 * The next chunk in a linked list.  This is atomic because
+	 * the #MusicPipe consumer may read it while the producer
+	 * appends a new chunk.
+	 */
+	std::atomic<music_chunk *> next;
 
 	/**
 	 * An optional chunk which should be mixed into this chunk.
@@ -61,9 +74,20 @@ struct music_chunk {
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
 
+	/** the allocated size of #data in bytes */
+	uint16_t capacity;
+
 	/** the time stamp within the song */
 	float times;
 
+	/**
+	 * The position of the end of this chunk in the stream played
+	 * by #MultipleOutputs, in microseconds.  It is assigned by
+	 * MultipleOutputs::Play(), and is used to keep outputs
+	 * synchronised.
+	 */
+	uint64_t stream_time;
+
 	/**
 	 * An optional tag associated with this chunk (and the
 	 * following chunks); appears at song boundaries.  The tag
@@ -85,18 +109,34 @@ struct music_chunk {
 	 */
 	unsigned replay_gain_serial;
 
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE];
-
 #ifndef NDEBUG
 	AudioFormat audio_format;
 #endif
 
-	music_chunk()
+	/**
+	 * The data (probably PCM).  This is a variable-size
+	 * attribute: the real size is #capacity, which is allocated
+	 * by #MusicBuffer.
+	 */
+	uint8_t data[DEFAULT_CHUNK_SIZE];
+
+	explicit music_chunk(size_t _capacity)
 		:other(nullptr),
 		 length(0),
+		 capacity(_capacity),
 		 tag(nullptr),
-		 replay_gain_serial(0) {}
+		 replay_gain_serial(0) {
+		assert(_capacity >= MIN_CHUNK_SIZE);
+		assert(_capacity <= MAX_CHUNK_SIZE);
+	}
+
+	/**
+	 * Returns the number of bytes to be allocated for a chunk with
+	 * the specified payload capacity.
+	 */
+	static constexpr size_t GetAllocationSize(size_t _capacity) {
+		return sizeof(music_chunk) - DEFAULT_CHUNK_SIZE + _capacity;
+	}
 
 	~music_chunk();
 
@@ -21,6 +21,7 @@
 #include "MusicPipe.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
+#include "thread/Util.hxx"
 
 #ifndef NDEBUG
 
@@ -29,7 +30,7 @@ MusicPipe::Contains(const music_chunk *chunk) const
 {
 	const ScopeLock protect(mutex);
 
-	for (const struct music_chunk *i = head; i != nullptr; i = i->next)
+	for (const struct music_chunk *i = Peek(); i != nullptr; i = i->next)
 		if (i == chunk)
 			return true;
 
@@ -38,40 +39,72 @@ MusicPipe::Contains(const music_chunk *chunk) const
 
 #endif
 
-music_chunk *
-MusicPipe::Shift()
+inline music_chunk *
+MusicPipe::ShiftInternal()
 {
-	const ScopeLock protect(mutex);
-
-	music_chunk *chunk = head;
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
-
-		head = chunk->next;
-		--size;
+	music_chunk *chunk = head.load(std::memory_order_acquire);
+	if (chunk == nullptr)
+		return nullptr;
 
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+	assert(!chunk->IsEmpty());
 
-			tail_r = &head;
-		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
+	music_chunk *next = chunk->next.load(std::memory_order_acquire);
+	if (next == nullptr) {
+		/* this looks like the last chunk; try to detach it
+		   from the producer's tail */
+		head.store(nullptr, std::memory_order_relaxed);
+
+		music_chunk *expected = chunk;
+		if (!tail.compare_exchange_strong(expected, nullptr,
+						  std::memory_order_acq_rel)) {
+			/* the producer has just claimed this chunk as
+			   its predecessor, but has not yet linked the
+			   new chunk; wait for it, because the chunk
+			   must not be returned to the buffer before */
+			while ((next = chunk->next.load(std::memory_order_acquire)) == nullptr)
+				YieldThread();
+
+			head.store(next, std::memory_order_release);
 		}
+	} else
+		head.store(next, std::memory_order_release);
 
+	{
 #ifndef NDEBUG
-		/* poison the "next" reference */
-		chunk->next = (music_chunk *)(void *)0x01010101;
+		const ScopeLock protect(format_mutex);
+#endif
+
+		const unsigned old_size =
+			size.fetch_sub(1, std::memory_order_relaxed);
+		assert(old_size > 0);
 
-		if (size == 0)
+#ifndef NDEBUG
+		if (old_size == 1)
 			audio_format.Clear();
+#else
+		(void)old_size;
 #endif
 	}
 
+#ifndef NDEBUG
+	/* poison the "next" reference */
+	chunk->next.store((music_chunk *)(void *)0x01010101,
+			  std::memory_order_relaxed);
+#endif
+
 	return chunk;
 }
 
+music_chunk *
+MusicPipe::Shift()
+{
+	if (lock_free)
+		return ShiftInternal();
+
+	const ScopeLock protect(mutex);
+	return ShiftInternal();
+}
+
 void
 MusicPipe::Clear(MusicBuffer &buffer)
 {
@@ -81,26 +114,48 @@ MusicPipe::Clear(MusicBuffer &buffer)
 		buffer.Return(chunk);
 }
 
-void
-MusicPipe::Push(music_chunk *chunk)
+inline void
+MusicPipe::PushInternal(music_chunk *chunk)
 {
-	assert(!chunk->IsEmpty());
-	assert(chunk->length == 0 || chunk->audio_format.IsValid());
+	chunk->next.store(nullptr, std::memory_order_relaxed);
 
-	const ScopeLock protect(mutex);
+	{
+#ifndef NDEBUG
+		const ScopeLock protect(format_mutex);
+#endif
 
-	assert(size > 0 || !audio_format.IsDefined());
-	assert(!audio_format.IsDefined() ||
-	       chunk->CheckFormat(audio_format));
+		assert(size > 0 || !audio_format.IsDefined());
+		assert(!audio_format.IsDefined() ||
+		       chunk->CheckFormat(audio_format));
 
 #ifndef NDEBUG
-	if (!audio_format.IsDefined() && chunk->length > 0)
-		audio_format = chunk->audio_format;
+		if (!audio_format.IsDefined() && chunk->length > 0)
+			audio_format = chunk->audio_format;
 #endif
 
-	chunk->next = nullptr;
-	*tail_r = chunk;
-	tail_r = &chunk->next;
+		/* count the chunk before publishing it, so the
+		   consumer never sees the size drop below zero */
+		size.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	music_chunk *prev = tail.exchange(chunk, std::memory_order_acq_rel);
+	if (prev == nullptr)
+		head.store(chunk, std::memory_order_release);
+	else
+		prev->next.store(chunk, std::memory_order_release);
+}
 
-	++size;
+void
+MusicPipe::Push(music_chunk *chunk)
+{
+	assert(!chunk->IsEmpty());
+	assert(chunk->length == 0 || chunk->audio_format.IsValid());
+
+	if (lock_free) {
+		PushInternal(chunk);
+		return;
+	}
+
+	const ScopeLock protect(mutex);
+	PushInternal(chunk);
 }
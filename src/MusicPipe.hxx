@@ -27,6 +27,8 @@
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <assert.h>
 
 struct music_chunk;
@@ -35,30 +37,64 @@ class MusicBuffer;
 /**
  * A queue of #music_chunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * The list is linked with atomic pointers, which makes it safe for
+ * exactly one producer (calling Push()) and one consumer (calling
+ * Peek(), Shift() and Clear()) without any lock.  Unless the pipe
+ * was constructed in "lock-free" mode, Push() and Shift() still
+ * serialise on a mutex.
  */
 class MusicPipe {
 	/** the first chunk */
-	music_chunk *head;
+	std::atomic<music_chunk *> head;
 
-	/** a pointer to the tail of the chunk */
-	music_chunk **tail_r;
+	/**
+	 * The last chunk, or nullptr if the pipe is empty.  Only the
+	 * producer moves this forward; the consumer resets it to
+	 * nullptr when it removes the last chunk.
+	 */
+	std::atomic<music_chunk *> tail;
 
 	/** the current number of chunks */
-	unsigned size;
+	std::atomic_uint size;
 
-	/** a mutex which protects #head and #tail_r */
+	/**
+	 * If true, then Push() and Shift() don't lock #mutex.
+	 */
+	const bool lock_free;
+
+	/**
+	 * A mutex which serialises Push() and Shift() unless
+	 * #lock_free is set.
+	 */
 	mutable Mutex mutex;
 
 #ifndef NDEBUG
+	/**
+	 * Protects #audio_format, and keeps it consistent with
+	 * #size.  Unlike #mutex, it is locked in lock-free mode,
+	 * too, so debug builds check the same code paths as release
+	 * builds.
+	 */
+	mutable Mutex format_mutex;
+
 	AudioFormat audio_format;
 #endif
 
+	music_chunk *ShiftInternal();
+	void PushInternal(music_chunk *chunk);
+
 public:
 	/**
 	 * Creates a new #MusicPipe object.  It is empty.
+	 *
+	 * @param _lock_free if true, then Push() and Shift() never
+	 * lock a mutex; this requires that there is only one producer
+	 * thread and one consumer thread
 	 */
-	MusicPipe()
-		:head(nullptr), tail_r(&head), size(0) {
+	explicit MusicPipe(bool _lock_free=false)
+		:head(nullptr), tail(nullptr), size(0),
+		 lock_free(_lock_free), mutex("music_pipe") {
 #ifndef NDEBUG
 		audio_format.Clear();
 #endif
@@ -69,7 +105,11 @@ public:
 	 */
 	~MusicPipe() {
 		assert(head == nullptr);
-		assert(tail_r == &head);
+		assert(tail == nullptr);
+	}
+
+	bool IsLockFree() const {
+		return lock_free;
 	}
 
 #ifndef NDEBUG
@@ -79,12 +119,14 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const {
+		const ScopeLock protect(format_mutex);
 		return !audio_format.IsDefined() ||
 			audio_format == other;
 	}
 
 	/**
 	 * Checks if the specified chunk is enqueued in the music pipe.
+	 * In lock-free mode, only the consumer may call this method.
 	 */
 	gcc_pure
 	bool Contains(const music_chunk *chunk) const;
@@ -96,7 +138,7 @@ public:
 	 */
 	gcc_pure
 	const music_chunk *Peek() const {
-		return head;
+		return head.load(std::memory_order_acquire);
 	}
 
 	/**
@@ -121,7 +163,7 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const {
-		return size;
+		return size.load(std::memory_order_relaxed);
 	}
 
 	gcc_pure
@@ -21,7 +21,6 @@
 #include "Partition.hxx"
 #include "DetachedSong.hxx"
 #include "output/MultipleOutputs.hxx"
-#include "mixer/Volume.hxx"
 #include "Idle.hxx"
 #include "GlobalEvents.hxx"
 
@@ -66,8 +65,7 @@ Partition::OnPlayerTagModified()
 void
 Partition::OnMixerVolumeChanged(gcc_unused Mixer &mixer, gcc_unused int volume)
 {
-	InvalidateHardwareVolume();
-
-	/* notify clients */
+	/* the mixer has already updated its cached volume; notify
+	   clients */
 	idle_add(IDLE_MIXER);
 }
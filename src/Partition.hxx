@@ -25,6 +25,9 @@
 #include "mixer/Listener.hxx"
 #include "PlayerControl.hxx"
 #include "PlayerListener.hxx"
+#include "StatusCache.hxx"
+
+#include <string>
 
 struct Instance;
 class MultipleOutputs;
@@ -35,21 +38,47 @@ class SongLoader;
  * a playlist, a player, outputs etc.
  */
 struct Partition final : private PlayerListener, private MixerListener {
+	static constexpr const char *const DEFAULT_NAME = "default";
+
 	Instance &instance;
 
+	/**
+	 * The name of this partition, as configured with the
+	 * "partition" setting of an "audio_output" block.
+	 */
+	const std::string name;
+
 	struct playlist playlist;
 
 	MultipleOutputs outputs;
 
 	PlayerControl pc;
 
+	/**
+	 * The "status" response, see handle_status().
+	 */
+	StatusCache status_cache;
+
 	Partition(Instance &_instance,
+		  const char *_name,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
-		  unsigned buffered_before_play)
-		:instance(_instance), playlist(max_length),
+		  size_t chunk_size,
+		  unsigned buffered_before_play,
+		  bool lock_free_pipe,
+		  unsigned prefetch_time)
+		:instance(_instance), name(_name), playlist(max_length),
 		 outputs(*this),
-		 pc(*this, outputs, buffer_chunks, buffered_before_play) {}
+		 pc(*this, outputs, buffer_chunks, chunk_size,
+		    buffered_before_play, lock_free_pipe, prefetch_time) {}
+
+	void BeginBatch() {
+		playlist.BeginBatch();
+	}
+
+	void CommitBatch() {
+		playlist.CommitBatch(pc);
+	}
 
 	void ClearQueue() {
 		playlist.Clear(pc);
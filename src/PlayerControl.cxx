@@ -29,14 +29,23 @@
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     unsigned _buffer_chunks,
-			     unsigned _buffered_before_play)
+			     size_t _chunk_size,
+			     unsigned _buffered_before_play,
+			     bool _lock_free_pipe,
+			     unsigned _prefetch_time)
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
+	 chunk_size(_chunk_size),
 	 buffered_before_play(_buffered_before_play),
+	 lock_free_pipe(_lock_free_pipe),
+	 prefetch_time(_prefetch_time),
+	 mutex("player"),
 	 command(PlayerCommand::NONE),
 	 state(PlayerState::STOP),
 	 error_type(PlayerError::NONE),
 	 tagged_song(nullptr),
+	 published_status(player_status{PlayerState::STOP, 0,
+				 AudioFormat::Undefined(), 0, 0}),
 	 next_song(nullptr),
 	 total_play_time(0),
 	 border_pause(false)
@@ -149,14 +158,11 @@ PlayerControl::SetBorderPause(bool _border_pause)
 	Unlock();
 }
 
-player_status
-PlayerControl::GetStatus()
+void
+PlayerControl::PublishStatus()
 {
 	player_status status;
 
-	Lock();
-	SynchronousCommand(PlayerCommand::REFRESH);
-
 	status.state = state;
 
 	if (state != PlayerState::STOP) {
@@ -164,11 +170,14 @@ PlayerControl::GetStatus()
 		status.audio_format = audio_format;
 		status.total_time = total_time;
 		status.elapsed_time = elapsed_time;
+	} else {
+		status.bit_rate = 0;
+		status.audio_format.Clear();
+		status.total_time = 0;
+		status.elapsed_time = 0;
 	}
 
-	Unlock();
-
-	return status;
+	published_status.Write(status);
 }
 
 void
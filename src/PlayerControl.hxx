@@ -24,8 +24,10 @@
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
+#include "thread/SeqLock.hxx"
 #include "util/Error.hxx"
 #include "CrossFade.hxx"
+#include "Trace.hxx"
 
 #include <stdint.h>
 
@@ -62,12 +64,6 @@ enum class PlayerCommand : uint8_t {
 	 * stop
 	 */
 	CANCEL,
-
-	/**
-	 * Refresh status information in the #PlayerControl struct,
-	 * e.g. elapsed_time.
-	 */
-	REFRESH,
 };
 
 enum class PlayerError : uint8_t {
@@ -99,8 +95,24 @@ struct PlayerControl {
 
 	unsigned buffer_chunks;
 
+	/**
+	 * The payload size of each #music_chunk in bytes.
+	 */
+	size_t chunk_size;
+
 	unsigned int buffered_before_play;
 
+	/**
+	 * Create decoder pipes in "lock-free" mode?  See
+	 * #MusicPipe::lock_free.
+	 */
+	bool lock_free_pipe;
+
+	/**
+	 * See DecoderControl::prefetch_time.
+	 */
+	unsigned prefetch_time;
+
 	/**
 	 * The handle of the player thread.
 	 */
@@ -153,6 +165,14 @@ struct PlayerControl {
 	float total_time;
 	float elapsed_time;
 
+	/**
+	 * A snapshot of the attributes above, published by the
+	 * player thread with PublishStatus().  GetStatus() reads it
+	 * without locking #mutex and without waking up the player
+	 * thread.
+	 */
+	SeqLock<player_status> published_status;
+
 	/**
 	 * The next queued song.
 	 *
@@ -179,14 +199,18 @@ struct PlayerControl {
 	PlayerControl(PlayerListener &_listener,
 		      MultipleOutputs &_outputs,
 		      unsigned buffer_chunks,
-		      unsigned buffered_before_play);
+		      size_t chunk_size,
+		      unsigned buffered_before_play,
+		      bool lock_free_pipe,
+		      unsigned prefetch_time);
 	~PlayerControl();
 
 	/**
 	 * Locks the object.
 	 */
 	void Lock() const {
-		mutex.lock();
+		if (!mutex.try_lock())
+			TraceLockContended(mutex, TraceObject::PLAYER);
 	}
 
 	/**
@@ -201,6 +225,7 @@ struct PlayerControl {
 	 * calling this function.
 	 */
 	void Signal() {
+		Trace(TraceEvent::COND_SIGNAL, TraceObject::PLAYER);
 		cond.signal();
 	}
 
@@ -233,6 +258,7 @@ struct PlayerControl {
 	void ClientSignal() {
 		assert(thread.IsInside());
 
+		Trace(TraceEvent::COND_SIGNAL, TraceObject::PLAYER);
 		client_cond.signal();
 	}
 
@@ -258,10 +284,21 @@ struct PlayerControl {
 	void CommandFinished() {
 		assert(command != PlayerCommand::NONE);
 
+		PublishStatus();
+
 		command = PlayerCommand::NONE;
 		ClientSignal();
 	}
 
+	/**
+	 * Copy #state, #bit_rate, #audio_format, #total_time and
+	 * #elapsed_time to #published_status.
+	 *
+	 * To be called from the player thread only.  Caller must
+	 * lock the object.
+	 */
+	void PublishStatus();
+
 private:
 	/**
 	 * Wait for the command to be finished by the player thread.
@@ -329,8 +366,14 @@ public:
 
 	void Kill();
 
+	/**
+	 * Returns the status most recently published by the player
+	 * thread.  This does not lock the object.
+	 */
 	gcc_pure
-	player_status GetStatus();
+	player_status GetStatus() const {
+		return published_status.Read();
+	}
 
 	PlayerState GetState() const {
 		return state;
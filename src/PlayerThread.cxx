@@ -32,8 +32,12 @@
 #include "output/MultipleOutputs.hxx"
 #include "tag/Tag.hxx"
 #include "Idle.hxx"
+#include "Metrics.hxx"
+#include "Trace.hxx"
+#include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "thread/Policy.hxx"
 #include "Log.hxx"
 
 #include <string.h>
@@ -210,6 +214,20 @@ private:
 		return dc.pipe != nullptr && !IsDecoderAtCurrentSong();
 	}
 
+	/**
+	 * Try to seek by discarding chunks from the head of the pipe,
+	 * without involving the decoder.  This works only if the
+	 * target is inside the buffered range; chunks which have
+	 * already been played are gone, so only forward seeks can be
+	 * served.
+	 *
+	 * The player lock is not held.
+	 *
+	 * @param where the target position within the file in seconds
+	 * @return true if the pipe now begins at the target position
+	 */
+	bool SeekInPipe(double where);
+
 	/**
 	 * This is the handler for the #PlayerCommand::SEEK command.
 	 *
@@ -252,6 +270,19 @@ private:
 	 */
 	bool SendSilence();
 
+	/**
+	 * Update PlayerControl::elapsed_time and publish the status
+	 * for PlayerControl::GetStatus().  Caller must lock the
+	 * mutex.
+	 */
+	void PublishStatus() {
+		pc.elapsed_time = pc.outputs.GetElapsedTime();
+		if (pc.elapsed_time < 0.0)
+			pc.elapsed_time = elapsed_time;
+
+		pc.PublishStatus();
+	}
+
 	/**
 	 * Player lock must be held before calling.
 	 */
@@ -490,6 +521,9 @@ Player::SendSilence()
 		return false;
 	}
 
+	metric_player_silence.Add();
+	TraceUnderrun(TraceObject::PLAYER);
+
 #ifndef NDEBUG
 	chunk->audio_format = play_audio_format;
 #endif
@@ -497,7 +531,7 @@ Player::SendSilence()
 	const size_t frame_size = play_audio_format.GetFrameSize();
 	/* this formula ensures that we don't send
 	   partial frames */
-	unsigned num_frames = sizeof(chunk->data) / frame_size;
+	unsigned num_frames = chunk->capacity / frame_size;
 
 	chunk->times = -1.0; /* undefined time stamp */
 	chunk->length = num_frames * frame_size;
@@ -513,13 +547,100 @@ Player::SendSilence()
 	return true;
 }
 
-inline bool
+inline /**
+ * Returns PlayerControl::seek_where, clamped to the duration of the
+ * song.
+ */
+gcc_pure
+static double
+GetSeekWhere(const PlayerControl &pc)
+{
+	double where = pc.seek_where;
+	if (where > pc.total_time)
+		where = pc.total_time - 0.1;
+	if (where < 0.0)
+		where = 0.0;
+	return where;
+}
+
+bool
+Player::SeekInPipe(double where)
+{
+	const music_chunk *first = pipe->Peek();
+	if (first == nullptr || first->times < 0.0 || where < first->times)
+		return false;
+
+	/* find the chunk which contains the target position; its
+	   successor must already be in the pipe, or we can't be sure
+	   where the chunk ends */
+	unsigned n = 0;
+	for (const music_chunk *i = first;; ++n) {
+		const music_chunk *next =
+			i->next.load(std::memory_order_acquire);
+		if (next == nullptr || next->times < 0.0)
+			return false;
+
+		if (next->times > where)
+			break;
+
+		if (i->tag != nullptr || i->other != nullptr)
+			/* don't discard a tag (or a cross-fade
+			   partner) */
+			return false;
+
+		i = next;
+	}
+
+	for (unsigned i = 0; i < n; ++i)
+		buffer.Return(pipe->Shift());
+
+	/* there is room in the buffer now */
+	pc.Lock();
+	dc.Signal();
+	pc.Unlock();
+
+	return true;
+}
+
+bool
 Player::SeekDecoder()
 {
 	assert(pc.next_song != nullptr);
 
 	const unsigned start_ms = pc.next_song->GetStartMS();
 
+	if (song != nullptr && !decoder_starting &&
+	    IsDecoderAtCurrentSong() &&
+	    pc.next_song->IsSame(*song) &&
+	    start_ms == song->GetStartMS() &&
+	    pc.next_song->GetEndMS() == song->GetEndMS()) {
+		/* seeking within the current song: if the target is
+		   already in the pipe, skip to it without a round
+		   trip to the decoder */
+		const double where = GetSeekWhere(pc);
+		if (SeekInPipe(where + start_ms / 1000.0)) {
+			delete pc.next_song;
+			pc.next_song = nullptr;
+			queued = false;
+
+			elapsed_time = where;
+
+			pc.Lock();
+			pc.elapsed_time = where;
+			pc.CommandFinished();
+			pc.Unlock();
+
+			xfade_state = CrossFadeState::UNKNOWN;
+
+			/* the pipe is still filled; only the chunks
+			   queued in the outputs must go */
+			buffering = false;
+			pc.outputs.Cancel();
+
+			return true;
+		}
+	}
+
 	if (!dc.LockIsCurrentSong(*pc.next_song)) {
 		/* the decoder is already decoding the "next" song -
 		   stop it and start the previous song again */
@@ -561,11 +682,7 @@ Player::SeekDecoder()
 
 	/* send the SEEK command */
 
-	double where = pc.seek_where;
-	if (where > pc.total_time)
-		where = pc.total_time - 0.1;
-	if (where < 0.0)
-		where = 0.0;
+	const double where = GetSeekWhere(pc);
 
 	if (!dc.Seek(where + start_ms / 1000.0)) {
 		/* decoder failure */
@@ -575,7 +692,10 @@ Player::SeekDecoder()
 
 	elapsed_time = where;
 
-	player_command_finished(pc);
+	pc.Lock();
+	pc.elapsed_time = where;
+	pc.CommandFinished();
+	pc.Unlock();
 
 	xfade_state = CrossFadeState::UNKNOWN;
 
@@ -590,6 +710,8 @@ Player::SeekDecoder()
 inline void
 Player::ProcessCommand()
 {
+	PublishStatus();
+
 	switch (pc.command) {
 	case PlayerCommand::NONE:
 	case PlayerCommand::STOP:
@@ -610,6 +732,11 @@ Player::ProcessCommand()
 		assert(!IsDecoderAtNextSong());
 
 		queued = true;
+
+		/* let the decoder open the next song before it
+		   finishes the current one */
+		dc.SetPrefetch(*pc.next_song);
+
 		pc.CommandFinished();
 		break;
 
@@ -663,22 +790,10 @@ Player::ProcessCommand()
 		delete pc.next_song;
 		pc.next_song = nullptr;
 		queued = false;
+		dc.ClearPrefetch();
 		pc.CommandFinished();
 		break;
 
-	case PlayerCommand::REFRESH:
-		if (output_open && !paused) {
-			pc.Unlock();
-			pc.outputs.Check();
-			pc.Lock();
-		}
-
-		pc.elapsed_time = pc.outputs.GetElapsedTime();
-		if (pc.elapsed_time < 0.0)
-			pc.elapsed_time = elapsed_time;
-
-		pc.CommandFinished();
-		break;
 	}
 }
 
@@ -749,6 +864,16 @@ Player::PlayNextChunk()
 		   another chunk */
 		return true;
 
+	metric_pipe_chunks.Set(pipe->GetSize());
+	metric_buffer_free_chunks.Set(buffer.GetFreeCount());
+
+	/* the decoder may already fill the next song's pipe, while
+	   this one runs out */
+	const unsigned buffered = pipe->GetSize() +
+		(IsDecoderAtNextSong() && dc.pipe != pipe
+		 ? dc.pipe->GetSize() : 0);
+	metric_pipe_low.Set(buffered < pc.buffered_before_play);
+
 	unsigned cross_fade_position;
 	struct music_chunk *chunk = nullptr;
 	if (xfade_state == CrossFadeState::ENABLED && IsDecoderAtNextSong() &&
@@ -825,6 +950,8 @@ Player::PlayNextChunk()
 
 	assert(chunk != nullptr);
 
+	Trace(TraceEvent::CHUNK_SHIFT, TraceObject::PLAYER, pipe->GetSize());
+
 	/* insert the postponed tag if cross-fading is finished */
 
 	if (xfade_state != CrossFadeState::ENABLED && cross_fade_tag != nullptr) {
@@ -907,7 +1034,7 @@ Player::SongBorder()
 inline void
 Player::Run()
 {
-	pipe = new MusicPipe();
+	pipe = new MusicPipe(pc.lock_free_pipe);
 
 	StartDecoder(*pipe);
 	if (!WaitForDecoder()) {
@@ -925,6 +1052,7 @@ Player::Run()
 	if (pc.command == PlayerCommand::SEEK)
 		elapsed_time = pc.seek_where;
 
+	pc.elapsed_time = elapsed_time;
 	pc.CommandFinished();
 
 	while (true) {
@@ -987,7 +1115,7 @@ Player::Run()
 
 			assert(dc.pipe == nullptr || dc.pipe == pipe);
 
-			StartDecoder(*new MusicPipe());
+			StartDecoder(*new MusicPipe(pc.lock_free_pipe));
 		}
 
 		if (/* no cross-fading if MPD is going to pause at the
@@ -1003,10 +1131,11 @@ Player::Run()
 				pc.cross_fade.Calculate(dc.total_time,
 							dc.replay_gain_db,
 							dc.replay_gain_prev_db,
-							dc.GetMixRampStart(),
-							dc.GetMixRampPreviousEnd(),
+							dc.GetMixRampStartCurve(),
+							dc.GetMixRampPreviousEndCurve(),
 							dc.out_audio_format,
 							play_audio_format,
+							buffer.GetChunkSize(),
 							buffer.GetSize() -
 							pc.buffered_before_play);
 			if (cross_fade_chunks > 0) {
@@ -1072,6 +1201,8 @@ Player::Run()
 
 	ClearAndDeletePipe();
 
+	metric_pipe_low.Set(0);
+
 	delete cross_fade_tag;
 
 	if (song != nullptr) {
@@ -1090,6 +1221,7 @@ Player::Run()
 	}
 
 	pc.state = PlayerState::STOP;
+	pc.PublishStatus();
 
 	pc.Unlock();
 }
@@ -1100,6 +1232,12 @@ do_play(PlayerControl &pc, DecoderControl &dc,
 {
 	Player player(pc, dc, buffer);
 	player.Run();
+
+	const MusicBuffer::Stats stats = buffer.GetStats();
+	FormatDebug(player_domain,
+		    "music buffer: %lu allocations, %lu returns, "
+		    "%lu global pool accesses",
+		    stats.allocations, stats.returns, stats.global_hits);
 }
 
 static void
@@ -1109,10 +1247,14 @@ player_task(void *arg)
 
 	SetThreadName("player");
 
-	DecoderControl dc(pc.mutex, pc.cond);
+	Error policy_error;
+	if (!ApplyThreadPolicy(ThreadClass::PLAYER, policy_error))
+		LogError(policy_error);
+
+	DecoderControl dc(pc.mutex, pc.cond, pc.prefetch_time);
 	decoder_thread_start(dc);
 
-	MusicBuffer buffer(pc.buffer_chunks);
+	MusicBuffer buffer(pc.buffer_chunks, pc.chunk_size);
 
 	pc.Lock();
 
@@ -1178,11 +1320,6 @@ player_task(void *arg)
 			pc.CommandFinished();
 			break;
 
-		case PlayerCommand::REFRESH:
-			/* no-op when not playing */
-			pc.CommandFinished();
-			break;
-
 		case PlayerCommand::NONE:
 			pc.Wait();
 			break;
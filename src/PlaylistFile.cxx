@@ -36,22 +36,168 @@
 #include "fs/Charset.hxx"
 #include "fs/FileSystem.hxx"
 #include "fs/DirectoryReader.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
 #include "util/StringUtil.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <list>
+#include <algorithm>
 
 #include <assert.h>
 #include <sys/stat.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 static const char PLAYLIST_COMMENT = '#';
 
+/**
+ * The maximum number of stored playlists kept in memory by
+ * #PlaylistFileCache.
+ */
+static constexpr size_t SPL_CACHE_SIZE = 8;
+
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
+/**
+ * An in-memory copy of a stored playlist.
+ */
+struct PlaylistCacheItem {
+	std::string name;
+
+	PlaylistFileContents contents;
+
+	/**
+	 * The modification time and size of the file after we have
+	 * last read or written it.  If the file does not match, it
+	 * was modified by somebody else, and #contents is stale.
+	 */
+	time_t mtime;
+	off_t size;
+
+	/**
+	 * Have #contents been modified, but not yet been written to
+	 * the file?
+	 */
+	bool dirty;
+
+	PlaylistCacheItem(const char *_name, PlaylistFileContents &&_contents)
+		:name(_name), contents(std::move(_contents)),
+		 mtime(0), size(-1), dirty(false) {}
+};
+
+/**
+ * Keeps recently used stored playlists in memory, so editing a large
+ * playlist doesn't need to parse the file each time.  Modifications
+ * are only applied to the memory copy; the file is rewritten after
+ * the current command (list) has finished, which folds a series of
+ * edits into a single write.
+ *
+ * It also remembers the result of the last directory scan for
+ * "listplaylists".
+ */
+class PlaylistFileCache final : DeferredMonitor {
+	/**
+	 * The most recently used item is at the front.
+	 */
+	std::list<PlaylistCacheItem> items;
+
+	PlaylistVector directory;
+
+	/**
+	 * The modification time of the playlist directory when
+	 * #directory was obtained.  Only valid if #directory_valid is
+	 * set.
+	 */
+	time_t directory_mtime;
+
+	bool directory_valid;
+
+public:
+	/**
+	 * Protects all attributes.  Must be locked by the caller of
+	 * all methods.
+	 */
+	Mutex mutex;
+
+	PlaylistFileCache(EventLoop &_loop)
+		:DeferredMonitor(_loop), directory_valid(false) {}
+
+	/**
+	 * Look up a playlist, loading it if it is not in the cache
+	 * or if the file has been modified.
+	 *
+	 * @return the item or nullptr on error
+	 */
+	PlaylistCacheItem *Get(const char *name_utf8, Error &error);
+
+	/**
+	 * Returns the playlist if it is in the cache, without
+	 * loading or validating it.
+	 */
+	gcc_pure
+	PlaylistCacheItem *Find(const char *name_utf8);
+
+	void Remove(const char *name_utf8);
+
+	void Rename(const char *from_utf8, const char *to_utf8) {
+		auto *item = Find(from_utf8);
+		if (item != nullptr)
+			item->name = to_utf8;
+	}
+
+	void SetModified(PlaylistCacheItem &item) {
+		item.dirty = true;
+		InvalidateDirectory();
+		Schedule();
+	}
+
+	/**
+	 * Write the playlist to the file if it has been modified.
+	 */
+	bool Flush(PlaylistCacheItem &item, Error &error);
+
+	void FlushAll();
+
+	/**
+	 * Remember the file's current modification time and size.
+	 */
+	void Update(PlaylistCacheItem &item, Path path_fs);
+
+	void InvalidateDirectory() {
+		directory_valid = false;
+		directory = PlaylistVector();
+	}
+
+	/**
+	 * Returns the cached directory listing or nullptr if there is
+	 * none or if the directory has been modified.
+	 *
+	 * @param mtime the current modification time of the playlist
+	 * directory
+	 */
+	const PlaylistVector *GetDirectory(time_t mtime);
+
+	void SetDirectory(time_t mtime, const PlaylistVector &list);
+
+private:
+	void Shrink();
+
+	/* virtual methods from DeferredMonitor */
+	void RunDeferred() override {
+		const ScopeLock protect(mutex);
+		FlushAll();
+	}
+};
+
+static PlaylistFileCache *spl_cache;
+
 void
-spl_global_init(void)
+spl_global_init(EventLoop &loop)
 {
 	playlist_max_length = config_get_positive(CONF_MAX_PLAYLIST_LENGTH,
 						  DEFAULT_PLAYLIST_MAX_LENGTH);
@@ -59,6 +205,22 @@ spl_global_init(void)
 	playlist_saveAbsolutePaths =
 		config_get_bool(CONF_SAVE_ABSOLUTE_PATHS,
 				DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS);
+
+	spl_cache = new PlaylistFileCache(loop);
+}
+
+void
+spl_global_finish()
+{
+	if (spl_cache == nullptr)
+		return;
+
+	spl_cache->mutex.lock();
+	spl_cache->FlushAll();
+	spl_cache->mutex.unlock();
+
+	delete spl_cache;
+	spl_cache = nullptr;
 }
 
 bool
@@ -165,6 +327,13 @@ LoadPlaylistFileInfo(PlaylistInfo &info,
 	return true;
 }
 
+static void
+CopyPlaylistVector(PlaylistVector &dest, const PlaylistVector &src)
+{
+	for (const auto &i : src)
+		dest.push_back(PlaylistInfo(i.name, i.mtime));
+}
+
 PlaylistVector
 ListPlaylistFiles(Error &error)
 {
@@ -174,6 +343,22 @@ ListPlaylistFiles(Error &error)
 	if (parent_path_fs.IsNull())
 		return list;
 
+	const ScopeLock protect(spl_cache->mutex);
+
+	/* stat the directory before reading it, so a modification
+	   while we're reading is detected by the next call */
+	struct stat st;
+	if (!StatFile(parent_path_fs, st)) {
+		error.SetErrno();
+		return list;
+	}
+
+	const auto *cached = spl_cache->GetDirectory(st.st_mtime);
+	if (cached != nullptr) {
+		CopyPlaylistVector(list, *cached);
+		return list;
+	}
+
 	DirectoryReader reader(parent_path_fs);
 	if (reader.HasFailed()) {
 		error.SetErrno();
@@ -187,22 +372,14 @@ ListPlaylistFiles(Error &error)
 			list.push_back(std::move(info));
 	}
 
+	spl_cache->SetDirectory(st.st_mtime, list);
 	return list;
 }
 
 static bool
-SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path,
+SavePlaylistFile(Path path_fs, const PlaylistFileContents &contents,
 		 Error &error)
 {
-	assert(utf8path != nullptr);
-
-	if (spl_map(error).IsNull())
-		return false;
-
-	const auto path_fs = spl_map_to_fs(utf8path, error);
-	if (path_fs.IsNull())
-		return false;
-
 	FILE *file = FOpen(path_fs, FOpenMode::WriteText);
 	if (file == nullptr) {
 		playlist_errno(error);
@@ -216,22 +393,14 @@ SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path,
 	return true;
 }
 
-PlaylistFileContents
-LoadPlaylistFile(const char *utf8path, Error &error)
+static bool
+ParsePlaylistFile(Path path_fs, PlaylistFileContents &contents,
+		  Error &error)
 {
-	PlaylistFileContents contents;
-
-	if (spl_map(error).IsNull())
-		return contents;
-
-	const auto path_fs = spl_map_to_fs(utf8path, error);
-	if (path_fs.IsNull())
-		return contents;
-
 	TextFile file(path_fs);
 	if (file.HasFailed()) {
 		playlist_errno(error);
-		return contents;
+		return false;
 	}
 
 	char *s;
@@ -268,7 +437,184 @@ LoadPlaylistFile(const char *utf8path, Error &error)
 			break;
 	}
 
-	return contents;
+	return true;
+}
+
+PlaylistCacheItem *
+PlaylistFileCache::Find(const char *name_utf8)
+{
+	for (auto &item : items)
+		if (item.name == name_utf8)
+			return &item;
+
+	return nullptr;
+}
+
+PlaylistCacheItem *
+PlaylistFileCache::Get(const char *name_utf8, Error &error)
+{
+	const auto path_fs = spl_map_to_fs(name_utf8, error);
+	if (path_fs.IsNull())
+		return nullptr;
+
+	for (auto i = items.begin(), end = items.end(); i != end; ++i) {
+		if (i->name != name_utf8)
+			continue;
+
+		/* move to the front */
+		items.splice(items.begin(), items, i);
+
+		auto &item = items.front();
+		if (item.dirty)
+			return &item;
+
+		struct stat st;
+		if (StatFile(path_fs, st) &&
+		    st.st_mtime == item.mtime && st.st_size == item.size)
+			return &item;
+
+		/* the file has been modified by somebody else */
+		items.pop_front();
+		break;
+	}
+
+	PlaylistFileContents contents;
+	if (!ParsePlaylistFile(path_fs, contents, error))
+		return nullptr;
+
+	items.emplace_front(name_utf8, std::move(contents));
+	auto &item = items.front();
+	Update(item, path_fs);
+
+	Shrink();
+	return &item;
+}
+
+void
+PlaylistFileCache::Remove(const char *name_utf8)
+{
+	for (auto i = items.begin(), end = items.end(); i != end; ++i) {
+		if (i->name == name_utf8) {
+			items.erase(i);
+			break;
+		}
+	}
+}
+
+void
+PlaylistFileCache::Update(PlaylistCacheItem &item, Path path_fs)
+{
+	struct stat st;
+	if (StatFile(path_fs, st)) {
+		item.mtime = st.st_mtime;
+		item.size = st.st_size;
+	} else {
+		item.mtime = 0;
+		item.size = -1;
+	}
+}
+
+bool
+PlaylistFileCache::Flush(PlaylistCacheItem &item, Error &error)
+{
+	if (!item.dirty)
+		return true;
+
+	const auto path_fs = spl_map_to_fs(item.name.c_str(), error);
+	if (path_fs.IsNull() ||
+	    !SavePlaylistFile(path_fs, item.contents, error))
+		return false;
+
+	item.dirty = false;
+	Update(item, path_fs);
+
+	/* the file's mtime has changed */
+	InvalidateDirectory();
+	return true;
+}
+
+void
+PlaylistFileCache::FlushAll()
+{
+	for (auto i = items.begin(), end = items.end(); i != end;) {
+		Error error;
+		if (!Flush(*i, error)) {
+			FormatError(error, "Failed to save playlist \"%s\"",
+				    i->name.c_str());
+			i = items.erase(i);
+		} else
+			++i;
+	}
+}
+
+void
+PlaylistFileCache::Shrink()
+{
+	while (items.size() > SPL_CACHE_SIZE) {
+		auto &item = items.back();
+
+		Error error;
+		if (!Flush(item, error))
+			FormatError(error, "Failed to save playlist \"%s\"",
+				    item.name.c_str());
+
+		items.pop_back();
+	}
+}
+
+const PlaylistVector *
+PlaylistFileCache::GetDirectory(time_t mtime)
+{
+	if (!directory_valid)
+		return nullptr;
+
+	if (mtime != directory_mtime) {
+		InvalidateDirectory();
+		return nullptr;
+	}
+
+	return &directory;
+}
+
+void
+PlaylistFileCache::SetDirectory(time_t mtime, const PlaylistVector &list)
+{
+	/* if the directory has been modified during the current
+	   second, another modification within the same second would
+	   not change its mtime; don't trust it */
+	if (mtime >= time(nullptr))
+		return;
+
+	directory = PlaylistVector();
+	CopyPlaylistVector(directory, list);
+	directory_mtime = mtime;
+	directory_valid = true;
+}
+
+PlaylistFileContents
+LoadPlaylistFile(const char *utf8path, Error &error)
+{
+	const ScopeLock protect(spl_cache->mutex);
+
+	const auto *item = spl_cache->Get(utf8path, error);
+	if (item == nullptr)
+		return PlaylistFileContents();
+
+	return item->contents;
+}
+
+void
+spl_flush(const char *utf8path)
+{
+	const ScopeLock protect(spl_cache->mutex);
+
+	auto *item = spl_cache->Find(utf8path);
+	if (item == nullptr)
+		return;
+
+	Error error;
+	if (!spl_cache->Flush(*item, error))
+		FormatError(error, "Failed to save playlist \"%s\"", utf8path);
 }
 
 bool
@@ -280,27 +626,29 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest,
 		   what the hell.. */
 		return true;
 
-	auto contents = LoadPlaylistFile(utf8path, error);
-	if (contents.empty() && error.IsDefined())
+	const ScopeLock protect(spl_cache->mutex);
+
+	auto *item = spl_cache->Get(utf8path, error);
+	if (item == nullptr)
 		return false;
 
+	auto &contents = item->contents;
 	if (src >= contents.size() || dest >= contents.size()) {
 		error.Set(playlist_domain, int(PlaylistResult::BAD_RANGE),
 			  "Bad range");
 		return false;
 	}
 
-	const auto src_i = std::next(contents.begin(), src);
-	auto value = std::move(*src_i);
-	contents.erase(src_i);
+	const auto begin = contents.begin();
+	if (src < dest)
+		std::rotate(begin + src, begin + src + 1, begin + dest + 1);
+	else
+		std::rotate(begin + dest, begin + src, begin + src + 1);
 
-	const auto dest_i = std::next(contents.begin(), dest);
-	contents.insert(dest_i, std::move(value));
-
-	bool result = SavePlaylistFile(contents, utf8path, error);
+	spl_cache->SetModified(*item);
 
 	idle_add(IDLE_STORED_PLAYLIST);
-	return result;
+	return true;
 }
 
 bool
@@ -313,6 +661,8 @@ spl_clear(const char *utf8path, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	const ScopeLock protect(spl_cache->mutex);
+
 	FILE *file = FOpen(path_fs, FOpenMode::WriteText);
 	if (file == nullptr) {
 		playlist_errno(error);
@@ -321,6 +671,15 @@ spl_clear(const char *utf8path, Error &error)
 
 	fclose(file);
 
+	auto *item = spl_cache->Find(utf8path);
+	if (item != nullptr) {
+		item->contents.clear();
+		item->dirty = false;
+		spl_cache->Update(*item, path_fs);
+	}
+
+	spl_cache->InvalidateDirectory();
+
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -332,11 +691,16 @@ spl_delete(const char *name_utf8, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	const ScopeLock protect(spl_cache->mutex);
+
 	if (!RemoveFile(path_fs)) {
 		playlist_errno(error);
 		return false;
 	}
 
+	spl_cache->Remove(name_utf8);
+	spl_cache->InvalidateDirectory();
+
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -344,10 +708,13 @@ spl_delete(const char *name_utf8, Error &error)
 bool
 spl_remove_index(const char *utf8path, unsigned pos, Error &error)
 {
-	auto contents = LoadPlaylistFile(utf8path, error);
-	if (contents.empty() && error.IsDefined())
+	const ScopeLock protect(spl_cache->mutex);
+
+	auto *item = spl_cache->Get(utf8path, error);
+	if (item == nullptr)
 		return false;
 
+	auto &contents = item->contents;
 	if (pos >= contents.size()) {
 		error.Set(playlist_domain, int(PlaylistResult::BAD_RANGE),
 			  "Bad range");
@@ -356,10 +723,33 @@ spl_remove_index(const char *utf8path, unsigned pos, Error &error)
 
 	contents.erase(std::next(contents.begin(), pos));
 
-	bool result = SavePlaylistFile(contents, utf8path, error);
+	spl_cache->SetModified(*item);
 
 	idle_add(IDLE_STORED_PLAYLIST);
-	return result;
+	return true;
+}
+
+/**
+ * Determine the URI which LoadPlaylistFile() would return for the
+ * line written by playlist_print_song().
+ *
+ * @return the URI or nullptr if that cannot be determined without
+ * reading the file
+ */
+gcc_pure
+static const char *
+spl_song_cache_uri(const DetachedSong &song)
+{
+	const char *uri = song.GetURI();
+	if (uri_has_scheme(uri))
+		return uri;
+
+#ifdef ENABLE_DATABASE
+	if (!playlist_saveAbsolutePaths && !PathTraitsUTF8::IsAbsolute(uri))
+		return uri;
+#endif
+
+	return nullptr;
 }
 
 bool
@@ -372,6 +762,33 @@ spl_append_song(const char *utf8path, const DetachedSong &song, Error &error)
 	if (path_fs.IsNull())
 		return false;
 
+	const char *cache_uri = spl_song_cache_uri(song);
+
+	const ScopeLock protect(spl_cache->mutex);
+
+	auto *item = spl_cache->Find(utf8path);
+	if (item != nullptr && item->dirty) {
+		if (cache_uri != nullptr) {
+			/* the file will be rewritten anyway; just
+			   append to the memory copy */
+			if (item->contents.size() >= playlist_max_length) {
+				error.Set(playlist_domain,
+					  int(PlaylistResult::TOO_LARGE),
+					  "Stored playlist is too large");
+				return false;
+			}
+
+			item->contents.emplace_back(cache_uri);
+			spl_cache->SetModified(*item);
+
+			idle_add(IDLE_STORED_PLAYLIST);
+			return true;
+		}
+
+		if (!spl_cache->Flush(*item, error))
+			return false;
+	}
+
 	FILE *file = FOpen(path_fs, FOpenMode::AppendText);
 	if (file == nullptr) {
 		playlist_errno(error);
@@ -396,6 +813,20 @@ spl_append_song(const char *utf8path, const DetachedSong &song, Error &error)
 
 	fclose(file);
 
+	if (item != nullptr) {
+		/* keep the memory copy in sync with the file, unless
+		   the file has been modified by somebody else */
+		if (cache_uri != nullptr &&
+		    st.st_mtime == item->mtime && st.st_size == item->size &&
+		    item->contents.size() < playlist_max_length) {
+			item->contents.emplace_back(cache_uri);
+			spl_cache->Update(*item, path_fs);
+		} else
+			spl_cache->Remove(utf8path);
+	}
+
+	spl_cache->InvalidateDirectory();
+
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -435,6 +866,8 @@ spl_rename_internal(Path from_path_fs, Path to_path_fs,
 		return false;
 	}
 
+	spl_cache->InvalidateDirectory();
+
 	idle_add(IDLE_STORED_PLAYLIST);
 	return true;
 }
@@ -453,5 +886,13 @@ spl_rename(const char *utf8from, const char *utf8to, Error &error)
 	if (to_path_fs.IsNull())
 		return false;
 
-	return spl_rename_internal(from_path_fs, to_path_fs, error);
+	const ScopeLock protect(spl_cache->mutex);
+
+	if (!spl_rename_internal(from_path_fs, to_path_fs, error))
+		return false;
+
+	/* pending modifications go to the new file */
+	spl_cache->Remove(utf8to);
+	spl_cache->Rename(utf8from, utf8to);
+	return true;
 }
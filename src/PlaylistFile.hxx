@@ -23,6 +23,7 @@
 #include <vector>
 #include <string>
 
+class EventLoop;
 class DetachedSong;
 class SongLoader;
 class PlaylistVector;
@@ -36,7 +37,13 @@ extern bool playlist_saveAbsolutePaths;
  * Perform some global initialization, e.g. load configuration values.
  */
 void
-spl_global_init(void);
+spl_global_init(EventLoop &loop);
+
+/**
+ * Write all pending modifications and free the playlist cache.
+ */
+void
+spl_global_finish();
 
 /**
  * Determines whether the specified string is a valid name for a
@@ -48,6 +55,10 @@ spl_valid_name(const char *name_utf8);
 /**
  * Returns a list of stored_playlist_info struct pointers.  Returns
  * nullptr if an error occurred.
+ *
+ * The result is cached until the playlist directory is modified.
+ * Modifications to a file by somebody else are only noticed after
+ * that, i.e. the "mtime" attribute may be stale.
  */
 PlaylistVector
 ListPlaylistFiles(Error &error);
@@ -55,6 +66,13 @@ ListPlaylistFiles(Error &error);
 PlaylistFileContents
 LoadPlaylistFile(const char *utf8path, Error &error);
 
+/**
+ * Write pending modifications of the specified playlist to its file.
+ * Call this before reading the file directly.  Errors are logged.
+ */
+void
+spl_flush(const char *utf8path);
+
 bool
 spl_move_index(const char *utf8path, unsigned src, unsigned dest,
 	       Error &error);
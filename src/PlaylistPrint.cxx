@@ -27,15 +27,53 @@
 #include "Instance.hxx"
 #include "db/Interface.hxx"
 #include "client/Client.hxx"
+#include "client/ResponseProducer.hxx"
 #include "input/InputStream.hxx"
 #include "DetachedSong.hxx"
 #include "fs/Traits.hxx"
 #include "util/Error.hxx"
 #include "thread/Cond.hxx"
 
+#include <vector>
+
 #define SONG_FILE "file: "
 #define SONG_TIME "Time: "
 
+/**
+ * Prints the rest of a queue range which did not fit into the
+ * client's output buffer.  The songs are remembered by their ids, so
+ * songs which are deleted meanwhile are skipped, and moved songs are
+ * printed with their new position.
+ */
+class QueueInfoProducer final : public ResponseProducer {
+	std::vector<unsigned> ids;
+
+	size_t next;
+
+public:
+	QueueInfoProducer(const Queue &queue, unsigned start, unsigned end)
+		:next(0) {
+		ids.reserve(end - start);
+		for (unsigned i = start; i < end; ++i)
+			ids.push_back(queue.PositionToId(i));
+	}
+
+	virtual bool Produce(Client &client) override {
+		const Queue &queue = client.GetPlaylist().queue;
+
+		while (next < ids.size()) {
+			const int position = queue.IdToPosition(ids[next++]);
+			if (position >= 0) {
+				queue_print_info(client, queue,
+						 position, position + 1);
+				return true;
+			}
+		}
+
+		return false;
+	}
+};
+
 void
 playlist_print_uris(Client &client, const playlist &playlist)
 {
@@ -58,7 +96,30 @@ playlist_print_info(Client &client, const playlist &playlist,
 		/* an invalid "start" offset is fatal */
 		return false;
 
-	queue_print_info(client, queue, start, end);
+	/* print directly while the output buffer has room, and let a
+	   ResponseProducer continue as the client reads */
+	for (; start < end && !client.IsOutputCongested(); ++start)
+		queue_print_info(client, queue, start, start + 1);
+
+	if (start < end)
+		client.StartResponse(new QueueInfoProducer(queue, start, end));
+
+	return true;
+}
+
+bool
+playlist_print_info(Client &client, const playlist &playlist,
+		    unsigned start, unsigned end, const SortWindow &sw)
+{
+	const Queue &queue = playlist.queue;
+
+	if (end > queue.GetLength())
+		end = queue.GetLength();
+
+	if (start > end)
+		return false;
+
+	queue_print_info(client, queue, start, end, sw);
 	return true;
 }
 
@@ -116,7 +177,7 @@ playlist_print_changes_position(Client &client,
 static bool
 PrintSongDetails(Client &client, const char *uri_utf8)
 {
-	const Database *db = client.partition.instance.database;
+	const Database *db = client.GetPartition().instance.database;
 	if (db == nullptr)
 		return false;
 
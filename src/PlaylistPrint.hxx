@@ -23,6 +23,7 @@
 #include <stdint.h>
 
 struct playlist;
+struct SortWindow;
 class SongFilter;
 class Client;
 class Error;
@@ -43,6 +44,14 @@ bool
 playlist_print_info(Client &client, const playlist &playlist,
 		    unsigned start, unsigned end);
 
+/**
+ * Like playlist_print_info(), but sort the range by a tag and send
+ * only the songs within the window.
+ */
+bool
+playlist_print_info(Client &client, const playlist &playlist,
+		    unsigned start, unsigned end, const SortWindow &sw);
+
 /**
  * Sends the song with the specified id to the client.
  *
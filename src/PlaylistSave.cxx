@@ -39,6 +39,16 @@
 void
 playlist_print_song(FILE *file, const DetachedSong &song)
 {
+#ifdef ENABLE_DATABASE
+	if (playlist_saveAbsolutePaths && song.IsInDatabase() &&
+	    !song.HasRealURI()) {
+		/* the real URI has been removed by
+		   map_song_compact() */
+		playlist_print_uri(file, song.GetURI());
+		return;
+	}
+#endif
+
 	const char *uri_utf8 = playlist_saveAbsolutePaths
 		? song.GetRealURI()
 		: song.GetURI();
@@ -86,20 +86,46 @@ SongFilter::Item::Match(const TagItem &item) const
 		StringMatch(item.value);
 }
 
+unsigned
+SongFilter::Item::GetRequiredType() const
+{
+	/* an empty value matches songs without this tag, and "album
+	   artist" falls back to "artist" */
+	return tag < TAG_NUM_OF_ITEM_TYPES && !value.empty() &&
+		tag != TAG_ALBUM_ARTIST
+		? tag
+		: unsigned(TAG_NUM_OF_ITEM_TYPES);
+}
+
 bool
 SongFilter::Item::Match(const Tag &_tag) const
 {
-	bool visited_types[TAG_NUM_OF_ITEM_TYPES];
-	std::fill_n(visited_types, size_t(TAG_NUM_OF_ITEM_TYPES), false);
+	return Match(_tag, _tag.type_mask);
+}
 
-	for (unsigned i = 0; i < _tag.num_items; i++) {
-		visited_types[_tag.items[i]->type] = true;
+bool
+SongFilter::Item::Match(const Tag &_tag, uint32_t tag_types) const
+{
+	if (tag < TAG_NUM_OF_ITEM_TYPES) {
+		if ((tag_types & (uint32_t(1) << tag)) != 0) {
+			/* compare only the items of the requested
+			   type */
+			for (unsigned i = 0; i < _tag.num_items; i++) {
+				const TagItem &item = *_tag.items[i];
+				if ((unsigned)item.type == tag &&
+				    StringMatch(item.value))
+					return true;
+			}
 
-		if (Match(*_tag.items[i]))
-			return true;
+			return false;
+		}
+	} else {
+		for (unsigned i = 0; i < _tag.num_items; i++)
+			if (Match(*_tag.items[i]))
+				return true;
 	}
 
-	if (tag < TAG_NUM_OF_ITEM_TYPES && !visited_types[tag]) {
+	if (tag < TAG_NUM_OF_ITEM_TYPES) {
 		/* If the search critieron was not visited during the
 		   sweep through the song's tag, it means this field
 		   is absent from the tag or empty. Thus, if the
@@ -109,7 +135,8 @@ SongFilter::Item::Match(const Tag &_tag) const
 		if (value.empty())
 			return true;
 
-		if (tag == TAG_ALBUM_ARTIST && visited_types[TAG_ARTIST]) {
+		if (tag == TAG_ALBUM_ARTIST &&
+		    (tag_types & (uint32_t(1) << TAG_ARTIST)) != 0) {
 			/* if we're looking for "album artist", but
 			   only "artist" exists, use that */
 			for (unsigned i = 0; i < _tag.num_items; i++) {
@@ -126,6 +153,12 @@ SongFilter::Item::Match(const Tag &_tag) const
 
 bool
 SongFilter::Item::Match(const DetachedSong &song) const
+{
+	return Match(song, song.GetTag().type_mask);
+}
+
+bool
+SongFilter::Item::Match(const DetachedSong &song, uint32_t tag_types) const
 {
 	if (tag == LOCATE_TAG_BASE_TYPE)
 		return uri_is_child_or_same(value.c_str(), song.GetURI());
@@ -133,11 +166,17 @@ SongFilter::Item::Match(const DetachedSong &song) const
 	if (tag == LOCATE_TAG_FILE_TYPE)
 		return StringMatch(song.GetURI());
 
-	return Match(song.GetTag());
+	return Match(song.GetTag(), tag_types);
 }
 
 bool
 SongFilter::Item::Match(const LightSong &song) const
+{
+	return Match(song, song.tag->type_mask);
+}
+
+bool
+SongFilter::Item::Match(const LightSong &song, uint32_t tag_types) const
 {
 	if (tag == LOCATE_TAG_BASE_TYPE) {
 		const auto uri = song.GetURI();
@@ -149,12 +188,59 @@ SongFilter::Item::Match(const LightSong &song) const
 		return StringMatch(uri.c_str());
 	}
 
-	return Match(*song.tag);
+	return Match(*song.tag, tag_types);
+}
+
+/**
+ * Estimate the cost of evaluating the item; cheap items are
+ * evaluated first, so expensive ones are skipped for most songs.
+ */
+gcc_pure
+static unsigned
+GetItemCost(const SongFilter::Item &item)
+{
+	const unsigned tag = item.GetTag();
+
+	if (tag == LOCATE_TAG_BASE_TYPE)
+		/* a string prefix comparison */
+		return 0;
+
+	/* case folding allocates memory and calls ICU */
+	unsigned cost = item.GetFoldCase() ? 4 : 0;
+
+	if (tag == LOCATE_TAG_FILE_TYPE)
+		/* the URI of a LightSong needs to be built */
+		cost += 2;
+	else if (tag == LOCATE_TAG_ANY_TYPE)
+		/* compares all tag items */
+		cost += 3;
+	else
+		cost += 1;
+
+	return cost;
+}
+
+void
+SongFilter::Add(Item &&item)
+{
+	const unsigned required = item.GetRequiredType();
+	if (required < TAG_NUM_OF_ITEM_TYPES)
+		required_types |= uint32_t(1) << required;
+
+	/* keep the vector sorted by cost; items with the same cost
+	   remain in the order they were specified */
+	const unsigned cost = GetItemCost(item);
+	auto i = items.begin();
+	while (i != items.end() && GetItemCost(*i) <= cost)
+		++i;
+
+	items.insert(i, std::move(item));
 }
 
 SongFilter::SongFilter(unsigned tag, const char *value, bool fold_case)
+	:required_types(0)
 {
-	items.push_back(Item(tag, value, fold_case));
+	Add(Item(tag, value, fold_case));
 }
 
 SongFilter::~SongFilter()
@@ -177,7 +263,7 @@ SongFilter::Parse(const char *tag_string, const char *value, bool fold_case)
 		fold_case = false;
 	}
 
-	items.push_back(Item(tag, value, fold_case));
+	Add(Item(tag, value, fold_case));
 	return true;
 }
 
@@ -197,8 +283,12 @@ SongFilter::Parse(ConstBuffer<const char *> args, bool fold_case)
 bool
 SongFilter::Match(const DetachedSong &song) const
 {
+	const uint32_t tag_types = song.GetTag().type_mask;
+	if ((tag_types & required_types) != required_types)
+		return false;
+
 	for (const auto &i : items)
-		if (!i.Match(song))
+		if (!i.Match(song, tag_types))
 			return false;
 
 	return true;
@@ -207,8 +297,12 @@ SongFilter::Match(const DetachedSong &song) const
 bool
 SongFilter::Match(const LightSong &song) const
 {
+	const uint32_t tag_types = song.tag->type_mask;
+	if ((tag_types & required_types) != required_types)
+		return false;
+
 	for (const auto &i : items)
-		if (!i.Match(song))
+		if (!i.Match(song, tag_types))
 			return false;
 
 	return true;
@@ -22,7 +22,7 @@
 
 #include "Compiler.h"
 
-#include <list>
+#include <vector>
 #include <string>
 
 #include <stdint.h>
@@ -59,6 +59,7 @@ public:
 		Item(Item &&) = default;
 
 		Item &operator=(const Item &other) = delete;
+		Item &operator=(Item &&) = default;
 
 		unsigned GetTag() const {
 			return tag;
@@ -81,22 +82,60 @@ public:
 		gcc_pure
 		bool Match(const Tag &tag) const;
 
+		/**
+		 * Like Match(const Tag &), but with a precomputed
+		 * bit mask of the tag types present in the #Tag.
+		 */
+		gcc_pure
+		bool Match(const Tag &tag, uint32_t tag_types) const;
+
 		gcc_pure
 		bool Match(const DetachedSong &song) const;
 
+		gcc_pure
+		bool Match(const DetachedSong &song,
+			   uint32_t tag_types) const;
+
 		gcc_pure
 		bool Match(const LightSong &song) const;
+
+		gcc_pure
+		bool Match(const LightSong &song, uint32_t tag_types) const;
+
+		/**
+		 * Can this item only match songs which have a tag of
+		 * this type?  Returns #TAG_NUM_OF_ITEM_TYPES if
+		 * there is no such type.
+		 */
+		gcc_pure
+		unsigned GetRequiredType() const;
 	};
 
 private:
-	std::list<Item> items;
+	/**
+	 * The conditions, ordered by the estimated cost of
+	 * evaluating them, cheapest first.
+	 */
+	std::vector<Item> items;
+
+	/**
+	 * A bit mask of tag types (bit number = #TagType) which a
+	 * song must have to match.  This is checked before any
+	 * string is compared.
+	 */
+	uint32_t required_types;
+
+	void Add(Item &&item);
 
 public:
-	SongFilter() = default;
+	SongFilter():required_types(0) {}
 
 	gcc_nonnull(3)
 	SongFilter(unsigned tag, const char *value, bool fold_case=false);
 
+	SongFilter(SongFilter &&) = default;
+	SongFilter &operator=(SongFilter &&) = default;
+
 	~SongFilter();
 
 	gcc_nonnull(2,3)
@@ -113,7 +152,7 @@ public:
 	gcc_pure
 	bool Match(const LightSong &song) const;
 
-	const std::list<Item> &GetItems() const {
+	const std::vector<Item> &GetItems() const {
 		return items;
 	}
 
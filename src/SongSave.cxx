@@ -33,6 +33,7 @@
 #include <stdlib.h>
 
 #define SONG_MTIME "mtime"
+#define SONG_IDENTITY "identity"
 #define SONG_END "song_end"
 
 static constexpr Domain song_save_domain("song_save");
@@ -56,6 +57,12 @@ song_save(FILE *fp, const Song &song)
 	tag_save(fp, song.tag);
 
 	fprintf(fp, SONG_MTIME ": %li\n", (long)song.mtime);
+
+	if (song.identity.IsDefined())
+		fprintf(fp, SONG_IDENTITY ": %u %u %llu\n",
+			song.identity.device, song.identity.inode,
+			(unsigned long long)song.identity.size);
+
 	fprintf(fp, SONG_END "\n");
 }
 
@@ -74,7 +81,7 @@ song_save(FILE *fp, const DetachedSong &song)
 
 DetachedSong *
 song_load(TextFile &file, const char *uri,
-	  Error &error)
+	  Error &error, SongIdentity *identity_r)
 {
 	DetachedSong *song = new DetachedSong(uri);
 
@@ -104,6 +111,13 @@ song_load(TextFile &file, const char *uri,
 			tag.SetHasPlaylist(strcmp(value, "yes") == 0);
 		} else if (strcmp(line, SONG_MTIME) == 0) {
 			song->SetLastModified(atoi(value));
+		} else if (identity_r != nullptr &&
+			   strcmp(line, SONG_IDENTITY) == 0) {
+			char *endptr;
+
+			identity_r->device = strtoul(value, &endptr, 10);
+			identity_r->inode = strtoul(endptr, &endptr, 10);
+			identity_r->size = strtoull(endptr, nullptr, 10);
 		} else if (strcmp(line, "Range") == 0) {
 			char *endptr;
 
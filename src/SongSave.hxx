@@ -25,6 +25,7 @@
 #define SONG_BEGIN "song_begin: "
 
 struct Song;
+struct SongIdentity;
 struct Directory;
 class DetachedSong;
 class TextFile;
@@ -41,10 +42,13 @@ song_save(FILE *fp, const DetachedSong &song);
  * "song_end" line.
  *
  * @param error location to store the error occurring
+ * @param identity_r if not nullptr, then the "identity" line of a
+ * database song is accepted and stored here; it is left unmodified
+ * if there is none
  * @return true on success, false on error
  */
 DetachedSong *
 song_load(TextFile &file, const char *uri,
-	  Error &error);
+	  Error &error, SongIdentity *identity_r=nullptr);
 
 #endif
@@ -79,7 +79,8 @@ tag_scan_fallback(Path path,
 #ifdef ENABLE_DATABASE
 
 bool
-Song::UpdateFile(Storage &storage)
+Song::ScanFile(Storage &storage, TagBuilder &tag_builder,
+	       time_t &mtime_r, SongIdentity &identity_r) const
 {
 	const auto &relative_uri = GetURI();
 
@@ -90,8 +91,6 @@ Song::UpdateFile(Storage &storage)
 	if (!info.IsRegular())
 		return false;
 
-	TagBuilder tag_builder;
-
 	const auto path_fs = storage.MapFS(relative_uri.c_str());
 	if (path_fs.IsNull()) {
 		const auto absolute_uri =
@@ -108,8 +107,23 @@ Song::UpdateFile(Storage &storage)
 					  &tag_builder);
 	}
 
-	mtime = info.mtime;
-	tag_builder.Commit(tag);
+	mtime_r = info.mtime;
+	identity_r = SongIdentity(info.size, info.device, info.inode);
+	return true;
+}
+
+bool
+Song::UpdateFile(Storage &storage)
+{
+	TagBuilder tag_builder;
+	time_t new_mtime;
+	SongIdentity new_identity;
+	if (!ScanFile(storage, tag_builder, new_mtime, new_identity))
+		return false;
+
+	mtime = new_mtime;
+	identity = new_identity;
+	CommitTag(tag_builder);
 	return true;
 }
 
@@ -135,7 +149,7 @@ Song::UpdateFileInArchive(const Storage &storage)
 	if (!tag_stream_scan(path_fs.c_str(), full_tag_handler, &tag_builder))
 		return false;
 
-	tag_builder.Commit(tag);
+	CommitTag(tag_builder);
 	return true;
 }
 
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SortWindow.hxx"
+#include "tag/Tag.hxx"
+#include "lib/icu/Collate.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+static bool
+ParseSortTag(SortWindow &sw, const char *s)
+{
+	if (sw.IsSorted())
+		return false;
+
+	const bool descending = *s == '-';
+	if (descending)
+		++s;
+
+	const TagType tag = tag_name_parse_i(s);
+	if (tag == TAG_NUM_OF_ITEM_TYPES)
+		return false;
+
+	sw.sort = tag;
+	sw.descending = descending;
+	return true;
+}
+
+/**
+ * Parse "START:END" or "START:" (open end).
+ */
+static bool
+ParseWindow(SortWindow &sw, const char *s)
+{
+	if (sw.IsWindowed())
+		return false;
+
+	char *endptr;
+	const unsigned long start = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != ':' ||
+	    start > std::numeric_limits<unsigned>::max())
+		return false;
+
+	s = endptr + 1;
+	unsigned long end = std::numeric_limits<unsigned>::max();
+	if (*s != 0) {
+		end = strtoul(s, &endptr, 10);
+		if (endptr == s || *endptr != 0 ||
+		    end > std::numeric_limits<unsigned>::max())
+			return false;
+	}
+
+	if (start > end)
+		return false;
+
+	sw.start = start;
+	sw.end = end;
+	return true;
+}
+
+bool
+SortWindow::ParseTrailing(ConstBuffer<const char *> &args)
+{
+	while (args.size >= 2) {
+		const char *name = args[args.size - 2];
+		const char *value = args[args.size - 1];
+
+		if (strcmp(name, "sort") == 0) {
+			/* "sort sticker:NAME" is handled by
+			   StickerQuery */
+			if (strchr(value, ':') != nullptr)
+				break;
+
+			if (!ParseSortTag(*this, value))
+				return false;
+		} else if (strcmp(name, "window") == 0) {
+			if (!ParseWindow(*this, value))
+				return false;
+		} else
+			break;
+
+		args.size -= 2;
+	}
+
+	return true;
+}
+
+/**
+ * Compare two tag values which should contain an integer value
+ * (e.g. disc or track number).
+ */
+static int
+CompareNumber(const char *a, const char *b)
+{
+	const long ai = strtol(a, nullptr, 10);
+	const long bi = strtol(b, nullptr, 10);
+	return ai < bi ? -1 : (ai > bi ? 1 : 0);
+}
+
+bool
+SortWindow::Less(const Tag &a, const Tag &b) const
+{
+	assert(IsSorted());
+
+	const char *va = a.GetValue(sort), *vb = b.GetValue(sort);
+	if (va == nullptr || vb == nullptr)
+		return va != nullptr && vb == nullptr;
+
+	const int cmp = sort == TAG_TRACK || sort == TAG_DISC
+		? CompareNumber(va, vb)
+		: IcuCollate(va, vb);
+	return descending ? cmp > 0 : cmp < 0;
+}
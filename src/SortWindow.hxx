@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SORT_WINDOW_HXX
+#define MPD_SORT_WINDOW_HXX
+
+#include "tag/TagType.h"
+#include "Compiler.h"
+
+#include <limits>
+
+template<typename T> struct ConstBuffer;
+struct Tag;
+
+/**
+ * The "sort" and "window" parameters of "find", "search" and
+ * "playlistinfo": sort the result by a tag, and send only a slice
+ * of it to the client.
+ */
+struct SortWindow {
+	/**
+	 * The tag to sort by, or #TAG_NUM_OF_ITEM_TYPES if the
+	 * natural order shall be kept.
+	 */
+	TagType sort = TAG_NUM_OF_ITEM_TYPES;
+
+	bool descending = false;
+
+	/**
+	 * The range of (sorted) result positions to be sent; "end"
+	 * is excluding.
+	 */
+	unsigned start = 0, end = std::numeric_limits<unsigned>::max();
+
+	bool IsSorted() const {
+		return sort != TAG_NUM_OF_ITEM_TYPES;
+	}
+
+	bool IsWindowed() const {
+		return start > 0 || end != std::numeric_limits<unsigned>::max();
+	}
+
+	bool IsDefined() const {
+		return IsSorted() || IsWindowed();
+	}
+
+	/**
+	 * Parse "sort TAG" and "window START:END" pairs at the end of
+	 * the argument list, and remove them from it.  A "-" prefix
+	 * on the tag name sorts in descending order.
+	 *
+	 * @return false on syntax error
+	 */
+	bool ParseTrailing(ConstBuffer<const char *> &args);
+
+	/**
+	 * Does song "a" come before song "b"?  Songs without the sort
+	 * tag are always last.
+	 */
+	gcc_pure
+	bool Less(const Tag &a, const Tag &b) const;
+};
+
+#endif
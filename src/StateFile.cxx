@@ -21,27 +21,108 @@
 #include "StateFile.hxx"
 #include "output/OutputState.hxx"
 #include "queue/PlaylistState.hxx"
+#include "queue/QueueBinary.hxx"
+#include "queue/QueueSave.hxx"
+#include "queue/Playlist.hxx"
 #include "fs/TextFile.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "mixer/Volume.hxx"
 #include "SongLoader.hxx"
 #include "fs/FileSystem.hxx"
+#include "util/StringUtil.hxx"
 #include "util/Domain.hxx"
+#include "util/Error.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#endif
+
+#include <algorithm>
+#include <vector>
+
 #include <string.h>
+#include <stdlib.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#define JOURNAL_GENERATION "queue_journal: "
+
+/**
+ * The journal is compacted into a new snapshot when it becomes larger
+ * than the snapshot, but not before it has reached this size.
+ */
+static constexpr size_t MIN_JOURNAL_COMPACT = 64 * 1024;
+
+/**
+ * If more songs than this have been replaced, the journal record
+ * contains all songs after the first one.
+ */
+static constexpr size_t MAX_JOURNAL_SONGS = 16;
 
 static constexpr Domain state_file_domain("state_file");
 
+static AllocatedPath
+AppendSuffix(const AllocatedPath &path, const char *suffix)
+{
+	return AllocatedPath::FromFS(std::string(path.c_str()) + suffix);
+}
+
+/**
+ * Finish writing a temporary file and move it over the specified
+ * path.  The file is closed in any case.
+ */
+static bool
+CommitFile(FILE *fp, const AllocatedPath &tmp_path, const AllocatedPath &path)
+{
+	bool success = fflush(fp) == 0 && !ferror(fp);
+#ifndef WIN32
+	success = success && fsync(fileno(fp)) == 0;
+#endif
+	success = fclose(fp) == 0 && success;
+
+	if (success && RenameFile(tmp_path, path))
+		return true;
+
+	RemoveFile(tmp_path);
+	return false;
+}
+
 StateFile::StateFile(AllocatedPath &&_path,
 		     Partition &_partition, EventLoop &_loop)
 	:TimeoutMonitor(_loop),
 	 path(std::move(_path)), path_utf8(path.ToUTF8()),
+	 queue_path(AppendSuffix(path, ".queue")),
+	 journal_path(AppendSuffix(path, ".journal")),
 	 partition(_partition),
 	 prev_volume_version(0), prev_output_version(0),
-	 prev_playlist_version(0)
+	 prev_playlist_version(0),
+	 prev_queue_version(0), prev_queue_length(0),
+	 generation(0), snapshot_db_stamp(0), snapshot_valid(false),
+	 journal(nullptr),
+	 snapshot_size(0), journal_size(0)
+{
+}
+
+StateFile::~StateFile()
 {
+	if (journal != nullptr)
+		fclose(journal);
+}
+
+time_t
+StateFile::GetDatabaseStamp() const
+{
+#ifdef ENABLE_DATABASE
+	const Database *db = partition.instance.database;
+	if (db != nullptr)
+		return db->GetUpdateStamp();
+#endif
+
+	return 0;
 }
 
 void
@@ -63,12 +144,13 @@ StateFile::IsModified() const
 }
 
 void
-StateFile::Write()
+StateFile::WriteState()
 {
 	FormatDebug(state_file_domain,
 		    "Saving state file %s", path_utf8.c_str());
 
-	FILE *fp = FOpen(path, FOpenMode::WriteText);
+	const auto tmp_path = AppendSuffix(path, ".tmp");
+	FILE *fp = FOpen(tmp_path, FOpenMode::WriteText);
 	if (gcc_unlikely(!fp)) {
 		FormatErrno(state_file_domain, "failed to create %s",
 			    path_utf8.c_str());
@@ -77,13 +159,215 @@ StateFile::Write()
 
 	save_sw_volume_state(fp);
 	audio_output_state_save(fp, partition.outputs);
-	playlist_state_save(fp, partition.playlist, partition.pc);
+	playlist_state_save(fp, partition.playlist, partition.pc,
+			    !snapshot_valid);
 
-	fclose(fp);
+	if (!CommitFile(fp, tmp_path, path))
+		FormatErrno(state_file_domain, "failed to write %s",
+			    path_utf8.c_str());
 
 	RememberVersions();
 }
 
+bool
+StateFile::WriteSnapshot()
+{
+	if (journal != nullptr) {
+		fclose(journal);
+		journal = nullptr;
+	}
+
+	const Queue &queue = partition.playlist.queue;
+	const time_t db_stamp = GetDatabaseStamp();
+
+	const auto tmp_path = AppendSuffix(queue_path, ".tmp");
+	FILE *fp = FOpen(tmp_path, FOpenMode::WriteBinary);
+	if (gcc_unlikely(!fp)) {
+		FormatErrno(state_file_domain, "failed to create %s",
+			    tmp_path.ToUTF8().c_str());
+		snapshot_valid = false;
+		return false;
+	}
+
+	queue_save_binary(fp, queue, generation + 1, db_stamp);
+	const long size = ftell(fp);
+
+	if (!CommitFile(fp, tmp_path, queue_path)) {
+		FormatErrno(state_file_domain, "failed to write %s",
+			    queue_path.ToUTF8().c_str());
+		snapshot_valid = false;
+		return false;
+	}
+
+	/* the old journal belongs to the previous generation; if
+	   removing it fails, it will be ignored */
+	RemoveFile(journal_path);
+
+	++generation;
+	snapshot_db_stamp = db_stamp;
+	snapshot_size = size > 0 ? size : 0;
+	journal_size = 0;
+	prev_queue_version = queue.version;
+	prev_queue_length = queue.GetLength();
+	snapshot_valid = true;
+	return true;
+}
+
+bool
+StateFile::AppendJournal(const std::vector<unsigned> &positions,
+			 unsigned start)
+{
+	if (journal == nullptr) {
+		journal = FOpen(journal_path, FOpenMode::AppendText);
+		if (journal == nullptr) {
+			FormatErrno(state_file_domain, "failed to open %s",
+				    journal_path.ToUTF8().c_str());
+			return false;
+		}
+
+		if (journal_size == 0)
+			fprintf(journal, JOURNAL_GENERATION "%u\n",
+				(unsigned)generation);
+	}
+
+	const Queue &queue = partition.playlist.queue;
+
+	for (unsigned position : positions)
+		queue_journal_save_song(journal, queue, position);
+
+	if (start < queue.GetLength() || start < prev_queue_length)
+		queue_journal_save_tail(journal, queue, start);
+
+	const long size = ftell(journal);
+	if (fflush(journal) != 0 || ferror(journal) || size < 0) {
+		FormatErrno(state_file_domain, "failed to write %s",
+			    journal_path.ToUTF8().c_str());
+		fclose(journal);
+		journal = nullptr;
+		return false;
+	}
+
+	journal_size = size;
+	prev_queue_version = queue.version;
+	prev_queue_length = queue.GetLength();
+	return true;
+}
+
+void
+StateFile::SaveQueue(bool compact)
+{
+	const Queue &queue = partition.playlist.queue;
+
+	const bool modified = !snapshot_valid ||
+		queue.version != prev_queue_version ||
+		queue.GetLength() != prev_queue_length;
+	if (!modified && (!compact || journal_size == 0))
+		return;
+
+	if (snapshot_valid && !compact &&
+	    GetDatabaseStamp() == snapshot_db_stamp) {
+		/* songs which have been replaced in the part which
+		   the saved queue and the current one have in common
+		   are saved individually, unless there are too many;
+		   then everything after the first one is saved */
+		const unsigned common = std::min(queue.GetLength(),
+						 prev_queue_length);
+		std::vector<unsigned> positions;
+		unsigned start = common;
+		queue.VisitChanges(prev_queue_version,
+				   [common, &positions, &start](unsigned position){
+					   if (position >= common ||
+					       start < common)
+						   return;
+
+					   if (positions.size() < MAX_JOURNAL_SONGS)
+						   positions.push_back(position);
+					   else {
+						   start = positions.front();
+						   positions.clear();
+					   }
+				   });
+
+		if (positions.empty() && start == queue.GetLength() &&
+		    start == prev_queue_length) {
+			/* only the order has changed, which is not
+			   saved */
+			prev_queue_version = queue.version;
+			return;
+		}
+
+		if (AppendJournal(positions, start) &&
+		    journal_size < std::max(snapshot_size,
+					    MIN_JOURNAL_COMPACT))
+			return;
+	}
+
+	const bool was_valid = snapshot_valid;
+	if (WriteSnapshot() != was_valid)
+		/* the queue moves between the state file and the
+		   snapshot */
+		WriteState();
+}
+
+void
+StateFile::Write()
+{
+	SaveQueue(true);
+	WriteState();
+}
+
+void
+StateFile::ReadQueue(const SongLoader &song_loader)
+{
+	Queue &queue = partition.playlist.queue;
+
+	Error error;
+	if (!queue_load_binary(queue_path, song_loader, GetDatabaseStamp(),
+			       queue, generation, error)) {
+		if (FileExists(queue_path))
+			LogError(error);
+
+		queue.Clear();
+		return;
+	}
+
+	struct stat st;
+	snapshot_size = StatFile(queue_path, st) ? st.st_size : 0;
+	snapshot_valid = true;
+
+	TextFile file(journal_path);
+	if (!file.HasFailed()) {
+		const char *line = file.ReadLine();
+		if (line != nullptr &&
+		    StringStartsWith(line, JOURNAL_GENERATION) &&
+		    strtoul(line + sizeof(JOURNAL_GENERATION) - 1,
+			    nullptr, 10) == generation) {
+			while ((line = file.ReadLine()) != nullptr)
+				if (!queue_journal_load(file, song_loader,
+							line, queue))
+					FormatError(state_file_domain,
+						    "Unrecognized line in queue journal: %s",
+						    line);
+
+			journal_size = StatFile(journal_path, st)
+				? st.st_size
+				: 0;
+		} else {
+			/* belongs to another snapshot */
+			LogWarning(state_file_domain,
+				   "Discarding obsolete queue journal");
+			RemoveFile(journal_path);
+		}
+	}
+
+	/* the database stamp may be different now; it is only used
+	   to decide whether the next modification goes to the
+	   journal */
+	snapshot_db_stamp = GetDatabaseStamp();
+
+	queue.IncrementVersion();
+}
+
 void
 StateFile::Read()
 {
@@ -105,25 +389,45 @@ StateFile::Read()
 	const SongLoader song_loader(nullptr, nullptr);
 #endif
 
+	/* the queue must be complete before the state file restores
+	   the current song */
+	ReadQueue(song_loader);
+
+	bool queue_loaded = false;
+
 	const char *line;
 	while ((line = file.ReadLine()) != NULL) {
 		success = read_sw_volume_state(line, partition.outputs) ||
 			audio_output_state_read(line, partition.outputs) ||
 			playlist_state_restore(line, file, song_loader,
 					       partition.playlist,
-					       partition.pc);
+					       partition.pc, queue_loaded);
 		if (!success)
 			FormatError(state_file_domain,
 				    "Unrecognized line in state file: %s",
 				    line);
 	}
 
+	const Queue &queue = partition.playlist.queue;
+	if (queue_loaded || !snapshot_valid) {
+		/* the queue was saved in the state file (by an older
+		   MPD version, or because the snapshot could not be
+		   written); convert it now */
+		snapshot_valid = false;
+		SaveQueue(true);
+	}
+
+	prev_queue_version = queue.version;
+	prev_queue_length = queue.GetLength();
+
 	RememberVersions();
 }
 
 void
 StateFile::CheckModified()
 {
+	SaveQueue(false);
+
 	if (!IsActive() && IsModified())
 		ScheduleSeconds(2 * 60);
 }
@@ -131,5 +435,5 @@ StateFile::CheckModified()
 void
 StateFile::OnTimeout()
 {
-	Write();
+	WriteState();
 }
@@ -25,13 +25,29 @@
 #include "Compiler.h"
 
 #include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
 
 struct Partition;
+class SongLoader;
 
+/**
+ * The state file contains the volume, the audio output states and
+ * the playback options.  The queue is saved separately: a binary
+ * snapshot (see QueueBinary.hxx), and an append-only journal of
+ * modifications since the snapshot was written, which is compacted
+ * into a new snapshot when it grows too large.  All files except
+ * the journal are replaced atomically.
+ */
 class StateFile final : private TimeoutMonitor {
 	AllocatedPath path;
 	std::string path_utf8;
 
+	AllocatedPath queue_path, journal_path;
+
 	Partition &partition;
 
 	/**
@@ -41,18 +57,89 @@ class StateFile final : private TimeoutMonitor {
 	unsigned prev_volume_version, prev_output_version,
 		prev_playlist_version;
 
+	/**
+	 * The queue version and length which have been saved in the
+	 * snapshot or in the journal.
+	 */
+	uint32_t prev_queue_version;
+	unsigned prev_queue_length;
+
+	/**
+	 * Identifies the snapshot; the journal is only valid for the
+	 * snapshot with the same generation.
+	 */
+	uint32_t generation;
+
+	/**
+	 * The database update stamp which was stored in the
+	 * snapshot.
+	 */
+	time_t snapshot_db_stamp;
+
+	/**
+	 * Do the snapshot and the journal contain the queue?  If
+	 * not, the queue is saved in the state file.
+	 */
+	bool snapshot_valid;
+
+	/**
+	 * The journal, opened for appending.  It is opened when the
+	 * first record is written.
+	 */
+	FILE *journal;
+
+	size_t snapshot_size, journal_size;
+
 public:
 	StateFile(AllocatedPath &&path, Partition &partition, EventLoop &loop);
+	~StateFile();
 
 	void Read();
+
+	/**
+	 * Write all files, and compact the journal.
+	 */
 	void Write();
 
 	/**
-	 * Schedules a write if MPD's state was modified.
+	 * Saves modifications of the queue in the journal, and
+	 * schedules a write if MPD's state was modified.
 	 */
 	void CheckModified();
 
 private:
+	void ReadQueue(const SongLoader &song_loader);
+
+	/**
+	 * Write the state file, without the queue (unless there is
+	 * no valid snapshot).
+	 */
+	void WriteState();
+
+	bool WriteSnapshot();
+	/**
+	 * Append a record to the journal.
+	 *
+	 * @param positions the positions of songs which have been
+	 * replaced
+	 * @param start all songs after this position have been
+	 * replaced
+	 */
+	bool AppendJournal(const std::vector<unsigned> &positions,
+			   unsigned start);
+
+	/**
+	 * Save queue modifications in the journal or in a new
+	 * snapshot.
+	 *
+	 * @param compact write a new snapshot even if the
+	 * modifications would fit into the journal
+	 */
+	void SaveQueue(bool compact);
+
+	gcc_pure
+	time_t GetDatabaseStamp() const;
+
 	/**
 	 * Save the current state versions for use with IsModified().
 	 */
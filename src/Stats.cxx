@@ -129,10 +129,10 @@ stats_print(Client &client)
 #else
 		      MonotonicClockS() - start_time,
 #endif
-		      (unsigned long)(client.player_control.GetTotalPlayTime() + 0.5));
+		      (unsigned long)(client.GetPlayerControl().GetTotalPlayTime() + 0.5));
 
 #ifdef ENABLE_DATABASE
-	const Database *db = client.partition.instance.database;
+	const Database *db = client.GetPartition().instance.database;
 	if (db != nullptr)
 		db_stats_print(client, *db);
 #endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STATUS_CACHE_HXX
+#define MPD_STATUS_CACHE_HXX
+
+#include "PlayerControl.hxx"
+
+#include <string>
+
+/**
+ * A pre-formatted response of the "status" command.  It is rebuilt
+ * after each idle event (see idle_get_serial()) or when it is older
+ * than a second; in between, "status" writes the cached text, and
+ * only "time" and "elapsed" are interpolated from the timestamp.
+ */
+struct StatusCache {
+	/**
+	 * Is this object filled?
+	 */
+	bool valid;
+
+	/**
+	 * The idle_get_serial() value before this snapshot was
+	 * built.
+	 */
+	unsigned serial;
+
+	/**
+	 * The MonotonicClockMS() value when this snapshot was built.
+	 */
+	unsigned timestamp_ms;
+
+	PlayerState state;
+
+	float elapsed_time, total_time;
+
+	unsigned bit_rate;
+
+	/**
+	 * The lines before "time".
+	 */
+	std::string head;
+
+	/**
+	 * The lines after "bitrate".
+	 */
+	std::string tail;
+
+	StatusCache():valid(false) {}
+
+	/**
+	 * Discard the snapshot, for changes which are not announced
+	 * with an idle event.
+	 */
+	void Invalidate() {
+		valid = false;
+	}
+};
+
+#endif
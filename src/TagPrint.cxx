@@ -30,7 +30,7 @@ void tag_print_types(Client &client)
 	int i;
 
 	for (i = 0; i < TAG_NUM_OF_ITEM_TYPES; i++) {
-		if (!ignore_tag_items[i])
+		if (!ignore_tag_items[i] && (client.tag_mask & (1u << i)))
 			client_printf(client, "tagtype: %s\n",
 				      tag_item_names[i]);
 	}
@@ -47,9 +47,15 @@ void tag_print(Client &client, const Tag &tag)
 	if (tag.time >= 0)
 		client_printf(client, SONG_TIME "%i\n", tag.time);
 
+	if (!tag.HasAnyType(client.tag_mask))
+		return;
+
 	for (unsigned i = 0; i < tag.num_items; i++) {
+		const TagItem &item = *tag.items[i];
+		if ((client.tag_mask & (1u << item.type)) == 0)
+			continue;
+
 		client_printf(client, "%s: %s\n",
-			      tag_item_names[tag.items[i]->type],
-			      tag.items[i]->value);
+			      tag_item_names[item.type], item.value);
 	}
 }
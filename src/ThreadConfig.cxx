@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ThreadConfig.hxx"
+#include "thread/Policy.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigOption.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr Domain thread_config_domain("thread_config");
+
+static bool
+ParseThreadClass(const char *name, ThreadClass &c)
+{
+	static constexpr struct {
+		const char *name;
+		ThreadClass c;
+	} names[] = {
+		{ "player", ThreadClass::PLAYER },
+		{ "decoder", ThreadClass::DECODER },
+		{ "output", ThreadClass::OUTPUT },
+		{ "encoder", ThreadClass::ENCODER },
+		{ "update", ThreadClass::UPDATE },
+		{ "io", ThreadClass::IO },
+	};
+
+	for (const auto &i : names) {
+		if (strcmp(name, i.name) == 0) {
+			c = i.c;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+ParseScheduler(const char *s, ThreadPolicy::Scheduler &scheduler)
+{
+	if (strcmp(s, "other") == 0)
+		scheduler = ThreadPolicy::Scheduler::OTHER;
+	else if (strcmp(s, "batch") == 0)
+		scheduler = ThreadPolicy::Scheduler::BATCH;
+	else if (strcmp(s, "idle") == 0)
+		scheduler = ThreadPolicy::Scheduler::IDLE;
+	else if (strcmp(s, "fifo") == 0)
+		scheduler = ThreadPolicy::Scheduler::FIFO;
+	else if (strcmp(s, "rr") == 0)
+		scheduler = ThreadPolicy::Scheduler::RR;
+	else
+		return false;
+
+	return true;
+}
+
+/**
+ * Parse a CPU list such as "0-3,6".
+ */
+static bool
+ParseCpuList(const char *s, uint64_t &mask)
+{
+	mask = 0;
+
+	while (true) {
+		char *endptr;
+		unsigned long first = strtoul(s, &endptr, 10);
+		if (endptr == s || first >= 64)
+			return false;
+
+		unsigned long last = first;
+		if (*endptr == '-') {
+			s = endptr + 1;
+			last = strtoul(s, &endptr, 10);
+			if (endptr == s || last >= 64 || last < first)
+				return false;
+		}
+
+		for (unsigned long i = first; i <= last; ++i)
+			mask |= uint64_t(1) << i;
+
+		if (*endptr == 0)
+			return true;
+
+		if (*endptr != ',')
+			return false;
+
+		s = endptr + 1;
+	}
+}
+
+/**
+ * Parse an I/O priority such as "idle", "best-effort:4" or
+ * "realtime:0".  The level defaults to 4.
+ */
+static bool
+ParseIOPriority(const char *s, ThreadPolicy &policy)
+{
+	const char *colon = strchr(s, ':');
+	const size_t length = colon != nullptr ? size_t(colon - s) : strlen(s);
+
+	if (length == 4 && memcmp(s, "idle", 4) == 0)
+		policy.io_class = ThreadPolicy::IOClass::IDLE;
+	else if (length == 11 && memcmp(s, "best-effort", 11) == 0)
+		policy.io_class = ThreadPolicy::IOClass::BEST_EFFORT;
+	else if (length == 8 && memcmp(s, "realtime", 8) == 0)
+		policy.io_class = ThreadPolicy::IOClass::REALTIME;
+	else
+		return false;
+
+	if (colon != nullptr) {
+		char *endptr;
+		unsigned long level = strtoul(colon + 1, &endptr, 10);
+		if (endptr == colon + 1 || *endptr != 0 || level > 7)
+			return false;
+
+		policy.io_level = level;
+	}
+
+	return true;
+}
+
+static bool
+ParseThreadPolicy(const config_param &param, ThreadClass &c,
+		  ThreadPolicy &policy, Error &error)
+{
+	const char *name = param.GetBlockValue("name");
+	if (name == nullptr) {
+		error.Set(thread_config_domain, "Missing \"name\"");
+		return false;
+	}
+
+	if (!ParseThreadClass(name, c)) {
+		error.Format(thread_config_domain,
+			     "Unknown thread class: %s", name);
+		return false;
+	}
+
+	const char *value = param.GetBlockValue("policy");
+	if (value != nullptr && !ParseScheduler(value, policy.scheduler)) {
+		error.Format(thread_config_domain,
+			     "Unknown scheduling policy: %s", value);
+		return false;
+	}
+
+	const unsigned priority = param.GetBlockValue("priority", 0u);
+	if (policy.scheduler == ThreadPolicy::Scheduler::FIFO ||
+	    policy.scheduler == ThreadPolicy::Scheduler::RR) {
+		if (priority < 1 || priority > 99) {
+			error.Set(thread_config_domain,
+				  "Real-time priority must be between 1 and 99");
+			return false;
+		}
+
+		policy.priority = priority;
+	}
+
+	value = param.GetBlockValue("cpus");
+	if (value != nullptr && !ParseCpuList(value, policy.cpu_mask)) {
+		error.Format(thread_config_domain,
+			     "Malformed CPU list: %s", value);
+		return false;
+	}
+
+	value = param.GetBlockValue("io_priority");
+	if (value != nullptr && !ParseIOPriority(value, policy)) {
+		error.Format(thread_config_domain,
+			     "Malformed I/O priority: %s", value);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+thread_config_global_init(Error &error)
+{
+	for (const config_param *param = config_get_param(CONF_THREAD);
+	     param != nullptr; param = param->next) {
+		ThreadClass c;
+		ThreadPolicy policy;
+		if (!ParseThreadPolicy(*param, c, policy, error)) {
+			error.FormatPrefix("Line %i: ", param->line);
+			return false;
+		}
+
+		SetThreadPolicy(c, policy);
+	}
+
+	return true;
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Trace.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "system/Clock.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Domain.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <atomic>
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+
+#if defined(HAVE_PTHREAD_SETNAME_NP) && !defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+static constexpr Domain trace_domain("trace");
+
+/**
+ * Don't write the trace file automatically more often than this.
+ */
+static constexpr uint64_t TRACE_AUTO_DUMP_INTERVAL_US = 10000000;
+
+static constexpr unsigned TRACE_MAX_THREADS = 64;
+
+TraceRecord *trace_ring;
+
+/**
+ * The number of records in #trace_ring; a power of two.
+ */
+static unsigned trace_size;
+
+/**
+ * The total number of records ever written; the next record goes to
+ * (trace_position % trace_size).
+ */
+static std::atomic<uint64_t> trace_position;
+
+static AllocatedPath trace_path = AllocatedPath::Null();
+
+static std::atomic_uint trace_n_threads;
+static char trace_thread_names[TRACE_MAX_THREADS][TRACE_THREAD_NAME_SIZE];
+
+/**
+ * The index of the current thread in #trace_thread_names plus one;
+ * 0 means not yet registered.
+ */
+static __thread uint16_t trace_thread;
+
+static std::atomic<uint64_t> trace_last_auto_dump;
+
+static uint16_t
+TraceRegisterThread()
+{
+	const unsigned i = trace_n_threads.fetch_add(1);
+	if (i >= TRACE_MAX_THREADS)
+		/* too many threads; use the "unknown" index, and
+		   don't try again */
+		return 0xffff;
+
+#if defined(HAVE_PTHREAD_SETNAME_NP) && !defined(__APPLE__)
+	pthread_getname_np(pthread_self(), trace_thread_names[i],
+			   TRACE_THREAD_NAME_SIZE);
+#else
+	snprintf(trace_thread_names[i], TRACE_THREAD_NAME_SIZE,
+		 "thread%u", i + 1);
+#endif
+
+	return i + 1;
+}
+
+void
+TraceRecordEvent(TraceEvent event, TraceObject object, uint64_t argument)
+{
+	assert(trace_ring != nullptr);
+
+	if (trace_thread == 0)
+		trace_thread = TraceRegisterThread();
+
+	const uint64_t i =
+		trace_position.fetch_add(1, std::memory_order_relaxed);
+	TraceRecord &r = trace_ring[i & (trace_size - 1)];
+	r.time = MonotonicClockUS();
+	r.argument = argument;
+	r.thread = trace_thread != 0xffff ? trace_thread : 0;
+	r.event = event;
+	r.object = object;
+	r.reserved = 0;
+}
+
+void
+TraceLockContended(Mutex &mutex, TraceObject object)
+{
+	if (trace_ring == nullptr) {
+		mutex.lock();
+		return;
+	}
+
+	const uint64_t start = MonotonicClockUS();
+	mutex.lock();
+	TraceRecordEvent(TraceEvent::MUTEX_WAIT, object,
+			 MonotonicClockUS() - start);
+}
+
+class TraceDumper final : DeferredMonitor {
+public:
+	explicit TraceDumper(EventLoop &_loop):DeferredMonitor(_loop) {}
+
+	using DeferredMonitor::Schedule;
+
+protected:
+	virtual void RunDeferred() override {
+		Error error;
+		if (!TraceDump(error))
+			LogError(error);
+	}
+};
+
+static TraceDumper *trace_dumper;
+
+void
+TraceUnderrun(TraceObject object)
+{
+	if (trace_ring == nullptr)
+		return;
+
+	TraceRecordEvent(TraceEvent::UNDERRUN, object, 0);
+
+	const uint64_t now = MonotonicClockUS();
+	uint64_t last = trace_last_auto_dump.load(std::memory_order_relaxed);
+	if (last != 0 && now - last < TRACE_AUTO_DUMP_INTERVAL_US)
+		return;
+
+	if (trace_last_auto_dump.compare_exchange_strong(last, now))
+		trace_dumper->Schedule();
+}
+
+bool
+TraceInit(EventLoop &loop, Error &error)
+{
+	assert(trace_ring == nullptr);
+
+	trace_path = config_get_path(CONF_TRACE_FILE, error);
+	if (trace_path.IsNull())
+		return !error.IsDefined();
+
+	const unsigned n = config_get_positive(CONF_TRACE_EVENTS, 65536);
+
+	/* round up to the next power of two */
+	trace_size = 1;
+	while (trace_size < n)
+		trace_size <<= 1;
+
+	trace_position.store(0);
+	trace_last_auto_dump.store(0);
+	trace_dumper = new TraceDumper(loop);
+
+	/* allocate last; this enables tracing */
+	trace_ring = new TraceRecord[trace_size];
+	return true;
+}
+
+void
+TraceFinish()
+{
+	delete[] trace_ring;
+	trace_ring = nullptr;
+
+	delete trace_dumper;
+	trace_dumper = nullptr;
+
+	trace_path = AllocatedPath::Null();
+}
+
+bool
+TraceDump(Error &error)
+{
+	if (trace_ring == nullptr) {
+		error.Set(trace_domain, "Tracing is disabled");
+		return false;
+	}
+
+	/* take a snapshot first, so writing the file does not race
+	   with the threads which are still recording; a record which
+	   is being overwritten right now may be garbled */
+	const uint64_t position = trace_position.load();
+	const uint64_t n_records = position < trace_size
+		? position
+		: trace_size;
+
+	TraceRecord *snapshot = new TraceRecord[n_records];
+	for (uint64_t i = 0; i < n_records; ++i)
+		snapshot[i] = trace_ring[(position - n_records + i)
+					 & (trace_size - 1)];
+
+	unsigned n_threads = trace_n_threads.load();
+	if (n_threads > TRACE_MAX_THREADS)
+		n_threads = TRACE_MAX_THREADS;
+
+	TraceFileHeader header;
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.n_threads = n_threads;
+	header.n_records = n_records;
+
+	FILE *file = FOpen(trace_path, FOpenMode::WriteBinary);
+	if (file == nullptr) {
+		delete[] snapshot;
+		const std::string path_utf8 = trace_path.ToUTF8();
+		error.FormatErrno("Failed to create %s", path_utf8.c_str());
+		return false;
+	}
+
+	bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(trace_thread_names, TRACE_THREAD_NAME_SIZE,
+		       n_threads, file) == n_threads &&
+		fwrite(snapshot, sizeof(*snapshot), n_records,
+		       file) == n_records;
+	delete[] snapshot;
+
+	success = fclose(file) == 0 && success;
+
+	const std::string path_utf8 = trace_path.ToUTF8();
+	if (!success) {
+		error.FormatErrno("Failed to write %s", path_utf8.c_str());
+		return false;
+	}
+
+	FormatDefault(trace_domain, "%u trace records written to %s",
+		      unsigned(n_records), path_utf8.c_str());
+	return true;
+}
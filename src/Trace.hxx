@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * A low-overhead recorder for player, decoder and output events,
+ * which helps diagnose underruns.  Events are stored in a fixed-size
+ * binary ring buffer which is written to a file on request (command
+ * "tracedump") or automatically after an underrun.  The program
+ * test/trace2json converts such a file to the Chrome trace event
+ * format.
+ */
+
+#ifndef MPD_TRACE_HXX
+#define MPD_TRACE_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stdint.h>
+
+class Error;
+class EventLoop;
+class Mutex;
+
+enum class TraceEvent : uint8_t {
+	/**
+	 * The decoder has pushed a chunk into the pipe.  Argument:
+	 * the new pipe size.
+	 */
+	CHUNK_PUSH,
+
+	/**
+	 * The player has removed a chunk from the pipe.  Argument:
+	 * the remaining pipe size.
+	 */
+	CHUNK_SHIFT,
+
+	/**
+	 * An output calls/returns from its plugin's play() method.
+	 * Argument: the number of bytes.
+	 */
+	OUTPUT_PLAY_BEGIN,
+	OUTPUT_PLAY_END,
+
+	/**
+	 * A thread had to wait for a mutex.  Argument: the wait time
+	 * in microseconds.
+	 */
+	MUTEX_WAIT,
+
+	COND_SIGNAL,
+
+	/**
+	 * An output has run out of chunks, or the player had to
+	 * insert silence.
+	 */
+	UNDERRUN,
+};
+
+/**
+ * Which object does a #TraceEvent refer to?
+ */
+enum class TraceObject : uint8_t {
+	NONE,
+	PLAYER,
+	DECODER,
+	OUTPUT,
+};
+
+/**
+ * One record in the trace ring buffer and in the trace file.
+ */
+struct TraceRecord {
+	/**
+	 * Monotonic time stamp in microseconds.
+	 */
+	uint64_t time;
+
+	uint64_t argument;
+
+	/**
+	 * An index into the thread name table; 0 is an unknown
+	 * thread.
+	 */
+	uint16_t thread;
+
+	TraceEvent event;
+	TraceObject object;
+
+	uint32_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 24, "Unexpected TraceRecord size");
+
+/*
+ * The trace file format (native byte order):
+ *
+ * - #TraceFileHeader
+ * - n_threads * TRACE_THREAD_NAME_SIZE bytes of null-terminated
+ *   thread names (for thread indices 1..n_threads)
+ * - n_records * #TraceRecord, oldest first
+ */
+
+static constexpr char TRACE_MAGIC[8] = { 'M', 'P', 'D', 'T', 'R', 'A', 'C', 'E' };
+static constexpr uint32_t TRACE_VERSION = 1;
+static constexpr unsigned TRACE_THREAD_NAME_SIZE = 16;
+
+struct TraceFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t n_threads;
+	uint64_t n_records;
+};
+
+extern TraceRecord *trace_ring;
+
+void
+TraceRecordEvent(TraceEvent event, TraceObject object, uint64_t argument);
+
+/**
+ * Record an event.  This is a no-op unless tracing is enabled.
+ */
+static inline void
+Trace(TraceEvent event, TraceObject object, uint64_t argument=0)
+{
+	if (gcc_unlikely(trace_ring != nullptr))
+		TraceRecordEvent(event, object, argument);
+}
+
+/**
+ * Lock a mutex whose try_lock() has failed, and record the time spent
+ * waiting.
+ */
+void
+TraceLockContended(Mutex &mutex, TraceObject object);
+
+/**
+ * Record an underrun and schedule writing the trace file (at most
+ * once every few seconds).  May be called from any thread.
+ */
+void
+TraceUnderrun(TraceObject object);
+
+/**
+ * Allocate the ring buffer if the "trace_file" setting is present.
+ */
+bool
+TraceInit(EventLoop &loop, Error &error);
+
+void
+TraceFinish();
+
+/**
+ * Write the ring buffer to the trace file.
+ */
+bool
+TraceDump(Error &error);
+
+#endif
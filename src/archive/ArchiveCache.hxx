@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ARCHIVE_CACHE_HXX
+#define MPD_ARCHIVE_CACHE_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileSystem.hxx"
+
+#include <list>
+#include <string>
+
+#include <sys/stat.h>
+
+/**
+ * Keeps recently used archives open, together with their parsed
+ * member index, so the update thread and the decoder threads do not
+ * parse the same archive again for each member.  An entry is
+ * discarded when the archive file's size or modification time
+ * changes.
+ *
+ * T must implement Ref() and Unref(), and its methods must be
+ * thread-safe, because the same object is handed out to several
+ * threads.
+ */
+template<typename T>
+class ArchiveCache {
+	struct Item {
+		std::string path;
+		time_t mtime;
+		off_t size;
+
+		T *file;
+
+		Item(const char *_path, const struct stat &st, T *_file)
+			:path(_path), mtime(st.st_mtime), size(st.st_size),
+			 file(_file) {}
+	};
+
+	const unsigned max_items;
+
+	Mutex mutex;
+
+	/**
+	 * The most recently used item is at the front.
+	 */
+	std::list<Item> items;
+
+public:
+	explicit ArchiveCache(unsigned _max_items)
+		:max_items(_max_items) {}
+
+	~ArchiveCache() {
+		Clear();
+	}
+
+	ArchiveCache(const ArchiveCache &) = delete;
+	ArchiveCache &operator=(const ArchiveCache &) = delete;
+
+	/**
+	 * Open an archive, or return a new reference to a cached
+	 * instance.
+	 *
+	 * @param open a function which opens the archive, returning a
+	 * new T or nullptr on error; it is called without holding the
+	 * lock
+	 */
+	template<typename F>
+	T *Open(Path path, F &&open) {
+		struct stat st;
+		if (!StatFile(path, st))
+			/* let the caller report the error */
+			return open();
+
+		mutex.lock();
+		for (auto i = items.begin(), end = items.end(); i != end; ++i) {
+			if (i->path != path.c_str())
+				continue;
+
+			if (i->mtime == st.st_mtime && i->size == st.st_size) {
+				items.splice(items.begin(), items, i);
+				T *file = i->file;
+				file->Ref();
+				mutex.unlock();
+				return file;
+			}
+
+			/* the archive was modified */
+			i->file->Unref();
+			items.erase(i);
+			break;
+		}
+		mutex.unlock();
+
+		T *file = open();
+		if (file == nullptr)
+			return nullptr;
+
+		file->Ref();
+
+		mutex.lock();
+		items.emplace_front(path.c_str(), st, file);
+		if (items.size() > max_items) {
+			items.back().file->Unref();
+			items.pop_back();
+		}
+		mutex.unlock();
+
+		return file;
+	}
+
+	/**
+	 * Release all cached references.
+	 */
+	void Clear() {
+		const ScopeLock protect(mutex);
+		for (auto &i : items)
+			i.file->Unref();
+		items.clear();
+	}
+};
+
+#endif
@@ -26,43 +26,160 @@
 #include "../ArchivePlugin.hxx"
 #include "../ArchiveFile.hxx"
 #include "../ArchiveVisitor.hxx"
+#include "../ArchiveCache.hxx"
+#include "lib/bzip2/Blocks.hxx"
 #include "input/InputStream.hxx"
 #include "input/InputPlugin.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 #include "util/RefCount.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "fs/Traits.hxx"
 #include "fs/Path.hxx"
+#include "Log.hxx"
 
-#include <bzlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
 
+#include <assert.h>
 #include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-#ifdef HAVE_OLDER_BZIP2
-#define BZ2_bzDecompressInit bzDecompressInit
-#define BZ2_bzDecompress bzDecompress
-#endif
+/**
+ * Decompress up to this number of blocks in parallel.
+ */
+static constexpr unsigned BZ2_THREADS = 4;
+
+/**
+ * Decompress this number of blocks ahead of the read position.
+ */
+static constexpr unsigned BZ2_READAHEAD = BZ2_THREADS;
 
+/**
+ * Keep at most this number of decompressed blocks (up to 900 kB
+ * each, usually) in memory.
+ */
+static constexpr unsigned BZ2_MAX_CACHED = 2 * BZ2_READAHEAD + 2;
+
+typedef std::shared_ptr<const std::vector<char>> Bzip2BlockData;
+
+/**
+ * A bzip2 file is split at its block boundaries.  The blocks are
+ * decompressed independently by a pool of worker threads and kept
+ * in a small cache, which allows parallel decompression and seeking
+ * by block.
+ */
 class Bzip2ArchiveFile final : public ArchiveFile {
-public:
+	struct Block {
+		Bzip2BlockRange range;
+
+		enum class State : uint8_t {
+			NONE,
+			QUEUED,
+			BUSY,
+			DONE,
+			FAILED,
+		} state;
+
+		bool size_known;
+
+		/**
+		 * The decompressed size.  Valid if #size_known.
+		 */
+		size_t size;
+
+		/**
+		 * The offset of the decompressed data in the file.
+		 * Valid for blocks below #known_blocks.
+		 */
+		uint64_t offset;
+
+		/**
+		 * A LRU stamp for the cache.
+		 */
+		unsigned last_used;
+
+		/**
+		 * The decompressed data.  Valid if the state is DONE.
+		 */
+		Bzip2BlockData data;
+
+		explicit Block(const Bzip2BlockRange &_range)
+			:range(_range), state(State::NONE),
+			 size_known(false), size(0), offset(0),
+			 last_used(0) {}
+	};
+
 	RefCount ref;
 
 	std::string name;
-	InputStream *const istream;
 
-	Bzip2ArchiveFile(Path path, InputStream *_is)
+	const int fd;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a block was queued, or when the workers
+	 * shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Signalled when a block has been decompressed.
+	 */
+	Cond done_cond;
+
+	/**
+	 * Has Bzip2ScanBlocks() been called?  This is deferred until
+	 * the first stream is opened, because the database update
+	 * only needs the name.
+	 */
+	bool indexed;
+
+	std::vector<Block> blocks;
+
+	/**
+	 * The sizes and offsets of all blocks below this index are
+	 * known.
+	 */
+	unsigned known_blocks;
+
+	/**
+	 * The sum of the sizes of all blocks below #known_blocks.
+	 */
+	uint64_t known_size;
+
+	std::deque<unsigned> queue;
+
+	unsigned n_cached, use_counter;
+
+	bool quit;
+
+	Thread threads[BZ2_THREADS];
+	unsigned n_threads;
+
+public:
+	Bzip2ArchiveFile(Path path, int _fd)
 		:ArchiveFile(bz2_archive_plugin),
 		 name(PathTraitsFS::GetBase(path.c_str())),
-		 istream(_is) {
+		 fd(_fd),
+		 indexed(false), known_blocks(0), known_size(0),
+		 n_cached(0), use_counter(0), quit(false), n_threads(0) {
 		// remove .bz2 suffix
 		const size_t len = name.length();
 		if (len > 4)
 			name.erase(len - 4);
 	}
 
-	~Bzip2ArchiveFile() {
-		delete istream;
-	}
+	~Bzip2ArchiveFile();
 
 	void Ref() {
 		ref.Increment();
@@ -75,6 +192,44 @@ public:
 		delete this;
 	}
 
+	/**
+	 * Locate the blocks and start the worker threads, unless
+	 * that has been done already.
+	 */
+	bool Index(Error &error);
+
+	unsigned GetBlockCount() const {
+		return blocks.size();
+	}
+
+	/**
+	 * Returns the decompressed size of the file, or -1 if it is
+	 * not yet known.
+	 */
+	int64_t GetSize() {
+		const ScopeLock protect(mutex);
+		return known_blocks == blocks.size()
+			? int64_t(known_size)
+			: -1;
+	}
+
+	/**
+	 * Obtain the decompressed data of a block, and schedule the
+	 * following blocks for decompression.
+	 */
+	Bzip2BlockData GetBlock(unsigned i, Error &error);
+
+	/**
+	 * Find the block which contains the given offset of the
+	 * decompressed data.  Blocks are decompressed as needed.
+	 *
+	 * @param index_r the block index, or GetBlockCount() at
+	 * the end of the file
+	 * @param skip_r the position within the block
+	 */
+	bool Locate(uint64_t offset, unsigned &index_r, size_t &skip_r,
+		    Error &error);
+
 	virtual void Close() override {
 		Unref();
 	}
@@ -84,20 +239,40 @@ public:
 	}
 
 	virtual InputStream *OpenStream(const char *path,
-					Mutex &mutex, Cond &cond,
+					Mutex &_mutex, Cond &_cond,
 					Error &error) override;
-};
 
-struct Bzip2InputStream final : public InputStream {
-	Bzip2ArchiveFile *archive;
+private:
+	void Request(unsigned i, bool urgent);
+
+	/**
+	 * Decompress a block which has been removed from the queue.
+	 * The caller must hold the mutex; it is released while
+	 * decompressing.
+	 */
+	void RunJob(unsigned i);
 
-	bool eof;
+	void UpdateKnown();
+	void Evict();
 
-	bz_stream bzstream;
+	void WorkerRun();
+	static void WorkerFunc(void *ctx);
+};
+
+class Bzip2InputStream final : public InputStream {
+	Bzip2ArchiveFile &archive;
+
+	unsigned block_index;
+	size_t block_position;
 
-	char buffer[5000];
+	/**
+	 * The current block, or nullptr if it has not been obtained
+	 * yet.
+	 */
+	Bzip2BlockData block;
 
-	Bzip2InputStream(Bzip2ArchiveFile &context, const char *uri,
+public:
+	Bzip2InputStream(Bzip2ArchiveFile &_archive, const char *uri,
 			 Mutex &mutex, Cond &cond);
 	~Bzip2InputStream();
 
@@ -106,71 +281,335 @@ struct Bzip2InputStream final : public InputStream {
 	/* virtual methods from InputStream */
 	bool IsEOF() override;
 	size_t Read(void *ptr, size_t size, Error &error) override;
+	bool Seek(offset_type offset, Error &error) override;
 };
 
 static constexpr Domain bz2_domain("bz2");
 
-/* single archive handling allocation helpers */
+/**
+ * Keep this number of bzip2 files open.
+ */
+static ArchiveCache<Bzip2ArchiveFile> bz2_cache(4);
+
+Bzip2ArchiveFile::~Bzip2ArchiveFile()
+{
+	mutex.lock();
+	quit = true;
+	work_cond.broadcast();
+	mutex.unlock();
 
-inline bool
-Bzip2InputStream::Open(Error &error)
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Join();
+
+	close(fd);
+}
+
+bool
+Bzip2ArchiveFile::Index(Error &error)
 {
-	bzstream.bzalloc = nullptr;
-	bzstream.bzfree = nullptr;
-	bzstream.opaque = nullptr;
+	const ScopeLock protect(mutex);
 
-	bzstream.next_in = (char *)buffer;
-	bzstream.avail_in = 0;
+	if (indexed)
+		return true;
 
-	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
-	if (ret != BZ_OK) {
-		error.Set(bz2_domain, ret,
-			  "BZ2_bzDecompressInit() has failed");
+	std::vector<Bzip2BlockRange> ranges;
+	if (!Bzip2ScanBlocks(fd, ranges, error))
 		return false;
+
+	blocks.reserve(ranges.size());
+	for (const auto &range : ranges)
+		blocks.emplace_back(range);
+
+	indexed = true;
+
+	while (n_threads < BZ2_THREADS) {
+		Error thread_error;
+		if (!threads[n_threads].Start(WorkerFunc, this,
+					      thread_error)) {
+			/* continue with the threads we have; without
+			   any, GetBlock() decompresses by itself */
+			LogError(thread_error);
+			break;
+		}
+
+		++n_threads;
 	}
 
-	SetReady();
 	return true;
 }
 
+void
+Bzip2ArchiveFile::Request(unsigned i, bool urgent)
+{
+	Block &b = blocks[i];
+	if (b.state != Block::State::NONE)
+		return;
+
+	b.state = Block::State::QUEUED;
+	if (urgent)
+		queue.push_front(i);
+	else
+		queue.push_back(i);
+
+	work_cond.signal();
+}
+
+void
+Bzip2ArchiveFile::UpdateKnown()
+{
+	while (known_blocks < blocks.size() &&
+	       blocks[known_blocks].size_known) {
+		Block &b = blocks[known_blocks++];
+		b.offset = known_size;
+		known_size += b.size;
+	}
+}
+
+void
+Bzip2ArchiveFile::Evict()
+{
+	while (n_cached > BZ2_MAX_CACHED) {
+		Block *oldest = nullptr;
+		for (auto &b : blocks)
+			if (b.state == Block::State::DONE &&
+			    (oldest == nullptr ||
+			     b.last_used < oldest->last_used))
+				oldest = &b;
+
+		assert(oldest != nullptr);
+
+		/* streams which still use the data hold their own
+		   reference */
+		oldest->data.reset();
+		oldest->state = Block::State::NONE;
+		--n_cached;
+	}
+}
+
+void
+Bzip2ArchiveFile::RunJob(unsigned i)
+{
+	blocks[i].state = Block::State::BUSY;
+	const Bzip2BlockRange range = blocks[i].range;
+
+	mutex.unlock();
+
+	auto data = std::make_shared<std::vector<char>>();
+	Error error;
+	bool success = Bzip2DecompressBlock(fd, range, *data, error);
+	if (!success)
+		LogError(error);
+
+	mutex.lock();
+
+	Block &b = blocks[i];
+	if (success) {
+		b.size = data->size();
+		b.size_known = true;
+		b.data = std::move(data);
+		b.state = Block::State::DONE;
+		b.last_used = ++use_counter;
+		++n_cached;
+
+		UpdateKnown();
+		Evict();
+	} else
+		b.state = Block::State::FAILED;
+
+	done_cond.broadcast();
+}
+
+Bzip2BlockData
+Bzip2ArchiveFile::GetBlock(unsigned i, Error &error)
+{
+	assert(indexed);
+	assert(i < blocks.size());
+
+	const ScopeLock protect(mutex);
+
+	/* drop stale read-ahead requests, e.g. after seeking */
+	for (unsigned q : queue)
+		blocks[q].state = Block::State::NONE;
+	queue.clear();
+
+	Request(i, true);
+
+	const unsigned end = std::min<unsigned>(i + 1 + BZ2_READAHEAD,
+						blocks.size());
+	for (unsigned j = i + 1; j < end; ++j)
+		Request(j, false);
+
+	while (true) {
+		Block &b = blocks[i];
+
+		switch (b.state) {
+		case Block::State::NONE:
+			/* evicted meanwhile */
+			Request(i, true);
+			break;
+
+		case Block::State::QUEUED:
+			if (n_threads == 0) {
+				queue.erase(std::find(queue.begin(),
+						      queue.end(), i));
+				RunJob(i);
+				continue;
+			}
+
+			done_cond.wait(mutex);
+			break;
+
+		case Block::State::BUSY:
+			done_cond.wait(mutex);
+			break;
+
+		case Block::State::DONE:
+			b.last_used = ++use_counter;
+			return b.data;
+
+		case Block::State::FAILED:
+			error.Format(bz2_domain,
+				     "Failed to decompress block %u", i);
+			return nullptr;
+		}
+	}
+}
+
+bool
+Bzip2ArchiveFile::Locate(uint64_t offset, unsigned &index_r, size_t &skip_r,
+			 Error &error)
+{
+	while (true) {
+		mutex.lock();
+
+		if (offset < known_size) {
+			/* binary search in the blocks whose offsets
+			   are known */
+			const auto end = blocks.begin() + known_blocks;
+			auto i = std::upper_bound(blocks.begin(), end, offset,
+						  [](uint64_t o, const Block &b){
+							  return o < b.offset;
+						  });
+			assert(i != blocks.begin());
+			--i;
+
+			index_r = i - blocks.begin();
+			skip_r = offset - i->offset;
+			mutex.unlock();
+			return true;
+		}
+
+		if (known_blocks == blocks.size()) {
+			mutex.unlock();
+
+			if (offset > known_size) {
+				error.Set(bz2_domain, "Seek beyond end of file");
+				return false;
+			}
+
+			index_r = blocks.size();
+			skip_r = 0;
+			return true;
+		}
+
+		const unsigned next = known_blocks;
+		mutex.unlock();
+
+		/* decompress the next block whose size is not yet
+		   known; the read-ahead runs in parallel */
+		if (GetBlock(next, error) == nullptr)
+			return false;
+	}
+}
+
+void
+Bzip2ArchiveFile::WorkerRun()
+{
+	SetThreadName("bzip2");
+
+	mutex.lock();
+
+	while (!quit) {
+		if (queue.empty()) {
+			work_cond.wait(mutex);
+			continue;
+		}
+
+		const unsigned i = queue.front();
+		queue.pop_front();
+
+		RunJob(i);
+	}
+
+	mutex.unlock();
+}
+
+void
+Bzip2ArchiveFile::WorkerFunc(void *ctx)
+{
+	((Bzip2ArchiveFile *)ctx)->WorkerRun();
+}
+
 /* archive open && listing routine */
 
+static void
+bz2_finish()
+{
+	bz2_cache.Clear();
+}
+
 static ArchiveFile *
 bz2_open(Path pathname, Error &error)
 {
-	static Mutex mutex;
-	static Cond cond;
-	InputStream *is = InputStream::OpenReady(pathname.c_str(), mutex, cond,
-						 error);
-	if (is == nullptr)
-		return nullptr;
-
-	return new Bzip2ArchiveFile(pathname, is);
+	return bz2_cache.Open(pathname, [pathname, &error]() -> Bzip2ArchiveFile * {
+			int fd = open(pathname.c_str(), O_RDONLY|O_CLOEXEC);
+			if (fd < 0) {
+				error.FormatErrno("Failed to open %s",
+						  pathname.c_str());
+				return nullptr;
+			}
+
+			return new Bzip2ArchiveFile(pathname, fd);
+		});
 }
 
 /* single archive handling */
 
-Bzip2InputStream::Bzip2InputStream(Bzip2ArchiveFile &_context,
+Bzip2InputStream::Bzip2InputStream(Bzip2ArchiveFile &_archive,
 				   const char *_uri,
 				   Mutex &_mutex, Cond &_cond)
 	:InputStream(_uri, _mutex, _cond),
-	 archive(&_context), eof(false)
+	 archive(_archive), block_index(0), block_position(0)
 {
-	archive->Ref();
+	archive.Ref();
 }
 
 Bzip2InputStream::~Bzip2InputStream()
 {
-	BZ2_bzDecompressEnd(&bzstream);
-	archive->Unref();
+	block.reset();
+	archive.Unref();
+}
+
+inline bool
+Bzip2InputStream::Open(Error &error)
+{
+	if (!archive.Index(error))
+		return false;
+
+	seekable = true;
+	size = archive.GetSize();
+
+	SetReady();
+	return true;
 }
 
 InputStream *
 Bzip2ArchiveFile::OpenStream(const char *path,
-			     Mutex &mutex, Cond &cond,
+			     Mutex &_mutex, Cond &_cond,
 			     Error &error)
 {
-	Bzip2InputStream *bis = new Bzip2InputStream(*this, path, mutex, cond);
+	Bzip2InputStream *bis = new Bzip2InputStream(*this, path,
+						     _mutex, _cond);
 	if (!bis->Open(error)) {
 		delete bis;
 		return nullptr;
@@ -179,67 +618,60 @@ Bzip2ArchiveFile::OpenStream(const char *path,
 	return bis;
 }
 
-static bool
-bz2_fillbuffer(Bzip2InputStream *bis, Error &error)
-{
-	size_t count;
-	bz_stream *bzstream;
-
-	bzstream = &bis->bzstream;
-
-	if (bzstream->avail_in > 0)
-		return true;
-
-	count = bis->archive->istream->Read(bis->buffer, sizeof(bis->buffer),
-					    error);
-	if (count == 0)
-		return false;
-
-	bzstream->next_in = bis->buffer;
-	bzstream->avail_in = count;
-	return true;
-}
-
 size_t
 Bzip2InputStream::Read(void *ptr, size_t length, Error &error)
 {
-	int bz_result;
-	size_t nbytes = 0;
-
-	if (eof)
-		return 0;
-
-	bzstream.next_out = (char *)ptr;
-	bzstream.avail_out = length;
-
-	do {
-		if (!bz2_fillbuffer(this, error))
-			return 0;
-
-		bz_result = BZ2_bzDecompress(&bzstream);
-
-		if (bz_result == BZ_STREAM_END) {
-			eof = true;
-			break;
+	while (block_index < archive.GetBlockCount()) {
+		if (block == nullptr) {
+			block = archive.GetBlock(block_index, error);
+			if (block == nullptr)
+				return 0;
 		}
 
-		if (bz_result != BZ_OK) {
-			error.Set(bz2_domain, bz_result,
-				  "BZ2_bzDecompress() has failed");
-			return 0;
+		if (block_position < block->size()) {
+			const size_t nbytes =
+				std::min(length, block->size() - block_position);
+			memcpy(ptr, block->data() + block_position, nbytes);
+			block_position += nbytes;
+			offset += nbytes;
+			return nbytes;
 		}
-	} while (bzstream.avail_out == length);
 
-	nbytes = length - bzstream.avail_out;
-	offset += nbytes;
+		++block_index;
+		block_position = 0;
+		block.reset();
+
+		if (size < 0)
+			size = archive.GetSize();
+	}
 
-	return nbytes;
+	return 0;
 }
 
 bool
 Bzip2InputStream::IsEOF()
 {
-	return eof;
+	const unsigned n = archive.GetBlockCount();
+	return block_index >= n ||
+		(block_index + 1 == n && block != nullptr &&
+		 block_position >= block->size());
+}
+
+bool
+Bzip2InputStream::Seek(offset_type new_offset, Error &error)
+{
+	unsigned index;
+	size_t skip;
+	if (!archive.Locate(new_offset, index, skip, error))
+		return false;
+
+	if (index != block_index)
+		block.reset();
+
+	block_index = index;
+	block_position = skip;
+	offset = new_offset;
+	return true;
 }
 
 /* exported structures */
@@ -252,8 +684,7 @@ static const char *const bz2_extensions[] = {
 const ArchivePlugin bz2_archive_plugin = {
 	"bz2",
 	nullptr,
-	nullptr,
+	bz2_finish,
 	bz2_open,
 	bz2_extensions,
 };
-
@@ -26,28 +26,60 @@
 #include "../ArchivePlugin.hxx"
 #include "../ArchiveFile.hxx"
 #include "../ArchiveVisitor.hxx"
+#include "../ArchiveCache.hxx"
 #include "input/InputStream.hxx"
 #include "input/InputPlugin.hxx"
 #include "fs/Path.hxx"
+#include "thread/Mutex.hxx"
 #include "util/RefCount.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
 #include <cdio/iso9660.h>
 
+#include <string>
+#include <vector>
+#include <map>
+
 #include <stdlib.h>
 #include <string.h>
 
 #define CEILING(x, y) ((x+(y-1))/y)
 
 class Iso9660ArchiveFile final : public ArchiveFile {
+public:
+	struct Member {
+		lsn_t lsn;
+		uint32_t size;
+	};
+
+private:
 	RefCount ref;
 
+	/**
+	 * Protects #iso, which is shared by all streams.
+	 */
+	mutable Mutex mutex;
+
 	iso9660_t *iso;
 
+	/**
+	 * All regular files in the image, keyed by their path
+	 * (without the leading slash).  The directory tree is read
+	 * only once, when the image is opened.
+	 */
+	std::map<std::string, Member> members;
+
+	/**
+	 * The keys of #members in the order of the directory tree.
+	 */
+	std::vector<const std::string *> order;
+
 public:
 	Iso9660ArchiveFile(iso9660_t *_iso)
-		:ArchiveFile(iso9660_archive_plugin), iso(_iso) {}
+		:ArchiveFile(iso9660_archive_plugin), iso(_iso) {
+		LoadIndex("/");
+	}
 
 	~Iso9660ArchiveFile() {
 		iso9660_close(iso);
@@ -63,10 +95,14 @@ public:
 	}
 
 	long SeekRead(void *ptr, lsn_t start, long int i_size) const {
+		const ScopeLock protect(mutex);
 		return iso9660_iso_seek_read(iso, ptr, start, i_size);
 	}
 
-	void Visit(const char *path, ArchiveVisitor &visitor);
+	/**
+	 * Find a file in the image.
+	 */
+	bool Find(const char *path, Member &member_r) const;
 
 	virtual void Close() override {
 		Unref();
@@ -77,14 +113,22 @@ public:
 	virtual InputStream *OpenStream(const char *path,
 					Mutex &mutex, Cond &cond,
 					Error &error) override;
+
+private:
+	void LoadIndex(const char *path);
 };
 
 static constexpr Domain iso9660_domain("iso9660");
 
 /* archive open && listing routine */
 
-inline void
-Iso9660ArchiveFile::Visit(const char *psz_path, ArchiveVisitor &visitor)
+/**
+ * Keep this number of ISO images open.
+ */
+static ArchiveCache<Iso9660ArchiveFile> iso9660_cache(4);
+
+void
+Iso9660ArchiveFile::LoadIndex(const char *psz_path)
 {
 	CdioList_t *entlist;
 	CdioListNode_t *entnode;
@@ -105,35 +149,68 @@ Iso9660ArchiveFile::Visit(const char *psz_path, ArchiveVisitor &visitor)
 		if (iso9660_stat_s::_STAT_DIR == statbuf->type ) {
 			if (strcmp(statbuf->filename, ".") && strcmp(statbuf->filename, "..")) {
 				strcat(pathname, "/");
-				Visit(pathname, visitor);
+				LoadIndex(pathname);
 			}
 		} else {
 			//remove leading /
-			visitor.VisitArchiveEntry(pathname + 1);
+			auto i = members.insert(std::make_pair(std::string(pathname + 1),
+							       Member{statbuf->lsn,
+								      statbuf->size}));
+			if (i.second)
+				order.push_back(&i.first->first);
 		}
 	}
 	_cdio_list_free (entlist, true);
 }
 
+static void
+iso9660_archive_finish()
+{
+	iso9660_cache.Clear();
+}
+
 static ArchiveFile *
 iso9660_archive_open(Path pathname, Error &error)
 {
-	/* open archive */
-	auto iso = iso9660_open(pathname.c_str());
-	if (iso == nullptr) {
-		error.Format(iso9660_domain,
-			     "Failed to open ISO9660 file %s",
-			     pathname.c_str());
-		return nullptr;
-	}
+	return iso9660_cache.Open(pathname, [pathname, &error]() -> Iso9660ArchiveFile * {
+			/* open archive */
+			auto iso = iso9660_open(pathname.c_str());
+			if (iso == nullptr) {
+				error.Format(iso9660_domain,
+					     "Failed to open ISO9660 file %s",
+					     pathname.c_str());
+				return nullptr;
+			}
 
-	return new Iso9660ArchiveFile(iso);
+			return new Iso9660ArchiveFile(iso);
+		});
 }
 
 void
 Iso9660ArchiveFile::Visit(ArchiveVisitor &visitor)
 {
-	Visit("/", visitor);
+	for (const auto *name : order)
+		visitor.VisitArchiveEntry(name->c_str());
+}
+
+bool
+Iso9660ArchiveFile::Find(const char *path, Member &member_r) const
+{
+	auto i = members.find(path);
+	if (i != members.end()) {
+		member_r = i->second;
+		return true;
+	}
+
+	/* not in the index; let libiso9660 translate the name */
+	const ScopeLock protect(mutex);
+	auto statbuf = iso9660_ifs_stat_translate(iso, path);
+	if (statbuf == nullptr)
+		return false;
+
+	member_r = Member{statbuf->lsn, statbuf->size};
+	free(statbuf);
+	return true;
 }
 
 /* single archive handling */
@@ -141,22 +218,21 @@ Iso9660ArchiveFile::Visit(ArchiveVisitor &visitor)
 class Iso9660InputStream final : public InputStream {
 	Iso9660ArchiveFile &archive;
 
-	iso9660_stat_t *statbuf;
+	const Iso9660ArchiveFile::Member member;
 
 public:
 	Iso9660InputStream(Iso9660ArchiveFile &_archive, const char *_uri,
 			   Mutex &_mutex, Cond &_cond,
-			   iso9660_stat_t *_statbuf)
+			   const Iso9660ArchiveFile::Member &_member)
 		:InputStream(_uri, _mutex, _cond),
-		 archive(_archive), statbuf(_statbuf) {
-		size = statbuf->size;
+		 archive(_archive), member(_member) {
+		size = member.size;
 		SetReady();
 
 		archive.Ref();
 	}
 
 	~Iso9660InputStream() {
-		free(statbuf);
 		archive.Unref();
 	}
 
@@ -170,15 +246,15 @@ Iso9660ArchiveFile::OpenStream(const char *pathname,
 			       Mutex &mutex, Cond &cond,
 			       Error &error)
 {
-	auto statbuf = iso9660_ifs_stat_translate(iso, pathname);
-	if (statbuf == nullptr) {
+	Member member;
+	if (!Find(pathname, member)) {
 		error.Format(iso9660_domain,
 			     "not found in the ISO file: %s", pathname);
 		return nullptr;
 	}
 
 	return new Iso9660InputStream(*this, pathname, mutex, cond,
-				      statbuf);
+				      member);
 }
 
 size_t
@@ -186,7 +262,7 @@ Iso9660InputStream::Read(void *ptr, size_t read_size, Error &error)
 {
 	int readed = 0;
 	int no_blocks, cur_block;
-	size_t left_bytes = statbuf->size - offset;
+	size_t left_bytes = member.size - offset;
 
 	if (left_bytes < read_size) {
 		no_blocks = CEILING(left_bytes, ISO_BLOCKSIZE);
@@ -199,7 +275,7 @@ Iso9660InputStream::Read(void *ptr, size_t read_size, Error &error)
 
 	cur_block = offset / ISO_BLOCKSIZE;
 
-	readed = archive.SeekRead(ptr, statbuf->lsn + cur_block,
+	readed = archive.SeekRead(ptr, member.lsn + cur_block,
 				  no_blocks);
 
 	if (readed != no_blocks * ISO_BLOCKSIZE) {
@@ -232,7 +308,7 @@ static const char *const iso9660_archive_extensions[] = {
 const ArchivePlugin iso9660_archive_plugin = {
 	"iso",
 	nullptr,
-	nullptr,
+	iso9660_archive_finish,
 	iso9660_archive_open,
 	iso9660_archive_extensions,
 };
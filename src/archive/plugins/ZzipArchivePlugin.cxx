@@ -26,26 +26,80 @@
 #include "../ArchivePlugin.hxx"
 #include "../ArchiveFile.hxx"
 #include "../ArchiveVisitor.hxx"
+#include "../ArchiveCache.hxx"
 #include "input/InputStream.hxx"
 #include "input/InputPlugin.hxx"
 #include "fs/Path.hxx"
+#include "thread/Mutex.hxx"
 #include "util/RefCount.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
 #include <zzip/zzip.h>
 
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 class ZzipArchiveFile final : public ArchiveFile {
 public:
+	struct StoredMember {
+		/**
+		 * The offset of the member's local file header.
+		 */
+		uint32_t header_offset;
+
+		uint32_t size;
+	};
+
 	RefCount ref;
 
+	/**
+	 * Protects #dir and all ZZIP_FILE objects opened from it,
+	 * because zziplib shares one file descriptor between them.
+	 */
+	Mutex zzip_mutex;
+
 	ZZIP_DIR *const dir;
 
-	ZzipArchiveFile(ZZIP_DIR *_dir)
-		:ArchiveFile(zzip_archive_plugin), dir(_dir) {}
+	/**
+	 * A private file descriptor for pread() calls on stored
+	 * members, or -1.
+	 */
+	const int fd;
+
+	/**
+	 * The names of all regular members, parsed once when the
+	 * archive is opened.
+	 */
+	std::vector<std::string> names;
+
+	/**
+	 * Members which are stored without compression; they are
+	 * read directly from #fd instead of going through zziplib.
+	 */
+	std::map<std::string, StoredMember> stored;
+
+	ZzipArchiveFile(ZZIP_DIR *_dir, int _fd)
+		:ArchiveFile(zzip_archive_plugin), dir(_dir), fd(_fd) {
+		LoadIndex();
+	}
 
 	~ZzipArchiveFile() {
 		zzip_dir_close(dir);
+		if (fd >= 0)
+			close(fd);
+	}
+
+	void Ref() {
+		ref.Increment();
 	}
 
 	void Unref() {
@@ -62,35 +116,175 @@ public:
 	virtual InputStream *OpenStream(const char *path,
 					Mutex &mutex, Cond &cond,
 					Error &error) override;
+
+private:
+	void LoadIndex();
+	bool LoadStoredIndex();
+
+	/**
+	 * Determine the offset of a stored member's data by reading
+	 * its local file header.
+	 */
+	bool GetDataOffset(const StoredMember &member,
+			   uint64_t &offset_r) const;
 };
 
 static constexpr Domain zzip_domain("zzip");
 
+/**
+ * Keep this number of ZIP files open.
+ */
+static ArchiveCache<ZzipArchiveFile> zzip_cache(4);
+
 /* archive open && listing routine */
 
+static void
+zzip_archive_finish()
+{
+	zzip_cache.Clear();
+}
+
 static ArchiveFile *
 zzip_archive_open(Path pathname, Error &error)
 {
-	ZZIP_DIR *dir = zzip_dir_open(pathname.c_str(), nullptr);
-	if (dir == nullptr) {
-		error.Format(zzip_domain, "Failed to open ZIP file %s",
-			     pathname.c_str());
-		return nullptr;
-	}
-
-	return new ZzipArchiveFile(dir);
+	return zzip_cache.Open(pathname, [pathname, &error]() -> ZzipArchiveFile * {
+			ZZIP_DIR *dir = zzip_dir_open(pathname.c_str(), nullptr);
+			if (dir == nullptr) {
+				error.Format(zzip_domain,
+					     "Failed to open ZIP file %s",
+					     pathname.c_str());
+				return nullptr;
+			}
+
+			int fd = open(pathname.c_str(), O_RDONLY|O_CLOEXEC);
+			return new ZzipArchiveFile(dir, fd);
+		});
 }
 
-inline void
-ZzipArchiveFile::Visit(ArchiveVisitor &visitor)
+void
+ZzipArchiveFile::LoadIndex()
 {
-	zzip_rewinddir(dir);
-
 	ZZIP_DIRENT dirent;
 	while (zzip_dir_read(dir, &dirent))
 		//add only files
 		if (dirent.st_size > 0)
-			visitor.VisitArchiveEntry(dirent.d_name);
+			names.emplace_back(dirent.d_name);
+
+	if (fd >= 0 && !LoadStoredIndex())
+		/* not understood (e.g. ZIP64); use zziplib for all
+		   members */
+		stored.clear();
+}
+
+static uint16_t
+ReadLE16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+ReadLE32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+/**
+ * Parse the central directory to find the members which are stored
+ * without compression.
+ */
+bool
+ZzipArchiveFile::LoadStoredIndex()
+{
+	static constexpr size_t EOCD_SIZE = 22;
+	static constexpr size_t MAX_COMMENT = 65535;
+	static constexpr size_t MAX_CENTRAL_DIRECTORY = 64 * 1024 * 1024;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || size_t(st.st_size) < EOCD_SIZE)
+		return false;
+
+	/* find the "end of central directory" record */
+	const size_t tail_size = std::min<uint64_t>(st.st_size,
+						    EOCD_SIZE + MAX_COMMENT);
+	std::unique_ptr<uint8_t[]> tail(new uint8_t[tail_size]);
+	if (pread(fd, tail.get(), tail_size, st.st_size - tail_size)
+	    != ssize_t(tail_size))
+		return false;
+
+	const uint8_t *eocd = nullptr;
+	for (size_t i = tail_size - EOCD_SIZE + 1; i-- > 0;) {
+		if (ReadLE32(tail.get() + i) == 0x06054b50) {
+			eocd = tail.get() + i;
+			break;
+		}
+	}
+
+	if (eocd == nullptr)
+		return false;
+
+	const uint32_t cd_size = ReadLE32(eocd + 12);
+	const uint32_t cd_offset = ReadLE32(eocd + 16);
+	if (cd_offset == 0xffffffff || cd_size > MAX_CENTRAL_DIRECTORY ||
+	    uint64_t(cd_offset) + cd_size > uint64_t(st.st_size))
+		return false;
+
+	std::unique_ptr<uint8_t[]> cd(new uint8_t[cd_size]);
+	if (pread(fd, cd.get(), cd_size, cd_offset) != ssize_t(cd_size))
+		return false;
+
+	for (const uint8_t *p = cd.get(), *end = p + cd_size; p < end;) {
+		if (p + 46 > end || ReadLE32(p) != 0x02014b50)
+			return false;
+
+		const uint16_t method = ReadLE16(p + 10);
+		const uint32_t csize = ReadLE32(p + 20);
+		const uint32_t usize = ReadLE32(p + 24);
+		const uint16_t name_length = ReadLE16(p + 28);
+		const uint16_t extra_length = ReadLE16(p + 30);
+		const uint16_t comment_length = ReadLE16(p + 32);
+		const uint16_t flags = ReadLE16(p + 8);
+		const uint32_t header_offset = ReadLE32(p + 42);
+
+		const uint8_t *next = p + 46 + name_length + extra_length
+			+ comment_length;
+		if (next > end)
+			return false;
+
+		/* bit 0 means encrypted */
+		if (method == 0 && (flags & 1) == 0 &&
+		    csize == usize && usize > 0 && usize != 0xffffffff &&
+		    header_offset != 0xffffffff)
+			stored.insert(std::make_pair(std::string((const char *)p + 46,
+								 name_length),
+						     StoredMember{header_offset,
+								  usize}));
+
+		p = next;
+	}
+
+	return true;
+}
+
+bool
+ZzipArchiveFile::GetDataOffset(const StoredMember &member,
+			       uint64_t &offset_r) const
+{
+	uint8_t header[30];
+	if (pread(fd, header, sizeof(header), member.header_offset)
+	    != ssize_t(sizeof(header)) ||
+	    ReadLE32(header) != 0x04034b50)
+		return false;
+
+	offset_r = uint64_t(member.header_offset) + sizeof(header)
+		+ ReadLE16(header + 26) + ReadLE16(header + 28);
+	return true;
+}
+
+void
+ZzipArchiveFile::Visit(ArchiveVisitor &visitor)
+{
+	for (const auto &name : names)
+		visitor.VisitArchiveEntry(name.c_str());
 }
 
 /* single archive handling */
@@ -114,11 +308,13 @@ struct ZzipInputStream final : public InputStream {
 
 		SetReady();
 
-		archive->ref.Increment();
+		archive->Ref();
 	}
 
 	~ZzipInputStream() {
+		archive->zzip_mutex.lock();
 		zzip_file_close(file);
+		archive->zzip_mutex.unlock();
 		archive->Unref();
 	}
 
@@ -128,12 +324,56 @@ struct ZzipInputStream final : public InputStream {
 	bool Seek(offset_type offset, Error &error) override;
 };
 
+/**
+ * Reads a member which is stored without compression directly from
+ * the archive file, at its known offset.
+ */
+class ZzipStoredInputStream final : public InputStream {
+	ZzipArchiveFile &archive;
+
+	const uint64_t start;
+
+public:
+	ZzipStoredInputStream(ZzipArchiveFile &_archive, const char *_uri,
+			      Mutex &_mutex, Cond &_cond,
+			      uint64_t _start, uint32_t _size)
+		:InputStream(_uri, _mutex, _cond),
+		 archive(_archive), start(_start) {
+		seekable = true;
+		size = _size;
+		SetReady();
+
+		archive.Ref();
+	}
+
+	~ZzipStoredInputStream() {
+		archive.Unref();
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() override {
+		return offset >= size;
+	}
+
+	size_t Read(void *ptr, size_t size, Error &error) override;
+	bool Seek(offset_type offset, Error &error) override;
+};
+
 InputStream *
 ZzipArchiveFile::OpenStream(const char *pathname,
 			    Mutex &mutex, Cond &cond,
 			    Error &error)
 {
+	auto i = stored.find(pathname);
+	uint64_t data_offset;
+	if (i != stored.end() && GetDataOffset(i->second, data_offset))
+		return new ZzipStoredInputStream(*this, pathname,
+						 mutex, cond,
+						 data_offset, i->second.size);
+
+	zzip_mutex.lock();
 	ZZIP_FILE *_file = zzip_file_open(dir, pathname, 0);
+	zzip_mutex.unlock();
 	if (_file == nullptr) {
 		error.Format(zzip_domain, "not found in the ZIP file: %s",
 			     pathname);
@@ -148,6 +388,8 @@ ZzipArchiveFile::OpenStream(const char *pathname,
 size_t
 ZzipInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
+	const ScopeLock protect(archive->zzip_mutex);
+
 	int ret = zzip_file_read(file, ptr, read_size);
 	if (ret < 0) {
 		error.Set(zzip_domain, "zzip_file_read() has failed");
@@ -161,12 +403,14 @@ ZzipInputStream::Read(void *ptr, size_t read_size, Error &error)
 bool
 ZzipInputStream::IsEOF()
 {
+	const ScopeLock protect(archive->zzip_mutex);
 	return (InputPlugin::offset_type)zzip_tell(file) == size;
 }
 
 bool
 ZzipInputStream::Seek(offset_type new_offset, Error &error)
 {
+	const ScopeLock protect(archive->zzip_mutex);
 	zzip_off_t ofs = zzip_seek(file, new_offset, SEEK_SET);
 	if (ofs != -1) {
 		error.Set(zzip_domain, "zzip_seek() has failed");
@@ -176,6 +420,42 @@ ZzipInputStream::Seek(offset_type new_offset, Error &error)
 	return false;
 }
 
+size_t
+ZzipStoredInputStream::Read(void *ptr, size_t read_size, Error &error)
+{
+	if (offset >= size)
+		return 0;
+
+	if (offset_type(read_size) > size - offset)
+		read_size = size - offset;
+
+	ssize_t nbytes = pread(archive.fd, ptr, read_size, start + offset);
+	if (nbytes < 0) {
+		error.SetErrno("Failed to read from ZIP file");
+		return 0;
+	}
+
+	if (nbytes == 0) {
+		error.Set(zzip_domain, "Unexpected end of ZIP file");
+		return 0;
+	}
+
+	offset += nbytes;
+	return nbytes;
+}
+
+bool
+ZzipStoredInputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (new_offset > size) {
+		error.Set(zzip_domain, "Invalid seek offset");
+		return false;
+	}
+
+	offset = new_offset;
+	return true;
+}
+
 /* exported structures */
 
 static const char *const zzip_archive_extensions[] = {
@@ -186,7 +466,7 @@ static const char *const zzip_archive_extensions[] = {
 const ArchivePlugin zzip_archive_plugin = {
 	"zzip",
 	nullptr,
-	nullptr,
+	zzip_archive_finish,
 	zzip_archive_open,
 	zzip_archive_extensions,
 };
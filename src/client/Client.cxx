@@ -25,18 +25,26 @@
 
 const Domain client_domain("client");
 
+void
+Client::SetPartition(Partition &new_partition)
+{
+	partition = &new_partition;
+	playlist = &new_partition.playlist;
+	player_control = &new_partition.pc;
+}
+
 #ifdef ENABLE_DATABASE
 
 const Database *
 Client::GetDatabase(Error &error) const
 {
-	return partition.instance.GetDatabase(error);
+	return partition->instance.GetDatabase(error);
 }
 
 const Storage *
 Client::GetStorage() const
 {
-	return partition.instance.storage;
+	return partition->instance.storage;
 }
 
 #endif
@@ -27,29 +27,50 @@
 #include "event/TimeoutMonitor.hxx"
 #include "Compiler.h"
 
+#ifdef ENABLE_DATABASE
+#include "SongFilter.hxx"
+#endif
+
 #include <boost/intrusive/list.hpp>
 
-#include <set>
+#include <map>
+#include <vector>
 #include <string>
 #include <list>
 
 #include <stddef.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 struct sockaddr;
+struct z_stream_s;
 class EventLoop;
 class Path;
 struct Partition;
 class Database;
 class Storage;
+class BackgroundCommand;
+class ResponseProducer;
+class MemoryAccount;
+
+/**
+ * The memory occupied by the output buffers of all clients.
+ */
+extern MemoryAccount memory_client_output;
 
 class Client final
 	: FullyBufferedSocket, TimeoutMonitor,
 	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+	/**
+	 * The partition this client is currently attached to; see
+	 * SetPartition().  #playlist and #player_control are
+	 * shortcuts into it.
+	 */
+	Partition *partition;
+	struct playlist *playlist;
+	struct PlayerControl *player_control;
+
 public:
-	Partition &partition;
-	struct playlist &playlist;
-	struct PlayerControl &player_control;
 
 	struct Disposer {
 		void operator()(Client *client) const {
@@ -77,9 +98,55 @@ public:
 	unsigned idle_subscriptions;
 
 	/**
-	 * A list of channel names this client is subscribed to.
+	 * A bit mask of tag types which are sent to this client (bit
+	 * number = #TagType).  It is configured with the "tagtypes"
+	 * command.
 	 */
-	std::set<std::string> subscriptions;
+	uint32_t tag_mask;
+
+#ifdef HAVE_ZLIB
+	/**
+	 * The zlib stream which compresses all output to this client,
+	 * or nullptr if compression is disabled.
+	 */
+	z_stream_s *compressor;
+
+	/**
+	 * Shall output be compressed?  This is set by the "compress"
+	 * command, and applied by EndResponse() after the response
+	 * to that command has been written.
+	 */
+	bool compression_requested;
+#endif
+
+	/**
+	 * The command which is currently being executed by a worker
+	 * thread, or nullptr.  While it is set, no input is processed
+	 * and only the worker thread writes to this client.
+	 */
+	BackgroundCommand *background;
+
+	/**
+	 * Generates the rest of the current response while the output
+	 * buffer drains, or nullptr.  While it is set, no input is
+	 * processed.
+	 */
+	ResponseProducer *producer;
+
+	/**
+	 * The number of response bytes written to this client (before
+	 * compression).  Used to measure the response size of each
+	 * command.
+	 */
+	uint64_t response_bytes;
+
+	/**
+	 * A sorted list of channel names this client is subscribed
+	 * to.  A vector is cheaper than a tree for the few
+	 * subscriptions a client may have, and it costs no memory
+	 * while empty.
+	 */
+	std::vector<std::string> subscriptions;
 
 	/**
 	 * The number of subscriptions in #subscriptions.  Used to
@@ -92,18 +159,56 @@ public:
 	 */
 	std::list<ClientMessage> messages;
 
+#ifdef ENABLE_DATABASE
+	/**
+	 * Song filters registered with the "prepare" command, which
+	 * can be executed repeatedly with "execute" without parsing
+	 * them again.
+	 */
+	std::map<std::string, SongFilter> prepared_filters;
+#endif
+
 	Client(EventLoop &loop, Partition &partition,
 	       int fd, int uid, int num);
 
 	~Client() {
 		if (FullyBufferedSocket::IsDefined())
 			FullyBufferedSocket::Close();
+
+#ifdef HAVE_ZLIB
+		DeleteCompressor();
+#endif
+
+		DeleteBackground();
+		DeleteProducer();
 	}
 
 	bool IsConnected() const {
 		return FullyBufferedSocket::IsDefined();
 	}
 
+	Partition &GetPartition() {
+		return *partition;
+	}
+
+	const Partition &GetPartition() const {
+		return *partition;
+	}
+
+	/**
+	 * Attach this client to another partition (the "partition"
+	 * command).
+	 */
+	void SetPartition(Partition &new_partition);
+
+	struct playlist &GetPlaylist() {
+		return *playlist;
+	}
+
+	PlayerControl &GetPlayerControl() {
+		return *player_control;
+	}
+
 	gcc_pure
 	bool IsExpired() const {
 		return !FullyBufferedSocket::IsDefined();
@@ -112,7 +217,86 @@ public:
 	void Close();
 	void SetExpired();
 
-	using FullyBufferedSocket::Write;
+	/**
+	 * Write data to the client, compressing it if enabled.
+	 *
+	 * @return false if the client has been closed
+	 */
+	bool Write(const void *data, size_t length);
+
+	WritableBuffer<void> PrepareWrite() {
+		if (background != nullptr)
+			/* output goes to the BackgroundCommand */
+			return nullptr;
+
+#ifdef HAVE_ZLIB
+		if (compressor != nullptr)
+			/* compressed output must go through Write() */
+			return nullptr;
+#endif
+
+		return FullyBufferedSocket::PrepareWrite();
+	}
+
+	void CommitWrite(size_t length) {
+		response_bytes += length;
+		FullyBufferedSocket::CommitWrite(length);
+	}
+
+	/**
+	 * Called after a complete response has been written.  When
+	 * compression is enabled, this flushes the compressor so the
+	 * client can decode the whole response.  It also applies a
+	 * compression mode change requested by the "compress"
+	 * command.
+	 */
+	void EndResponse();
+
+	/**
+	 * Is the output buffer filled up to its normal size?  Code
+	 * which writes a large response shall pass the rest to
+	 * StartResponse() then.
+	 */
+	gcc_pure
+	bool IsOutputCongested() const {
+		/* the output of a background command does not go to
+		   the output buffer (which belongs to the main
+		   thread) */
+		return background == nullptr &&
+			FullyBufferedSocket::IsOutputCongested();
+	}
+
+	/**
+	 * Write the rest of the current response with the given
+	 * producer, which is invoked whenever the output buffer has
+	 * room.  The command handler returns right away; input
+	 * processing is paused until the producer has finished, and
+	 * the "OK" is sent after that.  Inside a command list or a
+	 * background command, the whole response is produced right
+	 * away.
+	 *
+	 * This object takes over ownership of the producer.
+	 */
+	void StartResponse(ResponseProducer *producer);
+
+	bool IsStreaming() const {
+		return producer != nullptr;
+	}
+
+	/**
+	 * Execute a command line in a worker thread.  Input
+	 * processing is paused until it has finished.  If the
+	 * response is in #client_response_cache, it is written
+	 * right away instead.
+	 *
+	 * @param cacheable may the response be stored in (and be
+	 * served from) #client_response_cache?
+	 */
+	void StartBackground(const char *line, bool cacheable);
+
+	bool IsBackground() const {
+		return background != nullptr;
+	}
 
 	/**
 	 * returns the uid of the client process, or a negative value
@@ -160,13 +344,18 @@ public:
 	};
 
 	gcc_pure
-	bool IsSubscribed(const char *channel_name) const {
-		return subscriptions.find(channel_name) != subscriptions.end();
-	}
+	bool IsSubscribed(const char *channel_name) const;
 
 	SubscribeResult Subscribe(const char *channel);
 	bool Unsubscribe(const char *channel);
 	void UnsubscribeAll();
+
+	/**
+	 * Append a message to the queue of this client, which must
+	 * be subscribed to its channel.
+	 *
+	 * @return false if the queue is full
+	 */
 	bool PushMessage(const ClientMessage &msg);
 
 	/**
@@ -191,21 +380,85 @@ public:
 	const Storage *GetStorage() const;
 
 private:
+	friend class BackgroundCommand;
+
+	/**
+	 * Write data to the output buffer (through the compressor, if
+	 * enabled).  Must be called in the main thread.
+	 */
+	bool WriteOutput(const void *data, size_t length);
+
+	/**
+	 * Called by #BackgroundCommand in the main thread after the
+	 * whole response has been written.  Resumes processing input.
+	 */
+	void OnBackgroundFinished();
+
+	void DeleteBackground();
+
+	/**
+	 * Invoke the #producer until it has finished or the output
+	 * buffer is congested.
+	 *
+	 * @return true if the response is complete
+	 */
+	bool RunProducer();
+
+	void DeleteProducer();
+
+#ifdef HAVE_ZLIB
+	/**
+	 * Start compressing all further output.
+	 */
+	bool EnableCompression();
+
+	/**
+	 * Finish the compressed stream; all further output is sent
+	 * uncompressed.
+	 */
+	void DisableCompression();
+
+	void DeleteCompressor();
+
+	/**
+	 * Pass data (which may be empty) through the compressor and
+	 * write the result to the output buffer.
+	 *
+	 * @param flush the zlib flush mode
+	 */
+	bool WriteCompressed(const void *data, size_t length, int flush);
+#endif
+
 	/* virtual methods from class BufferedSocket */
 	virtual InputResult OnSocketInput(void *data, size_t length) override;
 	virtual void OnSocketError(Error &&error) override;
 	virtual void OnSocketClosed() override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	virtual bool OnOutputAvailable() override;
+
 	/* virtual methods from class TimeoutMonitor */
 	virtual void OnTimeout() override;
 };
 
 void client_manager_init(void);
 
+/**
+ * Stop the worker threads.  Call this before closing all clients.
+ */
+void
+client_manager_deinit();
+
 void
 client_new(EventLoop &loop, Partition &partition,
 	   int fd, const sockaddr *sa, size_t sa_length, int uid);
 
+/**
+ * Write a block of data to the client.
+ */
+void
+client_write(Client &client, const char *data, size_t length);
+
 /**
  * Write a C string to the client.
  */
@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientBackground.hxx"
+#include "ClientInternal.hxx"
+#include "ResponseCache.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "command/AllCommands.hxx"
+#include "protocol/Result.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "system/FatalError.hxx"
+#include "event/Loop.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdio.h>
+
+/**
+ * The number of worker threads.
+ */
+static constexpr unsigned CLIENT_WORKER_THREADS = 2;
+
+/**
+ * Output is passed to the main thread in chunks of this size.
+ */
+static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+static struct {
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Commands waiting for a worker thread.
+	 */
+	std::list<BackgroundCommand *> queue;
+
+	/**
+	 * Commands which are being executed.
+	 */
+	std::list<BackgroundCommand *> running;
+
+	/**
+	 * Commands whose client has been closed.  The main thread
+	 * deletes the client when the worker is done with it, or in
+	 * client_background_deinit() if the event loop has already
+	 * finished by then.
+	 */
+	std::list<BackgroundCommand *> closed;
+
+	Thread threads[CLIENT_WORKER_THREADS];
+
+	bool quit;
+} worker;
+
+BackgroundCommand::BackgroundCommand(EventLoop &_loop, Client &_client,
+				     const char *_line,
+				     std::string &&_cache_key)
+	:DeferredMonitor(_loop),
+	 client(_client), line(_line),
+	 cache_key(std::move(_cache_key)),
+	 cache_generation(client_response_cache.GetGeneration()),
+	 cacheable(!cache_key.empty()),
+	 chunks_size(0), done(false), success(false), cancelled(false),
+	 call(nullptr)
+{
+}
+
+void
+BackgroundCommand::Run()
+{
+	FormatDebug(client_domain, "[%u] process command \"%s\" in background",
+		    client.num, line.c_str());
+
+	CommandResult result = command_process(client, 0, &line[0]);
+	FormatDebug(client_domain, "[%u] command returned %i",
+		    client.num, int(result));
+
+	if (result == CommandResult::OK) {
+		command_success(client);
+
+		/* no lock needed: the main thread reads it only after
+		   Finish() */
+		success = true;
+	}
+}
+
+bool
+BackgroundCommand::Write(const void *data, size_t length)
+{
+	pending.append((const char *)data, length);
+	if (pending.length() < CHUNK_SIZE)
+		return true;
+
+	return Submit(false);
+}
+
+bool
+BackgroundCommand::Submit(bool finish)
+{
+	const ScopeLock protect(mutex);
+
+	if (!finish)
+		while (!cancelled && chunks_size >= client_max_output_buffer_size)
+			cond.wait(mutex);
+
+	if (!cancelled && !pending.empty()) {
+		chunks_size += pending.length();
+		chunks.emplace_back(std::move(pending));
+	}
+
+	pending.clear();
+
+	if (finish)
+		/* after this, the main thread may delete this object
+		   as soon as the mutex is released */
+		done = true;
+
+	DeferredMonitor::Schedule();
+	return !cancelled;
+}
+
+bool
+BackgroundCommand::CallMain(const std::function<void()> &f)
+{
+	const ScopeLock protect(mutex);
+
+	if (cancelled)
+		return false;
+
+	call = &f;
+	DeferredMonitor::Schedule();
+
+	while (!cancelled && call != nullptr)
+		cond.wait(mutex);
+
+	if (call != nullptr) {
+		/* cancelled; the main thread will not invoke it */
+		call = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+void
+BackgroundCommand::Cancel()
+{
+	const ScopeLock protect(mutex);
+	cancelled = true;
+	chunks.clear();
+	chunks_size = 0;
+	cond.signal();
+}
+
+bool
+BackgroundCommand::IsCancelled()
+{
+	const ScopeLock protect(mutex);
+	return cancelled;
+}
+
+void
+BackgroundCommand::OnClientClosed()
+{
+	const ScopeLock protect(worker.mutex);
+	worker.closed.push_back(this);
+	Cancel();
+}
+
+void
+BackgroundCommand::DeleteClient()
+{
+	worker.mutex.lock();
+	worker.closed.remove(this);
+	worker.mutex.unlock();
+
+	/* this deletes this object, too */
+	delete &client;
+}
+
+void
+BackgroundCommand::RunDeferred()
+{
+	mutex.lock();
+
+	if (cancelled) {
+		const bool _done = done;
+		mutex.unlock();
+
+		if (_done)
+			/* the client has been closed while the worker
+			   was still using it */
+			DeleteClient();
+		return;
+	}
+
+	const auto *_call = call;
+	mutex.unlock();
+
+	if (_call != nullptr) {
+		(*_call)();
+
+		const ScopeLock protect(mutex);
+		call = nullptr;
+		cond.signal();
+	}
+
+	bool _done, _success;
+
+	while (true) {
+		std::string chunk;
+
+		mutex.lock();
+		_done = done;
+		_success = success;
+
+		if (chunks.empty()) {
+			mutex.unlock();
+			break;
+		}
+
+		if (!client.IsExpired() &&
+		    client.FullyBufferedSocket::IsOutputCongested()) {
+			/* don't let the client's output buffer grow
+			   beyond its normal size; the remaining
+			   chunks stay here (which applies
+			   backpressure to the worker thread) until
+			   the client has read some of it */
+			mutex.unlock();
+			client.WaitOutputAvailable();
+			return;
+		}
+
+		chunk = std::move(chunks.front());
+		chunks.pop_front();
+		chunks_size -= chunk.length();
+		cond.signal();
+		mutex.unlock();
+
+		if (client.IsExpired())
+			continue;
+
+		client.WriteOutput(chunk.data(), chunk.length());
+
+		if (cacheable) {
+			const size_t length = response.length() +
+				chunk.length();
+			if (client_response_cache.IsCacheable(length) &&
+			    /* a cached response is written at once
+			       by Client::StartBackground() */
+			    length <= client_max_output_buffer_size / 2)
+				response.append(chunk);
+			else {
+				cacheable = false;
+				response.clear();
+				response.shrink_to_fit();
+			}
+		}
+	}
+
+	if (_done) {
+		if (_success && cacheable && !client.IsExpired())
+			client_response_cache.Put(cache_generation,
+						  std::move(cache_key),
+						  std::move(response));
+
+		/* this deletes this object */
+		client.OnBackgroundFinished();
+	}
+}
+
+/**
+ * Build the #client_response_cache key for a command.  The response
+ * also depends on the client's tag selection and permissions.
+ */
+static std::string
+MakeCacheKey(const Client &client, const char *line)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%x %x\n",
+		 (unsigned)client.tag_mask, client.GetPermission());
+
+	std::string key(buffer);
+	key.append(line);
+	return key;
+}
+
+void
+Client::StartBackground(const char *line, bool cacheable)
+{
+	assert(background == nullptr);
+
+	std::string key;
+	if (cacheable) {
+		key = MakeCacheKey(*this, line);
+		const std::string *cached = client_response_cache.Get(key);
+		if (cached != nullptr &&
+		    !FullyBufferedSocket::IsOutputCongested()) {
+			FormatDebug(client_domain,
+				    "[%u] cached response for \"%s\"",
+				    num, line);
+			WriteOutput(cached->data(), cached->length());
+			return;
+		}
+	}
+
+	/* no timeout while the command is running */
+	TimeoutMonitor::Cancel();
+
+	background = new BackgroundCommand(*partition->instance.event_loop,
+					   *this, line, std::move(key));
+	client_background_push(*background);
+}
+
+void
+Client::OnBackgroundFinished()
+{
+	assert(background != nullptr);
+
+	DeleteBackground();
+
+	if (IsExpired())
+		/* SetExpired() has scheduled Close() */
+		return;
+
+	EndResponse();
+	TimeoutMonitor::ScheduleSeconds(client_timeout);
+
+	/* process the input which has arrived in the meantime; this
+	   may close and delete the client */
+	ResumeInput();
+}
+
+void
+Client::DeleteBackground()
+{
+	delete background;
+	background = nullptr;
+}
+
+static void
+client_worker_thread(gcc_unused void *ctx)
+{
+	SetThreadName("client");
+
+	worker.mutex.lock();
+
+	while (true) {
+		if (worker.quit)
+			break;
+
+		if (worker.queue.empty()) {
+			worker.cond.wait(worker.mutex);
+			continue;
+		}
+
+		BackgroundCommand *cmd = worker.queue.front();
+		worker.queue.pop_front();
+		worker.running.push_front(cmd);
+		const auto i = worker.running.begin();
+
+		worker.mutex.unlock();
+		if (!cmd->IsCancelled())
+			cmd->Run();
+		worker.mutex.lock();
+
+		worker.running.erase(i);
+
+		/* submit the end of the response while still holding
+		   the pool lock, so client_background_deinit() does
+		   not see a command which is being deleted */
+		cmd->Finish();
+	}
+
+	worker.mutex.unlock();
+}
+
+/**
+ * Start the worker threads.  The caller must hold the mutex.
+ */
+static void
+client_background_start()
+{
+	worker.quit = false;
+
+	for (auto &thread : worker.threads) {
+		Error error;
+		if (!thread.Start(client_worker_thread, nullptr, error))
+			FatalError(error);
+	}
+}
+
+void
+client_background_deinit()
+{
+	if (!worker.threads[0].IsDefined())
+		/* the worker threads have never been started */
+		return;
+
+	worker.mutex.lock();
+	worker.quit = true;
+	/* the remaining queued commands are deleted with their
+	   client: by ClientList if it is still open, or below if it
+	   has been closed */
+	worker.queue.clear();
+	for (auto *cmd : worker.running)
+		cmd->Cancel();
+	worker.cond.broadcast();
+	worker.mutex.unlock();
+
+	for (auto &thread : worker.threads)
+		thread.Join();
+
+	/* the event loop does not run anymore, so it will not delete
+	   the clients which have been closed while their command was
+	   queued or running */
+	while (!worker.closed.empty())
+		worker.closed.front()->DeleteClient();
+}
+
+void
+client_background_push(BackgroundCommand &cmd)
+{
+	const ScopeLock protect(worker.mutex);
+
+	if (!worker.threads[0].IsDefined())
+		client_background_start();
+
+	worker.queue.push_back(&cmd);
+	worker.cond.signal();
+}
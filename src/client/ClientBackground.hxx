@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_BACKGROUND_HXX
+#define MPD_CLIENT_BACKGROUND_HXX
+
+#include "check.h"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <list>
+#include <functional>
+
+#include <stddef.h>
+
+class EventLoop;
+class Client;
+
+/**
+ * A read-only command which is executed by a worker thread on behalf
+ * of a #Client.  While it runs, the client does not read more input,
+ * and all output of the command handler goes to this object.  The
+ * response is passed to the main thread in chunks, which are written
+ * to the client's output buffer there whenever it has room; the
+ * event loop never waits for the client.
+ */
+class BackgroundCommand final : DeferredMonitor {
+	Client &client;
+
+	/**
+	 * The command line.  It is modified by the tokenizer.
+	 */
+	std::string line;
+
+	/**
+	 * Output which has not yet been submitted to the main
+	 * thread.  Only the worker thread accesses it.
+	 */
+	std::string pending;
+
+	/**
+	 * The key for #client_response_cache.
+	 */
+	std::string cache_key;
+
+	/**
+	 * The response collected for #client_response_cache.  Only
+	 * the main thread accesses it.
+	 */
+	std::string response;
+
+	/**
+	 * The cache generation when the command was started.
+	 */
+	const unsigned cache_generation;
+
+	/**
+	 * May the response still be stored in the cache?  This is
+	 * cleared when it gets too large.  Only the main thread
+	 * accesses it.
+	 */
+	bool cacheable;
+
+	/**
+	 * This mutex protects all of the following attributes.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled by the main thread when it has consumed
+	 * #chunks, or when the command has been cancelled.
+	 */
+	Cond cond;
+
+	/**
+	 * Output which is waiting to be written by the main thread.
+	 * It hands the chunks to the client only while the client's
+	 * output buffer has room, see RunDeferred().
+	 */
+	std::list<std::string> chunks;
+
+	/**
+	 * The total size of #chunks.
+	 */
+	size_t chunks_size;
+
+	/**
+	 * Has the worker thread finished executing the command?
+	 */
+	bool done;
+
+	/**
+	 * Has the command succeeded?
+	 */
+	bool success;
+
+	/**
+	 * Has the client been closed?  The output is discarded, and
+	 * the main thread deletes the client when the worker is done.
+	 */
+	bool cancelled;
+
+	/**
+	 * A function which shall be invoked by the main thread on
+	 * behalf of the worker, see CallMain().  It is reset to
+	 * nullptr when the function has returned.
+	 */
+	const std::function<void()> *call;
+
+public:
+	/**
+	 * @param _cache_key the key for #client_response_cache; an
+	 * empty string means the response must not be cached
+	 */
+	BackgroundCommand(EventLoop &_loop, Client &_client,
+			  const char *_line, std::string &&_cache_key);
+
+	/**
+	 * Execute the command.  Called by the worker thread.
+	 */
+	void Run();
+
+	/**
+	 * Append output.  Called by the worker thread through
+	 * Client::Write().
+	 *
+	 * @return false if the command has been cancelled
+	 */
+	bool Write(const void *data, size_t length);
+
+	/**
+	 * Submit the rest of the response; the main thread may delete
+	 * this object after that.  Called by the worker thread.
+	 */
+	void Finish() {
+		Submit(true);
+	}
+
+	/**
+	 * Invoke a function in the main thread and wait for it to
+	 * return.  This allows the command handler to modify state
+	 * which belongs to the main thread.  Called by the worker
+	 * thread.
+	 *
+	 * @return false if the command has been cancelled before the
+	 * function was invoked
+	 */
+	bool CallMain(const std::function<void()> &f);
+
+	/**
+	 * Discard all output and wake up the worker thread; it will
+	 * not wait for the main thread anymore.
+	 */
+	void Cancel();
+
+	gcc_pure
+	bool IsCancelled();
+
+	/**
+	 * The client has been closed.  The command gets cancelled,
+	 * and the client is deleted together with this object as
+	 * soon as the worker thread is done with it.  Called by the
+	 * main thread.
+	 */
+	void OnClientClosed();
+
+	/**
+	 * Delete the (closed) client, which deletes this object,
+	 * too.  Called by the main thread.
+	 */
+	void DeleteClient();
+
+	/**
+	 * The client's output buffer has room again; continue
+	 * handing over output.  Called by the main thread.
+	 */
+	void OnOutputAvailable() {
+		DeferredMonitor::Schedule();
+	}
+
+private:
+	/**
+	 * Pass #pending to the main thread.  Unless this is the end of
+	 * the response, waits while too much output is waiting, to
+	 * apply backpressure to the command handler.
+	 */
+	bool Submit(bool finish);
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override;
+};
+
+/**
+ * Cancel all commands and stop the worker threads.
+ */
+void
+client_background_deinit();
+
+/**
+ * Queue a command for execution by a worker thread.  The worker
+ * threads are started on the first call.
+ */
+void
+client_background_push(BackgroundCommand &cmd);
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientInternal.hxx"
+#include "Log.hxx"
+
+#include <zlib.h>
+
+#include <assert.h>
+
+bool
+Client::EnableCompression()
+{
+	assert(compressor == nullptr);
+
+	z_stream *z = new z_stream;
+	z->zalloc = Z_NULL;
+	z->zfree = Z_NULL;
+	z->opaque = Z_NULL;
+
+	if (deflateInit(z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+		FormatError(client_domain, "[%u] deflateInit() failed", num);
+		delete z;
+		compression_requested = false;
+		return false;
+	}
+
+	compressor = z;
+	FormatDebug(client_domain, "[%u] output compression enabled", num);
+	return true;
+}
+
+void
+Client::DisableCompression()
+{
+	assert(compressor != nullptr);
+
+	WriteCompressed(nullptr, 0, Z_FINISH);
+	DeleteCompressor();
+}
+
+void
+Client::DeleteCompressor()
+{
+	if (compressor == nullptr)
+		return;
+
+	deflateEnd(compressor);
+	delete compressor;
+	compressor = nullptr;
+}
+
+bool
+Client::WriteCompressed(const void *data, size_t length, int flush)
+{
+	assert(compressor != nullptr);
+
+	z_stream &z = *compressor;
+	z.next_in = const_cast<Bytef *>((const Bytef *)data);
+	z.avail_in = length;
+
+	do {
+		Bytef buffer[4096];
+		z.next_out = buffer;
+		z.avail_out = sizeof(buffer);
+
+		const int result = deflate(&z, flush);
+		if (result != Z_OK && result != Z_STREAM_END &&
+		    result != Z_BUF_ERROR) {
+			FormatError(client_domain,
+				    "[%u] deflate() failed", num);
+			SetExpired();
+			return false;
+		}
+
+		const size_t nbytes = sizeof(buffer) - z.avail_out;
+		if (nbytes > 0 &&
+		    !FullyBufferedSocket::Write(buffer, nbytes))
+			return false;
+	} while (z.avail_out == 0);
+
+	assert(z.avail_in == 0);
+	return true;
+}
@@ -19,15 +19,21 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientBackground.hxx"
 #include "config/ConfigGlobal.hxx"
+#include "util/MemoryAccount.hxx"
 
 #define CLIENT_TIMEOUT_DEFAULT			(60)
 #define CLIENT_MAX_COMMAND_LIST_DEFAULT		(2048*1024)
 #define CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT	(8192*1024)
+#define CLIENT_MAX_MESSAGES_DEFAULT		(1024)
 
 int client_timeout;
 size_t client_max_command_list_size;
 size_t client_max_output_buffer_size;
+unsigned client_max_messages;
+
+MemoryAccount memory_client_output;
 
 void client_manager_init(void)
 {
@@ -42,4 +48,14 @@ void client_manager_init(void)
 		config_get_positive(CONF_MAX_OUTPUT_BUFFER_SIZE,
 				    CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT / 1024)
 		* 1024;
+
+	client_max_messages =
+		config_get_positive(CONF_MAX_CLIENT_MESSAGES,
+				    CLIENT_MAX_MESSAGES_DEFAULT);
+}
+
+void
+client_manager_deinit()
+{
+	client_background_deinit();
 }
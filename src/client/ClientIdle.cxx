@@ -41,6 +41,7 @@ Client::IdleNotify()
 	}
 
 	client_puts(*this, "OK\n");
+	EndResponse();
 
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
 }
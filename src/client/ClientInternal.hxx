@@ -24,8 +24,8 @@
 #include "Client.hxx"
 #include "command/CommandResult.hxx"
 
-static constexpr unsigned CLIENT_MAX_SUBSCRIPTIONS = 16;
-static constexpr unsigned CLIENT_MAX_MESSAGES = 64;
+static constexpr unsigned CLIENT_MAX_SUBSCRIPTIONS = 64;
+static constexpr unsigned CLIENT_MAX_PREPARED = 32;
 
 extern const class Domain client_domain;
 
@@ -33,6 +33,11 @@ extern int client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * The maximum number of unread messages per client.
+ */
+extern unsigned client_max_messages;
+
 CommandResult
 client_process_line(Client &client, char *line);
 
@@ -31,12 +31,62 @@ ClientList::Remove(Client &client)
 	assert(!list.empty());
 
 	list.erase(list.iterator_to(client));
+	metric_clients.Set(list.size());
+
+	for (const auto &channel : client.subscriptions)
+		RemoveSubscriber(channel, client);
+}
+
+void
+ClientList::AddSubscriber(const std::string &channel, Client &client)
+{
+	channels[channel].insert(&client);
+}
+
+void
+ClientList::RemoveSubscriber(const std::string &channel, Client &client)
+{
+	auto i = channels.find(channel);
+	if (i == channels.end())
+		return;
+
+	i->second.erase(&client);
+	if (i->second.empty())
+		channels.erase(i);
+}
+
+ClientList::SendResult
+ClientList::SendMessage(const ClientMessage &msg)
+{
+	SendResult result{0, 0};
+
+	auto i = channels.find(msg.GetChannel());
+	if (i == channels.end())
+		return result;
+
+	for (Client *client : i->second) {
+		if (client->PushMessage(msg))
+			++result.sent;
+		else
+			++result.full;
+	}
+
+	return result;
 }
 
 void
 ClientList::CloseAll()
 {
 	list.clear_and_dispose(Client::Disposer());
+	channels.clear();
+	metric_clients.Set(0);
+}
+
+inline void
+ClientList::IdleFanOut(unsigned flags)
+{
+	for (auto &client : list)
+		client.IdleAdd(flags);
 }
 
 void
@@ -44,6 +94,22 @@ ClientList::IdleAdd(unsigned flags)
 {
 	assert(flags != 0);
 
-	for (auto &client : list)
-		client.IdleAdd(flags);
+	if (idle_delay_ms == 0) {
+		IdleFanOut(flags);
+		return;
+	}
+
+	pending_idle |= flags;
+	if (!IsActive())
+		Schedule(idle_delay_ms);
+}
+
+void
+ClientList::OnTimeout()
+{
+	const unsigned flags = pending_idle;
+	pending_idle = 0;
+
+	if (flags != 0)
+		IdleFanOut(flags);
 }
@@ -21,20 +21,47 @@
 #define MPD_CLIENT_LIST_HXX
 
 #include "Client.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "Metrics.hxx"
+
+#include <map>
+#include <set>
+#include <string>
 
 class Client;
+class ClientMessage;
 
-class ClientList {
+class ClientList final : TimeoutMonitor {
 	typedef boost::intrusive::list<Client,
 				       boost::intrusive::constant_time_size<true>> List;
 
 	const unsigned max_size;
 
+	/**
+	 * The number of milliseconds idle events are collected
+	 * before they are passed to the clients.  0 disables the
+	 * delay.
+	 */
+	const unsigned idle_delay_ms;
+
+	/**
+	 * Idle events which have been collected during the delay.
+	 */
+	unsigned pending_idle;
+
 	List list;
 
+	/**
+	 * All channels with at least one subscriber, and the clients
+	 * subscribed to each of them.
+	 */
+	std::map<std::string, std::set<Client *>> channels;
+
 public:
-	ClientList(unsigned _max_size)
-		:max_size(_max_size) {}
+	ClientList(EventLoop &_loop, unsigned _max_size,
+		   unsigned _idle_delay_ms)
+		:TimeoutMonitor(_loop), max_size(_max_size),
+		 idle_delay_ms(_idle_delay_ms), pending_idle(0) {}
 	~ClientList() {
 		CloseAll();
 	}
@@ -53,13 +80,69 @@ public:
 
 	void Add(Client &client) {
 		list.push_front(client);
+		metric_clients.Set(list.size());
 	}
 
 	void Remove(Client &client);
 
 	void CloseAll();
 
+	/**
+	 * Register a subscription in the channel index.  Called by
+	 * Client::Subscribe().
+	 */
+	void AddSubscriber(const std::string &channel, Client &client);
+
+	/**
+	 * Unregister a subscription from the channel index.  Called
+	 * by Client::Unsubscribe().
+	 */
+	void RemoveSubscriber(const std::string &channel, Client &client);
+
+	/**
+	 * Call the given function for each channel name which has at
+	 * least one subscriber.
+	 */
+	template<typename F>
+	void VisitChannels(F f) const {
+		for (const auto &i : channels)
+			f(i.first);
+	}
+
+	/**
+	 * The result of SendMessage().
+	 */
+	struct SendResult {
+		/**
+		 * The number of subscribers which have received the
+		 * message.
+		 */
+		unsigned sent;
+
+		/**
+		 * The number of subscribers whose message queue was
+		 * full; they have not received the message.
+		 */
+		unsigned full;
+	};
+
+	/**
+	 * Deliver a message to all clients subscribed to its channel.
+	 */
+	SendResult SendMessage(const ClientMessage &msg);
+
+	/**
+	 * Pass idle events to all clients.  If an idle delay is
+	 * configured, the events are collected first, so a burst of
+	 * events results in only one response per client.
+	 */
 	void IdleAdd(unsigned flags);
+
+private:
+	void IdleFanOut(unsigned flags);
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override;
 };
 
 #endif
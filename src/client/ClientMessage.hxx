@@ -22,6 +22,7 @@
 
 #include "Compiler.h"
 
+#include <memory>
 #include <string>
 
 #ifdef WIN32
@@ -31,23 +32,34 @@
 #endif
 
 /**
- * A client-to-client message.
+ * A client-to-client message.  The strings are reference counted and
+ * shared by all copies, so fanning a message out to many subscribers
+ * does not copy it.
  */
 class ClientMessage {
-	std::string channel, message;
+	struct Data {
+		std::string channel, message;
+
+		template<typename T, typename U>
+		Data(T &&_channel, U &&_message)
+			:channel(std::forward<T>(_channel)),
+			 message(std::forward<U>(_message)) {}
+	};
+
+	std::shared_ptr<const Data> data;
 
 public:
 	template<typename T, typename U>
 	ClientMessage(T &&_channel, U &&_message)
-		:channel(std::forward<T>(_channel)),
-		 message(std::forward<U>(_message)) {}
+		:data(std::make_shared<const Data>(std::forward<T>(_channel),
+						   std::forward<U>(_message))) {}
 
 	const char *GetChannel() const {
-		return channel.c_str();
+		return data->channel.c_str();
 	}
 
 	const char *GetMessage() const {
-		return message.c_str();
+		return data->message.c_str();
 	}
 };
 
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientBackground.hxx"
 #include "ClientList.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
@@ -43,14 +44,20 @@ static const char GREETING[] = "OK MPD " PROTOCOL_VERSION "\n";
 
 Client::Client(EventLoop &_loop, Partition &_partition,
 	       int _fd, int _uid, int _num)
-	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size),
+	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size,
+			     &memory_client_output),
 	 TimeoutMonitor(_loop),
-	 partition(_partition),
-	 playlist(partition.playlist), player_control(partition.pc),
+	 partition(&_partition),
+	 playlist(&_partition.playlist), player_control(&_partition.pc),
 	 permission(getDefaultPermissions()),
 	 uid(_uid),
 	 num(_num),
 	 idle_waiting(false), idle_flags(0),
+	 tag_mask(~uint32_t(0)),
+#ifdef HAVE_ZLIB
+	 compressor(nullptr), compression_requested(false),
+#endif
+	 background(nullptr), producer(nullptr), response_bytes(0),
 	 num_subscriptions(0)
 {
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
@@ -108,10 +115,19 @@ client_new(EventLoop &loop, Partition &partition,
 void
 Client::Close()
 {
-	partition.instance.client_list->Remove(*this);
+	partition->instance.client_list->Remove(*this);
 
 	SetExpired();
 
 	FormatInfo(client_domain, "[%u] closed", num);
+
+	if (background != nullptr) {
+		/* a worker thread is still using this object; the
+		   BackgroundCommand deletes it when it is done */
+		TimeoutMonitor::Cancel();
+		background->OnClientClosed();
+		return;
+	}
+
 	delete this;
 }
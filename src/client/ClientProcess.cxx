@@ -19,10 +19,18 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "Partition.hxx"
 #include "protocol/Result.hxx"
 #include "command/AllCommands.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "Instance.hxx"
+#include "util/Error.hxx"
+#endif
+
 #include <string.h>
 
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
@@ -31,26 +39,70 @@
 
 static CommandResult
 client_process_command_list(Client &client, bool list_ok,
-			    std::list<std::string> &&list)
+			    std::string &list)
 {
 	CommandResult ret = CommandResult::OK;
 	unsigned num = 0;
 
-	for (auto &&i : list) {
-		char *cmd = &*i.begin();
+	/* all queue modifications of the command list result in only
+	   one new queue version and one "playlist" idle event */
+	client.GetPartition().BeginBatch();
+
+	char *const end = &list[0] + list.size();
+	for (char *cmd = &list[0], *next; cmd != end; cmd = next) {
+		/* determine the next command now, because
+		   command_process() modifies the string */
+		next = cmd + strlen(cmd) + 1;
 
 		FormatDebug(client_domain, "process command \"%s\"", cmd);
 		ret = command_process(client, num++, cmd);
-		FormatDebug(client_domain, "command returned %i", ret);
+		FormatDebug(client_domain, "command returned %i", int(ret));
 		if (ret != CommandResult::OK || client.IsExpired())
 			break;
 		else if (list_ok)
 			client_puts(client, "list_OK\n");
 	}
 
+	client.GetPartition().CommitBatch();
+
 	return ret;
 }
 
+/**
+ * Can this command be executed by a worker thread?
+ */
+static bool
+client_may_run_in_background(gcc_unused Client &client,
+			     gcc_unused const char *line)
+{
+#ifdef ENABLE_DATABASE
+	if (!command_is_background(line))
+		return false;
+
+	const Database *db = client.GetDatabase(IgnoreError());
+	return db != nullptr && db->GetPlugin().IsThreadSafe();
+#else
+	return false;
+#endif
+}
+
+/**
+ * Can this storage listing be executed by a worker thread?  Without
+ * a #Storage, "listfiles" falls back to the database, which may not
+ * be thread-safe.
+ */
+static bool
+client_may_list_in_background(gcc_unused Client &client,
+			      gcc_unused const char *line)
+{
+#ifdef ENABLE_DATABASE
+	return command_is_background_storage(line) &&
+		client.GetPartition().instance.storage != nullptr;
+#else
+	return false;
+#endif
+}
+
 CommandResult
 client_process_line(Client &client, char *line)
 {
@@ -83,14 +135,12 @@ client_process_line(Client &client, char *line)
 				    "[%u] process command list",
 				    client.num);
 
-			auto &&cmd_list = client.cmd_list.Commit();
-
 			ret = client_process_command_list(client,
 							  client.cmd_list.IsOKMode(),
-							  std::move(cmd_list));
+							  client.cmd_list.Commit());
 			FormatDebug(client_domain,
 				    "[%u] process command "
-				    "list returned %i", client.num, ret);
+				    "list returned %i", client.num, int(ret));
 
 			if (ret == CommandResult::CLOSE ||
 			    client.IsExpired())
@@ -119,6 +169,18 @@ client_process_line(Client &client, char *line)
 		} else if (strcmp(line, CLIENT_LIST_OK_MODE_BEGIN) == 0) {
 			client.cmd_list.Begin(true);
 			ret = CommandResult::OK;
+		} else if (command_is_background_queue(line)) {
+			/* modifies the queue; never cached */
+			client.StartBackground(line, false);
+			ret = CommandResult::OK;
+		} else if (client_may_run_in_background(client, line)) {
+			client.StartBackground(line, true);
+			ret = CommandResult::OK;
+		} else if (client_may_list_in_background(client, line)) {
+			/* the storage may change at any time; never
+			   cached */
+			client.StartBackground(line, false);
+			ret = CommandResult::OK;
 		} else {
 			FormatDebug(client_domain,
 				    "[%u] process command \"%s\"",
@@ -126,13 +188,15 @@ client_process_line(Client &client, char *line)
 			ret = command_process(client, 0, line);
 			FormatDebug(client_domain,
 				    "[%u] command returned %i",
-				    client.num, ret);
+				    client.num, int(ret));
 
 			if (ret == CommandResult::CLOSE ||
 			    client.IsExpired())
 				return CommandResult::CLOSE;
 
-			if (ret == CommandResult::OK)
+			if (ret == CommandResult::OK && !client.IsStreaming())
+				/* a streamed response gets its "OK"
+				   when it is complete */
 				command_success(client);
 		}
 	}
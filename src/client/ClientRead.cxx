@@ -30,47 +30,67 @@ BufferedSocket::InputResult
 Client::OnSocketInput(void *data, size_t length)
 {
 	char *p = (char *)data;
+	char *const end = p + length;
 	char *newline = (char *)memchr(p, '\n', length);
 	if (newline == nullptr)
 		return InputResult::MORE;
 
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
 
-	BufferedSocket::ConsumeInput(newline + 1 - p);
+	/* process all complete lines which are in the buffer
+	   already; this matters for clients which send many
+	   commands without waiting for the responses */
+	do {
+		char *const next = newline + 1;
+		BufferedSocket::ConsumeInput(next - p);
 
-	/* skip whitespace at the end of the line */
-	while (newline > p && IsWhitespaceOrNull(newline[-1]))
-		--newline;
+		/* skip whitespace at the end of the line */
+		while (newline > p && IsWhitespaceOrNull(newline[-1]))
+			--newline;
 
-	/* terminate the string at the end of the line */
-	*newline = 0;
+		/* terminate the string at the end of the line */
+		*newline = 0;
 
-	CommandResult result = client_process_line(*this, p);
-	switch (result) {
-	case CommandResult::OK:
-	case CommandResult::IDLE:
-	case CommandResult::ERROR:
-		break;
+		CommandResult result = client_process_line(*this, p);
+		switch (result) {
+		case CommandResult::OK:
+		case CommandResult::IDLE:
+		case CommandResult::ERROR:
+			if (IsBackground() || IsStreaming())
+				/* the command is being executed by a
+				   worker thread, or its response is
+				   still being generated; the rest of
+				   the input is processed when it has
+				   finished */
+				return InputResult::PAUSE;
 
-	case CommandResult::KILL:
-		Close();
-		partition.instance.event_loop->Break();
-		return InputResult::CLOSED;
+			EndResponse();
+			break;
 
-	case CommandResult::FINISH:
-		if (Flush())
+		case CommandResult::KILL:
 			Close();
-		return InputResult::CLOSED;
+			partition->instance.event_loop->Break();
+			return InputResult::CLOSED;
 
-	case CommandResult::CLOSE:
-		Close();
-		return InputResult::CLOSED;
-	}
+		case CommandResult::FINISH:
+			EndResponse();
+			if (!IsExpired() && Flush())
+				Close();
+			return InputResult::CLOSED;
 
-	if (IsExpired()) {
-		Close();
-		return InputResult::CLOSED;
-	}
+		case CommandResult::CLOSE:
+			Close();
+			return InputResult::CLOSED;
+		}
+
+		if (IsExpired()) {
+			Close();
+			return InputResult::CLOSED;
+		}
+
+		p = next;
+		newline = (char *)memchr(p, '\n', end - p);
+	} while (newline != nullptr);
 
 	return InputResult::AGAIN;
 }
@@ -19,9 +19,31 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
 #include "Idle.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
+#include <string.h>
+
+gcc_pure
+static bool
+ChannelLess(const std::string &a, const char *b)
+{
+	return strcmp(a.c_str(), b) < 0;
+}
+
+bool
+Client::IsSubscribed(const char *channel_name) const
+{
+	const auto i = std::lower_bound(subscriptions.begin(),
+					subscriptions.end(),
+					channel_name, ChannelLess);
+	return i != subscriptions.end() && *i == channel_name;
+}
 
 Client::SubscribeResult
 Client::Subscribe(const char *channel)
@@ -34,12 +56,16 @@ Client::Subscribe(const char *channel)
 	if (num_subscriptions >= CLIENT_MAX_SUBSCRIPTIONS)
 		return Client::SubscribeResult::FULL;
 
-	auto r = subscriptions.insert(channel);
-	if (!r.second)
+	auto i = std::lower_bound(subscriptions.begin(), subscriptions.end(),
+				  channel, ChannelLess);
+	if (i != subscriptions.end() && *i == channel)
 		return Client::SubscribeResult::ALREADY;
 
+	i = subscriptions.emplace(i, channel);
 	++num_subscriptions;
 
+	partition->instance.client_list->AddSubscriber(*i, *this);
+
 	idle_add(IDLE_SUBSCRIPTION);
 
 	return Client::SubscribeResult::OK;
@@ -48,12 +74,15 @@ Client::Subscribe(const char *channel)
 bool
 Client::Unsubscribe(const char *channel)
 {
-	const auto i = subscriptions.find(channel);
-	if (i == subscriptions.end())
+	const auto i = std::lower_bound(subscriptions.begin(),
+					subscriptions.end(),
+					channel, ChannelLess);
+	if (i == subscriptions.end() || *i != channel)
 		return false;
 
 	assert(num_subscriptions > 0);
 
+	partition->instance.client_list->RemoveSubscriber(*i, *this);
 	subscriptions.erase(i);
 	--num_subscriptions;
 
@@ -68,15 +97,21 @@ Client::Unsubscribe(const char *channel)
 void
 Client::UnsubscribeAll()
 {
-	subscriptions.clear();
+	for (const auto &channel : subscriptions)
+		partition->instance.client_list->RemoveSubscriber(channel,
+								  *this);
+
+	/* swap with an empty vector to actually free the memory */
+	std::vector<std::string>().swap(subscriptions);
 	num_subscriptions = 0;
 }
 
 bool
 Client::PushMessage(const ClientMessage &msg)
 {
-	if (messages.size() >= CLIENT_MAX_MESSAGES ||
-	    !IsSubscribed(msg.GetChannel()))
+	assert(IsSubscribed(msg.GetChannel()));
+
+	if (messages.size() >= client_max_messages)
 		return false;
 
 	if (messages.empty())
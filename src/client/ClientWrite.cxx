@@ -19,14 +19,136 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientBackground.hxx"
+#include "ResponseProducer.hxx"
+#include "protocol/Result.hxx"
 #include "util/FormatString.hxx"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
-/**
- * Write a block of data to the client.
- */
-static void
+bool
+Client::Write(const void *data, size_t length)
+{
+	response_bytes += length;
+
+	if (background != nullptr)
+		return background->Write(data, length);
+
+	return WriteOutput(data, length);
+}
+
+bool
+Client::WriteOutput(const void *data, size_t length)
+{
+#ifdef HAVE_ZLIB
+	if (compressor != nullptr)
+		return WriteCompressed(data, length, Z_NO_FLUSH);
+#endif
+
+	return FullyBufferedSocket::Write(data, length);
+}
+
+void
+Client::EndResponse()
+{
+#ifdef HAVE_ZLIB
+	if (IsExpired())
+		return;
+
+	if (compressor != nullptr &&
+	    !WriteCompressed(nullptr, 0, Z_SYNC_FLUSH))
+		return;
+
+	if (compression_requested && compressor == nullptr)
+		EnableCompression();
+	else if (!compression_requested && compressor != nullptr)
+		DisableCompression();
+#endif
+}
+
+bool
+Client::RunProducer()
+{
+	assert(producer != nullptr);
+
+	while (!IsOutputCongested())
+		if (!producer->Produce(*this) || IsExpired())
+			return true;
+
+	return false;
+}
+
+void
+Client::DeleteProducer()
+{
+	delete producer;
+	producer = nullptr;
+}
+
+void
+Client::StartResponse(ResponseProducer *_producer)
+{
+	assert(producer == nullptr);
+
+	if (background != nullptr || cmd_list.IsActive()) {
+		/* the response must be complete when the command
+		   handler returns */
+		while (_producer->Produce(*this) && !IsExpired()) {}
+		delete _producer;
+		return;
+	}
+
+	producer = _producer;
+	if (RunProducer())
+		DeleteProducer();
+	else
+		/* continue in OnOutputAvailable() */
+		WaitOutputAvailable();
+}
+
+bool
+Client::OnOutputAvailable()
+{
+	if (background != nullptr) {
+		/* hand over more output of the background command */
+		background->OnOutputAvailable();
+		return true;
+	}
+
+	if (producer == nullptr)
+		return true;
+
+	/* the client is reading; don't let it time out while the
+	   response is being generated */
+	TimeoutMonitor::ScheduleSeconds(client_timeout);
+
+	if (!RunProducer()) {
+		WaitOutputAvailable();
+		return true;
+	}
+
+	DeleteProducer();
+
+	if (IsExpired())
+		return false;
+
+	command_success(*this);
+	EndResponse();
+	if (IsExpired())
+		return false;
+
+	/* process the input which has arrived in the meantime; this
+	   may close and delete the client */
+	return ResumeInput();
+}
+
+void
 client_write(Client &client, const char *data, size_t length)
 {
 	/* if the client is going to be closed, do nothing */
@@ -45,6 +167,26 @@ client_puts(Client &client, const char *s)
 void
 client_vprintf(Client &client, const char *fmt, va_list args)
 {
+	if (client.IsExpired())
+		return;
+
+	/* try to format directly into the output buffer; this
+	   avoids a heap allocation for each line */
+	const auto w = client.PrepareWrite();
+	if (!w.IsEmpty()) {
+		va_list ap;
+		va_copy(ap, args);
+		const int length = vsnprintf((char *)w.data, w.size, fmt, ap);
+		va_end(ap);
+
+		if (length >= 0 && size_t(length) < w.size) {
+			client.CommitWrite(length);
+			return;
+		}
+	}
+
+	/* not enough room left in the buffer, or formatting failed:
+	   fall back to a temporary allocation */
 	char *p = FormatNewV(fmt, args);
 	client_write(client, p, strlen(p));
 	delete[] p;
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ResponseCache.hxx"
+
+#include <iterator>
+
+#include <assert.h>
+
+/**
+ * The maximum total size of all cached responses.
+ */
+static constexpr size_t CLIENT_RESPONSE_CACHE_SIZE = 8 * 1024 * 1024;
+
+ResponseCache client_response_cache(CLIENT_RESPONSE_CACHE_SIZE);
+
+const std::string *
+ResponseCache::Get(const std::string &key)
+{
+	auto i = map.find(key);
+	if (i == map.end())
+		return nullptr;
+
+	/* move to the front */
+	items.splice(items.begin(), items, i->second);
+	return &i->second->value;
+}
+
+void
+ResponseCache::Put(unsigned _generation, std::string &&key,
+		   std::string &&value)
+{
+	if (_generation != generation)
+		/* the database has been modified meanwhile */
+		return;
+
+	const size_t item_size = key.length() + value.length();
+	if (!IsCacheable(item_size))
+		return;
+
+	auto old = map.find(key);
+	if (old != map.end())
+		Remove(old->second);
+
+	while (size + item_size > max_size) {
+		assert(!items.empty());
+		Remove(std::prev(items.end()));
+	}
+
+	items.emplace_front(std::move(key), std::move(value));
+	map.emplace(items.front().key, items.begin());
+	size += item_size;
+}
+
+void
+ResponseCache::Clear()
+{
+	++generation;
+	map.clear();
+	items.clear();
+	size = 0;
+}
+
+void
+ResponseCache::Remove(std::list<Item>::iterator i)
+{
+	size -= i->key.length() + i->value.length();
+	map.erase(i->key);
+	items.erase(i);
+}
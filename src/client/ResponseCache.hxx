@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_RESPONSE_CACHE_HXX
+#define MPD_CLIENT_RESPONSE_CACHE_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <string>
+#include <list>
+#include <unordered_map>
+
+#include <stddef.h>
+
+/**
+ * A bounded cache of serialised responses to read-only database
+ * commands, shared by all clients.  Entries are dropped in LRU order
+ * when the cache is full, and all of them are dropped when the
+ * database is modified.  It is only used by the main thread.
+ */
+class ResponseCache {
+	struct Item {
+		std::string key, value;
+
+		Item(std::string &&_key, std::string &&_value)
+			:key(std::move(_key)), value(std::move(_value)) {}
+	};
+
+	/**
+	 * All items, the most recently used one first.
+	 */
+	std::list<Item> items;
+
+	std::unordered_map<std::string, std::list<Item>::iterator> map;
+
+	/**
+	 * The sum of all keys and values in #items.
+	 */
+	size_t size;
+
+	const size_t max_size;
+
+	/**
+	 * Incremented by Clear().  Responses which were generated
+	 * while an older generation was current are not stored.
+	 */
+	unsigned generation;
+
+public:
+	explicit ResponseCache(size_t _max_size)
+		:size(0), max_size(_max_size), generation(0) {}
+
+	ResponseCache(const ResponseCache &) = delete;
+	ResponseCache &operator=(const ResponseCache &) = delete;
+
+	unsigned GetGeneration() const {
+		return generation;
+	}
+
+	/**
+	 * Is a response of this size small enough to be cached?
+	 */
+	bool IsCacheable(size_t length) const {
+		return length <= max_size / 4;
+	}
+
+	/**
+	 * Look up a response.
+	 *
+	 * @return the response or nullptr if it is not cached
+	 */
+	const std::string *Get(const std::string &key);
+
+	/**
+	 * Store a response.
+	 *
+	 * @param _generation the value of GetGeneration() when the
+	 * command was started
+	 */
+	void Put(unsigned _generation, std::string &&key, std::string &&value);
+
+	/**
+	 * Drop all items, because the database has been modified.
+	 */
+	void Clear();
+
+private:
+	void Remove(std::list<Item>::iterator i);
+};
+
+/**
+ * The response cache used by all clients.
+ */
+extern ResponseCache client_response_cache;
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_RESPONSE_PRODUCER_HXX
+#define MPD_CLIENT_RESPONSE_PRODUCER_HXX
+
+class Client;
+
+/**
+ * Generates a large response in small portions.  The #Client calls
+ * Produce() only while its output buffer has room, and continues
+ * when the socket has drained, so the response never needs to be
+ * buffered completely.  See Client::StartResponse().
+ */
+class ResponseProducer {
+public:
+	virtual ~ResponseProducer() {}
+
+	/**
+	 * Write the next portion of the response (e.g. one song).
+	 *
+	 * @return false if the response is complete
+	 */
+	virtual bool Produce(Client &client) = 0;
+};
+
+#endif
@@ -29,6 +29,7 @@
 #include "OutputCommands.hxx"
 #include "MessageCommands.hxx"
 #include "NeighborCommands.hxx"
+#include "PartitionCommands.hxx"
 #include "OtherCommands.hxx"
 #include "Permission.hxx"
 #include "tag/TagType.h"
@@ -37,6 +38,16 @@
 #include "client/Client.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "system/Clock.hxx"
+#include "Metrics.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
 
 #ifdef ENABLE_SQLITE
 #include "StickerCommands.hxx"
@@ -44,6 +55,8 @@
 #endif
 
 #include <assert.h>
+#include <string>
+
 #include <string.h>
 
 /*
@@ -85,6 +98,7 @@ static const struct command commands[] = {
 	{ "cleartagid", PERMISSION_ADD, 1, 2, handle_cleartagid },
 	{ "close", PERMISSION_NONE, -1, -1, handle_close },
 	{ "commands", PERMISSION_NONE, 0, 0, handle_commands },
+	{ "compress", PERMISSION_NONE, 1, 1, handle_compress },
 	{ "config", PERMISSION_ADMIN, 0, 0, handle_config },
 	{ "consume", PERMISSION_CONTROL, 1, 1, handle_consume },
 #ifdef ENABLE_DATABASE
@@ -98,6 +112,7 @@ static const struct command commands[] = {
 	{ "disableoutput", PERMISSION_ADMIN, 1, 1, handle_disableoutput },
 	{ "enableoutput", PERMISSION_ADMIN, 1, 1, handle_enableoutput },
 #ifdef ENABLE_DATABASE
+	{ "execute", PERMISSION_READ, 1, 1, handle_execute },
 	{ "find", PERMISSION_READ, 2, -1, handle_find },
 	{ "findadd", PERMISSION_ADD, 2, -1, handle_findadd},
 #endif
@@ -115,11 +130,14 @@ static const struct command commands[] = {
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	{ "listneighbors", PERMISSION_READ, 0, 0, handle_listneighbors },
 #endif
+	{ "listpartitions", PERMISSION_READ, 0, 0, handle_listpartitions },
 	{ "listplaylist", PERMISSION_READ, 1, 1, handle_listplaylist },
 	{ "listplaylistinfo", PERMISSION_READ, 1, 1, handle_listplaylistinfo },
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 2, handle_load },
 	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
+	{ "memory", PERMISSION_READ, 0, 0, handle_memory },
+	{ "metrics", PERMISSION_READ, 0, 0, handle_metrics },
 	{ "mixrampdb", PERMISSION_CONTROL, 1, 1, handle_mixrampdb },
 	{ "mixrampdelay", PERMISSION_CONTROL, 1, 1, handle_mixrampdelay },
 #ifdef ENABLE_DATABASE
@@ -130,6 +148,7 @@ static const struct command commands[] = {
 	{ "next", PERMISSION_CONTROL, 0, 0, handle_next },
 	{ "notcommands", PERMISSION_NONE, 0, 0, handle_not_commands },
 	{ "outputs", PERMISSION_READ, 0, 0, handle_devices },
+	{ "partition", PERMISSION_READ, 1, 1, handle_partition },
 	{ "password", PERMISSION_NONE, 1, 1, handle_password },
 	{ "pause", PERMISSION_CONTROL, 0, 1, handle_pause },
 	{ "ping", PERMISSION_NONE, 0, 0, handle_ping },
@@ -141,11 +160,14 @@ static const struct command commands[] = {
 	{ "playlistdelete", PERMISSION_CONTROL, 2, 2, handle_playlistdelete },
 	{ "playlistfind", PERMISSION_READ, 2, -1, handle_playlistfind },
 	{ "playlistid", PERMISSION_READ, 0, 1, handle_playlistid },
-	{ "playlistinfo", PERMISSION_READ, 0, 1, handle_playlistinfo },
+	{ "playlistinfo", PERMISSION_READ, 0, -1, handle_playlistinfo },
 	{ "playlistmove", PERMISSION_CONTROL, 3, 3, handle_playlistmove },
 	{ "playlistsearch", PERMISSION_READ, 2, -1, handle_playlistsearch },
 	{ "plchanges", PERMISSION_READ, 1, 1, handle_plchanges },
 	{ "plchangesposid", PERMISSION_READ, 1, 1, handle_plchangesposid },
+#ifdef ENABLE_DATABASE
+	{ "prepare", PERMISSION_READ, 4, -1, handle_prepare },
+#endif
 	{ "previous", PERMISSION_CONTROL, 0, 0, handle_previous },
 	{ "prio", PERMISSION_CONTROL, 2, -1, handle_prio },
 	{ "prioid", PERMISSION_CONTROL, 2, -1, handle_prioid },
@@ -182,10 +204,12 @@ static const struct command commands[] = {
 	{ "subscribe", PERMISSION_READ, 1, 1, handle_subscribe },
 	{ "swap", PERMISSION_CONTROL, 2, 2, handle_swap },
 	{ "swapid", PERMISSION_CONTROL, 2, 2, handle_swapid },
-	{ "tagtypes", PERMISSION_READ, 0, 0, handle_tagtypes },
+	{ "tagtypes", PERMISSION_READ, 0, -1, handle_tagtypes },
 	{ "toggleoutput", PERMISSION_ADMIN, 1, 1, handle_toggleoutput },
+	{ "tracedump", PERMISSION_ADMIN, 0, 0, handle_tracedump },
 #ifdef ENABLE_DATABASE
 	{ "unmount", PERMISSION_ADMIN, 1, 1, handle_unmount },
+	{ "unprepare", PERMISSION_READ, 1, 1, handle_unprepare },
 #endif
 	{ "unsubscribe", PERMISSION_READ, 1, 1, handle_unsubscribe },
 	{ "update", PERMISSION_CONTROL, 0, 1, handle_update },
@@ -195,6 +219,36 @@ static const struct command commands[] = {
 
 static const unsigned num_commands = sizeof(commands) / sizeof(commands[0]);
 
+/**
+ * Aggregated statistics of one command; see command_visit_metrics().
+ */
+struct CommandStats {
+	MetricHistogram duration;
+
+	/**
+	 * The total time spent waiting for #db_mutex.
+	 */
+	MetricCounter lock_wait_us;
+
+	MetricCounter response_bytes;
+
+	/**
+	 * The number of invocations which exceeded
+	 * #slow_command_threshold_us.
+	 */
+	MetricCounter slow;
+};
+
+static CommandStats command_stats[num_commands];
+
+static constexpr Domain slow_command_domain("slow_command");
+
+/**
+ * Commands which take at least this many microseconds are logged.
+ * 0 disables the slow command log.
+ */
+static uint64_t slow_command_threshold_us;
+
 static bool
 command_available(gcc_unused const Partition &partition,
 		  gcc_unused const struct command *cmd)
@@ -224,7 +278,7 @@ handle_commands(Client &client,
 		cmd = &commands[i];
 
 		if (cmd->permission == (permission & cmd->permission) &&
-		    command_available(client.partition, cmd))
+		    command_available(client.GetPartition(), cmd))
 			client_printf(client, "command: %s\n", cmd->cmd);
 	}
 
@@ -255,6 +309,10 @@ void command_init(void)
 	for (unsigned i = 0; i < num_commands - 1; ++i)
 		assert(strcmp(commands[i].cmd, commands[i + 1].cmd) < 0);
 #endif
+
+	slow_command_threshold_us =
+		uint64_t(config_get_unsigned(CONF_SLOW_COMMAND_THRESHOLD, 0))
+		* 1000;
 }
 
 void command_finish(void)
@@ -283,6 +341,83 @@ command_lookup(const char *name)
 	return nullptr;
 }
 
+/**
+ * Does the command name in the given line appear in the (sorted)
+ * list?
+ */
+template<size_t N>
+gcc_pure
+static bool
+command_in_list(const char *line, const char *const (&list)[N])
+{
+	const char *end = line;
+	while (*end != 0 && *end != ' ' && *end != '\t')
+		++end;
+
+	const size_t length = end - line;
+	for (const char *name : list) {
+		const int cmp = strncmp(line, name, length);
+		if (cmp == 0 && name[length] == 0)
+			return true;
+		if (cmp < 0)
+			break;
+	}
+
+	return false;
+}
+
+bool
+command_is_background(gcc_unused const char *line)
+{
+#ifdef ENABLE_DATABASE
+	/* must be sorted */
+	static constexpr const char *background_commands[] = {
+		"count",
+		"find",
+		"list",
+		"listall",
+		"listallinfo",
+		"search",
+	};
+
+	return command_in_list(line, background_commands);
+#else
+	return false;
+#endif
+}
+
+bool
+command_is_background_queue(const char *line)
+{
+	/* must be sorted */
+	static constexpr const char *background_queue_commands[] = {
+#ifdef ENABLE_DATABASE
+		"findadd",
+#endif
+		"load",
+#ifdef ENABLE_DATABASE
+		"searchadd",
+#endif
+	};
+
+	return command_in_list(line, background_queue_commands);
+}
+
+bool
+command_is_background_storage(gcc_unused const char *line)
+{
+#ifdef ENABLE_DATABASE
+	/* must be sorted */
+	static constexpr const char *background_storage_commands[] = {
+		"listfiles",
+	};
+
+	return command_in_list(line, background_storage_commands);
+#else
+	return false;
+#endif
+}
+
 static bool
 command_check_request(const struct command *cmd, Client &client,
 		      unsigned permission, unsigned argc, char *argv[])
@@ -343,6 +478,81 @@ command_checked_lookup(Client &client, unsigned permission,
 	return cmd;
 }
 
+/**
+ * Update the statistics after a command has finished, and log it if
+ * it was slow.
+ */
+static void
+command_account(const Client &client, const struct command &cmd,
+		unsigned argc, char *const argv[],
+		uint64_t duration_us, uint64_t lock_wait_us,
+		uint64_t response_bytes)
+{
+	metric_command_latency.Observe(duration_us);
+	metric_commands.Add();
+
+	CommandStats &stats = command_stats[&cmd - commands];
+	stats.duration.Observe(duration_us);
+	stats.lock_wait_us.Add(lock_wait_us);
+	stats.response_bytes.Add(response_bytes);
+
+	if (slow_command_threshold_us == 0 ||
+	    duration_us < slow_command_threshold_us)
+		return;
+
+	stats.slow.Add();
+
+	/* reconstruct the command line, but never log passwords */
+	std::string line(cmd.cmd);
+	if (strcmp(cmd.cmd, "password") != 0) {
+		for (unsigned i = 1; i < argc && line.length() < 256; ++i) {
+			line.append(" \"");
+			line.append(argv[i]);
+			line.push_back('"');
+		}
+	}
+
+	FormatWarning(slow_command_domain,
+		      "[%u] %s: %u ms, %u ms waiting for the database lock, "
+		      "%llu response bytes",
+		      client.num, line.c_str(),
+		      unsigned(duration_us / 1000),
+		      unsigned(lock_wait_us / 1000),
+		      (unsigned long long)response_bytes);
+}
+
+void
+command_visit_metrics(MetricsVisitor &visitor)
+{
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (command_stats[i].duration.GetCount() > 0)
+			visitor.OnHistogram("command_duration_us",
+					    "Execution time of a command",
+					    MetricLabel("command", commands[i].cmd),
+					    command_stats[i].duration);
+
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (command_stats[i].duration.GetCount() > 0)
+			visitor.OnCounter("command_lock_wait_us",
+					  "Time a command has waited for the database lock",
+					  MetricLabel("command", commands[i].cmd),
+					  command_stats[i].lock_wait_us.Get());
+
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (command_stats[i].duration.GetCount() > 0)
+			visitor.OnCounter("command_response_bytes",
+					  "Response bytes written by a command",
+					  MetricLabel("command", commands[i].cmd),
+					  command_stats[i].response_bytes.Get());
+
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (command_stats[i].slow.Get() > 0)
+			visitor.OnCounter("command_slow",
+					  "Number of slow command invocations",
+					  MetricLabel("command", commands[i].cmd),
+					  command_stats[i].slow.Get());
+}
+
 CommandResult
 command_process(Client &client, unsigned num, char *line)
 {
@@ -401,9 +611,25 @@ command_process(Client &client, unsigned num, char *line)
 
 	cmd = command_checked_lookup(client, client.GetPermission(),
 				     argc, argv);
-	if (cmd)
+	if (cmd) {
+		const uint64_t start = MonotonicClockUS();
+#ifdef ENABLE_DATABASE
+		const uint64_t wait_start = db_mutex_wait_us;
+#endif
+		const uint64_t bytes_start = client.response_bytes;
+
 		ret = cmd->handler(client, argc, argv);
 
+		command_account(client, *cmd, argc, argv,
+				MonotonicClockUS() - start,
+#ifdef ENABLE_DATABASE
+				db_mutex_wait_us - wait_start,
+#else
+				0,
+#endif
+				client.response_bytes - bytes_start);
+	}
+
 	current_command = nullptr;
 	command_list_num = 0;
 
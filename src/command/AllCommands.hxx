@@ -21,8 +21,10 @@
 #define MPD_ALL_COMMANDS_HXX
 
 #include "CommandResult.hxx"
+#include "Compiler.h"
 
 class Client;
+class MetricsVisitor;
 
 void command_init(void);
 
@@ -31,4 +33,39 @@ void command_finish(void);
 CommandResult
 command_process(Client &client, unsigned num, char *line);
 
+/**
+ * Visit the per-command statistics (duration, database lock wait
+ * time, response size) of all commands which have been executed.
+ */
+void
+command_visit_metrics(MetricsVisitor &visitor);
+
+/**
+ * May this command line be executed by a worker thread?  This is
+ * true for commands which only read the database and do not touch
+ * any other state.
+ */
+gcc_pure
+bool
+command_is_background(const char *line);
+
+/**
+ * May this command line be executed by a worker thread, which
+ * modifies the queue through BackgroundCommand::CallMain()?  This is
+ * true for commands which spend most of their time reading input
+ * before modifying the queue, e.g. "load".
+ */
+gcc_pure
+bool
+command_is_background_queue(const char *line);
+
+/**
+ * May this command line be executed by a worker thread if there is a
+ * #Storage?  This is true for commands which list (possibly remote)
+ * storage directories, e.g. "listfiles".
+ */
+gcc_pure
+bool
+command_is_background_storage(const char *line);
+
 #endif
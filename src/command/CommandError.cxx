@@ -116,6 +116,11 @@ print_error(Client &client, const Error &error)
 		case DB_CONFLICT:
 			command_error(client, ACK_ERROR_ARG, "Conflict");
 			return CommandResult::ERROR;
+
+		case DB_LOADING:
+			command_error(client, ACK_ERROR_SYSTEM, "%s",
+				      error.GetMessage());
+			return CommandResult::ERROR;
 		}
 #endif
 	} else if (error.IsDomain(errno_domain)) {
@@ -23,21 +23,30 @@
 
 #include <string.h>
 
+/**
+ * Keep the buffer for the next command list only up to this size.
+ */
+static constexpr size_t MAX_KEEP_SIZE = 64 * 1024;
+
 void
 CommandListBuilder::Reset()
 {
-	list.clear();
+	if (list.capacity() > MAX_KEEP_SIZE)
+		std::string().swap(list);
+	else
+		list.clear();
+
 	mode = Mode::DISABLED;
 }
 
 bool
 CommandListBuilder::Add(const char *cmd)
 {
+	/* including the null terminator */
 	size_t len = strlen(cmd) + 1;
-	size += len;
-	if (size > client_max_command_list_size)
+	if (list.size() + len > client_max_command_list_size)
 		return false;
 
-	list.emplace_back(cmd);
+	list.append(cmd, len);
 	return true;
 }
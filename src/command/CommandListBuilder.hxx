@@ -20,7 +20,6 @@
 #ifndef MPD_COMMAND_LIST_BUILDER_HXX
 #define MPD_COMMAND_LIST_BUILDER_HXX
 
-#include <list>
 #include <string>
 
 #include <assert.h>
@@ -47,18 +46,15 @@ class CommandListBuilder {
 	} mode;
 
 	/**
-	 * for when in list mode
+	 * for when in list mode: the commands, each one
+	 * null-terminated, stored one after another in one buffer
+	 * (which is reused for the next list)
 	 */
-	std::list<std::string> list;
-
-	/**
-	 * Memory consumed by the list.
-	 */
-	size_t size;
+	std::string list;
 
 public:
 	CommandListBuilder()
-		:mode(Mode::DISABLED), size(0) {}
+		:mode(Mode::DISABLED) {}
 
 	/**
 	 * Is a command list currently being built?
@@ -97,12 +93,14 @@ public:
 	bool Add(const char *cmd);
 
 	/**
-	 * Finishes the list and returns it.
+	 * Finishes the list and returns it; see #list for the
+	 * format.  The buffer is owned by this object and remains
+	 * valid until Reset() is called.
 	 */
-	std::list<std::string> &&Commit() {
+	std::string &Commit() {
 		assert(IsActive());
 
-		return std::move(list);
+		return list;
 	}
 };
 
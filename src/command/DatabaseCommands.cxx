@@ -27,12 +27,20 @@
 #include "db/Selection.hxx"
 #include "CommandError.hxx"
 #include "client/Client.hxx"
+#include "client/ClientInternal.hxx"
+#include "client/ClientBackground.hxx"
 #include "tag/Tag.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
 #include "SongFilter.hxx"
+#include "SortWindow.hxx"
 #include "protocol/Result.hxx"
 
+#ifdef ENABLE_SQLITE
+#include "sticker/StickerQuery.hxx"
+#include "sticker/StickerDatabase.hxx"
+#endif
+
 #include <string.h>
 
 CommandResult
@@ -64,21 +72,99 @@ handle_lsinfo2(Client &client, unsigned argc, char *argv[])
 	return CommandResult::OK;
 }
 
+#ifdef ENABLE_SQLITE
+
+/**
+ * Parse the arguments of "find"/"search": tag/value pairs for the
+ * #SongFilter, mixed with sticker expressions for the #StickerQuery.
+ */
+static bool
+ParseMatch(SongFilter &filter, StickerQuery &stickers,
+	   ConstBuffer<const char *> args, bool fold_case)
+{
+	while (!args.IsEmpty()) {
+		const int n = stickers.Parse(args);
+		if (n < 0)
+			return false;
+
+		if (n > 0) {
+			args.data += n;
+			args.size -= n;
+			continue;
+		}
+
+		if (args.size < 2 ||
+		    !filter.Parse(args[0], args[1], fold_case))
+			return false;
+
+		args.data += 2;
+		args.size -= 2;
+	}
+
+	return true;
+}
+
+static CommandResult
+handle_match_stickers(Client &client, const DatabaseSelection &selection,
+		      StickerQuery &stickers)
+{
+	if (!sticker_enabled()) {
+		command_error(client, ACK_ERROR_UNKNOWN,
+			      "sticker database is disabled");
+		return CommandResult::ERROR;
+	}
+
+	if (!stickers.Load()) {
+		command_error(client, ACK_ERROR_SYSTEM,
+			      "failed to load stickers");
+		return CommandResult::ERROR;
+	}
+
+	Error error;
+	return db_selection_print_stickers(client, selection, stickers, error)
+		? CommandResult::OK
+		: print_error(client, error);
+}
+
+#endif
+
 static CommandResult
 handle_match(Client &client, unsigned argc, char *argv[], bool fold_case)
 {
 	ConstBuffer<const char *> args(argv + 1, argc - 1);
 
+	SortWindow sw;
 	SongFilter filter;
-	if (!filter.Parse(args, fold_case)) {
+#ifdef ENABLE_SQLITE
+	StickerQuery stickers;
+	if (!sw.ParseTrailing(args) ||
+	    !ParseMatch(filter, stickers, args, fold_case)) {
+#else
+	if (!sw.ParseTrailing(args) || !filter.Parse(args, fold_case)) {
+#endif
 		command_error(client, ACK_ERROR_ARG, "incorrect arguments");
 		return CommandResult::ERROR;
 	}
 
 	const DatabaseSelection selection("", true, &filter);
 
+#ifdef ENABLE_SQLITE
+	if (!stickers.IsEmpty()) {
+		if (sw.IsDefined()) {
+			command_error(client, ACK_ERROR_ARG,
+				      "sort/window cannot be combined with stickers");
+			return CommandResult::ERROR;
+		}
+
+		return handle_match_stickers(client, selection, stickers);
+	}
+#endif
+
 	Error error;
-	return db_selection_print(client, selection, true, false, error)
+	const bool success = sw.IsDefined()
+		? db_selection_print(client, selection, sw, error)
+		: db_selection_print(client, selection, true, false, error);
+	return success
 		? CommandResult::OK
 		: print_error(client, error);
 }
@@ -108,11 +194,94 @@ handle_match_add(Client &client, unsigned argc, char *argv[], bool fold_case)
 
 	const DatabaseSelection selection("", true, &filter);
 	Error error;
-	return AddFromDatabase(client.partition, selection, error)
+
+	bool success;
+	if (client.IsBackground()) {
+		/* we're in a worker thread; the queue is modified by
+		   the main thread */
+		BackgroundCommand &background = *client.background;
+		const MainThreadCall call =
+			[&background](const std::function<void()> &f){
+				return background.CallMain(f);
+			};
+
+		success = AddFromDatabaseAsync(client.GetPartition(),
+					       selection, call, error);
+	} else
+		success = AddFromDatabase(client.GetPartition(), selection,
+					  error);
+
+	return success
+		? CommandResult::OK
+		: print_error(client, error);
+}
+
+CommandResult
+handle_prepare(Client &client, unsigned argc, char *argv[])
+{
+	ConstBuffer<const char *> args(argv + 1, argc - 1);
+	const char *name = args.shift();
+	const char *type = args.shift();
+
+	bool fold_case;
+	if (strcmp(type, "find") == 0)
+		fold_case = false;
+	else if (strcmp(type, "search") == 0)
+		fold_case = true;
+	else {
+		command_error(client, ACK_ERROR_ARG,
+			      "Unknown query type: %s", type);
+		return CommandResult::ERROR;
+	}
+
+	auto &prepared = client.prepared_filters;
+	if (prepared.size() >= CLIENT_MAX_PREPARED &&
+	    prepared.find(name) == prepared.end()) {
+		command_error(client, ACK_ERROR_ARG,
+			      "Too many prepared queries");
+		return CommandResult::ERROR;
+	}
+
+	SongFilter filter;
+	if (!filter.Parse(args, fold_case)) {
+		command_error(client, ACK_ERROR_ARG, "incorrect arguments");
+		return CommandResult::ERROR;
+	}
+
+	prepared[name] = std::move(filter);
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_execute(Client &client, gcc_unused unsigned argc, char *argv[])
+{
+	const auto i = client.prepared_filters.find(argv[1]);
+	if (i == client.prepared_filters.end()) {
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "No such prepared query");
+		return CommandResult::ERROR;
+	}
+
+	const DatabaseSelection selection("", true, &i->second);
+
+	Error error;
+	return db_selection_print(client, selection, true, false, error)
 		? CommandResult::OK
 		: print_error(client, error);
 }
 
+CommandResult
+handle_unprepare(Client &client, gcc_unused unsigned argc, char *argv[])
+{
+	if (client.prepared_filters.erase(argv[1]) == 0) {
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "No such prepared query");
+		return CommandResult::ERROR;
+	}
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_findadd(Client &client, unsigned argc, char *argv[])
 {
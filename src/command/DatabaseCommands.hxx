@@ -48,6 +48,15 @@ handle_searchaddpl(Client &client, unsigned argc, char *argv[]);
 CommandResult
 handle_count(Client &client, unsigned argc, char *argv[]);
 
+CommandResult
+handle_prepare(Client &client, unsigned argc, char *argv[]);
+
+CommandResult
+handle_execute(Client &client, unsigned argc, char *argv[]);
+
+CommandResult
+handle_unprepare(Client &client, unsigned argc, char *argv[]);
+
 CommandResult
 handle_listall(Client &client, unsigned argc, char *argv[]);
 
@@ -25,7 +25,6 @@
 #include "Partition.hxx"
 #include "protocol/Result.hxx"
 
-#include <set>
 #include <string>
 
 #include <assert.h>
@@ -80,13 +79,11 @@ handle_channels(Client &client,
 {
 	assert(argc == 1);
 
-	std::set<std::string> channels;
-	for (const auto &c : *client.partition.instance.client_list)
-		channels.insert(c.subscriptions.begin(),
-				c.subscriptions.end());
-
-	for (const auto &channel : channels)
-		client_printf(client, "channel: %s\n", channel.c_str());
+	const ClientList &list = *client.GetPartition().instance.client_list;
+	list.VisitChannels([&client](const std::string &channel){
+			client_printf(client, "channel: %s\n",
+				      channel.c_str());
+		});
 
 	return CommandResult::OK;
 }
@@ -120,13 +117,18 @@ handle_send_message(Client &client,
 		return CommandResult::ERROR;
 	}
 
-	bool sent = false;
 	const ClientMessage msg(argv[1], argv[2]);
-	for (auto &c : *client.partition.instance.client_list)
-		if (c.PushMessage(msg))
-			sent = true;
-
-	if (sent)
+	const auto result =
+		client.GetPartition().instance.client_list->SendMessage(msg);
+
+	if (result.full > 0) {
+		/* tell the sender to slow down instead of dropping
+		   messages silently */
+		command_error(client, ACK_ERROR_SYSTEM,
+			      "message queue full for %u of %u subscribers",
+			      result.full, result.sent + result.full);
+		return CommandResult::ERROR;
+	} else if (result.sent > 0)
 		return CommandResult::OK;
 	else {
 		command_error(client, ACK_ERROR_NO_EXIST,
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "OtherCommands.hxx"
+#include "AllCommands.hxx"
 #include "FileCommands.hxx"
 #include "StorageCommands.hxx"
 #include "CommandError.hxx"
@@ -29,6 +30,7 @@
 #include "TagPrint.hxx"
 #include "TagStream.hxx"
 #include "tag/TagHandler.hxx"
+#include "tag/Tag.hxx"
 #include "TimePrint.hxx"
 #include "decoder/DecoderPrint.hxx"
 #include "protocol/ArgParser.hxx"
@@ -39,6 +41,10 @@
 #include "util/Error.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "Stats.hxx"
+#include "Metrics.hxx"
+#include "MemoryBudget.hxx"
+#include "util/MemoryAccount.hxx"
+#include "Trace.hxx"
 #include "Permission.hxx"
 #include "PlaylistFile.hxx"
 #include "db/PlaylistVector.hxx"
@@ -50,6 +56,7 @@
 #ifdef ENABLE_DATABASE
 #include "DatabaseCommands.hxx"
 #include "db/update/Service.hxx"
+#include "db/Interface.hxx"
 #endif
 
 #include <assert.h>
@@ -84,11 +91,62 @@ handle_decoders(Client &client,
 	return CommandResult::OK;
 }
 
+/**
+ * Parse a list of tag names into a bit mask.
+ */
+static bool
+parse_tag_mask(Client &client, unsigned argc, char *argv[], uint32_t &mask_r)
+{
+	static_assert(sizeof(mask_r) * 8 >= TAG_NUM_OF_ITEM_TYPES,
+		      "Mask is too small");
+
+	uint32_t mask = 0;
+
+	for (unsigned i = 0; i < argc; ++i) {
+		const TagType type = tag_name_parse_i(argv[i]);
+		if (type == TAG_NUM_OF_ITEM_TYPES) {
+			command_error(client, ACK_ERROR_ARG,
+				      "Unknown tag type: %s", argv[i]);
+			return false;
+		}
+
+		mask |= 1u << type;
+	}
+
+	mask_r = mask;
+	return true;
+}
+
 CommandResult
-handle_tagtypes(Client &client,
-		gcc_unused unsigned argc, gcc_unused char *argv[])
+handle_tagtypes(Client &client, unsigned argc, char *argv[])
 {
-	tag_print_types(client);
+	if (argc == 1) {
+		tag_print_types(client);
+		return CommandResult::OK;
+	}
+
+	const char *const cmd = argv[1];
+	uint32_t mask;
+
+	if (argc == 2 && strcmp(cmd, "all") == 0) {
+		client.tag_mask = ~uint32_t(0);
+	} else if (argc == 2 && strcmp(cmd, "clear") == 0) {
+		client.tag_mask = 0;
+	} else if (argc > 2 && strcmp(cmd, "enable") == 0) {
+		if (!parse_tag_mask(client, argc - 2, argv + 2, mask))
+			return CommandResult::ERROR;
+
+		client.tag_mask |= mask;
+	} else if (argc > 2 && strcmp(cmd, "disable") == 0) {
+		if (!parse_tag_mask(client, argc - 2, argv + 2, mask))
+			return CommandResult::ERROR;
+
+		client.tag_mask &= ~mask;
+	} else {
+		command_error(client, ACK_ERROR_ARG, "Unknown sub command");
+		return CommandResult::ERROR;
+	}
+
 	return CommandResult::OK;
 }
 
@@ -106,6 +164,30 @@ handle_close(gcc_unused Client &client,
 	return CommandResult::FINISH;
 }
 
+CommandResult
+handle_compress(Client &client, gcc_unused unsigned argc, char *argv[])
+{
+	const char *const mode = argv[1];
+
+#ifdef HAVE_ZLIB
+	if (strcmp(mode, "deflate") == 0) {
+		client.compression_requested = true;
+		return CommandResult::OK;
+	}
+#endif
+
+	if (strcmp(mode, "none") == 0) {
+#ifdef HAVE_ZLIB
+		client.compression_requested = false;
+#endif
+		return CommandResult::OK;
+	}
+
+	command_error(client, ACK_ERROR_ARG,
+		      "Unsupported compression: %s", mode);
+	return CommandResult::ERROR;
+}
+
 static void
 print_tag(TagType type, const char *value, void *ctx)
 {
@@ -134,11 +216,11 @@ handle_listfiles(Client &client, unsigned argc, char *argv[])
 	/* must be a path relative to the configured
 	   music_directory */
 
-	if (client.partition.instance.storage != nullptr)
+	if (client.GetPartition().instance.storage != nullptr)
 		/* if we have a storage instance, obtain a list of
 		   files from it */
 		return handle_listfiles_storage(client,
-						*client.partition.instance.storage,
+						*client.GetPartition().instance.storage,
 						uri);
 
 	/* fall back to entries from database if we have no storage */
@@ -245,13 +327,23 @@ handle_update(Client &client, unsigned argc, char *argv[], bool discard)
 		}
 	}
 
-	UpdateService *update = client.partition.instance.update;
-	if (update == nullptr) {
-		command_error(client, ACK_ERROR_NO_EXIST, "No database");
-		return CommandResult::ERROR;
+	unsigned ret;
+	UpdateService *update = client.GetPartition().instance.update;
+	if (update != nullptr) {
+		ret = update->Enqueue(path, discard);
+	} else {
+		/* this database is not maintained by the
+		   UpdateService; ask the plugin to reload it */
+		Error error;
+		Database *db = client.GetPartition().instance.GetDatabase(error);
+		if (db == nullptr)
+			return print_error(client, error);
+
+		ret = db->Reload(error);
+		if (ret == 0 && error.IsDefined())
+			return print_error(client, error);
 	}
 
-	unsigned ret = update->Enqueue(path, discard);
 	if (ret > 0) {
 		client_printf(client, "updating_db: %i\n", ret);
 		return CommandResult::OK;
@@ -297,7 +389,7 @@ handle_setvol(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	}
 
-	success = volume_level_change(client.partition.outputs, level);
+	success = volume_level_change(client.GetPartition().outputs, level);
 	if (!success) {
 		command_error(client, ACK_ERROR_SYSTEM,
 			      "problems setting volume");
@@ -319,7 +411,7 @@ handle_volume(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	}
 
-	const int old_volume = volume_level_get(client.partition.outputs);
+	const int old_volume = volume_level_get(client.GetPartition().outputs);
 	if (old_volume < 0) {
 		command_error(client, ACK_ERROR_SYSTEM, "No mixer");
 		return CommandResult::ERROR;
@@ -332,7 +424,7 @@ handle_volume(Client &client, gcc_unused unsigned argc, char *argv[])
 		new_volume = 100;
 
 	if (new_volume != old_volume &&
-	    !volume_level_change(client.partition.outputs, new_volume)) {
+	    !volume_level_change(client.GetPartition().outputs, new_volume)) {
 		command_error(client, ACK_ERROR_SYSTEM,
 			      "problems setting volume");
 		return CommandResult::ERROR;
@@ -349,6 +441,96 @@ handle_stats(Client &client,
 	return CommandResult::OK;
 }
 
+/**
+ * Prints metrics in the "name: value" format of the MPD protocol.
+ * Labelled samples are printed as "name[label]: value"; histograms
+ * are summarized by count, sum and a few quantiles.
+ */
+class ProtocolMetricsVisitor final : public MetricsVisitor {
+	Client &client;
+
+public:
+	explicit ProtocolMetricsVisitor(Client &_client):client(_client) {}
+
+private:
+	void PrintName(const char *name, const char *suffix,
+		       MetricLabel label) {
+		if (label.IsDefined())
+			client_printf(client, "%s%s[%s]: ",
+				      name, suffix, label.value);
+		else
+			client_printf(client, "%s%s: ", name, suffix);
+	}
+
+	virtual void OnCounter(const char *name, gcc_unused const char *help,
+			       MetricLabel label, uint64_t value) override {
+		PrintName(name, "", label);
+		client_printf(client, "%llu\n", (unsigned long long)value);
+	}
+
+	virtual void OnGauge(const char *name, gcc_unused const char *help,
+			     MetricLabel label, int64_t value) override {
+		PrintName(name, "", label);
+		client_printf(client, "%lld\n", (long long)value);
+	}
+
+	virtual void OnHistogram(const char *name,
+				 gcc_unused const char *help,
+				 MetricLabel label,
+				 const MetricHistogram &h) override {
+		PrintName(name, "_count", label);
+		client_printf(client, "%llu\n",
+			      (unsigned long long)h.GetCount());
+		PrintName(name, "_sum", label);
+		client_printf(client, "%llu\n",
+			      (unsigned long long)h.GetSum());
+		PrintName(name, "_p50", label);
+		client_printf(client, "%llu\n",
+			      (unsigned long long)h.GetQuantile(0.5));
+		PrintName(name, "_p99", label);
+		client_printf(client, "%llu\n",
+			      (unsigned long long)h.GetQuantile(0.99));
+	}
+};
+
+CommandResult
+handle_metrics(Client &client,
+	       gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	ProtocolMetricsVisitor visitor(client);
+	metrics_visit(visitor);
+	memory_visit_metrics(visitor);
+	command_visit_metrics(visitor);
+	client.GetPartition().outputs.VisitMetrics(visitor);
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_memory(Client &client,
+	      gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	for (auto i = memory_accounts; i->name != nullptr; ++i)
+		client_printf(client,
+			      "subsystem: %s\n"
+			      "bytes: %lu\n"
+			      "budget: %lu\n",
+			      i->name,
+			      (unsigned long)i->account->Get(),
+			      (unsigned long)i->account->GetBudget());
+
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_tracedump(Client &client,
+		 gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	Error error;
+	return TraceDump(error)
+		? CommandResult::OK
+		: print_error(client, error);
+}
+
 CommandResult
 handle_ping(gcc_unused Client &client,
 	    gcc_unused unsigned argc, gcc_unused char *argv[])
@@ -39,6 +39,9 @@ handle_kill(Client &client, unsigned argc, char *argv[]);
 CommandResult
 handle_close(Client &client, unsigned argc, char *argv[]);
 
+CommandResult
+handle_compress(Client &client, unsigned argc, char *argv[]);
+
 CommandResult
 handle_listfiles(Client &client, unsigned argc, char *argv[]);
 
@@ -60,6 +63,15 @@ handle_volume(Client &client, unsigned argc, char *argv[]);
 CommandResult
 handle_stats(Client &client, unsigned argc, char *argv[]);
 
+CommandResult
+handle_metrics(Client &client, unsigned argc, char *argv[]);
+
+CommandResult
+handle_memory(Client &client, unsigned argc, char *argv[]);
+
+CommandResult
+handle_tracedump(Client &client, unsigned argc, char *argv[]);
+
 CommandResult
 handle_ping(Client &client, unsigned argc, char *argv[]);
 
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PartitionCommands.hxx"
+#include "client/Client.hxx"
+#include "Instance.hxx"
+#include "Partition.hxx"
+#include "protocol/Result.hxx"
+
+CommandResult
+handle_partition(Client &client, gcc_unused unsigned argc, char *argv[])
+{
+	const char *name = argv[1];
+	Partition *partition =
+		client.GetPartition().instance.FindPartition(name);
+	if (partition == nullptr) {
+		command_error(client, ACK_ERROR_NO_EXIST,
+			      "partition does not exist");
+		return CommandResult::ERROR;
+	}
+
+	client.SetPartition(*partition);
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_listpartitions(Client &client,
+		      gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	for (const auto partition : client.GetPartition().instance.partitions)
+		client_printf(client, "partition: %s\n",
+			      partition->name.c_str());
+
+	return CommandResult::OK;
+}
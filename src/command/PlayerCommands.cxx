@@ -30,6 +30,13 @@
 #include "protocol/ArgParser.hxx"
 #include "AudioFormat.hxx"
 #include "ReplayGainConfig.hxx"
+#include "Idle.hxx"
+#include "system/Clock.hxx"
+
+#include <string>
+
+#include <stdarg.h>
+#include <stdio.h>
 
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
@@ -62,7 +69,7 @@ handle_play(Client &client, unsigned argc, char *argv[])
 
 	if (argc == 2 && !check_int(client, &song, argv[1]))
 		return CommandResult::ERROR;
-	PlaylistResult result = client.partition.PlayPosition(song);
+	PlaylistResult result = client.GetPartition().PlayPosition(song);
 	return print_playlist_result(client, result);
 }
 
@@ -74,7 +81,7 @@ handle_playid(Client &client, unsigned argc, char *argv[])
 	if (argc == 2 && !check_int(client, &id, argv[1]))
 		return CommandResult::ERROR;
 
-	PlaylistResult result = client.partition.PlayId(id);
+	PlaylistResult result = client.GetPartition().PlayId(id);
 	return print_playlist_result(client, result);
 }
 
@@ -82,7 +89,7 @@ CommandResult
 handle_stop(Client &client,
 	    gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	client.partition.Stop();
+	client.GetPartition().Stop();
 	return CommandResult::OK;
 }
 
@@ -90,7 +97,7 @@ CommandResult
 handle_currentsong(Client &client,
 		   gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	playlist_print_current(client, client.playlist);
+	playlist_print_current(client, client.GetPlaylist());
 	return CommandResult::OK;
 }
 
@@ -103,22 +110,69 @@ handle_pause(Client &client,
 		if (!check_bool(client, &pause_flag, argv[1]))
 			return CommandResult::ERROR;
 
-		client.player_control.SetPause(pause_flag);
+		client.GetPlayerControl().SetPause(pause_flag);
 	} else
-		client.player_control.Pause();
+		client.GetPlayerControl().Pause();
 
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_status(Client &client,
-	      gcc_unused unsigned argc, gcc_unused char *argv[])
+/**
+ * The maximum age of the cached "status" response.  Some values
+ * (e.g. the bit rate of VBR streams) change without an idle event.
+ */
+static constexpr unsigned STATUS_CACHE_MAX_AGE_MS = 1000;
+
+gcc_printf(2,3)
+static void
+AppendFormat(std::string &dest, const char *fmt, ...)
 {
-	const char *state = nullptr;
-	int song;
+	char buffer[256];
+
+	va_list args;
+	va_start(args, fmt);
+	const int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
+	va_end(args);
+
+	if (length < 0)
+		return;
+
+	if (size_t(length) < sizeof(buffer)) {
+		dest.append(buffer, length);
+		return;
+	}
 
-	const auto player_status = client.player_control.GetStatus();
+	/* too long for the stack buffer (e.g. an error message) */
+	const size_t old_size = dest.size();
+	dest.resize(old_size + length + 1);
 
+	va_start(args, fmt);
+	vsnprintf(&dest[old_size], length + 1, fmt, args);
+	va_end(args);
+
+	dest.resize(old_size + length);
+}
+
+/**
+ * Rebuild the "status" snapshot: query the player, the mixers and
+ * the playlist, and format everything except "time" and "elapsed".
+ */
+static void
+UpdateStatusCache(Partition &partition, StatusCache &cache)
+{
+	/* read the serial first: an event which occurs while the
+	   state is being collected invalidates this snapshot */
+	cache.serial = idle_get_serial();
+	cache.timestamp_ms = MonotonicClockMS();
+
+	PlayerControl &pc = partition.pc;
+	const auto player_status = pc.GetStatus();
+	cache.state = player_status.state;
+	cache.elapsed_time = player_status.elapsed_time;
+	cache.total_time = player_status.total_time;
+	cache.bit_rate = player_status.bit_rate;
+
+	const char *state = nullptr;
 	switch (player_status.state) {
 	case PlayerState::STOP:
 		state = "stop";
@@ -131,91 +185,124 @@ handle_status(Client &client,
 		break;
 	}
 
-	const playlist &playlist = client.playlist;
-	client_printf(client,
-		      "volume: %i\n"
-		      COMMAND_STATUS_REPEAT ": %i\n"
-		      COMMAND_STATUS_RANDOM ": %i\n"
-		      COMMAND_STATUS_SINGLE ": %i\n"
-		      COMMAND_STATUS_CONSUME ": %i\n"
-		      COMMAND_STATUS_PLAYLIST ": %li\n"
-		      COMMAND_STATUS_PLAYLIST_LENGTH ": %i\n"
-		      COMMAND_STATUS_MIXRAMPDB ": %f\n"
-		      COMMAND_STATUS_STATE ": %s\n",
-		      volume_level_get(client.partition.outputs),
-		      playlist.GetRepeat(),
-		      playlist.GetRandom(),
-		      playlist.GetSingle(),
-		      playlist.GetConsume(),
-		      (unsigned long)playlist.GetVersion(),
-		      playlist.GetLength(),
-		      client.player_control.GetMixRampDb(),
-		      state);
-
-	if (client.player_control.GetCrossFade() > 0)
-		client_printf(client,
-			      COMMAND_STATUS_CROSSFADE ": %i\n",
-			      int(client.player_control.GetCrossFade() + 0.5));
-
-	if (client.player_control.GetMixRampDelay() > 0)
-		client_printf(client,
-			      COMMAND_STATUS_MIXRAMPDELAY ": %f\n",
-			      client.player_control.GetMixRampDelay());
-
-	song = playlist.GetCurrentPosition();
-	if (song >= 0) {
-		client_printf(client,
-			      COMMAND_STATUS_SONG ": %i\n"
-			      COMMAND_STATUS_SONGID ": %u\n",
-			      song, playlist.PositionToId(song));
-	}
-
-	if (player_status.state != PlayerState::STOP) {
-		client_printf(client,
-			      COMMAND_STATUS_TIME ": %i:%i\n"
-			      "elapsed: %1.3f\n"
-			      COMMAND_STATUS_BITRATE ": %u\n",
-			      (int)(player_status.elapsed_time + 0.5),
-			      (int)(player_status.total_time + 0.5),
-			      player_status.elapsed_time,
-			      player_status.bit_rate);
-
-		if (player_status.audio_format.IsDefined()) {
-			struct audio_format_string af_string;
-
-			client_printf(client,
-				      COMMAND_STATUS_AUDIO ": %s\n",
-				      audio_format_to_string(player_status.audio_format,
-							     &af_string));
-		}
+	const playlist &playlist = partition.playlist;
+
+	std::string &head = cache.head;
+	head.clear();
+	AppendFormat(head,
+		     "volume: %i\n"
+		     COMMAND_STATUS_REPEAT ": %i\n"
+		     COMMAND_STATUS_RANDOM ": %i\n"
+		     COMMAND_STATUS_SINGLE ": %i\n"
+		     COMMAND_STATUS_CONSUME ": %i\n"
+		     COMMAND_STATUS_PLAYLIST ": %li\n"
+		     COMMAND_STATUS_PLAYLIST_LENGTH ": %i\n"
+		     COMMAND_STATUS_MIXRAMPDB ": %f\n"
+		     COMMAND_STATUS_STATE ": %s\n",
+		     volume_level_get(partition.outputs),
+		     playlist.GetRepeat(),
+		     playlist.GetRandom(),
+		     playlist.GetSingle(),
+		     playlist.GetConsume(),
+		     (unsigned long)playlist.GetVersion(),
+		     playlist.GetLength(),
+		     pc.GetMixRampDb(),
+		     state);
+
+	if (pc.GetCrossFade() > 0)
+		AppendFormat(head,
+			     COMMAND_STATUS_CROSSFADE ": %i\n",
+			     int(pc.GetCrossFade() + 0.5));
+
+	if (pc.GetMixRampDelay() > 0)
+		AppendFormat(head,
+			     COMMAND_STATUS_MIXRAMPDELAY ": %f\n",
+			     pc.GetMixRampDelay());
+
+	int song = playlist.GetCurrentPosition();
+	if (song >= 0)
+		AppendFormat(head,
+			     COMMAND_STATUS_SONG ": %i\n"
+			     COMMAND_STATUS_SONGID ": %u\n",
+			     song, playlist.PositionToId(song));
+
+	std::string &tail = cache.tail;
+	tail.clear();
+
+	if (player_status.state != PlayerState::STOP &&
+	    player_status.audio_format.IsDefined()) {
+		struct audio_format_string af_string;
+
+		AppendFormat(tail,
+			     COMMAND_STATUS_AUDIO ": %s\n",
+			     audio_format_to_string(player_status.audio_format,
+						    &af_string));
 	}
 
 #ifdef ENABLE_DATABASE
-	const UpdateService *update_service = client.partition.instance.update;
+	const UpdateService *update_service = partition.instance.update;
 	unsigned updateJobId = update_service != nullptr
 		? update_service->GetId()
 		: 0;
-	if (updateJobId != 0) {
-		client_printf(client,
-			      COMMAND_STATUS_UPDATING_DB ": %i\n",
-			      updateJobId);
-	}
+	if (updateJobId != 0)
+		AppendFormat(tail,
+			     COMMAND_STATUS_UPDATING_DB ": %i\n",
+			     updateJobId);
 #endif
 
-	Error error = client.player_control.LockGetError();
+	Error error = pc.LockGetError();
 	if (error.IsDefined())
-		client_printf(client,
-			      COMMAND_STATUS_ERROR ": %s\n",
-			      error.GetMessage());
+		AppendFormat(tail,
+			     COMMAND_STATUS_ERROR ": %s\n",
+			     error.GetMessage());
 
 	song = playlist.GetNextPosition();
-	if (song >= 0) {
+	if (song >= 0)
+		AppendFormat(tail,
+			     COMMAND_STATUS_NEXTSONG ": %i\n"
+			     COMMAND_STATUS_NEXTSONGID ": %u\n",
+			     song, playlist.PositionToId(song));
+
+	cache.valid = true;
+}
+
+CommandResult
+handle_status(Client &client,
+	      gcc_unused unsigned argc, gcc_unused char *argv[])
+{
+	Partition &partition = client.GetPartition();
+	StatusCache &cache = partition.status_cache;
+
+	const unsigned now_ms = MonotonicClockMS();
+	if (!cache.valid || cache.serial != idle_get_serial() ||
+	    now_ms - cache.timestamp_ms >= STATUS_CACHE_MAX_AGE_MS)
+		UpdateStatusCache(partition, cache);
+
+	client_write(client, cache.head.data(), cache.head.size());
+
+	if (cache.state != PlayerState::STOP) {
+		float elapsed_time = cache.elapsed_time;
+		if (cache.state == PlayerState::PLAY) {
+			/* interpolate instead of asking the player
+			   thread */
+			elapsed_time += (now_ms - cache.timestamp_ms) / 1000.;
+			if (cache.total_time > 0 &&
+			    elapsed_time > cache.total_time)
+				elapsed_time = cache.total_time;
+		}
+
 		client_printf(client,
-			      COMMAND_STATUS_NEXTSONG ": %i\n"
-			      COMMAND_STATUS_NEXTSONGID ": %u\n",
-			      song, playlist.PositionToId(song));
+			      COMMAND_STATUS_TIME ": %i:%i\n"
+			      "elapsed: %1.3f\n"
+			      COMMAND_STATUS_BITRATE ": %u\n",
+			      (int)(elapsed_time + 0.5),
+			      (int)(cache.total_time + 0.5),
+			      elapsed_time,
+			      cache.bit_rate);
 	}
 
+	client_write(client, cache.tail.data(), cache.tail.size());
+
 	return CommandResult::OK;
 }
 
@@ -223,14 +310,14 @@ CommandResult
 handle_next(Client &client,
 	    gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	playlist &playlist = client.playlist;
+	playlist &playlist = client.GetPlaylist();
 
 	/* single mode is not considered when this is user who
 	 * wants to change song. */
 	const bool single = playlist.queue.single;
 	playlist.queue.single = false;
 
-	client.partition.PlayNext();
+	client.GetPartition().PlayNext();
 
 	playlist.queue.single = single;
 	return CommandResult::OK;
@@ -240,7 +327,7 @@ CommandResult
 handle_previous(Client &client,
 		gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	client.partition.PlayPrevious();
+	client.GetPartition().PlayPrevious();
 	return CommandResult::OK;
 }
 
@@ -251,7 +338,7 @@ handle_repeat(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_bool(client, &status, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.SetRepeat(status);
+	client.GetPartition().SetRepeat(status);
 	return CommandResult::OK;
 }
 
@@ -262,7 +349,7 @@ handle_single(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_bool(client, &status, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.SetSingle(status);
+	client.GetPartition().SetSingle(status);
 	return CommandResult::OK;
 }
 
@@ -273,7 +360,7 @@ handle_consume(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_bool(client, &status, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.SetConsume(status);
+	client.GetPartition().SetConsume(status);
 	return CommandResult::OK;
 }
 
@@ -284,16 +371,19 @@ handle_random(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_bool(client, &status, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.SetRandom(status);
-	client.partition.outputs.SetReplayGainMode(replay_gain_get_real_mode(client.partition.GetRandom()));
+	client.GetPartition().SetRandom(status);
+	client.GetPartition().outputs.SetReplayGainMode(replay_gain_get_real_mode(client.GetPartition().GetRandom()));
 	return CommandResult::OK;
 }
 
 CommandResult
-handle_clearerror(gcc_unused Client &client,
+handle_clearerror(Client &client,
 		  gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	client.player_control.ClearError();
+	client.GetPlayerControl().ClearError();
+
+	/* this is not announced with an idle event */
+	client.GetPartition().status_cache.Invalidate();
 	return CommandResult::OK;
 }
 
@@ -308,7 +398,7 @@ handle_seek(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.SeekSongPosition(song, seek_time);
+		client.GetPartition().SeekSongPosition(song, seek_time);
 	return print_playlist_result(client, result);
 }
 
@@ -323,7 +413,7 @@ handle_seekid(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.SeekSongId(id, seek_time);
+		client.GetPartition().SeekSongId(id, seek_time);
 	return print_playlist_result(client, result);
 }
 
@@ -337,7 +427,7 @@ handle_seekcur(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.SeekCurrent(seek_time, relative);
+		client.GetPartition().SeekCurrent(seek_time, relative);
 	return print_playlist_result(client, result);
 }
 
@@ -348,7 +438,7 @@ handle_crossfade(Client &client, gcc_unused unsigned argc, char *argv[])
 
 	if (!check_unsigned(client, &xfade_time, argv[1]))
 		return CommandResult::ERROR;
-	client.player_control.SetCrossFade(xfade_time);
+	client.GetPlayerControl().SetCrossFade(xfade_time);
 
 	return CommandResult::OK;
 }
@@ -360,7 +450,7 @@ handle_mixrampdb(Client &client, gcc_unused unsigned argc, char *argv[])
 
 	if (!check_float(client, &db, argv[1]))
 		return CommandResult::ERROR;
-	client.player_control.SetMixRampDb(db);
+	client.GetPlayerControl().SetMixRampDb(db);
 
 	return CommandResult::OK;
 }
@@ -372,7 +462,7 @@ handle_mixrampdelay(Client &client, gcc_unused unsigned argc, char *argv[])
 
 	if (!check_float(client, &delay_secs, argv[1]))
 		return CommandResult::ERROR;
-	client.player_control.SetMixRampDelay(delay_secs);
+	client.GetPlayerControl().SetMixRampDelay(delay_secs);
 
 	return CommandResult::OK;
 }
@@ -387,7 +477,7 @@ handle_replay_gain_mode(Client &client,
 		return CommandResult::ERROR;
 	}
 
-	client.partition.outputs.SetReplayGainMode(replay_gain_get_real_mode(client.playlist.queue.random));
+	client.GetPartition().outputs.SetReplayGainMode(replay_gain_get_real_mode(client.GetPlaylist().queue.random));
 	return CommandResult::OK;
 }
 
@@ -31,6 +31,7 @@
 #include "queue/Playlist.hxx"
 #include "TimePrint.hxx"
 #include "client/Client.hxx"
+#include "client/ClientBackground.hxx"
 #include "protocol/ArgParser.hxx"
 #include "protocol/Result.hxx"
 #include "ls.hxx"
@@ -51,7 +52,7 @@ print_spl_list(Client &client, const PlaylistVector &list)
 CommandResult
 handle_save(Client &client, gcc_unused unsigned argc, char *argv[])
 {
-	PlaylistResult result = spl_save_playlist(argv[1], client.playlist);
+	PlaylistResult result = spl_save_playlist(argv[1], client.GetPlaylist());
 	return print_playlist_result(client, result);
 }
 
@@ -68,10 +69,31 @@ handle_load(Client &client, unsigned argc, char *argv[])
 
 	Error error;
 	const SongLoader loader(client);
-	if (!playlist_open_into_queue(argv[1],
-				      start_index, end_index,
-				      client.playlist,
-				      client.player_control, loader, error))
+
+	bool success;
+	if (client.IsBackground()) {
+		/* we're in a worker thread; the queue is modified by
+		   the main thread */
+		BackgroundCommand &background = *client.background;
+		const MainThreadCall call =
+			[&background](const std::function<void()> &f){
+				return background.CallMain(f);
+			};
+
+		success = playlist_open_into_queue_async(argv[1],
+							 start_index,
+							 end_index,
+							 client.GetPlaylist(),
+							 client.GetPlayerControl(),
+							 loader, call, error);
+	} else
+		success = playlist_open_into_queue(argv[1],
+						   start_index, end_index,
+						   client.GetPlaylist(),
+						   client.GetPlayerControl(),
+						   loader, error);
+
+	if (!success)
 		return print_error(client, error);
 
 	return CommandResult::OK;
@@ -24,6 +24,7 @@
 #include "db/Selection.hxx"
 #include "SongFilter.hxx"
 #include "SongLoader.hxx"
+#include "SortWindow.hxx"
 #include "queue/Playlist.hxx"
 #include "PlaylistPrint.hxx"
 #include "client/Client.hxx"
@@ -66,7 +67,7 @@ handle_add(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (uri_has_scheme(uri) || PathTraitsUTF8::IsAbsolute(uri)) {
 		const SongLoader loader(client);
 		Error error;
-		unsigned id = client.partition.AppendURI(loader, uri, error);
+		unsigned id = client.GetPartition().AppendURI(loader, uri, error);
 		if (id == 0)
 			return print_error(client, error);
 
@@ -76,7 +77,7 @@ handle_add(Client &client, gcc_unused unsigned argc, char *argv[])
 #ifdef ENABLE_DATABASE
 	const DatabaseSelection selection(uri, true);
 	Error error;
-	return AddFromDatabase(client.partition, selection, error)
+	return AddFromDatabase(client.GetPartition(), selection, error)
 		? CommandResult::OK
 		: print_error(client, error);
 #else
@@ -94,7 +95,7 @@ handle_addid(Client &client, unsigned argc, char *argv[])
 
 	const SongLoader loader(client);
 	Error error;
-	unsigned added_id = client.partition.AppendURI(loader, uri, error);
+	unsigned added_id = client.GetPartition().AppendURI(loader, uri, error);
 	if (added_id == 0)
 		return print_error(client, error);
 
@@ -102,11 +103,11 @@ handle_addid(Client &client, unsigned argc, char *argv[])
 		unsigned to;
 		if (!check_unsigned(client, &to, argv[2]))
 			return CommandResult::ERROR;
-		PlaylistResult result = client.partition.MoveId(added_id, to);
+		PlaylistResult result = client.GetPartition().MoveId(added_id, to);
 		if (result != PlaylistResult::SUCCESS) {
 			CommandResult ret =
 				print_playlist_result(client, result);
-			client.partition.DeleteId(added_id);
+			client.GetPartition().DeleteId(added_id);
 			return ret;
 		}
 	}
@@ -123,7 +124,7 @@ handle_delete(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_range(client, &start, &end, argv[1]))
 		return CommandResult::ERROR;
 
-	PlaylistResult result = client.partition.DeleteRange(start, end);
+	PlaylistResult result = client.GetPartition().DeleteRange(start, end);
 	return print_playlist_result(client, result);
 }
 
@@ -135,7 +136,7 @@ handle_deleteid(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_unsigned(client, &id, argv[1]))
 		return CommandResult::ERROR;
 
-	PlaylistResult result = client.partition.DeleteId(id);
+	PlaylistResult result = client.GetPartition().DeleteId(id);
 	return print_playlist_result(client, result);
 }
 
@@ -143,7 +144,7 @@ CommandResult
 handle_playlist(Client &client,
 		gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	playlist_print_uris(client, client.playlist);
+	playlist_print_uris(client, client.GetPlaylist());
 	return CommandResult::OK;
 }
 
@@ -151,11 +152,11 @@ CommandResult
 handle_shuffle(gcc_unused Client &client,
 	       gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	unsigned start = 0, end = client.playlist.queue.GetLength();
+	unsigned start = 0, end = client.GetPlaylist().queue.GetLength();
 	if (argc == 2 && !check_range(client, &start, &end, argv[1]))
 		return CommandResult::ERROR;
 
-	client.partition.Shuffle(start, end);
+	client.GetPartition().Shuffle(start, end);
 	return CommandResult::OK;
 }
 
@@ -163,7 +164,7 @@ CommandResult
 handle_clear(gcc_unused Client &client,
 	     gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	client.partition.ClearQueue();
+	client.GetPartition().ClearQueue();
 	return CommandResult::OK;
 }
 
@@ -175,7 +176,7 @@ handle_plchanges(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_uint32(client, &version, argv[1]))
 		return CommandResult::ERROR;
 
-	playlist_print_changes_info(client, client.playlist, version);
+	playlist_print_changes_info(client, client.GetPlaylist(), version);
 	return CommandResult::OK;
 }
 
@@ -187,20 +188,31 @@ handle_plchangesposid(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_uint32(client, &version, argv[1]))
 		return CommandResult::ERROR;
 
-	playlist_print_changes_position(client, client.playlist, version);
+	playlist_print_changes_position(client, client.GetPlaylist(), version);
 	return CommandResult::OK;
 }
 
 CommandResult
 handle_playlistinfo(Client &client, unsigned argc, char *argv[])
 {
+	ConstBuffer<const char *> args(argv + 1, argc - 1);
+	SortWindow sw;
+	if (!sw.ParseTrailing(args) || args.size > 1) {
+		command_error(client, ACK_ERROR_ARG, "incorrect arguments");
+		return CommandResult::ERROR;
+	}
+
 	unsigned start = 0, end = std::numeric_limits<unsigned>::max();
 	bool ret;
 
-	if (argc == 2 && !check_range(client, &start, &end, argv[1]))
+	if (args.size == 1 && !check_range(client, &start, &end, args[0]))
 		return CommandResult::ERROR;
 
-	ret = playlist_print_info(client, client.playlist, start, end);
+	ret = sw.IsDefined()
+		? playlist_print_info(client, client.GetPlaylist(),
+				      start, end, sw)
+		: playlist_print_info(client, client.GetPlaylist(),
+				      start, end);
 	if (!ret)
 		return print_playlist_result(client,
 					     PlaylistResult::BAD_RANGE);
@@ -216,12 +228,12 @@ handle_playlistid(Client &client, unsigned argc, char *argv[])
 		if (!check_unsigned(client, &id, argv[1]))
 			return CommandResult::ERROR;
 
-		bool ret = playlist_print_id(client, client.playlist, id);
+		bool ret = playlist_print_id(client, client.GetPlaylist(), id);
 		if (!ret)
 			return print_playlist_result(client,
 						     PlaylistResult::NO_SUCH_SONG);
 	} else {
-		playlist_print_info(client, client.playlist,
+		playlist_print_info(client, client.GetPlaylist(),
 				    0, std::numeric_limits<unsigned>::max());
 	}
 
@@ -240,7 +252,7 @@ handle_playlist_match(Client &client, unsigned argc, char *argv[],
 		return CommandResult::ERROR;
 	}
 
-	playlist_print_find(client, client.playlist, filter);
+	playlist_print_find(client, client.GetPlaylist(), filter);
 	return CommandResult::OK;
 }
 
@@ -277,7 +289,7 @@ handle_prio(Client &client, unsigned argc, char *argv[])
 			return CommandResult::ERROR;
 
 		PlaylistResult result =
-			client.partition.SetPriorityRange(start_position,
+			client.GetPartition().SetPriorityRange(start_position,
 							   end_position,
 							   priority);
 		if (result != PlaylistResult::SUCCESS)
@@ -307,7 +319,7 @@ handle_prioid(Client &client, unsigned argc, char *argv[])
 			return CommandResult::ERROR;
 
 		PlaylistResult result =
-			client.partition.SetPriorityId(song_id, priority);
+			client.GetPartition().SetPriorityId(song_id, priority);
 		if (result != PlaylistResult::SUCCESS)
 			return print_playlist_result(client, result);
 	}
@@ -327,7 +339,7 @@ handle_move(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.MoveRange(start, end, to);
+		client.GetPartition().MoveRange(start, end, to);
 	return print_playlist_result(client, result);
 }
 
@@ -341,7 +353,7 @@ handle_moveid(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 	if (!check_int(client, &to, argv[2]))
 		return CommandResult::ERROR;
-	PlaylistResult result = client.partition.MoveId(id, to);
+	PlaylistResult result = client.GetPartition().MoveId(id, to);
 	return print_playlist_result(client, result);
 }
 
@@ -356,7 +368,7 @@ handle_swap(Client &client, gcc_unused unsigned argc, char *argv[])
 		return CommandResult::ERROR;
 
 	PlaylistResult result =
-		client.partition.SwapPositions(song1, song2);
+		client.GetPartition().SwapPositions(song1, song2);
 	return print_playlist_result(client, result);
 }
 
@@ -370,6 +382,6 @@ handle_swapid(Client &client, gcc_unused unsigned argc, char *argv[])
 	if (!check_unsigned(client, &id2, argv[2]))
 		return CommandResult::ERROR;
 
-	PlaylistResult result = client.partition.SwapIds(id1, id2);
+	PlaylistResult result = client.GetPartition().SwapIds(id1, id2);
 	return print_playlist_result(client, result);
 }
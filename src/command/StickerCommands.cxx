@@ -28,6 +28,7 @@
 #include "CommandError.hxx"
 #include "protocol/Result.hxx"
 #include "client/Client.hxx"
+#include "client/ResponseCache.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "util/Error.hxx"
@@ -97,6 +98,10 @@ handle_sticker_song(Client &client, unsigned argc, char *argv[])
 
 		bool ret = sticker_song_set_value(*song, argv[4], argv[5]);
 		db->ReturnSong(song);
+
+		/* "find" responses may contain sticker values */
+		client_response_cache.Clear();
+
 		if (!ret) {
 			command_error(client, ACK_ERROR_SYSTEM,
 				      "failed to set sticker value");
@@ -115,6 +120,7 @@ handle_sticker_song(Client &client, unsigned argc, char *argv[])
 			? sticker_song_delete(*song)
 			: sticker_song_delete_value(*song, argv[4]);
 		db->ReturnSong(song);
+		client_response_cache.Clear();
 		if (!ret) {
 			command_error(client, ACK_ERROR_SYSTEM,
 				      "no such sticker");
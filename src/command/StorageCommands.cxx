@@ -32,6 +32,7 @@
 #include "storage/Registry.hxx"
 #include "storage/CompositeStorage.hxx"
 #include "storage/FileInfo.hxx"
+#include "storage/ListCache.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/update/Service.hxx"
 #include "TimePrint.hxx"
@@ -39,13 +40,6 @@
 
 #include <inttypes.h> /* for PRIu64 */
 
-gcc_pure
-static bool
-skip_path(const char *name_utf8)
-{
-	return strchr(name_utf8, '\n') != nullptr;
-}
-
 #if defined(WIN32) && GCC_CHECK_VERSION(4,6)
 /* PRIu64 causes bogus compiler warning */
 #pragma GCC diagnostic push
@@ -53,18 +47,12 @@ skip_path(const char *name_utf8)
 #pragma GCC diagnostic ignored "-Wformat-extra-args"
 #endif
 
-static bool
-handle_listfiles_storage(Client &client, StorageDirectoryReader &reader,
-			 Error &error)
+static void
+print_storage_listing(Client &client, const StorageListing &listing)
 {
-	const char *name_utf8;
-	while ((name_utf8 = reader.Read()) != nullptr) {
-		if (skip_path(name_utf8))
-			continue;
-
-		FileInfo info;
-		if (!reader.GetInfo(false, info, error))
-			continue;
+	for (const auto &i : listing) {
+		const char *name_utf8 = i.name.c_str();
+		const FileInfo &info = i.info;
 
 		switch (info.type) {
 		case FileInfo::Type::OTHER:
@@ -86,34 +74,40 @@ handle_listfiles_storage(Client &client, StorageDirectoryReader &reader,
 		if (info.mtime != 0)
 			time_print(client, "Last-Modified", info.mtime);
 	}
-
-	return true;
 }
 
 #if defined(WIN32) && GCC_CHECK_VERSION(4,6)
 #pragma GCC diagnostic pop
 #endif
 
-static bool
-handle_listfiles_storage(Client &client, Storage &storage, const char *uri,
-			 Error &error)
+static std::shared_ptr<const StorageListing>
+list_storage(Client &client, Storage &storage, const char *uri,
+	     Error &error)
 {
-	auto reader = storage.OpenDirectory(uri, error);
-	if (reader == nullptr)
-		return false;
-
-	bool success = handle_listfiles_storage(client, *reader, error);
-	delete reader;
-	return success;
+	StorageListCache *cache =
+		client.GetPartition().instance.storage_list_cache;
+	return cache != nullptr
+		? cache->List(storage, uri, error)
+		: ListStorageDirectory(storage, uri, error);
 }
 
 CommandResult
 handle_listfiles_storage(Client &client, Storage &storage, const char *uri)
 {
 	Error error;
-	if (!handle_listfiles_storage(client, storage, uri, error))
+	std::shared_ptr<const StorageListing> listing;
+
+	{
+		/* this may be a worker thread; don't let "unmount"
+		   destroy the storage while we're listing it */
+		const CompositeStorage::ScopeUse use((CompositeStorage &)storage);
+		listing = list_storage(client, storage, uri, error);
+	}
+
+	if (listing == nullptr)
 		return print_error(client, error);
 
+	print_storage_listing(client, *listing);
 	return CommandResult::OK;
 }
 
@@ -131,11 +125,12 @@ handle_listfiles_storage(Client &client, const char *uri)
 		return CommandResult::ERROR;
 	}
 
-	bool success = handle_listfiles_storage(client, *storage, "", error);
+	const auto listing = list_storage(client, *storage, "", error);
 	delete storage;
-	if (!success)
+	if (listing == nullptr)
 		return print_error(client, error);
 
+	print_storage_listing(client, *listing);
 	return CommandResult::OK;
 }
 
@@ -168,7 +163,7 @@ print_storage_uri(Client &client, const Storage &storage)
 CommandResult
 handle_listmounts(Client &client, gcc_unused unsigned argc, gcc_unused char *argv[])
 {
-	Storage *_composite = client.partition.instance.storage;
+	Storage *_composite = client.GetPartition().instance.storage;
 	if (_composite == nullptr) {
 		command_error(client, ACK_ERROR_NO_EXIST, "No database");
 		return CommandResult::ERROR;
@@ -190,7 +185,7 @@ handle_listmounts(Client &client, gcc_unused unsigned argc, gcc_unused char *arg
 CommandResult
 handle_mount(Client &client, gcc_unused unsigned argc, char *argv[])
 {
-	Storage *_composite = client.partition.instance.storage;
+	Storage *_composite = client.GetPartition().instance.storage;
 	if (_composite == nullptr) {
 		command_error(client, ACK_ERROR_NO_EXIST, "No database");
 		return CommandResult::ERROR;
@@ -231,7 +226,7 @@ handle_mount(Client &client, gcc_unused unsigned argc, char *argv[])
 	idle_add(IDLE_MOUNT);
 
 #ifdef ENABLE_DATABASE
-	Database *_db = client.partition.instance.database;
+	Database *_db = client.GetPartition().instance.database;
 	if (_db != nullptr && _db->IsPlugin(simple_db_plugin)) {
 		SimpleDatabase &db = *(SimpleDatabase *)_db;
 
@@ -252,7 +247,7 @@ handle_mount(Client &client, gcc_unused unsigned argc, char *argv[])
 CommandResult
 handle_unmount(Client &client, gcc_unused unsigned argc, char *argv[])
 {
-	Storage *_composite = client.partition.instance.storage;
+	Storage *_composite = client.GetPartition().instance.storage;
 	if (_composite == nullptr) {
 		command_error(client, ACK_ERROR_NO_EXIST, "No database");
 		return CommandResult::ERROR;
@@ -268,13 +263,13 @@ handle_unmount(Client &client, gcc_unused unsigned argc, char *argv[])
 	}
 
 #ifdef ENABLE_DATABASE
-	if (client.partition.instance.update != nullptr)
+	if (client.GetPartition().instance.update != nullptr)
 		/* ensure that no database update will attempt to work
 		   with the database/storage instances we're about to
 		   destroy here */
-		client.partition.instance.update->CancelMount(local_uri);
+		client.GetPartition().instance.update->CancelMount(local_uri);
 
-	Database *_db = client.partition.instance.database;
+	Database *_db = client.GetPartition().instance.database;
 	if (_db != nullptr && _db->IsPlugin(simple_db_plugin)) {
 		SimpleDatabase &db = *(SimpleDatabase *)_db;
 
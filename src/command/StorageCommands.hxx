@@ -25,6 +25,10 @@
 class Client;
 class Storage;
 
+/**
+ * List a directory of the instance's #CompositeStorage.  May be
+ * called by a worker thread.
+ */
 CommandResult
 handle_listfiles_storage(Client &client, Storage &storage, const char *uri);
 
@@ -38,6 +38,7 @@ enum ConfigOption {
 	CONF_BIND_TO_ADDRESS,
 	CONF_PORT,
 	CONF_LOG_LEVEL,
+	CONF_LOG_ASYNC,
 	CONF_ZEROCONF_NAME,
 	CONF_ZEROCONF_ENABLED,
 	CONF_PASSWORD,
@@ -51,33 +52,58 @@ enum ConfigOption {
 	CONF_REPLAYGAIN_LIMIT,
 	CONF_VOLUME_NORMALIZATION,
 	CONF_SAMPLERATE_CONVERTER,
+	CONF_RESAMPLER,
+	CONF_DSD_THREADS,
 	CONF_AUDIO_BUFFER_SIZE,
+	CONF_CHUNK_SIZE,
+	CONF_BUFFER_HUGE_PAGES,
+	CONF_BUFFER_LOCK,
 	CONF_BUFFER_BEFORE_PLAY,
+	CONF_LOCK_FREE_PIPE,
+	CONF_PREFETCH_TIME,
 	CONF_HTTP_PROXY_HOST,
 	CONF_HTTP_PROXY_PORT,
 	CONF_HTTP_PROXY_USER,
 	CONF_HTTP_PROXY_PASSWORD,
 	CONF_CONN_TIMEOUT,
 	CONF_MAX_CONN,
+	CONF_IDLE_DELAY,
 	CONF_MAX_PLAYLIST_LENGTH,
 	CONF_MAX_COMMAND_LIST_SIZE,
 	CONF_MAX_OUTPUT_BUFFER_SIZE,
+	CONF_MAX_CLIENT_MESSAGES,
 	CONF_FS_CHARSET,
 	CONF_ID3V1_ENCODING,
 	CONF_METADATA_TO_USE,
 	CONF_SAVE_ABSOLUTE_PATHS,
 	CONF_DECODER,
 	CONF_INPUT,
+	CONF_INPUT_CACHE,
+	CONF_SYNTH_CACHE,
+	CONF_DECODER_CACHE,
 	CONF_GAPLESS_MP3_PLAYBACK,
 	CONF_PLAYLIST_PLUGIN,
 	CONF_AUTO_UPDATE,
 	CONF_AUTO_UPDATE_DEPTH,
+	CONF_UPDATE_THREADS,
+	CONF_UPDATE_TRUST_MTIME,
+	CONF_UPDATE_MAX_RATE,
+	CONF_UPDATE_BACK_OFF,
+	CONF_STORAGE_CACHE_TTL,
+	CONF_LOUDNESS_ANALYSIS_THREADS,
+	CONF_IO_THREADS,
 	CONF_DESPOTIFY_USER,
 	CONF_DESPOTIFY_PASSWORD,
 	CONF_DESPOTIFY_HIGH_BITRATE,
 	CONF_AUDIO_FILTER,
 	CONF_DATABASE,
 	CONF_NEIGHBORS,
+	CONF_THREAD,
+	CONF_METRICS_PORT,
+	CONF_SLOW_COMMAND_THRESHOLD,
+	CONF_TRACE_FILE,
+	CONF_TRACE_EVENTS,
+	CONF_MEMORY_BUDGET,
 	CONF_MAX
 };
 
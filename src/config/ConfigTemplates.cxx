@@ -38,6 +38,7 @@ const ConfigTemplate config_templates[] = {
 	{ "bind_to_address", true, false },
 	{ "port", false, false },
 	{ "log_level", false, false },
+	{ "log_async", false, false },
 	{ "zeroconf_name", false, false },
 	{ "zeroconf_enabled", false, false },
 	{ "password", true, false },
@@ -51,33 +52,58 @@ const ConfigTemplate config_templates[] = {
 	{ "replaygain_limit", false, false },
 	{ "volume_normalization", false, false },
 	{ "samplerate_converter", false, false },
+	{ "resampler", true, true },
+	{ "dsd_threads", false, false },
 	{ "audio_buffer_size", false, false },
+	{ "chunk_size", false, false },
+	{ "buffer_huge_pages", false, false },
+	{ "buffer_lock", false, false },
 	{ "buffer_before_play", false, false },
+	{ "lock_free_pipe", false, false },
+	{ "prefetch_time", false, false },
 	{ "http_proxy_host", false, false },
 	{ "http_proxy_port", false, false },
 	{ "http_proxy_user", false, false },
 	{ "http_proxy_password", false, false },
 	{ "connection_timeout", false, false },
 	{ "max_connections", false, false },
+	{ "idle_delay", false, false },
 	{ "max_playlist_length", false, false },
 	{ "max_command_list_size", false, false },
 	{ "max_output_buffer_size", false, false },
+	{ "max_client_messages", false, false },
 	{ "filesystem_charset", false, false },
 	{ "id3v1_encoding", false, false },
 	{ "metadata_to_use", false, false },
 	{ "save_absolute_paths_in_playlists", false, false },
 	{ "decoder", true, true },
 	{ "input", true, true },
+	{ "input_cache", false, true },
+	{ "synth_cache", false, true },
+	{ "decoder_cache", false, true },
 	{ "gapless_mp3_playback", false, false },
 	{ "playlist_plugin", true, true },
 	{ "auto_update", false, false },
 	{ "auto_update_depth", false, false },
+	{ "update_threads", false, false },
+	{ "update_trust_mtime", false, false },
+	{ "update_max_rate", false, false },
+	{ "update_back_off", false, false },
+	{ "storage_cache_ttl", false, false },
+	{ "loudness_analysis_threads", false, false },
+	{ "io_threads", false, false },
 	{ "despotify_user", false, false },
 	{ "despotify_password", false, false},
 	{ "despotify_high_bitrate", false, false },
 	{ "filter", true, true },
 	{ "database", false, true },
 	{ "neighbors", true, true },
+	{ "thread", true, true },
+	{ "metrics_port", false, false },
+	{ "slow_command_threshold", false, false },
+	{ "trace_file", false, false },
+	{ "trace_events", false, false },
+	{ "memory_budget", false, true },
 };
 
 static constexpr unsigned n_config_templates =
@@ -72,6 +72,9 @@ stats_visitor_song(SearchStats &stats, const LightSong &song)
 static bool
 CollectGroupCounts(TagCountMap &map, TagType group, const Tag &tag)
 {
+	if (!tag.HasType(group))
+		return false;
+
 	bool found = false;
 	for (unsigned i = 0; i < tag.num_items; ++i) {
 		const TagItem &item = *tag.items[i];
@@ -32,6 +32,12 @@ enum db_error {
 	DB_NOT_FOUND,
 
 	DB_CONFLICT,
+
+	/**
+	 * The database is configured, but it is still being loaded
+	 * during startup.
+	 */
+	DB_LOADING,
 };
 
 extern const Domain db_domain;
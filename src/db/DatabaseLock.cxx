@@ -20,8 +20,17 @@
 #include "config.h"
 #include "DatabaseLock.hxx"
 
-Mutex db_mutex;
+SharedMutex db_mutex;
+
+uint64_t db_mutex_locked_at;
+MetricHistogram db_mutex_hold_time;
+__thread uint64_t db_mutex_wait_us;
+
+#ifdef ENABLE_LOCK_PROFILING
+LockProfile &db_mutex_profile = lock_profile_get("database");
+#endif
 
 #ifndef NDEBUG
 ThreadId db_mutex_holder;
+__thread bool db_mutex_shared;
 #endif
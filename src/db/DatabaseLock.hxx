@@ -27,62 +27,183 @@
 #define MPD_DB_LOCK_HXX
 
 #include "check.h"
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
+#include "system/Clock.hxx"
+#include "Metrics.hxx"
 #include "Compiler.h"
 
+#ifdef ENABLE_LOCK_PROFILING
+#include "thread/LockProfile.hxx"
+#endif
+
 #include <assert.h>
 
-extern Mutex db_mutex;
+/**
+ * The global database lock.  Threads which modify the database (the
+ * update thread, mounting, saving) lock it exclusively; all others
+ * share it, and do not block each other.
+ */
+extern SharedMutex db_mutex;
+
+/**
+ * When #db_mutex was locked exclusively.  Only valid while it is
+ * being held.
+ */
+extern uint64_t db_mutex_locked_at;
+
+/**
+ * How long #db_mutex is held exclusively.  This is the time all
+ * readers are blocked.
+ */
+extern MetricHistogram db_mutex_hold_time;
+
+/**
+ * The total number of microseconds the current thread has waited
+ * for #db_mutex.  Only contended lock attempts are measured.
+ */
+extern __thread uint64_t db_mutex_wait_us;
+
+#ifdef ENABLE_LOCK_PROFILING
+/**
+ * Contention statistics of #db_mutex, for both exclusive and shared
+ * locks.  The hold time is only measured for exclusive locks (and
+ * duplicates #db_mutex_hold_time).
+ */
+extern LockProfile &db_mutex_profile;
+#endif
 
 #ifndef NDEBUG
 
 #include "thread/Id.hxx"
 
+/**
+ * The thread which holds #db_mutex exclusively.
+ */
 extern ThreadId db_mutex_holder;
 
 /**
- * Does the current thread hold the database lock?
+ * Does the current thread hold a shared lock on #db_mutex?
+ */
+extern __thread bool db_mutex_shared;
+
+/**
+ * Does the current thread hold the database lock exclusively?  This
+ * is required for modifying the database.
  */
 gcc_pure
 static inline bool
-holding_db_lock(void)
+holding_db_write_lock(void)
 {
 	return db_mutex_holder.IsInside();
 }
 
+/**
+ * Does the current thread hold the database lock (exclusive or
+ * shared)?  This is required for reading the database.
+ */
+gcc_pure
+static inline bool
+holding_db_lock(void)
+{
+	return db_mutex_shared || holding_db_write_lock();
+}
+
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock exclusively.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
 {
 	assert(!holding_db_lock());
 
-	db_mutex.lock();
+	if (!db_mutex.try_lock()) {
+		const uint64_t start = MonotonicClockUS();
+		db_mutex.lock();
+		const uint64_t wait_us = MonotonicClockUS() - start;
+		db_mutex_wait_us += wait_us;
+#ifdef ENABLE_LOCK_PROFILING
+		db_mutex_profile.Contended(wait_us);
+#endif
+	}
+
+#ifdef ENABLE_LOCK_PROFILING
+	db_mutex_profile.acquisitions.Add();
+#endif
 
 	assert(db_mutex_holder.IsNull());
 #ifndef NDEBUG
 	db_mutex_holder = ThreadId::GetCurrent();
 #endif
+
+	db_mutex_locked_at = MonotonicClockUS();
 }
 
 /**
- * Release the global database lock.
+ * Release the exclusive global database lock.
  */
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 #ifndef NDEBUG
 	db_mutex_holder = ThreadId::Null();
 #endif
 
+	const uint64_t hold_us = MonotonicClockUS() - db_mutex_locked_at;
+	db_mutex_hold_time.Observe(hold_us);
+#ifdef ENABLE_LOCK_PROFILING
+	db_mutex_profile.hold_time.Observe(hold_us);
+#endif
+
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain a shared global database lock.  This is needed before
+ * dereferencing a #song or #directory.  It is not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	if (!db_mutex.try_lock_shared()) {
+		const uint64_t start = MonotonicClockUS();
+		db_mutex.lock_shared();
+		const uint64_t wait_us = MonotonicClockUS() - start;
+		db_mutex_wait_us += wait_us;
+#ifdef ENABLE_LOCK_PROFILING
+		db_mutex_profile.Contended(wait_us);
+#endif
+	}
+
+#ifdef ENABLE_LOCK_PROFILING
+	db_mutex_profile.acquisitions.Add();
+#endif
+
+	assert(db_mutex_holder.IsNull());
+#ifndef NDEBUG
+	db_mutex_shared = true;
+#endif
+}
+
+/**
+ * Release the shared global database lock.
+ */
+static inline void
+db_unlock_shared(void)
+{
+	assert(db_mutex_shared);
+#ifndef NDEBUG
+	db_mutex_shared = false;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
 class ScopeDatabaseLock {
 public:
 	ScopeDatabaseLock() {
@@ -94,4 +215,15 @@ public:
 	}
 };
 
+class ScopeDatabaseSharedLock {
+public:
+	ScopeDatabaseSharedLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseSharedLock() {
+		db_unlock_shared();
+	}
+};
+
 #endif
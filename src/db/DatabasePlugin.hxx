@@ -39,6 +39,12 @@ struct DatabasePlugin {
 	 */
 	static constexpr unsigned FLAG_REQUIRE_STORAGE = 0x1;
 
+	/**
+	 * The Visit(), VisitUniqueTags() and GetStats() methods may
+	 * be called by any thread, even concurrently.
+	 */
+	static constexpr unsigned FLAG_THREAD_SAFE = 0x2;
+
 	const char *name;
 
 	unsigned flags;
@@ -53,6 +59,10 @@ struct DatabasePlugin {
 	constexpr bool RequireStorage() const {
 		return flags & FLAG_REQUIRE_STORAGE;
 	}
+
+	constexpr bool IsThreadSafe() const {
+		return flags & FLAG_THREAD_SAFE;
+	}
 };
 
 #endif
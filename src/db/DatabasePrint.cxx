@@ -22,6 +22,8 @@
 #include "Selection.hxx"
 #include "SongFilter.hxx"
 #include "SongPrint.hxx"
+#include "SortWindow.hxx"
+#include "DetachedSong.hxx"
 #include "TimePrint.hxx"
 #include "client/Client.hxx"
 #include "tag/Tag.hxx"
@@ -31,7 +33,17 @@
 #include "Interface.hxx"
 #include "fs/Traits.hxx"
 
+#ifdef ENABLE_SQLITE
+#include "sticker/StickerQuery.hxx"
+#endif
+
 #include <functional>
+#include <vector>
+#include <algorithm>
+
+#ifdef ENABLE_SQLITE
+#include <list>
+#endif
 
 static const char *
 ApplyBaseFlag(const char *uri, bool base)
@@ -168,6 +180,188 @@ db_selection_print(Client &client, const DatabaseSelection &selection,
 	return db->Visit(selection, d, s, p, error);
 }
 
+static void
+PrintDetachedSong(Client &client, const DetachedSong &song)
+{
+	song_print_info(client, song);
+
+	if (song.GetTag().has_playlist)
+		/* this song file has an embedded CUE sheet */
+		client_printf(client, "playlist: %s\n", song.GetURI());
+}
+
+/**
+ * Print the songs within the window in the database's natural
+ * order, and stop visiting after the last one.
+ */
+static bool
+PrintWindow(Client &client, const Database &db,
+	    const DatabaseSelection &selection, const SortWindow &sw,
+	    Error &error)
+{
+	unsigned n = 0;
+	bool done = false;
+
+	const auto s = [&client, &sw, &n, &done](const LightSong &song,
+						  gcc_unused Error &){
+		if (n >= sw.end) {
+			done = true;
+			return false;
+		}
+
+		if (n++ >= sw.start)
+			PrintSongFull(client, false, song);
+		return true;
+	};
+
+	return db.Visit(selection, s, error) || done;
+}
+
+namespace {
+
+/**
+ * A song which is a candidate for the sorted window.  The sequence
+ * number makes the order of songs with equal sort keys stable.
+ */
+struct SortedSong {
+	unsigned sequence;
+	DetachedSong song;
+
+	SortedSong(unsigned _sequence, const LightSong &_song)
+		:sequence(_sequence),
+		 song(_song.GetURI(), Tag(*_song.tag)) {
+		song.SetLastModified(_song.mtime);
+		song.SetStartMS(_song.start_ms);
+		song.SetEndMS(_song.end_ms);
+	}
+};
+
+}
+
+bool
+db_selection_print(Client &client, const DatabaseSelection &selection,
+		   const SortWindow &sw, Error &error)
+{
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return false;
+
+	if (!sw.IsSorted())
+		return PrintWindow(client, *db, selection, sw, error);
+
+	const auto less = [&sw](const SortedSong &a, const SortedSong &b){
+		if (sw.Less(a.song.GetTag(), b.song.GetTag()))
+			return true;
+		if (sw.Less(b.song.GetTag(), a.song.GetTag()))
+			return false;
+		return a.sequence < b.sequence;
+	};
+
+	/* a max-heap of the best "end" songs (top-k); a song is only
+	   copied if it beats the worst one of them */
+	std::vector<SortedSong> heap;
+	unsigned sequence = 0;
+
+	const auto s = [&sw, &heap, &sequence, &less](const LightSong &song,
+						      gcc_unused Error &){
+		const unsigned n = sequence++;
+
+		if (heap.size() < sw.end) {
+			heap.emplace_back(n, song);
+			std::push_heap(heap.begin(), heap.end(), less);
+		} else if (sw.end > 0 &&
+			   sw.Less(*song.tag, heap.front().song.GetTag())) {
+			std::pop_heap(heap.begin(), heap.end(), less);
+			heap.back() = SortedSong(n, song);
+			std::push_heap(heap.begin(), heap.end(), less);
+		}
+
+		return true;
+	};
+
+	if (!db->Visit(selection, s, error))
+		return false;
+
+	std::sort_heap(heap.begin(), heap.end(), less);
+
+	for (size_t i = sw.start; i < heap.size(); ++i)
+		PrintDetachedSong(client, heap[i].song);
+
+	return true;
+}
+
+#ifdef ENABLE_SQLITE
+
+static bool
+PrintStickerSong(Client &client, const StickerQuery &stickers,
+		 const LightSong &song)
+{
+	const auto uri = song.GetURI();
+	if (!stickers.Match(uri))
+		return true;
+
+	PrintSongFull(client, false, song);
+	stickers.Print(client, uri);
+	return true;
+}
+
+static bool
+CollectStickerSong(std::list<DetachedSong> &songs,
+		   const StickerQuery &stickers,
+		   const LightSong &song)
+{
+	auto uri = song.GetURI();
+	if (!stickers.Match(uri))
+		return true;
+
+	songs.emplace_back(std::move(uri), Tag(*song.tag));
+
+	DetachedSong &detached = songs.back();
+	detached.SetLastModified(song.mtime);
+	detached.SetStartMS(song.start_ms);
+	detached.SetEndMS(song.end_ms);
+	return true;
+}
+
+bool
+db_selection_print_stickers(Client &client, const DatabaseSelection &selection,
+			    const StickerQuery &stickers, Error &error)
+{
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return false;
+
+	using namespace std::placeholders;
+
+	if (!stickers.IsSorted()) {
+		const auto s = std::bind(PrintStickerSong, std::ref(client),
+					 std::cref(stickers), _1);
+		return db->Visit(selection, s, error);
+	}
+
+	/* the database is visited in its own order; collect all
+	   matching songs first, then sort and print them */
+	std::list<DetachedSong> songs;
+	const auto s = std::bind(CollectStickerSong, std::ref(songs),
+				 std::cref(stickers), _1);
+	if (!db->Visit(selection, s, error))
+		return false;
+
+	/* std::list::sort() is stable */
+	songs.sort([&stickers](const DetachedSong &a, const DetachedSong &b) {
+			return stickers.Less(a.GetURI(), b.GetURI());
+		});
+
+	for (const auto &song : songs) {
+		PrintDetachedSong(client, song);
+		stickers.Print(client, song.GetURI());
+	}
+
+	return true;
+}
+
+#endif
+
 static bool
 PrintSongURIVisitor(Client &client, const LightSong &song)
 {
@@ -25,6 +25,8 @@
 #include <stdint.h>
 
 class SongFilter;
+class StickerQuery;
+struct SortWindow;
 struct DatabaseSelection;
 class Client;
 class Error;
@@ -37,6 +39,30 @@ bool
 db_selection_print(Client &client, const DatabaseSelection &selection,
 		   bool full, bool base, Error &error);
 
+/**
+ * Print the songs of the selection with all attributes, sorted and
+ * sliced according to the #SortWindow.  Only the songs within the
+ * window are kept in memory while the database is visited.
+ */
+bool
+db_selection_print(Client &client, const DatabaseSelection &selection,
+		   const SortWindow &sw, Error &error);
+
+#ifdef ENABLE_SQLITE
+
+/**
+ * Print all songs of the selection which match the sticker
+ * conditions, together with the requested sticker values, and
+ * optionally sorted by a sticker value.
+ *
+ * @param stickers a #StickerQuery on which Load() has been called
+ */
+bool
+db_selection_print_stickers(Client &client, const DatabaseSelection &selection,
+			    const StickerQuery &stickers, Error &error);
+
+#endif
+
 bool
 PrintUniqueTags(Client &client, unsigned type, uint32_t group_mask,
 		const SongFilter *filter,
@@ -25,29 +25,96 @@
 #include "Instance.hxx"
 #include "DetachedSong.hxx"
 
+#include "queue/Playlist.hxx"
+#include "PlaylistError.hxx"
+#include "util/Error.hxx"
+
 #include <functional>
+#include <list>
 
 static bool
-AddToQueue(Partition &partition, const LightSong &song, Error &error)
+CollectSong(std::list<DetachedSong> &songs, const Storage &storage,
+	    const LightSong &song)
 {
-	const Storage &storage = *partition.instance.storage;
-	unsigned id =
-		partition.playlist.AppendSong(partition.pc,
-					      DatabaseDetachSong(storage,
-								 song),
-					      error);
-	return id != 0;
+	songs.emplace_back(DatabaseDetachSong(storage, song));
+	return true;
 }
 
-bool
-AddFromDatabase(Partition &partition, const DatabaseSelection &selection,
-		Error &error)
+/**
+ * Visit the selection and convert all songs to #DetachedSong
+ * instances.  This only reads the database and may therefore be
+ * called by any thread.
+ */
+static bool
+CollectFromDatabase(Partition &partition, const DatabaseSelection &selection,
+		    std::list<DetachedSong> &songs, Error &error)
 {
 	const Database *db = partition.instance.GetDatabase(error);
 	if (db == nullptr)
 		return false;
 
+	const Storage &storage = *partition.instance.storage;
+
 	using namespace std::placeholders;
-	const auto f = std::bind(AddToQueue, std::ref(partition), _1, _2);
+	const auto f = std::bind(CollectSong, std::ref(songs),
+				 std::cref(storage), _1);
 	return db->Visit(selection, f, error);
 }
+
+/**
+ * Append the songs to the queue in one batch.  Must be called by the
+ * main thread.
+ */
+static bool
+AppendToQueue(Partition &partition, std::list<DetachedSong> &songs,
+	      Error &error)
+{
+	bool success = true;
+
+	partition.BeginBatch();
+
+	for (auto &song : songs) {
+		if (partition.playlist.AppendSong(partition.pc,
+						  std::move(song),
+						  error) == 0) {
+			success = false;
+			break;
+		}
+	}
+
+	partition.CommitBatch();
+	return success;
+}
+
+bool
+AddFromDatabase(Partition &partition, const DatabaseSelection &selection,
+		Error &error)
+{
+	std::list<DetachedSong> songs;
+	return CollectFromDatabase(partition, selection, songs, error) &&
+		AppendToQueue(partition, songs, error);
+}
+
+bool
+AddFromDatabaseAsync(Partition &partition, const DatabaseSelection &selection,
+		     const MainThreadCall &call, Error &error)
+{
+	std::list<DetachedSong> songs;
+	if (!CollectFromDatabase(partition, selection, songs, error))
+		return false;
+
+	if (songs.empty())
+		return true;
+
+	bool success = true;
+	const std::function<void()> f = [&](){
+		success = AppendToQueue(partition, songs, error);
+	};
+
+	if (!call(f)) {
+		error.Set(playlist_domain, "Cancelled");
+		return false;
+	}
+
+	return success;
+}
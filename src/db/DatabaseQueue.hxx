@@ -20,12 +20,28 @@
 #ifndef MPD_DATABASE_QUEUE_HXX
 #define MPD_DATABASE_QUEUE_HXX
 
+#include "playlist/PlaylistQueue.hxx"
+
 struct Partition;
 struct DatabaseSelection;
 class Error;
 
+/**
+ * Append all songs of the selection to the queue.  The database is
+ * visited first; the songs are then appended in one batch, i.e. with
+ * one queue version and one "playlist" idle event.
+ */
 bool
 AddFromDatabase(Partition &partition, const DatabaseSelection &selection,
 		Error &error);
 
+/**
+ * Like AddFromDatabase(), but called by a thread other than the main
+ * thread.  The database is visited in the calling thread, and the
+ * collected songs are appended by the main thread through #call.
+ */
+bool
+AddFromDatabaseAsync(Partition &partition, const DatabaseSelection &selection,
+		     const MainThreadCall &call, Error &error);
+
 #endif
@@ -21,6 +21,8 @@
 #define MPD_DATABASE_INTERFACE_HXX
 
 #include "Visitor.hxx"
+#include "DatabaseError.hxx"
+#include "util/Error.hxx"
 #include "tag/TagType.h"
 #include "Compiler.h"
 
@@ -31,7 +33,6 @@ struct DatabasePlugin;
 struct DatabaseStats;
 struct DatabaseSelection;
 struct LightSong;
-class Error;
 
 class Database {
 	const DatabasePlugin &plugin;
@@ -121,6 +122,20 @@ public:
 	 */
 	gcc_pure
 	virtual time_t GetUpdateStamp() const = 0;
+
+	/**
+	 * Load the database again from its source, without blocking
+	 * readers in the meantime.  This is used for plugins which
+	 * are not maintained by the #UpdateService.
+	 *
+	 * @return the job id, or 0 on error or if a reload is already
+	 * in progress (in which case #error is not set)
+	 */
+	virtual unsigned Reload(Error &error) {
+		error.Set(db_domain, DB_DISABLED,
+			  "This database cannot be reloaded");
+		return 0;
+	}
 };
 
 #endif
@@ -19,56 +19,139 @@
 
 #include "config.h"
 #include "LazyDatabase.hxx"
-#include "db/Interface.hxx"
+#include "db/DatabaseListener.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <assert.h>
 
-LazyDatabase::LazyDatabase(Database *_db)
-	:Database(_db->GetPlugin()), db(_db), open(false) {}
+static constexpr Domain lazy_database_domain("lazy_database");
+
+LazyDatabase::LazyDatabase(EventLoop &_loop, DatabaseListener &_listener,
+			   Database *_db,
+			   Factory _factory, bool _background)
+	:Database(_db->GetPlugin()), DeferredMonitor(_loop),
+	 listener(_listener),
+	 factory(std::move(_factory)), background(_background),
+	 current(std::make_shared<Wrapped>(_db)),
+	 opening(false), reloading(false), reload_id(0) {}
 
 LazyDatabase::~LazyDatabase()
 {
-	assert(!open);
+	assert(!thread.IsDefined());
+	assert(borrowed.empty());
+}
+
+void
+LazyDatabase::OpenThread(void *ctx)
+{
+	LazyDatabase &lazy = *(LazyDatabase *)ctx;
+
+	SetThreadName("lazy_db");
+
+	lazy.mutex.lock();
+	const WrappedPtr w = lazy.current;
+	lazy.mutex.unlock();
 
-	delete db;
+	Error error;
+	const bool success = w->db->Open(error);
+	if (!success)
+		/* the next access will try again */
+		LogError(error);
+
+	lazy.mutex.lock();
+	w->open = success;
+	lazy.opening = false;
+	lazy.cond.broadcast();
+	lazy.mutex.unlock();
+
+	if (success)
+		lazy.Schedule();
 }
 
 bool
-LazyDatabase::EnsureOpen(Error &error) const
+LazyDatabase::Open(Error &error)
 {
-	if (open)
+	if (!background)
 		return true;
 
-	if (!db->Open(error))
+	assert(!thread.IsDefined());
+
+	opening = true;
+	if (!thread.Start(OpenThread, this, error)) {
+		opening = false;
 		return false;
+	}
 
-	open = true;
 	return true;
 }
 
 void
 LazyDatabase::Close()
 {
-	if (open) {
-		open = false;
-		db->Close();
+	if (thread.IsDefined())
+		thread.Join();
+
+	Cancel();
+
+	const ScopeLock protect(mutex);
+	assert(borrowed.empty());
+
+	if (current->open) {
+		current->open = false;
+		current->db->Close();
+	}
+}
+
+LazyDatabase::WrappedPtr
+LazyDatabase::Acquire(Error &error) const
+{
+	const ScopeLock protect(mutex);
+
+	while (opening)
+		cond.wait(mutex);
+
+	if (!current->open) {
+		if (!current->db->Open(error))
+			return WrappedPtr();
+
+		current->open = true;
 	}
+
+	return current;
 }
 
 const LightSong *
 LazyDatabase::GetSong(const char *uri, Error &error) const
 {
-	return EnsureOpen(error)
-		? db->GetSong(uri, error)
-		: nullptr;
+	const WrappedPtr w = Acquire(error);
+	if (!w)
+		return nullptr;
+
+	const LightSong *song = w->db->GetSong(uri, error);
+	if (song != nullptr) {
+		/* remember the instance, because it may be replaced
+		   before the song is returned */
+		const ScopeLock protect(mutex);
+		borrowed.insert(std::make_pair(song, w));
+	}
+
+	return song;
 }
 
 void
 LazyDatabase::ReturnSong(const LightSong *song) const
 {
-	assert(open);
+	mutex.lock();
+	auto i = borrowed.find(song);
+	assert(i != borrowed.end());
+	const WrappedPtr w = std::move(i->second);
+	borrowed.erase(i);
+	mutex.unlock();
 
-	db->ReturnSong(song);
+	w->db->ReturnSong(song);
 }
 
 bool
@@ -78,9 +161,10 @@ LazyDatabase::Visit(const DatabaseSelection &selection,
 		    VisitPlaylist visit_playlist,
 		    Error &error) const
 {
-	return EnsureOpen(error) &&
-		db->Visit(selection, visit_directory, visit_song,
-			  visit_playlist, error);
+	const WrappedPtr w = Acquire(error);
+	return w &&
+		w->db->Visit(selection, visit_directory, visit_song,
+			     visit_playlist, error);
 }
 
 bool
@@ -89,20 +173,98 @@ LazyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 			      VisitTag visit_tag,
 			      Error &error) const
 {
-	return EnsureOpen(error) &&
-		db->VisitUniqueTags(selection, tag_type, group_mask, visit_tag,
-				    error);
+	const WrappedPtr w = Acquire(error);
+	return w &&
+		w->db->VisitUniqueTags(selection, tag_type, group_mask,
+				       visit_tag, error);
 }
 
 bool
 LazyDatabase::GetStats(const DatabaseSelection &selection,
 		       DatabaseStats &stats, Error &error) const
 {
-	return EnsureOpen(error) && db->GetStats(selection, stats, error);
+	const WrappedPtr w = Acquire(error);
+	return w && w->db->GetStats(selection, stats, error);
 }
 
 time_t
 LazyDatabase::GetUpdateStamp() const
 {
-	return open ? db->GetUpdateStamp() : 0;
+	const ScopeLock protect(mutex);
+	return current->open ? current->db->GetUpdateStamp() : 0;
+}
+
+void
+LazyDatabase::ReloadThread(void *ctx)
+{
+	LazyDatabase &lazy = *(LazyDatabase *)ctx;
+
+	SetThreadName("lazy_db");
+
+	Error error;
+	WrappedPtr w;
+	Database *db = lazy.factory(error);
+	if (db != nullptr) {
+		w = std::make_shared<Wrapped>(db);
+		if (db->Open(error))
+			w->open = true;
+		else
+			w.reset();
+	}
+
+	const bool success = (bool)w;
+	if (!success)
+		LogError(error, "Failed to reload the database");
+
+	lazy.mutex.lock();
+	if (success)
+		lazy.current.swap(w);
+	lazy.reloading = false;
+	lazy.mutex.unlock();
+
+	/* release the old instance outside of the lock; it is
+	   closed as soon as the last reader is done with it */
+	w.reset();
+
+	if (success)
+		lazy.Schedule();
+}
+
+unsigned
+LazyDatabase::Reload(Error &error)
+{
+	if (!factory)
+		return Database::Reload(error);
+
+	mutex.lock();
+	const bool busy = opening || reloading;
+	if (!busy)
+		reloading = true;
+	mutex.unlock();
+
+	if (busy)
+		return 0;
+
+	/* the previous worker thread has finished already (or is
+	   just about to) */
+	if (thread.IsDefined())
+		thread.Join();
+
+	if (!thread.Start(ReloadThread, this, error)) {
+		const ScopeLock protect(mutex);
+		reloading = false;
+		return 0;
+	}
+
+	FormatDebug(lazy_database_domain, "reloading database");
+
+	if (++reload_id == 0)
+		reload_id = 1;
+	return reload_id;
+}
+
+void
+LazyDatabase::RunDeferred()
+{
+	listener.OnDatabaseModified();
 }
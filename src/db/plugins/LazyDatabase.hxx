@@ -21,24 +21,110 @@
 #define MPD_LAZY_DATABASE_PLUGIN_HXX
 
 #include "db/Interface.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
 #include "Compiler.h"
 
+#include <functional>
+#include <memory>
+#include <map>
+
+class DatabaseListener;
+
 /**
  * A wrapper for a #Database object that gets opened on the first
  * database access.  This works around daemonization problems with
  * some plugins.
+ *
+ * In "background" mode, Open() starts opening the wrapped database
+ * in a worker thread right away, and the first access waits for it
+ * instead of opening it synchronously.  If a #Factory was specified,
+ * Reload() builds a fresh instance in the worker thread and swaps it
+ * in when it is ready; readers keep using the old one until then.
  */
-class LazyDatabase final : public Database {
-	Database *const db;
+class LazyDatabase final : public Database, DeferredMonitor {
+public:
+	/**
+	 * Creates a new (not yet opened) instance of the wrapped
+	 * database.  Called in the worker thread.
+	 */
+	typedef std::function<Database *(Error &error)> Factory;
+
+private:
+	/**
+	 * One instance of the wrapped database.  It is shared by all
+	 * callers which are currently using it, and it is closed and
+	 * freed when the last reference disappears.
+	 */
+	struct Wrapped {
+		Database *const db;
+
+		bool open;
+
+		explicit Wrapped(Database *_db):db(_db), open(false) {}
+
+		~Wrapped() {
+			if (open)
+				db->Close();
+			delete db;
+		}
+	};
+
+	typedef std::shared_ptr<Wrapped> WrappedPtr;
+
+	DatabaseListener &listener;
+
+	const Factory factory;
 
-	mutable bool open;
+	const bool background;
+
+	/**
+	 * Protects all attributes below.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * Signalled when #opening is cleared.
+	 */
+	mutable Cond cond;
+
+	mutable WrappedPtr current;
+
+	/**
+	 * Songs returned by GetSong(), and the instance which must
+	 * free them.
+	 */
+	mutable std::map<const LightSong *, WrappedPtr> borrowed;
+
+	/**
+	 * The worker thread which opens the database in "background"
+	 * mode or which builds a new instance for Reload().
+	 */
+	Thread thread;
+
+	/**
+	 * The worker thread is opening #current.
+	 */
+	bool opening;
+
+	/**
+	 * The worker thread is building a replacement for #current.
+	 */
+	bool reloading;
+
+	unsigned reload_id;
 
 public:
 	gcc_nonnull_all
-	LazyDatabase(Database *_db);
+	LazyDatabase(EventLoop &_loop, DatabaseListener &_listener,
+		     Database *_db,
+		     Factory _factory=Factory(), bool _background=false);
 
 	virtual ~LazyDatabase();
 
+	virtual bool Open(Error &error) override;
 	virtual void Close() override;
 
 	virtual const LightSong *GetSong(const char *uri_utf8,
@@ -62,8 +148,20 @@ public:
 
 	virtual time_t GetUpdateStamp() const override;
 
+	virtual unsigned Reload(Error &error) override;
+
 private:
-	bool EnsureOpen(Error &error) const;
+	/**
+	 * Obtain a reference to the current instance, waiting for
+	 * the worker thread or opening it if necessary.
+	 */
+	WrappedPtr Acquire(Error &error) const;
+
+	static void OpenThread(void *ctx);
+	static void ReloadThread(void *ctx);
+
+	/* virtual methods from class DeferredMonitor */
+	virtual void RunDeferred() override;
 };
 
 #endif
@@ -28,6 +28,8 @@
 #include "db/LightDirectory.hxx"
 #include "db/LightSong.hxx"
 #include "db/Stats.hxx"
+#include "db/Helpers.hxx"
+#include "db/UniqueTags.hxx"
 #include "SongFilter.hxx"
 #include "Compiler.h"
 #include "config/ConfigData.hxx"
@@ -38,6 +40,9 @@
 #include "protocol/Ack.hxx"
 #include "event/SocketMonitor.hxx"
 #include "event/IdleMonitor.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 #include "Log.hxx"
 
 #include <mpd/client.h>
@@ -46,6 +51,9 @@
 #include <cassert>
 #include <string>
 #include <list>
+#include <map>
+
+#include <string.h>
 
 class ProxySong : public LightSong {
 	Tag tag2;
@@ -61,19 +69,156 @@ public:
 	explicit AllocatedProxySong(mpd_song *_song)
 		:ProxySong(_song), song(_song) {}
 
+	AllocatedProxySong(const AllocatedProxySong &) = delete;
+
 	~AllocatedProxySong() {
 		mpd_song_free(song);
 	}
+
+	const mpd_song *GetSong() const {
+		return song;
+	}
+};
+
+/**
+ * A directory in the #ProxyCache.
+ */
+struct ProxyCacheDirectory {
+	typedef std::map<std::string, ProxyCacheDirectory> Map;
+
+	time_t mtime = 0;
+
+	/**
+	 * Pointers to the sub directories, which are owned by
+	 * ProxyCache::directories.
+	 */
+	std::list<const Map::value_type *> children;
+
+	std::list<AllocatedProxySong> songs;
+
+	std::list<PlaylistInfo> playlists;
+
+	gcc_pure
+	const AllocatedProxySong *FindSong(const char *uri) const;
 };
 
-class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
+/**
+ * A local replica of the whole upstream database, loaded with
+ * "listallinfo".  Once it is loaded, all queries are answered from
+ * it, without a network round trip.
+ */
+struct ProxyCache {
+	/**
+	 * All directories, indexed by their path.  The root directory
+	 * has the empty path.
+	 */
+	ProxyCacheDirectory::Map directories;
+
+	time_t update_stamp = 0;
+
+	ProxyCache() {
+		directories.emplace(std::string(), ProxyCacheDirectory());
+	}
+
+	/**
+	 * Look up a directory, and create it (and its parents) if it
+	 * does not exist yet.
+	 */
+	ProxyCacheDirectory &MakeDirectory(const std::string &path);
+
+	/**
+	 * Look up the directory which contains the given URI.
+	 */
+	ProxyCacheDirectory &MakeParent(const char *uri);
+
+	gcc_pure
+	const ProxyCacheDirectory *FindDirectory(const std::string &path) const {
+		auto i = directories.find(path);
+		return i != directories.end() ? &i->second : nullptr;
+	}
+
+	gcc_pure
+	const AllocatedProxySong *FindSong(const char *uri) const;
+
+	bool Load(const char *host, unsigned port, Error &error);
+};
+
+class ProxyDatabase final
+	: public Database, SocketMonitor, IdleMonitor {
 	DatabaseListener &listener;
 
 	std::string host;
 	unsigned port;
 
+	/**
+	 * Keep a local replica of the upstream database?
+	 */
+	bool cache_enabled;
+
 	struct mpd_connection *connection;
 
+	/**
+	 * The local replica which answers all queries, or nullptr if
+	 * it is disabled or has not been loaded yet.  Only accessed
+	 * in the main thread.
+	 */
+	ProxyCache *cache;
+
+	/**
+	 * Loads a new #ProxyCache in a separate thread over a
+	 * separate connection, so the main thread never waits for
+	 * the upstream MPD.  The result is handed to the main thread
+	 * with a #DeferredMonitor.
+	 */
+	class CacheLoader final : DeferredMonitor {
+		ProxyDatabase &db;
+
+		Thread thread;
+
+		/**
+		 * The result of the #thread; nullptr on error.  It is
+		 * owned by the thread until it has been joined.
+		 */
+		ProxyCache *loaded = nullptr;
+
+		Error error;
+
+		/**
+		 * Has the upstream database been modified again while
+		 * the #thread was running?
+		 */
+		bool outdated = false;
+
+	public:
+		CacheLoader(EventLoop &_loop, ProxyDatabase &_db)
+			:DeferredMonitor(_loop), db(_db) {}
+
+		bool IsRunning() const {
+			return thread.IsDefined();
+		}
+
+		/**
+		 * Start loading a new #ProxyCache.  If a load is
+		 * already running, another one is started after it
+		 * has finished.
+		 */
+		void Start();
+
+		/**
+		 * Wait for the thread and discard its result.
+		 */
+		void Stop();
+
+	private:
+		static void Task(void *ctx);
+
+		/* virtual methods from DeferredMonitor */
+		virtual void RunDeferred() override;
+	};
+
+	/* this is mutable because GetCache() must be "const" */
+	mutable CacheLoader cache_loader;
+
 	/* this is mutable because GetStats() must be "const" */
 	mutable time_t update_stamp;
 
@@ -93,7 +238,7 @@ public:
 	ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener)
 		:Database(proxy_db_plugin),
 		 SocketMonitor(_loop), IdleMonitor(_loop),
-		 listener(_listener) {}
+		 listener(_listener), cache_loader(_loop, *this) {}
 
 	static Database *Create(EventLoop &loop, DatabaseListener &listener,
 				const config_param &param,
@@ -133,6 +278,25 @@ private:
 
 	void Disconnect();
 
+	/**
+	 * Called by the #CacheLoader in the main thread after a new
+	 * #ProxyCache has been loaded.
+	 */
+	void OnCacheLoaded(ProxyCache *new_cache);
+
+	/**
+	 * Returns the #ProxyCache, or nullptr if queries must be sent
+	 * to the upstream MPD.  If the "idle" connection has been
+	 * lost, this starts a reload, which reconnects on success.
+	 */
+	const ProxyCache *GetCache() const;
+
+	bool VisitCache(const DatabaseSelection &selection,
+			VisitDirectory visit_directory,
+			VisitSong visit_song,
+			VisitPlaylist visit_playlist,
+			Error &error) const;
+
 	/* virtual methods from SocketMonitor */
 	virtual bool OnSocketReady(unsigned flags) override;
 
@@ -326,6 +490,7 @@ ProxyDatabase::Configure(const config_param &param, gcc_unused Error &error)
 {
 	host = param.GetBlockValue("host", "");
 	port = param.GetBlockValue("port", 0u);
+	cache_enabled = param.GetBlockValue("cache", false);
 
 	return true;
 }
@@ -338,12 +503,21 @@ ProxyDatabase::Open(Error &error)
 
 	update_stamp = 0;
 
+	cache = nullptr;
+	if (cache_enabled)
+		cache_loader.Start();
+
 	return true;
 }
 
 void
 ProxyDatabase::Close()
 {
+	cache_loader.Stop();
+
+	delete cache;
+	cache = nullptr;
+
 	if (connection != nullptr)
 		Disconnect();
 }
@@ -455,8 +629,14 @@ ProxyDatabase::OnIdle()
 
 	/* handle previous idle events */
 
-	if (idle_received & MPD_IDLE_DATABASE)
-		listener.OnDatabaseModified();
+	if (idle_received & MPD_IDLE_DATABASE) {
+		if (cache_enabled)
+			/* the listener will be notified as soon as
+			   the new replica is ready */
+			cache_loader.Start();
+		else
+			listener.OnDatabaseModified();
+	}
 
 	idle_received = 0;
 
@@ -481,9 +661,241 @@ ProxyDatabase::OnIdle()
 	SocketMonitor::ScheduleRead();
 }
 
+const AllocatedProxySong *
+ProxyCacheDirectory::FindSong(const char *uri) const
+{
+	for (const auto &song : songs)
+		if (strcmp(song.uri, uri) == 0)
+			return &song;
+
+	return nullptr;
+}
+
+ProxyCacheDirectory &
+ProxyCache::MakeDirectory(const std::string &path)
+{
+	auto i = directories.find(path);
+	if (i != directories.end())
+		return i->second;
+
+	ProxyCacheDirectory &parent = MakeParent(path.c_str());
+
+	i = directories.emplace(path, ProxyCacheDirectory()).first;
+	parent.children.push_back(&*i);
+	return i->second;
+}
+
+ProxyCacheDirectory &
+ProxyCache::MakeParent(const char *uri)
+{
+	const char *slash = strrchr(uri, '/');
+	return MakeDirectory(slash != nullptr
+			     ? std::string(uri, slash)
+			     : std::string());
+}
+
+const AllocatedProxySong *
+ProxyCache::FindSong(const char *uri) const
+{
+	const char *slash = strrchr(uri, '/');
+	const ProxyCacheDirectory *directory =
+		FindDirectory(slash != nullptr
+			      ? std::string(uri, slash)
+			      : std::string());
+	return directory != nullptr
+		? directory->FindSong(uri)
+		: nullptr;
+}
+
+bool
+ProxyCache::Load(const char *host, unsigned port, Error &error)
+{
+	struct mpd_connection *c = mpd_connection_new(host, port, 0);
+	if (c == nullptr) {
+		error.Set(libmpdclient_domain, (int)MPD_ERROR_OOM,
+			  "Out of memory");
+		return false;
+	}
+
+	if (!CheckError(c, error) ||
+	    (!mpd_send_list_all_meta(c, "") && !CheckError(c, error))) {
+		mpd_connection_free(c);
+		return false;
+	}
+
+	struct mpd_entity *entity;
+	while ((entity = mpd_recv_entity(c)) != nullptr) {
+		switch (mpd_entity_get_type(entity)) {
+		case MPD_ENTITY_TYPE_UNKNOWN:
+			break;
+
+		case MPD_ENTITY_TYPE_DIRECTORY: {
+			const struct mpd_directory *directory =
+				mpd_entity_get_directory(entity);
+			ProxyCacheDirectory &d =
+				MakeDirectory(mpd_directory_get_path(directory));
+#if LIBMPDCLIENT_CHECK_VERSION(2,9,0)
+			d.mtime = mpd_directory_get_last_modified(directory);
+#else
+			(void)d;
+#endif
+			break;
+		}
+
+		case MPD_ENTITY_TYPE_SONG: {
+			const struct mpd_song *song =
+				mpd_entity_get_song(entity);
+			MakeParent(mpd_song_get_uri(song))
+				.songs.emplace_back(mpd_song_dup(song));
+			break;
+		}
+
+		case MPD_ENTITY_TYPE_PLAYLIST: {
+			const struct mpd_playlist *playlist =
+				mpd_entity_get_playlist(entity);
+			const char *path = mpd_playlist_get_path(playlist);
+			MakeParent(path).playlists.emplace_back(path,
+								mpd_playlist_get_last_modified(playlist));
+			break;
+		}
+		}
+
+		mpd_entity_free(entity);
+	}
+
+	if (!mpd_response_finish(c) && !CheckError(c, error)) {
+		mpd_connection_free(c);
+		return false;
+	}
+
+	struct mpd_stats *stats = mpd_run_stats(c);
+	if (stats == nullptr) {
+		CheckError(c, error);
+		mpd_connection_free(c);
+		return false;
+	}
+
+	update_stamp = (time_t)mpd_stats_get_db_update_time(stats);
+	mpd_stats_free(stats);
+
+	mpd_connection_free(c);
+	return true;
+}
+
+void
+ProxyDatabase::CacheLoader::Start()
+{
+	assert(db.cache_enabled);
+
+	if (thread.IsDefined()) {
+		/* already running; reload again when it is
+		   finished */
+		outdated = true;
+		return;
+	}
+
+	outdated = false;
+	loaded = nullptr;
+	error.Clear();
+
+	if (!thread.Start(Task, this, error))
+		LogError(error);
+}
+
+void
+ProxyDatabase::CacheLoader::Stop()
+{
+	if (thread.IsDefined()) {
+		thread.Join();
+		delete loaded;
+		loaded = nullptr;
+	}
+
+	DeferredMonitor::Cancel();
+	outdated = false;
+}
+
+void
+ProxyDatabase::CacheLoader::Task(void *ctx)
+{
+	CacheLoader &loader = *(CacheLoader *)ctx;
+	const ProxyDatabase &db = loader.db;
+
+	SetThreadName("proxy_db");
+
+	ProxyCache *c = new ProxyCache();
+	if (!c->Load(db.host.empty() ? nullptr : db.host.c_str(), db.port,
+		     loader.error)) {
+		delete c;
+		c = nullptr;
+	}
+
+	loader.loaded = c;
+	loader.Schedule();
+}
+
+void
+ProxyDatabase::CacheLoader::RunDeferred()
+{
+	if (!thread.IsDefined())
+		return;
+
+	thread.Join();
+
+	if (loaded == nullptr) {
+		LogError(error, "Failed to load the upstream database");
+	} else {
+		db.OnCacheLoaded(loaded);
+		loaded = nullptr;
+	}
+
+	if (outdated)
+		Start();
+}
+
+void
+ProxyDatabase::OnCacheLoaded(ProxyCache *new_cache)
+{
+	delete cache;
+	cache = new_cache;
+
+	update_stamp = cache->update_stamp;
+
+	if (connection == nullptr) {
+		/* the upstream MPD is reachable again: restore the
+		   "idle" connection which triggers reloads */
+		Error error;
+		if (!Connect(error))
+			LogError(error);
+	}
+
+	listener.OnDatabaseModified();
+}
+
+const ProxyCache *
+ProxyDatabase::GetCache() const
+{
+	if (cache != nullptr && connection == nullptr &&
+	    !cache_loader.IsRunning())
+		cache_loader.Start();
+
+	return cache;
+}
+
 const LightSong *
 ProxyDatabase::GetSong(const char *uri, Error &error) const
 {
+	if (GetCache() != nullptr) {
+		const AllocatedProxySong *song = cache->FindSong(uri);
+		if (song == nullptr) {
+			error.Format(db_domain, DB_NOT_FOUND,
+				     "No such song: %s", uri);
+			return nullptr;
+		}
+
+		return new AllocatedProxySong(mpd_song_dup(song->GetSong()));
+	}
+
 	// TODO: eliminate the const_cast
 	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
 		return nullptr;
@@ -712,6 +1124,68 @@ ServerSupportsSearchBase(const struct mpd_connection *connection)
 #endif
 }
 
+static bool
+Visit(const ProxyCacheDirectory &directory,
+      bool recursive, const SongFilter *filter,
+      VisitDirectory visit_directory, VisitSong visit_song,
+      VisitPlaylist visit_playlist, Error &error)
+{
+	for (const auto *child : directory.children) {
+		if (visit_directory &&
+		    !visit_directory(LightDirectory(child->first.c_str(),
+						    child->second.mtime),
+				     error))
+			return false;
+
+		if (recursive &&
+		    !Visit(child->second, recursive, filter,
+			   visit_directory, visit_song, visit_playlist,
+			   error))
+			return false;
+	}
+
+	if (visit_song)
+		for (const auto &song : directory.songs)
+			if (Match(filter, song) && !visit_song(song, error))
+				return false;
+
+	if (visit_playlist)
+		for (const auto &playlist : directory.playlists)
+			if (!visit_playlist(playlist, LightDirectory::Root(),
+					    error))
+				return false;
+
+	return true;
+}
+
+bool
+ProxyDatabase::VisitCache(const DatabaseSelection &selection,
+			  VisitDirectory visit_directory,
+			  VisitSong visit_song,
+			  VisitPlaylist visit_playlist,
+			  Error &error) const
+{
+	assert(cache != nullptr);
+
+	const ProxyCacheDirectory *directory =
+		cache->FindDirectory(selection.uri);
+	if (directory != nullptr)
+		return ::Visit(*directory, selection.recursive,
+			       selection.filter,
+			       visit_directory, visit_song, visit_playlist,
+			       error);
+
+	const AllocatedProxySong *song =
+		cache->FindSong(selection.uri.c_str());
+	if (song == nullptr) {
+		error.Set(db_domain, DB_NOT_FOUND, "No such directory");
+		return false;
+	}
+
+	return !visit_song || !selection.Match(*song) ||
+		visit_song(*song, error);
+}
+
 bool
 ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitDirectory visit_directory,
@@ -719,6 +1193,10 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitPlaylist visit_playlist,
 		     Error &error) const
 {
+	if (GetCache() != nullptr)
+		return VisitCache(selection, visit_directory, visit_song,
+				  visit_playlist, error);
+
 	// TODO: eliminate the const_cast
 	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
 		return nullptr;
@@ -741,10 +1219,14 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 bool
 ProxyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 			       TagType tag_type,
-			       gcc_unused uint32_t group_mask,
+			       uint32_t group_mask,
 			       VisitTag visit_tag,
 			       Error &error) const
 {
+	if (GetCache() != nullptr)
+		return ::VisitUniqueTags(*this, selection, tag_type,
+					 group_mask, visit_tag, error);
+
 	// TODO: eliminate the const_cast
 	if (!const_cast<ProxyDatabase *>(this)->EnsureConnected(error))
 		return nullptr;
@@ -786,6 +1268,9 @@ bool
 ProxyDatabase::GetStats(const DatabaseSelection &selection,
 			DatabaseStats &stats, Error &error) const
 {
+	if (GetCache() != nullptr)
+		return ::GetStats(*this, selection, stats, error);
+
 	// TODO: match
 	(void)selection;
 
@@ -0,0 +1,798 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseBinary.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/PlaylistVector.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/TagSettings.h"
+#include "fs/Charset.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+#ifdef HAVE_ZLIB
+#include "lib/zlib/GzipFile.hxx"
+#endif
+#include "Log.hxx"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+static constexpr char BINARY_DB_MAGIC[8] = {
+	'M', 'P', 'D', 'b', 'i', 'n', 'D', 'B',
+};
+
+/**
+ * Format 2 adds the #SongIdentity to songs.
+ */
+static constexpr uint32_t BINARY_DB_FORMAT = 2;
+
+/**
+ * The oldest binary database format which can be loaded.
+ */
+static constexpr uint32_t OLDEST_BINARY_DB_FORMAT = 1;
+
+/**
+ * Written in host byte order; a file from a host with a different
+ * byte order is rejected.
+ */
+static constexpr uint32_t BINARY_DB_BYTE_ORDER = 0x01020304;
+
+/**
+ * The maximum recursion depth while loading; protects against
+ * corrupt files.
+ */
+static constexpr unsigned MAX_DIRECTORY_DEPTH = 256;
+
+bool
+db_binary_check(Path path)
+{
+	char magic[sizeof(BINARY_DB_MAGIC)];
+
+#ifdef HAVE_ZLIB
+	if (GzipReadHead(path, magic, sizeof(magic)) != sizeof(magic))
+		return false;
+#else
+	FILE *fp = FOpen(path, FOpenMode::ReadBinary);
+	if (fp == nullptr)
+		return false;
+
+	bool success = fread(magic, sizeof(magic), 1, fp) == 1;
+	fclose(fp);
+	if (!success)
+		return false;
+#endif
+
+	return memcmp(magic, BINARY_DB_MAGIC, sizeof(magic)) == 0;
+}
+
+/**
+ * The directory device ids which are stored in the database; all
+ * others are runtime values which are not saved.
+ */
+gcc_const
+static uint32_t
+ExportDevice(unsigned device)
+{
+	return device == DEVICE_INARCHIVE || device == DEVICE_CONTAINER
+		? device
+		: 0;
+}
+
+class BinaryDatabaseWriter {
+	FILE *const fp;
+
+	std::unordered_map<std::string, uint32_t> string_ids;
+
+	/**
+	 * The strings in the order of their ids; they point into the
+	 * keys of #string_ids.
+	 */
+	std::vector<const char *> strings;
+
+	/**
+	 * Maps each #TagType to its index in the tag name table, or
+	 * -1 if the tag type is disabled.
+	 */
+	int tag_index[TAG_NUM_OF_ITEM_TYPES];
+
+	unsigned n_tags;
+
+public:
+	explicit BinaryDatabaseWriter(FILE *_fp):fp(_fp), n_tags(0) {
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			tag_index[i] = ignore_tag_items[i] ? -1 : n_tags++;
+	}
+
+	void Save(const Directory &root);
+
+private:
+	uint32_t Intern(const char *s) {
+		auto i = string_ids.emplace(s, strings.size());
+		if (i.second)
+			strings.push_back(i.first->first.c_str());
+		return i.first->second;
+	}
+
+	gcc_pure
+	uint32_t GetId(const char *s) const {
+		auto i = string_ids.find(s);
+		assert(i != string_ids.end());
+		return i->second;
+	}
+
+	void Collect(const Tag &tag);
+	void Collect(const Directory &directory);
+
+	void Write(const void *data, size_t size) {
+		fwrite(data, size, 1, fp);
+	}
+
+	void WriteU32(uint32_t value) {
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU64(uint64_t value) {
+		WriteU32(uint32_t(value));
+		WriteU32(uint32_t(value >> 32));
+	}
+
+	void WriteTime(time_t t) {
+		WriteU64(t);
+	}
+
+	void WriteStrings();
+	void WriteTag(const Tag &tag);
+	void WriteSong(const Song &song);
+	void WriteDirectory(const Directory &directory);
+};
+
+void
+BinaryDatabaseWriter::Collect(const Tag &tag)
+{
+	for (unsigned i = 0; i < tag.num_items; ++i)
+		if (tag_index[tag.items[i]->type] >= 0)
+			Intern(tag.items[i]->value);
+}
+
+/**
+ * Like Directory::GetName(), but returns an empty string for the
+ * root directory.
+ */
+gcc_pure
+static const char *
+GetDirectoryName(const Directory &directory)
+{
+	return directory.IsRoot() ? "" : directory.GetName();
+}
+
+void
+BinaryDatabaseWriter::Collect(const Directory &directory)
+{
+	Intern(GetDirectoryName(directory));
+
+	for (const auto &child : directory.children) {
+		if (child.IsMount())
+			Intern(child.GetName());
+		else
+			Collect(child);
+	}
+
+	for (const auto &song : directory.songs) {
+		Intern(song.uri);
+		Collect(song.tag);
+	}
+
+	for (const PlaylistInfo &pi : directory.playlists)
+		Intern(pi.name.c_str());
+}
+
+void
+BinaryDatabaseWriter::WriteStrings()
+{
+	uint32_t offset = 0;
+	for (const char *s : strings) {
+		WriteU32(offset);
+		offset += strlen(s) + 1;
+	}
+
+	WriteU32(offset);
+
+	for (const char *s : strings)
+		Write(s, strlen(s) + 1);
+
+	/* pad to a multiple of 4 bytes */
+	static constexpr char padding[4] = {0, 0, 0, 0};
+	Write(padding, (4 - offset % 4) % 4);
+}
+
+void
+BinaryDatabaseWriter::WriteTag(const Tag &tag)
+{
+	WriteU32(uint32_t(tag.time));
+	WriteU32(tag.has_playlist);
+
+	unsigned n = 0;
+	for (unsigned i = 0; i < tag.num_items; ++i)
+		if (tag_index[tag.items[i]->type] >= 0)
+			++n;
+
+	WriteU32(n);
+
+	for (unsigned i = 0; i < tag.num_items; ++i) {
+		const TagItem &item = *tag.items[i];
+		if (tag_index[item.type] < 0)
+			continue;
+
+		WriteU32(tag_index[item.type]);
+		WriteU32(GetId(item.value));
+	}
+}
+
+void
+BinaryDatabaseWriter::WriteSong(const Song &song)
+{
+	WriteU32(GetId(song.uri));
+	WriteU32(song.start_ms);
+	WriteU32(song.end_ms);
+	WriteTime(song.mtime);
+	WriteU32(song.identity.device);
+	WriteU32(song.identity.inode);
+	WriteU64(song.identity.size);
+	WriteTag(song.tag);
+}
+
+void
+BinaryDatabaseWriter::WriteDirectory(const Directory &directory)
+{
+	WriteU32(GetId(GetDirectoryName(directory)));
+
+	if (directory.IsMount()) {
+		/* mount points are saved as empty directories, just
+		   like the text format does */
+		WriteU32(0);
+		WriteTime(0);
+		WriteU32(0);
+		WriteU32(0);
+		WriteU32(0);
+		return;
+	}
+
+	WriteU32(ExportDevice(directory.device));
+	WriteTime(directory.mtime);
+
+	uint32_t n = 0;
+	for (gcc_unused const auto &child : directory.children)
+		++n;
+	WriteU32(n);
+
+	for (const auto &child : directory.children) {
+		WriteDirectory(child);
+
+		if (ferror(fp))
+			return;
+	}
+
+	n = 0;
+	for (gcc_unused const auto &song : directory.songs)
+		++n;
+	WriteU32(n);
+
+	for (const auto &song : directory.songs)
+		WriteSong(song);
+
+	n = 0;
+	for (gcc_unused const PlaylistInfo &pi : directory.playlists)
+		++n;
+	WriteU32(n);
+
+	for (const PlaylistInfo &pi : directory.playlists) {
+		WriteU32(GetId(pi.name.c_str()));
+		WriteTime(pi.mtime);
+	}
+}
+
+void
+BinaryDatabaseWriter::Save(const Directory &root)
+{
+	const uint32_t charset = Intern(GetFSCharset());
+	const uint32_t version = Intern(VERSION);
+
+	unsigned tag_names[TAG_NUM_OF_ITEM_TYPES];
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (tag_index[i] >= 0)
+			tag_names[tag_index[i]] = Intern(tag_item_names[i]);
+
+	Collect(root);
+
+	Write(BINARY_DB_MAGIC, sizeof(BINARY_DB_MAGIC));
+	WriteU32(BINARY_DB_FORMAT);
+	WriteU32(BINARY_DB_BYTE_ORDER);
+	WriteU32(strings.size());
+	WriteU32(charset);
+	WriteU32(version);
+	WriteU32(n_tags);
+
+	for (unsigned i = 0; i < n_tags; ++i)
+		WriteU32(tag_names[i]);
+
+	WriteStrings();
+	WriteDirectory(root);
+}
+
+void
+db_save_binary(FILE *fp, const Directory &root)
+{
+	BinaryDatabaseWriter writer(fp);
+	writer.Save(root);
+}
+
+/**
+ * The contents of a database file, mapped into memory (or read into
+ * a buffer if mmap() is not available or if the file is compressed).
+ */
+class MappedDatabaseFile {
+	void *data;
+	size_t size;
+
+#ifndef WIN32
+	bool mapped;
+#endif
+
+public:
+	MappedDatabaseFile()
+		:data(nullptr), size(0)
+#ifndef WIN32
+		, mapped(false)
+#endif
+	{}
+
+	~MappedDatabaseFile() {
+#ifndef WIN32
+		if (mapped) {
+			munmap(data, size);
+			return;
+		}
+#endif
+
+		free(data);
+	}
+
+	MappedDatabaseFile(const MappedDatabaseFile &) = delete;
+	MappedDatabaseFile &operator=(const MappedDatabaseFile &) = delete;
+
+	bool Open(Path path, Error &error);
+
+	const uint8_t *begin() const {
+		return (const uint8_t *)data;
+	}
+
+	const uint8_t *end() const {
+		return begin() + size;
+	}
+};
+
+bool
+MappedDatabaseFile::Open(Path path, Error &error)
+{
+	int fd = OpenFile(path, O_RDONLY, 0);
+	if (fd < 0) {
+		error.SetErrno("Failed to open database file");
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		error.SetErrno("Failed to stat database file");
+		close(fd);
+		return false;
+	}
+
+	size = st.st_size;
+
+#ifdef HAVE_ZLIB
+	unsigned char head[2];
+	const ssize_t head_size = read(fd, head, sizeof(head));
+	if (head_size > 0 && IsGzipMagic(head, head_size)) {
+		/* compressed files cannot be mapped; decompress them
+		   into a buffer */
+		close(fd);
+		data = GzipLoadFile(path, size, error);
+		return data != nullptr;
+	}
+
+	lseek(fd, 0, SEEK_SET);
+#endif
+
+#ifndef WIN32
+	data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	mapped = data != MAP_FAILED;
+	if (mapped) {
+		close(fd);
+#ifdef MADV_SEQUENTIAL
+		madvise(data, size, MADV_SEQUENTIAL);
+#endif
+		return true;
+	}
+#endif
+
+	/* fall back to reading the whole file */
+
+	data = malloc(size);
+	if (data == nullptr) {
+		error.Set(db_domain, "Out of memory");
+		close(fd);
+		return false;
+	}
+
+	size_t position = 0;
+	while (position < size) {
+		ssize_t nbytes = read(fd, (uint8_t *)data + position,
+				      size - position);
+		if (nbytes <= 0) {
+			error.SetErrno("Failed to read database file");
+			close(fd);
+			return false;
+		}
+
+		position += nbytes;
+	}
+
+	close(fd);
+	return true;
+}
+
+class BinaryDatabaseReader {
+	const uint8_t *p;
+	const uint8_t *const end;
+
+	const uint8_t *offsets;
+	const char *blob;
+	uint32_t n_strings, blob_size;
+
+	/**
+	 * The format of the file, obtained from the header.
+	 */
+	uint32_t format;
+
+	std::vector<TagType> tag_types;
+
+	SongArena &arena;
+
+public:
+	BinaryDatabaseReader(const uint8_t *begin, const uint8_t *_end,
+			     SongArena &_arena)
+		:p(begin), end(_end), arena(_arena) {}
+
+	bool Load(Directory &root, Error &error);
+
+private:
+	bool Skip(size_t size) {
+		if (size_t(end - p) < size)
+			return false;
+
+		p += size;
+		return true;
+	}
+
+	bool ReadU32(uint32_t &value_r) {
+		if (end - p < (ptrdiff_t)sizeof(value_r))
+			return false;
+
+		memcpy(&value_r, p, sizeof(value_r));
+		p += sizeof(value_r);
+		return true;
+	}
+
+	bool ReadU64(uint64_t &value_r) {
+		uint32_t low, high;
+		if (!ReadU32(low) || !ReadU32(high))
+			return false;
+
+		value_r = uint64_t(low) | (uint64_t(high) << 32);
+		return true;
+	}
+
+	bool ReadTime(time_t &t) {
+		uint64_t value;
+		if (!ReadU64(value))
+			return false;
+
+		t = time_t(value);
+		return true;
+	}
+
+	gcc_pure
+	const char *GetString(uint32_t id) const {
+		if (id >= n_strings)
+			return nullptr;
+
+		uint32_t offset;
+		memcpy(&offset, offsets + id * sizeof(offset), sizeof(offset));
+		return offset < blob_size
+			? blob + offset
+			: nullptr;
+	}
+
+	bool ReadString(const char *&s) {
+		uint32_t id;
+		return ReadU32(id) && (s = GetString(id)) != nullptr;
+	}
+
+	bool ReadHeader(Error &error);
+	bool ReadSong(Directory &parent);
+	bool ReadDirectory(Directory &directory, unsigned depth);
+};
+
+static void
+SetCorrupted(Error &error)
+{
+	error.Set(db_domain, "Database corrupted");
+}
+
+bool
+BinaryDatabaseReader::ReadHeader(Error &error)
+{
+	uint32_t byte_order, charset_id, version_id, n_tags;
+
+	if (!Skip(sizeof(BINARY_DB_MAGIC)) ||
+	    !ReadU32(format) || !ReadU32(byte_order)) {
+		SetCorrupted(error);
+		return false;
+	}
+
+	if (format < OLDEST_BINARY_DB_FORMAT || format > BINARY_DB_FORMAT ||
+	    byte_order != BINARY_DB_BYTE_ORDER) {
+		error.Set(db_domain,
+			  "Database format mismatch, "
+			  "discarding database file");
+		return false;
+	}
+
+	if (!ReadU32(n_strings) || !ReadU32(charset_id) ||
+	    !ReadU32(version_id) || !ReadU32(n_tags) ||
+	    n_tags > TAG_NUM_OF_ITEM_TYPES) {
+		SetCorrupted(error);
+		return false;
+	}
+
+	const uint8_t *tag_ids = p;
+	if (!Skip(n_tags * sizeof(uint32_t))) {
+		SetCorrupted(error);
+		return false;
+	}
+
+	/* the string table: n_strings+1 offsets, followed by the
+	   string data */
+
+	offsets = p;
+	if (n_strings >= (end - p) / sizeof(uint32_t) ||
+	    !Skip(n_strings * sizeof(uint32_t)) ||
+	    !ReadU32(blob_size)) {
+		SetCorrupted(error);
+		return false;
+	}
+
+	blob = (const char *)p;
+	if (!Skip(blob_size) || !Skip((4 - blob_size % 4) % 4) ||
+	    (blob_size > 0 && blob[blob_size - 1] != 0)) {
+		/* the last string must be null-terminated, which
+		   guarantees that all strings are */
+		SetCorrupted(error);
+		return false;
+	}
+
+	const char *const new_charset = GetString(charset_id);
+	if (new_charset == nullptr || GetString(version_id) == nullptr) {
+		SetCorrupted(error);
+		return false;
+	}
+
+	const char *const old_charset = GetFSCharset();
+	if (*old_charset != 0 && strcmp(new_charset, old_charset) != 0) {
+		error.Format(db_domain,
+			     "Existing database has charset "
+			     "\"%s\" instead of \"%s\"; "
+			     "discarding database file",
+			     new_charset, old_charset);
+		return false;
+	}
+
+	bool tags[TAG_NUM_OF_ITEM_TYPES];
+	memset(tags, false, sizeof(tags));
+
+	tag_types.reserve(n_tags);
+	for (unsigned i = 0; i < n_tags; ++i) {
+		uint32_t id;
+		memcpy(&id, tag_ids + i * sizeof(id), sizeof(id));
+
+		const char *name = GetString(id);
+		if (name == nullptr) {
+			SetCorrupted(error);
+			return false;
+		}
+
+		TagType tag = tag_name_parse(name);
+		if (tag == TAG_NUM_OF_ITEM_TYPES) {
+			error.Format(db_domain,
+				     "Unrecognized tag '%s', "
+				     "discarding database file",
+				     name);
+			return false;
+		}
+
+		tags[tag] = true;
+		tag_types.push_back(tag);
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		if (!ignore_tag_items[i] && !tags[i]) {
+			error.Set(db_domain,
+				  "Tag list mismatch, "
+				  "discarding database file");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+BinaryDatabaseReader::ReadSong(Directory &parent)
+{
+	const char *uri;
+	uint32_t start_ms, end_ms, duration, has_playlist, n_items;
+	time_t mtime;
+
+	if (!ReadString(uri) || *uri == 0 ||
+	    !ReadU32(start_ms) || !ReadU32(end_ms) || !ReadTime(mtime))
+		return false;
+
+	uint32_t device = 0, inode = 0;
+	uint64_t size = 0;
+	if (format >= 2 &&
+	    (!ReadU32(device) || !ReadU32(inode) || !ReadU64(size)))
+		return false;
+
+	if (!ReadU32(duration) || !ReadU32(has_playlist) ||
+	    !ReadU32(n_items))
+		return false;
+
+	TagBuilder tag;
+	tag.SetTime(int(duration));
+	tag.SetHasPlaylist(has_playlist != 0);
+
+	for (unsigned i = 0; i < n_items; ++i) {
+		uint32_t index;
+		const char *value;
+		if (!ReadU32(index) || index >= tag_types.size() ||
+		    !ReadString(value))
+			return false;
+
+		tag.AddItem(tag_types[index], value);
+	}
+
+	Song *song = Song::NewFile(uri, parent, arena);
+	song->start_ms = start_ms;
+	song->end_ms = end_ms;
+	song->mtime = mtime;
+	song->identity = SongIdentity(size, device, inode);
+	song->CommitTag(tag);
+
+	parent.AddSong(song);
+	return true;
+}
+
+bool
+BinaryDatabaseReader::ReadDirectory(Directory &directory, unsigned depth)
+{
+	uint32_t device, n;
+
+	if (!ReadU32(device) || !ReadTime(directory.mtime))
+		return false;
+
+	directory.device = device;
+
+	if (!ReadU32(n))
+		return false;
+
+	if (depth >= MAX_DIRECTORY_DEPTH && n > 0)
+		return false;
+
+	for (unsigned i = 0; i < n; ++i) {
+		const char *name;
+		if (!ReadString(name) || *name == 0)
+			return false;
+
+		Directory *child = directory.CreateChild(name);
+		if (!ReadDirectory(*child, depth + 1))
+			return false;
+	}
+
+	if (!ReadU32(n))
+		return false;
+
+	for (unsigned i = 0; i < n; ++i)
+		if (!ReadSong(directory))
+			return false;
+
+	if (!ReadU32(n))
+		return false;
+
+	for (unsigned i = 0; i < n; ++i) {
+		const char *name;
+		time_t mtime;
+		if (!ReadString(name) || !ReadTime(mtime))
+			return false;
+
+		directory.playlists.UpdateOrInsert(PlaylistInfo(name, mtime));
+	}
+
+	return true;
+}
+
+bool
+BinaryDatabaseReader::Load(Directory &root, Error &error)
+{
+	if (!ReadHeader(error))
+		return false;
+
+	LogDebug(db_domain, "reading DB");
+
+	const char *name;
+	bool success;
+
+	db_lock();
+	success = ReadString(name) && ReadDirectory(root, 0);
+	db_unlock();
+
+	if (!success) {
+		SetCorrupted(error);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+db_load_binary(Path path, Directory &root, SongArena &arena,
+	       Error &error)
+{
+	MappedDatabaseFile file;
+	if (!file.Open(path, error))
+		return false;
+
+	BinaryDatabaseReader reader(file.begin(), file.end(), arena);
+	return reader.Load(root, error);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_BINARY_HXX
+#define MPD_DATABASE_BINARY_HXX
+
+#include "Compiler.h"
+
+#include <stdio.h>
+
+struct Directory;
+class SongArena;
+class Path;
+class Error;
+
+/*
+ * The binary database format.  The file starts with a header, a
+ * string table (all names, URIs and tag values, each stored only
+ * once) and the list of tag names; it is followed by the directory
+ * tree, which refers to strings by their index.  All integers are
+ * 32 bit in host byte order.
+ *
+ * The file is mapped into memory while loading, and strings are
+ * taken from the mapping without copying or parsing them.
+ */
+
+/**
+ * Does the specified file look like a binary database?
+ */
+gcc_pure
+bool
+db_binary_check(Path path);
+
+void
+db_save_binary(FILE *file, const Directory &root);
+
+bool
+db_load_binary(Path path, Directory &root, SongArena &arena,
+	       Error &error);
+
+#endif
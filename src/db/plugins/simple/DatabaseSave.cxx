@@ -31,6 +31,8 @@
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#include <string>
+
 #include <string.h>
 #include <stdlib.h>
 
@@ -40,8 +42,13 @@
 #define DIRECTORY_MPD_VERSION "mpd_version: "
 #define DIRECTORY_FS_CHARSET "fs_charset: "
 #define DB_TAG_PREFIX "tag: "
+#define JOURNAL_REPLACE "journal_replace: "
+#define JOURNAL_DELETE "journal_delete: "
 
-static constexpr unsigned DB_FORMAT = 2;
+/**
+ * Format 3 adds the "identity" line to songs.
+ */
+static constexpr unsigned DB_FORMAT = 3;
 
 /**
  * The oldest database format understood by this MPD version.
@@ -49,7 +56,7 @@ static constexpr unsigned DB_FORMAT = 2;
 static constexpr unsigned OLDEST_DB_FORMAT = 1;
 
 void
-db_save_internal(FILE *fp, const Directory &music_root)
+db_save_header(FILE *fp)
 {
 	fprintf(fp, "%s\n", DIRECTORY_INFO_BEGIN);
 	fprintf(fp, DB_FORMAT_PREFIX "%u\n", DB_FORMAT);
@@ -61,17 +68,36 @@ db_save_internal(FILE *fp, const Directory &music_root)
 			fprintf(fp, DB_TAG_PREFIX "%s\n", tag_item_names[i]);
 
 	fprintf(fp, "%s\n", DIRECTORY_INFO_END);
+}
 
+void
+db_save_internal(FILE *fp, const Directory &music_root)
+{
+	db_save_header(fp);
 	directory_save(fp, music_root);
 }
 
-bool
-db_load_internal(TextFile &file, Directory &music_root, Error &error)
+void
+db_save_journal(FILE *fp, const char *uri, const Directory *directory)
+{
+	if (directory == nullptr) {
+		fprintf(fp, JOURNAL_DELETE "%s\n", uri);
+		return;
+	}
+
+	fprintf(fp, JOURNAL_REPLACE "%s\n", uri);
+	directory_save(fp, *directory);
+}
+
+/**
+ * Parse and check the "info" header written by db_save_header().
+ */
+static bool
+db_load_header(TextFile &file, Error &error)
 {
 	char *line;
 	unsigned format = 0;
 	bool found_charset = false, found_version = false;
-	bool success;
 	bool tags[TAG_NUM_OF_ITEM_TYPES];
 
 	/* get initial info */
@@ -149,11 +175,63 @@ db_load_internal(TextFile &file, Directory &music_root, Error &error)
 		}
 	}
 
+	return true;
+}
+
+bool
+db_load_internal(TextFile &file, Directory &music_root, SongArena &arena,
+		 Error &error)
+{
+	if (!db_load_header(file, error))
+		return false;
+
 	LogDebug(db_domain, "reading DB");
 
 	db_lock();
-	success = directory_load(file, music_root, error);
+	const bool success = directory_load(file, music_root, arena, error);
 	db_unlock();
 
 	return success;
 }
+
+bool
+db_load_journal(TextFile &file, Directory &music_root, SongArena &arena,
+		Error &error)
+{
+	if (!db_load_header(file, error))
+		return false;
+
+	LogDebug(db_domain, "reading DB journal");
+
+	const ScopeDatabaseLock protect;
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr) {
+		if (StringStartsWith(line, JOURNAL_REPLACE)) {
+			const char *uri = line + sizeof(JOURNAL_REPLACE) - 1;
+			if (*uri == 0) {
+				error.Format(db_domain,
+					     "Malformed line: %s", line);
+				return false;
+			}
+
+			/* copy the URI, because the line buffer is
+			   reused by the next ReadLine() call */
+			const std::string uri2(uri);
+			if (!directory_load_replace(file, music_root,
+						    uri2.c_str(),
+						    arena, error))
+				return false;
+		} else if (StringStartsWith(line, JOURNAL_DELETE)) {
+			const char *uri = line + sizeof(JOURNAL_DELETE) - 1;
+			auto r = music_root.LookupDirectory(uri);
+			if (r.uri == nullptr && !r.directory->IsRoot())
+				r.directory->Delete();
+		} else {
+			error.Format(db_domain, "Malformed line: %s", line);
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -23,13 +23,39 @@
 #include <stdio.h>
 
 struct Directory;
+class SongArena;
 class TextFile;
 class Error;
 
+/**
+ * Write the "info" header, i.e. everything except the directory
+ * tree.
+ */
+void
+db_save_header(FILE *file);
+
 void
 db_save_internal(FILE *file, const Directory &root);
 
 bool
-db_load_internal(TextFile &file, Directory &root, Error &error);
+db_load_internal(TextFile &file, Directory &root, SongArena &arena,
+		 Error &error);
+
+/**
+ * Append a record to the journal file, which replaces the directory
+ * with the given URI (or deletes it if #directory is nullptr) when
+ * the journal is loaded.  The file must begin with db_save_header().
+ */
+void
+db_save_journal(FILE *fp, const char *uri, const Directory *directory);
+
+/**
+ * Apply the records of a journal file (written by db_save_header()
+ * and db_save_journal()) to a database which was loaded from the
+ * base file.
+ */
+bool
+db_load_journal(TextFile &file, Directory &root, SongArena &arena,
+		Error &error);
 
 #endif
@@ -21,6 +21,7 @@
 #include "Directory.hxx"
 #include "SongSort.hxx"
 #include "Song.hxx"
+#include "SongIndex.hxx"
 #include "Mount.hxx"
 #include "db/LightDirectory.hxx"
 #include "db/LightSong.hxx"
@@ -42,14 +43,25 @@ Directory::Directory(std::string &&_path_utf8, Directory *_parent)
 	 mtime(0),
 	 inode(0), device(0),
 	 path(std::move(_path_utf8)),
-	 mounted_database(nullptr)
+	 mounted_database(nullptr),
+	 song_index(nullptr)
 {
+	memory_database.Add(sizeof(*this) + path.length());
 }
 
 Directory::~Directory()
 {
+	memory_database.Sub(sizeof(*this) + path.length());
+
 	delete mounted_database;
 
+	if (!songs.empty()) {
+		SongIndex *index = GetSongIndex();
+		if (index != nullptr)
+			for (const auto &song : songs)
+				index->Remove(song);
+	}
+
 	songs.clear_and_dispose(Song::Disposer());
 	children.clear_and_dispose(Disposer());
 }
@@ -57,9 +69,10 @@ Directory::~Directory()
 void
 Directory::Delete()
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(parent != nullptr);
 
+	parent->child_index.Remove(*this);
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   Disposer());
 }
@@ -75,7 +88,7 @@ Directory::GetName() const
 Directory *
 Directory::CreateChild(const char *name_utf8)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(name_utf8 != nullptr);
 	assert(*name_utf8 != 0);
 
@@ -85,6 +98,7 @@ Directory::CreateChild(const char *name_utf8)
 
 	Directory *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	child_index.Add(*child, children);
 	return child;
 }
 
@@ -93,6 +107,9 @@ Directory::FindChild(const char *name) const
 {
 	assert(holding_db_lock());
 
+	if (child_index.IsDefined())
+		return child_index.Find(name);
+
 	for (const auto &child : children)
 		if (strcmp(child.GetName(), name) == 0)
 			return &child;
@@ -103,15 +120,16 @@ Directory::FindChild(const char *name) const
 void
 Directory::PruneEmpty()
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty())
+		if (child->IsEmpty()) {
+			child_index.Remove(*child);
 			child = children.erase_and_dispose(child, Disposer());
-		else
+		} else
 			++child;
 	}
 }
@@ -161,32 +179,71 @@ Directory::LookupDirectory(const char *uri)
 	return { d, rest };
 }
 
+SongIndex *
+Directory::GetSongIndex() const
+{
+	const Directory *d = this;
+	while (d->parent != nullptr)
+		d = d->parent;
+
+	return d->song_index;
+}
+
 void
 Directory::AddSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
 	songs.push_back(*song);
+	song_index_by_name.Add(*song, songs);
+	IndexSong(*song);
 }
 
 void
 Directory::RemoveSong(Song *song)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(song->parent == this);
 
+	UnindexSong(*song);
+	song_index_by_name.Remove(*song);
 	songs.erase(songs.iterator_to(*song));
 }
 
+void
+Directory::UnindexSong(const Song &song)
+{
+	assert(holding_db_write_lock());
+	assert(song.parent == this);
+
+	SongIndex *index = GetSongIndex();
+	if (index != nullptr)
+		index->Remove(song);
+}
+
+void
+Directory::IndexSong(const Song &song)
+{
+	assert(holding_db_write_lock());
+	assert(song.parent == this);
+
+	SongIndex *index = GetSongIndex();
+	if (index != nullptr)
+		index->Add(song);
+}
+
 const Song *
 Directory::FindSong(const char *name_utf8) const
 {
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index_by_name.IsDefined())
+		return song_index_by_name.Find(name_utf8);
+
 	for (auto &song : songs) {
 		assert(song.parent == this);
 
@@ -207,7 +264,7 @@ directory_cmp(const Directory &a, const Directory &b)
 void
 Directory::Sort()
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	children.sort(directory_cmp);
 	song_list_sort(songs);
@@ -220,23 +277,33 @@ bool
 Directory::Walk(bool recursive, const SongFilter *filter,
 		VisitDirectory visit_directory, VisitSong visit_song,
 		VisitPlaylist visit_playlist,
-		Error &error) const
+		Error &error,
+		MountWalkList *mount_walks) const
 {
 	assert(!error.IsDefined());
 
 	if (IsMount()) {
 		assert(IsEmpty());
 
+		MountWalk *walk = mount_walks != nullptr
+			? mount_walks->Find(*mounted_database)
+			: nullptr;
+
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		db_unlock();
-		bool result = WalkMount(GetPath(), *mounted_database,
-					recursive, filter,
-					visit_directory, visit_song,
-					visit_playlist,
-					error);
-		db_lock();
+		db_unlock_shared();
+		bool result = walk != nullptr
+			? walk->Finish(mount_walks->timeout_ms,
+				       visit_directory, visit_song,
+				       visit_playlist,
+				       error)
+			: WalkMount(GetPath(), *mounted_database,
+				    recursive, filter,
+				    visit_directory, visit_song,
+				    visit_playlist,
+				    error);
+		db_lock_shared();
 		return result;
 	}
 
@@ -263,7 +330,7 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		if (recursive &&
 		    !child.Walk(recursive, filter,
 				visit_directory, visit_song, visit_playlist,
-				error))
+				error, mount_walks))
 			return false;
 	}
 
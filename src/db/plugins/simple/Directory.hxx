@@ -25,6 +25,7 @@
 #include "db/Visitor.hxx"
 #include "db/PlaylistVector.hxx"
 #include "Song.hxx"
+#include "NameIndex.hxx"
 
 #include <boost/intrusive/list.hpp>
 
@@ -45,10 +46,25 @@ static constexpr unsigned DEVICE_CONTAINER = -2;
 
 struct db_visitor;
 class SongFilter;
+class SongIndex;
 class Error;
 class Database;
+class MountWalkList;
 
 struct Directory {
+	struct SongName {
+		const char *operator()(const Song &song) const {
+			return song.uri;
+		}
+	};
+
+	struct ChildName {
+		template<typename D>
+		const char *operator()(const D &directory) const {
+			return directory.GetName();
+		}
+	};
+
 	static constexpr auto link_mode = boost::intrusive::normal_link;
 	typedef boost::intrusive::link_mode<link_mode> LinkMode;
 	typedef boost::intrusive::list_member_hook<LinkMode> Hook;
@@ -90,6 +106,13 @@ struct Directory {
 	 */
 	SongList songs;
 
+	/**
+	 * Lookup tables for FindChild() and FindSong() in large
+	 * directories.
+	 */
+	NameIndex<Directory, ChildName> child_index;
+	NameIndex<Song, SongName> song_index_by_name;
+
 	PlaylistVector playlists;
 
 	Directory *parent;
@@ -104,6 +127,12 @@ struct Directory {
 	 */
 	Database *mounted_database;
 
+	/**
+	 * The tag index of this directory tree.  Only set in the
+	 * root directory; use GetSongIndex().
+	 */
+	SongIndex *song_index;
+
 public:
 	Directory(std::string &&_path_utf8, Directory *_parent);
 	~Directory();
@@ -245,6 +274,13 @@ public:
 		return const_cast<Song *>(cthis->FindSong(name_utf8));
 	}
 
+	/**
+	 * Returns the #SongIndex of the tree this directory belongs
+	 * to, or nullptr if there is none.
+	 */
+	gcc_pure
+	SongIndex *GetSongIndex() const;
+
 	/**
 	 * Add a song object to this directory.  Its "parent" attribute must
 	 * be set already.
@@ -258,6 +294,22 @@ public:
 	 */
 	void RemoveSong(Song *song);
 
+	/**
+	 * Remove a song of this directory from the #SongIndex before
+	 * its tag gets modified.  Call IndexSong() afterwards.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void UnindexSong(const Song &song);
+
+	/**
+	 * Add a song of this directory to the #SongIndex after its tag
+	 * has been modified.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void IndexSong(const Song &song);
+
 	/**
 	 * Caller must lock the #db_mutex.
 	 */
@@ -272,11 +324,16 @@ public:
 
 	/**
 	 * Caller must lock #db_mutex.
+	 *
+	 * @param mount_walks if not nullptr, then the results of
+	 * mounted databases are taken from the #MountWalk objects
+	 * found there, instead of visiting them in this thread
 	 */
 	bool Walk(bool recursive, const SongFilter *match,
 		  VisitDirectory visit_directory, VisitSong visit_song,
 		  VisitPlaylist visit_playlist,
-		  Error &error) const;
+		  Error &error,
+		  MountWalkList *mount_walks=nullptr) const;
 
 	gcc_pure
 	LightDirectory Export() const;
@@ -30,6 +30,9 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
+#include <string>
+
+#include <assert.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -120,7 +123,7 @@ ParseLine(Directory &directory, const char *line)
 
 static Directory *
 directory_load_subdir(TextFile &file, Directory &parent, const char *name,
-		      Error &error)
+		      SongArena &arena, Error &error)
 {
 	bool success;
 
@@ -151,7 +154,7 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name,
 		}
 	}
 
-	success = directory_load(file, *directory, error);
+	success = directory_load(file, *directory, arena, error);
 	if (!success) {
 		directory->Delete();
 		return nullptr;
@@ -161,7 +164,8 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name,
 }
 
 bool
-directory_load(TextFile &file, Directory &directory, Error &error)
+directory_load(TextFile &file, Directory &directory, SongArena &arena,
+	       Error &error)
 {
 	const char *line;
 
@@ -171,7 +175,7 @@ directory_load(TextFile &file, Directory &directory, Error &error)
 			Directory *subdir =
 				directory_load_subdir(file, directory,
 						      line + sizeof(DIRECTORY_DIR) - 1,
-						      error);
+						      arena, error);
 			if (subdir == nullptr)
 				return false;
 		} else if (StringStartsWith(line, SONG_BEGIN)) {
@@ -183,12 +187,16 @@ directory_load(TextFile &file, Directory &directory, Error &error)
 				return false;
 			}
 
-			DetachedSong *song = song_load(file, name, error);
+			SongIdentity identity(0, 0, 0);
+			DetachedSong *song = song_load(file, name, error,
+						       &identity);
 			if (song == nullptr)
 				return false;
 
-			directory.AddSong(Song::NewFrom(std::move(*song),
-							directory));
+			Song *new_song = Song::NewFrom(std::move(*song),
+						       directory, arena);
+			new_song->identity = identity;
+			directory.AddSong(new_song);
 			delete song;
 		} else if (StringStartsWith(line, PLAYLIST_META_BEGIN)) {
 			const char *name = line + sizeof(PLAYLIST_META_BEGIN) - 1;
@@ -204,3 +212,26 @@ directory_load(TextFile &file, Directory &directory, Error &error)
 
 	return true;
 }
+
+bool
+directory_load_replace(TextFile &file, Directory &root, const char *uri,
+		       SongArena &arena, Error &error)
+{
+	assert(*uri != 0);
+
+	Directory *parent = &root;
+	const char *name = uri;
+	const char *slash;
+	while ((slash = strchr(name, '/')) != nullptr) {
+		const std::string child_name(name, slash);
+		parent = parent->MakeChild(child_name.c_str());
+		name = slash + 1;
+	}
+
+	Directory *old = parent->FindChild(name);
+	if (old != nullptr)
+		old->Delete();
+
+	return directory_load_subdir(file, *parent, name, arena,
+				     error) != nullptr;
+}
@@ -23,6 +23,7 @@
 #include <stdio.h>
 
 struct Directory;
+class SongArena;
 class TextFile;
 class Error;
 
@@ -30,6 +31,18 @@ void
 directory_save(FILE *fp, const Directory &directory);
 
 bool
-directory_load(TextFile &file, Directory &directory, Error &error);
+directory_load(TextFile &file, Directory &directory, SongArena &arena,
+	       Error &error);
+
+/**
+ * Load a directory written by directory_save() and replace the
+ * existing directory with the given URI (relative to the root).
+ * Missing parent directories are created.
+ *
+ * Caller must lock the #db_mutex.
+ */
+bool
+directory_load_replace(TextFile &file, Directory &root, const char *uri,
+		       SongArena &arena, Error &error);
 
 #endif
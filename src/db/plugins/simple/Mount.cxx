@@ -24,11 +24,18 @@
 #include "db/LightDirectory.hxx"
 #include "db/LightSong.hxx"
 #include "db/Interface.hxx"
+#include "db/PlaylistInfo.hxx"
+#include "tag/Tag.hxx"
 #include "fs/Traits.hxx"
+#include "system/Clock.hxx"
 #include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <string>
 
+static constexpr Domain mount_walk_domain("mount_walk");
+
 struct PrefixedLightDirectory : LightDirectory {
 	std::string buffer;
 
@@ -94,3 +101,256 @@ WalkMount(const char *base, const Database &db,
 	return db.Visit(DatabaseSelection("", recursive, filter),
 			vd, vs, vp, error);
 }
+
+/**
+ * A copy of a #LightDirectory, #LightSong or #PlaylistInfo collected
+ * by the #MountWalk thread.
+ */
+struct MountWalk::Entry {
+	enum class Type {
+		DIRECTORY, SONG, PLAYLIST,
+	} type;
+
+	/**
+	 * The URI of the directory or song (relative to the mount
+	 * point).
+	 */
+	std::string uri;
+
+	/**
+	 * The "real" URI of a song; empty if there is none.
+	 */
+	std::string real_uri;
+
+	time_t mtime;
+
+	Tag tag;
+
+	unsigned start_ms, end_ms;
+
+	PlaylistInfo playlist;
+
+	Entry(const LightDirectory &directory)
+		:type(Type::DIRECTORY), uri(directory.uri),
+		 mtime(directory.mtime) {}
+
+	Entry(const LightSong &song)
+		:type(Type::SONG), uri(song.GetURI()),
+		 real_uri(song.real_uri != nullptr ? song.real_uri : ""),
+		 mtime(song.mtime), tag(*song.tag),
+		 start_ms(song.start_ms), end_ms(song.end_ms) {}
+
+	Entry(const PlaylistInfo &_playlist, const LightDirectory &directory)
+		:type(Type::PLAYLIST), uri(directory.uri),
+		 mtime(directory.mtime),
+		 playlist(_playlist.name, _playlist.mtime) {}
+
+	LightDirectory ExportDirectory() const {
+		return LightDirectory(uri.c_str(), mtime);
+	}
+
+	LightSong ExportSong() const {
+		LightSong song;
+		song.directory = nullptr;
+		song.uri = uri.c_str();
+		song.real_uri = real_uri.empty() ? nullptr : real_uri.c_str();
+		song.tag = &tag;
+		song.mtime = mtime;
+		song.start_ms = start_ms;
+		song.end_ms = end_ms;
+		return song;
+	}
+};
+
+MountWalk::MountWalk(const char *_base, const Database &_db,
+		     bool _recursive, const SongFilter *_filter,
+		     bool _want_directories, bool _want_songs,
+		     bool _want_playlists)
+	:base(_base), db(_db), recursive(_recursive), filter(_filter),
+	 want_directories(_want_directories), want_songs(_want_songs),
+	 want_playlists(_want_playlists),
+	 done(false), cancel(false), result(false)
+{
+}
+
+MountWalk::~MountWalk()
+{
+	cancel = true;
+
+	if (thread.IsDefined())
+		thread.Join();
+}
+
+bool
+MountWalk::Start(Error &_error)
+{
+	return thread.Start(Run, this, _error);
+}
+
+bool
+MountWalk::Cancelled(Error &_error) const
+{
+	if (!cancel)
+		return false;
+
+	_error.Set(mount_walk_domain, "Cancelled");
+	return true;
+}
+
+bool
+MountWalk::CollectDirectory(const LightDirectory &directory, Error &_error)
+{
+	if (Cancelled(_error))
+		return false;
+
+	entries.emplace_back(directory);
+	return true;
+}
+
+bool
+MountWalk::CollectSong(const LightSong &song, Error &_error)
+{
+	if (Cancelled(_error))
+		return false;
+
+	entries.emplace_back(song);
+	return true;
+}
+
+bool
+MountWalk::CollectPlaylist(const PlaylistInfo &playlist,
+			   const LightDirectory &directory, Error &_error)
+{
+	if (Cancelled(_error))
+		return false;
+
+	entries.emplace_back(playlist, directory);
+	return true;
+}
+
+inline void
+MountWalk::Run()
+{
+	using namespace std::placeholders;
+
+	VisitDirectory vd;
+	if (want_directories)
+		vd = std::bind(&MountWalk::CollectDirectory, this, _1, _2);
+
+	VisitSong vs;
+	if (want_songs)
+		vs = std::bind(&MountWalk::CollectSong, this, _1, _2);
+
+	VisitPlaylist vp;
+	if (want_playlists)
+		vp = std::bind(&MountWalk::CollectPlaylist, this,
+			       _1, _2, _3);
+
+	Error _error;
+	const bool _result =
+		db.Visit(DatabaseSelection("", recursive, filter),
+			 vd, vs, vp, _error);
+
+	const ScopeLock protect(mutex);
+	result = _result;
+	error = std::move(_error);
+	done = true;
+	cond.signal();
+}
+
+void
+MountWalk::Run(void *ctx)
+{
+	MountWalk &walk = *(MountWalk *)ctx;
+	walk.Run();
+}
+
+bool
+MountWalk::Finish(unsigned timeout_ms,
+		  const VisitDirectory &visit_directory,
+		  const VisitSong &visit_song,
+		  const VisitPlaylist &visit_playlist,
+		  Error &_error)
+{
+	mutex.lock();
+
+	const unsigned start = MonotonicClockMS();
+	while (!done) {
+		if (timeout_ms == 0) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		const unsigned elapsed = MonotonicClockMS() - start;
+		if (elapsed >= timeout_ms)
+			break;
+
+		cond.timed_wait(mutex, timeout_ms - elapsed);
+	}
+
+	const bool _done = done;
+	mutex.unlock();
+
+	if (!_done) {
+		/* the destructor waits for the thread, but the
+		   collecting visitors stop it early */
+		cancel = true;
+		FormatWarning(mount_walk_domain,
+			      "Mount \"%s\" did not respond in time",
+			      base.c_str());
+		return true;
+	}
+
+	if (!result) {
+		_error = std::move(error);
+		return false;
+	}
+
+	const char *const b = base.c_str();
+
+	for (const auto &entry : entries) {
+		switch (entry.type) {
+		case Entry::Type::DIRECTORY:
+			if (!PrefixVisitDirectory(b, visit_directory,
+						  entry.ExportDirectory(),
+						  _error))
+				return false;
+			break;
+
+		case Entry::Type::SONG:
+			if (!PrefixVisitSong(b, visit_song,
+					     entry.ExportSong(), _error))
+				return false;
+			break;
+
+		case Entry::Type::PLAYLIST:
+			if (!PrefixVisitPlaylist(b, visit_playlist,
+						 entry.playlist,
+						 entry.ExportDirectory(),
+						 _error))
+				return false;
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool
+MountWalkList::Add(const char *base, const Database &db,
+		   bool recursive, const SongFilter *filter,
+		   bool want_directories, bool want_songs,
+		   bool want_playlists,
+		   Error &error)
+{
+	MountWalk *walk = new MountWalk(base, db, recursive, filter,
+					want_directories, want_songs,
+					want_playlists);
+	if (!walk->Start(error)) {
+		delete walk;
+		return false;
+	}
+
+	map.emplace(&db, std::unique_ptr<MountWalk>(walk));
+	return true;
+}
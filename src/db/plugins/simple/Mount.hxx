@@ -21,6 +21,16 @@
 #define MPD_DB_SIMPLE_MOUNT_HXX
 
 #include "db/Visitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+
+#include <atomic>
+#include <string>
+#include <list>
+#include <map>
+#include <memory>
 
 class Database;
 class SongFilter;
@@ -33,4 +43,126 @@ WalkMount(const char *base, const Database &db,
 	  const VisitPlaylist &visit_playlist,
 	  Error &error);
 
+/**
+ * Visits a mounted #Database in a separate thread and collects the
+ * results, so several mounts can be searched concurrently.  Finish()
+ * passes the results to the visitors in the calling thread, in the
+ * same order as WalkMount().
+ */
+class MountWalk {
+	struct Entry;
+
+	const std::string base;
+	const Database &db;
+	const bool recursive;
+	const SongFilter *const filter;
+	const bool want_directories, want_songs, want_playlists;
+
+	Thread thread;
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Has the thread finished?  Protected by #mutex.
+	 */
+	bool done;
+
+	/**
+	 * Ask the thread to stop collecting results.
+	 */
+	std::atomic_bool cancel;
+
+	/**
+	 * The return value of Database::Visit().  Only valid when
+	 * #done is set.
+	 */
+	bool result;
+	Error error;
+
+	std::list<Entry> entries;
+
+public:
+	MountWalk(const char *_base, const Database &_db,
+		  bool _recursive, const SongFilter *_filter,
+		  bool _want_directories, bool _want_songs,
+		  bool _want_playlists);
+
+	/**
+	 * Cancels the thread and waits for it to exit.  The caller
+	 * must not hold the #db_mutex, because the mounted database
+	 * may need to lock it.
+	 */
+	~MountWalk();
+
+	MountWalk(const MountWalk &) = delete;
+	MountWalk &operator=(const MountWalk &) = delete;
+
+	bool Start(Error &error);
+
+	/**
+	 * Wait for the thread and pass the results to the visitors.
+	 * If the mounted database does not respond in time, the
+	 * mount is skipped with a warning.
+	 *
+	 * @param timeout_ms the maximum time to wait; 0 means no limit
+	 */
+	bool Finish(unsigned timeout_ms,
+		    const VisitDirectory &visit_directory,
+		    const VisitSong &visit_song,
+		    const VisitPlaylist &visit_playlist,
+		    Error &error);
+
+private:
+	void Run();
+	static void Run(void *ctx);
+
+	bool Cancelled(Error &error) const;
+
+	bool CollectDirectory(const LightDirectory &directory, Error &error);
+	bool CollectSong(const LightSong &song, Error &error);
+	bool CollectPlaylist(const PlaylistInfo &playlist,
+			     const LightDirectory &directory, Error &error);
+};
+
+/**
+ * The #MountWalk objects started for one Database::Visit() call,
+ * keyed by the mounted #Database.
+ */
+class MountWalkList {
+	std::map<const Database *, std::unique_ptr<MountWalk>> map;
+
+public:
+	/**
+	 * The per-mount timeout in milliseconds; 0 means no limit.
+	 */
+	const unsigned timeout_ms;
+
+	explicit MountWalkList(unsigned _timeout_ms)
+		:timeout_ms(_timeout_ms) {}
+
+	bool IsEmpty() const {
+		return map.empty();
+	}
+
+	/**
+	 * Start a #MountWalk for the given mount.
+	 */
+	bool Add(const char *base, const Database &db,
+		 bool recursive, const SongFilter *filter,
+		 bool want_directories, bool want_songs,
+		 bool want_playlists,
+		 Error &error);
+
+	/**
+	 * @return the #MountWalk started for the given mount or
+	 * nullptr
+	 */
+	gcc_pure
+	MountWalk *Find(const Database &db) const {
+		auto i = map.find(&db);
+		return i != map.end() ? i->second.get() : nullptr;
+	}
+};
+
 #endif
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_NAME_INDEX_HXX
+#define MPD_NAME_INDEX_HXX
+
+#include "Compiler.h"
+
+#include <memory>
+#include <unordered_map>
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * A hash index which finds the items of a #Directory (songs or sub
+ * directories) by their name.  Small directories are searched
+ * linearly; the hash table is only built when the directory grows
+ * beyond #THRESHOLD items, and is then kept up to date.
+ *
+ * All modifications must be done with the #db_mutex locked
+ * exclusively; Find() needs only a shared lock.
+ *
+ * @param G a function object which returns the name of an item
+ */
+template<typename T, typename G>
+class NameIndex {
+	struct Hash {
+		gcc_pure
+		size_t operator()(const char *p) const {
+			/* FNV-1a */
+			size_t h = 2166136261u;
+			for (; *p != 0; ++p)
+				h = (h ^ (unsigned char)*p) * 16777619u;
+			return h;
+		}
+	};
+
+	struct Equal {
+		gcc_pure
+		bool operator()(const char *a, const char *b) const {
+			return strcmp(a, b) == 0;
+		}
+	};
+
+	/**
+	 * The keys point to the names of the items.  It is a
+	 * multimap because nothing prevents duplicate names.
+	 */
+	typedef std::unordered_multimap<const char *, T *,
+					Hash, Equal> Map;
+
+	/**
+	 * The number of items, counted even while there is no #map.
+	 */
+	size_t size;
+
+	std::unique_ptr<Map> map;
+
+public:
+	static constexpr size_t THRESHOLD = 32;
+
+	NameIndex():size(0) {}
+
+	bool IsDefined() const {
+		return map != nullptr;
+	}
+
+	/**
+	 * Call this after the item was added to the list.
+	 */
+	template<typename L>
+	void Add(T &item, L &list) {
+		++size;
+
+		if (map != nullptr)
+			map->emplace(G()(item), &item);
+		else if (size > THRESHOLD) {
+			map.reset(new Map());
+			map->reserve(size);
+			for (auto &i : list)
+				map->emplace(G()(i), &i);
+		}
+	}
+
+	/**
+	 * Call this before the item is removed from the list.
+	 */
+	void Remove(const T &item) {
+		assert(size > 0);
+		--size;
+
+		if (map == nullptr)
+			return;
+
+		auto range = map->equal_range(G()(item));
+		for (auto i = range.first; i != range.second; ++i) {
+			if (i->second == &item) {
+				map->erase(i);
+				break;
+			}
+		}
+	}
+
+	/**
+	 * Look up an item.  Must only be called if IsDefined()
+	 * returns true.
+	 */
+	gcc_pure
+	T *Find(const char *name) const {
+		assert(IsDefined());
+
+		auto i = map->find(name);
+		return i != map->end()
+			? i->second
+			: nullptr;
+	}
+};
+
+#endif
@@ -26,27 +26,59 @@
 #include "db/UniqueTags.hxx"
 #include "db/LightDirectory.hxx"
 #include "Directory.hxx"
+#include "Mount.hxx"
 #include "Song.hxx"
 #include "SongFilter.hxx"
 #include "DatabaseSave.hxx"
+#include "DatabaseBinary.hxx"
+#include "tag/TagPool.hxx"
+#include "tag/TagItemGroup.hxx"
+#ifdef HAVE_FOPENCOOKIE
+#include "lib/zlib/GzipFile.hxx"
+#endif
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
+#include "db/Uri.hxx"
 #include "fs/TextFile.hxx"
 #include "config/ConfigData.hxx"
 #include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
 #include "util/CharUtil.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <unordered_set>
+#include <vector>
+
 #include <errno.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
+/**
+ * The journal is merged into the database file when it is larger
+ * than this fraction of the database file.
+ */
+static constexpr unsigned JOURNAL_COMPACT_DIVISOR = 4;
+
+static constexpr unsigned DEFAULT_MOUNT_TIMEOUT_MS = 10000;
+
+gcc_pure
+static AllocatedPath
+GetJournalPath(Path path)
+{
+	return AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+				     ".journal");
+}
+
 inline SimpleDatabase::SimpleDatabase()
 	:Database(simple_db_plugin),
 	 path(AllocatedPath::Null()),
 	 cache_path(AllocatedPath::Null()),
+	 binary(false), compress(false), journal(false),
+	 journal_path(AllocatedPath::Null()),
+	 base_size(0),
+	 n_mounts(0), mount_timeout_ms(DEFAULT_MOUNT_TIMEOUT_MS),
 	 prefixed_light_song(nullptr) {}
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path)
@@ -54,6 +86,10 @@ inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path)
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 	 cache_path(AllocatedPath::Null()),
+	 binary(false), compress(false), journal(false),
+	 journal_path(GetJournalPath(path)),
+	 base_size(0),
+	 n_mounts(0), mount_timeout_ms(DEFAULT_MOUNT_TIMEOUT_MS),
 	 prefixed_light_song(nullptr) {
 }
 
@@ -83,11 +119,36 @@ SimpleDatabase::Configure(const config_param &param, Error &error)
 	}
 
 	path_utf8 = path.ToUTF8();
+	journal_path = GetJournalPath(path);
 
 	cache_path = param.GetBlockPath("cache_directory", error);
 	if (path.IsNull() && error.IsDefined())
 		return false;
 
+	const char *format = param.GetBlockValue("format", "text");
+	if (strcmp(format, "binary") == 0)
+		binary = true;
+	else if (strcmp(format, "text") != 0) {
+		error.Format(simple_db_domain,
+			     "Unknown database format: \"%s\"", format);
+		return false;
+	}
+
+	compress = param.GetBlockValue("compress", false);
+#ifndef HAVE_FOPENCOOKIE
+	if (compress) {
+		error.Set(simple_db_domain,
+			  "Database compression is not available");
+		return false;
+	}
+#endif
+
+	journal = param.GetBlockValue("journal", false);
+
+	mount_timeout_ms = param.GetBlockValue("mount_timeout",
+					       DEFAULT_MOUNT_TIMEOUT_MS / 1000)
+		* 1000;
+
 	return true;
 }
 
@@ -166,29 +227,93 @@ SimpleDatabase::Load(Error &error)
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path);
+	if (db_binary_check(path)) {
+		if (!db_load_binary(path, *root, arena, error))
+			return false;
+	} else {
+		TextFile file(path);
+		if (file.HasFailed()) {
+			error.FormatErrno("Failed to open database file \"%s\"",
+					  path_utf8.c_str());
+			return false;
+		}
+
+		if (!db_load_internal(file, *root, arena, error))
+			return false;
+	}
+
+	struct stat st;
+	if (StatFile(path, st)) {
+		mtime = st.st_mtime;
+		base_size = st.st_size;
+	}
+
+	if (!LoadJournal(error))
+		return false;
+
+	TagPoolStats stats;
+	tag_pool_get_stats(stats);
+	FormatDebug(simple_db_domain,
+		    "tag pool: %zu items in %zu/%zu buckets, "
+		    "longest chain %zu, %u resizes; %u item groups",
+		    stats.n_items, stats.n_used_buckets, stats.n_buckets,
+		    stats.max_chain, stats.n_resizes,
+		    tag_item_group_count());
+
+	return true;
+}
+
+bool
+SimpleDatabase::LoadJournal(Error &error)
+{
+	struct stat st;
+	if (!StatFile(journal_path, st))
+		return true;
+
+	TextFile file(journal_path);
 	if (file.HasFailed()) {
-		error.FormatErrno("Failed to open database file \"%s\"",
-				  path_utf8.c_str());
+		error.FormatErrno("Failed to open database journal \"%s\"",
+				  journal_path.ToUTF8().c_str());
 		return false;
 	}
 
-	if (!db_load_internal(file, *root, error))
+	if (!db_load_journal(file, *root, arena, error))
 		return false;
 
-	struct stat st;
-	if (StatFile(path, st))
+	if (st.st_mtime > mtime)
 		mtime = st.st_mtime;
 
 	return true;
 }
 
+void
+SimpleDatabase::NewRoot()
+{
+	root = Directory::NewRoot();
+	root->song_index = &song_index;
+}
+
+void
+SimpleDatabase::DeleteRoot()
+{
+	/* detach the index first, so the Directory destructors
+	   don't need to remove each song from it */
+	root->song_index = nullptr;
+	delete root;
+
+	song_index.Clear();
+
+	/* all songs have been destructed, and now their memory is
+	   released at once */
+	arena.Clear();
+}
+
 bool
 SimpleDatabase::Open(Error &error)
 {
 	assert(prefixed_light_song == nullptr);
 
-	root = Directory::NewRoot();
+	NewRoot();
 	mtime = 0;
 
 #ifndef NDEBUG
@@ -196,7 +321,7 @@ SimpleDatabase::Open(Error &error)
 #endif
 
 	if (!Load(error)) {
-		delete root;
+		DeleteRoot();
 
 		LogError(error);
 		error.Clear();
@@ -204,7 +329,7 @@ SimpleDatabase::Open(Error &error)
 		if (!Check(error))
 			return false;
 
-		root = Directory::NewRoot();
+		NewRoot();
 	}
 
 	return true;
@@ -217,7 +342,7 @@ SimpleDatabase::Close()
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
-	delete root;
+	DeleteRoot();
 }
 
 const LightSong *
@@ -227,13 +352,13 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
-	db_lock();
+	db_lock_shared();
 
 	auto r = root->LookupDirectory(uri);
 
 	if (r.directory->IsMount()) {
 		/* pass the request to the mounted database */
-		db_unlock();
+		db_unlock_shared();
 
 		const LightSong *song =
 			r.directory->mounted_database->GetSong(r.uri, error);
@@ -247,7 +372,7 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 
 	if (r.uri == nullptr) {
 		/* it's a directory */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
@@ -255,14 +380,14 @@ SimpleDatabase::GetSong(const char *uri, Error &error) const
 
 	if (strchr(r.uri, '/') != nullptr) {
 		/* refers to a URI "below" the actual song */
-		db_unlock();
+		db_unlock_shared();
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
 		return nullptr;
 	}
 
 	const Song *song = r.directory->FindSong(r.uri);
-	db_unlock();
+	db_unlock_shared();
 	if (song == nullptr) {
 		error.Format(db_domain, DB_NOT_FOUND,
 			     "No such song: %s", uri);
@@ -295,6 +420,35 @@ SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const
 #endif
 }
 
+/**
+ * Start a #MountWalk for each mounted database below the given
+ * directory.
+ */
+static bool
+StartMountWalks(const Directory &directory, const SongFilter *filter,
+		bool want_directories, bool want_songs,
+		bool want_playlists,
+		MountWalkList &mount_walks, Error &error)
+{
+	for (const auto &child : directory.children) {
+		if (child.IsMount()) {
+			if (!mount_walks.Add(child.GetPath(),
+					     *child.mounted_database,
+					     true, filter,
+					     want_directories, want_songs,
+					     want_playlists,
+					     error))
+				return false;
+		} else if (!StartMountWalks(child, filter,
+					    want_directories, want_songs,
+					    want_playlists,
+					    mount_walks, error))
+			return false;
+	}
+
+	return true;
+}
+
 bool
 SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitDirectory visit_directory,
@@ -302,7 +456,11 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitPlaylist visit_playlist,
 		      Error &error) const
 {
-	ScopeDatabaseLock protect;
+	/* declared before the lock, because its destructor waits for
+	   the threads, which may need the lock */
+	MountWalkList mount_walks(mount_timeout_ms);
+
+	ScopeDatabaseSharedLock protect;
 
 	auto r = root->LookupDirectory(selection.uri.c_str());
 	if (r.uri == nullptr) {
@@ -312,10 +470,28 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		    !visit_directory(r.directory->Export(), error))
 			return false;
 
+		bool result;
+		if (selection.recursive && selection.filter != nullptr &&
+		    !visit_directory && visit_song && !visit_playlist &&
+		    VisitIndexed(*r.directory, *selection.filter, visit_song,
+				 result, error))
+			return result;
+
+		/* query all mounted databases concurrently, so a
+		   slow one does not delay the others */
+		if (selection.recursive && n_mounts > 0 &&
+		    !StartMountWalks(*r.directory, selection.filter,
+				     !!visit_directory, !!visit_song,
+				     !!visit_playlist,
+				     mount_walks, error))
+			return false;
+
 		return r.directory->Walk(selection.recursive, selection.filter,
 					 visit_directory, visit_song,
 					 visit_playlist,
-					 error);
+					 error,
+					 mount_walks.IsEmpty()
+					 ? nullptr : &mount_walks);
 	}
 
 	if (strchr(r.uri, '/') == nullptr) {
@@ -333,12 +509,95 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	return false;
 }
 
+typedef std::unordered_set<const Song *> SongSet;
+typedef std::unordered_set<const Directory *> DirectorySet;
+
+/**
+ * Like Directory::Walk(), but only visit the given songs and
+ * directories.  This keeps the order of a full walk.
+ */
+static bool
+WalkIndexed(const Directory &directory, const SongFilter &filter,
+	    const SongSet &songs, const DirectorySet &directories,
+	    VisitSong visit_song, Error &error)
+{
+	for (const auto &song : directory.songs) {
+		if (songs.find(&song) == songs.end())
+			continue;
+
+		const LightSong song2 = song.Export();
+		if (filter.Match(song2) && !visit_song(song2, error))
+			return false;
+	}
+
+	for (const auto &child : directory.children)
+		if (directories.find(&child) != directories.end() &&
+		    !WalkIndexed(child, filter, songs, directories,
+				 visit_song, error))
+			return false;
+
+	return true;
+}
+
+bool
+SimpleDatabase::VisitIndexed(const Directory &directory,
+			     const SongFilter &filter, VisitSong visit_song,
+			     bool &result, Error &error) const
+{
+	assert(holding_db_lock());
+
+	if (n_mounts > 0)
+		return false;
+
+	std::vector<const Song *> candidates;
+	if (!song_index.Collect(filter, candidates))
+		return false;
+
+	/* select the candidates below the given directory, and
+	   collect the directories leading to them */
+
+	SongSet songs;
+	DirectorySet directories;
+	std::vector<const Directory *> parents;
+
+	for (const Song *song : candidates) {
+		parents.clear();
+
+		const Directory *d = song->parent;
+		while (d != &directory && d != nullptr &&
+		       directories.find(d) == directories.end()) {
+			parents.push_back(d);
+			d = d->parent;
+		}
+
+		if (d == nullptr)
+			/* not below the given directory */
+			continue;
+
+		songs.insert(song);
+		directories.insert(parents.begin(), parents.end());
+	}
+
+	result = WalkIndexed(directory, filter, songs, directories,
+			     visit_song, error);
+	return true;
+}
+
 bool
 SimpleDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 				TagType tag_type, uint32_t group_mask,
 				VisitTag visit_tag,
 				Error &error) const
 {
+	if (selection.uri.empty() && selection.recursive &&
+	    selection.filter == nullptr && group_mask == 0) {
+		/* an unfiltered "list": use the precomputed values */
+		ScopeDatabaseSharedLock protect;
+		if (n_mounts == 0)
+			return song_index.VisitUniqueTags(tag_type, visit_tag,
+							  error);
+	}
+
 	return ::VisitUniqueTags(*this, selection, tag_type, group_mask,
 				 visit_tag,
 				 error);
@@ -348,6 +607,17 @@ bool
 SimpleDatabase::GetStats(const DatabaseSelection &selection,
 			 DatabaseStats &stats, Error &error) const
 {
+	if (selection.uri.empty() && selection.recursive &&
+	    selection.filter == nullptr) {
+		/* statistics of the whole database are maintained by
+		   the #song_index */
+		ScopeDatabaseSharedLock protect;
+		if (n_mounts == 0) {
+			song_index.GetStats(stats);
+			return true;
+		}
+	}
+
 	return ::GetStats(*this, selection, stats, error);
 }
 
@@ -364,16 +634,39 @@ SimpleDatabase::Save(Error &error)
 
 	db_unlock();
 
+	/* the journal refers to the old database file; delete it
+	   before overwriting that */
+	if (!RemoveFile(journal_path) && errno != ENOENT) {
+		error.FormatErrno("Failed to delete database journal \"%s\"",
+				  journal_path.ToUTF8().c_str());
+		return false;
+	}
+
 	LogDebug(simple_db_domain, "writing DB");
 
-	FILE *fp = FOpen(path, FOpenMode::WriteText);
-	if (!fp) {
-		error.FormatErrno("unable to write to db file \"%s\"",
-				  path_utf8.c_str());
-		return false;
+	FILE *fp;
+#ifdef HAVE_FOPENCOOKIE
+	if (compress) {
+		fp = GzipOpenWrite(path, error);
+		if (fp == nullptr)
+			return false;
+	} else
+#endif
+	{
+		fp = FOpen(path, binary
+			   ? FOpenMode::WriteBinary
+			   : FOpenMode::WriteText);
+		if (!fp) {
+			error.FormatErrno("unable to write to db file \"%s\"",
+					  path_utf8.c_str());
+			return false;
+		}
 	}
 
-	db_save_internal(fp, *root);
+	if (binary)
+		db_save_binary(fp, *root);
+	else
+		db_save_internal(fp, *root);
 
 	if (ferror(fp)) {
 		error.SetErrno("Failed to write to database file");
@@ -381,15 +674,94 @@ SimpleDatabase::Save(Error &error)
 		return false;
 	}
 
-	fclose(fp);
+	if (fclose(fp) != 0) {
+		error.SetErrno("Failed to write to database file");
+		return false;
+	}
+
+	struct stat st;
+	if (StatFile(path, st)) {
+		mtime = st.st_mtime;
+		base_size = st.st_size;
+	}
+
+	return true;
+}
+
+bool
+SimpleDatabase::SaveJournal(const char *uri, Error &error)
+{
+	db_lock();
+
+	root->PruneEmpty();
+	root->Sort();
+
+	/* the directory may have been deleted (or pruned) by the
+	   update */
+	auto r = root->LookupDirectory(uri);
+	const Directory *directory = r.uri == nullptr ? r.directory : nullptr;
+
+	db_unlock();
+
+	FormatDebug(simple_db_domain, "writing DB journal: %s", uri);
 
 	struct stat st;
-	if (StatFile(path, st))
+	const bool exists = StatFile(journal_path, st);
+
+	FILE *fp = FOpen(journal_path, FOpenMode::AppendText);
+	if (fp == nullptr) {
+		error.FormatErrno("unable to write to db journal \"%s\"",
+				  journal_path.ToUTF8().c_str());
+		return false;
+	}
+
+	if (!exists)
+		db_save_header(fp);
+
+	db_save_journal(fp, uri, directory);
+
+	if (ferror(fp)) {
+		error.SetErrno("Failed to write to database journal");
+		fclose(fp);
+		return false;
+	}
+
+	if (fclose(fp) != 0) {
+		error.SetErrno("Failed to write to database journal");
+		return false;
+	}
+
+	if (StatFile(journal_path, st))
 		mtime = st.st_mtime;
 
 	return true;
 }
 
+bool
+SimpleDatabase::Save(const char *uri, Error &error)
+{
+	if (!journal || !FileExists())
+		return Save(error);
+
+	/* the update may have added or removed the given path in its
+	   parent directory, so that one is saved */
+	const std::string parent = PathTraitsUTF8::GetParent(uri);
+	if (isRootDirectory(uri) || parent == "." ||
+	    isRootDirectory(parent.c_str()))
+		/* a journal record for the root directory would be as
+		   large as the database file */
+		return Save(error);
+
+	struct stat st;
+	if (StatFile(journal_path, st) &&
+	    st.st_size > base_size / JOURNAL_COMPACT_DIVISOR) {
+		LogDebug(simple_db_domain, "merging DB journal");
+		return Save(error);
+	}
+
+	return SaveJournal(parent.c_str(), error);
+}
+
 bool
 SimpleDatabase::Mount(const char *uri, Database *db, Error &error)
 {
@@ -414,6 +786,7 @@ SimpleDatabase::Mount(const char *uri, Database *db, Error &error)
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
 	mnt->mounted_database = db;
+	++n_mounts;
 	return true;
 }
 
@@ -473,6 +846,9 @@ SimpleDatabase::LockUmountSteal(const char *uri)
 	r.directory->mounted_database = nullptr;
 	r.directory->Delete();
 
+	assert(n_mounts > 0);
+	--n_mounts;
+
 	return db;
 }
 
@@ -490,6 +866,6 @@ SimpleDatabase::Unmount(const char *uri)
 
 const DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE|DatabasePlugin::FLAG_THREAD_SAFE,
 	SimpleDatabase::Create,
 };
@@ -23,10 +23,14 @@
 #include "db/Interface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "db/LightSong.hxx"
+#include "SongIndex.hxx"
+#include "SongArena.hxx"
 #include "Compiler.h"
 
 #include <cassert>
 
+#include <sys/types.h>
+
 struct config_param;
 struct Directory;
 struct DatabasePlugin;
@@ -43,8 +47,64 @@ class SimpleDatabase : public Database {
 	 */
 	AllocatedPath cache_path;
 
+	/**
+	 * Save the database in the binary format (see
+	 * DatabaseBinary.hxx) instead of the text format?
+	 */
+	bool binary;
+
+	/**
+	 * Compress the database file with gzip?
+	 */
+	bool compress;
+
+	/**
+	 * Append the directories modified by an update to the
+	 * journal file instead of rewriting the whole database file?
+	 */
+	bool journal;
+
+	/**
+	 * The journal file next to the database file (with the suffix
+	 * ".journal").  It is applied by Load() even if #journal is
+	 * disabled, and it is deleted by each full Save().
+	 */
+	AllocatedPath journal_path;
+
+	/**
+	 * The size of the database file after the last full Save() or
+	 * Load().  The journal is merged into a new database file
+	 * when it grows beyond a fraction of this.
+	 */
+	off_t base_size;
+
 	Directory *root;
 
+	/**
+	 * The tag index of all songs below #root.
+	 */
+	SongIndex song_index;
+
+	/**
+	 * The memory of all songs which were loaded from the
+	 * database file.  It is freed in DeleteRoot().
+	 */
+	SongArena arena;
+
+	/**
+	 * The number of databases mounted into this one.  The
+	 * #song_index does not know their songs, so it is only used
+	 * if this is zero.
+	 */
+	unsigned n_mounts;
+
+	/**
+	 * How long a recursive Visit() waits for each mounted
+	 * database, which is visited in a separate thread.  0 means
+	 * no limit.
+	 */
+	unsigned mount_timeout_ms;
+
 	time_t mtime;
 
 	/**
@@ -78,8 +138,22 @@ public:
 		return *root;
 	}
 
+	/**
+	 * Write the whole database to the database file.
+	 */
 	bool Save(Error &error);
 
+	/**
+	 * Save the database after an update of the given URI.  With
+	 * the "journal" setting, only the directory containing it is
+	 * appended to the journal file; the whole database is saved if
+	 * the journal has grown too large.
+	 *
+	 * @param uri the path which was passed to the update; an
+	 * empty string means the whole database was updated
+	 */
+	bool Save(const char *uri, Error &error);
+
 	/**
 	 * Returns true if there is a valid database file on the disk.
 	 */
@@ -136,6 +210,30 @@ private:
 
 	bool Load(Error &error);
 
+	/**
+	 * Apply the journal file (if one exists) after the database
+	 * file has been loaded.
+	 */
+	bool LoadJournal(Error &error);
+
+	bool SaveJournal(const char *uri, Error &error);
+
+	void NewRoot();
+	void DeleteRoot();
+
+	/**
+	 * Visit the songs below the given directory which match the
+	 * filter, looking up candidates in the #song_index instead of
+	 * testing every song.
+	 *
+	 * Caller must lock the #db_mutex.
+	 *
+	 * @return false if the filter cannot use the index
+	 */
+	bool VisitIndexed(const Directory &directory,
+			  const SongFilter &filter, VisitSong visit_song,
+			  bool &result, Error &error) const;
+
 	Database *LockUmountSteal(const char *uri);
 };
 
@@ -20,7 +20,9 @@
 #include "config.h"
 #include "Song.hxx"
 #include "Directory.hxx"
+#include "SongArena.hxx"
 #include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
 #include "util/VarSize.hxx"
 #include "DetachedSong.hxx"
 #include "db/LightSong.hxx"
@@ -29,8 +31,12 @@
 #include <string.h>
 #include <stdlib.h>
 
+MemoryAccount memory_database;
+
 inline Song::Song(const char *_uri, size_t uri_length, Directory &_parent)
-	:parent(&_parent), mtime(0), start_ms(0), end_ms(0)
+	:parent(&_parent), mtime(0), identity(0, 0, 0),
+	 start_ms(0), end_ms(0),
+	 in_arena(false)
 {
 	memcpy(uri, _uri, uri_length + 1);
 }
@@ -48,11 +54,29 @@ song_alloc(const char *uri, Directory &parent)
 	uri_length = strlen(uri);
 	assert(uri_length);
 
+	memory_database.Add(sizeof(Song) + uri_length);
+
 	return NewVarSize<Song>(sizeof(Song::uri),
 				uri_length + 1,
 				uri, uri_length, parent);
 }
 
+static Song *
+song_alloc(const char *uri, Directory &parent, SongArena &arena)
+{
+	size_t uri_length;
+
+	assert(uri);
+	uri_length = strlen(uri);
+	assert(uri_length);
+
+	void *p = arena.Allocate(sizeof(Song) - sizeof(Song::uri) +
+				 uri_length + 1);
+	Song *song = new(p) Song(uri, uri_length, parent);
+	song->in_arena = true;
+	return song;
+}
+
 Song *
 Song::NewFrom(DetachedSong &&other, Directory &parent)
 {
@@ -64,16 +88,44 @@ Song::NewFrom(DetachedSong &&other, Directory &parent)
 	return song;
 }
 
+Song *
+Song::NewFrom(DetachedSong &&other, Directory &parent, SongArena &arena)
+{
+	Song *song = song_alloc(other.GetURI(), parent, arena);
+	song->tag = std::move(other.WritableTag());
+	song->mtime = other.GetLastModified();
+	song->start_ms = other.GetStartMS();
+	song->end_ms = other.GetEndMS();
+	return song;
+}
+
 Song *
 Song::NewFile(const char *path, Directory &parent)
 {
 	return song_alloc(path, parent);
 }
 
+Song *
+Song::NewFile(const char *path, Directory &parent, SongArena &arena)
+{
+	return song_alloc(path, parent, arena);
+}
+
 void
 Song::Free()
 {
-	DeleteVarSize(this);
+	if (in_arena)
+		this->Song::~Song();
+	else {
+		memory_database.Sub(sizeof(Song) + strlen(uri));
+		DeleteVarSize(this);
+	}
+}
+
+void
+Song::CommitTag(TagBuilder &tag_builder)
+{
+	tag_builder.Commit(tag);
 }
 
 std::string
@@ -21,6 +21,7 @@
 #define MPD_SONG_HXX
 
 #include "tag/Tag.hxx"
+#include "util/MemoryAccount.hxx"
 #include "Compiler.h"
 
 #include <boost/intrusive/list.hpp>
@@ -28,12 +29,45 @@
 #include <string>
 
 #include <assert.h>
+#include <stdint.h>
 #include <time.h>
 
 struct LightSong;
 struct Directory;
 class DetachedSong;
 class Storage;
+class TagBuilder;
+class SongArena;
+
+/**
+ * The memory occupied by the songs and directories of the
+ * #SimpleDatabase, including the #SongArena.
+ */
+extern MemoryAccount memory_database;
+
+/**
+ * Identifies the file a #Song was read from, independent of its
+ * name.  Together with the modification time, it allows the update
+ * thread to recognize a file which was moved or renamed.
+ */
+struct SongIdentity {
+	uint64_t size;
+
+	/**
+	 * Device id and inode number.  0 means unknown.
+	 */
+	unsigned device, inode;
+
+	SongIdentity() = default;
+
+	constexpr SongIdentity(uint64_t _size,
+			       unsigned _device, unsigned _inode)
+		:size(_size), device(_device), inode(_inode) {}
+
+	constexpr bool IsDefined() const {
+		return inode != 0;
+	}
+};
 
 /**
  * A song file inside the configured music directory.  Internal
@@ -70,6 +104,12 @@ struct Song {
 
 	time_t mtime;
 
+	/**
+	 * The identity of the file.  Undefined for songs in archives
+	 * and containers, and for songs loaded from an old database.
+	 */
+	SongIdentity identity;
+
 	/**
 	 * Start of this sub-song within the file in milliseconds.
 	 */
@@ -81,6 +121,13 @@ struct Song {
 	 */
 	unsigned end_ms;
 
+	/**
+	 * Was this object allocated from a #SongArena?  Then Free()
+	 * only calls the destructor, and the memory is released with
+	 * the arena.
+	 */
+	bool in_arena;
+
 	/**
 	 * The file name.
 	 */
@@ -92,10 +139,22 @@ struct Song {
 	gcc_malloc
 	static Song *NewFrom(DetachedSong &&other, Directory &parent);
 
+	/**
+	 * Like NewFrom(DetachedSong &&, Directory &), but allocate the
+	 * object from the #SongArena.
+	 */
+	gcc_malloc
+	static Song *NewFrom(DetachedSong &&other, Directory &parent,
+			     SongArena &arena);
+
 	/** allocate a new song with a local file name */
 	gcc_malloc
 	static Song *NewFile(const char *path_utf8, Directory &parent);
 
+	gcc_malloc
+	static Song *NewFile(const char *path_utf8, Directory &parent,
+			     SongArena &arena);
+
 	/**
 	 * allocate a new song structure with a local file name and attempt to
 	 * load its metadata.  If all decoder plugin fail to read its meta
@@ -107,6 +166,18 @@ struct Song {
 
 	void Free();
 
+	/**
+	 * Replace the tag with the contents of the #TagBuilder.
+	 */
+	void CommitTag(TagBuilder &tag_builder);
+
+	/**
+	 * Read the tags of the file into the #TagBuilder, without
+	 * modifying this object.  This does not need the #db_mutex.
+	 */
+	bool ScanFile(Storage &storage, TagBuilder &tag_builder,
+		      time_t &mtime_r, SongIdentity &identity_r) const;
+
 	bool UpdateFile(Storage &storage);
 	bool UpdateFileInArchive(const Storage &storage);
 
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SongArena.hxx"
+#include "Song.hxx"
+#include "util/Alloc.hxx"
+
+#include <stdlib.h>
+
+void
+SongArena::Clear()
+{
+	while (head != nullptr) {
+		Chunk *chunk = head;
+		head = chunk->next;
+		free(chunk);
+	}
+
+	position = nullptr;
+	available = 0;
+
+	memory_database.Sub(allocated);
+	allocated = 0;
+}
+
+inline void *
+SongArena::AllocateChunk(size_t size)
+{
+	Chunk *chunk = (Chunk *)xalloc(sizeof(Chunk) + size);
+	chunk->next = head;
+	head = chunk;
+	allocated += sizeof(Chunk) + size;
+	memory_database.Add(sizeof(Chunk) + size);
+	return chunk + 1;
+}
+
+void *
+SongArena::Allocate(size_t size)
+{
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	if (size > available) {
+		if (size > CHUNK_SIZE / 4) {
+			/* large allocation: give it a chunk of its
+			   own, and keep filling the current one */
+			Chunk *current = head;
+			void *p = AllocateChunk(size);
+			if (current != nullptr) {
+				/* move the new chunk behind the one
+				   being filled */
+				head = head->next;
+				Chunk *chunk = (Chunk *)p - 1;
+				chunk->next = current->next;
+				current->next = chunk;
+			}
+
+			return p;
+		}
+
+		position = (char *)AllocateChunk(CHUNK_SIZE);
+		available = CHUNK_SIZE;
+	}
+
+	void *p = position;
+	position += size;
+	available -= size;
+	return p;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SONG_ARENA_HXX
+#define MPD_SONG_ARENA_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * A simple region allocator for #Song objects and their tag item
+ * arrays.  Memory is handed out from large chunks, one object after
+ * the other, without any per-allocation overhead; it cannot be freed
+ * individually, only all at once when the #SongArena is destructed.
+ *
+ * It is used for loading the database file, which creates all
+ * songs at once and releases them at once.  Songs which are removed
+ * later (by the update thread) leave a hole until the database is
+ * closed.
+ *
+ * This class is not thread-safe.  The caller must hold the #db_mutex
+ * exclusively.
+ */
+class SongArena {
+	struct Chunk {
+		Chunk *next;
+	};
+
+	static constexpr size_t CHUNK_SIZE = 256 * 1024;
+
+	static constexpr size_t ALIGNMENT = sizeof(void *);
+
+	/**
+	 * A linked list of all allocated chunks.  The most recent one
+	 * is at the front, and that one is being filled.
+	 */
+	Chunk *head;
+
+	char *position;
+	size_t available;
+
+	/**
+	 * The total size of all chunks, for #memory_database.
+	 */
+	size_t allocated;
+
+public:
+	SongArena()
+		:head(nullptr), position(nullptr), available(0),
+		 allocated(0) {}
+
+	~SongArena() {
+		Clear();
+	}
+
+	SongArena(const SongArena &) = delete;
+	SongArena &operator=(const SongArena &) = delete;
+
+	bool IsEmpty() const {
+		return head == nullptr;
+	}
+
+	/**
+	 * Free all memory which was allocated from this object.
+	 * Objects living in it must have been destructed already.
+	 */
+	void Clear();
+
+	/**
+	 * Allocate memory.  It is aligned for pointers and integers.
+	 * This function never fails (it aborts the process when out
+	 * of memory).
+	 */
+	gcc_malloc
+	void *Allocate(size_t size);
+
+	template<typename T>
+	gcc_malloc
+	T *AllocateArray(size_t n) {
+		return (T *)Allocate(sizeof(T) * n);
+	}
+
+private:
+	void *AllocateChunk(size_t size);
+};
+
+#endif
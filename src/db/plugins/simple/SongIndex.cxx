@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SongIndex.hxx"
+#include "Song.hxx"
+#include "SongFilter.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/Stats.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "lib/icu/Collate.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+
+static constexpr size_t TRIGRAM_LENGTH = 3;
+
+static constexpr uint32_t
+MakeTrigram(const char *p)
+{
+	return (uint32_t(uint8_t(p[0])) << 16) |
+		(uint32_t(uint8_t(p[1])) << 8) |
+		uint32_t(uint8_t(p[2]));
+}
+
+/**
+ * Does a #SongFilter::Item with the given tag look at tags of the
+ * specified type?
+ */
+static constexpr bool
+ItemUsesType(unsigned tag, TagType type)
+{
+	return tag == LOCATE_TAG_ANY_TYPE || tag == unsigned(type) ||
+		/* "album artist" falls back to "artist"; see
+		   SongFilter::Item::Match() */
+		(tag == TAG_ALBUM_ARTIST && type == TAG_ARTIST);
+}
+
+void
+SongIndex::AddTrigrams(TrigramMap &trigrams, const FoldedValue &value)
+{
+	const std::string &s = value.first;
+	if (s.length() < TRIGRAM_LENGTH)
+		return;
+
+	std::vector<uint32_t> keys;
+	keys.reserve(s.length() - TRIGRAM_LENGTH + 1);
+	for (size_t i = 0; i + TRIGRAM_LENGTH <= s.length(); ++i)
+		keys.push_back(MakeTrigram(s.data() + i));
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	for (const auto key : keys)
+		trigrams[key].push_back(&value);
+}
+
+static void
+UpdateUniqueValue(std::map<std::string, unsigned> &map,
+		  const char *value, bool add)
+{
+	if (add) {
+		++map[value];
+	} else {
+		auto i = map.find(value);
+		assert(i != map.end());
+		assert(i->second > 0);
+
+		if (--i->second == 0)
+			map.erase(i);
+	}
+}
+
+void
+SongIndex::UpdateUnique(const Tag &tag, bool add)
+{
+	bool present[TAG_NUM_OF_ITEM_TYPES];
+	std::fill_n(present, size_t(TAG_NUM_OF_ITEM_TYPES), false);
+
+	for (unsigned i = 0; i < tag.num_items; ++i) {
+		const TagItem &item = *tag.items[i];
+		present[item.type] = true;
+		UpdateUniqueValue(types[item.type].unique, item.value, add);
+	}
+
+	if (!present[TAG_ALBUM_ARTIST]) {
+		/* fall back to "artist" */
+		for (unsigned i = 0; i < tag.num_items; ++i) {
+			const TagItem &item = *tag.items[i];
+			if (item.type == TAG_ARTIST) {
+				present[TAG_ALBUM_ARTIST] = true;
+				UpdateUniqueValue(types[TAG_ALBUM_ARTIST].unique,
+						  item.value, add);
+			}
+		}
+	}
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		if (present[i])
+			continue;
+
+		TypeIndex &index = types[i];
+		if (add) {
+			++index.n_missing;
+		} else {
+			assert(index.n_missing > 0);
+			--index.n_missing;
+		}
+	}
+}
+
+void
+SongIndex::Add(const Song &song)
+{
+	assert(holding_db_write_lock());
+
+	const Tag &tag = song.tag;
+	for (unsigned i = 0; i < tag.num_items; ++i) {
+		const TagItem &item = *tag.items[i];
+		TypeIndex &index = types[item.type];
+
+		auto v = index.values.emplace(item.value, ValueEntry());
+		ValueEntry &entry = v.first->second;
+		if (v.second) {
+			/* a new value: fold it only once for all
+			   songs */
+			auto f = index.folded.emplace(IcuCaseFold(item.value),
+						      SongSet());
+			entry.folded = &*f.first;
+			if (f.second)
+				AddTrigrams(index.trigrams, *f.first);
+		}
+
+		entry.songs.insert(&song);
+		entry.folded->second.insert(&song);
+	}
+
+	UpdateUnique(tag, true);
+
+	++n_songs;
+	if (tag.time > 0)
+		total_duration += tag.time;
+}
+
+void
+SongIndex::Remove(const Song &song)
+{
+	assert(holding_db_write_lock());
+
+	const Tag &tag = song.tag;
+	for (unsigned i = 0; i < tag.num_items; ++i) {
+		const TagItem &item = *tag.items[i];
+		ValueMap &map = types[item.type].values;
+
+		auto j = map.find(item.value);
+		if (j == map.end())
+			continue;
+
+		ValueEntry &entry = j->second;
+		entry.folded->second.erase(&song);
+		entry.songs.erase(&song);
+		if (entry.songs.empty())
+			map.erase(j);
+	}
+
+	UpdateUnique(tag, false);
+
+	assert(n_songs > 0);
+	--n_songs;
+	if (tag.time > 0) {
+		assert(total_duration >= unsigned(tag.time));
+		total_duration -= tag.time;
+	}
+}
+
+void
+SongIndex::Clear()
+{
+	for (auto &index : types) {
+		index.values.clear();
+		index.trigrams.clear();
+		index.folded.clear();
+		index.unique.clear();
+		index.n_missing = 0;
+	}
+
+	n_songs = 0;
+	total_duration = 0;
+}
+
+void
+SongIndex::GetStats(DatabaseStats &stats) const
+{
+	assert(holding_db_lock());
+
+	stats.song_count = n_songs;
+	stats.total_duration = total_duration;
+	stats.artist_count = types[TAG_ARTIST].values.size();
+	stats.album_count = types[TAG_ALBUM].values.size();
+}
+
+bool
+SongIndex::VisitUniqueTags(TagType type, VisitTag visit_tag,
+			   Error &error) const
+{
+	assert(holding_db_lock());
+
+	const TypeIndex &index = types[type];
+
+	/* the empty value sorts first, like in #TagSet */
+	if (index.n_missing > 0) {
+		TagBuilder builder;
+		builder.AddEmptyItem(type);
+		if (!visit_tag(builder.Commit(), error))
+			return false;
+	}
+
+	for (const auto &i : index.unique) {
+		TagBuilder builder;
+		builder.AddItem(type, i.first.c_str());
+		if (!visit_tag(builder.Commit(), error))
+			return false;
+	}
+
+	return true;
+}
+
+const SongIndex::SongSet *
+SongIndex::Find(TagType type, const std::string &value) const
+{
+	const ValueMap &map = types[type].values;
+	auto i = map.find(value);
+	return i != map.end()
+		? &i->second.songs
+		: nullptr;
+}
+
+size_t
+SongIndex::EstimateFolded(TagType type, const std::string &value) const
+{
+	assert(value.length() >= TRIGRAM_LENGTH);
+
+	/* the rarest trigram of the value determines the cost; see
+	   FindFolded() */
+
+	const TrigramMap &trigrams = types[type].trigrams;
+	size_t result = SIZE_MAX;
+	for (size_t i = 0; i + TRIGRAM_LENGTH <= value.length(); ++i) {
+		auto j = trigrams.find(MakeTrigram(value.data() + i));
+		if (j == trigrams.end())
+			return 0;
+
+		result = std::min(result, j->second.size());
+	}
+
+	return result;
+}
+
+void
+SongIndex::FindFolded(TagType type, const std::string &value,
+		      std::vector<const Song *> &songs) const
+{
+	assert(value.length() >= TRIGRAM_LENGTH);
+
+	/* all values containing the given one also contain its
+	   rarest trigram; check each of them */
+
+	const TrigramMap &trigrams = types[type].trigrams;
+	const std::vector<const FoldedValue *> *best = nullptr;
+	for (size_t i = 0; i + TRIGRAM_LENGTH <= value.length(); ++i) {
+		auto j = trigrams.find(MakeTrigram(value.data() + i));
+		if (j == trigrams.end())
+			return;
+
+		if (best == nullptr || j->second.size() < best->size())
+			best = &j->second;
+	}
+
+	for (const FoldedValue *f : *best)
+		if (f->first.find(value) != f->first.npos)
+			songs.insert(songs.end(),
+				     f->second.begin(), f->second.end());
+}
+
+bool
+SongIndex::Collect(const SongFilter &filter,
+		   std::vector<const Song *> &songs) const
+{
+	assert(holding_db_lock());
+
+	/* find the exact-match item with the fewest songs */
+
+	bool found = false;
+	const SongSet *best = nullptr, *best_fallback = nullptr;
+	size_t best_size = 0;
+
+	for (const auto &item : filter.GetItems()) {
+		if (item.GetTag() >= TAG_NUM_OF_ITEM_TYPES ||
+		    item.GetFoldCase() || item.GetValue().empty())
+			/* not an exact tag match, or an empty value
+			   which matches songs without this tag */
+			continue;
+
+		const TagType type = TagType(item.GetTag());
+		const SongSet *set = Find(type, item.GetValue());
+
+		/* "album artist" falls back to "artist" in songs
+		   which have no "album artist" tag; see
+		   SongFilter::Item::Match() */
+		const SongSet *fallback = type == TAG_ALBUM_ARTIST
+			? Find(TAG_ARTIST, item.GetValue())
+			: nullptr;
+
+		const size_t size = (set != nullptr ? set->size() : 0) +
+			(fallback != nullptr ? fallback->size() : 0);
+
+		if (!found || size < best_size) {
+			found = true;
+			best = set;
+			best_fallback = fallback;
+			best_size = size;
+		}
+	}
+
+	if (found) {
+		songs.reserve(best_size);
+
+		if (best != nullptr)
+			songs.insert(songs.end(), best->begin(), best->end());
+
+		if (best_fallback != nullptr)
+			songs.insert(songs.end(),
+				     best_fallback->begin(),
+				     best_fallback->end());
+
+		return true;
+	}
+
+	/* no exact match: find the case-insensitive item with the
+	   fewest candidate values */
+
+	const SongFilter::Item *best_item = nullptr;
+	size_t best_cost = 0;
+
+	for (const auto &item : filter.GetItems()) {
+		const unsigned tag = item.GetTag();
+		if (!item.GetFoldCase() ||
+		    item.GetValue().length() < TRIGRAM_LENGTH ||
+		    (tag >= TAG_NUM_OF_ITEM_TYPES &&
+		     tag != LOCATE_TAG_ANY_TYPE))
+			continue;
+
+		size_t cost = 0;
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			if (ItemUsesType(tag, TagType(i)))
+				cost += EstimateFolded(TagType(i),
+						       item.GetValue());
+
+		if (best_item == nullptr || cost < best_cost) {
+			best_item = &item;
+			best_cost = cost;
+		}
+	}
+
+	if (best_item == nullptr)
+		return false;
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (ItemUsesType(best_item->GetTag(), TagType(i)))
+			FindFolded(TagType(i), best_item->GetValue(), songs);
+
+	return true;
+}
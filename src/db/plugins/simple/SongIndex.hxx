@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SONG_INDEX_HXX
+#define MPD_SONG_INDEX_HXX
+
+#include "db/Visitor.hxx"
+#include "tag/TagType.h"
+#include "Compiler.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <stdint.h>
+
+struct Song;
+struct Tag;
+class SongFilter;
+class Error;
+struct DatabaseStats;
+
+/**
+ * An inverted index from (#TagType, value) to the songs which have
+ * this tag.  It is owned by the #SimpleDatabase and updated by
+ * Directory::AddSong() and Directory::RemoveSong().
+ *
+ * In addition, the case-folded values are indexed by their trigrams
+ * (all substrings of three bytes), which allows looking up
+ * case-insensitive substring matches ("search") without folding the
+ * tags of every song.
+ *
+ * All methods must be called with the #db_mutex locked.
+ */
+class SongIndex {
+	typedef std::unordered_set<const Song *> SongSet;
+
+	/**
+	 * Maps a case-folded value to the songs having a tag which
+	 * folds to it.  Entries are never removed (only their song
+	 * set gets empty), because #TrigramMap points to them.
+	 */
+	typedef std::unordered_map<std::string, SongSet> FoldedMap;
+	typedef FoldedMap::value_type FoldedValue;
+
+	struct ValueEntry {
+		SongSet songs;
+
+		/**
+		 * The #FoldedMap entry of this value.
+		 */
+		FoldedValue *folded;
+	};
+
+	typedef std::unordered_map<std::string, ValueEntry> ValueMap;
+
+	/**
+	 * Maps a trigram (three bytes packed into an integer) to the
+	 * folded values containing it.
+	 */
+	typedef std::unordered_map<uint32_t,
+				   std::vector<const FoldedValue *>> TrigramMap;
+
+	/**
+	 * The values listed by an unfiltered "list" command, sorted,
+	 * with the number of songs having each of them.
+	 */
+	typedef std::map<std::string, unsigned> UniqueMap;
+
+	struct TypeIndex {
+		ValueMap values;
+		FoldedMap folded;
+		TrigramMap trigrams;
+
+		UniqueMap unique;
+
+		/**
+		 * The number of songs which have no value to be
+		 * listed; they are listed as one empty value.
+		 */
+		unsigned n_missing;
+
+		TypeIndex():n_missing(0) {}
+	};
+
+	TypeIndex types[TAG_NUM_OF_ITEM_TYPES];
+
+	unsigned n_songs;
+
+	/**
+	 * The sum of all known song durations (in seconds).
+	 */
+	unsigned long total_duration;
+
+public:
+	SongIndex():n_songs(0), total_duration(0) {}
+
+	void Add(const Song &song);
+	void Remove(const Song &song);
+
+	void Clear();
+
+	/**
+	 * Collect the songs which may match the given filter, by
+	 * looking up the most selective item: an exact match, or else
+	 * a case-insensitive substring of at least three bytes.  The
+	 * caller must still apply the filter to each of them, and the
+	 * list may contain duplicates.
+	 *
+	 * @return false if the filter has no item which can be looked
+	 * up in the index (e.g. only empty or very short values)
+	 */
+	bool Collect(const SongFilter &filter,
+		     std::vector<const Song *> &songs) const;
+
+	/**
+	 * Obtain the statistics of all songs, like ::GetStats()
+	 * would, but without scanning all songs.
+	 */
+	void GetStats(DatabaseStats &stats) const;
+
+	/**
+	 * Visit all unique values of the given tag type, like
+	 * ::VisitUniqueTags() without a filter and without groups
+	 * would, but without scanning all songs.
+	 */
+	bool VisitUniqueTags(TagType type, VisitTag visit_tag,
+			     Error &error) const;
+
+private:
+	/**
+	 * Add the song's values to #TypeIndex::unique (or remove
+	 * them).  This follows TagSet::InsertUnique(): "album artist"
+	 * falls back to "artist", and songs without a value count as
+	 * #TypeIndex::n_missing.
+	 */
+	void UpdateUnique(const Tag &tag, bool add);
+
+	gcc_pure
+	const SongSet *Find(TagType type, const std::string &value) const;
+
+	static void AddTrigrams(TrigramMap &trigrams,
+				const FoldedValue &value);
+
+	/**
+	 * Estimate the cost of FindFolded().
+	 */
+	gcc_pure
+	size_t EstimateFolded(TagType type, const std::string &value) const;
+
+	/**
+	 * Add all songs with a tag of the given type which contains
+	 * the given case-folded value.
+	 */
+	void FindFolded(TagType type, const std::string &value,
+			std::vector<const Song *> &songs) const;
+};
+
+#endif
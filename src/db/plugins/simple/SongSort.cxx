@@ -23,86 +23,102 @@
 #include "tag/Tag.hxx"
 #include "lib/icu/Collate.hxx"
 
-#include <stdlib.h>
-
-static int
-compare_utf8_string(const char *a, const char *b)
-{
-	if (a == nullptr)
-		return b == nullptr ? 0 : -1;
+#include <algorithm>
+#include <string>
+#include <vector>
 
-	if (b == nullptr)
-		return 1;
-
-	return IcuCollate(a, b);
-}
+#include <stdlib.h>
 
 /**
- * Compare two string tag values, ignoring case.  Either one may be
- * nullptr.
+ * Parse a tag value which should contain an integer value (e.g. disc
+ * or track number).  Returns 0 if it is missing or not positive.
  */
-static int
-compare_string_tag_item(const Tag &a, const Tag &b,
-			TagType type)
+static long
+ParseNumberTag(const Tag &tag, TagType type)
 {
-	return compare_utf8_string(a.GetValue(type),
-				   b.GetValue(type));
+	const char *value = tag.GetValue(type);
+	if (value == nullptr)
+		return 0;
+
+	long n = strtol(value, nullptr, 10);
+	return n > 0 ? n : 0;
 }
 
 /**
- * Compare two tag values which should contain an integer value
- * (e.g. disc or track number).  Either one may be nullptr.
+ * The values which determine the order of songs within a directory,
+ * computed once per song, so the comparisons do not need to parse
+ * and collate the strings again.
  */
-static int
-compare_number_string(const char *a, const char *b)
-{
-	long ai = a == nullptr ? 0 : strtol(a, nullptr, 10);
-	long bi = b == nullptr ? 0 : strtol(b, nullptr, 10);
-
-	if (ai <= 0)
-		return bi <= 0 ? 0 : -1;
-
-	if (bi <= 0)
-		return 1;
-
-	return ai - bi;
-}
-
-static int
-compare_tag_item(const Tag &a, const Tag &b, TagType type)
-{
-	return compare_number_string(a.GetValue(type),
-				     b.GetValue(type));
-}
+struct SongSortKey {
+	Song *song;
+
+	bool has_album;
+
+	/**
+	 * The collation key of the album name; see IcuCollateKey().
+	 */
+	std::string album;
+
+	long disc, track;
+
+	/**
+	 * The collation key of the file name.  It is only calculated
+	 * when two songs cannot be ordered by their tags.
+	 */
+	mutable std::string uri;
+
+	explicit SongSortKey(Song &_song)
+		:song(&_song) {
+		const char *album_value = song->tag.GetValue(TAG_ALBUM);
+		has_album = album_value != nullptr;
+		if (has_album)
+			album = IcuCollateKey(album_value);
+
+		disc = ParseNumberTag(song->tag, TAG_DISC);
+		track = ParseNumberTag(song->tag, TAG_TRACK);
+	}
+
+	const std::string &GetURIKey() const {
+		if (uri.empty())
+			uri = IcuCollateKey(song->uri);
+		return uri;
+	}
+};
 
 /* Only used for sorting/searchin a songvec, not general purpose compares */
 gcc_pure
 static bool
-song_cmp(const Song &a, const Song &b)
+song_cmp(const SongSortKey &a, const SongSortKey &b)
 {
-	int ret;
+	/* first sort by album; songs without one come first */
+	if (a.has_album != b.has_album)
+		return b.has_album;
 
-	/* first sort by album */
-	ret = compare_string_tag_item(a.tag, b.tag, TAG_ALBUM);
+	const int ret = a.album.compare(b.album);
 	if (ret != 0)
 		return ret < 0;
 
-	/* then sort by disc */
-	ret = compare_tag_item(a.tag, b.tag, TAG_DISC);
-	if (ret != 0)
-		return ret < 0;
+	/* then sort by disc, then by track number */
+	if (a.disc != b.disc)
+		return a.disc < b.disc;
 
-	/* then by track number */
-	ret = compare_tag_item(a.tag, b.tag, TAG_TRACK);
-	if (ret != 0)
-		return ret < 0;
+	if (a.track != b.track)
+		return a.track < b.track;
 
 	/* still no difference?  compare file name */
-	return IcuCollate(a.uri, b.uri) < 0;
+	return a.GetURIKey() < b.GetURIKey();
 }
 
 void
 song_list_sort(SongList &songs)
 {
-	songs.sort(song_cmp);
+	std::vector<SongSortKey> keys;
+	for (auto &song : songs)
+		keys.emplace_back(song);
+
+	std::stable_sort(keys.begin(), keys.end(), song_cmp);
+
+	songs.clear();
+	for (const auto &key : keys)
+		songs.push_back(*key.song);
 }
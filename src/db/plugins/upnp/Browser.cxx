@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Browser.hxx"
+#include "Directory.hxx"
+#include "lib/upnp/ContentDirectoryService.hxx"
+#include "lib/upnp/Domain.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Never queue more than this number of prefetch tasks.
+ */
+static constexpr unsigned MAX_PREFETCH_QUEUE = 64;
+
+/**
+ * The remaining slices of one container, which are read concurrently
+ * by the calling thread and the worker threads.
+ */
+class UpnpSliceJob {
+	const ContentDirectoryService server;
+	const std::string objid;
+
+	/**
+	 * The offset of the first slice.
+	 */
+	const unsigned start;
+
+	const unsigned slice_size, n_slices;
+
+	/**
+	 * The number of objects in the container.
+	 */
+	const unsigned total;
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * The index of the next slice to be read.
+	 */
+	unsigned next;
+
+	/**
+	 * The number of threads currently reading a slice.
+	 */
+	unsigned running;
+
+	Error error;
+
+public:
+	std::vector<UPnPDirContent> slices;
+
+	UpnpSliceJob(const ContentDirectoryService &_server,
+		     const char *_objid,
+		     unsigned _start, unsigned _slice_size, unsigned _total)
+		:server(_server), objid(_objid),
+		 start(_start), slice_size(_slice_size),
+		 n_slices((_total - _start + _slice_size - 1) / _slice_size),
+		 total(_total),
+		 next(0), running(0),
+		 slices(n_slices) {}
+
+	/**
+	 * Read slices until there are none left.
+	 */
+	void Run(UpnpClient_Handle handle);
+
+	/**
+	 * Wait until all slices have been read.
+	 */
+	bool Wait(Error &error_r);
+
+private:
+	bool ReadSlice(UpnpClient_Handle handle, unsigned i,
+		       Error &error_r);
+};
+
+struct UpnpBrowseTask {
+	ContentDirectoryService server;
+	std::string objid;
+
+	/**
+	 * If set, then this task helps reading the slices of this
+	 * job.  Otherwise, it is a prefetch task, which reads the
+	 * whole container #objid into the cache.
+	 */
+	std::shared_ptr<UpnpSliceJob> job;
+
+	UpnpBrowseTask(const ContentDirectoryService &_server,
+		       const std::string &_objid,
+		       std::shared_ptr<UpnpSliceJob> _job=nullptr)
+		:server(_server), objid(_objid), job(std::move(_job)) {}
+};
+
+inline bool
+UpnpSliceJob::ReadSlice(UpnpClient_Handle handle, unsigned i,
+			Error &error_r)
+{
+	const unsigned offset = start + i * slice_size;
+	unsigned want = std::min(slice_size, total - offset);
+
+	/* the server may return less than requested; keep reading
+	   until the slice is complete */
+	unsigned done = 0;
+	while (done < want) {
+		unsigned count, total2 = total;
+		if (!server.readDirSlice(handle, objid.c_str(),
+					 offset + done, want - done,
+					 slices[i],
+					 count, total2, error_r))
+			return false;
+
+		if (count == 0)
+			break;
+
+		done += count;
+	}
+
+	return true;
+}
+
+void
+UpnpSliceJob::Run(UpnpClient_Handle handle)
+{
+	const ScopeLock protect(mutex);
+
+	while (next < n_slices && !error.IsDefined()) {
+		const unsigned i = next++;
+		++running;
+
+		Error error2;
+		mutex.unlock();
+		const bool success = ReadSlice(handle, i, error2);
+		mutex.lock();
+
+		--running;
+		if (!success && !error.IsDefined())
+			error = std::move(error2);
+
+		cond.broadcast();
+	}
+}
+
+bool
+UpnpSliceJob::Wait(Error &error_r)
+{
+	const ScopeLock protect(mutex);
+
+	while (running > 0 || (next < n_slices && !error.IsDefined()))
+		cond.wait(mutex);
+
+	if (error.IsDefined()) {
+		error_r.Set(error);
+		return false;
+	}
+
+	return true;
+}
+
+UpnpBrowser::UpnpBrowser(UpnpClient_Handle _handle,
+			 unsigned cache_ttl, unsigned cache_size,
+			 unsigned _prefetch)
+	:handle(_handle), cache(cache_ttl, cache_size),
+	 prefetch(_prefetch), n_prefetch(0),
+	 queue("upnp_browse"), started(false)
+{
+}
+
+UpnpBrowser::~UpnpBrowser()
+{
+	/* this destructor exists here because #UpnpBrowseTask is
+	   incomplete in the header; the WorkQueue destructor stops
+	   the worker threads */
+}
+
+bool
+UpnpBrowser::Start(unsigned n_threads, Error &error)
+{
+	assert(!started);
+
+	if (n_threads == 0)
+		return true;
+
+	if (!queue.start(n_threads, Worker, this)) {
+		error.Set(upnp_domain, "Browse work queue start failed");
+		return false;
+	}
+
+	started = true;
+	return true;
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpBrowser::Load(const ContentDirectoryService &server, const char *objid,
+		  bool concurrent, Error &error)
+{
+	const unsigned slice_size = server.GetSliceSize();
+
+	std::shared_ptr<UPnPDirContent> content =
+		std::make_shared<UPnPDirContent>();
+
+	/* the first slice tells us how large the container is */
+	unsigned count, total = -1;
+	if (!server.readDirSlice(handle, objid, 0, slice_size, *content,
+				 count, total, error))
+		return nullptr;
+
+	if (count == 0 || count >= total)
+		return content;
+
+	if (total == unsigned(-1) || slice_size == 0) {
+		/* the size is unknown; read sequentially */
+		unsigned offset = count;
+		do {
+			if (!server.readDirSlice(handle, objid, offset,
+						 slice_size, *content,
+						 count, total, error))
+				return nullptr;
+
+			offset += count;
+		} while (count > 0 && offset < total);
+
+		return content;
+	}
+
+	const auto job = std::make_shared<UpnpSliceJob>(server, objid,
+							count, slice_size,
+							total);
+
+	if (concurrent && started) {
+		/* let the worker threads help; we don't need more
+		   helpers than slices */
+		const unsigned n = std::min<unsigned>(job->slices.size() - 1,
+						      16);
+		for (unsigned i = 0; i < n; ++i)
+			queue.put(std::unique_ptr<UpnpBrowseTask>(new UpnpBrowseTask(server, objid, job)));
+	}
+
+	job->Run(handle);
+	if (!job->Wait(error))
+		return nullptr;
+
+	for (auto &slice : job->slices)
+		for (auto &object : slice.objects)
+			content->objects.emplace_back(std::move(object));
+
+	return content;
+}
+
+void
+UpnpBrowser::Prefetch(const ContentDirectoryService &server,
+		      const UPnPDirContent &content)
+{
+	if (!started || !cache.IsEnabled())
+		return;
+
+	const std::string uri = server.GetURI();
+
+	unsigned n = 0;
+	for (const auto &object : content.objects) {
+		if (n >= prefetch || n_prefetch >= MAX_PREFETCH_QUEUE)
+			break;
+
+		if (object.type != UPnPDirObject::Type::CONTAINER ||
+		    cache.Contains(uri, object.m_id))
+			continue;
+
+		++n_prefetch;
+		++n;
+		queue.put(std::unique_ptr<UpnpBrowseTask>(new UpnpBrowseTask(server, object.m_id)));
+	}
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpBrowser::ReadDir(const ContentDirectoryService &server, const char *objid,
+		     Error &error)
+{
+	const std::string uri = server.GetURI();
+
+	auto content = cache.Get(uri, objid);
+	if (content == nullptr) {
+		content = Load(server, objid, true, error);
+		if (content == nullptr)
+			return nullptr;
+
+		cache.Put(uri, objid, content);
+	}
+
+	Prefetch(server, *content);
+	return content;
+}
+
+inline void
+UpnpBrowser::RunTask(UpnpBrowseTask &task)
+{
+	if (task.job != nullptr) {
+		task.job->Run(handle);
+		return;
+	}
+
+	--n_prefetch;
+
+	const std::string uri = task.server.GetURI();
+	if (cache.Contains(uri, task.objid))
+		return;
+
+	Error error;
+	auto content = Load(task.server, task.objid.c_str(), false, error);
+	if (content == nullptr) {
+		LogError(error);
+		return;
+	}
+
+	cache.Put(uri, task.objid, std::move(content));
+}
+
+inline void
+UpnpBrowser::Worker()
+{
+	SetThreadName("upnp_browse");
+
+	for (;;) {
+		std::unique_ptr<UpnpBrowseTask> task;
+		if (!queue.take(task)) {
+			queue.workerExit();
+			return;
+		}
+
+		RunTask(*task);
+	}
+}
+
+void *
+UpnpBrowser::Worker(void *ctx)
+{
+	UpnpBrowser &browser = *(UpnpBrowser *)ctx;
+	browser.Worker();
+	return (void*)1;
+}
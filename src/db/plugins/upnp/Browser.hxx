@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPNP_BROWSER_HXX
+#define MPD_UPNP_BROWSER_HXX
+
+#include "Cache.hxx"
+#include "lib/upnp/WorkQueue.hxx"
+
+#include <upnp/upnp.h>
+
+#include <atomic>
+#include <memory>
+
+class Error;
+class ContentDirectoryService;
+class UPnPDirContent;
+struct UpnpBrowseTask;
+
+/**
+ * Reads container listings from media servers.  Results are kept in
+ * a #UpnpDirCache.  Slices of large containers are requested
+ * concurrently by a pool of worker threads, which also prefetch the
+ * sub containers of each listing.
+ */
+class UpnpBrowser {
+	const UpnpClient_Handle handle;
+
+	UpnpDirCache cache;
+
+	/**
+	 * The maximum number of sub containers to be prefetched after
+	 * a listing has been read; 0 disables prefetching.
+	 */
+	const unsigned prefetch;
+
+	/**
+	 * The number of prefetch tasks in the #queue.  This is used to
+	 * limit the queue size.
+	 */
+	std::atomic_uint n_prefetch;
+
+	WorkQueue<std::unique_ptr<UpnpBrowseTask>> queue;
+
+	bool started;
+
+public:
+	UpnpBrowser(UpnpClient_Handle _handle,
+		    unsigned cache_ttl, unsigned cache_size,
+		    unsigned _prefetch);
+	~UpnpBrowser();
+
+	/**
+	 * Start the worker threads.  If this is not called, all
+	 * requests are made in the calling thread.
+	 */
+	bool Start(unsigned n_threads, Error &error);
+
+	/**
+	 * Read the children of a container.
+	 */
+	std::shared_ptr<const UPnPDirContent>
+	ReadDir(const ContentDirectoryService &server, const char *objid,
+		Error &error);
+
+private:
+	/**
+	 * Read a container from the server, bypassing the cache.
+	 *
+	 * @param concurrent request slices in the worker threads?
+	 */
+	std::shared_ptr<const UPnPDirContent>
+	Load(const ContentDirectoryService &server, const char *objid,
+	     bool concurrent, Error &error);
+
+	void Prefetch(const ContentDirectoryService &server,
+		      const UPnPDirContent &content);
+
+	void RunTask(UpnpBrowseTask &task);
+
+	void Worker();
+	static void *Worker(void *ctx);
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Cache.hxx"
+#include "Directory.hxx"
+#include "system/Clock.hxx"
+
+void
+UpnpDirCache::Erase(std::map<Key, Item>::iterator i)
+{
+	lru.erase(i->second.lru_position);
+	map.erase(i);
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpDirCache::Get(const std::string &server, const std::string &objid)
+{
+	if (!IsEnabled())
+		return nullptr;
+
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(Key(server, objid));
+	if (i == map.end())
+		return nullptr;
+
+	if ((int)(MonotonicClockS() - i->second.expires) >= 0) {
+		Erase(i);
+		return nullptr;
+	}
+
+	/* move to the front of the LRU list */
+	lru.splice(lru.begin(), lru, i->second.lru_position);
+
+	return i->second.content;
+}
+
+bool
+UpnpDirCache::Contains(const std::string &server, const std::string &objid)
+{
+	if (!IsEnabled())
+		return false;
+
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(Key(server, objid));
+	return i != map.end() &&
+		(int)(MonotonicClockS() - i->second.expires) < 0;
+}
+
+void
+UpnpDirCache::Put(const std::string &server, const std::string &objid,
+		  std::shared_ptr<const UPnPDirContent> content)
+{
+	if (!IsEnabled())
+		return;
+
+	const unsigned expires = MonotonicClockS() + ttl;
+
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(Key(server, objid));
+	if (i != map.end()) {
+		i->second.content = std::move(content);
+		i->second.expires = expires;
+		lru.splice(lru.begin(), lru, i->second.lru_position);
+		return;
+	}
+
+	while (map.size() >= max_size) {
+		/* evict the least recently used item */
+		auto j = map.find(*lru.back());
+		Erase(j);
+	}
+
+	i = map.insert(std::make_pair(Key(server, objid), Item())).first;
+	i->second.content = std::move(content);
+	i->second.expires = expires;
+	lru.push_front(&i->first);
+	i->second.lru_position = lru.begin();
+}
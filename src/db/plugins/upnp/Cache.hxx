@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPNP_CACHE_HXX
+#define MPD_UPNP_CACHE_HXX
+
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <memory>
+#include <string>
+#include <map>
+#include <list>
+
+class UPnPDirContent;
+
+/**
+ * A cache of container listings ("BrowseDirectChildren" results),
+ * keyed by media server and object id.  Entries expire after a fixed
+ * time, and the least recently used entries are evicted when the
+ * cache is full.
+ *
+ * This class is thread-safe.
+ */
+class UpnpDirCache {
+	typedef std::pair<std::string, std::string> Key;
+
+	struct Item {
+		std::shared_ptr<const UPnPDirContent> content;
+
+		/**
+		 * The time stamp (MonotonicClockS()) after which this
+		 * item is stale.
+		 */
+		unsigned expires;
+
+		/**
+		 * The position of this item in #lru.
+		 */
+		std::list<const Key *>::iterator lru_position;
+	};
+
+	const unsigned ttl;
+	const unsigned max_size;
+
+	Mutex mutex;
+
+	std::map<Key, Item> map;
+
+	/**
+	 * Pointers to the keys in #map; the most recently used one is
+	 * at the front.
+	 */
+	std::list<const Key *> lru;
+
+public:
+	/**
+	 * @param _ttl the number of seconds after which an item
+	 * expires; 0 disables the cache
+	 * @param _max_size the maximum number of items
+	 */
+	UpnpDirCache(unsigned _ttl, unsigned _max_size)
+		:ttl(_ttl), max_size(_max_size) {}
+
+	bool IsEnabled() const {
+		return ttl > 0 && max_size > 0;
+	}
+
+	/**
+	 * Look up a container.
+	 *
+	 * @return the cached listing, or nullptr if there is no
+	 * (fresh) item
+	 */
+	std::shared_ptr<const UPnPDirContent> Get(const std::string &server,
+						  const std::string &objid);
+
+	/**
+	 * Does the cache contain a fresh item for this container?
+	 */
+	gcc_pure
+	bool Contains(const std::string &server, const std::string &objid);
+
+	void Put(const std::string &server, const std::string &objid,
+		 std::shared_ptr<const UPnPDirContent> content);
+
+private:
+	void Erase(std::map<Key, Item>::iterator i);
+};
+
+#endif
@@ -38,7 +38,7 @@ ReadResultTag(UPnPDirContent &dirbuf, IXML_Document *response, Error &error)
 	return dirbuf.parse(p, error);
 }
 
-inline bool
+bool
 ContentDirectoryService::readDirSlice(UpnpClient_Handle hdl,
 				      const char *objectId, unsigned offset,
 				      unsigned count, UPnPDirContent &dirbuf,
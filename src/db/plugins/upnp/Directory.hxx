@@ -39,8 +39,8 @@ public:
 	~UPnPDirContent();
 
 	gcc_pure
-	UPnPDirObject *FindObject(const char *name) {
-		for (auto &o : objects)
+	const UPnPDirObject *FindObject(const char *name) const {
+		for (const auto &o : objects)
 			if (o.name == name)
 				return &o;
 
@@ -65,6 +65,7 @@ public:
 	Tag tag;
 
 	UPnPDirObject() = default;
+	UPnPDirObject(const UPnPDirObject &) = default;
 	UPnPDirObject(UPnPDirObject &&) = default;
 
 	~UPnPDirObject();
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "UpnpDatabasePlugin.hxx"
 #include "Directory.hxx"
+#include "Browser.hxx"
 #include "Tags.hxx"
 #include "lib/upnp/Domain.hxx"
 #include "lib/upnp/ClientInit.hxx"
@@ -28,6 +29,7 @@
 #include "lib/upnp/Util.hxx"
 #include "db/Interface.hxx"
 #include "db/DatabasePlugin.hxx"
+#include "db/plugins/LazyDatabase.hxx"
 #include "db/Selection.hxx"
 #include "db/DatabaseError.hxx"
 #include "db/LightDirectory.hxx"
@@ -45,6 +47,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <memory>
 
 #include <assert.h>
 #include <string.h>
@@ -74,6 +77,14 @@ class UpnpDatabase : public Database {
 	UpnpClient_Handle handle;
 	UPnPDeviceDirectory *discovery;
 
+	UpnpBrowser *browser;
+
+	/* configuration */
+
+	unsigned cache_ttl, cache_size;
+	unsigned browse_threads, prefetch;
+	unsigned discovery_threads;
+
 public:
 	UpnpDatabase():Database(upnp_db_plugin) {}
 
@@ -106,6 +117,20 @@ public:
 protected:
 	bool Configure(const config_param &param, Error &error);
 
+	/**
+	 * Create a new (not yet opened) instance with the same
+	 * configuration.
+	 */
+	UpnpDatabase *CloneConfig() const {
+		UpnpDatabase *db = new UpnpDatabase();
+		db->cache_ttl = cache_ttl;
+		db->cache_size = cache_size;
+		db->browse_threads = browse_threads;
+		db->prefetch = prefetch;
+		db->discovery_threads = discovery_threads;
+		return db;
+	}
+
 private:
 	bool VisitServer(const ContentDirectoryService &server,
 			 const std::list<std::string> &vpath,
@@ -154,8 +179,7 @@ private:
 };
 
 Database *
-UpnpDatabase::Create(gcc_unused EventLoop &loop,
-		     gcc_unused DatabaseListener &listener,
+UpnpDatabase::Create(EventLoop &loop, DatabaseListener &listener,
 		     const config_param &param, Error &error)
 {
 	UpnpDatabase *db = new UpnpDatabase();
@@ -164,15 +188,30 @@ UpnpDatabase::Create(gcc_unused EventLoop &loop,
 		return nullptr;
 	}
 
+	/* a reload discovers the servers from scratch */
+	const std::shared_ptr<const UpnpDatabase> prototype(db->CloneConfig());
+	auto factory = [prototype](Error &) -> Database * {
+		return prototype->CloneConfig();
+	};
+
 	/* libupnp loses its ability to receive multicast messages
 	   apparently due to daemonization; using the LazyDatabase
-	   wrapper works around this problem */
-	return db;
+	   wrapper works around this problem; the discovery is
+	   started in the background, so the first client does not
+	   have to wait for it */
+	return new LazyDatabase(loop, listener, db, factory, true);
 }
 
 inline bool
-UpnpDatabase::Configure(const config_param &, Error &)
+UpnpDatabase::Configure(const config_param &param, Error &)
 {
+	cache_ttl = param.GetBlockValue("cache_ttl", 60u);
+	cache_size = param.GetBlockValue("cache_size", 1024u);
+	browse_threads = param.GetBlockValue("browse_threads", 4u);
+	prefetch = param.GetBlockValue("prefetch", 8u);
+	discovery_threads = param.GetBlockValue("discovery_threads", 4u);
+	if (discovery_threads == 0)
+		discovery_threads = 1;
 	return true;
 }
 
@@ -183,7 +222,15 @@ UpnpDatabase::Open(Error &error)
 		return false;
 
 	discovery = new UPnPDeviceDirectory(handle);
-	if (!discovery->Start(error)) {
+	if (!discovery->Start(discovery_threads, error)) {
+		delete discovery;
+		UpnpClientGlobalFinish();
+		return false;
+	}
+
+	browser = new UpnpBrowser(handle, cache_ttl, cache_size, prefetch);
+	if (!browser->Start(browse_threads, error)) {
+		delete browser;
 		delete discovery;
 		UpnpClientGlobalFinish();
 		return false;
@@ -195,6 +242,7 @@ UpnpDatabase::Open(Error &error)
 void
 UpnpDatabase::Close()
 {
+	delete browser;
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
@@ -486,12 +534,13 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 
 	// Walk the path elements, read each directory and try to find the next one
 	for (auto i = vpath.begin(), last = std::prev(vpath.end());; ++i) {
-		UPnPDirContent dirbuf;
-		if (!server.readDir(handle, objid.c_str(), dirbuf, error))
+		const auto dirbuf = browser->ReadDir(server, objid.c_str(),
+						     error);
+		if (dirbuf == nullptr)
 			return false;
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(i->c_str());
+		const UPnPDirObject *child = dirbuf->FindObject(i->c_str());
 		if (child == nullptr) {
 			error.Format(db_domain, DB_NOT_FOUND,
 				     "No such object");
@@ -499,7 +548,7 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 		}
 
 		if (i == last) {
-			odirent = std::move(*child);
+			odirent = UPnPDirObject(*child);
 			return true;
 		}
 
@@ -509,7 +558,7 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 			return false;
 		}
 
-		objid = std::move(child->m_id);
+		objid = child->m_id;
 	}
 }
 
@@ -657,12 +706,12 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	UPnPDirContent dirbuf;
-	if (!server.readDir(handle, tdirent.m_id.c_str(), dirbuf,
-			    error))
+	const auto dirbuf = browser->ReadDir(server, tdirent.m_id.c_str(),
+					     error);
+	if (dirbuf == nullptr)
 		return false;
 
-	for (auto &dirent : dirbuf.objects) {
+	for (const auto &dirent : dirbuf->objects) {
 		const std::string uri = PathTraitsUTF8::Build(base_uri,
 							      dirent.name.c_str());
 		if (!VisitObject(dirent, uri.c_str(),
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "AnalysisPool.hxx"
+#include "UpdateDomain.hxx"
+#include "storage/StorageInterface.hxx"
+#include "sticker/LoudnessSticker.hxx"
+#include "decoder/DecoderControl.hxx"
+#include "decoder/DecoderThread.hxx"
+#include "pcm/Loudness.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmFormat.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "DetachedSong.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "thread/Policy.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+/**
+ * The number of chunks between the decoder and the analysis.
+ */
+static constexpr unsigned ANALYSIS_BUFFER_CHUNKS = 64;
+
+/**
+ * The ReplayGain 2.0 reference level in LUFS.
+ */
+static constexpr double REFERENCE_LOUDNESS = -18.0;
+
+LoudnessAnalysisPool::LoudnessAnalysisPool(Storage &_storage,
+					   unsigned threads)
+	:storage(_storage), quit(false), num_workers(0)
+{
+	threads = std::min(threads, unsigned(MAX_THREADS));
+	while (num_workers < threads) {
+		Worker &w = workers[num_workers];
+		w.pool = this;
+		w.index = num_workers;
+
+		Error error;
+		if (!w.thread.Start(WorkerFunc, &w, error)) {
+			/* continue with the threads we have */
+			LogError(error);
+			break;
+		}
+
+		++num_workers;
+	}
+}
+
+LoudnessAnalysisPool::~LoudnessAnalysisPool()
+{
+	mutex.lock();
+	quit = true;
+	queue.clear();
+	cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < num_workers; ++i)
+		workers[i].thread.Join();
+}
+
+void
+LoudnessAnalysisPool::Push(std::string &&uri)
+{
+	assert(IsEnabled());
+
+	const ScopeLock protect(mutex);
+	queue.emplace_back(std::move(uri));
+	cond.signal();
+}
+
+void
+LoudnessAnalysisPool::Analyze(const char *uri)
+{
+	const std::string real_uri = storage.MapUTF8(uri);
+	if (real_uri.empty())
+		return;
+
+	Mutex dc_mutex;
+	Cond dc_cond;
+	DecoderControl dc(dc_mutex, dc_cond);
+	decoder_thread_start(dc);
+
+	MusicBuffer buffer(ANALYSIS_BUFFER_CHUNKS, DEFAULT_CHUNK_SIZE);
+	MusicPipe pipe;
+
+	dc.Start(new DetachedSong(real_uri), 0, 0, buffer, pipe);
+
+	dc.Lock();
+	while (dc.IsStarting())
+		dc.WaitForDecoder();
+
+	const AudioFormat format = dc.out_audio_format;
+	const bool decoding = !dc.IsIdle();
+	dc.Unlock();
+
+	bool cancelled = false;
+
+	if (decoding && format.format != SampleFormat::DSD) {
+		LoudnessMeter loudness(format.sample_rate, format.channels);
+		MixRampMeter mix_ramp(format.sample_rate, format.channels);
+		PcmBuffer float_buffer;
+
+		dc.Lock();
+		while (true) {
+			music_chunk *chunk = pipe.Shift();
+			if (chunk == nullptr) {
+				if (dc.IsIdle())
+					break;
+
+				/* wake up the decoder if it waits for a
+				   free chunk */
+				dc.Signal();
+				dc.WaitForDecoder();
+				continue;
+			}
+
+			dc.Unlock();
+
+			const auto f =
+				pcm_convert_to_float(float_buffer,
+						     format.format,
+						     ConstBuffer<void>(chunk->data,
+								       chunk->length));
+			if (!f.IsNull()) {
+				const size_t n_frames = f.size / format.channels;
+				loudness.Feed(f.data, n_frames);
+				mix_ramp.Feed(f.data, n_frames);
+			}
+
+			buffer.Return(chunk);
+
+			if (LockIsQuitting()) {
+				cancelled = true;
+				dc.Lock();
+				break;
+			}
+
+			dc.Lock();
+			dc.Signal();
+		}
+
+		const bool failed = dc.HasFailed();
+		dc.Unlock();
+
+		if (!cancelled && !failed) {
+			const double lufs = loudness.GetIntegratedLoudness();
+
+			ReplayGainTuple track;
+			track.Clear();
+			if (lufs > -70) {
+				track.gain = REFERENCE_LOUDNESS - lufs;
+				track.peak = loudness.GetPeak();
+			}
+
+			MixRampInfo mix_ramp_info;
+			mix_ramp_info.SetStart(mix_ramp.GetStart());
+			mix_ramp_info.SetEnd(mix_ramp.GetEnd());
+
+			if (sticker_song_store_loudness(uri, track,
+							mix_ramp_info))
+				FormatDebug(update_domain,
+					    "analyzed %s: %.2f LUFS",
+					    uri, lufs);
+		}
+	}
+
+	dc.Stop();
+	pipe.Clear(buffer);
+	dc.Quit();
+}
+
+inline void
+LoudnessAnalysisPool::WorkerRun(Worker &w)
+{
+	FormatThreadName("analysis:%u", w.index);
+	SetThreadIdlePriority();
+
+	Error policy_error;
+	if (!ApplyThreadPolicy(ThreadClass::UPDATE, policy_error))
+		LogError(policy_error);
+
+	mutex.lock();
+
+	while (!quit) {
+		if (queue.empty()) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		const std::string uri = std::move(queue.front());
+		queue.pop_front();
+
+		mutex.unlock();
+		Analyze(uri.c_str());
+		mutex.lock();
+	}
+
+	mutex.unlock();
+}
+
+void
+LoudnessAnalysisPool::WorkerFunc(void *ctx)
+{
+	Worker &w = *(Worker *)ctx;
+	w.pool->WorkerRun(w);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_ANALYSIS_POOL_HXX
+#define MPD_UPDATE_ANALYSIS_POOL_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <list>
+#include <string>
+
+class Storage;
+
+/**
+ * A pool of threads which decode new and modified songs in the
+ * background to measure their loudness (EBU R128) and their MixRamp
+ * profile.  The results are stored in the sticker database (see
+ * sticker/LoudnessSticker.hxx) and used during playback if the song
+ * file has no ReplayGain/MixRamp tags.
+ *
+ * Unlike the #UpdateScanPool, this pool lives as long as the
+ * #UpdateService: the analysis is much slower than reading tags, and
+ * the database update does not wait for it.
+ */
+class LoudnessAnalysisPool {
+	static constexpr unsigned MAX_THREADS = 16;
+
+	struct Worker {
+		LoudnessAnalysisPool *pool;
+		unsigned index;
+		Thread thread;
+	};
+
+	Storage &storage;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a song was queued, or when the workers
+	 * shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * The URIs of the songs to be analyzed, relative to the music
+	 * directory.
+	 */
+	std::list<std::string> queue;
+
+	bool quit;
+
+	Worker workers[MAX_THREADS];
+	unsigned num_workers;
+
+public:
+	/**
+	 * @param _storage the storage which maps song URIs to the
+	 * files to be decoded
+	 * @param threads the number of worker threads
+	 */
+	LoudnessAnalysisPool(Storage &_storage, unsigned threads);
+
+	/**
+	 * Cancels all pending and running analysis jobs and waits for
+	 * the worker threads to exit.
+	 */
+	~LoudnessAnalysisPool();
+
+	LoudnessAnalysisPool(const LoudnessAnalysisPool &) = delete;
+	LoudnessAnalysisPool &operator=(const LoudnessAnalysisPool &) = delete;
+
+	bool IsEnabled() const {
+		return num_workers > 0;
+	}
+
+	/**
+	 * Queue a song for analysis.
+	 */
+	void Push(std::string &&uri);
+
+private:
+	bool LockIsQuitting() {
+		const ScopeLock protect(mutex);
+		return quit;
+	}
+
+	/**
+	 * Decode the song and store the results.
+	 */
+	void Analyze(const char *uri);
+
+	void WorkerRun(Worker &w);
+	static void WorkerFunc(void *ctx);
+};
+
+#endif
@@ -61,9 +61,9 @@ UpdateWalk::UpdateArchiveTree(Directory &directory, const char *name)
 		}
 
 		//add file
-		db_lock();
+		db_lock_shared();
 		Song *song = directory.FindSong(name);
-		db_unlock();
+		db_unlock_shared();
 		if (song == nullptr) {
 			song = Song::LoadFile(storage, name, directory);
 			if (song != nullptr) {
@@ -107,9 +107,9 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 			      const FileInfo &info,
 			      const ArchivePlugin &plugin)
 {
-	db_lock();
+	db_lock_shared();
 	Directory *directory = parent.FindChild(name);
-	db_unlock();
+	db_unlock_shared();
 
 	if (directory != nullptr && directory->mtime == info.mtime &&
 	    !walk_discard)
@@ -111,7 +111,7 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		plugin.ScanFile(child_path_fs,
 				add_tag_handler, &tag_builder);
 
-		tag_builder.Commit(song->tag);
+		song->CommitTag(tag_builder);
 
 		db_lock();
 		contdir->AddSong(song);
@@ -20,10 +20,12 @@
 #include "config.h" /* must be first for large file support */
 #include "Editor.hxx"
 #include "Remove.hxx"
+#include "IdentityCache.hxx"
 #include "db/PlaylistVector.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
+#include "tag/TagBuilder.hxx"
 
 #include <assert.h>
 #include <stddef.h>
@@ -33,6 +35,8 @@ DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 {
 	assert(del->parent == &dir);
 
+	identity_cache.Add(*del);
+
 	/* first, prevent traversers in main task from getting this */
 	dir.RemoveSong(del);
 
@@ -55,6 +59,24 @@ DatabaseEditor::LockDeleteSong(Directory &parent, Song *song)
 	db_unlock();
 }
 
+void
+DatabaseEditor::LockUpdateSong(Directory &parent, Song &song,
+			       TagBuilder &tag_builder, time_t mtime,
+			       const SongIdentity &identity)
+{
+	assert(song.parent == &parent);
+
+	/* readers see either the old or the new tag, never a
+	   partially updated song */
+	db_lock();
+	parent.UnindexSong(song);
+	song.mtime = mtime;
+	song.identity = identity;
+	song.CommitTag(tag_builder);
+	parent.IndexSong(song);
+	db_unlock();
+}
+
 /**
  * Recursively remove all sub directories and songs from a directory,
  * leaving an empty directory.
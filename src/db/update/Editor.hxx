@@ -23,16 +23,28 @@
 #include "check.h"
 #include "Remove.hxx"
 
+#include <time.h>
+
 struct Directory;
 struct Song;
+struct SongIdentity;
+class TagBuilder;
 class UpdateRemoveService;
+class UpdateIdentityCache;
 
 class DatabaseEditor final {
 	UpdateRemoveService remove;
 
+	/**
+	 * Deleted songs are added to this cache, so their tags can be
+	 * reused if the file shows up under another name.
+	 */
+	UpdateIdentityCache &identity_cache;
+
 public:
-	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener)
-		:remove(_loop, _listener) {}
+	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener,
+		       UpdateIdentityCache &_identity_cache)
+		:remove(_loop, _listener), identity_cache(_identity_cache) {}
 
 	/**
 	 * Caller must lock the #db_mutex.
@@ -44,6 +56,16 @@ public:
 	 */
 	void LockDeleteSong(Directory &parent, Song *song);
 
+	/**
+	 * Replace the tag of a song with one obtained by
+	 * Song::ScanFile(), and update the #SongIndex.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void LockUpdateSong(Directory &parent, Song &song,
+			    TagBuilder &tag_builder, time_t mtime,
+			    const SongIdentity &identity);
+
 	/**
 	 * Recursively free a directory and all its contents.
 	 *
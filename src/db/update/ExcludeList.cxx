@@ -16,7 +16,6 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-
 /*
  * The .mpdignore backend code.
  *
@@ -30,16 +29,93 @@
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 
 static constexpr Domain exclude_list_domain("exclude_list");
 
+/**
+ * Skip one UTF-8 character.
+ */
+static const char *
+SkipUTF8Char(const char *p)
+{
+	assert(*p != 0);
+
+	++p;
+	while ((*p & 0xc0) == 0x80)
+		++p;
+
+	return p;
+}
+
+/**
+ * Match a string against a pattern with the wildcards '*' and '?',
+ * like g_pattern_match_string().  When a '*' has matched too little,
+ * only the most recent one is extended, which keeps this linear in
+ * practice.
+ */
+gcc_pure
+static bool
+GlobMatch(const char *pattern, const char *s)
+{
+	const char *star = nullptr, *star_s = nullptr;
+
+	while (*s != 0) {
+		if (*pattern == '*') {
+			star = ++pattern;
+			star_s = s;
+		} else if (*pattern == '?') {
+			++pattern;
+			s = SkipUTF8Char(s);
+		} else if (*pattern != 0 && *pattern == *s) {
+			++pattern;
+			++s;
+		} else if (star != nullptr) {
+			/* let the last '*' consume one more
+			   character */
+			pattern = star;
+			s = star_s = SkipUTF8Char(star_s);
+		} else
+			return false;
+	}
+
+	while (*pattern == '*')
+		++pattern;
+
+	return *pattern == 0;
+}
+
+void
+ExcludeList::Add(const char *pattern)
+{
+	const char *wildcard = strpbrk(pattern, "*?");
+	if (wildcard == nullptr) {
+		names.emplace(pattern);
+		return;
+	}
+
+	if (pattern[0] == '*' && strpbrk(pattern + 1, "*?") == nullptr) {
+		/* "*SUFFIX" */
+		const char *suffix = pattern + 1;
+		const size_t length = strlen(suffix);
+
+		suffixes.emplace(suffix);
+		if (std::find(suffix_lengths.begin(), suffix_lengths.end(),
+			      length) == suffix_lengths.end())
+			suffix_lengths.push_back(length);
+		return;
+	}
+
+	globs.emplace_front(pattern);
+}
+
 bool
 ExcludeList::LoadFile(Path path_fs)
 {
-#ifdef HAVE_GLIB
 	FILE *file = FOpen(path_fs, FOpenMode::ReadText);
 	if (file == nullptr) {
 		const int e = errno;
@@ -61,18 +137,33 @@ ExcludeList::LoadFile(Path path_fs)
 
 		p = Strip(line);
 		if (*p != 0)
-			patterns.emplace_front(p);
+			Add(p);
 	}
 
 	fclose(file);
-#else
-	// TODO: implement
-	(void)path_fs;
-#endif
 
 	return true;
 }
 
+inline bool
+ExcludeList::CheckLocal(const char *name_fs, size_t length) const
+{
+	if (!names.empty() && names.find(name_fs) != names.end())
+		return true;
+
+	for (const size_t i : suffix_lengths)
+		if (i <= length &&
+		    suffixes.find(std::string(name_fs + length - i, i))
+		    != suffixes.end())
+			return true;
+
+	for (const auto &i : globs)
+		if (GlobMatch(i.c_str(), name_fs))
+			return true;
+
+	return false;
+}
+
 bool
 ExcludeList::Check(Path name_fs) const
 {
@@ -80,14 +171,12 @@ ExcludeList::Check(Path name_fs) const
 
 	/* XXX include full path name in check */
 
-#ifdef HAVE_GLIB
-	for (const auto &i : patterns)
-		if (i.Check(name_fs.c_str()))
+	const char *name = name_fs.c_str();
+	const size_t length = strlen(name);
+
+	for (const ExcludeList *i = this; i != nullptr; i = i->parent)
+		if (i->CheckLocal(name, length))
 			return true;
-#else
-	// TODO: implement
-	(void)name_fs;
-#endif
 
 	return false;
 }
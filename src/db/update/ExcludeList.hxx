@@ -16,7 +16,6 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-
 /*
  * The .mpdignore backend code.
  *
@@ -29,51 +28,65 @@
 #include "Compiler.h"
 
 #include <forward_list>
+#include <unordered_set>
+#include <vector>
+#include <string>
 
-#ifdef HAVE_GLIB
-#include <glib.h>
-#endif
+#include <stddef.h>
 
 class Path;
 
+/**
+ * The patterns of a .mpdignore file, compiled for fast matching:
+ * patterns without wildcards and patterns of the form "*SUFFIX"
+ * (e.g. "*.jpg") are looked up in hash tables; only the others are
+ * matched one by one.  The patterns of the parent directories apply
+ * as well; they are not loaded again, but referenced through the
+ * #parent pointer.
+ */
 class ExcludeList {
-#ifdef HAVE_GLIB
-	class Pattern {
-		GPatternSpec *pattern;
-
-	public:
-		Pattern(const char *_pattern)
-			:pattern(g_pattern_spec_new(_pattern)) {}
-
-		Pattern(Pattern &&other)
-			:pattern(other.pattern) {
-			other.pattern = nullptr;
-		}
-
-		~Pattern() {
-			g_pattern_spec_free(pattern);
-		}
-
-		gcc_pure
-		bool Check(const char *name_fs) const {
-			return g_pattern_match_string(pattern, name_fs);
-		}
-	};
-
-	std::forward_list<Pattern> patterns;
-#else
-	// TODO: implement
-#endif
+	const ExcludeList *const parent;
+
+	/**
+	 * Patterns without wildcards.
+	 */
+	std::unordered_set<std::string> names;
+
+	/**
+	 * The literal suffixes of "*SUFFIX" patterns.
+	 */
+	std::unordered_set<std::string> suffixes;
+
+	/**
+	 * The distinct lengths of all #suffixes.
+	 */
+	std::vector<size_t> suffix_lengths;
+
+	/**
+	 * All other patterns.  They support the same wildcards as
+	 * GLib's GPatternSpec: '*' matches any string, and '?'
+	 * matches one UTF-8 character.
+	 */
+	std::forward_list<std::string> globs;
 
 public:
+	ExcludeList()
+		:parent(nullptr) {}
+
+	/**
+	 * Construct an empty list which inherits the patterns of the
+	 * parent directory's list.  The parent must live longer than
+	 * this object.
+	 */
+	explicit ExcludeList(const ExcludeList &_parent)
+		:parent(&_parent) {}
+
+	ExcludeList &operator=(const ExcludeList &) = delete;
+
 	gcc_pure
 	bool IsEmpty() const {
-#ifdef HAVE_GLIB
-		return patterns.empty();
-#else
-		// TODO: implement
-		return true;
-#endif
+		return names.empty() && suffixes.empty() && globs.empty() &&
+			(parent == nullptr || parent->IsEmpty());
 	}
 
 	/**
@@ -82,10 +95,18 @@ public:
 	bool LoadFile(Path path_fs);
 
 	/**
-	 * Checks whether one of the patterns in the .mpdignore file matches
-	 * the specified file name.
+	 * Checks whether one of the patterns in the .mpdignore file (or
+	 * in the ones of the parent directories) matches the
+	 * specified file name.
 	 */
+	gcc_pure
 	bool Check(Path name_fs) const;
+
+private:
+	void Add(const char *pattern);
+
+	gcc_pure
+	bool CheckLocal(const char *name_fs, size_t length) const;
 };
 
 
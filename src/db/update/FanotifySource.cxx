@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "FanotifySource.hxx"
+#include "InotifyDomain.hxx"
+#include "util/Error.hxx"
+#include "system/FatalError.hxx"
+#include "Log.hxx"
+
+#include <sys/fanotify.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <limits.h>
+
+inline
+FanotifySource::FanotifySource(EventLoop &_loop,
+			       mpd_fanotify_callback_t _callback, void *_ctx,
+			       int _fd, int _mount_fd)
+	:SocketMonitor(_fd, _loop),
+	 callback(_callback), callback_ctx(_ctx),
+	 mount_fd(_mount_fd)
+{
+	ScheduleRead();
+}
+
+FanotifySource::~FanotifySource()
+{
+	Close();
+	close(mount_fd);
+}
+
+FanotifySource *
+FanotifySource::Create(EventLoop &loop,
+		       const char *path_fs, uint64_t mask,
+		       mpd_fanotify_callback_t callback, void *callback_ctx,
+		       Error &error)
+{
+	int fd = fanotify_init(FAN_CLASS_NOTIF|FAN_REPORT_DFID_NAME|
+			       FAN_CLOEXEC|FAN_NONBLOCK,
+			       O_RDONLY|O_LARGEFILE);
+	if (fd < 0) {
+		error.SetErrno("fanotify_init() has failed");
+		return nullptr;
+	}
+
+	if (fanotify_mark(fd, FAN_MARK_ADD|FAN_MARK_FILESYSTEM, mask,
+			  AT_FDCWD, path_fs) < 0) {
+		error.FormatErrno("fanotify_mark('%s') has failed", path_fs);
+		close(fd);
+		return nullptr;
+	}
+
+	int mount_fd = open(path_fs, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if (mount_fd < 0) {
+		error.FormatErrno("Failed to open %s", path_fs);
+		close(fd);
+		return nullptr;
+	}
+
+	return new FanotifySource(loop, callback, callback_ctx,
+				  fd, mount_fd);
+}
+
+inline void
+FanotifySource::HandleEvent(const struct fanotify_event_metadata &event)
+{
+	if (event.mask & FAN_Q_OVERFLOW) {
+		callback(nullptr, nullptr, event.mask, callback_ctx);
+		return;
+	}
+
+	const char *p = (const char *)&event + event.metadata_len;
+	const char *const end = (const char *)&event + event.event_len;
+
+	while (p + sizeof(struct fanotify_event_info_header) <= end) {
+		const auto &header =
+			*(const struct fanotify_event_info_header *)p;
+		if (header.len == 0 || p + header.len > end)
+			break;
+
+		if (header.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+			const auto &fid =
+				*(const struct fanotify_event_info_fid *)p;
+			const struct file_handle *handle =
+				(const struct file_handle *)(const void *)fid.handle;
+			const char *name = (const char *)handle->f_handle
+				+ handle->handle_bytes;
+
+			/* open_by_handle_at() does not modify the
+			   handle, but its prototype lacks "const" */
+			int dir_fd = open_by_handle_at(mount_fd,
+						       const_cast<struct file_handle *>(handle),
+						       O_PATH|O_CLOEXEC);
+			if (dir_fd < 0)
+				/* the directory has been deleted
+				   meanwhile; its parent will receive
+				   an event, too */
+				return;
+
+			char link[64], path[PATH_MAX];
+			snprintf(link, sizeof(link), "/proc/self/fd/%d",
+				 dir_fd);
+			ssize_t length = readlink(link, path,
+						  sizeof(path) - 1);
+			close(dir_fd);
+			if (length <= 0)
+				return;
+
+			path[length] = 0;
+			callback(path, *name != 0 ? name : nullptr,
+				 event.mask, callback_ctx);
+			return;
+		}
+
+		p += header.len;
+	}
+}
+
+bool
+FanotifySource::OnSocketReady(gcc_unused unsigned flags)
+{
+	alignas(struct fanotify_event_metadata) char buffer[8192];
+
+	ssize_t nbytes = read(Get(), buffer, sizeof(buffer));
+	if (nbytes < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return true;
+
+		FatalSystemError("Failed to read from fanotify");
+	}
+
+	if (nbytes == 0)
+		FatalError("end of file from fanotify");
+
+	for (const struct fanotify_event_metadata *event =
+		     (const struct fanotify_event_metadata *)buffer;
+	     FAN_EVENT_OK(event, nbytes);
+	     event = FAN_EVENT_NEXT(event, nbytes)) {
+		if (event->vers != FANOTIFY_METADATA_VERSION)
+			FatalError("fanotify metadata version mismatch");
+
+		if (event->fd >= 0)
+			/* not used in FID mode, but be safe */
+			close(event->fd);
+
+		HandleEvent(*event);
+	}
+
+	return true;
+}
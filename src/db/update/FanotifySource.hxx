@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_FANOTIFY_SOURCE_HXX
+#define MPD_FANOTIFY_SOURCE_HXX
+
+#include "event/SocketMonitor.hxx"
+
+#include <stdint.h>
+
+class Error;
+
+/**
+ * @param directory_fs the absolute path of the directory which
+ * contains the modified entry; nullptr if the kernel queue has
+ * overflowed and events were lost
+ * @param name the name of the modified entry, or nullptr
+ */
+typedef void (*mpd_fanotify_callback_t)(const char *directory_fs,
+					const char *name,
+					uint64_t mask, void *ctx);
+
+/**
+ * Watches a whole file system with one fanotify mark.  Events carry
+ * the handle of the parent directory and the entry name
+ * (FAN_REPORT_DFID_NAME); the handle is resolved to a path with
+ * open_by_handle_at().  This requires Linux 5.9 and the capabilities
+ * CAP_SYS_ADMIN and CAP_DAC_READ_SEARCH.
+ */
+class FanotifySource final : private SocketMonitor {
+	mpd_fanotify_callback_t callback;
+	void *callback_ctx;
+
+	/**
+	 * A descriptor of the watched directory, which is passed to
+	 * open_by_handle_at() to select the file system.
+	 */
+	int mount_fd;
+
+	FanotifySource(EventLoop &_loop,
+		       mpd_fanotify_callback_t callback, void *ctx,
+		       int fd, int _mount_fd);
+
+public:
+	~FanotifySource();
+
+	/**
+	 * Creates a new fanotify source and marks the file system
+	 * which contains the specified directory.
+	 *
+	 * @param mask the events to watch (FAN_CREATE etc.)
+	 */
+	static FanotifySource *Create(EventLoop &_loop,
+				      const char *path_fs, uint64_t mask,
+				      mpd_fanotify_callback_t callback,
+				      void *ctx,
+				      Error &error);
+
+private:
+	void HandleEvent(const struct fanotify_event_metadata &event);
+
+	virtual bool OnSocketReady(unsigned flags) override;
+};
+
+#endif
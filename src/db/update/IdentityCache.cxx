@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "IdentityCache.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+
+/**
+ * Can the tag of this song be reused for a file with the same
+ * identity?  Sub-songs of containers and songs in archives are
+ * never moved alone.
+ */
+gcc_pure
+static bool
+IsCacheable(const Song &song)
+{
+	return song.identity.IsDefined() &&
+		song.start_ms == 0 && song.end_ms == 0 &&
+		song.parent->device != DEVICE_INARCHIVE &&
+		song.parent->device != DEVICE_CONTAINER;
+}
+
+void
+UpdateIdentityCache::Add(const Song &song)
+{
+	if (!IsCacheable(song))
+		return;
+
+	const Key key{song.identity.size, song.mtime,
+			song.identity.device, song.identity.inode};
+	map.emplace(key, song.tag);
+}
+
+void
+UpdateIdentityCache::LoadDirectory(const Directory &directory)
+{
+	if (directory.IsMount())
+		return;
+
+	for (const auto &song : directory.songs)
+		Add(song);
+
+	for (const auto &child : directory.children)
+		LoadDirectory(child);
+}
+
+const Tag *
+UpdateIdentityCache::Lookup(const SongIdentity &identity, time_t mtime)
+{
+	if (!identity.IsDefined())
+		return nullptr;
+
+	if (!loaded) {
+		/* the update thread may read the tree without
+		   holding the db_mutex */
+		loaded = true;
+		if (root != nullptr)
+			LoadDirectory(*root);
+	}
+
+	const Key key{identity.size, mtime, identity.device, identity.inode};
+	auto i = map.find(key);
+	return i != map.end()
+		? &i->second
+		: nullptr;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_IDENTITY_CACHE_HXX
+#define MPD_UPDATE_IDENTITY_CACHE_HXX
+
+#include "check.h"
+#include "tag/Tag.hxx"
+#include "Compiler.h"
+
+#include <unordered_map>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+struct Directory;
+struct Song;
+struct SongIdentity;
+
+/**
+ * Remembers the tags of all songs in the database, keyed on the
+ * identity (device, inode, size) and the modification time of
+ * their file.  When the update thread finds a new file which has
+ * the same key as a known song, the file was moved or renamed, and
+ * its tags can be copied instead of scanning it again.
+ *
+ * The table is filled lazily from the directory tree the first
+ * time a new file is found; songs deleted before that are added by
+ * the #DatabaseEditor.  This class is only used by the update
+ * thread.
+ */
+class UpdateIdentityCache {
+	struct Key {
+		uint64_t size;
+		time_t mtime;
+		unsigned device, inode;
+
+		bool operator==(const Key &other) const {
+			return size == other.size && mtime == other.mtime &&
+				device == other.device &&
+				inode == other.inode;
+		}
+	};
+
+	struct KeyHash {
+		gcc_pure
+		size_t operator()(const Key &key) const {
+			return size_t(key.inode) * 31 + key.device +
+				size_t(key.size) * 131 + size_t(key.mtime);
+		}
+	};
+
+	/**
+	 * Tag copies share their item array with the song, so they
+	 * are cheap.
+	 */
+	std::unordered_map<Key, Tag, KeyHash> map;
+
+	const Directory *root;
+
+	bool loaded;
+
+public:
+	UpdateIdentityCache():root(nullptr), loaded(false) {}
+
+	UpdateIdentityCache(const UpdateIdentityCache &) = delete;
+	UpdateIdentityCache &operator=(const UpdateIdentityCache &) = delete;
+
+	/**
+	 * Specify the directory tree which is loaded by the first
+	 * Lookup() call.
+	 */
+	void SetRoot(const Directory &_root) {
+		root = &_root;
+	}
+
+	/**
+	 * Remember the tag of a song which is about to be deleted from
+	 * the database.  Songs without a (usable) identity are
+	 * ignored.
+	 */
+	void Add(const Song &song);
+
+	/**
+	 * Look up the tag of a file which was moved.
+	 *
+	 * @return the tag or nullptr if no song with this identity is
+	 * known
+	 */
+	const Tag *Lookup(const SongIdentity &identity, time_t mtime);
+
+private:
+	void LoadDirectory(const Directory &directory);
+};
+
+#endif
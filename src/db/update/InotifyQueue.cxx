@@ -21,17 +21,41 @@
 #include "InotifyQueue.hxx"
 #include "InotifyDomain.hxx"
 #include "Service.hxx"
+#include "system/Clock.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <string.h>
 
 /**
- * Wait this long after the last change before calling
- * update_enqueue().  This increases the probability that updates can
- * be bundled.
+ * Retry after this duration if the #UpdateService is busy.
  */
 static constexpr unsigned INOTIFY_UPDATE_DELAY_S = 5;
 
+/**
+ * Wait this long after a single change before calling
+ * UpdateService::Enqueue().  Each further event in the same batch
+ * extends the quiet period by #INOTIFY_DELAY_STEP_MS, up to
+ * #INOTIFY_MAX_DELAY_MS.  This increases the probability that
+ * updates can be bundled, e.g. while an album is being copied.
+ */
+static constexpr unsigned INOTIFY_MIN_DELAY_MS = 1000;
+static constexpr unsigned INOTIFY_DELAY_STEP_MS = 100;
+static constexpr unsigned INOTIFY_MAX_DELAY_MS = 5000;
+
+/**
+ * Submit a batch no later than this duration after its first event,
+ * even if events keep arriving.
+ */
+static constexpr unsigned INOTIFY_MAX_LATENCY_MS = 30000;
+
+/**
+ * Merge queued paths into common ancestors while there are more than
+ * this number of them.
+ */
+static constexpr size_t INOTIFY_MAX_QUEUE = 16;
+
 void
 InotifyQueue::OnTimeout()
 {
@@ -43,6 +67,8 @@ InotifyQueue::OnTimeout()
 		id = update.Enqueue(uri_utf8, false);
 		if (id == 0) {
 			/* retry later */
+			batch_start_ms = MonotonicClockMS();
+			batch_events = 0;
 			ScheduleSeconds(INOTIFY_UPDATE_DELAY_S);
 			return;
 		}
@@ -52,6 +78,28 @@ InotifyQueue::OnTimeout()
 
 		queue.pop_front();
 	}
+
+	batch_events = 0;
+}
+
+void
+InotifyQueue::ScheduleFlush()
+{
+	const unsigned now = MonotonicClockMS();
+	if (batch_events++ == 0)
+		batch_start_ms = now;
+
+	const unsigned quiet =
+		std::min(INOTIFY_MIN_DELAY_MS +
+			 (batch_events - 1) * INOTIFY_DELAY_STEP_MS,
+			 INOTIFY_MAX_DELAY_MS);
+
+	const unsigned elapsed = now - batch_start_ms;
+	const unsigned remaining = elapsed < INOTIFY_MAX_LATENCY_MS
+		? INOTIFY_MAX_LATENCY_MS - elapsed
+		: 0;
+
+	Schedule(std::min(quiet, remaining));
 }
 
 static bool
@@ -64,11 +112,69 @@ path_in(const char *path, const char *possible_parent)
 		 (path[length] == 0 || path[length] == '/'));
 }
 
+/**
+ * Returns the length of the deepest common ancestor of the two
+ * paths, i.e. the length of their common prefix which ends at a
+ * path separator.  0 means the root directory.
+ */
+gcc_pure
+static size_t
+CommonAncestorLength(const std::string &a, const std::string &b)
+{
+	size_t length = 0;
+
+	for (size_t i = 0;; ++i) {
+		const bool end_a = i == a.length(), end_b = i == b.length();
+		if (end_a || end_b) {
+			if ((end_a || a[i] == '/') && (end_b || b[i] == '/'))
+				length = i;
+			break;
+		}
+
+		if (a[i] != b[i])
+			break;
+
+		if (a[i] == '/')
+			length = i;
+	}
+
+	return length;
+}
+
 void
-InotifyQueue::Enqueue(const char *uri_utf8)
+InotifyQueue::Coalesce()
 {
-	ScheduleSeconds(INOTIFY_UPDATE_DELAY_S);
+	while (queue.size() > INOTIFY_MAX_QUEUE) {
+		auto best_a = queue.begin(), best_b = std::next(best_a);
+		size_t best_length = 0;
+
+		for (auto a = queue.begin(), end = queue.end(); a != end; ++a) {
+			for (auto b = std::next(a); b != end; ++b) {
+				size_t length = CommonAncestorLength(*a, *b);
+				if (length > best_length) {
+					best_a = a;
+					best_b = b;
+					best_length = length;
+				}
+			}
+		}
+
+		std::string ancestor(*best_a, 0, best_length);
+		queue.erase(best_a);
+		queue.erase(best_b);
 
+		FormatDebug(inotify_domain, "coalescing into '%s'",
+			    ancestor.c_str());
+
+		/* this also removes the other descendants of the
+		   ancestor */
+		Insert(ancestor.c_str());
+	}
+}
+
+void
+InotifyQueue::Insert(const char *uri_utf8)
+{
 	for (auto i = queue.begin(), end = queue.end(); i != end;) {
 		const char *current_uri = i->c_str();
 
@@ -87,3 +193,11 @@ InotifyQueue::Enqueue(const char *uri_utf8)
 
 	queue.emplace_back(uri_utf8);
 }
+
+void
+InotifyQueue::Enqueue(const char *uri_utf8)
+{
+	ScheduleFlush();
+	Insert(uri_utf8);
+	Coalesce();
+}
@@ -28,18 +28,50 @@
 
 class UpdateService;
 
+/**
+ * Collects the paths reported by inotify/fanotify and submits them to
+ * the #UpdateService after a quiet period.  The quiet period grows
+ * with the number of events, but the batch is submitted no later
+ * than a fixed time after its first event.  When there are too many
+ * paths, they are merged into their common ancestors.
+ */
 class InotifyQueue final : private TimeoutMonitor {
 	UpdateService &update;
 
 	std::list<std::string> queue;
 
+	/**
+	 * The MonotonicClockMS() value of the first event of the
+	 * current batch.
+	 */
+	unsigned batch_start_ms;
+
+	/**
+	 * The number of events in the current batch.
+	 */
+	unsigned batch_events;
+
 public:
 	InotifyQueue(EventLoop &_loop, UpdateService &_update)
-		:TimeoutMonitor(_loop), update(_update) {}
+		:TimeoutMonitor(_loop), update(_update), batch_events(0) {}
 
 	void Enqueue(const char *uri_utf8);
 
 private:
+	/**
+	 * Add a path to the queue, unless it is already covered by a
+	 * queued ancestor; queued descendants are removed.
+	 */
+	void Insert(const char *uri_utf8);
+
+	/**
+	 * Merge the two paths with the deepest common ancestor until
+	 * the queue is small enough.
+	 */
+	void Coalesce();
+
+	void ScheduleFlush();
+
 	virtual void OnTimeout() override;
 };
 
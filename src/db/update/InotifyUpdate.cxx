@@ -22,9 +22,14 @@
 #include "InotifySource.hxx"
 #include "InotifyQueue.hxx"
 #include "InotifyDomain.hxx"
+#ifdef HAVE_FANOTIFY
+#include "FanotifySource.hxx"
+#endif
 #include "storage/StorageInterface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
+#include "fs/Charset.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
@@ -34,8 +39,13 @@
 
 #include <assert.h>
 #include <sys/inotify.h>
+#ifdef HAVE_FANOTIFY
+#include <sys/fanotify.h>
+#endif
 #include <sys/stat.h>
 #include <string.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <dirent.h>
 
 static constexpr unsigned IN_MASK =
@@ -289,6 +299,84 @@ mpd_inotify_callback(int wd, unsigned mask,
 	}
 }
 
+#ifdef HAVE_FANOTIFY
+
+static constexpr uint64_t FAN_MASK =
+	FAN_CLOSE_WRITE|FAN_CREATE|FAN_DELETE|FAN_MOVED_FROM|FAN_MOVED_TO|
+	FAN_ONDIR;
+
+static FanotifySource *fanotify_source;
+
+/**
+ * The absolute path of the music directory.
+ */
+static AllocatedPath fanotify_root = AllocatedPath::Null();
+
+static void
+mpd_fanotify_callback(const char *directory_fs, gcc_unused const char *name,
+		      gcc_unused uint64_t mask, gcc_unused void *ctx)
+{
+	if (directory_fs == nullptr) {
+		/* events were lost: update everything */
+		inotify_queue->Enqueue("");
+		return;
+	}
+
+	/* the mark covers the whole file system; ignore everything
+	   outside of the music directory */
+	const char *relative =
+		PathTraitsFS::Relative(fanotify_root.c_str(), directory_fs);
+	if (relative == nullptr)
+		return;
+
+	/* emulate the depth limit of the inotify implementation */
+	unsigned depth = *relative != 0;
+	for (const char *p = relative; *p != 0; ++p)
+		if (*p == '/')
+			++depth;
+
+	if (depth > inotify_max_depth)
+		return;
+
+	const std::string uri_utf8 = PathToUTF8(relative);
+	if (uri_utf8.empty() && *relative != 0)
+		return;
+
+	inotify_queue->Enqueue(uri_utf8.c_str());
+}
+
+/**
+ * Attempt to watch the music directory with fanotify.
+ *
+ * @return false if fanotify is not available (e.g. because MPD is
+ * not privileged), and inotify shall be used instead
+ */
+static bool
+mpd_fanotify_init(EventLoop &loop, const AllocatedPath &path)
+{
+	Error error;
+	fanotify_source = FanotifySource::Create(loop, path.c_str(),
+						 FAN_MASK,
+						 mpd_fanotify_callback,
+						 nullptr, error);
+	if (fanotify_source == nullptr) {
+		FormatDebug(inotify_domain,
+			    "fanotify not available, using inotify: %s",
+			    error.GetMessage());
+		return false;
+	}
+
+	/* compare with the canonical path, because that is what
+	   /proc/self/fd/ reports */
+	char buffer[PATH_MAX];
+	const char *real = realpath(path.c_str(), buffer);
+	fanotify_root = AllocatedPath::FromFS(real != nullptr
+					      ? real : path.c_str());
+	return true;
+}
+
+#endif
+
 void
 mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 		 unsigned max_depth)
@@ -301,6 +389,17 @@ mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 		return;
 	}
 
+	inotify_max_depth = max_depth;
+
+#ifdef HAVE_FANOTIFY
+	if (mpd_fanotify_init(loop, path)) {
+		inotify_queue = new InotifyQueue(loop, update);
+		LogDebug(inotify_domain,
+			 "watching music directory with fanotify");
+		return;
+	}
+#endif
+
 	Error error;
 	inotify_source = InotifySource::Create(loop,
 					       mpd_inotify_callback, nullptr,
@@ -310,8 +409,6 @@ mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 		return;
 	}
 
-	inotify_max_depth = max_depth;
-
 	int descriptor = inotify_source->Add(path.c_str(), IN_MASK, error);
 	if (descriptor < 0) {
 		LogError(error);
@@ -334,6 +431,16 @@ mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 void
 mpd_inotify_finish(void)
 {
+#ifdef HAVE_FANOTIFY
+	if (fanotify_source != nullptr) {
+		delete inotify_queue;
+		delete fanotify_source;
+		fanotify_source = nullptr;
+		fanotify_root = AllocatedPath::Null();
+		return;
+	}
+#endif
+
 	if (inotify_source == nullptr)
 		return;
 
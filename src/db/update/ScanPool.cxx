@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "ScanPool.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/StorageInterface.hxx"
+#include "playlist/plugins/EmbeddedCuePlaylistPlugin.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "thread/Policy.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+inline void
+UpdateScanJob::LoadCueSheet(Storage &storage) const
+{
+	const Song &s = song != nullptr ? *song : *new_song;
+	const bool has_playlist = song != nullptr
+		? tag_builder.HasPlaylist()
+		: s.tag.has_playlist;
+	if (!has_playlist)
+		return;
+
+	/* parse the embedded cue sheet now, while the file is in the
+	   page cache, so clients can list its tracks without
+	   scanning it again */
+	const auto path_fs = storage.MapFS(s.GetURI().c_str());
+	if (!path_fs.IsNull())
+		embcue_playlist_update(path_fs,
+				       song != nullptr ? mtime : s.mtime);
+}
+
+void
+UpdateScanJob::Run(Storage &storage)
+{
+	const uint64_t start = MonotonicClockUS();
+
+	if (song == nullptr) {
+		new_song = Song::LoadFile(storage, name.c_str(), directory);
+		success = new_song != nullptr;
+	} else
+		success = song->ScanFile(storage, tag_builder, mtime,
+					   identity);
+
+	if (success)
+		LoadCueSheet(storage);
+
+	duration_us = MonotonicClockUS() - start;
+}
+
+UpdateScanPool::UpdateScanPool(Storage &_storage, unsigned threads)
+	:storage(_storage), running(0), quit(false), num_workers(0)
+{
+	if (threads <= 1)
+		return;
+
+	threads = std::min(threads, unsigned(MAX_THREADS));
+	while (num_workers < threads) {
+		Worker &w = workers[num_workers];
+		w.pool = this;
+		w.index = num_workers;
+
+		Error error;
+		if (!w.thread.Start(WorkerFunc, &w, error)) {
+			/* continue with the threads we have */
+			LogError(error);
+			break;
+		}
+
+		++num_workers;
+	}
+}
+
+UpdateScanPool::~UpdateScanPool()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < num_workers; ++i)
+		workers[i].thread.Join();
+
+	CancelQueued();
+
+	for (auto *job : finished) {
+		if (job->new_song != nullptr)
+			job->new_song->Free();
+		delete job;
+	}
+}
+
+void
+UpdateScanPool::Push(UpdateScanJob *job)
+{
+	assert(IsEnabled());
+
+	const ScopeLock protect(mutex);
+	queue.push_back(job);
+	cond.signal();
+}
+
+UpdateScanJob *
+UpdateScanPool::Collect(bool all)
+{
+	/* allow a few queued jobs per worker, so they never run dry
+	   while the walk enumerates the next files */
+	const size_t max_queued = num_workers * 2;
+
+	const ScopeLock protect(mutex);
+
+	while (finished.empty()) {
+		if (all
+		    ? queue.empty() && running == 0
+		    : queue.size() < max_queued)
+			return nullptr;
+
+		done_cond.wait(mutex);
+	}
+
+	UpdateScanJob *job = finished.front();
+	finished.pop_front();
+	return job;
+}
+
+void
+UpdateScanPool::CancelQueued()
+{
+	const ScopeLock protect(mutex);
+
+	for (auto *job : queue)
+		delete job;
+	queue.clear();
+}
+
+inline void
+UpdateScanPool::WorkerRun(Worker &w)
+{
+	FormatThreadName("update:%u", w.index);
+	SetThreadIdlePriority();
+
+	Error policy_error;
+	if (!ApplyThreadPolicy(ThreadClass::UPDATE, policy_error))
+		LogError(policy_error);
+
+	mutex.lock();
+
+	while (!quit) {
+		if (queue.empty()) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		UpdateScanJob *job = queue.front();
+		queue.pop_front();
+		++running;
+
+		mutex.unlock();
+		job->Run(storage);
+		mutex.lock();
+
+		--running;
+		finished.push_back(job);
+		done_cond.signal();
+	}
+
+	mutex.unlock();
+}
+
+void
+UpdateScanPool::WorkerFunc(void *ctx)
+{
+	Worker &w = *(Worker *)ctx;
+	w.pool->WorkerRun(w);
+}
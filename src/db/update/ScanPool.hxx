@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_SCAN_POOL_HXX
+#define MPD_UPDATE_SCAN_POOL_HXX
+
+#include "check.h"
+#include "db/plugins/simple/Song.hxx"
+#include "tag/TagBuilder.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <list>
+#include <string>
+
+#include <stdint.h>
+#include <time.h>
+
+struct Directory;
+class Storage;
+
+/**
+ * A request to read the tags of one song file.  It is filled by
+ * UpdateScanJob::Run(), which does not touch the database; the
+ * #UpdateWalk applies the result afterwards.
+ */
+struct UpdateScanJob {
+	Directory &directory;
+
+	const std::string name;
+
+	/**
+	 * The existing song which shall be updated, or nullptr if a
+	 * new one shall be loaded.
+	 */
+	Song *const song;
+
+	/**
+	 * The new song (only if #song is nullptr), or nullptr if the
+	 * file was not recognized.
+	 */
+	Song *new_song;
+
+	/**
+	 * The new tag, modification time and identity of #song.
+	 */
+	TagBuilder tag_builder;
+	time_t mtime;
+	SongIdentity identity;
+
+	bool success;
+
+	/**
+	 * How long Run() took [us].
+	 */
+	uint64_t duration_us;
+
+	UpdateScanJob(Directory &_directory, const char *_name, Song *_song)
+		:directory(_directory), name(_name), song(_song),
+		 new_song(nullptr), success(false), duration_us(0) {}
+
+	UpdateScanJob(const UpdateScanJob &) = delete;
+	UpdateScanJob &operator=(const UpdateScanJob &) = delete;
+
+	void Run(Storage &storage);
+
+private:
+	/**
+	 * Fill #embcue_cache if the file has an embedded cue sheet.
+	 */
+	void LoadCueSheet(Storage &storage) const;
+};
+
+/**
+ * A pool of threads which run #UpdateScanJob instances for the
+ * #UpdateWalk, so the latency of reading many files overlaps.
+ */
+class UpdateScanPool {
+	static constexpr unsigned MAX_THREADS = 16;
+
+	struct Worker {
+		UpdateScanPool *pool;
+		unsigned index;
+		Thread thread;
+	};
+
+	Storage &storage;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a job was queued, or when the workers shall
+	 * quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a job has finished.
+	 */
+	Cond done_cond;
+
+	std::list<UpdateScanJob *> queue, finished;
+
+	/**
+	 * The number of jobs being run by a worker right now.
+	 */
+	unsigned running;
+
+	bool quit;
+
+	Worker workers[MAX_THREADS];
+	unsigned num_workers;
+
+public:
+	/**
+	 * @param threads the number of worker threads; 0 or 1 disables
+	 * the pool
+	 */
+	UpdateScanPool(Storage &_storage, unsigned threads);
+	~UpdateScanPool();
+
+	UpdateScanPool(const UpdateScanPool &) = delete;
+	UpdateScanPool &operator=(const UpdateScanPool &) = delete;
+
+	/**
+	 * If this returns false, then the caller shall invoke
+	 * UpdateScanJob::Run() itself.
+	 */
+	bool IsEnabled() const {
+		return num_workers > 0;
+	}
+
+	/**
+	 * Queue a job.  The pool takes over responsibility for it
+	 * until it is returned by Collect().
+	 */
+	void Push(UpdateScanJob *job);
+
+	/**
+	 * Return a job which has finished, and pass responsibility
+	 * for it to the caller.
+	 *
+	 * @param all if true, then wait until all jobs have finished;
+	 * if false, wait only while the queue is full
+	 * @return a finished job, or nullptr if there is none (yet)
+	 */
+	UpdateScanJob *Collect(bool all);
+
+	/**
+	 * Discard all jobs which have not been started yet.
+	 */
+	void CancelQueued();
+
+private:
+	void WorkerRun(Worker &w);
+	static void WorkerFunc(void *ctx);
+};
+
+#endif
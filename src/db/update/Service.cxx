@@ -26,6 +26,8 @@
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "storage/CompositeStorage.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
 #include "Idle.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
@@ -34,6 +36,12 @@
 #include "thread/Id.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Util.hxx"
+#include "thread/Policy.hxx"
+
+#ifdef ENABLE_SQLITE
+#include "AnalysisPool.hxx"
+#include "sticker/StickerDatabase.hxx"
+#endif
 
 #ifndef NDEBUG
 #include "event/Loop.hxx"
@@ -51,6 +59,11 @@ UpdateService::UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 	 update_task_id(0),
 	 walk(nullptr)
 {
+#ifdef ENABLE_SQLITE
+	analysis_threads =
+		config_get_unsigned(CONF_LOUDNESS_ANALYSIS_THREADS, 0);
+	analysis = nullptr;
+#endif
 }
 
 UpdateService::~UpdateService()
@@ -61,6 +74,10 @@ UpdateService::~UpdateService()
 		update_thread.Join();
 
 	delete walk;
+
+#ifdef ENABLE_SQLITE
+	delete analysis;
+#endif
 }
 
 void
@@ -80,9 +97,9 @@ UpdateService::CancelMount(const char *uri)
 	/* determine which (mounted) database will be updated and what
 	   storage will be scanned */
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(uri);
-	db_unlock();
+	db_unlock_shared();
 
 	if (!lr.directory->IsMount())
 		return;
@@ -123,12 +140,16 @@ UpdateService::Task()
 
 	SetThreadIdlePriority();
 
+	Error policy_error;
+	if (!ApplyThreadPolicy(ThreadClass::UPDATE, policy_error))
+		LogError(policy_error);
+
 	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
 			      next.discard);
 
 	if (modified || !next.db->FileExists()) {
 		Error error;
-		if (!next.db->Save(error))
+		if (!next.db->Save(next.path_utf8.c_str(), error))
 			LogError(error, "Failed to save database");
 	}
 
@@ -159,7 +180,18 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	modified = false;
 
 	next = std::move(i);
-	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage);
+
+	/* only songs of the root database are analyzed, because
+	   the URIs of a mounted database are relative to its mount
+	   point */
+	LoudnessAnalysisPool *analysis_pool = nullptr;
+#ifdef ENABLE_SQLITE
+	if (next.db == &db)
+		analysis_pool = GetAnalysisPool();
+#endif
+
+	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage,
+			      analysis_pool);
 
 	Error error;
 	if (!update_thread.Start(Task, this, error))
@@ -169,6 +201,28 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 		    "spawned thread for update job id %i", next.id);
 }
 
+#ifdef ENABLE_SQLITE
+
+LoudnessAnalysisPool *
+UpdateService::GetAnalysisPool()
+{
+	if (analysis == nullptr && analysis_threads > 0) {
+		if (!sticker_enabled()) {
+			LogWarning(update_domain,
+				   "loudness analysis requires a sticker_file");
+			analysis_threads = 0;
+			return nullptr;
+		}
+
+		analysis = new LoudnessAnalysisPool(storage,
+						    analysis_threads);
+	}
+
+	return analysis;
+}
+
+#endif
+
 unsigned
 UpdateService::GenerateId()
 {
@@ -188,9 +242,9 @@ UpdateService::Enqueue(const char *path, bool discard)
 	SimpleDatabase *db2;
 	Storage *storage2;
 
-	db_lock();
+	db_lock_shared();
 	const auto lr = db.GetRoot().LookupDirectory(path);
-	db_unlock();
+	db_unlock_shared();
 	if (lr.directory->IsMount()) {
 		/* follow the mountpoint, update the mounted
 		   database */
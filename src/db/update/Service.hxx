@@ -29,6 +29,7 @@ class SimpleDatabase;
 class DatabaseListener;
 class UpdateWalk;
 class CompositeStorage;
+class LoudnessAnalysisPool;
 
 /**
  * This class manages the update queue and runs the update thread.
@@ -61,6 +62,20 @@ class UpdateService final : DeferredMonitor {
 
 	UpdateWalk *walk;
 
+#ifdef ENABLE_SQLITE
+	/**
+	 * The number of loudness analysis threads; 0 if the analysis
+	 * is disabled.
+	 */
+	unsigned analysis_threads;
+
+	/**
+	 * Created by GetAnalysisPool() on demand, because the sticker
+	 * database is initialized after this object.
+	 */
+	LoudnessAnalysisPool *analysis;
+#endif
+
 public:
 	UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 		      CompositeStorage &_storage,
@@ -110,6 +125,10 @@ private:
 	void StartThread(UpdateQueueItem &&i);
 
 	unsigned GenerateId();
+
+#ifdef ENABLE_SQLITE
+	LoudnessAnalysisPool *GetAnalysisPool();
+#endif
 };
 
 #endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Throttle.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "system/Clock.hxx"
+#include "Metrics.hxx"
+
+#include <algorithm>
+
+#include <unistd.h>
+
+/**
+ * The granularity of sleeping, so cancellation is not delayed.
+ */
+static constexpr unsigned SLEEP_STEP_US = 50000;
+
+/**
+ * The maximum time to pause for one file while the pipe is low.
+ * The player may stay below the threshold for a long time (e.g. with
+ * a slow stream), and the update shall not stall completely.
+ */
+static constexpr uint64_t MAX_BACK_OFF_US = 2000000;
+
+UpdateThrottle::UpdateThrottle()
+	:next_us(0)
+{
+	const unsigned max_rate = config_get_unsigned(CONF_UPDATE_MAX_RATE,
+						      0);
+	interval_us = max_rate > 0 ? 1000000 / max_rate : 0;
+
+	back_off = config_get_bool(CONF_UPDATE_BACK_OFF, true);
+}
+
+void
+UpdateThrottle::Wait(const volatile bool &cancel)
+{
+	uint64_t now = MonotonicClockUS();
+
+	if (back_off) {
+		const uint64_t until = now + MAX_BACK_OFF_US;
+		while (metric_pipe_low.Get() != 0 && !cancel &&
+		       now < until) {
+			usleep(SLEEP_STEP_US);
+			now = MonotonicClockUS();
+		}
+	}
+
+	if (interval_us == 0)
+		return;
+
+	while (now < next_us && !cancel) {
+		const uint64_t remaining = next_us - now;
+		usleep(remaining < SLEEP_STEP_US
+		       ? unsigned(remaining) : SLEEP_STEP_US);
+		now = MonotonicClockUS();
+	}
+
+	/* don't let an idle period accumulate a burst */
+	next_us = std::max(next_us, now) + interval_us;
+}
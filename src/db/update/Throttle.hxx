@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_THROTTLE_HXX
+#define MPD_UPDATE_THROTTLE_HXX
+
+#include "check.h"
+
+#include <stdint.h>
+
+/**
+ * Limits the rate at which #UpdateWalk scans song files, so a large
+ * update does not compete with playback for the disk.  It enforces
+ * the "update_max_rate" setting (files per second), and it backs off
+ * while the player's pipe is running low (see #metric_pipe_low).
+ *
+ * This class is only used by the update thread.
+ */
+class UpdateThrottle {
+	/**
+	 * The minimum interval between two files [us]; 0 means no
+	 * limit.
+	 */
+	uint64_t interval_us;
+
+	/**
+	 * Pause while the player's pipe is running low?
+	 */
+	bool back_off;
+
+	/**
+	 * When the next file may be scanned [MonotonicClockUS()].
+	 */
+	uint64_t next_us;
+
+public:
+	UpdateThrottle();
+
+	bool IsEnabled() const {
+		return interval_us > 0 || back_off;
+	}
+
+	/**
+	 * Wait until the next file may be scanned.  Returns early if
+	 * the given flag becomes true.
+	 */
+	void Wait(const volatile bool &cancel);
+};
+
+#endif
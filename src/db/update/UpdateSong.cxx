@@ -24,10 +24,16 @@
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
+#include "ScanPool.hxx"
 #include "decoder/DecoderList.hxx"
 #include "storage/FileInfo.hxx"
+#include "util/UriUtil.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_SQLITE
+#include "AnalysisPool.hxx"
+#endif
+
 #include <unistd.h>
 
 inline void
@@ -35,9 +41,9 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 			    const char *name, const char *suffix,
 			    const FileInfo &info)
 {
-	db_lock();
+	db_lock_shared();
 	Song *song = directory.FindSong(name);
-	db_unlock();
+	db_unlock_shared();
 
 	if (!directory_child_access(storage, directory, name, R_OK)) {
 		FormatError(update_domain,
@@ -49,6 +55,10 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 		return;
 	}
 
+	if (song == nullptr && !walk_discard &&
+	    AddMovedSong(directory, name, info))
+		return;
+
 	if (!(song != nullptr && info.mtime == song->mtime &&
 	      !walk_discard) &&
 	    UpdateContainerFile(directory, name, suffix, info)) {
@@ -61,7 +71,89 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 	if (song == nullptr) {
 		FormatDebug(update_domain, "reading %s/%s",
 			    directory.GetPath(), name);
-		song = Song::LoadFile(storage, name, directory);
+		ScanSongFile(directory, name, nullptr);
+	} else if (info.mtime != song->mtime || walk_discard) {
+		FormatDefault(update_domain, "updating %s/%s",
+			      directory.GetPath(), name);
+		ScanSongFile(directory, name, song);
+	} else if (!song->identity.IsDefined() && info.inode != 0) {
+		/* loaded from an old database: remember the identity
+		   now, so a later move can be detected */
+		db_lock();
+		song->identity = SongIdentity(info.size, info.device,
+					      info.inode);
+		db_unlock();
+		modified = true;
+	}
+}
+
+bool
+UpdateWalk::AddMovedSong(Directory &directory, const char *name,
+			 const FileInfo &info)
+{
+	const SongIdentity identity(info.size, info.device, info.inode);
+	const Tag *tag = identity_cache.Lookup(identity, info.mtime);
+	if (tag == nullptr)
+		return false;
+
+	Song *song = Song::NewFile(name, directory);
+	song->mtime = info.mtime;
+	song->identity = identity;
+	song->tag = Tag(*tag);
+
+	db_lock();
+	directory.AddSong(song);
+	db_unlock();
+
+	modified = true;
+	FormatDefault(update_domain, "added %s/%s (moved)",
+		      directory.GetPath(), name);
+	return true;
+}
+
+void
+UpdateWalk::ScanSongFile(Directory &directory, const char *name,
+			 Song *song)
+{
+	if (throttle.IsEnabled())
+		throttle.Wait(cancel);
+
+	UpdateScanJob *job = new UpdateScanJob(directory, name, song);
+
+	if (!scan_pool.IsEnabled()) {
+		job->Run(storage);
+		ApplyScan(*job);
+		delete job;
+		return;
+	}
+
+	scan_pool.Push(job);
+	FlushScans(false);
+}
+
+void
+UpdateScanProfile::Add(const UpdateScanJob &job)
+{
+	const char *suffix = uri_get_suffix(job.name.c_str());
+
+	Entry &entry = suffixes[suffix != nullptr ? suffix : ""];
+	++entry.files;
+	if (!job.success)
+		++entry.failed;
+	entry.duration_us += job.duration_us;
+}
+
+void
+UpdateWalk::ApplyScan(UpdateScanJob &job)
+{
+	Directory &directory = job.directory;
+	const char *name = job.name.c_str();
+
+	if (profile != nullptr)
+		profile->Add(job);
+
+	if (job.song == nullptr) {
+		Song *song = job.new_song;
 		if (song == nullptr) {
 			FormatDebug(update_domain,
 				    "ignoring unrecognized file %s/%s",
@@ -76,17 +168,52 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 		modified = true;
 		FormatDefault(update_domain, "added %s/%s",
 			      directory.GetPath(), name);
-	} else if (info.mtime != song->mtime || walk_discard) {
-		FormatDefault(update_domain, "updating %s/%s",
-			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
+	} else {
+		if (job.success)
+			editor.LockUpdateSong(directory, *job.song,
+					      job.tag_builder, job.mtime,
+					      job.identity);
+		else {
 			FormatDebug(update_domain,
 				    "deleting unrecognized file %s/%s",
 				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
+			editor.LockDeleteSong(directory, job.song);
 		}
 
 		modified = true;
+
+		if (!job.success)
+			return;
+	}
+
+#ifdef ENABLE_SQLITE
+	if (analysis != nullptr && analysis->IsEnabled()) {
+		const char *path = directory.GetPath();
+		std::string uri;
+		if (*path != 0) {
+			uri = path;
+			uri.push_back('/');
+		}
+
+		uri.append(name);
+		analysis->Push(std::move(uri));
+	}
+#endif
+}
+
+void
+UpdateWalk::FlushScans(bool all)
+{
+	if (!scan_pool.IsEnabled())
+		return;
+
+	if (all && cancel)
+		scan_pool.CancelQueued();
+
+	UpdateScanJob *job;
+	while ((job = scan_pool.Collect(all)) != nullptr) {
+		ApplyScan(*job);
+		delete job;
 	}
 }
 
@@ -49,11 +49,27 @@
 #include <errno.h>
 #include <memory>
 
+/**
+ * How many threads shall read tags?  Only files on the local file
+ * system are read in parallel, because the remote storage plugins
+ * are not thread-safe.
+ */
+static unsigned
+GetScanThreads(const Storage &storage)
+{
+	if (storage.MapFS("").IsNull())
+		return 1;
+
+	return config_get_positive(CONF_UPDATE_THREADS, 1);
+}
+
 UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage)
+		       Storage &_storage, LoudnessAnalysisPool *_analysis)
 	:cancel(false),
 	 storage(_storage),
-	 editor(_loop, _listener)
+	 editor(_loop, _listener, identity_cache),
+	 scan_pool(_storage, GetScanThreads(_storage)),
+	 analysis(_analysis), profile(nullptr)
 {
 #ifndef WIN32
 	follow_inside_symlinks =
@@ -64,6 +80,8 @@ UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
 		config_get_bool(CONF_FOLLOW_OUTSIDE_SYMLINKS,
 				DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
 #endif
+
+	trust_mtime = config_get_bool(CONF_UPDATE_TRUST_MTIME, false);
 }
 
 static void
@@ -219,6 +237,7 @@ UpdateWalk::UpdateRegularFile(Directory &directory,
 
 void
 UpdateWalk::UpdateDirectoryChild(Directory &directory,
+				 const ExcludeList &exclude_list,
 				 const char *name, const FileInfo &info)
 {
 	assert(strchr(name, '/') == nullptr);
@@ -236,7 +255,7 @@ UpdateWalk::UpdateDirectoryChild(Directory &directory,
 
 		assert(&directory == subdir->parent);
 
-		if (!UpdateDirectory(*subdir, info))
+		if (!UpdateDirectory(*subdir, exclude_list, info))
 			editor.LockDeleteDirectory(subdir);
 	} else {
 		FormatDebug(update_domain,
@@ -326,21 +345,40 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 #endif
 }
 
+void
+UpdateWalk::UpdateUnmodifiedDirectory(Directory &directory,
+				      const ExcludeList &exclude_list)
+{
+	directory.ForEachChildSafe([this, &exclude_list](Directory &child){
+			if (cancel || child.IsMount() ||
+			    child.device == DEVICE_INARCHIVE ||
+			    child.device == DEVICE_CONTAINER)
+				/* archives and containers are files,
+				   and since the list of files is
+				   assumed to be unchanged, so are
+				   they */
+				return;
+
+			FileInfo info;
+			if (!GetInfo(storage, child.GetPath(), info) ||
+			    !info.IsDirectory() ||
+			    !UpdateDirectory(child, exclude_list, info)) {
+				editor.LockDeleteDirectory(&child);
+				modified = true;
+			}
+		});
+}
+
 bool
-UpdateWalk::UpdateDirectory(Directory &directory, const FileInfo &info)
+UpdateWalk::UpdateDirectory(Directory &directory,
+			    const ExcludeList &parent_exclude_list,
+			    const FileInfo &info)
 {
 	assert(info.IsDirectory());
 
 	directory_set_stat(directory, info);
 
-	Error error;
-	const std::auto_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(directory.GetPath(), error));
-	if (reader.get() == nullptr) {
-		LogError(error);
-		return false;
-	}
-
-	ExcludeList exclude_list;
+	ExcludeList exclude_list(parent_exclude_list);
 
 	{
 		const auto exclude_path_fs =
@@ -349,6 +387,19 @@ UpdateWalk::UpdateDirectory(Directory &directory, const FileInfo &info)
 			exclude_list.LoadFile(exclude_path_fs);
 	}
 
+	if (trust_mtime && !walk_discard && directory.mtime != 0 &&
+	    directory.mtime == info.mtime) {
+		UpdateUnmodifiedDirectory(directory, exclude_list);
+		return true;
+	}
+
+	Error error;
+	const std::auto_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(directory.GetPath(), error));
+	if (reader.get() == nullptr) {
+		LogError(error);
+		return false;
+	}
+
 	if (!exclude_list.IsEmpty())
 		RemoveExcludedFromDirectory(directory, exclude_list);
 
@@ -376,9 +427,14 @@ UpdateWalk::UpdateDirectory(Directory &directory, const FileInfo &info)
 			continue;
 		}
 
-		UpdateDirectoryChild(directory, name_utf8, info2);
+		UpdateDirectoryChild(directory, exclude_list,
+				     name_utf8, info2);
 	}
 
+	/* the songs of this directory must be complete before the
+	   caller may delete it */
+	FlushScans(true);
+
 	directory.mtime = info.mtime;
 
 	return true;
@@ -389,9 +445,9 @@ UpdateWalk::DirectoryMakeChildChecked(Directory &parent,
 				      const char *uri_utf8,
 				      const char *name_utf8)
 {
-	db_lock();
+	db_lock_shared();
 	Directory *directory = parent.FindChild(name_utf8);
-	db_unlock();
+	db_unlock_shared();
 
 	if (directory != nullptr) {
 		if (directory->IsMount())
@@ -468,7 +524,10 @@ UpdateWalk::UpdateUri(Directory &root, const char *uri)
 		return;
 	}
 
-	UpdateDirectoryChild(*parent, name, info);
+	/* the .mpdignore files of the ancestors are not loaded
+	   here */
+	const ExcludeList exclude_list;
+	UpdateDirectoryChild(*parent, exclude_list, name, info);
 }
 
 bool
@@ -477,6 +536,8 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 	walk_discard = discard;
 	modified = false;
 
+	identity_cache.SetRoot(root);
+
 	if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
 	} else {
@@ -484,8 +545,11 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 		if (!GetInfo(storage, "", info))
 			return false;
 
-		UpdateDirectory(root, info);
+		const ExcludeList exclude_list;
+		UpdateDirectory(root, exclude_list, info);
 	}
 
+	FlushScans(true);
+
 	return modified;
 }
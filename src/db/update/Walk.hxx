@@ -22,8 +22,15 @@
 
 #include "check.h"
 #include "Editor.hxx"
+#include "IdentityCache.hxx"
+#include "ScanPool.hxx"
+#include "Throttle.hxx"
+
+#include <map>
+#include <string>
 
 #include <sys/stat.h>
+#include <stdint.h>
 
 struct stat;
 struct FileInfo;
@@ -31,6 +38,26 @@ struct Directory;
 struct ArchivePlugin;
 class Storage;
 class ExcludeList;
+class LoudnessAnalysisPool;
+
+/**
+ * Tag scanning statistics per file name suffix, collected by
+ * #UpdateWalk if enabled with UpdateWalk::SetProfile().
+ */
+struct UpdateScanProfile {
+	struct Entry {
+		unsigned files = 0, failed = 0;
+
+		/**
+		 * The sum of UpdateScanJob::duration_us.
+		 */
+		uint64_t duration_us = 0;
+	};
+
+	std::map<std::string, Entry> suffixes;
+
+	void Add(const UpdateScanJob &job);
+};
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
@@ -45,6 +72,12 @@ class UpdateWalk final {
 	bool follow_outside_symlinks;
 #endif
 
+	/**
+	 * Skip reading directories whose mtime has not changed?  See
+	 * UpdateUnmodifiedDirectory().
+	 */
+	bool trust_mtime;
+
 	bool walk_discard;
 	bool modified;
 
@@ -57,11 +90,37 @@ class UpdateWalk final {
 
 	Storage &storage;
 
+	/**
+	 * Must be declared before #editor, which refers to it.
+	 */
+	UpdateIdentityCache identity_cache;
+
 	DatabaseEditor editor;
 
+	UpdateScanPool scan_pool;
+
+	UpdateThrottle throttle;
+
+	/**
+	 * New and modified songs are queued here, or nullptr if the
+	 * loudness analysis is disabled.
+	 */
+	LoudnessAnalysisPool *const analysis;
+
+	UpdateScanProfile *profile;
+
 public:
 	UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage);
+		   Storage &_storage, LoudnessAnalysisPool *_analysis);
+
+	/**
+	 * Collect tag scanning statistics in the specified object
+	 * (nullptr disables this).  It is only accessed by the thread
+	 * which calls Walk().
+	 */
+	void SetProfile(UpdateScanProfile *_profile) {
+		profile = _profile;
+	}
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -90,6 +149,31 @@ private:
 			     const char *name, const char *suffix,
 			     const FileInfo &info);
 
+	/**
+	 * Add a new song with the tag of a known song whose file has
+	 * the same identity, i.e. a file which was moved or renamed.
+	 *
+	 * @return false if no such song is known
+	 */
+	bool AddMovedSong(Directory &directory, const char *name,
+			  const FileInfo &info);
+
+	/**
+	 * Read the tags of a new (song==nullptr) or modified song,
+	 * possibly in the #scan_pool.
+	 */
+	void ScanSongFile(Directory &directory, const char *name,
+			  Song *song);
+
+	void ApplyScan(UpdateScanJob &job);
+
+	/**
+	 * Apply the results of finished #scan_pool jobs.
+	 *
+	 * @param all wait for all jobs to finish?
+	 */
+	void FlushScans(bool all);
+
 	bool UpdateSongFile(Directory &directory,
 			    const char *name, const char *suffix,
 			    const FileInfo &info);
@@ -127,10 +211,30 @@ private:
 	bool UpdateRegularFile(Directory &directory,
 			       const char *name, const FileInfo &info);
 
+	/**
+	 * @param exclude_list the patterns of the .mpdignore files of
+	 * this directory and its ancestors
+	 */
 	void UpdateDirectoryChild(Directory &directory,
+				  const ExcludeList &exclude_list,
 				  const char *name, const FileInfo &info);
 
-	bool UpdateDirectory(Directory &directory, const FileInfo &info);
+	/**
+	 * Update a directory whose mtime has not changed since the
+	 * last update, without reading it: its list of entries is
+	 * assumed to be unchanged, and only the known subdirectories
+	 * are checked recursively.
+	 */
+	void UpdateUnmodifiedDirectory(Directory &directory,
+				       const ExcludeList &exclude_list);
+
+	/**
+	 * @param exclude_list the patterns of the .mpdignore files of
+	 * the ancestors of this directory
+	 */
+	bool UpdateDirectory(Directory &directory,
+			     const ExcludeList &exclude_list,
+			     const FileInfo &info);
 
 	/**
 	 * Create the specified directory object if it does not exist
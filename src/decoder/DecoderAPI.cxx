@@ -28,15 +28,99 @@
 #include "MusicPipe.hxx"
 #include "DecoderControl.hxx"
 #include "DecoderInternal.hxx"
+#include "DecoderCache.hxx"
 #include "DetachedSong.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_SYNTH_CACHE
+#include "SynthCache.hxx"
+#endif
+
+#ifdef ENABLE_SQLITE
+#include "sticker/StickerDatabase.hxx"
+#include "sticker/LoudnessSticker.hxx"
+#endif
+
 #include <assert.h>
 #include <string.h>
 #include <math.h>
 
+#ifdef ENABLE_SQLITE
+
+/**
+ * Use the results of the loudness analysis (see
+ * db/update/AnalysisPool.hxx) if the decoder plugin has not found
+ * ReplayGain or MixRamp tags.  Tags which the plugin reports later
+ * override these values.
+ */
+static void
+decoder_load_loudness_sticker(Decoder &decoder)
+{
+	DecoderControl &dc = decoder.dc;
+
+	const bool need_replay_gain = decoder.replay_gain_serial == 0;
+	const bool need_mix_ramp = dc.GetMixRampStart() == nullptr &&
+		dc.GetMixRampEnd() == nullptr;
+	if ((!need_replay_gain && !need_mix_ramp) ||
+	    !sticker_enabled() || !dc.song->IsInDatabase())
+		return;
+
+	ReplayGainInfo rgi;
+	MixRampInfo mix_ramp;
+	if (sticker_song_load_loudness(dc.song->GetURI(), rgi, mix_ramp) &&
+	    need_replay_gain) {
+		rgi.Complete();
+		decoder_replay_gain(decoder, &rgi);
+	}
+
+	if (need_mix_ramp && mix_ramp.IsDefined())
+		decoder_mixramp(decoder, std::move(mix_ramp));
+}
+
+#endif
+
+#ifdef ENABLE_SYNTH_CACHE
+
+/**
+ * Stop writing the rendered song to the #SynthCacheWriter, e.g. after
+ * a seek.
+ */
+static void
+decoder_synth_cache_discard(Decoder &decoder)
+{
+	delete decoder.synth_cache;
+	decoder.synth_cache = nullptr;
+}
+
+#endif
+
+/**
+ * Stop recording the song for the #DecoderCache, e.g. after a seek.
+ */
+static void
+decoder_cache_discard(Decoder &decoder)
+{
+	delete decoder.decoded_song;
+	decoder.decoded_song = nullptr;
+}
+
+/**
+ * Append decoded (and converted) PCM data to the song being recorded
+ * for the #DecoderCache.
+ */
+static void
+decoder_cache_append(Decoder &decoder, const void *data, size_t length)
+{
+	if (decoder.decoded_song != nullptr &&
+	    !decoder.decoded_song->Append(data, length))
+		/* longer than announced: don't cache it */
+		decoder_cache_discard(decoder);
+}
+
 void
 decoder_initialized(Decoder &decoder,
 		    const AudioFormat audio_format,
@@ -78,8 +162,30 @@ decoder_initialized(Decoder &decoder,
 			decoder.error = std::move(error);
 	}
 
+#ifdef ENABLE_SQLITE
+	decoder_load_loudness_sticker(decoder);
+#endif
+
+#ifdef ENABLE_SYNTH_CACHE
+	if (decoder.synth_cache != nullptr) {
+		Error error;
+		if (!decoder.synth_cache->Open(audio_format, error)) {
+			LogError(error);
+			decoder_synth_cache_discard(decoder);
+		}
+	}
+#endif
+
+	if (decoder.cacheable && !decoder.error.IsDefined()) {
+		assert(decoder_cache != nullptr);
+		assert(decoder.decoded_song == nullptr);
+
+		decoder.decoded_song =
+			decoder_cache->Start(dc.out_audio_format, total_time);
+	}
+
 	dc.Lock();
-	dc.state = DecoderState::DECODE;
+	dc.SetState(DecoderState::DECODE);
 	dc.client_cond.signal();
 	dc.Unlock();
 }
@@ -143,6 +249,11 @@ decoder_get_virtual_command(Decoder &decoder)
 		/* an error has occurred: stop the decoder plugin */
 		return DecoderCommand::STOP;
 
+	if (decoder.range_finished)
+		/* the song range is over, and the pending command
+		   is meant for the decoder thread */
+		return DecoderCommand::STOP;
+
 	const DecoderControl &dc = decoder.dc;
 	assert(dc.pipe != nullptr);
 
@@ -163,6 +274,16 @@ decoder_command_finished(Decoder &decoder)
 {
 	DecoderControl &dc = decoder.dc;
 
+#ifdef ENABLE_SYNTH_CACHE
+	/* the plugin has seeked, but the cache file must be
+	   rendered linearly */
+	if (decoder.initial_seek_running || decoder.seeking)
+		decoder_synth_cache_discard(decoder);
+#endif
+
+	if (decoder.initial_seek_running || decoder.seeking)
+		decoder_cache_discard(decoder);
+
 	dc.Lock();
 
 	assert(dc.command != DecoderCommand::NONE ||
@@ -189,7 +310,7 @@ decoder_command_finished(Decoder &decoder)
 		/* delete frames from the old song position */
 
 		if (decoder.chunk != nullptr) {
-			dc.buffer->Return(decoder.chunk);
+			decoder.chunk_cache.Return(decoder.chunk);
 			decoder.chunk = nullptr;
 		}
 
@@ -283,6 +404,9 @@ decoder_check_cancel_read(const Decoder *decoder)
 	if (decoder == nullptr)
 		return false;
 
+	if (decoder->range_finished)
+		return true;
+
 	const DecoderControl &dc = decoder->dc;
 	if (dc.command == DecoderCommand::NONE)
 		return false;
@@ -338,6 +462,42 @@ decoder_read(Decoder *decoder,
 	return nbytes;
 }
 
+ConstBuffer<void>
+decoder_read_direct(Decoder &decoder, InputStream &is, size_t length)
+{
+	assert(decoder.dc.state == DecoderState::START ||
+	       decoder.dc.state == DecoderState::DECODE);
+
+	is.Lock();
+
+	while (true) {
+		if (decoder_check_cancel_read(&decoder)) {
+			is.Unlock();
+
+			/* an empty (but not "null") buffer, so the
+			   caller handles the command instead of falling
+			   back to decoder_read() */
+			static constexpr uint8_t dummy = 0;
+			return { &dummy, 0 };
+		}
+
+		if (is.IsAvailable())
+			break;
+
+		is.cond.wait(is.mutex);
+	}
+
+	Error error;
+	const auto result = is.ReadDirect(length, error);
+
+	is.Unlock();
+
+	if (gcc_unlikely(error.IsDefined()))
+		LogError(error);
+
+	return result;
+}
+
 bool
 decoder_read_full(Decoder *decoder, InputStream &is,
 		  void *_buffer, size_t size)
@@ -430,6 +590,154 @@ update_stream_tag(Decoder &decoder, InputStream *is)
 	return true;
 }
 
+/**
+ * Send a new stream tag (or the song tag) to the music pipe, merged
+ * with the tag from the decoder plugin.
+ */
+static DecoderCommand
+send_stream_tag(Decoder &decoder, InputStream *is)
+{
+	if (!update_stream_tag(decoder, is))
+		return DecoderCommand::NONE;
+
+	if (decoder.decoder_tag != nullptr) {
+		/* merge with tag from decoder plugin */
+		Tag *tag = Tag::Merge(*decoder.decoder_tag,
+				      *decoder.stream_tag);
+		DecoderCommand cmd = do_send_tag(decoder, *tag);
+		delete tag;
+		return cmd;
+	} else
+		/* send only the stream tag */
+		return do_send_tag(decoder, *decoder.stream_tag);
+}
+
+/**
+ * The common part of decoder_data() and decoder_commit_data(): check
+ * for a command, open the next song if it is due, and send stream
+ * tags.
+ *
+ * @param data_pending will data be submitted after this call?
+ */
+static DecoderCommand
+decoder_prepare_data(Decoder &decoder, InputStream *is, bool data_pending)
+{
+	DecoderControl &dc = decoder.dc;
+
+	dc.Lock();
+	DecoderCommand cmd = decoder_get_virtual_command(decoder);
+	const bool prefetch = cmd == DecoderCommand::NONE &&
+		dc.IsPrefetchDue(decoder.timestamp);
+	dc.Unlock();
+
+	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK ||
+	    !data_pending)
+		return cmd;
+
+	if (prefetch)
+		/* the end of this song is near: open the next one
+		   now, while the pipe is still full */
+		decoder_prefetch(dc);
+
+	/* send stream tags */
+
+	return send_stream_tag(decoder, is);
+}
+
+/**
+ * Advance the time stamp after data has been submitted.
+ *
+ * @return true if the end of the song range has been reached
+ */
+static bool
+decoder_advance(Decoder &decoder, size_t nbytes)
+{
+	const DecoderControl &dc = decoder.dc;
+
+	decoder.timestamp += (double)nbytes /
+		dc.out_audio_format.GetTimeToSize();
+
+	return dc.end_ms > 0 && decoder.timestamp >= dc.end_ms / 1000.0;
+}
+
+/**
+ * The end of the song range has been reached.  If the player has
+ * announced that the next song starts right here in the same file
+ * (the next track of a CUE sheet), wait until it starts that song,
+ * and continue decoding into it without reopening the file; the new
+ * song only gets its tag.
+ *
+ * Caller must not lock the #DecoderControl object.
+ *
+ * @return true if decoding continues with the next song, false if
+ * the plugin shall stop
+ */
+static bool
+decoder_continue_range(Decoder &decoder)
+{
+	DecoderControl &dc = decoder.dc;
+
+	dc.Lock();
+	const bool continuation = dc.IsPrefetchContinuation();
+	dc.Unlock();
+
+	if (!continuation)
+		return false;
+
+	/* finish this song like decoder_run_song() does, so the
+	   player can switch to the next one as usual */
+
+	if (decoder.chunk != nullptr)
+		decoder.FlushChunk();
+
+	decoder.chunk_cache.Flush();
+
+	dc.Lock();
+
+	const std::string uri = dc.song->GetRealURI();
+	const unsigned end_ms = dc.end_ms;
+
+	dc.SetState(DecoderState::STOP);
+	dc.client_cond.signal();
+
+	while (dc.command == DecoderCommand::NONE &&
+	       dc.prefetch_song != nullptr)
+		dc.Wait();
+
+	if (dc.command != DecoderCommand::START ||
+	    dc.start_ms != end_ms || dc.song->GetStartMS() != end_ms ||
+	    uri != dc.song->GetRealURI()) {
+		/* the player wants something else; let
+		   decoder_task() handle the command */
+		dc.Unlock();
+		decoder.range_finished = true;
+		return false;
+	}
+
+	/* this is what decoder_task() and decoder_run_song() do for
+	   a new song, except that the audio format, the ReplayGain
+	   and the MixRamp values of the file remain valid */
+
+	dc.previous_mix_ramp = dc.mix_ramp;
+	dc.replay_gain_prev_db = dc.replay_gain_db;
+	dc.SetState(DecoderState::DECODE);
+	dc.command = DecoderCommand::NONE;
+	dc.client_cond.signal();
+
+	Tag *tag = new Tag(dc.song->GetTag());
+	dc.Unlock();
+
+	FormatDebug(decoder_domain, "continuing with %s", uri.c_str());
+
+	decoder.initial_seek_pending = false;
+
+	delete decoder.song_tag;
+	decoder.song_tag = tag;
+	send_stream_tag(decoder, nullptr);
+
+	return true;
+}
+
 DecoderCommand
 decoder_data(Decoder &decoder,
 	     InputStream *is,
@@ -437,36 +745,26 @@ decoder_data(Decoder &decoder,
 	     uint16_t kbit_rate)
 {
 	DecoderControl &dc = decoder.dc;
-	DecoderCommand cmd;
 
 	assert(dc.state == DecoderState::DECODE);
 	assert(dc.pipe != nullptr);
 	assert(length % dc.in_audio_format.GetFrameSize() == 0);
 
-	dc.Lock();
-	cmd = decoder_get_virtual_command(decoder);
-	dc.Unlock();
-
-	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK ||
-	    length == 0)
+	DecoderCommand cmd = decoder_prepare_data(decoder, is, length > 0);
+	if (cmd != DecoderCommand::NONE || length == 0)
 		return cmd;
 
-	/* send stream tags */
+	metric_decoder_bytes.Add(length);
 
-	if (update_stream_tag(decoder, is)) {
-		if (decoder.decoder_tag != nullptr) {
-			/* merge with tag from decoder plugin */
-			Tag *tag = Tag::Merge(*decoder.decoder_tag,
-					      *decoder.stream_tag);
-			cmd = do_send_tag(decoder, *tag);
-			delete tag;
-		} else
-			/* send only the stream tag */
-			cmd = do_send_tag(decoder, *decoder.stream_tag);
-
-		if (cmd != DecoderCommand::NONE)
-			return cmd;
+#ifdef ENABLE_SYNTH_CACHE
+	if (decoder.synth_cache != nullptr) {
+		Error error;
+		if (!decoder.synth_cache->Write(data, length, error)) {
+			LogError(error);
+			decoder_synth_cache_discard(decoder);
+		}
 	}
+#endif
 
 	if (decoder.convert != nullptr) {
 		assert(dc.in_audio_format != dc.out_audio_format);
@@ -486,6 +784,8 @@ decoder_data(Decoder &decoder,
 		assert(dc.in_audio_format == dc.out_audio_format);
 	}
 
+	decoder_cache_append(decoder, data, length);
+
 	while (length > 0) {
 		struct music_chunk *chunk;
 		bool full;
@@ -513,6 +813,25 @@ decoder_data(Decoder &decoder,
 		if (nbytes > length)
 			nbytes = length;
 
+		if (dc.end_ms > 0) {
+			/* don't let the chunk cross the end of the
+			   range, it may belong to the next song */
+			const size_t frame_size =
+				dc.out_audio_format.GetFrameSize();
+			const double remaining =
+				dc.end_ms / 1000.0 - decoder.timestamp;
+			size_t max_frames = remaining > 0
+				? size_t(ceil(remaining *
+					      dc.out_audio_format.sample_rate))
+				: 0;
+			if (max_frames == 0)
+				max_frames = 1;
+
+			const size_t max_bytes = max_frames * frame_size;
+			if (nbytes > max_bytes)
+				nbytes = max_bytes;
+		}
+
 		/* copy the buffer */
 
 		memcpy(dest.data, data, nbytes);
@@ -528,11 +847,8 @@ decoder_data(Decoder &decoder,
 		data = (const uint8_t *)data + nbytes;
 		length -= nbytes;
 
-		decoder.timestamp += (double)nbytes /
-			dc.out_audio_format.GetTimeToSize();
-
-		if (dc.end_ms > 0 &&
-		    decoder.timestamp >= dc.end_ms / 1000.0)
+		if (decoder_advance(decoder, nbytes) &&
+		    !decoder_continue_range(decoder))
 			/* the end of this range has been reached:
 			   stop decoding */
 			return DecoderCommand::STOP;
@@ -541,6 +857,70 @@ decoder_data(Decoder &decoder,
 	return DecoderCommand::NONE;
 }
 
+WritableBuffer<void>
+decoder_get_buffer(Decoder &decoder, uint16_t kbit_rate)
+{
+	DecoderControl &dc = decoder.dc;
+
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+
+	if (decoder.convert != nullptr)
+		/* the data must be converted first */
+		return WritableBuffer<void>::Null();
+
+	if (decoder.range_finished)
+		return WritableBuffer<void>::Null();
+
+	while (true) {
+		struct music_chunk *chunk = decoder.GetChunk();
+		if (chunk == nullptr) {
+			assert(dc.command != DecoderCommand::NONE);
+			return WritableBuffer<void>::Null();
+		}
+
+		const auto dest =
+			chunk->Write(dc.out_audio_format,
+				     decoder.timestamp -
+				     dc.song->GetStartMS() / 1000.0,
+				     kbit_rate);
+		if (!dest.IsNull())
+			return dest;
+
+		/* the chunk is full, flush it */
+		decoder.FlushChunk();
+	}
+}
+
+DecoderCommand
+decoder_commit_data(Decoder &decoder, InputStream *is, size_t length)
+{
+	DecoderControl &dc = decoder.dc;
+
+	assert(dc.state == DecoderState::DECODE);
+	assert(decoder.convert == nullptr);
+	assert(decoder.chunk != nullptr);
+	assert(length % dc.out_audio_format.GetFrameSize() == 0);
+
+	if (length > 0) {
+		decoder_cache_append(decoder,
+				     decoder.chunk->data + decoder.chunk->length,
+				     length);
+
+		if (decoder.chunk->Expand(dc.out_audio_format, length))
+			/* the chunk is full, flush it */
+			decoder.FlushChunk();
+
+		if (decoder_advance(decoder, length) &&
+		    !decoder_continue_range(decoder))
+			/* the end of this range has been reached:
+			   stop decoding */
+			return DecoderCommand::STOP;
+	}
+
+	return decoder_prepare_data(decoder, is, true);
+}
+
 DecoderCommand
 decoder_tag(Decoder &decoder, InputStream *is,
 	    Tag &&tag)
@@ -627,3 +1007,29 @@ decoder_mixramp(Decoder &decoder, MixRampInfo &&mix_ramp)
 
 	dc.SetMixRamp(std::move(mix_ramp));
 }
+
+void
+decoder_keep_state(Decoder &decoder, DecoderReusableState *state)
+{
+	DecoderControl &dc = decoder.dc;
+
+	delete dc.reusable_state;
+	dc.reusable_state = state;
+}
+
+DecoderReusableState *
+decoder_take_state(Decoder &decoder, const DecoderPlugin &plugin)
+{
+	DecoderControl &dc = decoder.dc;
+
+	DecoderReusableState *state = dc.reusable_state;
+	dc.reusable_state = nullptr;
+
+	if (state != nullptr && &state->plugin != &plugin) {
+		/* the next song is decoded by a different plugin */
+		delete state;
+		state = nullptr;
+	}
+
+	return state;
+}
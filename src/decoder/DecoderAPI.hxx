@@ -32,6 +32,7 @@
 #include "check.h"
 #include "DecoderCommand.hxx"
 #include "DecoderPlugin.hxx"
+#include "DecoderReusable.hxx"
 #include "ReplayGainInfo.hxx"
 #include "tag/Tag.hxx"
 #include "AudioFormat.hxx"
@@ -42,6 +43,9 @@
 
 class Error;
 
+template<typename T> struct WritableBuffer;
+template<typename T> struct ConstBuffer;
+
 /**
  * Notify the player thread that it has finished initialization and
  * that it has read the song's meta data.
@@ -126,6 +130,16 @@ decoder_read(Decoder &decoder, InputStream &is,
 	return decoder_read(&decoder, is, buffer, length);
 }
 
+/**
+ * Blocking read from the input stream without copying; see
+ * InputStream::ReadDirect().
+ *
+ * @return the data, an empty buffer on end of file, error or command,
+ * or a "null" buffer if the stream does not support direct reads
+ */
+ConstBuffer<void>
+decoder_read_direct(Decoder &decoder, InputStream &is, size_t length);
+
 /**
  * Blocking read from the input stream.  Attempts to fill the buffer
  * completely; there is no partial result.
@@ -179,6 +193,44 @@ decoder_data(Decoder &decoder, InputStream &is,
 	return decoder_data(decoder, &is, data, length, kbit_rate);
 }
 
+/**
+ * Returns a writable buffer inside the current music pipe chunk.
+ * The decoder plugin may decode directly into it, and then submit
+ * the data with decoder_commit_data(), which saves the copy done by
+ * decoder_data().  The buffer size is a multiple of the output frame
+ * size.
+ *
+ * If the buffer is "nulled", the plugin must use decoder_data()
+ * instead: either the data needs to be converted, or a command has
+ * been received.
+ *
+ * @param decoder the decoder object
+ * @param kbit_rate the current bit rate
+ */
+WritableBuffer<void>
+decoder_get_buffer(Decoder &decoder, uint16_t kbit_rate);
+
+/**
+ * Submit the data which was written into the buffer returned by
+ * decoder_get_buffer().
+ *
+ * @param decoder the decoder object
+ * @param is an input stream which is buffering while we are waiting
+ * for the player
+ * @param length the number of bytes written; a multiple of the
+ * frame size, and not larger than the buffer
+ * @return the current command, or DecoderCommand::NONE if there is no
+ * command pending
+ */
+DecoderCommand
+decoder_commit_data(Decoder &decoder, InputStream *is, size_t length);
+
+static inline DecoderCommand
+decoder_commit_data(Decoder &decoder, InputStream &is, size_t length)
+{
+	return decoder_commit_data(decoder, &is, length);
+}
+
 /**
  * This function is called by the decoder plugin when it has
  * successfully decoded a tag.
@@ -220,4 +272,26 @@ decoder_replay_gain(Decoder &decoder,
 void
 decoder_mixramp(Decoder &decoder, MixRampInfo &&mix_ramp);
 
+/**
+ * Keep plugin state for the next song (e.g. for gapless playback of
+ * an album).  This replaces (and frees) the object kept before.
+ *
+ * @param decoder the decoder object
+ * @param state the object, which is freed by the decoder from now on
+ */
+void
+decoder_keep_state(Decoder &decoder, DecoderReusableState *state);
+
+/**
+ * Take the object passed to decoder_keep_state() during the previous
+ * song.
+ *
+ * @param decoder the decoder object
+ * @param plugin the calling plugin
+ * @return the object, which must be freed by the caller, or nullptr
+ * if there is none or if it was created by a different plugin
+ */
+DecoderReusableState *
+decoder_take_state(Decoder &decoder, const DecoderPlugin &plugin);
+
 #endif
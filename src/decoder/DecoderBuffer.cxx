@@ -21,7 +21,10 @@
 #include "DecoderBuffer.hxx"
 #include "DecoderAPI.hxx"
 #include "util/ConstBuffer.hxx"
-#include "util/VarSize.hxx"
+#include "util/HugeAllocator.hxx"
+#include "system/FatalError.hxx"
+
+#include <new>
 
 #include <assert.h>
 #include <string.h>
@@ -48,6 +51,10 @@ struct DecoderBuffer {
 		      size_t _size)
 		:decoder(_decoder), is(&_is),
 		 size(_size), length(0), consumed(0) {}
+
+	static constexpr size_t GetAllocationSize(size_t _size) {
+		return sizeof(DecoderBuffer) - sizeof(data) + _size;
+	}
 };
 
 DecoderBuffer *
@@ -56,9 +63,14 @@ decoder_buffer_new(Decoder *decoder, InputStream &is,
 {
 	assert(size > 0);
 
-	return NewVarSize<DecoderBuffer>(sizeof(DecoderBuffer::data),
-					 size,
-					 decoder, is, size);
+	/* allocated with HugeAllocate(), so the buffer follows the
+	   "buffer_huge_pages" and "buffer_lock" settings like the
+	   MusicBuffer */
+	void *p = HugeAllocate(DecoderBuffer::GetAllocationSize(size));
+	if (p == nullptr)
+		FatalError("Failed to allocate decoder buffer");
+
+	return ::new(p) DecoderBuffer(decoder, is, size);
 }
 
 void
@@ -66,7 +78,9 @@ decoder_buffer_free(DecoderBuffer *buffer)
 {
 	assert(buffer != nullptr);
 
-	DeleteVarSize(buffer);
+	const size_t size = buffer->size;
+	buffer->~DecoderBuffer();
+	HugeFree(buffer, DecoderBuffer::GetAllocationSize(size));
 }
 
 bool
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderCache.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigError.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+DecoderCache *decoder_cache;
+
+DecodedSong *
+DecoderCache::Start(AudioFormat audio_format, float total_time) const
+{
+	assert(audio_format.IsValid());
+
+	if (total_time <= 0 || total_time > max_duration)
+		return nullptr;
+
+	/* allow some tolerance, because the duration reported by
+	   the decoder plugin may be imprecise */
+	const size_t expected = size_t(total_time *
+				       audio_format.GetTimeToSize());
+	const size_t limit =
+		std::min(size_t(max_duration *
+				audio_format.GetTimeToSize() * 1.1),
+			 max_size);
+	if (expected > limit)
+		return nullptr;
+
+	DecodedSong *song = new DecodedSong();
+	song->audio_format = audio_format;
+	song->total_time = total_time;
+	song->max_size = limit;
+	song->data.reserve(std::min(expected + expected / 16, limit));
+	return song;
+}
+
+std::shared_ptr<const DecodedSong>
+DecoderCache::Get(const std::string &uri)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(uri);
+	if (i == map.end())
+		return nullptr;
+
+	lru.splice(lru.begin(), lru, i->second.lru_position);
+	return i->second.song;
+}
+
+void
+DecoderCache::EvictOne()
+{
+	assert(!lru.empty());
+
+	auto i = map.find(*lru.back());
+	assert(i != map.end());
+
+	size -= i->second.song->data.size();
+	lru.pop_back();
+	map.erase(i);
+}
+
+void
+DecoderCache::Put(const std::string &uri, DecodedSong *_song)
+{
+	std::shared_ptr<const DecodedSong> song(_song);
+
+	/* give back the memory reserved for the estimated size */
+	_song->data.shrink_to_fit();
+
+	const size_t song_size = song->data.size();
+	if (song_size == 0 || song_size > max_size)
+		return;
+
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(uri);
+	if (i != map.end()) {
+		/* replace the old version */
+		size -= i->second.song->data.size();
+		lru.erase(i->second.lru_position);
+		map.erase(i);
+	}
+
+	while (size + song_size > max_size)
+		EvictOne();
+
+	auto r = map.insert(std::make_pair(uri, Item()));
+	assert(r.second);
+
+	r.first->second.song = std::move(song);
+	lru.push_front(&r.first->first);
+	r.first->second.lru_position = lru.begin();
+	size += song_size;
+}
+
+bool
+decoder_cache_global_init(Error &error)
+{
+	const config_param *param = config_get_param(CONF_DECODER_CACHE);
+	if (param == nullptr)
+		/* disabled */
+		return true;
+
+	const unsigned size_kb = param->GetBlockValue("size", 65536u);
+	const unsigned max_duration = param->GetBlockValue("max_duration",
+							   30u);
+	if (size_kb == 0 || max_duration == 0) {
+		error.Format(config_domain,
+			     "Invalid \"decoder_cache\" on line %i",
+			     param->line);
+		return false;
+	}
+
+	decoder_cache = new DecoderCache(size_t(size_kb) * 1024,
+					 max_duration);
+	return true;
+}
+
+void
+decoder_cache_global_finish()
+{
+	delete decoder_cache;
+	decoder_cache = nullptr;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_CACHE_HXX
+#define MPD_DECODER_CACHE_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Error;
+
+/**
+ * The complete decoder output of a song, as it was submitted to the
+ * #MusicPipe (i.e. already converted to the output format).
+ */
+struct DecodedSong {
+	AudioFormat audio_format;
+
+	float total_time;
+
+	/**
+	 * The tag sent by the decoder plugin; empty if there was
+	 * none.
+	 */
+	Tag tag;
+
+	ReplayGainInfo replay_gain_info;
+
+	/**
+	 * Is #replay_gain_info defined?
+	 */
+	bool has_replay_gain;
+
+	/**
+	 * The PCM data.
+	 */
+	std::vector<uint8_t> data;
+
+	/**
+	 * The maximum size of #data; the recording is discarded if
+	 * the decoder produces more.
+	 */
+	size_t max_size;
+
+	DecodedSong()
+		:audio_format(AudioFormat::Undefined()), total_time(-1),
+		 has_replay_gain(false), max_size(0) {}
+
+	DecodedSong(const DecodedSong &) = delete;
+	DecodedSong &operator=(const DecodedSong &) = delete;
+
+	/**
+	 * @return false if the maximum size has been exceeded
+	 */
+	bool Append(const void *p, size_t length) {
+		if (length > max_size - data.size())
+			return false;
+
+		const uint8_t *src = (const uint8_t *)p;
+		data.insert(data.end(), src, src + length);
+		return true;
+	}
+};
+
+/**
+ * An in-memory cache of the decoder output of short songs (jingles,
+ * station IDs), keyed by the URI passed to the decoder.  A song is
+ * stored after it has been decoded from the beginning to the end;
+ * the next time it is played, the decoder thread copies the data to
+ * the #MusicPipe without opening the file.  The least recently used
+ * songs are evicted when the size limit is reached.
+ *
+ * This class is thread-safe.
+ */
+class DecoderCache {
+	struct Item {
+		std::shared_ptr<const DecodedSong> song;
+
+		/**
+		 * The position of this item in #lru.
+		 */
+		std::list<const std::string *>::iterator lru_position;
+	};
+
+	const size_t max_size;
+
+	/**
+	 * Songs longer than this are not cached.
+	 */
+	const float max_duration;
+
+	Mutex mutex;
+
+	size_t size;
+
+	std::map<std::string, Item> map;
+
+	/**
+	 * Pointers to the keys in #map; the most recently used one is
+	 * at the front.
+	 */
+	std::list<const std::string *> lru;
+
+public:
+	DecoderCache(size_t _max_size, float _max_duration)
+		:max_size(_max_size), max_duration(_max_duration),
+		 size(0) {}
+
+	DecoderCache(const DecoderCache &) = delete;
+	DecoderCache &operator=(const DecoderCache &) = delete;
+
+	/**
+	 * Prepare recording a song with the given duration and
+	 * (output) audio format.
+	 *
+	 * @return a new object to be filled with DecodedSong::Append()
+	 * and passed to Put(), or nullptr if the song is not eligible
+	 */
+	DecodedSong *Start(AudioFormat audio_format, float total_time) const;
+
+	/**
+	 * Look up a song and mark it as recently used.
+	 *
+	 * @return the song or nullptr if it is not in the cache
+	 */
+	std::shared_ptr<const DecodedSong> Get(const std::string &uri);
+
+	/**
+	 * Add a completely decoded song to the cache.  The object
+	 * must have been allocated by Start(); this method takes over
+	 * ownership.
+	 */
+	void Put(const std::string &uri, DecodedSong *song);
+
+private:
+	/**
+	 * Remove the least recently used song.  Caller must lock
+	 * the mutex.
+	 */
+	void EvictOne();
+};
+
+/**
+ * The global decoder cache configured with "decoder_cache", or
+ * nullptr if it is disabled.
+ */
+extern DecoderCache *decoder_cache;
+
+bool
+decoder_cache_global_init(Error &error);
+
+void
+decoder_cache_global_finish();
+
+#endif
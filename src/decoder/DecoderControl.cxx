@@ -19,17 +19,24 @@
 
 #include "config.h"
 #include "DecoderControl.hxx"
+#include "DecoderReusable.hxx"
 #include "MusicPipe.hxx"
 #include "DetachedSong.hxx"
+#include "input/InputStream.hxx"
 
 #include <assert.h>
+#include <string.h>
 
-DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond)
+DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond,
+			       float _prefetch_time)
 	:mutex(_mutex), client_cond(_client_cond),
 	 state(DecoderState::STOP),
 	 command(DecoderCommand::NONE),
 	 client_is_waiting(false),
 	 song(nullptr),
+	 prefetch_time(_prefetch_time),
+	 prefetch_song(nullptr), prefetch_stream(nullptr),
+	 reusable_state(nullptr),
 	 replay_gain_db(0), replay_gain_prev_db(0) {}
 
 DecoderControl::~DecoderControl()
@@ -37,6 +44,9 @@ DecoderControl::~DecoderControl()
 	ClearError();
 
 	delete song;
+	delete prefetch_song;
+	delete prefetch_stream;
+	delete reusable_state;
 }
 
 void
@@ -76,14 +86,64 @@ DecoderControl::Start(DetachedSong *_song,
 	assert(_song != nullptr);
 	assert(_pipe.IsEmpty());
 
+	/* the decoder thread may still be running a plugin which
+	   waits for this song (see IsPrefetchContinuation()), so
+	   these attributes must not be modified without the lock */
+	Lock();
+
 	delete song;
 	song = _song;
+	ClearPrefetch();
 	start_ms = _start_ms;
 	end_ms = _end_ms;
 	buffer = &_buffer;
 	pipe = &_pipe;
 
-	LockSynchronousCommand(DecoderCommand::START);
+	SynchronousCommandLocked(DecoderCommand::START);
+	Unlock();
+}
+
+void
+DecoderControl::SetPrefetch(const DetachedSong &_song)
+{
+	delete prefetch_song;
+	prefetch_song = new DetachedSong(_song);
+}
+
+void
+DecoderControl::ClearPrefetch()
+{
+	delete prefetch_song;
+	prefetch_song = nullptr;
+
+	/* wake up the decoder if it waits for this song */
+	Signal();
+}
+
+bool
+DecoderControl::IsPrefetchDue(double timestamp) const
+{
+	if (prefetch_time <= 0 || prefetch_song == nullptr ||
+	    prefetch_stream != nullptr || IsPrefetchContinuation())
+		return false;
+
+	const double end = end_ms > 0
+		? end_ms / 1000.0
+		: total_time;
+	if (end <= 0 || timestamp + prefetch_time < end)
+		/* unknown duration (e.g. a radio stream) or still
+		   too far away from the end */
+		return false;
+
+	return prefetch_uri.empty();
+}
+
+bool
+DecoderControl::IsPrefetchContinuation() const
+{
+	return end_ms > 0 && prefetch_song != nullptr &&
+		prefetch_song->GetStartMS() == end_ms &&
+		strcmp(prefetch_song->GetRealURI(), song->GetRealURI()) == 0;
 }
 
 void
@@ -91,6 +151,10 @@ DecoderControl::Stop()
 {
 	Lock();
 
+	/* a decoder which has finished its song range may still be
+	   waiting for the next one; let it close the file */
+	ClearPrefetch();
+
 	if (command != DecoderCommand::NONE)
 		/* Attempt to cancel the current command.  If it's too
 		   late and the decoder thread is already executing
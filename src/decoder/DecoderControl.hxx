@@ -27,6 +27,10 @@
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "util/Error.hxx"
+#include "Metrics.hxx"
+#include "Trace.hxx"
+
+#include <string>
 
 #include <assert.h>
 #include <stdint.h>
@@ -37,8 +41,10 @@
 #endif
 
 class DetachedSong;
+class InputStream;
 class MusicBuffer;
 class MusicPipe;
+class DecoderReusableState;
 
 enum class DecoderState : uint8_t {
 	STOP = 0,
@@ -153,6 +159,45 @@ struct DecoderControl {
 	 */
 	MusicPipe *pipe;
 
+	/**
+	 * Open the #InputStream of #prefetch_song this many seconds
+	 * before the decoder reaches the end of the current song.  0
+	 * disables prefetching.
+	 */
+	const float prefetch_time;
+
+	/**
+	 * The song which will be decoded next (if the player does not
+	 * change its mind).  This attribute is set by the player
+	 * thread with SetPrefetch(), and cleared by Start().  The
+	 * decoder thread uses it to open the next song ahead of time,
+	 * and to decode straight into the next track of a CUE sheet
+	 * (see IsPrefetchContinuation()).
+	 *
+	 * This is a duplicate, and must be freed when this attribute
+	 * is cleared.
+	 */
+	DetachedSong *prefetch_song;
+
+	/**
+	 * The stream which was opened ahead of time for
+	 * #prefetch_song, and the URI (or file system path) it was
+	 * opened with; the decoder thread picks it up instead of
+	 * opening the same URI again.  An empty #prefetch_uri means
+	 * no prefetch has been attempted.
+	 *
+	 * These attributes are only accessed by the decoder thread.
+	 */
+	InputStream *prefetch_stream;
+	std::string prefetch_uri;
+
+	/**
+	 * Plugin state kept from the previous song, see
+	 * decoder_keep_state().  This attribute is only accessed by
+	 * the decoder thread.
+	 */
+	DecoderReusableState *reusable_state;
+
 	float replay_gain_db;
 	float replay_gain_prev_db;
 
@@ -161,15 +206,18 @@ struct DecoderControl {
 	/**
 	 * @param _mutex see #mutex
 	 * @param _client_cond see #client_cond
+	 * @param _prefetch_time see #prefetch_time
 	 */
-	DecoderControl(Mutex &_mutex, Cond &_client_cond);
+	DecoderControl(Mutex &_mutex, Cond &_client_cond,
+		       float _prefetch_time=0);
 	~DecoderControl();
 
 	/**
 	 * Locks the object.
 	 */
 	void Lock() const {
-		mutex.lock();
+		if (!mutex.try_lock())
+			TraceLockContended(mutex, TraceObject::DECODER);
 	}
 
 	/**
@@ -185,6 +233,7 @@ struct DecoderControl {
 	 * calling this function.
 	 */
 	void Signal() {
+		Trace(TraceEvent::COND_SIGNAL, TraceObject::DECODER);
 		cond.signal();
 	}
 
@@ -273,6 +322,16 @@ struct DecoderControl {
 		return result;
 	}
 
+	/**
+	 * Change the #state and count the transition.
+	 *
+	 * Caller must lock the object.
+	 */
+	void SetState(DecoderState _state) {
+		state = _state;
+		metric_decoder_state_changes.Add();
+	}
+
 	/**
 	 * Clear the error condition and free the #Error object (if any).
 	 *
@@ -281,7 +340,7 @@ struct DecoderControl {
 	void ClearError() {
 		if (state == DecoderState::ERROR) {
 			error.Clear();
-			state = DecoderState::STOP;
+			SetState(DecoderState::STOP);
 		}
 	}
 
@@ -303,6 +362,44 @@ struct DecoderControl {
 		return result;
 	}
 
+	/**
+	 * Announce the song which will be decoded after the current
+	 * one, so the decoder thread can open it ahead of time, or
+	 * continue decoding into it if it is the next range of the
+	 * same file.
+	 *
+	 * Caller must lock the object.
+	 */
+	void SetPrefetch(const DetachedSong &_song);
+
+	/**
+	 * Forget the song passed to SetPrefetch().
+	 *
+	 * Caller must lock the object.
+	 */
+	void ClearPrefetch();
+
+	/**
+	 * Shall the decoder thread open the #prefetch_song now?
+	 *
+	 * Caller must lock the object.
+	 *
+	 * @param timestamp the current decoder position in seconds
+	 */
+	gcc_pure
+	bool IsPrefetchDue(double timestamp) const;
+
+	/**
+	 * Does #prefetch_song start exactly where the current song
+	 * range ends, in the same file?  This is the case for
+	 * consecutive tracks of a CUE sheet; the decoder does not
+	 * need to reopen the file for the next one.
+	 *
+	 * Caller must lock the object.
+	 */
+	gcc_pure
+	bool IsPrefetchContinuation() const;
+
 private:
 	/**
 	 * Wait for the command to be finished by the decoder thread.
@@ -381,6 +478,14 @@ public:
 		return previous_mix_ramp.GetEnd();
 	}
 
+	const MixRampCurve &GetMixRampStartCurve() const {
+		return mix_ramp.GetStartCurve();
+	}
+
+	const MixRampCurve &GetMixRampPreviousEndCurve() const {
+		return previous_mix_ramp.GetEndCurve();
+	}
+
 	void SetMixRamp(MixRampInfo &&new_value) {
 		mix_ramp = std::move(new_value);
 	}
@@ -25,19 +25,55 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 #include "tag/Tag.hxx"
+#include "Metrics.hxx"
+#include "Trace.hxx"
+#include "DecoderCache.hxx"
+
+#ifdef ENABLE_SYNTH_CACHE
+#include "SynthCache.hxx"
+#endif
 
 #include <assert.h>
 
+Decoder::Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag)
+	:dc(_dc),
+	 convert(nullptr),
+	 timestamp(0),
+	 initial_seek_pending(_initial_seek_pending),
+	 initial_seek_running(false),
+	 seeking(false),
+	 range_finished(false),
+	 song_tag(_tag), stream_tag(nullptr), decoder_tag(nullptr),
+	 chunk(nullptr),
+	 chunk_cache(*_dc.buffer),
+	 replay_gain_serial(0),
+	 prefetched_stream(nullptr),
+	 cacheable(false), decoded_song(nullptr)
+{
+#ifdef ENABLE_SYNTH_CACHE
+	synth_cache = nullptr;
+#endif
+}
+
 Decoder::~Decoder()
 {
 	/* caller must flush the chunk */
 	assert(chunk == nullptr);
 
+	/* caller must close the stream */
+	assert(prefetched_stream == nullptr);
+
 	if (convert != nullptr) {
 		convert->Close();
 		delete convert;
 	}
 
+	delete decoded_song;
+
+#ifdef ENABLE_SYNTH_CACHE
+	delete synth_cache;
+#endif
+
 	delete song_tag;
 	delete stream_tag;
 	delete decoder_tag;
@@ -65,7 +101,7 @@ Decoder::GetChunk()
 		return chunk;
 
 	do {
-		chunk = dc.buffer->Allocate();
+		chunk = chunk_cache.Allocate();
 		if (chunk != nullptr) {
 			chunk->replay_gain_serial = replay_gain_serial;
 			if (replay_gain_serial != 0)
@@ -88,14 +124,20 @@ Decoder::FlushChunk()
 	assert(chunk != nullptr);
 
 	if (chunk->IsEmpty())
-		dc.buffer->Return(chunk);
-	else
+		chunk_cache.Return(chunk);
+	else {
 		dc.pipe->Push(chunk);
+		metric_decoder_chunks.Add();
+		Trace(TraceEvent::CHUNK_PUSH, TraceObject::DECODER,
+		      dc.pipe->GetSize());
+	}
 
 	chunk = nullptr;
 
 	dc.Lock();
-	if (dc.client_is_waiting)
+	if (dc.client_is_waiting) {
+		Trace(TraceEvent::COND_SIGNAL, TraceObject::DECODER);
 		dc.client_cond.signal();
+	}
 	dc.Unlock();
 }
@@ -21,9 +21,13 @@
 #define MPD_DECODER_INTERNAL_HXX
 
 #include "ReplayGainInfo.hxx"
+#include "MusicBuffer.hxx"
 #include "util/Error.hxx"
 
 class PcmConvert;
+class InputStream;
+class SynthCacheWriter;
+struct DecodedSong;
 struct DecoderControl;
 struct Tag;
 
@@ -62,6 +66,15 @@ struct Decoder {
 	 */
 	bool seeking;
 
+	/**
+	 * The end of the song range has been reached while the player
+	 * had announced the next CUE track, but then it has started a
+	 * different song (see decoder_continue_range()).  The plugin
+	 * is asked to stop; the pending command belongs to the
+	 * decoder thread.
+	 */
+	bool range_finished;
+
 	/**
 	 * The tag from the song object.  This is only used for local
 	 * files, because we expect the stream server to send us a new
@@ -78,6 +91,13 @@ struct Decoder {
 	/** the chunk currently being written to */
 	struct music_chunk *chunk;
 
+	/**
+	 * Allocates chunks from DecoderControl::buffer in batches.
+	 * It must be flushed before the #DecoderControl state is
+	 * changed at the end of the song.
+	 */
+	MusicBufferCache chunk_cache;
+
 	ReplayGainInfo replay_gain_info;
 
 	/**
@@ -86,23 +106,42 @@ struct Decoder {
 	 */
 	unsigned replay_gain_serial;
 
+	/**
+	 * The stream which was opened for this song while the
+	 * previous one was still being decoded (see
+	 * DecoderControl::prefetch_stream), or nullptr.  It is used
+	 * by the first attempt to open the song.
+	 */
+	InputStream *prefetched_stream;
+
+	/**
+	 * May the output of this song be recorded for the
+	 * #DecoderCache?  It is only set if the whole song is played
+	 * from the start.
+	 */
+	bool cacheable;
+
+	/**
+	 * The song being recorded for the #DecoderCache, or nullptr.
+	 * Allocated by decoder_initialized().
+	 */
+	DecodedSong *decoded_song;
+
+#ifdef ENABLE_SYNTH_CACHE
+	/**
+	 * Receives the output of a synthesizing plugin while it
+	 * renders the song for the first time, or nullptr.
+	 */
+	SynthCacheWriter *synth_cache;
+#endif
+
 	/**
 	 * An error has occurred (in DecoderAPI.cxx), and the plugin
 	 * will be asked to stop.
 	 */
 	Error error;
 
-	Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag)
-		:dc(_dc),
-		 convert(nullptr),
-		 timestamp(0),
-		 initial_seek_pending(_initial_seek_pending),
-		 initial_seek_running(false),
-		 seeking(false),
-		 song_tag(_tag), stream_tag(nullptr), decoder_tag(nullptr),
-		 chunk(nullptr),
-		 replay_gain_serial(0) {
-	}
+	Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag);
 
 	~Decoder();
 
@@ -122,4 +161,14 @@ struct Decoder {
 	void FlushChunk();
 };
 
+/**
+ * Open the #InputStream of DecoderControl::prefetch_song, so the
+ * next song can start from buffered data.  Returns early when a
+ * decoder command arrives.
+ *
+ * Caller must not lock the #DecoderControl object.
+ */
+void
+decoder_prefetch(DecoderControl &dc);
+
 #endif
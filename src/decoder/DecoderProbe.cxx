@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DecoderProbe.hxx"
+#include "thread/Mutex.hxx"
+
+#include <map>
+#include <string>
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Limit the size of the cache; it is flushed when this number is
+ * exceeded, which happens only with unusual suffixes or MIME type
+ * parameters.
+ */
+static constexpr size_t MAX_PROBE_CACHE = 256;
+
+static Mutex probe_cache_mutex;
+static std::map<std::string, const DecoderPlugin *> probe_cache;
+
+static std::string
+MakeKey(const char *suffix, const char *mime_type)
+{
+	std::string key;
+	if (suffix != nullptr)
+		key = suffix;
+	key.push_back('\n');
+	if (mime_type != nullptr)
+		key.append(mime_type);
+	return key;
+}
+
+const DecoderPlugin *
+decoder_probe_cache_lookup(const char *suffix, const char *mime_type)
+{
+	if (suffix == nullptr && mime_type == nullptr)
+		return nullptr;
+
+	const std::string key = MakeKey(suffix, mime_type);
+
+	const ScopeLock protect(probe_cache_mutex);
+	const auto i = probe_cache.find(key);
+	return i != probe_cache.end()
+		? i->second
+		: nullptr;
+}
+
+void
+decoder_probe_cache_store(const char *suffix, const char *mime_type,
+			  const DecoderPlugin &plugin)
+{
+	if (suffix == nullptr && mime_type == nullptr)
+		return;
+
+	std::string key = MakeKey(suffix, mime_type);
+
+	const ScopeLock protect(probe_cache_mutex);
+	if (probe_cache.size() >= MAX_PROBE_CACHE)
+		probe_cache.clear();
+
+	probe_cache[std::move(key)] = &plugin;
+}
+
+static constexpr const char *mp3_plugins[] = {
+	"mad", "mpg123", "ffmpeg", nullptr
+};
+
+static constexpr const char *aac_plugins[] = {
+	"faad", "ffmpeg", nullptr
+};
+
+static constexpr const char *flac_plugins[] = {
+	"flac", "ffmpeg", nullptr
+};
+
+static constexpr const char *oggflac_plugins[] = {
+	"oggflac", "ffmpeg", nullptr
+};
+
+static constexpr const char *vorbis_plugins[] = {
+	"vorbis", "ffmpeg", nullptr
+};
+
+static constexpr const char *opus_plugins[] = {
+	"opus", "ffmpeg", nullptr
+};
+
+static constexpr const char *pcm_plugins[] = {
+	"sndfile", "audiofile", "ffmpeg", nullptr
+};
+
+static constexpr const char *wavpack_plugins[] = {
+	"wavpack", "ffmpeg", nullptr
+};
+
+static constexpr const char *mpc_plugins[] = {
+	"mpcdec", "ffmpeg", nullptr
+};
+
+static constexpr const char *dsf_plugins[] = {
+	"dsf", nullptr
+};
+
+static constexpr const char *dsdiff_plugins[] = {
+	"dsdiff", nullptr
+};
+
+static constexpr const char *midi_plugins[] = {
+	"fluidsynth", "wildmidi", nullptr
+};
+
+static constexpr const char *sid_plugins[] = {
+	"sidplay", nullptr
+};
+
+static constexpr const char *ffmpeg_plugins[] = {
+	"ffmpeg", nullptr
+};
+
+static bool
+HasMagic(const uint8_t *data, size_t size, size_t offset,
+	 const char *magic)
+{
+	const size_t length = strlen(magic);
+	return size >= offset + length &&
+		memcmp(data + offset, magic, length) == 0;
+}
+
+/**
+ * Identify the codec of an Ogg stream from the first packet on its
+ * first page.
+ */
+static const char *const*
+SniffOgg(const uint8_t *data, size_t size)
+{
+	if (size < 27)
+		return nullptr;
+
+	/* the first packet follows the page header and its segment
+	   table */
+	const size_t packet = 27 + data[26];
+
+	if (HasMagic(data, size, packet, "\177FLAC"))
+		return oggflac_plugins;
+
+	if (HasMagic(data, size, packet, "OpusHead"))
+		return opus_plugins;
+
+	if (HasMagic(data, size, packet, "\001vorbis"))
+		return vorbis_plugins;
+
+	return ffmpeg_plugins;
+}
+
+const char *const*
+decoder_sniff(const void *_data, size_t size)
+{
+	const uint8_t *data = (const uint8_t *)_data;
+
+	if (HasMagic(data, size, 0, "fLaC"))
+		return flac_plugins;
+
+	if (HasMagic(data, size, 0, "OggS"))
+		return SniffOgg(data, size);
+
+	if (HasMagic(data, size, 0, "ID3"))
+		return mp3_plugins;
+
+	if ((HasMagic(data, size, 0, "RIFF") &&
+	     HasMagic(data, size, 8, "WAVE")) ||
+	    (HasMagic(data, size, 0, "FORM") &&
+	     (HasMagic(data, size, 8, "AIFF") ||
+	      HasMagic(data, size, 8, "AIFC"))))
+		return pcm_plugins;
+
+	if (HasMagic(data, size, 0, "wvpk"))
+		return wavpack_plugins;
+
+	if (HasMagic(data, size, 0, "MPCK") ||
+	    HasMagic(data, size, 0, "MP+"))
+		return mpc_plugins;
+
+	if (HasMagic(data, size, 0, "DSD "))
+		return dsf_plugins;
+
+	if (HasMagic(data, size, 0, "FRM8"))
+		return dsdiff_plugins;
+
+	if (HasMagic(data, size, 0, "MThd"))
+		return midi_plugins;
+
+	if (HasMagic(data, size, 0, "PSID") ||
+	    HasMagic(data, size, 0, "RSID"))
+		return sid_plugins;
+
+	if (HasMagic(data, size, 0, "ADIF"))
+		return aac_plugins;
+
+	if (HasMagic(data, size, 4, "ftyp") ||
+	    HasMagic(data, size, 0, "MAC ") ||
+	    HasMagic(data, size, 0, "\x30\x26\xb2\x75\x8e\x66\xcf\x11"))
+		/* MP4, Monkey's Audio, ASF */
+		return ffmpeg_plugins;
+
+	if (size >= 2 && data[0] == 0xff && (data[1] & 0xe0) == 0xe0) {
+		/* MPEG audio frame sync; layer "0" is used by the
+		   AAC ADTS header */
+		if ((data[1] & 0x16) == 0x10)
+			return aac_plugins;
+
+		if ((data[1] & 0x06) != 0)
+			return mp3_plugins;
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_PROBE_HXX
+#define MPD_DECODER_PROBE_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+
+struct DecoderPlugin;
+
+/*
+ * Helpers which let the decoder thread find the right plugin for a
+ * stream with few failed attempts.  Each failed attempt means that
+ * the stream has to be rewound, which is expensive for remote
+ * resources.
+ */
+
+/**
+ * How many bytes does decoder_sniff() want to see?
+ */
+static constexpr size_t DECODER_SNIFF_SIZE = 64;
+
+/**
+ * Look up the plugin which has most recently decoded a stream with
+ * the same suffix and MIME type.  This function is thread-safe.
+ *
+ * @param suffix the file name suffix or nullptr
+ * @param mime_type the MIME type or nullptr
+ * @return the plugin, or nullptr if none is known
+ */
+gcc_pure
+const DecoderPlugin *
+decoder_probe_cache_lookup(const char *suffix, const char *mime_type);
+
+/**
+ * Remember that a stream with this suffix and MIME type was decoded
+ * successfully by the specified plugin.  This function is
+ * thread-safe.
+ */
+void
+decoder_probe_cache_store(const char *suffix, const char *mime_type,
+			  const DecoderPlugin &plugin);
+
+/**
+ * Guess the format of a stream from its first bytes ("magic").
+ *
+ * @param data the beginning of the stream
+ * @param size the number of bytes at #data; should be at least
+ * #DECODER_SNIFF_SIZE unless the stream is shorter
+ * @return a nullptr-terminated list of decoder plugin names which
+ * can decode this format, in the order of preference, or nullptr if
+ * the format is unknown
+ */
+gcc_pure
+const char *const*
+decoder_sniff(const void *data, size_t size);
+
+#endif
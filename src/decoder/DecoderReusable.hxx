@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_REUSABLE_HXX
+#define MPD_DECODER_REUSABLE_HXX
+
+struct DecoderPlugin;
+
+/**
+ * Base class for the state of a decoder plugin which can be reused
+ * to decode the next song, e.g. a codec instance whose setup is
+ * expensive.  The plugin passes it to decoder_keep_state() when it
+ * has finished a song, and claims it again with decoder_take_state()
+ * when it starts the next one; it is then the plugin's task to check
+ * whether the parameters are still the same.
+ */
+class DecoderReusableState {
+public:
+	/**
+	 * The plugin which has created this object.  Only this plugin
+	 * can take it.
+	 */
+	const DecoderPlugin &plugin;
+
+	explicit DecoderReusableState(const DecoderPlugin &_plugin)
+		:plugin(_plugin) {}
+
+	DecoderReusableState(const DecoderReusableState &) = delete;
+	DecoderReusableState &operator=(const DecoderReusableState &) = delete;
+
+	virtual ~DecoderReusableState() {}
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include "DecoderInternal.hxx"
 #include "DecoderError.hxx"
 #include "DecoderPlugin.hxx"
+#include "DecoderProbe.hxx"
 #include "DetachedSong.hxx"
 #include "system/FatalError.hxx"
 #include "fs/Traits.hxx"
@@ -30,14 +31,24 @@
 #include "DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "DecoderList.hxx"
+#include "DecoderCache.hxx"
 #include "util/UriUtil.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "thread/Policy.hxx"
 #include "tag/ApeReplayGain.hxx"
+#include "tag/Tag.hxx"
 #include "Log.hxx"
 
-#include <functional>
+#ifdef ENABLE_SYNTH_CACHE
+#include "SynthCache.hxx"
+#include "fs/FileSystem.hxx"
+#endif
+
+#include <algorithm>
+
+#include <stdint.h>
 
 static constexpr Domain decoder_thread_domain("decoder_thread");
 
@@ -69,16 +80,24 @@ decoder_command_finished_locked(DecoderControl &dc)
  * received, nullptr on error
  */
 static InputStream *
-decoder_input_stream_open(DecoderControl &dc, const char *uri)
+decoder_input_stream_open(Decoder &decoder, const char *uri)
 {
+	DecoderControl &dc = decoder.dc;
 	Error error;
 
-	InputStream *is = InputStream::Open(uri, dc.mutex, dc.cond, error);
-	if (is == nullptr) {
-		if (error.IsDefined())
-			LogError(error);
-
-		return nullptr;
+	InputStream *is = decoder.prefetched_stream;
+	if (is != nullptr) {
+		decoder.prefetched_stream = nullptr;
+		FormatDebug(decoder_thread_domain,
+			    "using prefetched stream %s", uri);
+	} else {
+		is = InputStream::Open(uri, dc.mutex, dc.cond, error);
+		if (is == nullptr) {
+			if (error.IsDefined())
+				LogError(error);
+
+			return nullptr;
+		}
 	}
 
 	/* wait for the input stream to become ready; its metadata
@@ -106,6 +125,113 @@ decoder_input_stream_open(DecoderControl &dc, const char *uri)
 	return is;
 }
 
+/**
+ * Returns the string which is passed to InputStream::Open() for the
+ * specified song: the file system path of a local file, or the URI.
+ */
+static std::string
+decoder_stream_uri(const DetachedSong &song)
+{
+	const char *const uri_utf8 = song.GetRealURI();
+	if (PathTraitsUTF8::IsAbsolute(uri_utf8)) {
+		const auto path_fs = AllocatedPath::FromUTF8(uri_utf8);
+		if (!path_fs.IsNull())
+			return path_fs.c_str();
+	}
+
+	return uri_utf8;
+}
+
+void
+decoder_prefetch(DecoderControl &dc)
+{
+	dc.Lock();
+	if (dc.prefetch_song == nullptr) {
+		dc.Unlock();
+		return;
+	}
+
+	const std::string uri = decoder_stream_uri(*dc.prefetch_song);
+	dc.Unlock();
+
+	/* don't try again if it fails */
+	dc.prefetch_uri = uri;
+
+	FormatDebug(decoder_thread_domain, "prefetching %s", uri.c_str());
+
+	Error error;
+	InputStream *is = InputStream::Open(uri.c_str(), dc.mutex, dc.cond,
+					    error);
+	if (is == nullptr) {
+		if (error.IsDefined())
+			LogError(error);
+
+		return;
+	}
+
+	/* wait for the stream to become ready, but don't delay
+	   decoder commands; an unready stream is finished by
+	   decoder_input_stream_open() */
+
+	dc.Lock();
+
+	is->Update();
+	while (!is->IsReady() && dc.command == DecoderCommand::NONE) {
+		dc.Wait();
+
+		is->Update();
+	}
+
+	if (!is->Check(error)) {
+		dc.Unlock();
+
+		LogError(error);
+		delete is;
+		return;
+	}
+
+	if (is->IsReady() && is->IsSeekable()) {
+		/* read the beginning of the file into the kernel's
+		   cache, which hides the latency of network file
+		   systems */
+		char buffer[4096];
+		is->Read(buffer, sizeof(buffer), IgnoreError());
+		is->Rewind(IgnoreError());
+	}
+
+	dc.Unlock();
+
+	dc.prefetch_stream = is;
+}
+
+/**
+ * Move the stream opened by decoder_prefetch() to the #Decoder if it
+ * belongs to the specified URI, and close it otherwise.
+ *
+ * Caller must lock the #DecoderControl object.
+ */
+static void
+decoder_take_prefetch(Decoder &decoder, const char *uri)
+{
+	DecoderControl &dc = decoder.dc;
+
+	InputStream *is = dc.prefetch_stream;
+	dc.prefetch_stream = nullptr;
+
+	if (is != nullptr && dc.prefetch_uri == uri) {
+		decoder.prefetched_stream = is;
+		is = nullptr;
+	}
+
+	dc.prefetch_uri.clear();
+
+	if (is != nullptr) {
+		dc.Unlock();
+		delete is;
+		dc.Lock();
+	}
+}
+
 static bool
 decoder_stream_decode(const DecoderPlugin &plugin,
 		      Decoder &decoder,
@@ -202,17 +328,62 @@ decoder_check_plugin(const DecoderPlugin &plugin, const InputStream &is,
 		 decoder_check_plugin_suffix(plugin, suffix));
 }
 
+/**
+ * Attempt to decode the stream with the specified plugin, and
+ * remember it in the probe cache if it was successful.
+ */
 static bool
-decoder_run_stream_plugin(Decoder &decoder, InputStream &is,
-			  const char *suffix,
-			  const DecoderPlugin &plugin,
-			  bool &tried_r)
+decoder_stream_probe(const DecoderPlugin &plugin, Decoder &decoder,
+		     InputStream &is,
+		     const char *suffix, const char *mime_type)
 {
-	if (!decoder_check_plugin(plugin, is, suffix))
+	if (!decoder_stream_decode(plugin, decoder, is))
 		return false;
 
-	tried_r = true;
-	return decoder_stream_decode(plugin, decoder, is);
+	if (decoder.dc.state != DecoderState::START)
+		decoder_probe_cache_store(suffix, mime_type, plugin);
+
+	return true;
+}
+
+/**
+ * Read the first bytes of the stream and look up a plugin which
+ * recognizes their "magic".  The stream is rewound afterwards.
+ *
+ * Caller must lock the #DecoderControl object.
+ */
+static const DecoderPlugin *
+decoder_sniff_stream(Decoder &decoder, InputStream &is)
+{
+	if (decoder.dc.command == DecoderCommand::STOP ||
+	    !is.Rewind(IgnoreError()))
+		return nullptr;
+
+	uint8_t buffer[DECODER_SNIFF_SIZE];
+	size_t length = 0;
+	while (length < sizeof(buffer)) {
+		size_t nbytes = is.Read(buffer + length,
+					sizeof(buffer) - length,
+					IgnoreError());
+		if (nbytes == 0)
+			break;
+
+		length += nbytes;
+	}
+
+	is.Rewind(IgnoreError());
+
+	const char *const*names = decoder_sniff(buffer, length);
+	if (names == nullptr)
+		return nullptr;
+
+	for (; *names != nullptr; ++names) {
+		const DecoderPlugin *plugin = decoder_plugin_from_name(*names);
+		if (plugin != nullptr && plugin->stream_decode != nullptr)
+			return plugin;
+	}
+
+	return nullptr;
 }
 
 static bool
@@ -220,12 +391,33 @@ decoder_run_stream_locked(Decoder &decoder, InputStream &is,
 			  const char *uri, bool &tried_r)
 {
 	const char *const suffix = uri_get_suffix(uri);
+	const char *const mime_type = is.GetMimeType();
+
+	/* first try the plugin which has decoded the last stream of
+	   this kind; if there is none or if it fails, look at the
+	   first bytes; each failed attempt costs a rewind, which is
+	   expensive for remote streams */
+
+	const DecoderPlugin *const cached =
+		decoder_probe_cache_lookup(suffix, mime_type);
+	if (cached != nullptr && cached->stream_decode != nullptr &&
+	    decoder_stream_probe(*cached, decoder, is, suffix, mime_type))
+		return true;
+
+	const DecoderPlugin *const sniffed = decoder_sniff_stream(decoder, is);
+	if (sniffed != nullptr && sniffed != cached &&
+	    decoder_stream_probe(*sniffed, decoder, is, suffix, mime_type))
+		return true;
+
+	return decoder_plugins_try([&](const DecoderPlugin &plugin){
+			if (&plugin == cached || &plugin == sniffed ||
+			    !decoder_check_plugin(plugin, is, suffix))
+				return false;
 
-	using namespace std::placeholders;
-	const auto f = std::bind(decoder_run_stream_plugin,
-				 std::ref(decoder), std::ref(is), suffix,
-				 _1, std::ref(tried_r));
-	return decoder_plugins_try(f);
+			tried_r = true;
+			return decoder_stream_probe(plugin, decoder, is,
+						    suffix, mime_type);
+		});
 }
 
 /**
@@ -253,7 +445,7 @@ decoder_run_stream(Decoder &decoder, const char *uri)
 
 	dc.Unlock();
 
-	input_stream = decoder_input_stream_open(dc, uri);
+	input_stream = decoder_input_stream_open(decoder, uri);
 	if (input_stream == nullptr) {
 		dc.Lock();
 		return false;
@@ -290,12 +482,8 @@ decoder_load_replay_gain(Decoder &decoder, Path path_fs)
 }
 
 static bool
-TryDecoderFile(Decoder &decoder, Path path_fs, const char *suffix,
-	       const DecoderPlugin &plugin)
+DecodeFileWith(Decoder &decoder, Path path_fs, const DecoderPlugin &plugin)
 {
-	if (!plugin.SupportsSuffix(suffix))
-		return false;
-
 	DecoderControl &dc = decoder.dc;
 
 	if (plugin.file_decode != nullptr) {
@@ -307,7 +495,7 @@ TryDecoderFile(Decoder &decoder, Path path_fs, const char *suffix,
 		dc.Unlock();
 	} else if (plugin.stream_decode != nullptr) {
 		InputStream *input_stream =
-			decoder_input_stream_open(dc, path_fs.c_str());
+			decoder_input_stream_open(decoder, path_fs.c_str());
 		if (input_stream == nullptr)
 			return false;
 
@@ -329,6 +517,118 @@ TryDecoderFile(Decoder &decoder, Path path_fs, const char *suffix,
 	return false;
 }
 
+#ifdef ENABLE_SYNTH_CACHE
+
+/**
+ * Play a song which has been rendered into the synth cache before.
+ *
+ * @return true if the FLAC decoder has played it (the
+ * #DecoderControl is locked then)
+ */
+static bool
+decoder_play_synth_cache(Decoder &decoder, Path cache_path)
+{
+	const DecoderPlugin *flac = decoder_plugin_from_name("flac");
+	if (flac == nullptr || !FileExists(cache_path))
+		return false;
+
+	DecoderControl &dc = decoder.dc;
+
+	Error error;
+	InputStream *is = InputStream::OpenReady(cache_path.c_str(),
+						 dc.mutex, dc.cond, error);
+	if (is == nullptr) {
+		if (error.IsDefined())
+			LogError(error);
+		return false;
+	}
+
+	FormatDebug(decoder_thread_domain, "playing %s from the synth cache",
+		    cache_path.c_str());
+
+	dc.Lock();
+	const bool success = decoder_stream_decode(*flac, decoder, *is);
+	dc.Unlock();
+
+	delete is;
+
+	if (success)
+		dc.Lock();
+	return success;
+}
+
+/**
+ * Like DecodeFileWith(), but play the song from the synth cache if
+ * it has been rendered before, or else store the output of the
+ * plugin in the cache.
+ */
+static bool
+TryDecoderFileCached(Decoder &decoder, Path path_fs,
+		     const DecoderPlugin &plugin)
+{
+	DecoderControl &dc = decoder.dc;
+
+	AllocatedPath cache_path = synth_cache_path(plugin, path_fs);
+	if (cache_path.IsNull())
+		return DecodeFileWith(decoder, path_fs, plugin);
+
+	if (decoder_play_synth_cache(decoder, cache_path))
+		return true;
+
+	/* only a complete linear rendering can be cached */
+	if (dc.start_ms == 0 && dc.end_ms == 0 &&
+	    decoder.synth_cache == nullptr) {
+		Error error;
+		decoder.synth_cache = synth_cache_create(std::move(cache_path),
+							 error);
+		if (decoder.synth_cache == nullptr)
+			LogError(error);
+	}
+
+	const bool success = DecodeFileWith(decoder, path_fs, plugin);
+
+	if (decoder.synth_cache != nullptr) {
+		/* the plugin has rendered the whole song if it has
+		   finished without being stopped (seeking has
+		   discarded the writer already) */
+		const bool complete = success &&
+			dc.command == DecoderCommand::NONE &&
+			!decoder.error.IsDefined();
+
+		if (success)
+			dc.Unlock();
+
+		Error error;
+		if (complete && !decoder.synth_cache->Commit(error))
+			LogError(error);
+
+		delete decoder.synth_cache;
+		decoder.synth_cache = nullptr;
+
+		if (success)
+			dc.Lock();
+	}
+
+	return success;
+}
+
+#endif
+
+static bool
+TryDecoderFile(Decoder &decoder, Path path_fs, const char *suffix,
+	       const DecoderPlugin &plugin)
+{
+	if (!plugin.SupportsSuffix(suffix))
+		return false;
+
+#ifdef ENABLE_SYNTH_CACHE
+	if (synth_cache_wants(plugin))
+		return TryDecoderFileCached(decoder, path_fs, plugin);
+#endif
+
+	return DecodeFileWith(decoder, path_fs, plugin);
+}
+
 /**
  * Try decoding a file.
  */
@@ -344,54 +644,184 @@ decoder_run_file(Decoder &decoder, const char *uri_utf8, Path path_fs)
 
 	decoder_load_replay_gain(decoder, path_fs);
 
-	if (decoder_plugins_try([&decoder, path_fs,
-				 suffix](const DecoderPlugin &plugin){
-				return TryDecoderFile(decoder,
-						      path_fs, suffix,
-						      plugin);
-			}))
+	/* try the plugin which has decoded the last file with this
+	   suffix first */
+	const DecoderPlugin *const cached =
+		decoder_probe_cache_lookup(suffix, nullptr);
+	const DecoderPlugin *decoded_by = nullptr;
+
+	const auto f = [&decoder, path_fs, suffix,
+			&decoded_by](const DecoderPlugin &plugin){
+		if (!TryDecoderFile(decoder, path_fs, suffix, plugin))
+			return false;
+
+		decoded_by = &plugin;
+		return true;
+	};
+
+	if ((cached != nullptr && f(*cached)) ||
+	    decoder_plugins_try([cached, &f](const DecoderPlugin &plugin){
+			    return &plugin != cached && f(plugin);
+		    })) {
+		if (dc.state != DecoderState::START)
+			decoder_probe_cache_store(suffix, nullptr,
+						  *decoded_by);
 		return true;
+	}
 
 	dc.Lock();
 	return false;
 }
 
+/**
+ * Submit a song from the #DecoderCache to the #MusicPipe, as if it
+ * was decoded by a plugin.
+ *
+ * Caller must not lock the #DecoderControl object.
+ */
+static void
+decoder_play_cached(Decoder &decoder, const DecodedSong &song)
+{
+	decoder_initialized(decoder, song.audio_format, true, song.total_time);
+
+	if (song.has_replay_gain)
+		decoder_replay_gain(decoder, &song.replay_gain_info);
+
+	if (!song.tag.IsEmpty())
+		decoder_tag(decoder, nullptr, Tag(song.tag));
+
+	const size_t frame_size = song.audio_format.GetFrameSize();
+	const size_t max_nbytes = std::max(8192 / frame_size, size_t(1))
+		* frame_size;
+	const uint8_t *const data = song.data.data();
+	const size_t size = song.data.size();
+
+	size_t position = 0;
+	while (position < size) {
+		const size_t nbytes = std::min(size - position, max_nbytes);
+		const DecoderCommand cmd =
+			decoder_data(decoder, nullptr, data + position,
+				     nbytes, 0);
+		position += nbytes;
+
+		if (cmd == DecoderCommand::SEEK) {
+			const uint64_t frame =
+				uint64_t(decoder_seek_where(decoder) *
+					 song.audio_format.sample_rate);
+			if (frame * frame_size <= size) {
+				position = frame * frame_size;
+				decoder_command_finished(decoder);
+			} else
+				decoder_seek_error(decoder);
+		} else if (cmd != DecoderCommand::NONE)
+			break;
+	}
+}
+
+/**
+ * Add the song which has just been decoded to the #DecoderCache.
+ *
+ * Caller must not lock the #DecoderControl object.
+ */
+static void
+decoder_cache_store(Decoder &decoder, const char *uri)
+{
+	DecodedSong *song = decoder.decoded_song;
+	decoder.decoded_song = nullptr;
+
+	if (decoder.replay_gain_serial != 0) {
+		song->replay_gain_info = decoder.replay_gain_info;
+		song->has_replay_gain = true;
+	}
+
+	if (decoder.decoder_tag != nullptr)
+		song->tag = Tag(*decoder.decoder_tag);
+
+	FormatDebug(decoder_thread_domain, "storing %s in the decoder cache",
+		    uri);
+	decoder_cache->Put(uri, song);
+}
+
+/**
+ * @param song_uri the URI of the song for error messages
+ */
 static void
 decoder_run_song(DecoderControl &dc,
-		 const DetachedSong &song, const char *uri, Path path_fs)
+		 const char *song_uri, const char *uri, Path path_fs)
 {
 	Decoder decoder(dc, dc.start_ms > 0,
-			new Tag(song.GetTag()));
+			new Tag(dc.song->GetTag()));
 	int ret;
 
-	dc.state = DecoderState::START;
+	dc.SetState(DecoderState::START);
+
+	decoder_take_prefetch(decoder, !path_fs.IsNull()
+			      ? path_fs.c_str()
+			      : uri);
 
 	decoder_command_finished_locked(dc);
 
-	ret = !path_fs.IsNull()
-		? decoder_run_file(decoder, uri, path_fs)
-		: decoder_run_stream(decoder, uri);
+	/* only songs which are played completely from the start can
+	   be cached */
+	const bool cacheable = decoder_cache != nullptr &&
+		dc.start_ms == 0 && dc.end_ms == 0 &&
+		dc.song->GetStartMS() == 0 && dc.song->GetEndMS() == 0;
+
+	const auto cached = cacheable
+		? decoder_cache->Get(uri)
+		: nullptr;
+	if (cached) {
+		FormatDebug(decoder_thread_domain,
+			    "playing %s from the decoder cache", uri);
+
+		dc.Unlock();
+		decoder_play_cached(decoder, *cached);
+		dc.Lock();
+		ret = true;
+	} else {
+		decoder.cacheable = cacheable;
+		ret = !path_fs.IsNull()
+			? decoder_run_file(decoder, uri, path_fs)
+			: decoder_run_stream(decoder, uri);
+	}
+
+	/* the song has been decoded completely if the plugin has
+	   finished without being stopped (seeking has discarded the
+	   recording already) */
+	const bool complete = ret && dc.command == DecoderCommand::NONE &&
+		!decoder.error.IsDefined();
 
 	dc.Unlock();
 
+	if (decoder.decoded_song != nullptr && complete)
+		decoder_cache_store(decoder, uri);
+
+	/* the decoder plugin did not need the prefetched stream */
+	delete decoder.prefetched_stream;
+	decoder.prefetched_stream = nullptr;
+
 	/* flush the last chunk */
 
 	if (decoder.chunk != nullptr)
 		decoder.FlushChunk();
 
+	/* give the cached chunks back before the player is notified
+	   about the new state */
+	decoder.chunk_cache.Flush();
+
 	dc.Lock();
 
 	if (decoder.error.IsDefined()) {
 		/* copy the Error from sruct Decoder to
 		   DecoderControl */
-		dc.state = DecoderState::ERROR;
+		dc.SetState(DecoderState::ERROR);
 		dc.error = std::move(decoder.error);
 	} else if (ret)
-		dc.state = DecoderState::STOP;
+		dc.SetState(DecoderState::STOP);
 	else {
-		dc.state = DecoderState::ERROR;
+		dc.SetState(DecoderState::ERROR);
 
-		const char *error_uri = song.GetURI();
+		const char *error_uri = song_uri;
 		const std::string allocated = uri_remove_auth(error_uri);
 		if (!allocated.empty())
 			error_uri = allocated.c_str();
@@ -409,16 +839,20 @@ decoder_run(DecoderControl &dc)
 	dc.ClearError();
 
 	assert(dc.song != nullptr);
-	const DetachedSong &song = *dc.song;
 
-	const char *const uri_utf8 = song.GetRealURI();
+	/* copy the URIs, because the song object is replaced when
+	   decoding continues into the next track of a CUE sheet (see
+	   DecoderControl::IsPrefetchContinuation()) */
+	const std::string song_uri = dc.song->GetURI();
+	const std::string real_uri = dc.song->GetRealURI();
+	const char *const uri_utf8 = real_uri.c_str();
 
 	Path path_fs = Path::Null();
 	AllocatedPath path_buffer = AllocatedPath::Null();
 	if (PathTraitsUTF8::IsAbsolute(uri_utf8)) {
 		path_buffer = AllocatedPath::FromUTF8(uri_utf8, dc.error);
 		if (path_buffer.IsNull()) {
-			dc.state = DecoderState::ERROR;
+			dc.SetState(DecoderState::ERROR);
 			decoder_command_finished_locked(dc);
 			return;
 		}
@@ -426,7 +860,7 @@ decoder_run(DecoderControl &dc)
 		path_fs = path_buffer;
 	}
 
-	decoder_run_song(dc, song, uri_utf8, path_fs);
+	decoder_run_song(dc, song_uri.c_str(), uri_utf8, path_fs);
 
 }
 
@@ -437,6 +871,10 @@ decoder_task(void *arg)
 
 	SetThreadName("decoder");
 
+	Error policy_error;
+	if (!ApplyThreadPolicy(ThreadClass::DECODER, policy_error))
+		LogError(policy_error);
+
 	dc.Lock();
 
 	do {
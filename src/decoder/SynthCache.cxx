@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "SynthCache.hxx"
+#include "DecoderPlugin.hxx"
+#include "encoder/EncoderPlugin.hxx"
+#include "encoder/plugins/FlacEncoderPlugin.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/ConfigData.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+static constexpr Domain synth_cache_domain("synth_cache");
+
+/**
+ * The plugins which synthesize audio instead of decoding it; their
+ * output is expensive to produce, but compresses well.
+ */
+static const char *const synth_cache_plugins[] = {
+	"fluidsynth",
+	"wildmidi",
+	"sidplay",
+	"gme",
+	"modplug",
+	nullptr
+};
+
+static const char *const SYNTH_CACHE_SUFFIX = ".flac";
+static const char *const SYNTH_CACHE_TMP_SUFFIX = ".tmp";
+
+/**
+ * The "synth_cache" block; the FLAC encoder reads its settings
+ * (e.g. "compression") from here, too.  nullptr if the cache is
+ * disabled.
+ */
+static const config_param *synth_cache_param;
+
+static AllocatedPath synth_cache_directory = AllocatedPath::Null();
+
+static uint64_t synth_cache_limit;
+
+/**
+ * Makes the names of temporary files unique, because two decoder
+ * threads (of different partitions) may render the same song.
+ */
+static std::atomic<unsigned> synth_cache_tmp_counter;
+
+gcc_pure
+static bool
+StringEndsWith(const char *s, const char *suffix)
+{
+	const size_t length = strlen(s), suffix_length = strlen(suffix);
+	return length >= suffix_length &&
+		memcmp(s + length - suffix_length, suffix, suffix_length) == 0;
+}
+
+/**
+ * Delete temporary files which were left behind by a crash.
+ */
+static void
+RemoveStaleTemporaryFiles(Path directory)
+{
+	DirectoryReader reader(directory);
+	if (reader.HasFailed())
+		return;
+
+	while (reader.ReadEntry()) {
+		const Path name = reader.GetEntry();
+		if (StringEndsWith(name.c_str(), SYNTH_CACHE_TMP_SUFFIX))
+			RemoveFile(AllocatedPath::Build(directory, name));
+	}
+}
+
+struct SynthCacheFile {
+	AllocatedPath path;
+	time_t mtime;
+	uint64_t size;
+
+	SynthCacheFile(AllocatedPath &&_path, time_t _mtime, uint64_t _size)
+		:path(std::move(_path)), mtime(_mtime), size(_size) {}
+
+	bool operator<(const SynthCacheFile &other) const {
+		return mtime < other.mtime;
+	}
+};
+
+/**
+ * Delete the least recently used cache files until the directory
+ * is below the configured size.  The modification time of a cache
+ * file is updated each time it is played.
+ */
+static void
+EvictCacheFiles(Path directory)
+{
+	DirectoryReader reader(directory);
+	if (reader.HasFailed())
+		return;
+
+	std::vector<SynthCacheFile> files;
+	uint64_t total = 0;
+
+	while (reader.ReadEntry()) {
+		const Path name = reader.GetEntry();
+		if (!StringEndsWith(name.c_str(), SYNTH_CACHE_SUFFIX))
+			continue;
+
+		auto path = AllocatedPath::Build(directory, name);
+		struct stat st;
+		if (!StatFile(path, st) || !S_ISREG(st.st_mode))
+			continue;
+
+		total += st.st_size;
+		files.emplace_back(std::move(path), st.st_mtime,
+				   st.st_size);
+	}
+
+	if (total <= synth_cache_limit)
+		return;
+
+	std::sort(files.begin(), files.end());
+
+	for (const auto &file : files) {
+		if (total <= synth_cache_limit)
+			break;
+
+		if (RemoveFile(file.path))
+			total -= file.size;
+	}
+}
+
+bool
+synth_cache_global_init(Error &error)
+{
+	const config_param *param = config_get_param(CONF_SYNTH_CACHE);
+	if (param == nullptr)
+		/* disabled */
+		return true;
+
+	AllocatedPath directory = param->GetBlockPath("directory", error);
+	if (directory.IsNull()) {
+		if (!error.IsDefined())
+			error.Set(synth_cache_domain,
+				  "No \"directory\" in \"synth_cache\"");
+		return false;
+	}
+
+	const unsigned size_kb = param->GetBlockValue("size",
+						      1024u * 1024u);
+
+	RemoveStaleTemporaryFiles(directory);
+
+	synth_cache_param = param;
+	synth_cache_directory = std::move(directory);
+	synth_cache_limit = uint64_t(size_kb) * 1024;
+	return true;
+}
+
+void
+synth_cache_global_finish()
+{
+	synth_cache_param = nullptr;
+	synth_cache_directory = AllocatedPath::Null();
+}
+
+bool
+synth_cache_wants(const DecoderPlugin &plugin)
+{
+	if (synth_cache_param == nullptr)
+		return false;
+
+	for (auto i = synth_cache_plugins; *i != nullptr; ++i)
+		if (strcmp(*i, plugin.name) == 0)
+			return true;
+
+	return false;
+}
+
+/**
+ * FNV-1a
+ */
+static void
+HashUpdate(uint64_t &hash, const void *_data, size_t length)
+{
+	const uint8_t *data = (const uint8_t *)_data;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+}
+
+static void
+HashString(uint64_t &hash, const char *s)
+{
+	/* include the null terminator as a separator */
+	HashUpdate(hash, s, strlen(s) + 1);
+}
+
+AllocatedPath
+synth_cache_path(const DecoderPlugin &plugin, Path path_fs)
+{
+	assert(synth_cache_param != nullptr);
+
+	/* a sub-song (e.g. "song.nsf/track_002.nsf") is not a
+	   real file; use the container's attributes instead */
+	struct stat st;
+	if (!StatFile(path_fs, st) &&
+	    !StatFile(AllocatedPath(path_fs).GetDirectoryName(), st))
+		return AllocatedPath::Null();
+
+	uint64_t hash = 14695981039346656037ULL;
+	HashString(hash, plugin.name);
+	HashString(hash, path_fs.c_str());
+
+	const uint64_t size = st.st_size, mtime = st.st_mtime;
+	HashUpdate(hash, &size, sizeof(size));
+	HashUpdate(hash, &mtime, sizeof(mtime));
+
+	/* the synthesizer settings (sound font, sample rate, ...)
+	   are part of the key */
+	const config_param *param =
+		config_find_block(CONF_DECODER, "plugin", plugin.name);
+	if (param != nullptr) {
+		for (const auto &i : param->block_params) {
+			HashString(hash, i.name.c_str());
+			HashString(hash, i.value.c_str());
+		}
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx%s",
+		 (unsigned long long)hash, SYNTH_CACHE_SUFFIX);
+	auto path = AllocatedPath::Build(synth_cache_directory, name);
+
+	/* mark it as recently used */
+	utime(path.c_str(), nullptr);
+
+	return path;
+}
+
+SynthCacheWriter *
+synth_cache_create(AllocatedPath &&path, Error &error)
+{
+	assert(synth_cache_param != nullptr);
+
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%u%s",
+		 synth_cache_tmp_counter.fetch_add(1),
+		 SYNTH_CACHE_TMP_SUFFIX);
+	auto tmp_path = AllocatedPath::FromFS(std::string(path.c_str()) +
+					      suffix);
+
+	int fd = OpenFile(tmp_path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	if (fd < 0) {
+		error.FormatErrno("Failed to create %s", tmp_path.c_str());
+		return nullptr;
+	}
+
+	Encoder *encoder = encoder_init(flac_encoder_plugin,
+					*synth_cache_param, error);
+	if (encoder == nullptr) {
+		close(fd);
+		RemoveFile(tmp_path);
+		return nullptr;
+	}
+
+	return new SynthCacheWriter(std::move(path), std::move(tmp_path),
+				    fd, encoder);
+}
+
+SynthCacheWriter::~SynthCacheWriter()
+{
+	if (audio_format.IsDefined())
+		encoder_close(encoder);
+	encoder_finish(encoder);
+
+	if (fd >= 0)
+		close(fd);
+
+	if (!committed)
+		RemoveFile(tmp_path);
+}
+
+bool
+SynthCacheWriter::Open(AudioFormat _audio_format, Error &error)
+{
+	assert(!audio_format.IsDefined());
+
+	AudioFormat encoder_format = _audio_format;
+	if (!encoder_open(encoder, encoder_format, error))
+		return false;
+
+	audio_format = _audio_format;
+
+	if (encoder_format != _audio_format) {
+		/* the FLAC encoder would need a conversion; these
+		   plugins emit 16 bit samples, so this is not worth
+		   the trouble */
+		struct audio_format_string af_string;
+		error.Format(synth_cache_domain,
+			     "Cannot cache audio format %s",
+			     audio_format_to_string(_audio_format,
+						    &af_string));
+		return false;
+	}
+
+	return WriteEncoderOutput(error);
+}
+
+bool
+SynthCacheWriter::WriteEncoderOutput(Error &error)
+{
+	uint8_t buffer[32768];
+
+	while (true) {
+		const size_t nbytes = encoder_read_all(encoder,
+						       { buffer,
+						         sizeof(buffer) });
+		if (nbytes == 0)
+			return true;
+
+		if (write(fd, buffer, nbytes) != ssize_t(nbytes)) {
+			error.FormatErrno("Failed to write %s",
+					  tmp_path.c_str());
+			return false;
+		}
+	}
+}
+
+bool
+SynthCacheWriter::Write(const void *data, size_t length, Error &error)
+{
+	assert(audio_format.IsDefined());
+
+	if (!encoder_write(encoder, { data, length }, error))
+		return false;
+
+	n_frames += length / audio_format.GetFrameSize();
+	return WriteEncoderOutput(error);
+}
+
+bool
+SynthCacheWriter::PatchStreamInfo(Error &error)
+{
+	/* "fLaC", the metadata block header, and 18 bytes of
+	   STREAMINFO up to the end of the sample count */
+	uint8_t header[26];
+	if (pread(fd, header, sizeof(header), 0) != ssize_t(sizeof(header)) ||
+	    memcmp(header, "fLaC", 4) != 0 ||
+	    (header[4] & 0x7f) != 0) {
+		error.Format(synth_cache_domain,
+			     "No STREAMINFO in %s", tmp_path.c_str());
+		return false;
+	}
+
+	/* the sample count is 36 bits wide, starting in the lower
+	   half of byte 13 of STREAMINFO */
+	uint8_t *const p = header + 8 + 13;
+	p[0] = (p[0] & 0xf0) | uint8_t((n_frames >> 32) & 0x0f);
+	p[1] = uint8_t(n_frames >> 24);
+	p[2] = uint8_t(n_frames >> 16);
+	p[3] = uint8_t(n_frames >> 8);
+	p[4] = uint8_t(n_frames);
+
+	if (pwrite(fd, p, 5, p - header) != 5) {
+		error.FormatErrno("Failed to write %s", tmp_path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool
+SynthCacheWriter::Commit(Error &error)
+{
+	assert(!committed);
+
+	if (!audio_format.IsDefined() || n_frames == 0 ||
+	    n_frames >= (uint64_t(1) << 36)) {
+		error.Set(synth_cache_domain, "Nothing to cache");
+		return false;
+	}
+
+	if (!encoder_end(encoder, error) ||
+	    !WriteEncoderOutput(error) ||
+	    !PatchStreamInfo(error))
+		return false;
+
+	const int result = close(fd);
+	fd = -1;
+	if (result < 0) {
+		error.FormatErrno("Failed to write %s", tmp_path.c_str());
+		return false;
+	}
+
+	if (!RenameFile(tmp_path, path)) {
+		error.FormatErrno("Failed to rename %s", tmp_path.c_str());
+		return false;
+	}
+
+	committed = true;
+
+	FormatDebug(synth_cache_domain, "stored %s", path.c_str());
+
+	EvictCacheFiles(synth_cache_directory);
+	return true;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_SYNTH_CACHE_HXX
+#define MPD_DECODER_SYNTH_CACHE_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Error;
+class Path;
+struct Encoder;
+struct DecoderPlugin;
+
+/**
+ * Writes the output of a synthesizing decoder plugin (MIDI, module
+ * and chiptune formats) to a FLAC file in the "synth_cache"
+ * directory.  The file is only added to the cache by Commit() after
+ * the whole song has been rendered linearly; the destructor discards
+ * an incomplete file.
+ */
+class SynthCacheWriter {
+	const AllocatedPath path;
+	const AllocatedPath tmp_path;
+
+	int fd;
+
+	Encoder *encoder;
+
+	AudioFormat audio_format;
+
+	/**
+	 * The number of frames which have been passed to the
+	 * encoder.
+	 */
+	uint64_t n_frames;
+
+	bool committed;
+
+public:
+	SynthCacheWriter(AllocatedPath &&_path, AllocatedPath &&_tmp_path,
+			 int _fd, Encoder *_encoder)
+		:path(std::move(_path)), tmp_path(std::move(_tmp_path)),
+		 fd(_fd), encoder(_encoder),
+		 audio_format(AudioFormat::Undefined()),
+		 n_frames(0), committed(false) {}
+
+	~SynthCacheWriter();
+
+	SynthCacheWriter(const SynthCacheWriter &) = delete;
+	SynthCacheWriter &operator=(const SynthCacheWriter &) = delete;
+
+	/**
+	 * Called by decoder_initialized() with the plugin's audio
+	 * format.
+	 *
+	 * @return false if this format cannot be cached
+	 */
+	bool Open(AudioFormat _audio_format, Error &error);
+
+	/**
+	 * Pass PCM data from decoder_data() to the encoder.
+	 */
+	bool Write(const void *data, size_t length, Error &error);
+
+	/**
+	 * The song has been rendered completely: finish the FLAC
+	 * file and move it into the cache.
+	 */
+	bool Commit(Error &error);
+
+private:
+	bool WriteEncoderOutput(Error &error);
+
+	/**
+	 * Store the number of frames in the STREAMINFO block, which
+	 * the encoder could not do because it writes to a pipe-like
+	 * callback.  Without it, the FLAC decoder would not know the
+	 * duration and could not seek.
+	 */
+	bool PatchStreamInfo(Error &error);
+};
+
+bool
+synth_cache_global_init(Error &error);
+
+void
+synth_cache_global_finish();
+
+/**
+ * Is the output of this decoder plugin worth caching?
+ */
+gcc_pure
+bool
+synth_cache_wants(const DecoderPlugin &plugin);
+
+/**
+ * Determine the cache file for the given song rendered by the given
+ * plugin.  The key covers the file name, size and modification time
+ * and the plugin's configuration.
+ *
+ * @return the path (which may not exist yet) or "null" if the cache
+ * is disabled or the file cannot be accessed
+ */
+gcc_pure
+AllocatedPath
+synth_cache_path(const DecoderPlugin &plugin, Path path_fs);
+
+/**
+ * Prepare writing the cache file.
+ *
+ * @return the writer or nullptr on error
+ */
+SynthCacheWriter *
+synth_cache_create(AllocatedPath &&path, Error &error);
+
+#endif
@@ -33,6 +33,7 @@
 #include "CheckAudioFormat.hxx"
 #include "util/bit_reverse.h"
 #include "util/Error.hxx"
+#include "util/WritableBuffer.hxx"
 #include "system/ByteOrder.hxx"
 #include "tag/TagHandler.hxx"
 #include "DsdLib.hxx"
@@ -379,25 +380,70 @@ dsdiff_decode_chunk(Decoder &decoder, InputStream &is,
 	const size_t buffer_size = buffer_samples * sample_size;
 
 	while (chunk_size > 0) {
+		if (!lsbitfirst) {
+			/* pass the samples of a memory-mapped file to
+			   the music pipe without an intermediate
+			   copy */
+			size_t now_size = buffer_size;
+			if (chunk_size < (uint64_t)now_size) {
+				unsigned now_frames =
+					(unsigned)chunk_size / frame_size;
+				now_size = now_frames * frame_size;
+			}
+
+			const auto direct =
+				decoder_read_direct(decoder, is, now_size);
+			if (!direct.IsNull()) {
+				if (direct.size != now_size)
+					return false;
+
+				chunk_size -= direct.size;
+
+				const auto cmd =
+					decoder_data(decoder, is,
+						     direct.data, direct.size,
+						     0);
+				if (cmd == DecoderCommand::NONE)
+					continue;
+
+				if (cmd == DecoderCommand::SEEK) {
+					/* Not implemented yet */
+					decoder_seek_error(decoder);
+					continue;
+				}
+
+				return false;
+			}
+		}
+
+		/* read directly into the music pipe if possible;
+		   DSD samples are passed as they are */
+		const auto dest = decoder_get_buffer(decoder, 0);
+		uint8_t *const p = dest.IsNull()
+			? buffer
+			: (uint8_t *)dest.data;
+
 		/* see how much aligned data from the remaining chunk
-		   fits into the local buffer */
-		size_t now_size = buffer_size;
+		   fits into the buffer */
+		size_t now_size = dest.IsNull() ? buffer_size : dest.size;
 		if (chunk_size < (uint64_t)now_size) {
 			unsigned now_frames =
 				(unsigned)chunk_size / frame_size;
 			now_size = now_frames * frame_size;
 		}
 
-		size_t nbytes = decoder_read(decoder, is, buffer, now_size);
+		size_t nbytes = decoder_read(decoder, is, p, now_size);
 		if (nbytes != now_size)
 			return false;
 
 		chunk_size -= nbytes;
 
 		if (lsbitfirst)
-			bit_reverse_buffer(buffer, buffer + nbytes);
+			bit_reverse_buffer(p, p + nbytes);
 
-		const auto cmd = decoder_data(decoder, is, buffer, nbytes, 0);
+		const auto cmd = dest.IsNull()
+			? decoder_data(decoder, is, buffer, nbytes, 0)
+			: decoder_commit_data(decoder, is, nbytes);
 		switch (cmd) {
 		case DecoderCommand::NONE:
 			break;
@@ -195,21 +195,13 @@ bit_reverse_buffer(uint8_t *p, uint8_t *end)
  * order.
  */
 static void
-dsf_to_pcm_order(uint8_t *dest, uint8_t *scratch, size_t nrbytes)
+dsf_to_pcm_order(uint8_t *dest, const uint8_t *src, size_t nrbytes)
 {
-	for (unsigned i = 0, j = 0; i < (unsigned)nrbytes; i += 2) {
-		scratch[i] = *(dest+j);
-		j++;
-	}
-
-	for (unsigned i = 1, j = 0; i < (unsigned) nrbytes; i += 2) {
-		scratch[i] = *(dest+4096+j);
-		j++;
-	}
+	const uint8_t *left = src, *right = src + 4096;
 
-	for (unsigned i = 0; i < (unsigned)nrbytes; i++) {
-		*dest = scratch[i];
-		dest++;
+	for (size_t i = 0; i < nrbytes / 2; ++i) {
+		*dest++ = left[i];
+		*dest++ = right[i];
 	}
 }
 
@@ -224,9 +216,9 @@ dsf_decode_chunk(Decoder &decoder, InputStream &is,
 {
 	uint8_t buffer[8192];
 
-	/* scratch buffer for DSF samples to convert to the needed
-	   normal left/right regime of samples */
-	uint8_t dsf_scratch_buffer[8192];
+	/* the samples converted to the needed normal left/right
+	   regime */
+	uint8_t dsf_pcm_buffer[8192];
 
 	const size_t sample_size = sizeof(buffer[0]);
 	const size_t frame_size = channels * sample_size;
@@ -244,18 +236,35 @@ dsf_decode_chunk(Decoder &decoder, InputStream &is,
 			now_size = now_frames * frame_size;
 		}
 
-		size_t nbytes = decoder_read(&decoder, is, buffer, now_size);
+		/* a memory-mapped file can be converted in place;
+		   this is only done for complete blocks, because
+		   dsf_to_pcm_order() looks at the full block */
+		const uint8_t *src;
+		size_t nbytes;
+		const auto direct = now_size == sizeof(buffer)
+			? decoder_read_direct(decoder, is, now_size)
+			: ConstBuffer<void>::Null();
+		if (!direct.IsNull()) {
+			src = (const uint8_t *)direct.data;
+			nbytes = direct.size;
+		} else {
+			src = buffer;
+			nbytes = decoder_read(&decoder, is, buffer, now_size);
+		}
+
 		if (nbytes != now_size)
 			return false;
 
 		chunk_size -= nbytes;
 
-		if (bitreverse)
-			bit_reverse_buffer(buffer, buffer + nbytes);
+		dsf_to_pcm_order(dsf_pcm_buffer, src, nbytes);
 
-		dsf_to_pcm_order(buffer, dsf_scratch_buffer, nbytes);
+		if (bitreverse)
+			bit_reverse_buffer(dsf_pcm_buffer,
+					   dsf_pcm_buffer + nbytes);
 
-		const auto cmd = decoder_data(decoder, is, buffer, nbytes, 0);
+		const auto cmd = decoder_data(decoder, is, dsf_pcm_buffer,
+					      nbytes, 0);
 		switch (cmd) {
 		case DecoderCommand::NONE:
 			break;
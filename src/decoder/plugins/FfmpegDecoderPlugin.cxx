@@ -27,7 +27,12 @@
 #include "tag/TagHandler.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
+#include "AudioFormat.hxx"
+#include "pcm/Interleave.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "config/ConfigData.hxx"
 #include "util/Error.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Domain.hxx"
 #include "LogV.hxx"
 
@@ -44,11 +49,25 @@ extern "C" {
 #endif
 }
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
 static constexpr Domain ffmpeg_domain("ffmpeg");
 
+/* the send/receive API is required for frame threading, because
+   the delayed frames need to be drained at the end */
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+#define HAVE_AVCODEC_SEND_RECEIVE
+#endif
+
+/**
+ * The number of threads decoding one stream; 0 lets libavcodec
+ * choose one per CPU.
+ */
+static unsigned ffmpeg_threads;
+
 /* suppress the ffmpeg compatibility macro */
 #ifdef SampleFormat
 #undef SampleFormat
@@ -179,8 +198,10 @@ mpd_ffmpeg_open_input(AVFormatContext **ic_ptr,
 }
 
 static bool
-ffmpeg_init(gcc_unused const config_param &param)
+ffmpeg_init(const config_param &param)
 {
+	ffmpeg_threads = param.GetBlockValue("threads", 0u);
+
 	av_log_set_callback(mpd_ffmpeg_log_callback);
 
 	av_register_all();
@@ -239,95 +260,160 @@ start_time_fallback(const AVStream &stream)
 	return timestamp_fallback(stream.start_time, 0);
 }
 
-static void
-copy_interleave_frame2(uint8_t *dest, uint8_t **src,
-		       unsigned nframes, unsigned nchannels,
-		       unsigned sample_size)
+/**
+ * Submit the PCM data of an AVFrame.  If possible, the samples are
+ * interleaved directly into the music pipe; otherwise, they are
+ * interleaved into #buffer and passed to decoder_data().
+ */
+static DecoderCommand
+ffmpeg_send_frame(Decoder &decoder, InputStream &is,
+		  const AVCodecContext &codec_context,
+		  const AVFrame &frame,
+		  PcmBuffer &buffer)
 {
-	for (unsigned frame = 0; frame < nframes; ++frame) {
-		for (unsigned channel = 0; channel < nchannels; ++channel) {
-			memcpy(dest, src[channel] + frame * sample_size,
-			       sample_size);
-			dest += sample_size;
+	const unsigned channels = codec_context.channels;
+	const size_t sample_size =
+		av_get_bytes_per_sample(codec_context.sample_fmt);
+	const size_t frame_size = channels * sample_size;
+	const bool planar = channels > 1 &&
+		av_sample_fmt_is_planar(codec_context.sample_fmt);
+	const uint16_t kbit_rate = codec_context.bit_rate / 1000;
+
+	assert(channels <= MAX_CHANNELS);
+
+	const size_t n_frames = frame.nb_samples;
+	size_t position = 0;
+	while (position < n_frames) {
+		const size_t remaining = n_frames - position;
+
+		auto dest = decoder_get_buffer(decoder, kbit_rate);
+		const bool direct = !dest.IsNull();
+
+		DecoderCommand cmd;
+		if (planar) {
+			if (!direct) {
+				dest.size = remaining * frame_size;
+				dest.data = buffer.Get(dest.size);
+			}
+
+			const size_t now =
+				std::min(dest.size / frame_size, remaining);
+
+			const void *planes[MAX_CHANNELS];
+			for (unsigned c = 0; c < channels; ++c)
+				planes[c] = frame.extended_data[c] +
+					position * sample_size;
+
+			PcmInterleave(dest.data,
+				      ConstBuffer<const void *>(planes,
+								channels),
+				      now, sample_size);
+			position += now;
+
+			cmd = direct
+				? decoder_commit_data(decoder, is,
+						      now * frame_size)
+				: decoder_data(decoder, is, dest.data,
+					       now * frame_size, kbit_rate);
+		} else {
+			const uint8_t *src = frame.extended_data[0] +
+				position * frame_size;
+
+			if (direct) {
+				const size_t now =
+					std::min(dest.size / frame_size,
+						 remaining);
+				memcpy(dest.data, src, now * frame_size);
+				position += now;
+
+				cmd = decoder_commit_data(decoder, is,
+							  now * frame_size);
+			} else {
+				position = n_frames;
+
+				cmd = decoder_data(decoder, is, src,
+						   remaining * frame_size,
+						   kbit_rate);
+			}
 		}
+
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
 	}
+
+	return DecoderCommand::NONE;
 }
 
+#ifdef HAVE_AVCODEC_SEND_RECEIVE
+
 /**
- * Copy PCM data from a AVFrame to an interleaved buffer.
+ * Send a packet to the decoder (or nullptr to drain it at the end of
+ * the stream), and submit all frames which are available.
  */
-static int
-copy_interleave_frame(const AVCodecContext *codec_context,
-		      const AVFrame *frame,
-		      uint8_t **output_buffer,
-		      uint8_t **global_buffer, int *global_buffer_size)
+static DecoderCommand
+ffmpeg_send_packet(Decoder &decoder, InputStream &is,
+		   const AVPacket *packet,
+		   AVCodecContext &codec_context,
+		   const AVStream &stream,
+		   AVFrame &frame,
+		   PcmBuffer &buffer)
 {
-	int plane_size;
-	const int data_size =
-		av_samples_get_buffer_size(&plane_size,
-					   codec_context->channels,
-					   frame->nb_samples,
-					   codec_context->sample_fmt, 1);
-	if (data_size <= 0)
-		return data_size;
-
-	if (av_sample_fmt_is_planar(codec_context->sample_fmt) &&
-	    codec_context->channels > 1) {
-		if(*global_buffer_size < data_size) {
-			av_freep(global_buffer);
-
-			*global_buffer = (uint8_t*)av_malloc(data_size);
-
-			if (!*global_buffer)
-				/* Not enough memory - shouldn't happen */
-				return AVERROR(ENOMEM);
-			*global_buffer_size = data_size;
+	int err = avcodec_send_packet(&codec_context, packet);
+	if (err < 0 && err != AVERROR_EOF) {
+		/* if error, we skip the packet */
+		LogDefault(ffmpeg_domain,
+			   "decoding failed, frame skipped");
+		return decoder_get_command(decoder);
+	}
+
+	DecoderCommand cmd = DecoderCommand::NONE;
+	while (cmd == DecoderCommand::NONE) {
+		err = avcodec_receive_frame(&codec_context, &frame);
+		if (err < 0) {
+			if (err != AVERROR(EAGAIN) && err != AVERROR_EOF)
+				LogDefault(ffmpeg_domain,
+					   "decoding failed, frame skipped");
+			break;
 		}
-		*output_buffer = *global_buffer;
-		copy_interleave_frame2(*output_buffer, frame->extended_data,
-				       frame->nb_samples,
-				       codec_context->channels,
-				       av_get_bytes_per_sample(codec_context->sample_fmt));
-	} else {
-		*output_buffer = frame->extended_data[0];
+
+		/* with frame threading, the frames lag behind the
+		   packets, so the frame's time stamp is used */
+		if (frame.pts >= 0 && frame.pts != (int64_t)AV_NOPTS_VALUE)
+			decoder_timestamp(decoder,
+					  time_from_ffmpeg(frame.pts - start_time_fallback(stream),
+							   stream.time_base));
+
+		cmd = ffmpeg_send_frame(decoder, is, codec_context, frame,
+					buffer);
+		av_frame_unref(&frame);
 	}
 
-	return data_size;
+	return cmd;
 }
 
+#else
+
 static DecoderCommand
 ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 		   const AVPacket *packet,
-		   AVCodecContext *codec_context,
-		   const AVStream *stream,
-		   AVFrame *frame,
-		   uint8_t **buffer, int *buffer_size)
+		   AVCodecContext &codec_context,
+		   const AVStream &stream,
+		   AVFrame &frame,
+		   PcmBuffer &buffer)
 {
 	if (packet->pts >= 0 && packet->pts != (int64_t)AV_NOPTS_VALUE)
 		decoder_timestamp(decoder,
-				  time_from_ffmpeg(packet->pts - start_time_fallback(*stream),
-				  stream->time_base));
+				  time_from_ffmpeg(packet->pts - start_time_fallback(stream),
+				  stream.time_base));
 
 	AVPacket packet2 = *packet;
 
-	uint8_t *output_buffer;
-
 	DecoderCommand cmd = DecoderCommand::NONE;
 	while (packet2.size > 0 && cmd == DecoderCommand::NONE) {
-		int audio_size = 0;
 		int got_frame = 0;
-		int len = avcodec_decode_audio4(codec_context,
-						frame, &got_frame,
+		int len = avcodec_decode_audio4(&codec_context,
+						&frame, &got_frame,
 						&packet2);
-		if (len >= 0 && got_frame) {
-			audio_size = copy_interleave_frame(codec_context,
-							   frame,
-							   &output_buffer,
-							   buffer, buffer_size);
-			if (audio_size < 0)
-				len = audio_size;
-		}
-
 		if (len < 0) {
 			/* if error, we skip the frame */
 			LogDefault(ffmpeg_domain,
@@ -338,16 +424,16 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 		packet2.data += len;
 		packet2.size -= len;
 
-		if (audio_size <= 0)
-			continue;
-
-		cmd = decoder_data(decoder, is,
-				   output_buffer, audio_size,
-				   codec_context->bit_rate / 1000);
+		if (got_frame && frame.nb_samples > 0)
+			cmd = ffmpeg_send_frame(decoder, is, codec_context,
+						frame, buffer);
 	}
+
 	return cmd;
 }
 
+#endif
+
 gcc_const
 static SampleFormat
 ffmpeg_sample_format(enum AVSampleFormat sample_fmt)
@@ -488,6 +574,14 @@ ffmpeg_decode(Decoder &decoder, InputStream &input)
 	   values into AVCodecContext.channels - a change that will be
 	   reverted later by avcodec_decode_audio3() */
 
+#ifdef HAVE_AVCODEC_SEND_RECEIVE
+	/* libavcodec uses frame threading only for codecs which
+	   support it (e.g. WMA Pro, TrueHD); the delayed frames are
+	   drained at the end of the stream */
+	codec_context->thread_count = ffmpeg_threads;
+	codec_context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+#endif
+
 	const int open_result = avcodec_open2(codec_context, codec, nullptr);
 	if (open_result < 0) {
 		LogError(ffmpeg_domain, "Could not open codec");
@@ -513,22 +607,29 @@ ffmpeg_decode(Decoder &decoder, InputStream &input)
 		return;
 	}
 
-	uint8_t *interleaved_buffer = nullptr;
-	int interleaved_buffer_size = 0;
+	PcmBuffer interleaved_buffer;
 
 	DecoderCommand cmd;
 	do {
 		AVPacket packet;
-		if (av_read_frame(format_context, &packet) < 0)
+		if (av_read_frame(format_context, &packet) < 0) {
 			/* end of file */
+#ifdef HAVE_AVCODEC_SEND_RECEIVE
+			/* submit the frames which are still being
+			   decoded */
+			ffmpeg_send_packet(decoder, input, nullptr,
+					   *codec_context, *av_stream,
+					   *frame, interleaved_buffer);
+#endif
 			break;
+		}
 
 		if (packet.stream_index == audio_stream)
 			cmd = ffmpeg_send_packet(decoder, input,
-						 &packet, codec_context,
-						 av_stream,
-						 frame,
-						 &interleaved_buffer, &interleaved_buffer_size);
+						 &packet, *codec_context,
+						 *av_stream,
+						 *frame,
+						 interleaved_buffer);
 		else
 			cmd = decoder_get_command(decoder);
 
@@ -557,7 +658,6 @@ ffmpeg_decode(Decoder &decoder, InputStream &input)
 #else
 	av_freep(&frame);
 #endif
-	av_freep(&interleaved_buffer);
 
 	avcodec_close(codec_context);
 	avformat_close_input(&format_context);
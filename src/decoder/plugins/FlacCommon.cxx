@@ -27,8 +27,11 @@
 #include "FlacPcm.hxx"
 #include "CheckAudioFormat.hxx"
 #include "util/Error.hxx"
+#include "util/WritableBuffer.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 flac_data::flac_data(Decoder &_decoder,
 		     InputStream &_input_stream)
 	:FlacInput(_input_stream, &_decoder),
@@ -151,28 +154,49 @@ flac_common_write(struct flac_data *data, const FLAC__Frame * frame,
 		  const FLAC__int32 *const buf[],
 		  FLAC__uint64 nbytes)
 {
-	void *buffer;
 	unsigned bit_rate;
 
 	if (!data->initialized && !flac_got_first_frame(data, &frame->header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	size_t buffer_size = frame->header.blocksize * data->frame_size;
-	buffer = data->buffer.Get(buffer_size);
-
-	flac_convert(buffer, frame->header.channels,
-		     data->audio_format.format, buf,
-		     0, frame->header.blocksize);
-
 	if (nbytes > 0)
 		bit_rate = nbytes * 8 * frame->header.sample_rate /
 			(1000 * frame->header.blocksize);
 	else
 		bit_rate = 0;
 
-	auto cmd = decoder_data(data->decoder, data->input_stream,
-				buffer, buffer_size,
-				bit_rate);
+	/* convert the whole block at once, preferably straight into
+	   the music pipe chunk; a block which doesn't fit into the
+	   chunk is split */
+	const unsigned n_frames = frame->header.blocksize;
+	unsigned position = 0;
+	DecoderCommand cmd = DecoderCommand::NONE;
+	while (position < n_frames) {
+		auto dest = decoder_get_buffer(data->decoder, bit_rate);
+		const bool direct = !dest.IsNull();
+		if (!direct) {
+			dest.size = (n_frames - position) * data->frame_size;
+			dest.data = data->buffer.Get(dest.size);
+		}
+
+		const unsigned now =
+			std::min<size_t>(dest.size / data->frame_size,
+					 n_frames - position);
+		flac_convert(dest.data, frame->header.channels,
+			     data->audio_format.format, buf,
+			     position, position + now);
+		position += now;
+
+		const size_t nbytes_now = now * data->frame_size;
+		cmd = direct
+			? decoder_commit_data(data->decoder,
+					      data->input_stream, nbytes_now)
+			: decoder_data(data->decoder, data->input_stream,
+				       dest.data, nbytes_now, bit_rate);
+		if (cmd != DecoderCommand::NONE)
+			break;
+	}
+
 	data->next_frame += frame->header.blocksize;
 	switch (cmd) {
 	case DecoderCommand::NONE:
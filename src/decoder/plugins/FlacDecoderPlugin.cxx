@@ -112,18 +112,54 @@ flac_scan_stream(InputStream &is,
 }
 
 /**
- * Some glue code around FLAC__stream_decoder_new().
+ * A FLAC__StreamDecoder which is kept for the next song, so it does
+ * not need to be allocated again.  It is shared by the "flac" and
+ * the "oggflac" plugin.
+ */
+class FlacReusableDecoder final : public DecoderReusableState {
+	FLAC__StreamDecoder *sd;
+
+public:
+	explicit FlacReusableDecoder(FLAC__StreamDecoder *_sd)
+		:DecoderReusableState(flac_decoder_plugin), sd(_sd) {}
+
+	~FlacReusableDecoder() {
+		if (sd != nullptr)
+			FLAC__stream_decoder_delete(sd);
+	}
+
+	FLAC__StreamDecoder *Steal() {
+		FLAC__StreamDecoder *result = sd;
+		sd = nullptr;
+		return result;
+	}
+};
+
+/**
+ * Some glue code around FLAC__stream_decoder_new().  Reuses the
+ * decoder of the previous song if possible.
  */
 static FLAC__StreamDecoder *
-flac_decoder_new(void)
+flac_decoder_new(Decoder &decoder)
 {
-	FLAC__StreamDecoder *sd = FLAC__stream_decoder_new();
-	if (sd == nullptr) {
-		LogError(flac_domain,
-			 "FLAC__stream_decoder_new() failed");
-		return nullptr;
+	FLAC__StreamDecoder *sd = nullptr;
+
+	auto *reusable = (FlacReusableDecoder *)
+		decoder_take_state(decoder, flac_decoder_plugin);
+	if (reusable != nullptr) {
+		sd = reusable->Steal();
+		delete reusable;
+	} else {
+		sd = FLAC__stream_decoder_new();
+		if (sd == nullptr) {
+			LogError(flac_domain,
+				 "FLAC__stream_decoder_new() failed");
+			return nullptr;
+		}
 	}
 
+	/* this needs to be done each time, because
+	   FLAC__stream_decoder_finish() resets all settings */
 	if(!FLAC__stream_decoder_set_metadata_respond(sd, FLAC__METADATA_TYPE_VORBIS_COMMENT))
 		LogDebug(flac_domain,
 			 "FLAC__stream_decoder_set_metadata_respond() has failed");
@@ -131,6 +167,16 @@ flac_decoder_new(void)
 	return sd;
 }
 
+/**
+ * Finish the FLAC__StreamDecoder and keep it for the next song.
+ */
+static void
+flac_decoder_release(Decoder &decoder, FLAC__StreamDecoder *sd)
+{
+	FLAC__stream_decoder_finish(sd);
+	decoder_keep_state(decoder, new FlacReusableDecoder(sd));
+}
+
 static bool
 flac_decoder_initialize(struct flac_data *data, FLAC__StreamDecoder *sd,
 			FLAC__uint64 duration)
@@ -254,7 +300,7 @@ flac_decode_internal(Decoder &decoder,
 {
 	FLAC__StreamDecoder *flac_dec;
 
-	flac_dec = flac_decoder_new();
+	flac_dec = flac_decoder_new(decoder);
 	if (flac_dec == nullptr)
 		return;
 
@@ -269,16 +315,10 @@ flac_decode_internal(Decoder &decoder,
 		return;
 	}
 
-	if (!flac_decoder_initialize(&data, flac_dec, 0)) {
-		FLAC__stream_decoder_finish(flac_dec);
-		FLAC__stream_decoder_delete(flac_dec);
-		return;
-	}
-
-	flac_decoder_loop(&data, flac_dec, 0, 0);
+	if (flac_decoder_initialize(&data, flac_dec, 0))
+		flac_decoder_loop(&data, flac_dec, 0, 0);
 
-	FLAC__stream_decoder_finish(flac_dec);
-	FLAC__stream_decoder_delete(flac_dec);
+	flac_decoder_release(decoder, flac_dec);
 }
 
 static void
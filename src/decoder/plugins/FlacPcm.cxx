@@ -19,48 +19,10 @@
 
 #include "config.h"
 #include "FlacPcm.hxx"
+#include "pcm/Interleave.hxx"
 
 #include <assert.h>
 
-static void flac_convert_stereo16(int16_t *dest,
-				  const FLAC__int32 * const buf[],
-				  unsigned int position, unsigned int end)
-{
-	for (; position < end; ++position) {
-		*dest++ = buf[0][position];
-		*dest++ = buf[1][position];
-	}
-}
-
-static void
-flac_convert_16(int16_t *dest,
-		unsigned int num_channels,
-		const FLAC__int32 * const buf[],
-		unsigned int position, unsigned int end)
-{
-	unsigned int c_chan;
-
-	for (; position < end; ++position)
-		for (c_chan = 0; c_chan < num_channels; c_chan++)
-			*dest++ = buf[c_chan][position];
-}
-
-/**
- * Note: this function also handles 24 bit files!
- */
-static void
-flac_convert_32(int32_t *dest,
-		unsigned int num_channels,
-		const FLAC__int32 * const buf[],
-		unsigned int position, unsigned int end)
-{
-	unsigned int c_chan;
-
-	for (; position < end; ++position)
-		for (c_chan = 0; c_chan < num_channels; c_chan++)
-			*dest++ = buf[c_chan][position];
-}
-
 static void
 flac_convert_8(int8_t *dest,
 	       unsigned int num_channels,
@@ -80,20 +42,27 @@ flac_convert(void *dest,
 	     const FLAC__int32 *const buf[],
 	     unsigned int position, unsigned int end)
 {
+	assert(num_channels <= MAX_CHANNELS);
+
+	const FLAC__int32 *planes[MAX_CHANNELS];
+	for (unsigned c = 0; c < num_channels; ++c)
+		planes[c] = buf[c] + position;
+
+	const ConstBuffer<const FLAC__int32 *> src(planes, num_channels);
+	const size_t n_frames = end - position;
+
 	switch (sample_format) {
 	case SampleFormat::S16:
-		if (num_channels == 2)
-			flac_convert_stereo16((int16_t*)dest, buf,
-					      position, end);
-		else
-			flac_convert_16((int16_t*)dest, num_channels, buf,
-					position, end);
+		PcmInterleaveNarrow16((int16_t *)dest, src, n_frames);
 		break;
 
 	case SampleFormat::S24_P32:
 	case SampleFormat::S32:
-		flac_convert_32((int32_t*)dest, num_channels, buf,
-				position, end);
+		/* no conversion needed, only the signedness differs */
+		PcmInterleave32((uint32_t *)dest,
+				ConstBuffer<const uint32_t *>((const uint32_t *const*)src.data,
+							      src.size),
+				n_frames);
 		break;
 
 	case SampleFormat::S8:
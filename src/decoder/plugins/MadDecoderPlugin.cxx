@@ -19,9 +19,12 @@
 
 #include "config.h"
 #include "MadDecoderPlugin.hxx"
+#include "Mp3SeekIndex.hxx"
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "config/ConfigGlobal.hxx"
+#include "config/ConfigData.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "tag/TagId3.hxx"
 #include "tag/TagRva2.hxx"
 #include "tag/TagHandler.hxx"
@@ -69,6 +72,12 @@ static constexpr Domain mad_domain("mad");
 
 static bool gapless_playback;
 
+/**
+ * The directory where seek indexes are stored; "nulled" if this
+ * feature is disabled.
+ */
+static AllocatedPath seek_index_directory = AllocatedPath::Null();
+
 static inline int32_t
 mad_fixed_to_24_sample(mad_fixed_t sample)
 {
@@ -105,10 +114,19 @@ mad_fixed_to_24_buffer(int32_t *dest, const struct mad_synth *synth,
 }
 
 static bool
-mp3_plugin_init(gcc_unused const config_param &param)
+mp3_plugin_init(const config_param &param)
 {
 	gapless_playback = config_get_bool(CONF_GAPLESS_MP3_PLAYBACK,
 					   DEFAULT_GAPLESS_MP3_PLAYBACK);
+
+	Error error;
+	seek_index_directory = param.GetBlockPath("seek_index_directory",
+						  error);
+	if (seek_index_directory.IsNull() && error.IsDefined()) {
+		LogError(error);
+		return false;
+	}
+
 	return true;
 }
 
@@ -125,6 +143,29 @@ struct MadDecoder {
 	float elapsed_time;
 	float seek_where;
 	enum muteframe mute_frame;
+
+	/**
+	 * The offset of the first audio frame (the one carrying the
+	 * Xing header, if there is one).
+	 */
+	InputStream::offset_type first_frame_offset;
+
+	/**
+	 * The stream size according to the Xing header; 0 if
+	 * unknown.
+	 */
+	unsigned long xing_bytes;
+
+	/**
+	 * The Xing table of contents: for each percent of the
+	 * duration, the position in the stream in 1/256 units.
+	 * Only valid if #has_xing_toc is set.
+	 */
+	unsigned char xing_toc[100];
+	bool has_xing_toc;
+
+	Mp3SeekIndex seek_index;
+
 	long *frame_offsets;
 	mad_timer_t *times;
 	unsigned long highest_frame;
@@ -165,9 +206,34 @@ struct MadDecoder {
 
 	bool DecodeFirstFrame(Tag **tag);
 
+	/**
+	 * Parse all remaining frame headers and record their offsets
+	 * in #seek_index.  Call this right after DecodeFirstFrame().
+	 */
+	void BuildSeekIndex();
+
 	gcc_pure
 	long TimeToFrame(double t) const;
 
+	/**
+	 * Estimate the position of the specified time from the Xing
+	 * table of contents.
+	 */
+	gcc_pure
+	InputStream::offset_type XingTocOffset(double t) const;
+
+	/**
+	 * Jump to a position which is beyond the frames recorded in
+	 * #frame_offsets, with the help of the seek index or the
+	 * Xing table of contents.  The frame found there is at or
+	 * before the specified time; the caller mutes the remaining
+	 * frames until the exact position is reached.
+	 *
+	 * @return false if neither is available or seeking has
+	 * failed
+	 */
+	bool SeekBeyondRecorded(double t);
+
 	void UpdateTimerNextFrame();
 
 	/**
@@ -187,6 +253,7 @@ struct MadDecoder {
 MadDecoder::MadDecoder(Decoder *_decoder,
 		       InputStream &_input_stream)
 	:mute_frame(MUTEFRAME_NONE),
+	 first_frame_offset(0), xing_bytes(0), has_xing_toc(false),
 	 frame_offsets(nullptr),
 	 times(nullptr),
 	 highest_frame(0), max_frames(0), current_frame(0),
@@ -814,6 +881,8 @@ MadDecoder::DecodeFirstFrame(Tag **tag)
 	ptr = stream.anc_ptr;
 	bitlen = stream.anc_bitlen;
 
+	first_frame_offset = ThisFrameOffset();
+
 	FileSizeToSongLength();
 
 	/*
@@ -830,6 +899,14 @@ MadDecoder::DecodeFirstFrame(Tag **tag)
 			max_frames = xing.frames;
 		}
 
+		if (xing.flags & XING_BYTES)
+			xing_bytes = xing.bytes;
+
+		if (xing.flags & XING_TOC) {
+			memcpy(xing_toc, xing.toc, sizeof(xing_toc));
+			has_xing_toc = true;
+		}
+
 		if (parse_lame(&lame, &ptr, &bitlen)) {
 			if (gapless_playback && input_stream.IsSeekable()) {
 				drop_start_samples = lame.encoder_delay +
@@ -876,14 +953,92 @@ MadDecoder::~MadDecoder()
 	delete[] times;
 }
 
+void
+MadDecoder::BuildSeekIndex()
+{
+	seek_index.Clear();
+	seek_index.Append(ThisFrameOffset());
+
+	while (true) {
+		enum mp3_action ret;
+		do {
+			ret = DecodeNextFrameHeader(nullptr);
+		} while (ret == DECODE_CONT);
+		if (ret == DECODE_BREAK)
+			break;
+
+		if (ret == DECODE_OK)
+			seek_index.Append(ThisFrameOffset());
+	}
+}
+
+/**
+ * Load the seek index of the stream if one was stored.
+ *
+ * @return true if #MadDecoder::seek_index is now available
+ */
+static bool
+mad_decoder_load_seek_index(MadDecoder &data)
+{
+	InputStream &is = data.input_stream;
+	if (seek_index_directory.IsNull() || !is.KnownSize())
+		return false;
+
+	const char *uri = is.GetURI();
+	return data.seek_index.Load(mp3_seek_index_path(seek_index_directory,
+							uri),
+				    uri, is.GetSize());
+}
+
+/**
+ * Build the seek index of the stream and store it.  This is done
+ * while updating the database, i.e. only for new and modified files,
+ * so an existing index is always replaced.
+ *
+ * @return true if #MadDecoder::seek_index is now available
+ */
+static bool
+mad_decoder_build_seek_index(MadDecoder &data)
+{
+	InputStream &is = data.input_stream;
+	if (seek_index_directory.IsNull() || !is.KnownSize())
+		return false;
+
+	data.BuildSeekIndex();
+	if (data.seek_index.IsEmpty())
+		return false;
+
+	const char *uri = is.GetURI();
+	Error error;
+	if (!data.seek_index.Save(mp3_seek_index_path(seek_index_directory,
+						      uri),
+				  uri, is.GetSize(), error))
+		LogError(error);
+
+	return true;
+}
+
 /* this is primarily used for getting total time for tags */
 static int
 mad_decoder_total_file_time(InputStream &is)
 {
 	MadDecoder data(nullptr, is);
-	return data.DecodeFirstFrame(nullptr)
-		? data.total_time + 0.5
-		: -1;
+	if (!data.DecodeFirstFrame(nullptr))
+		return -1;
+
+	if (mad_decoder_build_seek_index(data)) {
+		/* the Xing frame does not contain audio */
+		unsigned long n = data.seek_index.GetFrameCount();
+		if (data.found_xing && n > 0)
+			--n;
+
+		mad_timer_t duration = data.frame.header.duration;
+		mad_timer_multiply(&duration, n);
+		data.total_time = mad_timer_count(duration,
+						  MAD_UNITS_MILLISECONDS) / 1000.;
+	}
+
+	return data.total_time + 0.5;
 }
 
 long
@@ -902,24 +1057,85 @@ MadDecoder::TimeToFrame(double t) const
 	return i;
 }
 
+InputStream::offset_type
+MadDecoder::XingTocOffset(double t) const
+{
+	assert(has_xing_toc);
+	assert(total_time > 0);
+
+	double percent = t * 100. / total_time;
+	if (percent < 0)
+		percent = 0;
+	else if (percent > 99.999)
+		percent = 99.999;
+
+	const unsigned i = percent;
+	const double a = xing_toc[i];
+	const double b = i < 99 ? xing_toc[i + 1] : 256.;
+	const double x = (a + (b - a) * (percent - i)) / 256.;
+
+	InputStream::offset_type size = xing_bytes;
+	if (size == 0)
+		size = input_stream.GetSize() - first_frame_offset;
+
+	return first_frame_offset + InputStream::offset_type(x * size);
+}
+
+bool
+MadDecoder::SeekBeyondRecorded(double t)
+{
+	const double frame_duration = mp3_frame_duration(&frame);
+	if (frame_duration <= 0)
+		return false;
+
+	const unsigned long j = t / frame_duration;
+
+	unsigned long k;
+	uint64_t offset;
+	if (seek_index.Lookup(j, k, offset)) {
+		/* exact frame boundary */
+	} else if (has_xing_toc && total_time > 0 &&
+		   (xing_bytes > 0 || input_stream.KnownSize())) {
+		/* approximation; the decoder resynchronizes at the
+		   next frame header */
+		k = j;
+		offset = XingTocOffset(t);
+	} else
+		return false;
+
+	if (!Seek(offset))
+		return false;
+
+	current_frame = k;
+	timer = frame.header.duration;
+	mad_timer_multiply(&timer, k);
+	return true;
+}
+
 void
 MadDecoder::UpdateTimerNextFrame()
 {
 	if (current_frame >= highest_frame) {
-		/* record this frame's properties in frame_offsets
-		   (for seeking) and times */
 		bit_rate = frame.header.bitrate;
 
-		if (current_frame >= max_frames)
-			/* cap current_frame */
-			current_frame = max_frames - 1;
-		else
-			highest_frame++;
+		mad_timer_add(&timer, frame.header.duration);
 
-		frame_offsets[current_frame] = ThisFrameOffset();
+		if (current_frame == highest_frame) {
+			/* record this frame's properties in
+			   frame_offsets (for seeking) and times */
+			if (current_frame >= max_frames)
+				/* cap current_frame */
+				current_frame = max_frames - 1;
+			else
+				highest_frame++;
+
+			frame_offsets[current_frame] = ThisFrameOffset();
+			times[current_frame] = timer;
+		}
 
-		mad_timer_add(&timer, frame.header.duration);
-		times[current_frame] = timer;
+		/* else: we have jumped ahead with
+		   SeekBeyondRecorded(), and there's a gap in
+		   frame_offsets */
 	} else
 		/* get the new timer value from "times" */
 		timer = times[current_frame];
@@ -1035,13 +1251,18 @@ MadDecoder::Read()
 
 			assert(input_stream.IsSeekable());
 
-			j = TimeToFrame(decoder_seek_where(*decoder));
+			const double t = decoder_seek_where(*decoder);
+			j = TimeToFrame(t);
 			if (j < highest_frame) {
 				if (Seek(frame_offsets[j])) {
 					current_frame = j;
 					decoder_command_finished(*decoder);
 				} else
 					decoder_seek_error(*decoder);
+			} else if (SeekBeyondRecorded(t)) {
+				seek_where = t;
+				mute_frame = MUTEFRAME_SEEK;
+				decoder_command_finished(*decoder);
 			} else {
 				seek_where = decoder_seek_where(*decoder);
 				mute_frame = MUTEFRAME_SEEK;
@@ -1112,6 +1333,11 @@ mp3_decode(Decoder &decoder, InputStream &input_stream)
 		return;
 	}
 
+	if (input_stream.IsSeekable())
+		/* an index built while updating the database allows
+		   exact seeking without reading up to the position */
+		mad_decoder_load_seek_index(data);
+
 	decoder_initialized(decoder, audio_format,
 			    input_stream.IsSeekable(),
 			    data.total_time);
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Mp3SeekIndex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <string>
+
+#include <string.h>
+#include <stdio.h>
+
+/*
+ * The file format: the magic string, then the version, the size of
+ * the MP3 file, the length of its URI followed by the URI itself,
+ * the number of frames, the interval and the number of offsets,
+ * followed by the offsets.  All integers are in host byte order.
+ */
+
+static constexpr char MP3_INDEX_MAGIC[8] = { 'M', 'P', 'D', 'M', 'P', '3', 'I', 'X' };
+static constexpr uint32_t MP3_INDEX_VERSION = 1;
+
+/**
+ * Refuse to load absurdly large files.
+ */
+static constexpr uint32_t MP3_INDEX_MAX_OFFSETS = 1024 * 1024;
+
+bool
+Mp3SeekIndex::Lookup(unsigned long frame,
+		     unsigned long &frame_r, uint64_t &offset_r) const
+{
+	if (frame >= n_frames)
+		return false;
+
+	const size_t i = frame / INTERVAL;
+	if (i >= offsets.size())
+		return false;
+
+	frame_r = i * INTERVAL;
+	offset_r = offsets[i];
+	return true;
+}
+
+template<typename T>
+static bool
+ReadValue(FILE *file, T &value)
+{
+	return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+template<typename T>
+static bool
+WriteValue(FILE *file, const T &value)
+{
+	return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+static bool
+LoadHeader(FILE *file, const char *uri, uint64_t file_size)
+{
+	char magic[sizeof(MP3_INDEX_MAGIC)];
+	uint32_t version, uri_length;
+	uint64_t stored_size;
+
+	if (fread(magic, sizeof(magic), 1, file) != 1 ||
+	    memcmp(magic, MP3_INDEX_MAGIC, sizeof(magic)) != 0 ||
+	    !ReadValue(file, version) || version != MP3_INDEX_VERSION ||
+	    !ReadValue(file, stored_size) || stored_size != file_size ||
+	    !ReadValue(file, uri_length) || uri_length != strlen(uri))
+		return false;
+
+	char buffer[256];
+	while (uri_length > 0) {
+		size_t n = std::min<size_t>(uri_length, sizeof(buffer));
+		if (fread(buffer, 1, n, file) != n ||
+		    memcmp(buffer, uri, n) != 0)
+			return false;
+
+		uri += n;
+		uri_length -= n;
+	}
+
+	return true;
+}
+
+bool
+Mp3SeekIndex::Load(Path path, const char *uri, uint64_t file_size)
+{
+	Clear();
+
+	FILE *file = FOpen(path, FOpenMode::ReadBinary);
+	if (file == nullptr)
+		return false;
+
+	uint64_t stored_frames;
+	uint32_t interval, n_offsets;
+	if (!LoadHeader(file, uri, file_size) ||
+	    !ReadValue(file, stored_frames) ||
+	    !ReadValue(file, interval) || interval != INTERVAL ||
+	    !ReadValue(file, n_offsets) ||
+	    n_offsets > MP3_INDEX_MAX_OFFSETS ||
+	    n_offsets != (stored_frames + INTERVAL - 1) / INTERVAL) {
+		fclose(file);
+		return false;
+	}
+
+	offsets.resize(n_offsets);
+	bool success = n_offsets == 0 ||
+		fread(&offsets.front(), sizeof(offsets.front()), n_offsets,
+		      file) == n_offsets;
+	fclose(file);
+
+	if (!success) {
+		offsets.clear();
+		return false;
+	}
+
+	n_frames = stored_frames;
+	return true;
+}
+
+bool
+Mp3SeekIndex::Save(Path path, const char *uri, uint64_t file_size,
+		   Error &error) const
+{
+	const auto tmp_path = AllocatedPath::FromFS(std::string(path.c_str()) + ".tmp");
+
+	FILE *file = FOpen(tmp_path, FOpenMode::WriteBinary);
+	if (file == nullptr) {
+		error.FormatErrno("Failed to create %s", tmp_path.c_str());
+		return false;
+	}
+
+	const uint32_t uri_length = strlen(uri);
+	const uint64_t stored_frames = n_frames;
+	const uint32_t interval = INTERVAL;
+	const uint32_t n_offsets = offsets.size();
+
+	bool success = fwrite(MP3_INDEX_MAGIC, sizeof(MP3_INDEX_MAGIC), 1,
+			      file) == 1 &&
+		WriteValue(file, MP3_INDEX_VERSION) &&
+		WriteValue(file, file_size) &&
+		WriteValue(file, uri_length) &&
+		fwrite(uri, 1, uri_length, file) == uri_length &&
+		WriteValue(file, stored_frames) &&
+		WriteValue(file, interval) &&
+		WriteValue(file, n_offsets) &&
+		(n_offsets == 0 ||
+		 fwrite(&offsets.front(), sizeof(offsets.front()), n_offsets,
+			file) == n_offsets);
+
+	if (fclose(file) != 0)
+		success = false;
+
+	if (!success) {
+		error.FormatErrno("Failed to write %s", tmp_path.c_str());
+		RemoveFile(tmp_path);
+		return false;
+	}
+
+	if (!RenameFile(tmp_path, path)) {
+		error.FormatErrno("Failed to rename %s", tmp_path.c_str());
+		RemoveFile(tmp_path);
+		return false;
+	}
+
+	return true;
+}
+
+AllocatedPath
+mp3_seek_index_path(Path directory, const char *uri)
+{
+	/* FNV-1a */
+	uint64_t hash = 14695981039346656037ULL;
+	for (const char *p = uri; *p != 0; ++p) {
+		hash ^= (unsigned char)*p;
+		hash *= 1099511628211ULL;
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx",
+		 (unsigned long long)hash);
+	return AllocatedPath::Build(directory, name);
+}
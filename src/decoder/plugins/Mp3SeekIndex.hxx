@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DECODER_MP3_SEEK_INDEX_HXX
+#define MPD_DECODER_MP3_SEEK_INDEX_HXX
+
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+class Path;
+class AllocatedPath;
+class Error;
+
+/**
+ * A table of MP3 frame offsets which allows exact seeking without
+ * parsing all frame headers up to the seek position.  The offset of
+ * every #INTERVAL-th frame is stored.
+ *
+ * The table is built while the database is updated and stored in a
+ * file, so it can be used the next time the song is played.
+ */
+class Mp3SeekIndex {
+public:
+	/**
+	 * Store the offset of every n-th frame.  At 44.1 kHz, this
+	 * is about one second of MPEG-1 layer III audio.
+	 */
+	static constexpr unsigned INTERVAL = 38;
+
+private:
+	std::vector<uint64_t> offsets;
+
+	unsigned long n_frames;
+
+public:
+	Mp3SeekIndex():n_frames(0) {}
+
+	bool IsEmpty() const {
+		return offsets.empty();
+	}
+
+	unsigned long GetFrameCount() const {
+		return n_frames;
+	}
+
+	void Clear() {
+		offsets.clear();
+		n_frames = 0;
+	}
+
+	/**
+	 * Add the next frame.  This must be called for every frame
+	 * in the file, in order, starting with the first audio frame.
+	 */
+	void Append(uint64_t offset) {
+		if (n_frames % INTERVAL == 0)
+			offsets.push_back(offset);
+		++n_frames;
+	}
+
+	/**
+	 * Find the last indexed frame at or before the specified
+	 * one.
+	 *
+	 * @return false if the frame is not in the index
+	 */
+	bool Lookup(unsigned long frame,
+		    unsigned long &frame_r, uint64_t &offset_r) const;
+
+	/**
+	 * Load the index from a file.  A missing file or one that
+	 * was written for another file (different URI or size) is
+	 * not an error; the method returns false and leaves the
+	 * index empty.
+	 */
+	bool Load(Path path, const char *uri, uint64_t file_size);
+
+	/**
+	 * Save the index to a file.  It is written to a temporary
+	 * file first which is then renamed, so readers never see a
+	 * partial index.
+	 */
+	bool Save(Path path, const char *uri, uint64_t file_size,
+		  Error &error) const;
+};
+
+/**
+ * Determine the index file name for the specified song URI.
+ */
+gcc_pure
+AllocatedPath
+mp3_seek_index_path(Path directory, const char *uri);
+
+#endif
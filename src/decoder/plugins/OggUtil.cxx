@@ -21,6 +21,13 @@
 #include "OggUtil.hxx"
 #include "../DecoderAPI.hxx"
 
+/**
+ * How much is read from the stream at a time while looking for the
+ * next page.  This is large enough for a typical page, so most pages
+ * need only one read and one ogg_sync_buffer() call.
+ */
+static constexpr size_t ogg_read_size = 8192;
+
 bool
 OggFeed(ogg_sync_state &oy, Decoder *decoder,
 	InputStream &input_stream, size_t size)
@@ -47,7 +54,7 @@ OggExpectPage(ogg_sync_state &oy, ogg_page &page,
 		if (r != 0)
 			return r > 0;
 
-		if (!OggFeed(oy, decoder, input_stream, 1024))
+		if (!OggFeed(oy, decoder, input_stream, ogg_read_size))
 			return false;
 	}
 }
@@ -100,7 +107,7 @@ OggExpectPageSeek(ogg_sync_state &oy, ogg_page &page,
 			continue;
 		}
 
-		if (!OggFeed(oy, decoder, input_stream, 1024))
+		if (!OggFeed(oy, decoder, input_stream, ogg_read_size))
 			return false;
 	}
 }
@@ -29,6 +29,7 @@
 #include "tag/TagHandler.hxx"
 #include "tag/TagBuilder.hxx"
 #include "input/InputStream.hxx"
+#include "config/ConfigData.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
@@ -39,6 +40,20 @@
 
 static constexpr opus_int32 opus_sample_rate = 48000;
 
+/**
+ * The largest Opus packet holds 120ms of audio; this is the size of
+ * the output buffer.
+ */
+static constexpr unsigned opus_output_buffer_frames =
+	opus_sample_rate * 120 / 1000;
+
+/**
+ * Decode with opus_decode_float() instead of opus_decode()?  libopus
+ * works with floating point internally, and this avoids the
+ * conversion to 16 bit and back when the output is float, too.
+ */
+static bool opus_float;
+
 gcc_pure
 static bool
 IsOpusHead(const ogg_packet &packet)
@@ -54,13 +69,41 @@ IsOpusTags(const ogg_packet &packet)
 }
 
 static bool
-mpd_opus_init(gcc_unused const config_param &param)
+mpd_opus_init(const config_param &param)
 {
 	LogDebug(opus_domain, opus_get_version_string());
 
+	opus_float = param.GetBlockValue("float", false);
+
 	return true;
 }
 
+/**
+ * An #OpusDecoder and the output buffer which are kept for the next
+ * song.
+ */
+class OpusReusableDecoder final : public DecoderReusableState {
+public:
+	OpusDecoder *opus_decoder;
+	float *output_buffer;
+	unsigned channels;
+
+	OpusReusableDecoder(OpusDecoder *_opus_decoder,
+			    float *_output_buffer,
+			    unsigned _channels)
+		:DecoderReusableState(opus_decoder_plugin),
+		 opus_decoder(_opus_decoder),
+		 output_buffer(_output_buffer),
+		 channels(_channels) {}
+
+	~OpusReusableDecoder() {
+		delete[] output_buffer;
+
+		if (opus_decoder != nullptr)
+			opus_decoder_destroy(opus_decoder);
+	}
+};
+
 class MPDOpusDecoder {
 	Decoder &decoder;
 	InputStream &input_stream;
@@ -68,8 +111,15 @@ class MPDOpusDecoder {
 	ogg_stream_state os;
 
 	OpusDecoder *opus_decoder;
-	opus_int16 *output_buffer;
-	unsigned output_size;
+
+	/**
+	 * Room for #opus_output_buffer_frames.  It is allocated for
+	 * float samples, and holds 16 bit samples unless #opus_float
+	 * is enabled.
+	 */
+	float *output_buffer;
+
+	unsigned channels;
 
 	bool os_initialized;
 	bool found_opus;
@@ -85,7 +135,7 @@ public:
 		       InputStream &_input_stream)
 		:decoder(_decoder), input_stream(_input_stream),
 		 opus_decoder(nullptr),
-		 output_buffer(nullptr), output_size(0),
+		 output_buffer(nullptr),
 		 os_initialized(false), found_opus(false) {}
 	~MPDOpusDecoder();
 
@@ -103,10 +153,14 @@ public:
 
 MPDOpusDecoder::~MPDOpusDecoder()
 {
-	delete[] output_buffer;
-
 	if (opus_decoder != nullptr)
-		opus_decoder_destroy(opus_decoder);
+		/* keep the decoder for the next song */
+		decoder_keep_state(decoder,
+				   new OpusReusableDecoder(opus_decoder,
+							   output_buffer,
+							   channels));
+	else
+		delete[] output_buffer;
 
 	if (os_initialized)
 		ogg_stream_clear(&os);
@@ -229,7 +283,6 @@ MPDOpusDecoder::HandleBOS(const ogg_packet &packet)
 	if (found_opus || !IsOpusHead(packet))
 		return DecoderCommand::STOP;
 
-	unsigned channels;
 	if (!ScanOpusHeader(packet.packet, packet.bytes, channels) ||
 	    !audio_valid_channel_count(channels))
 		return DecoderCommand::STOP;
@@ -243,13 +296,30 @@ MPDOpusDecoder::HandleBOS(const ogg_packet &packet)
 	/* TODO: parse attributes from the OpusHead (sample rate,
 	   channels, ...) */
 
-	int opus_error;
-	opus_decoder = opus_decoder_create(opus_sample_rate, channels,
-					   &opus_error);
+	auto *reusable = (OpusReusableDecoder *)
+		decoder_take_state(decoder, opus_decoder_plugin);
+	if (reusable != nullptr && reusable->channels == channels) {
+		/* the previous song had the same number of channels:
+		   reset and reuse its decoder */
+		opus_decoder = reusable->opus_decoder;
+		output_buffer = reusable->output_buffer;
+		reusable->opus_decoder = nullptr;
+		reusable->output_buffer = nullptr;
+
+		opus_decoder_ctl(opus_decoder, OPUS_RESET_STATE);
+	}
+
+	delete reusable;
+
 	if (opus_decoder == nullptr) {
-		FormatError(opus_domain, "libopus error: %s",
-			    opus_strerror(opus_error));
-		return DecoderCommand::STOP;
+		int opus_error;
+		opus_decoder = opus_decoder_create(opus_sample_rate, channels,
+						   &opus_error);
+		if (opus_decoder == nullptr) {
+			FormatError(opus_domain, "libopus error: %s",
+				    opus_strerror(opus_error));
+			return DecoderCommand::STOP;
+		}
 	}
 
 	eos_granulepos = LoadEOSGranulePos(input_stream, &decoder,
@@ -259,16 +329,17 @@ MPDOpusDecoder::HandleBOS(const ogg_packet &packet)
 		: -1.0;
 
 	const AudioFormat audio_format(opus_sample_rate,
-				       SampleFormat::S16, channels);
+				       opus_float
+				       ? SampleFormat::FLOAT
+				       : SampleFormat::S16,
+				       channels);
 	decoder_initialized(decoder, audio_format,
 			    eos_granulepos > 0, duration);
 	frame_size = audio_format.GetFrameSize();
 
-	/* allocate an output buffer for 16 bit PCM samples big enough
-	   to hold a quarter second, larger than 120ms required by
-	   libopus */
-	output_size = audio_format.sample_rate / 4;
-	output_buffer = new opus_int16[output_size * audio_format.channels];
+	if (output_buffer == nullptr)
+		output_buffer = new float[opus_output_buffer_frames *
+					  channels];
 
 	return decoder_get_command(decoder);
 }
@@ -301,11 +372,18 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 {
 	assert(opus_decoder != nullptr);
 
-	int nframes = opus_decode(opus_decoder,
-				  (const unsigned char*)packet.packet,
-				  packet.bytes,
-				  output_buffer, output_size,
-				  0);
+	int nframes = opus_float
+		? opus_decode_float(opus_decoder,
+				    (const unsigned char*)packet.packet,
+				    packet.bytes,
+				    output_buffer, opus_output_buffer_frames,
+				    0)
+		: opus_decode(opus_decoder,
+			      (const unsigned char*)packet.packet,
+			      packet.bytes,
+			      (opus_int16 *)output_buffer,
+			      opus_output_buffer_frames,
+			      0);
 	if (nframes < 0) {
 		LogError(opus_domain, opus_strerror(nframes));
 		return DecoderCommand::STOP;
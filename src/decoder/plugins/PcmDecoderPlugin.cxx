@@ -23,6 +23,7 @@
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
 #include "util/ByteReverse.hxx"
+#include "util/WritableBuffer.hxx"
 #include "Log.hxx"
 
 #include <string.h>
@@ -50,26 +51,44 @@ pcm_stream_decode(Decoder &decoder, InputStream &is)
 	decoder_initialized(decoder, audio_format,
 			    is.IsSeekable(), total_time);
 
+	const size_t frame_size = audio_format.GetFrameSize();
+
 	DecoderCommand cmd;
 	do {
 		char buffer[4096];
 
-		size_t nbytes = decoder_read(decoder, is,
-					     buffer, sizeof(buffer));
+		/* read directly into the music pipe if possible */
+		const auto dest = decoder_get_buffer(decoder, 0);
+		char *const p = dest.IsNull() ? buffer : (char *)dest.data;
+
+		size_t nbytes = decoder_read(decoder, is, p,
+					     dest.IsNull()
+					     ? sizeof(buffer) : dest.size);
+
+		/* complete the last frame */
+		const size_t partial = nbytes % frame_size;
+		if (partial > 0) {
+			if (decoder_read_full(&decoder, is, p + nbytes,
+					      frame_size - partial))
+				nbytes += frame_size - partial;
+			else
+				nbytes -= partial;
+		}
 
 		if (nbytes == 0 && is.LockIsEOF())
 			break;
 
 		if (reverse_endian)
 			/* make sure we deliver samples in host byte order */
-			reverse_bytes_16((uint16_t *)buffer,
-					 (uint16_t *)buffer,
-					 (uint16_t *)(buffer + nbytes));
-
-		cmd = nbytes > 0
-			? decoder_data(decoder, is,
-				       buffer, nbytes, 0)
-			: decoder_get_command(decoder);
+			reverse_bytes_16((uint16_t *)p,
+					 (uint16_t *)p,
+					 (uint16_t *)(p + nbytes));
+
+		cmd = nbytes == 0
+			? decoder_get_command(decoder)
+			: (dest.IsNull()
+			   ? decoder_data(decoder, is, buffer, nbytes, 0)
+			   : decoder_commit_data(decoder, is, nbytes));
 		if (cmd == DecoderCommand::SEEK) {
 			InputStream::offset_type offset(time_to_size *
 							decoder_seek_where(decoder));
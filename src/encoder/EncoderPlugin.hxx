@@ -20,9 +20,13 @@
 #ifndef MPD_ENCODER_PLUGIN_HXX
 #define MPD_ENCODER_PLUGIN_HXX
 
+#include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 struct EncoderPlugin;
 struct AudioFormat;
@@ -68,11 +72,20 @@ struct EncoderPlugin {
 	bool (*tag)(Encoder *encoder, const Tag *tag,
 		    Error &error);
 
-	bool (*write)(Encoder *encoder,
-		      const void *data, size_t length,
+	/**
+	 * Consume PCM data.  The plugin shall not keep a reference
+	 * to the buffer after returning.
+	 */
+	bool (*write)(Encoder *encoder, ConstBuffer<void> src,
 		      Error &error);
 
-	size_t (*read)(Encoder *encoder, void *dest, size_t length);
+	/**
+	 * Move encoded data into the caller's buffer.
+	 *
+	 * @return the number of bytes written to the buffer, 0 if
+	 * no more data is available right now
+	 */
+	size_t (*read)(Encoder *encoder, WritableBuffer<void> dest);
 
 	const char *(*get_mime_type)(Encoder *encoder);
 };
@@ -261,20 +274,18 @@ encoder_tag(Encoder *encoder, const Tag *tag, Error &error)
  * Writes raw PCM data to the encoder.
  *
  * @param encoder the encoder
- * @param data the buffer containing PCM samples
- * @param length the length of the buffer in bytes
+ * @param src the buffer containing PCM samples
  * @return true on success
  */
 static inline bool
-encoder_write(Encoder *encoder, const void *data, size_t length,
-	      Error &error)
+encoder_write(Encoder *encoder, ConstBuffer<void> src, Error &error)
 {
 	assert(encoder->open);
 	assert(!encoder->pre_tag);
 	assert(!encoder->tag);
 	assert(!encoder->end);
 
-	return encoder->plugin.write(encoder, data, length, error);
+	return encoder->plugin.write(encoder, src, error);
 }
 
 /**
@@ -284,11 +295,10 @@ encoder_write(Encoder *encoder, const void *data, size_t length,
  *
  * @param encoder the encoder
  * @param dest the destination buffer to copy to
- * @param length the maximum length of the destination buffer
  * @return the number of bytes written to #dest
  */
 static inline size_t
-encoder_read(Encoder *encoder, void *dest, size_t length)
+encoder_read(Encoder *encoder, WritableBuffer<void> dest)
 {
 	assert(encoder->open);
 	assert(!encoder->pre_tag || !encoder->tag);
@@ -300,7 +310,34 @@ encoder_read(Encoder *encoder, void *dest, size_t length)
 	}
 #endif
 
-	return encoder->plugin.read(encoder, dest, length);
+	return encoder->plugin.read(encoder, dest);
+}
+
+/**
+ * Like encoder_read(), but fill the whole buffer if the encoder has
+ * enough data, instead of returning after one small chunk.  This
+ * allows the caller to pass a page-sized buffer which it keeps (or
+ * sends) as-is, without copying it again.
+ *
+ * @return the number of bytes written to #dest
+ */
+static inline size_t
+encoder_read_all(Encoder *encoder, WritableBuffer<void> dest)
+{
+	uint8_t *const p = (uint8_t *)dest.data;
+	size_t position = 0;
+
+	while (position < dest.size) {
+		size_t nbytes = encoder_read(encoder,
+					     { p + position,
+					       dest.size - position });
+		if (nbytes == 0)
+			break;
+
+		position += nbytes;
+	}
+
+	return position;
 }
 
 /**
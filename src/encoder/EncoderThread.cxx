@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "EncoderThread.hxx"
+#include "EncoderPlugin.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "thread/Policy.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+EncoderThread::EncoderThread(Encoder &_encoder, Handler &_handler,
+			     size_t _max_queued)
+	:encoder(_encoder), handler(_handler), max_queued(_max_queued),
+	 queued(0), busy(false), quit(false), failed(false)
+{
+}
+
+EncoderThread::~EncoderThread()
+{
+	assert(!IsRunning());
+	assert(queue.empty());
+}
+
+bool
+EncoderThread::Start(Error &error_r)
+{
+	assert(!IsRunning());
+	assert(queue.empty());
+
+	quit = false;
+	failed = false;
+	error.Clear();
+
+	return thread.Start(Task, this, error_r);
+}
+
+void
+EncoderThread::Stop()
+{
+	assert(IsRunning());
+
+	mutex.lock();
+	quit = true;
+	cond.signal();
+	mutex.unlock();
+
+	thread.Join();
+
+	assert(queue.empty());
+}
+
+void
+EncoderThread::Cancel()
+{
+	const ScopeLock protect(mutex);
+
+	for (auto &command : queue)
+		delete command.tag;
+	queue.clear();
+	queued = 0;
+
+	while (busy)
+		done_cond.wait(mutex);
+}
+
+void
+EncoderThread::WaitIdle()
+{
+	while (!queue.empty() || busy)
+		done_cond.wait(mutex);
+}
+
+void
+EncoderThread::Drain()
+{
+	const ScopeLock protect(mutex);
+	WaitIdle();
+}
+
+void
+EncoderThread::Push(Command &&command)
+{
+	queue.emplace_back(std::move(command));
+	cond.signal();
+}
+
+bool
+EncoderThread::Write(ConstBuffer<void> src, Error &error_r)
+{
+	assert(IsRunning());
+
+	const ScopeLock protect(mutex);
+
+	while (!failed && !queue.empty() && queued + src.size > max_queued)
+		done_cond.wait(mutex);
+
+	if (failed) {
+		error_r.Set(error);
+		return false;
+	}
+
+	const uint8_t *p = (const uint8_t *)src.data;
+
+	Command command;
+	command.data.assign(p, p + src.size);
+	queued += src.size;
+	Push(std::move(command));
+	return true;
+}
+
+void
+EncoderThread::SendTag(const Tag &tag)
+{
+	assert(IsRunning());
+
+	const ScopeLock protect(mutex);
+
+	if (failed)
+		return;
+
+	Command command;
+	command.tag = new Tag(tag);
+	Push(std::move(command));
+}
+
+bool
+EncoderThread::Run(Command &command, Error &error_r)
+{
+	if (command.tag != nullptr) {
+		/* flush the current stream, and end it; the
+		   encoder_read() call in the handler is mandatory
+		   between encoder_pre_tag() and encoder_tag() */
+		return encoder_pre_tag(&encoder, error_r) &&
+			handler.OnEncoderOutput(encoder, 0, error_r) &&
+			encoder_tag(&encoder, command.tag, error_r) &&
+			handler.OnEncoderTag(encoder, error_r);
+	}
+
+	return encoder_write(&encoder, { command.data.data(),
+					 command.data.size() },
+			     error_r) &&
+		handler.OnEncoderOutput(encoder, command.data.size(),
+					error_r);
+}
+
+inline void
+EncoderThread::Task()
+{
+	SetThreadName("encoder");
+
+	/* don't inherit the real-time priority of the output
+	   thread */
+	SetThreadNormalPriority();
+
+	Error policy_error;
+	if (!ApplyThreadPolicy(ThreadClass::ENCODER, policy_error))
+		LogError(policy_error);
+
+	mutex.lock();
+
+	while (true) {
+		if (queue.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		Command command = std::move(queue.front());
+		queue.pop_front();
+		queued -= command.data.size();
+		busy = true;
+
+		if (!failed) {
+			mutex.unlock();
+
+			Error command_error;
+			const bool success = Run(command, command_error);
+
+			mutex.lock();
+
+			if (!success) {
+				failed = true;
+				error = std::move(command_error);
+			}
+		}
+
+		delete command.tag;
+
+		busy = false;
+		done_cond.broadcast();
+	}
+
+	mutex.unlock();
+}
+
+void
+EncoderThread::Task(void *ctx)
+{
+	EncoderThread &thread = *(EncoderThread *)ctx;
+	thread.Task();
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ENCODER_THREAD_HXX
+#define MPD_ENCODER_THREAD_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+
+#include <deque>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Encoder;
+struct Tag;
+
+/**
+ * Runs an opened #Encoder in a separate thread.  The output thread
+ * only submits PCM data to a bounded queue; encoding (and passing
+ * the encoded data on, see #Handler) happens in the encoder thread,
+ * so a slow encoder does not delay the output's consumption of the
+ * music pipe, and the encoders of several outputs run on different
+ * CPUs.
+ *
+ * While the thread is running, the #Encoder must not be used by
+ * anybody else.  Stop() returns it to the caller, e.g. for
+ * encoder_end().
+ */
+class EncoderThread {
+public:
+	/**
+	 * Receives the output of the encoder.  All methods are
+	 * called in the encoder thread.
+	 */
+	class Handler {
+	public:
+		/**
+		 * The encoder may have produced new data; obtain it
+		 * with encoder_read().
+		 *
+		 * @param input_size the number of PCM bytes which
+		 * were just passed to the encoder; 0 after
+		 * encoder_pre_tag()
+		 * @return false on error; the error is reported by
+		 * the next Write() call
+		 */
+		virtual bool OnEncoderOutput(Encoder &encoder,
+					     size_t input_size,
+					     Error &error) = 0;
+
+		/**
+		 * encoder_tag() has been called; the next output
+		 * begins a new stream.
+		 */
+		virtual bool OnEncoderTag(Encoder &encoder,
+					  Error &error) = 0;
+	};
+
+	/**
+	 * The default limit for queued PCM data: about 1.5 seconds
+	 * of 16 bit stereo at 44.1 kHz.
+	 */
+	static constexpr size_t DEFAULT_MAX_QUEUED = 256 * 1024;
+
+private:
+	struct Command {
+		/**
+		 * PCM data for encoder_write(), or empty if this is
+		 * a tag.
+		 */
+		std::vector<uint8_t> data;
+
+		/**
+		 * A tag for encoder_pre_tag() and encoder_tag(), or
+		 * nullptr.
+		 */
+		Tag *tag;
+
+		Command():tag(nullptr) {}
+	};
+
+	Encoder &encoder;
+	Handler &handler;
+
+	const size_t max_queued;
+
+	Thread thread;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a command was queued, or when the thread
+	 * shall quit.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a command has been finished.
+	 */
+	Cond done_cond;
+
+	std::deque<Command> queue;
+
+	/**
+	 * The number of PCM bytes in #queue.
+	 */
+	size_t queued;
+
+	/**
+	 * Is the thread currently executing a command (outside of
+	 * the #queue)?
+	 */
+	bool busy;
+
+	bool quit;
+
+	/**
+	 * Set by the thread when the encoder or the #Handler has
+	 * failed.  Further commands are discarded.
+	 */
+	bool failed;
+	Error error;
+
+public:
+	EncoderThread(Encoder &_encoder, Handler &_handler,
+		      size_t _max_queued=DEFAULT_MAX_QUEUED);
+	~EncoderThread();
+
+	EncoderThread(const EncoderThread &) = delete;
+	EncoderThread &operator=(const EncoderThread &) = delete;
+
+	bool IsRunning() const {
+		return thread.IsDefined();
+	}
+
+	/**
+	 * Start the thread.  The encoder must be open.
+	 */
+	bool Start(Error &error);
+
+	/**
+	 * Encode all queued data and stop the thread.  Afterwards,
+	 * the caller owns the encoder again.
+	 */
+	void Stop();
+
+	/**
+	 * Discard all queued data which has not been encoded yet,
+	 * and wait until the current command has finished.
+	 */
+	void Cancel();
+
+	/**
+	 * Wait until all queued data has been encoded.
+	 */
+	void Drain();
+
+	/**
+	 * Queue PCM data for the encoder.  Blocks while the queue is
+	 * full.
+	 *
+	 * @return false if the encoder has failed previously
+	 */
+	bool Write(ConstBuffer<void> src, Error &error);
+
+	/**
+	 * Queue a tag for the encoder (encoder_pre_tag() and
+	 * encoder_tag()).  The tag is copied.
+	 */
+	void SendTag(const Tag &tag);
+
+private:
+	void Push(Command &&command);
+
+	/**
+	 * Wait until the queue is empty and the thread is idle.  The
+	 * caller must hold the mutex.
+	 */
+	void WaitIdle();
+
+	/**
+	 * Run one command.  Called without holding the mutex.
+	 */
+	bool Run(Command &command, Error &error);
+
+	void Task();
+	static void Task(void *ctx);
+};
+
+#endif
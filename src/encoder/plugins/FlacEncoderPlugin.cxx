@@ -242,8 +242,7 @@ pcm16_to_flac(int32_t *out, const int16_t *in, unsigned num_samples)
 }
 
 static bool
-flac_encoder_write(Encoder *_encoder,
-		   const void *data, size_t length,
+flac_encoder_write(Encoder *_encoder, ConstBuffer<void> src,
 		   gcc_unused Error &error)
 {
 	struct flac_encoder *encoder = (struct flac_encoder *)_encoder;
@@ -253,20 +252,20 @@ flac_encoder_write(Encoder *_encoder,
 
 	/* format conversion */
 
-	num_frames = length / encoder->audio_format.GetFrameSize();
+	num_frames = src.size / encoder->audio_format.GetFrameSize();
 	num_samples = num_frames * encoder->audio_format.channels;
 
 	switch (encoder->audio_format.format) {
 	case SampleFormat::S8:
-		exbuffer = encoder->expand_buffer.Get(length * 4);
-		pcm8_to_flac((int32_t *)exbuffer, (const int8_t *)data,
+		exbuffer = encoder->expand_buffer.Get(src.size * 4);
+		pcm8_to_flac((int32_t *)exbuffer, (const int8_t *)src.data,
 			     num_samples);
 		buffer = exbuffer;
 		break;
 
 	case SampleFormat::S16:
-		exbuffer = encoder->expand_buffer.Get(length * 2);
-		pcm16_to_flac((int32_t *)exbuffer, (const int16_t *)data,
+		exbuffer = encoder->expand_buffer.Get(src.size * 2);
+		pcm16_to_flac((int32_t *)exbuffer, (const int16_t *)src.data,
 			      num_samples);
 		buffer = exbuffer;
 		break;
@@ -275,7 +274,7 @@ flac_encoder_write(Encoder *_encoder,
 	case SampleFormat::S32:
 		/* nothing need to be done; format is the same for
 		   both mpd and libFLAC */
-		buffer = data;
+		buffer = src.data;
 		break;
 
 	default:
@@ -295,11 +294,11 @@ flac_encoder_write(Encoder *_encoder,
 }
 
 static size_t
-flac_encoder_read(Encoder *_encoder, void *dest, size_t length)
+flac_encoder_read(Encoder *_encoder, WritableBuffer<void> dest)
 {
 	struct flac_encoder *encoder = (struct flac_encoder *)_encoder;
 
-	return encoder->output_buffer->Read((uint8_t *)dest, length);
+	return encoder->output_buffer->Read((uint8_t *)dest.data, dest.size);
 }
 
 static const char *
@@ -218,19 +218,18 @@ lame_encoder_close(Encoder *_encoder)
 }
 
 static bool
-lame_encoder_write(Encoder *_encoder,
-		   const void *data, size_t length,
+lame_encoder_write(Encoder *_encoder, ConstBuffer<void> _src,
 		   gcc_unused Error &error)
 {
 	LameEncoder *encoder = (LameEncoder *)_encoder;
-	const int16_t *src = (const int16_t*)data;
+	const int16_t *src = (const int16_t*)_src.data;
 
 	assert(encoder->output_begin == encoder->output_end);
 
 	const unsigned num_frames =
-		length / encoder->audio_format.GetFrameSize();
+		_src.size / encoder->audio_format.GetFrameSize();
 	const unsigned num_samples =
-		length / encoder->audio_format.GetSampleSize();
+		_src.size / encoder->audio_format.GetSampleSize();
 
 	/* worst-case formula according to LAME documentation */
 	const size_t output_buffer_size = 5 * num_samples / 4 + 7200;
@@ -255,17 +254,18 @@ lame_encoder_write(Encoder *_encoder,
 }
 
 static size_t
-lame_encoder_read(Encoder *_encoder, void *dest, size_t length)
+lame_encoder_read(Encoder *_encoder, WritableBuffer<void> dest)
 {
 	LameEncoder *encoder = (LameEncoder *)_encoder;
 
 	const auto begin = encoder->output_begin;
 	assert(begin <= encoder->output_end);
 	const size_t remainning = encoder->output_end - begin;
+	size_t length = dest.size;
 	if (length > remainning)
 		length = remainning;
 
-	memcpy(dest, begin, length);
+	memcpy(dest.data, begin, length);
 
 	encoder->output_begin = begin + length;
 	return length;
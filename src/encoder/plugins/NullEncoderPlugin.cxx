@@ -71,22 +71,21 @@ null_encoder_open(Encoder *_encoder,
 }
 
 static bool
-null_encoder_write(Encoder *_encoder,
-		   const void *data, size_t length,
+null_encoder_write(Encoder *_encoder, ConstBuffer<void> src,
 		   gcc_unused Error &error)
 {
 	NullEncoder *encoder = (NullEncoder *)_encoder;
 
-	encoder->buffer->Append((const uint8_t *)data, length);
-	return length;
+	encoder->buffer->Append((const uint8_t *)src.data, src.size);
+	return true;
 }
 
 static size_t
-null_encoder_read(Encoder *_encoder, void *dest, size_t length)
+null_encoder_read(Encoder *_encoder, WritableBuffer<void> dest)
 {
 	NullEncoder *encoder = (NullEncoder *)_encoder;
 
-	return encoder->buffer->Read((uint8_t *)dest, length);
+	return encoder->buffer->Read((uint8_t *)dest.data, dest.size);
 }
 
 const EncoderPlugin null_encoder_plugin = {
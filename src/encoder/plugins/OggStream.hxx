@@ -92,6 +92,16 @@ public:
 				    const_cast<ogg_packet *>(&packet));
 	}
 
+	/**
+	 * Obtain a page with all remaining packets, regardless of
+	 * its size.
+	 */
+	bool FlushPage(ogg_page &page) {
+		assert(initialized);
+
+		return ogg_stream_flush(&state, &page) != 0;
+	}
+
 	bool PageOut(ogg_page &page) {
 		int result = ogg_stream_pageout(&state, &page);
 		if (result == 0 && flush) {
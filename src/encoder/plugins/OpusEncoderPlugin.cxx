@@ -25,6 +25,8 @@
 #include "AudioFormat.hxx"
 #include "config/ConfigError.hxx"
 #include "util/Alloc.hxx"
+#include "util/Manual.hxx"
+#include "util/DynamicFifoBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "system/ByteOrder.hxx"
@@ -44,6 +46,19 @@ struct opus_encoder {
 	opus_int32 bitrate;
 	int complexity;
 	int signal;
+	int application;
+
+	/**
+	 * The number of frames per packet, i.e. the Opus frame
+	 * duration.
+	 */
+	size_t buffer_frames;
+
+	/**
+	 * Finish an Ogg page after this number of audio packets; 0
+	 * lets libogg fill pages of about 4 kB.
+	 */
+	unsigned packets_per_page;
 
 	/* runtime information */
 
@@ -51,7 +66,7 @@ struct opus_encoder {
 
 	size_t frame_size;
 
-	size_t buffer_frames, buffer_size, buffer_position;
+	size_t buffer_size, buffer_position;
 	uint8_t *buffer;
 
 	OpusEncoder *enc;
@@ -66,6 +81,18 @@ struct opus_encoder {
 
 	ogg_int64_t granulepos;
 
+	/**
+	 * The number of audio packets in the current Ogg page (only
+	 * used if #packets_per_page is non-zero).
+	 */
+	unsigned page_packets;
+
+	/**
+	 * Pages which were finished after #packets_per_page packets,
+	 * to be picked up by opus_encoder_read().
+	 */
+	Manual<DynamicFifoBuffer<uint8_t>> output_buffer;
+
 	opus_encoder():encoder(opus_encoder_plugin) {}
 };
 
@@ -108,6 +135,49 @@ opus_encoder_configure(struct opus_encoder *encoder,
 		return false;
 	}
 
+	value = param.GetBlockValue("application", "audio");
+	if (strcmp(value, "audio") == 0)
+		encoder->application = OPUS_APPLICATION_AUDIO;
+	else if (strcmp(value, "voip") == 0)
+		encoder->application = OPUS_APPLICATION_VOIP;
+	else if (strcmp(value, "lowdelay") == 0)
+		encoder->application = OPUS_APPLICATION_RESTRICTED_LOWDELAY;
+	else {
+		error.Format(config_domain, "Invalid application");
+		return false;
+	}
+
+	/* the frame durations supported by Opus, in milliseconds,
+	   and the corresponding number of frames at 48 kHz */
+	static constexpr struct {
+		const char *name;
+		unsigned frames;
+	} frame_sizes[] = {
+		{ "2.5", 120 },
+		{ "5", 240 },
+		{ "10", 480 },
+		{ "20", 960 },
+		{ "40", 1920 },
+		{ "60", 2880 },
+	};
+
+	value = param.GetBlockValue("frame_size", "20");
+	encoder->buffer_frames = 0;
+	for (const auto &i : frame_sizes) {
+		if (strcmp(value, i.name) == 0) {
+			encoder->buffer_frames = i.frames;
+			break;
+		}
+	}
+
+	if (encoder->buffer_frames == 0) {
+		error.Format(config_domain, "Invalid frame size: %s", value);
+		return false;
+	}
+
+	encoder->packets_per_page =
+		param.GetBlockValue("packets_per_page", 0u);
+
 	return true;
 }
 
@@ -169,7 +239,7 @@ opus_encoder_open(Encoder *_encoder,
 	int error_code;
 	encoder->enc = opus_encoder_create(audio_format.sample_rate,
 					   audio_format.channels,
-					   OPUS_APPLICATION_AUDIO,
+					   encoder->application,
 					   &error_code);
 	if (encoder->enc == nullptr) {
 		error.Set(opus_encoder_domain, error_code,
@@ -184,13 +254,14 @@ opus_encoder_open(Encoder *_encoder,
 
 	opus_encoder_ctl(encoder->enc, OPUS_GET_LOOKAHEAD(&encoder->lookahead));
 
-	encoder->buffer_frames = audio_format.sample_rate / 50;
 	encoder->buffer_size = encoder->frame_size * encoder->buffer_frames;
 	encoder->buffer_position = 0;
 	encoder->buffer = (unsigned char *)xalloc(encoder->buffer_size);
 
 	encoder->stream.Initialize(GenerateOggSerial());
 	encoder->packetno = 0;
+	encoder->page_packets = 0;
+	encoder->output_buffer.Construct(8192);
 
 	return true;
 }
@@ -201,25 +272,33 @@ opus_encoder_close(Encoder *_encoder)
 	struct opus_encoder *encoder = (struct opus_encoder *)_encoder;
 
 	encoder->stream.Deinitialize();
+	encoder->output_buffer.Destruct();
 	free(encoder->buffer);
 	opus_encoder_destroy(encoder->enc);
 }
 
+/**
+ * Encode one frame of #buffer_frames.
+ *
+ * @param src the PCM data; either #buffer (which must be full), or
+ * a complete frame in the caller's buffer
+ */
 static bool
-opus_encoder_do_encode(struct opus_encoder *encoder, bool eos,
-		       Error &error)
+opus_encoder_do_encode(struct opus_encoder *encoder, const void *src,
+		       bool eos, Error &error)
 {
-	assert(encoder->buffer_position == encoder->buffer_size);
+	assert(src != encoder->buffer ||
+	       encoder->buffer_position == encoder->buffer_size);
 
 	opus_int32 result =
 		encoder->audio_format.format == SampleFormat::S16
 		? opus_encode(encoder->enc,
-			      (const opus_int16 *)encoder->buffer,
+			      (const opus_int16 *)src,
 			      encoder->buffer_frames,
 			      encoder->buffer2,
 			      sizeof(encoder->buffer2))
 		: opus_encode_float(encoder->enc,
-				    (const float *)encoder->buffer,
+				    (const float *)src,
 				    encoder->buffer_frames,
 				    encoder->buffer2,
 				    sizeof(encoder->buffer2));
@@ -241,6 +320,21 @@ opus_encoder_do_encode(struct opus_encoder *encoder, bool eos,
 
 	encoder->buffer_position = 0;
 
+	if (encoder->packets_per_page > 0 &&
+	    ++encoder->page_packets >= encoder->packets_per_page) {
+		/* finish the page right now, so it contains exactly
+		   this number of packets */
+		encoder->page_packets = 0;
+
+		ogg_page page;
+		while (encoder->stream.FlushPage(page)) {
+			encoder->output_buffer->Append(page.header,
+						       page.header_len);
+			encoder->output_buffer->Append(page.body,
+						       page.body_len);
+		}
+	}
+
 	return true;
 }
 
@@ -255,7 +349,7 @@ opus_encoder_end(Encoder *_encoder, Error &error)
 	       encoder->buffer_size - encoder->buffer_position);
 	encoder->buffer_position = encoder->buffer_size;
 
-	return opus_encoder_do_encode(encoder, true, error);
+	return opus_encoder_do_encode(encoder, encoder->buffer, true, error);
 }
 
 static bool
@@ -285,7 +379,8 @@ opus_encoder_write_silence(struct opus_encoder *encoder, unsigned fill_frames,
 		fill_bytes -= nbytes;
 
 		if (encoder->buffer_position == encoder->buffer_size &&
-		    !opus_encoder_do_encode(encoder, false, error))
+		    !opus_encoder_do_encode(encoder, encoder->buffer, false,
+					    error))
 			return false;
 	}
 
@@ -293,12 +388,12 @@ opus_encoder_write_silence(struct opus_encoder *encoder, unsigned fill_frames,
 }
 
 static bool
-opus_encoder_write(Encoder *_encoder,
-		   const void *_data, size_t length,
+opus_encoder_write(Encoder *_encoder, ConstBuffer<void> src,
 		   Error &error)
 {
 	struct opus_encoder *encoder = (struct opus_encoder *)_encoder;
-	const uint8_t *data = (const uint8_t *)_data;
+	const uint8_t *data = (const uint8_t *)src.data;
+	size_t length = src.size;
 
 	if (encoder->lookahead > 0) {
 		/* generate some silence at the beginning of the
@@ -314,6 +409,19 @@ opus_encoder_write(Encoder *_encoder,
 	}
 
 	while (length > 0) {
+		if (encoder->buffer_position == 0 &&
+		    length >= encoder->buffer_size) {
+			/* a complete frame is available in the
+			   caller's buffer; encode it from there */
+			if (!opus_encoder_do_encode(encoder, data, false,
+						    error))
+				return false;
+
+			data += encoder->buffer_size;
+			length -= encoder->buffer_size;
+			continue;
+		}
+
 		size_t nbytes =
 			encoder->buffer_size - encoder->buffer_position;
 		if (nbytes > length)
@@ -326,7 +434,8 @@ opus_encoder_write(Encoder *_encoder,
 		encoder->buffer_position += nbytes;
 
 		if (encoder->buffer_position == encoder->buffer_size &&
-		    !opus_encoder_do_encode(encoder, false, error))
+		    !opus_encoder_do_encode(encoder, encoder->buffer, false,
+					    error))
 			return false;
 	}
 
@@ -385,7 +494,7 @@ opus_encoder_generate_tags(struct opus_encoder *encoder)
 }
 
 static size_t
-opus_encoder_read(Encoder *_encoder, void *dest, size_t length)
+opus_encoder_read(Encoder *_encoder, WritableBuffer<void> dest)
 {
 	struct opus_encoder *encoder = (struct opus_encoder *)_encoder;
 
@@ -394,7 +503,14 @@ opus_encoder_read(Encoder *_encoder, void *dest, size_t length)
 	else if (encoder->packetno == 1)
 		opus_encoder_generate_tags(encoder);
 
-	return encoder->stream.PageOut(dest, length);
+	/* pages finished by opus_encoder_do_encode() are older than
+	   the ones still in the stream */
+	size_t nbytes = encoder->output_buffer->Read((uint8_t *)dest.data,
+						     dest.size);
+	if (nbytes > 0)
+		return nbytes;
+
+	return encoder->stream.PageOut(dest.data, dest.size);
 }
 
 static const char *
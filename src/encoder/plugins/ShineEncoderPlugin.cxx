@@ -194,13 +194,13 @@ ShineEncoder::WriteChunk(bool flush)
 }
 
 static bool
-shine_encoder_write(Encoder *_encoder,
-		    const void *_data, size_t length,
+shine_encoder_write(Encoder *_encoder, ConstBuffer<void> src,
 		    gcc_unused Error &error)
 {
 	ShineEncoder *encoder = (ShineEncoder *)_encoder;
-	const int16_t *data = (const int16_t*)_data;
-	length /= sizeof(*data) * encoder->audio_format.channels;
+	const int16_t *data = (const int16_t*)src.data;
+	const size_t length =
+		src.size / (sizeof(*data) * encoder->audio_format.channels);
 	size_t written = 0;
 
 	if (encoder->input_pos > SHINE_MAX_SAMPLES) {
@@ -242,11 +242,11 @@ shine_encoder_flush(Encoder *_encoder, gcc_unused Error &error)
 }
 
 static size_t
-shine_encoder_read(Encoder *_encoder, void *dest, size_t length)
+shine_encoder_read(Encoder *_encoder, WritableBuffer<void> dest)
 {
 	ShineEncoder *encoder = (ShineEncoder *)_encoder;
 
-	return encoder->output_buffer->Read((uint8_t *)dest, length);
+	return encoder->output_buffer->Read((uint8_t *)dest.data, dest.size);
 }
 
 static const char *
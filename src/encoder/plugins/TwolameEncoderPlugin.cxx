@@ -230,18 +230,17 @@ twolame_encoder_flush(Encoder *_encoder, gcc_unused Error &error)
 }
 
 static bool
-twolame_encoder_write(Encoder *_encoder,
-		      const void *data, size_t length,
+twolame_encoder_write(Encoder *_encoder, ConstBuffer<void> _src,
 		      gcc_unused Error &error)
 {
 	TwolameEncoder *encoder = (TwolameEncoder *)_encoder;
-	const int16_t *src = (const int16_t*)data;
+	const int16_t *src = (const int16_t*)_src.data;
 
 	assert(encoder->output_buffer_position ==
 	       encoder->output_buffer_length);
 
 	const unsigned num_frames =
-		length / encoder->audio_format.GetFrameSize();
+		_src.size / encoder->audio_format.GetFrameSize();
 
 	int bytes_out = twolame_encode_buffer_interleaved(encoder->options,
 							  src, num_frames,
@@ -258,7 +257,7 @@ twolame_encoder_write(Encoder *_encoder,
 }
 
 static size_t
-twolame_encoder_read(Encoder *_encoder, void *dest, size_t length)
+twolame_encoder_read(Encoder *_encoder, WritableBuffer<void> dest)
 {
 	TwolameEncoder *encoder = (TwolameEncoder *)_encoder;
 
@@ -281,10 +280,11 @@ twolame_encoder_read(Encoder *_encoder, void *dest, size_t length)
 
 	const size_t remainning = encoder->output_buffer_length
 		- encoder->output_buffer_position;
+	size_t length = dest.size;
 	if (length > remainning)
 		length = remainning;
 
-	memcpy(dest, encoder->output_buffer + encoder->output_buffer_position,
+	memcpy(dest.data, encoder->output_buffer + encoder->output_buffer_position,
 	       length);
 
 	encoder->output_buffer_position += length;
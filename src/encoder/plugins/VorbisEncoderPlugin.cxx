@@ -314,19 +314,18 @@ interleaved_to_vorbis_buffer(float **dest, const float *src,
 }
 
 static bool
-vorbis_encoder_write(Encoder *_encoder,
-		     const void *data, size_t length,
+vorbis_encoder_write(Encoder *_encoder, ConstBuffer<void> src,
 		     gcc_unused Error &error)
 {
 	struct vorbis_encoder *encoder = (struct vorbis_encoder *)_encoder;
 
-	unsigned num_frames = length / encoder->audio_format.GetFrameSize();
+	unsigned num_frames = src.size / encoder->audio_format.GetFrameSize();
 
 	/* this is for only 16-bit audio */
 
 	interleaved_to_vorbis_buffer(vorbis_analysis_buffer(&encoder->vd,
 							    num_frames),
-				     (const float *)data,
+				     (const float *)src.data,
 				     num_frames,
 				     encoder->audio_format.channels);
 
@@ -336,11 +335,11 @@ vorbis_encoder_write(Encoder *_encoder,
 }
 
 static size_t
-vorbis_encoder_read(Encoder *_encoder, void *dest, size_t length)
+vorbis_encoder_read(Encoder *_encoder, WritableBuffer<void> dest)
 {
 	struct vorbis_encoder *encoder = (struct vorbis_encoder *)_encoder;
 
-	return encoder->stream.PageOut(dest, length);
+	return encoder->stream.PageOut(dest.data, dest.size);
 }
 
 static const char *
@@ -193,11 +193,12 @@ pcm24_to_wave(uint8_t *dst8, const uint32_t *src32, size_t length)
 }
 
 static bool
-wave_encoder_write(Encoder *_encoder,
-		   const void *src, size_t length,
+wave_encoder_write(Encoder *_encoder, ConstBuffer<void> _src,
 		   gcc_unused Error &error)
 {
 	WaveEncoder *encoder = (WaveEncoder *)_encoder;
+	const void *src = _src.data;
+	size_t length = _src.size;
 
 	uint8_t *dst = encoder->buffer->Write(length);
 
@@ -236,11 +237,11 @@ wave_encoder_write(Encoder *_encoder,
 }
 
 static size_t
-wave_encoder_read(Encoder *_encoder, void *dest, size_t length)
+wave_encoder_read(Encoder *_encoder, WritableBuffer<void> dest)
 {
 	WaveEncoder *encoder = (WaveEncoder *)_encoder;
 
-	return encoder->buffer->Read((uint8_t *)dest, length);
+	return encoder->buffer->Read((uint8_t *)dest.data, dest.size);
 }
 
 static const char *
@@ -49,17 +49,31 @@ BufferedSocket::DirectRead(void *data, size_t length)
 	return -1;
 }
 
+void
+BufferedSocket::ReleaseInput()
+{
+	if (input != nullptr && input->IsEmpty()) {
+		delete input;
+		input = nullptr;
+	}
+}
+
 bool
 BufferedSocket::ReadToBuffer()
 {
 	assert(IsDefined());
 
-	const auto buffer = input.Write();
+	if (input == nullptr)
+		input = new DynamicFifoBuffer<uint8_t>(INPUT_SIZE);
+
+	const auto buffer = input->Write();
 	assert(!buffer.IsEmpty());
 
 	const auto nbytes = DirectRead(buffer.data, buffer.size);
 	if (nbytes > 0)
-		input.Append(nbytes);
+		input->Append(nbytes);
+	else if (nbytes == 0)
+		ReleaseInput();
 
 	return nbytes >= 0;
 }
@@ -70,8 +84,14 @@ BufferedSocket::ResumeInput()
 	assert(IsDefined());
 
 	while (true) {
-		const auto buffer = input.Read();
+		if (input == nullptr) {
+			ScheduleRead();
+			return true;
+		}
+
+		const auto buffer = input->Read();
 		if (buffer.IsEmpty()) {
+			ReleaseInput();
 			ScheduleRead();
 			return true;
 		}
@@ -79,7 +99,7 @@ BufferedSocket::ResumeInput()
 		const auto result = OnSocketInput(buffer.data, buffer.size);
 		switch (result) {
 		case InputResult::MORE:
-			if (input.IsFull()) {
+			if (input->IsFull()) {
 				// TODO
 				static constexpr Domain buffered_socket_domain("buffered_socket");
 				Error error;
@@ -89,10 +109,12 @@ BufferedSocket::ResumeInput()
 				return false;
 			}
 
+			ReleaseInput();
 			ScheduleRead();
 			return true;
 
 		case InputResult::PAUSE:
+			ReleaseInput();
 			CancelRead();
 			return true;
 
@@ -116,12 +138,12 @@ BufferedSocket::OnSocketReady(unsigned flags)
 	}
 
 	if (flags & READ) {
-		assert(!input.IsFull());
+		assert(!IsInputFull());
 
 		if (!ReadToBuffer() || !ResumeInput())
 			return false;
 
-		if (input.IsFull())
+		if (IsInputFull())
 			ScheduleRead();
 	}
 
@@ -22,7 +22,8 @@
 
 #include "check.h"
 #include "SocketMonitor.hxx"
-#include "util/FifoBuffer.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+#include "Compiler.h"
 
 #include <assert.h>
 #include <stdint.h>
@@ -34,14 +35,24 @@ class EventLoop;
  * A #SocketMonitor specialization that adds an input buffer.
  */
 class BufferedSocket : protected SocketMonitor {
-	FifoBuffer<uint8_t, 8192> input;
+	static constexpr size_t INPUT_SIZE = 8192;
+
+	/**
+	 * The input buffer.  It is allocated only while there is
+	 * unconsumed data, so idle connections don't hold it.
+	 */
+	DynamicFifoBuffer<uint8_t> *input;
 
 public:
 	BufferedSocket(int _fd, EventLoop &_loop)
-		:SocketMonitor(_fd, _loop) {
+		:SocketMonitor(_fd, _loop), input(nullptr) {
 		ScheduleRead();
 	}
 
+	~BufferedSocket() {
+		delete input;
+	}
+
 	using SocketMonitor::IsDefined;
 	using SocketMonitor::Close;
 	using SocketMonitor::Write;
@@ -49,6 +60,16 @@ public:
 private:
 	ssize_t DirectRead(void *data, size_t length);
 
+	gcc_pure
+	bool IsInputFull() const {
+		return input != nullptr && input->IsFull();
+	}
+
+	/**
+	 * Free the input buffer if it is empty.
+	 */
+	void ReleaseInput();
+
 	/**
 	 * Receive data from the socket to the input buffer.
 	 *
@@ -70,8 +91,9 @@ protected:
 	 */
 	void ConsumeInput(size_t nbytes) {
 		assert(IsDefined());
+		assert(input != nullptr);
 
-		input.Consume(nbytes);
+		input->Consume(nbytes);
 	}
 
 	enum class InputResult {
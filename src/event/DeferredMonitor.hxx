@@ -23,7 +23,7 @@
 #include "check.h"
 #include "Compiler.h"
 
-#include <atomic>
+#include <boost/intrusive/list_hook.hpp>
 
 class EventLoop;
 
@@ -36,11 +36,18 @@ class DeferredMonitor {
 	EventLoop &loop;
 
 	friend class EventLoop;
-	bool pending;
+
+	typedef boost::intrusive::list_member_hook<> Hook;
+
+	/**
+	 * Links this object into EventLoop::deferred while it is
+	 * pending.  Protected by EventLoop::mutex.
+	 */
+	Hook deferred_hook;
 
 public:
 	DeferredMonitor(EventLoop &_loop)
-		:loop(_loop), pending(false) {}
+		:loop(_loop) {}
 
 	~DeferredMonitor() {
 		Cancel();
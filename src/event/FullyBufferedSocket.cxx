@@ -31,12 +31,19 @@
 #ifndef WIN32
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 FullyBufferedSocket::ssize_t
 FullyBufferedSocket::DirectWrite(const void *data, size_t length)
 {
-	const auto nbytes = SocketMonitor::Write((const char *)data, length);
+	return CheckWriteResult(SocketMonitor::Write((const char *)data,
+						     length));
+}
+
+FullyBufferedSocket::ssize_t
+FullyBufferedSocket::CheckWriteResult(ssize_t nbytes)
+{
 	if (gcc_unlikely(nbytes < 0)) {
 		const auto code = GetSocketError();
 		if (IsSocketErrorAgain(code))
@@ -54,24 +61,52 @@ FullyBufferedSocket::DirectWrite(const void *data, size_t length)
 	return nbytes;
 }
 
+FullyBufferedSocket::ssize_t
+FullyBufferedSocket::SendOutput()
+{
+	WritableBuffer<void> segments[2] = { nullptr, nullptr };
+	const unsigned n_segments = output.Read(segments);
+	assert(n_segments > 0);
+
+	ssize_t nbytes;
+#ifdef WIN32
+	nbytes = DirectWrite(segments[0].data, segments[0].size);
+#else
+	if (n_segments > 1) {
+		/* send both the normal and the peak buffer with one
+		   system call */
+		struct iovec v[2];
+		for (unsigned i = 0; i < n_segments; ++i) {
+			v[i].iov_base = segments[i].data;
+			v[i].iov_len = segments[i].size;
+		}
+
+		nbytes = CheckWriteResult(SocketMonitor::Write(v, n_segments));
+	} else
+		nbytes = DirectWrite(segments[0].data, segments[0].size);
+#endif
+
+	if (nbytes > 0)
+		output.Consume(nbytes);
+
+	return nbytes;
+}
+
 bool
 FullyBufferedSocket::Flush()
 {
 	assert(IsDefined());
 
-	const auto data = output.Read();
-	if (data.IsEmpty()) {
+	if (output.IsEmpty()) {
 		IdleMonitor::Cancel();
 		CancelWrite();
 		return true;
 	}
 
-	auto nbytes = DirectWrite(data.data, data.size);
+	auto nbytes = SendOutput();
 	if (gcc_unlikely(nbytes <= 0))
 		return nbytes == 0;
 
-	output.Consume(nbytes);
-
 	if (output.IsEmpty()) {
 		IdleMonitor::Cancel();
 		CancelWrite();
@@ -80,6 +115,16 @@ FullyBufferedSocket::Flush()
 	return true;
 }
 
+bool
+FullyBufferedSocket::CheckOutputAvailable()
+{
+	if (!output_wanted || IsOutputCongested())
+		return true;
+
+	output_wanted = false;
+	return OnOutputAvailable();
+}
+
 bool
 FullyBufferedSocket::Write(const void *data, size_t length)
 {
@@ -104,6 +149,22 @@ FullyBufferedSocket::Write(const void *data, size_t length)
 	return true;
 }
 
+void
+FullyBufferedSocket::CommitWrite(size_t length)
+{
+	assert(IsDefined());
+
+	if (length == 0)
+		return;
+
+	const bool was_empty = output.IsEmpty();
+
+	output.Append(length);
+
+	if (was_empty)
+		IdleMonitor::Schedule();
+}
+
 bool
 FullyBufferedSocket::OnSocketReady(unsigned flags)
 {
@@ -111,7 +172,7 @@ FullyBufferedSocket::OnSocketReady(unsigned flags)
 		assert(!output.IsEmpty());
 		assert(!IdleMonitor::IsActive());
 
-		if (!Flush())
+		if (!Flush() || !CheckOutputAvailable())
 			return false;
 	}
 
@@ -124,6 +185,6 @@ FullyBufferedSocket::OnSocketReady(unsigned flags)
 void
 FullyBufferedSocket::OnIdle()
 {
-	if (Flush() && !output.IsEmpty())
+	if (Flush() && CheckOutputAvailable() && !output.IsEmpty())
 		ScheduleWrite();
 }
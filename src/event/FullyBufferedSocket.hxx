@@ -31,11 +31,20 @@
 class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor {
 	PeakBuffer output;
 
+	/**
+	 * Shall OnOutputAvailable() be invoked as soon as the output
+	 * buffer has drained below its normal size?  See
+	 * WaitOutputAvailable().
+	 */
+	bool output_wanted;
+
 public:
 	FullyBufferedSocket(int _fd, EventLoop &_loop,
-			    size_t normal_size, size_t peak_size=0)
+			    size_t normal_size, size_t peak_size=0,
+			    MemoryAccount *account=nullptr)
 		:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
-		 output(normal_size, peak_size) {
+		 output(normal_size, peak_size, account),
+		 output_wanted(false) {
 	}
 
 	using BufferedSocket::IsDefined;
@@ -48,6 +57,31 @@ public:
 private:
 	ssize_t DirectWrite(const void *data, size_t length);
 
+	/**
+	 * Handle the return value of a send() call: errors are
+	 * reported to OnSocketError() or OnSocketClosed(), and
+	 * EAGAIN is translated to 0.
+	 */
+	ssize_t CheckWriteResult(ssize_t nbytes);
+
+	/**
+	 * Send as much of the output buffer as possible (both of its
+	 * segments at once) and remove it from the buffer.  The
+	 * buffer must not be empty.
+	 *
+	 * @return the number of bytes sent, 0 if the socket is not
+	 * writable, or -1 on error (which has been reported already)
+	 */
+	ssize_t SendOutput();
+
+	/**
+	 * Invoke OnOutputAvailable() if it has been requested and the
+	 * output buffer has drained enough.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool CheckOutputAvailable();
+
 protected:
 	/**
 	 * Send data from the output buffer to the socket.
@@ -61,6 +95,53 @@ protected:
 	 */
 	bool Write(const void *data, size_t length);
 
+	/**
+	 * Obtain free space at the end of the output buffer, to
+	 * generate data in place.  The returned buffer is empty if the
+	 * output buffer is full; in that case, the caller shall fall
+	 * back to Write().  Call CommitWrite() when done.
+	 */
+	WritableBuffer<void> PrepareWrite() {
+		return output.Write();
+	}
+
+	/**
+	 * Commit data which was written to the buffer returned by
+	 * PrepareWrite().
+	 */
+	void CommitWrite(size_t length);
+
+	/**
+	 * Is the output buffer filled up to its normal size?  Code
+	 * which generates a large response shall stop writing then,
+	 * call WaitOutputAvailable() and continue in
+	 * OnOutputAvailable(), instead of filling the peak buffer
+	 * until Write() fails.
+	 */
+	gcc_pure
+	bool IsOutputCongested() const {
+		return output.GetSize() >= output.GetNormalSize();
+	}
+
+	/**
+	 * Request a call to OnOutputAvailable() after the peer has
+	 * consumed enough of the output buffer.  This never blocks;
+	 * the event loop keeps running meanwhile.
+	 */
+	void WaitOutputAvailable() {
+		output_wanted = true;
+	}
+
+	/**
+	 * The output buffer has drained after WaitOutputAvailable()
+	 * was called.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	virtual bool OnOutputAvailable() {
+		return true;
+	}
+
 	virtual bool OnSocketReady(unsigned flags) override;
 	virtual void OnIdle() override;
 };
@@ -22,6 +22,8 @@
 
 #include "check.h"
 
+#include <boost/intrusive/list_hook.hpp>
+
 class EventLoop;
 
 /**
@@ -36,6 +38,13 @@ class EventLoop;
 class IdleMonitor {
 	friend class EventLoop;
 
+	typedef boost::intrusive::list_member_hook<> Hook;
+
+	/**
+	 * Links this object into EventLoop::idle while it is active.
+	 */
+	Hook idle_hook;
+
 	EventLoop &loop;
 
 	bool active;
@@ -23,13 +23,10 @@
 #include "system/Clock.hxx"
 #include "TimeoutMonitor.hxx"
 #include "SocketMonitor.hxx"
-#include "IdleMonitor.hxx"
-#include "DeferredMonitor.hxx"
-
-#include <algorithm>
 
 EventLoop::EventLoop()
 	:SocketMonitor(*this),
+	 timers(::MonotonicClockMS()),
 	 now_ms(::MonotonicClockMS()),
 	 quit(false), busy(true),
 #ifndef NDEBUG
@@ -44,7 +41,7 @@ EventLoop::EventLoop()
 EventLoop::~EventLoop()
 {
 	assert(idle.empty());
-	assert(timers.empty());
+	assert(timers.IsEmpty());
 
 	/* this is necessary to get a well-defined destruction
 	   order */
@@ -80,9 +77,9 @@ void
 EventLoop::AddIdle(IdleMonitor &i)
 {
 	assert(IsInsideOrVirgin());
-	assert(std::find(idle.begin(), idle.end(), &i) == idle.end());
+	assert(!i.idle_hook.is_linked());
 
-	idle.push_back(&i);
+	idle.push_back(i);
 	again = true;
 }
 
@@ -91,10 +88,9 @@ EventLoop::RemoveIdle(IdleMonitor &i)
 {
 	assert(IsInsideOrVirgin());
 
-	auto it = std::find(idle.begin(), idle.end(), &i);
-	assert(it != idle.end());
+	assert(i.idle_hook.is_linked());
 
-	idle.erase(it);
+	idle.erase(idle.iterator_to(i));
 }
 
 void
@@ -104,7 +100,8 @@ EventLoop::AddTimer(TimeoutMonitor &t, unsigned ms)
 	   modifies the timeout during avahi_client_free() */
 	assert(IsInsideOrNull());
 
-	timers.insert(TimerRecord(t, now_ms + ms));
+	t.due_ms = now_ms + ms;
+	timers.Add(t);
 	again = true;
 }
 
@@ -113,12 +110,7 @@ EventLoop::CancelTimer(TimeoutMonitor &t)
 {
 	assert(IsInsideOrNull());
 
-	for (auto i = timers.begin(), end = timers.end(); i != end; ++i) {
-		if (&i->timer == &t) {
-			timers.erase(i);
-			return;
-		}
-	}
+	timers.Remove(t);
 }
 
 void
@@ -142,33 +134,22 @@ EventLoop::Run()
 
 		/* invoke timers */
 
-		int timeout_ms;
-		while (true) {
-			auto i = timers.begin();
-			if (i == timers.end()) {
-				timeout_ms = -1;
-				break;
-			}
-
-			timeout_ms = i->due_ms - now_ms;
-			if (timeout_ms > 0)
-				break;
-
-			TimeoutMonitor &m = i->timer;
-			timers.erase(i);
-
-			m.Run();
+		TimeoutMonitor *m;
+		while ((m = timers.Pop(now_ms)) != nullptr) {
+			m->Run();
 
 			if (quit)
 				return;
 		}
 
+		const int timeout_ms = timers.GetTimeout(now_ms);
+
 		/* invoke idle */
 
 		while (!idle.empty()) {
-			IdleMonitor &m = *idle.front();
+			IdleMonitor &idle_monitor = idle.front();
 			idle.pop_front();
-			m.Run();
+			idle_monitor.Run();
 
 			if (quit)
 				return;
@@ -204,8 +185,8 @@ EventLoop::Run()
 				if (quit)
 					break;
 
-				auto m = (SocketMonitor *)poll_result.GetObject(i);
-				m->Dispatch(events);
+				auto s = (SocketMonitor *)poll_result.GetObject(i);
+				s->Dispatch(events);
 			}
 		}
 
@@ -224,20 +205,17 @@ void
 EventLoop::AddDeferred(DeferredMonitor &d)
 {
 	mutex.lock();
-	if (d.pending) {
+	if (d.deferred_hook.is_linked()) {
+		/* already pending */
 		mutex.unlock();
 		return;
 	}
 
-	assert(std::find(deferred.begin(),
-			 deferred.end(), &d) == deferred.end());
-
 	/* we don't need to wake up the EventLoop if another
 	   DeferredMonitor has already done it */
 	const bool must_wake = !busy && deferred.empty();
 
-	d.pending = true;
-	deferred.push_back(&d);
+	deferred.push_back(d);
 	again = true;
 	mutex.unlock();
 
@@ -250,29 +228,16 @@ EventLoop::RemoveDeferred(DeferredMonitor &d)
 {
 	const ScopeLock protect(mutex);
 
-	if (!d.pending) {
-		assert(std::find(deferred.begin(),
-				 deferred.end(), &d) == deferred.end());
-		return;
-	}
-
-	d.pending = false;
-
-	auto i = std::find(deferred.begin(), deferred.end(), &d);
-	assert(i != deferred.end());
-
-	deferred.erase(i);
+	if (d.deferred_hook.is_linked())
+		deferred.erase(deferred.iterator_to(d));
 }
 
 void
 EventLoop::HandleDeferred()
 {
 	while (!deferred.empty() && !quit) {
-		DeferredMonitor &m = *deferred.front();
-		assert(m.pending);
-
+		DeferredMonitor &m = deferred.front();
 		deferred.pop_front();
-		m.pending = false;
 
 		mutex.unlock();
 		m.RunDeferred();
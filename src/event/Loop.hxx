@@ -28,13 +28,13 @@
 #include "thread/Mutex.hxx"
 #include "WakeFD.hxx"
 #include "SocketMonitor.hxx"
+#include "TimerWheel.hxx"
+#include "IdleMonitor.hxx"
+#include "DeferredMonitor.hxx"
 
-#include <list>
-#include <set>
+#include <boost/intrusive/list.hpp>
 
 class TimeoutMonitor;
-class IdleMonitor;
-class DeferredMonitor;
 class SocketMonitor;
 
 #include <assert.h>
@@ -50,35 +50,25 @@ class SocketMonitor;
  */
 class EventLoop final : SocketMonitor
 {
-	struct TimerRecord {
-		/**
-		 * Projected monotonic_clock_ms() value when this
-		 * timer is due.
-		 */
-		const unsigned due_ms;
-
-		TimeoutMonitor &timer;
-
-		constexpr TimerRecord(TimeoutMonitor &_timer,
-				      unsigned _due_ms)
-			:due_ms(_due_ms), timer(_timer) {}
-
-		bool operator<(const TimerRecord &other) const {
-			return due_ms < other.due_ms;
-		}
+	WakeFD wake_fd;
 
-		bool IsDue(unsigned _now_ms) const {
-			return _now_ms >= due_ms;
-		}
-	};
+	typedef boost::intrusive::list<IdleMonitor,
+				       boost::intrusive::member_hook<IdleMonitor,
+								     IdleMonitor::Hook,
+								     &IdleMonitor::idle_hook>,
+				       boost::intrusive::constant_time_size<false>> IdleList;
 
-	WakeFD wake_fd;
+	typedef boost::intrusive::list<DeferredMonitor,
+				       boost::intrusive::member_hook<DeferredMonitor,
+								     DeferredMonitor::Hook,
+								     &DeferredMonitor::deferred_hook>,
+				       boost::intrusive::constant_time_size<false>> DeferredList;
 
-	std::multiset<TimerRecord> timers;
-	std::list<IdleMonitor *> idle;
+	TimerWheel timers;
+	IdleList idle;
 
 	Mutex mutex;
-	std::list<DeferredMonitor *> deferred;
+	DeferredList deferred;
 
 	unsigned now_ms;
 
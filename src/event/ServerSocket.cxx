@@ -54,6 +54,19 @@
 
 #define DEFAULT_PORT	6600
 
+/**
+ * The listen() backlog.  It is large enough to queue a burst of
+ * clients reconnecting at the same time (e.g. after a network
+ * outage) instead of dropping their SYN packets.
+ */
+static constexpr int SERVER_SOCKET_BACKLOG = 256;
+
+/**
+ * The maximum number of connections accepted in one
+ * OnSocketReady() call, to avoid starving other event sources.
+ */
+static constexpr unsigned SERVER_SOCKET_ACCEPT_BATCH = 16;
+
 class OneServerSocket final : private SocketMonitor {
 	ServerSocket &parent;
 
@@ -114,7 +127,13 @@ public:
 		SocketMonitor::ScheduleRead();
 	}
 
-	void Accept();
+	/**
+	 * Accept one pending connection.
+	 *
+	 * @return false if there was no pending connection or if
+	 * accept() has failed
+	 */
+	bool Accept();
 
 private:
 	virtual bool OnSocketReady(unsigned flags) override;
@@ -147,7 +166,7 @@ get_remote_uid(int fd)
 #endif
 }
 
-inline void
+inline bool
 OneServerSocket::Accept()
 {
 	struct sockaddr_storage peer_address;
@@ -156,10 +175,14 @@ OneServerSocket::Accept()
 		accept_cloexec_nonblock(Get(), (struct sockaddr*)&peer_address,
 					&peer_address_length);
 	if (peer_fd < 0) {
-		const SocketErrorMessage msg;
+		const socket_error_t code = GetSocketError();
+		if (IsSocketErrorAgain(code))
+			return false;
+
+		const SocketErrorMessage msg(code);
 		FormatError(server_socket_domain,
 			    "accept() failed: %s", (const char *)msg);
-		return;
+		return false;
 	}
 
 	if (socket_keepalive(peer_fd)) {
@@ -172,12 +195,18 @@ OneServerSocket::Accept()
 	parent.OnAccept(peer_fd,
 			(const sockaddr &)peer_address,
 			peer_address_length, get_remote_uid(peer_fd));
+	return true;
 }
 
 bool
 OneServerSocket::OnSocketReady(gcc_unused unsigned flags)
 {
-	Accept();
+	/* drain the accept queue in one go; this saves one poll
+	   round trip per connection during a reconnect storm */
+	for (unsigned i = 0; i < SERVER_SOCKET_ACCEPT_BATCH; ++i)
+		if (!Accept() || !IsDefined())
+			break;
+
 	return true;
 }
 
@@ -188,7 +217,8 @@ OneServerSocket::Open(Error &error)
 
 	int _fd = socket_bind_listen(address->sa_family,
 				     SOCK_STREAM, 0,
-				     address, address_length, 5,
+				     address, address_length,
+				     SERVER_SOCKET_BACKLOG,
 				     error);
 	if (_fd < 0)
 		return false;
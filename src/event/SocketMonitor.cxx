@@ -24,6 +24,7 @@
 #include "Compiler.h"
 
 #include <assert.h>
+#include <string.h>
 
 #ifdef WIN32
 #include <winsock2.h>
@@ -130,3 +131,28 @@ SocketMonitor::Write(const void *data, size_t length)
 
 	return send(Get(), (const char *)data, length, flags);
 }
+
+#ifndef WIN32
+
+SocketMonitor::ssize_t
+SocketMonitor::Write(const struct iovec *v, size_t n)
+{
+	assert(IsDefined());
+
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_DONTWAIT
+	flags |= MSG_DONTWAIT;
+#endif
+
+	struct msghdr m;
+	memset(&m, 0, sizeof(m));
+	m.msg_iov = const_cast<struct iovec *>(v);
+	m.msg_iovlen = n;
+
+	return sendmsg(Get(), &m, flags);
+}
+
+#endif
@@ -37,6 +37,7 @@
 #endif
 
 class EventLoop;
+struct iovec;
 
 /**
  * Monitor events on a socket.  Call Schedule() to announce events
@@ -136,6 +137,14 @@ public:
 	ssize_t Read(void *data, size_t length);
 	ssize_t Write(const void *data, size_t length);
 
+#ifndef WIN32
+	/**
+	 * Send the given buffers with one system call
+	 * (scatter/gather).
+	 */
+	ssize_t Write(const struct iovec *v, size_t n);
+#endif
+
 protected:
 	/**
 	 * @return false if the socket has been closed
@@ -22,6 +22,8 @@
 
 #include "check.h"
 
+#include <boost/intrusive/list_hook.hpp>
+
 class EventLoop;
 
 /**
@@ -34,9 +36,24 @@ class EventLoop;
  */
 class TimeoutMonitor {
 	friend class EventLoop;
+	friend class TimerWheel;
+
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>> Hook;
+
+	/**
+	 * Links this object into a #TimerWheel slot while it is
+	 * scheduled.
+	 */
+	Hook timer_hook;
 
 	EventLoop &loop;
 
+	/**
+	 * Projected monotonic_clock_ms() value when this timer is
+	 * due.  Only valid while #active.
+	 */
+	unsigned due_ms;
+
 	bool active;
 
 public:
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TimerWheel.hxx"
+
+#include <assert.h>
+
+static inline unsigned
+CountTrailingZeros(uint64_t x)
+{
+	assert(x != 0);
+
+	return __builtin_ctzll(x);
+}
+
+static constexpr uint64_t
+RotateRight(uint64_t x, unsigned n)
+{
+	return n == 0 ? x : (x >> n) | (x << (64 - n));
+}
+
+bool
+TimerWheel::IsEmpty() const
+{
+	for (const auto &level : levels)
+		for (const auto &slot : level.slots)
+			if (!slot.empty())
+				return false;
+
+	return overflow.empty();
+}
+
+void
+TimerWheel::Add(TimeoutMonitor &t)
+{
+	assert(!t.timer_hook.is_linked());
+
+	if (int(t.due_ms - current) < 0)
+		/* already due; this happens if the timer is scheduled
+		   after Pop() has processed the current tick */
+		t.due_ms = current;
+
+	Insert(t);
+}
+
+void
+TimerWheel::Insert(TimeoutMonitor &t)
+{
+	const unsigned delta = t.due_ms - current;
+
+	for (unsigned level = 0; level < N_LEVELS; ++level) {
+		if (delta < (1u << LevelShift(level + 1))) {
+			Level &l = levels[level];
+			const unsigned i =
+				(t.due_ms >> LevelShift(level)) & LEVEL_MASK;
+			l.slots[i].push_back(t);
+			l.occupied |= uint64_t(1) << i;
+			return;
+		}
+	}
+
+	overflow.push_back(t);
+}
+
+void
+TimerWheel::Reinsert(List &list)
+{
+	/* detach the list first, because Insert() may put a timer
+	   back into it (e.g. into the overflow list) */
+	List tmp;
+	tmp.swap(list);
+
+	while (!tmp.empty()) {
+		TimeoutMonitor &t = tmp.front();
+		tmp.pop_front();
+		Insert(t);
+	}
+}
+
+bool
+TimerWheel::GetNextCascade(unsigned &when_r) const
+{
+	bool found = false;
+	unsigned best = 0;
+
+	for (unsigned level = 1; level < N_LEVELS; ++level) {
+		const Level &l = levels[level];
+		if (l.occupied == 0)
+			continue;
+
+		/* the slot after the current one is cascaded first;
+		   the current slot is cascaded after a whole
+		   revolution of this level */
+		const unsigned shift = LevelShift(level);
+		const unsigned i = (current >> shift) & LEVEL_MASK;
+		const uint64_t rotated =
+			RotateRight(l.occupied, (i + 1) & LEVEL_MASK);
+		const unsigned distance = CountTrailingZeros(rotated) + 1;
+		const unsigned when = ((current >> shift) + distance) << shift;
+
+		if (!found || int(when - best) < 0) {
+			best = when;
+			found = true;
+		}
+	}
+
+	if (!overflow.empty()) {
+		const unsigned when = ((current >> LevelShift(N_LEVELS)) + 1)
+			<< LevelShift(N_LEVELS);
+		if (!found || int(when - best) < 0) {
+			best = when;
+			found = true;
+		}
+	}
+
+	when_r = best;
+	return found;
+}
+
+void
+TimerWheel::Cascade()
+{
+	assert((current & LEVEL_MASK) == 0);
+
+	for (unsigned level = 1; level < N_LEVELS; ++level) {
+		Level &l = levels[level];
+		const unsigned i = (current >> LevelShift(level)) & LEVEL_MASK;
+
+		if (l.occupied & (uint64_t(1) << i)) {
+			l.occupied &= ~(uint64_t(1) << i);
+			Reinsert(l.slots[i]);
+		}
+
+		if (i != 0)
+			return;
+	}
+
+	/* the top level has wrapped around */
+	Reinsert(overflow);
+}
+
+TimeoutMonitor *
+TimerWheel::Pop(unsigned now_ms)
+{
+	Level &l0 = levels[0];
+
+	while (int(now_ms - current) >= 0) {
+		const unsigned i = current & LEVEL_MASK;
+		const uint64_t pending = l0.occupied >> i;
+
+		if (pending != 0) {
+			/* the next occupied slot in this revolution */
+			const unsigned next = i + CountTrailingZeros(pending);
+			const unsigned due = current + (next - i);
+			if (int(now_ms - due) < 0) {
+				current = now_ms + 1;
+				return nullptr;
+			}
+
+			current = due;
+
+			List &slot = l0.slots[next];
+			if (!slot.empty()) {
+				TimeoutMonitor &t = slot.front();
+				slot.pop_front();
+				if (slot.empty())
+					l0.occupied &= ~(uint64_t(1) << next);
+				return &t;
+			}
+
+			l0.occupied &= ~(uint64_t(1) << next);
+			continue;
+		}
+
+		/* no more timers in this revolution: skip to the next
+		   level 0 boundary, or directly to the next one which
+		   has something to cascade if level 0 is empty */
+		unsigned boundary = (current | LEVEL_MASK) + 1;
+		if (l0.occupied == 0 && !GetNextCascade(boundary)) {
+			current = now_ms + 1;
+			return nullptr;
+		}
+
+		if (int(now_ms - boundary) < 0) {
+			current = now_ms + 1;
+			if (current == boundary)
+				Cascade();
+			return nullptr;
+		}
+
+		current = boundary;
+		Cascade();
+	}
+
+	return nullptr;
+}
+
+int
+TimerWheel::GetTimeout(unsigned now_ms) const
+{
+	bool found = false;
+	unsigned best = 0;
+
+	auto consider = [&](unsigned when){
+		const unsigned distance = when - now_ms;
+		if (int(distance) <= 0)
+			when = now_ms;
+
+		if (!found || int(when - now_ms) < int(best - now_ms)) {
+			best = when;
+			found = true;
+		}
+	};
+
+	const Level &l0 = levels[0];
+	if (l0.occupied != 0) {
+		const unsigned i = current & LEVEL_MASK;
+		const uint64_t pending = l0.occupied >> i;
+		if (pending != 0)
+			consider(current + CountTrailingZeros(pending));
+		else
+			/* only timers from the next revolution */
+			consider((current | LEVEL_MASK) + 1);
+	}
+
+	unsigned cascade = 0;
+	if (GetNextCascade(cascade))
+		consider(cascade);
+
+	if (!found)
+		return -1;
+
+	return best - now_ms;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TIMER_WHEEL_HXX
+#define MPD_TIMER_WHEEL_HXX
+
+#include "check.h"
+#include "TimeoutMonitor.hxx"
+#include "Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <stdint.h>
+
+/**
+ * A hierarchical timing wheel with a resolution of one millisecond.
+ * Each level has 64 slots; a timer is stored in the lowest level
+ * whose range covers its due time, and is moved to lower levels
+ * ("cascaded") as the wheel turns.  Timers which are due in more
+ * than 2^24 ms (4.6 hours) go to an overflow list.
+ *
+ * The #TimeoutMonitor objects are linked into the slots with an
+ * intrusive hook, so scheduling and cancelling a timer does not
+ * allocate memory, and both are O(1).
+ */
+class TimerWheel {
+	static constexpr unsigned LEVEL_BITS = 6;
+	static constexpr unsigned LEVEL_SIZE = 1u << LEVEL_BITS;
+	static constexpr unsigned LEVEL_MASK = LEVEL_SIZE - 1;
+	static constexpr unsigned N_LEVELS = 4;
+
+	typedef boost::intrusive::list<TimeoutMonitor,
+				       boost::intrusive::member_hook<TimeoutMonitor,
+								     TimeoutMonitor::Hook,
+								     &TimeoutMonitor::timer_hook>,
+				       boost::intrusive::constant_time_size<false>> List;
+
+	struct Level {
+		/**
+		 * A bit mask of slots which may contain timers.  A
+		 * bit may remain set after its slot has been emptied
+		 * by cancelling a timer; it is cleared lazily.
+		 */
+		uint64_t occupied;
+
+		List slots[LEVEL_SIZE];
+
+		Level():occupied(0) {}
+	};
+
+	Level levels[N_LEVELS];
+
+	List overflow;
+
+	/**
+	 * The next millisecond tick which has not been processed
+	 * yet.
+	 */
+	unsigned current;
+
+public:
+	explicit TimerWheel(unsigned now_ms)
+		:current(now_ms) {}
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	gcc_pure
+	bool IsEmpty() const;
+
+	/**
+	 * Insert a timer which is due at TimeoutMonitor::due_ms.
+	 */
+	void Add(TimeoutMonitor &t);
+
+	static void Remove(TimeoutMonitor &t) {
+		t.timer_hook.unlink();
+	}
+
+	/**
+	 * Remove and return one timer which is due at the given time,
+	 * or nullptr if there is none.
+	 */
+	TimeoutMonitor *Pop(unsigned now_ms);
+
+	/**
+	 * Returns the number of milliseconds until Pop() needs to be
+	 * called again, or -1 if there are no timers.
+	 */
+	gcc_pure
+	int GetTimeout(unsigned now_ms) const;
+
+private:
+	static constexpr unsigned LevelShift(unsigned level) {
+		return level * LEVEL_BITS;
+	}
+
+	void Insert(TimeoutMonitor &t);
+
+	/**
+	 * Move the timers of the slots which #current has reached to
+	 * lower levels.  Called when #current crosses a level 0
+	 * boundary.
+	 */
+	void Cascade();
+
+	void Reinsert(List &list);
+
+	/**
+	 * Determine the next time Cascade() will move timers from a
+	 * higher level.
+	 *
+	 * @return false if there are no timers above level 0
+	 */
+	gcc_pure
+	bool GetNextCascade(unsigned &when_r) const;
+};
+
+#endif
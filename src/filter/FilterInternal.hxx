@@ -25,6 +25,8 @@
 #ifndef MPD_FILTER_INTERNAL_HXX
 #define MPD_FILTER_INTERNAL_HXX
 
+#include "Compiler.h"
+
 #include <stddef.h>
 
 struct AudioFormat;
@@ -69,6 +71,30 @@ public:
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r,
 				      Error &error) = 0;
+
+	/**
+	 * Would FilterPCM() currently return its input unmodified?
+	 * The caller may then skip calling it.  The answer may
+	 * change when the filter's settings are changed (e.g. the
+	 * volume).  This is a conservative hint; the default
+	 * implementation returns false.
+	 */
+	virtual bool IsPassThrough() const {
+		return false;
+	}
+
+	/**
+	 * Does this filter do nothing but multiply all samples with a
+	 * constant factor, without changing the audio format?  If
+	 * yes, the factor (in #PCM_VOLUME_1 units) and whether the
+	 * filter dithers are returned, and ChainFilter may fuse this
+	 * filter with adjacent gain stages into one pass.  The
+	 * default implementation returns false.
+	 */
+	virtual bool GetGain(gcc_unused unsigned &gain_r,
+			     gcc_unused bool &dither_r) const {
+		return false;
+	}
 };
 
 #endif
@@ -51,6 +51,11 @@ public:
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r,
 				      Error &error) override;
+
+	virtual bool IsPassThrough() const override {
+		return (convert == nullptr || convert->IsPassThrough()) &&
+			filter->IsPassThrough();
+	}
 };
 
 AudioFormat
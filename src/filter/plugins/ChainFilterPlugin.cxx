@@ -23,10 +23,15 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "AudioFormat.hxx"
+#include "pcm/Volume.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
 #include <list>
+#include <iterator>
+
+#include <stdint.h>
 
 #include <assert.h>
 
@@ -35,14 +40,37 @@ class ChainFilter final : public Filter {
 		const char *name;
 		Filter *filter;
 
+		/**
+		 * Is this filter a pure gain stage (see
+		 * Filter::GetGain())?  Only valid while the chain is
+		 * open.
+		 */
+		bool gain_stage;
+
+		/**
+		 * Applies the combined gain of a run of adjacent gain
+		 * stages starting at this child.  Opened only if
+		 * #gain_stage is set.
+		 */
+		PcmVolume fused;
+
 		Child(const char *_name, Filter *_filter)
-			:name(_name), filter(_filter) {}
+			:name(_name), filter(_filter), gain_stage(false) {}
 		~Child() {
 			delete filter;
 		}
 
 		Child(const Child &) = delete;
 		Child &operator=(const Child &) = delete;
+
+		void Close() {
+			if (gain_stage) {
+				fused.Close();
+				gain_stage = false;
+			}
+
+			filter->Close();
+		}
 	};
 
 	std::list<Child> children;
@@ -57,6 +85,9 @@ public:
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r, Error &error);
 
+	gcc_pure
+	virtual bool IsPassThrough() const override;
+
 private:
 	/**
 	 * Close all filters in the chain until #until is reached.
@@ -83,7 +114,7 @@ ChainFilter::CloseUntil(const Filter *until)
 			return;
 
 		/* close this filter */
-		child.filter->Close();
+		child.Close();
 	}
 
 	/* this assertion fails if #until does not exist (anymore) */
@@ -123,6 +154,8 @@ ChainFilter::Open(AudioFormat &in_audio_format, Error &error)
 	AudioFormat audio_format = in_audio_format;
 
 	for (auto &child : children) {
+		const SampleFormat sample_format = audio_format.format;
+
 		audio_format = chain_open_child(child.name, child.filter,
 						audio_format, error);
 		if (!audio_format.IsDefined()) {
@@ -130,6 +163,12 @@ ChainFilter::Open(AudioFormat &in_audio_format, Error &error)
 			CloseUntil(child.filter);
 			break;
 		}
+
+		unsigned gain;
+		bool dither;
+		Error fused_error;
+		child.gain_stage = child.filter->GetGain(gain, dither) &&
+			child.fused.Open(sample_format, fused_error);
 	}
 
 	/* return the output format of the last filter */
@@ -140,20 +179,69 @@ void
 ChainFilter::Close()
 {
 	for (auto &child : children)
-		child.filter->Close();
+		child.Close();
+}
+
+/**
+ * Multiply two gain factors in #PCM_VOLUME_1 units.
+ */
+static constexpr uint64_t
+chain_multiply_gain(uint64_t a, unsigned b)
+{
+	return (a * b + PCM_VOLUME_1 / 2) >> PCM_VOLUME_BITS;
 }
 
 const void *
 ChainFilter::FilterPCM(const void *src, size_t src_size,
 		       size_t *dest_size_r, Error &error)
 {
-	for (auto &child : children) {
+	const auto end = children.end();
+	for (auto i = children.begin(); i != end;) {
+		auto next = std::next(i);
+
+		unsigned gain;
+		bool dither;
+		if (i->gain_stage && next != end && next->gain_stage &&
+		    i->filter->GetGain(gain, dither)) {
+			/* fuse this run of adjacent gain stages: the
+			   factors are multiplied in 64 bit fixed
+			   point, and the samples are scaled (and
+			   dithered) only once, instead of rounding
+			   after each stage */
+			uint64_t product = gain;
+
+			for (; next != end && next->gain_stage; ++next) {
+				bool next_dither;
+				if (!next->filter->GetGain(gain, next_dither))
+					break;
+
+				product = chain_multiply_gain(product, gain);
+				dither = dither || next_dither;
+			}
+
+			if (product > 0xffff)
+				/* way beyond clipping; avoid integer
+				   overflows in PcmVolume */
+				product = 0xffff;
+
+			i->fused.SetVolume(product);
+			i->fused.SetDither(dither);
+
+			const auto dest = i->fused.Apply({src, src_size});
+			src = dest.data;
+			src_size = dest.size;
+
+			i = next;
+			continue;
+		}
+
 		/* feed the output of the previous filter as input
 		   into the current one */
-		src = child.filter->FilterPCM(src, src_size, &src_size,
-					      error);
+		src = i->filter->FilterPCM(src, src_size, &src_size, error);
 		if (src == nullptr)
 			return nullptr;
+
+		i = next;
 	}
 
 	/* return the output of the last filter */
@@ -161,6 +249,16 @@ ChainFilter::FilterPCM(const void *src, size_t src_size,
 	return src;
 }
 
+bool
+ChainFilter::IsPassThrough() const
+{
+	for (const auto &child : children)
+		if (!child.filter->IsPassThrough())
+			return false;
+
+	return true;
+}
+
 const struct filter_plugin chain_filter_plugin = {
 	"chain",
 	chain_filter_init,
@@ -23,13 +23,23 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "pcm/PcmConvert.hxx"
-#include "util/Manual.hxx"
+#include "pcm/ConfiguredResampler.hxx"
+#include "config/ConfigData.hxx"
 #include "AudioFormat.hxx"
 #include "poison.h"
 
+#include <string>
+#include <list>
+
 #include <assert.h>
 
 class ConvertFilter final : public Filter {
+	/**
+	 * The name of the resampler profile passed to #PcmConvert;
+	 * empty for the default profile.
+	 */
+	const std::string resampler_profile;
+
 	/**
 	 * The input audio format; PCM data is passed to the filter()
 	 * method in this format.
@@ -46,9 +56,42 @@ class ConvertFilter final : public Filter {
 	 */
 	AudioFormat out_audio_format;
 
-	Manual<PcmConvert> state;
+	/**
+	 * The converter from #in_audio_format to #out_audio_format;
+	 * only valid if #out_audio_format is valid.
+	 */
+	PcmConvert *state;
+
+	/**
+	 * An open #PcmConvert which is not currently used.
+	 */
+	struct IdleConvert {
+		AudioFormat in_audio_format, out_audio_format;
+		PcmConvert *convert;
+	};
+
+	/**
+	 * The maximum size of #idle.
+	 */
+	static constexpr unsigned MAX_IDLE = 2;
+
+	/**
+	 * Converters which were used recently, the most recent one
+	 * first.  They are kept open after Close() or after the
+	 * format has changed, because setting up a resampler can be
+	 * expensive; if the next song has the same formats, the
+	 * converter is only reset.  All of them use
+	 * #resampler_profile, therefore the formats are the only key.
+	 */
+	std::list<IdleConvert> idle;
 
 public:
+	explicit ConvertFilter(const char *_resampler_profile)
+		:resampler_profile(_resampler_profile != nullptr
+				   ? _resampler_profile : "") {}
+
+	~ConvertFilter();
+
 	bool Set(const AudioFormat &_out_audio_format, Error &error);
 
 	virtual AudioFormat Open(AudioFormat &af, Error &error) override;
@@ -56,13 +99,83 @@ public:
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r,
 				      Error &error) override;
+
+	virtual bool IsPassThrough() const override {
+		/* see FilterPCM() */
+		return !out_audio_format.IsValid();
+	}
+
+private:
+	/**
+	 * Obtain a converter from #in_audio_format to the given
+	 * format: reuse an idle one, or open a new one.
+	 *
+	 * @return the converter or nullptr on error
+	 */
+	PcmConvert *Acquire(AudioFormat _out_audio_format, Error &error);
+
+	/**
+	 * Move #state to the #idle list.
+	 */
+	void Release();
 };
 
+ConvertFilter::~ConvertFilter()
+{
+	for (auto &i : idle) {
+		i.convert->Close();
+		delete i.convert;
+	}
+}
+
+PcmConvert *
+ConvertFilter::Acquire(AudioFormat _out_audio_format, Error &error)
+{
+	for (auto i = idle.begin(); i != idle.end(); ++i) {
+		if (i->in_audio_format == in_audio_format &&
+		    i->out_audio_format == _out_audio_format) {
+			PcmConvert *convert = i->convert;
+			idle.erase(i);
+			convert->Reset();
+			return convert;
+		}
+	}
+
+	PcmConvert *convert =
+		new PcmConvert(resampler_profile.empty()
+			       ? nullptr : resampler_profile.c_str());
+	if (!convert->Open(in_audio_format, _out_audio_format, error)) {
+		delete convert;
+		return nullptr;
+	}
+
+	return convert;
+}
+
+void
+ConvertFilter::Release()
+{
+	assert(out_audio_format.IsValid());
+
+	idle.push_front({in_audio_format, out_audio_format, state});
+
+	if (idle.size() > MAX_IDLE) {
+		PcmConvert *convert = idle.back().convert;
+		idle.pop_back();
+		convert->Close();
+		delete convert;
+	}
+}
+
 static Filter *
-convert_filter_init(gcc_unused const config_param &param,
-		    gcc_unused Error &error)
+convert_filter_init(const config_param &param, Error &error)
 {
-	return new ConvertFilter();
+	const char *resampler = param.GetBlockValue("resampler");
+	if (resampler != nullptr &&
+	    !pcm_resampler_check_profile(resampler, error))
+		return nullptr;
+
+	return new ConvertFilter(resampler);
 }
 
 bool
@@ -76,15 +189,16 @@ ConvertFilter::Set(const AudioFormat &_out_audio_format, Error &error)
 		return true;
 
 	if (out_audio_format.IsValid()) {
+		Release();
 		out_audio_format.Clear();
-		state->Close();
 	}
 
 	if (_out_audio_format == in_audio_format)
 		/* optimized special case: no-op */
 		return true;
 
-	if (!state->Open(in_audio_format, _out_audio_format, error))
+	state = Acquire(_out_audio_format, error);
+	if (state == nullptr)
 		return false;
 
 	out_audio_format = _out_audio_format;
@@ -99,8 +213,6 @@ ConvertFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 	in_audio_format = audio_format;
 	out_audio_format.Clear();
 
-	state.Construct();
-
 	return in_audio_format;
 }
 
@@ -110,9 +222,7 @@ ConvertFilter::Close()
 	assert(in_audio_format.IsValid());
 
 	if (out_audio_format.IsValid())
-		state->Close();
-
-	state.Destruct();
+		Release();
 
 	poison_undefined(&in_audio_format, sizeof(in_audio_format));
 	poison_undefined(&out_audio_format, sizeof(out_audio_format));
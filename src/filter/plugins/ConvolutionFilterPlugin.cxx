@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/** \file
+ *
+ * This filter convolves each channel with a long FIR filter (e.g. for
+ * room correction or equalization), using a uniformly partitioned
+ * FFT convolution (see PcmConvolver).  The impulse response is read
+ * from a file with raw native-endian 32 bit floating point samples.
+ * The channels are processed in parallel by worker threads.
+ */
+
+#include "config.h"
+#include "filter/FilterPlugin.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/FilterRegistry.hxx"
+#include "config/ConfigError.hxx"
+#include "config/ConfigData.hxx"
+#include "pcm/Convolver.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "AudioFormat.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <vector>
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr Domain convolution_filter_domain("convolution_filter");
+
+/**
+ * The maximum number of samples in an impulse response file.
+ */
+static constexpr size_t MAX_IMPULSE_SIZE = 1 << 22;
+
+class ConvolutionFilter final : public Filter {
+	/**
+	 * The impulse response, with #impulse_channels interleaved
+	 * channels.  A single channel is applied to all audio
+	 * channels.
+	 */
+	std::vector<float> impulse;
+	unsigned impulse_channels;
+
+	/**
+	 * The partition size in frames; this is also the latency of
+	 * this filter.
+	 */
+	size_t partition_size;
+
+	/**
+	 * The configured maximum number of threads, including the
+	 * one calling FilterPCM().
+	 */
+	unsigned max_threads;
+
+	unsigned channels;
+
+	PcmFft *fft;
+
+	PcmConvolver *convolvers[MAX_CHANNELS];
+
+	/**
+	 * Input samples which do not fill a whole partition yet.
+	 */
+	std::vector<float> pending;
+
+	PcmBuffer buffer;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a job has been submitted, or when the
+	 * workers shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Signalled when the last channel of a job is finished.
+	 */
+	Cond done_cond;
+
+	Thread threads[MAX_CHANNELS];
+	unsigned n_threads;
+
+	/**
+	 * The current job: #job_blocks blocks of interleaved samples.
+	 * Protected by #mutex.
+	 */
+	const float *job_src;
+	float *job_dest;
+	size_t job_blocks;
+
+	/**
+	 * The next channel of the current job which no thread has
+	 * picked up yet.
+	 */
+	unsigned next_channel;
+
+	/**
+	 * The number of channels of the current job which are not
+	 * finished yet.
+	 */
+	unsigned remaining_channels;
+
+	bool quit;
+
+public:
+	bool Configure(const config_param &param, Error &error);
+
+	virtual AudioFormat Open(AudioFormat &af, Error &error) override;
+	virtual void Close();
+	virtual const void *FilterPCM(const void *src, size_t src_size,
+				      size_t *dest_size_r, Error &error);
+
+private:
+	void StartThreads();
+	void StopThreads();
+
+	/**
+	 * Convolve all blocks of the current job in one channel.
+	 */
+	void RunChannel(unsigned channel);
+
+	/**
+	 * Let the caller and the worker threads process all channels
+	 * of the job.
+	 */
+	void RunJob(float *dest, const float *src, size_t n_blocks);
+
+	void WorkerRun();
+	static void WorkerFunc(void *ctx);
+};
+
+static bool
+LoadImpulse(Path path, std::vector<float> &impulse, Error &error)
+{
+	const int fd = OpenFile(path, O_RDONLY, 0);
+	if (fd < 0) {
+		error.FormatErrno("Failed to open %s", path.c_str());
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		error.FormatErrno("Failed to stat %s", path.c_str());
+		close(fd);
+		return false;
+	}
+
+	const size_t n = st.st_size / sizeof(float);
+	if (n == 0 || n > MAX_IMPULSE_SIZE) {
+		error.Format(convolution_filter_domain,
+			     "Impulse response %s has an unsupported size",
+			     path.c_str());
+		close(fd);
+		return false;
+	}
+
+	impulse.resize(n);
+
+	char *p = (char *)&impulse.front();
+	size_t remaining = n * sizeof(float);
+	while (remaining > 0) {
+		const ssize_t nbytes = read(fd, p, remaining);
+		if (nbytes <= 0) {
+			if (nbytes < 0)
+				error.FormatErrno("Failed to read %s",
+						  path.c_str());
+			else
+				error.Format(convolution_filter_domain,
+					     "Unexpected end of file: %s",
+					     path.c_str());
+			close(fd);
+			return false;
+		}
+
+		p += nbytes;
+		remaining -= nbytes;
+	}
+
+	close(fd);
+	return true;
+}
+
+bool
+ConvolutionFilter::Configure(const config_param &param, Error &error)
+{
+	const AllocatedPath path = param.GetBlockPath("impulse", error);
+	if (path.IsNull()) {
+		if (!error.IsDefined())
+			error.Set(config_domain,
+				  "No \"impulse\" file specified");
+		return false;
+	}
+
+	impulse_channels = param.GetBlockValue("impulse_channels", 1u);
+	if (impulse_channels < 1 || impulse_channels > MAX_CHANNELS) {
+		error.Format(config_domain,
+			     "Invalid \"impulse_channels\": %u",
+			     impulse_channels);
+		return false;
+	}
+
+	partition_size = param.GetBlockValue("partition_size", 1024u);
+	if (partition_size < 64 || partition_size > 65536 ||
+	    (partition_size & (partition_size - 1)) != 0) {
+		error.Set(config_domain,
+			  "\"partition_size\" must be a power of two between 64 and 65536");
+		return false;
+	}
+
+	max_threads = param.GetBlockValue("threads", unsigned(MAX_CHANNELS));
+	if (max_threads < 1)
+		max_threads = 1;
+
+	if (!LoadImpulse(path, impulse, error))
+		return false;
+
+	if (impulse.size() % impulse_channels != 0) {
+		error.Format(config_domain,
+			     "Impulse response size does not match \"impulse_channels\"");
+		return false;
+	}
+
+	return true;
+}
+
+static Filter *
+convolution_filter_init(const config_param &param, Error &error)
+{
+	ConvolutionFilter *filter = new ConvolutionFilter();
+	if (!filter->Configure(param, error)) {
+		delete filter;
+		return nullptr;
+	}
+
+	return filter;
+}
+
+AudioFormat
+ConvolutionFilter::Open(AudioFormat &audio_format, Error &error)
+{
+	if (impulse_channels != 1 &&
+	    impulse_channels != audio_format.channels) {
+		error.Format(convolution_filter_domain,
+			     "Impulse response has %u channels, but the audio has %u",
+			     impulse_channels, audio_format.channels);
+		return AudioFormat::Undefined();
+	}
+
+	audio_format.format = SampleFormat::FLOAT;
+	channels = audio_format.channels;
+
+	fft = new PcmFft(partition_size * 2);
+
+	const size_t length = impulse.size() / impulse_channels;
+	for (unsigned c = 0; c < channels; ++c) {
+		const unsigned ic = impulse_channels == 1 ? 0 : c;
+		convolvers[c] = new PcmConvolver(*fft, &impulse[ic],
+						 length, impulse_channels);
+	}
+
+	pending.clear();
+
+	StartThreads();
+
+	return audio_format;
+}
+
+void
+ConvolutionFilter::Close()
+{
+	StopThreads();
+
+	for (unsigned c = 0; c < channels; ++c)
+		delete convolvers[c];
+
+	delete fft;
+
+	pending.clear();
+	pending.shrink_to_fit();
+	buffer.Clear();
+}
+
+void
+ConvolutionFilter::StartThreads()
+{
+	quit = false;
+	next_channel = channels;
+	remaining_channels = 0;
+
+	/* the thread calling FilterPCM() processes channels, too */
+	const unsigned wanted = std::min(max_threads, channels) - 1;
+
+	for (n_threads = 0; n_threads < wanted; ++n_threads) {
+		Error error;
+		if (!threads[n_threads].Start(WorkerFunc, this, error)) {
+			/* continue with the threads we have */
+			LogError(error);
+			break;
+		}
+	}
+}
+
+void
+ConvolutionFilter::StopThreads()
+{
+	mutex.lock();
+	quit = true;
+	work_cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Join();
+
+	n_threads = 0;
+}
+
+inline void
+ConvolutionFilter::RunChannel(unsigned channel)
+{
+	const size_t block_size = partition_size * channels;
+
+	PcmConvolver &convolver = *convolvers[channel];
+	for (size_t i = 0; i < job_blocks; ++i)
+		convolver.Process(job_dest + i * block_size + channel,
+				  job_src + i * block_size + channel,
+				  channels);
+}
+
+void
+ConvolutionFilter::RunJob(float *dest, const float *src, size_t n_blocks)
+{
+	const ScopeLock protect(mutex);
+
+	job_dest = dest;
+	job_src = src;
+	job_blocks = n_blocks;
+	next_channel = 0;
+	remaining_channels = channels;
+	work_cond.broadcast();
+
+	while (next_channel < channels) {
+		const unsigned channel = next_channel++;
+
+		mutex.unlock();
+		RunChannel(channel);
+		mutex.lock();
+
+		--remaining_channels;
+	}
+
+	while (remaining_channels > 0)
+		done_cond.wait(mutex);
+}
+
+void
+ConvolutionFilter::WorkerRun()
+{
+	SetThreadName("convolution");
+
+	mutex.lock();
+
+	while (!quit) {
+		if (next_channel >= channels) {
+			/* no channel left in the current job */
+			work_cond.wait(mutex);
+			continue;
+		}
+
+		const unsigned channel = next_channel++;
+
+		mutex.unlock();
+		RunChannel(channel);
+		mutex.lock();
+
+		if (--remaining_channels == 0)
+			done_cond.signal();
+	}
+
+	mutex.unlock();
+}
+
+void
+ConvolutionFilter::WorkerFunc(void *ctx)
+{
+	((ConvolutionFilter *)ctx)->WorkerRun();
+}
+
+const void *
+ConvolutionFilter::FilterPCM(const void *src, size_t src_size,
+			     size_t *dest_size_r, gcc_unused Error &error)
+{
+	const size_t block_size = partition_size * channels;
+
+	const float *input = (const float *)src;
+	const size_t n_input = src_size / sizeof(float);
+
+	if (!pending.empty() || n_input % block_size != 0) {
+		/* collect partial blocks */
+		pending.insert(pending.end(), input, input + n_input);
+		input = &pending.front();
+	}
+
+	const size_t n_available = input == (const float *)src
+		? n_input
+		: pending.size();
+	const size_t n_blocks = n_available / block_size;
+	const size_t n = n_blocks * block_size;
+
+	float *dest = buffer.GetT<float>(n);
+	if (n_blocks > 0)
+		RunJob(dest, input, n_blocks);
+
+	if (input != (const float *)src)
+		pending.erase(pending.begin(), pending.begin() + n);
+
+	*dest_size_r = n * sizeof(float);
+	return dest;
+}
+
+const struct filter_plugin convolution_filter_plugin = {
+	"convolution",
+	convolution_filter_init,
+};
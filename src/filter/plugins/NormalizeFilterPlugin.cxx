@@ -21,16 +21,12 @@
 #include "filter/FilterPlugin.hxx"
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
-#include "pcm/PcmBuffer.hxx"
+#include "pcm/Normalizer.hxx"
 #include "AudioFormat.hxx"
-#include "AudioCompress/compress.h"
-
-#include <string.h>
+#include "util/ConstBuffer.hxx"
 
 class NormalizeFilter final : public Filter {
-	struct Compressor *compressor;
-
-	PcmBuffer buffer;
+	PcmNormalizer normalizer;
 
 public:
 	virtual AudioFormat Open(AudioFormat &af, Error &error) override;
@@ -49,9 +45,9 @@ normalize_filter_init(gcc_unused const config_param &param,
 AudioFormat
 NormalizeFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 {
-	audio_format.format = SampleFormat::S16;
+	audio_format.format = SampleFormat::FLOAT;
 
-	compressor = Compressor_new(0);
+	normalizer.Open(audio_format.channels);
 
 	return audio_format;
 }
@@ -59,21 +55,18 @@ NormalizeFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 void
 NormalizeFilter::Close()
 {
-	buffer.Clear();
-	Compressor_delete(compressor);
+	normalizer.Close();
 }
 
 const void *
 NormalizeFilter::FilterPCM(const void *src, size_t src_size,
 			   size_t *dest_size_r, gcc_unused Error &error)
 {
-	int16_t *dest = (int16_t *)buffer.Get(src_size);
-	memcpy(dest, src, src_size);
-
-	Compressor_Process_int16(compressor, dest, src_size / 2);
-
-	*dest_size_r = src_size;
-	return dest;
+	const auto dest =
+		normalizer.Process({(const float *)src,
+				    src_size / sizeof(float)});
+	*dest_size_r = dest.size * sizeof(float);
+	return dest.data;
 }
 
 const struct filter_plugin normalize_filter_plugin = {
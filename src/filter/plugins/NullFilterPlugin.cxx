@@ -46,6 +46,10 @@ public:
 		*dest_size_r = src_size;
 		return src;
 	}
+
+	virtual bool IsPassThrough() const override {
+		return true;
+	}
 };
 
 static Filter *
@@ -116,6 +116,16 @@ public:
 	virtual void Close();
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r, Error &error);
+
+	virtual bool IsPassThrough() const override {
+		return pv.IsPassThrough();
+	}
+
+	virtual bool GetGain(unsigned &gain_r, bool &dither_r) const override {
+		gain_r = pv.GetVolume();
+		dither_r = pv.GetDither();
+		return true;
+	}
 };
 
 void
@@ -47,6 +47,7 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmChannelsSimd.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
 
@@ -102,6 +103,30 @@ class RouteFilter final : public Filter {
 	 */
 	size_t output_frame_size;
 
+	/**
+	 * Special cases of the routing table which have a faster
+	 * implementation, determined by Open().
+	 */
+	enum class Layout {
+		GENERIC,
+
+		/**
+		 * Each output channel is the input channel with the
+		 * same number; the input is returned as-is.
+		 */
+		IDENTITY,
+
+		/**
+		 * Stereo with left and right swapped.
+		 */
+		SWAP,
+
+		/**
+		 * Mono to stereo.
+		 */
+		MONO_TO_STEREO,
+	} layout;
+
 	/**
 	 * The output buffer used last time around, can be reused if the size doesn't differ.
 	 */
@@ -123,6 +148,22 @@ public:
 	virtual void Close();
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r, Error &error);
+
+	virtual bool IsPassThrough() const override {
+		return layout == Layout::IDENTITY;
+	}
+
+private:
+	gcc_pure
+	Layout FindLayout() const;
+
+	/**
+	 * Route the frames with the vectorised kernels, if the
+	 * layout and the sample size allow it.
+	 *
+	 * @return the number of frames which have been routed
+	 */
+	size_t RouteSimd(void *dest, const void *src, size_t n) const;
 };
 
 bool
@@ -229,64 +270,148 @@ RouteFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 	// Precalculate this simple value, to speed up allocation later
 	output_frame_size = output_format.GetFrameSize();
 
+	layout = FindLayout();
+
 	return output_format;
 }
 
+RouteFilter::Layout
+RouteFilter::FindLayout() const
+{
+	const unsigned input_channels = input_format.channels;
+
+	if (input_channels == 2 && min_output_channels == 2 &&
+	    sources[0] == 1 && sources[1] == 0)
+		return Layout::SWAP;
+
+	if (input_channels == 1 && min_output_channels == 2 &&
+	    sources[0] == 0 && sources[1] == 0)
+		return Layout::MONO_TO_STEREO;
+
+	if (input_channels != min_output_channels)
+		return Layout::GENERIC;
+
+	for (unsigned c = 0; c < min_output_channels; ++c)
+		if (sources[c] != int(c))
+			return Layout::GENERIC;
+
+	return Layout::IDENTITY;
+}
+
 void
 RouteFilter::Close()
 {
 	output_buffer.Clear();
 }
 
+/**
+ * Copy the samples of each frame according to the routing table;
+ * output channels without a (valid) source are filled with zeroes.
+ */
+template<typename T>
+static void
+RouteFrames(T *dest, const T *src, size_t n,
+	    unsigned input_channels,
+	    const int8_t *sources, unsigned output_channels)
+{
+	for (size_t i = 0; i < n; ++i, src += input_channels) {
+		for (unsigned c = 0; c < output_channels; ++c) {
+			const int source = sources[c];
+			*dest++ = source >= 0 && unsigned(source) < input_channels
+				? src[source]
+				: T(0);
+		}
+	}
+}
+
+size_t
+RouteFilter::RouteSimd(void *dest, const void *src, size_t n) const
+{
+	switch (layout) {
+	case Layout::GENERIC:
+	case Layout::IDENTITY:
+		break;
+
+	case Layout::SWAP:
+		switch (input_format.GetSampleSize()) {
+		case 2:
+			return pcm_channels_simd_swap_16((uint16_t *)dest,
+							 (const uint16_t *)src,
+							 n);
+
+		case 4:
+			return pcm_channels_simd_swap_32((uint32_t *)dest,
+							 (const uint32_t *)src,
+							 n);
+		}
+
+		break;
+
+	case Layout::MONO_TO_STEREO:
+		switch (input_format.GetSampleSize()) {
+		case 2:
+			return pcm_channels_simd_mono_to_stereo_16((uint16_t *)dest,
+								   (const uint16_t *)src,
+								   n);
+
+		case 4:
+			return pcm_channels_simd_mono_to_stereo_32((uint32_t *)dest,
+								   (const uint32_t *)src,
+								   n);
+		}
+
+		break;
+	}
+
+	return 0;
+}
+
 const void *
 RouteFilter::FilterPCM(const void *src, size_t src_size,
 		       size_t *dest_size_r, gcc_unused Error &error)
 {
-	size_t number_of_frames = src_size / input_frame_size;
-
-	const size_t bytes_per_frame_per_channel = input_format.GetSampleSize();
+	if (layout == Layout::IDENTITY) {
+		*dest_size_r = src_size;
+		return src;
+	}
 
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const uint8_t *base_source = (const uint8_t *)src;
+	const size_t number_of_frames = src_size / input_frame_size;
 
-	// Grow our reusable buffer, if needed, and set the moving pointer
 	*dest_size_r = number_of_frames * output_frame_size;
 	void *const result = output_buffer.Get(*dest_size_r);
 
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	uint8_t *chan_destination = (uint8_t *)result;
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned int c=0; c<min_output_channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				memset(chan_destination,
-					0x00,
-					bytes_per_frame_per_channel);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
-		}
-
-
-		// Go on to the next N input samples
-		base_source += input_frame_size;
+	/* the vectorised kernels do the bulk of the common layouts;
+	   the remaining frames (and all other layouts) are routed
+	   with a loop specialised for the sample size */
+	const size_t done = RouteSimd(result, src, number_of_frames);
+	const size_t n = number_of_frames - done;
+	const void *const s = (const uint8_t *)src + done * input_frame_size;
+	void *const d = (uint8_t *)result + done * output_frame_size;
+
+	switch (input_format.GetSampleSize()) {
+	case 1:
+		RouteFrames((uint8_t *)d, (const uint8_t *)s, n,
+			    input_format.channels,
+			    sources, min_output_channels);
+		break;
+
+	case 2:
+		RouteFrames((uint16_t *)d, (const uint16_t *)s, n,
+			    input_format.channels,
+			    sources, min_output_channels);
+		break;
+
+	case 4:
+		RouteFrames((uint32_t *)d, (const uint32_t *)s, n,
+			    input_format.channels,
+			    sources, min_output_channels);
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
 	}
 
-	// Here it is, ladies and gentlemen! Rerouted data!
 	return result;
 }
 
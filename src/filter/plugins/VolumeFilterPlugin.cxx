@@ -32,21 +32,77 @@
 #include <string.h>
 
 class VolumeFilter final : public Filter {
+	/**
+	 * The volume level set by the mixer.
+	 */
+	unsigned volume;
+
+	/**
+	 * An additional gain factor which is combined with #volume,
+	 * see volume_filter_set_gain().
+	 */
+	unsigned gain;
+
+	/**
+	 * The duration of a volume ramp in milliseconds, see
+	 * volume_filter_set_ramp().
+	 */
+	unsigned ramp_ms;
+
 	PcmVolume pv;
 
 public:
+	VolumeFilter()
+		:volume(PCM_VOLUME_1), gain(PCM_VOLUME_1), ramp_ms(0) {}
+
 	unsigned GetVolume() const {
-		return pv.GetVolume();
+		return volume;
 	}
 
 	void SetVolume(unsigned _volume) {
-		pv.SetVolume(_volume);
+		volume = _volume;
+		Update();
+	}
+
+	void SetGain(unsigned _gain) {
+		gain = _gain;
+		Update();
+	}
+
+	void SetDither(bool dither) {
+		pv.SetDither(dither);
+	}
+
+	void SetRamp(unsigned ms) {
+		ramp_ms = ms;
 	}
 
 	virtual AudioFormat Open(AudioFormat &af, Error &error) override;
 	virtual void Close();
 	virtual const void *FilterPCM(const void *src, size_t src_size,
 				      size_t *dest_size_r, Error &error);
+
+	virtual bool IsPassThrough() const override {
+		return pv.IsPassThrough();
+	}
+
+	virtual bool GetGain(unsigned &gain_r, bool &dither_r) const override {
+		if (pv.IsRamping())
+			/* not a constant factor right now; don't let
+			   ChainFilter fuse us, or the ramp would be
+			   skipped */
+			return false;
+
+		gain_r = pv.GetVolume();
+		dither_r = pv.GetDither();
+		return true;
+	}
+
+private:
+	void Update() {
+		pv.SetVolume(((uint64_t)volume * gain + PCM_VOLUME_1 / 2)
+			     >> PCM_VOLUME_BITS);
+	}
 };
 
 static constexpr Domain volume_domain("pcm_volume");
@@ -64,6 +120,9 @@ VolumeFilter::Open(AudioFormat &audio_format, Error &error)
 	if (!pv.Open(audio_format.format, error))
 		return AudioFormat::Undefined();
 
+	pv.SetRamp(audio_format.channels,
+		   uint64_t(audio_format.sample_rate) * ramp_ms / 1000);
+
 	return audio_format;
 }
 
@@ -104,3 +163,26 @@ volume_filter_set(Filter *_filter, unsigned volume)
 	filter->SetVolume(volume);
 }
 
+void
+volume_filter_set_gain(Filter *_filter, unsigned gain)
+{
+	VolumeFilter *filter = (VolumeFilter *)_filter;
+
+	filter->SetGain(gain);
+}
+
+void
+volume_filter_set_dither(Filter *_filter, bool dither)
+{
+	VolumeFilter *filter = (VolumeFilter *)_filter;
+
+	filter->SetDither(dither);
+}
+
+void
+volume_filter_set_ramp(Filter *_filter, unsigned ms)
+{
+	VolumeFilter *filter = (VolumeFilter *)_filter;
+
+	filter->SetRamp(ms);
+}
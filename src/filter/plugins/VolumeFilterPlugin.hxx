@@ -28,4 +28,30 @@ volume_filter_get(const Filter *filter);
 void
 volume_filter_set(Filter *filter, unsigned volume);
 
+/**
+ * Set an additional gain factor (in #PCM_VOLUME_1 units) which is
+ * multiplied with the volume level, so both are applied to the
+ * samples in one pass.  This is used to fold replay gain into the
+ * software mixer.
+ */
+void
+volume_filter_set_gain(Filter *filter, unsigned gain);
+
+/**
+ * Enable or disable dithering.  Without dithering, the vectorised
+ * code path can be used.
+ */
+void
+volume_filter_set_dither(Filter *filter, bool dither);
+
+/**
+ * Let volume changes fade in over the given duration instead of
+ * jumping to the new level, which would click.  Takes effect when
+ * the filter is opened the next time.
+ *
+ * @param ms the ramp duration in milliseconds; 0 disables ramping
+ */
+void
+volume_filter_set_ramp(Filter *filter, unsigned ms);
+
 #endif
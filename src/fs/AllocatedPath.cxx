@@ -46,7 +46,15 @@ AllocatedPath
 AllocatedPath::FromUTF8(const char *path_utf8)
 {
 #ifdef HAVE_GLIB
-	return AllocatedPath(Donate(), ::PathFromUTF8(path_utf8));
+	if (IsFSCharsetUTF8())
+		/* copy only once, not with g_strdup() first */
+		return FromFS(path_utf8);
+
+	char *path_fs = ::PathFromUTF8(path_utf8);
+	if (path_fs == nullptr)
+		return Null();
+
+	return AllocatedPath(Donate(), path_fs);
 #else
 	return FromFS(path_utf8);
 #endif
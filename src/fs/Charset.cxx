@@ -26,6 +26,9 @@
 #include "Traits.hxx"
 
 #ifdef HAVE_GLIB
+#include "thread/Mutex.hxx"
+#include "util/ASCII.hxx"
+
 #include <glib.h>
 #endif
 
@@ -45,8 +48,43 @@
 static constexpr size_t MPD_PATH_MAX_UTF8 = (MPD_PATH_MAX - 1) * 4 + 1;
 
 #ifdef HAVE_GLIB
+/**
+ * The configured file system charset.  It is empty if that is UTF-8,
+ * i.e. if no conversion is necessary.
+ */
 static std::string fs_charset;
 
+/**
+ * Conversion descriptors between #fs_charset and UTF-8, opened once by
+ * SetFSCharset() instead of on each conversion.  They carry a shift
+ * state, so they are protected by #charset_mutex.
+ */
+static GIConv conv_to_utf8 = reinterpret_cast<GIConv>(-1);
+static GIConv conv_from_utf8 = reinterpret_cast<GIConv>(-1);
+static Mutex charset_mutex;
+
+static void
+CloseConverters()
+{
+	if (conv_to_utf8 != reinterpret_cast<GIConv>(-1)) {
+		g_iconv_close(conv_to_utf8);
+		conv_to_utf8 = reinterpret_cast<GIConv>(-1);
+	}
+
+	if (conv_from_utf8 != reinterpret_cast<GIConv>(-1)) {
+		g_iconv_close(conv_from_utf8);
+		conv_from_utf8 = reinterpret_cast<GIConv>(-1);
+	}
+}
+
+gcc_pure
+static bool
+IsUTF8Charset(const char *charset)
+{
+	return StringEqualsCaseASCII(charset, "UTF-8") ||
+		StringEqualsCaseASCII(charset, "UTF8");
+}
+
 gcc_pure
 static bool
 IsSupportedCharset(const char *charset)
@@ -68,7 +106,23 @@ SetFSCharset(const char *charset)
 	if (!IsSupportedCharset(charset))
 		FormatFatalError("invalid filesystem charset: %s", charset);
 
+	const ScopeLock protect(charset_mutex);
+
+	CloseConverters();
+
+	if (IsUTF8Charset(charset)) {
+		/* all conversions are no-ops */
+		fs_charset.clear();
+		FormatDebug(path_domain, "SetFSCharset: fs charset is UTF-8");
+		return;
+	}
+
 	fs_charset = charset;
+	conv_to_utf8 = g_iconv_open("utf-8", charset);
+	conv_from_utf8 = g_iconv_open(charset, "utf-8");
+	if (conv_to_utf8 == reinterpret_cast<GIConv>(-1) ||
+	    conv_from_utf8 == reinterpret_cast<GIConv>(-1))
+		FormatFatalError("invalid filesystem charset: %s", charset);
 
 	FormatDebug(path_domain,
 		    "SetFSCharset: fs charset is: %s", fs_charset.c_str());
@@ -86,6 +140,16 @@ GetFSCharset()
 #endif
 }
 
+bool
+IsFSCharsetUTF8()
+{
+#ifdef HAVE_GLIB
+	return fs_charset.empty();
+#else
+	return true;
+#endif
+}
+
 static inline void FixSeparators(std::string &s)
 {
 #ifdef WIN32
@@ -113,10 +177,6 @@ PathToUTF8(const char *path_fs)
 #ifdef HAVE_GLIB
 	}
 
-	GIConv conv = g_iconv_open("utf-8", fs_charset.c_str());
-	if (conv == reinterpret_cast<GIConv>(-1))
-		return std::string();
-
 	// g_iconv() does not need nul-terminator,
 	// std::string could be created without it too.
 	char path_utf8[MPD_PATH_MAX_UTF8 - 1];
@@ -125,9 +185,16 @@ PathToUTF8(const char *path_fs)
 	size_t in_left = strlen(path_fs);
 	size_t out_left = sizeof(path_utf8);
 
-	size_t ret = g_iconv(conv, &in, &in_left, &out, &out_left);
+	size_t ret;
 
-	g_iconv_close(conv);
+	{
+		const ScopeLock protect(charset_mutex);
+
+		/* reset the shift state */
+		g_iconv(conv_to_utf8, nullptr, nullptr, nullptr, nullptr);
+
+		ret = g_iconv(conv_to_utf8, &in, &in_left, &out, &out_left);
+	}
 
 	if (ret == static_cast<size_t>(-1) || in_left > 0)
 		return std::string();
@@ -148,9 +215,38 @@ PathFromUTF8(const char *path_utf8)
 	if (fs_charset.empty())
 		return g_strdup(path_utf8);
 
-	return g_convert(path_utf8, -1,
-			 fs_charset.c_str(), "utf-8",
-			 nullptr, nullptr, nullptr);
+	char *in = const_cast<char *>(path_utf8);
+	size_t in_left = strlen(path_utf8);
+
+	/* no sane file system charset needs more than 4 bytes per
+	   UTF-8 byte */
+	const size_t out_size = in_left * 4 + 1;
+	char *const path_fs = (char *)g_malloc(out_size);
+	char *out = path_fs;
+	size_t out_left = out_size - 1;
+
+	size_t ret;
+
+	{
+		const ScopeLock protect(charset_mutex);
+
+		/* reset the shift state */
+		g_iconv(conv_from_utf8, nullptr, nullptr, nullptr, nullptr);
+
+		ret = g_iconv(conv_from_utf8, &in, &in_left, &out, &out_left);
+		if (ret != static_cast<size_t>(-1))
+			/* flush the shift sequence */
+			ret = g_iconv(conv_from_utf8, nullptr, nullptr,
+				      &out, &out_left);
+	}
+
+	if (ret == static_cast<size_t>(-1) || in_left > 0) {
+		g_free(path_fs);
+		return nullptr;
+	}
+
+	*out = 0;
+	return path_fs;
 }
 
 #endif
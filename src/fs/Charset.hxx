@@ -35,6 +35,15 @@ GetFSCharset();
 void
 SetFSCharset(const char *charset);
 
+/**
+ * Is the file system character set UTF-8, i.e. are all conversions
+ * no-ops?  If yes, callers may use file system names as UTF-8
+ * strings (and vice versa) without copying them.
+ */
+gcc_pure
+bool
+IsFSCharsetUTF8();
+
 /**
  * Convert the path to UTF-8.
  * Returns empty string on error.
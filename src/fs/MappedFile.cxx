@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h" /* must be first for large file support */
+#include "MappedFile.hxx"
+#include "FileSystem.hxx"
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(Path path_fs)
+	:data(nullptr), size(0)
+{
+#ifndef WIN32
+	int fd = OpenFile(path_fs, O_RDONLY, 0);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+	    uint64_t(st.st_size) != uint64_t(size_t(st.st_size))) {
+		close(fd);
+		return;
+	}
+
+	void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return;
+
+	data = (const uint8_t *)p;
+	size = st.st_size;
+#else
+	(void)path_fs;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef WIN32
+	if (data != nullptr)
+		munmap(const_cast<uint8_t *>(data), size);
+#endif
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MAPPED_FILE_HXX
+#define MPD_MAPPED_FILE_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Path;
+
+/**
+ * A regular file mapped into memory read-only, to let parsers
+ * access it without read() calls and buffer copies.  This is not
+ * available on WIN32; HasFailed() is always true there, and callers
+ * need to fall back to reading the file.
+ *
+ * If another process truncates the file while it is mapped,
+ * accessing the missing pages raises SIGBUS; therefore this is
+ * meant for short-lived mappings only.
+ */
+class MappedFile {
+	const uint8_t *data;
+	size_t size;
+
+public:
+	explicit MappedFile(Path path_fs);
+
+	MappedFile(const MappedFile &other) = delete;
+	MappedFile &operator=(const MappedFile &other) = delete;
+
+	~MappedFile();
+
+	bool HasFailed() const {
+		return gcc_unlikely(data == nullptr);
+	}
+
+	const uint8_t *GetData() const {
+		return data;
+	}
+
+	size_t GetSize() const {
+		return size;
+	}
+};
+
+#endif
@@ -23,20 +23,82 @@
 #include "fs/Path.hxx"
 #include "fs/FileSystem.hxx"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef HAVE_ZLIB
+
+/**
+ * The size of zlib's input buffer; larger than the default to reduce
+ * the number of system calls.
+ */
+static constexpr unsigned GZIP_BUFFER_SIZE = 64 * 1024;
+
+static gzFile
+OpenTextFile(Path path_fs)
+{
+	gzFile file = gzopen(path_fs.c_str(), "rb");
+	if (file != nullptr)
+		gzbuffer(file, GZIP_BUFFER_SIZE);
+	return file;
+}
+
+static char *
+ReadTextFile(char *buffer, size_t size, gzFile file)
+{
+	return gzgets(file, buffer, size);
+}
+
+static bool
+HasTextFileError(gzFile file)
+{
+	int errnum;
+	gzerror(file, &errnum);
+	return errnum != Z_OK && errnum != Z_BUF_ERROR;
+}
+
+#else
+
+static FILE *
+OpenTextFile(Path path_fs)
+{
+	return FOpen(path_fs, FOpenMode::ReadText);
+}
+
+static char *
+ReadTextFile(char *buffer, size_t size, FILE *file)
+{
+	return fgets(buffer, size, file);
+}
+
+static bool
+HasTextFileError(FILE *file)
+{
+	return ferror(file);
+}
+
+#endif
+
 TextFile::TextFile(Path path_fs)
-	:file(FOpen(path_fs, FOpenMode::ReadText)),
+	:file(OpenTextFile(path_fs)),
 	 buffer((char *)xalloc(step)), capacity(step), length(0) {}
 
 TextFile::~TextFile()
 {
 	free(buffer);
 
-	if (file != nullptr)
+	if (file != nullptr) {
+#ifdef HAVE_ZLIB
+		gzclose(file);
+#else
 		fclose(file);
+#endif
+	}
 }
 
 char *
@@ -55,11 +117,14 @@ TextFile::ReadLine()
 			if (new_buffer == nullptr)
 				/* out of memory - bail out */
 				return nullptr;
+
+			buffer = new_buffer;
 		}
 
-		char *p = fgets(buffer + length, capacity - length, file);
+		char *p = ReadTextFile(buffer + length, capacity - length,
+				       file);
 		if (p == nullptr) {
-			if (length == 0 || ferror(file))
+			if (length == 0 || HasTextFileError(file))
 				return nullptr;
 			break;
 		}
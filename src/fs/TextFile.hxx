@@ -20,6 +20,7 @@
 #ifndef MPD_TEXT_FILE_HXX
 #define MPD_TEXT_FILE_HXX
 
+#include "check.h"
 #include "Compiler.h"
 
 #include <stdio.h>
@@ -27,11 +28,23 @@
 
 class Path;
 
+#ifdef HAVE_ZLIB
+struct gzFile_s;
+#endif
+
+/**
+ * Reads a text file line by line.  If zlib support is enabled, files
+ * compressed with gzip are decompressed transparently.
+ */
 class TextFile {
 	static constexpr size_t max_length = 512 * 1024;
 	static constexpr size_t step = 1024;
 
+#ifdef HAVE_ZLIB
+	gzFile_s *const file;
+#else
 	FILE *const file;
+#endif
 
 	char *buffer;
 	size_t capacity, length;
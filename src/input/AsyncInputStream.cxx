@@ -38,7 +38,9 @@ AsyncInputStream::AsyncInputStream(const char *_url,
 	 open(true),
 	 paused(false),
 	 seek_state(SeekState::NONE),
-	 tag(nullptr) {}
+	 tag(nullptr) {
+	memory_input_buffer.Add(_buffer_size);
+}
 
 AsyncInputStream::~AsyncInputStream()
 {
@@ -46,6 +48,7 @@ AsyncInputStream::~AsyncInputStream()
 
 	buffer.Clear();
 	HugeFree(buffer.Write().data, buffer.GetCapacity());
+	memory_input_buffer.Sub(buffer.GetCapacity());
 }
 
 void
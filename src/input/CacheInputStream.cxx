@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CacheInputStream.hxx"
+#include "InputCache.hxx"
+#include "ProxyInputStream.hxx"
+#include "util/UriUtil.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+static constexpr Domain cache_input_domain("cache_input");
+
+/**
+ * Copies the data of the underlying stream into an #InputCacheItem
+ * while it is being read.
+ */
+class CacheInputStream final : public ProxyInputStream {
+	/**
+	 * The item being filled, or nullptr if this resource is not
+	 * being cached.  Its size is always the offset of the
+	 * underlying stream.
+	 */
+	InputCacheItem *item;
+
+public:
+	CacheInputStream(InputStream *_input)
+		:ProxyInputStream(_input), item(nullptr) {}
+
+	~CacheInputStream() {
+		if (item != nullptr)
+			input_cache->Release(*item);
+	}
+
+	/* virtual methods from InputStream */
+
+	void Update() override {
+		if (!ReadingFromCache()) {
+			input.Update();
+			CopyInputAttributes();
+		}
+	}
+
+	bool IsEOF() override {
+		return !ReadingFromCache() && input.IsEOF();
+	}
+
+	bool IsAvailable() override {
+		return ReadingFromCache() || input.IsAvailable();
+	}
+
+	bool Seek(offset_type new_offset, Error &error) override;
+	size_t Read(void *ptr, size_t size, Error &error) override;
+
+private:
+	/**
+	 * Is the read position inside the cached range, i.e. behind
+	 * the position of the underlying stream?
+	 */
+	bool ReadingFromCache() const {
+		return item != nullptr && uint64_t(offset) < item->size;
+	}
+
+	/**
+	 * Like ProxyInputStream::CopyAttributes(), but decides
+	 * whether to cache the resource when it becomes ready.  Must
+	 * not be called while reading from the cache.
+	 */
+	void CopyInputAttributes();
+
+	/**
+	 * Stop caching, e.g. because the cache is full.
+	 */
+	void Abandon();
+
+	/**
+	 * Commit the item if the underlying stream has been read
+	 * completely.
+	 */
+	void CheckComplete();
+
+	/**
+	 * Read forward from the underlying stream, to emulate a
+	 * seek in a stream which is not seekable.
+	 */
+	bool SkipTo(offset_type new_offset, Error &error);
+};
+
+void
+CacheInputStream::CopyInputAttributes()
+{
+	if (!input.IsReady())
+		return;
+
+	if (!IsReady()) {
+		if (input.HasMimeType())
+			SetMimeType(input.GetMimeType());
+
+		size = input.GetSize();
+		seekable = input.IsSeekable();
+
+		if (input.KnownSize() && input.GetOffset() == 0 &&
+		    input_cache->CanCache(size)) {
+			item = input_cache->Create(GetURI());
+			seekable = true;
+		}
+
+		SetReady();
+	}
+
+	offset = input.GetOffset();
+}
+
+void
+CacheInputStream::Abandon()
+{
+	assert(item != nullptr);
+
+	input_cache->Release(*item);
+	item = nullptr;
+
+	seekable = input.IsSeekable();
+}
+
+void
+CacheInputStream::CheckComplete()
+{
+	if (item != nullptr && !item->committed && input.IsEOF() &&
+	    item->size == uint64_t(size)) {
+		if (HasMimeType())
+			item->mime = GetMimeType();
+
+		input_cache->Commit(*item);
+	}
+}
+
+size_t
+CacheInputStream::Read(void *ptr, size_t read_size, Error &error)
+{
+	if (ReadingFromCache()) {
+		size_t nbytes = item->Read(offset, ptr, read_size);
+		if (nbytes == 0)
+			error.Set(cache_input_domain,
+				  "Failed to read from the cache");
+
+		offset += nbytes;
+		return nbytes;
+	}
+
+	assert(item == nullptr || item->size == uint64_t(input.GetOffset()));
+
+	size_t nbytes = input.Read(ptr, read_size, error);
+	if (item != nullptr && nbytes > 0 &&
+	    !input_cache->Append(*item, ptr, nbytes))
+		Abandon();
+
+	CopyInputAttributes();
+	CheckComplete();
+	return nbytes;
+}
+
+bool
+CacheInputStream::SkipTo(offset_type new_offset, Error &error)
+{
+	char buffer[8192];
+
+	while (offset < new_offset) {
+		const size_t nbytes =
+			Read(buffer, std::min<offset_type>(sizeof(buffer),
+							   new_offset - offset),
+			     error);
+		if (nbytes == 0) {
+			if (!error.IsDefined())
+				error.Set(cache_input_domain,
+					  "Seek beyond the end of the stream");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+CacheInputStream::Seek(offset_type new_offset, Error &error)
+{
+	assert(IsReady());
+
+	if (item != nullptr) {
+		if (uint64_t(new_offset) <= item->size) {
+			/* cached seek */
+			offset = new_offset;
+			return true;
+		}
+
+		if (!input.IsSeekable()) {
+			/* continue caching up to the new position */
+			offset = item->size;
+			return SkipTo(new_offset, error);
+		}
+
+		/* the cached range would not be contiguous
+		   anymore */
+		Abandon();
+	}
+
+	bool success = input.Seek(new_offset, error);
+	CopyInputAttributes();
+	return success;
+}
+
+/**
+ * Reads a resource from a committed #InputCacheItem.
+ */
+class CachedInputStream final : public InputStream {
+	InputCacheItem &item;
+
+public:
+	CachedInputStream(const char *_uri, Mutex &_mutex, Cond &_cond,
+			  InputCacheItem &_item)
+		:InputStream(_uri, _mutex, _cond), item(_item) {
+		if (!item.mime.empty())
+			SetMimeType(item.mime.c_str());
+
+		size = item.size;
+		seekable = true;
+		SetReady();
+	}
+
+	~CachedInputStream() {
+		input_cache->Release(item);
+	}
+
+	/* virtual methods from InputStream */
+
+	bool IsEOF() override {
+		return offset >= size;
+	}
+
+	bool Seek(offset_type new_offset, Error &error) override {
+		if (new_offset < 0 || new_offset > size) {
+			error.Set(cache_input_domain, "Invalid seek offset");
+			return false;
+		}
+
+		offset = new_offset;
+		return true;
+	}
+
+	size_t Read(void *ptr, size_t read_size, Error &error) override {
+		size_t nbytes = item.Read(offset, ptr, read_size);
+		if (nbytes == 0 && !IsEOF())
+			error.Set(cache_input_domain,
+				  "Failed to read from the cache");
+
+		offset += nbytes;
+		return nbytes;
+	}
+};
+
+InputStream *
+input_cache_open(const char *uri, Mutex &mutex, Cond &cond)
+{
+	if (input_cache == nullptr || !uri_has_scheme(uri))
+		return nullptr;
+
+	InputCacheItem *item = input_cache->Get(uri);
+	if (item == nullptr)
+		return nullptr;
+
+	return new CachedInputStream(uri, mutex, cond, *item);
+}
+
+InputStream *
+input_cache_wrap(InputStream *is)
+{
+	assert(is != nullptr);
+
+	if (input_cache == nullptr || !uri_has_scheme(is->GetURI()))
+		return is;
+
+	return new CacheInputStream(is);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * Wrappers which copy the contents of remote input streams into the
+ * #InputCache, and which replay cached resources without opening
+ * them again.  A stream which is being cached becomes seekable
+ * within the cached range, even if the underlying stream is not.
+ */
+
+#ifndef MPD_CACHE_INPUT_STREAM_HXX
+#define MPD_CACHE_INPUT_STREAM_HXX
+
+class InputStream;
+class Mutex;
+class Cond;
+
+/**
+ * Open a resource from the #InputCache.
+ *
+ * @return nullptr if the resource is not cached
+ */
+InputStream *
+input_cache_open(const char *uri, Mutex &mutex, Cond &cond);
+
+/**
+ * Wrap a newly opened stream, so its contents are added to the
+ * #InputCache.  Returns the stream unmodified if the cache is
+ * disabled or if the resource is local.
+ */
+InputStream *
+input_cache_wrap(InputStream *is);
+
+#endif
@@ -21,6 +21,7 @@
 #include "Init.hxx"
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
+#include "InputCache.hxx"
 #include "util/Error.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
@@ -35,6 +36,9 @@ input_stream_global_init(Error &error)
 {
 	const config_param empty;
 
+	if (!input_cache_global_init(error))
+		return false;
+
 	for (unsigned i = 0; input_plugins[i] != nullptr; ++i) {
 		const InputPlugin *plugin = input_plugins[i];
 
@@ -84,4 +88,6 @@ void input_stream_global_finish(void)
 	input_plugins_for_each_enabled(plugin)
 		if (plugin->finish != nullptr)
 			plugin->finish();
+
+	input_cache_global_finish();
 }
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "InputCache.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/ConfigData.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr Domain input_cache_domain("input_cache");
+
+InputCache *input_cache;
+
+InputCacheItem::~InputCacheItem()
+{
+	for (auto chunk : chunks)
+		delete[] chunk;
+
+	if (fd >= 0)
+		close(fd);
+}
+
+size_t
+InputCacheItem::Read(uint64_t offset, void *dest, size_t length) const
+{
+	assert(offset <= size);
+
+	if (length > size - offset)
+		length = size - offset;
+
+	if (length == 0)
+		return 0;
+
+	if (offset < memory_size) {
+		const size_t position = offset % CHUNK_SIZE;
+		const uint8_t *chunk = chunks[offset / CHUNK_SIZE];
+
+		length = std::min<uint64_t>({length, CHUNK_SIZE - position,
+					     memory_size - offset});
+		memcpy(dest, chunk + position, length);
+		return length;
+	}
+
+#ifdef WIN32
+	return 0;
+#else
+	ssize_t nbytes = pread(fd, dest, length, offset - memory_size);
+	if (nbytes < 0) {
+		LogErrno(input_cache_domain, "Failed to read spill file");
+		return 0;
+	}
+
+	return nbytes;
+#endif
+}
+
+InputCache::InputCache(size_t _memory_limit,
+		       AllocatedPath &&_directory, uint64_t _disk_limit)
+	:memory_limit(_memory_limit), memory_used(0),
+	 directory(std::move(_directory)),
+	 disk_limit(directory.IsNull() ? 0 : _disk_limit), disk_used(0)
+{
+}
+
+InputCache::~InputCache()
+{
+	for (auto item : items) {
+		assert(item->refs == 0);
+		delete item;
+	}
+}
+
+InputCacheItem *
+InputCache::Get(const char *uri)
+{
+	const ScopeLock protect(mutex);
+
+	for (auto i = items.begin(); i != items.end(); ++i) {
+		InputCacheItem &item = **i;
+		if (item.uri == uri) {
+			++item.refs;
+			items.splice(items.begin(), items, i);
+			return &item;
+		}
+	}
+
+	return nullptr;
+}
+
+InputCacheItem *
+InputCache::Create(const char *uri)
+{
+	return new InputCacheItem(uri);
+}
+
+bool
+InputCache::EvictOne()
+{
+	for (auto i = items.rbegin(); i != items.rend(); ++i) {
+		InputCacheItem *item = *i;
+		if (item->refs == 0) {
+			FormatDebug(input_cache_domain, "evicting %s",
+				    item->uri.c_str());
+			items.erase(std::next(i).base());
+			Free(item);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool
+InputCache::ReserveMemory(size_t size)
+{
+	while (memory_used + size > memory_limit)
+		if (!EvictOne())
+			return false;
+
+	memory_used += size;
+	return true;
+}
+
+bool
+InputCache::ReserveDisk(uint64_t size)
+{
+	while (disk_used + size > disk_limit)
+		if (!EvictOne())
+			return false;
+
+	disk_used += size;
+	return true;
+}
+
+void
+InputCache::Free(InputCacheItem *item)
+{
+	memory_used -= item->chunks.size() * InputCacheItem::CHUNK_SIZE;
+	disk_used -= item->GetDiskSize();
+	delete item;
+}
+
+bool
+InputCache::OpenSpillFile(InputCacheItem &item)
+{
+	assert(item.fd < 0);
+
+#ifdef WIN32
+	(void)item;
+	return false;
+#else
+	if (directory.IsNull())
+		return false;
+
+#ifdef O_TMPFILE
+	item.fd = open(directory.c_str(), O_TMPFILE|O_RDWR|O_CLOEXEC, 0600);
+	if (item.fd >= 0)
+		return true;
+#endif
+
+	/* fall back to a named file which is deleted right away */
+	std::string name(directory.c_str());
+	name.append("/mpd-cache-XXXXXX");
+
+	item.fd = mkstemp(&name[0]);
+	if (item.fd < 0) {
+		FormatErrno(input_cache_domain,
+			    "Failed to create a file in %s",
+			    directory.c_str());
+		return false;
+	}
+
+	unlink(name.c_str());
+	return true;
+#endif
+}
+
+bool
+InputCache::Append(InputCacheItem &item, const void *_data, size_t length)
+{
+	assert(!item.committed);
+
+	const uint8_t *data = (const uint8_t *)_data;
+
+	while (length > 0 && item.fd < 0) {
+		if (item.memory_size ==
+		    item.chunks.size() * InputCacheItem::CHUNK_SIZE) {
+			bool reserved;
+
+			{
+				const ScopeLock protect(mutex);
+				reserved = ReserveMemory(InputCacheItem::CHUNK_SIZE);
+			}
+
+			if (!reserved) {
+				/* memory is full; spill the rest to
+				   the disk */
+				if (!OpenSpillFile(item))
+					return false;
+
+				break;
+			}
+
+			item.chunks.push_back(new uint8_t[InputCacheItem::CHUNK_SIZE]);
+		}
+
+		const size_t position =
+			item.memory_size % InputCacheItem::CHUNK_SIZE;
+		const size_t nbytes =
+			std::min(length, InputCacheItem::CHUNK_SIZE - position);
+		memcpy(item.chunks.back() + position, data, nbytes);
+		item.memory_size += nbytes;
+		item.size += nbytes;
+		data += nbytes;
+		length -= nbytes;
+	}
+
+	if (length == 0)
+		return true;
+
+#ifdef WIN32
+	return false;
+#else
+	{
+		const ScopeLock protect(mutex);
+		if (!ReserveDisk(length))
+			return false;
+	}
+
+	ssize_t nbytes = pwrite(item.fd, data, length, item.GetDiskSize());
+	if (nbytes != (ssize_t)length) {
+		if (nbytes < 0)
+			LogErrno(input_cache_domain,
+				 "Failed to write spill file");
+
+		const ScopeLock protect(mutex);
+		disk_used -= length;
+		return false;
+	}
+
+	item.size += length;
+	return true;
+#endif
+}
+
+void
+InputCache::Commit(InputCacheItem &item)
+{
+	assert(!item.committed);
+	assert(item.refs > 0);
+
+	const ScopeLock protect(mutex);
+
+	for (auto i : items)
+		if (i->uri == item.uri)
+			/* another stream was faster */
+			return;
+
+	FormatDebug(input_cache_domain, "caching %s (%llu bytes)",
+		    item.uri.c_str(), (unsigned long long)item.size);
+
+	item.committed = true;
+	items.push_front(&item);
+}
+
+void
+InputCache::Release(InputCacheItem &item)
+{
+	const ScopeLock protect(mutex);
+
+	assert(item.refs > 0);
+	--item.refs;
+
+	if (!item.committed) {
+		assert(item.refs == 0);
+		Free(&item);
+	}
+}
+
+bool
+input_cache_global_init(Error &error)
+{
+	const config_param *param = config_get_param(CONF_INPUT_CACHE);
+	if (param == nullptr)
+		/* disabled */
+		return true;
+
+	const unsigned memory_kb = param->GetBlockValue("size", 16384u);
+
+	AllocatedPath directory = param->GetBlockPath("directory", error);
+	if (directory.IsNull() && error.IsDefined())
+		return false;
+
+	const unsigned disk_kb = param->GetBlockValue("disk_size",
+						      1024u * 1024u);
+
+	input_cache = new InputCache(size_t(memory_kb) * 1024,
+				     std::move(directory),
+				     uint64_t(disk_kb) * 1024);
+	return true;
+}
+
+void
+input_cache_global_finish()
+{
+	delete input_cache;
+	input_cache = nullptr;
+}
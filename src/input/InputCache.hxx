@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_INPUT_CACHE_HXX
+#define MPD_INPUT_CACHE_HXX
+
+#include "thread/Mutex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <vector>
+#include <list>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Error;
+
+/**
+ * The contents of one resource in the #InputCache.  The first bytes
+ * are stored in memory; when the memory limit is reached, the rest
+ * goes into an unlinked temporary file.
+ *
+ * While an item is being filled, it is private to its
+ * #CacheInputStream.  After InputCache::Commit(), it is immutable
+ * and may be shared by several readers.
+ */
+struct InputCacheItem {
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+	const std::string uri;
+
+	std::string mime;
+
+	/**
+	 * The in-memory part of the contents, #CHUNK_SIZE bytes
+	 * each.
+	 */
+	std::vector<uint8_t *> chunks;
+
+	/**
+	 * The number of bytes in #chunks.
+	 */
+	uint64_t memory_size;
+
+	/**
+	 * The total number of bytes.  Everything after #memory_size
+	 * is in the spill file.
+	 */
+	uint64_t size;
+
+	/**
+	 * The spill file, or -1 if everything is in memory.
+	 */
+	int fd;
+
+	/**
+	 * The number of streams using this item.  Protected by
+	 * InputCache::mutex.
+	 */
+	unsigned refs;
+
+	/**
+	 * Has this item been added to the cache?
+	 */
+	bool committed;
+
+	explicit InputCacheItem(const char *_uri)
+		:uri(_uri), memory_size(0), size(0), fd(-1),
+		 refs(1), committed(false) {}
+
+	~InputCacheItem();
+
+	InputCacheItem(const InputCacheItem &) = delete;
+	InputCacheItem &operator=(const InputCacheItem &) = delete;
+
+	gcc_pure
+	uint64_t GetDiskSize() const {
+		return size - memory_size;
+	}
+
+	/**
+	 * Copy data from the item.  No lock needed.
+	 *
+	 * @return the number of bytes copied, 0 on error
+	 */
+	size_t Read(uint64_t offset, void *dest, size_t length) const;
+};
+
+/**
+ * A cache for the contents of remote resources, filled by
+ * #CacheInputStream.  Complete items are evicted in LRU order when
+ * a limit is reached; items which are in use are never evicted.
+ */
+class InputCache {
+	Mutex mutex;
+
+	const size_t memory_limit;
+	size_t memory_used;
+
+	/**
+	 * The directory for spill files.  If it is "null", the
+	 * cache does not use the disk.
+	 */
+	const AllocatedPath directory;
+
+	const uint64_t disk_limit;
+	uint64_t disk_used;
+
+	/**
+	 * All committed items, the most recently used one first.
+	 */
+	std::list<InputCacheItem *> items;
+
+public:
+	InputCache(size_t _memory_limit,
+		   AllocatedPath &&_directory, uint64_t _disk_limit);
+	~InputCache();
+
+	InputCache(const InputCache &) = delete;
+	InputCache &operator=(const InputCache &) = delete;
+
+	/**
+	 * Can a resource of this size be cached at all?
+	 */
+	gcc_pure
+	bool CanCache(uint64_t size) const {
+		return size <= memory_limit + disk_limit;
+	}
+
+	/**
+	 * Look up a committed item and reference it.  Call Release()
+	 * when done.
+	 *
+	 * @return nullptr if there is no such item
+	 */
+	InputCacheItem *Get(const char *uri);
+
+	/**
+	 * Create a new private item which will be filled with
+	 * Append().
+	 */
+	InputCacheItem *Create(const char *uri);
+
+	/**
+	 * Append data to a private item.  May evict other items to
+	 * make room.
+	 *
+	 * @return false if there is no room or if writing the
+	 * spill file has failed; the item cannot be committed anymore
+	 */
+	bool Append(InputCacheItem &item, const void *data, size_t length);
+
+	/**
+	 * Add a complete private item to the cache.  Unless this URI
+	 * has been cached meanwhile; then it stays private.
+	 */
+	void Commit(InputCacheItem &item);
+
+	/**
+	 * Release a reference obtained by Get() or Create().  Private
+	 * items are freed.
+	 */
+	void Release(InputCacheItem &item);
+
+private:
+	/**
+	 * Free the least recently used item which is not in use.
+	 * Caller must lock the mutex.
+	 *
+	 * @return false if there is no such item
+	 */
+	bool EvictOne();
+
+	/**
+	 * Account for #size bytes of memory, evicting other items if
+	 * necessary.  Caller must lock the mutex.
+	 */
+	bool ReserveMemory(size_t size);
+
+	/**
+	 * Account for #size bytes on the disk, evicting other items
+	 * if necessary.  Caller must lock the mutex.
+	 */
+	bool ReserveDisk(uint64_t size);
+
+	/**
+	 * Free an item and its accounting.  Caller must lock the
+	 * mutex.
+	 */
+	void Free(InputCacheItem *item);
+
+	bool OpenSpillFile(InputCacheItem &item);
+};
+
+/**
+ * The global input cache configured with "input_cache", or nullptr
+ * if caching is disabled.
+ */
+extern InputCache *input_cache;
+
+bool
+input_cache_global_init(Error &error);
+
+void
+input_cache_global_finish();
+
+#endif
@@ -24,6 +24,8 @@
 
 #include <assert.h>
 
+MemoryAccount memory_input_buffer;
+
 InputStream::~InputStream()
 {
 }
@@ -116,6 +118,12 @@ InputStream::LockRead(void *ptr, size_t _size, Error &error)
 	return Read(ptr, _size, error);
 }
 
+ConstBuffer<void>
+InputStream::ReadDirect(gcc_unused size_t _size, gcc_unused Error &error)
+{
+	return nullptr;
+}
+
 bool
 InputStream::LockIsEOF()
 {
@@ -22,6 +22,8 @@
 
 #include "check.h"
 #include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/MemoryAccount.hxx"
 #include "Compiler.h"
 
 #include <string>
@@ -33,6 +35,13 @@ class Cond;
 class Error;
 struct Tag;
 
+/**
+ * The memory occupied by the buffers of all input streams.  Plugins
+ * which may choose their buffer size shall use
+ * MemoryAccount::Clamp().
+ */
+extern MemoryAccount memory_input_buffer;
+
 class InputStream {
 public:
 	typedef int64_t offset_type;
@@ -359,6 +368,20 @@ public:
 	 */
 	gcc_nonnull_all
 	size_t LockRead(void *ptr, size_t size, Error &error);
+
+	/**
+	 * Like Read(), but instead of copying the data, return a
+	 * pointer into memory owned by the stream (e.g. a
+	 * memory-mapped file).  The pointer remains valid until the
+	 * stream is closed.
+	 *
+	 * The caller must lock the mutex.
+	 *
+	 * @return the data (empty on end of file or error), or a
+	 * "null" buffer if this stream does not support direct reads;
+	 * the caller shall fall back to Read() then
+	 */
+	virtual ConstBuffer<void> ReadDirect(size_t size, Error &error);
 };
 
 #endif
@@ -21,6 +21,7 @@
 #include "InputStream.hxx"
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
+#include "CacheInputStream.hxx"
 #include "plugins/RewindInputPlugin.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -32,11 +33,16 @@ InputStream::Open(const char *url,
 		  Mutex &mutex, Cond &cond,
 		  Error &error)
 {
+	InputStream *cached = input_cache_open(url, mutex, cond);
+	if (cached != nullptr)
+		return cached;
+
 	input_plugins_for_each_enabled(plugin) {
 		InputStream *is;
 
 		is = plugin->open(url, mutex, cond, error);
 		if (is != nullptr) {
+			is = input_cache_wrap(is);
 			is = input_rewind_open(is);
 
 			return is;
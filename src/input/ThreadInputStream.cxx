@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "ThreadInputStream.hxx"
+#include "tag/Tag.hxx"
 #include "thread/Name.hxx"
 #include "util/CircularBuffer.hxx"
 #include "util/HugeAllocator.hxx"
@@ -28,6 +29,24 @@
 
 ThreadInputStream::~ThreadInputStream()
 {
+	Stop();
+
+	if (buffer != nullptr) {
+		buffer->Clear();
+		HugeFree(buffer->Write().data, buffer_size);
+		delete buffer;
+		memory_input_buffer.Sub(buffer_size);
+	}
+
+	delete tag;
+}
+
+void
+ThreadInputStream::Stop()
+{
+	if (!thread.IsDefined())
+		return;
+
 	Lock();
 	close = true;
 	wake_cond.signal();
@@ -36,12 +55,6 @@ ThreadInputStream::~ThreadInputStream()
 	Cancel();
 
 	thread.Join();
-
-	if (buffer != nullptr) {
-		buffer->Clear();
-		HugeFree(buffer->Write().data, buffer_size);
-		delete buffer;
-	}
 }
 
 InputStream *
@@ -56,6 +69,7 @@ ThreadInputStream::Start(Error &error)
 	}
 
 	buffer = new CircularBuffer<uint8_t>((uint8_t *)p, buffer_size);
+	memory_input_buffer.Add(buffer_size);
 
 	if (!thread.Start(ThreadFunc, this, error))
 		return nullptr;
@@ -81,22 +95,51 @@ ThreadInputStream::ThreadFunc()
 	while (!close) {
 		assert(!postponed_error.IsDefined());
 
+		if (seeking) {
+			/* discard the data from the old position */
+			buffer->Clear();
+			eof = false;
+
+			Unlock();
+
+			Error error;
+			const bool success = ThreadSeek(seek_offset, error);
+
+			Lock();
+			seeking = false;
+			cond.broadcast();
+
+			if (!success) {
+				postponed_error = std::move(error);
+				break;
+			}
+
+			continue;
+		}
+
 		auto w = buffer->Write();
-		if (w.IsEmpty()) {
+		if (w.IsEmpty() || eof) {
 			wake_cond.wait(mutex);
 		} else {
 			Unlock();
 
 			Error error;
-			size_t nbytes = Read(w.data, w.size, error);
+			size_t nbytes = ThreadRead(w.data, w.size, error);
 
 			Lock();
 			cond.broadcast();
 
 			if (nbytes == 0) {
 				eof = true;
-				postponed_error = std::move(error);
-				break;
+
+				if (error.IsDefined() || !IsSeekable()) {
+					postponed_error = std::move(error);
+					break;
+				}
+
+				/* a seekable stream stays alive at the
+				   end, there may be a Seek() call */
+				continue;
 			}
 
 			buffer->Append(nbytes);
@@ -158,8 +201,69 @@ ThreadInputStream::Read(void *ptr, size_t read_size, Error &error)
 	}
 }
 
+bool
+ThreadInputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (!IsSeekable())
+		return false;
+
+	if (postponed_error.IsDefined()) {
+		/* the thread has already quit */
+		error = std::move(postponed_error);
+		return false;
+	}
+
+	if (new_offset == offset)
+		return true;
+
+	if (new_offset > offset) {
+		/* skip forward inside the buffer */
+		auto r = buffer->Read();
+		if (offset_type(r.size) >= new_offset - offset) {
+			buffer->Consume(new_offset - offset);
+			wake_cond.broadcast();
+			offset = new_offset;
+			return true;
+		}
+	}
+
+	seeking = true;
+	seek_offset = new_offset;
+	wake_cond.broadcast();
+
+	while (seeking)
+		cond.wait(mutex);
+
+	if (postponed_error.IsDefined()) {
+		error = std::move(postponed_error);
+		return false;
+	}
+
+	offset = new_offset;
+	return true;
+}
+
+Tag *
+ThreadInputStream::ReadTag()
+{
+	Tag *result = tag;
+	tag = nullptr;
+	return result;
+}
+
+void
+ThreadInputStream::SetTag(Tag *_tag)
+{
+	assert(thread.IsInside());
+
+	delete tag;
+	tag = _tag;
+}
+
 bool
 ThreadInputStream::IsEOF()
 {
-	return eof;
+	/* the thread may have reached the end while there is still
+	   unread data in the buffer */
+	return eof && buffer->IsEmpty();
 }
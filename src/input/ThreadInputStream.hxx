@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 
+struct Tag;
 template<typename T> class CircularBuffer;
 
 /**
@@ -37,7 +38,10 @@ template<typename T> class CircularBuffer;
  * another thread using the regular #InputStream API.  This class
  * manages the thread and the buffer.
  *
- * This works only for "streams": unknown length, no seeking, no tags.
+ * Seeking is supported if the implementation sets the "seekable"
+ * flag and implements ThreadSeek(); seeking forward within the
+ * buffered data does not involve the thread.  Tags submitted with
+ * SetTag() are passed on to the client.
  */
 class ThreadInputStream : public InputStream {
 	const char *const plugin;
@@ -66,6 +70,19 @@ class ThreadInputStream : public InputStream {
 	 */
 	bool eof;
 
+	/**
+	 * Has Seek() asked the thread to seek to #seek_offset?
+	 */
+	bool seeking;
+
+	offset_type seek_offset;
+
+	/**
+	 * The tag submitted by SetTag() which has not yet been
+	 * consumed by ReadTag().
+	 */
+	Tag *tag;
+
 public:
 	ThreadInputStream(const char *_plugin,
 			  const char *_uri, Mutex &_mutex, Cond &_cond,
@@ -74,7 +91,8 @@ public:
 		 plugin(_plugin),
 		 buffer_size(_buffer_size),
 		 buffer(nullptr),
-		 close(false), eof(false) {}
+		 close(false), eof(false), seeking(false),
+		 tag(nullptr) {}
 
 	virtual ~ThreadInputStream();
 
@@ -90,14 +108,32 @@ public:
 	bool IsEOF() override final;
 	bool IsAvailable() override final;
 	size_t Read(void *ptr, size_t size, Error &error) override final;
+	bool Seek(offset_type offset, Error &error) override final;
+	Tag *ReadTag() override final;
 
 protected:
+	/**
+	 * Stop the thread and wait for it to finish.  Destructors of
+	 * derived classes which free resources used by ThreadRead()
+	 * must call this first.
+	 */
+	void Stop();
+
 	void SetMimeType(const char *_mime) {
 		assert(thread.IsInside());
 
 		InputStream::SetMimeType(_mime);
 	}
 
+	/**
+	 * Submit a new tag, to be returned by the next ReadTag()
+	 * call.  An older tag which has not been read yet is
+	 * discarded.
+	 *
+	 * The #InputStream must be locked.
+	 */
+	void SetTag(Tag *_tag);
+
 	/* to be implemented by the plugin */
 
 	/**
@@ -121,6 +157,20 @@ protected:
 	 */
 	virtual size_t ThreadRead(void *ptr, size_t size, Error &error) = 0;
 
+	/**
+	 * Seek to the specified position; the next ThreadRead() call
+	 * shall return data from there.  Only called if the stream
+	 * is seekable.
+	 *
+	 * The #InputStream is not locked.
+	 *
+	 * @return false on error
+	 */
+	virtual bool ThreadSeek(gcc_unused offset_type new_offset,
+				gcc_unused Error &error) {
+		return false;
+	}
+
 	/**
 	 * Optional deinitialization before leaving the thread.
 	 *
@@ -23,7 +23,7 @@
 
 #include "config.h"
 #include "CdioParanoiaInputPlugin.hxx"
-#include "../InputStream.hxx"
+#include "../ThreadInputStream.hxx"
 #include "../InputPlugin.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
@@ -50,62 +50,82 @@
 
 #include <cdio/cd_types.h>
 
-class CdioParanoiaInputStream final : public InputStream {
+class CdioParanoiaInputStream final : public ThreadInputStream {
 	cdrom_drive_t *const drv;
 	CdIo_t *const cdio;
 	cdrom_paranoia_t *const para;
 
 	const lsn_t lsn_from, lsn_to;
+
+	/**
+	 * The position of the reader thread [bytes].  The client's
+	 * position (InputStream::offset) is behind this by the
+	 * amount of buffered data.
+	 */
+	offset_type position;
+
 	int lsn_relofs;
 
 	char buffer[CDIO_CD_FRAMESIZE_RAW];
 	int buffer_lsn;
 
+	const bool reverse_endian;
+
  public:
 	CdioParanoiaInputStream(const char *_uri, Mutex &_mutex, Cond &_cond,
 				cdrom_drive_t *_drv, CdIo_t *_cdio,
-				bool reverse_endian,
-				lsn_t _lsn_from, lsn_t _lsn_to)
-		:InputStream(_uri, _mutex, _cond),
+				bool _reverse_endian,
+				lsn_t _lsn_from, lsn_t _lsn_to,
+				size_t _buffer_size, int mode)
+		:ThreadInputStream(input_plugin_cdio_paranoia.name,
+				   _uri, _mutex, _cond, _buffer_size),
 		 drv(_drv), cdio(_cdio), para(cdio_paranoia_init(drv)),
 		 lsn_from(_lsn_from), lsn_to(_lsn_to),
-		 lsn_relofs(0),
-		 buffer_lsn(-1)
+		 position(0), lsn_relofs(0),
+		 buffer_lsn(-1),
+		 reverse_endian(_reverse_endian)
 	{
-		/* Set reading mode for full paranoia, but allow
-		   skipping sectors. */
-		paranoia_modeset(para,
-				 PARANOIA_MODE_FULL^PARANOIA_MODE_NEVERSKIP);
+		paranoia_modeset(para, mode);
 
 		/* seek to beginning of the track */
 		cdio_paranoia_seek(para, lsn_from, SEEK_SET);
 
 		seekable = true;
 		size = (lsn_to - lsn_from + 1) * CDIO_CD_FRAMESIZE_RAW;
-
-		/* hack to make MPD select the "pcm" decoder plugin */
-		SetMimeType(reverse_endian
-			    ? "audio/x-mpd-cdda-pcm-reverse"
-			    : "audio/x-mpd-cdda-pcm");
-		SetReady();
 	}
 
 	~CdioParanoiaInputStream() {
+		/* the thread uses the drive */
+		Stop();
+
 		cdio_paranoia_free(para);
 		cdio_cddap_close_no_free_cdio(drv);
 		cdio_destroy(cdio);
 	}
 
-	/* virtual methods from InputStream */
-	bool IsEOF() override;
-	size_t Read(void *ptr, size_t size, Error &error) override;
-	bool Seek(offset_type offset, Error &error) override;
+protected:
+	/* virtual methods from ThreadInputStream */
+	bool Open(Error &error) override;
+	size_t ThreadRead(void *ptr, size_t size, Error &error) override;
+	bool ThreadSeek(offset_type new_offset, Error &error) override;
 };
 
 static constexpr Domain cdio_domain("cdio");
 
 static bool default_reverse_endian;
 
+/**
+ * The number of seconds the reader thread reads ahead
+ * ("read_ahead"), so drive spin-up and error correction do not
+ * stall the decoder.
+ */
+static unsigned read_ahead = 5;
+
+/**
+ * Full paranoia, but allow skipping sectors.
+ */
+static int paranoia_mode = PARANOIA_MODE_FULL ^ PARANOIA_MODE_NEVERSKIP;
+
 static InputPlugin::InitResult
 input_cdio_init(const config_param &param, Error &error)
 {
@@ -123,6 +143,33 @@ input_cdio_init(const config_param &param, Error &error)
 		}
 	}
 
+	read_ahead = param.GetBlockValue("read_ahead", read_ahead);
+	if (read_ahead == 0) {
+		error.Set(config_domain, "'read_ahead' must be positive");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	value = param.GetBlockValue("paranoia_mode");
+	if (value != nullptr) {
+		if (strcmp(value, "disable") == 0)
+			paranoia_mode = PARANOIA_MODE_DISABLE;
+		else if (strcmp(value, "overlap") == 0)
+			paranoia_mode = PARANOIA_MODE_OVERLAP;
+		else if (strcmp(value, "full") == 0)
+			paranoia_mode = PARANOIA_MODE_FULL;
+		else {
+			error.Format(config_domain, 0,
+				     "Unrecognized 'paranoia_mode' setting: %s",
+				     value);
+			return InputPlugin::InitResult::ERROR;
+		}
+	}
+
+	if (param.GetBlockValue("paranoia_never_skip", false))
+		paranoia_mode |= PARANOIA_MODE_NEVERSKIP;
+	else
+		paranoia_mode &= ~PARANOIA_MODE_NEVERSKIP;
+
 	return InputPlugin::InitResult::SUCCESS;
 }
 
@@ -266,13 +313,32 @@ input_cdio_open(const char *uri,
 		lsn_to = cdio_get_disc_last_lsn(cdio);
 	}
 
-	return new CdioParanoiaInputStream(uri, mutex, cond,
-					   drv, cdio, reverse_endian,
-					   lsn_from, lsn_to);
+	const size_t buffer_size =
+		read_ahead * CDIO_CD_FRAMES_PER_SEC * CDIO_CD_FRAMESIZE_RAW;
+
+	auto c = new CdioParanoiaInputStream(uri, mutex, cond,
+					     drv, cdio, reverse_endian,
+					     lsn_from, lsn_to,
+					     buffer_size, paranoia_mode);
+	auto is = c->Start(error);
+	if (is == nullptr)
+		delete c;
+
+	return is;
 }
 
 bool
-CdioParanoiaInputStream::Seek(offset_type new_offset, Error &error)
+CdioParanoiaInputStream::Open(gcc_unused Error &error)
+{
+	/* hack to make MPD select the "pcm" decoder plugin */
+	SetMimeType(reverse_endian
+		    ? "audio/x-mpd-cdda-pcm-reverse"
+		    : "audio/x-mpd-cdda-pcm");
+	return true;
+}
+
+bool
+CdioParanoiaInputStream::ThreadSeek(offset_type new_offset, Error &error)
 {
 	if (new_offset < 0 || new_offset > size) {
 		error.Format(cdio_domain, "Invalid offset to seek %ld (%ld)",
@@ -280,13 +346,9 @@ CdioParanoiaInputStream::Seek(offset_type new_offset, Error &error)
 		return false;
 	}
 
-	/* simple case */
-	if (new_offset == offset)
-		return true;
-
 	/* calculate current LSN */
 	lsn_relofs = new_offset / CDIO_CD_FRAMESIZE_RAW;
-	offset = new_offset;
+	position = new_offset;
 
 	cdio_paranoia_seek(para, lsn_from + lsn_relofs, SEEK_SET);
 
@@ -294,77 +356,59 @@ CdioParanoiaInputStream::Seek(offset_type new_offset, Error &error)
 }
 
 size_t
-CdioParanoiaInputStream::Read(void *ptr, size_t length, Error &error)
+CdioParanoiaInputStream::ThreadRead(void *ptr, size_t length, Error &error)
 {
-	size_t nbytes = 0;
-	int diff;
-	size_t len, maxwrite;
-	int16_t *rbuf;
-	char *s_err, *s_mess;
-	char *wptr = (char *) ptr;
-
-	while (length > 0) {
-
-
-		/* end of track ? */
-		if (lsn_from + lsn_relofs > lsn_to)
-			break;
-
-		//current sector was changed ?
-		if (lsn_relofs != buffer_lsn) {
-			rbuf = cdio_paranoia_read(para, nullptr);
-
-			s_err = cdda_errors(drv);
-			if (s_err) {
-				FormatError(cdio_domain,
-					    "paranoia_read: %s", s_err);
-				free(s_err);
-			}
-			s_mess = cdda_messages(drv);
-			if (s_mess) {
-				free(s_mess);
-			}
-			if (!rbuf) {
-				error.Set(cdio_domain,
-					  "paranoia read error. Stopping.");
-				return 0;
-			}
-			//store current buffer
-			memcpy(buffer, rbuf, CDIO_CD_FRAMESIZE_RAW);
-			buffer_lsn = lsn_relofs;
-		} else {
-			//use cached sector
-			rbuf = (int16_t *)buffer;
-		}
+	/* end of track ? */
+	if (lsn_from + lsn_relofs > lsn_to)
+		return 0;
 
-		//correct offset
-		diff = offset - lsn_relofs * CDIO_CD_FRAMESIZE_RAW;
+	const int16_t *rbuf;
 
-		assert(diff >= 0 && diff < CDIO_CD_FRAMESIZE_RAW);
+	//current sector was changed ?
+	if (lsn_relofs != buffer_lsn) {
+		rbuf = cdio_paranoia_read(para, nullptr);
 
-		maxwrite = CDIO_CD_FRAMESIZE_RAW - diff;  //# of bytes pending in current buffer
-		len = (length < maxwrite? length : maxwrite);
+		char *s_err = cdda_errors(drv);
+		if (s_err) {
+			FormatError(cdio_domain,
+				    "paranoia_read: %s", s_err);
+			free(s_err);
+		}
+		char *s_mess = cdda_messages(drv);
+		if (s_mess) {
+			free(s_mess);
+		}
+		if (!rbuf) {
+			error.Set(cdio_domain,
+				  "paranoia read error. Stopping.");
+			return 0;
+		}
+		//store current buffer
+		memcpy(buffer, rbuf, CDIO_CD_FRAMESIZE_RAW);
+		buffer_lsn = lsn_relofs;
+	} else {
+		//use cached sector
+		rbuf = (const int16_t *)buffer;
+	}
 
-		//skip diff bytes from this lsn
-		memcpy(wptr, ((char*)rbuf) + diff, len);
-		//update pointer
-		wptr += len;
-		nbytes += len;
+	//correct offset
+	const int diff = position - lsn_relofs * CDIO_CD_FRAMESIZE_RAW;
 
-		//update offset
-		offset += len;
-		lsn_relofs = offset / CDIO_CD_FRAMESIZE_RAW;
-		//update length
-		length -= len;
-	}
+	assert(diff >= 0 && diff < CDIO_CD_FRAMESIZE_RAW);
 
-	return nbytes;
-}
+	/* return at most one sector, so the buffer is filled (and
+	   the decoder can start) sector by sector */
+	const size_t maxwrite = CDIO_CD_FRAMESIZE_RAW - diff;  //# of bytes pending in current buffer
+	const size_t len = (length < maxwrite? length : maxwrite);
 
-bool
-CdioParanoiaInputStream::IsEOF()
-{
-	return lsn_from + lsn_relofs > lsn_to;
+	//skip diff bytes from this lsn
+	memcpy(ptr, ((const char *)rbuf) + diff, len);
+
+	//update position
+	position += len;
+	lsn_relofs = position / CDIO_CD_FRAMESIZE_RAW;
+
+	return len;
 }
 
 const InputPlugin input_plugin_cdio_paranoia = {
@@ -27,19 +27,29 @@
 #include "tag/Tag.hxx"
 #include "tag/TagBuilder.hxx"
 #include "event/SocketMonitor.hxx"
+#include "event/DeferredMonitor.hxx"
 #include "event/TimeoutMonitor.hxx"
 #include "event/Call.hxx"
 #include "IOThread.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ASCII.hxx"
 #include "util/CharUtil.hxx"
 #include "util/NumberParser.hxx"
 #include "util/CircularBuffer.hxx"
 #include "util/HugeAllocator.hxx"
+#include "util/Clamp.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <list>
+
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <curl/curl.h>
@@ -49,37 +59,94 @@
 #endif
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * The default for the "buffer_size" setting: do not buffer more
+ * than this number of bytes.  It should be a reasonable limit that
+ * doesn't make low-end machines suffer too much, but doesn't cause
+ * stuttering on high-latency lines.
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
+static constexpr size_t CURL_DEFAULT_BUFFER_SIZE = 512 * 1024;
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The smallest buffer a new stream gets when the "input_buffer"
+ * memory budget is exhausted.
  */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+static constexpr size_t CURL_MIN_BUFFER_SIZE = 16 * 1024;
 
-struct CurlInputStream final : public AsyncInputStream {
-	/* some buffers which were passed to libcurl, which we have
-	   too free */
-	char range[32];
-	struct curl_slist *request_headers;
+/**
+ * The adaptive buffer holds this many times the measured
+ * bandwidth-delay product.  The stream is resumed when the buffer is
+ * 3/4 full, so the remaining quarter covers about 8 round trips,
+ * which is enough for TCP to leave slow start again.
+ */
+static constexpr size_t CURL_BDP_FACTOR = 32;
 
-	/** the curl handles */
+/**
+ * Resume the stream when the buffer has been drained to this size
+ * after it has been paused.
+ */
+/**
+ * The size of the segments fetched with "Range" requests by
+ * #CurlSegmentedInputStream.
+ */
+static constexpr size_t CURL_SEGMENT_SIZE = 256 * 1024;
+
+/**
+ * The default for the "segment_cache" setting.
+ */
+static constexpr size_t CURL_DEFAULT_SEGMENT_CACHE = 16 * 1024 * 1024;
+
+static constexpr size_t
+CurlResumeAt(size_t buffer_size)
+{
+	return buffer_size / 4 * 3;
+}
+
+/**
+ * An object owning a CURL "easy" handle which can be registered in
+ * the #CurlMulti.  Its address is passed to libcurl with
+ * CURLOPT_PRIVATE.
+ */
+class CurlRequest {
+public:
+	/** the curl handle */
 	CURL *easy;
 
 	/** error message provided by libcurl */
 	char error_buffer[CURL_ERROR_SIZE];
 
+	CurlRequest():easy(nullptr) {}
+
+	/**
+	 * Create the "easy" handle and set the options which are
+	 * common to all requests.
+	 */
+	bool InitEasy(const char *url, Error &error);
+
+	/**
+	 * A HTTP request is finished.
+	 *
+	 * Runs in the I/O thread.  The caller must not hold locks.
+	 */
+	virtual void RequestDone(CURLcode result, long status) = 0;
+
+protected:
+	~CurlRequest() {}
+};
+
+struct CurlInputStream final : public AsyncInputStream, CurlRequest {
+	/* some buffers which were passed to libcurl, which we have
+	   too free */
+	char range[32];
+	struct curl_slist *request_headers;
+
 	/** parser for icy-metadata */
 	IcyInputStream *icy;
 
 	CurlInputStream(const char *_url, Mutex &_mutex, Cond &_cond,
-			void *_buffer)
+			void *_buffer, size_t _buffer_size)
 		:AsyncInputStream(_url, _mutex, _cond,
-				  _buffer, CURL_MAX_BUFFERED,
-				  CURL_RESUME_AT),
+				  _buffer, _buffer_size,
+				  CurlResumeAt(_buffer_size)),
 		 request_headers(nullptr),
 		 icy(new IcyInputStream(this)) {}
 
@@ -109,16 +176,20 @@ struct CurlInputStream final : public AsyncInputStream {
 	 */
 	void FreeEasyIndirect();
 
+	/**
+	 * Feed the transfer statistics of the "easy" handle into the
+	 * adaptive buffer size.
+	 *
+	 * Runs in the I/O thread.
+	 */
+	void MeasureBandwidthDelay();
+
 	void HeaderReceived(const char *name, std::string &&value);
 
 	size_t DataReceived(const void *ptr, size_t size);
 
-	/**
-	 * A HTTP request is finished.
-	 *
-	 * Runs in the I/O thread.  The caller must not hold locks.
-	 */
-	void RequestDone(CURLcode result, long status);
+	/* virtual methods from CurlRequest */
+	void RequestDone(CURLcode result, long status) override;
 
 	/* virtual methods from AsyncInputStream */
 	virtual void DoResume() override;
@@ -197,8 +268,8 @@ public:
 		curl_multi_cleanup(multi);
 	}
 
-	bool Add(CurlInputStream *c, Error &error);
-	void Remove(CurlInputStream *c);
+	bool Add(CurlRequest *c, Error &error);
+	void Remove(CurlRequest *c);
 
 	/**
 	 * Check for finished HTTP responses.
@@ -245,8 +316,43 @@ static struct curl_slist *http_200_aliases;
 static const char *proxy, *proxy_user, *proxy_password;
 static unsigned proxy_port;
 
+/**
+ * The buffer size configured with "buffer_size", and the upper
+ * limit configured with "max_buffer_size".  If they differ, the
+ * buffer size adapts to the measured bandwidth-delay product.
+ */
+static size_t buffer_size, max_buffer_size;
+
+/**
+ * The buffer size for new streams, calculated from the last
+ * bandwidth-delay product.  Written by the I/O thread.
+ */
+static std::atomic_size_t adaptive_buffer_size;
+
+/**
+ * The number of concurrent "Range" requests configured with
+ * "segments", and the number of segments which fit into
+ * "segment_cache".  Segmented download is disabled if there is only
+ * one connection.
+ */
+static unsigned segment_connections;
+static size_t segment_cache_count;
+
 static CurlMulti *curl_multi;
 
+/**
+ * Shares the DNS cache, TLS sessions and connections between all
+ * requests, to make opening another stream on the same server
+ * cheaper.
+ */
+static CURLSH *curl_share;
+
+/**
+ * Protects the data in #curl_share.  Most requests are used only
+ * by the I/O thread, but they are created in the client thread.
+ */
+static Mutex curl_share_mutex[CURL_LOCK_DATA_LAST];
+
 static constexpr Domain http_domain("http");
 static constexpr Domain curl_domain("curl");
 static constexpr Domain curlm_domain("curlm");
@@ -260,6 +366,53 @@ CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
 
 	curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, TimerFunction);
 	curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/* run concurrent requests to the same HTTP/2 server over one
+	   connection */
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+}
+
+static void
+input_curl_share_lock(gcc_unused CURL *handle, curl_lock_data data,
+		      gcc_unused curl_lock_access access,
+		      gcc_unused void *userptr)
+{
+	curl_share_mutex[data].lock();
+}
+
+static void
+input_curl_share_unlock(gcc_unused CURL *handle, curl_lock_data data,
+			gcc_unused void *userptr)
+{
+	curl_share_mutex[data].unlock();
+}
+
+/**
+ * Allocate #curl_share.  Failure is not fatal, the requests just
+ * don't share anything.
+ */
+static void
+input_curl_share_init()
+{
+	curl_share = curl_share_init();
+	if (curl_share == nullptr) {
+		FormatWarning(curl_domain, "curl_share_init() failed");
+		return;
+	}
+
+	curl_share_setopt(curl_share, CURLSHOPT_LOCKFUNC,
+			  input_curl_share_lock);
+	curl_share_setopt(curl_share, CURLSHOPT_UNLOCKFUNC,
+			  input_curl_share_unlock);
+	curl_share_setopt(curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+			  CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+	curl_share_setopt(curl_share, CURLSHOPT_SHARE,
+			  CURL_LOCK_DATA_CONNECT);
+#endif
 }
 
 /**
@@ -268,7 +421,7 @@ CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
  * Runs in the I/O thread.  No lock needed.
  */
 gcc_pure
-static CurlInputStream *
+static CurlRequest *
 input_curl_find_request(CURL *easy)
 {
 	assert(io_thread_inside());
@@ -278,7 +431,7 @@ input_curl_find_request(CURL *easy)
 	if (code != CURLE_OK)
 		return nullptr;
 
-	return (CurlInputStream *)p;
+	return (CurlRequest *)p;
 }
 
 void
@@ -351,7 +504,7 @@ CurlSocket::OnSocketReady(unsigned flags)
  * Runs in the I/O thread.  No lock needed.
  */
 inline bool
-CurlMulti::Add(CurlInputStream *c, Error &error)
+CurlMulti::Add(CurlRequest *c, Error &error)
 {
 	assert(io_thread_inside());
 	assert(c != nullptr);
@@ -374,7 +527,7 @@ CurlMulti::Add(CurlInputStream *c, Error &error)
  * any thread.  Caller must not hold a mutex.
  */
 static bool
-input_curl_easy_add_indirect(CurlInputStream *c, Error &error)
+input_curl_easy_add_indirect(CurlRequest *c, Error &error)
 {
 	assert(c != nullptr);
 	assert(c->easy != nullptr);
@@ -387,7 +540,7 @@ input_curl_easy_add_indirect(CurlInputStream *c, Error &error)
 }
 
 inline void
-CurlMulti::Remove(CurlInputStream *c)
+CurlMulti::Remove(CurlRequest *c)
 {
 	curl_multi_remove_handle(multi, c->easy);
 }
@@ -400,6 +553,8 @@ CurlInputStream::FreeEasy()
 	if (easy == nullptr)
 		return;
 
+	MeasureBandwidthDelay();
+
 	curl_multi->Remove(this);
 
 	curl_easy_cleanup(easy);
@@ -409,6 +564,46 @@ CurlInputStream::FreeEasy()
 	request_headers = nullptr;
 }
 
+void
+CurlInputStream::MeasureBandwidthDelay()
+{
+	assert(io_thread_inside());
+	assert(easy != nullptr);
+
+	if (max_buffer_size <= buffer_size)
+		/* adaptive buffer disabled */
+		return;
+
+	/* the TCP handshake takes one round trip, and the average
+	   speed is at most the throughput of the line */
+	double rtt;
+#if LIBCURL_VERSION_NUM >= 0x073700
+	curl_off_t speed;
+	const CURLINFO speed_info = CURLINFO_SPEED_DOWNLOAD_T;
+#else
+	double speed;
+	const CURLINFO speed_info = CURLINFO_SPEED_DOWNLOAD;
+#endif
+	if (curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME,
+			      &rtt) != CURLE_OK ||
+	    curl_easy_getinfo(easy, speed_info, &speed) != CURLE_OK ||
+	    rtt <= 0 || speed <= 0)
+		/* no new connection or no data, e.g. a reused
+		   connection which was closed quickly */
+		return;
+
+	const double bdp = rtt * double(speed);
+	const size_t new_size = Clamp(size_t(bdp * CURL_BDP_FACTOR),
+				      buffer_size, max_buffer_size);
+
+	FormatDebug(curl_domain,
+		    "rtt=%.0fms speed=%.0f kB/s: buffer_size=%lu kB",
+		    rtt * 1000, double(speed) / 1024,
+		    (unsigned long)(new_size / 1024));
+
+	adaptive_buffer_size = new_size;
+}
+
 void
 CurlInputStream::FreeEasyIndirect()
 {
@@ -420,7 +615,7 @@ CurlInputStream::FreeEasyIndirect()
 	assert(easy == nullptr);
 }
 
-inline void
+void
 CurlInputStream::RequestDone(CURLcode result, long status)
 {
 	assert(io_thread_inside());
@@ -449,7 +644,7 @@ CurlInputStream::RequestDone(CURLcode result, long status)
 static void
 input_curl_handle_done(CURL *easy_handle, CURLcode result)
 {
-	CurlInputStream *c = input_curl_find_request(easy_handle);
+	CurlRequest *c = input_curl_find_request(easy_handle);
 	assert(c != nullptr);
 
 	long status = 0;
@@ -528,6 +723,35 @@ CurlMulti::OnTimeout()
 static InputPlugin::InitResult
 input_curl_init(const config_param &param, Error &error)
 {
+	const unsigned buffer_kb =
+		param.GetBlockValue("buffer_size",
+				    unsigned(CURL_DEFAULT_BUFFER_SIZE / 1024));
+	const unsigned max_buffer_kb =
+		param.GetBlockValue("max_buffer_size", buffer_kb);
+	if (buffer_kb < 16 || max_buffer_kb < buffer_kb) {
+		error.Set(curl_domain,
+			  "Invalid \"buffer_size\" or \"max_buffer_size\"");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	buffer_size = size_t(buffer_kb) * 1024;
+	max_buffer_size = size_t(max_buffer_kb) * 1024;
+	adaptive_buffer_size = buffer_size;
+
+	segment_connections = param.GetBlockValue("segments", 1u);
+	const unsigned segment_cache_kb =
+		param.GetBlockValue("segment_cache",
+				    unsigned(CURL_DEFAULT_SEGMENT_CACHE / 1024));
+	if (segment_connections < 1 || segment_connections > 16) {
+		error.Set(curl_domain, "Invalid \"segments\"");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	/* the cache must hold at least one segment per connection */
+	segment_cache_count = std::max(size_t(segment_cache_kb) * 1024
+				       / CURL_SEGMENT_SIZE,
+				       size_t(segment_connections));
+
 	CURLcode code = curl_global_init(CURL_GLOBAL_ALL);
 	if (code != CURLE_OK) {
 		error.Format(curl_domain, code,
@@ -570,6 +794,8 @@ input_curl_init(const config_param &param, Error &error)
 		return InputPlugin::InitResult::UNAVAILABLE;
 	}
 
+	input_curl_share_init();
+
 	curl_multi = new CurlMulti(io_thread_get(), multi);
 	return InputPlugin::InitResult::SUCCESS;
 }
@@ -581,6 +807,9 @@ input_curl_finish(void)
 			delete curl_multi;
 		});
 
+	if (curl_share != nullptr)
+		curl_share_cleanup(curl_share);
+
 	curl_slist_free_all(http_200_aliases);
 
 	curl_global_cleanup();
@@ -631,10 +860,11 @@ CurlInputStream::HeaderReceived(const char *name, std::string &&value)
 }
 
 /** called by curl when new data is available */
+template<typename T>
 static size_t
 input_curl_headerfunction(void *ptr, size_t size, size_t nmemb, void *stream)
 {
-	CurlInputStream &c = *(CurlInputStream *)stream;
+	T &c = *(T *)stream;
 
 	size *= nmemb;
 
@@ -686,10 +916,11 @@ CurlInputStream::DataReceived(const void *ptr, size_t received_size)
 }
 
 /** called by curl when new data is available */
+template<typename T>
 static size_t
 input_curl_writefunction(void *ptr, size_t size, size_t nmemb, void *stream)
 {
-	CurlInputStream &c = *(CurlInputStream *)stream;
+	T &c = *(T *)stream;
 
 	size *= nmemb;
 	if (size == 0)
@@ -699,7 +930,7 @@ input_curl_writefunction(void *ptr, size_t size, size_t nmemb, void *stream)
 }
 
 bool
-CurlInputStream::InitEasy(Error &error)
+CurlRequest::InitEasy(const char *url, Error &error)
 {
 	easy = curl_easy_init();
 	if (easy == nullptr) {
@@ -710,12 +941,6 @@ CurlInputStream::InitEasy(Error &error)
 	curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)this);
 	curl_easy_setopt(easy, CURLOPT_USERAGENT,
 			 "Music Player Daemon " VERSION);
-	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION,
-			 input_curl_headerfunction);
-	curl_easy_setopt(easy, CURLOPT_WRITEHEADER, this);
-	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
-			 input_curl_writefunction);
-	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
 	curl_easy_setopt(easy, CURLOPT_HTTP200ALIASES, http_200_aliases);
 	curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1);
 	curl_easy_setopt(easy, CURLOPT_NETRC, 1);
@@ -726,6 +951,17 @@ CurlInputStream::InitEasy(Error &error)
 	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1l);
 	curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10l);
 
+	if (curl_share != nullptr)
+		curl_easy_setopt(easy, CURLOPT_SHARE, curl_share);
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	/* prefer HTTP/2 over TLS, and wait for a connection which
+	   can be multiplexed instead of opening another one */
+	curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+			 (long)CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1l);
+#endif
+
 	if (proxy != nullptr)
 		curl_easy_setopt(easy, CURLOPT_PROXY, proxy);
 
@@ -740,7 +976,7 @@ CurlInputStream::InitEasy(Error &error)
 		curl_easy_setopt(easy, CURLOPT_PROXYUSERPWD, proxy_auth_str);
 	}
 
-	CURLcode code = curl_easy_setopt(easy, CURLOPT_URL, GetURI());
+	CURLcode code = curl_easy_setopt(easy, CURLOPT_URL, url);
 	if (code != CURLE_OK) {
 		error.Format(curl_domain, code,
 			     "curl_easy_setopt() failed: %s",
@@ -748,6 +984,22 @@ CurlInputStream::InitEasy(Error &error)
 		return false;
 	}
 
+	return true;
+}
+
+bool
+CurlInputStream::InitEasy(Error &error)
+{
+	if (!CurlRequest::InitEasy(GetURI(), error))
+		return false;
+
+	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION,
+			 input_curl_headerfunction<CurlInputStream>);
+	curl_easy_setopt(easy, CURLOPT_WRITEHEADER, this);
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
+			 input_curl_writefunction<CurlInputStream>);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+
 	request_headers = nullptr;
 	request_headers = curl_slist_append(request_headers,
 					       "Icy-Metadata: 1");
@@ -805,13 +1057,17 @@ inline InputStream *
 CurlInputStream::Open(const char *url, Mutex &mutex, Cond &cond,
 		      Error &error)
 {
-	void *buffer = HugeAllocate(CURL_MAX_BUFFERED);
+	const size_t size =
+		memory_input_buffer.Clamp(adaptive_buffer_size,
+					  CURL_MIN_BUFFER_SIZE);
+	void *buffer = HugeAllocate(size);
 	if (buffer == nullptr) {
 		error.Set(curl_domain, "Out of memory");
 		return nullptr;
 	}
 
-	CurlInputStream *c = new CurlInputStream(url, mutex, cond, buffer);
+	CurlInputStream *c = new CurlInputStream(url, mutex, cond,
+						 buffer, size);
 
 	if (!c->InitEasy(error) || !input_curl_easy_add_indirect(c, error)) {
 		delete c;
@@ -821,6 +1077,681 @@ CurlInputStream::Open(const char *url, Mutex &mutex, Cond &cond,
 	return c->icy;
 }
 
+class CurlSegmentedInputStream;
+
+/**
+ * A "Range" request fetching one segment of a
+ * #CurlSegmentedInputStream.
+ */
+class CurlSegmentRequest final : public CurlRequest {
+public:
+	CurlSegmentedInputStream &stream;
+
+	/** the index of the segment being fetched */
+	const uint64_t index;
+
+	/* a buffer which was passed to libcurl */
+	char range[48];
+
+	CurlSegmentRequest(CurlSegmentedInputStream &_stream,
+			   uint64_t _index)
+		:stream(_stream), index(_index) {}
+
+	/**
+	 * Runs in the I/O thread.
+	 */
+	~CurlSegmentRequest();
+
+	void HeaderReceived(const char *name, std::string &&value);
+	size_t DataReceived(const void *ptr, size_t size);
+
+	/* virtual methods from CurlRequest */
+	void RequestDone(CURLcode result, long status) override;
+};
+
+/**
+ * A seekable HTTP resource which is fetched in fixed-size segments
+ * with several concurrent "Range" requests.  The segments are kept
+ * in a cache, which makes seeking inside the cached area instant.
+ * If the server does not support "Range", it falls back to a
+ * regular #CurlInputStream.
+ */
+class CurlSegmentedInputStream final
+	: public InputStream, DeferredMonitor {
+
+	struct Segment {
+		uint8_t *data;
+
+		/** the number of bytes requested */
+		size_t length;
+
+		/** the number of bytes received so far */
+		size_t fill;
+
+		/** is a request for this segment still running? */
+		bool fetching;
+	};
+
+	/**
+	 * The cached segments, by index.  Protected by the mutex.
+	 */
+	std::map<uint64_t, Segment> segments;
+
+	/**
+	 * The running requests.  Only accessed in the I/O thread.
+	 */
+	std::list<CurlSegmentRequest *> requests;
+
+	/**
+	 * The stream which is used instead if the server does not
+	 * support "Range".  Protected by the mutex.
+	 */
+	InputStream *fallback;
+
+	/**
+	 * Set by the first request if its response does not allow
+	 * segmented access.
+	 */
+	bool want_fallback;
+
+	Error postponed_error;
+
+public:
+	CurlSegmentedInputStream(const char *_url,
+				 Mutex &_mutex, Cond &_cond)
+		:InputStream(_url, _mutex, _cond),
+		 DeferredMonitor(io_thread_get()),
+		 fallback(nullptr), want_fallback(false) {}
+
+	~CurlSegmentedInputStream();
+
+	static InputStream *Open(const char *url, Mutex &mutex, Cond &cond,
+				 Error &error);
+
+	void HeaderReceived(const char *name, std::string &&value);
+	size_t DataReceived(CurlSegmentRequest &r,
+			    const void *ptr, size_t size);
+
+	/**
+	 * A segment request is finished.  Frees the request.
+	 *
+	 * Runs in the I/O thread.  The caller must not hold locks.
+	 */
+	void SegmentDone(CurlSegmentRequest &r, CURLcode result, long status);
+
+	/* virtual methods from InputStream */
+	bool Check(Error &error) override;
+	void Update() override;
+	bool IsEOF() override;
+	bool Seek(offset_type new_offset, Error &error) override;
+	Tag *ReadTag() override;
+	bool IsAvailable() override;
+	size_t Read(void *ptr, size_t size, Error &error) override;
+
+private:
+	gcc_pure
+	uint64_t GetSegmentCount() const {
+		return (size + CURL_SEGMENT_SIZE - 1) / CURL_SEGMENT_SIZE;
+	}
+
+	/**
+	 * Copy the attributes of the fallback stream.  Caller must
+	 * lock the mutex.
+	 */
+	void CopyAttributes();
+
+	/**
+	 * Insert an empty segment into the cache.  Caller must lock
+	 * the mutex.
+	 */
+	bool AddSegment(uint64_t index);
+
+	/**
+	 * Free one cached segment to make room for the segment
+	 * "wanted": prefer one behind the read position, then the
+	 * one farthest ahead.  Caller must lock the mutex.
+	 *
+	 * @return false if no segment can be evicted
+	 */
+	bool EvictSegment(uint64_t first, uint64_t wanted);
+
+	/**
+	 * Start a "Range" request for the specified segment.
+	 *
+	 * Runs in the I/O thread.  No lock needed.
+	 */
+	bool StartRequest(uint64_t index, Error &error);
+
+	/**
+	 * Start requests for the missing segments after the read
+	 * position.
+	 *
+	 * Runs in the I/O thread.  The caller must not hold locks.
+	 */
+	void FillRequests();
+
+	/**
+	 * Discard all segments and open a regular #CurlInputStream.
+	 *
+	 * Runs in the I/O thread.  The caller must not hold locks.
+	 */
+	void OpenFallback();
+
+	/* virtual methods from DeferredMonitor */
+	void RunDeferred() override;
+};
+
+CurlSegmentRequest::~CurlSegmentRequest()
+{
+	assert(io_thread_inside());
+
+	if (easy != nullptr) {
+		curl_multi->Remove(this);
+		curl_easy_cleanup(easy);
+	}
+}
+
+inline void
+CurlSegmentRequest::HeaderReceived(const char *name, std::string &&value)
+{
+	stream.HeaderReceived(name, std::move(value));
+}
+
+inline size_t
+CurlSegmentRequest::DataReceived(const void *ptr, size_t size)
+{
+	return stream.DataReceived(*this, ptr, size);
+}
+
+void
+CurlSegmentRequest::RequestDone(CURLcode result, long status)
+{
+	stream.SegmentDone(*this, result, status);
+}
+
+CurlSegmentedInputStream::~CurlSegmentedInputStream()
+{
+	BlockingCall(io_thread_get(), [this](){
+			DeferredMonitor::Cancel();
+
+			for (auto r : requests)
+				delete r;
+			requests.clear();
+
+			curl_multi->InvalidateSockets();
+		});
+
+	delete fallback;
+
+	for (auto &i : segments)
+		free(i.second.data);
+}
+
+inline void
+CurlSegmentedInputStream::HeaderReceived(const char *name,
+					 std::string &&value)
+{
+	const ScopeLock protect(mutex);
+
+	if (IsReady())
+		/* only the first response describes the resource */
+		return;
+
+	if (StringEqualsCaseASCII(name, "content-range")) {
+		/* "bytes FIRST-LAST/TOTAL"; the total may be "*" */
+		const char *slash = strchr(value.c_str(), '/');
+		if (slash != nullptr && IsDigitASCII(slash[1]))
+			size = ParseUint64(slash + 1);
+	} else if (StringEqualsCaseASCII(name, "content-type")) {
+		SetMimeType(std::move(value));
+	}
+}
+
+inline size_t
+CurlSegmentedInputStream::DataReceived(CurlSegmentRequest &r,
+				       const void *ptr, size_t received_size)
+{
+	assert(received_size > 0);
+
+	const ScopeLock protect(mutex);
+
+	if (!IsReady()) {
+		long status = 0;
+		curl_easy_getinfo(r.easy, CURLINFO_RESPONSE_CODE, &status);
+		if (status != 206 || size <= 0) {
+			/* abort this request and retry without
+			   "Range" */
+			want_fallback = true;
+			return 0;
+		}
+
+		FormatDebug(curl_domain, "segmented download of %s",
+			    GetURI());
+
+		auto &first = segments.begin()->second;
+		if (uint64_t(size) < first.length)
+			first.length = size;
+
+		seekable = true;
+		SetReady();
+
+		/* start the other requests as soon as possible */
+		DeferredMonitor::Schedule();
+	}
+
+	auto i = segments.find(r.index);
+	assert(i != segments.end());
+
+	Segment &s = i->second;
+	assert(s.fetching);
+
+	/* ignore excess data, in case the server sends more than was
+	   requested */
+	const size_t nbytes = std::min(received_size, s.length - s.fill);
+	memcpy(s.data + s.fill, ptr, nbytes);
+	s.fill += nbytes;
+
+	cond.broadcast();
+	return received_size;
+}
+
+void
+CurlSegmentedInputStream::SegmentDone(CurlSegmentRequest &r,
+				      CURLcode result, long status)
+{
+	assert(io_thread_inside());
+
+	requests.remove(&r);
+
+	bool open_fallback = false;
+
+	{
+		const ScopeLock protect(mutex);
+
+		auto i = segments.find(r.index);
+		assert(i != segments.end());
+		Segment &s = i->second;
+		s.fetching = false;
+
+		if (!IsReady()) {
+			if (!want_fallback && result != CURLE_OK &&
+			    status == 0)
+				/* a network error; no point in retrying */
+				postponed_error.Format(curl_domain, result,
+						       "curl failed: %s",
+						       r.error_buffer);
+			else
+				/* an empty response, an HTTP error or no
+				   support for "Range" */
+				open_fallback = true;
+		} else if (postponed_error.IsDefined()) {
+			/* keep the first error */
+		} else if (result != CURLE_OK) {
+			postponed_error.Format(curl_domain, result,
+					       "curl failed: %s",
+					       r.error_buffer);
+		} else if (status != 206) {
+			postponed_error.Format(http_domain, status,
+					       "got HTTP status %ld",
+					       status);
+		} else if (s.fill < s.length) {
+			postponed_error.Set(curl_domain,
+					    "Premature end of segment");
+		}
+
+		cond.broadcast();
+	}
+
+	delete &r;
+
+	if (open_fallback)
+		OpenFallback();
+	else
+		FillRequests();
+}
+
+void
+CurlSegmentedInputStream::OpenFallback()
+{
+	assert(io_thread_inside());
+
+	FormatDebug(curl_domain, "no range support for %s", GetURI());
+
+	Error error;
+	InputStream *is = CurlInputStream::Open(GetURI(), mutex, cond, error);
+
+	const ScopeLock protect(mutex);
+
+	for (auto &i : segments)
+		free(i.second.data);
+	segments.clear();
+
+	if (is != nullptr) {
+		fallback = is;
+		CopyAttributes();
+	} else
+		postponed_error = std::move(error);
+
+	cond.broadcast();
+}
+
+void
+CurlSegmentedInputStream::CopyAttributes()
+{
+	assert(fallback != nullptr);
+
+	if (fallback->IsReady()) {
+		if (!IsReady()) {
+			if (fallback->HasMimeType())
+				SetMimeType(fallback->GetMimeType());
+
+			size = fallback->GetSize();
+			seekable = fallback->IsSeekable();
+			SetReady();
+		}
+
+		offset = fallback->GetOffset();
+	}
+}
+
+bool
+CurlSegmentedInputStream::AddSegment(uint64_t index)
+{
+	uint8_t *data = (uint8_t *)malloc(CURL_SEGMENT_SIZE);
+	if (data == nullptr)
+		return false;
+
+	Segment s;
+	s.data = data;
+	s.length = CURL_SEGMENT_SIZE;
+	if (IsReady() && index == GetSegmentCount() - 1)
+		s.length = size - index * CURL_SEGMENT_SIZE;
+	s.fill = 0;
+	s.fetching = true;
+
+	segments.emplace(index, s);
+	return true;
+}
+
+bool
+CurlSegmentedInputStream::EvictSegment(uint64_t first, uint64_t wanted)
+{
+	/* the oldest segment behind the read position */
+	for (auto i = segments.begin();
+	     i != segments.end() && i->first < first; ++i) {
+		if (!i->second.fetching) {
+			free(i->second.data);
+			segments.erase(i);
+			return true;
+		}
+	}
+
+	/* the segment farthest ahead, but only if it is farther away
+	   than the wanted one */
+	for (auto i = segments.rbegin();
+	     i != segments.rend() && i->first > wanted; ++i) {
+		if (!i->second.fetching) {
+			free(i->second.data);
+			segments.erase(std::next(i).base());
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool
+CurlSegmentedInputStream::StartRequest(uint64_t index, Error &error)
+{
+	assert(io_thread_inside());
+
+	CurlSegmentRequest *r = new CurlSegmentRequest(*this, index);
+	if (!r->InitEasy(GetURI(), error)) {
+		delete r;
+		return false;
+	}
+
+	/* the first request is sent before the size is known */
+	const uint64_t start = index * CURL_SEGMENT_SIZE;
+	uint64_t end = start + CURL_SEGMENT_SIZE;
+	if (IsReady() && end > uint64_t(size))
+		end = size;
+
+	snprintf(r->range, sizeof(r->range), "%llu-%llu",
+		 (unsigned long long)start, (unsigned long long)(end - 1));
+	curl_easy_setopt(r->easy, CURLOPT_RANGE, r->range);
+
+	curl_easy_setopt(r->easy, CURLOPT_HEADERFUNCTION,
+			 input_curl_headerfunction<CurlSegmentRequest>);
+	curl_easy_setopt(r->easy, CURLOPT_WRITEHEADER, r);
+	curl_easy_setopt(r->easy, CURLOPT_WRITEFUNCTION,
+			 input_curl_writefunction<CurlSegmentRequest>);
+	curl_easy_setopt(r->easy, CURLOPT_WRITEDATA, r);
+
+	/* register it first, because CurlMulti::Add() may finish
+	   the request already */
+	requests.push_back(r);
+
+	if (!curl_multi->Add(r, error)) {
+		requests.remove(r);
+		delete r;
+		return false;
+	}
+
+	return true;
+}
+
+void
+CurlSegmentedInputStream::FillRequests()
+{
+	assert(io_thread_inside());
+
+	std::list<uint64_t> start;
+
+	{
+		const ScopeLock protect(mutex);
+
+		if (fallback != nullptr || postponed_error.IsDefined() ||
+		    !IsReady())
+			return;
+
+		const uint64_t first = offset / CURL_SEGMENT_SIZE;
+		const uint64_t end = std::min(GetSegmentCount(),
+					      first + segment_cache_count);
+
+		size_t n_requests = requests.size();
+		for (uint64_t i = first;
+		     i < end && n_requests < segment_connections; ++i) {
+			if (segments.find(i) != segments.end())
+				continue;
+
+			if (segments.size() >= segment_cache_count &&
+			    !EvictSegment(first, i))
+				break;
+
+			if (!AddSegment(i))
+				break;
+
+			start.push_back(i);
+			++n_requests;
+		}
+	}
+
+	for (auto i : start) {
+		Error error;
+		if (!StartRequest(i, error)) {
+			const ScopeLock protect(mutex);
+
+			auto s = segments.find(i);
+			free(s->second.data);
+			segments.erase(s);
+
+			if (!postponed_error.IsDefined())
+				postponed_error = std::move(error);
+			cond.broadcast();
+		}
+	}
+}
+
+void
+CurlSegmentedInputStream::RunDeferred()
+{
+	FillRequests();
+}
+
+bool
+CurlSegmentedInputStream::Check(Error &error)
+{
+	if (fallback != nullptr)
+		return fallback->Check(error);
+
+	bool success = !postponed_error.IsDefined();
+	if (!success) {
+		error = std::move(postponed_error);
+		postponed_error.Clear();
+	}
+
+	return success;
+}
+
+void
+CurlSegmentedInputStream::Update()
+{
+	if (fallback != nullptr) {
+		fallback->Update();
+		CopyAttributes();
+	}
+}
+
+bool
+CurlSegmentedInputStream::IsEOF()
+{
+	if (fallback != nullptr)
+		return fallback->IsEOF();
+
+	return IsReady() && offset >= size;
+}
+
+bool
+CurlSegmentedInputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (fallback != nullptr) {
+		bool success = fallback->Seek(new_offset, error);
+		CopyAttributes();
+		return success;
+	}
+
+	assert(IsReady());
+
+	if (new_offset < 0 || new_offset > size) {
+		error.Set(curl_domain, "Invalid seek offset");
+		return false;
+	}
+
+	/* the data is fetched lazily by Read() */
+	offset = new_offset;
+	DeferredMonitor::Schedule();
+	return true;
+}
+
+Tag *
+CurlSegmentedInputStream::ReadTag()
+{
+	return fallback != nullptr
+		? fallback->ReadTag()
+		: nullptr;
+}
+
+bool
+CurlSegmentedInputStream::IsAvailable()
+{
+	if (fallback != nullptr)
+		return fallback->IsAvailable();
+
+	if (postponed_error.IsDefined() || IsEOF())
+		return true;
+
+	if (!IsReady())
+		return false;
+
+	auto i = segments.find(offset / CURL_SEGMENT_SIZE);
+	return i != segments.end() &&
+		i->second.fill > size_t(offset % CURL_SEGMENT_SIZE);
+}
+
+size_t
+CurlSegmentedInputStream::Read(void *ptr, size_t read_size, Error &error)
+{
+	while (true) {
+		if (fallback != nullptr) {
+			size_t nbytes = fallback->Read(ptr, read_size, error);
+			CopyAttributes();
+			return nbytes;
+		}
+
+		if (!Check(error) || IsEOF())
+			return 0;
+
+		if (IsReady()) {
+			const uint64_t index = offset / CURL_SEGMENT_SIZE;
+			const size_t position = offset % CURL_SEGMENT_SIZE;
+
+			auto i = segments.find(index);
+			if (i != segments.end() &&
+			    i->second.fill > position) {
+				const Segment &s = i->second;
+				const size_t nbytes =
+					std::min(read_size,
+						 s.fill - position);
+				memcpy(ptr, s.data + position, nbytes);
+				offset += nbytes;
+
+				if (position + nbytes == s.length)
+					/* entering the next segment:
+					   move the window */
+					DeferredMonitor::Schedule();
+
+				return nbytes;
+			}
+
+			if (i == segments.end())
+				/* not requested yet, e.g. after a
+				   seek */
+				DeferredMonitor::Schedule();
+		}
+
+		cond.wait(mutex);
+	}
+}
+
+inline InputStream *
+CurlSegmentedInputStream::Open(const char *url, Mutex &mutex, Cond &cond,
+			       Error &error)
+{
+	CurlSegmentedInputStream *s =
+		new CurlSegmentedInputStream(url, mutex, cond);
+
+	/* fetch the first segment; its response tells whether the
+	   server supports "Range", and the size of the resource */
+	if (!s->AddSegment(0)) {
+		delete s;
+		error.Set(curl_domain, "Out of memory");
+		return nullptr;
+	}
+
+	bool success;
+	BlockingCall(io_thread_get(), [s, &error, &success](){
+			success = s->StartRequest(0, error);
+		});
+
+	if (!success) {
+		delete s;
+		return nullptr;
+	}
+
+	return s;
+}
+
 static InputStream *
 input_curl_open(const char *url, Mutex &mutex, Cond &cond,
 		Error &error)
@@ -829,6 +1760,9 @@ input_curl_open(const char *url, Mutex &mutex, Cond &cond,
 	    memcmp(url, "https://", 8) != 0)
 		return nullptr;
 
+	if (segment_connections > 1)
+		return CurlSegmentedInputStream::Open(url, mutex, cond, error);
+
 	return CurlInputStream::Open(url, mutex, cond, error);
 }
 
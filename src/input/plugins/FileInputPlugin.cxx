@@ -21,34 +21,192 @@
 #include "FileInputPlugin.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/ConfigData.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "util/ConstBuffer.hxx"
+#include "thread/Mutex.hxx"
 #include "fs/Traits.hxx"
 #include "system/fd_util.h"
 #include "open.h"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <atomic>
 
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <signal.h>
+#endif
 
 static constexpr Domain file_domain("file");
 
+/**
+ * Ask the kernel to read this much data ahead of the current
+ * position, so the decoder thread does not block on the disk.
+ */
+static constexpr off_t FILE_PREFETCH_WINDOW = 1024 * 1024;
+
+/**
+ * Map files into memory instead of reading them?  Configured with
+ * the "mmap" setting.
+ */
+static bool file_mmap;
+
+#ifndef WIN32
+
+/**
+ * A file mapping which is watched by the SIGBUS handler.  If
+ * another program truncates the file, accessing the pages beyond
+ * the new end raises SIGBUS; the handler then replaces the page
+ * with zeroes and sets the #truncated flag, which makes the next
+ * read fail.
+ */
+struct FileMapping {
+	std::atomic<const uint8_t *> begin;
+	std::atomic<size_t> size;
+	std::atomic_bool truncated;
+};
+
+/**
+ * The maximum number of files which may be mapped at a time; more
+ * files are read with pread().
+ */
+static constexpr unsigned MAX_FILE_MAPPINGS = 16;
+
+static FileMapping file_mappings[MAX_FILE_MAPPINGS];
+
+/**
+ * Determined by InstallSigbusHandler(), because sysconf() must not
+ * be called from a signal handler.
+ */
+static uintptr_t file_page_size;
+
+static FileMapping *
+FindFileMapping(const void *p)
+{
+	for (auto &i : file_mappings) {
+		const uint8_t *begin = i.begin.load(std::memory_order_acquire);
+		if (begin != nullptr && p >= begin &&
+		    p < begin + i.size.load(std::memory_order_relaxed))
+			return &i;
+	}
+
+	return nullptr;
+}
+
+static void
+file_sigbus_handler(gcc_unused int signum, siginfo_t *info,
+		    gcc_unused void *context)
+{
+	FileMapping *m = FindFileMapping(info->si_addr);
+	if (m == nullptr) {
+		/* not ours: restore the default action, which gets
+		   triggered again when this handler returns */
+		signal(SIGBUS, SIG_DFL);
+		return;
+	}
+
+	void *page = (void *)(uintptr_t(info->si_addr) &
+			      ~(file_page_size - 1));
+	if (mmap(page, file_page_size, PROT_READ,
+		 MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0) == MAP_FAILED) {
+		signal(SIGBUS, SIG_DFL);
+		return;
+	}
+
+	m->truncated.store(true, std::memory_order_relaxed);
+}
+
+static bool
+InstallSigbusHandler()
+{
+	file_page_size = sysconf(_SC_PAGESIZE);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = file_sigbus_handler;
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	return sigaction(SIGBUS, &sa, nullptr) == 0;
+}
+
+static FileMapping *
+AddFileMapping(const uint8_t *begin, size_t size)
+{
+	static Mutex mutex;
+	const ScopeLock protect(mutex);
+
+	for (auto &i : file_mappings) {
+		if (i.begin.load(std::memory_order_relaxed) == nullptr) {
+			i.size.store(size, std::memory_order_relaxed);
+			i.truncated.store(false, std::memory_order_relaxed);
+			i.begin.store(begin, std::memory_order_release);
+			return &i;
+		}
+	}
+
+	return nullptr;
+}
+
+#endif
+
 struct FileInputStream final : public InputStream {
 	int fd;
 
+	/**
+	 * The whole file mapped into memory, or nullptr if it is
+	 * read with pread().
+	 */
+	const uint8_t *map;
+
+#ifndef WIN32
+	/**
+	 * The #file_mappings slot which is watched by the SIGBUS
+	 * handler; only valid if #map is set.
+	 */
+	FileMapping *mapping;
+#endif
+
+	/**
+	 * The end of the range which has been passed to
+	 * posix_fadvise(POSIX_FADV_WILLNEED) or
+	 * madvise(MADV_WILLNEED).
+	 */
+	offset_type prefetched;
+
 	FileInputStream(const char *path, int _fd, off_t _size,
 			Mutex &_mutex, Cond &_cond)
 		:InputStream(path, _mutex, _cond),
-		 fd(_fd) {
+		 fd(_fd), map(nullptr), prefetched(0) {
 		size = _size;
 		seekable = true;
 		SetReady();
 	}
 
 	~FileInputStream() {
+#ifndef WIN32
+		if (map != nullptr) {
+			mapping->begin.store(nullptr,
+					     std::memory_order_release);
+			munmap(const_cast<uint8_t *>(map), size_t(size));
+		}
+#endif
 		close(fd);
 	}
 
+	/**
+	 * Map the file into memory.  On failure, the file is read
+	 * with pread().
+	 */
+	void Map();
+
 	/* virtual methods from InputStream */
 
 	bool IsEOF() override {
@@ -56,9 +214,62 @@ struct FileInputStream final : public InputStream {
 	}
 
 	size_t Read(void *ptr, size_t size, Error &error) override;
+	ConstBuffer<void> ReadDirect(size_t size, Error &error) override;
 	bool Seek(offset_type offset, Error &error) override;
+
+private:
+	void Prefetch();
+
+	/**
+	 * Has the SIGBUS handler caught an access beyond the end of
+	 * the truncated file?
+	 */
+	bool CheckTruncated(Error &error);
 };
 
+static InputPlugin::InitResult
+input_file_init(const config_param &param, gcc_unused Error &error)
+{
+	file_mmap = param.GetBlockValue("mmap", false);
+
+#ifndef WIN32
+	if (file_mmap && !InstallSigbusHandler()) {
+		LogErrno(file_domain, "Failed to install the SIGBUS handler");
+		file_mmap = false;
+	}
+#endif
+
+	return InputPlugin::InitResult::SUCCESS;
+}
+
+void
+FileInputStream::Map()
+{
+#ifndef WIN32
+	if (size <= 0 || uint64_t(size) != uint64_t(size_t(size)))
+		/* empty, or too large for the address space */
+		return;
+
+	void *p = mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		return;
+
+	mapping = AddFileMapping((const uint8_t *)p, size_t(size));
+	if (mapping == nullptr) {
+		/* too many mapped files; without the SIGBUS handler,
+		   a truncated file would crash MPD */
+		munmap(p, size_t(size));
+		return;
+	}
+
+#ifdef MADV_SEQUENTIAL
+	madvise(p, size_t(size), MADV_SEQUENTIAL);
+#endif
+
+	map = (const uint8_t *)p;
+#endif
+}
+
 static InputStream *
 input_file_open(const char *filename,
 		Mutex &mutex, Cond &cond,
@@ -95,26 +306,107 @@ input_file_open(const char *filename,
 	posix_fadvise(fd, (off_t)0, st.st_size, POSIX_FADV_SEQUENTIAL);
 #endif
 
-	return new FileInputStream(filename, fd, st.st_size, mutex, cond);
+	auto *is = new FileInputStream(filename, fd, st.st_size,
+				       mutex, cond);
+	if (file_mmap)
+		is->Map();
+
+	return is;
+}
+
+inline void
+FileInputStream::Prefetch()
+{
+	/* refill the window when half of it has been consumed */
+	if (prefetched >= offset + FILE_PREFETCH_WINDOW / 2 ||
+	    prefetched >= size)
+		return;
+
+	if (prefetched < offset)
+		prefetched = offset;
+
+#if !defined(WIN32) && defined(MADV_WILLNEED)
+	if (map != nullptr) {
+		/* madvise() wants a page-aligned address */
+		static const offset_type page_mask =
+			sysconf(_SC_PAGESIZE) - 1;
+		const offset_type start = prefetched & ~page_mask;
+		const offset_type end =
+			std::min(prefetched + offset_type(FILE_PREFETCH_WINDOW),
+				 size);
+
+		madvise(const_cast<uint8_t *>(map + start),
+			size_t(end - start), MADV_WILLNEED);
+		prefetched = end;
+		return;
+	}
+#endif
+
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fd, (off_t)prefetched, FILE_PREFETCH_WINDOW,
+		      POSIX_FADV_WILLNEED);
+#endif
+	prefetched += FILE_PREFETCH_WINDOW;
 }
 
 bool
 FileInputStream::Seek(offset_type new_offset, Error &error)
 {
+#ifdef WIN32
 	new_offset = (offset_type)lseek(fd, (off_t)new_offset, SEEK_SET);
 	if (new_offset < 0) {
 		error.SetErrno("Failed to seek");
 		return false;
 	}
+#else
+	/* Read() uses pread(), so there is no file position to
+	   move */
+	if (new_offset < 0) {
+		error.SetErrno(EINVAL, "Failed to seek");
+		return false;
+	}
+
+	/* restart the prefetch window at the new position */
+	if (new_offset < offset || new_offset > prefetched)
+		prefetched = new_offset;
+#endif
 
 	offset = new_offset;
 	return true;
 }
 
+inline bool
+FileInputStream::CheckTruncated(Error &error)
+{
+#ifndef WIN32
+	if (mapping->truncated.load(std::memory_order_relaxed)) {
+		error.Format(file_domain, "File has been truncated: %s",
+			     GetURI());
+		return true;
+	}
+#else
+	(void)error;
+#endif
+
+	return false;
+}
+
 size_t
 FileInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
+	if (map != nullptr) {
+		const auto src = ReadDirect(read_size, error);
+		memcpy(ptr, src.data, src.size);
+		return src.size;
+	}
+
+#ifdef WIN32
 	ssize_t nbytes = read(fd, ptr, read_size);
+#else
+	Prefetch();
+
+	ssize_t nbytes = pread(fd, ptr, read_size, (off_t)offset);
+#endif
 	if (nbytes < 0) {
 		error.SetErrno("Failed to read");
 		return 0;
@@ -124,9 +416,31 @@ FileInputStream::Read(void *ptr, size_t read_size, Error &error)
 	return (size_t)nbytes;
 }
 
+ConstBuffer<void>
+FileInputStream::ReadDirect(size_t read_size, Error &error)
+{
+	if (map == nullptr)
+		return nullptr;
+
+	if (CheckTruncated(error))
+		return { map, 0 };
+
+	Prefetch();
+
+	if (offset >= size)
+		return { map + size, 0 };
+
+	if (offset_type(read_size) > size - offset)
+		read_size = size_t(size - offset);
+
+	const void *p = map + offset;
+	offset += read_size;
+	return { p, read_size };
+}
+
 const InputPlugin input_plugin_file = {
 	"file",
-	nullptr,
+	input_file_init,
 	nullptr,
 	input_file_open,
 };
@@ -38,6 +38,12 @@ public:
 				   MMS_BUFFER_SIZE) {
 	}
 
+	~MmsInputStream() {
+		/* join the thread while Close() can still be
+		   dispatched to this class */
+		Stop();
+	}
+
 protected:
 	virtual bool Open(gcc_unused Error &error) override;
 	virtual size_t ThreadRead(void *ptr, size_t size,
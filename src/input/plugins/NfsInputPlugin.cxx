@@ -24,6 +24,7 @@
 #include "lib/nfs/Domain.hxx"
 #include "lib/nfs/Glue.hxx"
 #include "lib/nfs/FileReader.hxx"
+#include "config/ConfigData.hxx"
 #include "util/HugeAllocator.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
@@ -48,9 +49,29 @@ static const size_t NFS_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t NFS_RESUME_AT = 384 * 1024;
 
+/**
+ * The size of one nfs_pread_async() request.
+ */
+static const size_t NFS_READ_SIZE = 32768;
+
+/**
+ * The maximum number of read requests which may be in flight at the
+ * same time.  Configured with the "readahead" setting.
+ */
+static unsigned nfs_readahead = 4;
+
 class NfsInputStream final : public AsyncInputStream, NfsFileReader {
+	/**
+	 * The offset of the next read request.
+	 */
 	uint64_t next_offset;
 
+	/**
+	 * The end of the data which has been appended to the buffer.
+	 * The range between this and #next_offset is in flight.
+	 */
+	uint64_t received_offset;
+
 public:
 	NfsInputStream(const char *_uri,
 		       Mutex &_mutex, Cond &_cond,
@@ -87,29 +108,37 @@ private:
 bool
 NfsInputStream::DoRead()
 {
-	assert(NfsFileReader::IsIdle());
-
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return true;
-
-	const size_t buffer_space = GetBufferSpace();
-	if (buffer_space == 0) {
-		Pause();
-		return true;
-	}
-
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
-					 buffer_space);
-
-	mutex.unlock();
-	Error error;
-	bool success = NfsFileReader::Read(next_offset, nbytes, error);
-	mutex.lock();
-
-	if (!success) {
-		PostponeError(std::move(error));
-		return false;
+	while (NfsFileReader::GetPendingReads() < nfs_readahead) {
+		int64_t remaining = size - next_offset;
+		if (remaining <= 0)
+			return true;
+
+		/* reserve buffer space for the requests which are
+		   still in flight */
+		const size_t pending = next_offset - received_offset;
+		const size_t buffer_space = GetBufferSpace();
+		if (buffer_space <= pending) {
+			if (pending == 0)
+				Pause();
+			return true;
+		}
+
+		size_t nbytes =
+			std::min<size_t>(std::min<uint64_t>(remaining,
+							    NFS_READ_SIZE),
+					 buffer_space - pending);
+
+		mutex.unlock();
+		Error error;
+		bool success = NfsFileReader::Read(next_offset, nbytes, error);
+		mutex.lock();
+
+		if (!success) {
+			PostponeError(std::move(error));
+			return false;
+		}
+
+		next_offset += nbytes;
 	}
 
 	return true;
@@ -130,7 +159,7 @@ NfsInputStream::DoSeek(offset_type new_offset)
 	NfsFileReader::CancelRead();
 	mutex.lock();
 
-	next_offset = offset = new_offset;
+	next_offset = received_offset = offset = new_offset;
 	SeekDone();
 	DoRead();
 }
@@ -142,7 +171,7 @@ NfsInputStream::OnNfsFileOpen(uint64_t _size)
 
 	size = _size;
 	seekable = true;
-	next_offset = 0;
+	next_offset = received_offset = 0;
 	SetReady();
 	DoRead();
 }
@@ -155,7 +184,12 @@ NfsInputStream::OnNfsFileRead(const void *data, size_t data_size)
 	assert(IsBufferFull() == (GetBufferSpace() == 0));
 	AppendToBuffer(data, data_size);
 
-	next_offset += data_size;
+	received_offset += data_size;
+	if (NfsFileReader::GetPendingReads() == 0)
+		/* after a short read, the NfsFileReader discards
+		   all following requests; continue at the real end of
+		   the data */
+		next_offset = received_offset;
 
 	DoRead();
 }
@@ -178,8 +212,15 @@ NfsInputStream::OnNfsFileError(Error &&error)
  */
 
 static InputPlugin::InitResult
-input_nfs_init(const config_param &, Error &)
+input_nfs_init(const config_param &param, Error &error)
 {
+	nfs_readahead = param.GetBlockValue("readahead", nfs_readahead);
+	if (nfs_readahead < 1 ||
+	    nfs_readahead * NFS_READ_SIZE > NFS_MAX_BUFFERED / 2) {
+		error.Set(nfs_domain, "Invalid \"readahead\"");
+		return InputPlugin::InitResult::ERROR;
+	}
+
 	nfs_init();
 	return InputPlugin::InitResult::SUCCESS;
 }
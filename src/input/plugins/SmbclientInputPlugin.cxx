@@ -20,44 +20,65 @@
 #include "config.h"
 #include "SmbclientInputPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Mutex.hxx"
-#include "../InputStream.hxx"
+#include "lib/smbclient/Context.hxx"
+#include "lib/smbclient/Pool.hxx"
+#include "../ThreadInputStream.hxx"
 #include "../InputPlugin.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Error.hxx"
 
-#include <libsmbclient.h>
+#include <fcntl.h>
 
-class SmbclientInputStream final : public InputStream {
-	SMBCCTX *ctx;
-	int fd;
+/**
+ * Idle libsmbclient contexts which are kept for the next stream.
+ * This allows several streams to be read in parallel, while keeping
+ * connections to the server open between songs.
+ */
+static SmbclientContextPool *smbclient_pool;
+
+/**
+ * Keep up to this number of idle contexts in #smbclient_pool.
+ */
+static constexpr unsigned SMBCLIENT_MAX_IDLE = 4;
+
+/**
+ * The size of the read-ahead buffer filled by the stream's thread.
+ */
+static constexpr size_t SMBCLIENT_BUFFER_SIZE = 512 * 1024;
+
+/**
+ * libsmbclient has only blocking calls; a ThreadInputStream reads
+ * ahead in a separate thread, so a slow server does not block the
+ * decoder.
+ */
+class SmbclientInputStream final : public ThreadInputStream {
+	SmbclientContext *const ctx;
+	SMBCFILE *const handle;
 
 public:
 	SmbclientInputStream(const char *_uri,
 			     Mutex &_mutex, Cond &_cond,
-			     SMBCCTX *_ctx, int _fd, const struct stat &st)
-		:InputStream(_uri, _mutex, _cond),
-		 ctx(_ctx), fd(_fd) {
+			     SmbclientContext *_ctx, SMBCFILE *_handle,
+			     const struct stat &st)
+		:ThreadInputStream(input_plugin_smbclient.name,
+				   _uri, _mutex, _cond,
+				   SMBCLIENT_BUFFER_SIZE),
+		 ctx(_ctx), handle(_handle) {
 		seekable = true;
 		size = st.st_size;
-		SetReady();
 	}
 
 	~SmbclientInputStream() {
-		smbclient_mutex.lock();
-		smbc_close(fd);
-		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
-	}
+		Stop();
 
-	/* virtual methods from InputStream */
-
-	bool IsEOF() override {
-		return offset >= size;
+		ctx->Close(handle);
+		smbclient_pool->Put(ctx);
 	}
 
-	size_t Read(void *ptr, size_t size, Error &error) override;
-	bool Seek(offset_type offset, Error &error) override;
+protected:
+	/* virtual methods from ThreadInputStream */
+	size_t ThreadRead(void *ptr, size_t size, Error &error) override;
+	bool ThreadSeek(offset_type offset, Error &error) override;
 };
 
 /*
@@ -71,13 +92,18 @@ input_smbclient_init(gcc_unused const config_param &param, Error &error)
 	if (!SmbclientInit(error))
 		return InputPlugin::InitResult::UNAVAILABLE;
 
-	// TODO: create one global SMBCCTX here?
-
 	// TODO: evaluate config_param, call smbc_setOption*()
 
+	smbclient_pool = new SmbclientContextPool(SMBCLIENT_MAX_IDLE);
 	return InputPlugin::InitResult::SUCCESS;
 }
 
+static void
+input_smbclient_finish()
+{
+	delete smbclient_pool;
+}
+
 static InputStream *
 input_smbclient_open(const char *uri,
 		     Mutex &mutex, Cond &cond,
@@ -86,47 +112,37 @@ input_smbclient_open(const char *uri,
 	if (!StringStartsWith(uri, "smb://"))
 		return nullptr;
 
-	const ScopeLock protect(smbclient_mutex);
-
-	SMBCCTX *ctx = smbc_new_context();
-	if (ctx == nullptr) {
-		error.SetErrno("smbc_new_context() failed");
-		return nullptr;
-	}
-
-	SMBCCTX *ctx2 = smbc_init_context(ctx);
-	if (ctx2 == nullptr) {
-		error.SetErrno("smbc_init_context() failed");
-		smbc_free_context(ctx, 1);
+	SmbclientContext *ctx = smbclient_pool->Get(error);
+	if (ctx == nullptr)
 		return nullptr;
-	}
 
-	ctx = ctx2;
-
-	int fd = smbc_open(uri, O_RDONLY, 0);
-	if (fd < 0) {
+	SMBCFILE *handle = ctx->Open(uri, O_RDONLY);
+	if (handle == nullptr) {
 		error.SetErrno("smbc_open() failed");
-		smbc_free_context(ctx, 1);
+		smbclient_pool->Put(ctx);
 		return nullptr;
 	}
 
 	struct stat st;
-	if (smbc_fstat(fd, &st) < 0) {
+	if (ctx->Stat(handle, st) < 0) {
 		error.SetErrno("smbc_fstat() failed");
-		smbc_close(fd);
-		smbc_free_context(ctx, 1);
+		ctx->Close(handle);
+		smbclient_pool->Put(ctx);
 		return nullptr;
 	}
 
-	return new SmbclientInputStream(uri, mutex, cond, ctx, fd, st);
+	auto is = new SmbclientInputStream(uri, mutex, cond, ctx, handle, st);
+	InputStream *result = is->Start(error);
+	if (result == nullptr)
+		delete is;
+
+	return result;
 }
 
 size_t
-SmbclientInputStream::Read(void *ptr, size_t read_size, Error &error)
+SmbclientInputStream::ThreadRead(void *ptr, size_t read_size, Error &error)
 {
-	smbclient_mutex.lock();
-	ssize_t nbytes = smbc_read(fd, ptr, read_size);
-	smbclient_mutex.unlock();
+	ssize_t nbytes = ctx->Read(handle, ptr, read_size);
 	if (nbytes < 0) {
 		error.SetErrno("smbc_read() failed");
 		nbytes = 0;
@@ -136,23 +152,20 @@ SmbclientInputStream::Read(void *ptr, size_t read_size, Error &error)
 }
 
 bool
-SmbclientInputStream::Seek(offset_type new_offset, Error &error)
+SmbclientInputStream::ThreadSeek(offset_type new_offset, Error &error)
 {
-	smbclient_mutex.lock();
-	off_t result = smbc_lseek(fd, new_offset, SEEK_SET);
-	smbclient_mutex.unlock();
+	off_t result = ctx->Seek(handle, new_offset, SEEK_SET);
 	if (result < 0) {
 		error.SetErrno("smbc_lseek() failed");
 		return false;
 	}
 
-	offset = result;
 	return true;
 }
 
 const InputPlugin input_plugin_smbclient = {
 	"smbclient",
 	input_smbclient_init,
-	nullptr,
+	input_smbclient_finish,
 	input_smbclient_open,
 };
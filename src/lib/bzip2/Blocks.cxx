@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Blocks.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <bzlib.h>
+
+#ifdef HAVE_OLDER_BZIP2
+#define BZ2_bzDecompressInit bzDecompressInit
+#define BZ2_bzDecompress bzDecompress
+#define BZ2_bzDecompressEnd bzDecompressEnd
+#endif
+
+#include <memory>
+
+#include <unistd.h>
+#include <string.h>
+
+static constexpr Domain bzip2_domain("bzip2");
+
+static constexpr uint64_t BLOCK_MAGIC = 0x314159265359ULL;
+static constexpr uint64_t EOS_MAGIC = 0x177245385090ULL;
+static constexpr uint64_t MAGIC_MASK = 0xffffffffffffULL;
+static constexpr unsigned MAGIC_BITS = 48;
+
+bool
+Bzip2ScanBlocks(int fd, std::vector<Bzip2BlockRange> &blocks, Error &error)
+{
+	char header[4];
+	if (pread(fd, header, sizeof(header), 0) != ssize_t(sizeof(header)) ||
+	    memcmp(header, "BZh", 3) != 0 ||
+	    header[3] < '1' || header[3] > '9') {
+		error.Set(bzip2_domain, "Not a bzip2 file");
+		return false;
+	}
+
+	blocks.clear();
+
+	uint8_t buffer[65536];
+	uint64_t window = 0, bit = 0;
+	off_t offset = 0;
+
+	while (true) {
+		ssize_t nbytes = pread(fd, buffer, sizeof(buffer), offset);
+		if (nbytes < 0) {
+			error.SetErrno("Failed to read bzip2 file");
+			return false;
+		}
+
+		if (nbytes == 0)
+			break;
+
+		offset += nbytes;
+
+		for (ssize_t i = 0; i < nbytes; ++i) {
+			const unsigned byte = buffer[i];
+			for (int shift = 7; shift >= 0; --shift) {
+				window = (window << 1) | ((byte >> shift) & 1);
+				++bit;
+
+				const uint64_t w = window & MAGIC_MASK;
+				if (w != BLOCK_MAGIC && w != EOS_MAGIC)
+					continue;
+
+				const uint64_t start = bit - MAGIC_BITS;
+
+				if (!blocks.empty() &&
+				    blocks.back().bit_end == 0)
+					blocks.back().bit_end = start;
+
+				if (w == BLOCK_MAGIC)
+					blocks.push_back({start, 0});
+			}
+		}
+	}
+
+	if (!blocks.empty() && blocks.back().bit_end == 0) {
+		error.Set(bzip2_domain, "Truncated bzip2 file");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Appends bits to a byte buffer, most significant bit first.
+ */
+class BitWriter {
+	std::vector<char> &buffer;
+	unsigned current, n_bits;
+
+public:
+	explicit BitWriter(std::vector<char> &_buffer)
+		:buffer(_buffer), current(0), n_bits(0) {}
+
+	void Write(unsigned value, unsigned bits) {
+		while (bits-- > 0) {
+			current = (current << 1) | ((value >> bits) & 1);
+			if (++n_bits == 8) {
+				buffer.push_back(char(current));
+				current = n_bits = 0;
+			}
+		}
+	}
+
+	void Flush() {
+		if (n_bits > 0)
+			buffer.push_back(char(current << (8 - n_bits)));
+		current = n_bits = 0;
+	}
+};
+
+static unsigned
+GetBit(const uint8_t *p, uint64_t bit)
+{
+	return (p[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+bool
+Bzip2DecompressBlock(int fd, const Bzip2BlockRange &block,
+		     std::vector<char> &dest, Error &error)
+{
+	/* read the bytes which contain the block */
+	const uint64_t first_byte = block.bit_start / 8;
+	const size_t n_bytes = (block.bit_end + 7) / 8 - first_byte;
+	std::unique_ptr<uint8_t[]> src(new uint8_t[n_bytes]);
+	if (pread(fd, src.get(), n_bytes, first_byte) != ssize_t(n_bytes)) {
+		error.SetErrno("Failed to read bzip2 file");
+		return false;
+	}
+
+	const uint64_t skip = block.bit_start % 8;
+	const uint64_t n_bits = block.bit_end - block.bit_start;
+	if (n_bits < MAGIC_BITS + 32) {
+		error.Set(bzip2_domain, "Malformed bzip2 block");
+		return false;
+	}
+
+	/* build a stream with just this block; the maximum block size
+	   is declared, because the original one may be smaller but
+	   never larger */
+	std::vector<char> stream;
+	stream.reserve(n_bytes + 16);
+	stream.insert(stream.end(), {'B', 'Z', 'h', '9'});
+
+	BitWriter w(stream);
+	uint32_t crc = 0;
+	for (uint64_t i = 0; i < n_bits; ++i) {
+		const unsigned b = GetBit(src.get(), skip + i);
+		w.Write(b, 1);
+
+		/* the block CRC follows the start marker */
+		if (i >= MAGIC_BITS && i < MAGIC_BITS + 32)
+			crc = (crc << 1) | b;
+	}
+
+	/* with only one block, the combined CRC equals the block
+	   CRC */
+	w.Write(unsigned(EOS_MAGIC >> 24), 24);
+	w.Write(unsigned(EOS_MAGIC & 0xffffff), 24);
+	w.Write(crc, 32);
+	w.Flush();
+
+	bz_stream bz;
+	memset(&bz, 0, sizeof(bz));
+	int ret = BZ2_bzDecompressInit(&bz, 0, 0);
+	if (ret != BZ_OK) {
+		error.Set(bzip2_domain, ret,
+			  "BZ2_bzDecompressInit() has failed");
+		return false;
+	}
+
+	bz.next_in = stream.data();
+	bz.avail_in = stream.size();
+
+	dest.clear();
+	size_t used = 0;
+
+	do {
+		if (used == dest.size())
+			dest.resize(dest.size() + 1024 * 1024);
+
+		bz.next_out = dest.data() + used;
+		bz.avail_out = dest.size() - used;
+
+		ret = BZ2_bzDecompress(&bz);
+		used = dest.size() - bz.avail_out;
+
+		if (ret != BZ_OK && ret != BZ_STREAM_END) {
+			BZ2_bzDecompressEnd(&bz);
+			error.Set(bzip2_domain, ret,
+				  "BZ2_bzDecompress() has failed");
+			return false;
+		}
+
+		if (ret == BZ_OK && bz.avail_in == 0 && bz.avail_out > 0) {
+			BZ2_bzDecompressEnd(&bz);
+			error.Set(bzip2_domain, "Truncated bzip2 block");
+			return false;
+		}
+	} while (ret != BZ_STREAM_END);
+
+	BZ2_bzDecompressEnd(&bz);
+
+	dest.resize(used);
+	return true;
+}
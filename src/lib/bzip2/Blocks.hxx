@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_BZIP2_BLOCKS_HXX
+#define MPD_BZIP2_BLOCKS_HXX
+
+#include "check.h"
+
+#include <vector>
+
+#include <stdint.h>
+
+class Error;
+
+/**
+ * The location of one compressed block inside a bzip2 file, in
+ * bits.  Blocks are not byte-aligned.
+ */
+struct Bzip2BlockRange {
+	/**
+	 * The position of the block's 48 bit start marker.
+	 */
+	uint64_t bit_start;
+
+	/**
+	 * The position of the following block or end-of-stream
+	 * marker.
+	 */
+	uint64_t bit_end;
+};
+
+/**
+ * Scan a bzip2 file for block boundaries by searching for the block
+ * start markers.  Concatenated streams (e.g. from pbzip2) are
+ * supported.
+ *
+ * @return false on I/O error or if the file is not a bzip2 file
+ */
+bool
+Bzip2ScanBlocks(int fd, std::vector<Bzip2BlockRange> &blocks, Error &error);
+
+/**
+ * Decompress a single block independently of the others.  The block
+ * is copied into a new single-block stream, which is then passed to
+ * libbz2.  This function is thread-safe.
+ *
+ * @param dest the decompressed data is stored here
+ */
+bool
+Bzip2DecompressBlock(int fd, const Bzip2BlockRange &block,
+		     std::vector<char> &dest, Error &error);
+
+#endif
@@ -196,3 +196,43 @@ IcuCaseFold(const char *src)
 	return result;
 }
 
+std::string
+IcuCollateKey(const char *src)
+{
+	assert(src != nullptr);
+
+#ifdef HAVE_ICU
+	assert(collator != nullptr);
+
+	const auto u = UCharFromUTF8(src);
+	if (u.IsNull())
+		return std::string(src);
+
+	/* the returned length includes the null terminator, which
+	   is the only null byte in a sort key */
+	std::string result(64, '\0');
+	int32_t length = ucol_getSortKey(collator, u.data, u.size,
+					 (uint8_t *)&result[0],
+					 result.size());
+	if (size_t(length) > result.size()) {
+		result.resize(length);
+		length = ucol_getSortKey(collator, u.data, u.size,
+					 (uint8_t *)&result[0],
+					 result.size());
+	}
+
+	delete[] u.data;
+
+	result.resize(length > 0 ? length - 1 : 0);
+	return result;
+#elif defined(HAVE_GLIB)
+	char *tmp = g_utf8_collate_key(src, -1);
+	std::string result(tmp);
+	g_free(tmp);
+	return result;
+#else
+	std::string result(src);
+	std::transform(result.begin(), result.end(), result.begin(), tolower);
+	return result;
+#endif
+}
@@ -57,7 +57,9 @@ NfsFileReader::Close()
 
 	connection->RemoveLease(*this);
 
-	if (state > State::MOUNT && state != State::IDLE)
+	if (state == State::READ)
+		CancelRead();
+	else if (state > State::MOUNT && state != State::IDLE)
 		connection->Cancel(*this);
 
 	if (state > State::OPEN)
@@ -110,10 +112,13 @@ NfsFileReader::Open(const char *uri, Error &error)
 bool
 NfsFileReader::Read(uint64_t offset, size_t size, Error &error)
 {
-	assert(state == State::IDLE);
+	assert(state == State::IDLE || state == State::READ);
 
-	if (!connection->Read(fh, offset, size, *this, error))
+	reads.emplace_back(*this, size);
+	if (!connection->Read(fh, offset, size, reads.back(), error)) {
+		reads.pop_back();
 		return false;
+	}
 
 	state = State::READ;
 	return true;
@@ -123,11 +128,98 @@ void
 NfsFileReader::CancelRead()
 {
 	if (state == State::READ) {
-		connection->Cancel(*this);
+		for (auto &r : reads)
+			if (!r.done)
+				connection->Cancel(r);
+
+		reads.clear();
 		state = State::IDLE;
 	}
 }
 
+std::list<NfsFileReader::ReadRequest>::iterator
+NfsFileReader::FindRead(const ReadRequest &r)
+{
+	for (auto i = reads.begin(), end = reads.end(); i != end; ++i)
+		if (&*i == &r)
+			return i;
+
+	assert(false);
+	gcc_unreachable();
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsCallback(unsigned status, void *_data)
+{
+	reader.ReadCallback(*this, _data, status);
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsError(Error &&error)
+{
+	reader.ReadError(*this, std::move(error));
+}
+
+inline void
+NfsFileReader::ReadCallback(ReadRequest &r, const void *data, size_t length)
+{
+	assert(state == State::READ);
+	assert(!r.done);
+
+	if (&r != &reads.front()) {
+		/* a preceding request is still pending: keep a copy
+		   until it arrives */
+		r.data.reset(new uint8_t[length]);
+		memcpy(r.data.get(), data, length);
+		r.length = length;
+		r.done = true;
+		return;
+	}
+
+	/* this is the oldest request: deliver it right away, and then
+	   all following requests which have already completed */
+
+	std::unique_ptr<uint8_t[]> buffer;
+
+	while (true) {
+		const bool short_read = length < reads.front().size;
+		reads.pop_front();
+
+		if (short_read)
+			/* the following requests were based on a wrong
+			   assumption; discard them, the caller will
+			   resubmit from the real offset */
+			CancelRead();
+		else if (reads.empty())
+			state = State::IDLE;
+
+		OnNfsFileRead(data, length);
+
+		/* the handler may have cancelled or submitted
+		   requests */
+		if (state != State::READ || !reads.front().done)
+			break;
+
+		ReadRequest &next = reads.front();
+		buffer = std::move(next.data);
+		data = buffer.get();
+		length = next.length;
+	}
+}
+
+inline void
+NfsFileReader::ReadError(ReadRequest &r, Error &&error)
+{
+	assert(state == State::READ);
+
+	/* this request has already been removed from the
+	   NfsConnection; drop it before cancelling the others */
+	reads.erase(FindRead(r));
+	CancelRead();
+
+	OnNfsFileError(std::move(error));
+}
+
 void
 NfsFileReader::OnNfsConnectionReady()
 {
@@ -157,6 +249,7 @@ NfsFileReader::OnNfsConnectionDisconnected(const Error &error)
 {
 	assert(state > State::MOUNT);
 
+	CancelRead();
 	state = State::INITIAL;
 
 	Error copy;
@@ -201,12 +294,13 @@ NfsFileReader::StatCallback(const struct stat *st)
 }
 
 void
-NfsFileReader::OnNfsCallback(unsigned status, void *data)
+NfsFileReader::OnNfsCallback(gcc_unused unsigned status, void *data)
 {
 	switch (state) {
 	case State::INITIAL:
 	case State::DEFER:
 	case State::MOUNT:
+	case State::READ:
 	case State::IDLE:
 		assert(false);
 		gcc_unreachable();
@@ -218,11 +312,6 @@ NfsFileReader::OnNfsCallback(unsigned status, void *data)
 	case State::STAT:
 		StatCallback((const struct stat *)data);
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		OnNfsFileRead(data, status);
-		break;
 	}
 }
 
@@ -26,6 +26,8 @@
 #include "event/DeferredMonitor.hxx"
 
 #include <string>
+#include <list>
+#include <memory>
 
 #include <stdint.h>
 #include <stddef.h>
@@ -34,6 +36,12 @@
 struct nfsfh;
 class NfsConnection;
 
+/**
+ * A helper class which reads a file from a NFS server
+ * asynchronously.  Several reads may be in flight at the same time;
+ * their results are delivered to OnNfsFileRead() in the order in
+ * which they were submitted.
+ */
 class NfsFileReader : NfsLease, NfsCallback, DeferredMonitor {
 	enum class State {
 		INITIAL,
@@ -54,6 +62,41 @@ class NfsFileReader : NfsLease, NfsCallback, DeferredMonitor {
 
 	nfsfh *fh;
 
+	/**
+	 * One outstanding nfs_pread_async() call.  Each request needs
+	 * its own #NfsCallback instance, because #NfsConnection
+	 * identifies callbacks by their address.
+	 */
+	class ReadRequest final : public NfsCallback {
+		NfsFileReader &reader;
+
+	public:
+		const size_t size;
+
+		/**
+		 * A copy of the data which was received out of
+		 * order; it is kept here until all preceding requests
+		 * have been delivered.
+		 */
+		std::unique_ptr<uint8_t[]> data;
+		size_t length;
+
+		bool done;
+
+		ReadRequest(NfsFileReader &_reader, size_t _size)
+			:reader(_reader), size(_size), done(false) {}
+
+		/* virtual methods from NfsCallback */
+		void OnNfsCallback(unsigned status, void *data) override;
+		void OnNfsError(Error &&error) override;
+	};
+
+	/**
+	 * The outstanding read requests, ordered by file offset.  The
+	 * list is non-empty if and only if #state is State::READ.
+	 */
+	std::list<ReadRequest> reads;
+
 public:
 	NfsFileReader();
 	~NfsFileReader();
@@ -62,13 +105,32 @@ public:
 	void DeferClose();
 
 	bool Open(const char *uri, Error &error);
+
+	/**
+	 * Submit a read request.  This may be called while other
+	 * requests are still pending.  If one request returns less
+	 * data than requested, all following requests are discarded,
+	 * so the data passed to OnNfsFileRead() is always contiguous.
+	 */
 	bool Read(uint64_t offset, size_t size, Error &error);
+
+	/**
+	 * Cancel all pending read requests.
+	 */
 	void CancelRead();
 
 	bool IsIdle() const {
 		return state == State::IDLE;
 	}
 
+	/**
+	 * Returns the number of read requests which have not yet been
+	 * delivered to OnNfsFileRead().
+	 */
+	unsigned GetPendingReads() const {
+		return reads.size();
+	}
+
 protected:
 	virtual void OnNfsFileOpen(uint64_t size) = 0;
 	virtual void OnNfsFileRead(const void *data, size_t size) = 0;
@@ -77,6 +139,10 @@ protected:
 private:
 	void OpenCallback(nfsfh *_fh);
 	void StatCallback(const struct stat *st);
+	void ReadCallback(ReadRequest &r, const void *data, size_t length);
+	void ReadError(ReadRequest &r, Error &&error);
+
+	std::list<ReadRequest>::iterator FindRead(const ReadRequest &r);
 
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() final;
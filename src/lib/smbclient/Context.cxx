@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Context.hxx"
+#include "Init.hxx"
+#include "Mutex.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Error.hxx"
+
+SmbclientContext::~SmbclientContext()
+{
+	/* creating and destroying contexts modifies global
+	   libsmbclient state */
+	const ScopeLock protect(smbclient_mutex);
+	smbc_free_context(ctx, 1);
+}
+
+SmbclientContext *
+SmbclientContext::New(Error &error)
+{
+	const ScopeLock protect(smbclient_mutex);
+
+	SMBCCTX *ctx = smbc_new_context();
+	if (ctx == nullptr) {
+		error.SetErrno("smbc_new_context() failed");
+		return nullptr;
+	}
+
+	smbc_setFunctionAuthData(ctx, SmbclientGetAuthData);
+
+	SMBCCTX *ctx2 = smbc_init_context(ctx);
+	if (ctx2 == nullptr) {
+		error.SetErrno("smbc_init_context() failed");
+		smbc_free_context(ctx, 1);
+		return nullptr;
+	}
+
+	return new SmbclientContext(ctx2);
+}
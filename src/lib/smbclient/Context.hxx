@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SMBCLIENT_CONTEXT_HXX
+#define MPD_SMBCLIENT_CONTEXT_HXX
+
+#include "check.h"
+
+#include <libsmbclient.h>
+
+#include <sys/types.h>
+
+class Error;
+
+/**
+ * Wrapper for a libsmbclient context.  Unlike the "compat" API
+ * (smbc_open() etc.) which operates on one global context, each
+ * #SmbclientContext has its own connections and can be used without
+ * locking #smbclient_mutex.  It must not be used by more than one
+ * thread at a time, though.
+ */
+class SmbclientContext {
+	SMBCCTX *const ctx;
+
+	explicit SmbclientContext(SMBCCTX *_ctx):ctx(_ctx) {}
+
+public:
+	SmbclientContext(const SmbclientContext &) = delete;
+	SmbclientContext &operator=(const SmbclientContext &) = delete;
+
+	~SmbclientContext();
+
+	/**
+	 * Create and initialize a new context.  Returns nullptr on
+	 * error.
+	 */
+	static SmbclientContext *New(Error &error);
+
+	/**
+	 * Set the timeout for each operation [ms].
+	 */
+	void SetTimeout(int timeout_ms) {
+		smbc_setTimeout(ctx, timeout_ms);
+	}
+
+	SMBCFILE *Open(const char *fname, int flags, mode_t mode=0) {
+		return smbc_getFunctionOpen(ctx)(ctx, fname, flags, mode);
+	}
+
+	ssize_t Read(SMBCFILE *file, void *buf, size_t count) {
+		return smbc_getFunctionRead(ctx)(ctx, file, buf, count);
+	}
+
+	off_t Seek(SMBCFILE *file, off_t offset, int whence) {
+		return smbc_getFunctionLseek(ctx)(ctx, file, offset, whence);
+	}
+
+	int Stat(const char *fname, struct stat &st) {
+		return smbc_getFunctionStat(ctx)(ctx, fname, &st);
+	}
+
+	int Stat(SMBCFILE *file, struct stat &st) {
+		return smbc_getFunctionFstat(ctx)(ctx, file, &st);
+	}
+
+	void Close(SMBCFILE *file) {
+		smbc_getFunctionClose(ctx)(ctx, file);
+	}
+
+	SMBCFILE *OpenDirectory(const char *fname) {
+		return smbc_getFunctionOpendir(ctx)(ctx, fname);
+	}
+
+	struct smbc_dirent *ReadDirectory(SMBCFILE *dir) {
+		return smbc_getFunctionReaddir(ctx)(ctx, dir);
+	}
+
+	void CloseDirectory(SMBCFILE *dir) {
+		smbc_getFunctionClosedir(ctx)(ctx, dir);
+	}
+};
+
+#endif
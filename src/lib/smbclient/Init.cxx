@@ -27,8 +27,8 @@
 
 #include <string.h>
 
-static void
-mpd_smbc_get_auth_data(gcc_unused const char *srv,
+void
+SmbclientGetAuthData(gcc_unused const char *srv,
 		       gcc_unused const char *shr,
 		       char *wg, gcc_unused int wglen,
 		       char *un, gcc_unused int unlen,
@@ -46,7 +46,7 @@ SmbclientInit(Error &error)
 	const ScopeLock protect(smbclient_mutex);
 
 	constexpr int debug = 0;
-	if (smbc_init(mpd_smbc_get_auth_data, debug) < 0) {
+	if (smbc_init(SmbclientGetAuthData, debug) < 0) {
 		error.SetErrno("smbc_init() failed");
 		return false;
 	}
@@ -30,4 +30,14 @@ class Error;
 bool
 SmbclientInit(Error &error);
 
+/**
+ * The authentication callback which is installed in all
+ * libsmbclient contexts.
+ */
+void
+SmbclientGetAuthData(const char *srv, const char *shr,
+		     char *wg, int wglen,
+		     char *un, int unlen,
+		     char *pw, int pwlen);
+
 #endif
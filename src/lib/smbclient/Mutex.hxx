@@ -24,7 +24,9 @@ class Mutex;
 
 /**
  * Since libsmbclient is not thread-safe, this mutex must be locked
- * during all libsmbclient function calls.
+ * during all calls to the "compat" API (which operates on the global
+ * context) and while creating or freeing a context.  Calls on a
+ * private #SmbclientContext do not need it.
  */
 extern Mutex smbclient_mutex;
 
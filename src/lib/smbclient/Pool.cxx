@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Pool.hxx"
+#include "Context.hxx"
+
+SmbclientContextPool::~SmbclientContextPool()
+{
+	for (auto *ctx : idle)
+		delete ctx;
+}
+
+SmbclientContext *
+SmbclientContextPool::Get(Error &error)
+{
+	mutex.lock();
+	if (!idle.empty()) {
+		SmbclientContext *ctx = idle.front();
+		idle.pop_front();
+		--n_idle;
+		mutex.unlock();
+		return ctx;
+	}
+
+	mutex.unlock();
+
+	return SmbclientContext::New(error);
+}
+
+void
+SmbclientContextPool::Put(SmbclientContext *ctx)
+{
+	mutex.lock();
+	if (n_idle < max_idle) {
+		idle.push_front(ctx);
+		++n_idle;
+		ctx = nullptr;
+	}
+
+	mutex.unlock();
+
+	delete ctx;
+}
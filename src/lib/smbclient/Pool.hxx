@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SMBCLIENT_POOL_HXX
+#define MPD_SMBCLIENT_POOL_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+
+#include <forward_list>
+
+class Error;
+class SmbclientContext;
+
+/**
+ * A pool of idle #SmbclientContext instances.  Each user obtains its
+ * own context, so independent streams do not block each other, and
+ * returning a context to the pool keeps its SMB connections open
+ * for the next user.
+ */
+class SmbclientContextPool {
+	const unsigned max_idle;
+
+	Mutex mutex;
+
+	std::forward_list<SmbclientContext *> idle;
+	unsigned n_idle;
+
+public:
+	explicit SmbclientContextPool(unsigned _max_idle)
+		:max_idle(_max_idle), n_idle(0) {}
+
+	~SmbclientContextPool();
+
+	SmbclientContextPool(const SmbclientContextPool &) = delete;
+	SmbclientContextPool &operator=(const SmbclientContextPool &) = delete;
+
+	/**
+	 * Obtain an idle context, or create a new one.  Returns
+	 * nullptr on error.
+	 */
+	SmbclientContext *Get(Error &error);
+
+	/**
+	 * Return a context which was obtained with Get().  It is
+	 * freed if there are already enough idle contexts.
+	 */
+	void Put(SmbclientContext *ctx);
+};
+
+#endif
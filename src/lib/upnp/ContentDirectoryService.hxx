@@ -121,6 +121,14 @@ public:
 				   std::list<std::string> &result,
 				   Error &error) const;
 
+	/**
+	 * The number of entries requested per readDirSlice() call by
+	 * readDir().
+	 */
+	unsigned GetSliceSize() const {
+		return m_rdreqcnt;
+	}
+
 	gcc_pure
 	std::string GetURI() const {
 		return "upnp://" + m_deviceId + "/" + m_serviceType;
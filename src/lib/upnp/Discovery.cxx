@@ -26,6 +26,8 @@
 
 #include <upnp/upnptools.h>
 
+#include <algorithm>
+
 #include <string.h>
 
 // The service type string we are looking for.
@@ -105,6 +107,39 @@ UPnPDeviceDirectory::LockRemove(const std::string &id)
 	}
 }
 
+inline bool
+UPnPDeviceDirectory::LockRefresh(const DiscoveredTask &task)
+{
+	const ScopeLock protect(mutex);
+
+	for (auto &i : directories) {
+		if (i.id == task.deviceId) {
+			if (i.url != task.url)
+				/* moved: download the new description */
+				break;
+
+			i.expires = std::max(i.expires,
+					     MonotonicClockS() + task.expires + 20);
+			return false;
+		}
+	}
+
+	if (std::find(pending.begin(), pending.end(),
+		      task.deviceId) != pending.end())
+		/* another worker is already on it */
+		return false;
+
+	pending.push_back(task.deviceId);
+	return true;
+}
+
+inline void
+UPnPDeviceDirectory::LockDonePending(const std::string &id)
+{
+	const ScopeLock protect(mutex);
+	pending.remove(id);
+}
+
 inline void
 UPnPDeviceDirectory::discoExplorer()
 {
@@ -115,19 +150,28 @@ UPnPDeviceDirectory::discoExplorer()
 			return;
 		}
 
-		// Device signals its existence and well-being. Perform the
-		// UPnP "description" phase by downloading and decoding the
-		// description document.
+		// Device signals its existence and well-being.  Skip
+		// the description phase if we know it already.
+		if (!LockRefresh(*tsk)) {
+			delete tsk;
+			continue;
+		}
+
+		// Perform the UPnP "description" phase by downloading
+		// and decoding the description document.
 		char *buf;
 		// LINE_SIZE is defined by libupnp's upnp.h...
 		char contentType[LINE_SIZE];
 		int code = UpnpDownloadUrlItem(tsk->url.c_str(), &buf, contentType);
 		if (code != UPNP_E_SUCCESS) {
+			LockDonePending(tsk->deviceId);
+			delete tsk;
 			continue;
 		}
 
 		// Update or insert the device
-		ContentDirectoryDescriptor d(std::move(tsk->deviceId),
+		ContentDirectoryDescriptor d(std::string(tsk->deviceId),
+					     std::string(tsk->url),
 					     MonotonicClockS(), tsk->expires);
 
 		{
@@ -135,6 +179,7 @@ UPnPDeviceDirectory::discoExplorer()
 			bool success = d.Parse(tsk->url, buf, error2);
 			free(buf);
 			if (!success) {
+				LockDonePending(tsk->deviceId);
 				delete tsk;
 				LogError(error2);
 				continue;
@@ -142,6 +187,7 @@ UPnPDeviceDirectory::discoExplorer()
 		}
 
 		LockAdd(std::move(d));
+		LockDonePending(tsk->deviceId);
 		delete tsk;
 	}
 }
@@ -218,6 +264,9 @@ UPnPDeviceDirectory::expireDevices(Error &error)
 	for (auto it = directories.begin();
 	     it != directories.end();) {
 		if (now > it->expires) {
+			if (listener != nullptr)
+				AnnounceLostUPnP(*listener, it->device);
+
 			it = directories.erase(it);
 			didsomething = true;
 		} else {
@@ -246,9 +295,9 @@ UPnPDeviceDirectory::~UPnPDeviceDirectory()
 }
 
 bool
-UPnPDeviceDirectory::Start(Error &error)
+UPnPDeviceDirectory::Start(unsigned n_workers, Error &error)
 {
-	if (!discoveredQueue.start(1, discoExplorer, this)) {
+	if (!discoveredQueue.start(n_workers, discoExplorer, this)) {
 		error.Set(upnp_domain, "Discover work queue start failed");
 		return false;
 	}
@@ -71,6 +71,14 @@ class UPnPDeviceDirectory final : UpnpCallback {
 	public:
 		std::string id;
 
+		/**
+		 * The URL of the description document this device
+		 * was parsed from.  As long as a device advertises
+		 * the same location, the description is not
+		 * downloaded again.
+		 */
+		std::string url;
+
 		UPnPDevice device;
 
 		/**
@@ -82,8 +90,10 @@ class UPnPDeviceDirectory final : UpnpCallback {
 		ContentDirectoryDescriptor() = default;
 
 		ContentDirectoryDescriptor(std::string &&_id,
+					   std::string &&_url,
 					   unsigned last, int exp)
-			:id(std::move(_id)), expires(last + exp + 20) {}
+			:id(std::move(_id)), url(std::move(_url)),
+			 expires(last + exp + 20) {}
 
 		bool Parse(const std::string &url, const char *description,
 			   Error &_error) {
@@ -96,6 +106,14 @@ class UPnPDeviceDirectory final : UpnpCallback {
 
 	Mutex mutex;
 	std::list<ContentDirectoryDescriptor> directories;
+
+	/**
+	 * The ids of the devices whose description is being
+	 * downloaded (or queued for that).  Further advertisements
+	 * for them are ignored.  Protected by #mutex.
+	 */
+	std::list<std::string> pending;
+
 	WorkQueue<DiscoveredTask *> discoveredQueue;
 
 	/**
@@ -118,7 +136,11 @@ public:
 	UPnPDeviceDirectory(const UPnPDeviceDirectory &) = delete;
 	UPnPDeviceDirectory& operator=(const UPnPDeviceDirectory &) = delete;
 
-	bool Start(Error &error);
+	/**
+	 * @param n_workers the number of threads which download
+	 * device descriptions concurrently
+	 */
+	bool Start(unsigned n_workers, Error &error);
 
 	/** Retrieve the directory services currently seen on the network */
 	bool getDirServices(std::vector<ContentDirectoryService> &, Error &);
@@ -143,6 +165,20 @@ private:
 	void LockAdd(ContentDirectoryDescriptor &&d);
 	void LockRemove(const std::string &id);
 
+	/**
+	 * A device has been advertised.  If it is already known at
+	 * the same location, only its expiry is updated.
+	 *
+	 * @return true if the description needs to be downloaded
+	 */
+	bool LockRefresh(const DiscoveredTask &task);
+
+	/**
+	 * The description download for this device has finished
+	 * (successfully or not).
+	 */
+	void LockDonePending(const std::string &id);
+
 	/**
 	 * Worker routine for the discovery queue. Get messages about
 	 * devices appearing and disappearing, and update the
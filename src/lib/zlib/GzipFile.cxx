@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "GzipFile.hxx"
+#include "Domain.hxx"
+#include "fs/Path.hxx"
+#include "util/Error.hxx"
+
+#include <zlib.h>
+
+#include <stdlib.h>
+#include <errno.h>
+
+/**
+ * The size of zlib's internal buffers; larger than the default to
+ * reduce the number of system calls on slow storage.
+ */
+static constexpr unsigned GZIP_BUFFER_SIZE = 128 * 1024;
+
+static void
+SetGzipError(Error &error, gzFile file, const char *msg)
+{
+	int errnum;
+	const char *detail = gzerror(file, &errnum);
+	if (errnum == Z_ERRNO)
+		error.SetErrno(msg);
+	else
+		error.Format(zlib_domain, errnum, "%s: %s", msg, detail);
+}
+
+#ifdef HAVE_FOPENCOOKIE
+
+static ssize_t
+gzip_cookie_write(void *cookie, const char *buffer, size_t size)
+{
+	gzFile file = (gzFile)cookie;
+
+	if (size == 0)
+		return 0;
+
+	int nbytes = gzwrite(file, buffer, size);
+	return nbytes > 0 ? nbytes : -1;
+}
+
+static int
+gzip_cookie_close(void *cookie)
+{
+	gzFile file = (gzFile)cookie;
+
+	return gzclose(file) == Z_OK ? 0 : EOF;
+}
+
+FILE *
+GzipOpenWrite(Path path, Error &error)
+{
+	gzFile file = gzopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		error.FormatErrno("Failed to create \"%s\"", path.c_str());
+		return nullptr;
+	}
+
+	gzbuffer(file, GZIP_BUFFER_SIZE);
+
+	static const cookie_io_functions_t functions = {
+		nullptr,
+		gzip_cookie_write,
+		nullptr,
+		gzip_cookie_close,
+	};
+
+	FILE *fp = fopencookie(file, "w", functions);
+	if (fp == nullptr) {
+		error.SetErrno("fopencookie() failed");
+		gzclose(file);
+		return nullptr;
+	}
+
+	return fp;
+}
+
+#endif
+
+size_t
+GzipReadHead(Path path, void *buffer, size_t size)
+{
+	gzFile file = gzopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return 0;
+
+	int nbytes = gzread(file, buffer, size);
+	gzclose(file);
+	return nbytes > 0 ? nbytes : 0;
+}
+
+void *
+GzipLoadFile(Path path, size_t &size_r, Error &error)
+{
+	gzFile file = gzopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		error.FormatErrno("Failed to open \"%s\"", path.c_str());
+		return nullptr;
+	}
+
+	gzbuffer(file, GZIP_BUFFER_SIZE);
+
+	size_t capacity = GZIP_BUFFER_SIZE, size = 0;
+	char *data = (char *)malloc(capacity);
+
+	while (data != nullptr) {
+		if (size == capacity) {
+			capacity *= 2;
+			char *new_data = (char *)realloc(data, capacity);
+			if (new_data == nullptr) {
+				free(data);
+				data = nullptr;
+				break;
+			}
+
+			data = new_data;
+		}
+
+		int nbytes = gzread(file, data + size, capacity - size);
+		if (nbytes < 0) {
+			SetGzipError(error, file, "Failed to decompress");
+			free(data);
+			gzclose(file);
+			return nullptr;
+		}
+
+		if (nbytes == 0)
+			break;
+
+		size += nbytes;
+	}
+
+	gzclose(file);
+
+	if (data == nullptr) {
+		error.Set(zlib_domain, "Out of memory");
+		return nullptr;
+	}
+
+	size_r = size;
+	return data;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_ZLIB_GZIP_FILE_HXX
+#define MPD_ZLIB_GZIP_FILE_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <stdio.h>
+#include <stddef.h>
+
+class Path;
+class Error;
+
+/**
+ * Does the buffer start with the gzip magic bytes?
+ */
+gcc_pure
+static inline bool
+IsGzipMagic(const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	return size >= 2 && p[0] == 0x1f && p[1] == 0x8b;
+}
+
+#ifdef HAVE_FOPENCOOKIE
+
+/**
+ * Open a file for writing.  All data written to the returned FILE
+ * object is compressed with gzip while it is being written, without
+ * buffering the whole file.  Close it with fclose(), and check its
+ * return value: it reports errors while flushing the compressor.
+ *
+ * @return the FILE object, or nullptr on error
+ */
+FILE *
+GzipOpenWrite(Path path, Error &error);
+
+#endif
+
+/**
+ * Read the first bytes of a file.  If it is compressed with gzip,
+ * the decompressed data is returned.
+ *
+ * @return the number of bytes read, or 0 on error
+ */
+size_t
+GzipReadHead(Path path, void *buffer, size_t size);
+
+/**
+ * Decompress a whole gzip file into a buffer allocated with
+ * malloc().  Uncompressed files are read as-is.
+ *
+ * @return the buffer (to be freed by the caller), or nullptr on error
+ */
+void *
+GzipLoadFile(Path path, size_t &size_r, Error &error);
+
+#endif
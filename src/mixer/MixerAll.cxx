@@ -43,7 +43,7 @@ output_mixer_get_volume(const AudioOutput &ao)
 		return -1;
 
 	Error error;
-	int volume = mixer_get_volume(mixer, error);
+	int volume = mixer_get_cached_volume(mixer, error);
 	if (volume < 0 && error.IsDefined())
 		FormatError(error,
 			    "Failed to read mixer for '%s'",
@@ -59,10 +59,17 @@ mixer_open(Mixer *mixer, Error &error)
 
 	const ScopeLock protect(mixer->mutex);
 
-	success = mixer->open || (mixer->open = mixer->Open(error));
+	if (mixer->open)
+		return true;
 
+	success = mixer->open = mixer->Open(error);
 	mixer->failed = !success;
 
+	if (success)
+		/* fill the cache; after this, it is kept up to date
+		   by mixer_set_volume() and by mixer events */
+		mixer->cached_volume = mixer->GetVolume(IgnoreError());
+
 	return success;
 }
 
@@ -74,6 +81,7 @@ mixer_close_internal(Mixer *mixer)
 
 	mixer->Close();
 	mixer->open = false;
+	mixer->cached_volume = -1;
 }
 
 void
@@ -125,12 +133,26 @@ mixer_get_volume(Mixer *mixer, Error &error)
 		volume = mixer->GetVolume(error);
 		if (volume < 0 && error.IsDefined())
 			mixer_failed(mixer);
+		else
+			mixer->cached_volume = volume;
 	} else
 		volume = -1;
 
 	return volume;
 }
 
+int
+mixer_get_cached_volume(Mixer *mixer, Error &error)
+{
+	assert(mixer != nullptr);
+
+	if (mixer->plugin.global && !mixer->open && !mixer->failed)
+		/* not opened yet */
+		return mixer_get_volume(mixer, error);
+
+	return mixer->cached_volume;
+}
+
 bool
 mixer_set_volume(Mixer *mixer, unsigned volume, Error &error)
 {
@@ -143,5 +165,9 @@ mixer_set_volume(Mixer *mixer, unsigned volume, Error &error)
 
 	const ScopeLock protect(mixer->mutex);
 
-	return mixer->open && mixer->SetVolume(volume, error);
+	if (!mixer->open || !mixer->SetVolume(volume, error))
+		return false;
+
+	mixer->cached_volume = volume;
+	return true;
 }
@@ -55,9 +55,24 @@ mixer_close(Mixer *mixer);
 void
 mixer_auto_close(Mixer *mixer);
 
+/**
+ * Read the volume from the device.  This also updates the value
+ * returned by mixer_get_cached_volume().
+ */
 int
 mixer_get_volume(Mixer *mixer, Error &error);
 
+/**
+ * Returns the volume which was last read, written or reported by a
+ * mixer event, without talking to the device.  The only exception is
+ * a "global" mixer which has not been opened yet: it is opened (and
+ * read) once.
+ *
+ * @return the volume (0..100 including) or -1 if unavailable
+ */
+int
+mixer_get_cached_volume(Mixer *mixer, Error &error);
+
 bool
 mixer_set_volume(Mixer *mixer, unsigned volume, Error &error);
 
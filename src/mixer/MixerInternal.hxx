@@ -22,10 +22,11 @@
 
 #include "MixerPlugin.hxx"
 #include "MixerList.hxx"
+#include "Listener.hxx"
 #include "thread/Mutex.hxx"
 #include "Compiler.h"
 
-class MixerListener;
+#include <atomic>
 
 class Mixer {
 public:
@@ -50,11 +51,21 @@ public:
 	 */
 	bool failed;
 
+	/**
+	 * The volume which was last read from or written to the
+	 * device, or reported by the plugin with VolumeChanged(); -1
+	 * if unknown or if the mixer is closed.  This allows
+	 * mixer_get_cached_volume() to answer without talking to the
+	 * device.
+	 */
+	std::atomic_int cached_volume;
+
 public:
 	explicit Mixer(const MixerPlugin &_plugin, MixerListener &_listener)
 		:plugin(_plugin), listener(_listener),
 		 open(false),
-		 failed(false) {}
+		 failed(false),
+		 cached_volume(-1) {}
 
 	Mixer(const Mixer &) = delete;
 
@@ -92,6 +103,20 @@ public:
 	 * true on success, false on error
 	 */
 	virtual bool SetVolume(unsigned volume, Error &error) = 0;
+
+	/**
+	 * The plugin calls this when the volume has been changed by
+	 * somebody else (or when the device became unavailable).  It
+	 * updates the cache and notifies the #MixerListener.  This
+	 * method is thread-safe.
+	 *
+	 * @param volume the new volume (0..100 including) or -1 if
+	 * unavailable
+	 */
+	void VolumeChanged(int volume) {
+		cached_volume = volume;
+		listener.OnMixerVolumeChanged(*this, volume);
+	}
 };
 
 #endif
@@ -23,7 +23,6 @@
 #include "Idle.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Domain.hxx"
-#include "system/PeriodClock.hxx"
 #include "Log.hxx"
 
 #include <assert.h>
@@ -35,28 +34,12 @@ static constexpr Domain volume_domain("volume");
 
 static unsigned volume_software_set = 100;
 
-/** the cached hardware mixer value; invalid if negative */
-static int last_hardware_volume = -1;
-/** the age of #last_hardware_volume */
-static PeriodClock hardware_volume_clock;
-
-void
-InvalidateHardwareVolume()
-{
-	/* flush the hardware volume cache */
-	last_hardware_volume = -1;
-}
-
 int
 volume_level_get(const MultipleOutputs &outputs)
 {
-	if (last_hardware_volume >= 0 &&
-	    !hardware_volume_clock.CheckUpdate(1000))
-		/* throttle access to hardware mixers */
-		return last_hardware_volume;
-
-	last_hardware_volume = outputs.GetVolume();
-	return last_hardware_volume;
+	/* this does not talk to the devices: each mixer caches its
+	   volume, and the plugins update it on mixer events */
+	return outputs.GetVolume();
 }
 
 static bool
@@ -73,9 +56,6 @@ software_volume_change(MultipleOutputs &outputs, unsigned volume)
 static bool
 hardware_volume_change(MultipleOutputs &outputs, unsigned volume)
 {
-	/* reset the cache */
-	last_hardware_volume = -1;
-
 	return outputs.SetVolume(volume);
 }
 
@@ -26,9 +26,11 @@
 
 class MultipleOutputs;
 
-void
-InvalidateHardwareVolume();
-
+/**
+ * Returns the average volume of all enabled mixers.  This is cheap:
+ * it uses the volume cached by each mixer, see
+ * mixer_get_cached_volume().
+ */
 gcc_pure
 int
 volume_level_get(const MultipleOutputs &outputs);
@@ -150,7 +150,7 @@ alsa_mixer_elem_callback(snd_mixer_elem_t *elem, unsigned mask)
 
 	if (mask & SND_CTL_EVENT_MASK_VALUE) {
 		int volume = mixer.GetVolume(IgnoreError());
-		mixer.listener.OnMixerVolumeChanged(mixer, volume);
+		mixer.VolumeChanged(volume);
 	}
 
 	return 0;
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "mixer/MixerInternal.hxx"
 #include "config/ConfigData.hxx"
+#include "event/TimeoutMonitor.hxx"
 #include "system/fd_util.h"
 #include "util/ASCII.hxx"
 #include "util/Error.hxx"
@@ -41,7 +42,13 @@
 
 #define VOLUME_MIXER_OSS_DEFAULT		"/dev/mixer"
 
-class OssMixer final : public Mixer {
+/**
+ * OSS does not report volume changes, so the device is polled at
+ * this interval while the mixer is open.
+ */
+static constexpr unsigned OSS_MIXER_POLL_SECONDS = 1;
+
+class OssMixer final : public Mixer, TimeoutMonitor {
 	const char *device;
 	const char *control;
 
@@ -49,8 +56,8 @@ class OssMixer final : public Mixer {
 	int volume_control;
 
 public:
-	OssMixer(MixerListener &_listener)
-		:Mixer(oss_mixer_plugin, _listener) {}
+	OssMixer(EventLoop &_loop, MixerListener &_listener)
+		:Mixer(oss_mixer_plugin, _listener), TimeoutMonitor(_loop) {}
 
 	bool Configure(const config_param &param, Error &error);
 
@@ -59,6 +66,12 @@ public:
 	virtual void Close() override;
 	virtual int GetVolume(Error &error) override;
 	virtual bool SetVolume(unsigned volume, Error &error) override;
+
+private:
+	bool ReadLevel(int &left_r, int &right_r, Error &error);
+
+	/* virtual methods from class TimeoutMonitor */
+	virtual void OnTimeout() override;
 };
 
 static constexpr Domain oss_mixer_domain("oss_mixer");
@@ -98,12 +111,12 @@ OssMixer::Configure(const config_param &param, Error &error)
 }
 
 static Mixer *
-oss_mixer_init(gcc_unused EventLoop &event_loop, gcc_unused AudioOutput &ao,
+oss_mixer_init(EventLoop &event_loop, gcc_unused AudioOutput &ao,
 	       MixerListener &listener,
 	       const config_param &param,
 	       Error &error)
 {
-	OssMixer *om = new OssMixer(listener);
+	OssMixer *om = new OssMixer(event_loop, listener);
 
 	if (!om->Configure(param, error)) {
 		delete om;
@@ -118,6 +131,7 @@ OssMixer::Close()
 {
 	assert(device_fd >= 0);
 
+	TimeoutMonitor::Cancel();
 	close(device_fd);
 }
 
@@ -148,25 +162,53 @@ OssMixer::Open(Error &error)
 		}
 	}
 
+	TimeoutMonitor::ScheduleSeconds(OSS_MIXER_POLL_SECONDS);
 	return true;
 }
 
-int
-OssMixer::GetVolume(Error &error)
+inline bool
+OssMixer::ReadLevel(int &left_r, int &right_r, Error &error)
 {
-	int left, right, level;
-	int ret;
+	int level;
 
 	assert(device_fd >= 0);
 
-	ret = ioctl(device_fd, MIXER_READ(volume_control), &level);
-	if (ret < 0) {
+	if (ioctl(device_fd, MIXER_READ(volume_control), &level) < 0) {
 		error.SetErrno("failed to read OSS volume");
 		return false;
 	}
 
-	left = level & 0xff;
-	right = (level & 0xff00) >> 8;
+	left_r = level & 0xff;
+	right_r = (level & 0xff00) >> 8;
+	return true;
+}
+
+void
+OssMixer::OnTimeout()
+{
+	/* keep the cached volume up to date, so reading it (e.g. for
+	   the "status" command) never needs to talk to the device */
+	int left, right;
+	bool success;
+
+	{
+		const ScopeLock protect(mutex);
+		success = ReadLevel(left, right, IgnoreError());
+	}
+
+	if (success && left != cached_volume)
+		VolumeChanged(left);
+
+	TimeoutMonitor::ScheduleSeconds(OSS_MIXER_POLL_SECONDS);
+}
+
+int
+OssMixer::GetVolume(Error &error)
+{
+	int left, right;
+
+	if (!ReadLevel(left, right, error))
+		return -1;
 
 	if (left != right) {
 		FormatWarning(oss_mixer_domain,
@@ -76,7 +76,7 @@ PulseMixer::Offline()
 
 	online = false;
 
-	listener.OnMixerVolumeChanged(*this, -1);
+	VolumeChanged(-1);
 }
 
 inline void
@@ -93,7 +93,7 @@ PulseMixer::VolumeCallback(const pa_sink_input_info *i, int eol)
 	online = true;
 	volume = i->volume;
 
-	listener.OnMixerVolumeChanged(*this, GetVolumeInternal(IgnoreError()));
+	VolumeChanged(GetVolumeInternal(IgnoreError()));
 }
 
 /**
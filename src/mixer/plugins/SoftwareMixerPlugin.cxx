@@ -55,13 +55,17 @@ class SoftwareMixer final : public Mixer {
 	unsigned volume;
 
 public:
-	SoftwareMixer(MixerListener &_listener)
+	SoftwareMixer(MixerListener &_listener, bool dither,
+		      unsigned ramp_ms)
 		:Mixer(software_mixer_plugin, _listener),
 		 filter(CreateVolumeFilter()),
 		 owns_filter(true),
 		 volume(100)
 	{
 		assert(filter != nullptr);
+
+		volume_filter_set_dither(filter, dither);
+		volume_filter_set_ramp(filter, ramp_ms);
 	}
 
 	virtual ~SoftwareMixer() {
@@ -90,10 +94,12 @@ static Mixer *
 software_mixer_init(gcc_unused EventLoop &event_loop,
 		    gcc_unused AudioOutput &ao,
 		    MixerListener &listener,
-		    gcc_unused const config_param &param,
+		    const config_param &param,
 		    gcc_unused Error &error)
 {
-	return new SoftwareMixer(listener);
+	return new SoftwareMixer(listener,
+				 param.GetBlockValue("volume_dither", true),
+				 param.GetBlockValue("volume_ramp", 20u));
 }
 
 gcc_const
@@ -20,8 +20,9 @@
 #include "config.h"
 #include "SmbclientNeighborPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
+#include "lib/smbclient/Context.hxx"
+#include "lib/smbclient/Pool.hxx"
 #include "lib/smbclient/Domain.hxx"
-#include "lib/smbclient/Mutex.hxx"
 #include "neighbor/NeighborPlugin.hxx"
 #include "neighbor/Explorer.hxx"
 #include "neighbor/Listener.hxx"
@@ -30,6 +31,9 @@
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigError.hxx"
+#include "system/Clock.hxx"
 #include "util/Macros.hxx"
 #include "util/Domain.hxx"
 #include "util/Error.hxx"
@@ -40,40 +44,70 @@
 #include <list>
 #include <algorithm>
 
+/**
+ * The default interval between two scans [s].
+ */
+static constexpr unsigned DEFAULT_INTERVAL = 10;
+
+/**
+ * The default time a server remains in the list after it has been
+ * seen for the last time [s].
+ */
+static constexpr unsigned DEFAULT_TTL = 60;
+
+/**
+ * The default timeout for each SMB operation [s].
+ */
+static constexpr unsigned DEFAULT_TIMEOUT = 5;
+
+/**
+ * The maximum number of workgroups which are probed in parallel.
+ */
+static constexpr unsigned MAX_PROBES = 8;
+
 class SmbclientNeighborExplorer final : public NeighborExplorer {
 	struct Server {
-		std::string name, comment;
+		NeighborInfo info;
 
-		bool alive;
+		/**
+		 * The MonotonicClockS() value when this server was
+		 * seen for the last time.
+		 */
+		unsigned last_seen;
 
-		Server(std::string &&_name, std::string &&_comment)
-			:name(std::move(_name)), comment(std::move(_comment)),
-			 alive(true) {}
-		Server(const Server &) = delete;
+		Server(NeighborInfo &&_info, unsigned _last_seen)
+			:info(std::move(_info)), last_seen(_last_seen) {}
+	};
 
-		gcc_pure
-		bool operator==(const Server &other) const {
-			return name == other.name;
-		}
+	const unsigned interval, ttl, timeout;
 
-		gcc_pure
-		NeighborInfo Export() const {
-			return { "smb://" + name + "/", comment };
-		}
-	};
+	/**
+	 * Private libsmbclient contexts for the scanner threads; they
+	 * keep their connections between two scans.
+	 */
+	SmbclientContextPool pool;
 
 	Thread thread;
 
 	mutable Mutex mutex;
 	Cond cond;
 
-	List list;
+	/**
+	 * All servers which have been seen within the last #ttl
+	 * seconds.  GetList() answers from here without scanning.
+	 * Protected by #mutex.
+	 */
+	std::list<Server> servers;
 
 	bool quit;
 
 public:
-	SmbclientNeighborExplorer(NeighborListener &_listener)
-		:NeighborExplorer(_listener) {}
+	SmbclientNeighborExplorer(NeighborListener &_listener,
+				  unsigned _interval, unsigned _ttl,
+				  unsigned _timeout)
+		:NeighborExplorer(_listener),
+		 interval(_interval), ttl(_ttl), timeout(_timeout),
+		 pool(MAX_PROBES) {}
 
 	/* virtual methods from class NeighborExplorer */
 	virtual bool Open(Error &error) override;
@@ -81,6 +115,8 @@ public:
 	virtual List GetList() const override;
 
 private:
+	SmbclientContext *GetContext();
+	List DetectServers();
 	void Run();
 	void ThreadFunc();
 	static void ThreadFunc(void *ctx);
@@ -108,11 +144,10 @@ NeighborExplorer::List
 SmbclientNeighborExplorer::GetList() const
 {
 	const ScopeLock protect(mutex);
-	/*
+
 	List list;
 	for (const auto &i : servers)
-		list.emplace_front(i.Export());
-	*/
+		list.emplace_front(i.info);
 	return list;
 }
 
@@ -125,118 +160,171 @@ ReadServer(NeighborExplorer::List &list, const smbc_dirent &e)
 	list.emplace_front("smb://" + name, name + " (" + comment + ")");
 }
 
+/**
+ * List the directory at the given URI, adding all servers to the
+ * list and the names of all workgroups to #workgroups.
+ */
 static void
-ReadServers(NeighborExplorer::List &list, const char *uri);
-
-static void
-ReadWorkgroup(NeighborExplorer::List &list, const std::string &name)
-{
-	std::string uri = "smb://" + name;
-	ReadServers(list, uri.c_str());
-}
-
-static void
-ReadEntry(NeighborExplorer::List &list, const smbc_dirent &e)
+ReadServers(SmbclientContext &ctx, NeighborExplorer::List &list,
+	    std::list<std::string> &workgroups, const char *uri)
 {
-	switch (e.smbc_type) {
-	case SMBC_WORKGROUP:
-		ReadWorkgroup(list, std::string(e.name, e.namelen));
-		break;
-
-	case SMBC_SERVER:
-		ReadServer(list, e);
-		break;
+	SMBCFILE *dir = ctx.OpenDirectory(uri);
+	if (dir == nullptr) {
+		FormatErrno(smbclient_domain, "smbc_opendir('%s') failed",
+			    uri);
+		return;
 	}
-}
 
-static void
-ReadServers(NeighborExplorer::List &list, int fd)
-{
 	smbc_dirent *e;
-	while ((e = smbc_readdir(fd)) != nullptr)
-		ReadEntry(list, *e);
+	while ((e = ctx.ReadDirectory(dir)) != nullptr) {
+		switch (e->smbc_type) {
+		case SMBC_WORKGROUP:
+			workgroups.emplace_back(e->name, e->namelen);
+			break;
 
-	smbc_closedir(fd);
-}
+		case SMBC_SERVER:
+			ReadServer(list, *e);
+			break;
+		}
+	}
 
-static void
-ReadServers(NeighborExplorer::List &list, const char *uri)
-{
-	int fd = smbc_opendir(uri);
-	if (fd >= 0) {
-		ReadServers(list, fd);
-		smbc_closedir(fd);
-	} else
-		FormatErrno(smbclient_domain, "smbc_opendir('%s') failed",
-			    uri);
+	ctx.CloseDirectory(dir);
 }
 
-gcc_pure
-static NeighborExplorer::List
-DetectServers()
-{
+/**
+ * Lists the servers of one workgroup in a separate thread, with its
+ * own #SmbclientContext.
+ */
+struct WorkgroupProbe {
+	SmbclientContext *const ctx;
+	const std::string uri;
+
 	NeighborExplorer::List list;
-	const ScopeLock protect(smbclient_mutex);
-	ReadServers(list, "smb://");
-	return list;
+
+	Thread thread;
+
+	WorkgroupProbe(SmbclientContext *_ctx, std::string &&_uri)
+		:ctx(_ctx), uri(std::move(_uri)) {}
+
+	void Run() {
+		std::list<std::string> workgroups;
+		ReadServers(*ctx, list, workgroups, uri.c_str());
+	}
+
+	static void Run(void *_ctx) {
+		SetThreadName("smbclient");
+
+		WorkgroupProbe &probe = *(WorkgroupProbe *)_ctx;
+		probe.Run();
+	}
+};
+
+SmbclientContext *
+SmbclientNeighborExplorer::GetContext()
+{
+	Error error;
+	SmbclientContext *ctx = pool.Get(error);
+	if (ctx == nullptr) {
+		LogError(error);
+		return nullptr;
+	}
+
+	ctx->SetTimeout(timeout * 1000);
+	return ctx;
 }
 
-gcc_pure
-static NeighborExplorer::List::const_iterator
-FindBeforeServerByURI(NeighborExplorer::List::const_iterator prev,
-		      NeighborExplorer::List::const_iterator end,
-		      const std::string &uri)
+NeighborExplorer::List
+SmbclientNeighborExplorer::DetectServers()
 {
-	for (auto i = std::next(prev); i != end; prev = i, i = std::next(prev))
-		if (i->uri == uri)
-			return prev;
+	List list;
+
+	SmbclientContext *ctx = GetContext();
+	if (ctx == nullptr)
+		return list;
+
+	std::list<std::string> workgroups;
+	ReadServers(*ctx, list, workgroups, "smb://");
+	pool.Put(ctx);
+
+	/* probe up to MAX_PROBES workgroups at a time, so one
+	   unresponsive master browser does not delay the others */
+	while (!workgroups.empty()) {
+		std::list<WorkgroupProbe> probes;
+
+		while (!workgroups.empty() && probes.size() < MAX_PROBES) {
+			ctx = GetContext();
+			if (ctx == nullptr)
+				break;
+
+			probes.emplace_back(ctx, "smb://" + workgroups.front());
+			workgroups.pop_front();
+
+			auto &probe = probes.back();
+			Error error;
+			if (!probe.thread.Start(WorkgroupProbe::Run, &probe,
+						error)) {
+				/* fall back to probing in this thread */
+				LogError(error);
+				probe.Run();
+			}
+		}
+
+		if (probes.empty())
+			break;
+
+		for (auto &probe : probes) {
+			if (probe.thread.IsDefined())
+				probe.thread.Join();
+
+			list.splice_after(list.before_begin(),
+					  std::move(probe.list));
+			pool.Put(probe.ctx);
+		}
+	}
 
-	return end;
+	return list;
 }
 
 inline void
 SmbclientNeighborExplorer::Run()
 {
-	List found = DetectServers(), lost;
+	List found = DetectServers(), added, lost;
+	const unsigned now = MonotonicClockS();
 
 	mutex.lock();
 
-	const auto found_before_begin = found.before_begin();
-	const auto found_end = found.end();
-
-	for (auto prev = list.before_begin(), i = std::next(prev), end = list.end();
-	     i != end; i = std::next(prev)) {
-		auto f = FindBeforeServerByURI(found_before_begin, found_end,
-					       i->uri);
-		if (f != found_end) {
-			/* still visible: remove from "found" so we
-			   don't believe it's a new one */
-			*i = std::move(*std::next(f));
-			found.erase_after(f);
-			prev = i;
+	for (auto &i : found) {
+		auto s = std::find_if(servers.begin(), servers.end(),
+				      [&i](const Server &server){
+					      return server.info.uri == i.uri;
+				      });
+		if (s != servers.end()) {
+			/* still visible: refresh */
+			s->info.display_name = std::move(i.display_name);
+			s->last_seen = now;
 		} else {
-			/* can't see it anymore: move to "lost" */
-#if defined(__clang__) || GCC_CHECK_VERSION(4,7)
-			lost.splice_after(lost.before_begin(), list, prev);
-#else
-			/* the forward_list::splice_after() lvalue
-			   reference overload is missing in gcc 4.6 */
-			lost.emplace_front(std::move(*i));
-			list.erase_after(prev);
-#endif
+			added.emplace_front(i);
+			servers.emplace_front(std::move(i), now);
 		}
 	}
 
-	for (auto prev = found_before_begin, i = std::next(prev);
-	     i != found_end; prev = i, i = std::next(prev))
-		list.push_front(*i);
+	/* servers which have not been seen for a while are lost; a
+	   single scan which misses one (which happens a lot with
+	   SMB browse lists) does not remove it yet */
+	for (auto i = servers.begin(); i != servers.end();) {
+		if (now - i->last_seen >= ttl) {
+			lost.emplace_front(std::move(i->info));
+			i = servers.erase(i);
+		} else
+			++i;
+	}
 
 	mutex.unlock();
 
 	for (auto &i : lost)
 		listener.LostNeighbor(i);
 
-	for (auto &i : found)
+	for (auto &i : added)
 		listener.FoundNeighbor(i);
 }
 
@@ -254,8 +342,7 @@ SmbclientNeighborExplorer::ThreadFunc()
 		if (quit)
 			break;
 
-		// TODO: sleep for how long?
-		cond.timed_wait(mutex, 10000);
+		cond.timed_wait(mutex, interval * 1000);
 	}
 
 	mutex.unlock();
@@ -273,13 +360,31 @@ SmbclientNeighborExplorer::ThreadFunc(void *ctx)
 static NeighborExplorer *
 smbclient_neighbor_create(gcc_unused EventLoop &loop,
 			  NeighborListener &listener,
-			  gcc_unused const config_param &param,
-			  gcc_unused Error &error)
+			  const config_param &param,
+			  Error &error)
 {
+	const unsigned interval =
+		param.GetBlockValue("interval", DEFAULT_INTERVAL);
+	if (interval == 0) {
+		error.Set(config_domain, "\"interval\" must be positive");
+		return nullptr;
+	}
+
+	const unsigned ttl = param.GetBlockValue("ttl", DEFAULT_TTL);
+	if (ttl < interval) {
+		error.Set(config_domain,
+			  "\"ttl\" must not be shorter than \"interval\"");
+		return nullptr;
+	}
+
+	const unsigned timeout =
+		param.GetBlockValue("timeout", DEFAULT_TIMEOUT);
+
 	if (!SmbclientInit(error))
 		return nullptr;
 
-	return new SmbclientNeighborExplorer(listener);
+	return new SmbclientNeighborExplorer(listener, interval, ttl,
+					     timeout);
 }
 
 const NeighborPlugin smbclient_neighbor_plugin = {
@@ -27,6 +27,7 @@
 #include "neighbor/Explorer.hxx"
 #include "neighbor/Listener.hxx"
 #include "neighbor/Info.hxx"
+#include "config/ConfigData.hxx"
 #include "Log.hxx"
 
 class UpnpNeighborExplorer final
@@ -54,9 +55,17 @@ class UpnpNeighborExplorer final
 
 	UPnPDeviceDirectory *discovery;
 
+	/**
+	 * The number of threads which download device descriptions
+	 * ("discovery_threads").
+	 */
+	const unsigned discovery_threads;
+
 public:
-	UpnpNeighborExplorer(NeighborListener &_listener)
-		:NeighborExplorer(_listener) {}
+	UpnpNeighborExplorer(NeighborListener &_listener,
+			     unsigned _discovery_threads)
+		:NeighborExplorer(_listener),
+		 discovery_threads(_discovery_threads) {}
 
 	/* virtual methods from class NeighborExplorer */
 	virtual bool Open(Error &error) override;
@@ -77,7 +86,7 @@ UpnpNeighborExplorer::Open(Error &error)
 		return false;
 
 	discovery = new UPnPDeviceDirectory(handle, this);
-	if (!discovery->Start(error)) {
+	if (!discovery->Start(discovery_threads, error)) {
 		delete discovery;
 		UpnpClientGlobalFinish();
 		return false;
@@ -127,10 +136,15 @@ UpnpNeighborExplorer::LostUPnP(const ContentDirectoryService &service)
 static NeighborExplorer *
 upnp_neighbor_create(gcc_unused EventLoop &loop,
 		     NeighborListener &listener,
-		     gcc_unused const config_param &param,
+		     const config_param &param,
 		     gcc_unused Error &error)
 {
-	return new UpnpNeighborExplorer(listener);
+	unsigned discovery_threads =
+		param.GetBlockValue("discovery_threads", 4u);
+	if (discovery_threads == 0)
+		discovery_threads = 1;
+
+	return new UpnpNeighborExplorer(listener, discovery_threads);
 }
 
 const NeighborPlugin upnp_neighbor_plugin = {
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "SharedConvert.hxx"
 #include "OutputPlugin.hxx"
 #include "mixer/MixerControl.hxx"
 #include "filter/FilterInternal.hxx"
@@ -37,6 +38,9 @@ AudioOutput::~AudioOutput()
 	delete replay_gain_filter;
 	delete other_replay_gain_filter;
 	delete filter;
+
+	if (shared_convert != nullptr)
+		shared_convert->Unref();
 }
 
 void
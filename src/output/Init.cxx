@@ -54,10 +54,17 @@ AudioOutput::AudioOutput(const AudioOutputPlugin &_plugin)
 	 allow_play(true),
 	 in_playback_loop(false),
 	 woken_for_play(false),
+	 batch_chunks(1), pending_chunks(0), starving(false),
+	 sync_clock(nullptr), sync_slot(0),
+	 latency_offset(0), sync_error(0),
 	 filter(nullptr),
 	 replay_gain_filter(nullptr),
 	 other_replay_gain_filter(nullptr),
-	 command(AO_COMMAND_NONE)
+	 volume_filter(nullptr),
+	 private_filters(false),
+	 shared_convert(nullptr),
+	 command(AO_COMMAND_NONE),
+	 skip_chunk(nullptr)
 {
 	assert(plugin.finish != nullptr);
 	assert(plugin.open != nullptr);
@@ -136,12 +143,18 @@ audio_output_load_mixer(EventLoop &event_loop, AudioOutput &ao,
 	case MIXER_TYPE_SOFTWARE:
 		mixer = mixer_new(event_loop, software_mixer_plugin, ao,
 				  listener,
-				  config_param(),
+				  param,
 				  IgnoreError());
 		assert(mixer != nullptr);
 
+		if (!ao.private_filters)
+			/* the volume filter is the first item in the
+			   chain; replay gain may be folded into it */
+			ao.volume_filter = software_mixer_get_filter(mixer);
+
 		filter_chain_append(filter_chain, "software_mixer",
 				    software_mixer_get_filter(mixer));
+		ao.private_filters = true;
 		return mixer;
 	}
 
@@ -175,10 +188,23 @@ AudioOutput::Configure(const config_param &param, Error &error)
 		config_audio_format.Clear();
 	}
 
+	resampler_profile = param.GetBlockValue("resampler");
+
 	tags = param.GetBlockValue("tags", true);
 	always_on = param.GetBlockValue("always_on", false);
+	keep_format = param.GetBlockValue("keep_format", false);
+	lossy = param.GetBlockValue("lossy", false);
+
+	batch_chunks = param.GetBlockValue("batch_chunks", 1u);
+	if (batch_chunks == 0 || batch_chunks > 64) {
+		error.Set(config_domain,
+			  "\"batch_chunks\" must be between 1 and 64");
+		return false;
+	}
 	enabled = param.GetBlockValue("enabled", true);
 
+	latency_offset = param.GetBlockValue("latency_offset", 0u) * 1000;
+
 	/* set up the filter chain */
 
 	filter = filter_chain_new();
@@ -194,12 +220,15 @@ AudioOutput::Configure(const config_param &param, Error &error)
 
 		filter_chain_append(*filter, "normalize",
 				    autoconvert_filter_new(normalize_filter));
+		private_filters = true;
 	}
 
+	const char *filters = param.GetBlockValue(AUDIO_FILTERS, "");
+	if (*filters != 0)
+		private_filters = true;
+
 	Error filter_error;
-	filter_chain_parse(*filter,
-			   param.GetBlockValue(AUDIO_FILTERS, ""),
-			   filter_error);
+	filter_chain_parse(*filter, filters, filter_error);
 
 	// It's not really fatal - Part of the filter chain has been set up already
 	// and even an empty one will work (if only with unexpected behaviour)
@@ -274,9 +303,15 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 
 	/* the "convert" filter must be the last one in the chain */
 
-	ao.convert_filter = filter_new(&convert_filter_plugin, config_param(),
-					IgnoreError());
-	assert(ao.convert_filter != nullptr);
+	config_param convert_param;
+	if (ao.resampler_profile != nullptr)
+		convert_param.AddBlockParam("resampler", ao.resampler_profile,
+					    param.line);
+
+	ao.convert_filter = filter_new(&convert_filter_plugin, convert_param,
+				       error);
+	if (ao.convert_filter == nullptr)
+		return false;
 
 	filter_chain_append(*ao.filter, "convert", ao.convert_filter);
 
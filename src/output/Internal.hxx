@@ -28,9 +28,12 @@
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "system/PeriodClock.hxx"
+#include "Metrics.hxx"
 
 class Error;
 class Filter;
+class SharedConvert;
+class OutputSyncClock;
 class MusicPipe;
 class EventLoop;
 class Mixer;
@@ -96,6 +99,20 @@ struct AudioOutput {
 	 */
 	bool always_on;
 
+	/**
+	 * Keep the device open in its current format when the input
+	 * format changes ("keep_format"), and convert to it instead
+	 * of reopening the device.
+	 */
+	bool keep_format;
+
+	/**
+	 * May this output fall behind the others and skip chunks
+	 * ("lossy"), instead of holding back the #MusicPipe for all
+	 * of them?
+	 */
+	bool lossy;
+
 	/**
 	 * Has the user enabled this device?
 	 */
@@ -147,6 +164,99 @@ struct AudioOutput {
 	 */
 	bool woken_for_play;
 
+	/**
+	 * The configured number of chunks the OutputThread waits for
+	 * before it wakes up to play them ("batch_chunks").  1 means
+	 * no batching.
+	 */
+	unsigned batch_chunks;
+
+	/**
+	 * The number of chunks added to the MusicPipe since the
+	 * OutputThread has gone to sleep.  It is woken up when the
+	 * first one arrives (to start the batch timeout, see
+	 * WaitForBatch()) and again when #batch_chunks is reached.
+	 */
+	unsigned pending_chunks;
+
+	/**
+	 * Has the OutputThread played all chunks in the pipe and is
+	 * waiting for more?  Used to count each underrun only once.
+	 */
+	bool starving;
+
+	/**
+	 * The number of times the OutputThread has run out of chunks
+	 * during playback.
+	 */
+	MetricCounter underruns;
+
+	/**
+	 * The number of times this "lossy" output has skipped ahead
+	 * because it lagged behind the other outputs.
+	 */
+	MetricCounter skips;
+
+	/**
+	 * The number of bytes a non-blocking output plugin has
+	 * discarded because its reader did not keep up.  Incremented
+	 * by the plugin.
+	 */
+	MetricCounter dropped_bytes;
+
+	/**
+	 * The duration of each ao_plugin_play() call.
+	 */
+	MetricHistogram play_latency;
+
+	/**
+	 * The shared clock this output is synchronised with ("sync"
+	 * setting), or nullptr.  It is owned by #MultipleOutputs.
+	 */
+	OutputSyncClock *sync_clock;
+
+	/**
+	 * This output's slot in #sync_clock.
+	 */
+	unsigned sync_slot;
+
+	/**
+	 * A constant latency added to the one reported by the plugin
+	 * ("latency_offset"), e.g. for the buffer of a network
+	 * receiver [us].
+	 */
+	unsigned latency_offset;
+
+	/**
+	 * The deviation from #sync_clock reported after the last
+	 * chunk [us]; positive if this output is ahead.  Only
+	 * accessed by the OutputThread.
+	 */
+	int64_t sync_error;
+
+	/**
+	 * The buffer used by the synchronisation to drop, duplicate
+	 * or insert frames.
+	 */
+	PcmBuffer sync_buffer;
+
+	/**
+	 * The latency of the device, as reported after the last
+	 * chunk [us].
+	 */
+	MetricGauge latency;
+
+	/**
+	 * The last value of #sync_error, for the "metrics" command.
+	 */
+	MetricGauge sync_error_metric;
+
+	/**
+	 * The number of frames dropped, duplicated or inserted to
+	 * stay synchronised.
+	 */
+	MetricCounter sync_frames;
+
 	/**
 	 * If not nullptr, the device has failed, and this timer is used
 	 * to estimate how long it should stay disabled (unless
@@ -159,6 +269,12 @@ struct AudioOutput {
 	 */
 	AudioFormat config_audio_format;
 
+	/**
+	 * The name of the resampler profile selected with the
+	 * "resampler" setting, or nullptr for the default profile.
+	 */
+	const char *resampler_profile;
+
 	/**
 	 * The audio_format in which audio data is received from the
 	 * player thread (which in turn receives it from the decoder).
@@ -214,6 +330,16 @@ struct AudioOutput {
 	 */
 	unsigned other_replay_gain_serial;
 
+	/**
+	 * The software mixer's volume filter, if it is the first
+	 * item in the filter chain (i.e. there is no volume
+	 * normalization and there are no "filters" before it).  The
+	 * replay gain of a chunk which is not being cross-faded is
+	 * then folded into this filter instead of being applied by
+	 * #replay_gain_filter, so the samples are scaled only once.
+	 */
+	Filter *volume_filter;
+
 	/**
 	 * The convert_filter_plugin instance of this audio output.
 	 * It is the last item in the filter chain, and is responsible
@@ -222,6 +348,22 @@ struct AudioOutput {
 	 */
 	Filter *convert_filter;
 
+	/**
+	 * Does the filter chain contain filters other than
+	 * #convert_filter (e.g. "filters", volume normalization or a
+	 * software mixer)?  If not, the conversion may be shared with
+	 * other outputs, see #shared_convert.
+	 */
+	bool private_filters;
+
+	/**
+	 * The converter shared with other audio outputs which have
+	 * the same configured audio format, or nullptr if conversion
+	 * is only done by #convert_filter.  This object holds a
+	 * reference.
+	 */
+	SharedConvert *shared_convert;
+
 	/**
 	 * The thread handle, or nullptr if the output thread isn't
 	 * running.
@@ -239,8 +381,8 @@ struct AudioOutput {
 	const MusicPipe *pipe;
 
 	/**
-	 * This mutex protects #open, #fail_timer, #current_chunk and
-	 * #current_chunk_finished.
+	 * This mutex protects #open, #fail_timer, #current_chunk,
+	 * #current_chunk_finished and #skip_chunk.
 	 */
 	Mutex mutex;
 
@@ -269,6 +411,14 @@ struct AudioOutput {
 	 */
 	bool current_chunk_finished;
 
+	/**
+	 * If not nullptr, then the player has found this "lossy"
+	 * output lagging behind the others; it shall continue after
+	 * this chunk, skipping all chunks before.  This is always a
+	 * chunk after #current_chunk.
+	 */
+	const music_chunk *skip_chunk;
+
 	AudioOutput(const AudioOutputPlugin &_plugin);
 	~AudioOutput();
 
@@ -394,6 +544,25 @@ private:
 	 */
 	bool WaitForDelay();
 
+	/**
+	 * Wait until #batch_chunks chunks have been queued, until
+	 * the batch timeout expires or until a command is received.
+	 */
+	void WaitForBatch();
+
+	/**
+	 * Drop, duplicate or insert frames to correct #sync_error.
+	 * The data is in #out_audio_format.
+	 */
+	const void *SyncCorrect(const void *data, size_t *size_r);
+
+	/**
+	 * Report the stream position which is being heard right now
+	 * to #sync_clock, after the given chunk has been passed to
+	 * the plugin.
+	 */
+	void SyncReport(const music_chunk &chunk);
+
 	gcc_pure
 	const music_chunk *GetNextChunk() const;
 
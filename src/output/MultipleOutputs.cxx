@@ -20,7 +20,9 @@
 #include "config.h"
 #include "MultipleOutputs.hxx"
 #include "PlayerControl.hxx"
+#include "Partition.hxx"
 #include "Internal.hxx"
+#include "SharedConvert.hxx"
 #include "Domain.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicPipe.hxx"
@@ -31,15 +33,28 @@
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "notify.hxx"
+#include "Metrics.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <iterator>
 
 #include <assert.h>
 #include <string.h>
 
+/**
+ * How many chunks the slowest regular output may be ahead of a
+ * "lossy" output before the latter is told to skip.  The player
+ * keeps only 64 chunks in the pipe (see Player::PlayNextChunk()),
+ * so beyond this, the regular outputs would soon run out of data.
+ */
+static constexpr unsigned LOSSY_MAX_LAG = 32;
+
 MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener)
 	:mixer_listener(_mixer_listener),
 	 input_audio_format(AudioFormat::Undefined()),
-	 buffer(nullptr), pipe(nullptr),
-	 elapsed_time(-1)
+	 buffer(nullptr), chunk_cache(nullptr), pipe(nullptr),
+	 elapsed_time(-1), stream_time(0)
 {
 }
 
@@ -49,6 +64,9 @@ MultipleOutputs::~MultipleOutputs()
 		i->LockDisableWait();
 		i->Finish();
 	}
+
+	for (auto i : shared_converts)
+		i->Unref();
 }
 
 static AudioOutput *
@@ -72,26 +90,105 @@ LoadOutput(EventLoop &event_loop, MixerListener &mixer_listener,
 }
 
 void
-MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc)
+MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc,
+			   const char *partition_name)
 {
-	for (const config_param *param = config_get_param(CONF_AUDIO_OUTPUT);
+	const config_param *first = config_get_param(CONF_AUDIO_OUTPUT);
+
+	for (const config_param *param = first;
 	     param != nullptr; param = param->next) {
+		const char *p = param->GetBlockValue("partition",
+						     Partition::DEFAULT_NAME);
+		if (strcmp(p, partition_name) != 0)
+			continue;
+
 		auto output = LoadOutput(event_loop, mixer_listener,
 					 pc, *param);
 		if (FindByName(output->name) != nullptr)
 			FormatFatalError("output devices with identical "
 					 "names: %s", output->name);
 
+		if (param->GetBlockValue("sync", false)) {
+			output->sync_clock = &sync_clock;
+			output->sync_slot = sync_clock.Add();
+		}
+
 		outputs.push_back(output);
 	}
 
-	if (outputs.empty()) {
+	if (first == nullptr) {
 		/* auto-detect device */
 		const config_param empty;
 		auto output = LoadOutput(event_loop, mixer_listener,
 					 pc, empty);
 		outputs.push_back(output);
 	}
+
+	SetupSharedConvert();
+}
+
+gcc_pure
+static bool
+CanShareConvert(const AudioOutput &ao)
+{
+	return !ao.private_filters &&
+		ao.config_audio_format.IsFullyDefined();
+}
+
+gcc_pure
+static bool
+IsSameResamplerProfile(const AudioOutput &a, const AudioOutput &b)
+{
+	if (a.resampler_profile == nullptr || b.resampler_profile == nullptr)
+		return a.resampler_profile == b.resampler_profile;
+
+	return strcmp(a.resampler_profile, b.resampler_profile) == 0;
+}
+
+void
+MultipleOutputs::SetupSharedConvert()
+{
+	for (auto i = outputs.begin(), end = outputs.end(); i != end; ++i) {
+		AudioOutput &ao = **i;
+		if (ao.shared_convert != nullptr || !CanShareConvert(ao))
+			continue;
+
+		SharedConvert *sc = nullptr;
+		for (auto j = std::next(i); j != end; ++j) {
+			AudioOutput &other = **j;
+			if (!CanShareConvert(other) ||
+			    other.config_audio_format != ao.config_audio_format ||
+			    !IsSameResamplerProfile(other, ao))
+				continue;
+
+			if (sc == nullptr) {
+				sc = new SharedConvert(ao.config_audio_format,
+						       ao.resampler_profile);
+				shared_converts.push_back(sc);
+
+				sc->Ref();
+				ao.shared_convert = sc;
+
+				FormatDebug(output_domain,
+					    "sharing conversion of output \"%s\"",
+					    ao.name);
+			}
+
+			sc->Ref();
+			other.shared_convert = sc;
+
+			FormatDebug(output_domain,
+				    "sharing conversion of output \"%s\"",
+				    other.name);
+		}
+	}
+}
+
+void
+MultipleOutputs::ClearSharedConvert()
+{
+	for (auto i : shared_converts)
+		i->Clear();
 }
 
 AudioOutput *
@@ -186,6 +283,20 @@ MultipleOutputs::SetReplayGainMode(ReplayGainMode mode)
 		ao->SetReplayGainMode(mode);
 }
 
+/**
+ * Returns the number of bytes an output plays from this chunk; this
+ * mirrors the cross-fading code in ao_filter_chunk().
+ */
+gcc_pure
+static size_t
+GetPlayedLength(const music_chunk &chunk)
+{
+	if (chunk.length == 0 || chunk.other == nullptr)
+		return chunk.length;
+
+	return chunk.other->length;
+}
+
 bool
 MultipleOutputs::Play(music_chunk *chunk, Error &error)
 {
@@ -200,6 +311,10 @@ MultipleOutputs::Play(music_chunk *chunk, Error &error)
 		return false;
 	}
 
+	stream_time += GetPlayedLength(*chunk) * 1000000. /
+		input_audio_format.GetTimeToSize();
+	chunk->stream_time = uint64_t(stream_time);
+
 	pipe->Push(chunk);
 
 	for (auto ao : outputs)
@@ -220,6 +335,9 @@ MultipleOutputs::Open(const AudioFormat audio_format,
 
 	buffer = &_buffer;
 
+	if (chunk_cache == nullptr)
+		chunk_cache = new MusicBufferCache(_buffer);
+
 	/* the audio format must be the same as existing chunks in the
 	   pipe */
 	assert(pipe == nullptr || pipe->CheckFormat(audio_format));
@@ -296,6 +414,62 @@ MultipleOutputs::IsChunkConsumed(const music_chunk *chunk) const
 	return true;
 }
 
+inline void
+MultipleOutputs::SkipLossyOutputs(const music_chunk *head)
+{
+	if (std::none_of(outputs.begin(), outputs.end(),
+			 [](const AudioOutput *ao){ return ao->lossy; }))
+		return;
+
+	/* collect the positions of all regular outputs; all of them
+	   must be done with the head chunk */
+	const music_chunk *positions[outputs.size()];
+	unsigned n_positions = 0;
+
+	for (auto ao : outputs) {
+		if (ao->lossy)
+			continue;
+
+		const ScopeLock protect(ao->mutex);
+		if (!ao->open)
+			continue;
+
+		if (!chunk_is_consumed_in(ao, pipe, head))
+			return;
+
+		positions[n_positions++] = ao->current_chunk;
+	}
+
+	if (n_positions == 0)
+		return;
+
+	/* find the slowest regular output; everything between the
+	   head and its position remains in the pipe while a lossy
+	   output holds the head */
+	const auto end = positions + n_positions;
+	const music_chunk *target = head;
+	unsigned lag = 0;
+	while (std::find(positions, end, target) == end) {
+		target = target->next;
+		if (target == nullptr)
+			return;
+
+		++lag;
+	}
+
+	if (lag < LOSSY_MAX_LAG)
+		return;
+
+	for (auto ao : outputs) {
+		if (!ao->lossy)
+			continue;
+
+		const ScopeLock protect(ao->mutex);
+		if (!chunk_is_consumed_in(ao, pipe, head))
+			ao->skip_chunk = target;
+	}
+}
+
 inline void
 MultipleOutputs::ClearTailChunk(gcc_unused const struct music_chunk *chunk,
 				bool *locked)
@@ -318,6 +492,7 @@ MultipleOutputs::ClearTailChunk(gcc_unused const struct music_chunk *chunk,
 
 		assert(ao->current_chunk == chunk);
 		assert(ao->current_chunk_finished);
+		assert(ao->skip_chunk == nullptr);
 		ao->current_chunk = nullptr;
 	}
 }
@@ -336,10 +511,13 @@ MultipleOutputs::Check()
 	while ((chunk = pipe->Peek()) != nullptr) {
 		assert(!pipe->IsEmpty());
 
-		if (!IsChunkConsumed(chunk))
+		if (!IsChunkConsumed(chunk)) {
 			/* at least one output is not finished playing
-			   this chunk */
+			   this chunk; if only "lossy" outputs are, they
+			   may have to skip ahead */
+			SkipLossyOutputs(chunk);
 			return pipe->GetSize();
+		}
 
 		if (chunk->length > 0 && chunk->times >= 0.0)
 			/* only update elapsed_time if the chunk
@@ -363,8 +541,12 @@ MultipleOutputs::Check()
 				if (locked[i])
 					outputs[i]->mutex.unlock();
 
-		/* return the chunk to the buffer */
-		buffer->Return(shifted);
+		/* drop the shared conversion results and return the
+		   chunk to the buffer */
+		for (auto i : shared_converts)
+			i->Forget(shifted);
+
+		chunk_cache->Return(shifted);
 	}
 
 	return 0;
@@ -395,6 +577,8 @@ MultipleOutputs::Pause()
 		ao->LockPauseAsync();
 
 	WaitAll();
+
+	sync_clock.Reset();
 }
 
 void
@@ -421,6 +605,13 @@ MultipleOutputs::Cancel()
 	if (pipe != nullptr)
 		pipe->Clear(*buffer);
 
+	ClearSharedConvert();
+
+	if (chunk_cache != nullptr)
+		chunk_cache->Flush();
+
+	sync_clock.Reset();
+
 	/* the audio outputs are now waiting for a signal, to
 	   synchronize the cleared music pipe */
 
@@ -445,11 +636,18 @@ MultipleOutputs::Close()
 		pipe = nullptr;
 	}
 
+	ClearSharedConvert();
+
+	delete chunk_cache;
+	chunk_cache = nullptr;
+
 	buffer = nullptr;
 
 	input_audio_format.Clear();
 
 	elapsed_time = -1.0;
+
+	sync_clock.Reset();
 }
 
 void
@@ -466,11 +664,18 @@ MultipleOutputs::Release()
 		pipe = nullptr;
 	}
 
+	ClearSharedConvert();
+
+	delete chunk_cache;
+	chunk_cache = nullptr;
+
 	buffer = nullptr;
 
 	input_audio_format.Clear();
 
 	elapsed_time = -1.0;
+
+	sync_clock.Reset();
 }
 
 void
@@ -480,3 +685,52 @@ MultipleOutputs::SongBorder()
 	   song */
 	elapsed_time = 0.0;
 }
+
+void
+MultipleOutputs::VisitMetrics(MetricsVisitor &visitor) const
+{
+	for (const auto ao : outputs)
+		visitor.OnCounter("output_underruns",
+				  "Number of times an output has run out of chunks",
+				  MetricLabel("output", ao->name),
+				  ao->underruns.Get());
+
+	for (const auto ao : outputs)
+		if (ao->lossy)
+			visitor.OnCounter("output_skips",
+					  "Number of times a lossy output has skipped ahead",
+					  MetricLabel("output", ao->name),
+					  ao->skips.Get());
+
+	for (const auto ao : outputs)
+		visitor.OnCounter("output_dropped_bytes",
+				  "Number of bytes discarded by an output because its reader was too slow",
+				  MetricLabel("output", ao->name),
+				  ao->dropped_bytes.Get());
+
+	for (const auto ao : outputs)
+		visitor.OnHistogram("output_play_latency_us",
+				    "Duration of each play() call of an output plugin",
+				    MetricLabel("output", ao->name),
+				    ao->play_latency);
+
+	for (const auto ao : outputs)
+		visitor.OnGauge("output_latency_us",
+				"Latency reported by an output plugin",
+				MetricLabel("output", ao->name),
+				ao->latency.Get());
+
+	for (const auto ao : outputs)
+		if (ao->sync_clock != nullptr)
+			visitor.OnGauge("output_sync_error_us",
+					"Deviation of an output from the shared playback clock",
+					MetricLabel("output", ao->name),
+					ao->sync_error_metric.Get());
+
+	for (const auto ao : outputs)
+		if (ao->sync_clock != nullptr)
+			visitor.OnCounter("output_sync_frames",
+					  "Frames dropped, duplicated or inserted to keep an output synchronised",
+					  MetricLabel("output", ao->name),
+					  ao->sync_frames.Get());
+}
@@ -28,6 +28,7 @@
 
 #include "AudioFormat.hxx"
 #include "ReplayGainInfo.hxx"
+#include "OutputSync.hxx"
 #include "Compiler.h"
 
 #include <vector>
@@ -36,19 +37,29 @@
 
 struct AudioFormat;
 class MusicBuffer;
+class MusicBufferCache;
 class MusicPipe;
 class EventLoop;
 class MixerListener;
 struct music_chunk;
 struct PlayerControl;
 struct AudioOutput;
+class SharedConvert;
 class Error;
+class MetricsVisitor;
 
 class MultipleOutputs {
 	MixerListener &mixer_listener;
 
 	std::vector<AudioOutput *> outputs;
 
+	/**
+	 * Converters shared by outputs with the same configured audio
+	 * format; see AudioOutput::shared_convert.  This object holds
+	 * a reference to each of them.
+	 */
+	std::vector<SharedConvert *> shared_converts;
+
 	AudioFormat input_audio_format;
 
 	/**
@@ -56,6 +67,13 @@ class MultipleOutputs {
 	 */
 	MusicBuffer *buffer;
 
+	/**
+	 * Consumed chunks go through this cache, to avoid locking
+	 * the #MusicBuffer for each one.  It is only used by the
+	 * player thread, and is flushed when the pipe is cleared.
+	 */
+	MusicBufferCache *chunk_cache;
+
 	/**
 	 * The #MusicPipe object which feeds all audio outputs.  It is
 	 * filled by audio_output_all_play().
@@ -68,6 +86,18 @@ class MultipleOutputs {
 	 */
 	float elapsed_time;
 
+	/**
+	 * The clock shared by all outputs with the "sync" setting.
+	 */
+	OutputSyncClock sync_clock;
+
+	/**
+	 * The end of the most recent chunk passed to Play(), see
+	 * music_chunk::stream_time [us].  This is a floating point
+	 * value to avoid accumulating rounding errors.
+	 */
+	double stream_time;
+
 public:
 	/**
 	 * Load audio outputs from the configuration file and
@@ -76,7 +106,15 @@ public:
 	MultipleOutputs(MixerListener &_mixer_listener);
 	~MultipleOutputs();
 
-	void Configure(EventLoop &event_loop, PlayerControl &pc);
+	/**
+	 * Load the audio outputs which belong to the given partition
+	 * (the "partition" setting of the "audio_output" block,
+	 * defaulting to Partition::DEFAULT_NAME).  An output is
+	 * auto-detected only if there are no "audio_output" blocks
+	 * at all.
+	 */
+	void Configure(EventLoop &event_loop, PlayerControl &pc,
+		       const char *partition_name);
 
 	/**
 	 * Returns the total number of audio output devices, including
@@ -109,6 +147,12 @@ public:
 	gcc_pure
 	AudioOutput *FindByName(const char *name) const;
 
+	/**
+	 * Visit the metrics of all audio outputs, labelled with their
+	 * names.
+	 */
+	void VisitMetrics(MetricsVisitor &visitor) const;
+
 	/**
 	 * Checks the "enabled" flag of all audio outputs, and if one has
 	 * changed, commit the change.
@@ -230,6 +274,18 @@ public:
 	void SetSoftwareVolume(unsigned volume);
 
 private:
+	/**
+	 * Group the audio outputs which can share their conversion
+	 * (same fully defined "format" and no private filters).
+	 */
+	void SetupSharedConvert();
+
+	/**
+	 * Discard all shared conversion results, after the
+	 * #MusicPipe has been cleared.
+	 */
+	void ClearSharedConvert();
+
 	/**
 	 * Determine if all (active) outputs have finished the current
 	 * command.
@@ -264,6 +320,14 @@ private:
 	 */
 	bool IsChunkConsumed(const music_chunk *chunk) const;
 
+	/**
+	 * The head chunk has not been consumed by all audio outputs.
+	 * If only "lossy" outputs are still using it, and the regular
+	 * outputs are too far ahead, tell the lossy ones to skip to
+	 * the position of the slowest regular output.
+	 */
+	void SkipLossyOutputs(const music_chunk *head);
+
 	/**
 	 * There's only one chunk left in the pipe (#pipe), and all
 	 * audio outputs have consumed it already.  Clear the
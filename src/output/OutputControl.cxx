@@ -125,6 +125,7 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 
 		if (pause) {
 			current_chunk = nullptr;
+			skip_chunk = nullptr;
 			pipe = &mp;
 
 			/* unpause with the CANCEL command; this is a
@@ -142,6 +143,7 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 
 	in_audio_format = audio_format;
 	current_chunk = nullptr;
+	skip_chunk = nullptr;
 
 	pipe = &mp;
 
@@ -201,7 +203,15 @@ AudioOutput::LockPlay()
 	assert(allow_play);
 
 	if (IsOpen() && !in_playback_loop && !woken_for_play) {
-		woken_for_play = true;
+		++pending_chunks;
+
+		if (pending_chunks >= batch_chunks)
+			woken_for_play = true;
+		else if (pending_chunks > 1)
+			/* the OutputThread is already waiting for
+			   this batch in WaitForBatch() */
+			return;
+
 		cond.signal();
 	}
 }
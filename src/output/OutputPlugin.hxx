@@ -103,6 +103,17 @@ struct AudioOutputPlugin {
 	 */
 	unsigned (*delay)(AudioOutput *data);
 
+	/**
+	 * Returns the time it takes until data which is passed to
+	 * play() now will be heard, i.e. the amount of audio which is
+	 * buffered in the device.  This is used to synchronise
+	 * multiple outputs.  Optional method; if it is not
+	 * implemented, the latency is assumed to be zero.
+	 *
+	 * @return the latency in microseconds
+	 */
+	unsigned (*latency)(AudioOutput *data);
+
 	/**
 	 * Display metadata for the next chunk.  Optional method,
 	 * because not all devices can display metadata.
@@ -185,6 +196,10 @@ gcc_pure
 unsigned
 ao_plugin_delay(AudioOutput *ao);
 
+gcc_pure
+unsigned
+ao_plugin_latency(AudioOutput *ao);
+
 void
 ao_plugin_send_tag(AudioOutput *ao, const Tag *tag);
 
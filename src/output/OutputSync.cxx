@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "OutputSync.hxx"
+#include "pcm/PcmBuffer.hxx"
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+/**
+ * Reports older than this are not considered, e.g. because the
+ * output has been paused or closed meanwhile [us].
+ */
+static constexpr uint64_t SYNC_STALE_US = 500000;
+
+void
+OutputSyncClock::Reset()
+{
+	const ScopeLock protect(mutex);
+
+	for (auto &i : slots)
+		i.time = 0;
+}
+
+int64_t
+OutputSyncClock::Report(unsigned slot, uint64_t stream_time, uint64_t now)
+{
+	assert(slot < slots.size());
+
+	const int64_t offset = int64_t(stream_time) - int64_t(now);
+
+	const ScopeLock protect(mutex);
+
+	Slot &s = slots[slot];
+	s.offset = offset;
+	s.time = now;
+
+	int64_t sum = 0;
+	unsigned n = 0;
+	for (const auto &i : slots) {
+		if (i.time == 0 || now - i.time > SYNC_STALE_US)
+			continue;
+
+		sum += i.offset;
+		++n;
+	}
+
+	assert(n > 0);
+
+	return offset - sum / int64_t(n);
+}
+
+const void *
+pcm_sync_stretch(PcmBuffer &buffer, const void *_src, size_t size,
+		 size_t frame_size, int delta, size_t *size_r)
+{
+	assert(size % frame_size == 0);
+
+	const size_t n_frames = size / frame_size;
+	assert(size_t(abs(delta)) < n_frames);
+
+	if (delta == 0) {
+		*size_r = size;
+		return _src;
+	}
+
+	const size_t dest_frames = n_frames + delta;
+	const uint8_t *src = (const uint8_t *)_src;
+	uint8_t *const dest0 = (uint8_t *)buffer.Get(dest_frames * frame_size);
+	uint8_t *dest = dest0;
+
+	/* one frame is dropped or duplicated at the end of each
+	   segment */
+	const unsigned count = abs(delta);
+	const size_t segment = n_frames / count;
+
+	for (unsigned i = 0; i < count; ++i) {
+		size_t copy = segment;
+		if (delta < 0)
+			/* skip the last frame of this segment */
+			--copy;
+
+		memcpy(dest, src, copy * frame_size);
+		dest += copy * frame_size;
+
+		if (delta > 0) {
+			/* repeat the last frame of this segment */
+			memcpy(dest, dest - frame_size, frame_size);
+			dest += frame_size;
+		}
+
+		src += segment * frame_size;
+	}
+
+	/* the remainder */
+	const size_t rest = (const uint8_t *)_src + size - src;
+	memcpy(dest, src, rest);
+	dest += rest;
+
+	assert(size_t(dest - dest0) == dest_frames * frame_size);
+
+	*size_r = dest_frames * frame_size;
+	return dest0;
+}
+
+const void *
+pcm_sync_pad(PcmBuffer &buffer, const void *src, size_t size,
+	     size_t frame_size, unsigned frames, size_t *size_r)
+{
+	const size_t silence = frames * frame_size;
+
+	uint8_t *dest = (uint8_t *)buffer.Get(silence + size);
+	memset(dest, 0, silence);
+	memcpy(dest + silence, src, size);
+
+	*size_r = silence + size;
+	return dest;
+}
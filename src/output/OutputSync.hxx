@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_SYNC_HXX
+#define MPD_OUTPUT_SYNC_HXX
+
+#include "thread/Mutex.hxx"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class PcmBuffer;
+
+/**
+ * A playback clock shared by those outputs of one #MultipleOutputs
+ * which have the "sync" setting.  After each chunk, every output
+ * reports which position of the stream is being heard right now
+ * (the stream time of the data it has written minus the latency of
+ * the device).  The clock is the average of all recent reports, and
+ * each output corrects its own rate towards it.
+ */
+class OutputSyncClock {
+	struct Slot {
+		/**
+		 * The stream time minus the monotonic clock at the
+		 * time of the last report [us].
+		 */
+		int64_t offset;
+
+		/**
+		 * When was #offset reported?  0 means never.
+		 */
+		uint64_t time;
+
+		Slot():offset(0), time(0) {}
+	};
+
+	Mutex mutex;
+
+	std::vector<Slot> slots;
+
+public:
+	/**
+	 * Register a new output.  This must be called before the
+	 * output threads are started.
+	 *
+	 * @return the slot number to be passed to Report()
+	 */
+	unsigned Add() {
+		slots.emplace_back();
+		return slots.size() - 1;
+	}
+
+	/**
+	 * Forget all reports, because playback has been interrupted
+	 * (e.g. paused or cancelled), and the old reports are not
+	 * comparable with new ones.
+	 */
+	void Reset();
+
+	/**
+	 * Report the stream position which is being heard right now
+	 * on the given output.
+	 *
+	 * @param stream_time the stream position [us]
+	 * @param now the current monotonic clock [us]
+	 * @return the deviation of this output from the shared clock
+	 * [us]; positive if this output is ahead
+	 */
+	int64_t Report(unsigned slot, uint64_t stream_time, uint64_t now);
+};
+
+/**
+ * Drop (negative @a delta) or duplicate (positive @a delta) frames,
+ * spread evenly over the buffer.
+ *
+ * @param delta the number of frames to drop or duplicate; its
+ * absolute value must be smaller than the number of frames
+ * @return the new buffer (either @a src or allocated from @a buffer)
+ */
+const void *
+pcm_sync_stretch(PcmBuffer &buffer, const void *src, size_t size,
+		 size_t frame_size, int delta, size_t *size_r);
+
+/**
+ * Insert silence (zero samples) before the given buffer.
+ */
+const void *
+pcm_sync_pad(PcmBuffer &buffer, const void *src, size_t size,
+	     size_t frame_size, unsigned frames, size_t *size_r);
+
+#endif
@@ -19,25 +19,35 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "SharedConvert.hxx"
+#include "OutputSync.hxx"
 #include "OutputAPI.hxx"
 #include "Domain.hxx"
 #include "pcm/PcmMix.hxx"
+#include "pcm/Volume.hxx"
 #include "notify.hxx"
 #include "filter/FilterInternal.hxx"
 #include "filter/plugins/ConvertFilterPlugin.hxx"
 #include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "filter/plugins/VolumeFilterPlugin.hxx"
 #include "PlayerControl.hxx"
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
+#include "Trace.hxx"
 #include "thread/Util.hxx"
 #include "thread/Slack.hxx"
+#include "thread/Policy.hxx"
 #include "thread/Name.hxx"
 #include "system/FatalError.hxx"
+#include "system/Clock.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 #include "Compiler.h"
 
+#include <algorithm>
+
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 void
@@ -139,6 +149,7 @@ AudioOutput::Open()
 	assert(in_audio_format.IsValid());
 
 	fail_timer.Reset();
+	sync_error = 0;
 
 	/* enable the device (just in case the last enable has failed) */
 
@@ -209,6 +220,7 @@ AudioOutput::Close(bool drain)
 	pipe = nullptr;
 
 	current_chunk = nullptr;
+	skip_chunk = nullptr;
 	open = false;
 
 	mutex.unlock();
@@ -249,6 +261,7 @@ AudioOutput::ReopenFilter()
 		pipe = nullptr;
 
 		current_chunk = nullptr;
+		skip_chunk = nullptr;
 		open = false;
 		fail_timer.Update();
 
@@ -260,10 +273,24 @@ AudioOutput::ReopenFilter()
 	}
 }
 
+/**
+ * Can the device stay open in its current format after the input
+ * format has changed ("keep_format")?  Conversion from and to DSD is
+ * not possible, so those devices are reopened.
+ */
+gcc_pure
+static bool
+CanKeepFormat(const AudioOutput &ao)
+{
+	return ao.keep_format && ao.open &&
+		ao.in_audio_format.format != SampleFormat::DSD &&
+		ao.out_audio_format.format != SampleFormat::DSD;
+}
+
 void
 AudioOutput::Reopen()
 {
-	if (!config_audio_format.IsFullyDefined()) {
+	if (!config_audio_format.IsFullyDefined() && !CanKeepFormat(*this)) {
 		if (open) {
 			const MusicPipe *mp = pipe;
 			Close(true);
@@ -306,10 +333,39 @@ AudioOutput::WaitForDelay()
 	}
 }
 
+/**
+ * The maximum time the OutputThread waits for a batch of chunks to
+ * be completed.  This bounds the added latency, and guarantees
+ * progress when the player stops adding chunks (e.g. at the end of
+ * the queue).
+ */
+static constexpr unsigned BATCH_TIMEOUT_MS = 50;
+
+inline void
+AudioOutput::WaitForBatch()
+{
+	const unsigned start = MonotonicClockMS();
+
+	while (pending_chunks < batch_chunks &&
+	       command == AO_COMMAND_NONE) {
+		const unsigned elapsed = MonotonicClockMS() - start;
+		if (elapsed >= BATCH_TIMEOUT_MS)
+			break;
+
+		(void)cond.timed_wait(mutex, BATCH_TIMEOUT_MS - elapsed);
+	}
+}
+
+/**
+ * @param volume_filter if not nullptr, then the replay gain is not
+ * applied here, but folded into this volume filter (which is applied
+ * later by the filter chain)
+ */
 static const void *
 ao_chunk_data(AudioOutput *ao, const struct music_chunk *chunk,
 	      Filter *replay_gain_filter,
 	      unsigned *replay_gain_serial_p,
+	      Filter *volume_filter,
 	      size_t *length_r)
 {
 	assert(chunk != nullptr);
@@ -332,13 +388,24 @@ ao_chunk_data(AudioOutput *ao, const struct music_chunk *chunk,
 			*replay_gain_serial_p = chunk->replay_gain_serial;
 		}
 
-		Error error;
-		data = replay_gain_filter->FilterPCM(data, length,
-						     &length, error);
-		if (data == nullptr) {
-			FormatError(error, "\"%s\" [%s] failed to filter",
-				    ao->name, ao->plugin.name);
-			return nullptr;
+		unsigned gain;
+		bool dither;
+		if (volume_filter != nullptr &&
+		    replay_gain_filter->GetGain(gain, dither)) {
+			/* combine replay gain and software volume;
+			   if the product is unity, the filter chain
+			   will skip it */
+			volume_filter_set_gain(volume_filter, gain);
+		} else if (!replay_gain_filter->IsPassThrough()) {
+			Error error;
+			data = replay_gain_filter->FilterPCM(data, length,
+							     &length, error);
+			if (data == nullptr) {
+				FormatError(error,
+					    "\"%s\" [%s] failed to filter",
+					    ao->name, ao->plugin.name);
+				return nullptr;
+			}
 		}
 	}
 
@@ -350,9 +417,19 @@ static const void *
 ao_filter_chunk(AudioOutput *ao, const struct music_chunk *chunk,
 		size_t *length_r)
 {
+	/* fold replay gain into the software volume, unless
+	   cross-fading (the two chunks have different replay gain,
+	   and are mixed before the filter chain runs) */
+	Filter *volume_filter = ao->volume_filter;
+	if (volume_filter != nullptr && chunk->other != nullptr) {
+		volume_filter_set_gain(volume_filter, PCM_VOLUME_1);
+		volume_filter = nullptr;
+	}
+
 	size_t length;
 	const void *data = ao_chunk_data(ao, chunk, ao->replay_gain_filter,
-					 &ao->replay_gain_serial, &length);
+					 &ao->replay_gain_serial,
+					 volume_filter, &length);
 	if (data == nullptr)
 		return nullptr;
 
@@ -370,7 +447,7 @@ ao_filter_chunk(AudioOutput *ao, const struct music_chunk *chunk,
 			ao_chunk_data(ao, chunk->other,
 				      ao->other_replay_gain_filter,
 				      &ao->other_replay_gain_serial,
-				      &other_length);
+				      nullptr, &other_length);
 		if (other_data == nullptr)
 			return nullptr;
 
@@ -402,9 +479,36 @@ ao_filter_chunk(AudioOutput *ao, const struct music_chunk *chunk,
 		length = other_length;
 	}
 
-	/* apply filter chain */
+	/* apply filter chain; skip it if it would not modify the
+	   data, so the chunk is passed directly to the plugin */
+
+	if (ao->filter->IsPassThrough()) {
+		*length_r = length;
+		return data;
+	}
 
 	Error error;
+
+	/* if this output shares its conversion with others, and
+	   the chunk is unmodified (no replay gain, no cross-fade),
+	   the result of another output's conversion can be reused */
+
+	if (ao->shared_convert != nullptr && data == chunk->data) {
+		const void *converted =
+			ao->shared_convert->Convert(*chunk,
+						    ao->in_audio_format,
+						    ao->out_audio_format,
+						    length_r, error);
+		if (converted != nullptr)
+			return converted;
+
+		if (error.IsDefined()) {
+			FormatError(error, "\"%s\" [%s] failed to convert",
+				    ao->name, ao->plugin.name);
+			return nullptr;
+		}
+	}
+
 	data = ao->filter->FilterPCM(data, length, &length, error);
 	if (data == nullptr) {
 		FormatError(error, "\"%s\" [%s] failed to filter",
@@ -416,6 +520,99 @@ ao_filter_chunk(AudioOutput *ao, const struct music_chunk *chunk,
 	return data;
 }
 
+/**
+ * Deviations from the shared clock below this are ignored [us].
+ */
+static constexpr int64_t SYNC_DEADBAND_US = 500;
+
+/**
+ * Deviations from the shared clock above this are corrected at once
+ * by skipping frames or by inserting silence; smaller ones are
+ * corrected gradually [us].
+ */
+static constexpr int64_t SYNC_STEP_US = 20000;
+
+/**
+ * The gradual correction drops or duplicates at most one frame per
+ * this number of frames.
+ */
+static constexpr size_t SYNC_MAX_RATE = 500;
+
+inline const void *
+AudioOutput::SyncCorrect(const void *data, size_t *size_r)
+{
+	const int64_t error = sync_error;
+	if (error > -SYNC_DEADBAND_US && error < SYNC_DEADBAND_US)
+		return data;
+
+	if (out_audio_format.format == SampleFormat::DSD)
+		/* DSD data cannot be stretched or padded */
+		return data;
+
+	const size_t frame_size = out_audio_format.GetFrameSize();
+	const size_t n_frames = *size_r / frame_size;
+
+	/* the number of frames this output is ahead (positive) or
+	   behind (negative) */
+	const int64_t frames =
+		error * int64_t(out_audio_format.sample_rate) / 1000000;
+	if (frames == 0 || n_frames == 0)
+		return data;
+
+	/* the next report will measure the effect of this
+	   correction */
+	sync_error = 0;
+
+	if (error >= SYNC_STEP_US) {
+		/* far ahead: insert at most one second of silence */
+		const unsigned pad =
+			std::min<int64_t>(frames, out_audio_format.sample_rate);
+		sync_frames.Add(pad);
+		return pcm_sync_pad(sync_buffer, data, *size_r,
+				    frame_size, pad, size_r);
+	}
+
+	if (error <= -SYNC_STEP_US) {
+		/* far behind: skip frames */
+		const size_t skip = std::min<int64_t>(-frames, n_frames);
+		sync_frames.Add(skip);
+		*size_r -= skip * frame_size;
+		return (const uint8_t *)data + skip * frame_size;
+	}
+
+	/* gradually drop or duplicate single frames */
+	const int64_t max = std::max<size_t>(n_frames / SYNC_MAX_RATE, 1);
+	const int delta = std::max(-max, std::min(frames, max));
+	if (size_t(abs(delta)) >= n_frames)
+		return data;
+
+	sync_frames.Add(abs(delta));
+	return pcm_sync_stretch(sync_buffer, data, *size_r,
+				frame_size, delta, size_r);
+}
+
+inline void
+AudioOutput::SyncReport(const music_chunk &chunk)
+{
+	assert(sync_clock != nullptr);
+
+	mutex.unlock();
+	const uint64_t delay = uint64_t(ao_plugin_latency(this)) +
+		latency_offset;
+	const uint64_t now = MonotonicClockUS();
+	mutex.lock();
+
+	latency.Set(delay);
+
+	if (chunk.stream_time < delay)
+		/* not a single chunk has been heard yet */
+		return;
+
+	sync_error = sync_clock->Report(sync_slot, chunk.stream_time - delay,
+					now);
+	sync_error_metric.Set(sync_error);
+}
+
 inline bool
 AudioOutput::PlayChunk(const music_chunk *chunk)
 {
@@ -442,16 +639,26 @@ AudioOutput::PlayChunk(const music_chunk *chunk)
 		return false;
 	}
 
+	if (sync_clock != nullptr)
+		data = (const char *)SyncCorrect(data, &size);
+
 	Error error;
 
-	while (size > 0 && command == AO_COMMAND_NONE) {
+	/* a pending skip_chunk request abandons the rest of this
+	   chunk */
+	while (size > 0 && command == AO_COMMAND_NONE &&
+	       skip_chunk == nullptr) {
 		size_t nbytes;
 
 		if (!WaitForDelay())
 			break;
 
 		mutex.unlock();
+		const uint64_t start = MonotonicClockUS();
+		Trace(TraceEvent::OUTPUT_PLAY_BEGIN, TraceObject::OUTPUT, size);
 		nbytes = ao_plugin_play(this, data, size, error);
+		Trace(TraceEvent::OUTPUT_PLAY_END, TraceObject::OUTPUT, nbytes);
+		play_latency.Observe(MonotonicClockUS() - start);
 		mutex.lock();
 		if (nbytes == 0) {
 			/* play()==0 means failure */
@@ -475,6 +682,9 @@ AudioOutput::PlayChunk(const music_chunk *chunk)
 		size -= nbytes;
 	}
 
+	if (sync_clock != nullptr && size == 0)
+		SyncReport(*chunk);
+
 	return true;
 }
 
@@ -494,18 +704,40 @@ AudioOutput::Play()
 	assert(pipe != nullptr);
 
 	const music_chunk *chunk = GetNextChunk();
-	if (chunk == nullptr)
-		/* no chunk available */
+	if (chunk == nullptr) {
+		/* no chunk available; if the previous chunk came
+		   from the same pipe, the player did not keep up */
+		if (current_chunk != nullptr && !starving) {
+			starving = true;
+			underruns.Add();
+			TraceUnderrun(TraceObject::OUTPUT);
+		}
+
 		return false;
+	}
 
+	starving = false;
 	current_chunk_finished = false;
 
 	assert(!in_playback_loop);
 	in_playback_loop = true;
+	pending_chunks = 0;
 
 	while (chunk != nullptr && command == AO_COMMAND_NONE) {
 		assert(!current_chunk_finished);
 
+		if (gcc_unlikely(skip_chunk != nullptr)) {
+			/* this "lossy" output has fallen behind; the
+			   player wants it to jump ahead */
+			current_chunk = skip_chunk;
+			skip_chunk = nullptr;
+			skips.Add();
+
+			chunk = current_chunk->next;
+			if (chunk == nullptr)
+				break;
+		}
+
 		current_chunk = chunk;
 
 		if (!PlayChunk(chunk)) {
@@ -537,6 +769,7 @@ AudioOutput::Pause()
 	mutex.lock();
 
 	pause = true;
+	sync_error = 0;
 	CommandFinished();
 
 	do {
@@ -564,6 +797,10 @@ AudioOutput::Task()
 	SetThreadRealtime();
 	SetThreadTimerSlackUS(100);
 
+	Error policy_error;
+	if (!ApplyThreadPolicy(ThreadClass::OUTPUT, policy_error))
+		LogError(policy_error);
+
 	mutex.lock();
 
 	while (1) {
@@ -631,6 +868,8 @@ AudioOutput::Task()
 
 		case AO_COMMAND_CANCEL:
 			current_chunk = nullptr;
+			skip_chunk = nullptr;
+			sync_error = 0;
 
 			if (open) {
 				mutex.unlock();
@@ -643,18 +882,27 @@ AudioOutput::Task()
 
 		case AO_COMMAND_KILL:
 			current_chunk = nullptr;
+			skip_chunk = nullptr;
 			CommandFinished();
 			mutex.unlock();
 			return;
 		}
 
-		if (open && allow_play && Play())
-			/* don't wait for an event if there are more
-			   chunks in the pipe */
-			continue;
+		if (open && allow_play) {
+			if (pending_chunks > 0 && pending_chunks < batch_chunks)
+				/* woken up by the first chunk of a
+				   batch; wait for the rest */
+				WaitForBatch();
+
+			if (Play())
+				/* don't wait for an event if there
+				   are more chunks in the pipe */
+				continue;
+		}
 
 		if (command == AO_COMMAND_NONE) {
 			woken_for_play = false;
+			pending_chunks = 0;
 			cond.wait(mutex);
 		}
 	}
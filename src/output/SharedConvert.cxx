@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SharedConvert.hxx"
+#include "MusicChunk.hxx"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+SharedConvert::Result::Result(const music_chunk *_chunk,
+			      const void *src, size_t _size)
+	:chunk(_chunk), data(malloc(_size)), size(_size)
+{
+	memcpy(data, src, size);
+}
+
+SharedConvert::Result::~Result()
+{
+	free(data);
+}
+
+SharedConvert::~SharedConvert()
+{
+	results.clear();
+	CloseState();
+}
+
+void
+SharedConvert::CloseState()
+{
+	if (in_format.IsValid()) {
+		state.Close();
+		in_format.Clear();
+		out_format.Clear();
+	}
+}
+
+const void *
+SharedConvert::Convert(const music_chunk &chunk,
+		       AudioFormat src_format, AudioFormat dest_format,
+		       size_t *size_r, Error &error)
+{
+	assert(src_format.IsValid());
+	assert(dest_format.IsValid());
+	assert(chunk.CheckFormat(src_format));
+
+	const ScopeLock protect(mutex);
+
+	if (src_format != in_format || dest_format != out_format) {
+		if (!results.empty())
+			/* another output of this group has opened the
+			   converter with different formats, and its
+			   results are still in use */
+			return nullptr;
+
+		CloseState();
+
+		if (!state.Open(src_format, dest_format, error))
+			return nullptr;
+
+		in_format = src_format;
+		out_format = dest_format;
+	}
+
+	for (const auto &r : results) {
+		if (r.chunk == &chunk) {
+			*size_r = r.size;
+			return r.data;
+		}
+	}
+
+	size_t size;
+	const void *data = state.Convert(chunk.data, chunk.length,
+					 &size, error);
+	if (data == nullptr)
+		return nullptr;
+
+	results.emplace_front(&chunk, data, size);
+
+	const Result &r = results.front();
+	*size_r = r.size;
+	return r.data;
+}
+
+void
+SharedConvert::Forget(const music_chunk *chunk)
+{
+	const ScopeLock protect(mutex);
+
+	results.remove_if([chunk](const Result &r){
+			return r.chunk == chunk;
+		});
+}
+
+void
+SharedConvert::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	results.clear();
+	CloseState();
+}
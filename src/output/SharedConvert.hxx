@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_SHARED_CONVERT_HXX
+#define MPD_OUTPUT_SHARED_CONVERT_HXX
+
+#include "AudioFormat.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "thread/Mutex.hxx"
+#include "util/RefCount.hxx"
+
+#include <forward_list>
+
+#include <stddef.h>
+
+struct music_chunk;
+class Error;
+
+/**
+ * A PCM converter which is shared by several audio outputs with the
+ * same configured audio format and no private filters.  The first
+ * output thread which reaches a #music_chunk converts it; the result
+ * is kept until the chunk is removed from the #MusicPipe, and all
+ * other outputs of the group play it without converting again.
+ *
+ * Because all outputs consume the pipe in the same order, the chunks
+ * are passed to the #PcmConvert object in order, which keeps the
+ * state of the resampler and the dither consistent.
+ */
+class SharedConvert {
+	struct Result {
+		const music_chunk *chunk;
+
+		void *data;
+		size_t size;
+
+		Result(const music_chunk *_chunk, const void *src,
+		       size_t _size);
+		~Result();
+
+		Result(const Result &) = delete;
+		Result &operator=(const Result &) = delete;
+	};
+
+	/**
+	 * The number of audio outputs (and other owners) which hold
+	 * a reference to this object.
+	 */
+	RefCount ref;
+
+	/**
+	 * This mutex protects all of the following attributes.  It
+	 * is locked by the output threads while converting.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The formats #state was opened with; if #in_format is not
+	 * valid, then #state is not open.
+	 */
+	AudioFormat in_format, out_format;
+
+	PcmConvert state;
+
+	/**
+	 * Converted chunks which are still in the #MusicPipe.  The
+	 * most recent one is at the front.
+	 */
+	std::forward_list<Result> results;
+
+public:
+	/**
+	 * The configured audio format of all outputs in this group.
+	 */
+	const AudioFormat config_audio_format;
+
+	/**
+	 * @param resampler_profile the resampler profile of all
+	 * outputs in this group, see pcm_resampler_create()
+	 */
+	SharedConvert(AudioFormat _config_audio_format,
+		      const char *resampler_profile)
+		:in_format(AudioFormat::Undefined()),
+		 out_format(AudioFormat::Undefined()),
+		 state(resampler_profile),
+		 config_audio_format(_config_audio_format) {}
+
+	~SharedConvert();
+
+	SharedConvert(const SharedConvert &) = delete;
+	SharedConvert &operator=(const SharedConvert &) = delete;
+
+	/**
+	 * Increases the reference counter.
+	 */
+	void Ref() {
+		ref.Increment();
+	}
+
+	/**
+	 * Decreases the reference counter.  If it reaches zero, the
+	 * object is deleted.
+	 */
+	void Unref() {
+		if (ref.Decrement())
+			delete this;
+	}
+
+	/**
+	 * Returns the given chunk converted to the specified format.
+	 * The returned buffer is valid until Forget() or Clear() is
+	 * called for this chunk.
+	 *
+	 * @return the converted data, or nullptr on error or if
+	 * another output of this group is using different formats; in
+	 * the latter case, #error is left untouched, and the caller
+	 * shall convert the chunk itself
+	 */
+	const void *Convert(const music_chunk &chunk,
+			    AudioFormat src_format, AudioFormat dest_format,
+			    size_t *size_r, Error &error);
+
+	/**
+	 * Discard the conversion result of a chunk which is being
+	 * removed from the #MusicPipe.
+	 */
+	void Forget(const music_chunk *chunk);
+
+	/**
+	 * Discard all conversion results and reset the converter.
+	 * This is called when the #MusicPipe gets cleared.
+	 */
+	void Clear();
+
+private:
+	void CloseState();
+};
+
+#endif
@@ -21,47 +21,127 @@
 #include "Timer.hxx"
 #include "AudioFormat.hxx"
 #include "system/Clock.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <limits>
 
 #include <assert.h>
+#include <errno.h>
+#include <time.h>
+
+static constexpr Domain timer_domain("timer");
+
+/**
+ * If the output falls behind by more than this, the timer starts
+ * over instead of letting the output catch up as fast as it can.
+ * This avoids flooding clients of streaming outputs after a stall.
+ */
+static constexpr uint64_t MAX_LAG_NS = 500000000;
 
 Timer::Timer(const AudioFormat af)
-	: time(0),
+	: start_ns(0), position(0),
 	  started(false),
-	 rate(af.sample_rate * af.GetFrameSize())
+	  rate(af.sample_rate * af.GetFrameSize()),
+	  stats()
 {
 }
 
 void Timer::Start()
 {
-	time = MonotonicClockUS();
+	start_ns = MonotonicClockNS();
+	position = 0;
 	started = true;
 }
 
 void Timer::Reset()
 {
-	time = 0;
+	if (stats.n > 0)
+		FormatDebug(timer_domain,
+			    "lateness avg=%uus max=%uus resyncs=%u",
+			    unsigned(stats.sum_ns / stats.n / 1000),
+			    unsigned(stats.max_ns / 1000),
+			    stats.resyncs);
+
+	start_ns = 0;
+	position = 0;
 	started = false;
+	stats = Statistics();
 }
 
 void Timer::Add(int size)
 {
 	assert(started);
+	assert(size >= 0);
+
+	position += size;
+}
+
+inline uint64_t
+Timer::GetDeadlineNS() const
+{
+	/* split the calculation to avoid integer overflow on long
+	   runs */
+	const uint64_t seconds = position / rate;
+	const uint64_t remainder = position % rate;
 
-	// (size samples) / (rate samples per second) = duration seconds
-	// duration seconds * 1000000 = duration us
-	time += ((uint64_t)size * 1000000) / rate;
+	return start_ns + seconds * 1000000000
+		+ remainder * 1000000000 / rate;
 }
 
-unsigned Timer::GetDelay() const
+/**
+ * Sleep until the given #MonotonicClockNS() value.
+ */
+static void
+SleepUntilNS(uint64_t deadline_ns)
 {
-	int64_t delay = (int64_t)(time - MonotonicClockUS()) / 1000;
-	if (delay < 0)
-		return 0;
+#if !defined(WIN32) && !defined(__APPLE__) && \
+	defined(CLOCK_MONOTONIC) && defined(TIMER_ABSTIME)
+	struct timespec ts;
+	ts.tv_sec = deadline_ns / 1000000000;
+	ts.tv_nsec = deadline_ns % 1000000000;
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+			       &ts, nullptr) == EINTR) {}
+#else
+	/* no absolute sleep available; the remaining time is below
+	   one millisecond, so just return early */
+	(void)deadline_ns;
+#endif
+}
+
+unsigned Timer::GetDelay()
+{
+	assert(started);
+
+	const uint64_t deadline_ns = GetDeadlineNS();
+	uint64_t now_ns = MonotonicClockNS();
+
+	if (deadline_ns > now_ns) {
+		const uint64_t delay_ms = (deadline_ns - now_ns) / 1000000;
+		if (delay_ms > 0)
+			return delay_ms < std::numeric_limits<int>::max()
+				? unsigned(delay_ms)
+				: std::numeric_limits<int>::max();
+
+		SleepUntilNS(deadline_ns);
+		now_ns = MonotonicClockNS();
+	}
+
+	const uint64_t lateness_ns =
+		now_ns > deadline_ns ? now_ns - deadline_ns : 0;
+
+	++stats.n;
+	stats.sum_ns += lateness_ns;
+	if (lateness_ns > stats.max_ns)
+		stats.max_ns = lateness_ns;
 
-	if (delay > std::numeric_limits<int>::max())
-		delay = std::numeric_limits<int>::max();
+	if (lateness_ns > MAX_LAG_NS) {
+		/* start over at the current position */
+		start_ns = now_ns;
+		position = 0;
+		++stats.resyncs;
+	}
 
-	return delay;
+	return 0;
 }
@@ -24,10 +24,54 @@
 
 struct AudioFormat;
 
+/**
+ * Paces an output which has no clock of its own (e.g. "null",
+ * "fifo" or "httpd") to the speed of real playback.
+ *
+ * The deadline of each Add() call is calculated from the total
+ * number of bytes since Start(), relative to an absolute start time,
+ * so rounding errors do not accumulate.
+ */
 class Timer {
-	uint64_t time;
+	/**
+	 * The #MonotonicClockNS() value when playback started.
+	 */
+	uint64_t start_ns;
+
+	/**
+	 * The number of bytes added since #start_ns.
+	 */
+	uint64_t position;
+
 	bool started;
-	const int rate;
+	const unsigned rate;
+
+public:
+	/**
+	 * Statistics on how late the timer reports the deadline.
+	 */
+	struct Statistics {
+		/**
+		 * The number of deadlines which were reached.
+		 */
+		uint64_t n;
+
+		/**
+		 * The sum and the maximum of the lateness in
+		 * nanoseconds.
+		 */
+		uint64_t sum_ns, max_ns;
+
+		/**
+		 * The number of times the timer was reset because
+		 * the output fell too far behind.
+		 */
+		unsigned resyncs;
+	};
+
+private:
+	Statistics stats;
+
 public:
 	explicit Timer(AudioFormat af);
 
@@ -39,9 +83,19 @@ public:
 	void Add(int size);
 
 	/**
-	 * Returns the number of milliseconds to sleep to get back to sync.
+	 * Returns the number of milliseconds to sleep to get back to
+	 * sync.  If less than one millisecond is left, this method
+	 * sleeps until the deadline with clock_nanosleep() and returns
+	 * 0.
 	 */
-	unsigned GetDelay() const;
+	unsigned GetDelay();
+
+	const Statistics &GetStatistics() const {
+		return stats;
+	}
+
+private:
+	uint64_t GetDeadlineNS() const;
 };
 
 #endif
@@ -31,6 +31,8 @@
 
 #include <string>
 
+#include <string.h>
+
 #define ALSA_PCM_NEW_HW_PARAMS_API
 #define ALSA_PCM_NEW_SW_PARAMS_API
 
@@ -40,9 +42,6 @@ static constexpr unsigned MPD_ALSA_BUFFER_TIME_US = 500000;
 
 #define MPD_ALSA_RETRY_NR 5
 
-typedef snd_pcm_sframes_t alsa_writei_t(snd_pcm_t * pcm, const void *buffer,
-					snd_pcm_uframes_t size);
-
 struct AlsaOutput {
 	AudioOutput base;
 
@@ -54,7 +53,11 @@ struct AlsaOutput {
 	 */
 	std::string device;
 
-	/** use memory mapped I/O? */
+	/**
+	 * Use memory mapped I/O?  If enabled, the last export stage
+	 * writes straight into the device's ring buffer, see
+	 * alsa_mmap_write().
+	 */
 	bool use_mmap;
 
 	/**
@@ -77,13 +80,6 @@ struct AlsaOutput {
 	/** the libasound PCM device handle */
 	snd_pcm_t *pcm;
 
-	/**
-	 * a pointer to the libasound writei() function, which is
-	 * snd_pcm_writei() or snd_pcm_mmap_writei(), depending on the
-	 * use_mmap configuration
-	 */
-	alsa_writei_t *writei;
-
 	/**
 	 * The size of one audio frame passed to method play().
 	 */
@@ -94,6 +90,12 @@ struct AlsaOutput {
 	 */
 	size_t out_frame_size;
 
+	/**
+	 * The sample rate of the device, used to convert frames to
+	 * time.
+	 */
+	unsigned sample_rate;
+
 	/**
 	 * The size of one period, in number of frames.
 	 */
@@ -104,6 +106,19 @@ struct AlsaOutput {
 	 */
 	snd_pcm_uframes_t period_position;
 
+	/**
+	 * The size of the ring buffer, in number of frames.
+	 */
+	snd_pcm_uframes_t buffer_frames;
+
+	/**
+	 * The start threshold passed to libasound, in number of
+	 * frames.  Committing frames with snd_pcm_mmap_commit() does
+	 * not start the device, so alsa_mmap_write() needs to do that
+	 * when this threshold is reached.
+	 */
+	snd_pcm_uframes_t start_threshold;
+
 	/**
 	 * Do we need to call snd_pcm_prepare() before the next write?
 	 * It means that we put the device to SND_PCM_STATE_SETUP by
@@ -125,7 +140,7 @@ struct AlsaOutput {
 
 	AlsaOutput()
 		:base(alsa_output_plugin),
-		 mode(0), writei(snd_pcm_writei) {
+		 mode(0) {
 	}
 
 	bool Init(const config_param &param, Error &error) {
@@ -425,8 +440,7 @@ configure_hw:
 			LogWarning(alsa_output_domain,
 				   "Falling back to direct write mode");
 			ad->use_mmap = false;
-		} else
-			ad->writei = snd_pcm_mmap_writei;
+		}
 	}
 
 	if (!ad->use_mmap) {
@@ -435,7 +449,6 @@ configure_hw:
 						   SND_PCM_ACCESS_RW_INTERLEAVED);
 		if (err < 0)
 			goto error;
-		ad->writei = snd_pcm_writei;
 	}
 
 	err = alsa_output_setup_format(ad->pcm, hwparams, audio_format,
@@ -589,8 +602,11 @@ configure_hw:
 		   happen again. */
 		alsa_period_size = 1;
 
+	ad->sample_rate = sample_rate;
 	ad->period_frames = alsa_period_size;
 	ad->period_position = 0;
+	ad->buffer_frames = alsa_buffer_size;
+	ad->start_threshold = alsa_buffer_size - alsa_period_size;
 
 	ad->silence = new uint8_t[snd_pcm_frames_to_bytes(ad->pcm,
 							  alsa_period_size)];
@@ -701,13 +717,175 @@ alsa_open(AudioOutput *ao, AudioFormat &audio_format, Error &error)
 	return true;
 }
 
+/**
+ * Start the device if it is prepared and enough frames have been
+ * committed to the ring buffer.  This is what snd_pcm_writei() does
+ * implicitly.
+ */
+static int
+alsa_mmap_auto_start(AlsaOutput *ad)
+{
+	if (snd_pcm_state(ad->pcm) != SND_PCM_STATE_PREPARED)
+		return 0;
+
+	snd_pcm_sframes_t avail = snd_pcm_avail_update(ad->pcm);
+	if (avail < 0)
+		return avail;
+
+	if (ad->buffer_frames - (snd_pcm_uframes_t)avail < ad->start_threshold)
+		return 0;
+
+	return snd_pcm_start(ad->pcm);
+}
+
+/**
+ * Obtain the next contiguous free part of the ring buffer, waiting
+ * until there is some room.
+ *
+ * @param offset_r the offset of the first free frame
+ * @param frames_r the maximum number of frames to be written; on
+ * return, the number of frames which may be written
+ * @return the start of the free area, or nullptr on error (with
+ * #err_r set)
+ */
+static uint8_t *
+alsa_mmap_begin(AlsaOutput *ad, snd_pcm_uframes_t *offset_r,
+		snd_pcm_uframes_t *frames_r, int *err_r)
+{
+	while (true) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(ad->pcm);
+		if (avail < 0) {
+			*err_r = avail;
+			return nullptr;
+		}
+
+		if (avail > 0)
+			break;
+
+		int err = snd_pcm_wait(ad->pcm, -1);
+		if (err < 0) {
+			*err_r = err;
+			return nullptr;
+		}
+	}
+
+	const snd_pcm_channel_area_t *areas;
+	int err = snd_pcm_mmap_begin(ad->pcm, &areas, offset_r, frames_r);
+	if (err < 0) {
+		*err_r = err;
+		return nullptr;
+	}
+
+	/* with SND_PCM_ACCESS_MMAP_INTERLEAVED, all channels share
+	   one area, and frames are stored contiguously */
+	assert(areas[0].first % 8 == 0);
+	assert(areas[0].step == ad->out_frame_size * 8);
+
+	return (uint8_t *)areas[0].addr + areas[0].first / 8
+		+ *offset_r * ad->out_frame_size;
+}
+
+/**
+ * Commit frames written by the caller of alsa_mmap_begin(), and
+ * start the device if the start threshold has been reached.
+ */
+static int
+alsa_mmap_commit(AlsaOutput *ad, snd_pcm_uframes_t offset,
+		 snd_pcm_uframes_t frames)
+{
+	snd_pcm_sframes_t ret = snd_pcm_mmap_commit(ad->pcm, offset, frames);
+	if (ret < 0)
+		return ret;
+
+	if ((snd_pcm_uframes_t)ret != frames)
+		return -EPIPE;
+
+	return alsa_mmap_auto_start(ad);
+}
+
+/**
+ * Export PCM data straight into the memory mapped ring buffer.
+ * Unlike snd_pcm_mmap_writei(), this does not need an intermediate
+ * buffer for the last export stage.
+ *
+ * @param size the size of #chunk in bytes
+ * @return the number of frames written to the device, or a
+ * negative error code
+ */
+static snd_pcm_sframes_t
+alsa_mmap_write(AlsaOutput *ad, const void *chunk, size_t size)
+{
+	snd_pcm_uframes_t offset, frames = ad->buffer_frames;
+	int err;
+	uint8_t *dest = alsa_mmap_begin(ad, &offset, &frames, &err);
+	if (dest == nullptr)
+		return err;
+
+	if (ad->pcm_export->dsd_usb) {
+		/* DSD-over-USB markers alternate from frame to
+		   frame, and the converter starts over with each
+		   call; never split a pair */
+
+		if (frames == 1) {
+			/* the ring buffer wraps after an odd number
+			   of frames; let libasound split the pair */
+			size_t max_size =
+				ad->pcm_export->CalcSourceSize(2 * ad->out_frame_size);
+			if (size > max_size)
+				size = max_size;
+
+			const void *data =
+				ad->pcm_export->Export(chunk, size, size);
+			return snd_pcm_mmap_writei(ad->pcm, data,
+						   size / ad->out_frame_size);
+		}
+
+		frames &= ~(snd_pcm_uframes_t)1;
+	}
+
+	size_t max_size =
+		ad->pcm_export->CalcSourceSize(frames * ad->out_frame_size);
+	if (size > max_size)
+		size = max_size;
+
+	const size_t dest_size = ad->pcm_export->ExportTo(dest, chunk, size);
+	assert(dest_size % ad->out_frame_size == 0);
+
+	frames = dest_size / ad->out_frame_size;
+	err = alsa_mmap_commit(ad, offset, frames);
+	if (err < 0)
+		return err;
+
+	return frames;
+}
+
 /**
  * Write silence to the ALSA device.
  */
 static void
 alsa_write_silence(AlsaOutput *ad, snd_pcm_uframes_t nframes)
 {
-	ad->writei(ad->pcm, ad->silence, nframes);
+	if (!ad->use_mmap) {
+		snd_pcm_writei(ad->pcm, ad->silence, nframes);
+		return;
+	}
+
+	/* pad the period inside the ring buffer, without going
+	   through snd_pcm_mmap_writei() */
+	while (nframes > 0) {
+		snd_pcm_uframes_t offset, frames = nframes;
+		int err;
+		uint8_t *dest = alsa_mmap_begin(ad, &offset, &frames, &err);
+		if (dest == nullptr)
+			return;
+
+		memcpy(dest, ad->silence, frames * ad->out_frame_size);
+
+		if (alsa_mmap_commit(ad, offset, frames) < 0)
+			return;
+
+		nframes -= frames;
+	}
 }
 
 static int
@@ -791,6 +969,22 @@ alsa_close(AudioOutput *ao)
 	delete[] ad->silence;
 }
 
+static unsigned
+alsa_latency(AudioOutput *ao)
+{
+	AlsaOutput *ad = (AlsaOutput *)ao;
+
+	if (ad->must_prepare)
+		/* the device has been stopped by alsa_cancel() */
+		return 0;
+
+	snd_pcm_sframes_t delay;
+	if (snd_pcm_delay(ad->pcm, &delay) < 0 || delay <= 0)
+		return 0;
+
+	return uint64_t(delay) * 1000000 / ad->sample_rate;
+}
+
 static size_t
 alsa_play(AudioOutput *ao, const void *chunk, size_t size,
 	  Error &error)
@@ -809,14 +1003,21 @@ alsa_play(AudioOutput *ao, const void *chunk, size_t size,
 		}
 	}
 
-	chunk = ad->pcm_export->Export(chunk, size, size);
+	const void *src = chunk;
+	const size_t src_size = size;
 
-	assert(size % ad->out_frame_size == 0);
+	if (!ad->use_mmap) {
+		chunk = ad->pcm_export->Export(chunk, size, size);
 
-	size /= ad->out_frame_size;
+		assert(size % ad->out_frame_size == 0);
+
+		size /= ad->out_frame_size;
+	}
 
 	while (true) {
-		snd_pcm_sframes_t ret = ad->writei(ad->pcm, chunk, size);
+		snd_pcm_sframes_t ret = ad->use_mmap
+			? alsa_mmap_write(ad, src, src_size)
+			: snd_pcm_writei(ad->pcm, chunk, size);
 		if (ret > 0) {
 			ad->period_position = (ad->period_position + ret)
 				% ad->period_frames;
@@ -843,6 +1044,7 @@ const struct AudioOutputPlugin alsa_output_plugin = {
 	alsa_open,
 	alsa_close,
 	nullptr,
+	alsa_latency,
 	nullptr,
 	alsa_play,
 	alsa_drain,
@@ -24,6 +24,7 @@
 #include "../Timer.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileSystem.hxx"
+#include "system/fd_util.h"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
@@ -46,10 +47,16 @@ struct FifoOutput {
 	bool created;
 	Timer *timer;
 
+	/**
+	 * The pipe capacity in bytes configured with "pipe_size", or
+	 * 0 to keep the kernel's default.
+	 */
+	unsigned pipe_size;
+
 	FifoOutput()
 		:base(fifo_output_plugin),
 		 path(AllocatedPath::Null()), input(-1), output(-1),
-		 created(false) {}
+		 created(false), pipe_size(0) {}
 
 	bool Initialize(const config_param &param, Error &error) {
 		return base.Configure(param, error);
@@ -61,6 +68,13 @@ struct FifoOutput {
 
 	bool Open(Error &error);
 	void Close();
+
+	/**
+	 * Discard all data in the FIFO.
+	 *
+	 * @return the number of bytes which were discarded
+	 */
+	size_t Drain();
 };
 
 static constexpr Domain fifo_output_domain("fifo_output");
@@ -159,9 +173,36 @@ FifoOutput::Open(Error &error)
 		return false;
 	}
 
+	if (pipe_size > 0 && pipe_set_size(output, pipe_size) < 0)
+		FormatErrno(fifo_output_domain,
+			    "Failed to set the capacity of FIFO \"%s\"",
+			    path_utf8.c_str());
+
 	return true;
 }
 
+size_t
+FifoOutput::Drain()
+{
+	char buf[FIFO_BUFFER_SIZE];
+	size_t total = 0;
+	ssize_t bytes = 1;
+
+	while (bytes > 0 && errno != EINTR) {
+		bytes = read(input, buf, FIFO_BUFFER_SIZE);
+		if (bytes > 0)
+			total += bytes;
+	}
+
+	if (bytes < 0 && errno != EAGAIN) {
+		FormatErrno(fifo_output_domain,
+			    "Flush of FIFO \"%s\" failed",
+			    path_utf8.c_str());
+	}
+
+	return total;
+}
+
 static bool
 fifo_open(FifoOutput *fd, Error &error)
 {
@@ -184,6 +225,7 @@ fifo_output_init(const config_param &param, Error &error)
 	}
 
 	fd->path_utf8 = fd->path.ToUTF8();
+	fd->pipe_size = param.GetBlockValue("pipe_size", 0u) * 1024;
 
 	if (!fd->Initialize(param, error)) {
 		delete fd;
@@ -230,19 +272,9 @@ static void
 fifo_output_cancel(AudioOutput *ao)
 {
 	FifoOutput *fd = (FifoOutput *)ao;
-	char buf[FIFO_BUFFER_SIZE];
-	int bytes = 1;
 
 	fd->timer->Reset();
-
-	while (bytes > 0 && errno != EINTR)
-		bytes = read(fd->input, buf, FIFO_BUFFER_SIZE);
-
-	if (bytes < 0 && errno != EAGAIN) {
-		FormatErrno(fifo_output_domain,
-			    "Flush of FIFO \"%s\" failed",
-			    fd->path_utf8.c_str());
-	}
+	fd->Drain();
 }
 
 static unsigned
@@ -275,7 +307,8 @@ fifo_output_play(AudioOutput *ao, const void *chunk, size_t size,
 			switch (errno) {
 			case EAGAIN:
 				/* The pipe is full, so empty it */
-				fifo_output_cancel(&fd->base);
+				fd->timer->Reset();
+				fd->base.dropped_bytes.Add(fd->Drain());
 				continue;
 			case EINTR:
 				continue;
@@ -299,6 +332,7 @@ const struct AudioOutputPlugin fifo_output_plugin = {
 	fifo_output_close,
 	fifo_output_delay,
 	nullptr,
+	nullptr,
 	fifo_output_play,
 	nullptr,
 	fifo_output_cancel,
@@ -21,10 +21,13 @@
 #include "JackOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
 #include "config/ConfigError.hxx"
+#include "pcm/Interleave.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <atomic>
+
 #include <assert.h>
 
 #include <glib.h>
@@ -41,6 +44,9 @@ enum {
 
 static const size_t jack_sample_size = sizeof(jack_default_audio_sample_t);
 
+static_assert(sizeof(jack_default_audio_sample_t) == sizeof(float),
+	      "JACK samples are not 32 bit float");
+
 struct JackOutput {
 	AudioOutput base;
 
@@ -71,13 +77,33 @@ struct JackOutput {
 	jack_client_t *client;
 	jack_ringbuffer_t *ringbuffer[MAX_PORTS];
 
-	bool shutdown;
+	/*
+	 * The following flags and counters are shared with the
+	 * "process" callback, which runs in the JACK realtime thread
+	 * and must never block; therefore they are atomic instead of
+	 * being protected by a mutex.
+	 */
+
+	std::atomic_bool shutdown;
 
 	/**
 	 * While this flag is set, the "process" callback generates
 	 * silence.
 	 */
-	bool pause;
+	std::atomic_bool pause;
+
+	/**
+	 * Set by mpd_jack_play() after the ring buffers have been
+	 * filled for the first time.  Until then, an empty ring buffer
+	 * is not an underrun.
+	 */
+	std::atomic_bool filled;
+
+	/**
+	 * The number of "process" cycles which found less data in the
+	 * ring buffers than requested since playback was started.
+	 */
+	std::atomic_uint underruns;
 
 	JackOutput()
 		:base(jack_output_plugin) {}
@@ -131,17 +157,18 @@ mpd_jack_process(jack_nframes_t nframes, void *arg)
 			jack_default_audio_sample_t *out =
 				(jack_default_audio_sample_t *)
 				jack_port_get_buffer(jd->ports[i], nframes);
-
-			for (jack_nframes_t f = 0; f < nframes; ++f)
-				out[f] = 0.0;
+			if (out != nullptr)
+				memset(out, 0, nframes * jack_sample_size);
 		}
 
 		return 0;
 	}
 
 	jack_nframes_t available = mpd_jack_available(jd);
-	if (available > nframes)
+	if (available >= nframes)
 		available = nframes;
+	else if (jd->filled.load(std::memory_order_relaxed))
+		jd->underruns.fetch_add(1, std::memory_order_relaxed);
 
 	for (unsigned i = 0; i < jd->audio_format.channels; ++i) {
 		jack_default_audio_sample_t *out =
@@ -157,9 +184,10 @@ mpd_jack_process(jack_nframes_t nframes, void *arg)
 		jack_ringbuffer_read(jd->ringbuffer[i],
 				     (char *)out, available * jack_sample_size);
 
-		for (jack_nframes_t f = available; f < nframes; ++f)
+		if (available < nframes)
 			/* ringbuffer underrun, fill with silence */
-			out[f] = 0.0;
+			memset(out + available, 0,
+			       (nframes - available) * jack_sample_size);
 	}
 
 	/* generate silence for the unused source ports */
@@ -176,8 +204,7 @@ mpd_jack_process(jack_nframes_t nframes, void *arg)
 			   buffer */
 			continue;
 
-		for (jack_nframes_t f = 0; f < nframes; ++f)
-			out[f] = 0.0;
+		memset(out, 0, nframes * jack_sample_size);
 	}
 
 	return 0;
@@ -200,9 +227,10 @@ set_audioformat(JackOutput *jd, AudioFormat &audio_format)
 	else if (audio_format.channels > jd->num_source_ports)
 		audio_format.channels = 2;
 
-	if (audio_format.format != SampleFormat::S16 &&
-	    audio_format.format != SampleFormat::S24_P32)
-		audio_format.format = SampleFormat::S24_P32;
+	/* let MPD's (vectorised) PCM conversion produce float
+	   samples, which can then be copied straight into the ring
+	   buffers */
+	audio_format.format = SampleFormat::FLOAT;
 }
 
 static void
@@ -438,6 +466,12 @@ mpd_jack_stop(JackOutput *jd)
 	if (jd->client == nullptr)
 		return;
 
+	const unsigned underruns = jd->underruns.exchange(0);
+	if (underruns > 0)
+		FormatWarning(jack_output_domain,
+			      "%u ring buffer underruns during playback",
+			      underruns);
+
 	if (jd->shutdown)
 		/* the connection has failed; close it */
 		mpd_jack_disconnect(jd);
@@ -470,6 +504,9 @@ mpd_jack_start(JackOutput *jd, Error &error)
 		jack_ringbuffer_reset(jd->ringbuffer[i]);
 	}
 
+	jd->filled = false;
+	jd->underruns = 0;
+
 	if ( jack_activate(jd->client) ) {
 		error.Set(jack_output_domain, "cannot activate client");
 		mpd_jack_stop(jd);
@@ -618,71 +655,52 @@ mpd_jack_delay(AudioOutput *ao)
 		: 0;
 }
 
-static inline jack_default_audio_sample_t
-sample_16_to_jack(int16_t sample)
-{
-	return sample / (jack_default_audio_sample_t)(1 << (16 - 1));
-}
-
-static void
-mpd_jack_write_samples_16(JackOutput *jd, const int16_t *src,
-			  unsigned num_samples)
+/**
+ * Deinterleave up to #n_frames float frames from #src directly into
+ * the ring buffers, without an intermediate buffer.
+ *
+ * @return the number of frames written
+ */
+static size_t
+mpd_jack_write_samples(JackOutput *jd, const float *src, size_t n_frames)
 {
-	jack_default_audio_sample_t sample;
-	unsigned i;
-
-	while (num_samples-- > 0) {
-		for (i = 0; i < jd->audio_format.channels; ++i) {
-			sample = sample_16_to_jack(*src++);
-			jack_ringbuffer_write(jd->ringbuffer[i],
-					      (const char *)&sample,
-					      sizeof(sample));
+	const unsigned channels = jd->audio_format.channels;
+	size_t written = 0;
+
+	while (written < n_frames) {
+		/* the ring buffers are filled and drained
+		   symmetrically, so their write vectors usually have
+		   the same shape; if not, copy the smallest common
+		   part and try again */
+		uint32_t *dest[MAX_PORTS];
+		size_t n = n_frames - written;
+		for (unsigned i = 0; i < channels; ++i) {
+			jack_ringbuffer_data_t vec[2];
+			jack_ringbuffer_get_write_vector(jd->ringbuffer[i],
+							 vec);
+
+			const size_t space = vec[0].len / jack_sample_size;
+			if (space < n)
+				n = space;
+
+			dest[i] = (uint32_t *)vec[0].buf;
 		}
-	}
-}
 
-static inline jack_default_audio_sample_t
-sample_24_to_jack(int32_t sample)
-{
-	return sample / (jack_default_audio_sample_t)(1 << (24 - 1));
-}
+		if (n == 0)
+			break;
 
-static void
-mpd_jack_write_samples_24(JackOutput *jd, const int32_t *src,
-			  unsigned num_samples)
-{
-	jack_default_audio_sample_t sample;
-	unsigned i;
-
-	while (num_samples-- > 0) {
-		for (i = 0; i < jd->audio_format.channels; ++i) {
-			sample = sample_24_to_jack(*src++);
-			jack_ringbuffer_write(jd->ringbuffer[i],
-					      (const char *)&sample,
-					      sizeof(sample));
-		}
-	}
-}
+		PcmDeinterleave32(ConstBuffer<uint32_t *>(dest, channels),
+				  (const uint32_t *)src + written * channels,
+				  n);
 
-static void
-mpd_jack_write_samples(JackOutput *jd, const void *src,
-		       unsigned num_samples)
-{
-	switch (jd->audio_format.format) {
-	case SampleFormat::S16:
-		mpd_jack_write_samples_16(jd, (const int16_t*)src,
-					  num_samples);
-		break;
-
-	case SampleFormat::S24_P32:
-		mpd_jack_write_samples_24(jd, (const int32_t*)src,
-					  num_samples);
-		break;
-
-	default:
-		assert(false);
-		gcc_unreachable();
+		for (unsigned i = 0; i < channels; ++i)
+			jack_ringbuffer_write_advance(jd->ringbuffer[i],
+						      n * jack_sample_size);
+
+		written += n;
 	}
+
+	return written;
 }
 
 static size_t
@@ -726,7 +744,8 @@ mpd_jack_play(AudioOutput *ao, const void *chunk, size_t size,
 	if (space < size)
 		size = space;
 
-	mpd_jack_write_samples(jd, chunk, size);
+	size = mpd_jack_write_samples(jd, (const float *)chunk, size);
+	jd->filled.store(true, std::memory_order_relaxed);
 	return size * frame_size;
 }
 
@@ -739,6 +758,7 @@ mpd_jack_pause(AudioOutput *ao)
 		return false;
 
 	jd->pause = true;
+	jd->filled = false;
 
 	return true;
 }
@@ -754,6 +774,7 @@ const struct AudioOutputPlugin jack_output_plugin = {
 	mpd_jack_close,
 	mpd_jack_delay,
 	nullptr,
+	nullptr,
 	mpd_jack_play,
 	nullptr,
 	nullptr,
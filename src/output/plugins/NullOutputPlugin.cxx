@@ -130,6 +130,7 @@ const struct AudioOutputPlugin null_output_plugin = {
 	null_close,
 	null_delay,
 	nullptr,
+	nullptr,
 	null_play,
 	nullptr,
 	null_cancel,
@@ -20,14 +20,16 @@
 #include "config.h"
 #include "OSXOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
-#include "util/DynamicFifoBuffer.hxx"
+#include "util/RingBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
-#include "thread/Mutex.hxx"
-#include "thread/Cond.hxx"
 #include "system/ByteOrder.hxx"
 #include "Log.hxx"
 
+#include <atomic>
+
+#include <string.h>
+
 #include <CoreAudio/AudioHardware.h>
 #include <AudioUnit/AudioUnit.h>
 #include <CoreServices/CoreServices.h>
@@ -41,10 +43,28 @@ struct OSXOutput {
 	const char *device_name;
 
 	AudioUnit au;
-	Mutex mutex;
-	Cond condition;
 
-	DynamicFifoBuffer<uint8_t> *buffer;
+	AudioFormat audio_format;
+
+	/**
+	 * Passes PCM data from osx_output_play() to the render
+	 * callback.  It is lock-free, so the realtime thread never
+	 * waits for the output thread.
+	 */
+	RingBuffer<uint8_t> *ring;
+
+	/**
+	 * Set by osx_output_play() after data has been submitted for
+	 * the first time.  Until then, an empty ring buffer is not an
+	 * underrun.
+	 */
+	std::atomic_bool filled;
+
+	/**
+	 * The number of render callbacks which found less data in
+	 * the ring buffer than requested since the device was opened.
+	 */
+	std::atomic_uint underruns;
 
 	OSXOutput()
 		:base(osx_output_plugin) {}
@@ -204,26 +224,21 @@ osx_render(void *vdata,
 {
 	OSXOutput *od = (OSXOutput *) vdata;
 	AudioBuffer *buffer = &buffer_list->mBuffers[0];
-	size_t buffer_size = buffer->mDataByteSize;
-
-	assert(od->buffer != NULL);
+	const size_t buffer_size = buffer->mDataByteSize;
 
-	od->mutex.lock();
+	assert(od->ring != nullptr);
 
-	auto src = od->buffer->Read();
-	if (!src.IsEmpty()) {
-		if (src.size > buffer_size)
-			src.size = buffer_size;
+	uint8_t *dest = (uint8_t *)buffer->mData;
+	const size_t nbytes = od->ring->Pop(dest, buffer_size);
+	if (nbytes < buffer_size) {
+		/* fill the rest with silence instead of shortening
+		   the buffer */
+		memset(dest + nbytes, 0, buffer_size - nbytes);
 
-		memcpy(buffer->mData, src.data, src.size);
-		od->buffer->Consume(src.size);
+		if (od->filled.load(std::memory_order_relaxed))
+			od->underruns.fetch_add(1, std::memory_order_relaxed);
 	}
 
-	od->condition.signal();
-	od->mutex.unlock();
-
-	buffer->mDataByteSize = src.size;
-
 	unsigned i;
 	for (i = 1; i < buffer_list->mNumberBuffers; ++i) {
 		buffer = &buffer_list->mBuffers[i];
@@ -297,8 +312,13 @@ osx_output_cancel(AudioOutput *ao)
 {
 	OSXOutput *od = (OSXOutput *)ao;
 
-	const ScopeLock protect(od->mutex);
-	od->buffer->Clear();
+	/* the ring buffer may only be cleared while the render
+	   callback is not running; AudioOutputUnitStop() waits for
+	   it to finish */
+	AudioOutputUnitStop(od->au);
+	od->ring->Clear();
+	od->filled = false;
+	AudioOutputUnitStart(od->au);
 }
 
 static void
@@ -309,7 +329,13 @@ osx_output_close(AudioOutput *ao)
 	AudioOutputUnitStop(od->au);
 	AudioUnitUninitialize(od->au);
 
-	delete od->buffer;
+	const unsigned underruns = od->underruns.exchange(0);
+	if (underruns > 0)
+		FormatWarning(osx_output_domain,
+			      "%u ring buffer underruns during playback",
+			      underruns);
+
+	delete od->ring;
 }
 
 static bool
@@ -369,13 +395,18 @@ osx_output_open(AudioOutput *ao, AudioFormat &audio_format,
 		return false;
 	}
 
+	od->audio_format = audio_format;
+
 	/* create a buffer of 1s */
-	od->buffer = new DynamicFifoBuffer<uint8_t>(audio_format.sample_rate *
-						    audio_format.GetFrameSize());
+	od->ring = new RingBuffer<uint8_t>(audio_format.sample_rate *
+					   audio_format.GetFrameSize());
+	od->filled = false;
+	od->underruns = 0;
 
 	status = AudioOutputUnitStart(od->au);
 	if (status != 0) {
 		AudioUnitUninitialize(od->au);
+		delete od->ring;
 		error.Format(osx_output_domain, status,
 			     "unable to start audio output: %s",
 			     GetMacOSStatusCommentString(status));
@@ -385,30 +416,43 @@ osx_output_open(AudioOutput *ao, AudioFormat &audio_format,
 	return true;
 }
 
+static unsigned
+osx_output_delay(AudioOutput *ao)
+{
+	OSXOutput *od = (OSXOutput *)ao;
+
+	/* instead of blocking in osx_output_play(), let the output
+	   thread sleep until the render callback has freed a quarter
+	   of the ring buffer */
+	const size_t threshold = od->ring->GetCapacity() / 4;
+	const size_t space = od->ring->GetSpace();
+	if (space >= threshold)
+		return 0;
+
+	const size_t bytes_per_second =
+		od->audio_format.sample_rate * od->audio_format.GetFrameSize();
+	const unsigned ms = (threshold - space) * 1000 / bytes_per_second;
+	return ms > 0 ? ms : 1;
+}
+
 static size_t
 osx_output_play(AudioOutput *ao, const void *chunk, size_t size,
 		gcc_unused Error &error)
 {
 	OSXOutput *od = (OSXOutput *)ao;
 
-	const ScopeLock protect(od->mutex);
-
-	DynamicFifoBuffer<uint8_t>::Range dest;
-	while (true) {
-		dest = od->buffer->Write();
-		if (!dest.IsEmpty())
-			break;
-
-		/* wait for some free space in the buffer */
-		od->condition.wait(od->mutex);
-	}
-
-	if (size > dest.size)
-		size = dest.size;
+	/* osx_output_delay() has made sure there is enough room; the
+	   render callback can only increase it meanwhile */
+	const size_t frame_size = od->audio_format.GetFrameSize();
+	size_t space = od->ring->GetSpace();
+	space -= space % frame_size;
+	assert(space > 0);
 
-	memcpy(dest.data, chunk, size);
-	od->buffer->Append(size);
+	if (size > space)
+		size = space;
 
+	size = od->ring->Push((const uint8_t *)chunk, size);
+	od->filled.store(true, std::memory_order_relaxed);
 	return size;
 }
 
@@ -421,6 +465,7 @@ const struct AudioOutputPlugin osx_output_plugin = {
 	osx_output_disable,
 	osx_output_open,
 	osx_output_close,
+	osx_output_delay,
 	nullptr,
 	nullptr,
 	osx_output_play,
@@ -274,6 +274,7 @@ const struct AudioOutputPlugin openal_output_plugin = {
 	openal_close,
 	openal_delay,
 	nullptr,
+	nullptr,
 	openal_play,
 	nullptr,
 	openal_cancel,
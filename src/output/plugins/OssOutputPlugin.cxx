@@ -763,6 +763,7 @@ const struct AudioOutputPlugin oss_output_plugin = {
 	oss_output_close,
 	nullptr,
 	nullptr,
+	nullptr,
 	oss_output_play,
 	nullptr,
 	oss_output_cancel,
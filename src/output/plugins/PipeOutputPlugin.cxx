@@ -20,13 +20,18 @@
 #include "config.h"
 #include "PipeOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
+#include "../Timer.hxx"
 #include "config/ConfigError.hxx"
+#include "system/fd_util.h"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <string>
 
 #include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 
 struct PipeOutput {
 	AudioOutput base;
@@ -34,6 +39,21 @@ struct PipeOutput {
 	std::string cmd;
 	FILE *fh;
 
+	/**
+	 * The pipe capacity in bytes configured with "pipe_size", or
+	 * 0 to keep the kernel's default.
+	 */
+	unsigned pipe_size;
+
+	/**
+	 * If true, the pipe is non-blocking: data which does not fit
+	 * into the pipe is discarded instead of waiting for the
+	 * command, and #timer paces the output thread.
+	 */
+	bool nonblocking;
+
+	Timer *timer;
+
 	PipeOutput()
 		:base(pipe_output_plugin) {}
 
@@ -56,6 +76,9 @@ PipeOutput::Configure(const config_param &param, Error &error)
 		return false;
 	}
 
+	pipe_size = param.GetBlockValue("pipe_size", 0u) * 1024;
+	nonblocking = param.GetBlockValue("nonblocking", false);
+
 	return true;
 }
 
@@ -86,8 +109,7 @@ pipe_output_finish(AudioOutput *ao)
 }
 
 static bool
-pipe_output_open(AudioOutput *ao,
-		 gcc_unused AudioFormat &audio_format,
+pipe_output_open(AudioOutput *ao, AudioFormat &audio_format,
 		 Error &error)
 {
 	PipeOutput *pd = (PipeOutput *)ao;
@@ -99,6 +121,25 @@ pipe_output_open(AudioOutput *ao,
 		return false;
 	}
 
+	const int fd = fileno(pd->fh);
+
+	if (pd->pipe_size > 0 && pipe_set_size(fd, pd->pipe_size) < 0)
+		FormatErrno(pipe_output_domain,
+			    "Failed to set the capacity of pipe \"%s\"",
+			    pd->cmd.c_str());
+
+	if (pd->nonblocking) {
+		if (fd_set_nonblock(fd) < 0) {
+			error.FormatErrno("Failed to make pipe \"%s\" non-blocking",
+					  pd->cmd.c_str());
+			pclose(pd->fh);
+			return false;
+		}
+
+		pd->timer = new Timer(audio_format);
+	} else
+		pd->timer = nullptr;
+
 	return true;
 }
 
@@ -107,21 +148,64 @@ pipe_output_close(AudioOutput *ao)
 {
 	PipeOutput *pd = (PipeOutput *)ao;
 
+	delete pd->timer;
 	pclose(pd->fh);
 }
 
+static unsigned
+pipe_output_delay(AudioOutput *ao)
+{
+	PipeOutput *pd = (PipeOutput *)ao;
+
+	return pd->timer != nullptr && pd->timer->IsStarted()
+		? pd->timer->GetDelay()
+		: 0;
+}
+
 static size_t
 pipe_output_play(AudioOutput *ao, const void *chunk, size_t size,
 		 Error &error)
 {
 	PipeOutput *pd = (PipeOutput *)ao;
-	size_t ret;
 
-	ret = fwrite(chunk, 1, size, pd->fh);
-	if (ret == 0)
+	if (pd->timer != nullptr) {
+		if (!pd->timer->IsStarted())
+			pd->timer->Start();
+		pd->timer->Add(size);
+	}
+
+	/* write to the file descriptor directly; stdio buffering
+	   would only add a copy, and it does not work with a
+	   non-blocking descriptor */
+	while (true) {
+		ssize_t nbytes = write(fileno(pd->fh), chunk, size);
+		if (nbytes > 0)
+			return nbytes;
+
+		if (nbytes < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EAGAIN && pd->nonblocking) {
+				/* the command is too slow: discard
+				   this chunk */
+				pd->base.dropped_bytes.Add(size);
+				return size;
+			}
+		}
+
 		error.SetErrno("Write error on pipe");
+		return 0;
+	}
+}
 
-	return ret;
+static void
+pipe_output_cancel(AudioOutput *ao)
+{
+	PipeOutput *pd = (PipeOutput *)ao;
+
+	if (pd->timer != nullptr)
+		pd->timer->Reset();
 }
 
 const struct AudioOutputPlugin pipe_output_plugin = {
@@ -133,11 +217,12 @@ const struct AudioOutputPlugin pipe_output_plugin = {
 	nullptr,
 	pipe_output_open,
 	pipe_output_close,
+	pipe_output_delay,
 	nullptr,
 	nullptr,
 	pipe_output_play,
 	nullptr,
-	nullptr,
+	pipe_output_cancel,
 	nullptr,
 	nullptr,
 };
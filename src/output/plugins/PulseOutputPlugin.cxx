@@ -37,6 +37,7 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MPD_PULSE_NAME "Music Player Daemon"
 
@@ -47,6 +48,19 @@ struct PulseOutput {
 	const char *server;
 	const char *sink;
 
+	/**
+	 * The configured target buffer length ("tlength") in
+	 * milliseconds; 0 means the server's default.
+	 */
+	unsigned buffer_time;
+
+	/**
+	 * The configured minimum request size ("minreq") in
+	 * milliseconds; 0 means the server's default.  Larger values
+	 * mean fewer wakeups.
+	 */
+	unsigned minreq_time;
+
 	PulseMixer *mixer;
 
 	struct pa_threaded_mainloop *mainloop;
@@ -55,6 +69,11 @@ struct PulseOutput {
 
 	size_t writable;
 
+	/**
+	 * The size of one frame of the current stream.
+	 */
+	size_t frame_size;
+
 	PulseOutput()
 		:base(pulse_output_plugin) {}
 };
@@ -338,6 +357,8 @@ pulse_output_init(const config_param &param, Error &error)
 	po->name = param.GetBlockValue("name", "mpd_pulse");
 	po->server = param.GetBlockValue("server");
 	po->sink = param.GetBlockValue("sink");
+	po->buffer_time = param.GetBlockValue("buffer_time", 0u);
+	po->minreq_time = param.GetBlockValue("minreq_time", 0u);
 
 	po->mixer = nullptr;
 	po->mainloop = nullptr;
@@ -543,6 +564,28 @@ pulse_output_setup_stream(PulseOutput *po, const pa_sample_spec *ss,
 	return true;
 }
 
+/**
+ * Fill a #pa_buffer_attr from the configured "buffer_time" and
+ * "minreq_time".  Settings which were not configured are left to the
+ * server.
+ */
+static void
+pulse_output_buffer_attr(const PulseOutput *po, const pa_sample_spec *ss,
+			 pa_buffer_attr *attr)
+{
+	attr->maxlength = (uint32_t)-1;
+	attr->prebuf = (uint32_t)-1;
+	attr->fragsize = (uint32_t)-1;
+
+	attr->tlength = po->buffer_time > 0
+		? pa_usec_to_bytes(pa_usec_t(po->buffer_time) * 1000, ss)
+		: (uint32_t)-1;
+
+	attr->minreq = po->minreq_time > 0
+		? pa_usec_to_bytes(pa_usec_t(po->minreq_time) * 1000, ss)
+		: (uint32_t)-1;
+}
+
 static bool
 pulse_output_open(AudioOutput *ao, AudioFormat &audio_format,
 		  Error &error)
@@ -586,6 +629,8 @@ pulse_output_open(AudioOutput *ao, AudioFormat &audio_format,
 	ss.rate = audio_format.sample_rate;
 	ss.channels = audio_format.channels;
 
+	po->frame_size = audio_format.GetFrameSize();
+
 	/* create a stream .. */
 
 	if (!pulse_output_setup_stream(po, &ss, error)) {
@@ -595,8 +640,23 @@ pulse_output_open(AudioOutput *ao, AudioFormat &audio_format,
 
 	/* .. and connect it (asynchronously) */
 
+	pa_buffer_attr attr;
+	const pa_buffer_attr *attr_p = nullptr;
+	/* timing updates are needed by pulse_output_latency() */
+	pa_stream_flags_t flags =
+		pa_stream_flags_t(PA_STREAM_INTERPOLATE_TIMING|
+				  PA_STREAM_AUTO_TIMING_UPDATE);
+	if (po->buffer_time > 0 || po->minreq_time > 0) {
+		pulse_output_buffer_attr(po, &ss, &attr);
+		attr_p = &attr;
+
+		/* let the server configure the sink latency according
+		   to tlength, instead of using the whole sink buffer */
+		flags = pa_stream_flags_t(flags|PA_STREAM_ADJUST_LATENCY);
+	}
+
 	if (pa_stream_connect_playback(po->stream, po->sink,
-				       nullptr, pa_stream_flags_t(0),
+				       attr_p, flags,
 				       nullptr, nullptr) < 0) {
 		pulse_output_delete_stream(po);
 
@@ -715,6 +775,27 @@ pulse_output_delay(AudioOutput *ao)
 	return result;
 }
 
+static unsigned
+pulse_output_latency(AudioOutput *ao)
+{
+	PulseOutput *po = (PulseOutput *)ao;
+	unsigned result = 0;
+
+	pa_threaded_mainloop_lock(po->mainloop);
+
+	pa_usec_t latency;
+	int negative;
+	if (po->stream != nullptr &&
+	    pa_stream_get_state(po->stream) == PA_STREAM_READY &&
+	    pa_stream_get_latency(po->stream, &latency, &negative) == 0 &&
+	    !negative)
+		result = latency;
+
+	pa_threaded_mainloop_unlock(po->mainloop);
+
+	return result;
+}
+
 static size_t
 pulse_output_play(AudioOutput *ao, const void *chunk, size_t size,
 		  Error &error)
@@ -767,10 +848,32 @@ pulse_output_play(AudioOutput *ao, const void *chunk, size_t size,
 		/* don't send more than possible */
 		size = po->writable;
 
+	/* fill a buffer allocated by libpulse (in the memory pool
+	   shared with the server, if available); pa_stream_write()
+	   recognizes it and does not need to copy it again */
+
+	void *data;
+	size_t nbytes = size;
+	if (pa_stream_begin_write(po->stream, &data, &nbytes) < 0) {
+		SetError(error, po->context, "pa_stream_begin_write() failed");
+		pa_threaded_mainloop_unlock(po->mainloop);
+		return 0;
+	}
+
+	if (size > nbytes)
+		size = nbytes;
+
+	/* pa_stream_write() requires whole frames */
+	size -= size % po->frame_size;
+
+	memcpy(data, chunk, size);
+
 	po->writable -= size;
 
-	int result = pa_stream_write(po->stream, chunk, size, nullptr,
+	int result = pa_stream_write(po->stream, data, size, nullptr,
 				     0, PA_SEEK_RELATIVE);
+	if (result < 0)
+		pa_stream_cancel_write(po->stream);
 	pa_threaded_mainloop_unlock(po->mainloop);
 	if (result < 0) {
 		SetError(error, po->context, "pa_stream_write() failed");
@@ -875,6 +978,7 @@ const struct AudioOutputPlugin pulse_output_plugin = {
 	pulse_output_open,
 	pulse_output_close,
 	pulse_output_delay,
+	pulse_output_latency,
 	nullptr,
 	pulse_output_play,
 	nullptr,
@@ -19,22 +19,27 @@
 
 #include "config.h"
 #include "RecorderOutputPlugin.hxx"
+#include "RecorderWriter.hxx"
 #include "../OutputAPI.hxx"
 #include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderThread.hxx"
 #include "encoder/EncoderList.hxx"
 #include "config/ConfigError.hxx"
+#include "tag/Tag.hxx"
+#include "system/Clock.hxx"
+#include "util/Cast.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
-#include "system/fd_util.h"
-#include "open.h"
+#include "Log.hxx"
+
+#include <string>
 
 #include <assert.h>
-#include <sys/types.h>
-#include <sys/stat.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
-#include <errno.h>
 
-struct RecorderOutput {
+struct RecorderOutput final : EncoderThread::Handler {
 	AudioOutput base;
 
 	/**
@@ -43,14 +48,64 @@ struct RecorderOutput {
 	Encoder *encoder;
 
 	/**
-	 * The destination file name.
+	 * Runs the #encoder while a file is open.
+	 */
+	EncoderThread *encoder_thread;
+
+	/**
+	 * The destination file name.  If #format_path is set, this
+	 * is nullptr.
 	 */
 	const char *path;
 
 	/**
-	 * The destination file descriptor.
+	 * The destination file name template; see ExpandPath().
 	 */
-	int fd;
+	const char *format_path;
+
+	/**
+	 * Start a new file after this many seconds; 0 disables
+	 * rotation by time.
+	 */
+	unsigned rotate_time;
+
+	/**
+	 * Open files with O_DIRECT?
+	 */
+	bool direct_io;
+
+	/**
+	 * The thread which writes to the file.
+	 */
+	RecorderWriter *writer;
+
+	/**
+	 * The audio format passed to the encoder; it is needed to
+	 * reopen the encoder for the next file.
+	 */
+	AudioFormat audio_format;
+
+	/**
+	 * The name of the current file.
+	 */
+	std::string current_path;
+
+	/**
+	 * Are the encoder and #current_path open?  This is false
+	 * after a failed rotation.
+	 */
+	bool file_open;
+
+	/**
+	 * The #MonotonicClockS() value when the current file was
+	 * started.
+	 */
+	unsigned file_start;
+
+	/**
+	 * The most recent tag, for expanding #format_path.
+	 */
+	Tag *tag;
 
 	/**
 	 * The buffer for encoder_read().
@@ -58,7 +113,19 @@ struct RecorderOutput {
 	char buffer[32768];
 
 	RecorderOutput()
-		:base(recorder_output_plugin) {}
+		:base(recorder_output_plugin),
+		 encoder_thread(nullptr), writer(nullptr),
+		 file_open(false), tag(nullptr) {}
+
+	~RecorderOutput() {
+		delete encoder_thread;
+		delete writer;
+		delete tag;
+	}
+
+	static RecorderOutput *Cast(AudioOutput *ao) {
+		return MemberContainerCast(ao, &RecorderOutput::base);
+	}
 
 	bool Initialize(const config_param &param, Error &error_r) {
 		return base.Configure(param, error_r);
@@ -66,12 +133,43 @@ struct RecorderOutput {
 
 	bool Configure(const config_param &param, Error &error);
 
-	bool WriteToFile(const void *data, size_t length, Error &error);
-
 	/**
 	 * Writes pending data from the encoder to the output file.
 	 */
-	bool EncoderToFile(Error &error);
+	void EncoderToFile();
+
+	/**
+	 * Determine the name of the next file: #path, or #format_path
+	 * expanded with the current tag and the local time.
+	 */
+	std::string ExpandPath() const;
+
+	/**
+	 * Open the file and the encoder.
+	 */
+	bool OpenFile(const std::string &new_path, Error &error);
+
+	/**
+	 * Flush and close the encoder; the writer finishes the file.
+	 */
+	void CloseFile();
+
+	/**
+	 * Start a new file if the expanded path has changed, or if
+	 * no file is open.
+	 */
+	bool Rotate(Error &error);
+
+	/* virtual methods from class EncoderThread::Handler */
+	bool OnEncoderOutput(Encoder &, size_t, Error &) override {
+		EncoderToFile();
+		return true;
+	}
+
+	bool OnEncoderTag(Encoder &, Error &) override {
+		EncoderToFile();
+		return true;
+	}
 };
 
 static constexpr Domain recorder_output_domain("recorder_output");
@@ -91,17 +189,47 @@ RecorderOutput::Configure(const config_param &param, Error &error)
 	}
 
 	path = param.GetBlockValue("path");
-	if (path == nullptr) {
+	format_path = param.GetBlockValue("format_path");
+	if (path == nullptr && format_path == nullptr) {
 		error.Set(config_domain, "'path' not configured");
 		return false;
 	}
 
+	if (path != nullptr && format_path != nullptr) {
+		error.Set(config_domain,
+			  "Cannot have both 'path' and 'format_path'");
+		return false;
+	}
+
+	rotate_time = param.GetBlockValue("rotate_time", 0u);
+	if (rotate_time > 0 && format_path == nullptr) {
+		error.Set(config_domain,
+			  "'rotate_time' requires 'format_path'");
+		return false;
+	}
+
+	direct_io = param.GetBlockValue("direct_io", false);
+
+	const unsigned queue_kb = param.GetBlockValue("queue_size", 8192u);
+	if (queue_kb == 0) {
+		error.Set(config_domain, "'queue_size' must not be 0");
+		return false;
+	}
+
+	const unsigned preallocate_kb =
+		param.GetBlockValue("preallocate", 0u);
+
+	writer = new RecorderWriter(size_t(queue_kb) * 1024,
+				    uint64_t(preallocate_kb) * 1024);
+
 	/* initialize encoder */
 
 	encoder = encoder_init(*encoder_plugin, param, error);
 	if (encoder == nullptr)
 		return false;
 
+	encoder_thread = new EncoderThread(*encoder, *this);
+
 	return true;
 }
 
@@ -126,54 +254,173 @@ recorder_output_init(const config_param &param, Error &error)
 static void
 recorder_output_finish(AudioOutput *ao)
 {
-	RecorderOutput *recorder = (RecorderOutput *)ao;
+	RecorderOutput *recorder = RecorderOutput::Cast(ao);
 
 	encoder_finish(recorder->encoder);
 	delete recorder;
 }
 
-inline bool
-RecorderOutput::WriteToFile(const void *_data, size_t length, Error &error)
+inline void
+RecorderOutput::EncoderToFile()
 {
-	assert(length > 0);
+	while (true) {
+		/* read from the encoder */
 
-	const uint8_t *data = (const uint8_t *)_data, *end = data + length;
+		size_t size = encoder_read_all(encoder,
+					       { buffer, sizeof(buffer) });
+		if (size == 0)
+			return;
 
-	while (true) {
-		ssize_t nbytes = write(fd, data, end - data);
-		if (nbytes > 0) {
-			data += nbytes;
-			if (data == end)
-				return true;
-		} else if (nbytes == 0) {
-			/* shouldn't happen for files */
-			error.Set(recorder_output_domain,
-				  "write() returned 0");
-			return false;
-		} else if (errno != EINTR) {
-			error.FormatErrno("Failed to write to '%s'", path);
-			return false;
+		/* queue everything for the file */
+
+		writer->Write(buffer, size);
+	}
+}
+
+/**
+ * Append a tag value to a path which will be passed to strftime():
+ * escape '%' and replace directory separators.
+ */
+static void
+AppendTagValue(std::string &dest, const char *value)
+{
+	for (; *value != 0; ++value) {
+		if (*value == '%')
+			dest.append("%%");
+		else if (*value == '/')
+			dest.push_back('_');
+		else
+			dest.push_back(*value);
+	}
+}
+
+std::string
+RecorderOutput::ExpandPath() const
+{
+	if (format_path == nullptr)
+		return path;
+
+	/* replace tag names such as "%artist%" with the value from
+	   the current tag */
+
+	std::string result;
+	const char *p = format_path;
+	while (*p != 0) {
+		const char *end;
+		if (*p == '%' && (end = strchr(p + 1, '%')) != nullptr &&
+		    end > p + 1) {
+			const std::string name(p + 1, end);
+			const TagType type = tag_name_parse_i(name.c_str());
+			if (type != TAG_NUM_OF_ITEM_TYPES) {
+				const char *value = tag != nullptr
+					? tag->GetValue(type)
+					: nullptr;
+				if (value != nullptr)
+					AppendTagValue(result, value);
+
+				p = end + 1;
+				continue;
+			}
 		}
+
+		/* leave everything else (including "%%") to
+		   strftime() */
+		result.push_back(*p);
+		if (*p == '%' && p[1] != 0) {
+			++p;
+			result.push_back(*p);
+		}
+
+		++p;
 	}
+
+	/* now expand the time conversions */
+
+	const time_t now = time(nullptr);
+	struct tm tm;
+#ifdef WIN32
+	tm = *localtime(&now);
+#else
+	localtime_r(&now, &tm);
+#endif
+
+	char buffer2[4096];
+	size_t length = strftime(buffer2, sizeof(buffer2), result.c_str(), &tm);
+	if (length == 0)
+		/* empty or too long; use the unexpanded name */
+		return result;
+
+	return std::string(buffer2, length);
 }
 
-inline bool
-RecorderOutput::EncoderToFile(Error &error)
+bool
+RecorderOutput::OpenFile(const std::string &new_path, Error &error)
 {
-	assert(fd >= 0);
+	/* create the output file */
 
-	while (true) {
-		/* read from the encoder */
+	const int fd = RecorderWriter::OpenFile(new_path.c_str(), direct_io,
+						error);
+	if (fd < 0)
+		return false;
 
-		size_t size = encoder_read(encoder, buffer, sizeof(buffer));
-		if (size == 0)
-			return true;
+	/* open the encoder */
+
+	if (!encoder_open(encoder, audio_format, error)) {
+		close(fd);
+		unlink(new_path.c_str());
+		return false;
+	}
+
+	writer->SwitchFile(fd, new_path.c_str());
+	current_path = new_path;
+	file_start = MonotonicClockS();
 
-		/* write everything into the file */
+	EncoderToFile();
 
-		if (!WriteToFile(buffer, size, error))
-			return false;
+	/* from now on, the encoder runs in its own thread */
+
+	if (!encoder_thread->Start(error)) {
+		encoder_close(encoder);
+		return false;
 	}
+
+	file_open = true;
+	return true;
+}
+
+void
+RecorderOutput::CloseFile()
+{
+	if (!file_open)
+		return;
+
+	file_open = false;
+
+	/* encode all queued data, and take the encoder back from the
+	   thread */
+	encoder_thread->Stop();
+
+	/* flush the encoder and write the rest to the file */
+
+	if (encoder_end(encoder, IgnoreError()))
+		EncoderToFile();
+
+	encoder_close(encoder);
+}
+
+bool
+RecorderOutput::Rotate(Error &error)
+{
+	const std::string new_path = ExpandPath();
+	if (file_open && new_path == current_path)
+		/* don't truncate the current file */
+		return true;
+
+	FormatDebug(recorder_output_domain, "switching to '%s'",
+		    new_path.c_str());
+
+	CloseFile();
+	return OpenFile(new_path, error);
 }
 
 static bool
@@ -181,62 +428,72 @@ recorder_output_open(AudioOutput *ao,
 		     AudioFormat &audio_format,
 		     Error &error)
 {
-	RecorderOutput *recorder = (RecorderOutput *)ao;
+	RecorderOutput *recorder = RecorderOutput::Cast(ao);
 
-	/* create the output file */
-
-	recorder->fd = open_cloexec(recorder->path,
-				    O_CREAT|O_WRONLY|O_TRUNC|O_BINARY,
-				    0666);
-	if (recorder->fd < 0) {
-		error.FormatErrno("Failed to create '%s'", recorder->path);
+	if (!recorder->writer->Start(error))
 		return false;
-	}
-
-	/* open the encoder */
 
-	if (!encoder_open(recorder->encoder, audio_format, error)) {
-		close(recorder->fd);
-		unlink(recorder->path);
-		return false;
-	}
+	/* the encoder may modify the audio format; the modified
+	   format is then used for all following files */
+	recorder->audio_format = audio_format;
 
-	if (!recorder->EncoderToFile(error)) {
-		encoder_close(recorder->encoder);
-		close(recorder->fd);
-		unlink(recorder->path);
+	if (!recorder->OpenFile(recorder->ExpandPath(), error)) {
+		recorder->writer->Stop();
 		return false;
 	}
 
+	audio_format = recorder->audio_format;
 	return true;
 }
 
 static void
 recorder_output_close(AudioOutput *ao)
 {
-	RecorderOutput *recorder = (RecorderOutput *)ao;
+	RecorderOutput *recorder = RecorderOutput::Cast(ao);
 
-	/* flush the encoder and write the rest to the file */
+	recorder->CloseFile();
 
-	if (encoder_end(recorder->encoder, IgnoreError()))
-		recorder->EncoderToFile(IgnoreError());
+	/* this waits until the writer thread has finished the
+	   file */
+	recorder->writer->Stop();
 
-	/* now really close everything */
+	recorder->current_path.clear();
+}
+
+static void
+recorder_output_send_tag(AudioOutput *ao, const Tag *tag)
+{
+	RecorderOutput *recorder = RecorderOutput::Cast(ao);
 
-	encoder_close(recorder->encoder);
+	if (recorder->format_path == nullptr)
+		return;
 
-	close(recorder->fd);
+	delete recorder->tag;
+	recorder->tag = new Tag(*tag);
+
+	/* start a new file for the new song */
+
+	Error error;
+	if (!recorder->Rotate(error))
+		LogError(error);
 }
 
 static size_t
 recorder_output_play(AudioOutput *ao, const void *chunk, size_t size,
 		     Error &error)
 {
-	RecorderOutput *recorder = (RecorderOutput *)ao;
+	RecorderOutput *recorder = RecorderOutput::Cast(ao);
+
+	if ((!recorder->file_open ||
+	     (recorder->rotate_time > 0 &&
+	      MonotonicClockS() - recorder->file_start >= recorder->rotate_time)) &&
+	    !recorder->Rotate(error))
+		return 0;
+
+	if (!recorder->encoder_thread->Write({ chunk, size }, error))
+		return 0;
 
-	return encoder_write(recorder->encoder, chunk, size, error) &&
-		recorder->EncoderToFile(error)
-		? size : 0;
+	return size;
 }
 
 const struct AudioOutputPlugin recorder_output_plugin = {
@@ -250,6 +507,7 @@ const struct AudioOutputPlugin recorder_output_plugin = {
 	recorder_output_close,
 	nullptr,
 	nullptr,
+	recorder_output_send_tag,
 	recorder_output_play,
 	nullptr,
 	nullptr,
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "RecorderWriter.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "system/fd_util.h"
+#include "Log.hxx"
+#include "open.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static constexpr Domain recorder_writer_domain("recorder_writer");
+
+RecorderWriter::RecorderWriter(size_t _max_queue, uint64_t _preallocate)
+	:max_queue(_max_queue), preallocate(_preallocate),
+	 queued(0), quit(false), dropped(0),
+	 fd(-1), direct(false), position(0), allocated(0),
+	 direct_buffer(nullptr), direct_fill(0)
+{
+}
+
+RecorderWriter::~RecorderWriter()
+{
+	assert(!thread.IsDefined());
+	assert(fd < 0);
+
+	free(direct_buffer);
+
+	for (auto &i : queue)
+		if (i.fd >= 0)
+			close(i.fd);
+}
+
+bool
+RecorderWriter::Start(Error &error)
+{
+	assert(!thread.IsDefined());
+
+	quit = false;
+	dropped = 0;
+	return thread.Start(Task, this, error);
+}
+
+void
+RecorderWriter::Stop()
+{
+	assert(thread.IsDefined());
+
+	mutex.lock();
+	quit = true;
+	cond.signal();
+	mutex.unlock();
+
+	thread.Join();
+}
+
+int
+RecorderWriter::OpenFile(const char *path, bool direct, Error &error)
+{
+	const int flags = O_CREAT|O_WRONLY|O_TRUNC|O_BINARY;
+
+#ifdef O_DIRECT
+	if (direct) {
+		int fd = open_cloexec(path, flags|O_DIRECT, 0666);
+		if (fd >= 0)
+			return fd;
+
+		if (errno != EINVAL) {
+			error.FormatErrno("Failed to create '%s'", path);
+			return -1;
+		}
+
+		/* EINVAL means the file system does not support
+		   O_DIRECT; try again without it */
+	}
+#else
+	(void)direct;
+#endif
+
+	int fd = open_cloexec(path, flags, 0666);
+	if (fd < 0)
+		error.FormatErrno("Failed to create '%s'", path);
+
+	return fd;
+}
+
+void
+RecorderWriter::SwitchFile(int new_fd, const char *new_path)
+{
+	assert(new_fd >= 0);
+
+	const ScopeLock protect(mutex);
+	queue.emplace_back(new_fd, new_path);
+	cond.signal();
+}
+
+void
+RecorderWriter::Write(const void *_data, size_t size)
+{
+	const uint8_t *data = (const uint8_t *)_data;
+
+	const ScopeLock protect(mutex);
+
+	if (queued + size > max_queue) {
+		if (dropped == 0)
+			LogWarning(recorder_writer_domain,
+				   "Disk too slow, discarding data");
+		dropped += size;
+		return;
+	}
+
+	if (dropped > 0) {
+		FormatWarning(recorder_writer_domain,
+			      "Discarded %llu bytes",
+			      (unsigned long long)dropped);
+		dropped = 0;
+	}
+
+	queued += size;
+
+	while (size > 0) {
+		if (queue.empty() || queue.back().fd >= 0 ||
+		    queue.back().data.size() >= BLOCK_SIZE) {
+			queue.emplace_back();
+			queue.back().data.reserve(BLOCK_SIZE);
+		}
+
+		auto &block = queue.back().data;
+		size_t n = BLOCK_SIZE - block.size();
+		if (n > size)
+			n = size;
+
+		block.insert(block.end(), data, data + n);
+		data += n;
+		size -= n;
+	}
+
+	cond.signal();
+}
+
+bool
+RecorderWriter::WriteFully(const uint8_t *data, size_t size)
+{
+	while (size > 0) {
+		ssize_t nbytes = write(fd, data, size);
+		if (nbytes > 0) {
+			data += nbytes;
+			size -= nbytes;
+			position += nbytes;
+		} else if (nbytes == 0) {
+			/* shouldn't happen for files */
+			FormatError(recorder_writer_domain,
+				    "write() to '%s' returned 0",
+				    path.c_str());
+			return false;
+		} else if (errno != EINTR) {
+			FormatErrno(recorder_writer_domain,
+				    "Failed to write to '%s'", path.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+inline void
+RecorderWriter::Preallocate(size_t size)
+{
+#ifdef __linux__
+	if (preallocate == 0 || position + size <= allocated)
+		return;
+
+	/* reserve disk space in large steps, to reduce
+	   fragmentation; errors are not fatal */
+	if (fallocate(fd, FALLOC_FL_KEEP_SIZE,
+		      allocated, preallocate) == 0)
+		allocated += preallocate;
+	else
+		/* not supported; don't try again for this file */
+		allocated = ~uint64_t(0);
+#else
+	(void)size;
+#endif
+}
+
+void
+RecorderWriter::DisableDirect()
+{
+#ifdef O_DIRECT
+	assert(direct);
+
+	direct = false;
+	int flags = fcntl(fd, F_GETFL);
+	if (flags >= 0)
+		fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+}
+
+void
+RecorderWriter::WriteFile(const uint8_t *data, size_t size)
+{
+	if (fd < 0)
+		/* no file, or a previous error */
+		return;
+
+	Preallocate(size);
+
+	bool success;
+	if (direct) {
+		/* collect the data in the aligned buffer, and write
+		   only full buffers */
+
+		success = true;
+		while (size > 0 && success) {
+			size_t n = BLOCK_SIZE - direct_fill;
+			if (n > size)
+				n = size;
+
+			memcpy(direct_buffer + direct_fill, data, n);
+			direct_fill += n;
+			data += n;
+			size -= n;
+
+			if (direct_fill == BLOCK_SIZE) {
+				success = WriteFully(direct_buffer,
+						     BLOCK_SIZE);
+				direct_fill = 0;
+			}
+		}
+	} else
+		success = WriteFully(data, size);
+
+	if (!success) {
+		/* discard the rest of this file */
+		close(fd);
+		fd = -1;
+	}
+}
+
+void
+RecorderWriter::CloseFile()
+{
+	if (fd < 0)
+		return;
+
+	if (direct) {
+		/* the tail is not aligned; write it without
+		   O_DIRECT */
+		DisableDirect();
+
+		if (direct_fill > 0 && !WriteFully(direct_buffer, direct_fill))
+			FormatError(recorder_writer_domain,
+				    "Failed to finish '%s'", path.c_str());
+
+		direct_fill = 0;
+	}
+
+	if (allocated > position && ftruncate(fd, position) < 0)
+		/* failed to give back the unused preallocated
+		   space; not fatal */
+		FormatErrno(recorder_writer_domain,
+			    "Failed to truncate '%s'", path.c_str());
+
+	close(fd);
+	fd = -1;
+}
+
+inline void
+RecorderWriter::Task()
+{
+	mutex.lock();
+
+	while (true) {
+		if (queue.empty()) {
+			if (quit)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		Item item = std::move(queue.front());
+		queue.pop_front();
+		queued -= item.data.size();
+
+		mutex.unlock();
+
+		if (item.fd >= 0) {
+			CloseFile();
+
+			fd = item.fd;
+			path = std::move(item.path);
+			position = allocated = 0;
+
+#ifdef O_DIRECT
+			const int flags = fcntl(fd, F_GETFL);
+			direct = flags >= 0 && (flags & O_DIRECT) != 0;
+			if (direct && direct_buffer == nullptr &&
+			    posix_memalign((void **)&direct_buffer,
+					   DIRECT_ALIGN, BLOCK_SIZE) != 0) {
+				direct_buffer = nullptr;
+				DisableDirect();
+			}
+#endif
+		} else
+			WriteFile(item.data.data(), item.data.size());
+
+		mutex.lock();
+	}
+
+	mutex.unlock();
+
+	CloseFile();
+}
+
+void
+RecorderWriter::Task(void *ctx)
+{
+	RecorderWriter &writer = *(RecorderWriter *)ctx;
+	writer.Task();
+}
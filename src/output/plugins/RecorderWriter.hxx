@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RECORDER_WRITER_HXX
+#define MPD_RECORDER_WRITER_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Error;
+
+/**
+ * Writes data to files in a separate thread, so a slow disk never
+ * blocks the output thread.  The queue is bounded; if it is full,
+ * new data is discarded (with a warning).
+ *
+ * All public methods are called from the output thread, or from the
+ * encoder thread while it runs (never from both at a time).
+ */
+class RecorderWriter {
+	/**
+	 * Direct I/O requires buffers and file offsets aligned to the
+	 * logical block size; this is a safe value for all common
+	 * file systems.
+	 */
+	static constexpr size_t DIRECT_ALIGN = 4096;
+
+	/**
+	 * The capacity of one queued block and the size of the
+	 * aligned buffer for direct I/O.
+	 */
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	struct Item {
+		/**
+		 * If non-negative, then this item switches to a new
+		 * file; it is then owned by the writer thread.
+		 */
+		int fd;
+
+		std::string path;
+
+		std::vector<uint8_t> data;
+
+		Item():fd(-1) {}
+
+		Item(int _fd, const char *_path)
+			:fd(_fd), path(_path) {}
+	};
+
+	const size_t max_queue;
+	const uint64_t preallocate;
+
+	Thread thread;
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Protected by #mutex.
+	 */
+	std::list<Item> queue;
+
+	/**
+	 * The number of data bytes in #queue.  Protected by #mutex.
+	 */
+	size_t queued;
+
+	/**
+	 * Tell the thread to finish the queue and exit.  Protected
+	 * by #mutex.
+	 */
+	bool quit;
+
+	/**
+	 * The number of bytes discarded since the queue has
+	 * overflowed; 0 if it has not.  Only used by the caller
+	 * of Write().
+	 */
+	uint64_t dropped;
+
+	/* the following attributes are only used by the writer
+	   thread */
+
+	int fd;
+	std::string path;
+
+	/**
+	 * Is #fd opened with O_DIRECT?
+	 */
+	bool direct;
+
+	/**
+	 * The number of bytes written to #fd.
+	 */
+	uint64_t position;
+
+	/**
+	 * The number of bytes allocated with fallocate().
+	 */
+	uint64_t allocated;
+
+	/**
+	 * The buffer for direct I/O, aligned to #DIRECT_ALIGN.
+	 */
+	uint8_t *direct_buffer;
+	size_t direct_fill;
+
+public:
+	/**
+	 * @param max_queue the maximum number of bytes in the queue
+	 * @param preallocate reserve this many bytes at a time with
+	 * fallocate(); 0 disables preallocation
+	 */
+	RecorderWriter(size_t max_queue, uint64_t preallocate);
+	~RecorderWriter();
+
+	RecorderWriter(const RecorderWriter &) = delete;
+	RecorderWriter &operator=(const RecorderWriter &) = delete;
+
+	bool Start(Error &error);
+
+	/**
+	 * Write all queued data, close the file and stop the thread.
+	 */
+	void Stop();
+
+	/**
+	 * Open a file for writing, to be used by SwitchFile().
+	 *
+	 * @param direct use O_DIRECT if the file system supports it
+	 * @return the file descriptor or -1 on error
+	 */
+	static int OpenFile(const char *path, bool direct, Error &error);
+
+	/**
+	 * Finish the current file and continue writing to the given
+	 * one (opened by OpenFile()), which is then owned by this
+	 * object.
+	 */
+	void SwitchFile(int fd, const char *path);
+
+	/**
+	 * Queue data for the current file.
+	 */
+	void Write(const void *data, size_t size);
+
+private:
+	void Task();
+	static void Task(void *ctx);
+
+	void CloseFile();
+	void WriteFile(const uint8_t *data, size_t size);
+	bool WriteFully(const uint8_t *data, size_t size);
+	void Preallocate(size_t size);
+
+	/**
+	 * Disable O_DIRECT on the current file (to write an
+	 * unaligned tail).
+	 */
+	void DisableDirect();
+};
+
+#endif
@@ -20,12 +20,16 @@
 #include "config.h"
 #include "ShoutOutputPlugin.hxx"
 #include "../OutputAPI.hxx"
+#include "../Timer.hxx"
 #include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderThread.hxx"
 #include "encoder/EncoderList.hxx"
 #include "config/ConfigError.hxx"
+#include "util/Cast.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "system/FatalError.hxx"
+#include "system/Clock.hxx"
 #include "Log.hxx"
 
 #include <shout/shout.h>
@@ -34,10 +38,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 
 static constexpr unsigned DEFAULT_CONN_TIMEOUT = 2;
 
-struct ShoutOutput final {
+/**
+ * The default upper limit for the number of encoded bytes which
+ * libshout may queue while the server is not accepting data.
+ */
+static constexpr unsigned DEFAULT_MAX_QUEUE = 256 * 1024;
+
+struct ShoutOutput final : EncoderThread::Handler {
 	AudioOutput base;
 
 	shout_t *shout_conn;
@@ -45,22 +56,65 @@ struct ShoutOutput final {
 
 	Encoder *encoder;
 
+	/**
+	 * Runs the #encoder and sends its output to the server while
+	 * the connection is open.  The #shout_conn is only used by
+	 * this thread then.
+	 */
+	EncoderThread *encoder_thread;
+
+	/**
+	 * Paces the output thread to the speed of real playback.
+	 * libshout is in nonblocking mode, therefore the network
+	 * cannot do that.
+	 */
+	Timer *timer;
+
 	float quality;
 	int bitrate;
 
 	int timeout;
 
+	/**
+	 * The maximum number of bytes in libshout's send queue.
+	 * Beyond that, #overflow decides what happens.
+	 */
+	size_t max_queue;
+
+	enum class Overflow {
+		/**
+		 * Discard new data until the server catches up.
+		 */
+		DROP,
+
+		/**
+		 * Fail; the output will be reopened later.
+		 */
+		RECONNECT,
+	} overflow;
+
+	/**
+	 * The number of encoder buffers discarded since the output
+	 * was opened.  Only used by the encoder thread.
+	 */
+	unsigned dropped;
+
 	uint8_t buffer[32768];
 
 	ShoutOutput()
 		:base(shout_output_plugin),
 		 shout_conn(shout_new()),
 		shout_meta(shout_metadata_new()),
+		encoder_thread(nullptr),
 		quality(-2.0),
 		bitrate(-1),
-		timeout(DEFAULT_CONN_TIMEOUT) {}
+		timeout(DEFAULT_CONN_TIMEOUT),
+		max_queue(DEFAULT_MAX_QUEUE),
+		overflow(Overflow::DROP) {}
 
 	~ShoutOutput() {
+		delete encoder_thread;
+
 		if (shout_meta != nullptr)
 			shout_metadata_free(shout_meta);
 		if (shout_conn != nullptr)
@@ -72,6 +126,15 @@ struct ShoutOutput final {
 	}
 
 	bool Configure(const config_param &param, Error &error);
+
+	static ShoutOutput *Cast(AudioOutput *ao) {
+		return MemberContainerCast(ao, &ShoutOutput::base);
+	}
+
+	/* virtual methods from class EncoderThread::Handler */
+	bool OnEncoderOutput(Encoder &encoder, size_t input_size,
+			     Error &error) override;
+	bool OnEncoderTag(Encoder &encoder, Error &error) override;
 };
 
 static int shout_init_count;
@@ -177,6 +240,8 @@ ShoutOutput::Configure(const config_param &param, Error &error)
 	if (encoder == nullptr)
 		return false;
 
+	encoder_thread = new EncoderThread(*encoder, *this);
+
 	unsigned shout_format;
 	if (strcmp(encoding, "mp3") == 0 || strcmp(encoding, "lame") == 0)
 		shout_format = SHOUT_FORMAT_MP3;
@@ -219,7 +284,8 @@ ShoutOutput::Configure(const config_param &param, Error &error)
 	    shout_set_format(shout_conn, shout_format)
 	    != SHOUTERR_SUCCESS ||
 	    shout_set_protocol(shout_conn, protocol) != SHOUTERR_SUCCESS ||
-	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS) {
+	    shout_set_agent(shout_conn, "MPD") != SHOUTERR_SUCCESS ||
+	    shout_set_nonblocking(shout_conn, 1) != SHOUTERR_SUCCESS) {
 		error.Set(shout_output_domain, shout_get_error(shout_conn));
 		return false;
 	}
@@ -227,6 +293,25 @@ ShoutOutput::Configure(const config_param &param, Error &error)
 	/* optional paramters */
 	timeout = param.GetBlockValue("timeout", DEFAULT_CONN_TIMEOUT);
 
+	max_queue = param.GetBlockValue("max_queue", DEFAULT_MAX_QUEUE);
+	if (max_queue == 0) {
+		error.Set(config_domain, "shout max_queue must be positive");
+		return false;
+	}
+
+	value = param.GetBlockValue("queue_policy", "drop");
+	if (strcmp(value, "drop") == 0)
+		overflow = Overflow::DROP;
+	else if (strcmp(value, "reconnect") == 0)
+		overflow = Overflow::RECONNECT;
+	else {
+		error.Format(config_domain,
+			     "shout queue_policy \"%s\" is not \"drop\" or "
+			     "\"reconnect\"",
+			     value);
+		return false;
+	}
+
 	value = param.GetBlockValue("genre");
 	if (value != nullptr && shout_set_genre(shout_conn, value)) {
 		error.Set(shout_output_domain, shout_get_error(shout_conn));
@@ -297,6 +382,9 @@ handle_shout_error(ShoutOutput *sd, int err, Error &error)
 {
 	switch (err) {
 	case SHOUTERR_SUCCESS:
+	case SHOUTERR_BUSY:
+		/* nonblocking mode: the rest is in libshout's
+		   queue */
 		break;
 
 	case SHOUTERR_UNCONNECTED:
@@ -320,27 +408,78 @@ handle_shout_error(ShoutOutput *sd, int err, Error &error)
 	return true;
 }
 
+/**
+ * Pass encoded data to libshout, unless its queue has grown beyond
+ * #ShoutOutput::max_queue because the server is too slow.
+ */
+static bool
+send_page(ShoutOutput *sd, size_t nbytes, Error &error)
+{
+	const ssize_t queued = shout_queuelen(sd->shout_conn);
+	if (queued > 0 && size_t(queued) + nbytes > sd->max_queue) {
+		if (sd->overflow == ShoutOutput::Overflow::RECONNECT) {
+			error.Format(shout_output_domain,
+				     "shout server %s:%i is too slow, "
+				     "%ld bytes are queued",
+				     shout_get_host(sd->shout_conn),
+				     shout_get_port(sd->shout_conn),
+				     (long)queued);
+			return false;
+		}
+
+		if (sd->dropped++ == 0)
+			FormatWarning(shout_output_domain,
+				      "shout server %s:%i is too slow, "
+				      "dropping data",
+				      shout_get_host(sd->shout_conn),
+				      shout_get_port(sd->shout_conn));
+		return true;
+	}
+
+	int err = shout_send(sd->shout_conn, sd->buffer, nbytes);
+	return handle_shout_error(sd, err, error);
+}
+
 static bool
 write_page(ShoutOutput *sd, Error &error)
 {
 	assert(sd->encoder != nullptr);
 
 	while (true) {
-		size_t nbytes = encoder_read(sd->encoder,
-					     sd->buffer, sizeof(sd->buffer));
+		/* fill the whole buffer to send fewer, larger
+		   packets */
+		size_t nbytes = encoder_read_all(sd->encoder,
+						 { sd->buffer,
+						   sizeof(sd->buffer) });
 		if (nbytes == 0)
 			return true;
 
-		int err = shout_send(sd->shout_conn, sd->buffer, nbytes);
-		if (!handle_shout_error(sd, err, error))
+		if (!send_page(sd, nbytes, error))
 			return false;
 	}
 
 	return true;
 }
 
+bool
+ShoutOutput::OnEncoderOutput(Encoder &, size_t, Error &error)
+{
+	return write_page(this, error);
+}
+
+bool
+ShoutOutput::OnEncoderTag(Encoder &, Error &error)
+{
+	return write_page(this, error);
+}
+
 static void close_shout_conn(ShoutOutput * sd)
 {
+	/* send all queued data, and take the encoder back from the
+	   thread */
+	if (sd->encoder_thread->IsRunning())
+		sd->encoder_thread->Stop();
+
 	if (sd->encoder != nullptr) {
 		if (encoder_end(sd->encoder, IgnoreError()))
 			write_page(sd, IgnoreError());
@@ -348,6 +487,25 @@ static void close_shout_conn(ShoutOutput * sd)
 		encoder_close(sd->encoder);
 	}
 
+	/* give the server a chance to receive what is still queued,
+	   but don't wait longer than the configured timeout */
+	const unsigned deadline = MonotonicClockMS() + sd->timeout * 1000;
+	while (shout_queuelen(sd->shout_conn) > 0 &&
+	       MonotonicClockMS() < deadline) {
+		int err = shout_send(sd->shout_conn, nullptr, 0);
+		if (err != SHOUTERR_SUCCESS && err != SHOUTERR_BUSY)
+			break;
+
+		usleep(10000);
+	}
+
+	if (sd->dropped > 0)
+		FormatWarning(shout_output_domain,
+			      "%u buffers were dropped because the shout "
+			      "server was too slow", sd->dropped);
+
+	delete sd->timer;
+
 	if (shout_get_connected(sd->shout_conn) != SHOUTERR_UNCONNECTED &&
 	    shout_close(sd->shout_conn) != SHOUTERR_SUCCESS) {
 		FormatWarning(shout_output_domain,
@@ -359,7 +517,7 @@ static void close_shout_conn(ShoutOutput * sd)
 static void
 my_shout_finish_driver(AudioOutput *ao)
 {
-	ShoutOutput *sd = (ShoutOutput *)ao;
+	ShoutOutput *sd = ShoutOutput::Cast(ao);
 
 	encoder_finish(sd->encoder);
 
@@ -374,16 +532,18 @@ my_shout_finish_driver(AudioOutput *ao)
 static void
 my_shout_drop_buffered_audio(AudioOutput *ao)
 {
-	gcc_unused
-	ShoutOutput *sd = (ShoutOutput *)ao;
+	ShoutOutput *sd = ShoutOutput::Cast(ao);
 
-	/* needs to be implemented for shout */
+	/* discard the data which has not been encoded yet */
+	sd->encoder_thread->Cancel();
+
+	sd->timer->Reset();
 }
 
 static void
 my_shout_close_device(AudioOutput *ao)
 {
-	ShoutOutput *sd = (ShoutOutput *)ao;
+	ShoutOutput *sd = ShoutOutput::Cast(ao);
 
 	close_shout_conn(sd);
 }
@@ -391,11 +551,32 @@ my_shout_close_device(AudioOutput *ao)
 static bool
 shout_connect(ShoutOutput *sd, Error &error)
 {
-	switch (shout_open(sd->shout_conn)) {
+	int result = shout_open(sd->shout_conn);
+	if (result == SHOUTERR_BUSY) {
+		/* nonblocking mode: wait for the handshake, but
+		   not longer than the configured timeout */
+		const unsigned deadline =
+			MonotonicClockMS() + sd->timeout * 1000;
+		do {
+			usleep(10000);
+			result = shout_get_connected(sd->shout_conn);
+		} while (result == SHOUTERR_BUSY &&
+			 MonotonicClockMS() < deadline);
+	}
+
+	switch (result) {
 	case SHOUTERR_SUCCESS:
 	case SHOUTERR_CONNECTED:
 		return true;
 
+	case SHOUTERR_BUSY:
+		shout_close(sd->shout_conn);
+		error.Format(shout_output_domain,
+			     "timeout connecting to shout server %s:%i",
+			     shout_get_host(sd->shout_conn),
+			     shout_get_port(sd->shout_conn));
+		return false;
+
 	default:
 		error.Format(shout_output_domain,
 			     "problem opening connection to shout server %s:%i: %s",
@@ -410,7 +591,9 @@ static bool
 my_shout_open_device(AudioOutput *ao, AudioFormat &audio_format,
 		     Error &error)
 {
-	ShoutOutput *sd = (ShoutOutput *)ao;
+	ShoutOutput *sd = ShoutOutput::Cast(ao);
+
+	sd->dropped = 0;
 
 	if (!shout_connect(sd, error))
 		return false;
@@ -420,35 +603,41 @@ my_shout_open_device(AudioOutput *ao, AudioFormat &audio_format,
 		return false;
 	}
 
-	if (!write_page(sd, error)) {
+	if (!write_page(sd, error) ||
+	    !sd->encoder_thread->Start(error)) {
 		encoder_close(sd->encoder);
 		shout_close(sd->shout_conn);
 		return false;
 	}
 
+	sd->timer = new Timer(audio_format);
 	return true;
 }
 
 static unsigned
 my_shout_delay(AudioOutput *ao)
 {
-	ShoutOutput *sd = (ShoutOutput *)ao;
-
-	int delay = shout_delay(sd->shout_conn);
-	if (delay < 0)
-		delay = 0;
+	ShoutOutput *sd = ShoutOutput::Cast(ao);
 
-	return delay;
+	return sd->timer->IsStarted()
+		? sd->timer->GetDelay()
+		: 0;
 }
 
 static size_t
 my_shout_play(AudioOutput *ao, const void *chunk, size_t size,
 	      Error &error)
 {
-	ShoutOutput *sd = (ShoutOutput *)ao;
+	ShoutOutput *sd = ShoutOutput::Cast(ao);
+
+	/* the timer paces this thread; the encoder thread never
+	   blocks on the network, because libshout is in nonblocking
+	   mode and its queue is bounded */
+	if (!sd->timer->IsStarted())
+		sd->timer->Start();
+	sd->timer->Add(size);
 
-	return encoder_write(sd->encoder, chunk, size, error) &&
-		write_page(sd, error)
+	return sd->encoder_thread->Write({ chunk, size }, error)
 		? size
 		: 0;
 }
@@ -490,20 +679,20 @@ shout_tag_to_metadata(const Tag *tag, char *dest, size_t size)
 static void my_shout_set_tag(AudioOutput *ao,
 			     const Tag *tag)
 {
-	ShoutOutput *sd = (ShoutOutput *)ao;
+	ShoutOutput *sd = ShoutOutput::Cast(ao);
 
 	if (sd->encoder->plugin.tag != nullptr) {
 		/* encoder plugin supports stream tags */
 
-		Error error;
-		if (!encoder_pre_tag(sd->encoder, error) ||
-		    !write_page(sd, error) ||
-		    !encoder_tag(sd->encoder, tag, error)) {
-			LogError(error);
-			return;
-		}
+		sd->encoder_thread->SendTag(*tag);
 	} else {
 		/* no stream tag support: fall back to icy-metadata */
+
+		/* the connection is used by the encoder thread; wait
+		   until it has sent everything which belongs to the
+		   previous song */
+		sd->encoder_thread->Drain();
+
 		char song[1024];
 		shout_tag_to_metadata(tag, song, sizeof(song));
 
@@ -514,8 +703,6 @@ static void my_shout_set_tag(AudioOutput *ao,
 				   "error setting shout metadata");
 		}
 	}
-
-	write_page(sd, IgnoreError());
 }
 
 const struct AudioOutputPlugin shout_output_plugin = {
@@ -528,6 +715,7 @@ const struct AudioOutputPlugin shout_output_plugin = {
 	my_shout_open_device,
 	my_shout_close_device,
 	my_shout_delay,
+	nullptr,
 	my_shout_set_tag,
 	my_shout_play,
 	nullptr,
@@ -344,6 +344,7 @@ const struct AudioOutputPlugin winmm_output_plugin = {
 	winmm_output_close,
 	nullptr,
 	nullptr,
+	nullptr,
 	winmm_output_play,
 	winmm_output_drain,
 	winmm_output_cancel,
@@ -24,18 +24,24 @@
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "system/SocketError.hxx"
+#include "util/Macros.hxx"
 #include "Log.hxx"
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
+
 HttpdClient::~HttpdClient()
 {
 	if (state == RESPONSE) {
+		--stream->n_clients;
+
 		if (current_page != nullptr)
 			current_page->Unref();
-
-		ClearQueue();
 	}
 
 	if (metadata)
@@ -63,11 +69,18 @@ HttpdClient::BeginResponse()
 {
 	assert(state != RESPONSE);
 
+	const ScopeLock protect(httpd.mutex);
+
 	state = RESPONSE;
 	current_page = nullptr;
+	++stream->n_clients;
+
+	/* start with the most recent pages, or with the next page
+	   from the encoder */
+	next_page = stream->GetStartPosition(httpd.burst_time);
 
-	if (!head_method)
-		httpd.SendHeader(*this);
+	if (!head_method && stream->header != nullptr)
+		PushHeader(*stream->header);
 }
 
 /**
@@ -91,6 +104,12 @@ HttpdClient::HandleLine(const char *line)
 			return false;
 		}
 
+		/* choose the stream by the path, ignoring the query
+		   string */
+		const size_t path_length = strcspn(line, " ?");
+		stream = &httpd.FindStream(line, path_length);
+		metadata_supported = stream->IsIcyMetaDataSupported();
+
 		line = strchr(line, ' ');
 		if (line == nullptr || memcmp(line + 1, "HTTP/", 5) != 0) {
 			/* HTTP/0.9 without request headers */
@@ -157,14 +176,14 @@ HttpdClient::SendResponse()
 			 "realTimeInfo.dlna.org: DLNA.ORG_TLAG=*\r\n"
 			 "contentFeatures.dlna.org: DLNA.ORG_OP=01;DLNA.ORG_CI=0\r\n"
 			 "\r\n",
-			 httpd.content_type);
+			 stream->content_type);
 		response = buffer;
 
 	} else if (metadata_requested) {
 		response = allocated =
 			icy_server_metadata_header(httpd.name, httpd.genre,
 						   httpd.website,
-						   httpd.content_type,
+						   stream->content_type,
 						   metaint);
        } else { /* revert to a normal HTTP request */
 		snprintf(buffer, sizeof(buffer),
@@ -174,7 +193,7 @@ HttpdClient::SendResponse()
 			 "Pragma: no-cache\r\n"
 			 "Cache-Control: no-cache, no-store\r\n"
 			 "\r\n",
-			 httpd.content_type);
+			 stream->content_type);
 		response = buffer;
 	}
 
@@ -185,22 +204,21 @@ HttpdClient::SendResponse()
 		FormatWarning(httpd_output_domain,
 			      "failed to write to client: %s",
 			      (const char *)msg);
-		Close();
+		LockClose();
 		return false;
 	}
 
 	return true;
 }
 
-HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
-			 bool _metadata_supported)
+HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop)
 	:BufferedSocket(_fd, _loop),
 	 httpd(_httpd),
+	 stream(nullptr),
 	 state(REQUEST),
-	 queue_size(0),
 	 head_method(false),
 	 dlna_streaming_requested(false),
-	 metadata_supported(_metadata_supported),
+	 metadata_supported(false),
 	 metadata_requested(false), metadata_sent(true),
 	 metaint(8192), /*TODO: just a std value */
 	 metadata(nullptr),
@@ -209,35 +227,49 @@ HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
 }
 
 void
-HttpdClient::ClearQueue()
+HttpdClient::CancelQueue()
 {
-	assert(state == RESPONSE);
-
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
+	if (state != RESPONSE)
+		return;
 
-#ifndef NDEBUG
-		assert(queue_size >= page->size);
-		queue_size -= page->size;
-#endif
+	next_page = stream->pages.GetHead();
 
-		page->Unref();
-	}
+	if (current_page == nullptr)
+		CancelWrite();
+}
 
-	assert(queue_size == 0);
+inline bool
+HttpdClient::HasPendingPages() const
+{
+	return current_page != nullptr ||
+		next_page != stream->pages.GetHead();
 }
 
-void
-HttpdClient::CancelQueue()
+bool
+HttpdClient::NextPage()
 {
-	if (state != RESPONSE)
-		return;
+	assert(current_page == nullptr);
 
-	ClearQueue();
+	const PageRing &ring = stream->pages;
 
-	if (current_page == nullptr)
-		CancelWrite();
+	if (next_page < ring.GetTail()) {
+		/* the ring has dropped pages which were not sent
+		   yet; continue with the most recent one */
+		FormatDebug(httpd_output_domain,
+			    "client is too slow, flushing its queue");
+
+		next_page = ring.IsEmpty()
+			? ring.GetHead()
+			: ring.GetHead() - 1;
+	}
+
+	if (next_page == ring.GetHead())
+		return false;
+
+	current_page = &ring.Get(next_page++);
+	current_page->Ref();
+	current_position = 0;
+	return true;
 }
 
 ssize_t
@@ -249,21 +281,83 @@ HttpdClient::TryWritePage(const Page &page, size_t position)
 }
 
 ssize_t
-HttpdClient::TryWritePageN(const Page &page, size_t position, ssize_t n)
+HttpdClient::WritePages(size_t limit)
 {
-	return n >= 0
-		? Write(page.data + position, n)
-		: TryWritePage(page, position);
+	assert(current_page != nullptr);
+	assert(current_position < current_page->size);
+	assert(limit > 0);
+
+#ifdef WIN32
+	size_t length = current_page->size - current_position;
+	if (length > limit)
+		length = limit;
+
+	return Write(current_page->data + current_position, length);
+#else
+	const PageRing &ring = stream->pages;
+
+	struct iovec v[16];
+	size_t n = 0;
+
+	const Page *page = current_page;
+	size_t position = current_position;
+	PageRing::Position i = next_page;
+
+	while (true) {
+		size_t length = page->size - position;
+		if (length > limit)
+			length = limit;
+
+		v[n].iov_base = const_cast<unsigned char *>(page->data
+							    + position);
+		v[n].iov_len = length;
+		++n;
+
+		limit -= length;
+		if (limit == 0 || n == ARRAY_SIZE(v) ||
+		    i < ring.GetTail() || i == ring.GetHead())
+			break;
+
+		page = &ring.Get(i++);
+		position = 0;
+	}
+
+	return Write(v, n);
+#endif
 }
 
-ssize_t
-HttpdClient::GetBytesTillMetaData() const
+void
+HttpdClient::ConsumePages(size_t nbytes)
 {
-	if (metadata_requested &&
-	    current_page->size - current_position > metaint - metadata_fill)
-		return metaint - metadata_fill;
+	while (true) {
+		assert(current_page != nullptr);
+
+		const size_t remaining = current_page->size - current_position;
+		if (nbytes < remaining) {
+			current_position += nbytes;
+			return;
+		}
 
-	return -1;
+		nbytes -= remaining;
+		current_page->Unref();
+		current_page = nullptr;
+
+		if (nbytes == 0)
+			return;
+
+		/* WritePages() has sent parts of the following
+		   pages, too */
+		gcc_unused const bool found = NextPage();
+		assert(found);
+	}
+}
+
+size_t
+HttpdClient::GetBytesTillMetaData() const
+{
+	return metadata_requested
+		? metaint - metadata_fill
+		: SIZE_MAX;
 }
 
 inline bool
@@ -273,24 +367,15 @@ HttpdClient::TryWrite()
 
 	assert(state == RESPONSE);
 
-	if (current_page == nullptr) {
-		if (pages.empty()) {
-			/* another thread has removed the event source
-			   while this thread was waiting for
-			   httpd.mutex */
-			CancelWrite();
-			return true;
-		}
-
-		current_page = pages.front();
-		pages.pop();
-		current_position = 0;
-
-		assert(queue_size >= current_page->size);
-		queue_size -= current_page->size;
+	if (current_page == nullptr && !NextPage()) {
+		/* another thread has removed the event source
+		   while this thread was waiting for
+		   httpd.mutex */
+		CancelWrite();
+		return true;
 	}
 
-	const ssize_t bytes_to_write = GetBytesTillMetaData();
+	const size_t bytes_to_write = GetBytesTillMetaData();
 	if (bytes_to_write == 0) {
 		if (!metadata_sent) {
 			ssize_t nbytes = TryWritePage(*metadata,
@@ -342,9 +427,7 @@ HttpdClient::TryWrite()
 			metadata_current_position = 0;
 		}
 	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
+		ssize_t nbytes = WritePages(bytes_to_write);
 		if (nbytes < 0) {
 			auto e = GetSocketError();
 			if (IsSocketErrorAgain(e))
@@ -361,44 +444,42 @@ HttpdClient::TryWrite()
 			return false;
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->size);
-
 		if (metadata_requested)
 			metadata_fill += nbytes;
 
-		if (current_position >= current_page->size) {
-			current_page->Unref();
-			current_page = nullptr;
+		ConsumePages(nbytes);
 
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+		if (!HasPendingPages())
+			/* all pages are sent: remove the event
+			   source */
+			CancelWrite();
 	}
 
 	return true;
 }
 
 void
-HttpdClient::PushPage(Page *page)
+HttpdClient::PushHeader(Page &page)
+{
+	assert(state == RESPONSE);
+	assert(current_page == nullptr);
+
+	page.Ref();
+	current_page = &page;
+	current_position = 0;
+
+	ScheduleWrite();
+}
+
+void
+HttpdClient::OnNewPages()
 {
 	if (state != RESPONSE)
 		/* the client is still writing the HTTP request */
 		return;
 
-	if (queue_size > 256 * 1024) {
-		FormatDebug(httpd_output_domain,
-			    "client is too slow, flushing its queue");
-		ClearQueue();
-	}
-
-	page->Ref();
-	pages.push(page);
-	queue_size += page->size;
-
-	ScheduleWrite();
+	if (HasPendingPages())
+		ScheduleWrite();
 }
 
 void
@@ -20,15 +20,14 @@
 #ifndef MPD_OUTPUT_HTTPD_CLIENT_HXX
 #define MPD_OUTPUT_HTTPD_CLIENT_HXX
 
+#include "PageRing.hxx"
 #include "event/BufferedSocket.hxx"
 #include "Compiler.h"
 
-#include <queue>
-#include <list>
-
 #include <stddef.h>
 
 class HttpdOutput;
+class HttpdStream;
 class Page;
 
 class HttpdClient final : BufferedSocket {
@@ -37,6 +36,12 @@ class HttpdClient final : BufferedSocket {
 	 */
 	HttpdOutput &httpd;
 
+	/**
+	 * The stream which was requested by the client.  It is
+	 * known after the request line has been received.
+	 */
+	HttpdStream *stream;
+
 	/**
 	 * The current state of the client.
 	 */
@@ -52,17 +57,15 @@ class HttpdClient final : BufferedSocket {
 	} state;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
-	 */
-	std::queue<Page *, std::list<Page *>> pages;
-
-	/**
-	 * The sum of all page sizes in #pages.
+	 * The position of the next page in HttpdStream::pages which
+	 * will be sent to the client.
 	 */
-	size_t queue_size;
+	PageRing::Position next_page;
 
 	/**
-	 * The #page which is currently being sent to the client.
+	 * The #page which is currently being sent to the client.  This
+	 * is either the header page or a page from the ring, and the
+	 * client holds a reference to it.
 	 */
 	Page *current_page;
 
@@ -86,7 +89,7 @@ class HttpdClient final : BufferedSocket {
 
 	/**
 	 * Do we support sending Icy-Metadata to the client?  This is
-	 * disabled if the httpd audio output uses encoder tags.
+	 * disabled if the encoder of the requested stream embeds tags.
 	 */
 	bool metadata_supported;
 
@@ -126,8 +129,7 @@ public:
 	 * @param httpd the HTTP output device
 	 * @param fd the socket file descriptor
 	 */
-	HttpdClient(HttpdOutput &httpd, int _fd, EventLoop &_loop,
-		    bool _metadata_supported);
+	HttpdClient(HttpdOutput &httpd, int _fd, EventLoop &_loop);
 
 	/**
 	 * Note: this does not remove the client from the
@@ -143,7 +145,9 @@ public:
 	void LockClose();
 
 	/**
-	 * Clears the page queue.
+	 * Skips all pages which have not been sent yet.
+	 *
+	 * Caller must lock the mutex.
 	 */
 	void CancelQueue();
 
@@ -162,18 +166,31 @@ public:
 	 */
 	bool SendResponse();
 
+	/**
+	 * Returns the amount of stream data which may be sent before
+	 * the next metadata block is due.
+	 */
 	gcc_pure
-	ssize_t GetBytesTillMetaData() const;
+	size_t GetBytesTillMetaData() const;
 
 	ssize_t TryWritePage(const Page &page, size_t position);
-	ssize_t TryWritePageN(const Page &page, size_t position, ssize_t n);
 
 	bool TryWrite();
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Sends the specified page before all pages from the ring.
+	 * This is used for the encoder header.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void PushHeader(Page &page);
+
+	/**
+	 * New pages have been added to HttpdStream::pages.
+	 *
+	 * Caller must lock the mutex.
 	 */
-	void PushPage(Page *page);
+	void OnNewPages();
 
 	/**
 	 * Sends the passed metadata.
@@ -181,7 +198,38 @@ public:
 	void PushMetaData(Page *page);
 
 private:
-	void ClearQueue();
+	/**
+	 * Are there pages which have not been sent yet?
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	bool HasPendingPages() const;
+
+	/**
+	 * Make the next page from the ring the #current_page.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @return false if there is no page to be sent
+	 */
+	bool NextPage();
+
+	/**
+	 * Send as much as possible from #current_page and the
+	 * following pages of the ring with one system call.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @param limit the maximum number of bytes
+	 */
+	ssize_t WritePages(size_t limit);
+
+	/**
+	 * Forget the specified number of bytes which have been sent
+	 * by WritePages().
+	 */
+	void ConsumePages(size_t nbytes);
 
 protected:
 	virtual bool OnSocketReady(unsigned flags) override;
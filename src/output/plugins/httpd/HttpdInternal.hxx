@@ -25,6 +25,7 @@
 #ifndef MPD_OUTPUT_HTTPD_INTERNAL_H
 #define MPD_OUTPUT_HTTPD_INTERNAL_H
 
+#include "HttpdStream.hxx"
 #include "output/Internal.hxx"
 #include "output/Timer.hxx"
 #include "thread/Mutex.hxx"
@@ -38,7 +39,6 @@
 #endif
 
 #include <forward_list>
-#include <queue>
 #include <list>
 
 struct config_param;
@@ -47,7 +47,7 @@ class EventLoop;
 class ServerSocket;
 class HttpdClient;
 class Page;
-struct Encoder;
+struct EncoderPlugin;
 struct Tag;
 
 class HttpdOutput final : ServerSocket, DeferredMonitor {
@@ -60,36 +60,23 @@ class HttpdOutput final : ServerSocket, DeferredMonitor {
 	bool open;
 
 	/**
-	 * The configured encoder plugin.
+	 * The streams of this output, each with its own encoder and
+	 * path.  The first one is the default stream, configured
+	 * with the plain "encoder" setting; more are configured with
+	 * "streamN_*" settings.  The list does not change after
+	 * Configure().
 	 */
-	Encoder *encoder;
-
-	/**
-	 * Number of bytes which were fed into the encoder, without
-	 * ever receiving new output.  This is used to estimate
-	 * whether MPD should manually flush the encoder, to avoid
-	 * buffer underruns in the client.
-	 */
-	size_t unflushed_input;
+	std::list<HttpdStream> streams;
 
 public:
 	/**
-	 * The MIME type produced by the #encoder.
-	 */
-	const char *content_type;
-
-	/**
-	 * This mutex protects the listener socket and the client
-	 * list.
+	 * This mutex protects the listener socket, the client list
+	 * and the page rings of all streams.  The OutputThread adds
+	 * pages, and the IOThread sends them to each client, which
+	 * only remembers its position in the ring.
 	 */
 	mutable Mutex mutex;
 
-	/**
-	 * This condition gets signalled when an item is removed from
-	 * #pages.
-	 */
-	Cond cond;
-
 private:
 	/**
 	 * A #Timer object to synchronize this output with the
@@ -97,24 +84,11 @@ private:
 	 */
 	Timer *timer;
 
-	/**
-	 * The header page, which is sent to every client on connect.
-	 */
-	Page *header;
-
 	/**
 	 * The metadata, which is sent to every client.
 	 */
 	Page *metadata;
 
-	/**
-	 * The page queue, i.e. pages from the encoder to be
-	 * broadcasted to all clients.  This container is necessary to
-	 * pass pages from the OutputThread to the IOThread.  It is
-	 * protected by #mutex, and removing signals #cond.
-	 */
-	std::queue<Page *, std::list<Page *>> pages;
-
  public:
 	/**
 	 * The configured name.
@@ -137,10 +111,16 @@ private:
 	std::forward_list<HttpdClient> clients;
 
 	/**
-	 * A temporary buffer for the httpd_output_read_page()
-	 * function.
+	 * The size of pages allocated by ReadPage().
+	 */
+	static constexpr size_t PAGE_SIZE = 32768;
+
+	/**
+	 * A page which was allocated by ReadPage() but not filled,
+	 * because the encoder had no data.  It is reused by the next
+	 * call.
 	 */
-	char buffer[32768];
+	Page *spare_page;
 
 	/**
 	 * The maximum and current number of clients connected
@@ -148,6 +128,15 @@ private:
 	 */
 	unsigned clients_max, clients_cnt;
 
+public:
+	/**
+	 * New clients get this many seconds of the most recent pages
+	 * right away, so they can start playing without waiting for
+	 * their buffer to fill.
+	 */
+	unsigned burst_time;
+
+private:
 public:
 	HttpdOutput(EventLoop &_loop);
 	~HttpdOutput();
@@ -169,6 +158,13 @@ public:
 
 	bool Init(const config_param &param, Error &error);
 
+	/**
+	 * Create a stream with an encoder configured by the specified
+	 * block.
+	 */
+	bool AddStream(const char *path, const config_param &param,
+		       Error &error);
+
 	bool Configure(const config_param &param, Error &error);
 
 	AudioOutput *InitAndConfigure(const config_param &param,
@@ -186,9 +182,13 @@ public:
 	void Unbind();
 
 	/**
+	 * Open the encoders of all streams.  The default stream
+	 * chooses the audio format, the others convert it if
+	 * necessary.
+	 *
 	 * Caller must lock the mutex.
 	 */
-	bool OpenEncoder(AudioFormat &audio_format, Error &error);
+	bool OpenEncoders(AudioFormat &audio_format, Error &error);
 
 	/**
 	 * Caller must lock the mutex.
@@ -219,6 +219,13 @@ public:
 		return HasClients();
 	}
 
+	/**
+	 * Find the stream for the specified request path (without
+	 * the leading slash).
+	 */
+	gcc_pure
+	HttpdStream &FindStream(const char *path, size_t length);
+
 	void AddClient(int fd);
 
 	/**
@@ -226,34 +233,58 @@ public:
 	 */
 	void RemoveClient(HttpdClient &client);
 
-	/**
-	 * Sends the encoder header to the client.  This is called
-	 * right after the response headers have been sent.
-	 */
-	void SendHeader(HttpdClient &client) const;
-
 	gcc_pure
 	unsigned Delay() const;
 
 	/**
 	 * Reads data from the encoder (as much as available) and
-	 * returns it as a new #page object.
+	 * returns it as a new #page object.  The encoder writes
+	 * directly into the page.
+	 *
+	 * Caller must lock the mutex.
 	 */
-	Page *ReadPage();
+	Page *ReadPage(HttpdStream &stream);
 
 	/**
-	 * Broadcasts a page struct to all clients.
+	 * Broadcasts a new header page to all clients of the stream,
+	 * and sends it to new clients from now on.
 	 *
 	 * Mutext must not be locked.
 	 */
-	void BroadcastPage(Page *page);
+	void BroadcastHeader(HttpdStream &stream, Page &page);
 
 	/**
-	 * Broadcasts data from the encoder to all clients.
+	 * Broadcasts data from the encoder to all clients of the
+	 * stream.  Called by the stream's encoder thread.
+	 *
+	 * Mutext must not be locked.
 	 */
-	void BroadcastFromEncoder();
+	void BroadcastFromEncoder(HttpdStream &stream);
 
-	bool EncodeAndPlay(const void *chunk, size_t size, Error &error);
+	/**
+	 * The encoder has started a new stream: its first page
+	 * becomes the new header.  Called by the stream's encoder
+	 * thread.
+	 *
+	 * Mutext must not be locked.
+	 */
+	void BroadcastHeaderFromEncoder(HttpdStream &stream);
+
+	/**
+	 * Stop the encoder threads of all streams, discarding queued
+	 * data.
+	 *
+	 * Mutex must not be locked, because the encoder threads lock
+	 * it.
+	 */
+	void StopEncoders();
+
+	/**
+	 * Discard data queued for the encoders.
+	 *
+	 * Mutex must not be locked.
+	 */
+	void CancelEncoders();
 
 	void SendTag(const Tag *tag);
 
@@ -35,6 +35,7 @@
 #include "Log.hxx"
 
 #include <assert.h>
+#include <stdio.h>
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -52,8 +53,7 @@ inline
 HttpdOutput::HttpdOutput(EventLoop &_loop)
 	:ServerSocket(_loop), DeferredMonitor(_loop),
 	 base(httpd_output_plugin),
-	 encoder(nullptr), unflushed_input(0),
-	 metadata(nullptr)
+	 metadata(nullptr), spare_page(nullptr)
 {
 }
 
@@ -62,9 +62,8 @@ HttpdOutput::~HttpdOutput()
 	if (metadata != nullptr)
 		metadata->Unref();
 
-	if (encoder != nullptr)
-		encoder_finish(encoder);
-
+	if (spare_page != nullptr)
+		spare_page->Unref();
 }
 
 inline bool
@@ -89,16 +88,10 @@ HttpdOutput::Unbind()
 		});
 }
 
-inline bool
-HttpdOutput::Configure(const config_param &param, Error &error)
+bool
+HttpdOutput::AddStream(const char *path, const config_param &param,
+		       Error &error)
 {
-	/* read configuration */
-	name = param.GetBlockValue("name", "Set name in config");
-	genre = param.GetBlockValue("genre", "Set genre in config");
-	website = param.GetBlockValue("website", "Set website in config");
-
-	unsigned port = param.GetBlockValue("port", 8000u);
-
 	const char *encoder_name =
 		param.GetBlockValue("encoder", "vorbis");
 	const auto encoder_plugin = encoder_plugin_get(encoder_name);
@@ -108,7 +101,51 @@ HttpdOutput::Configure(const config_param &param, Error &error)
 		return false;
 	}
 
+	Encoder *encoder = encoder_init(*encoder_plugin, param, error);
+	if (encoder == nullptr)
+		return false;
+
+	streams.emplace_back(*this, path, encoder);
+	streams.back().pages.SetKeepTime(burst_time);
+	return true;
+}
+
+/**
+ * Copy the settings of additional stream number #n (i.e. the ones
+ * called "streamN_NAME") to a new #config_param, without the prefix.
+ *
+ * @return false if there is no such stream
+ */
+static bool
+GetStreamParam(const config_param &param, unsigned n, config_param &dest)
+{
+	char prefix[32];
+	snprintf(prefix, sizeof(prefix), "stream%u_", n);
+	const size_t prefix_length = strlen(prefix);
+
+	for (const auto &i : param.block_params) {
+		if (i.name.compare(0, prefix_length, prefix) == 0) {
+			i.used = true;
+			dest.AddBlockParam(i.name.c_str() + prefix_length,
+					   i.value.c_str(), i.line);
+		}
+	}
+
+	return !dest.block_params.empty();
+}
+
+inline bool
+HttpdOutput::Configure(const config_param &param, Error &error)
+{
+	/* read configuration */
+	name = param.GetBlockValue("name", "Set name in config");
+	genre = param.GetBlockValue("genre", "Set genre in config");
+	website = param.GetBlockValue("website", "Set website in config");
+
+	unsigned port = param.GetBlockValue("port", 8000u);
+
 	clients_max = param.GetBlockValue("max_clients", 0u);
+	burst_time = param.GetBlockValue("burst_time", 0u);
 
 	/* set up bind_to_address */
 
@@ -120,16 +157,27 @@ HttpdOutput::Configure(const config_param &param, Error &error)
 	if (!success)
 		return false;
 
-	/* initialize encoder */
+	/* initialize the encoders */
 
-	encoder = encoder_init(*encoder_plugin, param, error);
-	if (encoder == nullptr)
+	if (!AddStream("", param, error))
 		return false;
 
-	/* determine content type */
-	content_type = encoder_get_mime_type(encoder);
-	if (content_type == nullptr)
-		content_type = "application/octet-stream";
+	for (unsigned n = 1;; ++n) {
+		config_param stream_param(param.line);
+		if (!GetStreamParam(param, n, stream_param))
+			break;
+
+		const char *path = stream_param.GetBlockValue("path");
+		if (path == nullptr || *path != '/' || path[1] == 0) {
+			error.Format(httpd_output_domain,
+				     "Missing or malformed \"stream%u_path\" "
+				     "in line %d", n, param.line);
+			return false;
+		}
+
+		if (!AddStream(path + 1, stream_param, error))
+			return false;
+	}
 
 	return true;
 }
@@ -143,7 +191,7 @@ HttpdOutput::Init(const config_param &param, Error &error)
 static AudioOutput *
 httpd_output_init(const config_param &param, Error &error)
 {
-	HttpdOutput *httpd = new HttpdOutput(io_thread_get());
+	HttpdOutput *httpd = new HttpdOutput(io_thread_get_next());
 
 	AudioOutput *result = httpd->InitAndConfigure(param, error);
 	if (result == nullptr)
@@ -164,11 +212,21 @@ httpd_output_finish(AudioOutput *ao)
  * Creates a new #HttpdClient object and adds it into the
  * HttpdOutput.clients linked list.
  */
+HttpdStream &
+HttpdOutput::FindStream(const char *path, size_t length)
+{
+	for (auto &stream : streams)
+		if (stream.path.length() == length &&
+		    memcmp(stream.path.data(), path, length) == 0)
+			return stream;
+
+	return streams.front();
+}
+
 inline void
 HttpdOutput::AddClient(int fd)
 {
-	clients.emplace_front(*this, fd, GetEventLoop(),
-			      encoder->plugin.tag == nullptr);
+	clients.emplace_front(*this, fd, GetEventLoop());
 	++clients_cnt;
 
 	/* pass metadata to client */
@@ -179,24 +237,13 @@ HttpdOutput::AddClient(int fd)
 void
 HttpdOutput::RunDeferred()
 {
-	/* this method runs in the IOThread; it broadcasts pages from
-	   our own queue to all clients */
+	/* this method runs in the IOThread; it lets all clients know
+	   about new pages in the ring */
 
 	const ScopeLock protect(mutex);
 
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
-
-		for (auto &client : clients)
-			client.PushPage(page);
-
-		page->Unref();
-	}
-
-	/* wake up the client that may be waiting for the queue to be
-	   flushed */
-	cond.broadcast();
+	for (auto &client : clients)
+		client.OnNewPages();
 }
 
 void
@@ -246,33 +293,31 @@ HttpdOutput::OnAccept(int fd, const sockaddr &address,
 }
 
 Page *
-HttpdOutput::ReadPage()
+HttpdOutput::ReadPage(HttpdStream &stream)
 {
-	if (unflushed_input >= 65536) {
+	if (stream.unflushed_input >= 65536) {
 		/* we have fed a lot of input into the encoder, but it
 		   didn't give anything back yet - flush now to avoid
 		   buffer underruns */
-		encoder_flush(encoder, IgnoreError());
-		unflushed_input = 0;
+		encoder_flush(stream.encoder, IgnoreError());
+		stream.unflushed_input = 0;
 	}
 
-	size_t size = 0;
-	do {
-		size_t nbytes = encoder_read(encoder,
-					     buffer + size,
-					     sizeof(buffer) - size);
-		if (nbytes == 0)
-			break;
-
-		unflushed_input = 0;
-
-		size += nbytes;
-	} while (size < sizeof(buffer));
+	Page *page = spare_page;
+	if (page == nullptr)
+		page = Page::Create(PAGE_SIZE);
 
-	if (size == 0)
+	size_t size = encoder_read_all(stream.encoder,
+				       { page->data, page->size });
+	if (size == 0) {
+		spare_page = page;
 		return nullptr;
+	}
+
+	spare_page = nullptr;
+	stream.unflushed_input = 0;
 
-	return Page::Copy(buffer, size);
+	return Page::Shrink(page, size);
 }
 
 static bool
@@ -292,17 +337,16 @@ httpd_output_disable(AudioOutput *ao)
 }
 
 inline bool
-HttpdOutput::OpenEncoder(AudioFormat &audio_format, Error &error)
-{
-	if (!encoder_open(encoder, audio_format, error))
-		return false;
-
-	/* we have to remember the encoder header, i.e. the first
-	   bytes of encoder output after opening it, because it has to
-	   be sent to every new client */
-	header = ReadPage();
-
-	unflushed_input = 0;
+HttpdOutput::OpenEncoders(AudioFormat &audio_format, Error &error)
+{
+	for (auto i = streams.begin(); i != streams.end(); ++i) {
+		/* the first stream chooses the audio format */
+		if (!i->Open(audio_format, i == streams.begin(), error)) {
+			while (i != streams.begin())
+				(--i)->Close();
+			return false;
+		}
+	}
 
 	return true;
 }
@@ -315,7 +359,7 @@ HttpdOutput::Open(AudioFormat &audio_format, Error &error)
 
 	/* open the encoder */
 
-	if (!OpenEncoder(audio_format, error))
+	if (!OpenEncoders(audio_format, error))
 		return false;
 
 	/* initialize other attributes */
@@ -351,10 +395,8 @@ HttpdOutput::Close()
 			clients.clear();
 		});
 
-	if (header != nullptr)
-		header->Unref();
-
-	encoder_close(encoder);
+	for (auto &stream : streams)
+		stream.Close();
 }
 
 static void
@@ -362,6 +404,8 @@ httpd_output_close(AudioOutput *ao)
 {
 	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
+	httpd->StopEncoders();
+
 	const ScopeLock protect(httpd->mutex);
 	httpd->Close();
 }
@@ -382,13 +426,6 @@ HttpdOutput::RemoveClient(HttpdClient &client)
 	}
 }
 
-void
-HttpdOutput::SendHeader(HttpdClient &client) const
-{
-	if (header != nullptr)
-		client.PushPage(header);
-}
-
 inline unsigned
 HttpdOutput::Delay() const
 {
@@ -419,52 +456,77 @@ httpd_output_delay(AudioOutput *ao)
 }
 
 void
-HttpdOutput::BroadcastPage(Page *page)
+HttpdOutput::BroadcastHeader(HttpdStream &stream, Page &page)
 {
-	assert(page != nullptr);
-
 	mutex.lock();
-	pages.push(page);
-	page->Ref();
+
+	page.Ref();
+	if (stream.header != nullptr)
+		stream.header->Unref();
+	stream.header = &page;
+
+	stream.pages.Push(page, stream.time);
+	stream.first_page = stream.pages.GetHead();
+
 	mutex.unlock();
 
 	DeferredMonitor::Schedule();
 }
 
 void
-HttpdOutput::BroadcastFromEncoder()
+HttpdOutput::BroadcastFromEncoder(HttpdStream &stream)
 {
-	/* synchronize with the IOThread */
 	mutex.lock();
-	while (!pages.empty())
-		cond.wait(mutex);
 
 	Page *page;
-	while ((page = ReadPage()) != nullptr)
-		pages.push(page);
+	while ((page = ReadPage(stream)) != nullptr) {
+		stream.pages.Push(*page, stream.time);
+		page->Unref();
+	}
 
 	mutex.unlock();
 
 	DeferredMonitor::Schedule();
 }
 
-inline bool
-HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
+void
+HttpdOutput::BroadcastHeaderFromEncoder(HttpdStream &stream)
 {
-	if (!encoder_write(encoder, chunk, size, error))
-		return false;
+	mutex.lock();
+	Page *page = ReadPage(stream);
+	mutex.unlock();
 
-	unflushed_input += size;
+	if (page != nullptr) {
+		BroadcastHeader(stream, *page);
+		page->Unref();
+	}
+}
 
-	BroadcastFromEncoder();
-	return true;
+void
+HttpdOutput::StopEncoders()
+{
+	for (auto &stream : streams)
+		stream.StopEncoder();
+}
+
+void
+HttpdOutput::CancelEncoders()
+{
+	for (auto &stream : streams)
+		stream.CancelEncoder();
 }
 
 inline size_t
 HttpdOutput::Play(const void *chunk, size_t size, Error &error)
 {
-	if (LockHasClients()) {
-		if (!EncodeAndPlay(chunk, size, error))
+	for (auto &stream : streams) {
+		mutex.lock();
+		const bool has_clients = stream.n_clients > 0;
+		mutex.unlock();
+
+		/* streams without listeners skip the encoder; the
+		   encoder thread broadcasts the output */
+		if (has_clients && !stream.Write(chunk, size, error))
 			return 0;
 	}
 
@@ -503,31 +565,23 @@ HttpdOutput::SendTag(const Tag *tag)
 {
 	assert(tag != nullptr);
 
-	if (encoder->plugin.tag != nullptr) {
-		/* embed encoder tags */
-
-		/* flush the current stream, and end it */
-
-		encoder_pre_tag(encoder, IgnoreError());
-		BroadcastFromEncoder();
+	bool icy = false;
 
-		/* send the tag to the encoder - which starts a new
-		   stream now */
+	for (auto &stream : streams) {
+		if (stream.IsIcyMetaDataSupported()) {
+			icy = true;
+			continue;
+		}
 
-		encoder_tag(encoder, tag, IgnoreError());
+		/* embed encoder tags: the encoder thread ends the
+		   current stream, and the first page of the new one
+		   becomes the new "header" page, which is sent to all
+		   new clients (see BroadcastHeaderFromEncoder()) */
 
-		/* the first page generated by the encoder will now be
-		   used as the new "header" page, which is sent to all
-		   new clients */
+		stream.SendTag(*tag);
+	}
 
-		Page *page = ReadPage();
-		if (page != nullptr) {
-			if (header != nullptr)
-				header->Unref();
-			header = page;
-			BroadcastPage(page);
-		}
-	} else {
+	if (icy) {
 		/* use Icy-Metadata */
 
 		if (metadata != nullptr)
@@ -560,16 +614,11 @@ HttpdOutput::CancelAllClients()
 {
 	const ScopeLock protect(mutex);
 
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
-		page->Unref();
-	}
+	for (auto &stream : streams)
+		stream.pages.Clear();
 
 	for (auto &client : clients)
 		client.CancelQueue();
-
-	cond.broadcast();
 }
 
 static void
@@ -577,7 +626,9 @@ httpd_output_cancel(AudioOutput *ao)
 {
 	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
-	BlockingCall(io_thread_get(), [httpd](){
+	httpd->CancelEncoders();
+
+	BlockingCall(httpd->GetEventLoop(), [httpd](){
 			httpd->CancelAllClients();
 		});
 }
@@ -592,6 +643,7 @@ const struct AudioOutputPlugin httpd_output_plugin = {
 	httpd_output_open,
 	httpd_output_close,
 	httpd_output_delay,
+	nullptr,
 	httpd_output_tag,
 	httpd_output_play,
 	nullptr,
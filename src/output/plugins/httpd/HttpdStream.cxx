@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "HttpdStream.hxx"
+#include "HttpdInternal.hxx"
+#include "Page.hxx"
+#include "encoder/EncoderPlugin.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+
+HttpdStream::HttpdStream(HttpdOutput &_output,
+			 const char *_path, Encoder *_encoder)
+	:output(_output), path(_path), encoder(_encoder),
+	 unflushed_input(0),
+	 header(nullptr), first_page(0), time(0), n_clients(0),
+	 convert_enabled(false),
+	 thread(*encoder, *this)
+{
+	/* determine content type */
+	content_type = encoder_get_mime_type(encoder);
+	if (content_type == nullptr)
+		content_type = "application/octet-stream";
+}
+
+HttpdStream::~HttpdStream()
+{
+	assert(header == nullptr);
+	assert(!convert_enabled);
+
+	encoder_finish(encoder);
+}
+
+bool
+HttpdStream::IsIcyMetaDataSupported() const
+{
+	return encoder->plugin.tag == nullptr;
+}
+
+bool
+HttpdStream::Open(AudioFormat &audio_format, bool adjust, Error &error)
+{
+	AudioFormat encoder_format = audio_format;
+	if (!encoder_open(encoder, encoder_format, error))
+		return false;
+
+	if (adjust)
+		audio_format = encoder_format;
+	else if (encoder_format != audio_format) {
+		if (!convert.Open(audio_format, encoder_format, error)) {
+			encoder_close(encoder);
+			return false;
+		}
+
+		convert_enabled = true;
+	}
+
+	time_to_size = encoder_format.GetTimeToSize();
+	time = 0;
+	unflushed_input = 0;
+	first_page = pages.GetHead();
+
+	/* we have to remember the encoder header, i.e. the first
+	   bytes of encoder output after opening it, because it has
+	   to be sent to every new client */
+	header = output.ReadPage(*this);
+
+	if (!thread.Start(error)) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void
+HttpdStream::StopEncoder()
+{
+	if (thread.IsRunning()) {
+		thread.Cancel();
+		thread.Stop();
+	}
+}
+
+void
+HttpdStream::Close()
+{
+	/* no data is queued here; the thread does not need the
+	   HttpdOutput::mutex to stop */
+	StopEncoder();
+
+	if (convert_enabled) {
+		convert.Close();
+		convert_enabled = false;
+	}
+
+	encoder_close(encoder);
+
+	pages.Clear();
+
+	if (header != nullptr) {
+		header->Unref();
+		header = nullptr;
+	}
+}
+
+PageRing::Position
+HttpdStream::GetStartPosition(double burst_time) const
+{
+	if (burst_time <= 0 || pages.IsEmpty())
+		return pages.GetHead();
+
+	return pages.FindTime(first_page,
+			      pages.GetNewestTime() - burst_time);
+}
+
+bool
+HttpdStream::Write(const void *data, size_t size, Error &error)
+{
+	if (convert_enabled) {
+		data = convert.Convert(data, size, &size, error);
+		if (data == nullptr)
+			return false;
+	}
+
+	return thread.Write({ data, size }, error);
+}
+
+bool
+HttpdStream::OnEncoderOutput(Encoder &, size_t input_size, Error &)
+{
+	time += input_size / time_to_size;
+	unflushed_input += input_size;
+
+	output.BroadcastFromEncoder(*this);
+	return true;
+}
+
+bool
+HttpdStream::OnEncoderTag(Encoder &, Error &)
+{
+	output.BroadcastHeaderFromEncoder(*this);
+	return true;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_HTTPD_STREAM_HXX
+#define MPD_OUTPUT_HTTPD_STREAM_HXX
+
+#include "PageRing.hxx"
+#include "encoder/EncoderThread.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <string>
+
+#include <stddef.h>
+
+class Error;
+class Page;
+class HttpdOutput;
+struct Encoder;
+struct Tag;
+
+/**
+ * One encoded stream of an httpd output.  All streams of an output
+ * share the audio format, the filter chain and the listener socket;
+ * each one has its own encoder and is served on its own path.
+ *
+ * The encoder runs in its own thread, which broadcasts the encoded
+ * pages.
+ */
+class HttpdStream final : EncoderThread::Handler {
+	HttpdOutput &output;
+
+public:
+	/**
+	 * The path clients request this stream with.  The default
+	 * stream has an empty path; it serves all other paths.
+	 */
+	const std::string path;
+
+	/**
+	 * The configured encoder plugin.
+	 */
+	Encoder *const encoder;
+
+	/**
+	 * The MIME type produced by the #encoder.
+	 */
+	const char *content_type;
+
+	/**
+	 * Number of bytes which were fed into the encoder, without
+	 * ever receiving new output.  This is used to estimate
+	 * whether MPD should manually flush the encoder, to avoid
+	 * buffer underruns in the client.  It is only used by the
+	 * encoder thread (and before it is started).
+	 */
+	size_t unflushed_input;
+
+	/**
+	 * The header page, which is sent to every client on connect.
+	 * It is protected by HttpdOutput::mutex.
+	 */
+	Page *header;
+
+	/**
+	 * The pages from the encoder to be broadcasted to all clients
+	 * of this stream.  It is protected by HttpdOutput::mutex.
+	 */
+	PageRing pages;
+
+	/**
+	 * The position of the first page in #pages which belongs to
+	 * the current #header.  Pages before it were produced before
+	 * the encoder started a new stream, and are not sent to new
+	 * clients.  It is protected by HttpdOutput::mutex.
+	 */
+	PageRing::Position first_page;
+
+	/**
+	 * The stream position in seconds, i.e. the duration of all
+	 * data passed to the encoder since it was opened.  This is
+	 * the time stamp of new pages.  It is only used by the
+	 * encoder thread.
+	 */
+	double time;
+
+	/**
+	 * The number of clients which listen to this stream.  It is
+	 * protected by HttpdOutput::mutex.
+	 */
+	unsigned n_clients;
+
+private:
+	/**
+	 * Converts the output's audio format to the one chosen by the
+	 * #encoder, if they differ.
+	 */
+	PcmConvert convert;
+
+	bool convert_enabled;
+
+	/**
+	 * The number of bytes per second in the encoder's audio
+	 * format.
+	 */
+	double time_to_size;
+
+	EncoderThread thread;
+
+public:
+	HttpdStream(HttpdOutput &_output,
+		    const char *_path, Encoder *_encoder);
+	~HttpdStream();
+
+	HttpdStream(const HttpdStream &) = delete;
+	HttpdStream &operator=(const HttpdStream &) = delete;
+
+	/**
+	 * Does this stream send Icy-MetaData (instead of embedding
+	 * tags with the encoder)?
+	 */
+	gcc_pure
+	bool IsIcyMetaDataSupported() const;
+
+	/**
+	 * Open the encoder, read the #header and start the encoder
+	 * thread.
+	 *
+	 * Caller must lock HttpdOutput::mutex.
+	 *
+	 * @param audio_format the audio format of the output; if
+	 * #adjust is true, the encoder may modify it, otherwise the
+	 * data is converted to the encoder's choice
+	 */
+	bool Open(AudioFormat &audio_format, bool adjust, Error &error);
+
+	/**
+	 * Stop the encoder thread (if not already done with
+	 * StopEncoder()) and close the encoder.
+	 */
+	void Close();
+
+	/**
+	 * Stop the encoder thread, discarding queued data.
+	 *
+	 * HttpdOutput::mutex must not be locked.
+	 */
+	void StopEncoder();
+
+	/**
+	 * Discard data queued for the encoder.
+	 *
+	 * HttpdOutput::mutex must not be locked.
+	 */
+	void CancelEncoder() {
+		thread.Cancel();
+	}
+
+	/**
+	 * Returns the position of the first page a new client gets
+	 * after the #header.
+	 *
+	 * Caller must lock HttpdOutput::mutex.
+	 *
+	 * @param burst_time send this many seconds of the most recent
+	 * pages right away
+	 */
+	gcc_pure
+	PageRing::Position GetStartPosition(double burst_time) const;
+
+	/**
+	 * Pass data in the output's audio format to the encoder
+	 * thread.
+	 */
+	bool Write(const void *data, size_t size, Error &error);
+
+	/**
+	 * Pass a tag to the encoder thread.
+	 */
+	void SendTag(const Tag &tag) {
+		thread.SendTag(tag);
+	}
+
+private:
+	/* virtual methods from class EncoderThread::Handler */
+	bool OnEncoderOutput(Encoder &encoder, size_t input_size,
+			     Error &error) override;
+	bool OnEncoderTag(Encoder &encoder, Error &error) override;
+};
+
+#endif
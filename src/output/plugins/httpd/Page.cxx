@@ -27,11 +27,13 @@
 #include <string.h>
 #include <stdlib.h>
 
+MemoryAccount memory_httpd;
+
 Page *
 Page::Create(size_t size)
 {
-	void *p = xalloc(sizeof(Page) + size -
-			 sizeof(Page::data));
+	void *p = xalloc(GetAllocationSize(size));
+	memory_httpd.Add(GetAllocationSize(size));
 	return ::new(p) Page(size);
 }
 
@@ -45,6 +47,26 @@ Page::Copy(const void *data, size_t size)
 	return page;
 }
 
+Page *
+Page::Shrink(Page *page, size_t new_size)
+{
+	assert(new_size > 0);
+	assert(new_size <= page->size);
+
+	if (new_size == page->size)
+		return page;
+
+	memory_httpd.Sub(page->size - new_size);
+	page->size = new_size;
+
+	/* shrinking usually happens in place; the reference counter
+	   has no other owner yet, so moving the object is safe */
+	void *p = realloc(page, GetAllocationSize(new_size));
+	return p != nullptr
+		? (Page *)p
+		: page;
+}
+
 Page *
 Page::Concat(const Page &a, const Page &b)
 {
@@ -62,6 +84,7 @@ Page::Unref()
 	bool unused = ref.Decrement();
 
 	if (unused) {
+		memory_httpd.Sub(GetAllocationSize(size));
 		this->Page::~Page();
 		free(this);
 	}
@@ -26,9 +26,15 @@
 #define MPD_PAGE_HXX
 
 #include "util/RefCount.hxx"
+#include "util/MemoryAccount.hxx"
 
 #include <stddef.h>
 
+/**
+ * The memory occupied by all #Page objects.
+ */
+extern MemoryAccount memory_httpd;
+
 /**
  * A dynamically allocated buffer which keeps track of its reference
  * count.  This is useful for passing buffers around, when several
@@ -45,9 +51,10 @@ class Page {
 
 public:
 	/**
-	 * The size of this buffer in bytes.
+	 * The size of this buffer in bytes.  It is only modified by
+	 * Shrink(), before the page is shared.
 	 */
-	const size_t size;
+	size_t size;
 
 	/**
 	 * Dynamic array containing the buffer data.
@@ -58,13 +65,26 @@ protected:
 	Page(size_t _size):size(_size) {}
 	~Page() = default;
 
+	static constexpr size_t GetAllocationSize(size_t size) {
+		return sizeof(Page) + size - sizeof(Page::data);
+	}
+
+public:
 	/**
 	 * Allocates a new #Page object, without filling the data
-	 * element.
+	 * element.  The caller may fill it directly (e.g. with
+	 * encoder_read()) and then trim it with Shrink().
 	 */
 	static Page *Create(size_t size);
 
-public:
+	/**
+	 * Reduces the size of a page which has not been shared yet,
+	 * and releases the unused memory.
+	 *
+	 * @return the page, which may have been moved
+	 */
+	static Page *Shrink(Page *page, size_t new_size);
+
 	/**
 	 * Creates a new #page object, and copies data from the
 	 * specified buffer.  It is initialized with a reference count
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PageRing.hxx"
+#include "Page.hxx"
+
+#include <assert.h>
+
+PageRing::~PageRing()
+{
+	Clear();
+}
+
+void
+PageRing::PopOldest()
+{
+	assert(!IsEmpty());
+
+	Page &page = Get(tail++);
+	assert(size >= page.size);
+	size -= page.size;
+	page.Unref();
+}
+
+PageRing::Position
+PageRing::FindTime(Position start, double time) const
+{
+	if (start < tail)
+		start = tail;
+
+	Position i = head;
+	while (i > start && times[(i - 1) % CAPACITY] >= time)
+		--i;
+
+	return i;
+}
+
+void
+PageRing::Push(Page &page, double time)
+{
+	/* when the "httpd" memory budget is exceeded, #keep_time
+	   is ignored */
+	const bool shed = memory_httpd.IsExceeded();
+
+	while (!IsEmpty() &&
+	       (head - tail >= CAPACITY ||
+		(size + page.size > MAX_SIZE &&
+		 (shed || times[tail % CAPACITY] <= time - keep_time))))
+		PopOldest();
+
+	page.Ref();
+	times[head % CAPACITY] = time;
+	pages[head++ % CAPACITY] = &page;
+	size += page.size;
+}
+
+void
+PageRing::Clear()
+{
+	while (!IsEmpty())
+		PopOldest();
+
+	assert(size == 0);
+}
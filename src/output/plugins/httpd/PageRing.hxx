@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PAGE_RING_HXX
+#define MPD_PAGE_RING_HXX
+
+#include "Compiler.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Page;
+
+/**
+ * The most recent #Page objects produced by the encoder, shared by
+ * all clients of one httpd output.  Each page gets a sequence
+ * number; a client only remembers the number of the next page it
+ * will send.  The oldest pages are dropped when the ring is full;
+ * a client which has not sent them yet is too slow.
+ *
+ * Each page also has a time stamp, the stream position (in seconds)
+ * after the encoder had produced it.  This allows sending the most
+ * recent seconds to a new client right away.
+ *
+ * This class is not thread-safe.
+ */
+class PageRing {
+public:
+	typedef uint64_t Position;
+
+private:
+	/**
+	 * The maximum number of pages.
+	 */
+	static constexpr size_t CAPACITY = 1024;
+
+	/**
+	 * The maximum sum of all page sizes.  More pages are kept if
+	 * they are within #keep_time.
+	 */
+	static constexpr size_t MAX_SIZE = 256 * 1024;
+
+	Page *pages[CAPACITY];
+	double times[CAPACITY];
+
+	/**
+	 * The position of the oldest page and of the next page which
+	 * will be pushed.
+	 */
+	Position tail, head;
+
+	/**
+	 * The sum of all page sizes.
+	 */
+	size_t size;
+
+	/**
+	 * Pages which are at most this many seconds older than the
+	 * newest one are not dropped because of #MAX_SIZE.
+	 */
+	double keep_time;
+
+public:
+	PageRing():tail(0), head(0), size(0), keep_time(0) {}
+	~PageRing();
+
+	PageRing(const PageRing &) = delete;
+	PageRing &operator=(const PageRing &) = delete;
+
+	bool IsEmpty() const {
+		return tail == head;
+	}
+
+	/**
+	 * Returns the position of the oldest page which is still
+	 * available.
+	 */
+	Position GetTail() const {
+		return tail;
+	}
+
+	/**
+	 * Returns the position which will be assigned to the next
+	 * page.
+	 */
+	Position GetHead() const {
+		return head;
+	}
+
+	/**
+	 * Returns the page at the specified position, which must be
+	 * between GetTail() (inclusive) and GetHead() (exclusive).
+	 * The ring keeps its reference.
+	 */
+	gcc_pure
+	Page &Get(Position position) const {
+		return *pages[position % CAPACITY];
+	}
+
+	/**
+	 * Returns the time stamp of the newest page.  The ring must
+	 * not be empty.
+	 */
+	gcc_pure
+	double GetNewestTime() const {
+		return times[(head - 1) % CAPACITY];
+	}
+
+	/**
+	 * Returns the position of the oldest page at or after #start
+	 * whose time stamp is not older than the specified one, or
+	 * GetHead() if there is none.
+	 */
+	gcc_pure
+	Position FindTime(Position start, double time) const;
+
+	void SetKeepTime(double _keep_time) {
+		keep_time = _keep_time;
+	}
+
+	/**
+	 * Appends a page, and adds a reference to it.  Old pages are
+	 * dropped to make room.
+	 *
+	 * @param time the time stamp of the page in seconds
+	 */
+	void Push(Page &page, double time);
+
+	/**
+	 * Drops all pages.  The positions are not reset, and the
+	 * next page will get the current GetHead() value.
+	 */
+	void Clear();
+
+private:
+	void PopOldest();
+};
+
+#endif
@@ -531,6 +531,7 @@ const struct AudioOutputPlugin sles_output_plugin = {
 	sles_output_close,
 	sles_output_delay,
 	nullptr,
+	nullptr,
 	sles_output_play,
 	sles_output_drain,
 	sles_output_cancel,
@@ -20,10 +20,13 @@
 #include "config.h"
 #include "ConfiguredResampler.hxx"
 #include "FallbackResampler.hxx"
+#include "PolyphaseResampler.hxx"
 #include "config/ConfigGlobal.hxx"
+#include "config/ConfigData.hxx"
 #include "config/ConfigOption.hxx"
 #include "config/ConfigError.hxx"
 #include "util/Error.hxx"
+#include "Compiler.h"
 
 #ifdef HAVE_LIBSAMPLERATE
 #include "LibsamplerateResampler.hxx"
@@ -33,11 +36,14 @@
 #include "SoxrResampler.hxx"
 #endif
 
+#include <assert.h>
 #include <string.h>
 
 enum class SelectedResampler {
 	FALLBACK,
 
+	POLYPHASE,
+
 #ifdef HAVE_LIBSAMPLERATE
 	LIBSAMPLERATE,
 #endif
@@ -58,6 +64,11 @@ pcm_resampler_global_init(Error &error)
 	if (strcmp(converter, "internal") == 0)
 		return true;
 
+	if (strncmp(converter, "polyphase", 9) == 0) {
+		selected_resampler = SelectedResampler::POLYPHASE;
+		return pcm_resample_polyphase_global_init(converter, error);
+	}
+
 #ifdef HAVE_SOXR
 	if (memcmp(converter, "soxr", 4) == 0) {
 		selected_resampler = SelectedResampler::SOXR;
@@ -70,8 +81,12 @@ pcm_resampler_global_init(Error &error)
 	return pcm_resample_lsr_global_init(converter, error);
 #endif
 
-	if (*converter == 0)
-		return true;
+	if (*converter == 0) {
+		/* no external library available: use the built-in
+		   polyphase resampler by default */
+		selected_resampler = SelectedResampler::POLYPHASE;
+		return pcm_resample_polyphase_global_init(converter, error);
+	}
 
 	error.Format(config_domain,
 		     "The samplerate_converter '%s' is not available",
@@ -79,13 +94,39 @@ pcm_resampler_global_init(Error &error)
 	return false;
 }
 
+bool
+pcm_resampler_check_profile(const char *name, Error &error)
+{
+	assert(name != nullptr);
+
+#ifdef HAVE_SOXR
+	if (selected_resampler == SelectedResampler::SOXR)
+		return pcm_resample_soxr_check_profile(name, error);
+#endif
+
+	/* the other resamplers have no profiles; the setting is
+	   ignored, but typos are still reported */
+	for (const config_param *param = config_get_param(CONF_RESAMPLER);
+	     param != nullptr; param = param->next) {
+		const char *value = param->GetBlockValue("name");
+		if (value != nullptr && strcmp(value, name) == 0)
+			return true;
+	}
+
+	error.Format(config_domain, "No such resampler: \"%s\"", name);
+	return false;
+}
+
 PcmResampler *
-pcm_resampler_create()
+pcm_resampler_create(gcc_unused const char *profile)
 {
 	switch (selected_resampler) {
 	case SelectedResampler::FALLBACK:
 		return new FallbackPcmResampler();
 
+	case SelectedResampler::POLYPHASE:
+		return new PolyphasePcmResampler();
+
 #ifdef HAVE_LIBSAMPLERATE
 	case SelectedResampler::LIBSAMPLERATE:
 		return new LibsampleratePcmResampler();
@@ -93,7 +134,7 @@ pcm_resampler_create()
 
 #ifdef HAVE_SOXR
 	case SelectedResampler::SOXR:
-		return new SoxrPcmResampler();
+		return new SoxrPcmResampler(profile);
 #endif
 	}
 
@@ -28,11 +28,22 @@ class PcmResampler;
 bool
 pcm_resampler_global_init(Error &error);
 
+/**
+ * Check whether the specified resampler profile (a "resampler" block
+ * with this name) exists.
+ */
+bool
+pcm_resampler_check_profile(const char *name, Error &error);
+
 /**
  * Create a #PcmResampler instance from the implementation class
  * configured in mpd.conf.
+ *
+ * @param profile the name of a resampler profile which was
+ * verified with pcm_resampler_check_profile(), or nullptr for the
+ * default settings
  */
 PcmResampler *
-pcm_resampler_create();
+pcm_resampler_create(const char *profile=nullptr);
 
 #endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Convolver.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+PcmConvolver::PcmConvolver(const PcmFft &_fft,
+			   const float *impulse, size_t length,
+			   size_t stride)
+	:fft(_fft), block(_fft.GetSize() / 2), bins(block + 1),
+	 n_partitions(std::max<size_t>((length + block - 1) / block, 1)),
+	 filter(n_partitions * bins),
+	 delay_line(n_partitions * bins), delay_position(0),
+	 input(2 * block), work(2 * block), sum(bins)
+{
+	const float scale = 1.f / fft.GetSize();
+
+	for (size_t p = 0; p < n_partitions; ++p) {
+		std::fill(work.begin(), work.end(), Complex());
+
+		for (size_t i = 0; i < block && p * block + i < length; ++i)
+			work[i] = impulse[(p * block + i) * stride] * scale;
+
+		fft.Forward(&work.front());
+		std::copy_n(work.begin(), bins, filter.begin() + p * bins);
+	}
+}
+
+void
+PcmConvolver::Process(float *dest, const float *src, size_t stride)
+{
+	/* slide the input window by one block */
+
+	std::copy(input.begin() + block, input.end(), input.begin());
+	for (size_t i = 0; i < block; ++i)
+		input[block + i] = src[i * stride];
+
+	/* transform it into the delay line */
+
+	std::copy(input.begin(), input.end(), work.begin());
+	fft.Forward(&work.front());
+
+	Complex *const current = &delay_line[delay_position * bins];
+	std::copy_n(work.begin(), bins, current);
+
+	/* multiply and accumulate all partitions; partition p is
+	   paired with the input spectrum from p blocks ago */
+
+	std::fill(sum.begin(), sum.end(), Complex());
+
+	size_t d = delay_position;
+	for (size_t p = 0; p < n_partitions; ++p) {
+		const Complex *h = &filter[p * bins];
+		const Complex *x = &delay_line[d * bins];
+
+		for (size_t k = 0; k < bins; ++k)
+			sum[k] += pcm_complex_mul(h[k], x[k]);
+
+		d = d > 0 ? d - 1 : n_partitions - 1;
+	}
+
+	delay_position = (delay_position + 1) % n_partitions;
+
+	/* restore the redundant half of the spectrum and transform
+	   back; with overlap-save, the second half of the result is
+	   the valid output */
+
+	std::copy(sum.begin(), sum.end(), work.begin());
+	for (size_t k = 1; k < block; ++k)
+		work[2 * block - k] = std::conj(sum[k]);
+
+	fft.Inverse(&work.front());
+
+	for (size_t i = 0; i < block; ++i)
+		dest[i * stride] = work[block + i].real();
+}
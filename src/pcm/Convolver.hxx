@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_CONVOLVER_HXX
+#define MPD_PCM_CONVOLVER_HXX
+
+#include "Fft.hxx"
+
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * Convolves one channel with a (long) FIR filter, using a uniformly
+ * partitioned overlap-save algorithm: the impulse response is split
+ * into partitions of #block samples, whose spectra are multiplied
+ * with a delay line of input spectra.  The cost per sample grows
+ * only linearly with the number of partitions, and the latency is
+ * one block.
+ */
+class PcmConvolver {
+	typedef PcmFft::Complex Complex;
+
+	/**
+	 * The transform of size 2 * #block, which may be shared with
+	 * other instances.
+	 */
+	const PcmFft &fft;
+
+	const size_t block;
+
+	/**
+	 * The number of bins which are stored; the other half of the
+	 * spectrum of a real signal is redundant.
+	 */
+	const size_t bins;
+
+	const size_t n_partitions;
+
+	/**
+	 * The spectra of all impulse response partitions, scaled by
+	 * 1/(2*#block) to compensate for the unscaled inverse FFT.
+	 */
+	std::vector<Complex> filter;
+
+	/**
+	 * The frequency domain delay line: the spectra of the last
+	 * #n_partitions input blocks.
+	 */
+	std::vector<Complex> delay_line;
+	size_t delay_position;
+
+	/**
+	 * The previous and the current input block.
+	 */
+	std::vector<float> input;
+
+	std::vector<Complex> work, sum;
+
+public:
+	/**
+	 * @param _fft a transform of twice the block size
+	 * @param impulse the impulse response
+	 * @param length the number of samples in the impulse response
+	 * @param stride the distance between two samples of
+	 * #impulse (for interleaved multi-channel impulse responses)
+	 */
+	PcmConvolver(const PcmFft &_fft, const float *impulse, size_t length,
+		     size_t stride);
+
+	PcmConvolver(const PcmConvolver &) = delete;
+	PcmConvolver &operator=(const PcmConvolver &) = delete;
+
+	/**
+	 * Convolve one block.
+	 *
+	 * @param dest the destination for one block of samples
+	 * @param src one block of input samples
+	 * @param stride the distance between two samples of #dest
+	 * and #src (i.e. the number of interleaved channels)
+	 */
+	void Process(float *dest, const float *src, size_t stride);
+};
+
+#endif
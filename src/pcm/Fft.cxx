@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Fft.hxx"
+
+#include <utility>
+
+#include <assert.h>
+#include <math.h>
+
+PcmFft::PcmFft(size_t _size)
+	:size(_size), twiddle(_size / 2), reverse(_size)
+{
+	assert(size >= 2);
+	assert((size & (size - 1)) == 0);
+
+	for (size_t k = 0; k < size / 2; ++k) {
+		const double phi = -2 * M_PI * k / size;
+		twiddle[k] = Complex(cos(phi), sin(phi));
+	}
+
+	unsigned bits = 0;
+	while ((size_t(1) << bits) < size)
+		++bits;
+
+	for (size_t i = 0; i < size; ++i) {
+		size_t r = 0;
+		for (unsigned b = 0; b < bits; ++b)
+			if (i & (size_t(1) << b))
+				r |= size_t(1) << (bits - 1 - b);
+
+		reverse[i] = r;
+	}
+}
+
+void
+PcmFft::Transform(Complex *data, bool inverse) const
+{
+	for (size_t i = 0; i < size; ++i)
+		if (i < reverse[i])
+			std::swap(data[i], data[reverse[i]]);
+
+	for (size_t length = 2; length <= size; length *= 2) {
+		const size_t half = length / 2;
+		const size_t step = size / length;
+
+		for (size_t i = 0; i < size; i += length) {
+			for (size_t j = 0; j < half; ++j) {
+				Complex w = twiddle[j * step];
+				if (inverse)
+					w = std::conj(w);
+
+				const Complex u = data[i + j];
+				const Complex v =
+					pcm_complex_mul(data[i + j + half], w);
+				data[i + j] = u + v;
+				data[i + j + half] = u - v;
+			}
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_FFT_HXX
+#define MPD_PCM_FFT_HXX
+
+#include <complex>
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * An in-place radix-2 complex FFT of a fixed size, with precomputed
+ * twiddle factors and bit reversal table.  The object is not
+ * modified by the transforms, so one instance may be shared by
+ * several threads.
+ */
+class PcmFft {
+public:
+	typedef std::complex<float> Complex;
+
+private:
+	size_t size;
+
+	/**
+	 * exp(-2 pi i k / size) for k < size / 2.
+	 */
+	std::vector<Complex> twiddle;
+
+	std::vector<size_t> reverse;
+
+public:
+	/**
+	 * @param _size the transform size; must be a power of two
+	 */
+	explicit PcmFft(size_t _size);
+
+	size_t GetSize() const {
+		return size;
+	}
+
+	void Forward(Complex *data) const {
+		Transform(data, false);
+	}
+
+	/**
+	 * The inverse transform.  The result is not scaled; it is
+	 * #size times the input of Forward().
+	 */
+	void Inverse(Complex *data) const {
+		Transform(data, true);
+	}
+
+private:
+	void Transform(Complex *data, bool inverse) const;
+};
+
+/**
+ * Multiply two complex numbers.  Unlike operator*, this does not
+ * check for infinities and NaNs, which allows the compiler to inline
+ * and vectorise it.
+ */
+static inline PcmFft::Complex
+pcm_complex_mul(PcmFft::Complex a, PcmFft::Complex b)
+{
+	return PcmFft::Complex(a.real() * b.real() - a.imag() * b.imag(),
+			       a.real() * b.imag() + a.imag() * b.real());
+}
+
+#endif
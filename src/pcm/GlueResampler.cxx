@@ -24,8 +24,8 @@
 
 #include <assert.h>
 
-GluePcmResampler::GluePcmResampler()
-	:resampler(pcm_resampler_create()) {}
+GluePcmResampler::GluePcmResampler(const char *profile)
+	:resampler(pcm_resampler_create(profile)) {}
 
 GluePcmResampler::~GluePcmResampler()
 {
@@ -70,6 +70,12 @@ GluePcmResampler::Close()
 	resampler->Close();
 }
 
+void
+GluePcmResampler::Reset()
+{
+	resampler->Reset();
+}
+
 ConstBuffer<void>
 GluePcmResampler::Resample(ConstBuffer<void> src, Error &error)
 {
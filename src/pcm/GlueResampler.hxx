@@ -46,13 +46,22 @@ class GluePcmResampler {
 	PcmFormatConverter format_converter;
 
 public:
-	GluePcmResampler();
+	/**
+	 * @param profile the name of a resampler profile, see
+	 * pcm_resampler_create()
+	 */
+	explicit GluePcmResampler(const char *profile=nullptr);
 	~GluePcmResampler();
 
 	bool Open(AudioFormat src_format, unsigned new_sample_rate,
 		  Error &error);
 	void Close();
 
+	/**
+	 * Discard the resampler's state; see PcmResampler::Reset().
+	 */
+	void Reset();
+
 	SampleFormat GetOutputSampleFormat() const {
 		return output_sample_format;
 	}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Interleave.hxx"
+#include "InterleaveSimd.hxx"
+
+#include <string.h>
+
+template<typename D, typename S>
+static void
+GenericPcmInterleave(D *gcc_restrict dest, ConstBuffer<const S *> src,
+		     size_t start, size_t n_frames)
+{
+	dest += start * src.size;
+	for (size_t frame = start; frame < n_frames; ++frame)
+		for (size_t c = 0; c < src.size; ++c)
+			*dest++ = D(src[c][frame]);
+}
+
+/**
+ * With a channel count known at compile time, the compiler can unroll
+ * the inner loop and keep all source pointers in registers.
+ */
+template<unsigned channels, typename D, typename S>
+static void
+FixedPcmInterleave(D *gcc_restrict dest, const S *const*src,
+		   size_t start, size_t n_frames)
+{
+	dest += start * channels;
+	for (size_t frame = start; frame < n_frames; ++frame)
+		for (unsigned c = 0; c < channels; ++c)
+			*dest++ = D(src[c][frame]);
+}
+
+/**
+ * Interleave the frames from #start to #n_frames without SIMD.  This
+ * handles the remainder after a vectorised kernel.
+ */
+template<typename D, typename S>
+static void
+ScalarPcmInterleave(D *gcc_restrict dest, ConstBuffer<const S *> src,
+		    size_t start, size_t n_frames)
+{
+	switch (src.size) {
+	case 1:
+		FixedPcmInterleave<1>(dest, src.data, start, n_frames);
+		break;
+
+	case 2:
+		FixedPcmInterleave<2>(dest, src.data, start, n_frames);
+		break;
+
+	case 6:
+		FixedPcmInterleave<6>(dest, src.data, start, n_frames);
+		break;
+
+	case 8:
+		FixedPcmInterleave<8>(dest, src.data, start, n_frames);
+		break;
+
+	default:
+		GenericPcmInterleave(dest, src, start, n_frames);
+	}
+}
+
+void
+PcmInterleave32(uint32_t *gcc_restrict dest,
+		ConstBuffer<const uint32_t *> src,
+		size_t n_frames)
+{
+	const size_t done = src.size == 2
+		? pcm_interleave_simd_32x2(dest, src[0], src[1], n_frames)
+		: pcm_interleave_simd_32xn(dest, src.data, src.size,
+					   n_frames);
+
+	ScalarPcmInterleave(dest, src, done, n_frames);
+}
+
+void
+PcmInterleave16(uint16_t *gcc_restrict dest,
+		ConstBuffer<const uint16_t *> src,
+		size_t n_frames)
+{
+	const size_t done = src.size == 2
+		? pcm_interleave_simd_16x2(dest, src[0], src[1], n_frames)
+		: 0;
+
+	ScalarPcmInterleave(dest, src, done, n_frames);
+}
+
+void
+PcmInterleaveNarrow16(int16_t *gcc_restrict dest,
+		      ConstBuffer<const int32_t *> src,
+		      size_t n_frames)
+{
+	const size_t done = src.size == 2
+		? pcm_interleave_simd_narrow16x2(dest, src[0], src[1],
+						 n_frames)
+		: pcm_interleave_simd_narrow16xn(dest, src.data, src.size,
+						 n_frames);
+
+	ScalarPcmInterleave(dest, src, done, n_frames);
+}
+
+void
+PcmInterleave(void *gcc_restrict dest, ConstBuffer<const void *> src,
+	      size_t n_frames, size_t sample_size)
+{
+	switch (sample_size) {
+	case 2:
+		PcmInterleave16((uint16_t *)dest,
+				ConstBuffer<const uint16_t *>((const uint16_t *const*)src.data,
+							      src.size),
+				n_frames);
+		break;
+
+	case 4:
+		PcmInterleave32((uint32_t *)dest,
+				ConstBuffer<const uint32_t *>((const uint32_t *const*)src.data,
+							      src.size),
+				n_frames);
+		break;
+
+	default: {
+		uint8_t *d = (uint8_t *)dest;
+		for (size_t frame = 0; frame < n_frames; ++frame) {
+			for (size_t c = 0; c < src.size; ++c) {
+				memcpy(d, (const uint8_t *)src[c] +
+				       frame * sample_size, sample_size);
+				d += sample_size;
+			}
+		}
+	}
+	}
+}
+
+void
+PcmDeinterleave32(ConstBuffer<uint32_t *> dest,
+		  const uint32_t *gcc_restrict src,
+		  size_t n_frames)
+{
+	const size_t done = dest.size == 2
+		? pcm_deinterleave_simd_32x2(dest[0], dest[1], src, n_frames)
+		: 0;
+
+	src += done * dest.size;
+	for (size_t frame = done; frame < n_frames; ++frame)
+		for (size_t c = 0; c < dest.size; ++c)
+			dest[c][frame] = *src++;
+}
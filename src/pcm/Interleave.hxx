@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_INTERLEAVE_HXX
+#define MPD_PCM_INTERLEAVE_HXX
+
+#include "check.h"
+#include "Compiler.h"
+#include "util/ConstBuffer.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Interleave planar PCM samples from #src to #dest.
+ *
+ * @param src one pointer per channel
+ * @param n_frames the number of samples per channel
+ * @param sample_size the size of one sample in bytes
+ */
+void
+PcmInterleave(void *gcc_restrict dest, ConstBuffer<const void *> src,
+	      size_t n_frames, size_t sample_size);
+
+/**
+ * Interleave planar 32 bit samples (which may be float) from #src to
+ * #dest.
+ */
+void
+PcmInterleave32(uint32_t *gcc_restrict dest,
+		ConstBuffer<const uint32_t *> src,
+		size_t n_frames);
+
+/**
+ * Interleave planar 16 bit samples from #src to #dest.
+ */
+void
+PcmInterleave16(uint16_t *gcc_restrict dest,
+		ConstBuffer<const uint16_t *> src,
+		size_t n_frames);
+
+/**
+ * Interleave planar 32 bit samples which are known to fit into 16
+ * bit (e.g. from a decoder library which always returns 32 bit
+ * integers), and store them as 16 bit.
+ */
+void
+PcmInterleaveNarrow16(int16_t *gcc_restrict dest,
+		      ConstBuffer<const int32_t *> src,
+		      size_t n_frames);
+
+/**
+ * Split interleaved 32 bit samples (which may be float) from #src
+ * into one buffer per channel.
+ *
+ * @param dest one pointer per channel
+ * @param n_frames the number of frames in #src
+ */
+void
+PcmDeinterleave32(ConstBuffer<uint32_t *> dest,
+		  const uint32_t *gcc_restrict src,
+		  size_t n_frames);
+
+#endif
@@ -0,0 +1,540 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "InterleaveSimd.hxx"
+#include "SimdLevel.hxx"
+
+#include <string.h>
+
+#if defined(PCM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef PCM_SIMD_X86
+
+__attribute__((target("sse2")))
+static size_t
+pcm_interleave_sse2_32x2(uint32_t *dest, const uint32_t *a,
+			 const uint32_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(dest + i * 2),
+				 _mm_unpacklo_epi32(x, y));
+		_mm_storeu_si128((__m128i *)(dest + i * 2 + 4),
+				 _mm_unpackhi_epi32(x, y));
+	}
+
+	return i;
+}
+
+/**
+ * The unpack instructions operate within each 128 bit lane, so the
+ * two halves need to be swapped back with vperm2i128.
+ */
+__attribute__((target("avx2")))
+static size_t
+pcm_interleave_avx2_32x2(uint32_t *dest, const uint32_t *a,
+			 const uint32_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x =
+			_mm256_loadu_si256((const __m256i *)(a + i));
+		const __m256i y =
+			_mm256_loadu_si256((const __m256i *)(b + i));
+		const __m256i lo = _mm256_unpacklo_epi32(x, y);
+		const __m256i hi = _mm256_unpackhi_epi32(x, y);
+		_mm256_storeu_si256((__m256i *)(dest + i * 2),
+				    _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(dest + i * 2 + 8),
+				    _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_interleave_sse2_16x2(uint16_t *dest, const uint16_t *a,
+			 const uint16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128((__m128i *)(dest + i * 2),
+				 _mm_unpacklo_epi16(x, y));
+		_mm_storeu_si128((__m128i *)(dest + i * 2 + 8),
+				 _mm_unpackhi_epi16(x, y));
+	}
+
+	return i;
+}
+
+/**
+ * Transpose four vectors of four 32 bit samples: on entry, each
+ * vector contains four frames of one channel; on return, each
+ * contains four channels of one frame.
+ */
+__attribute__((target("sse2")))
+static inline void
+pcm_transpose_sse2_4x4(__m128i &a, __m128i &b, __m128i &c, __m128i &d)
+{
+	const __m128i t0 = _mm_unpacklo_epi32(a, b);
+	const __m128i t1 = _mm_unpacklo_epi32(c, d);
+	const __m128i t2 = _mm_unpackhi_epi32(a, b);
+	const __m128i t3 = _mm_unpackhi_epi32(c, d);
+	a = _mm_unpacklo_epi64(t0, t1);
+	b = _mm_unpackhi_epi64(t0, t1);
+	c = _mm_unpacklo_epi64(t2, t3);
+	d = _mm_unpackhi_epi64(t2, t3);
+}
+
+/**
+ * Multi-channel interleaving: blocks of four channels are transposed
+ * in 4x4 steps, and a remaining channel pair is unpacked.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_interleave_sse2_32xn(uint32_t *dest, const uint32_t *const*src,
+			 unsigned channels, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		uint32_t *d = dest + i * channels;
+
+		unsigned c = 0;
+		for (; c + 4 <= channels; c += 4) {
+			__m128i v0 = _mm_loadu_si128((const __m128i *)(src[c] + i));
+			__m128i v1 = _mm_loadu_si128((const __m128i *)(src[c + 1] + i));
+			__m128i v2 = _mm_loadu_si128((const __m128i *)(src[c + 2] + i));
+			__m128i v3 = _mm_loadu_si128((const __m128i *)(src[c + 3] + i));
+			pcm_transpose_sse2_4x4(v0, v1, v2, v3);
+			_mm_storeu_si128((__m128i *)(d + c), v0);
+			_mm_storeu_si128((__m128i *)(d + channels + c), v1);
+			_mm_storeu_si128((__m128i *)(d + 2 * channels + c), v2);
+			_mm_storeu_si128((__m128i *)(d + 3 * channels + c), v3);
+		}
+
+		if (c < channels) {
+			const __m128i x = _mm_loadu_si128((const __m128i *)(src[c] + i));
+			const __m128i y = _mm_loadu_si128((const __m128i *)(src[c + 1] + i));
+			const __m128i lo = _mm_unpacklo_epi32(x, y);
+			const __m128i hi = _mm_unpackhi_epi32(x, y);
+			_mm_storel_epi64((__m128i *)(d + c), lo);
+			_mm_storel_epi64((__m128i *)(d + channels + c),
+					 _mm_srli_si128(lo, 8));
+			_mm_storel_epi64((__m128i *)(d + 2 * channels + c), hi);
+			_mm_storel_epi64((__m128i *)(d + 3 * channels + c),
+					 _mm_srli_si128(hi, 8));
+		}
+	}
+
+	return i;
+}
+
+/**
+ * The input is known to fit into 16 bit, so the saturation done by
+ * packssdw never kicks in, and the result equals truncation.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_interleave_sse2_narrow16x2(int16_t *dest, const int32_t *a,
+			       const int32_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x =
+			_mm_packs_epi32(_mm_loadu_si128((const __m128i *)(a + i)),
+					_mm_loadu_si128((const __m128i *)(a + i + 4)));
+		const __m128i y =
+			_mm_packs_epi32(_mm_loadu_si128((const __m128i *)(b + i)),
+					_mm_loadu_si128((const __m128i *)(b + i + 4)));
+		_mm_storeu_si128((__m128i *)(dest + i * 2),
+				 _mm_unpacklo_epi16(x, y));
+		_mm_storeu_si128((__m128i *)(dest + i * 2 + 8),
+				 _mm_unpackhi_epi16(x, y));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_interleave_sse2_narrow16xn(int16_t *dest, const int32_t *const*src,
+			       unsigned channels, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		int16_t *d = dest + i * channels;
+
+		unsigned c = 0;
+		for (; c + 4 <= channels; c += 4) {
+			__m128i v0 = _mm_loadu_si128((const __m128i *)(src[c] + i));
+			__m128i v1 = _mm_loadu_si128((const __m128i *)(src[c + 1] + i));
+			__m128i v2 = _mm_loadu_si128((const __m128i *)(src[c + 2] + i));
+			__m128i v3 = _mm_loadu_si128((const __m128i *)(src[c + 3] + i));
+			pcm_transpose_sse2_4x4(v0, v1, v2, v3);
+
+			const __m128i f01 = _mm_packs_epi32(v0, v1);
+			const __m128i f23 = _mm_packs_epi32(v2, v3);
+			_mm_storel_epi64((__m128i *)(d + c), f01);
+			_mm_storel_epi64((__m128i *)(d + channels + c),
+					 _mm_srli_si128(f01, 8));
+			_mm_storel_epi64((__m128i *)(d + 2 * channels + c), f23);
+			_mm_storel_epi64((__m128i *)(d + 3 * channels + c),
+					 _mm_srli_si128(f23, 8));
+		}
+
+		if (c < channels) {
+			const __m128i x = _mm_loadu_si128((const __m128i *)(src[c] + i));
+			const __m128i y = _mm_loadu_si128((const __m128i *)(src[c + 1] + i));
+			const __m128i p =
+				_mm_packs_epi32(_mm_unpacklo_epi32(x, y),
+						_mm_unpackhi_epi32(x, y));
+
+			int32_t pairs[4];
+			_mm_storeu_si128((__m128i *)pairs, p);
+			for (unsigned j = 0; j < 4; ++j)
+				memcpy(d + j * channels + c, &pairs[j],
+				       sizeof(pairs[j]));
+		}
+	}
+
+	return i;
+}
+
+/**
+ * The inverse of pcm_interleave_sse2_32x2(): shufps picks the even
+ * and the odd elements of two vectors.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_deinterleave_sse2_32x2(uint32_t *a, uint32_t *b, const uint32_t *src,
+			   size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 x =
+			_mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + i * 2)));
+		const __m128 y =
+			_mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + i * 2 + 4)));
+		_mm_storeu_si128((__m128i *)(a + i),
+				 _mm_castps_si128(_mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0))));
+		_mm_storeu_si128((__m128i *)(b + i),
+				 _mm_castps_si128(_mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1))));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef PCM_SIMD_NEON
+
+static size_t
+pcm_interleave_neon_32x2(uint32_t *dest, const uint32_t *a,
+			 const uint32_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const uint32x4x2_t v = { { vld1q_u32(a + i), vld1q_u32(b + i) } };
+		vst2q_u32(dest + i * 2, v);
+	}
+
+	return i;
+}
+
+static size_t
+pcm_interleave_neon_16x2(uint16_t *dest, const uint16_t *a,
+			 const uint16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const uint16x8x2_t v = { { vld1q_u16(a + i), vld1q_u16(b + i) } };
+		vst2q_u16(dest + i * 2, v);
+	}
+
+	return i;
+}
+
+/**
+ * Transpose four vectors of four 32 bit samples, see
+ * pcm_transpose_sse2_4x4().
+ */
+static inline void
+pcm_transpose_neon_4x4(uint32x4_t &a, uint32x4_t &b,
+		       uint32x4_t &c, uint32x4_t &d)
+{
+	const uint32x4x2_t ab = vtrnq_u32(a, b);
+	const uint32x4x2_t cd = vtrnq_u32(c, d);
+	a = vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0]));
+	b = vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1]));
+	c = vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0]));
+	d = vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1]));
+}
+
+static size_t
+pcm_interleave_neon_32xn(uint32_t *dest, const uint32_t *const*src,
+			 unsigned channels, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		uint32_t *d = dest + i * channels;
+
+		unsigned c = 0;
+		for (; c + 4 <= channels; c += 4) {
+			uint32x4_t v0 = vld1q_u32(src[c] + i);
+			uint32x4_t v1 = vld1q_u32(src[c + 1] + i);
+			uint32x4_t v2 = vld1q_u32(src[c + 2] + i);
+			uint32x4_t v3 = vld1q_u32(src[c + 3] + i);
+			pcm_transpose_neon_4x4(v0, v1, v2, v3);
+			vst1q_u32(d + c, v0);
+			vst1q_u32(d + channels + c, v1);
+			vst1q_u32(d + 2 * channels + c, v2);
+			vst1q_u32(d + 3 * channels + c, v3);
+		}
+
+		if (c < channels) {
+			const uint32x4x2_t v = vzipq_u32(vld1q_u32(src[c] + i),
+							 vld1q_u32(src[c + 1] + i));
+			vst1_u32(d + c, vget_low_u32(v.val[0]));
+			vst1_u32(d + channels + c, vget_high_u32(v.val[0]));
+			vst1_u32(d + 2 * channels + c, vget_low_u32(v.val[1]));
+			vst1_u32(d + 3 * channels + c, vget_high_u32(v.val[1]));
+		}
+	}
+
+	return i;
+}
+
+static size_t
+pcm_interleave_neon_narrow16x2(int16_t *dest, const int32_t *a,
+			       const int32_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8x2_t v = { {
+			vcombine_s16(vmovn_s32(vld1q_s32(a + i)),
+				     vmovn_s32(vld1q_s32(a + i + 4))),
+			vcombine_s16(vmovn_s32(vld1q_s32(b + i)),
+				     vmovn_s32(vld1q_s32(b + i + 4))),
+		} };
+		vst2q_s16(dest + i * 2, v);
+	}
+
+	return i;
+}
+
+static size_t
+pcm_interleave_neon_narrow16xn(int16_t *dest, const int32_t *const*src,
+			       unsigned channels, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		int16_t *d = dest + i * channels;
+
+		unsigned c = 0;
+		for (; c + 4 <= channels; c += 4) {
+			uint32x4_t v0 = vld1q_u32((const uint32_t *)src[c] + i);
+			uint32x4_t v1 = vld1q_u32((const uint32_t *)src[c + 1] + i);
+			uint32x4_t v2 = vld1q_u32((const uint32_t *)src[c + 2] + i);
+			uint32x4_t v3 = vld1q_u32((const uint32_t *)src[c + 3] + i);
+			pcm_transpose_neon_4x4(v0, v1, v2, v3);
+			vst1_s16(d + c, vmovn_s32(vreinterpretq_s32_u32(v0)));
+			vst1_s16(d + channels + c,
+				 vmovn_s32(vreinterpretq_s32_u32(v1)));
+			vst1_s16(d + 2 * channels + c,
+				 vmovn_s32(vreinterpretq_s32_u32(v2)));
+			vst1_s16(d + 3 * channels + c,
+				 vmovn_s32(vreinterpretq_s32_u32(v3)));
+		}
+
+		if (c < channels) {
+			const int32x4x2_t v = vzipq_s32(vld1q_s32(src[c] + i),
+							vld1q_s32(src[c + 1] + i));
+			const int16x8_t p = vcombine_s16(vmovn_s32(v.val[0]),
+							 vmovn_s32(v.val[1]));
+
+			int32_t pairs[4];
+			vst1q_s32(pairs, vreinterpretq_s32_s16(p));
+			for (unsigned j = 0; j < 4; ++j)
+				memcpy(d + j * channels + c, &pairs[j],
+				       sizeof(pairs[j]));
+		}
+	}
+
+	return i;
+}
+
+static size_t
+pcm_deinterleave_neon_32x2(uint32_t *a, uint32_t *b, const uint32_t *src,
+			   size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const uint32x4x2_t v = vld2q_u32(src + i * 2);
+		vst1q_u32(a + i, v.val[0]);
+		vst1q_u32(b + i, v.val[1]);
+	}
+
+	return i;
+}
+
+#endif
+
+size_t
+pcm_interleave_simd_32x2(uint32_t *dest, const uint32_t *a,
+			 const uint32_t *b, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_interleave_avx2_32x2(dest, a, b, n);
+
+	case SimdLevel::SSE2:
+		return pcm_interleave_sse2_32x2(dest, a, b, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_interleave_neon_32x2(dest, a, b, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_interleave_simd_16x2(uint16_t *dest, const uint16_t *a,
+			 const uint16_t *b, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_interleave_sse2_16x2(dest, a, b, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_interleave_neon_16x2(dest, a, b, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_interleave_simd_32xn(uint32_t *dest, const uint32_t *const*src,
+			 unsigned channels, size_t n)
+{
+	if (channels < 4 || channels % 2 != 0)
+		return 0;
+
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_interleave_sse2_32xn(dest, src, channels, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_interleave_neon_32xn(dest, src, channels, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_interleave_simd_narrow16x2(int16_t *dest, const int32_t *a,
+			       const int32_t *b, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_interleave_sse2_narrow16x2(dest, a, b, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_interleave_neon_narrow16x2(dest, a, b, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_interleave_simd_narrow16xn(int16_t *dest, const int32_t *const*src,
+			       unsigned channels, size_t n)
+{
+	if (channels < 4 || channels % 2 != 0)
+		return 0;
+
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_interleave_sse2_narrow16xn(dest, src, channels, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_interleave_neon_narrow16xn(dest, src, channels, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_deinterleave_simd_32x2(uint32_t *a, uint32_t *b, const uint32_t *src,
+			   size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_deinterleave_sse2_32x2(a, b, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_deinterleave_neon_32x2(a, b, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
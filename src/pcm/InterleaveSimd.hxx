@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_INTERLEAVE_SIMD_HXX
+#define MPD_PCM_INTERLEAVE_SIMD_HXX
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorised kernels for PcmInterleave() and PcmDeinterleave32().  Just like the ones in
+ * VolumeSimd.hxx, the instruction set is chosen at runtime, each
+ * function processes a multiple of the vector width and returns the
+ * number of frames it has processed, and the result is bit-exact
+ * with the scalar implementation in Interleave.cxx.
+ */
+
+/**
+ * Interleave two channels of 32 bit samples.
+ */
+size_t
+pcm_interleave_simd_32x2(uint32_t *dest, const uint32_t *a,
+			 const uint32_t *b, size_t n);
+
+/**
+ * Interleave two channels of 16 bit samples.
+ */
+size_t
+pcm_interleave_simd_16x2(uint16_t *dest, const uint16_t *a,
+			 const uint16_t *b, size_t n);
+
+/**
+ * Interleave an even number (at least 4) of channels of 32 bit
+ * samples.  Returns 0 for other channel counts.
+ */
+size_t
+pcm_interleave_simd_32xn(uint32_t *dest, const uint32_t *const*src,
+			 unsigned channels, size_t n);
+
+/**
+ * Interleave two channels of 32 bit samples which fit into 16 bit,
+ * and store them as 16 bit.
+ */
+size_t
+pcm_interleave_simd_narrow16x2(int16_t *dest, const int32_t *a,
+			       const int32_t *b, size_t n);
+
+/**
+ * Like pcm_interleave_simd_narrow16x2(), but for an even number (at
+ * least 4) of channels.  Returns 0 for other channel counts.
+ */
+size_t
+pcm_interleave_simd_narrow16xn(int16_t *dest, const int32_t *const*src,
+			       unsigned channels, size_t n);
+
+/**
+ * Split interleaved stereo 32 bit samples into two channels.
+ */
+size_t
+pcm_deinterleave_simd_32x2(uint32_t *a, uint32_t *b, const uint32_t *src,
+			   size_t n);
+
+#endif
@@ -42,6 +42,7 @@ public:
 	virtual AudioFormat Open(AudioFormat &af, unsigned new_sample_rate,
 				 Error &error) override;
 	virtual void Close() override;
+	virtual void Reset() override;
 	virtual ConstBuffer<void> Resample(ConstBuffer<void> src,
 					   Error &error) override;
 
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Loudness.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The K-weighting filter coefficients are derived from the analog
+ * prototypes for the given sample rate (the values given in
+ * BS.1770 are only valid for 48 kHz).
+ */
+LoudnessMeter::LoudnessMeter(unsigned sample_rate, unsigned _channels)
+	:channels(_channels),
+	 shelf_state(_channels, FilterState{0, 0, 0, 0}),
+	 highpass_state(_channels, FilterState{0, 0, 0, 0}),
+	 weights(_channels, 1.),
+	 block_frames(std::max(sample_rate / 10, 1u)),
+	 block_sum(0), block_position(0),
+	 n_previous(0),
+	 peak(0)
+{
+	assert(channels > 0);
+
+	/* stage 1: high shelf modelling the acoustic effect of the
+	   head */
+	{
+		const double f0 = 1681.974450955533;
+		const double G = 3.999843853973347;
+		const double Q = 0.7071752369554196;
+
+		const double K = tan(M_PI * f0 / sample_rate);
+		const double Vh = pow(10., G / 20.);
+		const double Vb = pow(Vh, 0.4996667741545416);
+		const double a0 = 1. + K / Q + K * K;
+
+		shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+		shelf.b1 = 2. * (K * K - Vh) / a0;
+		shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+		shelf.a1 = 2. * (K * K - 1.) / a0;
+		shelf.a2 = (1. - K / Q + K * K) / a0;
+	}
+
+	/* stage 2: the "RLB" high-pass filter */
+	{
+		const double f0 = 38.13547087602444;
+		const double Q = 0.5003270373238773;
+
+		const double K = tan(M_PI * f0 / sample_rate);
+		const double a0 = 1. + K / Q + K * K;
+
+		highpass.b0 = 1.;
+		highpass.b1 = -2.;
+		highpass.b2 = 1.;
+		highpass.a1 = 2. * (K * K - 1.) / a0;
+		highpass.a2 = (1. - K / Q + K * K) / a0;
+	}
+
+	/* channel weights for the surround layouts; the LFE channel
+	   is ignored */
+	if (channels == 5) {
+		weights[3] = weights[4] = 1.41;
+	} else if (channels == 6 || channels == 8) {
+		weights[3] = 0;
+		for (unsigned c = 4; c < channels; ++c)
+			weights[c] = 1.41;
+	}
+}
+
+static inline double
+ApplyBiquad(double x, double b0, double b1, double b2,
+	    double a1, double a2,
+	    double &x1, double &x2, double &y1, double &y2)
+{
+	const double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+	x2 = x1;
+	x1 = x;
+	y2 = y1;
+	y1 = y;
+	return y;
+}
+
+void
+LoudnessMeter::Feed(const float *src, size_t n_frames)
+{
+	for (size_t i = 0; i < n_frames; ++i) {
+		double sum = 0;
+		for (unsigned c = 0; c < channels; ++c) {
+			const float sample = *src++;
+			peak = std::max(peak, fabsf(sample));
+
+			FilterState &s = shelf_state[c];
+			FilterState &h = highpass_state[c];
+			double y = ApplyBiquad(sample, shelf.b0, shelf.b1,
+					       shelf.b2, shelf.a1, shelf.a2,
+					       s.x1, s.x2, s.y1, s.y2);
+			y = ApplyBiquad(y, highpass.b0, highpass.b1,
+					highpass.b2, highpass.a1, highpass.a2,
+					h.x1, h.x2, h.y1, h.y2);
+			sum += weights[c] * y * y;
+		}
+
+		block_sum += sum;
+		if (++block_position == block_frames)
+			FinishBlock();
+	}
+}
+
+void
+LoudnessMeter::FinishBlock()
+{
+	const double energy = block_sum / block_frames;
+	block_sum = 0;
+	block_position = 0;
+
+	if (n_previous == 3)
+		gating_blocks.push_back((previous[0] + previous[1] +
+					 previous[2] + energy) / 4);
+	else
+		++n_previous;
+
+	previous[0] = previous[1];
+	previous[1] = previous[2];
+	previous[2] = energy;
+}
+
+static inline double
+EnergyToLoudness(double energy)
+{
+	return -0.691 + 10. * log10(energy);
+}
+
+static inline double
+LoudnessToEnergy(double loudness)
+{
+	return pow(10., (loudness + 0.691) / 10.);
+}
+
+double
+LoudnessMeter::GetIntegratedLoudness() const
+{
+	/* absolute gate */
+	const double absolute = LoudnessToEnergy(-70);
+
+	double sum = 0;
+	size_t n = 0;
+	for (double e : gating_blocks) {
+		if (e > absolute) {
+			sum += e;
+			++n;
+		}
+	}
+
+	if (n == 0)
+		return -HUGE_VAL;
+
+	/* relative gate: 10 LU below the loudness of the blocks
+	   which have passed the absolute gate */
+	const double relative =
+		std::max(absolute,
+			 LoudnessToEnergy(EnergyToLoudness(sum / n) - 10));
+
+	sum = 0;
+	n = 0;
+	for (double e : gating_blocks) {
+		if (e > relative) {
+			sum += e;
+			++n;
+		}
+	}
+
+	return n > 0
+		? EnergyToLoudness(sum / n)
+		: -HUGE_VAL;
+}
+
+/**
+ * The MixRamp levels in dBFS, in increasing order.
+ */
+static constexpr int MIXRAMP_MIN_DB = -42, MIXRAMP_STEP_DB = 3;
+static constexpr unsigned MIXRAMP_N_LEVELS = -MIXRAMP_MIN_DB / MIXRAMP_STEP_DB + 1;
+
+static constexpr double
+MixRampLevel(unsigned i)
+{
+	return MIXRAMP_MIN_DB + int(i) * MIXRAMP_STEP_DB;
+}
+
+MixRampMeter::MixRampMeter(unsigned sample_rate, unsigned _channels)
+	:channels(_channels),
+	 window_frames(std::max(sample_rate / 10, 1u)),
+	 window_sum(0), window_position(0), n_windows(0),
+	 first(MIXRAMP_N_LEVELS, SIZE_MAX),
+	 last(MIXRAMP_N_LEVELS, SIZE_MAX)
+{
+	assert(channels > 0);
+}
+
+void
+MixRampMeter::Feed(const float *src, size_t n_frames)
+{
+	for (size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < channels; ++c) {
+			const double sample = *src++;
+			window_sum += sample * sample;
+		}
+
+		if (++window_position == window_frames)
+			FinishWindow();
+	}
+}
+
+void
+MixRampMeter::FinishWindow()
+{
+	const double mean = window_sum / (window_frames * channels);
+	window_sum = 0;
+	window_position = 0;
+
+	const double level = mean > 0 ? 10. * log10(mean) : -HUGE_VAL;
+	for (unsigned i = 0; i < MIXRAMP_N_LEVELS && level >= MixRampLevel(i);
+	     ++i) {
+		if (first[i] == SIZE_MAX)
+			first[i] = n_windows;
+		last[i] = n_windows;
+	}
+
+	++n_windows;
+}
+
+static void
+AppendMixRamp(std::string &dest, double db, double seconds)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.2f %.2f;", db, seconds);
+	dest += buffer;
+}
+
+std::string
+MixRampMeter::GetStart() const
+{
+	std::string result;
+	for (unsigned i = 0; i < MIXRAMP_N_LEVELS; ++i)
+		if (first[i] != SIZE_MAX)
+			AppendMixRamp(result, MixRampLevel(i),
+				      first[i] / 10.);
+	return result;
+}
+
+std::string
+MixRampMeter::GetEnd() const
+{
+	std::string result;
+	for (unsigned i = 0; i < MIXRAMP_N_LEVELS; ++i)
+		if (last[i] != SIZE_MAX)
+			AppendMixRamp(result, MixRampLevel(i),
+				      (n_windows - 1 - last[i]) / 10.);
+	return result;
+}
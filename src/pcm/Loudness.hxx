@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_LOUDNESS_HXX
+#define MPD_PCM_LOUDNESS_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+/**
+ * Measures the integrated loudness of a stream according to EBU
+ * R128 / ITU-R BS.1770 (K-weighting, 400 ms gating blocks with 75%
+ * overlap, absolute and relative gate), and its sample peak.
+ */
+class LoudnessMeter {
+	/**
+	 * A second order IIR filter in direct form I, one state per
+	 * channel.
+	 */
+	struct Biquad {
+		double b0, b1, b2, a1, a2;
+	};
+
+	struct FilterState {
+		double x1, x2, y1, y2;
+	};
+
+	Biquad shelf, highpass;
+
+	unsigned channels;
+
+	std::vector<FilterState> shelf_state, highpass_state;
+	std::vector<double> weights;
+
+	/**
+	 * The number of frames in a 100 ms sub-block.
+	 */
+	size_t block_frames;
+
+	/**
+	 * The weighted energy of the current sub-block, and the
+	 * number of frames in it so far.
+	 */
+	double block_sum;
+	size_t block_position;
+
+	/**
+	 * The mean weighted energy of the last three finished
+	 * sub-blocks.
+	 */
+	double previous[3];
+	unsigned n_previous;
+
+	/**
+	 * The mean energy of all 400 ms gating blocks.
+	 */
+	std::vector<double> gating_blocks;
+
+	float peak;
+
+public:
+	LoudnessMeter(unsigned sample_rate, unsigned channels);
+
+	/**
+	 * Feed interleaved samples, where 1.0 is full scale.
+	 */
+	void Feed(const float *src, size_t n_frames);
+
+	/**
+	 * The highest absolute sample value so far.
+	 */
+	float GetPeak() const {
+		return peak;
+	}
+
+	/**
+	 * Calculate the integrated loudness in LUFS.
+	 *
+	 * @return the loudness, or a value below -70 if the stream
+	 * was (nearly) silent
+	 */
+	gcc_pure
+	double GetIntegratedLoudness() const;
+
+private:
+	void FinishBlock();
+};
+
+/**
+ * Determines the MixRamp profile of a stream: for a range of levels,
+ * the time from the start until the level is first reached, and the
+ * time from the last moment the level is reached until the end.  The
+ * result is formatted like the "mixramp_start" and "mixramp_end"
+ * tags.
+ */
+class MixRampMeter {
+	unsigned channels;
+
+	/**
+	 * The number of frames in a 100 ms window.
+	 */
+	size_t window_frames;
+
+	double window_sum;
+	size_t window_position;
+
+	/**
+	 * The number of finished windows.
+	 */
+	size_t n_windows;
+
+	/**
+	 * For each level: the first and the last window which
+	 * reached it, or SIZE_MAX.
+	 */
+	std::vector<size_t> first, last;
+
+public:
+	MixRampMeter(unsigned sample_rate, unsigned channels);
+
+	/**
+	 * Feed interleaved samples, where 1.0 is full scale.
+	 */
+	void Feed(const float *src, size_t n_frames);
+
+	gcc_pure
+	std::string GetStart() const;
+
+	gcc_pure
+	std::string GetEnd() const;
+
+private:
+	void FinishWindow();
+};
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Normalizer.hxx"
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+/**
+ * The level the normalizer aims at; this is the default of the
+ * AudioCompress library which was used previously.
+ */
+static constexpr float NORMALIZER_TARGET = 0.5;
+
+/**
+ * Never amplify by more than this factor.
+ */
+static constexpr float NORMALIZER_MAX_GAIN = 32;
+
+/**
+ * The inertia of the normalization gain: each block moves it by
+ * this fraction towards the wanted gain.
+ */
+static constexpr float NORMALIZER_SMOOTH = 1. / 256;
+
+/**
+ * The limiter keeps all samples below this level.
+ */
+static constexpr float NORMALIZER_CEILING = 1;
+
+/**
+ * Determine the absolute peak of a block.  Four independent
+ * accumulators allow the compiler to keep several vector lanes busy.
+ */
+gcc_pure
+static float
+BlockPeak(const float *p, size_t n)
+{
+	assert(n % 4 == 0);
+
+	float m0 = 0, m1 = 0, m2 = 0, m3 = 0;
+	for (size_t i = 0; i < n; i += 4) {
+		m0 = std::max(m0, fabsf(p[i]));
+		m1 = std::max(m1, fabsf(p[i + 1]));
+		m2 = std::max(m2, fabsf(p[i + 2]));
+		m3 = std::max(m3, fabsf(p[i + 3]));
+	}
+
+	return std::max(std::max(m0, m1), std::max(m2, m3));
+}
+
+void
+PcmNormalizer::Open(unsigned _channels)
+{
+	channels = _channels;
+	pending.clear();
+	pending_peak = -1;
+	history.fill(0);
+	history_position = 0;
+	target_gain = 1;
+	gain = 1;
+}
+
+void
+PcmNormalizer::Close()
+{
+	/* the held back blocks are discarded */
+	pending.clear();
+	pending.shrink_to_fit();
+	buffer.Clear();
+}
+
+inline void
+PcmNormalizer::ProcessBlock(float *dest, const float *src,
+			    float peak, float next_peak)
+{
+	/* normalization: follow the loudest block in the history */
+
+	history[history_position] = peak;
+	history_position = (history_position + 1) % HISTORY;
+
+	const float loudest = *std::max_element(history.begin(),
+						history.end());
+	float wanted = loudest * NORMALIZER_MAX_GAIN > NORMALIZER_TARGET
+		? NORMALIZER_TARGET / loudest
+		: NORMALIZER_MAX_GAIN;
+	if (wanted < 1)
+		/* don't attenuate; that's the limiter's job */
+		wanted = 1;
+
+	target_gain += (wanted - target_gain) * NORMALIZER_SMOOTH;
+
+	/* limiter: the gain at the end of this block must not clip
+	   this block or the next one; the gain at the start has been
+	   limited the same way by the previous block, so the linear
+	   ramp between both does not clip either */
+
+	float end_gain = target_gain;
+	const float limit = std::max(peak, next_peak);
+	if (limit * end_gain > NORMALIZER_CEILING)
+		end_gain = NORMALIZER_CEILING / limit;
+
+	const float step = (end_gain - gain) / BLOCK_FRAMES;
+	for (size_t i = 0; i < BLOCK_FRAMES; ++i) {
+		const float g = gain + step * (i + 1);
+		for (unsigned c = 0; c < channels; ++c)
+			*dest++ = *src++ * g;
+	}
+
+	gain = end_gain;
+}
+
+ConstBuffer<float>
+PcmNormalizer::Process(ConstBuffer<float> src)
+{
+	pending.insert(pending.end(), src.begin(), src.end());
+
+	const size_t block_size = BLOCK_FRAMES * channels;
+	const size_t n_blocks = pending.size() / block_size;
+	if (n_blocks < 2)
+		/* not enough lookahead yet */
+		return { src.data, 0 };
+
+	/* the last complete block is only used for lookahead */
+	const size_t n = (n_blocks - 1) * block_size;
+	float *const dest = buffer.GetT<float>(n);
+
+	const float *p = pending.data();
+	float peak = pending_peak >= 0
+		? pending_peak
+		: BlockPeak(p, block_size);
+
+	for (size_t i = 0; i < n; i += block_size, p += block_size) {
+		const float next_peak = BlockPeak(p + block_size, block_size);
+		ProcessBlock(dest + i, p, peak, next_peak);
+		peak = next_peak;
+	}
+
+	pending_peak = peak;
+	pending.erase(pending.begin(), pending.begin() + n);
+
+	return { dest, n };
+}
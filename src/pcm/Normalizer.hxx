@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_NORMALIZER_HXX
+#define MPD_PCM_NORMALIZER_HXX
+
+#include "PcmBuffer.hxx"
+
+#include <array>
+#include <vector>
+
+#include <stddef.h>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * A volume normalizer with a lookahead peak limiter.  It operates on
+ * interleaved floating point samples in blocks of #BLOCK_FRAMES: the
+ * peak of each block determines the normalization gain (which
+ * follows the loudest block of the last few seconds with some
+ * inertia), and the gain ramp within a block is limited so neither
+ * this block nor the next one clips.  This delays the signal by one
+ * to two blocks.
+ */
+class PcmNormalizer {
+	/**
+	 * The number of frames per block, which is also the length of
+	 * the lookahead.
+	 */
+	static constexpr size_t BLOCK_FRAMES = 512;
+
+	/**
+	 * The number of block peaks remembered for determining the
+	 * normalization gain.
+	 */
+	static constexpr size_t HISTORY = 800;
+
+	unsigned channels;
+
+	/**
+	 * Input samples which have not been processed yet, because
+	 * there is no lookahead for them yet.
+	 */
+	std::vector<float> pending;
+
+	/**
+	 * The peak of the first block in #pending, or a negative
+	 * value if it has not been calculated yet.
+	 */
+	float pending_peak;
+
+	std::array<float, HISTORY> history;
+	size_t history_position;
+
+	/**
+	 * The smoothed normalization gain.
+	 */
+	float target_gain;
+
+	/**
+	 * The gain applied to the last frame of the previous block.
+	 */
+	float gain;
+
+	PcmBuffer buffer;
+
+public:
+	void Open(unsigned _channels);
+	void Close();
+
+	/**
+	 * Process a buffer of interleaved samples.  The returned
+	 * buffer may be shorter or longer than the input, because
+	 * the normalizer holds back up to two blocks for lookahead.
+	 * It is invalidated by the next call.
+	 */
+	ConstBuffer<float> Process(ConstBuffer<float> src);
+
+private:
+	void ProcessBlock(float *dest, const float *src,
+			  float peak, float next_peak);
+};
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "PcmChannels.hxx"
+#include "PcmChannelsSimd.hxx"
 #include "PcmBuffer.hxx"
 #include "Traits.hxx"
 #include "AudioFormat.hxx"
@@ -115,27 +116,101 @@ NToM(typename Traits::pointer_type dest,
 	return dest;
 }
 
-template<SampleFormat F, class Traits=SampleTraits<F>>
+/**
+ * Convert as many frames as possible with the vectorised kernels from
+ * PcmChannelsSimd.hxx.
+ *
+ * @return the number of frames which have been converted
+ */
+static size_t
+ConvertChannelsSimd16(int16_t *dest, unsigned dest_channels,
+		      unsigned src_channels, const int16_t *src, size_t n)
+{
+	if (src_channels == 1 && dest_channels == 2)
+		return pcm_channels_simd_mono_to_stereo_16((uint16_t *)dest,
+							   (const uint16_t *)src,
+							   n);
+	else if (src_channels == 2 && dest_channels == 1)
+		return pcm_channels_simd_stereo_to_mono_16(dest, src, n);
+	else if (src_channels == 6 && dest_channels == 2)
+		return pcm_channels_simd_6_to_stereo_16(dest, src, n);
+	else
+		return 0;
+}
+
+static size_t
+ConvertChannelsSimd24(int32_t *dest, unsigned dest_channels,
+		      unsigned src_channels, const int32_t *src, size_t n)
+{
+	if (src_channels == 1 && dest_channels == 2)
+		return pcm_channels_simd_mono_to_stereo_32((uint32_t *)dest,
+							   (const uint32_t *)src,
+							   n);
+	else if (src_channels == 2 && dest_channels == 1)
+		return pcm_channels_simd_stereo_to_mono_24(dest, src, n);
+	else
+		return 0;
+}
+
+/**
+ * There is no vectorised stereo-to-mono kernel for 32 bit samples,
+ * because the sum needs 33 bits.
+ */
+static size_t
+ConvertChannelsSimd32(int32_t *dest, unsigned dest_channels,
+		      unsigned src_channels, const int32_t *src, size_t n)
+{
+	if (src_channels == 1 && dest_channels == 2)
+		return pcm_channels_simd_mono_to_stereo_32((uint32_t *)dest,
+							   (const uint32_t *)src,
+							   n);
+	else
+		return 0;
+}
+
+static size_t
+ConvertChannelsSimdFloat(float *dest, unsigned dest_channels,
+			 unsigned src_channels, const float *src, size_t n)
+{
+	if (src_channels == 1 && dest_channels == 2)
+		return pcm_channels_simd_mono_to_stereo_32((uint32_t *)dest,
+							   (const uint32_t *)src,
+							   n);
+	else if (src_channels == 2 && dest_channels == 1)
+		return pcm_channels_simd_stereo_to_mono_float(dest, src, n);
+	else
+		return 0;
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>, typename S>
 static ConstBuffer<typename Traits::value_type>
 ConvertChannels(PcmBuffer &buffer,
 		unsigned dest_channels,
 		unsigned src_channels,
-		ConstBuffer<typename Traits::value_type> src)
+		ConstBuffer<typename Traits::value_type> src,
+		S simd)
 {
 	assert(src.size % src_channels == 0);
 
 	const size_t dest_size = src.size / src_channels * dest_channels;
 	auto dest = buffer.GetT<typename Traits::value_type>(dest_size);
 
+	/* the vectorised kernels do the bulk; the scalar code below
+	   handles the remaining frames and all other layouts */
+	const size_t done = simd(dest, dest_channels, src_channels,
+				 src.data, src.size / src_channels);
+	auto d = dest + done * dest_channels;
+	auto s = src.begin() + done * src_channels;
+
 	if (src_channels == 1 && dest_channels == 2)
-		MonoToStereo(dest, src.begin(), src.end());
+		MonoToStereo(d, s, src.end());
 	else if (src_channels == 2 && dest_channels == 1)
-		StereoToMono<F>(dest, src.begin(), src.end());
+		StereoToMono<F>(d, s, src.end());
 	else if (dest_channels == 2)
-		NToStereo<F>(dest, src_channels, src.begin(), src.end());
+		NToStereo<F>(d, src_channels, s, src.end());
 	else
-		NToM<F>(dest, dest_channels,
-			src_channels, src.begin(), src.end());
+		NToM<F>(d, dest_channels,
+			src_channels, s, src.end());
 
 	return { dest, dest_size };
 }
@@ -147,7 +222,8 @@ pcm_convert_channels_16(PcmBuffer &buffer,
 			ConstBuffer<int16_t> src)
 {
 	return ConvertChannels<SampleFormat::S16>(buffer, dest_channels,
-						  src_channels, src);
+						  src_channels, src,
+						  ConvertChannelsSimd16);
 }
 
 ConstBuffer<int32_t>
@@ -157,7 +233,8 @@ pcm_convert_channels_24(PcmBuffer &buffer,
 			ConstBuffer<int32_t> src)
 {
 	return ConvertChannels<SampleFormat::S24_P32>(buffer, dest_channels,
-						      src_channels, src);
+						      src_channels, src,
+						      ConvertChannelsSimd24);
 }
 
 ConstBuffer<int32_t>
@@ -167,7 +244,8 @@ pcm_convert_channels_32(PcmBuffer &buffer,
 			ConstBuffer<int32_t> src)
 {
 	return ConvertChannels<SampleFormat::S32>(buffer, dest_channels,
-						  src_channels, src);
+						  src_channels, src,
+						  ConvertChannelsSimd32);
 }
 
 ConstBuffer<float>
@@ -177,5 +255,6 @@ pcm_convert_channels_float(PcmBuffer &buffer,
 			   ConstBuffer<float> src)
 {
 	return ConvertChannels<SampleFormat::FLOAT>(buffer, dest_channels,
-						    src_channels, src);
+						    src_channels, src,
+						    ConvertChannelsSimdFloat);
 }
@@ -0,0 +1,529 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "PcmChannelsSimd.hxx"
+#include "SimdLevel.hxx"
+
+#if defined(PCM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef PCM_SIMD_X86
+
+__attribute__((target("sse2")))
+static size_t
+pcm_mono_to_stereo_sse2_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i * 2),
+				 _mm_unpacklo_epi16(x, x));
+		_mm_storeu_si128((__m128i *)(dest + i * 2 + 8),
+				 _mm_unpackhi_epi16(x, x));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_mono_to_stereo_sse2_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i * 2),
+				 _mm_unpacklo_epi32(x, x));
+		_mm_storeu_si128((__m128i *)(dest + i * 2 + 4),
+				 _mm_unpackhi_epi32(x, x));
+	}
+
+	return i;
+}
+
+/**
+ * Divide 32 bit integers by two, rounding towards zero like the C
+ * division operator: negative values are incremented before the
+ * arithmetic shift.
+ */
+__attribute__((target("sse2")))
+static inline __m128i
+pcm_half_sse2_32(__m128i x)
+{
+	return _mm_srai_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 31)), 1);
+}
+
+/**
+ * pmaddwd with a vector of ones adds each pair of adjacent 16 bit
+ * samples (i.e. the two channels of a frame) into a 32 bit integer.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_stereo_to_mono_sse2_16(int16_t *dest, const int16_t *src, size_t n)
+{
+	const __m128i one = _mm_set1_epi16(1);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i a =
+			_mm_madd_epi16(_mm_loadu_si128((const __m128i *)(src + i * 2)),
+				       one);
+		const __m128i b =
+			_mm_madd_epi16(_mm_loadu_si128((const __m128i *)(src + i * 2 + 8)),
+				       one);
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_packs_epi32(pcm_half_sse2_32(a),
+						 pcm_half_sse2_32(b)));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_stereo_to_mono_sse2_24(int32_t *dest, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 x =
+			_mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + i * 2)));
+		const __m128 y =
+			_mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(src + i * 2 + 4)));
+		const __m128i left =
+			_mm_castps_si128(_mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m128i right =
+			_mm_castps_si128(_mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 pcm_half_sse2_32(_mm_add_epi32(left, right)));
+	}
+
+	return i;
+}
+
+/**
+ * Multiplying by 0.5 is exact, and therefore equals the division
+ * in the scalar code.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_stereo_to_mono_sse_float(float *dest, const float *src, size_t n)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 x = _mm_loadu_ps(src + i * 2);
+		const __m128 y = _mm_loadu_ps(src + i * 2 + 4);
+		const __m128 sum =
+			_mm_add_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)),
+				   _mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_ps(dest + i, _mm_mul_ps(sum, half));
+	}
+
+	return i;
+}
+
+/**
+ * Divide four signed 32 bit integers by six, truncating towards zero.
+ * The absolute values must be below 2^19 (six 16 bit samples sum up
+ * to at most 196608).  In that range, multiplying with
+ * ceil(2^20 / 6) = 174763 and shifting right by 20 is exact.
+ * pmuludq multiplies only the even lanes, so the odd lanes are
+ * shifted down and multiplied separately.
+ */
+__attribute__((target("sse2")))
+static inline __m128i
+pcm_div6_sse2(__m128i x)
+{
+	const __m128i magic = _mm_set1_epi32(174763);
+
+	const __m128i sign = _mm_srai_epi32(x, 31);
+	const __m128i abs = _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+
+	const __m128i even =
+		_mm_srli_epi64(_mm_mul_epu32(abs, magic), 20);
+	const __m128i odd =
+		_mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(abs, 32), magic),
+			       20);
+
+	/* both quotients are below 2^32, so the upper half of each
+	   64 bit lane of "even" is zero */
+	const __m128i q = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+	return _mm_sub_epi32(_mm_xor_si128(q, sign), sign);
+}
+
+/**
+ * Four 5.1 frames are three vectors.  pmaddwd sums channel pairs,
+ * resulting in twelve 32 bit values q0..q11 (three per frame),
+ * which are then gathered by shufps into three vectors
+ * [q0,q3,q6,q9], [q1,q4,q7,q10], [q2,q5,q8,q11] and added.  The
+ * division by six truncates towards zero like the scalar division;
+ * see pcm_div6_sse2().
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_6_to_stereo_sse2_16(int16_t *dest, const int16_t *src, size_t n)
+{
+	const __m128i one = _mm_set1_epi16(1);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int16_t *s = src + i * 6;
+		const __m128 p0 =
+			_mm_castsi128_ps(_mm_madd_epi16(_mm_loadu_si128((const __m128i *)s),
+							one));
+		const __m128 p1 =
+			_mm_castsi128_ps(_mm_madd_epi16(_mm_loadu_si128((const __m128i *)(s + 8)),
+							one));
+		const __m128 p2 =
+			_mm_castsi128_ps(_mm_madd_epi16(_mm_loadu_si128((const __m128i *)(s + 16)),
+							one));
+
+		/* [q0,q3,q4,q5] and [q6,q7,q9,q10] */
+		const __m128 a = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(1, 0, 3, 0));
+		const __m128 b = _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(2, 1, 3, 2));
+		/* [q1,q2,q4,q5] and [q7,q7,q8,q10] */
+		const __m128 c = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(1, 0, 2, 1));
+		const __m128 d = _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(2, 0, 3, 3));
+
+		const __m128i x =
+			_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 1, 0)));
+		const __m128i y =
+			_mm_castps_si128(_mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 0, 2, 0)));
+		const __m128i z =
+			_mm_castps_si128(_mm_shuffle_ps(c, p2, _MM_SHUFFLE(3, 0, 3, 1)));
+
+		const __m128i sum = _mm_add_epi32(_mm_add_epi32(x, y), z);
+		const __m128i value = pcm_div6_sse2(sum);
+		const __m128i packed = _mm_packs_epi32(value, value);
+		_mm_storeu_si128((__m128i *)(dest + i * 2),
+				 _mm_unpacklo_epi16(packed, packed));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_swap_sse2_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i * 2));
+		x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+		x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+		_mm_storeu_si128((__m128i *)(dest + i * 2), x);
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_swap_sse2_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i * 2));
+		_mm_storeu_si128((__m128i *)(dest + i * 2),
+				 _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef PCM_SIMD_NEON
+
+static size_t
+pcm_mono_to_stereo_neon_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const uint16x8_t x = vld1q_u16(src + i);
+		const uint16x8x2_t v = { { x, x } };
+		vst2q_u16(dest + i * 2, v);
+	}
+
+	return i;
+}
+
+static size_t
+pcm_mono_to_stereo_neon_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const uint32x4_t x = vld1q_u32(src + i);
+		const uint32x4x2_t v = { { x, x } };
+		vst2q_u32(dest + i * 2, v);
+	}
+
+	return i;
+}
+
+/**
+ * Divide 32 bit integers by two, rounding towards zero, see
+ * pcm_half_sse2_32().
+ */
+static inline int32x4_t
+pcm_half_neon_32(int32x4_t x)
+{
+	const uint32x4_t sign = vshrq_n_u32(vreinterpretq_u32_s32(x), 31);
+	return vshrq_n_s32(vaddq_s32(x, vreinterpretq_s32_u32(sign)), 1);
+}
+
+static size_t
+pcm_stereo_to_mono_neon_16(int16_t *dest, const int16_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8x2_t v = vld2q_s16(src + i * 2);
+		const int32x4_t lo = vaddl_s16(vget_low_s16(v.val[0]),
+					       vget_low_s16(v.val[1]));
+		const int32x4_t hi = vaddl_s16(vget_high_s16(v.val[0]),
+					       vget_high_s16(v.val[1]));
+		vst1q_s16(dest + i,
+			  vcombine_s16(vmovn_s32(pcm_half_neon_32(lo)),
+				       vmovn_s32(pcm_half_neon_32(hi))));
+	}
+
+	return i;
+}
+
+static size_t
+pcm_stereo_to_mono_neon_24(int32_t *dest, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int32x4x2_t v = vld2q_s32(src + i * 2);
+		vst1q_s32(dest + i,
+			  pcm_half_neon_32(vaddq_s32(v.val[0], v.val[1])));
+	}
+
+	return i;
+}
+
+#ifdef __aarch64__
+/* only on AArch64: ARMv7 NEON flushes denormals to zero, which
+   would not be bit-exact */
+static size_t
+pcm_stereo_to_mono_neon_float(float *dest, const float *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4x2_t v = vld2q_f32(src + i * 2);
+		vst1q_f32(dest + i,
+			  vmulq_n_f32(vaddq_f32(v.val[0], v.val[1]), 0.5f));
+	}
+
+	return i;
+}
+#endif
+
+static size_t
+pcm_swap_neon_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_u16(dest + i * 2, vrev32q_u16(vld1q_u16(src + i * 2)));
+
+	return i;
+}
+
+static size_t
+pcm_swap_neon_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 2 <= n; i += 2)
+		vst1q_u32(dest + i * 2, vrev64q_u32(vld1q_u32(src + i * 2)));
+
+	return i;
+}
+
+#endif
+
+size_t
+pcm_channels_simd_mono_to_stereo_16(uint16_t *dest, const uint16_t *src,
+				    size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_mono_to_stereo_sse2_16(dest, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_mono_to_stereo_neon_16(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_channels_simd_mono_to_stereo_32(uint32_t *dest, const uint32_t *src,
+				    size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_mono_to_stereo_sse2_32(dest, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_mono_to_stereo_neon_32(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_channels_simd_stereo_to_mono_16(int16_t *dest, const int16_t *src,
+				    size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_stereo_to_mono_sse2_16(dest, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_stereo_to_mono_neon_16(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_channels_simd_stereo_to_mono_24(int32_t *dest, const int32_t *src,
+				    size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_stereo_to_mono_sse2_24(dest, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_stereo_to_mono_neon_24(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_channels_simd_stereo_to_mono_float(float *dest, const float *src,
+				       size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_stereo_to_mono_sse_float(dest, src, n);
+#endif
+
+#if defined(PCM_SIMD_NEON) && defined(__aarch64__)
+	case SimdLevel::NEON:
+		return pcm_stereo_to_mono_neon_float(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_channels_simd_6_to_stereo_16(int16_t *dest, const int16_t *src,
+				 size_t n)
+{
+	/* no NEON version: ARMv7 NEON lacks a division instruction,
+	   and the reciprocal estimate is not exact */
+
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_6_to_stereo_sse2_16(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_channels_simd_swap_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_swap_sse2_16(dest, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_swap_neon_16(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_channels_simd_swap_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_swap_sse2_32(dest, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_swap_neon_32(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
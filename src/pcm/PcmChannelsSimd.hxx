@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_CHANNELS_SIMD_HXX
+#define MPD_PCM_CHANNELS_SIMD_HXX
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorised kernels for common channel layout conversions in
+ * PcmChannels.cxx and the "route" filter.  Just like the ones in
+ * VolumeSimd.hxx, the instruction set is chosen at runtime, each
+ * function processes a multiple of the vector width and returns the
+ * number of frames it has processed, and the result is bit-exact
+ * with the scalar implementation.
+ */
+
+/**
+ * Duplicate each 16 bit mono sample into a stereo frame.
+ */
+size_t
+pcm_channels_simd_mono_to_stereo_16(uint16_t *dest, const uint16_t *src,
+				    size_t n);
+
+/**
+ * Duplicate each 32 bit (or float) mono sample into a stereo frame.
+ */
+size_t
+pcm_channels_simd_mono_to_stereo_32(uint32_t *dest, const uint32_t *src,
+				    size_t n);
+
+/**
+ * Mix 16 bit stereo down to mono: (left + right) / 2, rounded
+ * towards zero.
+ */
+size_t
+pcm_channels_simd_stereo_to_mono_16(int16_t *dest, const int16_t *src,
+				    size_t n);
+
+/**
+ * Like pcm_channels_simd_stereo_to_mono_16(), but for 24 bit samples
+ * in 32 bit integers.  The sum must fit into 32 bit, which is why
+ * there is no such function for #SampleFormat::S32.
+ */
+size_t
+pcm_channels_simd_stereo_to_mono_24(int32_t *dest, const int32_t *src,
+				    size_t n);
+
+size_t
+pcm_channels_simd_stereo_to_mono_float(float *dest, const float *src,
+				       size_t n);
+
+/**
+ * Mix six 16 bit channels (5.1) down to stereo: both output channels
+ * get the average of all six input channels, rounded towards zero.
+ */
+size_t
+pcm_channels_simd_6_to_stereo_16(int16_t *dest, const int16_t *src,
+				 size_t n);
+
+/**
+ * Swap the two channels of 16 bit stereo frames.
+ */
+size_t
+pcm_channels_simd_swap_16(uint16_t *dest, const uint16_t *src, size_t n);
+
+/**
+ * Swap the two channels of 32 bit (or float) stereo frames.
+ */
+size_t
+pcm_channels_simd_swap_32(uint32_t *dest, const uint32_t *src, size_t n);
+
+#endif
@@ -21,11 +21,14 @@
 #include "PcmConvert.hxx"
 #include "Domain.hxx"
 #include "ConfiguredResampler.hxx"
+#include "PcmDsd.hxx"
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "util/ConstBuffer.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
 
 #include <assert.h>
 #include <math.h>
@@ -33,10 +36,13 @@
 bool
 pcm_convert_global_init(Error &error)
 {
+	pcm_dsd_global_init(config_get_positive(CONF_DSD_THREADS, 1));
+
 	return pcm_resampler_global_init(error);
 }
 
-PcmConvert::PcmConvert()
+PcmConvert::PcmConvert(const char *resampler_profile)
+	:resampler(resampler_profile)
 {
 #ifndef NDEBUG
 	src_format.Clear();
@@ -117,6 +123,17 @@ PcmConvert::Close()
 #endif
 }
 
+void
+PcmConvert::Reset()
+{
+	assert(src_format.IsValid());
+
+	if (enable_resampler)
+		resampler.Reset();
+
+	dsd.Reset();
+}
+
 const void *
 PcmConvert::Convert(const void *src, size_t src_size,
 		    size_t *dest_size_r,
@@ -50,7 +50,11 @@ class PcmConvert {
 	bool enable_resampler, enable_format, enable_channels;
 
 public:
-	PcmConvert();
+	/**
+	 * @param resampler_profile the name of a resampler profile,
+	 * see pcm_resampler_create()
+	 */
+	explicit PcmConvert(const char *resampler_profile=nullptr);
 	~PcmConvert();
 
 	/**
@@ -65,6 +69,14 @@ public:
 	 */
 	void Close();
 
+	/**
+	 * Discard all state which depends on previous input (e.g. the
+	 * resampler's history), so the object can be used for a new
+	 * stream with the same formats.  This is much cheaper than
+	 * Close() and Open().
+	 */
+	void Reset();
+
 	/**
 	 * Converts PCM data between two audio formats.
 	 *
@@ -20,20 +20,36 @@
 #include "config.h"
 #include "PcmDsd.hxx"
 #include "dsd2pcm/dsd2pcm.h"
+#include "thread/Name.hxx"
 #include "util/Macros.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
 
 #include <algorithm>
 
 #include <assert.h>
 
+static unsigned pcm_dsd_threads = 1;
+
+void
+pcm_dsd_global_init(unsigned threads)
+{
+	assert(threads > 0);
+
+	pcm_dsd_threads = std::min(threads, unsigned(PcmDsd::MAX_THREADS));
+}
+
 PcmDsd::PcmDsd()
+	:num_workers(0), generation(0), pending(0),
+	 workers_started(false), quit(false)
 {
 	std::fill_n(dsd2pcm, ARRAY_SIZE(dsd2pcm), nullptr);
 }
 
 PcmDsd::~PcmDsd()
 {
+	StopWorkers();
+
 	for (unsigned i = 0; i < ARRAY_SIZE(dsd2pcm); ++i)
 		if (dsd2pcm[i] != nullptr)
 			dsd2pcm_destroy(dsd2pcm[i]);
@@ -47,6 +63,111 @@ PcmDsd::Reset()
 			dsd2pcm_reset(dsd2pcm[i]);
 }
 
+void
+PcmDsd::StartWorkers()
+{
+	assert(!workers_started);
+	assert(num_workers == 0);
+
+	workers_started = true;
+
+	/* no locking needed: there is no job yet */
+
+	const unsigned n = pcm_dsd_threads - 1;
+	while (num_workers < n) {
+		Worker &w = workers[num_workers];
+		w.dsd = this;
+		w.index = num_workers + 1;
+		w.generation = generation;
+
+		Error error;
+		if (!w.thread.Start(WorkerFunc, &w, error))
+			/* continue with the threads we have */
+			break;
+
+		++num_workers;
+	}
+}
+
+void
+PcmDsd::StopWorkers()
+{
+	if (num_workers == 0)
+		return;
+
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < num_workers; ++i)
+		workers[i].thread.Join();
+
+	num_workers = 0;
+}
+
+void
+PcmDsd::Run(const Job &j, unsigned index, unsigned stride)
+{
+	/* units [0..num_quads) are groups of four channels, the
+	   remaining units are single channels */
+	const unsigned num_quads = j.channels / 4;
+	const unsigned num_units = num_quads + j.channels % 4;
+
+	for (unsigned u = index; u < num_units; u += stride) {
+		if (u < num_quads) {
+			const unsigned c = u * 4;
+			dsd2pcm_translate_4(dsd2pcm + c, j.num_frames,
+					    j.src + c, j.channels,
+					    j.lsbfirst, j.dest + c, j.channels);
+		} else {
+			const unsigned c = num_quads * 4 + (u - num_quads);
+			dsd2pcm_translate(dsd2pcm[c], j.num_frames,
+					  j.src + c, j.channels,
+					  j.lsbfirst, j.dest + c, j.channels);
+		}
+	}
+}
+
+inline void
+PcmDsd::WorkerRun(Worker &w)
+{
+	FormatThreadName("dsd%u", w.index);
+
+	mutex.lock();
+
+	while (true) {
+		if (quit)
+			break;
+
+		if (w.generation == generation) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		w.generation = generation;
+		const Job j = job;
+		const unsigned stride = num_workers + 1;
+
+		mutex.unlock();
+		Run(j, w.index, stride);
+		mutex.lock();
+
+		assert(pending > 0);
+		if (--pending == 0)
+			done_cond.signal();
+	}
+
+	mutex.unlock();
+}
+
+void
+PcmDsd::WorkerFunc(void *ctx)
+{
+	Worker &w = *(Worker *)ctx;
+	w.dsd->WorkerRun(w);
+}
+
 ConstBuffer<float>
 PcmDsd::ToFloat(unsigned channels, bool lsbfirst,
 		ConstBuffer<uint8_t> src)
@@ -63,17 +184,39 @@ PcmDsd::ToFloat(unsigned channels, bool lsbfirst,
 	const size_t dest_size = num_samples * sizeof(*dest);
 	dest = (float *)buffer.Get(dest_size);
 
+	/* dsd2pcm_init() is not thread-safe; allocate all contexts
+	   here, before the workers get them */
 	for (unsigned c = 0; c < channels; ++c) {
 		if (dsd2pcm[c] == nullptr) {
 			dsd2pcm[c] = dsd2pcm_init();
 			if (dsd2pcm[c] == nullptr)
 				return nullptr;
 		}
+	}
+
+	const Job j = { src.data, dest, num_frames, channels, lsbfirst };
+
+	if (channels > 1 && pcm_dsd_threads > 1 && !workers_started)
+		StartWorkers();
 
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  lsbfirst, dest + c, channels);
+	if (channels <= 1 || num_workers == 0) {
+		Run(j, 0, 1);
+		return { dest, num_samples };
 	}
 
+	mutex.lock();
+	job = j;
+	pending = num_workers;
+	++generation;
+	cond.broadcast();
+	mutex.unlock();
+
+	Run(j, 0, num_workers + 1);
+
+	mutex.lock();
+	while (pending > 0)
+		done_cond.wait(mutex);
+	mutex.unlock();
+
 	return { dest, num_samples };
 }
@@ -22,19 +22,98 @@
 
 #include "check.h"
 #include "PcmBuffer.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 
 #include <stdint.h>
 
 template<typename T> struct ConstBuffer;
 
+/**
+ * Set the number of threads used to convert multi-channel DSD
+ * streams (see #PcmDsd).  Must be called before the first #PcmDsd
+ * instance is used.
+ */
+void
+pcm_dsd_global_init(unsigned threads);
+
 /**
  * Wrapper for the dsd2pcm library.
+ *
+ * Channels are converted in groups of four with
+ * dsd2pcm_translate_4(); if more than one thread was configured with
+ * pcm_dsd_global_init(), these groups are distributed over worker
+ * threads, which are started on demand.
  */
 class PcmDsd {
+public:
+	static constexpr unsigned MAX_THREADS = 8;
+
+private:
 	PcmBuffer buffer;
 
 	struct dsd2pcm_ctx_s *dsd2pcm[32];
 
+	/**
+	 * One conversion request, handed to the worker threads.
+	 */
+	struct Job {
+		const uint8_t *src;
+		float *dest;
+		unsigned num_frames, channels;
+		bool lsbfirst;
+	};
+
+	struct Worker {
+		Thread thread;
+		PcmDsd *dsd;
+
+		/**
+		 * The index of this worker; 0 is the caller of
+		 * ToFloat().
+		 */
+		unsigned index;
+
+		/**
+		 * The #generation this worker has seen last.
+		 */
+		unsigned generation;
+	};
+
+	Worker workers[MAX_THREADS - 1];
+	unsigned num_workers;
+
+	/**
+	 * Protects #job, #generation, #pending and #quit.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled by ToFloat() when a new #job is available.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled by the last worker which has finished the #job.
+	 */
+	Cond done_cond;
+
+	Job job;
+
+	/**
+	 * Incremented for each new #job.
+	 */
+	unsigned generation;
+
+	/**
+	 * The number of workers which have not yet finished the
+	 * current #job.
+	 */
+	unsigned pending;
+
+	bool workers_started, quit;
+
 public:
 	PcmDsd();
 	~PcmDsd();
@@ -43,6 +122,19 @@ public:
 
 	ConstBuffer<float> ToFloat(unsigned channels, bool lsbfirst,
 				   ConstBuffer<uint8_t> src);
+
+private:
+	void StartWorkers();
+	void StopWorkers();
+
+	/**
+	 * Convert the channel groups which are assigned to the
+	 * specified worker.
+	 */
+	void Run(const Job &j, unsigned index, unsigned stride);
+
+	void WorkerRun(Worker &w);
+	static void WorkerFunc(void *ctx);
 };
 
 #endif
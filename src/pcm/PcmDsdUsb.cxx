@@ -19,70 +19,49 @@
 
 #include "config.h"
 #include "PcmDsdUsb.hxx"
-#include "PcmBuffer.hxx"
+#include "PcmExportSimd.hxx"
 #include "AudioFormat.hxx"
 
 #include <assert.h>
 
 constexpr
 static inline uint32_t
-pcm_two_dsd_to_usb_marker1(uint8_t a, uint8_t b)
+pcm_two_dsd_to_usb(uint8_t marker, uint8_t a, uint8_t b)
 {
-	return 0xff050000 | (a << 8) | b;
+	/* each 24 bit sample has 16 DSD sample bits plus the magic
+	   marker */
+	return 0xff000000 | (marker << 16) | (a << 8) | b;
 }
 
-constexpr
-static inline uint32_t
-pcm_two_dsd_to_usb_marker2(uint8_t a, uint8_t b)
-{
-	return 0xfffa0000 | (a << 8) | b;
-}
-
-
-const uint32_t *
-pcm_dsd_to_usb(PcmBuffer &buffer, unsigned channels,
-	       const uint8_t *src, size_t src_size,
-	       size_t *dest_size_r)
+void
+pcm_dsd_to_usb(uint32_t *dest, unsigned channels,
+	       const uint8_t *src, size_t num_frames,
+	       bool &odd)
 {
 	assert(audio_valid_channel_count(channels));
-	assert(src != NULL);
-	assert(src_size > 0);
-	assert(src_size % channels == 0);
-
-	const unsigned num_src_samples = src_size;
-	const unsigned num_src_frames = num_src_samples / channels;
-
-	/* this rounds down and discards the last odd frame; not
-	   elegant, but good enough for now */
-	const unsigned num_frames = num_src_frames / 2;
-	const unsigned num_samples = num_frames * channels;
-
-	const size_t dest_size = num_samples * 4;
-	*dest_size_r = dest_size;
-	uint32_t *const dest0 = (uint32_t *)buffer.Get(dest_size),
-		*dest = dest0;
-
-	for (unsigned i = num_frames / 2; i > 0; --i) {
-		for (unsigned c = channels; c > 0; --c) {
-			/* each 24 bit sample has 16 DSD sample bits
-			   plus the magic 0x05 marker */
-
-			*dest++ = pcm_two_dsd_to_usb_marker1(src[0], src[channels]);
+	assert(dest != nullptr);
+	assert(src != nullptr);
+
+	if (channels == 2) {
+		const size_t done =
+			pcm_export_simd_dsd_usb_stereo(dest, src,
+						       num_frames, odd);
+		dest += done * 2;
+		src += done * 4;
+		num_frames -= done;
+
+		/* the vectorised kernel handles a multiple of four
+		   frames, which doesn't change the marker */
+		assert(done % 2 == 0);
+	}
 
-			/* seek the source pointer to the next
-			   channel */
-			++src;
-		}
-
-		/* skip the second byte of each channel, because we
-		   have already copied it */
-		src += channels;
+	for (size_t i = num_frames; i > 0; --i) {
+		const uint8_t marker = odd ? 0xfa : 0x05;
+		odd = !odd;
 
 		for (unsigned c = channels; c > 0; --c) {
-			/* each 24 bit sample has 16 DSD sample bits
-			   plus the magic 0xfa marker */
-
-			*dest++ = pcm_two_dsd_to_usb_marker2(src[0], src[channels]);
+			*dest++ = pcm_two_dsd_to_usb(marker, src[0],
+						     src[channels]);
 
 			/* seek the source pointer to the next
 			   channel */
@@ -93,6 +72,4 @@ pcm_dsd_to_usb(PcmBuffer &buffer, unsigned channels,
 		   have already copied it */
 		src += channels;
 	}
-
-	return dest0;
 }
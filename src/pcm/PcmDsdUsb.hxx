@@ -25,17 +25,24 @@
 #include <stdint.h>
 #include <stddef.h>
 
-class PcmBuffer;
-
 /**
  * Pack DSD 1 bit samples into (padded) 24 bit PCM samples for
  * playback over USB, according to the proposed standard by 
  * dCS and others:
  * http://www.sonore.us/DoP_openStandard_1v1.pdf
+ *
+ * Each destination frame contains two source frames.
+ *
+ * @param dest the destination buffer; it must have room for
+ * #num_frames * #channels samples
+ * @param num_frames the number of destination frames
+ * @param odd the marker of the next frame: false for 0x05, true for
+ * 0xfa; it is toggled with each frame, so consecutive calls
+ * continue the sequence
  */
-const uint32_t *
-pcm_dsd_to_usb(PcmBuffer &buffer, unsigned channels,
-	       const uint8_t *src, size_t src_size,
-	       size_t *dest_size_r);
+void
+pcm_dsd_to_usb(uint32_t *dest, unsigned channels,
+	       const uint8_t *src, size_t num_frames,
+	       bool &odd);
 
 #endif
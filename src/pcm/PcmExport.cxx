@@ -19,10 +19,23 @@
 
 #include "config.h"
 #include "PcmExport.hxx"
+#include "PcmExportSimd.hxx"
 #include "PcmDsdUsb.hxx"
 #include "PcmPack.hxx"
+#include "system/ByteOrder.hxx"
 #include "util/ByteReverse.hxx"
 
+#include <algorithm>
+
+#include <string.h>
+
+/**
+ * The number of DSD-over-USB samples which are converted at a time
+ * into a buffer on the stack before being passed to the remaining
+ * export stages.
+ */
+static constexpr size_t DSD_USB_BLOCK_SAMPLES = 1024;
+
 void
 PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		bool _dsd_usb, bool _shift8, bool _pack, bool _reverse_endian)
@@ -71,60 +84,199 @@ PcmExport::GetFrameSize(const AudioFormat &audio_format) const
 	return audio_format.GetFrameSize();
 }
 
-const void *
-PcmExport::Export(const void *data, size_t size, size_t &dest_size_r)
+/**
+ * Pack padded 24 bit samples into the given buffer, with the bytes
+ * of each sample in reverse order.
+ */
+static void
+export_pack24_reverse(uint8_t *dest, const int32_t *src,
+		      const int32_t *src_end)
 {
-	if (dsd_usb)
-		data = pcm_dsd_to_usb(dsd_buffer, channels,
-				      (const uint8_t *)data, size, &size);
+	while (src < src_end) {
+		const uint32_t x = *src++;
 
-	if (pack24) {
-		assert(size % 4 == 0);
+		if (IsLittleEndian()) {
+			dest[0] = x >> 16;
+			dest[1] = x >> 8;
+			dest[2] = x;
+		} else {
+			dest[0] = x;
+			dest[1] = x >> 8;
+			dest[2] = x >> 16;
+		}
 
-		const size_t num_samples = size / 4;
-		const size_t dest_size = num_samples * 3;
+		dest += 3;
+	}
+}
+
+/**
+ * Pack padded 24 bit samples into the given buffer.
+ *
+ * @return the number of bytes written to #dest
+ */
+static size_t
+export_pack24(uint8_t *dest, const void *_src, size_t src_size,
+	      bool reverse)
+{
+	assert(src_size % 4 == 0);
+
+	const int32_t *src = (const int32_t *)_src;
+	const size_t n = src_size / 4;
 
-		const uint8_t *src8 = (const uint8_t *)data;
-		const uint8_t *src_end8 = src8 + size;
-		uint8_t *dest = (uint8_t *)pack_buffer.Get(dest_size);
-		assert(dest != nullptr);
+	const size_t done = IsLittleEndian()
+		? pcm_export_simd_pack24(dest, src, n, reverse)
+		: 0;
 
-		pcm_pack_24(dest, (const int32_t *)src8,
-			    (const int32_t *)src_end8);
+	if (reverse)
+		export_pack24_reverse(dest + done * 3, src + done, src + n);
+	else
+		pcm_pack_24(dest + done * 3, src + done, src + n);
+
+	return n * 3;
+}
 
-		data = dest;
-		size = dest_size;
-	} else if (shift8) {
-		assert(size % 4 == 0);
+/**
+ * Shift padded 24 bit samples left by 8 bits into the given buffer.
+ */
+static void
+export_shift8(uint32_t *dest, const void *_src, size_t src_size,
+	      bool reverse)
+{
+	assert(src_size % 4 == 0);
 
-		const uint8_t *src8 = (const uint8_t *)data;
-		const uint8_t *src_end8 = src8 + size;
-		const uint32_t *src = (const uint32_t *)src8;
-		const uint32_t *const src_end = (const uint32_t *)src_end8;
+	const uint32_t *src = (const uint32_t *)_src;
+	const uint32_t *const src_end = src + src_size / 4;
 
-		uint32_t *dest = (uint32_t *)pack_buffer.Get(size);
-		data = dest;
+	const size_t done =
+		pcm_export_simd_shift8(dest, src, src_size / 4, reverse);
+	dest += done;
+	src += done;
 
+	if (reverse)
+		while (src < src_end)
+			*dest++ = ByteSwap32(*src++ << 8);
+	else
 		while (src < src_end)
 			*dest++ = *src++ << 8;
-	}
+}
 
+static void
+export_reverse(uint8_t *dest, const uint8_t *src, size_t src_size,
+	       unsigned sample_size)
+{
+	size_t done = 0;
+	if (sample_size == 2)
+		done = pcm_export_simd_reverse_16((uint16_t *)dest,
+						  (const uint16_t *)src,
+						  src_size / 2) * 2;
+	else if (sample_size == 4)
+		done = pcm_export_simd_reverse_32((uint32_t *)dest,
+						  (const uint32_t *)src,
+						  src_size / 4) * 4;
+
+	reverse_bytes(dest + done, src + done, src + src_size, sample_size);
+}
+
+size_t
+PcmExport::ExportPcm(uint8_t *dest, const uint8_t *src, size_t size) const
+{
+	if (pack24)
+		return export_pack24(dest, src, size, reverse_endian > 0);
+
+	if (shift8) {
+		export_shift8((uint32_t *)dest, src, size,
+			      reverse_endian > 0);
+		return size;
+	}
 
 	if (reverse_endian > 0) {
 		assert(reverse_endian >= 2);
 
-		uint8_t *dest = (uint8_t *)reverse_buffer.Get(size);
-		assert(dest != nullptr);
+		export_reverse(dest, src, size, reverse_endian);
+		return size;
+	}
 
-		const uint8_t *src = (const uint8_t *)data;
-		const uint8_t *src_end = src + size;
-		reverse_bytes(dest, src, src_end, reverse_endian);
+	memcpy(dest, src, size);
+	return size;
+}
 
-		data = dest;
+size_t
+PcmExport::ExportDsdUsb(uint8_t *dest, const uint8_t *src, size_t size)
+{
+	assert(size % channels == 0);
+
+	/* this rounds down and discards the last odd frame; not
+	   elegant, but good enough for now */
+	size_t num_frames = size / channels / 2;
+
+	/* the markers start over with each call; the caller must
+	   not split pairs of frames (see alsa_mmap_write()) */
+	bool odd = false;
+
+	if (!pack24 && !shift8 && reverse_endian == 0) {
+		pcm_dsd_to_usb((uint32_t *)dest, channels,
+			       src, num_frames, odd);
+		return num_frames * channels * 4;
+	}
+
+	/* convert small blocks which stay in the CPU cache, and
+	   pass each of them to the remaining stages right away */
+
+	uint32_t block[DSD_USB_BLOCK_SAMPLES];
+	const size_t block_frames = DSD_USB_BLOCK_SAMPLES / channels;
+
+	uint8_t *const dest0 = dest;
+	while (num_frames > 0) {
+		const size_t n = std::min(num_frames, block_frames);
+		pcm_dsd_to_usb(block, channels, src, n, odd);
+		src += n * channels * 2;
+		num_frames -= n;
+
+		dest += ExportPcm(dest, (const uint8_t *)block,
+				  n * channels * 4);
+	}
+
+	return dest - dest0;
+}
+
+const void *
+PcmExport::Export(const void *data, size_t size, size_t &dest_size_r)
+{
+	if (!dsd_usb && !pack24 && !shift8 && reverse_endian == 0) {
+		/* nothing to do */
+		dest_size_r = size;
+		return data;
 	}
 
-	dest_size_r = size;
-	return data;
+	void *dest = buffer.Get(CalcDestSize(size));
+	dest_size_r = ExportTo(dest, data, size);
+	return dest;
+}
+
+size_t
+PcmExport::ExportTo(void *dest, const void *data, size_t size)
+{
+	assert(dest != nullptr);
+
+	if (dsd_usb)
+		return ExportDsdUsb((uint8_t *)dest, (const uint8_t *)data,
+				    size);
+
+	return ExportPcm((uint8_t *)dest, (const uint8_t *)data, size);
+}
+
+size_t
+PcmExport::CalcDestSize(size_t size) const
+{
+	if (dsd_usb)
+		/* two DSD bytes per channel become one 32 bit
+		   sample */
+		size = size / channels / 2 * channels * 4;
+
+	if (pack24)
+		size = size / 4 * 3;
+
+	return size;
 }
 
 size_t
@@ -33,26 +33,10 @@ struct AudioFormat;
  */
 struct PcmExport {
 	/**
-	 * The buffer is used to convert DSD samples to the
-	 * DSD-over-USB format.
-	 *
-	 * @see #dsd_usb
-	 */
-	PcmBuffer dsd_buffer;
-
-	/**
-	 * The buffer is used to pack samples, removing padding.
-	 *
-	 * @see #pack24
-	 */
-	PcmBuffer pack_buffer;
-
-	/**
-	 * The buffer is used to reverse the byte order.
-	 *
-	 * @see #reverse_endian
+	 * The destination buffer of Export().  All stages are done
+	 * in one pass, so there is no other intermediate buffer.
 	 */
-	PcmBuffer reverse_buffer;
+	PcmBuffer buffer;
 
 	/**
 	 * The number of channels.
@@ -115,6 +99,19 @@ struct PcmExport {
 	const void *Export(const void *src, size_t src_size,
 			   size_t &dest_size_r);
 
+	/**
+	 * Like Export(), but write the result of the last stage into
+	 * the given buffer instead of an internal one.  This allows
+	 * exporting straight into a memory mapped device buffer.
+	 *
+	 * @param dest the destination buffer, which must be large
+	 * enough for the exported data
+	 * @param src the source PCM buffer
+	 * @param src_size the size of #src in bytes
+	 * @return the number of bytes written to #dest
+	 */
+	size_t ExportTo(void *dest, const void *src, size_t src_size);
+
 	/**
 	 * Converts the number of consumed bytes from the pcm_export()
 	 * destination buffer to the according number of bytes from the
@@ -122,6 +119,24 @@ struct PcmExport {
 	 */
 	gcc_pure
 	size_t CalcSourceSize(size_t dest_size) const;
+
+private:
+	/**
+	 * Calculate the size of the exported data for the given
+	 * source size.
+	 */
+	gcc_pure
+	size_t CalcDestSize(size_t src_size) const;
+
+	/**
+	 * The stages after DSD-over-USB: #pack24 or #shift8, and
+	 * #reverse_endian, fused into one pass.
+	 *
+	 * @return the number of bytes written to #dest
+	 */
+	size_t ExportPcm(uint8_t *dest, const uint8_t *src, size_t size) const;
+
+	size_t ExportDsdUsb(uint8_t *dest, const uint8_t *src, size_t size);
 };
 
 #endif
@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PcmExportSimd.hxx"
+#include "SimdLevel.hxx"
+
+#if defined(PCM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef PCM_SIMD_X86
+
+/*
+ * The pshufb kernels are only used on AVX2 CPUs (AVX2 implies
+ * SSSE3); there is no #SimdLevel for SSSE3 alone.
+ */
+
+/**
+ * Sixteen samples are four vectors which are packed to 12 bytes
+ * each by pshufb and then merged into three full vectors, so no
+ * store writes beyond the packed data.
+ */
+__attribute__((target("ssse3")))
+static size_t
+pcm_pack24_ssse3(uint8_t *dest, const int32_t *src, size_t n, bool reverse)
+{
+	const __m128i mask = reverse
+		? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+				-1, -1, -1, -1)
+		: _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+				-1, -1, -1, -1);
+
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m128i *s = (const __m128i *)(src + i);
+		const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(s), mask);
+		const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(s + 1), mask);
+		const __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(s + 2), mask);
+		const __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(s + 3), mask);
+
+		__m128i *p = (__m128i *)(dest + i * 3);
+		_mm_storeu_si128(p, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+		_mm_storeu_si128(p + 1, _mm_or_si128(_mm_srli_si128(b, 4),
+						     _mm_slli_si128(c, 8)));
+		_mm_storeu_si128(p + 2, _mm_or_si128(_mm_srli_si128(c, 8),
+						     _mm_slli_si128(d, 4)));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+pcm_bswap_sse2_16(__m128i x)
+{
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+pcm_bswap_sse2_32(__m128i x)
+{
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+	x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+	return pcm_bswap_sse2_16(x);
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_shift8_sse2(uint32_t *dest, const uint32_t *src, size_t n, bool reverse)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		x = _mm_slli_epi32(x, 8);
+		if (reverse)
+			x = pcm_bswap_sse2_32(x);
+		_mm_storeu_si128((__m128i *)(dest + i), x);
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_reverse_sse2_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i), pcm_bswap_sse2_16(x));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_reverse_sse2_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i), pcm_bswap_sse2_32(x));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+pcm_bswap_mask_avx2_32()
+{
+	return _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+				11, 10, 9, 8, 15, 14, 13, 12,
+				3, 2, 1, 0, 7, 6, 5, 4,
+				11, 10, 9, 8, 15, 14, 13, 12);
+}
+
+__attribute__((target("avx2")))
+static size_t
+pcm_shift8_avx2(uint32_t *dest, const uint32_t *src, size_t n, bool reverse)
+{
+	const __m256i mask = pcm_bswap_mask_avx2_32();
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		x = _mm256_slli_epi32(x, 8);
+		if (reverse)
+			x = _mm256_shuffle_epi8(x, mask);
+		_mm256_storeu_si256((__m256i *)(dest + i), x);
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+pcm_reverse_avx2_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	const __m256i mask =
+		_mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+				 9, 8, 11, 10, 13, 12, 15, 14,
+				 1, 0, 3, 2, 5, 4, 7, 6,
+				 9, 8, 11, 10, 13, 12, 15, 14);
+
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_shuffle_epi8(x, mask));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+pcm_reverse_avx2_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	const __m256i mask = pcm_bswap_mask_avx2_32();
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_shuffle_epi8(x, mask));
+	}
+
+	return i;
+}
+
+/**
+ * Sixteen DSD bytes (eight stereo source frames) become four
+ * DSD-over-USB frames.  pshufb moves each pair of DSD bytes of a
+ * channel into the two low bytes of a 32 bit word (the second one
+ * being the least significant), and the markers are or'ed into the
+ * two high bytes.
+ */
+__attribute__((target("ssse3")))
+static size_t
+pcm_dsd_usb_stereo_ssse3(uint32_t *dest, const uint8_t *src,
+			 size_t n, bool odd)
+{
+	const __m128i lo_mask =
+		_mm_setr_epi8(2, 0, -1, -1, 3, 1, -1, -1,
+			      6, 4, -1, -1, 7, 5, -1, -1);
+	const __m128i hi_mask =
+		_mm_setr_epi8(10, 8, -1, -1, 11, 9, -1, -1,
+			      14, 12, -1, -1, 15, 13, -1, -1);
+
+	const int marker1 = int(0xff050000), marker2 = int(0xfffa0000);
+	const __m128i markers = odd
+		? _mm_setr_epi32(marker2, marker2, marker1, marker1)
+		: _mm_setr_epi32(marker1, marker1, marker2, marker2);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(src + i * 4));
+		_mm_storeu_si128((__m128i *)(dest + i * 2),
+				 _mm_or_si128(_mm_shuffle_epi8(x, lo_mask),
+					      markers));
+		_mm_storeu_si128((__m128i *)(dest + i * 2 + 4),
+				 _mm_or_si128(_mm_shuffle_epi8(x, hi_mask),
+					      markers));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef PCM_SIMD_NEON
+
+/**
+ * vld4q deinterleaves the four bytes of each sample into separate
+ * registers, and vst3q writes back only the three low ones.
+ */
+static size_t
+pcm_pack24_neon(uint8_t *dest, const int32_t *src, size_t n, bool reverse)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const uint8x16x4_t v = vld4q_u8((const uint8_t *)(src + i));
+		uint8x16x3_t o;
+		if (reverse) {
+			o.val[0] = v.val[2];
+			o.val[1] = v.val[1];
+			o.val[2] = v.val[0];
+		} else {
+			o.val[0] = v.val[0];
+			o.val[1] = v.val[1];
+			o.val[2] = v.val[2];
+		}
+
+		vst3q_u8(dest + i * 3, o);
+	}
+
+	return i;
+}
+
+static size_t
+pcm_shift8_neon(uint32_t *dest, const uint32_t *src, size_t n, bool reverse)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		uint32x4_t x = vshlq_n_u32(vld1q_u32(src + i), 8);
+		if (reverse)
+			x = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(x)));
+		vst1q_u32(dest + i, x);
+	}
+
+	return i;
+}
+
+static size_t
+pcm_reverse_neon_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const uint8x16_t x = vreinterpretq_u8_u16(vld1q_u16(src + i));
+		vst1q_u16(dest + i, vreinterpretq_u16_u8(vrev16q_u8(x)));
+	}
+
+	return i;
+}
+
+static size_t
+pcm_reverse_neon_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const uint8x16_t x = vreinterpretq_u8_u32(vld1q_u32(src + i));
+		vst1q_u32(dest + i, vreinterpretq_u32_u8(vrev32q_u8(x)));
+	}
+
+	return i;
+}
+
+/**
+ * Each DSD-over-USB sample is written as two 16 bit words: the two
+ * DSD bytes (zipped from the deinterleaved source) and the marker.
+ * vst4q interleaves them with the other channel.
+ */
+static size_t
+pcm_dsd_usb_stereo_neon(uint32_t *dest, const uint8_t *src,
+			size_t n, bool odd)
+{
+	static const uint16_t marker_table[9] = {
+		0xff05, 0xfffa, 0xff05, 0xfffa,
+		0xff05, 0xfffa, 0xff05, 0xfffa,
+		0xff05,
+	};
+
+	const uint16x8_t markers = vld1q_u16(marker_table + odd);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const uint8x8x4_t v = vld4_u8(src + i * 4);
+		const uint8x8x2_t l = vzip_u8(v.val[2], v.val[0]);
+		const uint8x8x2_t r = vzip_u8(v.val[3], v.val[1]);
+
+		uint16x8x4_t o;
+		o.val[0] = vreinterpretq_u16_u8(vcombine_u8(l.val[0], l.val[1]));
+		o.val[1] = markers;
+		o.val[2] = vreinterpretq_u16_u8(vcombine_u8(r.val[0], r.val[1]));
+		o.val[3] = markers;
+		vst4q_u16((uint16_t *)(dest + i * 2), o);
+	}
+
+	return i;
+}
+
+#endif
+
+size_t
+pcm_export_simd_pack24(uint8_t *dest, const int32_t *src, size_t n,
+		       bool reverse)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_pack24_ssse3(dest, src, n, reverse);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_pack24_neon(dest, src, n, reverse);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_export_simd_shift8(uint32_t *dest, const uint32_t *src, size_t n,
+		       bool reverse)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_shift8_avx2(dest, src, n, reverse);
+
+	case SimdLevel::SSE2:
+		return pcm_shift8_sse2(dest, src, n, reverse);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_shift8_neon(dest, src, n, reverse);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_export_simd_reverse_16(uint16_t *dest, const uint16_t *src, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_reverse_avx2_16(dest, src, n);
+
+	case SimdLevel::SSE2:
+		return pcm_reverse_sse2_16(dest, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_reverse_neon_16(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_export_simd_reverse_32(uint32_t *dest, const uint32_t *src, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_reverse_avx2_32(dest, src, n);
+
+	case SimdLevel::SSE2:
+		return pcm_reverse_sse2_32(dest, src, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_reverse_neon_32(dest, src, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_export_simd_dsd_usb_stereo(uint32_t *dest, const uint8_t *src,
+			       size_t n, bool odd)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_dsd_usb_stereo_ssse3(dest, src, n, odd);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_dsd_usb_stereo_neon(dest, src, n, odd);
+#endif
+
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_EXPORT_SIMD_HXX
+#define MPD_PCM_EXPORT_SIMD_HXX
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorised kernels for PcmExport.  Like the other *Simd.hxx
+ * kernels, the instruction set is chosen at runtime, each function
+ * processes a multiple of the vector width and returns the number
+ * of samples (or frames) it has processed, leaving the tail to the
+ * scalar code.  They assume a little-endian host.
+ */
+
+/**
+ * Pack 24 bit samples (padded to 32 bit) into 3 bytes each.
+ *
+ * @param reverse reverse the byte order of each packed sample
+ */
+size_t
+pcm_export_simd_pack24(uint8_t *dest, const int32_t *src, size_t n,
+		       bool reverse);
+
+/**
+ * Shift padded 24 bit samples left by 8 bits.
+ *
+ * @param reverse reverse the byte order of each shifted sample
+ */
+size_t
+pcm_export_simd_shift8(uint32_t *dest, const uint32_t *src, size_t n,
+		       bool reverse);
+
+size_t
+pcm_export_simd_reverse_16(uint16_t *dest, const uint16_t *src, size_t n);
+
+size_t
+pcm_export_simd_reverse_32(uint32_t *dest, const uint32_t *src, size_t n);
+
+/**
+ * Convert stereo DSD to DSD-over-USB, see pcm_dsd_to_usb().
+ *
+ * @param n the number of destination frames; #src contains twice
+ * as many frames
+ * @param odd true if the first destination frame gets the 0xfa
+ * marker instead of 0x05
+ * @return the number of destination frames
+ */
+size_t
+pcm_export_simd_dsd_usb_stereo(uint32_t *dest, const uint8_t *src,
+			       size_t n, bool odd);
+
+#endif
@@ -24,6 +24,7 @@
 #include "Traits.hxx"
 #include "FloatConvert.hxx"
 #include "ShiftConvert.hxx"
+#include "PcmFormatSimd.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
@@ -45,6 +46,27 @@ struct PerSampleConvert : C {
 	}
 };
 
+/**
+ * Wrapper which lets a kernel from PcmFormatSimd.hxx convert as much
+ * as it can, and converts the remaining tail with the portable
+ * implementation.
+ */
+template<typename Portable,
+	 size_t (*simd)(typename Portable::DstTraits::pointer_type out,
+			typename Portable::SrcTraits::const_pointer_type in,
+			size_t n)>
+struct SimdConvert : Portable {
+	typedef typename Portable::SrcTraits SrcTraits;
+	typedef typename Portable::DstTraits DstTraits;
+
+	void Convert(typename DstTraits::pointer_type gcc_restrict out,
+		     typename SrcTraits::const_pointer_type gcc_restrict in,
+		     size_t n) const {
+		const size_t done = simd(out, in, n);
+		Portable::Convert(out + done, in + done, n - done);
+	}
+};
+
 struct Convert8To16
 	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S8,
 						  SampleFormat::S16>> {};
@@ -114,8 +136,26 @@ struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
 	: GlueOptimizedConvert<NeonFloatTo16,
 			       PortableFloatToInteger<SampleFormat::S16>> {};
 
+#else
+
+template<>
+struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: SimdConvert<PortableFloatToInteger<SampleFormat::S16>,
+		      pcm_simd_float_to_16> {};
+
 #endif
 
+template<>
+struct FloatToInteger<SampleFormat::S24_P32,
+		      SampleTraits<SampleFormat::S24_P32>>
+	: SimdConvert<PortableFloatToInteger<SampleFormat::S24_P32>,
+		      pcm_simd_float_to_24> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: SimdConvert<PortableFloatToInteger<SampleFormat::S32>,
+		      pcm_simd_float_to_32> {};
+
 template<class C>
 static ConstBuffer<typename C::DstTraits::value_type>
 AllocateConvert(PcmBuffer &buffer, C convert,
@@ -196,8 +236,9 @@ struct Convert8To24
 						  SampleFormat::S24_P32>> {};
 
 struct Convert16To24
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S24_P32>> {};
+	: SimdConvert<PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
+							      SampleFormat::S24_P32>>,
+		      pcm_simd_16_to_24> {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_24(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -212,8 +253,9 @@ pcm_allocate_16_to_24(PcmBuffer &buffer, ConstBuffer<int16_t> src)
 }
 
 struct Convert32To24
-	: PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
-						   SampleFormat::S24_P32>> {};
+	: SimdConvert<PerSampleConvert<RightShiftSampleConvert<SampleFormat::S32,
+							       SampleFormat::S24_P32>>,
+		      pcm_simd_32_to_24> {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_32_to_24(PcmBuffer &buffer, ConstBuffer<int32_t> src)
@@ -264,12 +306,14 @@ struct Convert8To32
 						  SampleFormat::S32>> {};
 
 struct Convert16To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
-						  SampleFormat::S32>> {};
+	: SimdConvert<PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S16,
+							      SampleFormat::S32>>,
+		      pcm_simd_16_to_32> {};
 
 struct Convert24To32
-	: PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
-						  SampleFormat::S32>> {};
+	: SimdConvert<PerSampleConvert<LeftShiftSampleConvert<SampleFormat::S24_P32,
+							      SampleFormat::S32>>,
+		      pcm_simd_24_to_32> {};
 
 static ConstBuffer<int32_t>
 pcm_allocate_8_to_32(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -331,13 +375,16 @@ struct Convert8ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
 
 struct Convert16ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
+	: SimdConvert<PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>>,
+		      pcm_simd_16_to_float> {};
 
 struct Convert24ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
+	: SimdConvert<PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>>,
+		      pcm_simd_24_to_float> {};
 
 struct Convert32ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
+	: SimdConvert<PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>>,
+		      pcm_simd_32_to_float> {};
 
 static ConstBuffer<float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
@@ -0,0 +1,600 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PcmFormatSimd.hxx"
+#include "SimdLevel.hxx"
+
+#if defined(PCM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+/* the factors of IntegerToFloatSampleConvert and
+   FloatToIntegerSampleConvert; all of them are powers of two, so the
+   multiplication is exact */
+static constexpr float FACTOR_FROM_16 = 1.0 / (1 << 15);
+static constexpr float FACTOR_FROM_24 = 1.0 / (1 << 23);
+static constexpr float FACTOR_FROM_32 = 1.0 / (1u << 31);
+static constexpr float FACTOR_TO_16 = 1 << 15;
+static constexpr float FACTOR_TO_24 = 1 << 23;
+static constexpr float FACTOR_TO_32 = 1u << 31;
+
+#ifdef PCM_SIMD_X86
+
+/**
+ * Sign-extend the lower/upper four 16 bit samples to 32 bit.
+ */
+__attribute__((target("sse2")))
+static inline __m128i
+sse2_widen_lo(__m128i x)
+{
+	return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+sse2_widen_hi(__m128i x)
+{
+	return _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_16_to_24(int32_t *out, const int16_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_si128((__m128i *)(out + i),
+				 _mm_slli_epi32(sse2_widen_lo(x), 8));
+		_mm_storeu_si128((__m128i *)(out + i + 4),
+				 _mm_slli_epi32(sse2_widen_hi(x), 8));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_16_to_32(int32_t *out, const int16_t *in, size_t n)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_si128((__m128i *)(out + i),
+				 _mm_unpacklo_epi16(zero, x));
+		_mm_storeu_si128((__m128i *)(out + i + 4),
+				 _mm_unpackhi_epi16(zero, x));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_24_to_32(int32_t *out, const int32_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_slli_epi32(x, 8));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_32_to_24(int32_t *out, const int32_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_srai_epi32(x, 8));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_16_to_float(float *out, const int16_t *in, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FACTOR_FROM_16);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_ps(out + i,
+			      _mm_mul_ps(_mm_cvtepi32_ps(sse2_widen_lo(x)),
+					 factor));
+		_mm_storeu_ps(out + i + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(sse2_widen_hi(x)),
+					 factor));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_32bit_to_float(float *out, const int32_t *in, size_t n, float _factor)
+{
+	const __m128 factor = _mm_set1_ps(_factor);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(x), factor));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_24_to_float(float *out, const int32_t *in, size_t n)
+{
+	return sse2_32bit_to_float(out, in, n, FACTOR_FROM_24);
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_32_to_float(float *out, const int32_t *in, size_t n)
+{
+	return sse2_32bit_to_float(out, in, n, FACTOR_FROM_32);
+}
+
+/**
+ * The portable code truncates to 32 bit and then clamps; cvttps does
+ * the former, and packs the latter.
+ */
+__attribute__((target("sse2")))
+static size_t
+sse2_float_to_16(int16_t *out, const float *in, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FACTOR_TO_16);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i a =
+			_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i),
+						    factor));
+		const __m128i b =
+			_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4),
+						    factor));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+	}
+
+	return i;
+}
+
+/**
+ * Clamp in the floating point domain before truncating; since both
+ * limits are integers, this is equivalent to clamping afterwards.
+ * maxps returns its second operand for NaN, which maps NaN to the
+ * minimum, just like the portable code.
+ */
+__attribute__((target("sse2")))
+static size_t
+sse2_float_to_24(int32_t *out, const float *in, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FACTOR_TO_24);
+	const __m128 min = _mm_set1_ps(-0x800000);
+	const __m128 max = _mm_set1_ps(0x7fffff);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(in + i), factor);
+		x = _mm_min_ps(_mm_max_ps(x, min), max);
+		_mm_storeu_si128((__m128i *)(out + i), _mm_cvttps_epi32(x));
+	}
+
+	return i;
+}
+
+/**
+ * INT32_MAX cannot be represented as float; cvttps returns INT32_MIN
+ * for all values out of range, which is correct for negative values
+ * only, so positive overflows are fixed up with a mask.
+ */
+__attribute__((target("sse2")))
+static size_t
+sse2_float_to_32(int32_t *out, const float *in, size_t n)
+{
+	const __m128 factor = _mm_set1_ps(FACTOR_TO_32);
+	const __m128 min = _mm_set1_ps(-FACTOR_TO_32);
+	const __m128 limit = _mm_set1_ps(FACTOR_TO_32);
+	const __m128i max = _mm_set1_epi32(INT32_MAX);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(in + i), factor);
+		x = _mm_max_ps(x, min);
+
+		const __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(x, limit));
+		const __m128i y = _mm_cvttps_epi32(x);
+		_mm_storeu_si128((__m128i *)(out + i),
+				 _mm_or_si128(_mm_andnot_si128(overflow, y),
+					      _mm_and_si128(overflow, max)));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_16_to_24(int32_t *out, const int16_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i)));
+		_mm256_storeu_si256((__m256i *)(out + i),
+				    _mm256_slli_epi32(x, 8));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_16_to_32(int32_t *out, const int16_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i)));
+		_mm256_storeu_si256((__m256i *)(out + i),
+				    _mm256_slli_epi32(x, 16));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_24_to_32(int32_t *out, const int32_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+		_mm256_storeu_si256((__m256i *)(out + i),
+				    _mm256_slli_epi32(x, 8));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_32_to_24(int32_t *out, const int32_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+		_mm256_storeu_si256((__m256i *)(out + i),
+				    _mm256_srai_epi32(x, 8));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_16_to_float(float *out, const int16_t *in, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FACTOR_FROM_16);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x =
+			_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i)));
+		_mm256_storeu_ps(out + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(x), factor));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_32bit_to_float(float *out, const int32_t *in, size_t n, float _factor)
+{
+	const __m256 factor = _mm256_set1_ps(_factor);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+		_mm256_storeu_ps(out + i,
+				 _mm256_mul_ps(_mm256_cvtepi32_ps(x), factor));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_24_to_float(float *out, const int32_t *in, size_t n)
+{
+	return avx2_32bit_to_float(out, in, n, FACTOR_FROM_24);
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_32_to_float(float *out, const int32_t *in, size_t n)
+{
+	return avx2_32bit_to_float(out, in, n, FACTOR_FROM_32);
+}
+
+/**
+ * packs operates within each 128 bit lane; the permutation restores
+ * the sample order.
+ */
+__attribute__((target("avx2")))
+static size_t
+avx2_float_to_16(int16_t *out, const float *in, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FACTOR_TO_16);
+
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i a =
+			_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(in + i),
+							  factor));
+		const __m256i b =
+			_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8),
+							  factor));
+		const __m256i packed =
+			_mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+						 _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *)(out + i), packed);
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_float_to_24(int32_t *out, const float *in, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FACTOR_TO_24);
+	const __m256 min = _mm256_set1_ps(-0x800000);
+	const __m256 max = _mm256_set1_ps(0x7fffff);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 x = _mm256_mul_ps(_mm256_loadu_ps(in + i), factor);
+		x = _mm256_min_ps(_mm256_max_ps(x, min), max);
+		_mm256_storeu_si256((__m256i *)(out + i),
+				    _mm256_cvttps_epi32(x));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_float_to_32(int32_t *out, const float *in, size_t n)
+{
+	const __m256 factor = _mm256_set1_ps(FACTOR_TO_32);
+	const __m256 min = _mm256_set1_ps(-FACTOR_TO_32);
+	const __m256 limit = _mm256_set1_ps(FACTOR_TO_32);
+	const __m256i max = _mm256_set1_epi32(INT32_MAX);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 x = _mm256_mul_ps(_mm256_loadu_ps(in + i), factor);
+		x = _mm256_max_ps(x, min);
+
+		const __m256i overflow =
+			_mm256_castps_si256(_mm256_cmp_ps(x, limit, _CMP_GE_OQ));
+		_mm256_storeu_si256((__m256i *)(out + i),
+				    _mm256_blendv_epi8(_mm256_cvttps_epi32(x),
+						       max, overflow));
+	}
+
+	return i;
+}
+
+#define PCM_SIMD_DISPATCH(name, D, S) \
+size_t \
+pcm_simd_##name(D *out, const S *in, size_t n) \
+{ \
+	switch (GetSimdLevel()) { \
+	case SimdLevel::AVX2: \
+		return avx2_##name(out, in, n); \
+	case SimdLevel::SSE2: \
+		return sse2_##name(out, in, n); \
+	default: \
+		return 0; \
+	} \
+}
+
+#elif defined(PCM_SIMD_NEON)
+
+static size_t
+neon_16_to_24(int32_t *out, const int16_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t x = vld1q_s16(in + i);
+		vst1q_s32(out + i, vshll_n_s16(vget_low_s16(x), 8));
+		vst1q_s32(out + i + 4, vshll_n_s16(vget_high_s16(x), 8));
+	}
+
+	return i;
+}
+
+static size_t
+neon_16_to_32(int32_t *out, const int16_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t x = vld1q_s16(in + i);
+		vst1q_s32(out + i, vshll_n_s16(vget_low_s16(x), 16));
+		vst1q_s32(out + i + 4, vshll_n_s16(vget_high_s16(x), 16));
+	}
+
+	return i;
+}
+
+static size_t
+neon_24_to_32(int32_t *out, const int32_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_s32(out + i, vshlq_n_s32(vld1q_s32(in + i), 8));
+
+	return i;
+}
+
+static size_t
+neon_32_to_24(int32_t *out, const int32_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_s32(out + i, vshrq_n_s32(vld1q_s32(in + i), 8));
+
+	return i;
+}
+
+static size_t
+neon_16_to_float(float *out, const int16_t *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t x = vld1q_s16(in + i);
+		vst1q_f32(out + i,
+			  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))),
+				      FACTOR_FROM_16));
+		vst1q_f32(out + i + 4,
+			  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))),
+				      FACTOR_FROM_16));
+	}
+
+	return i;
+}
+
+static size_t
+neon_32bit_to_float(float *out, const int32_t *in, size_t n, float factor)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(out + i,
+			  vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)),
+				      factor));
+
+	return i;
+}
+
+static size_t
+neon_24_to_float(float *out, const int32_t *in, size_t n)
+{
+	return neon_32bit_to_float(out, in, n, FACTOR_FROM_24);
+}
+
+static size_t
+neon_32_to_float(float *out, const int32_t *in, size_t n)
+{
+	return neon_32bit_to_float(out, in, n, FACTOR_FROM_32);
+}
+
+/* the ARM conversion instructions saturate (and map NaN to zero),
+   just like the scalar conversions used by the portable code */
+
+static size_t
+neon_float_to_16(int16_t *out, const float *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int32x4_t a =
+			vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(in + i),
+						  FACTOR_TO_16));
+		const int32x4_t b =
+			vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(in + i + 4),
+						  FACTOR_TO_16));
+		vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+
+	return i;
+}
+
+static size_t
+neon_float_to_24(int32_t *out, const float *in, size_t n)
+{
+	const int32x4_t min = vdupq_n_s32(-0x800000);
+	const int32x4_t max = vdupq_n_s32(0x7fffff);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int32x4_t x =
+			vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(in + i),
+						  FACTOR_TO_24));
+		vst1q_s32(out + i, vminq_s32(vmaxq_s32(x, min), max));
+	}
+
+	return i;
+}
+
+static size_t
+neon_float_to_32(int32_t *out, const float *in, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_s32(out + i,
+			  vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(in + i),
+						    FACTOR_TO_32)));
+
+	return i;
+}
+
+#define PCM_SIMD_DISPATCH(name, D, S) \
+size_t \
+pcm_simd_##name(D *out, const S *in, size_t n) \
+{ \
+	return neon_##name(out, in, n); \
+}
+
+#else
+
+#define PCM_SIMD_DISPATCH(name, D, S) \
+size_t \
+pcm_simd_##name(gcc_unused D *out, gcc_unused const S *in, \
+		gcc_unused size_t n) \
+{ \
+	return 0; \
+}
+
+#endif
+
+PCM_SIMD_DISPATCH(16_to_24, int32_t, int16_t)
+PCM_SIMD_DISPATCH(16_to_32, int32_t, int16_t)
+PCM_SIMD_DISPATCH(24_to_32, int32_t, int32_t)
+PCM_SIMD_DISPATCH(32_to_24, int32_t, int32_t)
+PCM_SIMD_DISPATCH(16_to_float, float, int16_t)
+PCM_SIMD_DISPATCH(24_to_float, float, int32_t)
+PCM_SIMD_DISPATCH(32_to_float, float, int32_t)
+PCM_SIMD_DISPATCH(float_to_16, int16_t, float)
+PCM_SIMD_DISPATCH(float_to_24, int32_t, float)
+PCM_SIMD_DISPATCH(float_to_32, int32_t, float)
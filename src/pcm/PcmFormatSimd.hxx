@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_FORMAT_SIMD_HXX
+#define MPD_PCM_FORMAT_SIMD_HXX
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorised sample format conversion kernels for PcmFormat.cxx.
+ * Like the ones in VolumeSimd.hxx, the instruction set is chosen at
+ * runtime according to GetSimdLevel(), and each function returns the
+ * number of samples it has processed; the caller converts the
+ * remaining tail with the portable implementation.  The results are
+ * bit-exact with the portable implementation.
+ */
+
+size_t
+pcm_simd_16_to_24(int32_t *out, const int16_t *in, size_t n);
+
+size_t
+pcm_simd_16_to_32(int32_t *out, const int16_t *in, size_t n);
+
+size_t
+pcm_simd_24_to_32(int32_t *out, const int32_t *in, size_t n);
+
+size_t
+pcm_simd_32_to_24(int32_t *out, const int32_t *in, size_t n);
+
+size_t
+pcm_simd_16_to_float(float *out, const int16_t *in, size_t n);
+
+size_t
+pcm_simd_24_to_float(float *out, const int32_t *in, size_t n);
+
+size_t
+pcm_simd_32_to_float(float *out, const int32_t *in, size_t n);
+
+size_t
+pcm_simd_float_to_16(int16_t *out, const float *in, size_t n);
+
+size_t
+pcm_simd_float_to_24(int32_t *out, const float *in, size_t n);
+
+size_t
+pcm_simd_float_to_32(int32_t *out, const float *in, size_t n);
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "PcmMix.hxx"
+#include "PcmMixSimd.hxx"
 #include "Volume.hxx"
 #include "PcmUtils.hxx"
 #include "AudioFormat.hxx"
@@ -75,6 +76,13 @@ static void
 pcm_add_vol_float(float *buffer1, const float *buffer2,
 		  unsigned num_samples, float volume1, float volume2)
 {
+	const size_t done = pcm_add_vol_simd_float(buffer1, buffer2,
+						   num_samples,
+						   volume1, volume2);
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -163,9 +171,36 @@ PcmAddVoid(void *a, const void *b, size_t size)
 			  size / sample_size);
 }
 
+/**
+ * Let the SIMD kernel process as much as possible, and finish the
+ * tail with the generic implementation.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+PcmAddSimdVoid(size_t (*simd)(typename Traits::pointer_type a,
+			      typename Traits::const_pointer_type b,
+			      size_t n),
+	       void *_a, const void *_b, size_t size)
+{
+	constexpr size_t sample_size = Traits::SAMPLE_SIZE;
+	assert(size % sample_size == 0);
+
+	const auto a = typename Traits::pointer_type(_a);
+	const auto b = typename Traits::const_pointer_type(_b);
+	const size_t n = size / sample_size;
+
+	const size_t done = simd(a, b, n);
+	PcmAdd<F, Traits>(a + done, b + done, n - done);
+}
+
 static void
 pcm_add_float(float *buffer1, const float *buffer2, unsigned num_samples)
 {
+	const size_t done = pcm_add_simd_float(buffer1, buffer2, num_samples);
+	buffer1 += done;
+	buffer2 += done;
+	num_samples -= done;
+
 	while (num_samples > 0) {
 		float sample1 = *buffer1;
 		float sample2 = *buffer2++;
@@ -189,15 +224,18 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
+		PcmAddSimdVoid<SampleFormat::S16>(pcm_add_simd_16,
+						  buffer1, buffer2, size);
 		return true;
 
 	case SampleFormat::S24_P32:
-		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size);
+		PcmAddSimdVoid<SampleFormat::S24_P32>(pcm_add_simd_24,
+						      buffer1, buffer2, size);
 		return true;
 
 	case SampleFormat::S32:
-		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size);
+		PcmAddSimdVoid<SampleFormat::S32>(pcm_add_simd_32,
+						  buffer1, buffer2, size);
 		return true;
 
 	case SampleFormat::FLOAT:
@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PcmMixSimd.hxx"
+#include "SimdLevel.hxx"
+
+#if defined(PCM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+static constexpr int32_t S24_MIN = -0x800000, S24_MAX = 0x7fffff;
+
+#ifdef PCM_SIMD_X86
+
+__attribute__((target("sse2")))
+static size_t
+pcm_add_sse2_16(int16_t *a, const int16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i *p = (__m128i *)(a + i);
+		const __m128i x = _mm_loadu_si128(p);
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		_mm_storeu_si128(p, _mm_adds_epi16(x, y));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+pcm_add_avx2_16(int16_t *a, const int16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i *p = (__m256i *)(a + i);
+		const __m256i x = _mm256_loadu_si256(p);
+		const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		_mm256_storeu_si256(p, _mm256_adds_epi16(x, y));
+	}
+
+	return i;
+}
+
+/**
+ * SSE2 has no 32 bit min/max; emulate it with compare and mask.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_add_sse2_24(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m128i min = _mm_set1_epi32(S24_MIN);
+	const __m128i max = _mm_set1_epi32(S24_MAX);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i *p = (__m128i *)(a + i);
+		__m128i x = _mm_add_epi32(_mm_loadu_si128(p),
+					  _mm_loadu_si128((const __m128i *)(b + i)));
+
+		__m128i mask = _mm_cmpgt_epi32(x, max);
+		x = _mm_or_si128(_mm_andnot_si128(mask, x),
+				 _mm_and_si128(mask, max));
+		mask = _mm_cmplt_epi32(x, min);
+		x = _mm_or_si128(_mm_andnot_si128(mask, x),
+				 _mm_and_si128(mask, min));
+
+		_mm_storeu_si128(p, x);
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+pcm_add_avx2_24(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m256i min = _mm256_set1_epi32(S24_MIN);
+	const __m256i max = _mm256_set1_epi32(S24_MAX);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i *p = (__m256i *)(a + i);
+		__m256i x = _mm256_add_epi32(_mm256_loadu_si256(p),
+					     _mm256_loadu_si256((const __m256i *)(b + i)));
+		x = _mm256_min_epi32(_mm256_max_epi32(x, min), max);
+		_mm256_storeu_si256(p, x);
+	}
+
+	return i;
+}
+
+/**
+ * Saturating 32 bit addition: an overflow has occurred if both
+ * operands have the same sign, and the sum has a different one; in
+ * that case, the result is INT32_MIN or INT32_MAX, depending on the
+ * sign of the operands.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_add_sse2_32(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m128i max = _mm_set1_epi32(INT32_MAX);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i *p = (__m128i *)(a + i);
+		const __m128i x = _mm_loadu_si128(p);
+		const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		const __m128i sum = _mm_add_epi32(x, y);
+
+		const __m128i overflow =
+			_mm_srai_epi32(_mm_andnot_si128(_mm_xor_si128(x, y),
+							_mm_xor_si128(x, sum)),
+				       31);
+		/* INT32_MAX for positive x, INT32_MIN for negative x */
+		const __m128i saturated =
+			_mm_xor_si128(max, _mm_srai_epi32(x, 31));
+
+		_mm_storeu_si128(p, _mm_or_si128(_mm_andnot_si128(overflow, sum),
+						 _mm_and_si128(overflow, saturated)));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+pcm_add_avx2_32(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m256i max = _mm256_set1_epi32(INT32_MAX);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i *p = (__m256i *)(a + i);
+		const __m256i x = _mm256_loadu_si256(p);
+		const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		const __m256i sum = _mm256_add_epi32(x, y);
+
+		const __m256i overflow =
+			_mm256_srai_epi32(_mm256_andnot_si256(_mm256_xor_si256(x, y),
+							      _mm256_xor_si256(x, sum)),
+					  31);
+		const __m256i saturated =
+			_mm256_xor_si256(max, _mm256_srai_epi32(x, 31));
+
+		_mm256_storeu_si256(p, _mm256_blendv_epi8(sum, saturated,
+							  overflow));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_add_sse_float(float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(a + i, _mm_add_ps(_mm_loadu_ps(a + i),
+						_mm_loadu_ps(b + i)));
+
+	return i;
+}
+
+__attribute__((target("avx")))
+static size_t
+pcm_add_avx_float(float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i, _mm256_add_ps(_mm256_loadu_ps(a + i),
+						      _mm256_loadu_ps(b + i)));
+
+	return i;
+}
+
+/* no FMA here: the scalar code rounds after each multiplication */
+
+__attribute__((target("sse2")))
+static size_t
+pcm_add_vol_sse_float(float *a, const float *b, size_t n,
+		      float volume1, float volume2)
+{
+	const __m128 v1 = _mm_set1_ps(volume1), v2 = _mm_set1_ps(volume2);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(a + i,
+			      _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), v1),
+					 _mm_mul_ps(_mm_loadu_ps(b + i), v2)));
+
+	return i;
+}
+
+__attribute__((target("avx")))
+static size_t
+pcm_add_vol_avx_float(float *a, const float *b, size_t n,
+		      float volume1, float volume2)
+{
+	const __m256 v1 = _mm256_set1_ps(volume1), v2 = _mm256_set1_ps(volume2);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i,
+				 _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a + i), v1),
+					       _mm256_mul_ps(_mm256_loadu_ps(b + i), v2)));
+
+	return i;
+}
+
+#endif
+
+#ifdef PCM_SIMD_NEON
+
+static size_t
+pcm_add_neon_16(int16_t *a, const int16_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		vst1q_s16(a + i, vqaddq_s16(vld1q_s16(a + i), vld1q_s16(b + i)));
+
+	return i;
+}
+
+static size_t
+pcm_add_neon_24(int32_t *a, const int32_t *b, size_t n)
+{
+	const int32x4_t min = vdupq_n_s32(S24_MIN);
+	const int32x4_t max = vdupq_n_s32(S24_MAX);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const int32x4_t x = vaddq_s32(vld1q_s32(a + i),
+					      vld1q_s32(b + i));
+		vst1q_s32(a + i, vminq_s32(vmaxq_s32(x, min), max));
+	}
+
+	return i;
+}
+
+static size_t
+pcm_add_neon_32(int32_t *a, const int32_t *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_s32(a + i, vqaddq_s32(vld1q_s32(a + i), vld1q_s32(b + i)));
+
+	return i;
+}
+
+#ifdef __aarch64__
+/* only on AArch64: ARMv7 NEON flushes denormals to zero, which
+   would not be bit-exact; the multiply-add is left to the compiler,
+   because it may contract the scalar code to FMA */
+static size_t
+pcm_add_neon_float(float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(a + i, vaddq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+
+	return i;
+}
+#endif
+
+#endif
+
+size_t
+pcm_add_simd_16(int16_t *a, const int16_t *b, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_add_avx2_16(a, b, n);
+
+	case SimdLevel::SSE2:
+		return pcm_add_sse2_16(a, b, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_add_neon_16(a, b, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_add_simd_24(int32_t *a, const int32_t *b, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_add_avx2_24(a, b, n);
+
+	case SimdLevel::SSE2:
+		return pcm_add_sse2_24(a, b, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_add_neon_24(a, b, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_add_simd_32(int32_t *a, const int32_t *b, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_add_avx2_32(a, b, n);
+
+	case SimdLevel::SSE2:
+		return pcm_add_sse2_32(a, b, n);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_add_neon_32(a, b, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_add_simd_float(float *a, const float *b, size_t n)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_add_avx_float(a, b, n);
+
+	case SimdLevel::SSE2:
+		return pcm_add_sse_float(a, b, n);
+#endif
+
+#if defined(PCM_SIMD_NEON) && defined(__aarch64__)
+	case SimdLevel::NEON:
+		return pcm_add_neon_float(a, b, n);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_add_vol_simd_float(float *a, const float *b, size_t n,
+		       float volume1, float volume2)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_add_vol_avx_float(a, b, n, volume1, volume2);
+
+	case SimdLevel::SSE2:
+		return pcm_add_vol_sse_float(a, b, n, volume1, volume2);
+#endif
+
+	default:
+		return 0;
+	}
+}
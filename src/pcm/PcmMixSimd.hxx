@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_MIX_SIMD_HXX
+#define MPD_PCM_MIX_SIMD_HXX
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorised kernels for pcm_mix().  Just like the ones in
+ * VolumeSimd.hxx, the instruction set is chosen at runtime, each
+ * function processes a multiple of the vector width and returns the
+ * number of samples it has processed, and the result is bit-exact
+ * with the scalar implementation in PcmMix.cxx.
+ */
+
+/**
+ * Add two 16 bit buffers (in place), saturating the result.
+ */
+size_t
+pcm_add_simd_16(int16_t *a, const int16_t *b, size_t n);
+
+/**
+ * Add two 24 bit buffers (in place), clamping the result to 24 bit.
+ */
+size_t
+pcm_add_simd_24(int32_t *a, const int32_t *b, size_t n);
+
+/**
+ * Add two 32 bit buffers (in place), saturating the result.
+ */
+size_t
+pcm_add_simd_32(int32_t *a, const int32_t *b, size_t n);
+
+size_t
+pcm_add_simd_float(float *a, const float *b, size_t n);
+
+/**
+ * Calculate a=a*volume1+b*volume2.
+ */
+size_t
+pcm_add_vol_simd_float(float *a, const float *b, size_t n,
+		       float volume1, float volume2);
+
+#endif
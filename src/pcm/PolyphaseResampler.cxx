@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PolyphaseResampler.hxx"
+#include "PolyphaseSimd.hxx"
+#include "AudioFormat.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain polyphase_domain("polyphase");
+
+struct PolyphaseQuality {
+	const char *name;
+
+	/**
+	 * The number of filter taps when upsampling; when
+	 * downsampling, the filter is stretched by the conversion
+	 * ratio.
+	 */
+	unsigned taps;
+
+	/**
+	 * The Kaiser window parameter; larger values mean more
+	 * stop band attenuation, but a wider transition band.
+	 */
+	double beta;
+
+	/**
+	 * The cutoff frequency as a fraction of the Nyquist
+	 * frequency.
+	 */
+	double cutoff;
+};
+
+static constexpr PolyphaseQuality polyphase_qualities[] = {
+	{ "fast", 16, 5.0, 0.80 },
+	{ "medium", 32, 7.0, 0.86 },
+	{ "best", 64, 9.0, 0.91 },
+};
+
+static const PolyphaseQuality *polyphase_quality = &polyphase_qualities[1];
+
+/**
+ * With more phases than this, the phase is rounded, to keep the
+ * coefficient table small.
+ */
+static constexpr unsigned POLYPHASE_MAX_PHASES = 1024;
+
+static constexpr unsigned POLYPHASE_MAX_TAPS = 512;
+
+static bool
+polyphase_parse_converter(const char *converter)
+{
+	assert(converter != nullptr);
+
+	/* an empty string selects the default quality */
+	if (*converter == 0)
+		return true;
+
+	assert(strncmp(converter, "polyphase", 9) == 0);
+	if (converter[9] == '\0')
+		return true;
+	if (converter[9] != ' ')
+		return false;
+
+	for (const auto &i : polyphase_qualities) {
+		if (strcmp(converter + 10, i.name) == 0) {
+			polyphase_quality = &i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool
+pcm_resample_polyphase_global_init(const char *converter, Error &error)
+{
+	if (!polyphase_parse_converter(converter)) {
+		error.Format(polyphase_domain,
+			     "unknown samplerate converter '%s'", converter);
+		return false;
+	}
+
+	FormatDebug(polyphase_domain, "polyphase converter '%s'",
+		    polyphase_quality->name);
+
+	return true;
+}
+
+gcc_const
+static unsigned
+gcd(unsigned a, unsigned b)
+{
+	while (b != 0) {
+		const unsigned t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/**
+ * The zeroth order modified Bessel function of the first kind, for
+ * the Kaiser window.
+ */
+gcc_const
+static double
+bessel_i0(double x)
+{
+	double sum = 1, term = 1;
+	for (unsigned k = 1; k < 64 && term > sum * 1e-12; ++k) {
+		const double t = x / (2 * k);
+		term *= t * t;
+		sum += term;
+	}
+
+	return sum;
+}
+
+/**
+ * Calculate the coefficients of one phase.
+ *
+ * @param frac the position of the output frame after the input
+ * frame preceding it, in the range [0..1)
+ * @param fc the cutoff frequency in cycles per input frame
+ */
+static void
+polyphase_design(float *dest, unsigned n_taps, double frac,
+		 double fc, double beta)
+{
+	const unsigned half = n_taps / 2;
+	const double i0_beta = bessel_i0(beta);
+
+	double sum = 0;
+	double h[POLYPHASE_MAX_TAPS];
+	for (unsigned k = 0; k < n_taps; ++k) {
+		/* the distance between input frame k and the output
+		   frame */
+		const double t = double(k) - double(half - 1) - frac;
+
+		const double x = 2 * fc * t;
+		double v = x == 0 ? 1 : sin(M_PI * x) / (M_PI * x);
+
+		const double w = t / half;
+		v *= w < 1 && w > -1
+			? bessel_i0(beta * sqrt(1 - w * w)) / i0_beta
+			: 0;
+
+		h[k] = v;
+		sum += v;
+	}
+
+	/* normalize each phase to unity gain at DC */
+	for (unsigned k = 0; k < n_taps; ++k)
+		dest[k] = h[k] / sum;
+}
+
+AudioFormat
+PolyphasePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
+			    gcc_unused Error &error)
+{
+	assert(af.IsValid());
+	assert(audio_valid_sample_rate(new_sample_rate));
+
+	channels = af.channels;
+
+	const unsigned g = gcd(af.sample_rate, new_sample_rate);
+	up = new_sample_rate / g;
+	down = af.sample_rate / g;
+	n_phases = std::min(up, POLYPHASE_MAX_PHASES);
+
+	const PolyphaseQuality &quality = *polyphase_quality;
+
+	/* when downsampling, lower the cutoff frequency below the
+	   new Nyquist frequency, and make the filter longer
+	   accordingly */
+	double scale = 1;
+	if (down > up)
+		scale = double(up) / double(down);
+
+	n_taps = unsigned(ceil(quality.taps / scale));
+	n_taps = std::min((n_taps + 7) & ~7u, POLYPHASE_MAX_TAPS);
+
+	const double fc = 0.5 * quality.cutoff * scale;
+
+	coefficients = new float[n_phases * n_taps];
+	for (unsigned p = 0; p < n_phases; ++p)
+		polyphase_design(coefficients + p * n_taps, n_taps,
+				 double(p) / n_phases, fc, quality.beta);
+
+	history = new float[channels * n_taps];
+	Reset();
+
+	FormatDebug(polyphase_domain,
+		    "%u:%u, %u phases, %u taps",
+		    up, down, n_phases, n_taps);
+
+	af.format = SampleFormat::FLOAT;
+
+	AudioFormat result = af;
+	result.sample_rate = new_sample_rate;
+	return result;
+}
+
+void
+PolyphasePcmResampler::Close()
+{
+	delete[] coefficients;
+	delete[] history;
+}
+
+void
+PolyphasePcmResampler::Reset()
+{
+	/* start with silence, so the first output frame is
+	   aligned with the first input frame */
+	std::fill_n(history, channels * n_taps, 0.0f);
+	history_length = position = n_taps / 2 - 1;
+	phase = 0;
+}
+
+static inline float
+polyphase_dot(const float *a, const float *b, size_t n)
+{
+	float sum = 0;
+	size_t i = pcm_dot_simd_float(a, b, n, sum);
+	for (; i < n; ++i)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+ConstBuffer<void>
+PolyphasePcmResampler::Resample(ConstBuffer<void> _src,
+				gcc_unused Error &error)
+{
+	const auto src = ConstBuffer<float>::FromVoid(_src);
+	assert(src.size % channels == 0);
+
+	const unsigned n_frames = src.size / channels;
+	const unsigned total = history_length + n_frames;
+
+	/* de-interleave the history and the new input into one
+	   contiguous block per channel */
+	float *work = work_buffer.GetT<float>(channels * total);
+	for (unsigned c = 0; c < channels; ++c) {
+		float *w = work + c * total;
+		std::copy_n(history + c * n_taps, history_length, w);
+		w += history_length;
+
+		for (unsigned i = 0; i < n_frames; ++i)
+			w[i] = src.data[i * channels + c];
+	}
+
+	const unsigned half = n_taps / 2;
+	const size_t max_frames =
+		uint64_t(total) * up / down + 1;
+	float *const dest0 = buffer.GetT<float>(max_frames * channels);
+	float *dest = dest0;
+
+	while (position + half < total) {
+		const unsigned p = n_phases == up
+			? phase
+			: unsigned(uint64_t(phase) * n_phases / up);
+		const float *h = coefficients + p * n_taps;
+		const float *w = work + position + 1 - half;
+
+		for (unsigned c = 0; c < channels; ++c)
+			*dest++ = polyphase_dot(w + c * total, h, n_taps);
+
+		phase += down;
+		position += phase / up;
+		phase %= up;
+	}
+
+	assert(dest <= dest0 + max_frames * channels);
+
+	/* keep the frames which are needed by the next output
+	   frame */
+	const unsigned discard = std::min(position + 1 - half, total);
+	history_length = total - discard;
+	position -= discard;
+	assert(history_length < n_taps);
+
+	for (unsigned c = 0; c < channels; ++c)
+		std::copy_n(work + c * total + discard, history_length,
+			    history + c * n_taps);
+
+	return ConstBuffer<float>(dest0, dest - dest0).ToVoid();
+}
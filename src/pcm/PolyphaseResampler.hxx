@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_POLYPHASE_RESAMPLER_HXX
+#define MPD_PCM_POLYPHASE_RESAMPLER_HXX
+
+#include "Resampler.hxx"
+#include "PcmBuffer.hxx"
+
+class Error;
+
+/**
+ * A windowed-sinc polyphase resampler which does not need an external
+ * library.  The filter coefficients for all phases of the rational
+ * conversion ratio are calculated in Open(); the inner loop is a dot
+ * product which uses SIMD instructions if available (see
+ * PolyphaseSimd.hxx).  It works with floating point samples.
+ */
+class PolyphasePcmResampler final : public PcmResampler {
+	unsigned channels;
+
+	/**
+	 * The conversion ratio is #up / #down.
+	 */
+	unsigned up, down;
+
+	/**
+	 * The number of filter phases in #coefficients.  This equals
+	 * #up unless #up is very large, in which case the phase is
+	 * rounded down to the nearest one in the table.
+	 */
+	unsigned n_phases;
+
+	/**
+	 * The number of filter taps per phase; always a multiple of 8.
+	 */
+	unsigned n_taps;
+
+	/**
+	 * #n_phases * #n_taps coefficients.
+	 */
+	float *coefficients;
+
+	/**
+	 * The last input frames which are still needed for the next
+	 * output frames, one block of #n_taps samples per channel.
+	 */
+	float *history;
+
+	/**
+	 * The number of valid frames in #history.
+	 */
+	unsigned history_length;
+
+	/**
+	 * The input frame (counted from the beginning of #history)
+	 * which immediately precedes the next output frame.
+	 */
+	unsigned position;
+
+	/**
+	 * The distance between #position and the next output frame, in
+	 * units of 1/#up input frames.
+	 */
+	unsigned phase;
+
+	PcmBuffer work_buffer, buffer;
+
+public:
+	virtual AudioFormat Open(AudioFormat &af, unsigned new_sample_rate,
+				 Error &error) override;
+	virtual void Close() override;
+	virtual void Reset() override;
+	virtual ConstBuffer<void> Resample(ConstBuffer<void> src,
+					   Error &error) override;
+};
+
+bool
+pcm_resample_polyphase_global_init(const char *converter, Error &error);
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PolyphaseSimd.hxx"
+#include "SimdLevel.hxx"
+
+#if defined(PCM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef PCM_SIMD_X86
+
+__attribute__((target("sse2")))
+static float
+pcm_hsum_sse(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_dot_sse_float(const float *a, const float *b, size_t n, float &sum_r)
+{
+	__m128 sum = _mm_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i),
+						 _mm_loadu_ps(b + i)));
+
+	sum_r += pcm_hsum_sse(sum);
+	return i;
+}
+
+/**
+ * Two independent accumulators hide the latency of the additions.
+ */
+__attribute__((target("avx")))
+static size_t
+pcm_dot_avx_float(const float *a, const float *b, size_t n, float &sum_r)
+{
+	__m256 sum1 = _mm256_setzero_ps(), sum2 = _mm256_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		sum1 = _mm256_add_ps(sum1,
+				     _mm256_mul_ps(_mm256_loadu_ps(a + i),
+						   _mm256_loadu_ps(b + i)));
+		sum2 = _mm256_add_ps(sum2,
+				     _mm256_mul_ps(_mm256_loadu_ps(a + i + 8),
+						   _mm256_loadu_ps(b + i + 8)));
+	}
+
+	for (; i + 8 <= n; i += 8)
+		sum1 = _mm256_add_ps(sum1,
+				     _mm256_mul_ps(_mm256_loadu_ps(a + i),
+						   _mm256_loadu_ps(b + i)));
+
+	const __m256 sum = _mm256_add_ps(sum1, sum2);
+	sum_r += pcm_hsum_sse(_mm_add_ps(_mm256_castps256_ps128(sum),
+					 _mm256_extractf128_ps(sum, 1)));
+	return i;
+}
+
+#endif
+
+#ifdef PCM_SIMD_NEON
+
+static size_t
+pcm_dot_neon_float(const float *a, const float *b, size_t n, float &sum_r)
+{
+	float32x4_t sum = vdupq_n_f32(0);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+
+	float32x2_t s = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+	s = vpadd_f32(s, s);
+	sum_r += vget_lane_f32(s, 0);
+	return i;
+}
+
+#endif
+
+size_t
+pcm_dot_simd_float(const float *a, const float *b, size_t n, float &sum_r)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_dot_avx_float(a, b, n, sum_r);
+
+	case SimdLevel::SSE2:
+		return pcm_dot_sse_float(a, b, n, sum_r);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_dot_neon_float(a, b, n, sum_r);
+#endif
+
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_POLYPHASE_SIMD_HXX
+#define MPD_PCM_POLYPHASE_SIMD_HXX
+
+#include <stddef.h>
+
+/*
+ * Vectorised kernels for the polyphase resampler.  Just like the ones
+ * in VolumeSimd.hxx, the instruction set is chosen at runtime and
+ * each function processes a multiple of the vector width and returns
+ * the number of samples it has processed.  Since the additions are
+ * reordered, the result may differ from the scalar implementation in
+ * the least significant bits.
+ */
+
+/**
+ * Calculate the dot product of two float vectors and add it to
+ * #sum_r.
+ */
+size_t
+pcm_dot_simd_float(const float *a, const float *b, size_t n, float &sum_r);
+
+#endif
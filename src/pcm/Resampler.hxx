@@ -54,6 +54,14 @@ public:
 	 */
 	virtual void Close() = 0;
 
+	/**
+	 * Discard the internal state (e.g. buffered input frames),
+	 * as if the resampler had just been opened with the same
+	 * parameters.  The default implementation does nothing,
+	 * which is correct for stateless resamplers.
+	 */
+	virtual void Reset() {}
+
 	/**
 	 * Resamples a block of PCM data.
 	 *
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SimdLevel.hxx"
+
+static SimdLevel
+DetectSimdLevel()
+{
+#if defined(PCM_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SimdLevel::AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SimdLevel::SSE2;
+#elif defined(PCM_SIMD_NEON)
+	return SimdLevel::NEON;
+#endif
+
+	return SimdLevel::NONE;
+}
+
+SimdLevel
+GetSimdLevel()
+{
+	static const SimdLevel level = DetectSimdLevel();
+	return level;
+}
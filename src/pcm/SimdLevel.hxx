@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SIMD_LEVEL_HXX
+#define MPD_PCM_SIMD_LEVEL_HXX
+
+#include "Compiler.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PCM_SIMD_X86
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PCM_SIMD_NEON
+#endif
+
+/**
+ * The best instruction set extension supported by this CPU which is
+ * used by the vectorised PCM kernels.
+ */
+enum class SimdLevel {
+	NONE,
+
+	SSE2,
+
+	/**
+	 * AVX2 (which implies AVX).
+	 */
+	AVX2,
+
+	NEON,
+};
+
+/**
+ * Detect the #SimdLevel of this CPU.  The result is determined only
+ * once and then cached.
+ */
+gcc_pure
+SimdLevel
+GetSimdLevel();
+
+#endif
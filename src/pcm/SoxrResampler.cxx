@@ -20,6 +20,10 @@
 #include "config.h"
 #include "SoxrResampler.hxx"
 #include "AudioFormat.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigError.hxx"
+#include "config/ConfigOption.hxx"
 #include "util/ASCII.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -27,11 +31,38 @@
 
 #include <soxr.h>
 
+#include <string>
+#include <forward_list>
+
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 static constexpr Domain soxr_domain("soxr");
 
-static unsigned long soxr_quality_recipe = SOXR_HQ;
+/**
+ * A set of soxr parameters, configured with a "resampler" block.
+ */
+struct SoxrProfile {
+	/**
+	 * The name used by the "resampler" setting of an audio
+	 * output.  Empty for the default profile.
+	 */
+	std::string name;
+
+	unsigned long quality;
+
+	soxr_quality_spec_t quality_spec;
+	soxr_runtime_spec_t runtime_spec;
+};
+
+/**
+ * The profile used by all resamplers which have not selected a
+ * named profile.
+ */
+static SoxrProfile soxr_default_profile;
+
+static std::forward_list<SoxrProfile> soxr_profiles;
 
 static const char *
 soxr_quality_name(unsigned long recipe)
@@ -53,7 +84,26 @@ soxr_quality_name(unsigned long recipe)
 }
 
 static bool
-soxr_parse_converter(const char *converter)
+soxr_parse_quality(const char *quality, unsigned long &recipe)
+{
+	if (strcmp(quality, "very high") == 0)
+		recipe = SOXR_VHQ;
+	else if (strcmp(quality, "high") == 0)
+		recipe = SOXR_HQ;
+	else if (strcmp(quality, "medium") == 0)
+		recipe = SOXR_MQ;
+	else if (strcmp(quality, "low") == 0)
+		recipe = SOXR_LQ;
+	else if (strcmp(quality, "quick") == 0)
+		recipe = SOXR_QQ;
+	else
+		return false;
+
+	return true;
+}
+
+static bool
+soxr_parse_converter(const char *converter, unsigned long &recipe)
 {
 	assert(converter != nullptr);
 
@@ -64,27 +114,126 @@ soxr_parse_converter(const char *converter)
 		return false;
 
 	// converter example is "soxr very high", we want the "very high" part
-	const char *quality = converter + 5;
-	if (strcmp(quality, "very high") == 0)
-		soxr_quality_recipe = SOXR_VHQ;
-	else if (strcmp(quality, "high") == 0)
-		soxr_quality_recipe = SOXR_HQ;
-	else if (strcmp(quality, "medium") == 0)
-		soxr_quality_recipe = SOXR_MQ;
-	else if (strcmp(quality, "low") == 0)
-		soxr_quality_recipe = SOXR_LQ;
-	else if (strcmp(quality, "quick") == 0)
-		soxr_quality_recipe = SOXR_QQ;
-	else
+	return soxr_parse_quality(converter + 5, recipe);
+}
+
+/**
+ * Parse a fraction of the Nyquist frequency.
+ */
+static bool
+soxr_parse_bandwidth(const config_param &param, const char *name,
+		     double max, double &value_r, Error &error)
+{
+	const char *s = param.GetBlockValue(name);
+	if (s == nullptr)
+		return true;
+
+	char *endptr;
+	double value = strtod(s, &endptr);
+	if (endptr == s || *endptr != 0 || value <= 0 || value > max) {
+		error.Format(config_domain,
+			     "Invalid \"%s\" value in line %d",
+			     name, param.line);
 		return false;
+	}
 
+	value_r = value;
 	return true;
 }
 
+static bool
+soxr_parse_profile(const config_param &param, const SoxrProfile &base,
+		   SoxrProfile &profile, Error &error)
+{
+	profile.quality = base.quality;
+
+	const char *quality = param.GetBlockValue("quality");
+	if (quality != nullptr &&
+	    !soxr_parse_quality(quality, profile.quality)) {
+		error.Format(config_domain,
+			     "Unknown soxr quality \"%s\" in line %d",
+			     quality, param.line);
+		return false;
+	}
+
+	unsigned long recipe = profile.quality;
+	double phase_response = -1;
+
+	const char *phase = param.GetBlockValue("phase_response");
+	if (phase == nullptr || strcmp(phase, "linear") == 0)
+		recipe |= SOXR_LINEAR_PHASE;
+	else if (strcmp(phase, "intermediate") == 0)
+		recipe |= SOXR_INTERMEDIATE_PHASE;
+	else if (strcmp(phase, "minimum") == 0)
+		recipe |= SOXR_MINIMUM_PHASE;
+	else {
+		/* a number between 0 (minimum) and 100 (maximum,
+		   i.e. linear phase) */
+		char *endptr;
+		phase_response = strtod(phase, &endptr);
+		if (endptr == phase || *endptr != 0 ||
+		    phase_response < 0 || phase_response > 100) {
+			error.Format(config_domain,
+				     "Invalid \"phase_response\" value in line %d",
+				     param.line);
+			return false;
+		}
+	}
+
+	if (param.GetBlockValue("steep", false))
+		recipe |= SOXR_STEEP_FILTER;
+
+	profile.quality_spec = soxr_quality_spec(recipe, 0);
+	if (phase_response >= 0)
+		profile.quality_spec.phase_response = phase_response;
+
+	if (!soxr_parse_bandwidth(param, "passband_end", 1,
+				  profile.quality_spec.passband_end, error) ||
+	    !soxr_parse_bandwidth(param, "stopband_begin", 2,
+				  profile.quality_spec.stopband_begin, error))
+		return false;
+
+	if (profile.quality_spec.stopband_begin <=
+	    profile.quality_spec.passband_end) {
+		error.Format(config_domain,
+			     "\"stopband_begin\" must be larger than "
+			     "\"passband_end\" in line %d",
+			     param.line);
+		return false;
+	}
+
+	/* 0 means one thread per CPU */
+	const unsigned threads = param.GetBlockValue("threads", 1u);
+	profile.runtime_spec = soxr_runtime_spec(threads);
+
+	FormatDebug(soxr_domain,
+		    "soxr profile '%s': %s, phase=%.0f, passband=%.3f, "
+		    "stopband=%.3f, threads=%u",
+		    profile.name.c_str(),
+		    soxr_quality_name(profile.quality),
+		    profile.quality_spec.phase_response,
+		    profile.quality_spec.passband_end,
+		    profile.quality_spec.stopband_begin,
+		    threads);
+
+	return true;
+}
+
+static const SoxrProfile *
+soxr_find_profile(const char *name)
+{
+	for (const auto &i : soxr_profiles)
+		if (i.name == name)
+			return &i;
+
+	return nullptr;
+}
+
 bool
 pcm_resample_soxr_global_init(const char *converter, Error &error)
 {
-	if (!soxr_parse_converter(converter)) {
+	soxr_default_profile.quality = SOXR_HQ;
+	if (!soxr_parse_converter(converter, soxr_default_profile.quality)) {
 		error.Format(soxr_domain,
 			    "unknown samplerate converter '%s'", converter);
 		return false;
@@ -92,11 +241,73 @@ pcm_resample_soxr_global_init(const char *converter, Error &error)
 
 	FormatDebug(soxr_domain,
 		    "soxr converter '%s'",
-		    soxr_quality_name(soxr_quality_recipe));
+		    soxr_quality_name(soxr_default_profile.quality));
+
+	soxr_default_profile.quality_spec =
+		soxr_quality_spec(soxr_default_profile.quality, 0);
+	soxr_default_profile.runtime_spec = soxr_runtime_spec(1);
+
+	/* the unnamed "resampler" block modifies the default
+	   profile; it must be parsed before the named ones, which
+	   inherit its quality */
+	const struct config_param *param;
+	for (param = config_get_param(CONF_RESAMPLER);
+	     param != nullptr; param = param->next) {
+		if (param->GetBlockValue("name") == nullptr) {
+			SoxrProfile profile;
+			if (!soxr_parse_profile(*param, soxr_default_profile,
+						profile, error))
+				return false;
+
+			soxr_default_profile = profile;
+			break;
+		}
+	}
+
+	soxr_profiles.clear();
+	for (param = config_get_param(CONF_RESAMPLER);
+	     param != nullptr; param = param->next) {
+		const char *name = param->GetBlockValue("name");
+		if (name == nullptr)
+			continue;
+
+		if (soxr_find_profile(name) != nullptr) {
+			error.Format(config_domain,
+				     "Duplicate resampler \"%s\" in line %d",
+				     name, param->line);
+			return false;
+		}
+
+		soxr_profiles.emplace_front();
+		SoxrProfile &profile = soxr_profiles.front();
+		profile.name = name;
+		if (!soxr_parse_profile(*param, soxr_default_profile,
+					profile, error))
+			return false;
+	}
 
 	return true;
 }
 
+bool
+pcm_resample_soxr_check_profile(const char *name, Error &error)
+{
+	if (soxr_find_profile(name) != nullptr)
+		return true;
+
+	error.Format(config_domain, "No such resampler: \"%s\"", name);
+	return false;
+}
+
+SoxrPcmResampler::SoxrPcmResampler(const char *profile_name)
+	:profile(nullptr)
+{
+	if (profile_name != nullptr)
+		profile = soxr_find_profile(profile_name);
+	if (profile == nullptr)
+		profile = &soxr_default_profile;
+}
+
 AudioFormat
 SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
 		       Error &error)
@@ -105,10 +316,10 @@ SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
 	assert(audio_valid_sample_rate(new_sample_rate));
 
 	soxr_error_t e;
-	soxr_quality_spec_t quality = soxr_quality_spec(soxr_quality_recipe, 0);
 	soxr = soxr_create(af.sample_rate, new_sample_rate,
 			   af.channels, &e,
-			   nullptr, &quality, nullptr);
+			   nullptr, &profile->quality_spec,
+			   &profile->runtime_spec);
 	if (soxr == nullptr) {
 		error.Format(soxr_domain,
 			     "soxr initialization has failed: %s", e);
@@ -138,6 +349,12 @@ SoxrPcmResampler::Close()
 	soxr_delete(soxr);
 }
 
+void
+SoxrPcmResampler::Reset()
+{
+	soxr_clear(soxr);
+}
+
 ConstBuffer<void>
 SoxrPcmResampler::Resample(ConstBuffer<void> src, Error &error)
 {
@@ -24,11 +24,14 @@
 #include "PcmBuffer.hxx"
 
 struct AudioFormat;
+struct SoxrProfile;
 
 /**
  * A resampler using soxr.
  */
 class SoxrPcmResampler final : public PcmResampler {
+	const SoxrProfile *profile;
+
 	struct soxr *soxr;
 
 	unsigned channels;
@@ -37,9 +40,16 @@ class SoxrPcmResampler final : public PcmResampler {
 	PcmBuffer buffer;
 
 public:
+	/**
+	 * @param profile_name the name of a "resampler" block, or
+	 * nullptr for the default profile
+	 */
+	explicit SoxrPcmResampler(const char *profile_name);
+
 	virtual AudioFormat Open(AudioFormat &af, unsigned new_sample_rate,
 				 Error &error) override;
 	virtual void Close() override;
+	virtual void Reset() override;
 	virtual ConstBuffer<void> Resample(ConstBuffer<void> src,
 					   Error &error) override;
 };
@@ -47,4 +57,7 @@ public:
 bool
 pcm_resample_soxr_global_init(const char *converter, Error &error);
 
+bool
+pcm_resample_soxr_check_profile(const char *name, Error &error);
+
 #endif
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Volume.hxx"
+#include "VolumeSimd.hxx"
 #include "Domain.hxx"
 #include "PcmUtils.hxx"
 #include "Traits.hxx"
@@ -27,6 +28,8 @@
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
+#include <algorithm>
+
 #include <stdint.h>
 #include <string.h>
 
@@ -55,6 +58,69 @@ pcm_volume_change(PcmDither &dither,
 		dest[i] = pcm_volume_sample<F, Traits>(dither, src[i], volume);
 }
 
+/**
+ * Like pcm_volume_sample(), but without dithering: round to the
+ * nearest value and clamp.  This is the reference for the vectorised
+ * kernels in VolumeSimd.cxx.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static inline typename Traits::value_type
+pcm_volume_sample_nodither(typename Traits::value_type _sample, int volume)
+{
+	typename Traits::long_type sample(_sample);
+
+	return PcmClamp<F, Traits>((sample * volume +
+				    (1 << (PCM_VOLUME_BITS - 1)))
+				   >> PCM_VOLUME_BITS);
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+pcm_volume_change_nodither(typename Traits::pointer_type dest,
+			   typename Traits::const_pointer_type src,
+			   size_t n,
+			   int volume)
+{
+	for (size_t i = 0; i != n; ++i)
+		dest[i] = pcm_volume_sample_nodither<F, Traits>(src[i],
+								volume);
+}
+
+static void
+pcm_volume_change_8_nodither(int8_t *dest, const int8_t *src, size_t n,
+			     int volume)
+{
+	pcm_volume_change_nodither<SampleFormat::S8>(dest, src, n, volume);
+}
+
+static void
+pcm_volume_change_16_nodither(int16_t *dest, const int16_t *src, size_t n,
+			      int volume)
+{
+	/* the SIMD kernels multiply with a 16 bit volume */
+	size_t done = volume <= 0x7fff
+		? pcm_volume_simd_16(dest, src, n, volume)
+		: 0;
+
+	pcm_volume_change_nodither<SampleFormat::S16>(dest + done, src + done,
+						      n - done, volume);
+}
+
+static void
+pcm_volume_change_24_nodither(int32_t *dest, const int32_t *src, size_t n,
+			      int volume)
+{
+	pcm_volume_change_nodither<SampleFormat::S24_P32>(dest, src, n,
+							  volume);
+}
+
+static void
+pcm_volume_change_32_nodither(int32_t *dest, const int32_t *src, size_t n,
+			      int volume)
+{
+	pcm_volume_change_nodither<SampleFormat::S32>(dest, src, n, volume);
+}
+
 static void
 pcm_volume_change_8(PcmDither &dither,
 		    int8_t *dest, const int8_t *src, size_t n,
@@ -92,10 +158,98 @@ static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume)
 {
-	for (size_t i = 0; i != n; ++i)
+	const size_t done = pcm_volume_simd_float(dest, src, n, volume);
+
+	for (size_t i = done; i != n; ++i)
 		dest[i] = src[i] * volume;
 }
 
+/**
+ * Apply a linear volume ramp: all samples of frame k are multiplied
+ * with (gain + k * step) >> 16.
+ *
+ * @param dither the dither state, or nullptr to round to the nearest
+ * value
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+pcm_volume_ramp(PcmDither *dither,
+		typename Traits::pointer_type dest,
+		typename Traits::const_pointer_type src,
+		size_t n_frames, unsigned channels,
+		int64_t gain, int64_t step)
+{
+	for (size_t i = 0; i != n_frames; ++i, gain += step) {
+		const int volume = int(gain >> 16);
+
+		for (unsigned c = 0; c != channels; ++c)
+			*dest++ = dither != nullptr
+				? pcm_volume_sample<F, Traits>(*dither, *src++,
+							       volume)
+				: pcm_volume_sample_nodither<F, Traits>(*src++,
+									volume);
+	}
+}
+
+/**
+ * Can the vectorised ramp kernels handle this ramp?  They calculate
+ * with 32 bit gains and 16 bit volumes.
+ */
+gcc_const
+static bool
+pcm_volume_ramp_simd_possible(size_t n_frames, int64_t gain, int64_t step)
+{
+	if (n_frames == 0)
+		return false;
+
+	const int64_t last = gain + step * int64_t(n_frames - 1);
+	constexpr int64_t max = int64_t(0x7fff) << 16;
+
+	return gain <= max && last <= max;
+}
+
+static void
+pcm_volume_ramp_16_nodither(int16_t *dest, const int16_t *src,
+			    size_t n_frames, unsigned channels,
+			    int64_t gain, int64_t step)
+{
+	const size_t done =
+		pcm_volume_ramp_simd_possible(n_frames, gain, step)
+		? pcm_volume_ramp_simd_16(dest, src, n_frames * channels,
+					  channels, gain, step) / channels
+		: 0;
+
+	pcm_volume_ramp<SampleFormat::S16>(nullptr,
+					   dest + done * channels,
+					   src + done * channels,
+					   n_frames - done, channels,
+					   gain + step * int64_t(done), step);
+}
+
+static void
+pcm_volume_ramp_float(float *dest, const float *src,
+		      size_t n_frames, unsigned channels,
+		      int64_t gain, int64_t step)
+{
+	const size_t done =
+		pcm_volume_ramp_simd_possible(n_frames, gain, step)
+		? pcm_volume_ramp_simd_float(dest, src, n_frames * channels,
+					     channels, gain, step) / channels
+		: 0;
+
+	dest += done * channels;
+	src += done * channels;
+	gain += step * int64_t(done);
+
+	for (size_t i = done; i != n_frames; ++i, gain += step) {
+		const float volume =
+			float(gain) * (1.0f / float(PCM_VOLUME_1 << 16));
+
+		for (unsigned c = 0; c != channels; ++c)
+			*dest++ = *src++ * volume;
+	}
+}
+
 bool
 PcmVolume::Open(SampleFormat _format, Error &error)
 {
@@ -121,27 +275,72 @@ PcmVolume::Open(SampleFormat _format, Error &error)
 	}
 
 	format = _format;
+	applied_volume = volume;
+	ramp_frames = 0;
+	ramp_remaining = 0;
 	return true;
 }
 
-ConstBuffer<void>
-PcmVolume::Apply(ConstBuffer<void> src)
+inline bool
+PcmVolume::ApplyNoDither(void *data, ConstBuffer<void> src,
+			 unsigned _volume) const
 {
-	if (volume == PCM_VOLUME_1)
-		return src;
+	switch (format) {
+	case SampleFormat::S8:
+		pcm_volume_change_8_nodither((int8_t *)data,
+					     (const int8_t *)src.data,
+					     src.size / sizeof(int8_t),
+					     _volume);
+		return true;
 
-	void *data = buffer.Get(src.size);
+	case SampleFormat::S16:
+		pcm_volume_change_16_nodither((int16_t *)data,
+					      (const int16_t *)src.data,
+					      src.size / sizeof(int16_t),
+					      _volume);
+		return true;
+
+	case SampleFormat::S24_P32:
+		pcm_volume_change_24_nodither((int32_t *)data,
+					      (const int32_t *)src.data,
+					      src.size / sizeof(int32_t),
+					      _volume);
+		return true;
+
+	case SampleFormat::S32:
+		pcm_volume_change_32_nodither((int32_t *)data,
+					      (const int32_t *)src.data,
+					      src.size / sizeof(int32_t),
+					      _volume);
+		return true;
+
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::FLOAT:
+	case SampleFormat::DSD:
+		/* not dithered anyway */
+		break;
+	}
 
-	if (volume == 0) {
+	return false;
+}
+
+void
+PcmVolume::ApplyConstant(void *data, ConstBuffer<void> src, unsigned _volume)
+{
+	if (_volume == 0) {
 		/* optimized special case: 0% volume = memset(0) */
 		/* TODO: is this valid for all sample formats? What
 		   about floating point? */
 		memset(data, 0, src.size);
-		return { data, src.size };
+		return;
 	}
 
+	if (!dither_enabled && ApplyNoDither(data, src, _volume))
+		return;
+
 	switch (format) {
 	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
 		assert(false);
 		gcc_unreachable();
 
@@ -149,41 +348,161 @@ PcmVolume::Apply(ConstBuffer<void> src)
 		pcm_volume_change_8(dither, (int8_t *)data,
 				    (const int8_t *)src.data,
 				    src.size / sizeof(int8_t),
-				    volume);
+				    _volume);
 		break;
 
 	case SampleFormat::S16:
 		pcm_volume_change_16(dither, (int16_t *)data,
 				     (const int16_t *)src.data,
 				     src.size / sizeof(int16_t),
-				     volume);
+				     _volume);
 		break;
 
 	case SampleFormat::S24_P32:
 		pcm_volume_change_24(dither, (int32_t *)data,
 				     (const int32_t *)src.data,
 				     src.size / sizeof(int32_t),
-				     volume);
+				     _volume);
 		break;
 
 	case SampleFormat::S32:
 		pcm_volume_change_32(dither, (int32_t *)data,
 				     (const int32_t *)src.data,
 				     src.size / sizeof(int32_t),
-				     volume);
+				     _volume);
 		break;
 
 	case SampleFormat::FLOAT:
 		pcm_volume_change_float((float *)data,
 					(const float *)src.data,
 					src.size / sizeof(float),
-					pcm_volume_to_float(volume));
+					pcm_volume_to_float(_volume));
 		break;
+	}
+}
+
+inline void
+PcmVolume::UpdateRamp()
+{
+	const unsigned target = volume;
+	if (target == applied_volume)
+		return;
+
+	if (ramp_frames == 0 || format == SampleFormat::DSD) {
+		applied_volume = target;
+		return;
+	}
 
+	/* start a new ramp from wherever the previous one has
+	   arrived; this coalesces a burst of volume changes (e.g. a
+	   client dragging a slider) into one continuous curve */
+	const int64_t from = ramp_remaining > 0
+		? ramp_gain
+		: int64_t(applied_volume) << 16;
+
+	applied_volume = target;
+	ramp_gain = from;
+	ramp_step = ((int64_t(target) << 16) - from) / int64_t(ramp_frames);
+	ramp_remaining = ramp_frames;
+}
+
+ConstBuffer<void>
+PcmVolume::ApplyRamp(ConstBuffer<void> src)
+{
+	const size_t frame_size = sample_format_size(format) * channels;
+	assert(src.size % frame_size == 0);
+
+	const size_t n_frames = src.size / frame_size;
+	const size_t n = std::min(n_frames, size_t(ramp_remaining));
+
+	void *data = buffer.Get(src.size);
+	PcmDither *const d = dither_enabled ? &dither : nullptr;
+
+	switch (format) {
+	case SampleFormat::UNDEFINED:
 	case SampleFormat::DSD:
+		assert(false);
+		gcc_unreachable();
+
+	case SampleFormat::S8:
+		pcm_volume_ramp<SampleFormat::S8>(d, (int8_t *)data,
+						  (const int8_t *)src.data,
+						  n, channels,
+						  ramp_gain, ramp_step);
+		break;
+
+	case SampleFormat::S16:
+		if (d == nullptr)
+			pcm_volume_ramp_16_nodither((int16_t *)data,
+						    (const int16_t *)src.data,
+						    n, channels,
+						    ramp_gain, ramp_step);
+		else
+			pcm_volume_ramp<SampleFormat::S16>(d, (int16_t *)data,
+							   (const int16_t *)src.data,
+							   n, channels,
+							   ramp_gain, ramp_step);
+		break;
+
+	case SampleFormat::S24_P32:
+		pcm_volume_ramp<SampleFormat::S24_P32>(d, (int32_t *)data,
+						       (const int32_t *)src.data,
+						       n, channels,
+						       ramp_gain, ramp_step);
+		break;
+
+	case SampleFormat::S32:
+		pcm_volume_ramp<SampleFormat::S32>(d, (int32_t *)data,
+						   (const int32_t *)src.data,
+						   n, channels,
+						   ramp_gain, ramp_step);
+		break;
+
+	case SampleFormat::FLOAT:
+		pcm_volume_ramp_float((float *)data, (const float *)src.data,
+				      n, channels, ramp_gain, ramp_step);
+		break;
+	}
+
+	ramp_remaining -= n;
+	if (ramp_remaining > 0) {
+		ramp_gain += ramp_step * int64_t(n);
+		return { data, src.size };
+	}
+
+	/* the ramp is finished; the rest of this chunk gets the
+	   target volume, without the rounding error which the
+	   integer step may have accumulated */
+	const size_t done = n * frame_size;
+	if (done < src.size) {
+		const ConstBuffer<void> rest((const uint8_t *)src.data + done,
+					     src.size - done);
+		if (applied_volume == PCM_VOLUME_1)
+			memcpy((uint8_t *)data + done, rest.data, rest.size);
+		else
+			ApplyConstant((uint8_t *)data + done, rest,
+				      applied_volume);
+	}
+
+	return { data, src.size };
+}
+
+ConstBuffer<void>
+PcmVolume::Apply(ConstBuffer<void> src)
+{
+	UpdateRamp();
+	if (ramp_remaining > 0)
+		return ApplyRamp(src);
+
+	const unsigned level = applied_volume;
+	if (level == PCM_VOLUME_1)
+		return src;
+
+	if (format == SampleFormat::DSD && level != 0)
 		// TODO: implement this; currently, it's a no-op
 		return src;
-	}
 
+	void *data = buffer.Get(src.size);
+	ApplyConstant(data, src, level);
 	return { data, src.size };
 }
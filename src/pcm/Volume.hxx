@@ -26,10 +26,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
-
-#ifndef NDEBUG
 #include <assert.h>
-#endif
 
 class Error;
 template<typename T> struct ConstBuffer;
@@ -69,14 +66,60 @@ pcm_volume_to_float(int volume)
 class PcmVolume {
 	SampleFormat format;
 
+	/**
+	 * The volume level requested by SetVolume().  This may be
+	 * modified by another thread; Apply() reads it only once per
+	 * call, so a burst of SetVolume() calls between two chunks
+	 * costs nothing but the last one.
+	 */
 	unsigned volume;
 
+	/**
+	 * The volume level which was last seen by Apply(), i.e. the
+	 * level currently applied to the samples, or the target of
+	 * the running ramp.
+	 */
+	unsigned applied_volume;
+
+	/**
+	 * The number of channels; only used by the volume ramp.
+	 */
+	unsigned channels;
+
+	/**
+	 * The duration of a volume ramp in frames.  0 means volume
+	 * changes are applied immediately.
+	 */
+	unsigned ramp_frames;
+
+	/**
+	 * The number of frames left in the running ramp; 0 if there
+	 * is none.
+	 */
+	unsigned ramp_remaining;
+
+	/**
+	 * The volume of the next frame and the per-frame increment of
+	 * the running ramp, both in 16.16 fixed point (#PCM_VOLUME_1
+	 * units).
+	 */
+	int64_t ramp_gain, ramp_step;
+
+	/**
+	 * Dither the result?  If this is false, samples are rounded
+	 * to the nearest value, which allows the vectorised code path
+	 * to be used.
+	 */
+	bool dither_enabled;
+
 	PcmBuffer buffer;
 	PcmDither dither;
 
 public:
 	PcmVolume()
-		:volume(PCM_VOLUME_1) {
+		:volume(PCM_VOLUME_1), applied_volume(PCM_VOLUME_1),
+		 channels(1), ramp_frames(0), ramp_remaining(0),
+		 dither_enabled(true) {
 #ifndef NDEBUG
 		format = SampleFormat::UNDEFINED;
 #endif
@@ -92,6 +135,25 @@ public:
 		return volume;
 	}
 
+	/**
+	 * Does Apply() currently return its input unmodified?
+	 */
+	bool IsPassThrough() const {
+		return volume == PCM_VOLUME_1 &&
+			applied_volume == PCM_VOLUME_1 &&
+			ramp_remaining == 0;
+	}
+
+	/**
+	 * Is a volume ramp running or about to be started by the next
+	 * Apply() call?  While this is true, Apply() does not
+	 * multiply with a constant factor.
+	 */
+	bool IsRamping() const {
+		return ramp_frames > 0 &&
+			(volume != applied_volume || ramp_remaining > 0);
+	}
+
 	/**
 	 * @param _volume the volume level in the range
 	 * [0..#PCM_VOLUME_1]; may be bigger than #PCM_VOLUME_1, but
@@ -101,6 +163,14 @@ public:
 		volume = _volume;
 	}
 
+	bool GetDither() const {
+		return dither_enabled;
+	}
+
+	void SetDither(bool _dither) {
+		dither_enabled = _dither;
+	}
+
 	/**
 	 * Opens the object, prepare for Apply().
 	 *
@@ -110,6 +180,23 @@ public:
 	 */
 	bool Open(SampleFormat format, Error &error);
 
+	/**
+	 * Enable gradual volume changes: after SetVolume(), the
+	 * volume moves linearly from the current level to the new
+	 * one over the given number of frames, instead of jumping,
+	 * which would be audible as a click.  Must be called after
+	 * Open().
+	 *
+	 * @param channels the number of channels per frame
+	 * @param frames the duration of the ramp; 0 disables ramping
+	 */
+	void SetRamp(unsigned _channels, unsigned frames) {
+		assert(_channels > 0);
+
+		channels = _channels;
+		ramp_frames = frames;
+	}
+
 	/**
 	 * Closes the object.  After that, you may call Open() again.
 	 */
@@ -123,8 +210,31 @@ public:
 	/**
 	 * Apply the volume level.
 	 */
-	gcc_pure
 	ConstBuffer<void> Apply(ConstBuffer<void> src);
+
+private:
+	/**
+	 * Apply the volume level without dithering.
+	 *
+	 * @return false if the sample format is not dithered anyway,
+	 * and the caller shall use the generic code path
+	 */
+	bool ApplyNoDither(void *data, ConstBuffer<void> src,
+			   unsigned _volume) const;
+
+	/**
+	 * Multiply all samples with a constant volume level.
+	 */
+	void ApplyConstant(void *data, ConstBuffer<void> src,
+			   unsigned _volume);
+
+	/**
+	 * Pick up a new volume level from SetVolume(), and start a
+	 * ramp if enabled.
+	 */
+	void UpdateRamp();
+
+	ConstBuffer<void> ApplyRamp(ConstBuffer<void> src);
 };
 
 #endif
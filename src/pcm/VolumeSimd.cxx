@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "VolumeSimd.hxx"
+#include "SimdLevel.hxx"
+#include "Volume.hxx"
+
+#include <assert.h>
+
+#if defined(PCM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PCM_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+static constexpr int32_t PCM_VOLUME_ROUND = 1 << (PCM_VOLUME_BITS - 1);
+
+/**
+ * Converts a 16.16 fixed-point ramp gain to a floating point factor.
+ * Dividing by a power of two is exact.
+ */
+static constexpr float PCM_VOLUME_RAMP_SCALE =
+	1.0f / float(PCM_VOLUME_1 << 16);
+
+/**
+ * The ramp gain of the given vector lane: all samples of a frame
+ * share one gain.
+ */
+static inline int32_t
+RampLaneGain(int32_t gain, int32_t step, unsigned lane, unsigned channels)
+{
+	return gain + step * int32_t(lane / channels);
+}
+
+#ifdef PCM_SIMD_X86
+
+/**
+ * Multiply eight 16 bit samples, widening to 32 bit with
+ * mullo/mulhi, and pack them back with signed saturation, which is
+ * exactly what PcmClamp() does.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_volume_sse2_16(int16_t *dest, const int16_t *src, size_t n, int volume)
+{
+	const __m128i v = _mm_set1_epi16(volume);
+	const __m128i round = _mm_set1_epi32(PCM_VOLUME_ROUND);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m128i lo = _mm_mullo_epi16(s, v);
+		const __m128i hi = _mm_mulhi_epi16(s, v);
+
+		__m128i a = _mm_unpacklo_epi16(lo, hi);
+		__m128i b = _mm_unpackhi_epi16(lo, hi);
+		a = _mm_srai_epi32(_mm_add_epi32(a, round), PCM_VOLUME_BITS);
+		b = _mm_srai_epi32(_mm_add_epi32(b, round), PCM_VOLUME_BITS);
+
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_packs_epi32(a, b));
+	}
+
+	return i;
+}
+
+/**
+ * Same as pcm_volume_sse2_16(), but 16 samples at a time.  The
+ * unpack and pack instructions operate within each 128 bit lane, so
+ * the sample order is preserved.
+ */
+__attribute__((target("avx2")))
+static size_t
+pcm_volume_avx2_16(int16_t *dest, const int16_t *src, size_t n, int volume)
+{
+	const __m256i v = _mm256_set1_epi16(volume);
+	const __m256i round = _mm256_set1_epi32(PCM_VOLUME_ROUND);
+
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m256i s =
+			_mm256_loadu_si256((const __m256i *)(src + i));
+		const __m256i lo = _mm256_mullo_epi16(s, v);
+		const __m256i hi = _mm256_mulhi_epi16(s, v);
+
+		__m256i a = _mm256_unpacklo_epi16(lo, hi);
+		__m256i b = _mm256_unpackhi_epi16(lo, hi);
+		a = _mm256_srai_epi32(_mm256_add_epi32(a, round),
+				      PCM_VOLUME_BITS);
+		b = _mm256_srai_epi32(_mm256_add_epi32(b, round),
+				      PCM_VOLUME_BITS);
+
+		_mm256_storeu_si256((__m256i *)(dest + i),
+				    _mm256_packs_epi32(a, b));
+	}
+
+	return i;
+}
+
+/**
+ * Like pcm_volume_sse2_16(), but each lane has its own volume, which
+ * is advanced by the number of frames per vector after each
+ * iteration.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_volume_ramp_sse2_16(int16_t *dest, const int16_t *src, size_t n,
+			unsigned channels, int32_t gain, int32_t step)
+{
+	__m128i g_lo = _mm_setr_epi32(RampLaneGain(gain, step, 0, channels),
+				      RampLaneGain(gain, step, 1, channels),
+				      RampLaneGain(gain, step, 2, channels),
+				      RampLaneGain(gain, step, 3, channels));
+	__m128i g_hi = _mm_setr_epi32(RampLaneGain(gain, step, 4, channels),
+				      RampLaneGain(gain, step, 5, channels),
+				      RampLaneGain(gain, step, 6, channels),
+				      RampLaneGain(gain, step, 7, channels));
+	const __m128i advance = _mm_set1_epi32(step * int32_t(8 / channels));
+	const __m128i round = _mm_set1_epi32(PCM_VOLUME_ROUND);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i v = _mm_packs_epi32(_mm_srli_epi32(g_lo, 16),
+						  _mm_srli_epi32(g_hi, 16));
+		g_lo = _mm_add_epi32(g_lo, advance);
+		g_hi = _mm_add_epi32(g_hi, advance);
+
+		const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m128i lo = _mm_mullo_epi16(s, v);
+		const __m128i hi = _mm_mulhi_epi16(s, v);
+
+		__m128i a = _mm_unpacklo_epi16(lo, hi);
+		__m128i b = _mm_unpackhi_epi16(lo, hi);
+		a = _mm_srai_epi32(_mm_add_epi32(a, round), PCM_VOLUME_BITS);
+		b = _mm_srai_epi32(_mm_add_epi32(b, round), PCM_VOLUME_BITS);
+
+		_mm_storeu_si128((__m128i *)(dest + i),
+				 _mm_packs_epi32(a, b));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t
+pcm_volume_sse_float(float *dest, const float *src, size_t n, float volume)
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_loadu_ps(src + i), v));
+
+	return i;
+}
+
+/**
+ * The lane gains are kept as integers and converted for each vector,
+ * instead of accumulating a floating point increment, so the result
+ * is bit-exact with the scalar implementation.
+ */
+__attribute__((target("sse2")))
+static size_t
+pcm_volume_ramp_sse_float(float *dest, const float *src, size_t n,
+			  unsigned channels, int32_t gain, int32_t step)
+{
+	__m128i g = _mm_setr_epi32(RampLaneGain(gain, step, 0, channels),
+				   RampLaneGain(gain, step, 1, channels),
+				   RampLaneGain(gain, step, 2, channels),
+				   RampLaneGain(gain, step, 3, channels));
+	const __m128i advance = _mm_set1_epi32(step * int32_t(4 / channels));
+	const __m128 scale = _mm_set1_ps(PCM_VOLUME_RAMP_SCALE);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(g), scale);
+		g = _mm_add_epi32(g, advance);
+
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_loadu_ps(src + i), v));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx")))
+static size_t
+pcm_volume_avx_float(float *dest, const float *src, size_t n, float volume)
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dest + i,
+				 _mm256_mul_ps(_mm256_loadu_ps(src + i), v));
+
+	return i;
+}
+
+#endif
+
+#ifdef PCM_SIMD_NEON
+
+/**
+ * vqrshrn rounds, shifts and saturates in one step; since the
+ * intermediate value cannot overflow 32 bit, this is equivalent to
+ * the scalar implementation.
+ */
+static size_t
+pcm_volume_neon_16(int16_t *dest, const int16_t *src, size_t n, int volume)
+{
+	const int16x4_t v = vdup_n_s16(volume);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x8_t s = vld1q_s16(src + i);
+		const int32x4_t a = vmull_s16(vget_low_s16(s), v);
+		const int32x4_t b = vmull_s16(vget_high_s16(s), v);
+
+		vst1q_s16(dest + i,
+			  vcombine_s16(vqrshrn_n_s32(a, PCM_VOLUME_BITS),
+				       vqrshrn_n_s32(b, PCM_VOLUME_BITS)));
+	}
+
+	return i;
+}
+
+static size_t
+pcm_volume_ramp_neon_16(int16_t *dest, const int16_t *src, size_t n,
+			unsigned channels, int32_t gain, int32_t step)
+{
+	const int32_t lo_init[4] = {
+		RampLaneGain(gain, step, 0, channels),
+		RampLaneGain(gain, step, 1, channels),
+		RampLaneGain(gain, step, 2, channels),
+		RampLaneGain(gain, step, 3, channels),
+	};
+	const int32_t hi_init[4] = {
+		RampLaneGain(gain, step, 4, channels),
+		RampLaneGain(gain, step, 5, channels),
+		RampLaneGain(gain, step, 6, channels),
+		RampLaneGain(gain, step, 7, channels),
+	};
+
+	int32x4_t g_lo = vld1q_s32(lo_init), g_hi = vld1q_s32(hi_init);
+	const int32x4_t advance = vdupq_n_s32(step * int32_t(8 / channels));
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const int16x4_t v_lo = vshrn_n_s32(g_lo, 16);
+		const int16x4_t v_hi = vshrn_n_s32(g_hi, 16);
+		g_lo = vaddq_s32(g_lo, advance);
+		g_hi = vaddq_s32(g_hi, advance);
+
+		const int16x8_t s = vld1q_s16(src + i);
+		const int32x4_t a = vmull_s16(vget_low_s16(s), v_lo);
+		const int32x4_t b = vmull_s16(vget_high_s16(s), v_hi);
+
+		vst1q_s16(dest + i,
+			  vcombine_s16(vqrshrn_n_s32(a, PCM_VOLUME_BITS),
+				       vqrshrn_n_s32(b, PCM_VOLUME_BITS)));
+	}
+
+	return i;
+}
+
+#ifdef __aarch64__
+/* only on AArch64: ARMv7 NEON flushes denormals to zero, which
+   would not be bit-exact */
+static size_t
+pcm_volume_neon_float(float *dest, const float *src, size_t n, float volume)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(dest + i, vmulq_n_f32(vld1q_f32(src + i), volume));
+
+	return i;
+}
+#endif
+
+#endif
+
+size_t
+pcm_volume_simd_16(int16_t *dest, const int16_t *src, size_t n, int volume)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_volume_avx2_16(dest, src, n, volume);
+
+	case SimdLevel::SSE2:
+		return pcm_volume_sse2_16(dest, src, n, volume);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_volume_neon_16(dest, src, n, volume);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_volume_simd_float(float *dest, const float *src, size_t n, float volume)
+{
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+		return pcm_volume_avx_float(dest, src, n, volume);
+
+	case SimdLevel::SSE2:
+		return pcm_volume_sse_float(dest, src, n, volume);
+#endif
+
+#if defined(PCM_SIMD_NEON) && defined(__aarch64__)
+	case SimdLevel::NEON:
+		return pcm_volume_neon_float(dest, src, n, volume);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_volume_ramp_simd_16(int16_t *dest, const int16_t *src, size_t n,
+			unsigned channels, int32_t gain, int32_t step)
+{
+	assert(channels > 0);
+
+	if (8 % channels != 0)
+		return 0;
+
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_volume_ramp_sse2_16(dest, src, n,
+					       channels, gain, step);
+#endif
+
+#ifdef PCM_SIMD_NEON
+	case SimdLevel::NEON:
+		return pcm_volume_ramp_neon_16(dest, src, n,
+					       channels, gain, step);
+#endif
+
+	default:
+		return 0;
+	}
+}
+
+size_t
+pcm_volume_ramp_simd_float(float *dest, const float *src, size_t n,
+			   unsigned channels, int32_t gain, int32_t step)
+{
+	assert(channels > 0);
+
+	if (4 % channels != 0)
+		return 0;
+
+	switch (GetSimdLevel()) {
+#ifdef PCM_SIMD_X86
+	case SimdLevel::AVX2:
+	case SimdLevel::SSE2:
+		return pcm_volume_ramp_sse_float(dest, src, n,
+						 channels, gain, step);
+#endif
+
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_VOLUME_SIMD_HXX
+#define MPD_PCM_VOLUME_SIMD_HXX
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Vectorised kernels for the non-dithering software volume path.
+ * The instruction set (SSE2, AVX2 or NEON) is chosen at runtime
+ * according to GetSimdLevel().  Each function handles a
+ * multiple of the vector width and returns the number of samples it
+ * has processed; the caller is responsible for the remaining tail.
+ * The result is bit-exact with the scalar implementation in
+ * Volume.cxx.
+ */
+
+/**
+ * Multiply 16 bit samples with a fixed-point volume (see
+ * #PCM_VOLUME_BITS), rounding and clamping the result.
+ *
+ * @param volume the volume; must be in the range [0..32767]
+ */
+size_t
+pcm_volume_simd_16(int16_t *dest, const int16_t *src, size_t n,
+		   int volume);
+
+/**
+ * Multiply floating point samples with a volume factor.
+ */
+size_t
+pcm_volume_simd_float(float *dest, const float *src, size_t n,
+		      float volume);
+
+/**
+ * Like pcm_volume_simd_16(), but with a linear volume ramp: all
+ * samples of frame k are multiplied with (gain + k * step) >> 16.
+ * Only implemented if the number of channels divides the vector
+ * width (1, 2, 4 or 8 channels); the return value is always a
+ * multiple of the number of channels.
+ *
+ * @param gain the 16.16 fixed-point volume of the first frame; it
+ * and the volume of the last frame must be in the range [0..32767]
+ * @param step the per-frame increment in 16.16 fixed point
+ */
+size_t
+pcm_volume_ramp_simd_16(int16_t *dest, const int16_t *src, size_t n,
+			unsigned channels, int32_t gain, int32_t step);
+
+/**
+ * Like pcm_volume_simd_float(), but with a linear volume ramp; see
+ * pcm_volume_ramp_simd_16().  Frame k is multiplied with
+ * (gain + k * step) / (#PCM_VOLUME_1 << 16).  Only implemented for 1,
+ * 2 and 4 channels.
+ */
+size_t
+pcm_volume_ramp_simd_float(float *dest, const float *src, size_t n,
+			   unsigned channels, int32_t gain, int32_t step);
+
+#endif
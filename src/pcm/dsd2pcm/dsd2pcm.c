@@ -5,6 +5,12 @@
 
 #include "dsd2pcm.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #define HTAPS    48             /* number of FIR constants */
 #define FIFOSIZE 16             /* must be a power of two */
 #define FIFOMASK (FIFOSIZE-1)   /* bit mask for FIFO offsets */
@@ -182,3 +188,92 @@ extern void dsd2pcm_translate(
 	ptr->fifopos = ffp;
 }
 
+
+/*
+ * Push one octet into the FIFO of a context, just like
+ * dsd2pcm_translate() does.
+ */
+static inline void dsd2pcm_push(dsd2pcm_ctx* ptr, unsigned ffp,
+	unsigned bite, int lsbf)
+{
+	unsigned char* p;
+	if (lsbf) bite = bit_reverse(bite);
+	ptr->fifo[ffp] = bite;
+	p = ptr->fifo + ((ffp-CTABLES) & FIFOMASK);
+	*p = bit_reverse(*p);
+}
+
+extern void dsd2pcm_translate_4(
+	dsd2pcm_ctx* const ptr[4],
+	size_t samples,
+	const unsigned char *src, ptrdiff_t src_stride,
+	int lsbf,
+	float *dst, ptrdiff_t dst_stride)
+{
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+	unsigned ffp;
+	unsigned i, c;
+	unsigned idx1, idx2;
+	float t1[4], t2[4];
+	ffp = ptr[0]->fifopos;
+	if (ptr[1]->fifopos != ffp || ptr[2]->fifopos != ffp ||
+	    ptr[3]->fifopos != ffp)
+		goto fallback;
+	lsbf = lsbf ? 1 : 0;
+	while (samples-- > 0) {
+#if defined(__SSE2__)
+		__m128d acc_lo = _mm_setzero_pd(), acc_hi = _mm_setzero_pd();
+		__m128 s;
+#else
+		float64x2_t acc_lo = vdupq_n_f64(0), acc_hi = vdupq_n_f64(0);
+		float32x4_t s;
+#endif
+		for (c=0; c<4; ++c)
+			dsd2pcm_push(ptr[c], ffp, src[c] & 0xFFu, lsbf);
+		src += src_stride;
+		/* the same computation as in dsd2pcm_translate(), with
+		   one channel per vector lane; the float sums are
+		   accumulated as double in the same order, so the
+		   result is identical */
+		for (i=0; i<CTABLES; ++i) {
+			idx1 = (ffp              -i) & FIFOMASK;
+			idx2 = (ffp-(CTABLES*2-1)+i) & FIFOMASK;
+			for (c=0; c<4; ++c) {
+				t1[c] = ctables[i][ptr[c]->fifo[idx1]];
+				t2[c] = ctables[i][ptr[c]->fifo[idx2]];
+			}
+#if defined(__SSE2__)
+			s = _mm_add_ps(_mm_loadu_ps(t1), _mm_loadu_ps(t2));
+			acc_lo = _mm_add_pd(acc_lo, _mm_cvtps_pd(s));
+			acc_hi = _mm_add_pd(acc_hi,
+					    _mm_cvtps_pd(_mm_movehl_ps(s, s)));
+#else
+			s = vaddq_f32(vld1q_f32(t1), vld1q_f32(t2));
+			acc_lo = vaddq_f64(acc_lo,
+					   vcvt_f64_f32(vget_low_f32(s)));
+			acc_hi = vaddq_f64(acc_hi, vcvt_high_f64_f32(s));
+#endif
+		}
+#if defined(__SSE2__)
+		_mm_storeu_ps(dst, _mm_movelh_ps(_mm_cvtpd_ps(acc_lo),
+						 _mm_cvtpd_ps(acc_hi)));
+#else
+		vst1q_f32(dst, vcvt_high_f32_f64(vcvt_f32_f64(acc_lo),
+						 acc_hi));
+#endif
+		dst += dst_stride;
+		ffp = (ffp + 1) & FIFOMASK;
+	}
+	for (c=0; c<4; ++c)
+		ptr[c]->fifopos = ffp;
+	return;
+fallback:
+#endif
+	{
+		unsigned ch;
+		for (ch=0; ch<4; ++ch)
+			dsd2pcm_translate(ptr[ch], samples,
+					  src + ch, src_stride,
+					  lsbf, dst + ch, dst_stride);
+	}
+}
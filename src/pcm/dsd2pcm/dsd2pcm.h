@@ -56,6 +56,22 @@ extern void dsd2pcm_translate(dsd2pcm_ctx *ctx,
 	int lsbitfirst,
 	float *dst, ptrdiff_t dst_stride);
 
+/**
+ * like dsd2pcm_translate(), but for four adjacent channels at once;
+ * the result is identical, but it is vectorised where SSE2 or
+ * AArch64 NEON is available
+ * @param ctx -- the contexts of the four channels
+ * @param src -- pointer to the first octet of the first channel;
+ * the other three channels follow directly
+ * @param dst -- pointer to the first float of the first channel;
+ * the other three channels follow directly
+ */
+extern void dsd2pcm_translate_4(dsd2pcm_ctx *const ctx[4],
+	size_t samples,
+	const unsigned char *src, ptrdiff_t src_stride,
+	int lsbitfirst,
+	float *dst, ptrdiff_t dst_stride);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
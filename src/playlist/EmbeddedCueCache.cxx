@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "EmbeddedCueCache.hxx"
+
+EmbeddedCueCache embcue_cache;
+
+bool
+EmbeddedCueCache::Get(const char *path, time_t mtime,
+		      std::forward_list<DetachedSong> &songs)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(path);
+	if (i == map.end())
+		return false;
+
+	if (i->second.mtime != mtime) {
+		/* the file has been modified */
+		map.erase(i);
+		return false;
+	}
+
+	songs = std::forward_list<DetachedSong>(i->second.songs);
+	return true;
+}
+
+void
+EmbeddedCueCache::Put(const char *path, time_t mtime,
+		      std::forward_list<DetachedSong> &&songs)
+{
+	const ScopeLock protect(mutex);
+
+	Entry &entry = map[path];
+	entry.mtime = mtime;
+	entry.songs = std::move(songs);
+}
+
+void
+EmbeddedCueCache::Remove(const char *path)
+{
+	const ScopeLock protect(mutex);
+	map.erase(path);
+}
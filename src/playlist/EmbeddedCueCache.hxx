@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_EMBEDDED_CUE_CACHE_HXX
+#define MPD_EMBEDDED_CUE_CACHE_HXX
+
+#include "check.h"
+#include "DetachedSong.hxx"
+#include "thread/Mutex.hxx"
+
+#include <forward_list>
+#include <unordered_map>
+#include <string>
+
+#include <time.h>
+
+/**
+ * Remembers the parsed embedded cue sheets of song files, keyed on
+ * the absolute path and the modification time of the file.  It is
+ * filled by the database update and by the "embcue" playlist
+ * plugin, which then lists the virtual tracks without scanning the
+ * file's tags and parsing the cue sheet again.
+ *
+ * This class is thread-safe.
+ */
+class EmbeddedCueCache {
+	struct Entry {
+		time_t mtime;
+
+		/**
+		 * The parsed tracks; their URIs are the base name of
+		 * the file.
+		 */
+		std::forward_list<DetachedSong> songs;
+	};
+
+	Mutex mutex;
+
+	std::unordered_map<std::string, Entry> map;
+
+public:
+	EmbeddedCueCache() = default;
+	EmbeddedCueCache(const EmbeddedCueCache &) = delete;
+	EmbeddedCueCache &operator=(const EmbeddedCueCache &) = delete;
+
+	/**
+	 * Copy the tracks of the given file into the list.
+	 *
+	 * @return false if there is no entry for this file, or if it
+	 * is outdated
+	 */
+	bool Get(const char *path, time_t mtime,
+		 std::forward_list<DetachedSong> &songs);
+
+	void Put(const char *path, time_t mtime,
+		 std::forward_list<DetachedSong> &&songs);
+
+	void Remove(const char *path);
+};
+
+/**
+ * The cache used by #embcue_playlist_plugin.
+ */
+extern EmbeddedCueCache embcue_cache;
+
+#endif
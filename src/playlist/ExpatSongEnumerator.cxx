@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ExpatSongEnumerator.hxx"
+#include "input/InputStream.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+bool
+ExpatSongEnumerator::ReadChunk(Error &error)
+{
+	assert(!eof);
+
+	char buffer[4096];
+	size_t nbytes = is.LockRead(buffer, sizeof(buffer), error);
+	if (nbytes == 0) {
+		eof = true;
+		return !error.IsDefined() &&
+			expat.Parse("", 0, true, error);
+	}
+
+	if (!expat.Parse(buffer, nbytes, false, error)) {
+		eof = true;
+		return false;
+	}
+
+	return true;
+}
+
+bool
+ExpatSongEnumerator::Fill(Error &error)
+{
+	while (songs.empty() && !eof)
+		if (!ReadChunk(error))
+			return false;
+
+	return true;
+}
+
+DetachedSong *
+ExpatSongEnumerator::NextSong()
+{
+	Error error;
+	if (!Fill(error))
+		/* return the songs which have been parsed before the
+		   error */
+		LogError(error);
+
+	if (songs.empty())
+		return nullptr;
+
+	auto result = new DetachedSong(std::move(songs.front()));
+	songs.pop_front();
+	return result;
+}
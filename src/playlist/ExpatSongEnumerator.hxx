@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EXPAT_SONG_ENUMERATOR_HXX
+#define MPD_EXPAT_SONG_ENUMERATOR_HXX
+
+#include "check.h"
+#include "SongEnumerator.hxx"
+#include "DetachedSong.hxx"
+#include "lib/expat/ExpatParser.hxx"
+
+#include <list>
+
+class InputStream;
+class Error;
+
+/**
+ * A #SongEnumerator which parses an XML document with expat while it
+ * is being enumerated.  The element handlers (installed by the
+ * plugin) pass songs to AddSong(); NextSong() reads only as much
+ * input as is needed to obtain the next one.  This way, the
+ * first song of a large (remote) document is available before the
+ * rest has been downloaded, and memory usage does not depend on the
+ * size of the document.
+ *
+ * The #InputStream must remain valid until this object is deleted.
+ */
+class ExpatSongEnumerator : public SongEnumerator {
+	InputStream &is;
+
+	ExpatParser expat;
+
+	/**
+	 * Has the end of the document been reached (or has an error
+	 * occurred)?
+	 */
+	bool eof;
+
+	/**
+	 * Songs which have been parsed, but not yet been returned by
+	 * NextSong().
+	 */
+	std::list<DetachedSong> songs;
+
+protected:
+	ExpatSongEnumerator(InputStream &_is)
+		:is(_is), expat(this), eof(false) {}
+
+public:
+	/**
+	 * Cast the "user_data" parameter of an expat callback to the
+	 * derived class.
+	 */
+	template<typename T>
+	static T &FromUserData(void *user_data) {
+		return static_cast<T &>(*(ExpatSongEnumerator *)user_data);
+	}
+
+	/**
+	 * Called by the element handlers.
+	 */
+	void AddSong(DetachedSong &&song) {
+		songs.emplace_back(std::move(song));
+	}
+
+	void SetElementHandler(XML_StartElementHandler start,
+			       XML_EndElementHandler end) {
+		expat.SetElementHandler(start, end);
+	}
+
+	void SetCharacterDataHandler(XML_CharacterDataHandler charhndl) {
+		expat.SetCharacterDataHandler(charhndl);
+	}
+
+	/**
+	 * Parse the document until at least one song is available or
+	 * until the end of the document has been reached.  Call this
+	 * after opening the document to find out whether it can be
+	 * parsed at all.
+	 *
+	 * @return false on error
+	 */
+	bool Fill(Error &error);
+
+	virtual DetachedSong *NextSong() override;
+
+private:
+	/**
+	 * Read the next chunk from the #InputStream and pass it to
+	 * the parser.
+	 *
+	 * @return false on error
+	 */
+	bool ReadChunk(Error &error);
+};
+
+#endif
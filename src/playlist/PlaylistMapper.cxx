@@ -41,6 +41,8 @@ playlist_open_in_playlist_dir(const char *uri, Mutex &mutex, Cond &cond)
 	if (path_fs.IsNull())
 		return nullptr;
 
+	spl_flush(uri);
+
 	return playlist_open_path(path_fs.c_str(), mutex, cond);
 }
 
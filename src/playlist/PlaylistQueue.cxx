@@ -29,10 +29,35 @@
 #include "fs/Traits.hxx"
 #include "util/Error.hxx"
 
+#include <list>
+
 #ifdef ENABLE_DATABASE
 #include "SongLoader.hxx"
 #endif
 
+/**
+ * The number of songs which are appended to the queue at a time by
+ * playlist_open_into_queue_async().
+ */
+static constexpr unsigned PLAYLIST_LOAD_BATCH = 256;
+
+/**
+ * Resolve a song from a playlist and append it to the queue.
+ *
+ * @return false on a fatal error (e.g. the queue is full), true on
+ * success or if the song was skipped
+ */
+static bool
+playlist_append_song(DetachedSong &&song, const char *base_uri,
+		     playlist &dest, PlayerControl &pc,
+		     const SongLoader &loader, Error &error)
+{
+	if (!playlist_check_translate_song(song, base_uri, loader))
+		return true;
+
+	return dest.AppendSong(pc, std::move(song), error) != 0;
+}
+
 bool
 playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			 unsigned start_index, unsigned end_index,
@@ -44,6 +69,9 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 		? PathTraitsUTF8::GetParent(uri)
 		: std::string(".");
 
+	dest.BeginBatch();
+
+	bool success = true;
 	DetachedSong *song;
 	for (unsigned i = 0;
 	     i < end_index && (song = e.NextSong()) != nullptr;
@@ -54,19 +82,32 @@ playlist_load_into_queue(const char *uri, SongEnumerator &e,
 			continue;
 		}
 
-		if (!playlist_check_translate_song(*song, base_uri.c_str(),
-						   loader)) {
-			delete song;
-			continue;
-		}
-
-		unsigned id = dest.AppendSong(pc, std::move(*song), error);
+		success = playlist_append_song(std::move(*song),
+					       base_uri.c_str(),
+					       dest, pc, loader, error);
 		delete song;
-		if (id == 0)
-			return false;
+		if (!success)
+			break;
 	}
 
-	return true;
+	dest.CommitBatch(pc);
+	return success;
+}
+
+static SongEnumerator *
+playlist_open_for_queue(const char *uri, gcc_unused const SongLoader &loader,
+			Mutex &mutex, Cond &cond, Error &error)
+{
+	auto playlist = playlist_open_any(uri,
+#ifdef ENABLE_DATABASE
+					  loader.GetStorage(),
+#endif
+					  mutex, cond);
+	if (playlist == nullptr)
+		error.Set(playlist_domain, int(PlaylistResult::NO_SUCH_LIST),
+			  "No such playlist");
+
+	return playlist;
 }
 
 bool
@@ -79,16 +120,10 @@ playlist_open_into_queue(const char *uri,
 	Mutex mutex;
 	Cond cond;
 
-	auto playlist = playlist_open_any(uri,
-#ifdef ENABLE_DATABASE
-					  loader.GetStorage(),
-#endif
-					  mutex, cond);
-	if (playlist == nullptr) {
-		error.Set(playlist_domain, int(PlaylistResult::NO_SUCH_LIST),
-			  "No such playlist");
+	auto playlist = playlist_open_for_queue(uri, loader,
+						mutex, cond, error);
+	if (playlist == nullptr)
 		return false;
-	}
 
 	bool result =
 		playlist_load_into_queue(uri, *playlist,
@@ -97,3 +132,85 @@ playlist_open_into_queue(const char *uri,
 	delete playlist;
 	return result;
 }
+
+/**
+ * Pass a batch of songs to the main thread, which resolves them
+ * (this may need the database, which must not be used by this
+ * thread) and appends them to the queue.
+ */
+static bool
+playlist_submit_batch(std::list<DetachedSong> &batch, const char *base_uri,
+		      playlist &dest, PlayerControl &pc,
+		      const SongLoader &loader, const MainThreadCall &call,
+		      Error &error)
+{
+	bool success = true;
+	const std::function<void()> f = [&](){
+		dest.BeginBatch();
+
+		for (auto &song : batch) {
+			success = playlist_append_song(std::move(song),
+						       base_uri, dest, pc,
+						       loader, error);
+			if (!success)
+				break;
+		}
+
+		dest.CommitBatch(pc);
+	};
+
+	if (!call(f)) {
+		error.Set(playlist_domain, "Cancelled");
+		success = false;
+	}
+
+	batch.clear();
+	return success;
+}
+
+bool
+playlist_open_into_queue_async(const char *uri,
+			       unsigned start_index, unsigned end_index,
+			       playlist &dest, PlayerControl &pc,
+			       const SongLoader &loader,
+			       const MainThreadCall &call,
+			       Error &error)
+{
+	Mutex mutex;
+	Cond cond;
+
+	auto e = playlist_open_for_queue(uri, loader, mutex, cond, error);
+	if (e == nullptr)
+		return false;
+
+	const std::string base_uri = PathTraitsUTF8::GetParent(uri);
+
+	std::list<DetachedSong> batch;
+	bool success = true;
+	DetachedSong *song;
+	for (unsigned i = 0;
+	     i < end_index && (song = e->NextSong()) != nullptr;
+	     ++i) {
+		if (i >= start_index)
+			batch.emplace_back(std::move(*song));
+		delete song;
+
+		if (batch.size() >= PLAYLIST_LOAD_BATCH) {
+			success = playlist_submit_batch(batch,
+							base_uri.c_str(),
+							dest, pc, loader,
+							call, error);
+			if (!success)
+				break;
+		}
+	}
+
+	delete e;
+
+	if (success && !batch.empty())
+		success = playlist_submit_batch(batch, base_uri.c_str(),
+						dest, pc, loader,
+						call, error);
+
+	return success;
+}
@@ -26,12 +26,21 @@
 
 #include "PlaylistError.hxx"
 
+#include <functional>
+
 class Error;
 class SongLoader;
 class SongEnumerator;
 struct playlist;
 struct PlayerControl;
 
+/**
+ * Invokes the given function in the main thread and waits for it to
+ * return.  Returns false if the function was not invoked, e.g.
+ * because the operation has been cancelled.
+ */
+typedef std::function<bool(const std::function<void()> &)> MainThreadCall;
+
 /**
  * Loads the contents of a playlist and append it to the specified
  * play queue.
@@ -58,5 +67,20 @@ playlist_open_into_queue(const char *uri,
 			 playlist &dest, PlayerControl &pc,
 			 const SongLoader &loader, Error &error);
 
+/**
+ * Like playlist_open_into_queue(), but called by a thread other than
+ * the main thread.  The playlist is opened and parsed in the calling
+ * thread; batches of songs are resolved and appended by the main
+ * thread through #call.  Each batch results in one queue version,
+ * which lets clients watch the progress.
+ */
+bool
+playlist_open_into_queue_async(const char *uri,
+			       unsigned start_index, unsigned end_index,
+			       playlist &dest, PlayerControl &pc,
+			       const SongLoader &loader,
+			       const MainThreadCall &call,
+			       Error &error);
+
 #endif
 
@@ -20,7 +20,7 @@
 #include "config.h"
 #include "AsxPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "tag/TagBuilder.hxx"
 #include "util/ASCII.hxx"
 #include "util/Error.hxx"
@@ -30,13 +30,7 @@
 /**
  * This is the state object for the GLib XML parser.
  */
-struct AsxParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+struct AsxParser final : ExpatSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -58,16 +52,16 @@ struct AsxParser {
 
 	TagBuilder tag_builder;
 
-	AsxParser()
-		:state(ROOT) {}
-
+	AsxParser(InputStream &_is)
+		:ExpatSongEnumerator(_is), state(ROOT) {}
 };
 
 static void XMLCALL
 asx_start_element(void *user_data, const XML_Char *element_name,
 		  const XML_Char **atts)
 {
-	AsxParser *parser = (AsxParser *)user_data;
+	AsxParser *parser =
+		&ExpatSongEnumerator::FromUserData<AsxParser>(user_data);
 
 	switch (parser->state) {
 	case AsxParser::ROOT:
@@ -99,7 +93,8 @@ asx_start_element(void *user_data, const XML_Char *element_name,
 static void XMLCALL
 asx_end_element(void *user_data, const XML_Char *element_name)
 {
-	AsxParser *parser = (AsxParser *)user_data;
+	AsxParser *parser =
+		&ExpatSongEnumerator::FromUserData<AsxParser>(user_data);
 
 	switch (parser->state) {
 	case AsxParser::ROOT:
@@ -108,8 +103,8 @@ asx_end_element(void *user_data, const XML_Char *element_name)
 	case AsxParser::ENTRY:
 		if (StringEqualsCaseASCII(element_name, "entry")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->AddSong(DetachedSong(std::move(parser->location),
+							     parser->tag_builder.Commit()));
 
 			parser->state = AsxParser::ROOT;
 		} else
@@ -122,7 +117,8 @@ asx_end_element(void *user_data, const XML_Char *element_name)
 static void XMLCALL
 asx_char_data(void *user_data, const XML_Char *s, int len)
 {
-	AsxParser *parser = (AsxParser *)user_data;
+	AsxParser *parser =
+		&ExpatSongEnumerator::FromUserData<AsxParser>(user_data);
 
 	switch (parser->state) {
 	case AsxParser::ROOT:
@@ -144,22 +140,18 @@ asx_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 asx_open_stream(InputStream &is)
 {
-	AsxParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(asx_start_element, asx_end_element);
-		expat.SetCharacterDataHandler(asx_char_data);
-
-		Error error;
-		if (!expat.Parse(is, error)) {
-			LogError(error);
-			return nullptr;
-		}
+	AsxParser *parser = new AsxParser(is);
+	parser->SetElementHandler(asx_start_element, asx_end_element);
+	parser->SetCharacterDataHandler(asx_char_data);
+
+	Error error;
+	if (!parser->Fill(error)) {
+		delete parser;
+		LogError(error);
+		return nullptr;
 	}
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return parser;
 }
 
 static const char *const asx_suffixes[] = {
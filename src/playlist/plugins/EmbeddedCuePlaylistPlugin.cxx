@@ -26,7 +26,8 @@
 #include "config.h"
 #include "EmbeddedCuePlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../SongEnumerator.hxx"
+#include "../MemorySongEnumerator.hxx"
+#include "../EmbeddedCueCache.hxx"
 #include "../cue/CueParser.hxx"
 #include "tag/TagHandler.hxx"
 #include "tag/TagId3.hxx"
@@ -35,51 +36,19 @@
 #include "TagFile.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
 #include "util/ASCII.hxx"
 
 #include <string.h>
 
-class EmbeddedCuePlaylist final : public SongEnumerator {
-public:
-	/**
-	 * This is an override for the CUE's "FILE".  An embedded CUE
-	 * sheet must always point to the song file it is contained
-	 * in.
-	 */
-	std::string filename;
-
-	/**
-	 * The value of the file's "CUESHEET" tag.
-	 */
-	std::string cuesheet;
-
-	/**
-	 * The offset of the next line within "cuesheet".
-	 */
-	char *next;
-
-	CueParser *parser;
-
-public:
-	EmbeddedCuePlaylist()
-		:parser(nullptr) {
-	}
-
-	virtual ~EmbeddedCuePlaylist() {
-		delete parser;
-	}
-
-	virtual DetachedSong *NextSong() override;
-};
-
 static void
 embcue_tag_pair(const char *name, const char *value, void *ctx)
 {
-	EmbeddedCuePlaylist *playlist = (EmbeddedCuePlaylist *)ctx;
+	std::string &cuesheet = *(std::string *)ctx;
 
-	if (playlist->cuesheet.empty() &&
+	if (cuesheet.empty() &&
 	    StringEqualsCaseASCII(name, "cuesheet"))
-		playlist->cuesheet = value;
+		cuesheet = value;
 }
 
 static const struct tag_handler embcue_tag_handler = {
@@ -88,49 +57,48 @@ static const struct tag_handler embcue_tag_handler = {
 	embcue_tag_pair,
 };
 
-static SongEnumerator *
-embcue_playlist_open_uri(const char *uri,
-			 gcc_unused Mutex &mutex,
-			 gcc_unused Cond &cond)
+/**
+ * Append the song which was completed by the #CueParser (if any) to
+ * the (reversed) list.
+ *
+ * @param filename this is an override for the CUE's "FILE"; an
+ * embedded CUE sheet must always point to the song file it is
+ * contained in
+ */
+static void
+embcue_get_song(CueParser &parser, const std::string &filename,
+		std::forward_list<DetachedSong> &songs)
 {
-	if (!PathTraitsUTF8::IsAbsolute(uri))
-		/* only local files supported */
-		return nullptr;
-
-	const auto path_fs = AllocatedPath::FromUTF8(uri);
-	if (path_fs.IsNull())
-		return nullptr;
+	DetachedSong *song;
+	while ((song = parser.Get()) != nullptr) {
+		song->SetURI(filename);
+		songs.emplace_front(std::move(*song));
+		delete song;
+	}
+}
 
-	const auto playlist = new EmbeddedCuePlaylist();
+bool
+embcue_playlist_load(Path path_fs, std::forward_list<DetachedSong> &songs)
+{
+	std::string cuesheet;
 
-	tag_file_scan(path_fs, embcue_tag_handler, playlist);
-	if (playlist->cuesheet.empty()) {
-		tag_ape_scan2(path_fs, &embcue_tag_handler, playlist);
-		if (playlist->cuesheet.empty())
-			tag_id3_scan(path_fs, &embcue_tag_handler, playlist);
+	tag_file_scan(path_fs, embcue_tag_handler, &cuesheet);
+	if (cuesheet.empty()) {
+		tag_ape_scan2(path_fs, &embcue_tag_handler, &cuesheet);
+		if (cuesheet.empty())
+			tag_id3_scan(path_fs, &embcue_tag_handler, &cuesheet);
 	}
 
-	if (playlist->cuesheet.empty()) {
+	if (cuesheet.empty())
 		/* no "CUESHEET" tag found */
-		delete playlist;
-		return nullptr;
-	}
+		return false;
 
-	playlist->filename = PathTraitsUTF8::GetBase(uri);
+	const std::string filename =
+		PathTraitsUTF8::GetBase(path_fs.ToUTF8().c_str());
 
-	playlist->next = &playlist->cuesheet[0];
-	playlist->parser = new CueParser();
-
-	return playlist;
-}
-
-DetachedSong *
-EmbeddedCuePlaylist::NextSong()
-{
-	DetachedSong *song = parser->Get();
-	if (song != nullptr)
-		return song;
+	CueParser parser;
 
+	char *next = &cuesheet[0];
 	while (*next != 0) {
 		const char *line = next;
 		char *eol = strpbrk(next, "\r\n");
@@ -143,19 +111,56 @@ EmbeddedCuePlaylist::NextSong()
 			   end of the buffer */
 			next += strlen(line);
 
-		parser->Feed(line);
-		song = parser->Get();
-		if (song != nullptr) {
-			song->SetURI(filename);
-			return song;
-		}
+		parser.Feed(line);
+		embcue_get_song(parser, filename, songs);
 	}
 
-	parser->Finish();
-	song = parser->Get();
-	if (song != nullptr)
-		song->SetURI(filename);
-	return song;
+	parser.Finish();
+	embcue_get_song(parser, filename, songs);
+
+	songs.reverse();
+	return true;
+}
+
+void
+embcue_playlist_update(Path path_fs, time_t mtime)
+{
+	std::forward_list<DetachedSong> songs;
+	if (embcue_playlist_load(path_fs, songs))
+		embcue_cache.Put(path_fs.c_str(), mtime, std::move(songs));
+	else
+		embcue_cache.Remove(path_fs.c_str());
+}
+
+static SongEnumerator *
+embcue_playlist_open_uri(const char *uri,
+			 gcc_unused Mutex &mutex,
+			 gcc_unused Cond &cond)
+{
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		/* only local files supported */
+		return nullptr;
+
+	const auto path_fs = AllocatedPath::FromUTF8(uri);
+	if (path_fs.IsNull())
+		return nullptr;
+
+	struct stat st;
+	if (!StatFile(path_fs, st) || !S_ISREG(st.st_mode)) {
+		embcue_cache.Remove(uri);
+		return nullptr;
+	}
+
+	std::forward_list<DetachedSong> songs;
+	if (!embcue_cache.Get(uri, st.st_mtime, songs)) {
+		if (!embcue_playlist_load(path_fs, songs))
+			return nullptr;
+
+		embcue_cache.Put(uri, st.st_mtime,
+				 std::forward_list<DetachedSong>(songs));
+	}
+
+	return new MemorySongEnumerator(std::move(songs));
 }
 
 static const char *const embcue_playlist_suffixes[] = {
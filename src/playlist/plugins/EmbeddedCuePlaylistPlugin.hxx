@@ -20,6 +20,32 @@
 #ifndef MPD_EMBCUE_PLAYLIST_PLUGIN_HXX
 #define MPD_EMBCUE_PLAYLIST_PLUGIN_HXX
 
+#include "DetachedSong.hxx"
+
+#include <forward_list>
+
+#include <time.h>
+
+class Path;
+
 extern const struct playlist_plugin embcue_playlist_plugin;
 
+/**
+ * Read the "CUESHEET" tag of a song file and parse it.
+ *
+ * @param songs the list to store the tracks in
+ * @return false if the file has no embedded cue sheet
+ */
+bool
+embcue_playlist_load(Path path_fs, std::forward_list<DetachedSong> &songs);
+
+/**
+ * Parse the embedded cue sheet of a song file and store it in
+ * #embcue_cache, so the plugin does not need to scan the file when
+ * it is opened.  This is called by the database update for song
+ * files which have a "CUESHEET" tag.
+ */
+void
+embcue_playlist_update(Path path_fs, time_t mtime);
+
 #endif
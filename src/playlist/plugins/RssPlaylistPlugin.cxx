@@ -20,7 +20,7 @@
 #include "config.h"
 #include "RssPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "tag/TagBuilder.hxx"
 #include "util/ASCII.hxx"
 #include "util/Error.hxx"
@@ -30,13 +30,7 @@
 /**
  * This is the state object for the GLib XML parser.
  */
-struct RssParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+struct RssParser final : ExpatSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -59,15 +53,16 @@ struct RssParser {
 
 	TagBuilder tag_builder;
 
-	RssParser()
-		:state(ROOT) {}
+	RssParser(InputStream &_is)
+		:ExpatSongEnumerator(_is), state(ROOT) {}
 };
 
 static void XMLCALL
 rss_start_element(void *user_data, const XML_Char *element_name,
 		  const XML_Char **atts)
 {
-	RssParser *parser = (RssParser *)user_data;
+	RssParser *parser =
+		&ExpatSongEnumerator::FromUserData<RssParser>(user_data);
 
 	switch (parser->state) {
 	case RssParser::ROOT:
@@ -97,7 +92,8 @@ rss_start_element(void *user_data, const XML_Char *element_name,
 static void XMLCALL
 rss_end_element(void *user_data, const XML_Char *element_name)
 {
-	RssParser *parser = (RssParser *)user_data;
+	RssParser *parser =
+		&ExpatSongEnumerator::FromUserData<RssParser>(user_data);
 
 	switch (parser->state) {
 	case RssParser::ROOT:
@@ -106,8 +102,8 @@ rss_end_element(void *user_data, const XML_Char *element_name)
 	case RssParser::ITEM:
 		if (StringEqualsCaseASCII(element_name, "item")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->AddSong(DetachedSong(std::move(parser->location),
+							     parser->tag_builder.Commit()));
 
 			parser->state = RssParser::ROOT;
 		} else
@@ -120,7 +116,8 @@ rss_end_element(void *user_data, const XML_Char *element_name)
 static void XMLCALL
 rss_char_data(void *user_data, const XML_Char *s, int len)
 {
-	RssParser *parser = (RssParser *)user_data;
+	RssParser *parser =
+		&ExpatSongEnumerator::FromUserData<RssParser>(user_data);
 
 	switch (parser->state) {
 	case RssParser::ROOT:
@@ -142,22 +139,18 @@ rss_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 rss_open_stream(InputStream &is)
 {
-	RssParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(rss_start_element, rss_end_element);
-		expat.SetCharacterDataHandler(rss_char_data);
-
-		Error error;
-		if (!expat.Parse(is, error)) {
-			LogError(error);
-			return nullptr;
-		}
+	RssParser *parser = new RssParser(is);
+	parser->SetElementHandler(rss_start_element, rss_end_element);
+	parser->SetCharacterDataHandler(rss_char_data);
+
+	Error error;
+	if (!parser->Fill(error)) {
+		delete parser;
+		LogError(error);
+		return nullptr;
 	}
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return parser;
 }
 
 static const char *const rss_suffixes[] = {
@@ -20,7 +20,8 @@
 #include "config.h"
 #include "SoundCloudPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../SongEnumerator.hxx"
+#include "DetachedSong.hxx"
 #include "config/ConfigData.hxx"
 #include "input/InputStream.hxx"
 #include "tag/TagBuilder.hxx"
@@ -33,6 +34,7 @@
 #include <yajl/yajl_parse.h>
 
 #include <string>
+#include <list>
 
 #include <string.h>
 
@@ -107,7 +109,11 @@ struct parse_data {
 	char* title;
 	int got_url; /* nesting level of last stream_url */
 
-	std::forward_list<DetachedSong> songs;
+	/**
+	 * Songs which have been parsed, but not yet been returned by
+	 * SoundCloudSongEnumerator::NextSong().
+	 */
+	std::list<DetachedSong> songs;
 };
 
 static int
@@ -219,7 +225,7 @@ handle_end_map(void *ctx)
 	if (data->title != nullptr)
 		tag.AddItem(TAG_NAME, data->title);
 
-	data->songs.emplace_front(u, tag.Commit());
+	data->songs.emplace_back(u, tag.Commit());
 	g_free(u);
 
 	return 1;
@@ -240,73 +246,128 @@ static yajl_callbacks parse_callbacks = {
 };
 
 /**
- * Read JSON data and parse it using the given YAJL parser.
- * @param url URL of the JSON data.
- * @param hand YAJL parser handle.
- * @return -1 on error, 0 on success.
+ * Parses the JSON response while it is being enumerated: NextSong()
+ * reads only as much input as is needed to obtain the next track, so
+ * the first songs of a large user or playlist resolve are available
+ * before the rest has been downloaded.
  */
-static int
-soundcloud_parse_json(const char *url, yajl_handle hand,
-		      Mutex &mutex, Cond &cond)
-{
-	Error error;
-	InputStream *input_stream = InputStream::OpenReady(url, mutex, cond,
-							   error);
-	if (input_stream == nullptr) {
-		if (error.IsDefined())
-			LogError(error);
-		return -1;
+class SoundCloudSongEnumerator final : public SongEnumerator {
+	InputStream *const input_stream;
+
+	yajl_handle hand;
+
+	struct parse_data data;
+
+	/**
+	 * Has the end of the response been reached (or has an error
+	 * occurred)?
+	 */
+	bool eof;
+
+public:
+	explicit SoundCloudSongEnumerator(InputStream *_input_stream)
+		:input_stream(_input_stream), eof(false) {
+		data.got_url = 0;
+		data.title = nullptr;
+		data.stream_url = nullptr;
+#ifdef HAVE_YAJL1
+		hand = yajl_alloc(&parse_callbacks, nullptr, nullptr, &data);
+#else
+		hand = yajl_alloc(&parse_callbacks, nullptr, &data);
+#endif
+	}
+
+	virtual ~SoundCloudSongEnumerator() {
+		yajl_free(hand);
+		g_free(data.title);
+		g_free(data.stream_url);
+		delete input_stream;
 	}
 
-	mutex.lock();
+	/**
+	 * Parse the response until at least one song is available or
+	 * until its end has been reached.
+	 *
+	 * @return false on error
+	 */
+	bool Fill(Error &error);
+
+	virtual DetachedSong *NextSong() override;
+
+private:
+	/**
+	 * Read the next chunk from the #InputStream and pass it to
+	 * the YAJL parser.
+	 *
+	 * @return false on error
+	 */
+	bool ReadChunk(Error &error);
+};
+
+bool
+SoundCloudSongEnumerator::ReadChunk(Error &error)
+{
+	assert(!eof);
+
+	unsigned char buffer[4096];
+	const size_t nbytes =
+		input_stream->LockRead(buffer, sizeof(buffer), error);
 
 	yajl_status stat;
-	int done = 0;
-
-	while (!done) {
-		char buffer[4096];
-		unsigned char *ubuffer = (unsigned char *)buffer;
-		const size_t nbytes =
-			input_stream->Read(buffer, sizeof(buffer), error);
-		if (nbytes == 0) {
-			if (error.IsDefined())
-				LogError(error);
-
-			if (input_stream->IsEOF()) {
-				done = true;
-			} else {
-				mutex.unlock();
-				delete input_stream;
-				return -1;
-			}
-		}
+	if (nbytes == 0) {
+		eof = true;
+		if (error.IsDefined())
+			return false;
 
-		if (done) {
 #ifdef HAVE_YAJL1
-			stat = yajl_parse_complete(hand);
+		stat = yajl_parse_complete(hand);
 #else
-			stat = yajl_complete_parse(hand);
+		stat = yajl_complete_parse(hand);
 #endif
-		} else
-			stat = yajl_parse(hand, ubuffer, nbytes);
+	} else
+		stat = yajl_parse(hand, buffer, nbytes);
 
-		if (stat != yajl_status_ok
+	if (stat != yajl_status_ok
 #ifdef HAVE_YAJL1
-		    && stat != yajl_status_insufficient_data
+	    && stat != yajl_status_insufficient_data
 #endif
-		    )
-		{
-			unsigned char *str = yajl_get_error(hand, 1, ubuffer, nbytes);
-			LogError(soundcloud_domain, (const char *)str);
-			yajl_free_error(hand, str);
-			break;
-		}
+	    )
+	{
+		unsigned char *str = yajl_get_error(hand, 1, buffer, nbytes);
+		error.Set(soundcloud_domain, (const char *)str);
+		yajl_free_error(hand, str);
+		eof = true;
+		return false;
 	}
 
-	mutex.unlock();
-	delete input_stream;
+	return true;
+}
+
+bool
+SoundCloudSongEnumerator::Fill(Error &error)
+{
+	while (data.songs.empty() && !eof)
+		if (!ReadChunk(error))
+			return false;
 
-	return 0;
+	return true;
+}
+
+DetachedSong *
+SoundCloudSongEnumerator::NextSong()
+{
+	Error error;
+	if (!Fill(error))
+		/* return the songs which have been parsed before the
+		   error */
+		LogError(error);
+
+	if (data.songs.empty())
+		return nullptr;
+
+	auto result = new DetachedSong(std::move(data.songs.front()));
+	data.songs.pop_front();
+	return result;
 }
 
 /**
@@ -355,29 +416,24 @@ soundcloud_open_uri(const char *uri, Mutex &mutex, Cond &cond)
 		return nullptr;
 	}
 
-	struct parse_data data;
-	data.got_url = 0;
-	data.title = nullptr;
-	data.stream_url = nullptr;
-#ifdef HAVE_YAJL1
-	yajl_handle hand = yajl_alloc(&parse_callbacks, nullptr, nullptr,
-				      &data);
-#else
-	yajl_handle hand = yajl_alloc(&parse_callbacks, nullptr, &data);
-#endif
-
-	int ret = soundcloud_parse_json(u, hand, mutex, cond);
-
+	Error error;
+	InputStream *input_stream = InputStream::OpenReady(u, mutex, cond,
+							   error);
 	g_free(u);
-	yajl_free(hand);
-	g_free(data.title);
-	g_free(data.stream_url);
+	if (input_stream == nullptr) {
+		if (error.IsDefined())
+			LogError(error);
+		return nullptr;
+	}
 
-	if (ret == -1)
+	auto playlist = new SoundCloudSongEnumerator(input_stream);
+	if (!playlist->Fill(error)) {
+		delete playlist;
+		LogError(error);
 		return nullptr;
+	}
 
-	data.songs.reverse();
-	return new MemorySongEnumerator(std::move(data.songs));
+	return playlist;
 }
 
 static const char *const soundcloud_schemes[] = {
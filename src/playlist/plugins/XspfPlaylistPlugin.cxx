@@ -20,7 +20,7 @@
 #include "config.h"
 #include "XspfPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../ExpatSongEnumerator.hxx"
 #include "DetachedSong.hxx"
 #include "input/InputStream.hxx"
 #include "tag/TagBuilder.hxx"
@@ -36,13 +36,7 @@ static constexpr Domain xspf_domain("xspf");
 /**
  * This is the state object for the GLib XML parser.
  */
-struct XspfParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+struct XspfParser final : ExpatSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -65,15 +59,16 @@ struct XspfParser {
 
 	TagBuilder tag_builder;
 
-	XspfParser()
-		:state(ROOT) {}
+	XspfParser(InputStream &_is)
+		:ExpatSongEnumerator(_is), state(ROOT) {}
 };
 
 static void XMLCALL
 xspf_start_element(void *user_data, const XML_Char *element_name,
 		   gcc_unused const XML_Char **atts)
 {
-	XspfParser *parser = (XspfParser *)user_data;
+	XspfParser *parser =
+		&ExpatSongEnumerator::FromUserData<XspfParser>(user_data);
 
 	switch (parser->state) {
 	case XspfParser::ROOT:
@@ -123,7 +118,8 @@ xspf_start_element(void *user_data, const XML_Char *element_name,
 static void XMLCALL
 xspf_end_element(void *user_data, const XML_Char *element_name)
 {
-	XspfParser *parser = (XspfParser *)user_data;
+	XspfParser *parser =
+		&ExpatSongEnumerator::FromUserData<XspfParser>(user_data);
 
 	switch (parser->state) {
 	case XspfParser::ROOT:
@@ -144,8 +140,8 @@ xspf_end_element(void *user_data, const XML_Char *element_name)
 	case XspfParser::TRACK:
 		if (strcmp(element_name, "track") == 0) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->AddSong(DetachedSong(std::move(parser->location),
+							     parser->tag_builder.Commit()));
 
 			parser->state = XspfParser::TRACKLIST;
 		} else
@@ -162,7 +158,8 @@ xspf_end_element(void *user_data, const XML_Char *element_name)
 static void XMLCALL
 xspf_char_data(void *user_data, const XML_Char *s, int len)
 {
-	XspfParser *parser = (XspfParser *)user_data;
+	XspfParser *parser =
+		&ExpatSongEnumerator::FromUserData<XspfParser>(user_data);
 
 	switch (parser->state) {
 	case XspfParser::ROOT:
@@ -192,22 +189,18 @@ xspf_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 xspf_open_stream(InputStream &is)
 {
-	XspfParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(xspf_start_element, xspf_end_element);
-		expat.SetCharacterDataHandler(xspf_char_data);
-
-		Error error;
-		if (!expat.Parse(is, error)) {
-			LogError(error);
-			return nullptr;
-		}
+	XspfParser *parser = new XspfParser(is);
+	parser->SetElementHandler(xspf_start_element, xspf_end_element);
+	parser->SetCharacterDataHandler(xspf_char_data);
+
+	Error error;
+	if (!parser->Fill(error)) {
+		delete parser;
+		LogError(error);
+		return nullptr;
 	}
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return parser;
 }
 
 static const char *const xspf_suffixes[] = {
@@ -23,8 +23,8 @@
 
 #include <assert.h>
 
-const char *current_command;
-int command_list_num;
+__thread const char *current_command;
+__thread int command_list_num;
 
 void
 command_success(Client &client)
@@ -28,8 +28,10 @@
 
 class Client;
 
-extern const char *current_command;
-extern int command_list_num;
+/* these are thread-local because read-only commands may be executed
+   by worker threads (see BackgroundCommand) */
+extern __thread const char *current_command;
+extern __thread int command_list_num;
 
 void
 command_success(Client &client);
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_CHANGE_LOG_HXX
+#define MPD_QUEUE_CHANGE_LOG_HXX
+
+#include "Compiler.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * A bounded log of the position ranges which were modified in a
+ * #Queue, and the version number they were modified with.  It
+ * allows answering "plchanges" without looking at every song.
+ *
+ * Ranges of the same version are merged.  A range which extends the
+ * previous one (e.g. songs being appended one by one) is merged with
+ * it as well, keeping the newer version; that makes the log a
+ * superset of the real changes, so the caller still has to check the
+ * version of each song.
+ */
+class QueueChangeLog {
+public:
+	static constexpr unsigned CAPACITY = 256;
+
+	struct Range {
+		unsigned start, end;
+	};
+
+private:
+	struct Entry {
+		uint32_t version;
+		unsigned start, end;
+	};
+
+	Entry entries[CAPACITY];
+
+	/**
+	 * The index where the next entry will be written.
+	 */
+	unsigned head;
+
+	unsigned count;
+
+	/**
+	 * All modifications with this version number or newer are
+	 * in the log.
+	 */
+	uint32_t covered_version;
+
+	/**
+	 * False if the log cannot be used at all, because the queue
+	 * version has wrapped around.
+	 */
+	bool valid;
+
+public:
+	QueueChangeLog() {
+		Clear();
+	}
+
+	/**
+	 * Forget all entries.  This may only be called when the
+	 * queue is empty.
+	 */
+	void Clear() {
+		head = 0;
+		count = 0;
+		covered_version = 0;
+		valid = true;
+	}
+
+	/**
+	 * Disable the log until the next Clear() call.
+	 */
+	void Invalidate() {
+		valid = false;
+	}
+
+	/**
+	 * Does the log know all modifications since the specified
+	 * version?
+	 */
+	gcc_pure
+	bool Covers(uint32_t version) const {
+		return valid && version >= covered_version;
+	}
+
+	void Add(uint32_t version, unsigned start, unsigned end) {
+		assert(start <= end);
+
+		if (!valid || start == end)
+			return;
+
+		if (count > 0) {
+			Entry &last = entries[(head + CAPACITY - 1) % CAPACITY];
+			assert(version >= last.version);
+
+			if (start == last.end ||
+			    (version == last.version &&
+			     start <= last.end && end >= last.start)) {
+				last.version = version;
+				last.start = std::min(last.start, start);
+				last.end = std::max(last.end, end);
+				return;
+			}
+		}
+
+		if (count == CAPACITY)
+			/* overwriting the oldest entry */
+			covered_version = std::max(covered_version,
+						   entries[head].version + 1);
+		else
+			++count;
+
+		Entry &e = entries[head];
+		e.version = version;
+		e.start = start;
+		e.end = end;
+
+		head = (head + 1) % CAPACITY;
+	}
+
+	/**
+	 * Obtain the sorted and merged position ranges which were
+	 * modified with the specified version or newer.  Must only be
+	 * called if Covers() returns true.
+	 *
+	 * @param length the current length of the queue; ranges are
+	 * clipped to it
+	 * @param buffer a buffer with room for #CAPACITY ranges
+	 * @return the number of ranges in the buffer
+	 */
+	unsigned Get(uint32_t version, unsigned length, Range *buffer) const {
+		assert(Covers(version));
+
+		unsigned n = 0;
+		for (unsigned i = 0; i < count; ++i) {
+			const Entry &e = entries[(head + CAPACITY - count + i)
+						 % CAPACITY];
+			if (e.version >= version && e.start < length) {
+				buffer[n].start = e.start;
+				buffer[n].end = std::min(e.end, length);
+				++n;
+			}
+		}
+
+		if (n == 0)
+			return 0;
+
+		std::sort(buffer, buffer + n,
+			  [](const Range &a, const Range &b){
+				  return a.start < b.start;
+			  });
+
+		unsigned m = 0;
+		for (unsigned i = 1; i < n; ++i) {
+			if (buffer[i].start <= buffer[m].end)
+				buffer[m].end = std::max(buffer[m].end,
+							 buffer[i].end);
+			else
+				buffer[++m] = buffer[i];
+		}
+
+		return m + 1;
+	}
+};
+
+#endif
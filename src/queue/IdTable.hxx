@@ -23,68 +23,110 @@
 #include "Compiler.h"
 
 #include <algorithm>
+#include <vector>
+#include <deque>
 
 #include <assert.h>
 
 /**
  * A table that maps id numbers to position numbers.
+ *
+ * New ids are handed out in ascending order, and the table grows
+ * with the number of ids in use.  Once it has reached its maximum
+ * size (or is sparse enough), freed ids are reused, the one which
+ * has been freed first goes first; this keeps an id unused for as
+ * long as possible, because clients may still refer to it.
  */
 class IdTable {
-	unsigned size;
-
+	/**
+	 * The upper limit for the size of #data.
+	 */
+	const unsigned max_size;
+
+	/**
+	 * Grow the table (instead of reusing freed ids) as long as it
+	 * has fewer than this number of slots per id in use.
+	 */
+	const unsigned sparseness;
+
+	/**
+	 * The lowest id which has never been used.
+	 */
 	unsigned next;
 
-	int *data;
+	/**
+	 * The number of ids currently in use.
+	 */
+	unsigned n_used;
 
-public:
-	IdTable(unsigned _size):size(_size), next(1), data(new int[size]) {
-		std::fill_n(data, size, -1);
-	}
+	/**
+	 * Maps ids to positions; -1 means the id is unused.  Id 0 is
+	 * never used.
+	 */
+	std::vector<int> data;
 
-	~IdTable() {
-		delete[] data;
-	}
+	/**
+	 * Ids which have been freed and not yet reused, in the order
+	 * they have been freed.
+	 */
+	std::deque<unsigned> free_ids;
+
+public:
+	IdTable(unsigned _max_size, unsigned _sparseness)
+		:max_size(_max_size), sparseness(_sparseness),
+		 next(1), n_used(0), data(1, -1) {}
 
 	int IdToPosition(unsigned id) const {
-		return id < size
+		return id < data.size()
 			? data[id]
 			: -1;
 	}
 
 	unsigned GenerateId() {
 		assert(next > 0);
-		assert(next < size);
 
-		while (true) {
-			unsigned id = next;
+		if (next == data.size() && next < max_size &&
+		    (free_ids.empty() ||
+		     size_t(n_used) * sparseness >= data.size())) {
+			/* grow geometrically */
+			size_t new_size = std::max<size_t>(data.size() * 2, 16);
+			data.resize(std::min<size_t>(new_size, max_size), -1);
+		}
 
-			++next;
-			if (next == size)
-				next = 1;
+		if (next < data.size())
+			return next++;
 
-			if (data[id] < 0)
-				return id;
-		}
+		/* reuse the id which has been unused for the longest
+		   time */
+		assert(!free_ids.empty());
+		const unsigned id = free_ids.front();
+		free_ids.pop_front();
+		assert(data[id] < 0);
+		return id;
 	}
 
 	unsigned Insert(unsigned position) {
 		unsigned id = GenerateId();
 		data[id] = position;
+		++n_used;
 		return id;
 	}
 
 	void Move(unsigned id, unsigned position) {
-		assert(id < size);
+		assert(id < data.size());
 		assert(data[id] >= 0);
 
 		data[id] = position;
 	}
 
 	void Erase(unsigned id) {
-		assert(id < size);
+		assert(id < data.size());
 		assert(data[id] >= 0);
+		assert(n_used > 0);
 
 		data[id] = -1;
+		--n_used;
+		free_ids.push_back(id);
 	}
 };
 
@@ -22,6 +22,7 @@
 #include "PlaylistError.hxx"
 #include "PlayerControl.hxx"
 #include "DetachedSong.hxx"
+#include "Mapper.hxx"
 #include "Idle.hxx"
 #include "Log.hxx"
 
@@ -44,6 +45,14 @@ playlist::TagModified(DetachedSong &&song)
 	idle_add(IDLE_PLAYLIST);
 }
 
+DetachedSong *
+playlist_dup_song(const DetachedSong &song)
+{
+	DetachedSong *copy = new DetachedSong(song);
+	map_song_restore(*copy);
+	return copy;
+}
+
 /**
  * Queue a song, addressed by its order number.
  */
@@ -60,7 +69,7 @@ playlist_queue_song_order(playlist &playlist, PlayerControl &pc,
 	FormatDebug(playlist_domain, "queue song %i:\"%s\"",
 		    playlist.queued, song.GetURI());
 
-	pc.EnqueueSong(new DetachedSong(song));
+	pc.EnqueueSong(playlist_dup_song(song));
 }
 
 /**
@@ -149,7 +158,7 @@ playlist::PlayOrder(PlayerControl &pc, int order)
 
 	FormatDebug(playlist_domain, "play %i:\"%s\"", order, song.GetURI());
 
-	pc.Play(new DetachedSong(song));
+	pc.Play(playlist_dup_song(song));
 	current = order;
 }
 
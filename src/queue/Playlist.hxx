@@ -72,8 +72,27 @@ struct playlist {
 	 */
 	int queued;
 
+	/**
+	 * The nesting level of BeginBatch() calls.  While this is
+	 * non-zero, modifications don't increment the queue version,
+	 * and appended songs are not announced to the player.
+	 */
+	unsigned batch;
+
+	/**
+	 * Was the queue modified since BeginBatch()?
+	 */
+	bool batch_modified;
+
+	/**
+	 * Were songs appended since BeginBatch(), i.e. does the
+	 * queued song need to be updated?
+	 */
+	bool batch_appended;
+
 	playlist(unsigned max_length)
-		:queue(max_length), playing(false), current(-1), queued(-1) {
+		:queue(max_length), playing(false), current(-1), queued(-1),
+		 batch(0), batch_modified(false), batch_appended(false) {
 	}
 
 	~playlist() {
@@ -130,6 +149,21 @@ protected:
 	void UpdateQueuedSong(PlayerControl &pc, const DetachedSong *prev);
 
 public:
+	/**
+	 * Begin a series of modifications (e.g. a command list)
+	 * which shall result in only one new queue version, one
+	 * #IDLE_PLAYLIST event and one update of the queued song.
+	 * Calls may be nested.
+	 */
+	void BeginBatch() {
+		++batch;
+	}
+
+	/**
+	 * Finish what was started with BeginBatch().
+	 */
+	void CommitBatch(PlayerControl &pc);
+
 	void Clear(PlayerControl &pc);
 
 	/**
@@ -267,4 +301,12 @@ public:
 	void SetConsume(bool new_value);
 };
 
+/**
+ * Duplicate a song from the queue for the #PlayerControl, restoring
+ * the "real" URI which the queue does not store for database songs
+ * (see map_song_compact()).
+ */
+DetachedSong *
+playlist_dup_song(const DetachedSong &song);
+
 #endif
@@ -31,6 +31,7 @@
 #include "util/Error.hxx"
 #include "DetachedSong.hxx"
 #include "SongLoader.hxx"
+#include "Mapper.hxx"
 #include "Idle.hxx"
 
 #include <stdlib.h>
@@ -38,11 +39,38 @@
 void
 playlist::OnModified()
 {
+	if (batch > 0) {
+		/* postponed until CommitBatch() */
+		batch_modified = true;
+		return;
+	}
+
 	queue.IncrementVersion();
 
 	idle_add(IDLE_PLAYLIST);
 }
 
+void
+playlist::CommitBatch(PlayerControl &pc)
+{
+	assert(batch > 0);
+
+	if (--batch > 0)
+		return;
+
+	if (batch_appended) {
+		/* appending songs does not change the queued song,
+		   so it is still the one the player knows */
+		batch_appended = false;
+		UpdateQueuedSong(pc, GetQueuedSong());
+	}
+
+	if (batch_modified) {
+		batch_modified = false;
+		OnModified();
+	}
+}
+
 void
 playlist::Clear(PlayerControl &pc)
 {
@@ -67,6 +95,10 @@ playlist::AppendSong(PlayerControl &pc, DetachedSong &&song, Error &error)
 
 	const DetachedSong *const queued_song = GetQueuedSong();
 
+	/* the real URI of a database song is restored only when it
+	   is played */
+	map_song_compact(song);
+
 	id = queue.Append(std::move(song), 0);
 
 	if (queue.random) {
@@ -82,7 +114,12 @@ playlist::AppendSong(PlayerControl &pc, DetachedSong &&song, Error &error)
 			queue.ShuffleOrderLast(start, queue.GetLength());
 	}
 
-	UpdateQueuedSong(pc, queued_song);
+	if (batch > 0)
+		/* postponed until CommitBatch() */
+		batch_appended = true;
+	else
+		UpdateQueuedSong(pc, queued_song);
+
 	OnModified();
 
 	return id;
@@ -267,9 +304,65 @@ playlist::DeleteRange(PlayerControl &pc, unsigned start, unsigned end)
 
 	const DetachedSong *queued_song = GetQueuedSong();
 
-	do {
-		DeleteInternal(pc, --end, &queued_song);
-	} while (end != start);
+	/* remember the current song by its position, because the
+	   order numbers change when the songs get removed */
+	int current_position = current >= 0
+		? (int)queue.OrderToPosition(current)
+		: -1;
+
+	if (current_position >= (int)start && current_position < (int)end) {
+		/* the current song is going to be deleted: see which
+		   song is going to be played instead; skip the ones
+		   which are going to be deleted as well */
+
+		int next = current;
+		unsigned next_position = 0;
+		do {
+			next = queue.GetNextOrder(next);
+			if (next < 0 || next == current) {
+				next = -1;
+				break;
+			}
+
+			next_position = queue.OrderToPosition(next);
+		} while (next_position >= start && next_position < end);
+
+		if (playing) {
+			const bool paused = pc.GetState() == PlayerState::PAUSE;
+
+			if (next >= 0 && !paused)
+				/* play the song after the deleted ones */
+				PlayOrder(pc, next);
+			else {
+				/* stop the player */
+
+				pc.Stop();
+				playing = false;
+			}
+
+			queued_song = nullptr;
+
+			current_position = next >= 0
+				? (int)next_position
+				: -1;
+		} else
+			/* there's a "current song" but we're not
+			   playing currently - clear "current" */
+			current_position = -1;
+	}
+
+	/* now do it: remove the songs */
+
+	queue.DeleteRange(start, end);
+
+	/* update the "current" variable */
+
+	if (current_position >= (int)end)
+		current_position -= end - start;
+
+	current = current_position >= 0
+		? (int)queue.PositionToOrder(current_position)
+		: -1;
 
 	UpdateQueuedSong(pc, queued_song);
 	OnModified();
@@ -60,7 +60,7 @@
 
 void
 playlist_state_save(FILE *fp, const struct playlist &playlist,
-		    PlayerControl &pc)
+		    PlayerControl &pc, bool save_queue)
 {
 	const auto player_status = pc.GetStatus();
 
@@ -97,15 +97,23 @@ playlist_state_save(FILE *fp, const struct playlist &playlist,
 		pc.GetMixRampDb());
 	fprintf(fp, PLAYLIST_STATE_FILE_MIXRAMPDELAY "%f\n",
 		pc.GetMixRampDelay());
-	fputs(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n", fp);
-	queue_save(fp, playlist.queue);
-	fputs(PLAYLIST_STATE_FILE_PLAYLIST_END "\n", fp);
+
+	if (save_queue) {
+		fputs(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n", fp);
+		queue_save(fp, playlist.queue);
+		fputs(PLAYLIST_STATE_FILE_PLAYLIST_END "\n", fp);
+	}
 }
 
 static void
 playlist_state_load(TextFile &file, const SongLoader &song_loader,
 		    struct playlist &playlist)
 {
+	/* a queue in the state file replaces the one loaded from the
+	   snapshot: it is only saved here if the snapshot could not
+	   be written, or by older MPD versions */
+	playlist.queue.Clear();
+
 	const char *line = file.ReadLine();
 	if (line == nullptr) {
 		LogWarning(playlist_domain, "No playlist in state file");
@@ -130,7 +138,8 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 bool
 playlist_state_restore(const char *line, TextFile &file,
 		       const SongLoader &song_loader,
-		       struct playlist &playlist, PlayerControl &pc)
+		       struct playlist &playlist, PlayerControl &pc,
+		       bool &queue_loaded_r)
 {
 	int current = -1;
 	int seek_time = 0;
@@ -186,6 +195,7 @@ playlist_state_restore(const char *line, TextFile &file,
 		} else if (StringStartsWith(line,
 					    PLAYLIST_STATE_FILE_PLAYLIST_BEGIN)) {
 			playlist_state_load(file, song_loader, playlist);
+			queue_loaded_r = true;
 		}
 	}
 
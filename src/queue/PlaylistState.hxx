@@ -32,14 +32,23 @@ struct PlayerControl;
 class TextFile;
 class SongLoader;
 
+/**
+ * @param save_queue save the songs of the queue, too?  This is
+ * false if the queue is saved separately (see QueueBinary.hxx).
+ */
 void
 playlist_state_save(FILE *fp, const playlist &playlist,
-		    PlayerControl &pc);
+		    PlayerControl &pc, bool save_queue=true);
 
+/**
+ * @param queue_loaded_r set to true if the state file contained the
+ * songs of the queue
+ */
 bool
 playlist_state_restore(const char *line, TextFile &file,
 		       const SongLoader &song_loader,
-		       playlist &playlist, PlayerControl &pc);
+		       playlist &playlist, PlayerControl &pc,
+		       bool &queue_loaded_r);
 
 /**
  * Generates a hash number for the current state of the playlist and
@@ -21,17 +21,19 @@
 #include "Queue.hxx"
 #include "DetachedSong.hxx"
 
+MemoryAccount memory_queue;
+
 Queue::Queue(unsigned _max_length)
 	:max_length(_max_length), length(0),
 	 version(1),
-	 items(new Item[max_length]),
-	 order(new unsigned[max_length]),
-	 id_table(max_length * HASH_MULT),
+	 items(nullptr), order(nullptr), inverse_order(nullptr),
+	 id_table(max_length * HASH_MULT, HASH_MULT),
 	 repeat(false),
 	 single(false),
 	 consume(false),
 	 random(false)
 {
+	Allocate(std::min(max_length, unsigned(INITIAL_CAPACITY)));
 }
 
 Queue::~Queue()
@@ -40,6 +42,53 @@ Queue::~Queue()
 
 	delete[] items;
 	delete[] order;
+	delete[] inverse_order;
+
+	memory_queue.Sub(capacity * SlotSize());
+}
+
+void
+Queue::Allocate(unsigned _capacity)
+{
+	if (items != nullptr)
+		memory_queue.Sub(capacity * SlotSize());
+
+	delete[] items;
+	delete[] order;
+	delete[] inverse_order;
+
+	memory_queue.Add(_capacity * SlotSize());
+
+	capacity = _capacity;
+	items = new Item[capacity];
+	order = new unsigned[capacity];
+	inverse_order = new unsigned[capacity];
+}
+
+template<typename T>
+static void
+Reallocate(T *&p, unsigned length, unsigned new_capacity)
+{
+	T *q = new T[new_capacity];
+	std::copy_n(p, length, q);
+	delete[] p;
+	p = q;
+}
+
+void
+Queue::Grow()
+{
+	assert(capacity < max_length);
+
+	const unsigned new_capacity = capacity < max_length / 2
+		? capacity * 2
+		: max_length;
+
+	Reallocate(items, length, new_capacity);
+	Reallocate(order, length, new_capacity);
+	Reallocate(inverse_order, length, new_capacity);
+	memory_queue.Add((new_capacity - capacity) * SlotSize());
+	capacity = new_capacity;
 }
 
 int
@@ -71,6 +120,10 @@ Queue::IncrementVersion()
 			items[i].version = 0;
 
 		version = 1;
+
+		/* all songs are reported as modified now, and the
+		   log's versions are meaningless */
+		changes.Invalidate();
 	}
 }
 
@@ -79,7 +132,7 @@ Queue::ModifyAtOrder(unsigned _order)
 {
 	assert(_order < length);
 
-	unsigned position = order[_order];
+	unsigned position = OrderToPosition(_order);
 	ModifyAtPosition(position);
 }
 
@@ -88,16 +141,21 @@ Queue::Append(DetachedSong &&song, uint8_t priority)
 {
 	assert(!IsFull());
 
+	if (length == capacity)
+		Grow();
+
 	const unsigned position = length++;
 	const unsigned id = id_table.Insert(position);
 
 	auto &item = items[position];
 	item.song = new DetachedSong(std::move(song));
+	memory_queue.Add(sizeof(DetachedSong));
 	item.id = id;
 	item.version = version;
 	item.priority = priority;
+	changes.Add(version, position, position + 1);
 
-	order[position] = position;
+	order[position] = inverse_order[position] = position;
 
 	return id;
 }
@@ -112,6 +170,8 @@ Queue::SwapPositions(unsigned position1, unsigned position2)
 
 	items[position1].version = version;
 	items[position2].version = version;
+	changes.Add(version, position1, position1 + 1);
+	changes.Add(version, position2, position2 + 1);
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
@@ -120,78 +180,53 @@ Queue::SwapPositions(unsigned position1, unsigned position2)
 void
 Queue::MovePostion(unsigned from, unsigned to)
 {
-	const Item tmp = items[from];
-
-	/* move songs to one less in from->to */
+	MoveRange(from, from + 1, to);
+}
 
-	for (unsigned i = from; i < to; i++)
-		MoveItemTo(i + 1, i);
+void
+Queue::MoveRange(unsigned start, unsigned end, unsigned to)
+{
+	assert(start < end);
+	assert(end <= length);
+	assert(to + end - start <= length);
 
-	/* move songs to one more in to->from */
+	if (start == to)
+		return;
 
-	for (unsigned i = from; i > to; i--)
-		MoveItemTo(i - 1, i);
+	/* the range of positions which are affected: the block
+	   itself and the songs between its old and new location */
 
-	/* put song at _to_ */
+	unsigned first, middle, last;
+	if (to > start) {
+		first = start;
+		middle = end;
+		last = to + end - start;
+	} else {
+		first = to;
+		middle = start;
+		last = end;
+	}
 
-	id_table.Move(tmp.id, to);
-	items[to] = tmp;
-	items[to].version = version;
+	/* rotate the items in place; this moves each one only once,
+	   and needs no temporary copy of the block */
 
-	/* now deal with order */
+	std::rotate(items + first, items + middle, items + last);
 
-	if (random) {
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] > from && order[i] <= to)
-				order[i]--;
-			else if (order[i] < from &&
-				 order[i] >= to)
-				order[i]++;
-			else if (from == order[i])
-				order[i] = to;
-		}
+	for (unsigned i = first; i < last; i++) {
+		items[i].version = version;
+		id_table.Move(items[i].id, i);
 	}
-}
 
-void
-Queue::MoveRange(unsigned start, unsigned end, unsigned to)
-{
-	Item tmp[end - start];
-	// Copy the original block [start,end-1]
-	for (unsigned i = start; i < end; i++)
-		tmp[i - start] = items[i];
-
-	// If to > start, we need to move to-start items to start, starting from end
-	for (unsigned i = end; i < end + to - start; i++)
-		MoveItemTo(i, start + i - end);
-
-	// If to < start, we need to move start-to items to newend (= end + to - start), starting from to
-	// This is the same as moving items from start-1 to to (decreasing), with start-1 going to end-1
-	// We have to iterate in this order to avoid writing over something we haven't yet moved
-	for (int i = start - 1; i >= int(to); i--)
-		MoveItemTo(i, i + end - start);
-
-	// Copy the original block back in, starting at to.
-	for (unsigned i = start; i< end; i++)
-	{
-		id_table.Move(tmp[i - start].id, to + i - start);
-		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
-	}
+	changes.Add(version, first, last);
 
 	if (random) {
-		// Update the positions in the queue.
-		// Note that the ranges for these cases are the same as the ranges of
-		// the loops above.
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] >= end && order[i] < to + end - start)
-				order[i] -= end - start;
-			else if (order[i] < start &&
-				 order[i] >= to)
-				order[i] += end - start;
-			else if (start <= order[i] && order[i] < end)
-				order[i] += to - start;
-		}
+		/* the order numbers move along with the songs; only
+		   the affected positions need to be updated */
+		std::rotate(inverse_order + first, inverse_order + middle,
+			    inverse_order + last);
+
+		for (unsigned i = first; i < last; i++)
+			order[inverse_order[i]] = i;
 	}
 }
 
@@ -204,14 +239,19 @@ Queue::MoveOrder(unsigned from_order, unsigned to_order)
 	const unsigned from_position = OrderToPosition(from_order);
 
 	if (from_order < to_order) {
-		for (unsigned i = from_order; i < to_order; ++i)
+		for (unsigned i = from_order; i < to_order; ++i) {
 			order[i] = order[i + 1];
+			inverse_order[order[i]] = i;
+		}
 	} else {
-		for (unsigned i = from_order; i > to_order; --i)
+		for (unsigned i = from_order; i > to_order; --i) {
 			order[i] = order[i - 1];
+			inverse_order[order[i]] = i;
+		}
 	}
 
 	order[to_order] = from_position;
+	inverse_order[from_position] = to_order;
 }
 
 void
@@ -220,6 +260,7 @@ Queue::DeletePosition(unsigned position)
 	assert(position < length);
 
 	delete items[position].song;
+	memory_queue.Sub(sizeof(DetachedSong));
 
 	const unsigned id = PositionToId(position);
 	const unsigned _order = PositionToOrder(position);
@@ -235,6 +276,8 @@ Queue::DeletePosition(unsigned position)
 	for (unsigned i = position; i < length; i++)
 		MoveItemTo(i + 1, i);
 
+	changes.Add(version, position, length);
+
 	/* delete the entry from the order array */
 
 	for (unsigned i = _order; i < length; i++)
@@ -242,9 +285,57 @@ Queue::DeletePosition(unsigned position)
 
 	/* readjust values in the order array */
 
-	for (unsigned i = 0; i < length; i++)
+	for (unsigned i = 0; i < length; i++) {
 		if (order[i] > position)
 			--order[i];
+
+		inverse_order[order[i]] = i;
+	}
+}
+
+void
+Queue::DeleteRange(unsigned start, unsigned end)
+{
+	assert(start <= end);
+	assert(end <= length);
+
+	const unsigned n = end - start;
+	if (n == 0)
+		return;
+
+	for (unsigned i = start; i < end; i++) {
+		delete items[i].song;
+		id_table.Erase(items[i].id);
+	}
+
+	memory_queue.Sub(n * sizeof(DetachedSong));
+
+	/* close the gap in the songs array */
+
+	for (unsigned i = end; i < length; i++)
+		MoveItemTo(i, i - n);
+
+	changes.Add(version, start, length - n);
+
+	/* remove the deleted songs from the order array and
+	   readjust its values, all in one pass */
+
+	unsigned o = 0;
+	for (unsigned i = 0; i < length; i++) {
+		unsigned position = order[i];
+		if (position >= start && position < end)
+			continue;
+
+		if (position >= end)
+			position -= n;
+
+		order[o] = position;
+		inverse_order[position] = o;
+		++o;
+	}
+
+	length -= n;
+	assert(o == length);
 }
 
 void
@@ -258,7 +349,13 @@ Queue::Clear()
 		id_table.Erase(item->id);
 	}
 
+	memory_queue.Sub(length * sizeof(DetachedSong));
 	length = 0;
+	changes.Clear();
+
+	if (capacity > INITIAL_CAPACITY)
+		/* release the memory of a large queue */
+		Allocate(INITIAL_CAPACITY);
 }
 
 static void
@@ -288,6 +385,7 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end)
 
 	rand.AutoCreate();
 	std::shuffle(order + start, order + end, rand);
+	UpdateInverseOrder(start, end);
 }
 
 /**
@@ -369,36 +467,31 @@ Queue::ShuffleRange(unsigned start, unsigned end)
 }
 
 unsigned
-Queue::FindPriorityOrder(unsigned start_order, uint8_t priority,
-			 unsigned exclude_order) const
+Queue::FindPriorityOrder(unsigned start_order, unsigned end_order,
+			 uint8_t priority) const
 {
 	assert(random);
-	assert(start_order <= length);
-
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority <= priority && i != exclude_order)
-			return i;
-	}
+	assert(start_order <= end_order);
+	assert(end_order <= length);
 
-	return length;
+	return std::partition_point(order + start_order, order + end_order,
+				    [this, priority](unsigned position){
+					    return items[position].priority > priority;
+				    }) - order;
 }
 
 unsigned
-Queue::CountSamePriority(unsigned start_order, uint8_t priority) const
+Queue::FindLowerPriorityOrder(unsigned start_order, unsigned end_order,
+			      uint8_t priority) const
 {
 	assert(random);
-	assert(start_order <= length);
+	assert(start_order <= end_order);
+	assert(end_order <= length);
 
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority != priority)
-			return i - start_order;
-	}
-
-	return length - start_order;
+	return std::partition_point(order + start_order, order + end_order,
+				    [this, priority](unsigned position){
+					    return items[position].priority >= priority;
+				    }) - order;
 }
 
 bool
@@ -413,12 +506,14 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order)
 
 	item->version = version;
 	item->priority = priority;
+	changes.Add(version, position, position + 1);
 
 	if (!random)
 		/* don't reorder if not in random mode */
 		return true;
 
 	unsigned _order = PositionToOrder(position);
+	unsigned start_order = after_order + 1;
 	if (after_order >= 0) {
 		if (_order == (unsigned)after_order)
 			/* don't reorder the current song */
@@ -437,24 +532,53 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order)
 			    priority <= after_item->priority)
 				/* priority hasn't become bigger */
 				return true;
+
+			/* remove it from the played songs; now it is
+			   the first one after the current song */
+			MoveOrder(_order, after_order);
+			_order = start_order = after_order;
 		}
 	}
 
-	/* move the item to the beginning of the priority group (or
-	   create a new priority group) */
+	/* the other songs after "after_order" are grouped by
+	   priority; move this one over the groups in between by
+	   swapping it with the nearest item of each group, which
+	   keeps the groups contiguous */
+
+	while (_order > start_order) {
+		const uint8_t prev_priority = GetOrderPriority(_order - 1);
+		if (prev_priority >= priority)
+			break;
+
+		const unsigned group_start =
+			FindPriorityOrder(start_order, _order, prev_priority);
+		SwapOrders(group_start, _order);
+		_order = group_start;
+	}
+
+	while (_order + 1 < length) {
+		const uint8_t next_priority = GetOrderPriority(_order + 1);
+		if (next_priority <= priority)
+			break;
 
-	const unsigned before_order =
-		FindPriorityOrder(after_order + 1, priority, _order);
-	const unsigned new_order = before_order > _order
-		? before_order - 1
-		: before_order;
-	MoveOrder(_order, new_order);
+		const unsigned group_end =
+			FindLowerPriorityOrder(_order + 1, length,
+					       next_priority);
+		SwapOrders(_order, group_end - 1);
+		_order = group_end - 1;
+	}
 
-	/* shuffle the song within that priority group */
+	/* shuffle the song within its new priority group */
 
-	const unsigned priority_count = CountSamePriority(new_order, priority);
-	assert(priority_count >= 1);
-	ShuffleOrderFirst(new_order, new_order + priority_count);
+	const unsigned group_start =
+		FindPriorityOrder(start_order, _order, priority);
+	const unsigned group_end =
+		FindLowerPriorityOrder(_order + 1, length, priority);
+
+	rand.AutoCreate();
+	std::uniform_int_distribution<unsigned> distribution(group_start,
+							     group_end - 1);
+	SwapOrders(_order, distribution(rand));
 
 	return true;
 }
@@ -22,7 +22,9 @@
 
 #include "Compiler.h"
 #include "IdTable.hxx"
+#include "ChangeLog.hxx"
 #include "util/LazyRandomEngine.hxx"
+#include "util/MemoryAccount.hxx"
 
 #include <algorithm>
 
@@ -31,6 +33,12 @@
 
 class DetachedSong;
 
+/**
+ * The memory occupied by the arrays and the #DetachedSong objects
+ * of all queues.
+ */
+extern MemoryAccount memory_queue;
+
 /**
  * A queue of songs.  This is the backend of the playlist: it contains
  * an ordered list of songs.
@@ -43,11 +51,18 @@ class DetachedSong;
  */
 struct Queue {
 	/**
-	 * reserve max_length * HASH_MULT elements in the id
-	 * number space
+	 * reserve up to max_length * HASH_MULT elements in the id
+	 * number space, and keep it this much larger than the
+	 * number of songs
 	 */
 	static constexpr unsigned HASH_MULT = 4;
 
+	/**
+	 * The initial number of allocated items; the arrays grow
+	 * geometrically from here.
+	 */
+	static constexpr unsigned INITIAL_CAPACITY = 64;
+
 	/**
 	 * One element of the queue: basically a song plus some queue specific
 	 * information attached.
@@ -72,6 +87,12 @@ struct Queue {
 	/** configured maximum length of the queue */
 	unsigned max_length;
 
+	/**
+	 * The number of elements allocated in #items, #order and
+	 * #inverse_order.  It is never larger than #max_length.
+	 */
+	unsigned capacity;
+
 	/** number of songs in the queue */
 	unsigned length;
 
@@ -84,9 +105,19 @@ struct Queue {
 	/** map order numbers to positions */
 	unsigned *order;
 
+	/**
+	 * Map positions to order numbers; this is the inverse of
+	 * #order, which allows looking up the order of a song
+	 * without scanning.
+	 */
+	unsigned *inverse_order;
+
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/** the position ranges modified recently, for "plchanges" */
+	QueueChangeLog changes;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat;
@@ -171,13 +202,9 @@ struct Queue {
 	gcc_pure
 	unsigned PositionToOrder(unsigned position) const {
 		assert(position < length);
+		assert(order[inverse_order[position]] == position);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return inverse_order[position];
 	}
 
 	gcc_pure
@@ -225,6 +252,32 @@ struct Queue {
 			items[position].version == 0;
 	}
 
+	/**
+	 * Invoke a function for the position of each song which is
+	 * newer than the specified version (see IsNewerAtPosition()),
+	 * in ascending order.  If the version is recent enough, only
+	 * the ranges in the change log are checked.
+	 */
+	template<typename F>
+	void VisitChanges(uint32_t _version, F &&f) const {
+		if (_version <= version && changes.Covers(_version)) {
+			QueueChangeLog::Range ranges[QueueChangeLog::CAPACITY];
+			const unsigned n = changes.Get(_version, length,
+						       ranges);
+
+			for (unsigned i = 0; i < n; ++i)
+				for (unsigned position = ranges[i].start;
+				     position < ranges[i].end; ++position)
+					if (IsNewerAtPosition(position, _version))
+						f(position);
+		} else {
+			for (unsigned position = 0; position < length;
+			     ++position)
+				if (IsNewerAtPosition(position, _version))
+					f(position);
+		}
+	}
+
 	/**
 	 * Returns the order number following the specified one.  This takes
 	 * end of queue and "repeat" mode into account.
@@ -249,6 +302,7 @@ struct Queue {
 		assert(position < length);
 
 		items[position].version = version;
+		changes.Add(version, position, position + 1);
 	}
 
 	/**
@@ -280,6 +334,8 @@ struct Queue {
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) {
 		std::swap(order[order1], order[order2]);
+		inverse_order[order[order1]] = order1;
+		inverse_order[order[order2]] = order2;
 	}
 
 	/**
@@ -297,6 +353,13 @@ struct Queue {
 	 */
 	void DeletePosition(unsigned position);
 
+	/**
+	 * Removes a range of songs from the playlist.  Unlike calling
+	 * DeletePosition() for each song, this shifts the remaining
+	 * songs and the order array only once.
+	 */
+	void DeleteRange(unsigned start, unsigned end);
+
 	/**
 	 * Removes all songs from the playlist.
 	 */
@@ -307,7 +370,7 @@ struct Queue {
 	 */
 	void RestoreOrder() {
 		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
+			order[i] = inverse_order[i] = i;
 	}
 
 	/**
@@ -343,12 +406,49 @@ struct Queue {
 	 */
 	void ShuffleRange(unsigned start, unsigned end);
 
+	/**
+	 * Change the priority of a song.  In random mode, it is moved
+	 * to a random place within its new priority group after
+	 * #after_order.  The songs after #after_order are grouped by
+	 * priority (in descending order); the song is moved by
+	 * swapping it with the boundary items of the groups in
+	 * between, which takes O(log n) per group and does not shift
+	 * the #order array.
+	 */
 	bool SetPriority(unsigned position, uint8_t priority, int after_order);
 
 	bool SetPriorityRange(unsigned start_position, unsigned end_position,
 			      uint8_t priority, int after_order);
 
 private:
+	/**
+	 * Allocate the arrays with the given capacity, discarding
+	 * their contents.
+	 */
+	void Allocate(unsigned _capacity);
+
+	/**
+	 * Enlarge the arrays, preserving their contents.
+	 */
+	void Grow();
+
+	/**
+	 * The number of bytes allocated per array slot, for
+	 * #memory_queue.
+	 */
+	static constexpr size_t SlotSize() {
+		return sizeof(Item) + 2 * sizeof(unsigned);
+	}
+
+	/**
+	 * Update #inverse_order after the specified range of #order
+	 * has been modified.
+	 */
+	void UpdateInverseOrder(unsigned start, unsigned end) {
+		for (unsigned i = start; i < end; ++i)
+			inverse_order[order[i]] = i;
+	}
+
 	/**
 	 * Moves a song to a new position in the "order" list.
 	 */
@@ -363,16 +463,24 @@ private:
 	}
 
 	/**
-	 * Find the first item that has this specified priority or
-	 * higher.
+	 * Find the first item in the specified (order) range whose
+	 * priority is not bigger than the specified one.  The range
+	 * must be grouped by priority in descending order.
+	 *
+	 * @return the order number or #end_order if there is none
 	 */
 	gcc_pure
-	unsigned FindPriorityOrder(unsigned start_order, uint8_t priority,
-				   unsigned exclude_order) const;
+	unsigned FindPriorityOrder(unsigned start_order, unsigned end_order,
+				   uint8_t priority) const;
 
+	/**
+	 * Like FindPriorityOrder(), but find the first item whose
+	 * priority is smaller than the specified one.
+	 */
 	gcc_pure
-	unsigned CountSamePriority(unsigned start_order,
-				   uint8_t priority) const;
+	unsigned FindLowerPriorityOrder(unsigned start_order,
+					unsigned end_order,
+					uint8_t priority) const;
 };
 
 #endif
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "QueueBinary.hxx"
+#include "Queue.hxx"
+#include "PlaylistError.hxx"
+#include "DetachedSong.hxx"
+#include "SongLoader.hxx"
+#include "Mapper.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "storage/StorageInterface.hxx"
+#endif
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+
+static constexpr char BINARY_QUEUE_MAGIC[8] = {
+	'M', 'P', 'D', 'q', 'u', 'e', 'u', 'e',
+};
+
+static constexpr uint32_t BINARY_QUEUE_FORMAT = 1;
+
+/**
+ * Written in host byte order; a file from a host with a different
+ * byte order is rejected.
+ */
+static constexpr uint32_t BINARY_QUEUE_BYTE_ORDER = 0x01020304;
+
+class BinaryQueueWriter {
+	FILE *const fp;
+
+	std::unordered_map<std::string, uint32_t> string_ids;
+
+	/**
+	 * The strings in the order of their ids; they point into the
+	 * keys of #string_ids.
+	 */
+	std::vector<const char *> strings;
+
+public:
+	explicit BinaryQueueWriter(FILE *_fp):fp(_fp) {}
+
+	void Save(const Queue &queue, uint32_t generation, time_t db_stamp);
+
+private:
+	uint32_t Intern(const char *s) {
+		auto i = string_ids.emplace(s, strings.size());
+		if (i.second)
+			strings.push_back(i.first->first.c_str());
+		return i.first->second;
+	}
+
+	gcc_pure
+	uint32_t GetId(const char *s) const {
+		auto i = string_ids.find(s);
+		assert(i != string_ids.end());
+		return i->second;
+	}
+
+	void Write(const void *data, size_t size) {
+		fwrite(data, size, 1, fp);
+	}
+
+	void WriteU32(uint32_t value) {
+		Write(&value, sizeof(value));
+	}
+
+	void WriteU64(uint64_t value) {
+		WriteU32(uint32_t(value));
+		WriteU32(uint32_t(value >> 32));
+	}
+
+	void WriteStrings();
+	void WriteSong(const DetachedSong &song, uint8_t priority);
+};
+
+void
+BinaryQueueWriter::WriteStrings()
+{
+	uint32_t offset = 0;
+	for (const char *s : strings) {
+		WriteU32(offset);
+		offset += strlen(s) + 1;
+	}
+
+	WriteU32(offset);
+
+	for (const char *s : strings)
+		Write(s, strlen(s) + 1);
+
+	/* pad to a multiple of 4 bytes */
+	static constexpr char padding[4] = {0, 0, 0, 0};
+	Write(padding, (4 - offset % 4) % 4);
+}
+
+void
+BinaryQueueWriter::WriteSong(const DetachedSong &song, uint8_t priority)
+{
+	const Tag &tag = song.GetTag();
+
+	WriteU32(GetId(song.GetURI()));
+	WriteU32(priority);
+	WriteU32(song.GetStartMS());
+	WriteU32(song.GetEndMS());
+	WriteU64(song.GetLastModified());
+	WriteU32(uint32_t(tag.time));
+	WriteU32(tag.has_playlist);
+	WriteU32(tag.num_items);
+
+	for (unsigned i = 0; i < tag.num_items; ++i) {
+		const TagItem &item = *tag.items[i];
+		WriteU32(item.type);
+		WriteU32(GetId(item.value));
+	}
+}
+
+void
+BinaryQueueWriter::Save(const Queue &queue, uint32_t generation,
+			time_t db_stamp)
+{
+	uint32_t tag_names[TAG_NUM_OF_ITEM_TYPES];
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		tag_names[i] = Intern(tag_item_names[i]);
+
+	const unsigned length = queue.GetLength();
+	for (unsigned i = 0; i < length; ++i) {
+		const DetachedSong &song = queue.Get(i);
+		Intern(song.GetURI());
+
+		const Tag &tag = song.GetTag();
+		for (unsigned j = 0; j < tag.num_items; ++j)
+			Intern(tag.items[j]->value);
+	}
+
+	Write(BINARY_QUEUE_MAGIC, sizeof(BINARY_QUEUE_MAGIC));
+	WriteU32(BINARY_QUEUE_FORMAT);
+	WriteU32(BINARY_QUEUE_BYTE_ORDER);
+	WriteU32(generation);
+	WriteU64(db_stamp);
+	WriteU32(strings.size());
+	WriteStrings();
+
+	WriteU32(TAG_NUM_OF_ITEM_TYPES);
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		WriteU32(tag_names[i]);
+
+	WriteU32(length);
+	for (unsigned i = 0; i < length; ++i)
+		WriteSong(queue.Get(i), queue.GetPriorityAtPosition(i));
+}
+
+void
+queue_save_binary(FILE *fp, const Queue &queue,
+		  uint32_t generation, time_t db_stamp)
+{
+	BinaryQueueWriter writer(fp);
+	writer.Save(queue, generation, db_stamp);
+}
+
+class BinaryQueueReader {
+	const uint8_t *p;
+	const uint8_t *const end;
+
+	const uint8_t *offsets;
+	const char *blob;
+	uint32_t n_strings, blob_size;
+
+	/**
+	 * Maps the tag index in the file to the #TagType, or
+	 * #TAG_NUM_OF_ITEM_TYPES if this MPD version does not know
+	 * the tag.
+	 */
+	std::vector<TagType> tag_types;
+
+public:
+	BinaryQueueReader(const uint8_t *begin, const uint8_t *_end)
+		:p(begin), end(_end) {}
+
+	bool Load(const SongLoader &loader, time_t db_stamp,
+		  Queue &queue, uint32_t &generation_r, Error &error);
+
+private:
+	bool Skip(size_t size) {
+		if (size_t(end - p) < size)
+			return false;
+
+		p += size;
+		return true;
+	}
+
+	bool ReadU32(uint32_t &value_r) {
+		if (end - p < (ptrdiff_t)sizeof(value_r))
+			return false;
+
+		memcpy(&value_r, p, sizeof(value_r));
+		p += sizeof(value_r);
+		return true;
+	}
+
+	bool ReadU64(uint64_t &value_r) {
+		uint32_t low, high;
+		if (!ReadU32(low) || !ReadU32(high))
+			return false;
+
+		value_r = uint64_t(low) | (uint64_t(high) << 32);
+		return true;
+	}
+
+	gcc_pure
+	const char *GetString(uint32_t id) const {
+		if (id >= n_strings)
+			return nullptr;
+
+		uint32_t offset;
+		memcpy(&offset, offsets + id * sizeof(offset), sizeof(offset));
+		return offset < blob_size
+			? blob + offset
+			: nullptr;
+	}
+
+	bool ReadString(const char *&s) {
+		uint32_t id;
+		return ReadU32(id) && (s = GetString(id)) != nullptr;
+	}
+
+	bool ReadStrings();
+	bool ReadTagNames();
+	DetachedSong *ReadSong(uint8_t &priority_r);
+};
+
+static void
+SetCorrupted(Error &error)
+{
+	error.Set(playlist_domain, "Queue snapshot corrupted");
+}
+
+bool
+BinaryQueueReader::ReadStrings()
+{
+	/* n_strings+1 offsets, followed by the string data */
+
+	if (!ReadU32(n_strings) ||
+	    n_strings >= (end - p) / sizeof(uint32_t))
+		return false;
+
+	offsets = p;
+	if (!Skip(n_strings * sizeof(uint32_t)) || !ReadU32(blob_size))
+		return false;
+
+	blob = (const char *)p;
+
+	/* the last string must be null-terminated, which guarantees
+	   that all strings are */
+	return Skip(blob_size) && Skip((4 - blob_size % 4) % 4) &&
+		(blob_size == 0 || blob[blob_size - 1] == 0);
+}
+
+bool
+BinaryQueueReader::ReadTagNames()
+{
+	uint32_t n_tags;
+	if (!ReadU32(n_tags) || n_tags > 4 * TAG_NUM_OF_ITEM_TYPES)
+		return false;
+
+	tag_types.reserve(n_tags);
+	for (unsigned i = 0; i < n_tags; ++i) {
+		const char *name;
+		if (!ReadString(name))
+			return false;
+
+		/* tags which are unknown to this MPD version are
+		   skipped */
+		tag_types.push_back(tag_name_parse(name));
+	}
+
+	return true;
+}
+
+DetachedSong *
+BinaryQueueReader::ReadSong(uint8_t &priority_r)
+{
+	const char *uri;
+	uint32_t priority, start_ms, end_ms, duration, has_playlist, n_items;
+	uint64_t mtime;
+
+	if (!ReadString(uri) || !ReadU32(priority) ||
+	    !ReadU32(start_ms) || !ReadU32(end_ms) ||
+	    !ReadU64(mtime) ||
+	    !ReadU32(duration) || !ReadU32(has_playlist) ||
+	    !ReadU32(n_items))
+		return nullptr;
+
+	TagBuilder tag;
+	tag.SetTime(int32_t(duration));
+	tag.SetHasPlaylist(has_playlist != 0);
+
+	for (unsigned i = 0; i < n_items; ++i) {
+		uint32_t type;
+		const char *value;
+		if (!ReadU32(type) || type >= tag_types.size() ||
+		    !ReadString(value))
+			return nullptr;
+
+		if (tag_types[type] != TAG_NUM_OF_ITEM_TYPES)
+			tag.AddItem(tag_types[type], value);
+	}
+
+	DetachedSong *song = new DetachedSong(uri, tag.Commit());
+	song->SetStartMS(start_ms);
+	song->SetEndMS(end_ms);
+	song->SetLastModified(time_t(mtime));
+
+	priority_r = priority;
+	return song;
+}
+
+bool
+BinaryQueueReader::Load(const SongLoader &loader, time_t db_stamp,
+			Queue &queue, uint32_t &generation_r, Error &error)
+{
+	uint32_t format, byte_order;
+	uint64_t stamp;
+
+	if (!Skip(sizeof(BINARY_QUEUE_MAGIC)) ||
+	    memcmp(p - sizeof(BINARY_QUEUE_MAGIC), BINARY_QUEUE_MAGIC,
+		   sizeof(BINARY_QUEUE_MAGIC)) != 0 ||
+	    !ReadU32(format) || !ReadU32(byte_order)) {
+		SetCorrupted(error);
+		return false;
+	}
+
+	if (format != BINARY_QUEUE_FORMAT ||
+	    byte_order != BINARY_QUEUE_BYTE_ORDER) {
+		error.Set(playlist_domain, "Queue snapshot format mismatch");
+		return false;
+	}
+
+	uint32_t n_songs;
+	if (!ReadU32(generation_r) || !ReadU64(stamp) ||
+	    !ReadStrings() || !ReadTagNames() || !ReadU32(n_songs)) {
+		SetCorrupted(error);
+		return false;
+	}
+
+	/* if the database has not been modified since the snapshot
+	   was written, its songs can be trusted without looking them
+	   up; the queue does not need their real URI (see
+	   map_song_compact()) */
+#ifdef ENABLE_DATABASE
+	const Storage *const storage = db_stamp != 0 && time_t(stamp) == db_stamp
+		? loader.GetStorage()
+		: nullptr;
+#else
+	(void)db_stamp;
+#endif
+
+	for (unsigned i = 0; i < n_songs && !queue.IsFull(); ++i) {
+		uint8_t priority;
+		DetachedSong *song = ReadSong(priority);
+		if (song == nullptr) {
+			SetCorrupted(error);
+			return false;
+		}
+
+#ifdef ENABLE_DATABASE
+		if (storage != nullptr && song->IsInDatabase()) {
+			/* trusted */
+		} else
+#endif
+		if (!playlist_check_translate_song(*song, nullptr, loader)) {
+			delete song;
+			continue;
+		}
+
+		map_song_compact(*song);
+		queue.Append(std::move(*song), priority);
+		delete song;
+	}
+
+	return true;
+}
+
+bool
+queue_load_binary(Path path, const SongLoader &loader, time_t db_stamp,
+		  Queue &queue, uint32_t &generation_r, Error &error)
+{
+	FILE *fp = FOpen(path, FOpenMode::ReadBinary);
+	if (fp == nullptr) {
+		error.FormatErrno("Failed to open %s", path.c_str());
+		return false;
+	}
+
+	long size = -1;
+	if (fseek(fp, 0, SEEK_END) == 0) {
+		size = ftell(fp);
+		rewind(fp);
+	}
+
+	if (size < 0) {
+		error.FormatErrno("Failed to read %s", path.c_str());
+		fclose(fp);
+		return false;
+	}
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+	const bool success = fread(buffer.get(), 1, size, fp) == size_t(size);
+	fclose(fp);
+
+	if (!success) {
+		error.Format(playlist_domain, "Failed to read %s",
+			     path.c_str());
+		return false;
+	}
+
+	BinaryQueueReader reader(buffer.get(), buffer.get() + size);
+	return reader.Load(loader, db_stamp, queue, generation_r, error);
+}
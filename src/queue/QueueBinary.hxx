@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * A binary snapshot of the queue, used by the state file.
+ */
+
+#ifndef MPD_QUEUE_BINARY_HXX
+#define MPD_QUEUE_BINARY_HXX
+
+#include "Compiler.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+struct Queue;
+class SongLoader;
+class Path;
+class Error;
+
+/*
+ * The file starts with a header, followed by a string table (all
+ * URIs and tag values, each stored only once), the list of tag names
+ * and the songs.  All integers are 32 bit in host byte order.
+ *
+ * The header contains the database update stamp at the time the
+ * snapshot was written.  If the database has not been modified
+ * since, songs from the database are restored from the snapshot
+ * without looking them up in the database.
+ */
+
+void
+queue_save_binary(FILE *fp, const Queue &queue,
+		  uint32_t generation, time_t db_stamp);
+
+/**
+ * Load a snapshot and append its songs to the queue.
+ *
+ * @param generation_r the generation which was passed to
+ * queue_save_binary()
+ * @param db_stamp the current database update stamp, or 0 if
+ * there is no database
+ */
+bool
+queue_load_binary(Path path, const SongLoader &loader, time_t db_stamp,
+		  Queue &queue, uint32_t &generation_r, Error &error);
+
+#endif
@@ -22,8 +22,14 @@
 #include "Queue.hxx"
 #include "SongFilter.hxx"
 #include "SongPrint.hxx"
+#include "SortWindow.hxx"
+#include "DetachedSong.hxx"
+#include "tag/Tag.hxx"
 #include "client/Client.hxx"
 
+#include <vector>
+#include <algorithm>
+
 /**
  * Send detailed information about a range of songs in the queue to a
  * client.
@@ -56,6 +62,50 @@ queue_print_info(Client &client, const Queue &queue,
 		queue_print_song_info(client, queue, i);
 }
 
+void
+queue_print_info(Client &client, const Queue &queue,
+		 unsigned start, unsigned end, const SortWindow &sw)
+{
+	assert(start <= end);
+	assert(end <= queue.GetLength());
+
+	if (!sw.IsSorted()) {
+		const unsigned length = end - start;
+		const unsigned skip = std::min(sw.start, length);
+		start += skip;
+		end = start + std::min(sw.end - sw.start, length - skip);
+
+		queue_print_info(client, queue, start, end);
+		return;
+	}
+
+	std::vector<unsigned> positions;
+	positions.reserve(end - start);
+	for (unsigned i = start; i < end; ++i)
+		positions.push_back(i);
+
+	/* only the songs up to the end of the window need to be in
+	   order */
+	const auto middle = sw.end < positions.size()
+		? positions.begin() + sw.end
+		: positions.end();
+	std::partial_sort(positions.begin(), middle, positions.end(),
+			  [&queue, &sw](unsigned a, unsigned b){
+				  const Tag &ta = queue.Get(a).GetTag();
+				  const Tag &tb = queue.Get(b).GetTag();
+				  if (sw.Less(ta, tb))
+					  return true;
+				  if (sw.Less(tb, ta))
+					  return false;
+				  return a < b;
+			  });
+
+	const size_t skip = std::min<size_t>(sw.start,
+					     middle - positions.begin());
+	for (auto i = positions.begin() + skip; i != middle; ++i)
+		queue_print_song_info(client, queue, *i);
+}
+
 void
 queue_print_uris(Client &client, const Queue &queue,
 		 unsigned start, unsigned end)
@@ -73,20 +123,19 @@ void
 queue_print_changes_info(Client &client, const Queue &queue,
 			 uint32_t version)
 {
-	for (unsigned i = 0; i < queue.GetLength(); i++) {
-		if (queue.IsNewerAtPosition(i, version))
+	queue.VisitChanges(version, [&client, &queue](unsigned i){
 			queue_print_song_info(client, queue, i);
-	}
+		});
 }
 
 void
 queue_print_changes_position(Client &client, const Queue &queue,
 			     uint32_t version)
 {
-	for (unsigned i = 0; i < queue.GetLength(); i++)
-		if (queue.IsNewerAtPosition(i, version))
+	queue.VisitChanges(version, [&client, &queue](unsigned i){
 			client_printf(client, "cpos: %i\nId: %i\n",
 				      i, queue.PositionToId(i));
+		});
 }
 
 void
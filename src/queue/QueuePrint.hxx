@@ -28,6 +28,7 @@
 #include <stdint.h>
 
 struct Queue;
+struct SortWindow;
 class SongFilter;
 class Client;
 
@@ -35,6 +36,14 @@ void
 queue_print_info(Client &client, const Queue &queue,
 		 unsigned start, unsigned end);
 
+/**
+ * Like queue_print_info(), but sort the range by a tag first and
+ * print only the songs within the window.
+ */
+void
+queue_print_info(Client &client, const Queue &queue,
+		 unsigned start, unsigned end, const SortWindow &sw);
+
 void
 queue_print_uris(Client &client, const Queue &queue,
 		 unsigned start, unsigned end);
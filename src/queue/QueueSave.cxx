@@ -24,6 +24,7 @@
 #include "DetachedSong.hxx"
 #include "SongSave.hxx"
 #include "SongLoader.hxx"
+#include "Mapper.hxx"
 #include "playlist/PlaylistSong.hxx"
 #include "fs/TextFile.hxx"
 #include "util/StringUtil.hxx"
@@ -31,9 +32,14 @@
 #include "fs/Traits.hxx"
 #include "Log.hxx"
 
+#include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define PRIO_LABEL "Prio: "
+#define JOURNAL_SET "queue_set: "
+#define JOURNAL_TRUNCATE "queue_truncate: "
+#define JOURNAL_END "queue_end"
 
 static void
 queue_save_database_song(FILE *fp, int idx, const DetachedSong &song)
@@ -56,32 +62,40 @@ queue_save_song(FILE *fp, int idx, const DetachedSong &song)
 		queue_save_full_song(fp, song);
 }
 
-void
-queue_save(FILE *fp, const Queue &queue)
+static void
+queue_save_item(FILE *fp, const Queue &queue, unsigned position)
 {
-	for (unsigned i = 0; i < queue.GetLength(); i++) {
-		uint8_t prio = queue.GetPriorityAtPosition(i);
-		if (prio != 0)
-			fprintf(fp, PRIO_LABEL "%u\n", prio);
+	uint8_t prio = queue.GetPriorityAtPosition(position);
+	if (prio != 0)
+		fprintf(fp, PRIO_LABEL "%u\n", prio);
 
-		queue_save_song(fp, i, queue.Get(i));
-	}
+	queue_save_song(fp, position, queue.Get(position));
 }
 
 void
-queue_load_song(TextFile &file, const SongLoader &loader,
-		const char *line, Queue &queue)
+queue_save(FILE *fp, const Queue &queue, unsigned start)
 {
-	if (queue.IsFull())
-		return;
+	for (unsigned i = start; i < queue.GetLength(); i++)
+		queue_save_item(fp, queue, i);
+}
 
-	uint8_t priority = 0;
+/**
+ * Loads one song from the state file.
+ *
+ * @return the song (to be freed by the caller), or nullptr on error
+ */
+static DetachedSong *
+queue_load_song(TextFile &file, const SongLoader &loader,
+		const char *line, uint8_t &priority_r)
+{
+	priority_r = 0;
 	if (StringStartsWith(line, PRIO_LABEL)) {
-		priority = strtoul(line + sizeof(PRIO_LABEL) - 1, nullptr, 10);
+		priority_r = strtoul(line + sizeof(PRIO_LABEL) - 1,
+				     nullptr, 10);
 
 		line = file.ReadLine();
 		if (line == nullptr)
-			return;
+			return nullptr;
 	}
 
 	DetachedSong *song;
@@ -93,7 +107,7 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 		song = song_load(file, uri, error);
 		if (song == nullptr) {
 			LogError(error);
-			return;
+			return nullptr;
 		}
 	} else {
 		char *endptr;
@@ -101,7 +115,7 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 		if (ret < 0 || *endptr != ':' || endptr[1] == 0) {
 			LogError(playlist_domain,
 				 "Malformed playlist line in state file");
-			return;
+			return nullptr;
 		}
 
 		const char *uri = endptr + 1;
@@ -111,9 +125,105 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 
 	if (!playlist_check_translate_song(*song, nullptr, loader)) {
 		delete song;
-		return;
+		return nullptr;
 	}
 
+	return song;
+}
+
+void
+queue_load_song(TextFile &file, const SongLoader &loader,
+		const char *line, Queue &queue)
+{
+	if (queue.IsFull())
+		return;
+
+	uint8_t priority;
+	DetachedSong *song = queue_load_song(file, loader, line, priority);
+	if (song == nullptr)
+		return;
+
+	map_song_compact(*song);
 	queue.Append(std::move(*song), priority);
 	delete song;
 }
+
+void
+queue_journal_save_song(FILE *fp, const Queue &queue, unsigned position)
+{
+	fprintf(fp, JOURNAL_SET "%u\n", position);
+	queue_save_item(fp, queue, position);
+}
+
+void
+queue_journal_save_tail(FILE *fp, const Queue &queue, unsigned start)
+{
+	assert(start <= queue.GetLength());
+
+	fprintf(fp, JOURNAL_TRUNCATE "%u\n", start);
+	queue_save(fp, queue, start);
+	fputs(JOURNAL_END "\n", fp);
+}
+
+/**
+ * Replace the song at the specified position with the one from the
+ * journal.
+ */
+static void
+queue_journal_load_song(TextFile &file, const SongLoader &loader,
+			unsigned position, Queue &queue)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr)
+		return;
+
+	uint8_t priority;
+	DetachedSong *song = queue_load_song(file, loader, line, priority);
+	if (song == nullptr)
+		return;
+
+	if (position < queue.GetLength()) {
+		DetachedSong &dest = queue.Get(position);
+		dest.SetURI(song->GetURI());
+		if (song->HasRealURI())
+			dest.SetRealURI(song->GetRealURI());
+		else
+			dest.ClearRealURI();
+		dest.SetTag(std::move(song->WritableTag()));
+		dest.SetLastModified(song->GetLastModified());
+		dest.SetStartMS(song->GetStartMS());
+		dest.SetEndMS(song->GetEndMS());
+		map_song_compact(dest);
+
+		queue.SetPriority(position, priority, -1);
+		queue.ModifyAtPosition(position);
+	}
+
+	delete song;
+}
+
+bool
+queue_journal_load(TextFile &file, const SongLoader &loader,
+		   const char *line, Queue &queue)
+{
+	if (StringStartsWith(line, JOURNAL_SET)) {
+		const unsigned position =
+			strtoul(line + sizeof(JOURNAL_SET) - 1, nullptr, 10);
+		queue_journal_load_song(file, loader, position, queue);
+		return true;
+	}
+
+	if (!StringStartsWith(line, JOURNAL_TRUNCATE))
+		return false;
+
+	const unsigned start =
+		strtoul(line + sizeof(JOURNAL_TRUNCATE) - 1, nullptr, 10);
+	if (start < queue.GetLength())
+		queue.DeleteRange(start, queue.GetLength());
+
+	while ((line = file.ReadLine()) != nullptr &&
+	       strcmp(line, JOURNAL_END) != 0)
+		queue_load_song(file, loader, line, queue);
+
+	return true;
+}
@@ -31,8 +31,11 @@ struct Queue;
 class TextFile;
 class SongLoader;
 
+/**
+ * Saves the songs of the queue, starting at the specified position.
+ */
 void
-queue_save(FILE *fp, const Queue &queue);
+queue_save(FILE *fp, const Queue &queue, unsigned start=0);
 
 /**
  * Loads one song from the state file and appends it to the queue.
@@ -41,4 +44,34 @@ void
 queue_load_song(TextFile &file, const SongLoader &loader,
 		const char *line, Queue &queue);
 
+/*
+ * The queue journal is a text file with records describing
+ * modifications of the queue, in the same format as the queue in the
+ * state file.
+ */
+
+/**
+ * Appends a record to the queue journal: the song at the specified
+ * position has been replaced.
+ */
+void
+queue_journal_save_song(FILE *fp, const Queue &queue, unsigned position);
+
+/**
+ * Appends a record to the queue journal: all songs after the
+ * specified position are replaced with the current ones.
+ */
+void
+queue_journal_save_tail(FILE *fp, const Queue &queue, unsigned start);
+
+/**
+ * Applies one queue journal record to the queue.
+ *
+ * @param line the current line of the journal
+ * @return false if the line does not start a journal record
+ */
+bool
+queue_journal_load(TextFile &file, const SongLoader &loader,
+		   const char *line, Queue &queue);
+
 #endif
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "LoudnessSticker.hxx"
+#include "StickerDatabase.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "util/NumberParser.hxx"
+
+#include <stdio.h>
+
+static constexpr char STICKER_TYPE[] = "song";
+
+static bool
+StoreFloat(const char *uri, const char *name, float value)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.2f", value);
+	return sticker_store_value(STICKER_TYPE, uri, name, buffer);
+}
+
+bool
+sticker_song_store_loudness(const char *uri, const ReplayGainTuple &track,
+			    const MixRampInfo &mix_ramp)
+{
+	bool success = true;
+
+	if (track.IsDefined()) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.6f", track.peak);
+
+		success = StoreFloat(uri, "replaygain_track_gain",
+				     track.gain) &&
+			sticker_store_value(STICKER_TYPE, uri,
+					    "replaygain_track_peak", buffer);
+	}
+
+	if (mix_ramp.GetStart() != nullptr)
+		success = sticker_store_value(STICKER_TYPE, uri,
+					      "mixramp_start",
+					      mix_ramp.GetStart()) && success;
+
+	if (mix_ramp.GetEnd() != nullptr)
+		success = sticker_store_value(STICKER_TYPE, uri,
+					      "mixramp_end",
+					      mix_ramp.GetEnd()) && success;
+
+	return success;
+}
+
+bool
+sticker_song_load_loudness(const char *uri, ReplayGainInfo &rgi,
+			   MixRampInfo &mix_ramp)
+{
+	rgi.Clear();
+	mix_ramp.Clear();
+
+	sticker *sticker = sticker_load(STICKER_TYPE, uri);
+	if (sticker == nullptr)
+		return false;
+
+	auto &track = rgi.tuples[REPLAY_GAIN_TRACK];
+
+	const char *gain = sticker_get_value(*sticker,
+					     "replaygain_track_gain");
+	const char *peak = sticker_get_value(*sticker,
+					     "replaygain_track_peak");
+	if (gain != nullptr && peak != nullptr) {
+		char *endptr;
+		const float g = ParseFloat(gain, &endptr);
+		if (endptr > gain && *endptr == 0) {
+			const float p = ParseFloat(peak, &endptr);
+			if (endptr > peak && *endptr == 0) {
+				track.gain = g;
+				track.peak = p;
+			}
+		}
+	}
+
+	mix_ramp.SetStart(sticker_get_value(*sticker, "mixramp_start"));
+	mix_ramp.SetEnd(sticker_get_value(*sticker, "mixramp_end"));
+
+	sticker_free(sticker);
+	return track.IsDefined();
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LOUDNESS_STICKER_HXX
+#define MPD_LOUDNESS_STICKER_HXX
+
+#include "Compiler.h"
+
+struct ReplayGainTuple;
+struct ReplayGainInfo;
+class MixRampInfo;
+
+/*
+ * The results of the loudness analysis (see db/update/AnalysisPool.hxx)
+ * are stored in the sticker database, with the same names as the
+ * tags: "replaygain_track_gain", "replaygain_track_peak",
+ * "mixramp_start" and "mixramp_end".
+ */
+
+/**
+ * Store the analysis results of a song.
+ *
+ * @param uri the song URI relative to the music directory
+ */
+bool
+sticker_song_store_loudness(const char *uri, const ReplayGainTuple &track,
+			    const MixRampInfo &mix_ramp);
+
+/**
+ * Load the analysis results of a song.  Only the track gain is
+ * analyzed; the album tuple of #rgi is left undefined.
+ *
+ * @param uri the song URI relative to the music directory
+ * @return true if a track gain was found
+ */
+bool
+sticker_song_load_loudness(const char *uri, ReplayGainInfo &rgi,
+			   MixRampInfo &mix_ramp);
+
+#endif
@@ -24,6 +24,9 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "util/Macros.hxx"
+#include "thread/Mutex.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "event/TimeoutMonitor.hxx"
 #include "Log.hxx"
 
 #include <string>
@@ -48,6 +51,8 @@ enum sticker_sql {
 	STICKER_SQL_DELETE,
 	STICKER_SQL_DELETE_VALUE,
 	STICKER_SQL_FIND,
+	STICKER_SQL_BEGIN,
+	STICKER_SQL_COMMIT,
 };
 
 static const char *const sticker_sql[] = {
@@ -65,6 +70,10 @@ static const char *const sticker_sql[] = {
 	"DELETE FROM sticker WHERE type=? AND uri=? AND name=?",
 	//[STICKER_SQL_FIND] =
 	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=?",
+	//[STICKER_SQL_BEGIN] =
+	"BEGIN",
+	//[STICKER_SQL_COMMIT] =
+	"COMMIT",
 };
 
 static const char sticker_sql_create[] =
@@ -76,11 +85,42 @@ static const char sticker_sql_create[] =
 	");"
 	"CREATE UNIQUE INDEX IF NOT EXISTS"
 	" sticker_value ON sticker(type, uri, name);"
+	"CREATE INDEX IF NOT EXISTS"
+	" sticker_name ON sticker(type, name, value);"
 	"";
 
+/**
+ * Write-ahead logging lets readers proceed while a write transaction
+ * is open, and needs fewer fsync() calls; "synchronous=NORMAL" is
+ * safe in this mode (a power failure may roll back the last
+ * transactions, but does not corrupt the database).  Older SQLite
+ * versions ignore these pragmas.
+ */
+static const char sticker_sql_pragmas[] =
+	"PRAGMA journal_mode=WAL;"
+	"PRAGMA synchronous=NORMAL;";
+
+/**
+ * Writes are collected in one transaction which is committed this
+ * many milliseconds after the first write.
+ */
+static constexpr unsigned STICKER_COMMIT_DELAY_MS = 1000;
+
 static sqlite3 *sticker_db;
 static sqlite3_stmt *sticker_stmt[ARRAY_SIZE(sticker_sql)];
 
+/**
+ * Protects the prepared statements, which are shared by all callers.
+ * Stickers are not only accessed by the main thread, but also by the
+ * loudness analysis and the decoder thread.
+ */
+static Mutex sticker_mutex;
+
+/**
+ * Is a write transaction open?  Protected by #sticker_mutex.
+ */
+static bool sticker_transaction;
+
 static constexpr Domain sticker_domain("sticker");
 
 static void
@@ -89,6 +129,116 @@ LogError(sqlite3 *db, const char *msg)
 	FormatError(sticker_domain, "%s: %s", msg, sqlite3_errmsg(db));
 }
 
+/**
+ * Commits the write transaction #STICKER_COMMIT_DELAY_MS after it
+ * has been started.  Writes happen in several threads, but
+ * #TimeoutMonitor may only be used in the #EventLoop thread, so
+ * Schedule() goes through a #DeferredMonitor.
+ */
+class StickerCommitTimer final : DeferredMonitor {
+	class Timeout final : public TimeoutMonitor {
+	public:
+		explicit Timeout(EventLoop &_loop)
+			:TimeoutMonitor(_loop) {}
+
+	protected:
+		virtual void OnTimeout() override;
+	};
+
+	Timeout timeout;
+
+public:
+	explicit StickerCommitTimer(EventLoop &_loop)
+		:DeferredMonitor(_loop), timeout(_loop) {}
+
+	/**
+	 * This method is thread-safe.
+	 */
+	using DeferredMonitor::Schedule;
+
+	/**
+	 * Must be called from the #EventLoop thread.
+	 */
+	void Cancel() {
+		DeferredMonitor::Cancel();
+		timeout.Cancel();
+	}
+
+protected:
+	virtual void RunDeferred() override {
+		if (!timeout.IsActive())
+			timeout.Schedule(STICKER_COMMIT_DELAY_MS);
+	}
+};
+
+static StickerCommitTimer *sticker_commit_timer;
+
+/**
+ * Execute a statement which does not return rows.
+ */
+static bool
+sticker_step(sqlite3_stmt *stmt)
+{
+	int ret;
+
+	sqlite3_reset(stmt);
+
+	do {
+		ret = sqlite3_step(stmt);
+	} while (ret == SQLITE_BUSY);
+
+	sqlite3_reset(stmt);
+
+	if (ret != SQLITE_DONE) {
+		LogError(sticker_db, "sqlite3_step() failed");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Prepare a write: open a transaction unless one is already open.
+ * If that fails, the write is done in autocommit mode.  Caller must
+ * lock #sticker_mutex.
+ */
+static void
+sticker_begin_write()
+{
+	if (sticker_transaction)
+		return;
+
+	if (!sticker_step(sticker_stmt[STICKER_SQL_BEGIN]))
+		return;
+
+	sticker_transaction = true;
+	sticker_commit_timer->Schedule();
+}
+
+/**
+ * Commit the write transaction, if one is open.  Caller must lock
+ * #sticker_mutex.
+ */
+static void
+sticker_commit()
+{
+	if (!sticker_transaction)
+		return;
+
+	sticker_transaction = false;
+
+	if (!sticker_step(sticker_stmt[STICKER_SQL_COMMIT]))
+		/* don't leave the transaction open */
+		sqlite3_exec(sticker_db, "ROLLBACK", nullptr, nullptr, nullptr);
+}
+
+void
+StickerCommitTimer::Timeout::OnTimeout()
+{
+	const ScopeLock protect(sticker_mutex);
+	sticker_commit();
+}
+
 static sqlite3_stmt *
 sticker_prepare(const char *sql, Error &error)
 {
@@ -107,7 +257,7 @@ sticker_prepare(const char *sql, Error &error)
 }
 
 bool
-sticker_global_init(Path path, Error &error)
+sticker_global_init(EventLoop &loop, Path path, Error &error)
 {
 	assert(!path.IsNull());
 
@@ -124,6 +274,12 @@ sticker_global_init(Path path, Error &error)
 		return false;
 	}
 
+	ret = sqlite3_exec(sticker_db, sticker_sql_pragmas,
+			   nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK)
+		/* not fatal, continue in rollback journal mode */
+		LogError(sticker_db, "Failed to enable write-ahead logging");
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(sticker_db, sticker_sql_create,
@@ -145,6 +301,8 @@ sticker_global_init(Path path, Error &error)
 			return false;
 	}
 
+	sticker_commit_timer = new StickerCommitTimer(loop);
+
 	return true;
 }
 
@@ -155,6 +313,13 @@ sticker_global_finish(void)
 		/* not configured */
 		return;
 
+	sticker_commit_timer->Cancel();
+	delete sticker_commit_timer;
+
+	sticker_mutex.lock();
+	sticker_commit();
+	sticker_mutex.unlock();
+
 	for (unsigned i = 0; i < ARRAY_SIZE(sticker_stmt); ++i) {
 		assert(sticker_stmt[i] != nullptr);
 
@@ -173,6 +338,8 @@ sticker_enabled(void)
 std::string
 sticker_load_value(const char *type, const char *uri, const char *name)
 {
+	const ScopeLock protect(sticker_mutex);
+
 	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_GET];
 	int ret;
 
@@ -399,6 +566,8 @@ bool
 sticker_store_value(const char *type, const char *uri,
 		    const char *name, const char *value)
 {
+	const ScopeLock protect(sticker_mutex);
+
 	assert(sticker_enabled());
 	assert(type != nullptr);
 	assert(uri != nullptr);
@@ -408,6 +577,8 @@ sticker_store_value(const char *type, const char *uri,
 	if (*name == 0)
 		return false;
 
+	sticker_begin_write();
+
 	return sticker_update_value(type, uri, name, value) ||
 		sticker_insert_value(type, uri, name, value);
 }
@@ -415,6 +586,8 @@ sticker_store_value(const char *type, const char *uri,
 bool
 sticker_delete(const char *type, const char *uri)
 {
+	const ScopeLock protect(sticker_mutex);
+
 	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_DELETE];
 	int ret;
 
@@ -422,6 +595,8 @@ sticker_delete(const char *type, const char *uri)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	sticker_begin_write();
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, type, -1, nullptr);
@@ -455,6 +630,8 @@ sticker_delete(const char *type, const char *uri)
 bool
 sticker_delete_value(const char *type, const char *uri, const char *name)
 {
+	const ScopeLock protect(sticker_mutex);
+
 	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_DELETE_VALUE];
 	int ret;
 
@@ -462,6 +639,8 @@ sticker_delete_value(const char *type, const char *uri, const char *name)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	sticker_begin_write();
+
 	sqlite3_reset(stmt);
 
 	ret = sqlite3_bind_text(stmt, 1, type, -1, nullptr);
@@ -529,6 +708,8 @@ sticker_foreach(const sticker &sticker,
 struct sticker *
 sticker_load(const char *type, const char *uri)
 {
+	const ScopeLock protect(sticker_mutex);
+
 	sticker s;
 
 	if (!sticker_list_values(s.table, type, uri))
@@ -547,6 +728,8 @@ sticker_find(const char *type, const char *base_uri, const char *name,
 			  void *user_data),
 	     void *user_data)
 {
+	const ScopeLock protect(sticker_mutex);
+
 	sqlite3_stmt *const stmt = sticker_stmt[STICKER_SQL_FIND];
 	int ret;
 
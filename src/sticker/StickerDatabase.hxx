@@ -46,6 +46,7 @@
 
 #include <string>
 
+class EventLoop;
 class Error;
 class Path;
 struct sticker;
@@ -56,7 +57,7 @@ struct sticker;
  * @return true on success, false on error
  */
 bool
-sticker_global_init(Path path, Error &error);
+sticker_global_init(EventLoop &loop, Path path, Error &error);
 
 /**
  * Close the sticker database.
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "StickerQuery.hxx"
+#include "StickerDatabase.hxx"
+#include "StickerPrint.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+static constexpr char STICKER_SORT_PREFIX[] = "sticker:";
+
+const char *
+StickerQuery::Column::Get(const std::string &uri) const
+{
+	const auto i = values.find(uri);
+	return i != values.end()
+		? i->second.c_str()
+		: nullptr;
+}
+
+/**
+ * Compare two sticker values.  If both are numbers, they are
+ * compared numerically (so "10" is greater than "9"), else as
+ * strings.
+ */
+gcc_pure
+static int
+CompareStickerValues(const char *a, const char *b)
+{
+	char *endptr;
+	const double na = strtod(a, &endptr);
+	if (endptr != a && *endptr == 0) {
+		const double nb = strtod(b, &endptr);
+		if (endptr != b && *endptr == 0)
+			return na < nb ? -1 : (na > nb ? 1 : 0);
+	}
+
+	return strcmp(a, b);
+}
+
+bool
+StickerQuery::Condition::Match(const char *actual) const
+{
+	if (actual == nullptr)
+		/* songs without this sticker never match */
+		return false;
+
+	switch (op) {
+	case Operator::EQUALS:
+		return value == actual;
+
+	case Operator::LESS:
+		return CompareStickerValues(actual, value.c_str()) < 0;
+
+	case Operator::GREATER:
+		return CompareStickerValues(actual, value.c_str()) > 0;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
+unsigned
+StickerQuery::FindOrAdd(const char *name)
+{
+	for (unsigned i = 0; i < columns.size(); ++i)
+		if (columns[i].name == name)
+			return i;
+
+	columns.emplace_back(name);
+	return columns.size() - 1;
+}
+
+int
+StickerQuery::Parse(ConstBuffer<const char *> args)
+{
+	if (args.IsEmpty())
+		return 0;
+
+	if (strcmp(args[0], "sticker") == 0) {
+		if (args.size < 2 || *args[1] == 0)
+			return -1;
+
+		const unsigned column = FindOrAdd(args[1]);
+		if (args.size < 4)
+			return 2;
+
+		Operator op;
+		if (strcmp(args[2], "=") == 0)
+			op = Operator::EQUALS;
+		else if (strcmp(args[2], "<") == 0)
+			op = Operator::LESS;
+		else if (strcmp(args[2], ">") == 0)
+			op = Operator::GREATER;
+		else
+			/* no condition; the next argument is a
+			   filter tag */
+			return 2;
+
+		conditions.emplace_back(column, op, args[3]);
+		return 4;
+	} else if (strcmp(args[0], "sort") == 0) {
+		if (args.size < 2 || IsSorted())
+			return -1;
+
+		const char *p = args[1];
+		const bool descending = *p == '-';
+		if (descending)
+			++p;
+
+		const size_t prefix_length = sizeof(STICKER_SORT_PREFIX) - 1;
+		if (memcmp(p, STICKER_SORT_PREFIX, prefix_length) != 0 ||
+		    p[prefix_length] == 0)
+			return -1;
+
+		sort = FindOrAdd(p + prefix_length);
+		sort_descending = descending;
+		return 2;
+	} else
+		return 0;
+}
+
+static void
+sticker_query_load_cb(const char *uri, const char *value, void *user_data)
+{
+	auto &column = *(StickerQuery::Column *)user_data;
+
+	column.values.emplace(uri, value);
+}
+
+bool
+StickerQuery::Load()
+{
+	for (auto &i : columns) {
+		i.values.clear();
+
+		if (!sticker_find("song", nullptr, i.name.c_str(),
+				  sticker_query_load_cb, &i))
+			return false;
+	}
+
+	return true;
+}
+
+bool
+StickerQuery::Match(const std::string &uri) const
+{
+	for (const auto &i : conditions)
+		if (!i.Match(columns[i.column].Get(uri)))
+			return false;
+
+	return true;
+}
+
+bool
+StickerQuery::Less(const std::string &a, const std::string &b) const
+{
+	assert(IsSorted());
+
+	const Column &column = columns[sort];
+	const char *va = column.Get(a), *vb = column.Get(b);
+
+	/* songs without this sticker are always last */
+	if (va == nullptr || vb == nullptr)
+		return va != nullptr && vb == nullptr;
+
+	const int cmp = CompareStickerValues(va, vb);
+	return sort_descending ? cmp > 0 : cmp < 0;
+}
+
+void
+StickerQuery::Print(Client &client, const std::string &uri) const
+{
+	for (const auto &i : columns) {
+		const char *value = i.Get(uri);
+		if (value != nullptr)
+			sticker_print_value(client, i.name.c_str(), value);
+	}
+}
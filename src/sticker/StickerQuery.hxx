@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_STICKER_QUERY_HXX
+#define MPD_STICKER_QUERY_HXX
+
+#include "Compiler.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+template<typename T> struct ConstBuffer;
+class Client;
+
+/**
+ * The sticker part of a "find"/"search" command: conditions on
+ * sticker values, a sort order and the sticker values to be printed
+ * with each song.  Instead of one sticker lookup per song, the
+ * values of each referenced sticker name are loaded with one query
+ * into a map and joined against the songs visited in the database.
+ */
+class StickerQuery {
+public:
+	enum class Operator {
+		EQUALS,
+		LESS,
+		GREATER,
+	};
+
+	/**
+	 * One sticker name referenced by the command.
+	 */
+	struct Column {
+		std::string name;
+
+		/**
+		 * The sticker values loaded by Load(), indexed by
+		 * song URI.
+		 */
+		std::unordered_map<std::string, std::string> values;
+
+		explicit Column(const char *_name):name(_name) {}
+
+		/**
+		 * @return the value or nullptr if the song has no
+		 * such sticker
+		 */
+		gcc_pure
+		const char *Get(const std::string &uri) const;
+	};
+
+	struct Condition {
+		unsigned column;
+
+		Operator op;
+
+		std::string value;
+
+		Condition(unsigned _column, Operator _op, const char *_value)
+			:column(_column), op(_op), value(_value) {}
+
+		gcc_pure
+		bool Match(const char *actual) const;
+	};
+
+private:
+	std::vector<Column> columns;
+
+	std::vector<Condition> conditions;
+
+	/**
+	 * The index of the #Column to sort by, or -1 if the result
+	 * is not sorted.
+	 */
+	int sort;
+
+	bool sort_descending;
+
+public:
+	StickerQuery():sort(-1), sort_descending(false) {}
+
+	bool IsEmpty() const {
+		return columns.empty();
+	}
+
+	bool IsSorted() const {
+		return sort >= 0;
+	}
+
+	/**
+	 * Attempt to parse one sticker expression at the beginning
+	 * of the argument list: "sticker NAME [OP VALUE]" (OP being
+	 * "=", "<" or ">") or "sort [-]sticker:NAME".
+	 *
+	 * @return the number of arguments consumed, 0 if this is
+	 * not a sticker expression, -1 on syntax error
+	 */
+	int Parse(ConstBuffer<const char *> args);
+
+	/**
+	 * Load the values of all referenced stickers from the
+	 * sticker database.
+	 *
+	 * @return false on error
+	 */
+	bool Load();
+
+	/**
+	 * Does the song with the given URI match all conditions?
+	 */
+	gcc_pure
+	bool Match(const std::string &uri) const;
+
+	/**
+	 * Compare two songs according to the sort order.
+	 *
+	 * @return true if the song #a shall be printed before #b
+	 */
+	gcc_pure
+	bool Less(const std::string &a, const std::string &b) const;
+
+	/**
+	 * Send the sticker values of one song to the client.
+	 */
+	void Print(Client &client, const std::string &uri) const;
+
+private:
+	/**
+	 * @return the index of the #Column
+	 */
+	unsigned FindOrAdd(const char *name);
+};
+
+#endif
@@ -24,6 +24,9 @@
 #include "util/Domain.hxx"
 
 #include <set>
+#include <algorithm>
+
+#include <string.h>
 
 static constexpr Domain composite_domain("composite");
 
@@ -203,6 +206,7 @@ CompositeStorage::Directory::MapToRelativeUTF8(std::string &buffer,
 }
 
 CompositeStorage::CompositeStorage()
+	:users(0)
 {
 }
 
@@ -210,10 +214,69 @@ CompositeStorage::~CompositeStorage()
 {
 }
 
+const char *
+CompositeStorage::MountPoint::Match(const char *other) const
+{
+	if (strncmp(other, uri.data(), uri.length()) != 0)
+		return nullptr;
+
+	other += uri.length();
+	if (*other == '/')
+		return other + 1;
+
+	if (*other != 0)
+		/* the mount point is only a prefix of a path
+		   segment */
+		return nullptr;
+
+	return other;
+}
+
+void
+CompositeStorage::CollectMountPoints(std::string &uri,
+				     const Directory &directory)
+{
+	if (!uri.empty())
+		uri.push_back('/');
+
+	const size_t uri_length = uri.length();
+
+	for (const auto &i : directory.children) {
+		uri.resize(uri_length);
+		uri.append(i.first);
+
+		if (i.second.storage != nullptr)
+			mount_points.emplace_back(std::string(uri), i.second);
+
+		CollectMountPoints(uri, i.second);
+	}
+}
+
+void
+CompositeStorage::UpdateMountPoints()
+{
+	mount_points.clear();
+
+	std::string uri;
+	CollectMountPoints(uri, root);
+
+	std::stable_sort(mount_points.begin(), mount_points.end(),
+			 [](const MountPoint &a, const MountPoint &b){
+				 return a.uri.length() > b.uri.length();
+			 });
+}
+
+inline void
+CompositeStorage::WaitUnused()
+{
+	while (users > 0)
+		users_cond.wait(mutex);
+}
+
 Storage *
 CompositeStorage::GetMount(const char *uri)
 {
-	const ScopeLock protect(mutex);
+	const ScopeSharedLock protect(tree_mutex);
 
 	auto result = FindStorage(uri);
 	if (*result.uri != 0)
@@ -228,10 +291,19 @@ CompositeStorage::Mount(const char *uri, Storage *storage)
 {
 	const ScopeLock protect(mutex);
 
+	const Directory *old = root.Find(uri);
+	if (old != nullptr && old->storage != nullptr)
+		/* wait before locking the tree, because the users
+		   need to lock it to finish */
+		WaitUnused();
+
+	const ScopeExclusiveLock protect_tree(tree_mutex);
+
 	Directory &directory = root.Make(uri);
-	if (directory.storage != nullptr)
-		delete directory.storage;
+	delete directory.storage;
 	directory.storage = storage;
+
+	UpdateMountPoints();
 }
 
 bool
@@ -239,28 +311,27 @@ CompositeStorage::Unmount(const char *uri)
 {
 	const ScopeLock protect(mutex);
 
-	return root.Unmount(uri);
+	WaitUnused();
+
+	const ScopeExclusiveLock protect_tree(tree_mutex);
+
+	if (!root.Unmount(uri))
+		return false;
+
+	UpdateMountPoints();
+	return true;
 }
 
 CompositeStorage::FindResult
 CompositeStorage::FindStorage(const char *uri) const
 {
-	FindResult result{&root, uri};
-
-	const Directory *directory = &root;
-	while (*uri != 0) {
-		const std::string name = NextSegment(uri);
-
-		auto i = directory->children.find(name);
-		if (i == directory->children.end())
-			break;
-
-		directory = &i->second;
-		if (directory->storage != nullptr)
-			result = FindResult{directory, uri};
+	for (const auto &i : mount_points) {
+		const char *rest = i.Match(uri);
+		if (rest != nullptr)
+			return FindResult{i.directory, rest};
 	}
 
-	return result;
+	return FindResult{&root, uri};
 }
 
 CompositeStorage::FindResult
@@ -276,7 +347,7 @@ bool
 CompositeStorage::GetInfo(const char *uri, bool follow, FileInfo &info,
 			  Error &error)
 {
-	const ScopeLock protect(mutex);
+	const ScopeSharedLock protect(tree_mutex);
 
 	auto f = FindStorage(uri, error);
 	if (f.directory->storage != nullptr &&
@@ -300,7 +371,7 @@ StorageDirectoryReader *
 CompositeStorage::OpenDirectory(const char *uri,
 				Error &error)
 {
-	const ScopeLock protect(mutex);
+	const ScopeSharedLock protect(tree_mutex);
 
 	auto f = FindStorage(uri, error);
 	const Directory *directory = f.directory->Find(f.uri);
@@ -321,7 +392,7 @@ CompositeStorage::OpenDirectory(const char *uri,
 std::string
 CompositeStorage::MapUTF8(const char *uri) const
 {
-	const ScopeLock protect(mutex);
+	const ScopeSharedLock protect(tree_mutex);
 
 	auto f = FindStorage(uri);
 	if (f.directory->storage == nullptr)
@@ -333,7 +404,7 @@ CompositeStorage::MapUTF8(const char *uri) const
 AllocatedPath
 CompositeStorage::MapFS(const char *uri) const
 {
-	const ScopeLock protect(mutex);
+	const ScopeSharedLock protect(tree_mutex);
 
 	auto f = FindStorage(uri);
 	if (f.directory->storage == nullptr)
@@ -345,7 +416,8 @@ CompositeStorage::MapFS(const char *uri) const
 const char *
 CompositeStorage::MapToRelativeUTF8(const char *uri) const
 {
-	const ScopeLock protect(mutex);
+	/* exclusive because this method writes to relative_buffer */
+	const ScopeExclusiveLock protect(tree_mutex);
 
 	if (root.storage != nullptr) {
 		const char *result = root.storage->MapToRelativeUTF8(uri);
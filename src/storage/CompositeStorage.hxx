@@ -23,9 +23,12 @@
 #include "check.h"
 #include "StorageInterface.hxx"
 #include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/SharedMutex.hxx"
 #include "Compiler.h"
 
 #include <string>
+#include <vector>
 #include <map>
 
 class Error;
@@ -81,17 +84,93 @@ class CompositeStorage final : public Storage {
 	};
 
 	/**
-	 * Protects the virtual #Directory tree.
-	 *
-	 * TODO: use readers-writer lock
+	 * An entry in #mount_points.
+	 */
+	struct MountPoint {
+		std::string uri;
+
+		const Directory *directory;
+
+		MountPoint(std::string &&_uri, const Directory &_directory)
+			:uri(std::move(_uri)), directory(&_directory) {}
+
+		/**
+		 * Is the given URI inside this mount point?
+		 *
+		 * @return the URI relative to the mount point or
+		 * nullptr on mismatch
+		 */
+		gcc_pure
+		const char *Match(const char *other) const;
+	};
+
+	/**
+	 * Protects the virtual #Directory tree and #mount_points.
+	 * Lookups share it, so the threads which map URIs do not
+	 * block each other; only Mount() and Unmount() lock it
+	 * exclusively.
+	 */
+	mutable SharedMutex tree_mutex;
+
+	/**
+	 * Protects #users.
 	 */
 	mutable Mutex mutex;
 
+	/**
+	 * Signalled when #users drops to zero.
+	 */
+	Cond users_cond;
+
+	/**
+	 * The number of #ScopeUse instances, i.e. threads other than
+	 * the main thread which use a mounted #Storage.  Mount() and
+	 * Unmount() wait until this is zero before destroying a
+	 * #Storage.  Protected by #mutex.
+	 */
+	unsigned users;
+
 	Directory root;
 
+	/**
+	 * All #Directory instances with a #Storage (except for
+	 * #root), the longest URI first.  FindStorage() picks the
+	 * first one which matches, without walking the tree.
+	 */
+	std::vector<MountPoint> mount_points;
+
+	/**
+	 * The return value of MapToRelativeUTF8().  Protected by
+	 * locking #tree_mutex exclusively.
+	 */
 	mutable std::string relative_buffer;
 
 public:
+	/**
+	 * Keeps the mounted storages alive while the calling thread
+	 * (not the main thread) uses them.  Don't hold it while
+	 * waiting for the main thread.
+	 */
+	class ScopeUse {
+		CompositeStorage &composite;
+
+	public:
+		explicit ScopeUse(CompositeStorage &_composite)
+			:composite(_composite) {
+			const ScopeLock protect(composite.mutex);
+			++composite.users;
+		}
+
+		~ScopeUse() {
+			const ScopeLock protect(composite.mutex);
+			if (--composite.users == 0)
+				composite.users_cond.broadcast();
+		}
+
+		ScopeUse(const ScopeUse &) = delete;
+		ScopeUse &operator=(const ScopeUse &) = delete;
+	};
+
 	CompositeStorage();
 	virtual ~CompositeStorage();
 
@@ -113,7 +192,7 @@ public:
 	 */
 	template<typename T>
 	void VisitMounts(T t) const {
-		const ScopeLock protect(mutex);
+		const ScopeSharedLock protect(tree_mutex);
 		std::string uri;
 		VisitMounts(uri, root, t);
 	}
@@ -155,6 +234,25 @@ private:
 		}
 	}
 
+	/**
+	 * Rebuild #mount_points after the tree has been modified.
+	 * Caller must lock #tree_mutex exclusively.
+	 */
+	void UpdateMountPoints();
+
+	void CollectMountPoints(std::string &uri,
+				const Directory &directory);
+
+	/**
+	 * Wait until there are no #ScopeUse instances.  Caller must
+	 * lock #mutex.
+	 */
+	void WaitUnused();
+
+	/**
+	 * Find the #Storage which is responsible for the given URI.
+	 * Caller must lock #tree_mutex.
+	 */
 	gcc_pure
 	FindResult FindStorage(const char *uri) const;
 	FindResult FindStorage(const char *uri, Error &error) const;
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ListCache.hxx"
+#include "StorageInterface.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+
+#include <string.h>
+
+/**
+ * After this many TTLs, an item is listed again even if the
+ * directory's modification time is unchanged.
+ */
+static constexpr unsigned LIST_CACHE_MAX_AGE_FACTOR = 10;
+
+std::shared_ptr<const StorageListing>
+ListStorageDirectory(Storage &storage, const char *uri, Error &error)
+{
+	StorageDirectoryReader *reader = storage.OpenDirectory(uri, error);
+	if (reader == nullptr)
+		return nullptr;
+
+	auto listing = std::make_shared<StorageListing>();
+
+	const char *name_utf8;
+	while ((name_utf8 = reader->Read()) != nullptr) {
+		if (strchr(name_utf8, '\n') != nullptr)
+			continue;
+
+		FileInfo info;
+		if (!reader->GetInfo(false, info, IgnoreError()))
+			continue;
+
+		listing->emplace_back(name_utf8, info);
+	}
+
+	delete reader;
+	return listing;
+}
+
+void
+StorageListCache::Erase(std::map<std::string, Item>::iterator i)
+{
+	lru.erase(i->second.lru_position);
+	map.erase(i);
+}
+
+StorageListCache::Lookup
+StorageListCache::Get(const std::string &key,
+		      std::shared_ptr<const StorageListing> &listing_r,
+		      time_t &mtime_r)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(key);
+	if (i == map.end())
+		return Lookup::MISS;
+
+	const unsigned now = MonotonicClockS();
+	Item &item = i->second;
+	if (now - item.listed >= ttl * LIST_CACHE_MAX_AGE_FACTOR) {
+		Erase(i);
+		return Lookup::MISS;
+	}
+
+	/* move to the front of the LRU list */
+	lru.splice(lru.begin(), lru, item.lru_position);
+
+	listing_r = item.listing;
+	mtime_r = item.mtime;
+	return now - item.validated < ttl
+		? Lookup::FRESH
+		: Lookup::REVALIDATE;
+}
+
+void
+StorageListCache::Validated(const std::string &key)
+{
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(key);
+	if (i != map.end())
+		i->second.validated = MonotonicClockS();
+}
+
+void
+StorageListCache::Put(const std::string &key,
+		      std::shared_ptr<const StorageListing> listing,
+		      time_t mtime)
+{
+	const unsigned now = MonotonicClockS();
+
+	const ScopeLock protect(mutex);
+
+	auto i = map.find(key);
+	if (i == map.end()) {
+		while (map.size() >= max_size)
+			/* evict the least recently used item */
+			Erase(map.find(*lru.back()));
+
+		i = map.insert(std::make_pair(key, Item())).first;
+		lru.push_front(&i->first);
+		i->second.lru_position = lru.begin();
+	} else
+		lru.splice(lru.begin(), lru, i->second.lru_position);
+
+	Item &item = i->second;
+	item.listing = std::move(listing);
+	item.mtime = mtime;
+	item.validated = item.listed = now;
+}
+
+std::shared_ptr<const StorageListing>
+StorageListCache::List(Storage &storage, const char *uri, Error &error)
+{
+	if (!IsEnabled() || !storage.MapFS(uri).IsNull())
+		/* local directories are cheap to list, and their
+		   contents are not cached */
+		return ListStorageDirectory(storage, uri, error);
+
+	const std::string key = storage.MapUTF8(uri);
+	if (key.empty())
+		return ListStorageDirectory(storage, uri, error);
+
+	std::shared_ptr<const StorageListing> listing;
+	time_t mtime;
+	switch (Get(key, listing, mtime)) {
+	case Lookup::MISS:
+		break;
+
+	case Lookup::FRESH:
+		return listing;
+
+	case Lookup::REVALIDATE: {
+		FileInfo info;
+		if (mtime != 0 &&
+		    storage.GetInfo(uri, true, info, IgnoreError()) &&
+		    info.mtime == mtime) {
+			Validated(key);
+			return listing;
+		}
+
+		break;
+	}
+	}
+
+	/* obtain the modification time before listing, so a change
+	   while listing is noticed by the next revalidation */
+	FileInfo info;
+	if (!storage.GetInfo(uri, true, info, IgnoreError()))
+		info.mtime = 0;
+
+	listing = ListStorageDirectory(storage, uri, error);
+	if (listing != nullptr)
+		Put(key, listing, info.mtime);
+
+	return listing;
+}
+
+void
+StorageListCache::Clear()
+{
+	const ScopeLock protect(mutex);
+
+	map.clear();
+	lru.clear();
+}
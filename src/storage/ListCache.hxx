@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STORAGE_LIST_CACHE_HXX
+#define MPD_STORAGE_LIST_CACHE_HXX
+
+#include "check.h"
+#include "FileInfo.hxx"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+
+class Storage;
+class Error;
+
+struct StorageListEntry {
+	std::string name;
+
+	FileInfo info;
+
+	StorageListEntry(const char *_name, const FileInfo &_info)
+		:name(_name), info(_info) {}
+};
+
+typedef std::vector<StorageListEntry> StorageListing;
+
+/**
+ * List a directory of the storage without the cache.  Entries whose
+ * name contains a newline are omitted.
+ *
+ * @return the listing or nullptr on error
+ */
+std::shared_ptr<const StorageListing>
+ListStorageDirectory(Storage &storage, const char *uri, Error &error);
+
+/**
+ * A cache of directory listings of remote storages (NFS, SMB), keyed
+ * by the mapped URI.  Within the TTL, an item is used without asking
+ * the server.  After that, it is revalidated by comparing the
+ * directory's modification time, which costs one round trip instead
+ * of one per entry.  After 10 times the TTL, the directory is listed
+ * again, because file sizes may have changed without touching the
+ * directory.  Local directories are never cached.
+ *
+ * This class is thread-safe.  The mutex is not held while talking to
+ * the storage.
+ */
+class StorageListCache {
+	struct Item {
+		std::shared_ptr<const StorageListing> listing;
+
+		/**
+		 * The modification time of the directory when it was
+		 * listed; 0 if unknown.
+		 */
+		time_t mtime;
+
+		/**
+		 * When was this item listed or revalidated
+		 * (MonotonicClockS())?
+		 */
+		unsigned validated;
+
+		/**
+		 * When was this item listed (MonotonicClockS())?
+		 */
+		unsigned listed;
+
+		/**
+		 * The position of this item in #lru.
+		 */
+		std::list<const std::string *>::iterator lru_position;
+	};
+
+	const unsigned ttl;
+	const unsigned max_size;
+
+	Mutex mutex;
+
+	std::map<std::string, Item> map;
+
+	/**
+	 * Pointers to the keys in #map; the most recently used one is
+	 * at the front.
+	 */
+	std::list<const std::string *> lru;
+
+public:
+	/**
+	 * @param _ttl the number of seconds an item is trusted
+	 * without revalidation; 0 disables the cache
+	 * @param _max_size the maximum number of directories
+	 */
+	StorageListCache(unsigned _ttl, unsigned _max_size)
+		:ttl(_ttl), max_size(_max_size) {}
+
+	bool IsEnabled() const {
+		return ttl > 0 && max_size > 0;
+	}
+
+	/**
+	 * List a directory of the storage, using and filling the
+	 * cache.  Entries whose name contains a newline are
+	 * omitted.
+	 *
+	 * @return the listing or nullptr on error
+	 */
+	std::shared_ptr<const StorageListing> List(Storage &storage,
+						   const char *uri,
+						   Error &error);
+
+	/**
+	 * Forget all items, e.g. after a storage has been unmounted.
+	 */
+	void Clear();
+
+private:
+	enum class Lookup {
+		MISS,
+		FRESH,
+		REVALIDATE,
+	};
+
+	Lookup Get(const std::string &key,
+		   std::shared_ptr<const StorageListing> &listing_r,
+		   time_t &mtime_r);
+
+	void Validated(const std::string &key);
+
+	void Put(const std::string &key,
+		 std::shared_ptr<const StorageListing> listing,
+		 time_t mtime);
+
+	void Erase(std::map<std::string, Item>::iterator i);
+};
+
+#endif
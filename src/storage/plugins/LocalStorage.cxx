@@ -25,10 +25,14 @@
 #include "util/Error.hxx"
 #include "fs/FileSystem.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "fs/Charset.hxx"
 #include "fs/DirectoryReader.hxx"
+#include "thread/Mutex.hxx"
 
 #include <string>
 
+#include <string.h>
+
 class LocalDirectoryReader final : public StorageDirectoryReader {
 	AllocatedPath base_fs;
 
@@ -54,9 +58,25 @@ class LocalStorage final : public Storage {
 	const AllocatedPath base_fs;
 	const std::string base_utf8;
 
+	/**
+	 * Protects #cache_directory_utf8 and #cache_directory_fs.
+	 */
+	mutable Mutex cache_mutex;
+
+	/**
+	 * The directory most recently mapped by MapFS() (relative
+	 * UTF-8 URI) and its converted absolute path.  Consecutive
+	 * calls usually refer to files in the same directory, so this
+	 * saves converting the directory part of the URI again.  Only
+	 * used if the file system charset is not UTF-8.
+	 */
+	mutable std::string cache_directory_utf8;
+	mutable AllocatedPath cache_directory_fs;
+
 public:
 	explicit LocalStorage(Path _base_fs)
-		:base_fs(_base_fs), base_utf8(base_fs.ToUTF8()) {
+		:base_fs(_base_fs), base_utf8(base_fs.ToUTF8()),
+		 cache_directory_fs(AllocatedPath::Null()) {
 		assert(!base_fs.IsNull());
 		assert(!base_utf8.empty());
 	}
@@ -76,6 +96,12 @@ public:
 
 private:
 	AllocatedPath MapFS(const char *uri_utf8, Error &error) const;
+
+	/**
+	 * Map a relative directory URI, consulting the cache.
+	 */
+	AllocatedPath MapDirectoryFS(std::string &&directory_utf8,
+				     Error &error) const;
 };
 
 static bool
@@ -115,6 +141,29 @@ LocalStorage::MapUTF8(const char *uri_utf8) const
 	return PathTraitsUTF8::Build(base_utf8.c_str(), uri_utf8);
 }
 
+AllocatedPath
+LocalStorage::MapDirectoryFS(std::string &&directory_utf8,
+			     Error &error) const
+{
+	{
+		const ScopeLock protect(cache_mutex);
+		if (directory_utf8 == cache_directory_utf8)
+			return cache_directory_fs;
+	}
+
+	AllocatedPath directory_fs =
+		AllocatedPath::FromUTF8(directory_utf8.c_str(), error);
+	if (directory_fs.IsNull())
+		return directory_fs;
+
+	directory_fs = AllocatedPath::Build(base_fs, directory_fs);
+
+	const ScopeLock protect(cache_mutex);
+	cache_directory_utf8 = std::move(directory_utf8);
+	cache_directory_fs = directory_fs;
+	return directory_fs;
+}
+
 AllocatedPath
 LocalStorage::MapFS(const char *uri_utf8, Error &error) const
 {
@@ -123,11 +172,29 @@ LocalStorage::MapFS(const char *uri_utf8, Error &error) const
 	if (*uri_utf8 == 0)
 		return base_fs;
 
-	AllocatedPath path_fs = AllocatedPath::FromUTF8(uri_utf8, error);
-	if (!path_fs.IsNull())
-		path_fs = AllocatedPath::Build(base_fs, path_fs);
-
-	return path_fs;
+	if (IsFSCharsetUTF8())
+		/* no conversion */
+		return AllocatedPath::Build(base_fs, uri_utf8);
+
+	AllocatedPath directory_fs = AllocatedPath::Null();
+	const char *name_utf8 = strrchr(uri_utf8, '/');
+	if (name_utf8 != nullptr) {
+		directory_fs = MapDirectoryFS(std::string(uri_utf8, name_utf8),
+					      error);
+		if (directory_fs.IsNull())
+			return directory_fs;
+
+		++name_utf8;
+	} else
+		name_utf8 = uri_utf8;
+
+	AllocatedPath name_fs = AllocatedPath::FromUTF8(name_utf8, error);
+	if (name_fs.IsNull())
+		return name_fs;
+
+	return AllocatedPath::Build(directory_fs.IsNull()
+				    ? base_fs : directory_fs,
+				    name_fs);
 }
 
 AllocatedPath
@@ -188,6 +255,10 @@ LocalDirectoryReader::Read()
 		if (SkipNameFS(name_fs.c_str()))
 			continue;
 
+		if (IsFSCharsetUTF8())
+			/* no conversion, no copy */
+			return name_fs.c_str();
+
 		name_utf8 = name_fs.ToUTF8();
 		if (name_utf8.empty())
 			continue;
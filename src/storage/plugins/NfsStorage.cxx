@@ -25,28 +25,54 @@
 #include "lib/nfs/Domain.hxx"
 #include "util/Error.hxx"
 #include "thread/Mutex.hxx"
+#include "system/Clock.hxx"
 
 extern "C" {
 #include <nfsc/libnfs.h>
 #include <nfsc/libnfs-raw-nfs.h>
 }
 
+#include <map>
+#include <memory>
+#include <string>
+
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <string.h>
 
-class NfsDirectoryReader final : public StorageDirectoryReader {
-	const std::string base;
+/**
+ * How many seconds are attributes obtained with READDIRPLUS trusted?
+ * This is long enough to cover one directory during a database
+ * update, which stats each entry several times.
+ */
+static constexpr unsigned NFS_LISTING_TTL = 10;
 
-	nfs_context *ctx;
-	nfsdir *dir;
+/**
+ * A snapshot of a directory, including the attributes of all
+ * entries, as obtained from nfs_opendir() (i.e. READDIRPLUS).
+ */
+struct NfsDirectoryListing {
+	/**
+	 * The time stamp (MonotonicClockS()) after which this listing
+	 * is stale.
+	 */
+	unsigned expires;
+
+	std::map<std::string, FileInfo> entries;
+};
 
-	nfsdirent *ent;
+typedef std::shared_ptr<const NfsDirectoryListing> NfsListingPtr;
 
-public:
-	NfsDirectoryReader(const char *_base, nfs_context *_ctx, nfsdir *_dir)
-		:base(_base), ctx(_ctx), dir(_dir) {}
+class NfsDirectoryReader final : public StorageDirectoryReader {
+	const NfsListingPtr listing;
 
-	virtual ~NfsDirectoryReader();
+	std::map<std::string, FileInfo>::const_iterator next, current;
+
+public:
+	explicit NfsDirectoryReader(NfsListingPtr &&_listing)
+		:listing(std::move(_listing)),
+		 next(listing->entries.begin()) {}
 
 	/* virtual methods from class StorageDirectoryReader */
 	virtual const char *Read() override;
@@ -57,8 +83,20 @@ public:
 class NfsStorage final : public Storage {
 	const std::string base;
 
+	/**
+	 * Protects #ctx (libnfs is not thread-safe) and #listings.
+	 */
+	Mutex mutex;
+
 	nfs_context *ctx;
 
+	/**
+	 * Recently read directories, indexed by their URI.  This
+	 * serves the many GetInfo() calls of the database update
+	 * without a GETATTR/LOOKUP round trip per file.
+	 */
+	std::map<std::string, NfsListingPtr> listings;
+
 public:
 	NfsStorage(const char *_base, nfs_context *_ctx)
 		:base(_base), ctx(_ctx) {}
@@ -77,6 +115,13 @@ public:
 	virtual std::string MapUTF8(const char *uri_utf8) const override;
 
 	virtual const char *MapToRelativeUTF8(const char *uri_utf8) const override;
+
+private:
+	/**
+	 * Obtain a fresh listing of the given directory, either from
+	 * #listings or from the server.  Caller must lock #mutex.
+	 */
+	NfsListingPtr GetListing(const std::string &uri_utf8, Error &error);
 };
 
 std::string
@@ -120,19 +165,44 @@ GetInfo(nfs_context *ctx, const char *path, FileInfo &info, Error &error)
 	return true;
 }
 
-bool
-NfsStorage::GetInfo(const char *uri_utf8, gcc_unused bool follow,
-		    FileInfo &info, Error &error)
+gcc_pure
+static bool
+SkipNameFS(const char *name)
 {
-	/* libnfs paths must begin with a slash */
-	std::string path(uri_utf8);
-	path.insert(path.begin(), '/');
+	return name[0] == '.' &&
+		(name[1] == 0 ||
+		 (name[1] == '.' && name[2] == 0));
+}
 
-	return ::GetInfo(ctx, path.c_str(), info, error);
+static void
+Copy(FileInfo &info, const nfsdirent &ent)
+{
+	switch (ent.type) {
+	case NF3REG:
+		info.type = FileInfo::Type::REGULAR;
+		break;
+
+	case NF3DIR:
+		info.type = FileInfo::Type::DIRECTORY;
+		break;
+
+	default:
+		info.type = FileInfo::Type::OTHER;
+		break;
+	}
+
+	info.size = ent.size;
+	info.mtime = ent.mtime.tv_sec;
+	info.device = 0;
+	info.inode = ent.inode;
 }
 
-StorageDirectoryReader *
-NfsStorage::OpenDirectory(const char *uri_utf8, Error &error)
+/**
+ * Read a whole directory with nfs_opendir(), which obtains names and
+ * attributes with READDIRPLUS.
+ */
+static NfsDirectoryListing *
+ReadListing(nfs_context *ctx, const char *uri_utf8, Error &error)
 {
 	/* libnfs paths must begin with a slash */
 	std::string path(uri_utf8);
@@ -145,58 +215,123 @@ NfsStorage::OpenDirectory(const char *uri_utf8, Error &error)
 		return nullptr;
 	}
 
-	return new NfsDirectoryReader(uri_utf8, ctx, dir);
+	NfsDirectoryListing *listing = new NfsDirectoryListing();
+	listing->expires = MonotonicClockS() + NFS_LISTING_TTL;
+
+	const nfsdirent *ent;
+	while ((ent = nfs_readdir(ctx, dir)) != nullptr)
+		if (!SkipNameFS(ent->name))
+			Copy(listing->entries[ent->name], *ent);
+
+	nfs_closedir(ctx, dir);
+	return listing;
 }
 
 gcc_pure
 static bool
-SkipNameFS(const char *name)
+IsExpired(const NfsDirectoryListing &listing, unsigned now)
 {
-	return name[0] == '.' &&
-		(name[1] == 0 ||
-		 (name[1] == '.' && name[2] == 0));
+	return (int)(now - listing.expires) >= 0;
 }
 
-NfsDirectoryReader::~NfsDirectoryReader()
+NfsListingPtr
+NfsStorage::GetListing(const std::string &uri_utf8, Error &error)
 {
-	nfs_closedir(ctx, dir);
+	const unsigned now = MonotonicClockS();
+
+	auto i = listings.find(uri_utf8);
+	if (i != listings.end()) {
+		if (!IsExpired(*i->second, now))
+			return i->second;
+
+		listings.erase(i);
+	}
+
+	NfsListingPtr listing(ReadListing(ctx, uri_utf8.c_str(), error));
+	if (listing == nullptr)
+		return nullptr;
+
+	/* discard stale listings, so the cache size is bounded by
+	   what can be read within NFS_LISTING_TTL */
+	for (auto j = listings.begin(); j != listings.end();) {
+		if (IsExpired(*j->second, now))
+			j = listings.erase(j);
+		else
+			++j;
+	}
+
+	listings.emplace(uri_utf8, listing);
+	return listing;
 }
 
-const char *
-NfsDirectoryReader::Read()
+bool
+NfsStorage::GetInfo(const char *uri_utf8, gcc_unused bool follow,
+		    FileInfo &info, Error &error)
 {
-	while ((ent = nfs_readdir(ctx, dir)) != nullptr) {
-		if (!SkipNameFS(ent->name))
-			return ent->name;
+	const ScopeLock protect(mutex);
+
+	const char *slash = strrchr(uri_utf8, '/');
+	if (*uri_utf8 != 0) {
+		/* look up the entry in its parent's listing; this
+		   reads the whole parent directory, because the
+		   caller is likely to ask for its siblings next */
+		const std::string parent = slash != nullptr
+			? std::string(uri_utf8, slash)
+			: std::string();
+		const char *name = slash != nullptr ? slash + 1 : uri_utf8;
+
+		const auto listing = GetListing(parent, IgnoreError());
+		if (listing != nullptr) {
+			auto i = listing->entries.find(name);
+			if (i == listing->entries.end()) {
+				error.SetErrno(ENOENT, "No such file");
+				return false;
+			}
+
+			if (i->second.type != FileInfo::Type::OTHER) {
+				info = i->second;
+				return true;
+			}
+
+			/* possibly a symlink: ask the server to
+			   resolve it */
+		}
 	}
 
-	return nullptr;
+	/* libnfs paths must begin with a slash */
+	std::string path(uri_utf8);
+	path.insert(path.begin(), '/');
+
+	return ::GetInfo(ctx, path.c_str(), info, error);
 }
 
-bool
-NfsDirectoryReader::GetInfo(gcc_unused bool follow, FileInfo &info,
-			    gcc_unused Error &error)
+StorageDirectoryReader *
+NfsStorage::OpenDirectory(const char *uri_utf8, Error &error)
 {
-	assert(ent != nullptr);
+	const ScopeLock protect(mutex);
 
-	switch (ent->type) {
-	case NF3REG:
-		info.type = FileInfo::Type::REGULAR;
-		break;
+	auto listing = GetListing(uri_utf8, error);
+	if (listing == nullptr)
+		return nullptr;
 
-	case NF3DIR:
-		info.type = FileInfo::Type::DIRECTORY;
-		break;
+	return new NfsDirectoryReader(std::move(listing));
+}
 
-	default:
-		info.type = FileInfo::Type::OTHER;
-		break;
-	}
+const char *
+NfsDirectoryReader::Read()
+{
+	if (next == listing->entries.end())
+		return nullptr;
 
-	info.size = ent->size;
-	info.mtime = ent->mtime.tv_sec;
-	info.device = 0;
-	info.inode = ent->inode;
+	current = next++;
+	return current->first.c_str();
+}
+
+bool
+NfsDirectoryReader::GetInfo(gcc_unused bool follow, FileInfo &info,
+			    gcc_unused Error &error)
+{
+	info = current->second;
 	return true;
 }
 
@@ -23,21 +23,30 @@
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Mutex.hxx"
+#include "lib/smbclient/Context.hxx"
+#include "lib/smbclient/Pool.hxx"
 #include "util/Error.hxx"
-#include "thread/Mutex.hxx"
 
-#include <libsmbclient.h>
+/**
+ * Keep up to this number of idle contexts per storage.
+ */
+static constexpr unsigned SMBCLIENT_STORAGE_MAX_IDLE = 2;
 
 class SmbclientDirectoryReader final : public StorageDirectoryReader {
 	const std::string base;
-	const unsigned handle;
+
+	SmbclientContextPool &pool;
+	SmbclientContext *const ctx;
+	SMBCFILE *const handle;
 
 	const char *name;
 
 public:
-	SmbclientDirectoryReader(std::string &&_base, unsigned _handle)
-		:base(std::move(_base)), handle(_handle) {}
+	SmbclientDirectoryReader(std::string &&_base,
+				 SmbclientContextPool &_pool,
+				 SmbclientContext *_ctx, SMBCFILE *_handle)
+		:base(std::move(_base)),
+		 pool(_pool), ctx(_ctx), handle(_handle) {}
 
 	virtual ~SmbclientDirectoryReader();
 
@@ -50,16 +59,20 @@ public:
 class SmbclientStorage final : public Storage {
 	const std::string base;
 
-	SMBCCTX *const ctx;
+	/**
+	 * Each directory reader and each GetInfo() call obtains its
+	 * own context from this pool, so concurrent users (e.g. the
+	 * database update and a "listfiles" command) do not block
+	 * each other or the input plugin.
+	 */
+	SmbclientContextPool pool;
 
 public:
-	SmbclientStorage(const char *_base, SMBCCTX *_ctx)
-		:base(_base), ctx(_ctx) {}
+	explicit SmbclientStorage(const char *_base)
+		:base(_base), pool(SMBCLIENT_STORAGE_MAX_IDLE) {}
 
-	virtual ~SmbclientStorage() {
-		smbclient_mutex.lock();
-		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
+	SmbclientContextPool &GetPool() {
+		return pool;
 	}
 
 	/* virtual methods from class Storage */
@@ -92,13 +105,11 @@ SmbclientStorage::MapToRelativeUTF8(const char *uri_utf8) const
 }
 
 static bool
-GetInfo(const char *path, FileInfo &info, Error &error)
+GetInfo(SmbclientContext &ctx, const char *path, FileInfo &info,
+	Error &error)
 {
 	struct stat st;
-	smbclient_mutex.lock();
-	bool success = smbc_stat(path, &st) == 0;
-	smbclient_mutex.unlock();
-	if (!success) {
+	if (ctx.Stat(path, st) < 0) {
 		error.SetErrno();
 		return false;
 	}
@@ -121,23 +132,33 @@ bool
 SmbclientStorage::GetInfo(const char *uri_utf8, gcc_unused bool follow,
 			  FileInfo &info, Error &error)
 {
+	SmbclientContext *ctx = pool.Get(error);
+	if (ctx == nullptr)
+		return false;
+
 	const std::string mapped = MapUTF8(uri_utf8);
-	return ::GetInfo(mapped.c_str(), info, error);
+	bool success = ::GetInfo(*ctx, mapped.c_str(), info, error);
+	pool.Put(ctx);
+	return success;
 }
 
 StorageDirectoryReader *
 SmbclientStorage::OpenDirectory(const char *uri_utf8, Error &error)
 {
+	SmbclientContext *ctx = pool.Get(error);
+	if (ctx == nullptr)
+		return nullptr;
+
 	std::string mapped = MapUTF8(uri_utf8);
-	smbclient_mutex.lock();
-	int handle = smbc_opendir(mapped.c_str());
-	smbclient_mutex.unlock();
-	if (handle < 0) {
+	SMBCFILE *handle = ctx->OpenDirectory(mapped.c_str());
+	if (handle == nullptr) {
 		error.SetErrno();
+		pool.Put(ctx);
 		return nullptr;
 	}
 
-	return new SmbclientDirectoryReader(std::move(mapped.c_str()), handle);
+	return new SmbclientDirectoryReader(std::move(mapped), pool,
+					    ctx, handle);
 }
 
 gcc_pure
@@ -151,18 +172,15 @@ SkipNameFS(const char *name)
 
 SmbclientDirectoryReader::~SmbclientDirectoryReader()
 {
-	smbclient_mutex.lock();
-	smbc_close(handle);
-	smbclient_mutex.unlock();
+	ctx->CloseDirectory(handle);
+	pool.Put(ctx);
 }
 
 const char *
 SmbclientDirectoryReader::Read()
 {
-	const ScopeLock protect(smbclient_mutex);
-
 	struct smbc_dirent *e;
-	while ((e = smbc_readdir(handle)) != nullptr) {
+	while ((e = ctx->ReadDirectory(handle)) != nullptr) {
 		name = e->name;
 		if (!SkipNameFS(name))
 			return name;
@@ -176,7 +194,7 @@ SmbclientDirectoryReader::GetInfo(gcc_unused bool follow, FileInfo &info,
 				  Error &error)
 {
 	const std::string path = PathTraitsUTF8::Build(base.c_str(), name);
-	return ::GetInfo(path.c_str(), info, error);
+	return ::GetInfo(*ctx, path.c_str(), info, error);
 }
 
 static Storage *
@@ -188,21 +206,18 @@ CreateSmbclientStorageURI(const char *base, Error &error)
 	if (!SmbclientInit(error))
 		return nullptr;
 
-	const ScopeLock protect(smbclient_mutex);
-	SMBCCTX *ctx = smbc_new_context();
-	if (ctx == nullptr) {
-		error.SetErrno("smbc_new_context() failed");
-		return nullptr;
-	}
+	SmbclientStorage *storage = new SmbclientStorage(base);
 
-	SMBCCTX *ctx2 = smbc_init_context(ctx);
-	if (ctx2 == nullptr) {
-		error.SetErrno("smbc_init_context() failed");
-		smbc_free_context(ctx, 1);
+	/* create the first context right away to report
+	   configuration errors early */
+	SmbclientContext *ctx = storage->GetPool().Get(error);
+	if (ctx == nullptr) {
+		delete storage;
 		return nullptr;
 	}
 
-	return new SmbclientStorage(base, ctx2);
+	storage->GetPool().Put(ctx);
+	return storage;
 }
 
 const StoragePlugin smbclient_storage_plugin = {
@@ -118,6 +118,25 @@ MonotonicClockUS(void)
 #endif
 }
 
+uint64_t
+MonotonicClockNS(void)
+{
+#if defined(__APPLE__)
+	static mach_timebase_info_data_t base;
+	if (base.denom == 0)
+		(void)mach_timebase_info(&base);
+
+	return ((uint64_t)mach_absolute_time() * (uint64_t)base.numer)
+		/ (uint64_t)base.denom;
+#elif !defined(WIN32) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#else
+	return MonotonicClockUS() * 1000;
+#endif
+}
+
 #ifdef WIN32
 
 gcc_const
@@ -82,11 +82,7 @@ fd_set_cloexec(int fd, bool enable)
 #endif
 }
 
-/**
- * Enables non-blocking mode for the specified file descriptor.  On
- * WIN32, this function only works for sockets.
- */
-static int
+int
 fd_set_nonblock(int fd)
 {
 #ifdef WIN32
@@ -105,6 +101,22 @@ fd_set_nonblock(int fd)
 #endif
 }
 
+int
+pipe_set_size(int fd, unsigned size)
+{
+#ifdef F_SETPIPE_SZ
+	assert(fd >= 0);
+
+	return fcntl(fd, F_SETPIPE_SZ, (int)size);
+#else
+	(void)fd;
+	(void)size;
+
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
 int
 dup_cloexec(int oldfd)
 {
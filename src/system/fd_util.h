@@ -54,6 +54,23 @@ extern "C" {
 int
 fd_set_cloexec(int fd, bool enable);
 
+/**
+ * Enables non-blocking mode for the specified file descriptor.  On
+ * WIN32, this function only works for sockets.
+ */
+int
+fd_set_nonblock(int fd);
+
+/**
+ * Change the capacity of a pipe (requires Linux 2.6.35).  The kernel
+ * rounds it up to a power of two number of pages.
+ *
+ * @return the new capacity in bytes, or -1 on error (or if the
+ * operation is not supported)
+ */
+int
+pipe_set_size(int fd, unsigned size);
+
 /**
  * Wrapper for dup(), which sets the CLOEXEC flag on the new
  * descriptor.
@@ -21,6 +21,7 @@
 #include "Aiff.hxx"
 #include "util/Domain.hxx"
 #include "system/ByteOrder.hxx"
+#include "util/ConstBuffer.hxx"
 #include "Log.hxx"
 
 #include <limits>
@@ -96,3 +97,45 @@ aiff_seek_id3(FILE *file)
 			return 0;
 	}
 }
+
+ConstBuffer<void>
+aiff_find_id3(ConstBuffer<void> file)
+{
+	const uint8_t *const begin = (const uint8_t *)file.data;
+	const size_t size = file.size;
+
+	aiff_header header;
+	if (size < sizeof(header))
+		return nullptr;
+
+	memcpy(&header, begin, sizeof(header));
+	if (memcmp(header.id, "FORM", 4) != 0 ||
+	    FromBE32(header.size) > size ||
+	    (memcmp(header.format, "AIFF", 4) != 0 &&
+	     memcmp(header.format, "AIFC", 4) != 0))
+		/* not a AIFF file */
+		return nullptr;
+
+	size_t position = sizeof(header);
+	while (size - position >= sizeof(aiff_chunk_header)) {
+		aiff_chunk_header chunk;
+		memcpy(&chunk, begin + position, sizeof(chunk));
+		position += sizeof(chunk);
+
+		size_t chunk_size = FromBE32(chunk.size);
+		if (chunk_size % 2 != 0)
+			/* pad byte */
+			++chunk_size;
+
+		if (chunk_size > size - position)
+			return nullptr;
+
+		if (memcmp(chunk.id, "ID3 ", 4) == 0)
+			/* found it! */
+			return { begin + position, chunk_size };
+
+		position += chunk_size;
+	}
+
+	return nullptr;
+}
@@ -25,9 +25,13 @@
 #ifndef MPD_AIFF_HXX
 #define MPD_AIFF_HXX
 
+#include "Compiler.h"
+
 #include <stddef.h>
 #include <stdio.h>
 
+template<typename T> struct ConstBuffer;
+
 /**
  * Seeks the AIFF file to the ID3 chunk.
  *
@@ -37,4 +41,15 @@
 size_t
 aiff_seek_id3(FILE *file);
 
+/**
+ * Like aiff_seek_id3(), but search a file which has been mapped
+ * into memory.
+ *
+ * @return the ID3 chunk, or nullptr if this is not a AIFF file or no
+ * ID3 chunk was found
+ */
+gcc_pure
+ConstBuffer<void>
+aiff_find_id3(ConstBuffer<void> file);
+
 #endif
@@ -21,6 +21,7 @@
 #include "ApeLoader.hxx"
 #include "system/ByteOrder.hxx"
 #include "fs/FileSystem.hxx"
+#include "fs/MappedFile.hxx"
 
 #include <stdint.h>
 #include <assert.h>
@@ -36,38 +37,16 @@ struct ape_footer {
 	unsigned char reserved[8];
 };
 
-static bool
-ape_scan_internal(FILE *fp, ApeTagCallback callback)
+/**
+ * Parse the items of an APE tag.
+ *
+ * @param p the tag data following the header (or the beginning of
+ * the tag if there is no header), excluding the footer
+ */
+static void
+ape_scan_items(const char *p, size_t remaining, unsigned n,
+	       ApeTagCallback callback)
 {
-	/* determine if file has an apeV2 tag */
-	struct ape_footer footer;
-	if (fseek(fp, -(long)sizeof(footer), SEEK_END) ||
-	    fread(&footer, 1, sizeof(footer), fp) != sizeof(footer) ||
-	    memcmp(footer.id, "APETAGEX", sizeof(footer.id)) != 0 ||
-	    FromLE32(footer.version) != 2000)
-		return false;
-
-	/* find beginning of ape tag */
-	size_t remaining = FromLE32(footer.length);
-	if (remaining <= sizeof(footer) + 10 ||
-	    /* refuse to load more than one megabyte of tag data */
-	    remaining > 1024 * 1024 ||
-	    fseek(fp, -(long)remaining, SEEK_END))
-		return false;
-
-	/* read tag into buffer */
-	remaining -= sizeof(footer);
-	assert(remaining > 10);
-
-	char *buffer = new char[remaining];
-	if (fread(buffer, 1, remaining, fp) != remaining) {
-		delete[] buffer;
-		return false;
-	}
-
-	/* read tags */
-	unsigned n = FromLE32(footer.count);
-	const char *p = buffer;
 	while (n-- && remaining > 10) {
 		size_t size = FromLE32(*(const uint32_t *)p);
 		p += 4;
@@ -95,14 +74,92 @@ ape_scan_internal(FILE *fp, ApeTagCallback callback)
 		p += size;
 		remaining -= size;
 	}
+}
+
+/**
+ * Check the footer, and return the size of the tag data preceding
+ * it, or 0 if there is no usable APE tag.
+ */
+static size_t
+ape_check_footer(const ape_footer &footer)
+{
+	if (memcmp(footer.id, "APETAGEX", sizeof(footer.id)) != 0 ||
+	    FromLE32(footer.version) != 2000)
+		return 0;
+
+	size_t length = FromLE32(footer.length);
+	if (length <= sizeof(footer) + 10 ||
+	    /* refuse to load more than one megabyte of tag data */
+	    length > 1024 * 1024)
+		return 0;
+
+	return length - sizeof(footer);
+}
+
+static bool
+ape_scan_internal(FILE *fp, ApeTagCallback callback)
+{
+	/* determine if file has an apeV2 tag */
+	struct ape_footer footer;
+	if (fseek(fp, -(long)sizeof(footer), SEEK_END) ||
+	    fread(&footer, 1, sizeof(footer), fp) != sizeof(footer))
+		return false;
+
+	/* find beginning of ape tag */
+	size_t remaining = ape_check_footer(footer);
+	if (remaining == 0 ||
+	    fseek(fp, -(long)(remaining + sizeof(footer)), SEEK_END))
+		return false;
+
+	/* read tag into buffer */
+	assert(remaining > 10);
+
+	char *buffer = new char[remaining];
+	if (fread(buffer, 1, remaining, fp) != remaining) {
+		delete[] buffer;
+		return false;
+	}
+
+	/* read tags */
+	ape_scan_items(buffer, remaining, FromLE32(footer.count), callback);
 
 	delete[] buffer;
 	return true;
 }
 
+/**
+ * Like ape_scan_internal(), but parse the tag straight from a file
+ * mapped into memory.
+ */
+static bool
+ape_scan_mapped(const MappedFile &file, ApeTagCallback callback)
+{
+	const size_t file_size = file.GetSize();
+
+	struct ape_footer footer;
+	if (file_size < sizeof(footer))
+		return false;
+
+	memcpy(&footer, file.GetData() + file_size - sizeof(footer),
+	       sizeof(footer));
+
+	size_t remaining = ape_check_footer(footer);
+	if (remaining == 0 || remaining + sizeof(footer) > file_size)
+		return false;
+
+	const char *p = (const char *)file.GetData()
+		+ file_size - sizeof(footer) - remaining;
+	ape_scan_items(p, remaining, FromLE32(footer.count), callback);
+	return true;
+}
+
 bool
 tag_ape_scan(Path path_fs, ApeTagCallback callback)
 {
+	const MappedFile mapped(path_fs);
+	if (!mapped.HasFailed())
+		return ape_scan_mapped(mapped, callback);
+
 	FILE *fp = FOpen(path_fs, "rb");
 	if (fp == nullptr)
 		return false;
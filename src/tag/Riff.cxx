@@ -21,6 +21,7 @@
 #include "Riff.hxx"
 #include "util/Domain.hxx"
 #include "system/ByteOrder.hxx"
+#include "util/ConstBuffer.hxx"
 #include "Log.hxx"
 
 #include <limits>
@@ -95,3 +96,44 @@ riff_seek_id3(FILE *file)
 			return 0;
 	}
 }
+
+ConstBuffer<void>
+riff_find_id3(ConstBuffer<void> file)
+{
+	const uint8_t *const begin = (const uint8_t *)file.data;
+	const size_t size = file.size;
+
+	riff_header header;
+	if (size < sizeof(header))
+		return nullptr;
+
+	memcpy(&header, begin, sizeof(header));
+	if (memcmp(header.id, "RIFF", 4) != 0 ||
+	    FromLE32(header.size) > size)
+		/* not a RIFF file */
+		return nullptr;
+
+	size_t position = sizeof(header);
+	while (size - position >= sizeof(riff_chunk_header)) {
+		riff_chunk_header chunk;
+		memcpy(&chunk, begin + position, sizeof(chunk));
+		position += sizeof(chunk);
+
+		size_t chunk_size = FromLE32(chunk.size);
+		if (chunk_size % 2 != 0)
+			/* pad byte */
+			++chunk_size;
+
+		if (chunk_size > size - position)
+			return nullptr;
+
+		if (memcmp(chunk.id, "id3 ", 4) == 0 ||
+		    memcmp(chunk.id, "ID3 ", 4) == 0)
+			/* found it! */
+			return { begin + position, chunk_size };
+
+		position += chunk_size;
+	}
+
+	return nullptr;
+}
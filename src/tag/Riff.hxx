@@ -25,9 +25,13 @@
 #ifndef MPD_RIFF_HXX
 #define MPD_RIFF_HXX
 
+#include "Compiler.h"
+
 #include <stddef.h>
 #include <stdio.h>
 
+template<typename T> struct ConstBuffer;
+
 /**
  * Seeks the RIFF file to the ID3 chunk.
  *
@@ -37,4 +41,15 @@
 size_t
 riff_seek_id3(FILE *file);
 
+/**
+ * Like riff_seek_id3(), but search a file which has been mapped
+ * into memory.
+ *
+ * @return the ID3 chunk, or nullptr if this is not a RIFF file or no
+ * ID3 chunk was found
+ */
+gcc_pure
+ConstBuffer<void>
+riff_find_id3(ConstBuffer<void> file);
+
 #endif
@@ -29,6 +29,9 @@ static bool
 CopyTagItem(TagBuilder &dest, TagType dest_type,
 	    const Tag &src, TagType src_type)
 {
+	if (!src.HasType(src_type))
+		return false;
+
 	bool found = false;
 	const unsigned n = src.num_items;
 	for (unsigned i = 0; i < n; ++i) {
@@ -86,6 +89,9 @@ TagSet::CheckUnique(TagType dest_type,
 		    const Tag &tag, TagType src_type,
 		    uint32_t group_mask)
 {
+	if (!tag.HasType(src_type))
+		return false;
+
 	bool found = false;
 	for (unsigned i = 0; i < tag.num_items; ++i) {
 		if (tag.items[i]->type == src_type) {
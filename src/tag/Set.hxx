@@ -41,6 +41,12 @@ struct TagLess {
 		for (unsigned i = 0; i < n; ++i) {
 			const TagItem &ai = *a.items[i];
 			const TagItem &bi = *b.items[i];
+
+			/* thanks to the #TagPool, equal items are
+			   usually the same object */
+			if (&ai == &bi)
+				continue;
+
 			if (ai.type != bi.type)
 				return unsigned(ai.type) < unsigned(bi.type);
 
@@ -25,8 +25,44 @@
 #include "TagBuilder.hxx"
 #include "util/ASCII.hxx"
 
+#include <atomic>
+#include <algorithm>
+#include <new>
+
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
+#include <stdlib.h>
+
+static_assert(TAG_NUM_OF_ITEM_TYPES <= 32,
+	      "Tag::type_mask is too small");
+
+/**
+ * The reference counted allocation behind Tag::Items::own.
+ */
+struct TagItemArray {
+	std::atomic_uint ref;
+
+	TagItem *items[1];
+
+	static TagItemArray &FromItems(TagItem **items) {
+		return *(TagItemArray *)((char *)items -
+					 offsetof(TagItemArray, items));
+	}
+};
+
+TagItem **
+Tag::AllocateItems(unsigned n)
+{
+	if (n == 0)
+		return nullptr;
+
+	void *p = malloc(sizeof(TagItemArray) - sizeof(TagItemArray::items) +
+			 n * sizeof(TagItem *));
+	TagItemArray *array = new(p) TagItemArray();
+	array->ref = 1;
+	return array->items;
+}
 
 TagType
 tag_name_parse(const char *name)
@@ -64,29 +100,87 @@ Tag::Clear()
 	time = -1;
 	has_playlist = false;
 
-	tag_pool_lock.lock();
-	for (unsigned i = 0; i < num_items; ++i)
-		tag_pool_put_item(items[i]);
-	tag_pool_lock.unlock();
+	const unsigned group_size = items.GetGroupSize();
+
+	if (items.own != nullptr) {
+		TagItemArray &array = TagItemArray::FromItems(items.own);
+		if (--array.ref == 0) {
+			for (unsigned i = group_size; i < num_items; ++i)
+				tag_pool_put_item(items[i]);
+
+			array.~TagItemArray();
+			free(&array);
+		}
+	}
+
+	if (items.group != nullptr)
+		tag_item_group_put(items.group);
+
+	items = Items();
+	num_items = 0;
+	type_mask = 0;
+}
+
+void
+Tag::MoveItems(TagItem **dest)
+{
+	const unsigned group_size = items.GetGroupSize();
+
+	if (items.group != nullptr) {
+		/* the group is shared, and keeps its item
+		   references */
+		const TagItemGroup &group = *items.group;
+		for (unsigned i = 0; i < group.num_items; ++i)
+			*dest++ = tag_pool_dup_item(group.items[i]);
+
+		tag_item_group_put(items.group);
+	}
 
-	delete[] items;
-	items = nullptr;
+	if (items.own != nullptr) {
+		TagItem **const own = items.own;
+		const unsigned n = num_items - group_size;
+		TagItemArray &array = TagItemArray::FromItems(own);
+
+		if (array.ref.load() == 1) {
+			/* this is the only reference; take over the
+			   item references without contacting the tag
+			   pool */
+			std::copy_n(own, n, dest);
+			array.~TagItemArray();
+			free(&array);
+		} else {
+			/* the array is shared, and its other owners
+			   keep their item references */
+			for (unsigned i = 0; i < n; ++i)
+				dest[i] = tag_pool_dup_item(own[i]);
+
+			if (--array.ref == 0) {
+				/* another owner has released it
+				   meanwhile */
+				for (unsigned i = 0; i < n; ++i)
+					tag_pool_put_item(own[i]);
+
+				array.~TagItemArray();
+				free(&array);
+			}
+		}
+	}
+
+	items = Items();
 	num_items = 0;
+	type_mask = 0;
 }
 
 Tag::Tag(const Tag &other)
 	:time(other.time), has_playlist(other.has_playlist),
-	 num_items(other.num_items),
-	 items(nullptr)
+	 num_items(other.num_items), type_mask(other.type_mask),
+	 items(other.items)
 {
-	if (num_items > 0) {
-		items = new TagItem *[num_items];
+	if (items.group != nullptr)
+		tag_item_group_dup(items.group);
 
-		tag_pool_lock.lock();
-		for (unsigned i = 0; i < num_items; i++)
-			items[i] = tag_pool_dup_item(other.items[i]);
-		tag_pool_lock.unlock();
-	}
+	if (items.own != nullptr)
+		++TagItemArray::FromItems(items.own).ref;
 }
 
 Tag *
@@ -118,15 +212,12 @@ Tag::GetValue(TagType type) const
 {
 	assert(type < TAG_NUM_OF_ITEM_TYPES);
 
+	if (!HasType(type))
+		return nullptr;
+
 	for (unsigned i = 0; i < num_items; i++)
 		if (items[i]->type == type)
 			return items[i]->value;
 
 	return nullptr;
 }
-
-bool
-Tag::HasType(TagType type) const
-{
-	return GetValue(type) != nullptr;
-}
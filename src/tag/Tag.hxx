@@ -22,11 +22,13 @@
 
 #include "TagType.h" // IWYU pragma: export
 #include "TagItem.hxx" // IWYU pragma: export
+#include "TagItemGroup.hxx"
 #include "Compiler.h"
 
 #include <algorithm>
 
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * The meta information about a song file.  It is a MPD specific
@@ -50,22 +52,63 @@ struct Tag {
 	/** the total number of tag items in the #items array */
 	unsigned short num_items;
 
-	/** an array of tag items */
-	TagItem **items;
+	/**
+	 * A bit mask of the types present in #items (bit number =
+	 * #TagType).  It allows checking for a type without scanning
+	 * the array.
+	 */
+	uint32_t type_mask;
+
+	/**
+	 * The tag items, which can be indexed like an array of
+	 * #num_items #TagItem pointers.  The first ones are the
+	 * album-level items of a #TagItemGroup, which is shared with
+	 * other songs of the same album; the remaining ones are in
+	 * an array which is reference counted and shared by all
+	 * copies of this object.  Both are never modified after
+	 * TagBuilder::Commit() has created them; therefore copying a
+	 * #Tag neither allocates memory nor touches the #TagPool.
+	 */
+	struct Items {
+		/**
+		 * The shared album-level items; may be nullptr.
+		 */
+		const TagItemGroup *group;
+
+		/**
+		 * The other items; may be nullptr.
+		 */
+		TagItem **own;
+
+		constexpr Items():group(nullptr), own(nullptr) {}
+
+		gcc_pure
+		unsigned GetGroupSize() const {
+			return group != nullptr ? group->num_items : 0;
+		}
+
+		gcc_pure
+		TagItem *operator[](unsigned i) const {
+			const unsigned n = GetGroupSize();
+			return i < n ? group->items[i] : own[i - n];
+		}
+	} items;
 
 	/**
 	 * Create an empty tag.
 	 */
 	Tag():time(-1), has_playlist(false),
-	      num_items(0), items(nullptr) {}
+	      num_items(0), type_mask(0) {}
 
 	Tag(const Tag &other);
 
 	Tag(Tag &&other)
 		:time(other.time), has_playlist(other.has_playlist),
-		 num_items(other.num_items), items(other.items) {
-		other.items = nullptr;
+		 num_items(other.num_items), type_mask(other.type_mask),
+		 items(other.items) {
+		other.items = Items();
 		other.num_items = 0;
+		other.type_mask = 0;
 	}
 
 	/**
@@ -82,6 +125,7 @@ struct Tag {
 		has_playlist = other.has_playlist;
 		std::swap(items, other.items);
 		std::swap(num_items, other.num_items);
+		std::swap(type_mask, other.type_mask);
 		return *this;
 	}
 
@@ -105,6 +149,20 @@ struct Tag {
 	 */
 	void Clear();
 
+	/**
+	 * Allocate a new (unshared) item array for Items::own.
+	 * Returns nullptr if n is zero.
+	 */
+	gcc_malloc
+	static TagItem **AllocateItems(unsigned n);
+
+	/**
+	 * Copy the item pointers to the given buffer and transfer
+	 * their #TagPool references to the caller.  The items are
+	 * removed from this object; the other attributes remain.
+	 */
+	void MoveItems(TagItem **dest);
+
 	/**
 	 * Merges the data from two tags.  If both tags share data for the
 	 * same TagType, only data from "add" is used.
@@ -135,7 +193,17 @@ struct Tag {
 	 * the specified type.
 	 */
 	gcc_pure
-	bool HasType(TagType type) const;
+	bool HasType(TagType type) const {
+		return (type_mask & (uint32_t(1) << type)) != 0;
+	}
+
+	/**
+	 * Checks whether the tag contains at least one item of the
+	 * types in the specified bit mask.
+	 */
+	bool HasAnyType(uint32_t mask) const {
+		return (type_mask & mask) != 0;
+	}
 };
 
 /**
@@ -24,6 +24,8 @@
 #include "TagString.hxx"
 #include "Tag.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -33,25 +35,18 @@ TagBuilder::TagBuilder(const Tag &other)
 {
 	items.reserve(other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i)
 		items.push_back(tag_pool_dup_item(other.items[i]));
-	tag_pool_lock.unlock();
 }
 
 TagBuilder::TagBuilder(Tag &&other)
 	:time(other.time), has_playlist(other.has_playlist)
 {
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	/* move all TagItem pointers from the Tag object; unless its
+	   item array is shared, we don't need to contact the tag
+	   pool, because all we do is move references */
+	items.resize(other.num_items);
+	other.MoveItems(items.data());
 }
 
 TagBuilder &
@@ -63,10 +58,8 @@ TagBuilder::operator=(const TagBuilder &other)
 	items = other.items;
 
 	/* increment the tag pool refcounters */
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_dup_item(i);
-	tag_pool_lock.unlock();
 
 	return *this;
 }
@@ -87,17 +80,12 @@ TagBuilder::operator=(Tag &&other)
 	time = other.time;
 	has_playlist = other.has_playlist;
 
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
-	items.clear();
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	/* move all TagItem pointers from the Tag object; unless its
+	   item array is shared, we don't need to contact the tag
+	   pool, because all we do is move references */
+	RemoveAll();
+	items.resize(other.num_items);
+	other.MoveItems(items.data());
 
 	return *this;
 }
@@ -124,8 +112,26 @@ TagBuilder::Commit(Tag &tag)
 	   object */
 	const unsigned n_items = items.size();
 	tag.num_items = n_items;
-	tag.items = new TagItem *[n_items];
-	std::copy_n(items.begin(), n_items, tag.items);
+	tag.type_mask = GetTypeMask();
+
+	/* move the album-level items to the front, and share them
+	   with other songs of the same album; a group with only one
+	   item would not save memory */
+	const auto group_end =
+		std::stable_partition(items.begin(), items.end(),
+				      [](const TagItem *item) {
+					      return (TAG_ITEM_GROUP_MASK &
+						      (uint32_t(1) << item->type)) != 0;
+				      });
+	unsigned group_size = std::distance(items.begin(), group_end);
+	if (group_size >= 2)
+		tag.items.group = tag_item_group_get(items.data(),
+						     group_size);
+	else
+		group_size = 0;
+
+	tag.items.own = Tag::AllocateItems(n_items - group_size);
+	std::copy(items.begin() + group_size, items.end(), tag.items.own);
 	items.clear();
 
 	/* now ensure that this object is fresh (will not delete any
@@ -149,6 +155,16 @@ TagBuilder::CommitNew()
 	return tag;
 }
 
+uint32_t
+TagBuilder::GetTypeMask() const
+{
+	uint32_t mask = 0;
+	for (auto i : items)
+		mask |= uint32_t(1) << i->type;
+
+	return mask;
+}
+
 bool
 TagBuilder::HasType(TagType type) const
 {
@@ -169,13 +185,11 @@ TagBuilder::Complement(const Tag &other)
 
 	items.reserve(items.size() + other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
 		TagItem *item = other.items[i];
 		if (!HasType(item->type))
 			items.push_back(tag_pool_dup_item(item));
 	}
-	tag_pool_lock.unlock();
 }
 
 inline void
@@ -190,9 +204,7 @@ TagBuilder::AddItemInternal(TagType type, const char *value, size_t length)
 		length = strlen(value);
 	}
 
-	tag_pool_lock.lock();
 	auto i = tag_pool_get_item(type, value, length);
-	tag_pool_lock.unlock();
 
 	free(p);
 
@@ -221,9 +233,7 @@ TagBuilder::AddItem(TagType type, const char *value)
 void
 TagBuilder::AddEmptyItem(TagType type)
 {
-	tag_pool_lock.lock();
 	auto i = tag_pool_get_item(type, "", 0);
-	tag_pool_lock.unlock();
 
 	items.push_back(i);
 }
@@ -231,10 +241,8 @@ TagBuilder::AddEmptyItem(TagType type)
 void
 TagBuilder::RemoveAll()
 {
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_put_item(i);
-	tag_pool_lock.unlock();
 
 	items.clear();
 }
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include <stddef.h>
+#include <stdint.h>
 
 struct TagItem;
 struct Tag;
@@ -80,6 +81,10 @@ public:
 		return items.empty();
 	}
 
+	unsigned GetItemCount() const {
+		return items.size();
+	}
+
 	/**
 	 * Returns true if the object contains any information.
 	 */
@@ -113,6 +118,10 @@ public:
 		time = _time;
 	}
 
+	bool HasPlaylist() const {
+		return has_playlist;
+	}
+
 	void SetHasPlaylist(bool _has_playlist) {
 		has_playlist = _has_playlist;
 	}
@@ -128,6 +137,13 @@ public:
 	gcc_pure
 	bool HasType(TagType type) const;
 
+	/**
+	 * Returns a bit mask of the types of all items (bit number =
+	 * #TagType).
+	 */
+	gcc_pure
+	uint32_t GetTypeMask() const;
+
 	/**
 	 * Copy attributes and items from the other object that do not
 	 * exist in this object.
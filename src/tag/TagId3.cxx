@@ -32,6 +32,8 @@
 #include "Aiff.hxx"
 #include "fs/Path.hxx"
 #include "fs/FileSystem.hxx"
+#include "fs/MappedFile.hxx"
+#include "util/ConstBuffer.hxx"
 
 #ifdef HAVE_GLIB
 #include <glib.h>
@@ -40,6 +42,7 @@
 #include <id3tag.h>
 
 #include <string>
+#include <algorithm>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -509,9 +512,149 @@ tag_id3_riff_aiff_load(FILE *file)
 	return tag;
 }
 
+/**
+ * Parse the ID3 tag at the specified offset of a file which has been
+ * mapped into memory.
+ *
+ * @param end_r on success, receives the offset after the tag
+ */
+static struct id3_tag *
+tag_id3_parse_mapped(ConstBuffer<id3_byte_t> file, size_t offset,
+		     size_t &end_r)
+{
+	if (offset >= file.size)
+		return nullptr;
+
+	const id3_byte_t *p = file.data + offset;
+	const size_t available = file.size - offset;
+
+	long tag_size = id3_tag_query(p, std::min(available,
+						  size_t(ID3_TAG_QUERYSIZE)));
+	if (tag_size <= 0 || size_t(tag_size) > available)
+		return nullptr;
+
+	end_r = offset + tag_size;
+	return id3_tag_parse(p, tag_size);
+}
+
+/**
+ * Like tag_id3_find_from_beginning(), but parse a file which has been
+ * mapped into memory.
+ */
+static struct id3_tag *
+tag_id3_find_mapped_from_beginning(ConstBuffer<id3_byte_t> file)
+{
+	size_t end;
+	id3_tag *tag = tag_id3_parse_mapped(file, 0, end);
+	if (!tag) {
+		return nullptr;
+	} else if (tag_is_id3v1(tag)) {
+		/* id3v1 tags don't belong here */
+		id3_tag_delete(tag);
+		return nullptr;
+	}
+
+	/* We have an id3v2 tag, so let's look for SEEK frames; their
+	   value is relative to the end of the tag */
+	id3_frame *frame;
+	while ((frame = id3_tag_findframe(tag, "SEEK", 0))) {
+		int seek = id3_field_getint(id3_frame_field(frame, 0));
+		if (seek < 0)
+			break;
+
+		size_t seek_end;
+		id3_tag *seektag = tag_id3_parse_mapped(file, end + seek,
+							seek_end);
+		if (!seektag)
+			break;
+
+		if (tag_is_id3v1(seektag)) {
+			id3_tag_delete(seektag);
+			break;
+		}
+
+		id3_tag_delete(tag);
+		tag = seektag;
+		end = seek_end;
+	}
+
+	return tag;
+}
+
+/**
+ * Like tag_id3_find_from_end(), but parse a file which has been
+ * mapped into memory.
+ */
+static struct id3_tag *
+tag_id3_find_mapped_from_end(ConstBuffer<id3_byte_t> file)
+{
+	/* Get an id3v1 tag from the end of file for later use */
+	size_t end;
+	id3_tag *v1tag = file.size >= 128
+		? tag_id3_parse_mapped(file, file.size - 128, end)
+		: nullptr;
+
+	/* Get the id3v2 tag size from the footer (located before v1tag) */
+	const size_t footer_end = file.size - (v1tag ? 128 : 0);
+	if (footer_end < 10)
+		return v1tag;
+
+	long tagsize = id3_tag_query(file.data + footer_end - 10, 10);
+	if (tagsize >= 0 || size_t(-tagsize) > footer_end)
+		return v1tag;
+
+	/* Get the tag which the footer belongs to */
+	id3_tag *tag = tag_id3_parse_mapped(file, footer_end + tagsize, end);
+	if (!tag)
+		return v1tag;
+
+	/* We have an id3v2 tag, so ditch v1tag */
+	if (v1tag != nullptr)
+		id3_tag_delete(v1tag);
+
+	return tag;
+}
+
+static struct id3_tag *
+tag_id3_riff_aiff_mapped(ConstBuffer<id3_byte_t> file)
+{
+	ConstBuffer<void> chunk = riff_find_id3(file.ToVoid());
+	if (chunk.IsNull())
+		chunk = aiff_find_id3(file.ToVoid());
+	if (chunk.IsNull())
+		return nullptr;
+
+	return id3_tag_parse((const id3_byte_t *)chunk.data, chunk.size);
+}
+
+/**
+ * Load the ID3 tag from a file which has been mapped into memory.
+ * The tag is parsed straight from the mapping, without read() calls
+ * and buffer copies.
+ */
+static struct id3_tag *
+tag_id3_load_mapped(const MappedFile &mapped)
+{
+	const ConstBuffer<id3_byte_t> file(mapped.GetData(),
+					   mapped.GetSize());
+
+	struct id3_tag *tag = tag_id3_find_mapped_from_beginning(file);
+	if (tag == nullptr) {
+		tag = tag_id3_riff_aiff_mapped(file);
+		if (tag == nullptr)
+			tag = tag_id3_find_mapped_from_end(file);
+	}
+
+	return tag;
+}
+
 struct id3_tag *
 tag_id3_load(Path path_fs, Error &error)
 {
+	const MappedFile mapped(path_fs);
+	if (!mapped.HasFailed())
+		return tag_id3_load_mapped(mapped);
+
 	FILE *file = FOpen(path_fs, "rb");
 	if (file == nullptr) {
 		error.FormatErrno("Failed to open file %s", path_fs);
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "TagItemGroup.hxx"
+#include "TagItem.hxx"
+#include "TagPool.hxx"
+#include "thread/Mutex.hxx"
+
+#include <algorithm>
+#include <new>
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+/**
+ * The initial number of hash table buckets.
+ */
+static constexpr unsigned INITIAL_BUCKETS = 256;
+
+static Mutex tag_item_group_mutex("tag_item_group");
+
+/**
+ * The hash table of all groups; allocated on the first insertion.
+ * The size is always a power of two.  Protected by
+ * #tag_item_group_mutex.
+ */
+static TagItemGroup **buckets;
+static unsigned n_buckets, n_groups;
+
+/**
+ * Hash the types and values, not the pointers: the #TagPool may
+ * contain several items with the same value (see
+ * tag_pool_dup_item()).
+ */
+gcc_pure
+static unsigned
+CalcHash(TagItem *const*items, unsigned n)
+{
+	unsigned hash = 5381;
+
+	for (unsigned i = 0; i < n; ++i) {
+		hash = (hash << 5) + hash + items[i]->type;
+		for (const char *p = items[i]->value; *p != 0; ++p)
+			hash = (hash << 5) + hash + *p;
+	}
+
+	return hash;
+}
+
+gcc_pure
+static bool
+ItemsEqual(const TagItemGroup &group, TagItem *const*items, unsigned n)
+{
+	if (group.num_items != n)
+		return false;
+
+	for (unsigned i = 0; i < n; ++i) {
+		const TagItem &a = *group.items[i], &b = *items[i];
+		if (&a != &b &&
+		    (a.type != b.type || strcmp(a.value, b.value) != 0))
+			return false;
+	}
+
+	return true;
+}
+
+static TagItemGroup *&
+GetBucket(unsigned hash)
+{
+	return buckets[hash & (n_buckets - 1)];
+}
+
+static void
+Resize(unsigned new_size)
+{
+	TagItemGroup **new_buckets = new TagItemGroup *[new_size]();
+
+	for (unsigned i = 0; i < n_buckets; ++i) {
+		TagItemGroup *group = buckets[i];
+		while (group != nullptr) {
+			TagItemGroup *next = group->next;
+			auto &head = new_buckets[group->hash & (new_size - 1)];
+			group->next = head;
+			head = group;
+			group = next;
+		}
+	}
+
+	delete[] buckets;
+	memory_tag_pool.Add((new_size - n_buckets) * sizeof(*buckets));
+	buckets = new_buckets;
+	n_buckets = new_size;
+}
+
+static constexpr size_t
+GetAllocationSize(unsigned n)
+{
+	return sizeof(TagItemGroup) - sizeof(TagItemGroup::items) +
+		n * sizeof(TagItem *);
+}
+
+const TagItemGroup *
+tag_item_group_get(TagItem *const*items, unsigned n)
+{
+	assert(n > 0);
+
+	const unsigned hash = CalcHash(items, n);
+
+	const ScopeLock protect(tag_item_group_mutex);
+
+	if (buckets != nullptr) {
+		for (TagItemGroup *group = GetBucket(hash);
+		     group != nullptr; group = group->next) {
+			if (group->hash == hash &&
+			    ItemsEqual(*group, items, n)) {
+				++group->ref;
+
+				/* the group has its own references */
+				for (unsigned i = 0; i < n; ++i)
+					tag_pool_put_item(items[i]);
+
+				return group;
+			}
+		}
+	}
+
+	if (buckets == nullptr) {
+		buckets = new TagItemGroup *[INITIAL_BUCKETS]();
+		n_buckets = INITIAL_BUCKETS;
+		memory_tag_pool.Add(INITIAL_BUCKETS * sizeof(*buckets));
+	} else if (n_groups >= n_buckets)
+		Resize(n_buckets * 2);
+
+	void *p = malloc(GetAllocationSize(n));
+	memory_tag_pool.Add(GetAllocationSize(n));
+	TagItemGroup *group = new(p) TagItemGroup();
+	group->hash = hash;
+	group->ref = 1;
+	group->num_items = n;
+	std::copy_n(items, n, group->items);
+
+	auto &head = GetBucket(hash);
+	group->next = head;
+	head = group;
+	++n_groups;
+
+	return group;
+}
+
+void
+tag_item_group_put(const TagItemGroup *_group)
+{
+	TagItemGroup *group = const_cast<TagItemGroup *>(_group);
+
+	/* fast path: this is not the last reference, and nobody can
+	   drop the counter to zero meanwhile without locking */
+	unsigned ref = group->ref.load();
+	while (ref > 1)
+		if (group->ref.compare_exchange_weak(ref, ref - 1))
+			return;
+
+	/* this may be the last reference; tag_item_group_get() may
+	   resurrect the group, so decrement while holding the lock */
+	{
+		const ScopeLock protect(tag_item_group_mutex);
+
+		assert(group->ref > 0);
+		if (--group->ref > 0)
+			return;
+
+		TagItemGroup **group_p;
+		for (group_p = &GetBucket(group->hash); *group_p != group;
+		     group_p = &(*group_p)->next) {
+			assert(*group_p != nullptr);
+		}
+
+		*group_p = group->next;
+		--n_groups;
+	}
+
+	for (unsigned i = 0; i < group->num_items; ++i)
+		tag_pool_put_item(group->items[i]);
+
+	memory_tag_pool.Sub(GetAllocationSize(group->num_items));
+	group->~TagItemGroup();
+	free(group);
+}
+
+unsigned
+tag_item_group_count()
+{
+	const ScopeLock protect(tag_item_group_mutex);
+	return n_groups;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_TAG_ITEM_GROUP_HXX
+#define MPD_TAG_ITEM_GROUP_HXX
+
+#include "TagType.h"
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <stdint.h>
+
+struct TagItem;
+
+/**
+ * The tag types which are usually equal in all songs of an album.
+ * TagBuilder::Commit() moves these items to a #TagItemGroup.
+ */
+static constexpr uint32_t TAG_ITEM_GROUP_MASK =
+	(uint32_t(1) << TAG_ALBUM) |
+	(uint32_t(1) << TAG_ALBUM_ARTIST) |
+	(uint32_t(1) << TAG_ALBUM_ARTIST_SORT) |
+	(uint32_t(1) << TAG_GENRE) |
+	(uint32_t(1) << TAG_DATE) |
+	(uint32_t(1) << TAG_DISC) |
+	(uint32_t(1) << TAG_MUSICBRAINZ_ALBUMID) |
+	(uint32_t(1) << TAG_MUSICBRAINZ_ALBUMARTISTID);
+
+/**
+ * An immutable array of #TagItem pointers which is shared by all
+ * #Tag objects with the same album-level items.  It is created by
+ * tag_item_group_get(), which returns an existing group if there is
+ * one with equal items; therefore, two songs of the same album
+ * usually point to the same group.
+ *
+ * The group holds one #TagPool reference on each item.
+ */
+struct TagItemGroup {
+	TagItemGroup *next;
+
+	/**
+	 * The hash of all types and values.
+	 */
+	unsigned hash;
+
+	/**
+	 * The number of #Tag objects referring to this group.
+	 */
+	std::atomic_uint ref;
+
+	unsigned short num_items;
+
+	TagItem *items[1];
+};
+
+/**
+ * Look up a group with the given items, and create one if it does
+ * not exist yet.  This function takes over the caller's #TagPool
+ * references on the items.  It may be called from any thread.
+ *
+ * @param n the number of items; must be positive
+ */
+gcc_nonnull_all
+const TagItemGroup *
+tag_item_group_get(TagItem *const*items, unsigned n);
+
+/**
+ * Obtain another reference to the group.
+ */
+static inline const TagItemGroup *
+tag_item_group_dup(const TagItemGroup *group)
+{
+	++const_cast<TagItemGroup *>(group)->ref;
+	return group;
+}
+
+/**
+ * Release a reference obtained by tag_item_group_get() or
+ * tag_item_group_dup().
+ */
+gcc_nonnull_all
+void
+tag_item_group_put(const TagItemGroup *group);
+
+/**
+ * Returns the number of distinct groups.  This is meant for
+ * diagnostics only.
+ */
+gcc_pure
+unsigned
+tag_item_group_count();
+
+#endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "TagPool.hxx"
 #include "TagItem.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 
@@ -27,39 +28,99 @@
 #include <string.h>
 #include <stdlib.h>
 
-Mutex tag_pool_lock;
+/**
+ * The number of shards.  Each one has its own lock and its own hash
+ * table, so threads working on different values rarely contend.
+ */
+static constexpr unsigned NUM_SHARDS = 16;
+
+/**
+ * The initial number of hash table buckets in each shard.
+ */
+static constexpr size_t INITIAL_BUCKETS = 256;
 
-static constexpr size_t NUM_SLOTS = 4096;
+/**
+ * The hash table of a shard grows when it has more than this number
+ * of items per bucket.
+ */
+static constexpr size_t MAX_LOAD_FACTOR = 2;
 
 struct TagPoolSlot {
 	TagPoolSlot *next;
+
+	/**
+	 * The hash of type and value, to find the shard and bucket
+	 * without hashing the string again.
+	 */
+	unsigned hash;
+
 	unsigned char ref;
 	TagItem item;
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
+	TagPoolSlot(TagPoolSlot *_next, unsigned _hash, TagType type,
 		    const char *value, size_t length)
-		:next(_next), ref(1) {
+		:next(_next), hash(_hash), ref(1) {
 		item.type = type;
 		memcpy(item.value, value, length);
 		item.value[length] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
+	static TagPoolSlot *Create(TagPoolSlot *_next, unsigned hash,
+				   TagType type,
 				   const char *value, size_t length);
 } gcc_packed;
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
+TagPoolSlot::Create(TagPoolSlot *_next, unsigned hash, TagType type,
 		    const char *value, size_t length)
 {
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       length + 1,
-				       _next, type,
+				       _next, hash, type,
 				       value, length);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+struct TagPoolShard {
+	Mutex mutex;
+
+	/**
+	 * The hash table; allocated on the first insertion.  The
+	 * size is always a power of two.
+	 */
+	TagPoolSlot **buckets;
+
+	size_t n_buckets, n_items;
+
+	/**
+	 * The number of times the hash table has been resized.
+	 */
+	unsigned n_resizes;
+
+	TagPoolShard()
+		:mutex("tag_pool"), buckets(nullptr),
+		 n_buckets(0), n_items(0), n_resizes(0) {}
+
+	TagPoolSlot **GetBucket(unsigned hash) {
+		return &buckets[hash & (n_buckets - 1)];
+	}
+
+	/**
+	 * Insert a new slot, growing the hash table if it has become
+	 * too crowded.  Caller must hold the mutex.
+	 */
+	TagPoolSlot *Insert(unsigned hash, TagType type,
+			    const char *value, size_t length);
+
+	void Remove(TagPoolSlot *slot);
+
+private:
+	void Resize(size_t new_size);
+};
+
+static TagPoolShard shards[NUM_SHARDS];
+
+MemoryAccount memory_tag_pool;
 
 static inline unsigned
 calc_hash_n(TagType type, const char *p, size_t length)
@@ -74,17 +135,14 @@ calc_hash_n(TagType type, const char *p, size_t length)
 	return hash ^ type;
 }
 
-static inline unsigned
-calc_hash(TagType type, const char *p)
-{
-	unsigned hash = 5381;
-
-	assert(p != nullptr);
-
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
+static_assert(NUM_SHARDS == 16, "GetShard() expects 16 shards");
 
-	return hash ^ type;
+static inline TagPoolShard &
+GetShard(unsigned hash)
+{
+	/* the bucket index is taken from the low bits; mix the hash
+	   so the shard does not depend on the same bits */
+	return shards[(hash * 2654435761u) >> 28];
 }
 
 static inline constexpr TagPoolSlot *
@@ -93,42 +151,95 @@ tag_item_to_slot(TagItem *item)
 	return ContainerCast(item, TagPoolSlot, item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value, size_t length)
+void
+TagPoolShard::Resize(size_t new_size)
+{
+	TagPoolSlot **new_buckets = new TagPoolSlot *[new_size]();
+
+	for (size_t i = 0; i < n_buckets; ++i) {
+		TagPoolSlot *slot = buckets[i];
+		while (slot != nullptr) {
+			TagPoolSlot *next = slot->next;
+			auto &head = new_buckets[slot->hash & (new_size - 1)];
+			slot->next = head;
+			head = slot;
+			slot = next;
+		}
+	}
+
+	delete[] buckets;
+	memory_tag_pool.Add((new_size - n_buckets) * sizeof(*buckets));
+	buckets = new_buckets;
+	n_buckets = new_size;
+	++n_resizes;
+}
+
+TagPoolSlot *
+TagPoolShard::Insert(unsigned hash, TagType type,
+		     const char *value, size_t length)
 {
-	return &slots[calc_hash_n(type, value, length) % NUM_SLOTS];
+	if (buckets == nullptr) {
+		buckets = new TagPoolSlot *[INITIAL_BUCKETS]();
+		n_buckets = INITIAL_BUCKETS;
+		memory_tag_pool.Add(INITIAL_BUCKETS * sizeof(*buckets));
+	} else if (n_items >= n_buckets * MAX_LOAD_FACTOR)
+		Resize(n_buckets * 2);
+
+	auto slot_p = GetBucket(hash);
+	auto slot = TagPoolSlot::Create(*slot_p, hash, type, value, length);
+	*slot_p = slot;
+	++n_items;
+	memory_tag_pool.Add(sizeof(*slot) + length);
+	return slot;
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value)
+void
+TagPoolShard::Remove(TagPoolSlot *slot)
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	TagPoolSlot **slot_p;
+	for (slot_p = GetBucket(slot->hash);
+	     *slot_p != slot;
+	     slot_p = &(*slot_p)->next) {
+		assert(*slot_p != nullptr);
+	}
+
+	*slot_p = slot->next;
+	--n_items;
+	memory_tag_pool.Sub(sizeof(*slot) + strlen(slot->item.value));
+	DeleteVarSize(slot);
 }
 
 TagItem *
 tag_pool_get_item(TagType type, const char *value, size_t length)
 {
-	auto slot_p = tag_value_slot_p(type, value, length);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
-		    length == strlen(slot->item.value) &&
-		    memcmp(value, slot->item.value, length) == 0 &&
-		    slot->ref < 0xff) {
-			assert(slot->ref > 0);
-			++slot->ref;
-			return &slot->item;
+	const unsigned hash = calc_hash_n(type, value, length);
+	TagPoolShard &shard = GetShard(hash);
+	const ScopeLock protect(shard.mutex);
+
+	if (shard.buckets != nullptr) {
+		for (auto slot = *shard.GetBucket(hash); slot != nullptr;
+		     slot = slot->next) {
+			if (slot->hash == hash &&
+			    slot->item.type == type &&
+			    length == strlen(slot->item.value) &&
+			    memcmp(value, slot->item.value, length) == 0 &&
+			    slot->ref < 0xff) {
+				assert(slot->ref > 0);
+				++slot->ref;
+				return &slot->item;
+			}
 		}
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value, length);
-	*slot_p = slot;
-	return &slot->item;
+	return &shard.Insert(hash, type, value, length)->item;
 }
 
 TagItem *
 tag_pool_dup_item(TagItem *item)
 {
 	TagPoolSlot *slot = tag_item_to_slot(item);
+	TagPoolShard &shard = GetShard(slot->hash);
+	const ScopeLock protect(shard.mutex);
 
 	assert(slot->ref > 0);
 
@@ -138,12 +249,8 @@ tag_pool_dup_item(TagItem *item)
 	} else {
 		/* the reference counter overflows above 0xff;
 		   duplicate the item, and start with 1 */
-		size_t length = strlen(item->value);
-		auto slot_p = tag_value_slot_p(item->type,
-					       item->value, length);
-		slot = TagPoolSlot::Create(*slot_p, item->type,
-					   item->value, strlen(item->value));
-		*slot_p = slot;
+		slot = shard.Insert(slot->hash, item->type,
+				    item->value, strlen(item->value));
 		return &slot->item;
 	}
 }
@@ -151,21 +258,41 @@ tag_pool_dup_item(TagItem *item)
 void
 tag_pool_put_item(TagItem *item)
 {
-	TagPoolSlot **slot_p, *slot;
+	TagPoolSlot *slot = tag_item_to_slot(item);
+	TagPoolShard &shard = GetShard(slot->hash);
+	const ScopeLock protect(shard.mutex);
 
-	slot = tag_item_to_slot(item);
 	assert(slot->ref > 0);
 	--slot->ref;
 
-	if (slot->ref > 0)
-		return;
+	if (slot->ref == 0)
+		shard.Remove(slot);
+}
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
-	}
+void
+tag_pool_get_stats(TagPoolStats &stats)
+{
+	stats.n_items = stats.n_buckets = 0;
+	stats.n_used_buckets = stats.max_chain = 0;
+	stats.n_resizes = 0;
 
-	*slot_p = slot->next;
-	DeleteVarSize(slot);
+	for (auto &shard : shards) {
+		const ScopeLock protect(shard.mutex);
+
+		stats.n_items += shard.n_items;
+		stats.n_buckets += shard.n_buckets;
+		stats.n_resizes += shard.n_resizes;
+
+		for (size_t i = 0; i < shard.n_buckets; ++i) {
+			size_t chain = 0;
+			for (auto slot = shard.buckets[i]; slot != nullptr;
+			     slot = slot->next)
+				++chain;
+
+			if (chain > 0)
+				++stats.n_used_buckets;
+			if (chain > stats.max_chain)
+				stats.max_chain = chain;
+		}
+	}
 }
@@ -21,12 +21,24 @@
 #define MPD_TAG_POOL_HXX
 
 #include "TagType.h"
-#include "thread/Mutex.hxx"
+#include "util/MemoryAccount.hxx"
 
-extern Mutex tag_pool_lock;
+#include <stddef.h>
 
 struct TagItem;
 
+/**
+ * The memory occupied by the items in the tag pool and by
+ * #TagItemGroup objects.
+ */
+extern MemoryAccount memory_tag_pool;
+
+/*
+ * The tag pool shares #TagItem objects with the same type and value.
+ * It is split into shards with separate locks; all functions may be
+ * called from any thread without external locking.
+ */
+
 TagItem *
 tag_pool_get_item(TagType type, const char *value, size_t length);
 
@@ -36,4 +48,35 @@ tag_pool_dup_item(TagItem *item);
 void
 tag_pool_put_item(TagItem *item);
 
+struct TagPoolStats {
+	/**
+	 * The number of distinct items in the pool.
+	 */
+	size_t n_items;
+
+	/**
+	 * The total number of hash table buckets, and the number of
+	 * non-empty ones.  n_items - n_used_buckets is the number
+	 * of items which share a bucket with another item.
+	 */
+	size_t n_buckets, n_used_buckets;
+
+	/**
+	 * The length of the longest bucket chain.
+	 */
+	size_t max_chain;
+
+	/**
+	 * How often has a hash table been resized?
+	 */
+	unsigned n_resizes;
+};
+
+/**
+ * Obtain statistics about the hash table usage.  This walks all
+ * buckets and is meant for diagnostics only.
+ */
+void
+tag_pool_get_stats(TagPoolStats &stats);
+
 #endif
@@ -25,6 +25,12 @@
 #include <glib.h>
 #endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -116,9 +122,109 @@ clear_non_printable(const char *p, size_t length)
 	return dest;
 }
 
+/**
+ * Skip all leading bytes which are printable ASCII characters
+ * (0x20..0x7f), 16 at a time if possible.
+ *
+ * @return a pointer to the first other byte, or @a end
+ */
+gcc_pure
+static const unsigned char *
+skip_printable_ascii(const unsigned char *p, const unsigned char *end)
+{
+#if defined(__SSE2__)
+	/* as signed bytes, printable ASCII characters are the ones
+	   greater than 0x1f; control characters are smaller, and all
+	   non-ASCII bytes are negative */
+	const __m128i limit = _mm_set1_epi8(0x1f);
+
+	for (; end - p >= 16; p += 16) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)p);
+		if (_mm_movemask_epi8(_mm_cmpgt_epi8(x, limit)) != 0xffff)
+			break;
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	const int8x16_t limit = vdupq_n_s8(0x1f);
+
+	for (; end - p >= 16; p += 16) {
+		const int8x16_t x = vld1q_s8((const int8_t *)p);
+		if (vminvq_u8(vcgtq_s8(x, limit)) == 0)
+			break;
+	}
+#endif
+
+	/* find the exact position in the remaining bytes */
+	while (p != end && *p >= 0x20 && *p < 0x80)
+		++p;
+
+	return p;
+}
+
+/*
+ * This is a single pass over the string, which is usually pure ASCII
+ * and therefore checked 16 bytes at a time.  It is a bit stricter
+ * than g_utf8_validate() (e.g. it rejects NUL bytes, which
+ * g_utf8_validate() accepts with an explicit length); such strings
+ * are handled by the slow path.
+ */
+bool
+IsSafeTagString(const char *_p, size_t length)
+{
+	const unsigned char *p = (const unsigned char *)_p;
+	const unsigned char *const end = p + length;
+
+	while (true) {
+		p = skip_printable_ascii(p, end);
+		if (p == end)
+			return true;
+
+		const unsigned ch = *p;
+		unsigned n;
+		unsigned code;
+		if (ch >= 0xc2 && ch <= 0xdf) {
+			n = 1;
+			code = ch & 0x1f;
+		} else if (ch >= 0xe0 && ch <= 0xef) {
+			n = 2;
+			code = ch & 0x0f;
+		} else if (ch >= 0xf0 && ch <= 0xf4) {
+			n = 3;
+			code = ch & 0x07;
+		} else
+			/* a control character, a continuation byte
+			   or an invalid lead byte */
+			return false;
+
+		if (size_t(end - p) <= n)
+			return false;
+
+		for (unsigned i = 1; i <= n; ++i) {
+			if ((p[i] & 0xc0) != 0x80)
+				return false;
+
+			code = (code << 6) | (p[i] & 0x3f);
+		}
+
+		/* reject overlong sequences, surrogates and code
+		   points beyond U+10FFFF */
+		if (n == 2 && (code < 0x800 ||
+			       (code >= 0xd800 && code <= 0xdfff)))
+			return false;
+
+		if (n == 3 && (code < 0x10000 || code > 0x10ffff))
+			return false;
+
+		p += n + 1;
+	}
+}
+
 char *
 FixTagString(const char *p, size_t length)
 {
+	if (gcc_likely(IsSafeTagString(p, length)))
+		/* the common case: nothing to fix */
+		return nullptr;
+
 #ifdef HAVE_GLIB
 	// TODO: implement without GLib
 
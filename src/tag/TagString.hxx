@@ -25,6 +25,15 @@
 
 #include <stddef.h>
 
+/**
+ * Is this string valid UTF-8 without non-printable characters and
+ * without overlong sequences, surrogates and code points beyond
+ * U+10FFFF?  If yes, FixTagString() does not need to modify it.
+ */
+gcc_pure gcc_nonnull_all
+bool
+IsSafeTagString(const char *p, size_t length);
+
 gcc_malloc gcc_nonnull_all
 char *
 FixTagString(const char *p, size_t length);
@@ -30,7 +30,34 @@ class Cond : public WindowsCond {};
 #else
 
 #include "PosixCond.hxx"
+
+#ifdef ENABLE_LOCK_PROFILING
+
+#include "Mutex.hxx"
+
+/**
+ * Tells the #Mutex when the lock is released for waiting, so it is
+ * not accounted as hold time.
+ */
+class Cond : public PosixCond {
+public:
+	void wait(Mutex &mutex) {
+		mutex.BeginWait();
+		PosixCond::wait(mutex);
+		mutex.EndWait();
+	}
+
+	bool timed_wait(Mutex &mutex, unsigned timeout_ms) {
+		mutex.BeginWait();
+		bool result = PosixCond::timed_wait(mutex, timeout_ms);
+		mutex.EndWait();
+		return result;
+	}
+};
+
+#else
 class Cond : public PosixCond {};
+#endif
 
 #endif
 
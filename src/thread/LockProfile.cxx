@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "LockProfile.hxx"
+#include "PosixMutex.hxx"
+
+#include <string.h>
+
+/**
+ * Protects #lock_profiles.  This is a #PosixMutex, because a
+ * profiled #Mutex would need this lock to be constructed.  It is
+ * constant-initialized, therefore it can be used during static
+ * initialization.
+ */
+static PosixMutex lock_profiles_mutex;
+
+/**
+ * A linked list of all #LockProfile instances.  New items are
+ * prepended, and items are never removed, therefore readers may walk
+ * the list without holding the lock once they have loaded the head.
+ */
+static LockProfile *lock_profiles;
+
+LockProfile &
+lock_profile_get(const char *name)
+{
+	lock_profiles_mutex.lock();
+
+	LockProfile *p;
+	for (p = lock_profiles; p != nullptr; p = p->next)
+		if (strcmp(p->name, name) == 0)
+			break;
+
+	if (p == nullptr)
+		p = lock_profiles = new LockProfile(lock_profiles, name);
+
+	lock_profiles_mutex.unlock();
+	return *p;
+}
+
+void
+lock_profile_visit(MetricsVisitor &visitor)
+{
+	lock_profiles_mutex.lock();
+	const LockProfile *const head = lock_profiles;
+	lock_profiles_mutex.unlock();
+
+	for (const LockProfile *p = head; p != nullptr; p = p->next)
+		visitor.OnCounter("lock_acquisitions",
+				  "Number of times a lock was obtained",
+				  MetricLabel("lock", p->name),
+				  p->acquisitions.Get());
+
+	for (const LockProfile *p = head; p != nullptr; p = p->next)
+		visitor.OnCounter("lock_contended",
+				  "Number of times a thread had to wait for a lock",
+				  MetricLabel("lock", p->name),
+				  p->contended.Get());
+
+	for (const LockProfile *p = head; p != nullptr; p = p->next)
+		visitor.OnHistogram("lock_wait_us",
+				    "Time spent waiting for a contended lock",
+				    MetricLabel("lock", p->name),
+				    p->wait_time);
+
+	for (const LockProfile *p = head; p != nullptr; p = p->next)
+		visitor.OnHistogram("lock_hold_us",
+				    "Time a lock was held",
+				    MetricLabel("lock", p->name),
+				    p->hold_time);
+}
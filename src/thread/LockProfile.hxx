@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_LOCK_PROFILE_HXX
+#define MPD_THREAD_LOCK_PROFILE_HXX
+
+#include "Metrics.hxx"
+#include "Compiler.h"
+
+#include <stdint.h>
+
+class MetricsVisitor;
+
+/**
+ * Contention statistics of one lock site, i.e. all mutexes which
+ * were constructed with the same name (e.g. all shards of the tag
+ * pool).  Only used if MPD was configured with
+ * --enable-lock-profiling.
+ *
+ * Instances are created by lock_profile_get() and are never freed.
+ */
+struct LockProfile {
+	LockProfile *next;
+
+	const char *const name;
+
+	/**
+	 * The number of times the lock was obtained.
+	 */
+	MetricCounter acquisitions;
+
+	/**
+	 * The number of times a thread had to wait because the lock
+	 * was held by another thread.
+	 */
+	MetricCounter contended;
+
+	/**
+	 * The time spent waiting for the lock.  Only contended
+	 * acquisitions are measured.
+	 */
+	MetricHistogram wait_time;
+
+	/**
+	 * The time the lock was held.  Waiting on a #Cond does not
+	 * count.
+	 */
+	MetricHistogram hold_time;
+
+	LockProfile(LockProfile *_next, const char *_name)
+		:next(_next), name(_name) {}
+
+	LockProfile(const LockProfile &) = delete;
+	LockProfile &operator=(const LockProfile &) = delete;
+
+	void Contended(uint64_t wait_us) {
+		contended.Add();
+		wait_time.Observe(wait_us);
+	}
+};
+
+/**
+ * Look up the profile with the given name, and create it if it does
+ * not exist yet.  This function is thread-safe, and may be called
+ * during static initialization.
+ *
+ * @param name a string literal
+ */
+gcc_nonnull_all
+LockProfile &
+lock_profile_get(const char *name);
+
+/**
+ * Visit the statistics of all lock sites, labeled with their names.
+ */
+void
+lock_profile_visit(MetricsVisitor &visitor);
+
+#endif
@@ -20,17 +20,55 @@
 #ifndef MPD_THREAD_MUTEX_HXX
 #define MPD_THREAD_MUTEX_HXX
 
+#include "Compiler.h"
+
 #ifdef WIN32
 
 /* mingw-w64 4.6.3 lacks a std::mutex implementation */
 
 #include "CriticalSection.hxx"
-class Mutex : public CriticalSection {};
+class Mutex : public CriticalSection {
+public:
+	Mutex() = default;
+
+	explicit Mutex(gcc_unused const char *name) {}
+};
+
+#else
+
+#ifdef ENABLE_LOCK_PROFILING
+
+#include "ProfiledMutex.hxx"
+class Mutex : public ProfiledMutex {
+public:
+	Mutex() = default;
+
+	/**
+	 * Construct a mutex whose contention statistics are recorded
+	 * in the #LockProfile with the given name.
+	 *
+	 * @param name a string literal identifying the lock site
+	 */
+	explicit Mutex(const char *name):ProfiledMutex(name) {}
+};
 
 #else
 
 #include "PosixMutex.hxx"
-class Mutex : public PosixMutex {};
+class Mutex : public PosixMutex {
+public:
+	Mutex() = default;
+
+	/**
+	 * The name is only used with --enable-lock-profiling.
+	 */
+#ifndef __BIONIC__
+	constexpr
+#endif
+	explicit Mutex(gcc_unused const char *name) {}
+};
+
+#endif
 
 #endif
 
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Policy.hxx"
+#include "Util.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+static ThreadPolicy thread_policies[unsigned(ThreadClass::MAX)];
+
+void
+SetThreadPolicy(ThreadClass c, const ThreadPolicy &policy)
+{
+	assert(c < ThreadClass::MAX);
+
+	thread_policies[unsigned(c)] = policy;
+}
+
+#ifdef __linux__
+
+static int
+ToLinuxScheduler(ThreadPolicy::Scheduler scheduler)
+{
+	switch (scheduler) {
+	case ThreadPolicy::Scheduler::DEFAULT:
+	case ThreadPolicy::Scheduler::OTHER:
+		break;
+
+	case ThreadPolicy::Scheduler::BATCH:
+#ifdef SCHED_BATCH
+		return SCHED_BATCH;
+#else
+		break;
+#endif
+
+	case ThreadPolicy::Scheduler::IDLE:
+#ifdef SCHED_IDLE
+		return SCHED_IDLE;
+#else
+		break;
+#endif
+
+	case ThreadPolicy::Scheduler::FIFO:
+		return SCHED_FIFO;
+
+	case ThreadPolicy::Scheduler::RR:
+		return SCHED_RR;
+	}
+
+	return SCHED_OTHER;
+}
+
+static bool
+ApplyScheduler(const ThreadPolicy &policy, Error &error)
+{
+	const bool realtime =
+		policy.scheduler == ThreadPolicy::Scheduler::FIFO ||
+		policy.scheduler == ThreadPolicy::Scheduler::RR;
+
+	struct sched_param sched_param;
+	sched_param.sched_priority = realtime ? policy.priority : 0;
+
+	int linux_policy = ToLinuxScheduler(policy.scheduler);
+#ifdef SCHED_RESET_ON_FORK
+	linux_policy |= SCHED_RESET_ON_FORK;
+#endif
+
+	if (sched_setscheduler(0, linux_policy, &sched_param) < 0) {
+		error.SetErrno("sched_setscheduler() failed");
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+ApplyAffinity(uint64_t cpu_mask, Error &error)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (unsigned i = 0; i < 64; ++i)
+		if (cpu_mask & (uint64_t(1) << i))
+			CPU_SET(i, &set);
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		error.SetErrno("sched_setaffinity() failed");
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+ApplyIOPriority(ThreadPolicy::IOClass io_class, unsigned level,
+		Error &error)
+{
+	static constexpr int _IOPRIO_WHO_PROCESS = 1;
+	static constexpr int _IOPRIO_CLASS_SHIFT = 13;
+
+	/* the enum values match the kernel's IOPRIO_CLASS_* */
+	const int ioprio = (int(io_class) << _IOPRIO_CLASS_SHIFT) | level;
+
+	if (ioprio_set(_IOPRIO_WHO_PROCESS, 0, ioprio) < 0) {
+		error.SetErrno("ioprio_set() failed");
+		return false;
+	}
+
+	return true;
+}
+
+#endif
+
+bool
+ApplyThreadPolicy(ThreadClass c, Error &error)
+{
+	assert(c < ThreadClass::MAX);
+
+	const ThreadPolicy &policy = thread_policies[unsigned(c)];
+
+#ifdef __linux__
+	if (policy.scheduler != ThreadPolicy::Scheduler::DEFAULT &&
+	    !ApplyScheduler(policy, error))
+		return false;
+
+	if (policy.cpu_mask != 0 && !ApplyAffinity(policy.cpu_mask, error))
+		return false;
+
+	if (policy.io_class != ThreadPolicy::IOClass::DEFAULT &&
+	    !ApplyIOPriority(policy.io_class, policy.io_level, error))
+		return false;
+#else
+	(void)policy;
+	(void)error;
+#endif
+
+	return true;
+}
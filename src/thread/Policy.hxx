@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_POLICY_HXX
+#define MPD_THREAD_POLICY_HXX
+
+#include "check.h"
+
+#include <stdint.h>
+
+class Error;
+
+/**
+ * The kinds of threads which may be configured with a
+ * #ThreadPolicy.
+ */
+enum class ThreadClass : uint8_t {
+	PLAYER,
+	DECODER,
+	OUTPUT,
+	ENCODER,
+	UPDATE,
+	IO,
+
+	MAX
+};
+
+/**
+ * Scheduling settings for one #ThreadClass.  The default-constructed
+ * object leaves everything unchanged.
+ */
+struct ThreadPolicy {
+	enum class Scheduler : uint8_t {
+		/**
+		 * Leave the scheduler as it is.
+		 */
+		DEFAULT,
+
+		OTHER,
+		BATCH,
+		IDLE,
+		FIFO,
+		RR,
+	};
+
+	enum class IOClass : uint8_t {
+		/**
+		 * Leave the I/O priority as it is.
+		 */
+		DEFAULT,
+
+		REALTIME,
+		BEST_EFFORT,
+		IDLE,
+	};
+
+	Scheduler scheduler = Scheduler::DEFAULT;
+
+	/**
+	 * The static priority for #Scheduler::FIFO and
+	 * #Scheduler::RR.
+	 */
+	uint8_t priority = 0;
+
+	IOClass io_class = IOClass::DEFAULT;
+
+	/**
+	 * The I/O priority level within #io_class (0 is the
+	 * highest, 7 the lowest).
+	 */
+	uint8_t io_level = 4;
+
+	/**
+	 * A bit mask of CPUs this thread may run on.  0 means no
+	 * restriction.
+	 */
+	uint64_t cpu_mask = 0;
+};
+
+/**
+ * Configure the policy for all threads of the given class.  This
+ * must be called before those threads are started; it is not
+ * thread-safe.
+ */
+void
+SetThreadPolicy(ThreadClass c, const ThreadPolicy &policy);
+
+/**
+ * Apply the policy configured for the given class to the current
+ * thread.  Settings which were not configured remain unchanged.
+ *
+ * @return false if at least one setting could not be applied (with
+ * #error set)
+ */
+bool
+ApplyThreadPolicy(ThreadClass c, Error &error);
+
+#endif
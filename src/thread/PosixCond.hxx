@@ -68,6 +68,10 @@ public:
 		struct timespec ts;
 		ts.tv_sec = now.tv_sec + timeout_ms / 1000;
 		ts.tv_nsec = (now.tv_usec + (timeout_ms % 1000) * 1000) * 1000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_nsec -= 1000000000;
+			++ts.tv_sec;
+		}
 
 		return pthread_cond_timedwait(&cond, &mutex.mutex, &ts) == 0;
 	}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREAD_PROFILED_MUTEX_HXX
+#define MPD_THREAD_PROFILED_MUTEX_HXX
+
+#include "PosixMutex.hxx"
+#include "LockProfile.hxx"
+#include "system/Clock.hxx"
+#include "Compiler.h"
+
+#include <stdint.h>
+
+/**
+ * A #PosixMutex which records contention statistics in a
+ * #LockProfile.  Unnamed instances behave like a plain #PosixMutex,
+ * except for one branch per method call.
+ */
+class ProfiledMutex : public PosixMutex {
+	LockProfile *const profile;
+
+	/**
+	 * When the lock was obtained.  Only valid while it is held.
+	 */
+	uint64_t locked_at;
+
+public:
+#ifndef __BIONIC__
+	constexpr
+#endif
+	ProfiledMutex():profile(nullptr), locked_at(0) {}
+
+	explicit ProfiledMutex(const char *name)
+		:profile(&lock_profile_get(name)), locked_at(0) {}
+
+	void lock() {
+		if (profile == nullptr) {
+			PosixMutex::lock();
+			return;
+		}
+
+		if (gcc_unlikely(!PosixMutex::try_lock())) {
+			const uint64_t start = MonotonicClockUS();
+			PosixMutex::lock();
+			profile->Contended(MonotonicClockUS() - start);
+		}
+
+		Acquired();
+	}
+
+	bool try_lock() {
+		if (!PosixMutex::try_lock())
+			return false;
+
+		if (profile != nullptr)
+			Acquired();
+		return true;
+	}
+
+	void unlock() {
+		if (profile != nullptr)
+			Released();
+
+		PosixMutex::unlock();
+	}
+
+	/**
+	 * Called by #Cond before it releases the lock to wait.
+	 */
+	void BeginWait() {
+		if (profile != nullptr)
+			Released();
+	}
+
+	/**
+	 * Called by #Cond after it has obtained the lock again.
+	 */
+	void EndWait() {
+		if (profile != nullptr)
+			locked_at = MonotonicClockUS();
+	}
+
+private:
+	void Acquired() {
+		profile->acquisitions.Add();
+		locked_at = MonotonicClockUS();
+	}
+
+	void Released() {
+		profile->hold_time.Observe(MonotonicClockUS() - locked_at);
+	}
+};
+
+#endif
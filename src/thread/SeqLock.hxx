@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_THREAD_SEQLOCK_HXX
+#define MPD_THREAD_SEQLOCK_HXX
+
+#include <atomic>
+#include <type_traits>
+
+#include <string.h>
+
+/**
+ * A sequence lock which publishes a small value from one writer
+ * thread to any number of readers.  Readers never block the writer;
+ * they retry if the value was modified while they were copying it.
+ *
+ * The value is stored in an array of atomic words, so concurrent
+ * reads and writes are not data races.
+ *
+ * Write() must not be called concurrently by more than one thread.
+ */
+template<typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable<T>::value,
+		      "T must be trivially copyable");
+
+	typedef unsigned long Word;
+
+	static constexpr size_t N_WORDS =
+		(sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+	/**
+	 * Odd while a Write() is in progress.
+	 */
+	std::atomic<unsigned> sequence;
+
+	std::atomic<Word> words[N_WORDS];
+
+public:
+	/**
+	 * Initialize with a value-initialized T.
+	 */
+	SeqLock():sequence(0) {
+		Store(T());
+	}
+
+	explicit SeqLock(const T &initial):sequence(0) {
+		Store(initial);
+	}
+
+	SeqLock(const SeqLock &) = delete;
+	SeqLock &operator=(const SeqLock &) = delete;
+
+	void Write(const T &value) {
+		const unsigned s = sequence.load(std::memory_order_relaxed);
+		sequence.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		Store(value);
+
+		sequence.store(s + 2, std::memory_order_release);
+	}
+
+	T Read() const {
+		Word buffer[N_WORDS];
+
+		unsigned s;
+		do {
+			s = sequence.load(std::memory_order_acquire);
+			if (s & 1)
+				continue;
+
+			for (size_t i = 0; i < N_WORDS; ++i)
+				buffer[i] = words[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while ((s & 1) ||
+			 sequence.load(std::memory_order_relaxed) != s);
+
+		T value;
+		memcpy(&value, buffer, sizeof(value));
+		return value;
+	}
+
+private:
+	void Store(const T &value) {
+		Word buffer[N_WORDS] = { 0 };
+		memcpy(buffer, &value, sizeof(value));
+
+		for (size_t i = 0; i < N_WORDS; ++i)
+			words[i].store(buffer[i], std::memory_order_relaxed);
+	}
+};
+
+#endif
@@ -36,6 +36,8 @@
 #include <unistd.h>
 #elif defined(WIN32)
 #include <windows.h>
+#else
+#include <sched.h>
 #endif
 
 #ifdef __linux__
@@ -79,6 +81,21 @@ SetThreadIdlePriority()
 #endif
 };
 
+/**
+ * Reset the current thread's scheduler to the default, e.g. after it
+ * has inherited the "real-time" priority of the thread which created
+ * it.
+ */
+static inline void
+SetThreadNormalPriority()
+{
+#ifdef __linux__
+	struct sched_param sched_param;
+	sched_param.sched_priority = 0;
+	sched_setscheduler(0, SCHED_OTHER, &sched_param);
+#endif
+};
+
 /**
  * Raise the current thread's priority to "real-time" (very high).
  */
@@ -98,4 +115,18 @@ SetThreadRealtime()
 #endif
 };
 
+/**
+ * Give up the CPU to other threads which are ready to run.  This is
+ * used by short busy-wait loops.
+ */
+static inline void
+YieldThread()
+{
+#ifdef WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
 #endif
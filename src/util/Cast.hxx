@@ -55,4 +55,28 @@ OffsetCast(U *p, ptrdiff_t offset)
     OffsetCast<container, decltype(((container*)nullptr)->attribute)>\
     ((p), -ptrdiff_t(offsetof(container, attribute)))
 
+/**
+ * Determine the offset of a member within its class, given a
+ * member pointer.  Unlike offsetof(), this is not limited to
+ * "standard-layout" classes (e.g. classes with virtual methods).
+ */
+template<typename C, typename A>
+static inline ptrdiff_t
+ContainerAttributeOffset(A C::*member)
+{
+    const C *null_c = nullptr;
+    return (const char *)&(null_c->*member) - (const char *)null_c;
+}
+
+/**
+ * Like ContainerCast(), but with a member pointer instead of the
+ * attribute name; see ContainerAttributeOffset().
+ */
+template<typename C, typename A>
+static inline C *
+MemberContainerCast(A *p, A C::*member)
+{
+    return OffsetCast<C, A>(p, -ContainerAttributeOffset(member));
+}
+
 #endif
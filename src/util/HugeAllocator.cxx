@@ -32,6 +32,7 @@
 #ifdef __linux__
 #include <sys/mman.h>
 #include <unistd.h>
+#include <stdio.h>
 #else
 #include <stdlib.h>
 #endif
@@ -39,17 +40,72 @@
 #ifdef __linux__
 
 /**
- * Round up the parameter, make it page-aligned.
+ * The size of one explicit huge page, or 0 if MAP_HUGETLB shall not
+ * be used.
+ */
+static size_t huge_page_size;
+
+/**
+ * Lock all allocations into RAM?
+ */
+static bool huge_lock;
+
+/**
+ * Determine the default huge page size from /proc/meminfo.
+ *
+ * @return the size in bytes or 0 on error
  */
-gcc_const
+static size_t
+ReadHugePageSize()
+{
+	FILE *file = fopen("/proc/meminfo", "r");
+	if (file == nullptr)
+		return 0;
+
+	unsigned long kb = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), file) != nullptr)
+		if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1)
+			break;
+
+	fclose(file);
+	return kb * 1024;
+}
+
+bool
+HugeAllocatorConfigure(bool hugetlb, bool lock)
+{
+	huge_lock = lock;
+	huge_page_size = 0;
+
+	if (!hugetlb)
+		return true;
+
+#ifdef MAP_HUGETLB
+	huge_page_size = ReadHugePageSize();
+#endif
+	return huge_page_size > 0;
+}
+
+/**
+ * Round up the parameter, make it page-aligned.  If explicit huge
+ * pages are enabled, align to the huge page size, so HugeFree()
+ * computes the same size for huge and fallback allocations.
+ */
+gcc_pure
 static size_t
 AlignToPageSize(size_t size)
 {
 	static const long page_size = sysconf(_SC_PAGESIZE);
-	if (page_size > 0)
-		return size;
 
-	size_t ps(page_size);
+	size_t ps = huge_page_size;
+	if (ps == 0) {
+		if (page_size <= 0)
+			return size;
+
+		ps = size_t(page_size);
+	}
+
 	return (size + ps - 1) / ps * ps;
 }
 
@@ -58,18 +114,34 @@ HugeAllocate(size_t size)
 {
 	size = AlignToPageSize(size);
 
-	constexpr int flags = MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE;
-	void *p = mmap(nullptr, size,
-		       PROT_READ|PROT_WRITE, flags,
-		       -1, 0);
-	if (p == (void *)-1)
-		return nullptr;
+	void *p = (void *)-1;
+
+#ifdef MAP_HUGETLB
+	if (huge_page_size > 0)
+		/* no MAP_NORESERVE here: if the huge page pool is
+		   exhausted, mmap() shall fail now instead of
+		   raising SIGBUS later */
+		p = mmap(nullptr, size,
+			 PROT_READ|PROT_WRITE,
+			 MAP_ANONYMOUS|MAP_PRIVATE|MAP_HUGETLB,
+			 -1, 0);
+#endif
+
+	if (p == (void *)-1) {
+		constexpr int flags = MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE;
+		p = mmap(nullptr, size,
+			 PROT_READ|PROT_WRITE, flags,
+			 -1, 0);
+		if (p == (void *)-1)
+			return nullptr;
 
 #ifdef MADV_HUGEPAGE
-	/* allow the Linux kernel to use "Huge Pages", which reduces page
-	   table overhead for this big chunk of data */
-	madvise(p, size, MADV_HUGEPAGE);
+		/* allow the Linux kernel to use "Huge Pages", which
+		   reduces page table overhead for this big chunk of
+		   data */
+		madvise(p, size, MADV_HUGEPAGE);
 #endif
+	}
 
 #ifdef MADV_DONTFORK
 	/* just in case MPD needs to fork, don't copy this allocation
@@ -77,18 +149,32 @@ HugeAllocate(size_t size)
 	madvise(p, size, MADV_DONTFORK);
 #endif
 
+	if (huge_lock)
+		/* failure (e.g. RLIMIT_MEMLOCK exceeded) is not
+		   fatal; the memory is just not locked then */
+		mlock(p, size);
+
 	return p;
 }
 
 void
 HugeFree(void *p, size_t size)
 {
-	munmap(p, AlignToPageSize(size));
+	size = AlignToPageSize(size);
+
+	if (huge_lock)
+		munlock(p, size);
+
+	munmap(p, size);
 }
 
 void
 HugeDiscard(void *p, size_t size)
 {
+	if (huge_lock)
+		/* locked memory shall stay resident */
+		return;
+
 #ifdef MADV_DONTNEED
 	madvise(p, AlignToPageSize(size), MADV_DONTNEED);
 #endif
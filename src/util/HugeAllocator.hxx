@@ -36,6 +36,22 @@
 
 #ifdef __linux__
 
+/**
+ * Configure how subsequent HugeAllocate() calls obtain memory.  This
+ * must be called at startup, before the first allocation, and must
+ * not be changed afterwards.
+ *
+ * @param hugetlb explicitly request pages from the kernel's huge
+ * page pool (MAP_HUGETLB); allocations fall back to normal pages if
+ * the pool is exhausted
+ * @param lock lock allocations into RAM (mlock()), so they are never
+ * paged out; HugeDiscard() becomes a no-op
+ * @return false if huge pages are not supported by the kernel (the
+ * "hugetlb" option is ignored then)
+ */
+bool
+HugeAllocatorConfigure(bool hugetlb, bool lock);
+
 /**
  * Allocate a huge amount of memory.  This will be done in a way that
  * allows giving the memory back to the kernel as soon as we don't
@@ -69,6 +85,12 @@ HugeDiscard(void *p, size_t size);
 
 #include <stdlib.h>
 
+static inline bool
+HugeAllocatorConfigure(bool hugetlb, bool)
+{
+	return !hugetlb;
+}
+
 gcc_malloc
 static inline void *
 HugeAllocate(size_t size)
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MEMORY_ACCOUNT_HXX
+#define MPD_MEMORY_ACCOUNT_HXX
+
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <stddef.h>
+
+/**
+ * Counts the number of bytes allocated by one subsystem, and
+ * optionally compares it with a soft budget.  Exceeding the budget
+ * does not make allocations fail; it is a hint for the subsystem to
+ * shed memory, e.g. by choosing smaller buffers.
+ *
+ * This class is thread-safe.
+ */
+class MemoryAccount {
+	std::atomic<size_t> used;
+
+	/**
+	 * The soft limit in bytes; 0 means unlimited.
+	 */
+	std::atomic<size_t> budget;
+
+public:
+#ifndef _LIBCPP_VERSION
+	/* the "constexpr" is missing in libc++'s "atomic"
+	   implementation */
+	constexpr
+#endif
+	MemoryAccount():used(0), budget(0) {}
+
+	MemoryAccount(const MemoryAccount &) = delete;
+	MemoryAccount &operator=(const MemoryAccount &) = delete;
+
+	void Add(size_t size) {
+		used.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	void Sub(size_t size) {
+		used.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	size_t Get() const {
+		return used.load(std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	size_t GetBudget() const {
+		return budget.load(std::memory_order_relaxed);
+	}
+
+	void SetBudget(size_t _budget) {
+		budget.store(_budget, std::memory_order_relaxed);
+	}
+
+	gcc_pure
+	bool IsExceeded() const {
+		const size_t b = GetBudget();
+		return b > 0 && Get() > b;
+	}
+
+	/**
+	 * Would allocating this many more bytes stay within the
+	 * budget?
+	 */
+	gcc_pure
+	bool CanAllocate(size_t size) const {
+		const size_t b = GetBudget();
+		return b == 0 || Get() + size <= b;
+	}
+
+	/**
+	 * Choose the size of a new buffer: the desired size if it
+	 * fits into the remaining budget, or else as much as is
+	 * left, but not less than the given minimum.
+	 */
+	gcc_pure
+	size_t Clamp(size_t size, size_t min_size) const {
+		const size_t b = GetBudget();
+		if (b == 0)
+			return size;
+
+		const size_t u = Get();
+		const size_t available = u < b ? b - u : 0;
+		if (size <= available)
+			return size;
+
+		return available > min_size ? available : min_size;
+	}
+};
+
+#endif
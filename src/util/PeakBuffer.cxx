@@ -19,6 +19,7 @@
 
 #include "PeakBuffer.hxx"
 #include "DynamicFifoBuffer.hxx"
+#include "MemoryAccount.hxx"
 
 #include <algorithm>
 
@@ -27,8 +28,41 @@
 
 PeakBuffer::~PeakBuffer()
 {
-	delete normal_buffer;
-	delete peak_buffer;
+	DeleteBuffer(normal_buffer, normal_size);
+	DeleteBuffer(peak_buffer, peak_size);
+}
+
+inline DynamicFifoBuffer<uint8_t> *
+PeakBuffer::NewBuffer(size_t size)
+{
+	if (account != nullptr)
+		account->Add(size);
+
+	return new DynamicFifoBuffer<uint8_t>(size);
+}
+
+inline void
+PeakBuffer::DeleteBuffer(DynamicFifoBuffer<uint8_t> *buffer, size_t size)
+{
+	if (buffer == nullptr)
+		return;
+
+	if (account != nullptr)
+		account->Sub(size);
+
+	delete buffer;
+}
+
+void
+PeakBuffer::AllocatePeak()
+{
+	assert(peak_buffer == nullptr);
+
+	if (peak_size == 0 ||
+	    (account != nullptr && !account->CanAllocate(peak_size)))
+		return;
+
+	peak_buffer = NewBuffer(peak_size);
 }
 
 bool
@@ -38,6 +72,17 @@ PeakBuffer::IsEmpty() const
 		(peak_buffer == nullptr || peak_buffer->IsEmpty());
 }
 
+size_t
+PeakBuffer::GetSize() const
+{
+	size_t size = 0;
+	if (normal_buffer != nullptr)
+		size += normal_buffer->Read().size;
+	if (peak_buffer != nullptr)
+		size += peak_buffer->Read().size;
+	return size;
+}
+
 WritableBuffer<void>
 PeakBuffer::Read() const
 {
@@ -56,18 +101,51 @@ PeakBuffer::Read() const
 	return nullptr;
 }
 
+unsigned
+PeakBuffer::Read(WritableBuffer<void> segments[2]) const
+{
+	unsigned n = 0;
+
+	if (normal_buffer != nullptr) {
+		const auto p = normal_buffer->Read();
+		if (!p.IsEmpty())
+			segments[n++] = p.ToVoid();
+	}
+
+	if (peak_buffer != nullptr) {
+		const auto p = peak_buffer->Read();
+		if (!p.IsEmpty())
+			segments[n++] = p.ToVoid();
+	}
+
+	return n;
+}
+
 void
 PeakBuffer::Consume(size_t length)
 {
 	if (normal_buffer != nullptr && !normal_buffer->IsEmpty()) {
-		normal_buffer->Consume(length);
-		return;
+		const size_t available = normal_buffer->Read().size;
+		if (length < available) {
+			normal_buffer->Consume(length);
+			return;
+		}
+
+		/* the normal buffer has been drained; give it back
+		   instead of keeping it around while the owner is
+		   idle */
+		DeleteBuffer(normal_buffer, normal_size);
+		normal_buffer = nullptr;
+		length -= available;
+
+		if (length == 0)
+			return;
 	}
 
 	if (peak_buffer != nullptr && !peak_buffer->IsEmpty()) {
 		peak_buffer->Consume(length);
 		if (peak_buffer->IsEmpty()) {
-			delete peak_buffer;
+			DeleteBuffer(peak_buffer, peak_size);
 			peak_buffer = nullptr;
 		}
 
@@ -75,6 +153,46 @@ PeakBuffer::Consume(size_t length)
 	}
 }
 
+DynamicFifoBuffer<uint8_t> *
+PeakBuffer::GetWriteBuffer()
+{
+	if (peak_buffer != nullptr && !peak_buffer->IsEmpty())
+		return peak_buffer;
+
+	if (normal_buffer == nullptr)
+		normal_buffer = NewBuffer(normal_size);
+
+	if (!normal_buffer->Write().IsEmpty())
+		return normal_buffer;
+
+	if (peak_buffer == nullptr)
+		AllocatePeak();
+
+	return peak_buffer;
+}
+
+WritableBuffer<void>
+PeakBuffer::Write()
+{
+	auto *buffer = GetWriteBuffer();
+	if (buffer == nullptr)
+		return nullptr;
+
+	return buffer->Write().ToVoid();
+}
+
+void
+PeakBuffer::Append(size_t length)
+{
+	if (length == 0)
+		return;
+
+	auto *buffer = GetWriteBuffer();
+	assert(buffer != nullptr);
+
+	buffer->Append(length);
+}
+
 static size_t
 AppendTo(DynamicFifoBuffer<uint8_t> &buffer, const void *data, size_t length)
 {
@@ -100,35 +218,36 @@ AppendTo(DynamicFifoBuffer<uint8_t> &buffer, const void *data, size_t length)
 	return total;
 }
 
-bool
-PeakBuffer::Append(const void *data, size_t length)
+size_t
+PeakBuffer::AppendSome(const void *data, size_t length)
 {
 	if (length == 0)
-		return true;
+		return 0;
 
-	if (peak_buffer != nullptr && !peak_buffer->IsEmpty()) {
-		size_t nbytes = AppendTo(*peak_buffer, data, length);
-		return nbytes == length;
-	}
+	if (peak_buffer != nullptr && !peak_buffer->IsEmpty())
+		return AppendTo(*peak_buffer, data, length);
 
 	if (normal_buffer == nullptr)
-		normal_buffer = new DynamicFifoBuffer<uint8_t>(normal_size);
+		normal_buffer = NewBuffer(normal_size);
 
-	size_t nbytes = AppendTo(*normal_buffer, data, length);
-	if (nbytes > 0) {
-		data = (const uint8_t *)data + nbytes;
-		length -= nbytes;
-		if (length == 0)
-			return true;
-	}
+	size_t total = AppendTo(*normal_buffer, data, length);
+	if (total == length)
+		return total;
+
+	data = (const uint8_t *)data + total;
+	length -= total;
 
 	if (peak_buffer == nullptr) {
-		if (peak_size > 0)
-			peak_buffer = new DynamicFifoBuffer<uint8_t>(peak_size);
+		AllocatePeak();
 		if (peak_buffer == nullptr)
-			return false;
+			return total;
 	}
 
-	nbytes = AppendTo(*peak_buffer, data, length);
-	return nbytes == length;
+	return total + AppendTo(*peak_buffer, data, length);
+}
+
+bool
+PeakBuffer::Append(const void *data, size_t length)
+{
+	return AppendSome(data, length) == length;
 }
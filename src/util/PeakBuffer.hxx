@@ -28,26 +28,55 @@
 
 template<typename T> struct WritableBuffer;
 template<typename T> class DynamicFifoBuffer;
+class MemoryAccount;
 
 /**
  * A FIFO-like buffer that will allocate more memory on demand to
  * allow large peaks.  This second buffer will be given back to the
- * kernel when it has been consumed.
+ * kernel when it has been consumed.  The normal buffer is allocated
+ * on the first write and freed as soon as it is empty, so an idle
+ * owner does not hold any memory.
  */
 class PeakBuffer {
 	size_t normal_size, peak_size;
 
 	DynamicFifoBuffer<uint8_t> *normal_buffer, *peak_buffer;
 
+	/**
+	 * If not nullptr, the buffer allocations are reported to this
+	 * account, and the peak buffer is not allocated if that would
+	 * exceed its budget.
+	 */
+	MemoryAccount *account;
+
+	DynamicFifoBuffer<uint8_t> *NewBuffer(size_t size);
+	void DeleteBuffer(DynamicFifoBuffer<uint8_t> *buffer, size_t size);
+
+	/**
+	 * Allocate #peak_buffer unless that is disabled or the
+	 * account's budget is exhausted.
+	 */
+	void AllocatePeak();
+
+	/**
+	 * Determine the buffer which receives appended data,
+	 * allocating it if necessary.  Returns nullptr if there is no
+	 * room left.
+	 */
+	DynamicFifoBuffer<uint8_t> *GetWriteBuffer();
+
 public:
-	PeakBuffer(size_t _normal_size, size_t _peak_size)
+	PeakBuffer(size_t _normal_size, size_t _peak_size,
+		   MemoryAccount *_account=nullptr)
 		:normal_size(_normal_size), peak_size(_peak_size),
-		 normal_buffer(nullptr), peak_buffer(nullptr) {}
+		 normal_buffer(nullptr), peak_buffer(nullptr),
+		 account(_account) {}
 
 	PeakBuffer(PeakBuffer &&other)
 		:normal_size(other.normal_size), peak_size(other.peak_size),
 		 normal_buffer(other.normal_buffer),
-		 peak_buffer(other.peak_buffer) {
+		 peak_buffer(other.peak_buffer),
+		 account(other.account) {
 		other.normal_buffer = nullptr;
 		other.peak_buffer = nullptr;
 	}
@@ -60,11 +89,55 @@ public:
 	gcc_pure
 	bool IsEmpty() const;
 
+	/**
+	 * Returns the number of bytes in the buffer.
+	 */
+	gcc_pure
+	size_t GetSize() const;
+
+	size_t GetNormalSize() const {
+		return normal_size;
+	}
+
 	gcc_pure
 	WritableBuffer<void> Read() const;
 
+	/**
+	 * Returns all data in the buffer, which may be up to two
+	 * segments, in the order they were appended.
+	 *
+	 * @return the number of segments (0 if the buffer is empty)
+	 */
+	gcc_pure
+	unsigned Read(WritableBuffer<void> segments[2]) const;
+
+	/**
+	 * Remove data from the beginning of the buffer.  The length
+	 * may span both segments returned by Read().
+	 */
 	void Consume(size_t length);
 
+	/**
+	 * Prepare appending data in place.  Returns the free space at
+	 * the end of the buffer which receives new data; it may be
+	 * empty if the buffer is full.  Call Append(size_t) after
+	 * writing to it.
+	 */
+	WritableBuffer<void> Write();
+
+	/**
+	 * Commit data which was written to the buffer returned by
+	 * Write().
+	 */
+	void Append(size_t length);
+
+	/**
+	 * Append as much of the given data as fits.
+	 *
+	 * @return the number of bytes which were appended
+	 */
+	size_t AppendSome(const void *data, size_t length);
+
 	bool Append(const void *data, size_t length);
 };
 
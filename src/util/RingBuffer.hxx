@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RING_BUFFER_HXX
+#define MPD_RING_BUFFER_HXX
+
+#include "WritableBuffer.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+#include <algorithm>
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * A lock-free first-in-first-out buffer with a fixed capacity which
+ * is allocated by the constructor.  Exactly one thread may write
+ * (Write(), Append()) and exactly one other thread may read (Read(),
+ * Consume()) at the same time; neither side ever blocks or allocates
+ * memory, which makes it suitable for realtime callbacks.
+ */
+template<typename T>
+class RingBuffer {
+public:
+	typedef WritableBuffer<T> Range;
+
+private:
+	/**
+	 * One slot is always kept free to distinguish a full buffer
+	 * from an empty one.
+	 */
+	const size_t n_slots;
+
+	T *const data;
+
+	/**
+	 * The index of the next item to be read; only modified by the
+	 * consumer.
+	 */
+	std::atomic<size_t> read_index;
+
+	/**
+	 * The index of the next item to be written; only modified by
+	 * the producer.
+	 */
+	std::atomic<size_t> write_index;
+
+public:
+	explicit RingBuffer(size_t capacity)
+		:n_slots(capacity + 1), data(new T[n_slots]),
+		 read_index(0), write_index(0) {}
+
+	~RingBuffer() {
+		delete[] data;
+	}
+
+	RingBuffer(const RingBuffer &) = delete;
+	RingBuffer &operator=(const RingBuffer &) = delete;
+
+	size_t GetCapacity() const {
+		return n_slots - 1;
+	}
+
+	/**
+	 * Discard all data.  Neither the producer nor the consumer
+	 * may access the buffer concurrently.
+	 */
+	void Clear() {
+		read_index.store(0, std::memory_order_relaxed);
+		write_index.store(0, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the number of items which can be read.  Safe to be
+	 * called by either side, but the value may be outdated by
+	 * the time the caller uses it.
+	 */
+	gcc_pure
+	size_t GetAvailable() const {
+		const size_t w = write_index.load(std::memory_order_acquire);
+		const size_t r = read_index.load(std::memory_order_acquire);
+		return w >= r ? w - r : n_slots - r + w;
+	}
+
+	gcc_pure
+	size_t GetSpace() const {
+		return GetCapacity() - GetAvailable();
+	}
+
+	/**
+	 * Producer: returns the contiguous free area at the write
+	 * position.  The buffer may have more free space after the
+	 * wraparound; call this method again after Append().
+	 */
+	Range Write() {
+		const size_t w = write_index.load(std::memory_order_relaxed);
+		const size_t r = read_index.load(std::memory_order_acquire);
+
+		size_t end;
+		if (r > w)
+			end = r - 1;
+		else if (r == 0)
+			end = n_slots - 1;
+		else
+			end = n_slots;
+
+		return Range(data + w, end - w);
+	}
+
+	/**
+	 * Producer: expose the given number of items (written into
+	 * the area returned by Write()) to the consumer.
+	 */
+	void Append(size_t n) {
+		size_t w = write_index.load(std::memory_order_relaxed);
+		assert(n <= Write().size);
+
+		w += n;
+		if (w == n_slots)
+			w = 0;
+
+		write_index.store(w, std::memory_order_release);
+	}
+
+	/**
+	 * Producer: copy as many items as possible into the buffer.
+	 *
+	 * @return the number of items copied
+	 */
+	size_t Push(const T *src, size_t n) {
+		size_t result = 0;
+
+		while (n > 0) {
+			auto dest = Write();
+			if (dest.IsEmpty())
+				break;
+
+			if (dest.size > n)
+				dest.size = n;
+
+			std::copy(src, src + dest.size, dest.data);
+			Append(dest.size);
+
+			src += dest.size;
+			n -= dest.size;
+			result += dest.size;
+		}
+
+		return result;
+	}
+
+	/**
+	 * Consumer: returns the contiguous readable area at the read
+	 * position.  More data may be available after the
+	 * wraparound; call this method again after Consume().
+	 */
+	Range Read() {
+		const size_t r = read_index.load(std::memory_order_relaxed);
+		const size_t w = write_index.load(std::memory_order_acquire);
+
+		return Range(data + r, (w >= r ? w : n_slots) - r);
+	}
+
+	/**
+	 * Consumer: mark the given number of items (obtained by
+	 * Read()) as consumed, freeing their space for the producer.
+	 */
+	void Consume(size_t n) {
+		size_t r = read_index.load(std::memory_order_relaxed);
+		assert(n <= Read().size);
+
+		r += n;
+		if (r == n_slots)
+			r = 0;
+
+		read_index.store(r, std::memory_order_release);
+	}
+
+	/**
+	 * Consumer: move as many items as possible out of the
+	 * buffer.
+	 *
+	 * @return the number of items copied
+	 */
+	size_t Pop(T *dest, size_t n) {
+		size_t result = 0;
+
+		while (n > 0) {
+			auto src = Read();
+			if (src.IsEmpty())
+				break;
+
+			if (src.size > n)
+				src.size = n;
+
+			std::copy(src.data, src.data + src.size, dest);
+			Consume(src.size);
+
+			dest += src.size;
+			n -= src.size;
+			result += src.size;
+		}
+
+		return result;
+	}
+};
+
+#endif
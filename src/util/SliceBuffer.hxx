@@ -28,10 +28,14 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * This class pre-allocates a certain number of objects, and allows
  * callers to allocate and free these objects ("slices").
+ *
+ * The slice size may be specified at runtime, which allows storing
+ * objects with a variable-size last attribute (see VarSize.hxx).
  */
 template<typename T>
 class SliceBuffer {
@@ -46,6 +50,12 @@ class SliceBuffer {
 	 */
 	const unsigned n_max;
 
+	/**
+	 * The size of each slice in bytes, rounded up to the
+	 * alignment of #T.
+	 */
+	const size_t slice_size;
+
 	/**
 	 * The number of slices that are initialized.  This is used to
 	 * avoid page faulting on the new allocation, so the kernel
@@ -58,21 +68,35 @@ class SliceBuffer {
 	 */
 	unsigned n_allocated;
 
-	Slice *const data;
+	uint8_t *const data;
 
 	/**
 	 * Pointer to the first free element in the chain.
 	 */
 	Slice *available;
 
+	static constexpr size_t AlignSliceSize(size_t size) {
+		return ((size < sizeof(Slice *) ? sizeof(Slice *) : size)
+			+ alignof(Slice) - 1) & ~(alignof(Slice) - 1);
+	}
+
 	size_t CalcAllocationSize() const {
-		return n_max * sizeof(Slice);
+		return n_max * slice_size;
+	}
+
+	Slice *At(unsigned i) {
+		return reinterpret_cast<Slice *>(data + i * slice_size);
 	}
 
 public:
-	SliceBuffer(unsigned _count)
-		:n_max(_count), n_initialized(0), n_allocated(0),
-		 data((Slice *)HugeAllocate(CalcAllocationSize())),
+	/**
+	 * @param _slice_size the size of each slice; may be smaller
+	 * than sizeof(T) if #T has a variable-size last attribute
+	 */
+	SliceBuffer(unsigned _count, size_t _slice_size=sizeof(T))
+		:n_max(_count), slice_size(AlignSliceSize(_slice_size)),
+		 n_initialized(0), n_allocated(0),
+		 data((uint8_t *)HugeAllocate(CalcAllocationSize())),
 		 available(nullptr) {
 		assert(n_max > 0);
 	}
@@ -99,6 +123,14 @@ public:
 		return n_max;
 	}
 
+	size_t GetSliceSize() const {
+		return slice_size;
+	}
+
+	unsigned GetAllocatedCount() const {
+		return n_allocated;
+	}
+
 	bool IsEmpty() const {
 		return n_allocated == 0;
 	}
@@ -119,7 +151,7 @@ public:
 				return nullptr;
 			}
 
-			available = &data[n_initialized++];
+			available = At(n_initialized++);
 			available->next = nullptr;
 		}
 
@@ -138,7 +170,9 @@ public:
 		assert(n_allocated <= n_initialized);
 
 		Slice *slice = reinterpret_cast<Slice *>(value);
-		assert(slice >= data && slice < data + n_max);
+		assert((uint8_t *)slice >= data &&
+		       (uint8_t *)slice < data + CalcAllocationSize());
+		assert(((uint8_t *)slice - data) % slice_size == 0);
 
 		/* destruct the object */
 		value->~T();
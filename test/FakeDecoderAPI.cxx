@@ -22,6 +22,7 @@
 #include "decoder/DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
+#include "util/WritableBuffer.hxx"
 #include "Compiler.h"
 
 #include <unistd.h>
@@ -29,7 +30,7 @@
 void
 decoder_initialized(Decoder &decoder,
 		    const AudioFormat audio_format,
-		    gcc_unused bool seekable,
+		    bool seekable,
 		    float duration)
 {
 	struct audio_format_string af_string;
@@ -37,33 +38,52 @@ decoder_initialized(Decoder &decoder,
 	assert(!decoder.initialized);
 	assert(audio_format.IsValid());
 
-	fprintf(stderr, "audio_format=%s duration=%f\n",
-		audio_format_to_string(audio_format, &af_string),
-		duration);
+	if (!decoder.quiet)
+		fprintf(stderr, "audio_format=%s duration=%f\n",
+			audio_format_to_string(audio_format, &af_string),
+			duration);
 
 	decoder.initialized = true;
+	decoder.audio_format = audio_format;
+	decoder.seekable = seekable;
+	decoder.duration = duration;
 }
 
 DecoderCommand
-decoder_get_command(gcc_unused Decoder &decoder)
+decoder_get_command(Decoder &decoder)
 {
-	return DecoderCommand::NONE;
+	return decoder.command;
 }
 
 void
-decoder_command_finished(gcc_unused Decoder &decoder)
+decoder_command_finished(Decoder &decoder)
 {
+	assert(decoder.command != DecoderCommand::NONE);
+
+	decoder.command = DecoderCommand::NONE;
+
+	if (decoder.listener != nullptr)
+		decoder.listener(decoder, true);
 }
 
 double
-decoder_seek_where(gcc_unused Decoder &decoder)
+decoder_seek_where(Decoder &decoder)
 {
-	return 1.0;
+	assert(decoder.command == DecoderCommand::SEEK);
+
+	return decoder.seek_where;
 }
 
 void
-decoder_seek_error(gcc_unused Decoder &decoder)
+decoder_seek_error(Decoder &decoder)
 {
+	assert(decoder.command == DecoderCommand::SEEK);
+
+	decoder.command = DecoderCommand::NONE;
+	decoder.seek_error = true;
+
+	if (decoder.listener != nullptr)
+		decoder.listener(decoder, true);
 }
 
 InputStream *
@@ -80,6 +100,15 @@ decoder_read(gcc_unused Decoder *decoder,
 	return is.LockRead(buffer, length, IgnoreError());
 }
 
+ConstBuffer<void>
+decoder_read_direct(gcc_unused Decoder &decoder,
+		    gcc_unused InputStream &is,
+		    gcc_unused size_t length)
+{
+	/* no direct reads; the decoder falls back to decoder_read() */
+	return nullptr;
+}
+
 bool
 decoder_read_full(Decoder *decoder, InputStream &is,
 		  void *_buffer, size_t size)
@@ -121,13 +150,38 @@ decoder_timestamp(gcc_unused Decoder &decoder,
 }
 
 DecoderCommand
-decoder_data(gcc_unused Decoder &decoder,
+decoder_data(Decoder &decoder,
 	     gcc_unused InputStream *is,
 	     const void *data, size_t datalen,
 	     gcc_unused uint16_t kbit_rate)
 {
-	gcc_unused ssize_t nbytes = write(1, data, datalen);
-	return DecoderCommand::NONE;
+	decoder.pcm_bytes += datalen;
+
+	if (!decoder.quiet) {
+		gcc_unused ssize_t nbytes = write(1, data, datalen);
+	}
+
+	if (decoder.listener != nullptr)
+		decoder.listener(decoder, false);
+
+	return decoder.command;
+}
+
+WritableBuffer<void>
+decoder_get_buffer(gcc_unused Decoder &decoder,
+		   gcc_unused uint16_t kbit_rate)
+{
+	/* let the plugin use decoder_data() */
+	return WritableBuffer<void>::Null();
+}
+
+DecoderCommand
+decoder_commit_data(gcc_unused Decoder &decoder,
+		    gcc_unused InputStream *is,
+		    gcc_unused size_t length)
+{
+	assert(false);
+	gcc_unreachable();
 }
 
 DecoderCommand
@@ -139,9 +193,12 @@ decoder_tag(gcc_unused Decoder &decoder,
 }
 
 void
-decoder_replay_gain(gcc_unused Decoder &decoder,
+decoder_replay_gain(Decoder &decoder,
 		    const ReplayGainInfo *rgi)
 {
+	if (decoder.quiet || rgi == nullptr)
+		return;
+
 	const ReplayGainTuple *tuple = &rgi->tuples[REPLAY_GAIN_ALBUM];
 	if (tuple->IsDefined())
 		fprintf(stderr, "replay_gain[album]: gain=%f peak=%f\n",
@@ -157,3 +214,16 @@ void
 decoder_mixramp(gcc_unused Decoder &decoder, gcc_unused MixRampInfo &&mix_ramp)
 {
 }
+
+void
+decoder_keep_state(gcc_unused Decoder &decoder, DecoderReusableState *state)
+{
+	delete state;
+}
+
+DecoderReusableState *
+decoder_take_state(gcc_unused Decoder &decoder,
+		   gcc_unused const DecoderPlugin &plugin)
+{
+	return nullptr;
+}
@@ -23,6 +23,10 @@
 #include "check.h"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
+#include "decoder/DecoderCommand.hxx"
+#include "AudioFormat.hxx"
+
+#include <stdint.h>
 
 struct Decoder {
 	Mutex mutex;
@@ -30,8 +34,48 @@ struct Decoder {
 
 	bool initialized;
 
+	/**
+	 * If true, then PCM data is discarded instead of being
+	 * written to stdout, and nothing is printed on stderr.
+	 */
+	bool quiet;
+
+	AudioFormat audio_format;
+	bool seekable;
+	float duration;
+
+	/**
+	 * The number of PCM bytes submitted by the plugin.
+	 */
+	uint64_t pcm_bytes;
+
+	/**
+	 * The command returned to the plugin; may be modified by the
+	 * #listener.
+	 */
+	DecoderCommand command;
+	double seek_where;
+
+	/**
+	 * Set by decoder_seek_error(); may be cleared by the
+	 * #listener.
+	 */
+	bool seek_error;
+
+	/**
+	 * An optional callback which is invoked after each PCM chunk
+	 * and after a command has finished (or a seek has failed).
+	 */
+	void (*listener)(Decoder &decoder, bool command_finished);
+
 	Decoder()
-		:initialized(false) {}
+		:initialized(false), quiet(false),
+		 audio_format(AudioFormat::Undefined()),
+		 seekable(false), duration(0),
+		 pcm_bytes(0),
+		 command(DecoderCommand::NONE), seek_where(0),
+		 seek_error(false),
+		 listener(nullptr) {}
 };
 
 #endif
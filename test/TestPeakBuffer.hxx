@@ -0,0 +1,54 @@
+/*
+ * Unit tests for class PeakBuffer.
+ */
+
+#include "config.h"
+#include "util/PeakBuffer.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+
+class TestPeakBuffer : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestPeakBuffer);
+	CPPUNIT_TEST(TestSegments);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSegments() {
+		PeakBuffer buffer(4, 8);
+		WritableBuffer<void> segments[2];
+
+		CPPUNIT_ASSERT(buffer.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(0u, buffer.Read(segments));
+
+		/* fills the normal buffer, then overflows into the
+		   peak buffer */
+		CPPUNIT_ASSERT(buffer.Append("abcdefg", 7));
+		CPPUNIT_ASSERT_EQUAL(2u, buffer.Read(segments));
+		CPPUNIT_ASSERT_EQUAL(size_t(4), segments[0].size);
+		CPPUNIT_ASSERT(memcmp(segments[0].data, "abcd", 4) == 0);
+		CPPUNIT_ASSERT_EQUAL(size_t(3), segments[1].size);
+		CPPUNIT_ASSERT(memcmp(segments[1].data, "efg", 3) == 0);
+
+		/* consume across the segment boundary */
+		buffer.Consume(5);
+		CPPUNIT_ASSERT_EQUAL(1u, buffer.Read(segments));
+		CPPUNIT_ASSERT_EQUAL(size_t(2), segments[0].size);
+		CPPUNIT_ASSERT(memcmp(segments[0].data, "fg", 2) == 0);
+
+		/* new data goes behind the peak buffer, to keep the
+		   order */
+		CPPUNIT_ASSERT(buffer.Append("h", 1));
+		CPPUNIT_ASSERT_EQUAL(1u, buffer.Read(segments));
+		CPPUNIT_ASSERT_EQUAL(size_t(3), segments[0].size);
+		CPPUNIT_ASSERT(memcmp(segments[0].data, "fgh", 3) == 0);
+
+		buffer.Consume(3);
+		CPPUNIT_ASSERT(buffer.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(0u, buffer.Read(segments));
+	}
+};
@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program generates synthetic databases and measures the
+ * performance of the "simple" database plugin with them.
+ *
+ *   bench_db generate FILE [--songs N] [--artists N] [--albums N]
+ *                          [--genres N] [--dates N]
+ *
+ * writes a text database with N songs in ARTIST/ALBUM directories,
+ * and
+ *
+ *   bench_db run FILE [--iterations N] [--save [--binary]]
+ *
+ * loads it and times typical queries ("find", "search", "list",
+ * "count").  Each result is printed as a tab-separated line:
+ *
+ *   NAME<TAB>MILLISECONDS<TAB>RESULTS
+ *
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/Selection.hxx"
+#include "db/LightSong.hxx"
+#include "db/Stats.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigData.hxx"
+#include "tag/TagConfig.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Tag.hxx"
+#include "DetachedSong.hxx"
+#include "SongSave.hxx"
+#include "SongFilter.hxx"
+#include "event/Loop.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+
+#include <functional>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBUPNP
+#include "input/InputStream.hxx"
+size_t
+InputStream::LockRead(void *, size_t, Error &)
+{
+	return 0;
+}
+#endif
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	virtual void OnDatabaseModified() override {}
+	virtual void OnDatabaseSongRemoved(const LightSong &) override {}
+};
+
+struct GeneratorOptions {
+	unsigned songs = 100000;
+	unsigned artists = 5000;
+
+	/**
+	 * Albums per artist.
+	 */
+	unsigned albums = 3;
+
+	unsigned genres = 50;
+	unsigned dates = 70;
+};
+
+static bool
+ParseUnsignedOption(int &i, int argc, char **argv, const char *name,
+		    unsigned &value)
+{
+	if (strcmp(argv[i], name) != 0 || i + 1 >= argc)
+		return false;
+
+	value = strtoul(argv[++i], nullptr, 10);
+	return true;
+}
+
+/**
+ * Resident memory of this process in kilobytes.
+ */
+static long
+GetResidentKB()
+{
+#ifdef __linux__
+	FILE *file = fopen("/proc/self/statm", "r");
+	if (file != nullptr) {
+		long size, resident;
+		const bool ok = fscanf(file, "%ld %ld", &size, &resident) == 2;
+		fclose(file);
+		if (ok)
+			return resident * (sysconf(_SC_PAGESIZE) / 1024);
+	}
+#endif
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+static void
+GenerateSong(FILE *file, unsigned n, unsigned track,
+	     const char *artist, const char *album,
+	     const GeneratorOptions &options)
+{
+	char buffer[64];
+
+	TagBuilder tag;
+	tag.SetTime(120 + n % 360);
+	tag.AddItem(TAG_ARTIST, artist);
+	tag.AddItem(TAG_ALBUM, album);
+
+	snprintf(buffer, sizeof(buffer), "Title %u", n);
+	tag.AddItem(TAG_TITLE, buffer);
+
+	snprintf(buffer, sizeof(buffer), "%u", track);
+	tag.AddItem(TAG_TRACK, buffer);
+
+	snprintf(buffer, sizeof(buffer), "Genre %u", n % options.genres);
+	tag.AddItem(TAG_GENRE, buffer);
+
+	snprintf(buffer, sizeof(buffer), "%u", 1950 + n % options.dates);
+	tag.AddItem(TAG_DATE, buffer);
+
+	snprintf(buffer, sizeof(buffer), "%02u - Title %u.flac", track, n);
+	DetachedSong song(buffer, tag.Commit());
+	song_save(file, song);
+}
+
+static int
+Generate(const char *path, const GeneratorOptions &options)
+{
+	FILE *file = fopen(path, "w");
+	if (file == nullptr) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+
+	db_save_header(file);
+
+	const unsigned n_albums = options.artists * options.albums;
+	const unsigned songs_per_album =
+		(options.songs + n_albums - 1) / n_albums;
+
+	unsigned n = 0;
+	for (unsigned a = 0; a < options.artists && n < options.songs; ++a) {
+		char artist[32], artist_path[64];
+		snprintf(artist, sizeof(artist), "Artist %u", a);
+		snprintf(artist_path, sizeof(artist_path), "artist%u", a);
+
+		fprintf(file, "directory: %s\nmtime: 1\nbegin: %s\n",
+			artist_path, artist_path);
+
+		for (unsigned b = 0; b < options.albums && n < options.songs;
+		     ++b) {
+			char album[32], album_name[32], album_path[128];
+			snprintf(album, sizeof(album), "Album %u",
+				 a * options.albums + b);
+			snprintf(album_name, sizeof(album_name), "album%u", b);
+			snprintf(album_path, sizeof(album_path), "%s/%s",
+				 artist_path, album_name);
+
+			fprintf(file, "directory: %s\nmtime: 1\nbegin: %s\n",
+				album_name, album_path);
+
+			for (unsigned t = 1;
+			     t <= songs_per_album && n < options.songs;
+			     ++t, ++n)
+				GenerateSong(file, n, t, artist, album,
+					     options);
+
+			fprintf(file, "end: %s\n", album_path);
+		}
+
+		fprintf(file, "end: %s\n", artist_path);
+	}
+
+	if (fclose(file) != 0) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "%u songs written to %s\n", n, path);
+	return EXIT_SUCCESS;
+}
+
+static unsigned bench_iterations = 5;
+
+/**
+ * Run the function #bench_iterations times and print the average
+ * duration.  The function returns the number of results.
+ */
+static bool
+Bench(const char *name, std::function<bool(unsigned &)> f)
+{
+	unsigned n_results = 0;
+	const uint64_t start = MonotonicClockUS();
+	for (unsigned i = 0; i < bench_iterations; ++i) {
+		n_results = 0;
+		if (!f(n_results))
+			return false;
+	}
+
+	const uint64_t elapsed = MonotonicClockUS() - start;
+	printf("%s\t%.3f\t%u\n", name,
+	       elapsed / 1000. / bench_iterations, n_results);
+	fflush(stdout);
+	return true;
+}
+
+static bool
+BenchVisit(const Database &db, const char *name, const SongFilter *filter,
+	   Error &error)
+{
+	const DatabaseSelection selection("", true, filter);
+	return Bench(name, [&](unsigned &n){
+			return db.Visit(selection, VisitDirectory(),
+					[&n](const LightSong &, Error &){
+						++n;
+						return true;
+					},
+					VisitPlaylist(), error);
+		});
+}
+
+static bool
+BenchList(const Database &db, const char *name, TagType type,
+	  uint32_t group_mask, const SongFilter *filter, Error &error)
+{
+	const DatabaseSelection selection("", true, filter);
+	return Bench(name, [&](unsigned &n){
+			return db.VisitUniqueTags(selection, type, group_mask,
+						  [&n](const Tag &, Error &){
+							  ++n;
+							  return true;
+						  },
+						  error);
+		});
+}
+
+static bool
+BenchCount(const Database &db, const char *name, const SongFilter *filter,
+	   Error &error)
+{
+	const DatabaseSelection selection("", true, filter);
+	return Bench(name, [&](unsigned &n){
+			DatabaseStats stats;
+			if (!db.GetStats(selection, stats, error))
+				return false;
+
+			n = stats.song_count;
+			return true;
+		});
+}
+
+static bool
+RunQueries(const Database &db, Error &error)
+{
+	const SongFilter artist(TAG_ARTIST, "Artist 17");
+	const SongFilter album(TAG_ALBUM, "Album 42");
+	const SongFilter genre(TAG_GENRE, "Genre 7");
+	const SongFilter title_search(TAG_TITLE, "title 123", true);
+	const SongFilter any_search(LOCATE_TAG_ANY_TYPE, "artist 1",
+				    true);
+
+	return BenchVisit(db, "listall", nullptr, error) &&
+		BenchVisit(db, "find_artist", &artist, error) &&
+		BenchVisit(db, "find_album", &album, error) &&
+		BenchVisit(db, "find_genre", &genre, error) &&
+		BenchVisit(db, "search_title", &title_search, error) &&
+		BenchVisit(db, "search_any", &any_search, error) &&
+		BenchList(db, "list_artist", TAG_ARTIST, 0, nullptr, error) &&
+		BenchList(db, "list_album", TAG_ALBUM, 0, nullptr, error) &&
+		BenchList(db, "list_album_group_artist", TAG_ALBUM,
+			  1u << TAG_ARTIST, nullptr, error) &&
+		BenchList(db, "list_album_artist", TAG_ALBUM, 0, &artist,
+			  error) &&
+		BenchCount(db, "count_all", nullptr, error) &&
+		BenchCount(db, "count_artist", &artist, error) &&
+		BenchCount(db, "count_genre", &genre, error);
+}
+
+static int
+Run(const char *path, bool save, bool binary)
+{
+	EventLoop event_loop;
+	NullDatabaseListener listener;
+
+	/* the plugin wants an absolute path */
+	std::string absolute_path(path);
+	if (*path != '/') {
+		char cwd[4096];
+		if (getcwd(cwd, sizeof(cwd)) == nullptr) {
+			perror("getcwd");
+			return EXIT_FAILURE;
+		}
+
+		absolute_path = std::string(cwd) + "/" + path;
+	}
+
+	config_param param("database");
+	param.AddBlockParam("path", absolute_path.c_str());
+	if (binary)
+		param.AddBlockParam("format", "binary");
+
+	Error error;
+	Database *db = SimpleDatabase::Create(event_loop, listener,
+					      param, error);
+	if (db == nullptr) {
+		fprintf(stderr, "%s\n", error.GetMessage());
+		return EXIT_FAILURE;
+	}
+
+	const long rss_before = GetResidentKB();
+	const uint64_t start = MonotonicClockUS();
+	if (!db->Open(error)) {
+		delete db;
+		fprintf(stderr, "%s\n", error.GetMessage());
+		return EXIT_FAILURE;
+	}
+
+	printf("load\t%.3f\t%ld\n", (MonotonicClockUS() - start) / 1000.,
+	       GetResidentKB() - rss_before);
+
+	bool success = RunQueries(*db, error);
+
+	if (success && save) {
+		const uint64_t save_start = MonotonicClockUS();
+		success = ((SimpleDatabase *)db)->Save(error);
+		if (success)
+			printf("%s\t%.3f\t0\n",
+			       binary ? "save_binary" : "save",
+			       (MonotonicClockUS() - save_start) / 1000.);
+	}
+
+	db->Close();
+	delete db;
+
+	if (!success) {
+		fprintf(stderr, "%s\n", error.GetMessage());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: bench_db generate FILE [--songs N] [--artists N] "
+		"[--albums N] [--genres N] [--dates N]\n"
+		"       bench_db run FILE [--iterations N] "
+		"[--save [--binary]]\n");
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	const char *const command = argv[1];
+	const char *const path = argv[2];
+
+	config_global_init();
+	TagLoadConfig();
+
+	int result;
+	if (strcmp(command, "generate") == 0) {
+		GeneratorOptions options;
+
+		for (int i = 3; i < argc; ++i) {
+			if (!ParseUnsignedOption(i, argc, argv, "--songs",
+						 options.songs) &&
+			    !ParseUnsignedOption(i, argc, argv, "--artists",
+						 options.artists) &&
+			    !ParseUnsignedOption(i, argc, argv, "--albums",
+						 options.albums) &&
+			    !ParseUnsignedOption(i, argc, argv, "--genres",
+						 options.genres) &&
+			    !ParseUnsignedOption(i, argc, argv, "--dates",
+						 options.dates)) {
+				Usage();
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (options.songs == 0 || options.artists == 0 ||
+		    options.albums == 0 || options.genres == 0 ||
+		    options.dates == 0) {
+			Usage();
+			return EXIT_FAILURE;
+		}
+
+		result = Generate(path, options);
+	} else if (strcmp(command, "run") == 0) {
+		bool save = false, binary = false;
+
+		for (int i = 3; i < argc; ++i) {
+			if (ParseUnsignedOption(i, argc, argv, "--iterations",
+						bench_iterations))
+				continue;
+			else if (strcmp(argv[i], "--save") == 0)
+				save = true;
+			else if (strcmp(argv[i], "--binary") == 0)
+				binary = true;
+			else {
+				Usage();
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (bench_iterations == 0)
+			bench_iterations = 1;
+
+		result = Run(path, save, binary);
+	} else {
+		Usage();
+		result = EXIT_FAILURE;
+	}
+
+	config_global_finish();
+	return result;
+}
@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Decoder throughput benchmark: decodes all files below the given
+ * paths with every enabled plugin which supports the file name
+ * suffix, discarding the PCM output.  Prints one TSV row per file
+ * and plugin, followed by totals per plugin and suffix:
+ *
+ *   bench_decoder [--plugin NAME] [--seeks N] PATH...
+ *
+ * With "--seeks N", each seekable file is decoded a second time,
+ * issuing N seeks to random positions, and the seek latency
+ * (from submitting the command until the plugin acknowledges it) is
+ * reported.
+ *
+ */
+
+#include "config.h"
+#include "IOThread.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "FakeDecoderAPI.hxx"
+#include "input/Init.hxx"
+#include "input/InputStream.hxx"
+#include "fs/Path.hxx"
+#include "util/UriUtil.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef HAVE_GLIB
+#include <glib.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static std::atomic<unsigned long> n_allocations(0);
+
+#ifdef __GLIBC__
+
+/*
+ * Count all heap allocations (including those inside the codec
+ * libraries) by interposing the glibc allocator.
+ *
+ */
+
+extern "C" {
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+void *
+malloc(size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *p, size_t size)
+{
+	n_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, size);
+}
+
+}
+
+#endif
+
+static uint64_t
+NowUS()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * User plus system CPU time of this process [us].
+ */
+static uint64_t
+CpuUS()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return uint64_t(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+		ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+struct Result {
+	unsigned files = 0, failed = 0;
+
+	double audio_s = 0;
+	uint64_t wall_us = 0, cpu_us = 0;
+	unsigned long allocations = 0;
+
+	std::vector<uint64_t> seek_us;
+	unsigned seek_errors = 0;
+
+	void Add(const Result &other) {
+		files += other.files;
+		failed += other.failed;
+		audio_s += other.audio_s;
+		wall_us += other.wall_us;
+		cpu_us += other.cpu_us;
+		allocations += other.allocations;
+		seek_us.insert(seek_us.end(),
+			       other.seek_us.begin(), other.seek_us.end());
+		seek_errors += other.seek_errors;
+	}
+
+	void Print(const char *kind, const char *plugin,
+		   const char *what) {
+		std::sort(seek_us.begin(), seek_us.end());
+
+		const double wall_s = wall_us / 1000000.;
+		printf("%s\t%s\t%s\t%u\t%u\t%.2f\t%.1f\t%.1f\t%.1f\t%lu",
+		       kind, plugin, what, files, failed,
+		       audio_s, wall_us / 1000., cpu_us / 1000.,
+		       wall_s > 0 ? audio_s / wall_s : 0.,
+		       allocations);
+
+		if (seek_us.empty())
+			printf("\t%u\t%u\t-\t-\n",
+			       0u, seek_errors);
+		else
+			printf("\t%zu\t%u\t%llu\t%llu\n",
+			       seek_us.size(), seek_errors,
+			       (unsigned long long)seek_us[seek_us.size() / 2],
+			       (unsigned long long)seek_us.back());
+	}
+};
+
+/**
+ * State of the seek test, manipulated by SeekListener().
+ */
+static struct {
+	unsigned remaining;
+	uint64_t submitted_at;
+	Result *result;
+} seek_test;
+
+static void
+SubmitSeek(Decoder &decoder)
+{
+	decoder.command = DecoderCommand::SEEK;
+	decoder.seek_where = decoder.duration * 0.95 *
+		(double(random()) / RAND_MAX);
+	seek_test.submitted_at = NowUS();
+	--seek_test.remaining;
+}
+
+static void
+SeekListener(Decoder &decoder, bool command_finished)
+{
+	if (command_finished) {
+		if (decoder.seek_error) {
+			decoder.seek_error = false;
+			++seek_test.result->seek_errors;
+		} else if (seek_test.submitted_at != 0)
+			seek_test.result->seek_us.push_back(NowUS() -
+							    seek_test.submitted_at);
+
+		seek_test.submitted_at = 0;
+
+		if (seek_test.remaining == 0)
+			decoder.command = DecoderCommand::STOP;
+
+		return;
+	}
+
+	if (decoder.command == DecoderCommand::NONE) {
+		if (seek_test.remaining > 0)
+			SubmitSeek(decoder);
+		else
+			decoder.command = DecoderCommand::STOP;
+	}
+}
+
+static bool
+Decode(const DecoderPlugin &plugin, Decoder &decoder, const char *path)
+{
+	if (plugin.file_decode != nullptr) {
+		plugin.FileDecode(decoder, Path::FromFS(path));
+	} else if (plugin.stream_decode != nullptr) {
+		Error error;
+		InputStream *is =
+			InputStream::OpenReady(path, decoder.mutex,
+					       decoder.cond, error);
+		if (is == nullptr) {
+			if (error.IsDefined())
+				LogError(error);
+			return false;
+		}
+
+		plugin.StreamDecode(decoder, *is);
+		delete is;
+	} else
+		return false;
+
+	return decoder.initialized;
+}
+
+static Result
+BenchFile(const DecoderPlugin &plugin, const char *path, unsigned n_seeks)
+{
+	Result result;
+	result.files = 1;
+
+	{
+		Decoder decoder;
+		decoder.quiet = true;
+
+		const unsigned long allocations0 = n_allocations.load();
+		const uint64_t cpu0 = CpuUS();
+		const uint64_t t0 = NowUS();
+
+		const bool success = Decode(plugin, decoder, path);
+
+		result.wall_us = NowUS() - t0;
+		result.cpu_us = CpuUS() - cpu0;
+		result.allocations = n_allocations.load() - allocations0;
+
+		if (!success) {
+			result.failed = 1;
+			return result;
+		}
+
+		const size_t frame_size = decoder.audio_format.GetFrameSize();
+		result.audio_s = double(decoder.pcm_bytes / frame_size) /
+			decoder.audio_format.sample_rate;
+
+		if (n_seeks == 0 || !decoder.seekable ||
+		    decoder.duration <= 0)
+			return result;
+	}
+
+	Decoder decoder;
+	decoder.quiet = true;
+	decoder.listener = SeekListener;
+
+	seek_test.remaining = n_seeks;
+	seek_test.submitted_at = 0;
+	seek_test.result = &result;
+
+	Decode(plugin, decoder, path);
+
+	/* a seek which was never acknowledged (the plugin returned
+	   before processing the command) counts as an error */
+	if (seek_test.submitted_at != 0)
+		++result.seek_errors;
+
+	return result;
+}
+
+static void
+CollectFiles(const std::string &path, std::vector<std::string> &files)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) < 0) {
+		perror(path.c_str());
+		return;
+	}
+
+	if (S_ISREG(st.st_mode)) {
+		files.push_back(path);
+		return;
+	}
+
+	if (!S_ISDIR(st.st_mode))
+		return;
+
+	DIR *dir = opendir(path.c_str());
+	if (dir == nullptr) {
+		perror(path.c_str());
+		return;
+	}
+
+	std::vector<std::string> children;
+	const struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr)
+		if (ent->d_name[0] != '.')
+			children.push_back(path + "/" + ent->d_name);
+
+	closedir(dir);
+
+	std::sort(children.begin(), children.end());
+	for (const auto &child : children)
+		CollectFiles(child, files);
+}
+
+int main(int argc, char **argv)
+{
+	const char *plugin_name = nullptr;
+	unsigned n_seeks = 0;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--plugin") == 0 && i + 1 < argc)
+			plugin_name = argv[++i];
+		else if (strcmp(argv[i], "--seeks") == 0 && i + 1 < argc)
+			n_seeks = strtoul(argv[++i], nullptr, 10);
+		else if (argv[i][0] == '-') {
+			fprintf(stderr, "Usage: bench_decoder [--plugin NAME] "
+				"[--seeks N] PATH...\n");
+			return EXIT_FAILURE;
+		} else
+			CollectFiles(argv[i], files);
+	}
+
+	if (files.empty()) {
+		fprintf(stderr, "No input files\n");
+		return EXIT_FAILURE;
+	}
+
+#ifdef HAVE_GLIB
+#if !GLIB_CHECK_VERSION(2,32,0)
+	g_thread_init(NULL);
+#endif
+#endif
+
+	io_thread_init();
+	io_thread_start();
+
+	Error error;
+	if (!input_stream_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	decoder_plugin_init_all();
+
+	const DecoderPlugin *forced = nullptr;
+	if (plugin_name != nullptr) {
+		forced = decoder_plugin_from_name(plugin_name);
+		if (forced == nullptr) {
+			fprintf(stderr, "No such decoder: %s\n", plugin_name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* key: plugin name + '\t' + suffix */
+	std::map<std::string, Result> totals;
+
+	printf("# kind\tplugin\tfile\tfiles\tfailed\taudio_s\twall_ms"
+	       "\tcpu_ms\trealtime\tallocations"
+	       "\tseeks\tseek_errors\tseek_p50_us\tseek_max_us\n");
+
+	for (const auto &path : files) {
+		const char *suffix = uri_get_suffix(path.c_str());
+		if (suffix == nullptr)
+			continue;
+
+		std::string lower(suffix);
+		std::transform(lower.begin(), lower.end(), lower.begin(),
+			       ::tolower);
+
+		auto f = [&](const DecoderPlugin &plugin){
+			if (forced != nullptr && &plugin != forced)
+				return;
+
+			if (!plugin.SupportsSuffix(lower.c_str()))
+				return;
+
+			Result result = BenchFile(plugin, path.c_str(),
+						  n_seeks);
+			result.Print("file", plugin.name, path.c_str());
+			fflush(stdout);
+
+			totals[std::string(plugin.name) + '\t' + lower]
+				.Add(result);
+		};
+
+		decoder_plugins_for_each_enabled(f);
+	}
+
+	for (auto &i : totals) {
+		const size_t tab = i.first.find('\t');
+		const std::string plugin = i.first.substr(0, tab);
+		const std::string suffix = i.first.substr(tab + 1);
+
+		i.second.Print("total", plugin.c_str(), suffix.c_str());
+	}
+
+	decoder_plugin_deinit_all();
+	input_stream_global_finish();
+	io_thread_deinit();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Output pipeline benchmark: feeds a #MusicPipe with synthetic PCM
+ * through real #AudioOutput threads (including their filters,
+ * resampler and encoder as configured in mpd.conf), playing the role
+ * of the player thread.  It prints the distribution of the per-chunk
+ * end-to-end latency (from MusicPipe::Push() until the output has
+ * finished the chunk) and the CPU time of each output thread:
+ *
+ *   bench_output [--format FORMAT] [--duration SECONDS] [--pipe N]
+ *                [--chunk-size BYTES] CONFIG NAME...
+ *
+ * Use the "null" output plugin with "sync" disabled to measure the
+ * maximum throughput; with "sync" enabled, the latency shows how
+ * long chunks wait in the pipe for a given "--pipe" depth (compare
+ * with "buffered_before_play").
+ *
+ */
+
+#include "config.h"
+#include "output/Internal.hxx"
+#include "output/OutputPlugin.hxx"
+#include "config/ConfigData.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "event/Loop.hxx"
+#include "IOThread.hxx"
+#include "fs/Path.hxx"
+#include "AudioParser.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "PlayerControl.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef HAVE_GLIB
+#include <glib.h>
+#endif
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <dirent.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+PlayerControl::PlayerControl(PlayerListener &_listener,
+			     MultipleOutputs &_outputs,
+			     gcc_unused unsigned _buffer_chunks,
+			     gcc_unused size_t _chunk_size,
+			     gcc_unused unsigned _buffered_before_play,
+			     gcc_unused bool _lock_free_pipe,
+			     gcc_unused unsigned _prefetch_time)
+	:listener(_listener), outputs(_outputs) {}
+PlayerControl::~PlayerControl() {}
+
+/*
+ * Only the output threads signal this object; it wakes up our
+ * "player" loop.
+ *
+ */
+static PlayerControl player_control(*(PlayerListener *)nullptr,
+				    *(MultipleOutputs *)nullptr,
+				    32, 4096, 4, false, 0);
+
+struct OutputProbe {
+	AudioOutput *ao;
+
+	std::vector<uint32_t> latencies;
+
+	/**
+	 * The CPU time [us] of the output thread when the benchmark
+	 * started.
+	 */
+	uint64_t cpu_start;
+
+	explicit OutputProbe(AudioOutput *_ao):ao(_ao), cpu_start(0) {}
+
+	uint32_t GetPercentile(double p) const {
+		if (latencies.empty())
+			return 0;
+
+		size_t i = size_t(p * latencies.size());
+		if (i >= latencies.size())
+			i = latencies.size() - 1;
+		return latencies[i];
+	}
+};
+
+struct PendingChunk {
+	const music_chunk *chunk;
+	uint64_t pushed_at;
+
+	/**
+	 * Bit mask of the outputs which have finished this chunk.
+	 */
+	uint64_t consumed;
+};
+
+/**
+ * Determine the CPU time of the output thread by its name
+ * ("output:NAME", truncated by the kernel to 15 characters).
+ *
+ * @return the CPU time in microseconds or 0 if not available
+ */
+static uint64_t
+GetOutputThreadCpuUS(const AudioOutput &ao)
+{
+#ifdef __linux__
+	char expected[16];
+	snprintf(expected, sizeof(expected), "output:%s", ao.name);
+
+	DIR *dir = opendir("/proc/self/task");
+	if (dir == nullptr)
+		return 0;
+
+	uint64_t result = 0;
+	const struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr) {
+		if (ent->d_name[0] == '.')
+			continue;
+
+		const std::string prefix =
+			std::string("/proc/self/task/") + ent->d_name;
+
+		char comm[32];
+		FILE *file = fopen((prefix + "/comm").c_str(), "r");
+		if (file == nullptr)
+			continue;
+
+		const bool match = fgets(comm, sizeof(comm), file) != nullptr &&
+			strncmp(comm, expected, strlen(expected)) == 0;
+		fclose(file);
+		if (!match)
+			continue;
+
+		file = fopen((prefix + "/stat").c_str(), "r");
+		if (file == nullptr)
+			continue;
+
+		char line[1024];
+		if (fgets(line, sizeof(line), file) != nullptr) {
+			/* skip "pid (comm)"; utime and stime are the
+			   12th and 13th fields after it */
+			const char *p = strrchr(line, ')');
+			unsigned long utime, stime;
+			if (p != nullptr &&
+			    sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u"
+				   " %*u %*u %lu %lu", &utime, &stime) == 2)
+				result = uint64_t(utime + stime) * 1000000 /
+					sysconf(_SC_CLK_TCK);
+		}
+
+		fclose(file);
+		break;
+	}
+
+	closedir(dir);
+	return result;
+#else
+	(void)ao;
+	return 0;
+#endif
+}
+
+/**
+ * Has the output finished playing this chunk?  This is a copy of
+ * chunk_is_consumed_in() from MultipleOutputs.cxx, and is only valid
+ * for chunks up to the output's current chunk.  Caller must lock the
+ * output's mutex.
+ */
+static bool
+IsChunkConsumedIn(const AudioOutput &ao, const music_chunk *chunk)
+{
+	if (!ao.open)
+		return true;
+
+	if (ao.current_chunk == nullptr)
+		return false;
+
+	if (chunk != ao.current_chunk)
+		return true;
+
+	return ao.current_chunk_finished && chunk->next == nullptr;
+}
+
+static AudioOutput *
+load_audio_output(EventLoop &event_loop, const char *name)
+{
+	const config_param *param =
+		config_find_block(CONF_AUDIO_OUTPUT, "name", name);
+	if (param == NULL) {
+		fprintf(stderr, "No such configured audio output: %s\n", name);
+		return nullptr;
+	}
+
+	Error error;
+	AudioOutput *ao =
+		audio_output_new(event_loop, *param,
+				 *(MixerListener *)nullptr,
+				 player_control,
+				 error);
+	if (ao == nullptr)
+		LogError(error);
+
+	return ao;
+}
+
+static void
+FillChunk(music_chunk &chunk, AudioFormat audio_format, float data_time)
+{
+	auto w = chunk.Write(audio_format, data_time, 0);
+	assert(!w.IsNull());
+
+	/* any non-silent pattern will do; the filters must not be
+	   able to take shortcuts */
+	uint8_t *p = (uint8_t *)w.data;
+	for (size_t i = 0; i < w.size; ++i)
+		p[i] = uint8_t(i * 37 + 11);
+
+	const size_t frame_size = audio_format.GetFrameSize();
+	chunk.Expand(audio_format, w.size - w.size % frame_size);
+}
+
+/**
+ * Remove all chunks from the head of the pipe which have been
+ * finished by all outputs, and record the latencies.
+ */
+static void
+CheckPipe(std::vector<OutputProbe> &probes, MusicPipe &pipe,
+	  MusicBuffer &buffer, std::deque<PendingChunk> &pending)
+{
+	const uint64_t all = (uint64_t(1) << probes.size()) - 1;
+	const uint64_t now = MonotonicClockUS();
+
+	for (size_t i = 0; i < probes.size(); ++i) {
+		const uint64_t bit = uint64_t(1) << i;
+		AudioOutput &ao = *probes[i].ao;
+
+		/* walk the pipe in order: IsChunkConsumedIn() is only
+		   meaningful up to the output's current chunk */
+		const ScopeLock protect(ao.mutex);
+		for (auto &p : pending) {
+			if (p.consumed & bit)
+				continue;
+
+			if (!IsChunkConsumedIn(ao, p.chunk))
+				break;
+
+			p.consumed |= bit;
+			probes[i].latencies.push_back(uint32_t(now - p.pushed_at));
+		}
+	}
+
+	while (!pending.empty() && pending.front().consumed == all) {
+		const music_chunk *chunk = pending.front().chunk;
+		const bool is_tail = chunk->next == nullptr;
+
+		/* like MultipleOutputs::ClearTailChunk(): don't let the
+		   outputs keep a pointer to a chunk which is about to
+		   be freed */
+		if (is_tail)
+			for (auto &probe : probes)
+				probe.ao->mutex.lock();
+
+		if (is_tail)
+			for (auto &probe : probes)
+				if (probe.ao->current_chunk == chunk)
+					probe.ao->current_chunk = nullptr;
+
+		music_chunk *shifted = pipe.Shift();
+		assert(shifted == chunk);
+
+		if (is_tail)
+			for (auto &probe : probes)
+				probe.ao->mutex.unlock();
+
+		buffer.Return(shifted);
+		pending.pop_front();
+	}
+}
+
+static void
+Usage()
+{
+	fprintf(stderr, "Usage: bench_output [--format FORMAT] "
+		"[--duration SECONDS] [--pipe N] [--chunk-size BYTES] "
+		"CONFIG NAME...\n");
+}
+
+int main(int argc, char **argv)
+{
+	Error error;
+
+	AudioFormat audio_format(44100, SampleFormat::S16, 2);
+	unsigned duration = 10, pipe_depth = 8;
+	size_t chunk_size = DEFAULT_CHUNK_SIZE;
+	const char *format_string = nullptr;
+
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; ++i) {
+		if (i + 1 >= argc) {
+			Usage();
+			return EXIT_FAILURE;
+		}
+
+		if (strcmp(argv[i], "--format") == 0)
+			format_string = argv[++i];
+		else if (strcmp(argv[i], "--duration") == 0)
+			duration = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--pipe") == 0)
+			pipe_depth = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--chunk-size") == 0)
+			chunk_size = strtoul(argv[++i], nullptr, 10);
+		else {
+			Usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - i < 2 || argc - i - 1 > 64 || pipe_depth == 0 ||
+	    chunk_size < MIN_CHUNK_SIZE || chunk_size > MAX_CHUNK_SIZE) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+	if (format_string != nullptr &&
+	    !audio_format_parse(audio_format, format_string, false, error)) {
+		LogError(error, "Failed to parse audio format");
+		return EXIT_FAILURE;
+	}
+
+	const Path config_path = Path::FromFS(argv[i++]);
+
+#ifdef HAVE_GLIB
+#if !GLIB_CHECK_VERSION(2,32,0)
+	g_thread_init(NULL);
+#endif
+#endif
+
+	/* read configuration file (mpd.conf) */
+
+	config_global_init();
+	if (!ReadConfigFile(config_path, error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	EventLoop event_loop;
+
+	io_thread_init();
+	io_thread_start();
+
+	/* initialize and open the audio outputs */
+
+	MusicBuffer buffer(pipe_depth + 4, chunk_size);
+	MusicPipe pipe;
+
+	std::vector<OutputProbe> probes;
+	for (; i < argc; ++i) {
+		AudioOutput *ao = load_audio_output(event_loop, argv[i]);
+		if (ao == nullptr)
+			return EXIT_FAILURE;
+
+		ao->LockEnableWait();
+		if (!ao->LockUpdate(audio_format, pipe)) {
+			fprintf(stderr, "Failed to open audio output %s\n",
+				argv[i]);
+			return EXIT_FAILURE;
+		}
+
+		probes.emplace_back(ao);
+	}
+
+	for (auto &probe : probes)
+		probe.cpu_start = GetOutputThreadCpuUS(*probe.ao);
+
+	/* play */
+
+	std::deque<PendingChunk> pending;
+	const uint64_t start = MonotonicClockUS();
+	const uint64_t end = start + uint64_t(duration) * 1000000;
+	const double chunk_time = double(chunk_size -
+					 chunk_size % audio_format.GetFrameSize()) /
+		audio_format.GetTimeToSize();
+	float data_time = 0;
+	unsigned long n_chunks = 0;
+
+	while (MonotonicClockUS() < end) {
+		while (pipe.GetSize() < pipe_depth) {
+			music_chunk *chunk = buffer.Allocate();
+			if (chunk == nullptr)
+				break;
+
+			FillChunk(*chunk, audio_format, data_time);
+			data_time += chunk_time;
+
+			pending.push_back({chunk, MonotonicClockUS(), 0});
+			pipe.Push(chunk);
+			++n_chunks;
+
+			for (auto &probe : probes)
+				probe.ao->LockPlay();
+		}
+
+		/* the output threads signal the PlayerControl after
+		   each chunk; the timeout covers a signal which
+		   arrived before we started waiting */
+		player_control.mutex.lock();
+		player_control.cond.timed_wait(player_control.mutex, 5);
+		player_control.mutex.unlock();
+
+		CheckPipe(probes, pipe, buffer, pending);
+	}
+
+	const double elapsed = (MonotonicClockUS() - start) / 1000000.;
+
+	printf("# output\tplugin\tchunks\tp50_us\tp90_us\tp99_us\tmax_us"
+	       "\tcpu_ms\tcpu_percent\tunderruns\n");
+
+	for (auto &probe : probes) {
+		const uint64_t cpu = GetOutputThreadCpuUS(*probe.ao) -
+			probe.cpu_start;
+
+		std::sort(probe.latencies.begin(), probe.latencies.end());
+
+		printf("%s\t%s\t%zu\t%u\t%u\t%u\t%u\t%.1f\t%.1f\t%llu\n",
+		       probe.ao->name, probe.ao->plugin.name,
+		       probe.latencies.size(),
+		       probe.GetPercentile(0.5), probe.GetPercentile(0.9),
+		       probe.GetPercentile(0.99),
+		       probe.latencies.empty() ? 0 : probe.latencies.back(),
+		       cpu / 1000., cpu / 10000. / elapsed,
+		       (unsigned long long)probe.ao->underruns.Get());
+	}
+
+	printf("# %lu chunks (%.1f s of audio) in %.1f s\n",
+	       n_chunks, n_chunks * chunk_time, elapsed);
+
+	/* cleanup and exit */
+
+	for (auto &probe : probes) {
+		probe.ao->LockCloseWait();
+		probe.ao->LockDisableWait();
+	}
+
+	CheckPipe(probes, pipe, buffer, pending);
+	pipe.Clear(buffer);
+
+	for (auto &probe : probes)
+		audio_output_free(probe.ao);
+
+	io_thread_deinit();
+
+	config_global_finish();
+
+	return EXIT_SUCCESS;
+}
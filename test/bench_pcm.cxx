@@ -0,0 +1,590 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the throughput of MPD's PCM kernels.  It
+ * prints one line per kernel/format/channel combination:
+ *
+ *   NAME<TAB>FORMAT<TAB>CHANNELS<TAB>SAMPLES_PER_SECOND
+ *
+ * With "--baseline FILE", the results are compared with a previous
+ * run (same format), and the exit status is non-zero if a kernel has
+ * become slower than the tolerance ("--tolerance PERCENT", default
+ * 10).
+ *
+ */
+
+#include "config.h"
+#include "pcm/Volume.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmDither.hxx"
+#include "pcm/FormatConverter.hxx"
+#include "pcm/PcmChannels.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/PcmExport.hxx"
+#include "pcm/FallbackResampler.hxx"
+#include "pcm/PolyphaseResampler.hxx"
+#include "pcm/SimdLevel.hxx"
+#include "AudioFormat.hxx"
+#include "system/Clock.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+
+#ifdef HAVE_LIBSAMPLERATE
+#include "pcm/LibsamplerateResampler.hxx"
+#endif
+
+#ifdef HAVE_SOXR
+#include "pcm/SoxrResampler.hxx"
+#endif
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of frames processed by each kernel call.
+ */
+static constexpr unsigned BENCH_FRAMES = 4096;
+
+/**
+ * Each kernel is called repeatedly for at least this duration.
+ */
+static uint64_t bench_duration_us = 200000;
+
+static const char *bench_filter;
+
+typedef std::map<std::string, double> BenchResults;
+static BenchResults bench_results;
+
+/**
+ * Fill a buffer with random samples of the given format, in the
+ * valid range of that format.
+ */
+static void
+FillRandom(void *_dest, SampleFormat format, size_t n_samples)
+{
+	uint32_t state = 0x12345678;
+	auto next = [&state](){
+		state = state * 1664525 + 1013904223;
+		return state;
+	};
+
+	switch (format) {
+	case SampleFormat::S24_P32:
+		for (size_t i = 0; i < n_samples; ++i) {
+			int32_t v = int32_t(next()) >> 8;
+			((int32_t *)_dest)[i] = v;
+		}
+		break;
+
+	case SampleFormat::FLOAT:
+		for (size_t i = 0; i < n_samples; ++i)
+			((float *)_dest)[i] =
+				int32_t(next()) / 2147483648.f;
+		break;
+
+	default: {
+		uint8_t *dest = (uint8_t *)_dest;
+		const size_t size = n_samples * sample_format_size(format);
+		for (size_t i = 0; i < size; ++i)
+			dest[i] = uint8_t(next() >> 24);
+		break;
+	}
+	}
+}
+
+/**
+ * A buffer of random sample data.
+ */
+class BenchData {
+	void *data;
+	size_t size;
+
+public:
+	BenchData(SampleFormat format, unsigned channels,
+		  unsigned frames=BENCH_FRAMES) {
+		const size_t n = size_t(frames) * channels;
+		size = n * sample_format_size(format);
+		data = malloc(size);
+		FillRandom(data, format, n);
+	}
+
+	~BenchData() {
+		free(data);
+	}
+
+	BenchData(const BenchData &) = delete;
+
+	void *Get() {
+		return data;
+	}
+
+	ConstBuffer<void> ToConst() const {
+		return { data, size };
+	}
+
+	template<typename T>
+	ConstBuffer<T> ToConstT() const {
+		return ConstBuffer<T>::FromVoid(ToConst());
+	}
+
+	size_t GetSize() const {
+		return size;
+	}
+};
+
+/**
+ * Consume the result of a kernel, so the compiler cannot discard
+ * calls to functions declared "pure".
+ */
+static volatile size_t bench_sink;
+
+template<typename T>
+static void
+Sink(ConstBuffer<T> b)
+{
+	bench_sink = b.size;
+}
+
+/**
+ * Run the kernel until #bench_duration_us has elapsed, and print the
+ * throughput.
+ *
+ * @param samples_per_call the number of samples processed by one
+ * call of #f
+ */
+static void
+Bench(const char *name, const char *format, unsigned channels,
+      size_t samples_per_call, std::function<void()> f)
+{
+	if (bench_filter != nullptr && strstr(name, bench_filter) == nullptr)
+		return;
+
+	/* warm up caches and lazily allocated buffers */
+	f();
+
+	uint64_t n_calls = 0;
+	const uint64_t start = MonotonicClockUS();
+	uint64_t elapsed;
+	do {
+		for (unsigned i = 0; i < 16; ++i)
+			f();
+		n_calls += 16;
+		elapsed = MonotonicClockUS() - start;
+	} while (elapsed < bench_duration_us);
+
+	const double rate = double(n_calls) * samples_per_call * 1000000.
+		/ elapsed;
+
+	printf("%s\t%s\t%u\t%.0f\n", name, format, channels, rate);
+	fflush(stdout);
+
+	char key[128];
+	snprintf(key, sizeof(key), "%s\t%s\t%u", name, format, channels);
+	bench_results[key] = rate;
+}
+
+static constexpr SampleFormat integer_formats[] = {
+	SampleFormat::S8,
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+};
+
+static constexpr SampleFormat all_formats[] = {
+	SampleFormat::S8,
+	SampleFormat::S16,
+	SampleFormat::S24_P32,
+	SampleFormat::S32,
+	SampleFormat::FLOAT,
+};
+
+static constexpr unsigned channel_counts[] = { 1, 2, 6 };
+
+static void
+BenchVolume()
+{
+	for (auto format : all_formats) {
+		for (bool dither : { false, true }) {
+			if (dither && format == SampleFormat::FLOAT)
+				continue;
+
+			PcmVolume pv;
+			pv.SetDither(dither);
+
+			Error error;
+			if (!pv.Open(format, error))
+				continue;
+
+			pv.SetVolume(PCM_VOLUME_1 / 2);
+
+			BenchData src(format, 2);
+			Bench(dither ? "volume_dither" : "volume",
+			      sample_format_to_string(format), 2,
+			      BENCH_FRAMES * 2,
+			      [&](){ Sink(pv.Apply(src.ToConst())); });
+			pv.Close();
+		}
+	}
+}
+
+static void
+BenchMix()
+{
+	for (auto format : all_formats) {
+		for (float portion : { 0.3f, -1.f }) {
+			BenchData a(format, 2), b(format, 2);
+			PcmDither dither;
+
+			Bench(portion < 0 ? "mix_add" : "mix",
+			      sample_format_to_string(format), 2,
+			      BENCH_FRAMES * 2,
+			      [&](){
+				      if (!pcm_mix(dither, a.Get(),
+						   b.ToConst().data,
+						   a.GetSize(), format,
+						   portion))
+					      abort();
+			      });
+		}
+	}
+}
+
+static void
+BenchFormat()
+{
+	static constexpr SampleFormat formats[] = {
+		SampleFormat::S8,
+		SampleFormat::S16,
+		SampleFormat::S24_P32,
+		SampleFormat::S32,
+		SampleFormat::FLOAT,
+	};
+
+	for (auto src_format : formats) {
+		for (auto dest_format : formats) {
+			if (src_format == dest_format)
+				continue;
+
+			PcmFormatConverter converter;
+			Error error;
+			if (!converter.Open(src_format, dest_format, error))
+				continue;
+
+			char name[64];
+			snprintf(name, sizeof(name), "format_to_%s",
+				 sample_format_to_string(dest_format));
+
+			BenchData src(src_format, 2);
+			Bench(name, sample_format_to_string(src_format), 2,
+			      BENCH_FRAMES * 2,
+			      [&](){
+				      Sink(converter.Convert(src.ToConst(),
+							     error));
+			      });
+			converter.Close();
+		}
+	}
+}
+
+template<typename T, typename F>
+static void
+BenchChannelsT(SampleFormat format, F f)
+{
+	static constexpr struct {
+		unsigned src, dest;
+	} layouts[] = {
+		{ 1, 2 },
+		{ 2, 1 },
+		{ 6, 2 },
+		{ 2, 6 },
+	};
+
+	for (const auto &l : layouts) {
+		PcmBuffer buffer;
+		BenchData src(format, l.src);
+
+		char name[64];
+		snprintf(name, sizeof(name), "channels_to_%u", l.dest);
+
+		Bench(name, sample_format_to_string(format), l.src,
+		      BENCH_FRAMES * l.src,
+		      [&](){
+			      Sink(f(buffer, l.dest, l.src,
+				     src.ToConstT<T>()));
+		      });
+	}
+}
+
+static void
+BenchChannels()
+{
+	BenchChannelsT<int16_t>(SampleFormat::S16, pcm_convert_channels_16);
+	BenchChannelsT<int32_t>(SampleFormat::S24_P32,
+				pcm_convert_channels_24);
+	BenchChannelsT<int32_t>(SampleFormat::S32, pcm_convert_channels_32);
+	BenchChannelsT<float>(SampleFormat::FLOAT,
+			      pcm_convert_channels_float);
+}
+
+static void
+BenchDsd()
+{
+	for (unsigned channels : channel_counts) {
+		PcmDsd dsd;
+		BenchData src(SampleFormat::DSD, channels);
+
+		/* one float per DSD byte */
+		Bench("dsd_to_float", "dsd", channels,
+		      BENCH_FRAMES * channels,
+		      [&](){
+			      Sink(dsd.ToFloat(channels, false,
+					       src.ToConstT<uint8_t>()));
+		      });
+	}
+}
+
+static void
+BenchExport()
+{
+	static constexpr struct {
+		const char *name;
+		SampleFormat format;
+		bool dsd_usb, shift8, pack24, reverse_endian;
+	} modes[] = {
+		{ "export_pack24", SampleFormat::S24_P32,
+		  false, false, true, false },
+		{ "export_shift8", SampleFormat::S24_P32,
+		  false, true, false, false },
+		{ "export_reverse", SampleFormat::S16,
+		  false, false, false, true },
+		{ "export_reverse", SampleFormat::S32,
+		  false, false, false, true },
+		{ "export_pack24_reverse", SampleFormat::S24_P32,
+		  false, false, true, true },
+		{ "export_dsd_usb", SampleFormat::DSD,
+		  true, false, false, false },
+	};
+
+	for (const auto &m : modes) {
+		PcmExport e;
+		e.Open(m.format, 2, m.dsd_usb, m.shift8, m.pack24,
+		       m.reverse_endian);
+
+		BenchData src(m.format, 2);
+		Bench(m.name, sample_format_to_string(m.format), 2,
+		      BENCH_FRAMES * 2,
+		      [&](){
+			      size_t dest_size;
+			      e.Export(src.ToConst().data, src.GetSize(),
+				       dest_size);
+			      bench_sink = dest_size;
+		      });
+	}
+}
+
+static void
+BenchResamplerInstance(const char *name, PcmResampler &r)
+{
+	static constexpr struct {
+		unsigned from, to;
+	} rates[] = {
+		{ 44100, 48000 },
+		{ 48000, 44100 },
+		{ 44100, 96000 },
+	};
+
+	for (auto format : { SampleFormat::S16, SampleFormat::FLOAT }) {
+		for (const auto &rate : rates) {
+			AudioFormat af(rate.from, format, 2);
+			Error error;
+			const AudioFormat out = r.Open(af, rate.to, error);
+			if (!out.IsDefined())
+				continue;
+
+			if (af.format != format) {
+				/* the resampler does not support this
+				   format natively; it's benchmarked
+				   with the other one */
+				r.Close();
+				continue;
+			}
+
+			BenchData src(format, 2);
+
+			char full_name[64];
+			snprintf(full_name, sizeof(full_name),
+				 "%s_%u_%u", name, rate.from, rate.to);
+
+			Bench(full_name, sample_format_to_string(af.format),
+			      2, BENCH_FRAMES * 2,
+			      [&](){ Sink(r.Resample(src.ToConst(), error)); });
+			r.Close();
+		}
+	}
+}
+
+static void
+BenchResampler()
+{
+	{
+		FallbackPcmResampler r;
+		BenchResamplerInstance("resample_fallback", r);
+	}
+
+	for (const char *quality : { "fast", "medium", "best" }) {
+		char converter[32], name[32];
+		snprintf(converter, sizeof(converter), "polyphase %s",
+			 quality);
+		snprintf(name, sizeof(name), "resample_polyphase_%s",
+			 quality);
+
+		Error error;
+		if (!pcm_resample_polyphase_global_init(converter, error))
+			continue;
+
+		PolyphasePcmResampler r;
+		BenchResamplerInstance(name, r);
+	}
+
+#ifdef HAVE_LIBSAMPLERATE
+	{
+		Error error;
+		if (pcm_resample_lsr_global_init("", error)) {
+			LibsampleratePcmResampler r;
+			BenchResamplerInstance("resample_lsr", r);
+		}
+	}
+#endif
+
+#ifdef HAVE_SOXR
+	{
+		Error error;
+		if (pcm_resample_soxr_global_init("", error)) {
+			SoxrPcmResampler r;
+			BenchResamplerInstance("resample_soxr", r);
+		}
+	}
+#endif
+}
+
+/**
+ * Compare #bench_results with a file written by an earlier run.
+ *
+ * @return the number of regressions, or -1 on error
+ */
+static int
+CompareBaseline(const char *path, double tolerance)
+{
+	FILE *file = fopen(path, "r");
+	if (file == nullptr) {
+		perror(path);
+		return -1;
+	}
+
+	int regressions = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		if (*line == '#')
+			continue;
+
+		/* split the line after the third tab */
+		char *p = line;
+		for (unsigned i = 0; i < 3 && p != nullptr; ++i) {
+			p = strchr(p, '\t');
+			if (p != nullptr)
+				++p;
+		}
+
+		if (p == nullptr)
+			continue;
+
+		const double baseline = strtod(p, nullptr);
+		p[-1] = 0;
+
+		const auto i = bench_results.find(line);
+		if (i == bench_results.end() || baseline <= 0)
+			continue;
+
+		const double change = (i->second - baseline) / baseline;
+		if (change < -tolerance) {
+			fprintf(stderr, "REGRESSION %s: %.0f -> %.0f (%+.1f%%)\n",
+				line, baseline, i->second, change * 100);
+			++regressions;
+		}
+	}
+
+	fclose(file);
+	return regressions;
+}
+
+int main(int argc, char **argv)
+{
+	const char *baseline = nullptr;
+	double tolerance = 0.10;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			baseline = argv[++i];
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			tolerance = strtod(argv[++i], nullptr) / 100.;
+		else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc)
+			bench_duration_us = strtoul(argv[++i], nullptr, 10)
+				* 1000;
+		else if (*argv[i] != '-' && bench_filter == nullptr)
+			bench_filter = argv[i];
+		else {
+			fprintf(stderr, "Usage: bench_pcm [--duration MS] "
+				"[--baseline FILE [--tolerance PERCENT]] "
+				"[FILTER]\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	static const char *const simd_names[] = {
+		"none", "sse2", "avx2", "neon",
+	};
+
+	printf("# simd=%s\n", simd_names[unsigned(GetSimdLevel())]);
+	printf("# name\tformat\tchannels\tsamples_per_second\n");
+
+	BenchVolume();
+	BenchMix();
+	BenchFormat();
+	BenchChannels();
+	BenchDsd();
+	BenchExport();
+	BenchResampler();
+
+	if (baseline != nullptr) {
+		const int regressions = CompareBaseline(baseline, tolerance);
+		if (regressions != 0)
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
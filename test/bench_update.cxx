@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Database update benchmark: walks a storage (a local directory or
+ * a storage URI such as nfs:// or smb://) into a throwaway in-memory
+ * database, exactly like "mpd --update" would, and reports where the
+ * time went:
+ *
+ *   bench_update [--config FILE] [--rescan] PATH_OR_URI
+ *
+ * The configuration file is optional; it may be used to set
+ * "update_threads", "update_trust_mtime", symlink options and the
+ * decoder plugins.  With "--rescan", a second walk over the
+ * unmodified tree is measured.
+ *
+ * Tag scanning time is summed over all scan threads and attributed
+ * to the first enabled decoder plugin supporting the file name
+ * suffix.
+ *
+ */
+
+#include "config.h"
+#include "db/update/Walk.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/SongIndex.hxx"
+#include "storage/Registry.hxx"
+#include "storage/StorageInterface.hxx"
+#include "storage/plugins/LocalStorage.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "playlist/PlaylistRegistry.hxx"
+#include "input/Init.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "event/Loop.hxx"
+#include "IOThread.hxx"
+#include "fs/Path.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef HAVE_GLIB
+#include <glib.h>
+#endif
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+/**
+ * Time spent in directory listing and stat calls.  These are atomic
+ * because Song::ScanFile() calls Storage::GetInfo() in the scan
+ * threads.
+ */
+struct StorageCounters {
+	std::atomic<uint64_t> open_dirs, entries, list_us;
+	std::atomic<uint64_t> stats, stat_us;
+
+	StorageCounters()
+		:open_dirs(0), entries(0), list_us(0),
+		 stats(0), stat_us(0) {}
+};
+
+class ProfilingDirectoryReader final : public StorageDirectoryReader {
+	std::unique_ptr<StorageDirectoryReader> reader;
+	StorageCounters &counters;
+
+public:
+	ProfilingDirectoryReader(StorageDirectoryReader *_reader,
+				 StorageCounters &_counters)
+		:reader(_reader), counters(_counters) {}
+
+	/* virtual methods from class StorageDirectoryReader */
+	const char *Read() override {
+		const uint64_t start = MonotonicClockUS();
+		const char *name = reader->Read();
+		counters.list_us += MonotonicClockUS() - start;
+		if (name != nullptr)
+			++counters.entries;
+		return name;
+	}
+
+	bool GetInfo(bool follow, FileInfo &info, Error &error) override {
+		const uint64_t start = MonotonicClockUS();
+		bool success = reader->GetInfo(follow, info, error);
+		counters.stat_us += MonotonicClockUS() - start;
+		++counters.stats;
+		return success;
+	}
+};
+
+/**
+ * A #Storage decorator which measures the time spent in its methods.
+ */
+class ProfilingStorage final : public Storage {
+	std::unique_ptr<Storage> storage;
+
+public:
+	StorageCounters counters;
+
+	explicit ProfilingStorage(Storage *_storage)
+		:storage(_storage) {}
+
+	/* virtual methods from class Storage */
+	bool GetInfo(const char *uri_utf8, bool follow, FileInfo &info,
+		     Error &error) override {
+		const uint64_t start = MonotonicClockUS();
+		bool success = storage->GetInfo(uri_utf8, follow, info, error);
+		counters.stat_us += MonotonicClockUS() - start;
+		++counters.stats;
+		return success;
+	}
+
+	StorageDirectoryReader *OpenDirectory(const char *uri_utf8,
+					      Error &error) override {
+		const uint64_t start = MonotonicClockUS();
+		StorageDirectoryReader *reader =
+			storage->OpenDirectory(uri_utf8, error);
+		counters.list_us += MonotonicClockUS() - start;
+		++counters.open_dirs;
+
+		return reader != nullptr
+			? new ProfilingDirectoryReader(reader, counters)
+			: nullptr;
+	}
+
+	std::string MapUTF8(const char *uri_utf8) const override {
+		return storage->MapUTF8(uri_utf8);
+	}
+
+	AllocatedPath MapFS(const char *uri_utf8) const override {
+		return storage->MapFS(uri_utf8);
+	}
+
+	const char *MapToRelativeUTF8(const char *uri_utf8) const override {
+		return storage->MapToRelativeUTF8(uri_utf8);
+	}
+};
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	/* virtual methods from class DatabaseListener */
+	void OnDatabaseModified() override {}
+	void OnDatabaseSongRemoved(gcc_unused const LightSong &song) override {}
+};
+
+static uint64_t
+CpuUS()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return uint64_t(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+		ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static const char *
+GetPluginName(const std::string &suffix)
+{
+	const DecoderPlugin *plugin =
+		decoder_plugins_find([&suffix](const DecoderPlugin &p){
+				return p.SupportsSuffix(suffix.c_str());
+			});
+	return plugin != nullptr ? plugin->name : "-";
+}
+
+static void
+RunWalk(const char *label, EventLoop &event_loop, ProfilingStorage &storage,
+	Directory &root)
+{
+	NullDatabaseListener listener;
+	UpdateScanProfile profile;
+
+	const StorageCounters &c = storage.counters;
+	const uint64_t open_dirs0 = c.open_dirs, entries0 = c.entries,
+		list_us0 = c.list_us, stats0 = c.stats, stat_us0 = c.stat_us;
+	const uint64_t locks0 = db_mutex_hold_time.GetCount();
+	const uint64_t lock_hold0 = db_mutex_hold_time.GetSum();
+	const uint64_t lock_wait0 = db_mutex_wait_us;
+	const uint64_t cpu0 = CpuUS();
+	const uint64_t start = MonotonicClockUS();
+
+	{
+		UpdateWalk walk(event_loop, listener, storage, nullptr);
+		walk.SetProfile(&profile);
+		walk.Walk(root, "", false);
+	}
+
+	const uint64_t wall_us = MonotonicClockUS() - start;
+	const uint64_t cpu_us = CpuUS() - cpu0;
+
+	unsigned files = 0;
+	for (const auto &i : profile.suffixes)
+		files += i.second.files;
+
+	printf("%s\twalk\t%u files\t%.1f ms\t%.0f files/s\t%.1f ms cpu\n",
+	       label, files, wall_us / 1000.,
+	       wall_us > 0 ? files * 1000000. / wall_us : 0.,
+	       cpu_us / 1000.);
+
+	printf("%s\tlist\t%llu dirs\t%llu entries\t%.1f ms\n", label,
+	       (unsigned long long)(c.open_dirs - open_dirs0),
+	       (unsigned long long)(c.entries - entries0),
+	       (c.list_us - list_us0) / 1000.);
+
+	const uint64_t n_stats = c.stats - stats0;
+	const uint64_t stat_us = c.stat_us - stat_us0;
+	printf("%s\tstat\t%llu calls\t%.1f ms\t%.1f us/call\n", label,
+	       (unsigned long long)n_stats, stat_us / 1000.,
+	       n_stats > 0 ? double(stat_us) / n_stats : 0.);
+
+	/* per plugin totals, and the suffixes contributing to them */
+	std::map<std::string, UpdateScanProfile::Entry> plugins;
+	for (const auto &i : profile.suffixes) {
+		const char *plugin = GetPluginName(i.first);
+		auto &p = plugins[plugin];
+		p.files += i.second.files;
+		p.failed += i.second.failed;
+		p.duration_us += i.second.duration_us;
+
+		printf("%s\tscan\t%s\t.%s\t%u files\t%u failed\t%.1f ms\t%.1f us/file\n",
+		       label, plugin, i.first.c_str(),
+		       i.second.files, i.second.failed,
+		       i.second.duration_us / 1000.,
+		       double(i.second.duration_us) / i.second.files);
+	}
+
+	for (const auto &i : plugins)
+		printf("%s\tscan\t%s\t*\t%u files\t%u failed\t%.1f ms\t%.1f us/file\n",
+		       label, i.first.c_str(),
+		       i.second.files, i.second.failed,
+		       i.second.duration_us / 1000.,
+		       double(i.second.duration_us) / i.second.files);
+
+	printf("%s\tdb_lock\t%llu locks\t%.1f ms held\t%.1f ms waited\n",
+	       label,
+	       (unsigned long long)(db_mutex_hold_time.GetCount() - locks0),
+	       (db_mutex_hold_time.GetSum() - lock_hold0) / 1000.,
+	       (db_mutex_wait_us - lock_wait0) / 1000.);
+}
+
+static void
+Usage()
+{
+	fprintf(stderr, "Usage: bench_update [--config FILE] [--rescan] "
+		"PATH_OR_URI\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *config_file = nullptr, *uri = nullptr;
+	bool rescan = false;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+			config_file = argv[++i];
+		else if (strcmp(argv[i], "--rescan") == 0)
+			rescan = true;
+		else if (argv[i][0] == '-' || uri != nullptr) {
+			Usage();
+			return EXIT_FAILURE;
+		} else
+			uri = argv[i];
+	}
+
+	if (uri == nullptr) {
+		Usage();
+		return EXIT_FAILURE;
+	}
+
+#ifdef HAVE_GLIB
+#if !GLIB_CHECK_VERSION(2,32,0)
+	g_thread_init(NULL);
+#endif
+#endif
+
+	Error error;
+
+	config_global_init();
+	if (config_file != nullptr &&
+	    !ReadConfigFile(Path::FromFS(config_file), error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	io_thread_init();
+	io_thread_start();
+
+	if (!input_stream_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	decoder_plugin_init_all();
+	playlist_list_global_init();
+
+	Storage *inner = uri[0] == '/'
+		? CreateLocalStorage(Path::FromFS(uri))
+		: CreateStorageURI(uri, error);
+	if (inner == nullptr) {
+		if (error.IsDefined())
+			LogError(error);
+		else
+			fprintf(stderr, "Unrecognized storage URI: %s\n", uri);
+		return EXIT_FAILURE;
+	}
+
+	ProfilingStorage storage(inner);
+
+	EventLoop event_loop;
+
+	SongIndex song_index;
+	Directory *root = Directory::NewRoot();
+	root->song_index = &song_index;
+
+	printf("# pass\tphase\tvalues...\n");
+	RunWalk("full", event_loop, storage, *root);
+	if (rescan)
+		RunWalk("rescan", event_loop, storage, *root);
+
+	root->song_index = nullptr;
+	delete root;
+	song_index.Clear();
+
+	playlist_list_global_finish();
+	decoder_plugin_deinit_all();
+	input_stream_global_finish();
+	io_thread_deinit();
+	config_global_finish();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * A load generator for the MPD protocol.  It opens many connections
+ * to a running MPD: some of them only wait in "idle", the others run
+ * a mix of commands in a loop.  At the end, it prints latency
+ * percentiles for each command and the total throughput:
+ *
+ *   mpd_load [--host HOST] [--port PORT] [--duration SECONDS]
+ *            [--idle N] [--clients N] [--command CMD]...
+ *
+ * HOST may be the path of a local socket.  CMD may contain "\n" to
+ * send a command list, e.g.
+ * "command_list_begin\nstatus\ncurrentsong\ncommand_list_end".
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t
+NowUS()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct CommandStats {
+	std::string name;
+	std::vector<uint32_t> latencies;
+	unsigned errors = 0;
+
+	explicit CommandStats(const std::string &_name):name(_name) {}
+
+	uint32_t GetPercentile(double p) const {
+		if (latencies.empty())
+			return 0;
+
+		size_t i = size_t(p * latencies.size());
+		if (i >= latencies.size())
+			i = latencies.size() - 1;
+		return latencies[i];
+	}
+};
+
+struct Connection {
+	int fd;
+
+	enum class State {
+		CONNECTING,
+		GREETING,
+		READY,
+		WAITING,
+		IDLE,
+	} state;
+
+	/**
+	 * Does this connection only wait in "idle"?
+	 */
+	bool idle_only;
+
+	/**
+	 * The index of the next command in the mix.
+	 */
+	unsigned next_command;
+
+	/**
+	 * The index of the command whose response is pending.
+	 */
+	unsigned pending_command;
+
+	uint64_t sent_at;
+
+	std::string output, input;
+};
+
+static std::vector<CommandStats> command_stats;
+static std::vector<std::string> command_texts;
+static uint64_t bytes_received, responses_total;
+
+static int
+Connect(const char *host, const char *port)
+{
+	if (*host == '/') {
+		struct sockaddr_un sun;
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		if (strlen(host) >= sizeof(sun.sun_path))
+			return -1;
+		strcpy(sun.sun_path, host);
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		if (connect(fd, (const struct sockaddr *)&sun,
+			    sizeof(sun)) < 0 && errno != EINPROGRESS &&
+		    errno != EAGAIN) {
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+
+	struct addrinfo hints, *ai;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(host, port, &hints, &ai) != 0)
+		return -1;
+
+	int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (fd >= 0) {
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) < 0 &&
+		    errno != EINPROGRESS) {
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	freeaddrinfo(ai);
+	return fd;
+}
+
+/**
+ * Queue the next command of the mix (or "idle").
+ */
+static void
+SendNext(Connection &c)
+{
+	if (c.idle_only) {
+		c.output += "idle\n";
+		c.state = Connection::State::IDLE;
+		return;
+	}
+
+	c.pending_command = c.next_command;
+	c.next_command = (c.next_command + 1) % command_texts.size();
+
+	c.output += command_texts[c.pending_command];
+	c.output += '\n';
+	c.sent_at = NowUS();
+	c.state = Connection::State::WAITING;
+}
+
+/**
+ * Consume complete lines from the input buffer.
+ *
+ * @return false on error
+ */
+static bool
+HandleInput(Connection &c)
+{
+	size_t start = 0, eol;
+	while ((eol = c.input.find('\n', start)) != std::string::npos) {
+		const char *line = c.input.data() + start;
+		const size_t length = eol - start;
+		start = eol + 1;
+
+		switch (c.state) {
+		case Connection::State::CONNECTING:
+		case Connection::State::READY:
+			break;
+
+		case Connection::State::GREETING:
+			if (length < 6 || memcmp(line, "OK MPD", 6) != 0)
+				return false;
+
+			c.state = Connection::State::READY;
+			SendNext(c);
+			break;
+
+		case Connection::State::IDLE:
+			/* some subsystem has changed; idle again */
+			if (length == 2 && memcmp(line, "OK", 2) == 0) {
+				c.state = Connection::State::READY;
+				SendNext(c);
+			}
+
+			break;
+
+		case Connection::State::WAITING: {
+			const bool ok = length == 2 &&
+				memcmp(line, "OK", 2) == 0;
+			const bool ack = length >= 3 &&
+				memcmp(line, "ACK", 3) == 0;
+			if (!ok && !ack)
+				break;
+
+			CommandStats &stats = command_stats[c.pending_command];
+			stats.latencies.push_back(uint32_t(NowUS() - c.sent_at));
+			if (ack)
+				++stats.errors;
+
+			++responses_total;
+			c.state = Connection::State::READY;
+			SendNext(c);
+			break;
+		}
+		}
+	}
+
+	c.input.erase(0, start);
+	return true;
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: mpd_load [--host HOST] [--port PORT] "
+		"[--duration SECONDS] [--idle N] [--clients N] "
+		"[--command CMD]...\n");
+}
+
+/**
+ * Replace the two-character sequence "\n" with a newline.
+ */
+static std::string
+Unescape(const char *s)
+{
+	std::string result;
+	for (; *s != 0; ++s) {
+		if (s[0] == '\\' && s[1] == 'n') {
+			result += '\n';
+			++s;
+		} else
+			result += *s;
+	}
+
+	return result;
+}
+
+int main(int argc, char **argv)
+{
+	const char *host = "localhost", *port = "6600";
+	unsigned duration = 10, n_idle = 0, n_clients = 10;
+
+	for (int i = 1; i < argc; ++i) {
+		if (i + 1 >= argc) {
+			Usage();
+			return EXIT_FAILURE;
+		}
+
+		if (strcmp(argv[i], "--host") == 0)
+			host = argv[++i];
+		else if (strcmp(argv[i], "--port") == 0)
+			port = argv[++i];
+		else if (strcmp(argv[i], "--duration") == 0)
+			duration = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--idle") == 0)
+			n_idle = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--clients") == 0)
+			n_clients = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--command") == 0)
+			command_texts.push_back(Unescape(argv[++i]));
+		else {
+			Usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (command_texts.empty())
+		command_texts.push_back("status");
+
+	for (const auto &text : command_texts)
+		command_stats.emplace_back(text);
+
+	std::vector<Connection> connections;
+	connections.reserve(n_idle + n_clients);
+
+	for (unsigned i = 0; i < n_idle + n_clients; ++i) {
+		Connection c;
+		c.fd = Connect(host, port);
+		if (c.fd < 0) {
+			fprintf(stderr, "Failed to connect to %s:%s: %s\n",
+				host, port, strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		c.state = Connection::State::GREETING;
+		c.idle_only = i < n_idle;
+		/* spread the active clients over the mix */
+		c.next_command = i % command_texts.size();
+		c.pending_command = 0;
+		c.sent_at = 0;
+		connections.push_back(std::move(c));
+	}
+
+	std::vector<struct pollfd> pfds(connections.size());
+
+	const uint64_t start = NowUS();
+	const uint64_t end = start + uint64_t(duration) * 1000000;
+	unsigned n_closed = 0;
+
+	while (NowUS() < end) {
+		for (size_t i = 0; i < connections.size(); ++i) {
+			const Connection &c = connections[i];
+			pfds[i].fd = c.fd;
+			pfds[i].events = POLLIN;
+			if (!c.output.empty())
+				pfds[i].events |= POLLOUT;
+			pfds[i].revents = 0;
+		}
+
+		if (poll(pfds.data(), pfds.size(), 100) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			return EXIT_FAILURE;
+		}
+
+		for (size_t i = 0; i < connections.size(); ++i) {
+			Connection &c = connections[i];
+			if (c.fd < 0)
+				continue;
+
+			const short revents = pfds[i].revents;
+
+			if ((revents & POLLOUT) && !c.output.empty()) {
+				ssize_t nbytes = send(c.fd, c.output.data(),
+						      c.output.size(),
+						      MSG_NOSIGNAL);
+				if (nbytes > 0)
+					c.output.erase(0, nbytes);
+			}
+
+			if (revents & (POLLIN|POLLHUP|POLLERR)) {
+				char buffer[16384];
+				ssize_t nbytes = recv(c.fd, buffer,
+						      sizeof(buffer), 0);
+				if (nbytes <= 0) {
+					if (nbytes < 0 && errno == EAGAIN)
+						continue;
+
+					close(c.fd);
+					c.fd = -1;
+					++n_closed;
+					continue;
+				}
+
+				bytes_received += nbytes;
+				c.input.append(buffer, nbytes);
+
+				if (!HandleInput(c)) {
+					close(c.fd);
+					c.fd = -1;
+					++n_closed;
+				}
+			}
+		}
+	}
+
+	const double elapsed = (NowUS() - start) / 1000000.;
+
+	for (auto &c : connections)
+		if (c.fd >= 0)
+			close(c.fd);
+
+	printf("# command\tcount\terrors\tp50_us\tp90_us\tp99_us\tmax_us\n");
+	for (auto &stats : command_stats) {
+		std::sort(stats.latencies.begin(), stats.latencies.end());
+
+		std::string name = stats.name;
+		std::replace(name.begin(), name.end(), '\n', ';');
+
+		printf("%s\t%zu\t%u\t%u\t%u\t%u\t%u\n",
+		       name.c_str(), stats.latencies.size(), stats.errors,
+		       stats.GetPercentile(0.5), stats.GetPercentile(0.9),
+		       stats.GetPercentile(0.99),
+		       stats.latencies.empty() ? 0 : stats.latencies.back());
+	}
+
+	printf("# %u idle + %u active connections, %u closed by the server\n",
+	       n_idle, n_clients, n_closed);
+	printf("# %.0f responses/s, %.0f KiB/s\n",
+	       responses_total / elapsed, bytes_received / 1024. / elapsed);
+
+	return EXIT_SUCCESS;
+}
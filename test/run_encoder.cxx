@@ -38,7 +38,7 @@ encoder_to_stdout(Encoder &encoder)
 	size_t length;
 	static char buffer[32768];
 
-	while ((length = encoder_read(&encoder, buffer, sizeof(buffer))) > 0) {
+	while ((length = encoder_read(&encoder, { buffer, sizeof(buffer) })) > 0) {
 		gcc_unused ssize_t ignored = write(1, buffer, length);
 	}
 }
@@ -100,7 +100,7 @@ int main(int argc, char **argv)
 
 	ssize_t nbytes;
 	while ((nbytes = read(0, buffer, sizeof(buffer))) > 0) {
-		if (!encoder_write(encoder, buffer, nbytes, error)) {
+		if (!encoder_write(encoder, { buffer, size_t(nbytes) }, error)) {
 			LogError(error, "encoder_write() failed");
 			return EXIT_FAILURE;
 		}
@@ -18,15 +18,16 @@
  */
 
 /*
- * This program is a command line interface to MPD's normalize library
- * (based on AudioCompress).
+ * This program is a command line interface to MPD's normalizer
+ * (PcmNormalizer).  It reads and writes floating point samples.
  *
  */
 
 #include "config.h"
-#include "AudioCompress/compress.h"
+#include "pcm/Normalizer.hxx"
 #include "AudioParser.hxx"
 #include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
 #include "stdbin.h"
 
@@ -37,8 +38,7 @@
 
 int main(int argc, char **argv)
 {
-	struct Compressor *compressor;
-	static char buffer[4096];
+	static float buffer[4096];
 	ssize_t nbytes;
 
 	if (argc > 2) {
@@ -46,7 +46,7 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	AudioFormat audio_format(48000, SampleFormat::S16, 2);
+	AudioFormat audio_format(48000, SampleFormat::FLOAT, 2);
 	if (argc > 1) {
 		Error error;
 		if (!audio_format_parse(audio_format, argv[1], false, error)) {
@@ -54,16 +54,23 @@ int main(int argc, char **argv)
 				   error.GetMessage());
 			return 1;
 		}
+
+		if (audio_format.format != SampleFormat::FLOAT) {
+			fprintf(stderr, "Only floating point samples are supported\n");
+			return 1;
+		}
 	}
 
-	compressor = Compressor_new(0);
+	PcmNormalizer normalizer;
+	normalizer.Open(audio_format.channels);
 
 	while ((nbytes = read(0, buffer, sizeof(buffer))) > 0) {
-		Compressor_Process_int16(compressor,
-					 (int16_t *)buffer, nbytes / 2);
+		const auto dest =
+			normalizer.Process({buffer, nbytes / sizeof(buffer[0])});
 
-		gcc_unused ssize_t ignored = write(1, buffer, nbytes);
+		gcc_unused ssize_t ignored =
+			write(1, dest.data, dest.size * sizeof(dest.data[0]));
 	}
 
-	Compressor_delete(compressor);
+	normalizer.Close();
 }
@@ -0,0 +1,243 @@
+/*
+ * Unit tests for src/db/plugins/simple/DatabaseBinary.cxx
+ */
+
+#include "config.h"
+#include "db/plugins/simple/DatabaseBinary.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/SongArena.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/PlaylistInfo.hxx"
+#include "tag/TagBuilder.hxx"
+#include "fs/Path.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Serialize the tree in the text format, which contains everything
+ * the binary format stores; two trees are equal if their text
+ * representation is.
+ */
+static std::string
+DumpText(const Directory &root)
+{
+	char *buffer = nullptr;
+	size_t size = 0;
+	FILE *fp = open_memstream(&buffer, &size);
+	CPPUNIT_ASSERT(fp != nullptr);
+
+	db_save_internal(fp, root);
+	fclose(fp);
+
+	std::string result(buffer, size);
+	free(buffer);
+	return result;
+}
+
+static std::string
+SaveBinary(const Directory &root)
+{
+	char *buffer = nullptr;
+	size_t size = 0;
+	FILE *fp = open_memstream(&buffer, &size);
+	CPPUNIT_ASSERT(fp != nullptr);
+
+	db_save_binary(fp, root);
+	fclose(fp);
+
+	std::string result(buffer, size);
+	free(buffer);
+	return result;
+}
+
+class DatabaseBinaryTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DatabaseBinaryTest);
+	CPPUNIT_TEST(TestEmpty);
+	CPPUNIT_TEST(TestRoundTrip);
+	CPPUNIT_TEST(TestTruncated);
+	CPPUNIT_TEST(TestCorrupt);
+	CPPUNIT_TEST_SUITE_END();
+
+	char path[64];
+
+public:
+	void setUp() override {
+		strcpy(path, "/tmp/test_db_binary.XXXXXX");
+		const int fd = mkstemp(path);
+		CPPUNIT_ASSERT(fd >= 0);
+		close(fd);
+	}
+
+	void tearDown() override {
+		unlink(path);
+	}
+
+	void TestEmpty() {
+		Directory *root = Directory::NewRoot();
+		CheckRoundTrip(*root);
+
+		db_lock();
+		root->CreateChild("empty");
+		root->MakeChild("a")->MakeChild("b")->MakeChild("c");
+		db_unlock();
+		CheckRoundTrip(*root);
+
+		delete root;
+	}
+
+	void TestRoundTrip() {
+		Directory *root = MakeTree();
+		CheckRoundTrip(*root);
+		delete root;
+	}
+
+	/**
+	 * Every prefix of a valid file must be rejected.
+	 */
+	void TestTruncated() {
+		Directory *root = MakeTree();
+		const std::string data = SaveBinary(*root);
+		delete root;
+
+		for (size_t length = 0; length < data.length(); ++length) {
+			WriteFile(data.data(), length);
+
+			Directory *loaded = Directory::NewRoot();
+			SongArena arena;
+			Error error;
+			CPPUNIT_ASSERT(!db_load_binary(Path::FromFS(path),
+						       *loaded, arena,
+						       error));
+			CPPUNIT_ASSERT(error.IsDefined());
+			delete loaded;
+		}
+	}
+
+	/**
+	 * Random damage must not crash the loader; it may or may not
+	 * detect it, because not every field has a redundancy.
+	 */
+	void TestCorrupt() {
+		Directory *root = MakeTree();
+		const std::string data = SaveBinary(*root);
+		delete root;
+
+		for (size_t i = 0; i < data.length(); ++i) {
+			for (const unsigned char x : {0x01, 0x80, 0xff}) {
+				std::string damaged(data);
+				damaged[i] ^= x;
+				WriteFile(damaged.data(), damaged.length());
+
+				Directory *loaded = Directory::NewRoot();
+				SongArena arena;
+				Error error;
+				if (!db_load_binary(Path::FromFS(path),
+						    *loaded, arena, error))
+					CPPUNIT_ASSERT(error.IsDefined());
+				delete loaded;
+			}
+		}
+
+		/* a different magic is not a binary database */
+		std::string damaged(data);
+		damaged[0] = 'X';
+		WriteFile(damaged.data(), damaged.length());
+		CPPUNIT_ASSERT(!db_binary_check(Path::FromFS(path)));
+	}
+
+private:
+	static Directory *MakeTree() {
+		Directory *root = Directory::NewRoot();
+
+		db_lock();
+
+		root->playlists.push_back(PlaylistInfo("list.m3u", 1234));
+
+		Directory *music = root->CreateChild("music");
+		music->mtime = 1000000000;
+
+		Song *song = Song::NewFile("a.flac", *music);
+		song->mtime = 1400000000;
+		song->identity = SongIdentity(12345678, 2049, 77);
+		TagBuilder tag;
+		tag.SetTime(215);
+		tag.AddItem(TAG_ARTIST, "Foo");
+		tag.AddItem(TAG_ARTIST, "Bar");
+		tag.AddItem(TAG_GENRE, "Jazz");
+		tag.AddItem(TAG_GENRE, "Funk");
+		tag.AddItem(TAG_TITLE, "T\xc3\xadtulo");
+		song->CommitTag(tag);
+		music->AddSong(song);
+
+		/* a song without tags, and one which shares tag
+		   values (the string table stores them once) */
+		music->AddSong(Song::NewFile("b.mp3", *music));
+
+		song = Song::NewFile("c.ogg", *music);
+		song->start_ms = 1000;
+		song->end_ms = 61000;
+		tag.AddItem(TAG_ARTIST, "Foo");
+		tag.AddItem(TAG_ALBUM, "");
+		song->CommitTag(tag);
+		music->AddSong(song);
+
+		music->CreateChild("empty");
+
+		Directory *sub = music->CreateChild("sub dir");
+		sub->AddSong(Song::NewFile("d.wav", *sub));
+		sub->playlists.push_back(PlaylistInfo("x.pls", 0));
+
+		db_unlock();
+		return root;
+	}
+
+	void WriteFile(const void *data, size_t length) {
+		FILE *fp = fopen(path, "wb");
+		CPPUNIT_ASSERT(fp != nullptr);
+		CPPUNIT_ASSERT_EQUAL(length, fwrite(data, 1, length, fp));
+		CPPUNIT_ASSERT_EQUAL(0, fclose(fp));
+	}
+
+	void CheckRoundTrip(const Directory &root) {
+		const std::string data = SaveBinary(root);
+		WriteFile(data.data(), data.length());
+		CPPUNIT_ASSERT(db_binary_check(Path::FromFS(path)));
+
+		Directory *loaded = Directory::NewRoot();
+		SongArena arena;
+		Error error;
+		CPPUNIT_ASSERT(db_load_binary(Path::FromFS(path), *loaded,
+					      arena, error));
+
+		CPPUNIT_ASSERT(DumpText(root) == DumpText(*loaded));
+
+		/* saving again yields the same file */
+		CPPUNIT_ASSERT(SaveBinary(*loaded) == data);
+
+		delete loaded;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DatabaseBinaryTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,160 @@
+/*
+ * Unit tests for src/decoder/DecoderProbe.cxx
+ */
+
+#include "config.h"
+#include "decoder/DecoderProbe.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *
+Sniff(const void *data, size_t size)
+{
+	const char *const*names = decoder_sniff(data, size);
+	return names != nullptr ? names[0] : "";
+}
+
+static const char *
+Sniff(const char *data)
+{
+	return Sniff(data, strlen(data));
+}
+
+static std::string
+MakeOgg(const char *packet, size_t packet_size)
+{
+	std::string page("OggS", 4);
+	page.append(22, '\0');
+	/* three lacing values */
+	page.push_back(3);
+	page.append("\x1e\x00\x00", 3);
+	page.append(packet, packet_size);
+	page.resize(DECODER_SNIFF_SIZE, '\0');
+	return page;
+}
+
+class DecoderProbeTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DecoderProbeTest);
+	CPPUNIT_TEST(TestSniff);
+	CPPUNIT_TEST(TestSniffOgg);
+	CPPUNIT_TEST(TestSniffMpeg);
+	CPPUNIT_TEST(TestCache);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSniff() {
+		CPPUNIT_ASSERT_EQUAL(std::string("flac"),
+				     std::string(Sniff("fLaC\0\0\0\x22", 8)));
+		CPPUNIT_ASSERT_EQUAL(std::string("mad"),
+				     std::string(Sniff("ID3\x04")));
+		CPPUNIT_ASSERT_EQUAL(std::string("sndfile"),
+				     std::string(Sniff("RIFF\x24\x08\0\0WAVEfmt ", 16)));
+		CPPUNIT_ASSERT_EQUAL(std::string("sndfile"),
+				     std::string(Sniff("FORM\0\0\0\0AIFF", 12)));
+		CPPUNIT_ASSERT_EQUAL(std::string("wavpack"),
+				     std::string(Sniff("wvpk")));
+		CPPUNIT_ASSERT_EQUAL(std::string("dsf"),
+				     std::string(Sniff("DSD ")));
+		CPPUNIT_ASSERT_EQUAL(std::string("ffmpeg"),
+				     std::string(Sniff("\0\0\0\x20" "ftypM4A ", 12)));
+
+		/* too short or unknown */
+		CPPUNIT_ASSERT_EQUAL(std::string(""), std::string(Sniff("fLa")));
+		CPPUNIT_ASSERT_EQUAL(std::string(""), std::string(Sniff("RIFF")));
+		CPPUNIT_ASSERT_EQUAL(std::string(""),
+				     std::string(Sniff("<html>")));
+		CPPUNIT_ASSERT_EQUAL(std::string(""), std::string(Sniff("", 0)));
+
+		/* the list is terminated, and ordered by preference */
+		const char *const*names = decoder_sniff("ID3", 3);
+		CPPUNIT_ASSERT(names != nullptr);
+		CPPUNIT_ASSERT_EQUAL(std::string("mpg123"),
+				     std::string(names[1]));
+		CPPUNIT_ASSERT(names[3] == nullptr);
+	}
+
+	void TestSniffOgg() {
+		std::string ogg = MakeOgg("\001vorbis", 7);
+		CPPUNIT_ASSERT_EQUAL(std::string("vorbis"),
+				     std::string(Sniff(ogg.data(), ogg.size())));
+
+		ogg = MakeOgg("OpusHead", 8);
+		CPPUNIT_ASSERT_EQUAL(std::string("opus"),
+				     std::string(Sniff(ogg.data(), ogg.size())));
+
+		ogg = MakeOgg("\177FLAC", 5);
+		CPPUNIT_ASSERT_EQUAL(std::string("oggflac"),
+				     std::string(Sniff(ogg.data(), ogg.size())));
+
+		ogg = MakeOgg("Speex   ", 8);
+		CPPUNIT_ASSERT_EQUAL(std::string("ffmpeg"),
+				     std::string(Sniff(ogg.data(), ogg.size())));
+
+		/* the packet is beyond the end of the buffer */
+		CPPUNIT_ASSERT_EQUAL(std::string("ffmpeg"),
+				     std::string(Sniff(ogg.data(), 31)));
+	}
+
+	void TestSniffMpeg() {
+		/* MPEG-1 layer III */
+		CPPUNIT_ASSERT_EQUAL(std::string("mad"),
+				     std::string(Sniff("\xff\xfb\x90\x64", 4)));
+		/* MPEG-2 layer II */
+		CPPUNIT_ASSERT_EQUAL(std::string("mad"),
+				     std::string(Sniff("\xff\xf5\x90\x64", 4)));
+		/* AAC ADTS */
+		CPPUNIT_ASSERT_EQUAL(std::string("faad"),
+				     std::string(Sniff("\xff\xf1\x50\x80", 4)));
+		CPPUNIT_ASSERT_EQUAL(std::string("faad"),
+				     std::string(Sniff("\xff\xf9\x50\x80", 4)));
+		/* not a frame header */
+		CPPUNIT_ASSERT_EQUAL(std::string(""),
+				     std::string(Sniff("\xff\x00\x90\x64", 4)));
+	}
+
+	void TestCache() {
+		/* only the addresses matter */
+		static DecoderPlugin a, b;
+
+		CPPUNIT_ASSERT(decoder_probe_cache_lookup("ogg",
+							 nullptr) == nullptr);
+
+		decoder_probe_cache_store("ogg", nullptr, a);
+		decoder_probe_cache_store("ogg", "audio/ogg", b);
+		CPPUNIT_ASSERT(decoder_probe_cache_lookup("ogg", nullptr) == &a);
+		CPPUNIT_ASSERT(decoder_probe_cache_lookup("ogg",
+							 "audio/ogg") == &b);
+		CPPUNIT_ASSERT(decoder_probe_cache_lookup(nullptr,
+							 "audio/ogg") == nullptr);
+
+		/* the most recent success wins */
+		decoder_probe_cache_store("ogg", nullptr, b);
+		CPPUNIT_ASSERT(decoder_probe_cache_lookup("ogg", nullptr) == &b);
+
+		/* nothing is known without suffix and MIME type */
+		decoder_probe_cache_store(nullptr, nullptr, a);
+		CPPUNIT_ASSERT(decoder_probe_cache_lookup(nullptr,
+							 nullptr) == nullptr);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DecoderProbeTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -20,7 +20,10 @@ static Tag *
 icy_parse_tag(const char *p)
 {
 	char *q = strdup(p);
-	Tag *tag = icy_parse_tag(q, q + strlen(q));
+	const char *title;
+	size_t length;
+	icy_parse_title(q, q + strlen(q), title, length);
+	Tag *tag = icy_title_tag(title, length);
 	free(q);
 	return tag;
 }
@@ -0,0 +1,170 @@
+/*
+ * Unit tests for src/input/InputCache.cxx
+ */
+
+#include "config.h"
+#include "input/InputCache.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static constexpr size_t CHUNK_SIZE = InputCacheItem::CHUNK_SIZE;
+
+static std::string
+MakeData(size_t length, char seed)
+{
+	std::string data(length, 0);
+	for (size_t i = 0; i < length; ++i)
+		data[i] = char(seed + i * 7);
+	return data;
+}
+
+static bool
+Fill(InputCache &cache, InputCacheItem &item, const std::string &data)
+{
+	/* append in odd sizes to cross chunk boundaries */
+	for (size_t i = 0; i < data.length(); i += 10000)
+		if (!cache.Append(item, data.data() + i,
+				  std::min<size_t>(10000, data.length() - i)))
+			return false;
+
+	return true;
+}
+
+static std::string
+ReadAll(const InputCacheItem &item)
+{
+	std::string result;
+	char buffer[7000];
+	while (result.length() < item.size) {
+		size_t nbytes = item.Read(result.length(),
+					  buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+		result.append(buffer, nbytes);
+	}
+
+	return result;
+}
+
+class InputCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(InputCacheTest);
+	CPPUNIT_TEST(TestMemory);
+	CPPUNIT_TEST(TestSpill);
+	CPPUNIT_TEST(TestEvict);
+	CPPUNIT_TEST(TestFull);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestMemory() {
+		InputCache cache(4 * CHUNK_SIZE, AllocatedPath::Null(), 0);
+		const std::string data = MakeData(3 * CHUNK_SIZE + 123, 1);
+
+		CPPUNIT_ASSERT(cache.Get("http://a/") == nullptr);
+
+		InputCacheItem *item = cache.Create("http://a/");
+		CPPUNIT_ASSERT(Fill(cache, *item, data));
+		CPPUNIT_ASSERT_EQUAL(-1, item->fd);
+		cache.Commit(*item);
+		cache.Release(*item);
+
+		item = cache.Get("http://a/");
+		CPPUNIT_ASSERT(item != nullptr);
+		CPPUNIT_ASSERT(ReadAll(*item) == data);
+		cache.Release(*item);
+	}
+
+	void TestSpill() {
+		char directory[] = "/tmp/test_input_cache.XXXXXX";
+		CPPUNIT_ASSERT(mkdtemp(directory) != nullptr);
+
+		{
+			InputCache cache(2 * CHUNK_SIZE,
+					 AllocatedPath::FromFS(directory),
+					 16 * CHUNK_SIZE);
+			const std::string data =
+				MakeData(5 * CHUNK_SIZE + 17, 2);
+
+			InputCacheItem *item = cache.Create("http://b/");
+			CPPUNIT_ASSERT(Fill(cache, *item, data));
+			CPPUNIT_ASSERT(item->fd >= 0);
+			CPPUNIT_ASSERT_EQUAL(uint64_t(2 * CHUNK_SIZE),
+					     item->memory_size);
+			CPPUNIT_ASSERT(ReadAll(*item) == data);
+			cache.Commit(*item);
+			cache.Release(*item);
+		}
+
+		/* the spill files are unlinked */
+		CPPUNIT_ASSERT_EQUAL(0, rmdir(directory));
+	}
+
+	void TestEvict() {
+		InputCache cache(4 * CHUNK_SIZE, AllocatedPath::Null(), 0);
+		const std::string data = MakeData(2 * CHUNK_SIZE, 3);
+
+		InputCacheItem *a = cache.Create("http://a/");
+		CPPUNIT_ASSERT(Fill(cache, *a, data));
+		cache.Commit(*a);
+		cache.Release(*a);
+
+		InputCacheItem *b = cache.Create("http://b/");
+		CPPUNIT_ASSERT(Fill(cache, *b, data));
+		cache.Commit(*b);
+		cache.Release(*b);
+
+		/* "a" is now the most recently used item */
+		a = cache.Get("http://a/");
+		CPPUNIT_ASSERT(a != nullptr);
+		cache.Release(*a);
+
+		InputCacheItem *c = cache.Create("http://c/");
+		CPPUNIT_ASSERT(Fill(cache, *c, data));
+		cache.Commit(*c);
+		cache.Release(*c);
+
+		CPPUNIT_ASSERT(cache.Get("http://b/") == nullptr);
+		a = cache.Get("http://a/");
+		CPPUNIT_ASSERT(a != nullptr);
+		CPPUNIT_ASSERT(ReadAll(*a) == data);
+		cache.Release(*a);
+	}
+
+	void TestFull() {
+		InputCache cache(2 * CHUNK_SIZE, AllocatedPath::Null(), 0);
+		const std::string data = MakeData(2 * CHUNK_SIZE, 4);
+
+		InputCacheItem *a = cache.Create("http://a/");
+		CPPUNIT_ASSERT(Fill(cache, *a, data));
+		cache.Commit(*a);
+
+		/* "a" is still in use and must not be evicted */
+		InputCacheItem *b = cache.Create("http://b/");
+		CPPUNIT_ASSERT(!Fill(cache, *b, data));
+		cache.Release(*b);
+
+		CPPUNIT_ASSERT(ReadAll(*a) == data);
+		cache.Release(*a);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(InputCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
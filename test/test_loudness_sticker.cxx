@@ -0,0 +1,268 @@
+/*
+ * Unit tests for src/sticker/LoudnessSticker.cxx, against a real
+ * SQLite database
+ */
+
+#include "config.h"
+#include "sticker/LoudnessSticker.hxx"
+#include "sticker/StickerDatabase.hxx"
+#include "ReplayGainInfo.hxx"
+#include "MixRampInfo.hxx"
+#include "Idle.hxx"
+#include "event/Loop.hxx"
+#include "fs/Path.hxx"
+#include "util/Domain.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void
+Log(const Domain &domain, gcc_unused LogLevel level, const char *msg)
+{
+	fprintf(stderr, "[%s] %s\n", domain.GetName(), msg);
+}
+
+void
+idle_add(gcc_unused unsigned flags)
+{
+}
+
+static ReplayGainTuple
+MakeTrack(float gain, float peak)
+{
+	ReplayGainTuple track;
+	track.gain = gain;
+	track.peak = peak;
+	return track;
+}
+
+static MixRampInfo
+MakeMixRamp(const char *start, const char *end)
+{
+	MixRampInfo mix_ramp;
+	mix_ramp.Clear();
+	mix_ramp.SetStart(start);
+	mix_ramp.SetEnd(end);
+	return mix_ramp;
+}
+
+class LoudnessStickerTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(LoudnessStickerTest);
+	CPPUNIT_TEST(TestMissing);
+	CPPUNIT_TEST(TestRoundTrip);
+	CPPUNIT_TEST(TestOverwrite);
+	CPPUNIT_TEST(TestMixRampOnly);
+	CPPUNIT_TEST(TestInvalid);
+	CPPUNIT_TEST(TestThreads);
+	CPPUNIT_TEST_SUITE_END();
+
+	char path[40];
+
+	EventLoop *loop;
+
+public:
+	void setUp() {
+		strcpy(path, "/tmp/test_loudness_sticker.XXXXXX");
+		int fd = mkstemp(path);
+		CPPUNIT_ASSERT(fd >= 0);
+		close(fd);
+
+		loop = new EventLoop();
+
+		Error error;
+		CPPUNIT_ASSERT(sticker_global_init(*loop, Path::FromFS(path),
+						   error));
+		CPPUNIT_ASSERT(sticker_enabled());
+	}
+
+	void tearDown() {
+		sticker_global_finish();
+		delete loop;
+
+		unlink(path);
+
+		/* the WAL files */
+		std::string p(path);
+		unlink((p + "-wal").c_str());
+		unlink((p + "-shm").c_str());
+	}
+
+	void TestMissing() {
+		ReplayGainInfo rgi;
+		MixRampInfo mix_ramp;
+		CPPUNIT_ASSERT(!sticker_song_load_loudness("missing.flac",
+							   rgi, mix_ramp));
+		CPPUNIT_ASSERT(!rgi.tuples[REPLAY_GAIN_TRACK].IsDefined());
+		CPPUNIT_ASSERT(!rgi.tuples[REPLAY_GAIN_ALBUM].IsDefined());
+		CPPUNIT_ASSERT(mix_ramp.GetStart() == nullptr);
+		CPPUNIT_ASSERT(mix_ramp.GetEnd() == nullptr);
+	}
+
+	void TestRoundTrip() {
+		CPPUNIT_ASSERT(sticker_song_store_loudness("a/b.flac",
+							   MakeTrack(-7.25, 0.987654),
+							   MakeMixRamp("0.00 0.00;-3.00 1.20;",
+								       "0.00 5.00;-3.00 3.40;")));
+
+		ReplayGainInfo rgi;
+		MixRampInfo mix_ramp;
+		CPPUNIT_ASSERT(sticker_song_load_loudness("a/b.flac",
+							  rgi, mix_ramp));
+
+		const auto &track = rgi.tuples[REPLAY_GAIN_TRACK];
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(-7.25, track.gain, 0.005);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(0.987654, track.peak, 0.000001);
+		CPPUNIT_ASSERT(!rgi.tuples[REPLAY_GAIN_ALBUM].IsDefined());
+
+		CPPUNIT_ASSERT(mix_ramp.GetStart() != nullptr);
+		CPPUNIT_ASSERT_EQUAL(std::string("0.00 0.00;-3.00 1.20;"),
+				     std::string(mix_ramp.GetStart()));
+		CPPUNIT_ASSERT(mix_ramp.GetEnd() != nullptr);
+		CPPUNIT_ASSERT_EQUAL(std::string("0.00 5.00;-3.00 3.40;"),
+				     std::string(mix_ramp.GetEnd()));
+
+		/* other songs are not affected */
+		CPPUNIT_ASSERT(!sticker_song_load_loudness("a/c.flac",
+							   rgi, mix_ramp));
+	}
+
+	void TestOverwrite() {
+		CPPUNIT_ASSERT(sticker_song_store_loudness("x.ogg",
+							   MakeTrack(3, 0.5),
+							   MakeMixRamp("1", "2")));
+		CPPUNIT_ASSERT(sticker_song_store_loudness("x.ogg",
+							   MakeTrack(-1.5, 0.25),
+							   MakeMixRamp("3", "4")));
+
+		ReplayGainInfo rgi;
+		MixRampInfo mix_ramp;
+		CPPUNIT_ASSERT(sticker_song_load_loudness("x.ogg",
+							  rgi, mix_ramp));
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(-1.5,
+					     rgi.tuples[REPLAY_GAIN_TRACK].gain,
+					     0.005);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25,
+					     rgi.tuples[REPLAY_GAIN_TRACK].peak,
+					     0.000001);
+		CPPUNIT_ASSERT_EQUAL(std::string("3"),
+				     std::string(mix_ramp.GetStart()));
+		CPPUNIT_ASSERT_EQUAL(std::string("4"),
+				     std::string(mix_ramp.GetEnd()));
+
+		/* one row per name */
+		unsigned n = 0;
+		sticker *s = sticker_load("song", "x.ogg");
+		CPPUNIT_ASSERT(s != nullptr);
+		sticker_foreach(*s, [](gcc_unused const char *name,
+				       gcc_unused const char *value,
+				       void *ctx){
+					++*(unsigned *)ctx;
+				}, &n);
+		sticker_free(s);
+		CPPUNIT_ASSERT_EQUAL(4u, n);
+	}
+
+	void TestMixRampOnly() {
+		ReplayGainTuple track;
+		track.Clear();
+		CPPUNIT_ASSERT(sticker_song_store_loudness("m.mp3", track,
+							   MakeMixRamp("5", nullptr)));
+
+		ReplayGainInfo rgi;
+		MixRampInfo mix_ramp;
+		CPPUNIT_ASSERT(!sticker_song_load_loudness("m.mp3",
+							   rgi, mix_ramp));
+		CPPUNIT_ASSERT(!rgi.tuples[REPLAY_GAIN_TRACK].IsDefined());
+		CPPUNIT_ASSERT_EQUAL(std::string("5"),
+				     std::string(mix_ramp.GetStart()));
+		CPPUNIT_ASSERT(mix_ramp.GetEnd() == nullptr);
+	}
+
+	void TestInvalid() {
+		/* stickers edited by a client */
+		CPPUNIT_ASSERT(sticker_store_value("song", "i.wav",
+						   "replaygain_track_gain",
+						   "loud"));
+		CPPUNIT_ASSERT(sticker_store_value("song", "i.wav",
+						   "replaygain_track_peak",
+						   "0.5"));
+
+		ReplayGainInfo rgi;
+		MixRampInfo mix_ramp;
+		CPPUNIT_ASSERT(!sticker_song_load_loudness("i.wav",
+							   rgi, mix_ramp));
+		CPPUNIT_ASSERT(!rgi.tuples[REPLAY_GAIN_TRACK].IsDefined());
+	}
+
+	/**
+	 * The analysis threads and the decoder thread access the
+	 * sticker database concurrently.
+	 */
+	void TestThreads() {
+		static constexpr unsigned N_THREADS = 4, N_SONGS = 50;
+
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < N_THREADS; ++t) {
+			threads.emplace_back([t](){
+					for (unsigned i = 0; i < N_SONGS; ++i) {
+						char uri[32];
+						snprintf(uri, sizeof(uri),
+							 "%u/%u.flac", t, i);
+
+						const float gain = float(i) / 4;
+						sticker_song_store_loudness(uri,
+									    MakeTrack(gain, 0.5),
+									    MakeMixRamp("1", "2"));
+
+						ReplayGainInfo rgi;
+						MixRampInfo mix_ramp;
+						if (!sticker_song_load_loudness(uri, rgi,
+										mix_ramp) ||
+						    rgi.tuples[REPLAY_GAIN_TRACK].gain != gain)
+							abort();
+					}
+				});
+		}
+
+		for (auto &i : threads)
+			i.join();
+
+		for (unsigned t = 0; t < N_THREADS; ++t) {
+			for (unsigned i = 0; i < N_SONGS; ++i) {
+				char uri[32];
+				snprintf(uri, sizeof(uri), "%u/%u.flac", t, i);
+
+				ReplayGainInfo rgi;
+				MixRampInfo mix_ramp;
+				CPPUNIT_ASSERT(sticker_song_load_loudness(uri, rgi,
+									  mix_ramp));
+				CPPUNIT_ASSERT_DOUBLES_EQUAL(float(i) / 4,
+							     rgi.tuples[REPLAY_GAIN_TRACK].gain,
+							     0.005);
+			}
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LoudnessStickerTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -3,7 +3,7 @@
  */
 
 #include "config.h"
-#include "CrossFade.cxx"
+#include "MixRampCurve.hxx"
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -12,6 +12,14 @@
 
 #include <string.h>
 
+static float
+mixramp_interpolate(const char *ramp_list, float required_db)
+{
+	MixRampCurve curve;
+	curve.Parse(ramp_list);
+	return curve.Interpolate(required_db);
+}
+
 class MixRampTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(MixRampTest);
 	CPPUNIT_TEST(TestInterpolate);
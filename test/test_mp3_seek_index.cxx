@@ -0,0 +1,151 @@
+/*
+ * Unit tests for src/decoder/plugins/Mp3SeekIndex.cxx
+ */
+
+#include "config.h"
+#include "decoder/plugins/Mp3SeekIndex.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static constexpr unsigned INTERVAL = Mp3SeekIndex::INTERVAL;
+
+static void
+Fill(Mp3SeekIndex &index, unsigned long n)
+{
+	/* frames of 417 bytes after a 1000 byte ID3 tag */
+	for (unsigned long i = 0; i < n; ++i)
+		index.Append(1000 + i * 417);
+}
+
+class Mp3SeekIndexTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(Mp3SeekIndexTest);
+	CPPUNIT_TEST(TestLookup);
+	CPPUNIT_TEST(TestSaveLoad);
+	CPPUNIT_TEST(TestStale);
+	CPPUNIT_TEST(TestPath);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestLookup() {
+		Mp3SeekIndex index;
+		unsigned long frame;
+		uint64_t offset;
+		CPPUNIT_ASSERT(!index.Lookup(0, frame, offset));
+
+		Fill(index, 10 * INTERVAL + 5);
+		CPPUNIT_ASSERT_EQUAL(10ul * INTERVAL + 5, index.GetFrameCount());
+
+		CPPUNIT_ASSERT(index.Lookup(0, frame, offset));
+		CPPUNIT_ASSERT_EQUAL(0ul, frame);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1000), offset);
+
+		CPPUNIT_ASSERT(index.Lookup(3 * INTERVAL + 7, frame, offset));
+		CPPUNIT_ASSERT_EQUAL(3ul * INTERVAL, frame);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1000 + frame * 417), offset);
+
+		CPPUNIT_ASSERT(index.Lookup(10 * INTERVAL + 4, frame, offset));
+		CPPUNIT_ASSERT_EQUAL(10ul * INTERVAL, frame);
+
+		CPPUNIT_ASSERT(!index.Lookup(10 * INTERVAL + 5, frame, offset));
+	}
+
+	void TestSaveLoad() {
+		char directory[] = "/tmp/test_mp3_seek_index.XXXXXX";
+		CPPUNIT_ASSERT(mkdtemp(directory) != nullptr);
+
+		const auto path = AllocatedPath::Build(directory, "index");
+
+		Mp3SeekIndex index;
+		Fill(index, 5 * INTERVAL + 1);
+
+		Error error;
+		CPPUNIT_ASSERT(index.Save(path, "/music/a.mp3", 123456, error));
+
+		Mp3SeekIndex loaded;
+		CPPUNIT_ASSERT(loaded.Load(path, "/music/a.mp3", 123456));
+		CPPUNIT_ASSERT_EQUAL(index.GetFrameCount(),
+				     loaded.GetFrameCount());
+
+		for (unsigned long i = 0; i < index.GetFrameCount(); i += 7) {
+			unsigned long a_frame, b_frame;
+			uint64_t a_offset, b_offset;
+			CPPUNIT_ASSERT(index.Lookup(i, a_frame, a_offset));
+			CPPUNIT_ASSERT(loaded.Lookup(i, b_frame, b_offset));
+			CPPUNIT_ASSERT_EQUAL(a_frame, b_frame);
+			CPPUNIT_ASSERT_EQUAL(a_offset, b_offset);
+		}
+
+		CPPUNIT_ASSERT(RemoveFile(path));
+		CPPUNIT_ASSERT_EQUAL(0, rmdir(directory));
+	}
+
+	void TestStale() {
+		char directory[] = "/tmp/test_mp3_seek_index.XXXXXX";
+		CPPUNIT_ASSERT(mkdtemp(directory) != nullptr);
+
+		const auto path = AllocatedPath::Build(directory, "index");
+
+		Mp3SeekIndex index;
+		Fill(index, 3 * INTERVAL);
+
+		Error error;
+		CPPUNIT_ASSERT(index.Save(path, "/music/a.mp3", 1000, error));
+
+		Mp3SeekIndex loaded;
+
+		/* the file has been modified */
+		CPPUNIT_ASSERT(!loaded.Load(path, "/music/a.mp3", 1001));
+		CPPUNIT_ASSERT(loaded.IsEmpty());
+
+		/* hash collision */
+		CPPUNIT_ASSERT(!loaded.Load(path, "/music/b.mp3", 1000));
+		CPPUNIT_ASSERT(!loaded.Load(path, "/music/a.mp", 1000));
+
+		/* truncated file */
+		CPPUNIT_ASSERT_EQUAL(0, truncate(path.c_str(), 40));
+		CPPUNIT_ASSERT(!loaded.Load(path, "/music/a.mp3", 1000));
+		CPPUNIT_ASSERT(loaded.IsEmpty());
+
+		CPPUNIT_ASSERT(RemoveFile(path));
+
+		/* missing file */
+		CPPUNIT_ASSERT(!loaded.Load(path, "/music/a.mp3", 1000));
+
+		CPPUNIT_ASSERT_EQUAL(0, rmdir(directory));
+	}
+
+	void TestPath() {
+		const auto directory = AllocatedPath::FromFS("/var/cache");
+		const auto a = mp3_seek_index_path(directory, "/music/a.mp3");
+		const auto b = mp3_seek_index_path(directory, "/music/b.mp3");
+
+		CPPUNIT_ASSERT(strncmp(a.c_str(), "/var/cache/", 11) == 0);
+		CPPUNIT_ASSERT_EQUAL(size_t(11 + 16), strlen(a.c_str()));
+		CPPUNIT_ASSERT(strcmp(a.c_str(), b.c_str()) != 0);
+		CPPUNIT_ASSERT(strcmp(a.c_str(),
+				      mp3_seek_index_path(directory,
+							  "/music/a.mp3").c_str()) == 0);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(Mp3SeekIndexTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
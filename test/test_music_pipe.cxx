@@ -0,0 +1,257 @@
+/*
+ * Unit tests for src/MusicPipe.cxx and src/MusicBuffer.cxx
+ */
+
+#include "config.h"
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "AudioFormat.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Util.hxx"
+#include "util/Error.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+static constexpr AudioFormat test_audio_format(44100, SampleFormat::S16, 2);
+static constexpr AudioFormat other_audio_format(48000, SampleFormat::S32, 2);
+
+static music_chunk *
+MakeChunk(MusicBuffer &buffer, unsigned n,
+	  AudioFormat audio_format=test_audio_format)
+{
+	music_chunk *chunk;
+	while ((chunk = buffer.Allocate()) == nullptr)
+		YieldThread();
+
+	auto w = chunk->Write(audio_format, 0, 0);
+	memcpy(w.data, &n, sizeof(n));
+	chunk->Expand(audio_format, audio_format.GetFrameSize());
+	return chunk;
+}
+
+static unsigned
+GetChunkNumber(const music_chunk *chunk)
+{
+	unsigned n;
+	memcpy(&n, chunk->data, sizeof(n));
+	return n;
+}
+
+/**
+ * One producer thread and one consumer thread (the caller of Run())
+ * sharing a #MusicPipe.
+ */
+struct PipeStress {
+	static constexpr unsigned N = 100000;
+
+	/**
+	 * The producer switches the audio format after this many
+	 * chunks, after the consumer has drained the pipe, like the
+	 * decoder at the beginning of a new song.
+	 */
+	static constexpr unsigned SONG_LENGTH = 10000;
+
+	MusicBuffer buffer;
+	MusicPipe pipe;
+
+	explicit PipeStress(bool lock_free)
+		:buffer(16, DEFAULT_CHUNK_SIZE), pipe(lock_free) {}
+
+	static AudioFormat GetAudioFormat(unsigned i) {
+		return (i / SONG_LENGTH) % 2 == 0
+			? test_audio_format
+			: other_audio_format;
+	}
+
+	static void Producer(void *ctx) {
+		PipeStress &s = *(PipeStress *)ctx;
+		for (unsigned i = 0; i < N; ++i) {
+			if (i > 0 && i % SONG_LENGTH == 0)
+				while (!s.pipe.IsEmpty())
+					YieldThread();
+
+			s.pipe.Push(MakeChunk(s.buffer, i, GetAudioFormat(i)));
+		}
+	}
+
+	void Run() {
+		Thread thread;
+		Error error;
+		CPPUNIT_ASSERT(thread.Start(Producer, this, error));
+
+		for (unsigned i = 0; i < N;) {
+			const music_chunk *peek = pipe.Peek();
+			if (peek == nullptr) {
+				YieldThread();
+				continue;
+			}
+
+			/* only the consumer removes chunks, so the
+			   head cannot change in between */
+			music_chunk *chunk = pipe.Shift();
+			CPPUNIT_ASSERT(chunk == peek);
+
+			CPPUNIT_ASSERT_EQUAL(i, GetChunkNumber(chunk));
+#ifndef NDEBUG
+			CPPUNIT_ASSERT(chunk->CheckFormat(GetAudioFormat(i)));
+#endif
+			buffer.Return(chunk);
+			++i;
+		}
+
+		thread.Join();
+		CPPUNIT_ASSERT(pipe.IsEmpty());
+		CPPUNIT_ASSERT(pipe.Peek() == nullptr);
+	}
+};
+
+class MusicPipeTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MusicPipeTest);
+	CPPUNIT_TEST(TestOrder);
+	CPPUNIT_TEST(TestLockedStress);
+	CPPUNIT_TEST(TestLockFreeStress);
+	CPPUNIT_TEST(TestBufferCache);
+	CPPUNIT_TEST(TestChunkSize);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestOrder() {
+		MusicBuffer buffer(8, DEFAULT_CHUNK_SIZE);
+
+		for (bool lock_free : {false, true}) {
+			MusicPipe pipe(lock_free);
+			CPPUNIT_ASSERT(pipe.IsEmpty());
+			CPPUNIT_ASSERT_EQUAL((const music_chunk *)nullptr,
+					     pipe.Peek());
+
+			/* refill after draining, to check that the
+			   tail is reset properly */
+			for (unsigned round = 0; round < 2; ++round) {
+				for (unsigned i = 0; i < 4; ++i)
+					pipe.Push(MakeChunk(buffer, i));
+
+				CPPUNIT_ASSERT_EQUAL(4u, pipe.GetSize());
+				CPPUNIT_ASSERT_EQUAL(0u, GetChunkNumber(pipe.Peek()));
+				CPPUNIT_ASSERT_EQUAL(1u, GetChunkNumber(pipe.Peek()->next));
+
+				for (unsigned i = 0; i < 4; ++i) {
+					music_chunk *chunk = pipe.Shift();
+					CPPUNIT_ASSERT(chunk != nullptr);
+					CPPUNIT_ASSERT_EQUAL(i, GetChunkNumber(chunk));
+					buffer.Return(chunk);
+				}
+
+				CPPUNIT_ASSERT(pipe.IsEmpty());
+				CPPUNIT_ASSERT_EQUAL((music_chunk *)nullptr,
+						     pipe.Shift());
+			}
+
+			pipe.Push(MakeChunk(buffer, 42));
+			pipe.Clear(buffer);
+			CPPUNIT_ASSERT(pipe.IsEmpty());
+		}
+	}
+
+	void TestLockedStress() {
+		PipeStress s(false);
+		CPPUNIT_ASSERT(!s.pipe.IsLockFree());
+		s.Run();
+	}
+
+	void TestLockFreeStress() {
+		PipeStress s(true);
+		CPPUNIT_ASSERT(s.pipe.IsLockFree());
+		s.Run();
+	}
+
+	void TestBufferCache() {
+		/* 64 chunks make a batch size of 4 */
+		MusicBuffer buffer(64, DEFAULT_CHUNK_SIZE);
+
+		{
+			MusicBufferCache cache(buffer);
+			music_chunk *chunks[64];
+
+			for (unsigned i = 0; i < 64; ++i) {
+				chunks[i] = cache.Allocate();
+				CPPUNIT_ASSERT(chunks[i] != nullptr);
+			}
+
+			CPPUNIT_ASSERT_EQUAL((music_chunk *)nullptr,
+					     cache.Allocate());
+
+			for (unsigned i = 0; i < 64; ++i)
+				cache.Return(chunks[i]);
+
+			/* a returned chunk is reused without
+			   touching the global pool */
+			const unsigned long hits =
+				buffer.GetStats().global_hits;
+			chunks[0] = cache.Allocate();
+			CPPUNIT_ASSERT(chunks[0] != nullptr);
+			CPPUNIT_ASSERT(chunks[0]->IsEmpty());
+			CPPUNIT_ASSERT_EQUAL(hits,
+					     buffer.GetStats().global_hits);
+			cache.Return(chunks[0]);
+		}
+
+		const MusicBuffer::Stats stats = buffer.GetStats();
+		CPPUNIT_ASSERT_EQUAL(65ul, stats.allocations);
+		CPPUNIT_ASSERT_EQUAL(65ul, stats.returns);
+		CPPUNIT_ASSERT(stats.global_hits < 64);
+
+		/* the cache has given everything back */
+		music_chunk *chunks[64];
+		CPPUNIT_ASSERT_EQUAL(64u, buffer.AllocateBatch(chunks, 64));
+		buffer.ReturnBatch(chunks, 64);
+	}
+
+	void TestChunkSize() {
+		/* not a multiple of the frame size (4 bytes) */
+		static constexpr size_t chunk_size = 1002;
+		MusicBuffer buffer(4, chunk_size);
+		CPPUNIT_ASSERT_EQUAL(chunk_size, buffer.GetChunkSize());
+
+		music_chunk *chunks[4];
+		for (unsigned i = 0; i < 4; ++i) {
+			chunks[i] = buffer.Allocate();
+			CPPUNIT_ASSERT(chunks[i] != nullptr);
+
+			auto w = chunks[i]->Write(test_audio_format, 0, 0);
+			CPPUNIT_ASSERT_EQUAL(size_t(1000), w.size);
+			memset(w.data, 'a' + i, w.size);
+			CPPUNIT_ASSERT(chunks[i]->Expand(test_audio_format,
+							 w.size));
+			CPPUNIT_ASSERT(chunks[i]->Write(test_audio_format,
+							0, 0).IsNull());
+		}
+
+		/* the payloads must not overlap */
+		for (unsigned i = 0; i < 4; ++i) {
+			CPPUNIT_ASSERT_EQUAL(uint8_t('a' + i),
+					     chunks[i]->data[0]);
+			CPPUNIT_ASSERT_EQUAL(uint8_t('a' + i),
+					     chunks[i]->data[999]);
+			buffer.Return(chunks[i]);
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MusicPipeTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
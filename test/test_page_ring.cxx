@@ -0,0 +1,165 @@
+/*
+ * Unit tests for src/output/plugins/httpd/PageRing.cxx
+ */
+
+#include "config.h"
+#include "output/plugins/httpd/PageRing.hxx"
+#include "output/plugins/httpd/Page.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static Page *
+MakePage(size_t size, unsigned char value)
+{
+	unsigned char buffer[64 * 1024];
+	memset(buffer, value, size);
+	return Page::Copy(buffer, size);
+}
+
+class PageRingTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PageRingTest);
+	CPPUNIT_TEST(TestPush);
+	CPPUNIT_TEST(TestCapacity);
+	CPPUNIT_TEST(TestSize);
+	CPPUNIT_TEST(TestClear);
+	CPPUNIT_TEST(TestTime);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestPush() {
+		PageRing ring;
+		CPPUNIT_ASSERT(ring.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(ring.GetTail(), ring.GetHead());
+
+		for (unsigned i = 0; i < 10; ++i) {
+			Page *page = MakePage(100 + i, i);
+			ring.Push(*page, i);
+
+			/* the ring holds its own reference */
+			CPPUNIT_ASSERT(!page->Unref());
+		}
+
+		CPPUNIT_ASSERT(!ring.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(PageRing::Position(0), ring.GetTail());
+		CPPUNIT_ASSERT_EQUAL(PageRing::Position(10), ring.GetHead());
+
+		for (unsigned i = 0; i < 10; ++i) {
+			const Page &page = ring.Get(i);
+			CPPUNIT_ASSERT_EQUAL(size_t(100 + i), page.size);
+			CPPUNIT_ASSERT_EQUAL((unsigned char)i, page.data[0]);
+		}
+	}
+
+	void TestCapacity() {
+		PageRing ring;
+
+		for (unsigned i = 0; i < 2000; ++i) {
+			Page *page = MakePage(16, i);
+			ring.Push(*page, i);
+			page->Unref();
+		}
+
+		CPPUNIT_ASSERT_EQUAL(PageRing::Position(2000),
+				     ring.GetHead());
+		CPPUNIT_ASSERT(ring.GetHead() - ring.GetTail() < 2000);
+
+		/* the newest pages are still there */
+		for (auto i = ring.GetTail(); i != ring.GetHead(); ++i)
+			CPPUNIT_ASSERT_EQUAL((unsigned char)i,
+					     ring.Get(i).data[0]);
+	}
+
+	void TestSize() {
+		PageRing ring;
+
+		/* a client which holds a reference keeps the page
+		   alive after the ring has dropped it */
+		Page *first = MakePage(32768, 1);
+		ring.Push(*first, 0);
+
+		for (unsigned i = 0; i < 64; ++i) {
+			Page *page = MakePage(32768, 2);
+			ring.Push(*page, i + 1);
+			page->Unref();
+		}
+
+		CPPUNIT_ASSERT(ring.GetTail() > 0);
+		CPPUNIT_ASSERT(ring.GetHead() - ring.GetTail() <= 8);
+		CPPUNIT_ASSERT_EQUAL((unsigned char)1, first->data[0]);
+		CPPUNIT_ASSERT(first->Unref());
+	}
+
+	void TestClear() {
+		PageRing ring;
+
+		for (unsigned i = 0; i < 5; ++i) {
+			Page *page = MakePage(10, i);
+			ring.Push(*page, i);
+			page->Unref();
+		}
+
+		ring.Clear();
+		CPPUNIT_ASSERT(ring.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(PageRing::Position(5), ring.GetTail());
+		CPPUNIT_ASSERT_EQUAL(PageRing::Position(5), ring.GetHead());
+
+		Page *page = MakePage(10, 42);
+		ring.Push(*page, 5);
+		page->Unref();
+		CPPUNIT_ASSERT_EQUAL(PageRing::Position(5), ring.GetTail());
+		CPPUNIT_ASSERT_EQUAL((unsigned char)42, ring.Get(5).data[0]);
+	}
+
+	void TestTime() {
+		PageRing ring;
+		ring.SetKeepTime(3);
+
+		/* two 64 kB pages per second: the size limit alone
+		   would keep only two seconds */
+		for (unsigned i = 0; i < 40; ++i) {
+			Page *page = MakePage(65536, i);
+			ring.Push(*page, 0.5 * (i + 1));
+			page->Unref();
+		}
+
+		CPPUNIT_ASSERT_EQUAL(20.0, ring.GetNewestTime());
+
+		/* the pages of the last three seconds are still
+		   there */
+		CPPUNIT_ASSERT_EQUAL(ring.GetHead() - 6, ring.GetTail());
+
+		const auto start = ring.FindTime(0, 18.0);
+		CPPUNIT_ASSERT_EQUAL(ring.GetHead() - 5, start);
+		CPPUNIT_ASSERT_EQUAL((unsigned char)35,
+				     ring.Get(start).data[0]);
+
+		/* the start position is honoured */
+		CPPUNIT_ASSERT_EQUAL(ring.GetHead() - 2,
+				     ring.FindTime(ring.GetHead() - 2, 10.0));
+
+		/* older than the oldest page */
+		CPPUNIT_ASSERT_EQUAL(ring.GetTail(), ring.FindTime(0, 1.0));
+
+		/* nothing is that new */
+		CPPUNIT_ASSERT_EQUAL(ring.GetHead(),
+				     ring.FindTime(0, 21.0));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PageRingTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -45,6 +45,25 @@ public:
 	void TestUnpack24();
 };
 
+class PcmInterleaveTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmInterleaveTest);
+	CPPUNIT_TEST(TestInterleave8);
+	CPPUNIT_TEST(TestInterleave16);
+	CPPUNIT_TEST(TestInterleave32);
+	CPPUNIT_TEST(TestInterleave64);
+	CPPUNIT_TEST(TestInterleaveNarrow16);
+	CPPUNIT_TEST(TestDeinterleave32);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestInterleave8();
+	void TestInterleave16();
+	void TestInterleave32();
+	void TestInterleave64();
+	void TestInterleaveNarrow16();
+	void TestDeinterleave32();
+};
+
 class PcmChannelsTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmChannelsTest);
 	CPPUNIT_TEST(TestChannels16);
@@ -56,6 +75,25 @@ public:
 	void TestChannels32();
 };
 
+class PcmExportTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmExportTest);
+	CPPUNIT_TEST(TestPack24);
+	CPPUNIT_TEST(TestShift8);
+	CPPUNIT_TEST(TestReverse16);
+	CPPUNIT_TEST(TestReverse32);
+	CPPUNIT_TEST(TestDsdUsb);
+	CPPUNIT_TEST(TestExport);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestPack24();
+	void TestShift8();
+	void TestReverse16();
+	void TestReverse32();
+	void TestDsdUsb();
+	void TestExport();
+};
+
 class PcmVolumeTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmVolumeTest);
 	CPPUNIT_TEST(TestVolume8);
@@ -63,6 +101,10 @@ class PcmVolumeTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestVolume24);
 	CPPUNIT_TEST(TestVolume32);
 	CPPUNIT_TEST(TestVolumeFloat);
+	CPPUNIT_TEST(TestVolume16NoDither);
+	CPPUNIT_TEST(TestVolumeFloatNoDither);
+	CPPUNIT_TEST(TestRamp16);
+	CPPUNIT_TEST(TestRampFloat);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -71,6 +113,10 @@ public:
 	void TestVolume24();
 	void TestVolume32();
 	void TestVolumeFloat();
+	void TestVolume16NoDither();
+	void TestVolumeFloatNoDither();
+	void TestRamp16();
+	void TestRampFloat();
 };
 
 class PcmFormatTest : public CppUnit::TestFixture {
@@ -79,6 +125,10 @@ class PcmFormatTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestFormat16to24);
 	CPPUNIT_TEST(TestFormat16to32);
 	CPPUNIT_TEST(TestFormatFloat);
+	CPPUNIT_TEST(TestFormat24to32);
+	CPPUNIT_TEST(TestFormat32to24);
+	CPPUNIT_TEST(TestFormatToFloat);
+	CPPUNIT_TEST(TestFormatFromFloat);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -86,6 +136,10 @@ public:
 	void TestFormat16to24();
 	void TestFormat16to32();
 	void TestFormatFloat();
+	void TestFormat24to32();
+	void TestFormat32to24();
+	void TestFormatToFloat();
+	void TestFormatFromFloat();
 };
 
 class PcmMixTest : public CppUnit::TestFixture {
@@ -94,6 +148,11 @@ class PcmMixTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestMix16);
 	CPPUNIT_TEST(TestMix24);
 	CPPUNIT_TEST(TestMix32);
+	CPPUNIT_TEST(TestAdd16);
+	CPPUNIT_TEST(TestAdd24);
+	CPPUNIT_TEST(TestAdd32);
+	CPPUNIT_TEST(TestAddFloat);
+	CPPUNIT_TEST(TestMixFloat);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -101,6 +160,39 @@ public:
 	void TestMix16();
 	void TestMix24();
 	void TestMix32();
+	void TestAdd16();
+	void TestAdd24();
+	void TestAdd32();
+	void TestAddFloat();
+	void TestMixFloat();
+};
+
+class PcmResampleTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmResampleTest);
+	CPPUNIT_TEST(TestDot);
+	CPPUNIT_TEST(TestChunks);
+	CPPUNIT_TEST(TestSine);
+	CPPUNIT_TEST(TestAliasing);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestDot();
+	void TestChunks();
+	void TestSine();
+	void TestAliasing();
+};
+
+class PcmLoudnessTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmLoudnessTest);
+	CPPUNIT_TEST(TestSine);
+	CPPUNIT_TEST(TestSilence);
+	CPPUNIT_TEST(TestMixRamp);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestSine();
+	void TestSilence();
+	void TestMixRamp();
 };
 
 #endif
@@ -50,6 +50,21 @@ PcmChannelsTest::TestChannels16()
 		CPPUNIT_ASSERT_EQUAL(src[i], dest[i * 2]);
 		CPPUNIT_ASSERT_EQUAL(src[i], dest[i * 2 + 1]);
 	}
+
+	/* 5.1 to stereo */
+
+	constexpr size_t N6 = N * 2 / 6;
+	dest = pcm_convert_channels_16(buffer, 2, 6, { src, N6 * 6 });
+	CPPUNIT_ASSERT(!dest.IsNull());
+	CPPUNIT_ASSERT_EQUAL(N6 * 2, dest.size);
+	for (unsigned i = 0; i < N6; ++i) {
+		int sum = 0;
+		for (unsigned c = 0; c < 6; ++c)
+			sum += src[i * 6 + c];
+
+		CPPUNIT_ASSERT_EQUAL(int16_t(sum / 6), dest[i * 2]);
+		CPPUNIT_ASSERT_EQUAL(int16_t(sum / 6), dest[i * 2 + 1]);
+	}
 }
 
 void
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/PcmExport.hxx"
+#include "pcm/PcmExportSimd.hxx"
+#include "pcm/SimdLevel.hxx"
+#include "system/ByteOrder.hxx"
+
+#include <string.h>
+
+/*
+ * The vectorised kernels are compared with straightforward scalar
+ * implementations on random input.  Each kernel is called at all
+ * offsets within a vector and with all lengths up to a few vectors,
+ * and the samples it claims to have processed must be bit-exact.
+ */
+
+static constexpr size_t N = 509;
+
+/**
+ * The longest vector is 32 bytes (AVX2), i.e. 8 32 bit samples; use
+ * lengths and offsets which cover several of them.
+ */
+static constexpr size_t MAX_OFFSET = 8;
+static constexpr size_t MAX_LENGTH = 100;
+
+static bool
+HaveSimd()
+{
+	return GetSimdLevel() != SimdLevel::NONE;
+}
+
+static void
+ReferencePack24(uint8_t *dest, const int32_t *src, size_t n, bool reverse)
+{
+	for (size_t i = 0; i < n; ++i) {
+		const uint32_t x = src[i];
+		const uint8_t b0 = x, b1 = x >> 8, b2 = x >> 16;
+
+		*dest++ = reverse ? b2 : b0;
+		*dest++ = b1;
+		*dest++ = reverse ? b0 : b2;
+	}
+}
+
+static void
+ReferenceDsdUsb(uint32_t *dest, const uint8_t *src, size_t n, bool odd)
+{
+	for (size_t i = 0; i < n; ++i, odd = !odd) {
+		const uint32_t marker = odd ? 0xfa : 0x05;
+
+		for (unsigned c = 0; c < 2; ++c)
+			*dest++ = 0xff000000 | (marker << 16) |
+				(src[c] << 8) | src[2 + c];
+
+		src += 4;
+	}
+}
+
+void
+PcmExportTest::TestPack24()
+{
+	if (IsBigEndian())
+		/* the kernels are not used on big-endian hosts */
+		return;
+
+	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
+
+	for (const bool reverse : {false, true}) {
+		for (size_t offset = 0; offset < MAX_OFFSET; ++offset) {
+			for (size_t n = 0; n <= MAX_LENGTH; ++n) {
+				uint8_t dest[MAX_LENGTH * 3];
+				const size_t done =
+					pcm_export_simd_pack24(dest,
+							       src + offset,
+							       n, reverse);
+				CPPUNIT_ASSERT(done <= n);
+
+				uint8_t expected[MAX_LENGTH * 3];
+				ReferencePack24(expected, src + offset, done,
+						reverse);
+				CPPUNIT_ASSERT_EQUAL(0, memcmp(dest, expected,
+							       done * 3));
+			}
+		}
+	}
+}
+
+void
+PcmExportTest::TestShift8()
+{
+	const auto src = TestDataBuffer<uint32_t, N>();
+
+	for (const bool reverse : {false, true}) {
+		for (size_t offset = 0; offset < MAX_OFFSET; ++offset) {
+			for (size_t n = 0; n <= MAX_LENGTH; ++n) {
+				uint32_t dest[MAX_LENGTH];
+				const size_t done =
+					pcm_export_simd_shift8(dest,
+							       src + offset,
+							       n, reverse);
+				CPPUNIT_ASSERT(done <= n);
+				if (HaveSimd() && n >= 16)
+					CPPUNIT_ASSERT(done > 0);
+
+				for (size_t i = 0; i < done; ++i) {
+					uint32_t x = src[offset + i] << 8;
+					if (reverse)
+						x = ByteSwap32(x);
+					CPPUNIT_ASSERT_EQUAL(x, dest[i]);
+				}
+			}
+		}
+	}
+}
+
+void
+PcmExportTest::TestReverse16()
+{
+	const auto src = TestDataBuffer<uint16_t, N>();
+
+	for (size_t offset = 0; offset < MAX_OFFSET * 2; ++offset) {
+		for (size_t n = 0; n <= MAX_LENGTH; ++n) {
+			uint16_t dest[MAX_LENGTH];
+			const size_t done =
+				pcm_export_simd_reverse_16(dest, src + offset,
+							   n);
+			CPPUNIT_ASSERT(done <= n);
+			if (HaveSimd() && n >= 32)
+				CPPUNIT_ASSERT(done > 0);
+
+			for (size_t i = 0; i < done; ++i)
+				CPPUNIT_ASSERT_EQUAL(ByteSwap16(src[offset + i]),
+						     dest[i]);
+		}
+	}
+}
+
+void
+PcmExportTest::TestReverse32()
+{
+	const auto src = TestDataBuffer<uint32_t, N>();
+
+	for (size_t offset = 0; offset < MAX_OFFSET; ++offset) {
+		for (size_t n = 0; n <= MAX_LENGTH; ++n) {
+			uint32_t dest[MAX_LENGTH];
+			const size_t done =
+				pcm_export_simd_reverse_32(dest, src + offset,
+							   n);
+			CPPUNIT_ASSERT(done <= n);
+			if (HaveSimd() && n >= 16)
+				CPPUNIT_ASSERT(done > 0);
+
+			for (size_t i = 0; i < done; ++i)
+				CPPUNIT_ASSERT_EQUAL(ByteSwap32(src[offset + i]),
+						     dest[i]);
+		}
+	}
+}
+
+void
+PcmExportTest::TestDsdUsb()
+{
+	const auto src = TestDataBuffer<uint8_t, N * 4>();
+
+	for (const bool odd : {false, true}) {
+		for (size_t offset = 0; offset < MAX_OFFSET * 4; ++offset) {
+			for (size_t n = 0; n <= MAX_LENGTH; ++n) {
+				uint32_t dest[MAX_LENGTH * 2];
+				const size_t done =
+					pcm_export_simd_dsd_usb_stereo(dest,
+								       src + offset,
+								       n, odd);
+				CPPUNIT_ASSERT(done <= n);
+
+				uint32_t expected[MAX_LENGTH * 2];
+				ReferenceDsdUsb(expected, src + offset, done,
+						odd);
+				CPPUNIT_ASSERT_EQUAL(0, memcmp(dest, expected,
+							       done * 8));
+			}
+		}
+	}
+}
+
+/**
+ * The whole export chain (kernel plus scalar tail, and the block
+ * loop of DSD-over-USB) must produce the scalar result.
+ */
+void
+PcmExportTest::TestExport()
+{
+	if (IsBigEndian())
+		return;
+
+	const auto src = TestDataBuffer<int32_t, N * 2>(RandomInt24());
+
+	PcmExport e;
+	e.Open(SampleFormat::S24_P32, 2, false, false, true, true);
+
+	size_t size;
+	const void *dest = e.Export(src, sizeof(int32_t) * N * 2, size);
+	CPPUNIT_ASSERT_EQUAL(N * 2 * 3, size);
+
+	uint8_t expected[N * 2 * 3];
+	ReferencePack24(expected, src, N * 2, true);
+	CPPUNIT_ASSERT_EQUAL(0, memcmp(dest, expected, size));
+
+	/* more than one DSD_USB_BLOCK_SAMPLES block, with a
+	   stage after the conversion */
+	constexpr size_t n_dsd_frames = 1500;
+	static uint8_t dsd[n_dsd_frames * 2 * 2];
+	RandomInt<uint8_t> g;
+	for (auto &i : dsd)
+		i = g();
+
+	e.Open(SampleFormat::DSD, 2, true, false, false, true);
+	dest = e.Export(dsd, sizeof(dsd), size);
+	CPPUNIT_ASSERT_EQUAL(n_dsd_frames * 2 * 4, size);
+
+	static uint32_t usb[n_dsd_frames * 2];
+	ReferenceDsdUsb(usb, dsd, n_dsd_frames, false);
+	const uint32_t *d = (const uint32_t *)dest;
+	for (size_t i = 0; i < n_dsd_frames * 2; ++i)
+		CPPUNIT_ASSERT_EQUAL(ByteSwap32(usb[i]), d[i]);
+}
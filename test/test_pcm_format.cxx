@@ -26,6 +26,11 @@
 #include "pcm/PcmBuffer.hxx"
 #include "AudioFormat.hxx"
 
+#include <algorithm>
+
+#include <math.h>
+#include <string.h>
+
 void
 PcmFormatTest::TestFormat8to16()
 {
@@ -118,3 +123,121 @@ PcmFormatTest::TestFormatFloat()
 	for (size_t i = 4; i < N; ++i)
 		CPPUNIT_ASSERT_EQUAL(src[i], d[i]);
 }
+
+void
+PcmFormatTest::TestFormat24to32()
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
+
+	PcmBuffer buffer;
+
+	auto d = pcm_convert_to_32(buffer, SampleFormat::S24_P32, src);
+	CPPUNIT_ASSERT_EQUAL(N, d.size);
+
+	for (size_t i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(src[i], d[i] >> 8);
+}
+
+void
+PcmFormatTest::TestFormat32to24()
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int32_t, N>();
+
+	PcmBuffer buffer;
+
+	auto d = pcm_convert_to_24(buffer, SampleFormat::S32, src);
+	CPPUNIT_ASSERT_EQUAL(N, d.size);
+
+	for (size_t i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(src[i] >> 8, d[i]);
+}
+
+template<typename T>
+static void
+AssertFloatEqual(const T &expected, float actual)
+{
+	const float e = expected;
+	CPPUNIT_ASSERT_EQUAL(0, memcmp(&e, &actual, sizeof(e)));
+}
+
+void
+PcmFormatTest::TestFormatToFloat()
+{
+	constexpr size_t N = 509;
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src32 = TestDataBuffer<int32_t, N>();
+
+	PcmBuffer buffer;
+
+	auto f = pcm_convert_to_float(buffer, SampleFormat::S16, src16);
+	CPPUNIT_ASSERT_EQUAL(N, f.size);
+	for (size_t i = 0; i < N; ++i)
+		AssertFloatEqual(float(src16[i]) * float(1.0 / (1 << 15)),
+				 f[i]);
+
+	f = pcm_convert_to_float(buffer, SampleFormat::S24_P32, src24);
+	CPPUNIT_ASSERT_EQUAL(N, f.size);
+	for (size_t i = 0; i < N; ++i)
+		AssertFloatEqual(float(src24[i]) * float(1.0 / (1 << 23)),
+				 f[i]);
+
+	f = pcm_convert_to_float(buffer, SampleFormat::S32, src32);
+	CPPUNIT_ASSERT_EQUAL(N, f.size);
+	for (size_t i = 0; i < N; ++i)
+		AssertFloatEqual(float(src32[i]) * float(1.0 / (1u << 31)),
+				 f[i]);
+}
+
+/**
+ * Generate floats in the range [-1.5, 1.5], to check clamping.
+ */
+struct RandomFloatOverflow : RandomFloat {
+	float operator()() {
+		return RandomFloat::operator()() * 1.5f;
+	}
+};
+
+template<typename T>
+static T
+ReferenceFromFloat(float src, int64_t min, int64_t max)
+{
+	const int64_t x = src * float(uint32_t(1) << (sizeof(T) * 8 - 1));
+	return T(std::min(std::max(x, min), max));
+}
+
+void
+PcmFormatTest::TestFormatFromFloat()
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<float, N>(RandomFloatOverflow());
+
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	auto d16 = pcm_convert_to_16(buffer, dither, SampleFormat::FLOAT, src);
+	CPPUNIT_ASSERT_EQUAL(N, d16.size);
+	for (size_t i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(ReferenceFromFloat<int16_t>(src[i],
+								 -32768, 32767),
+				     d16[i]);
+
+	auto d24 = pcm_convert_to_24(buffer, SampleFormat::FLOAT, src);
+	CPPUNIT_ASSERT_EQUAL(N, d24.size);
+	for (size_t i = 0; i < N; ++i) {
+		int64_t x = src[i] * float(1 << 23);
+		x = std::min<int64_t>(std::max<int64_t>(x, -0x800000),
+				      0x7fffff);
+		CPPUNIT_ASSERT_EQUAL(int32_t(x), d24[i]);
+	}
+
+	auto d32 = pcm_convert_to_32(buffer, SampleFormat::FLOAT, src);
+	CPPUNIT_ASSERT_EQUAL(N, d32.size);
+	for (size_t i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(ReferenceFromFloat<int32_t>(src[i],
+								 INT32_MIN,
+								 INT32_MAX),
+				     d32[i]);
+}
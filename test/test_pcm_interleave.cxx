@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/Interleave.hxx"
+
+#include <string.h>
+
+template<typename T, unsigned channels, size_t N>
+static void
+TestInterleaveN()
+{
+	T src[channels][N];
+	const void *planes[channels];
+	for (unsigned c = 0; c < channels; ++c) {
+		for (size_t i = 0; i < N; ++i)
+			src[c][i] = T(random());
+		planes[c] = src[c];
+	}
+
+	T dest[N * channels + 1];
+	dest[N * channels] = T(0x42);
+
+	PcmInterleave(dest, ConstBuffer<const void *>(planes, channels),
+		      N, sizeof(T));
+
+	for (size_t i = 0; i < N; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			CPPUNIT_ASSERT(dest[i * channels + c] == src[c][i]);
+
+	/* must not write beyond the end */
+	CPPUNIT_ASSERT(dest[N * channels] == T(0x42));
+}
+
+void
+PcmInterleaveTest::TestInterleave8()
+{
+	TestInterleaveN<uint8_t, 1, 509>();
+	TestInterleaveN<uint8_t, 2, 509>();
+	TestInterleaveN<uint8_t, 3, 509>();
+}
+
+void
+PcmInterleaveTest::TestInterleave16()
+{
+	TestInterleaveN<uint16_t, 1, 509>();
+	TestInterleaveN<uint16_t, 2, 509>();
+	TestInterleaveN<uint16_t, 2, 7>();
+	TestInterleaveN<uint16_t, 5, 509>();
+	TestInterleaveN<uint16_t, 6, 509>();
+	TestInterleaveN<uint16_t, 8, 509>();
+}
+
+void
+PcmInterleaveTest::TestInterleave32()
+{
+	TestInterleaveN<uint32_t, 1, 509>();
+	TestInterleaveN<uint32_t, 2, 509>();
+	TestInterleaveN<uint32_t, 2, 3>();
+	TestInterleaveN<uint32_t, 4, 509>();
+	TestInterleaveN<uint32_t, 6, 509>();
+	TestInterleaveN<uint32_t, 6, 3>();
+	TestInterleaveN<uint32_t, 8, 509>();
+}
+
+template<unsigned channels, size_t N>
+static void
+TestInterleaveNarrow16N()
+{
+	int32_t src[channels][N];
+	const int32_t *planes[channels];
+	for (unsigned c = 0; c < channels; ++c) {
+		for (size_t i = 0; i < N; ++i)
+			src[c][i] = int16_t(random());
+		planes[c] = src[c];
+	}
+
+	/* the extremes */
+	src[0][0] = -32768;
+	src[channels - 1][N - 1] = 32767;
+
+	int16_t dest[N * channels + 1];
+	dest[N * channels] = 0x42;
+
+	PcmInterleaveNarrow16(dest,
+			      ConstBuffer<const int32_t *>(planes, channels),
+			      N);
+
+	for (size_t i = 0; i < N; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			CPPUNIT_ASSERT_EQUAL(src[c][i],
+					     int32_t(dest[i * channels + c]));
+
+	/* must not write beyond the end */
+	CPPUNIT_ASSERT_EQUAL(int16_t(0x42), dest[N * channels]);
+}
+
+void
+PcmInterleaveTest::TestInterleaveNarrow16()
+{
+	TestInterleaveNarrow16N<1, 509>();
+	TestInterleaveNarrow16N<2, 509>();
+	TestInterleaveNarrow16N<2, 5>();
+	TestInterleaveNarrow16N<3, 509>();
+	TestInterleaveNarrow16N<4, 509>();
+	TestInterleaveNarrow16N<6, 509>();
+	TestInterleaveNarrow16N<8, 509>();
+	TestInterleaveNarrow16N<8, 3>();
+}
+
+void
+PcmInterleaveTest::TestInterleave64()
+{
+	TestInterleaveN<uint64_t, 2, 509>();
+	TestInterleaveN<uint64_t, 3, 509>();
+}
+
+template<unsigned channels, size_t N>
+static void
+TestDeinterleave32N()
+{
+	uint32_t src[N * channels];
+	for (size_t i = 0; i < N * channels; ++i)
+		src[i] = uint32_t(random());
+
+	uint32_t dest[channels][N + 1];
+	uint32_t *planes[channels];
+	for (unsigned c = 0; c < channels; ++c) {
+		dest[c][N] = 0x42;
+		planes[c] = dest[c];
+	}
+
+	PcmDeinterleave32(ConstBuffer<uint32_t *>(planes, channels), src, N);
+
+	for (size_t i = 0; i < N; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			CPPUNIT_ASSERT_EQUAL(src[i * channels + c], dest[c][i]);
+
+	/* must not write beyond the end */
+	for (unsigned c = 0; c < channels; ++c)
+		CPPUNIT_ASSERT_EQUAL(uint32_t(0x42), dest[c][N]);
+}
+
+void
+PcmInterleaveTest::TestDeinterleave32()
+{
+	TestDeinterleave32N<1, 509>();
+	TestDeinterleave32N<2, 509>();
+	TestDeinterleave32N<2, 3>();
+	TestDeinterleave32N<6, 509>();
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/Loudness.hxx"
+
+#include <vector>
+
+#include <math.h>
+#include <stdlib.h>
+
+/**
+ * Generate a 997 Hz sine wave in all channels.
+ */
+static std::vector<float>
+MakeSine(unsigned sample_rate, unsigned channels, double seconds,
+	 double dbfs)
+{
+	const double amplitude = pow(10., dbfs / 20.);
+	const size_t n_frames = sample_rate * seconds;
+
+	std::vector<float> result;
+	result.reserve(n_frames * channels);
+	for (size_t i = 0; i < n_frames; ++i) {
+		const float sample =
+			amplitude * sin(2 * M_PI * 997. * i / sample_rate);
+		for (unsigned c = 0; c < channels; ++c)
+			result.push_back(sample);
+	}
+
+	return result;
+}
+
+void
+PcmLoudnessTest::TestSine()
+{
+	/* EBU Tech 3341 test case 1: a stereo sine at -23 dBFS
+	   reads -23 LUFS */
+	for (unsigned sample_rate : { 44100u, 48000u, 96000u }) {
+		const auto sine = MakeSine(sample_rate, 2, 20, -23);
+
+		LoudnessMeter meter(sample_rate, 2);
+		meter.Feed(&sine.front(), sine.size() / 2);
+
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(-23.,
+					     meter.GetIntegratedLoudness(),
+					     0.1);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(pow(10., -23. / 20.),
+					     meter.GetPeak(), 0.001);
+	}
+
+	/* the LFE channel of 5.1 is ignored */
+	auto sine = MakeSine(48000, 6, 10, -23);
+	for (size_t i = 3; i < sine.size(); i += 6)
+		sine[i] = 0.9;
+
+	LoudnessMeter meter(48000, 6);
+	meter.Feed(&sine.front(), sine.size() / 6);
+
+	/* stereo is -23; center adds one channel of weight 1, the
+	   two surround channels 1.41 each */
+	const double expected = -23. + 10. * log10((3 + 2 * 1.41) / 2.);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(expected, meter.GetIntegratedLoudness(),
+				     0.1);
+}
+
+void
+PcmLoudnessTest::TestSilence()
+{
+	static constexpr unsigned sample_rate = 44100;
+
+	std::vector<float> silence(sample_rate * 5 * 2, 0.f);
+	LoudnessMeter meter(sample_rate, 2);
+	meter.Feed(&silence.front(), silence.size() / 2);
+
+	CPPUNIT_ASSERT(meter.GetIntegratedLoudness() < -70);
+	CPPUNIT_ASSERT_EQUAL(0.f, meter.GetPeak());
+
+	/* quiet passages don't pull down the result (relative
+	   gate) */
+	const auto loud = MakeSine(sample_rate, 2, 10, -10);
+	const auto quiet = MakeSine(sample_rate, 2, 10, -40);
+
+	LoudnessMeter gated(sample_rate, 2);
+	gated.Feed(&loud.front(), loud.size() / 2);
+	gated.Feed(&quiet.front(), quiet.size() / 2);
+	gated.Feed(&silence.front(), silence.size() / 2);
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-10., gated.GetIntegratedLoudness(), 0.2);
+}
+
+/**
+ * Parse the time of the specified level from a MixRamp string.
+ */
+static double
+FindMixRamp(const std::string &s, double db)
+{
+	const char *p = s.c_str();
+	while (*p != 0) {
+		char *endptr;
+		const double level = strtod(p, &endptr);
+		const double seconds = strtod(endptr, &endptr);
+		if (*endptr == ';')
+			++endptr;
+
+		if (fabs(level - db) < 0.01)
+			return seconds;
+
+		p = endptr;
+	}
+
+	return -1;
+}
+
+void
+PcmLoudnessTest::TestMixRamp()
+{
+	static constexpr unsigned sample_rate = 44100;
+
+	/* 2 seconds of silence, 3 seconds of a sine (mean square
+	   -9.03 dBFS), 1 second of silence */
+	const std::vector<float> silence(sample_rate * 2, 0.f);
+	const auto sine = MakeSine(sample_rate, 1, 3, -6);
+
+	MixRampMeter meter(sample_rate, 1);
+	meter.Feed(&silence.front(), sample_rate * 2);
+	meter.Feed(&sine.front(), sine.size());
+	meter.Feed(&silence.front(), sample_rate);
+
+	const std::string start = meter.GetStart(), end = meter.GetEnd();
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(2., FindMixRamp(start, -42), 0.01);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(2., FindMixRamp(start, -12), 0.01);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1., FindMixRamp(end, -42), 0.01);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1., FindMixRamp(end, -12), 0.01);
+
+	/* these levels are never reached */
+	CPPUNIT_ASSERT_EQUAL(-1., FindMixRamp(start, -6));
+	CPPUNIT_ASSERT_EQUAL(-1., FindMixRamp(end, 0));
+}
@@ -27,10 +27,14 @@
 
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmDitherTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmPackTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmInterleaveTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmChannelsTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmExportTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmVolumeTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmFormatTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(PcmMixTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmResampleTest);
+CPPUNIT_TEST_SUITE_REGISTRATION(PcmLoudnessTest);
 
 int
 main(gcc_unused int argc, gcc_unused char **argv)
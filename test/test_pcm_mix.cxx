@@ -22,6 +22,12 @@
 #include "test_pcm_util.hxx"
 #include "pcm/PcmMix.hxx"
 #include "pcm/PcmDither.hxx"
+#include "pcm/Volume.hxx"
+
+#include <algorithm>
+
+#include <math.h>
+#include <string.h>
 
 template<typename T, SampleFormat format, typename G=RandomInt<T>>
 static void
@@ -84,3 +90,106 @@ PcmMixTest::TestMix32()
 {
 	TestPcmMix<int32_t, SampleFormat::S32>();
 }
+
+/**
+ * Like RandomInt<int32_t>, but covers negative values, too.
+ */
+struct RandomInt32 : RandomInt<int32_t> {
+	int32_t operator()() {
+		return int32_t(uint32_t(random()) ^ (uint32_t(random()) << 16));
+	}
+};
+
+/**
+ * Compare the (possibly vectorised) MixRamp code path with the
+ * scalar formula; the results must be bit-exact.
+ */
+template<typename T, SampleFormat format, typename G=RandomInt<T>>
+static void
+TestPcmAdd(int64_t min, int64_t max, G g=G())
+{
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<T, N>(g);
+	const auto src2 = TestDataBuffer<T, N>(g);
+
+	PcmDither dither;
+
+	auto result = src1;
+	bool success = pcm_mix(dither,
+			       result.begin(), src2.begin(), sizeof(result),
+			       format, -1.0);
+	CPPUNIT_ASSERT(success);
+
+	for (unsigned i = 0; i < N; ++i) {
+		int64_t expected = int64_t(src1[i]) + int64_t(src2[i]);
+		expected = std::min(std::max(expected, min), max);
+		CPPUNIT_ASSERT_EQUAL(expected, int64_t(result[i]));
+	}
+}
+
+void
+PcmMixTest::TestAdd16()
+{
+	TestPcmAdd<int16_t, SampleFormat::S16>(INT16_MIN, INT16_MAX);
+}
+
+void
+PcmMixTest::TestAdd24()
+{
+	TestPcmAdd<int32_t, SampleFormat::S24_P32>(-0x800000, 0x7fffff,
+						   RandomInt24());
+}
+
+void
+PcmMixTest::TestAdd32()
+{
+	TestPcmAdd<int32_t, SampleFormat::S32>(INT32_MIN, INT32_MAX,
+					       RandomInt32());
+}
+
+void
+PcmMixTest::TestAddFloat()
+{
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<float, N>(RandomFloat());
+	const auto src2 = TestDataBuffer<float, N>(RandomFloat());
+
+	PcmDither dither;
+
+	auto result = src1;
+	bool success = pcm_mix(dither,
+			       result.begin(), src2.begin(), sizeof(result),
+			       SampleFormat::FLOAT, -1.0);
+	CPPUNIT_ASSERT(success);
+
+	for (unsigned i = 0; i < N; ++i) {
+		const float expected = src1[i] + src2[i];
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(&expected, &result[i],
+					       sizeof(expected)));
+	}
+}
+
+void
+PcmMixTest::TestMixFloat()
+{
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<float, N>(RandomFloat());
+	const auto src2 = TestDataBuffer<float, N>(RandomFloat());
+
+	PcmDither dither;
+
+	/* portion1=0.5 results in vol1=512 */
+	auto result = src1;
+	bool success = pcm_mix(dither,
+			       result.begin(), src2.begin(), sizeof(result),
+			       SampleFormat::FLOAT, 0.5);
+	CPPUNIT_ASSERT(success);
+
+	const float volume1 = pcm_volume_to_float(PCM_VOLUME_1 / 2);
+	const float volume2 = pcm_volume_to_float(PCM_VOLUME_1 / 2);
+	for (unsigned i = 0; i < N; ++i) {
+		const float expected = src1[i] * volume1 + src2[i] * volume2;
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(&expected, &result[i],
+					       sizeof(expected)));
+	}
+}
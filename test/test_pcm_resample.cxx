@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/PolyphaseResampler.hxx"
+#include "pcm/PolyphaseSimd.hxx"
+#include "AudioFormat.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <math.h>
+#include <string.h>
+
+static std::vector<float>
+Resample(unsigned channels, unsigned src_rate, unsigned dest_rate,
+	 const std::vector<float> &src, size_t chunk_frames)
+{
+	PolyphasePcmResampler r;
+	AudioFormat af(src_rate, SampleFormat::FLOAT, channels);
+	const AudioFormat out = r.Open(af, dest_rate, IgnoreError());
+	CPPUNIT_ASSERT(out.IsValid());
+	CPPUNIT_ASSERT_EQUAL(dest_rate, out.sample_rate);
+	CPPUNIT_ASSERT(out.format == SampleFormat::FLOAT);
+
+	std::vector<float> result;
+	for (size_t i = 0; i < src.size();) {
+		const size_t n = std::min(chunk_frames * channels,
+					  src.size() - i);
+		const ConstBuffer<void> in(&src[i], n * sizeof(float));
+		const auto dest =
+			ConstBuffer<float>::FromVoid(r.Resample(in,
+								IgnoreError()));
+		CPPUNIT_ASSERT(dest.size % channels == 0);
+		result.insert(result.end(), dest.begin(), dest.end());
+
+		i += n;
+	}
+
+	r.Close();
+	return result;
+}
+
+static std::vector<float>
+Sine(unsigned rate, double frequency, double amplitude, unsigned n)
+{
+	std::vector<float> result;
+	for (unsigned i = 0; i < n; ++i)
+		result.push_back(amplitude *
+				 sin(2 * M_PI * frequency * i / rate));
+	return result;
+}
+
+void
+PcmResampleTest::TestDot()
+{
+	constexpr size_t N = 509;
+	const auto a = TestDataBuffer<float, N>(RandomFloat());
+	const auto b = TestDataBuffer<float, N>(RandomFloat());
+
+	float sum = 0;
+	size_t i = pcm_dot_simd_float(a, b, N, sum);
+	CPPUNIT_ASSERT(i <= N);
+	for (; i < N; ++i)
+		sum += a[i] * b[i];
+
+	double expected = 0;
+	for (i = 0; i < N; ++i)
+		expected += double(a[i]) * double(b[i]);
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(expected, sum, 1e-3);
+}
+
+void
+PcmResampleTest::TestChunks()
+{
+	/* the result must not depend on how the input is split */
+	constexpr unsigned N = 4096;
+	const auto data = TestDataBuffer<float, N * 2>(RandomFloat());
+	const std::vector<float> src(data.begin(), data.end());
+
+	const auto expected = Resample(2, 44100, 48000, src, N);
+	CPPUNIT_ASSERT(expected.size() > 2 * (N * 48000 / 44100 - 32));
+	CPPUNIT_ASSERT(expected.size() <= 2 * (N * 48000 / 44100 + 1));
+
+	for (size_t chunk : { 1, 7, 100, 1003 }) {
+		const auto result = Resample(2, 44100, 48000, src, chunk);
+		CPPUNIT_ASSERT_EQUAL(expected.size(), result.size());
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(&expected[0], &result[0],
+					       expected.size() * sizeof(float)));
+	}
+
+	const auto down = Resample(2, 48000, 22050, src, N);
+	for (size_t chunk : { 1, 13, 999 }) {
+		const auto result = Resample(2, 48000, 22050, src, chunk);
+		CPPUNIT_ASSERT_EQUAL(down.size(), result.size());
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(&down[0], &result[0],
+					       down.size() * sizeof(float)));
+	}
+}
+
+void
+PcmResampleTest::TestSine()
+{
+	/* the first output frame is aligned with the first input
+	   frame, so the output must be the same sine wave sampled at
+	   the new rate */
+	const auto src = Sine(44100, 1000, 0.5, 44100);
+	const auto result = Resample(1, 44100, 48000, src, 1024);
+	const auto expected = Sine(48000, 1000, 0.5, result.size());
+
+	CPPUNIT_ASSERT(result.size() > 47000);
+	for (size_t i = 100; i < result.size(); ++i)
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i], result[i], 0.005);
+}
+
+void
+PcmResampleTest::TestAliasing()
+{
+	/* a tone above the new Nyquist frequency must be removed
+	   when downsampling */
+	const auto src = Sine(48000, 16000, 0.5, 48000);
+	const auto result = Resample(1, 48000, 22050, src, 1024);
+	CPPUNIT_ASSERT(result.size() > 21000);
+
+	double sum = 0;
+	for (size_t i = 100; i < result.size(); ++i)
+		sum += double(result[i]) * double(result[i]);
+
+	const double rms = sqrt(sum / (result.size() - 100));
+	CPPUNIT_ASSERT(rms < 0.001);
+}
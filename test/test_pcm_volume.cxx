@@ -123,3 +123,166 @@ PcmVolumeTest::TestVolumeFloat()
 
 	pv.Close();
 }
+
+void
+PcmVolumeTest::TestVolume16NoDither()
+{
+	PcmVolume pv;
+	pv.SetDither(false);
+	CPPUNIT_ASSERT(pv.Open(SampleFormat::S16, IgnoreError()));
+
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<int16_t, N>();
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	/* the result must be bit-exact with the scalar formula,
+	   regardless of which SIMD kernel was chosen */
+	static constexpr unsigned volumes[] = {
+		1, 7, PCM_VOLUME_1 / 3, PCM_VOLUME_1 - 1,
+		PCM_VOLUME_1 * 3, 0x7fff, 0x8000,
+	};
+
+	for (const unsigned volume : volumes) {
+		pv.SetVolume(volume);
+		const auto dest = ConstBuffer<int16_t>::FromVoid(pv.Apply(src));
+		CPPUNIT_ASSERT_EQUAL(N, dest.size);
+
+		for (unsigned i = 0; i < N; ++i) {
+			int32_t expected = (int32_t(_src[i]) * int32_t(volume)
+					    + (1 << (PCM_VOLUME_BITS - 1)))
+				>> PCM_VOLUME_BITS;
+			expected = std::min<int32_t>(expected, 32767);
+			expected = std::max<int32_t>(expected, -32768);
+			CPPUNIT_ASSERT_EQUAL(expected, int32_t(dest[i]));
+		}
+	}
+
+	pv.Close();
+}
+
+void
+PcmVolumeTest::TestVolumeFloatNoDither()
+{
+	PcmVolume pv;
+	pv.SetDither(false);
+	CPPUNIT_ASSERT(pv.Open(SampleFormat::FLOAT, IgnoreError()));
+
+	constexpr size_t N = 509;
+	const auto _src = TestDataBuffer<float, N>(RandomFloat());
+	const ConstBuffer<void> src(_src, sizeof(_src));
+
+	pv.SetVolume(PCM_VOLUME_1 / 3);
+	const auto dest = ConstBuffer<float>::FromVoid(pv.Apply(src));
+	CPPUNIT_ASSERT_EQUAL(N, dest.size);
+
+	const float volume = pcm_volume_to_float(PCM_VOLUME_1 / 3);
+	for (unsigned i = 0; i < N; ++i) {
+		const float expected = _src[i] * volume;
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(&expected, &dest[i],
+					       sizeof(expected)));
+	}
+
+	pv.Close();
+}
+
+/**
+ * Feed a constant signal through a volume ramp in chunks which do
+ * not line up with the ramp, and verify the start and end levels
+ * and that the level moves monotonically in between.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+TestRamp(typename Traits::value_type value)
+{
+	typedef typename Traits::value_type value_type;
+
+	constexpr unsigned channels = 2;
+	constexpr unsigned ramp_frames = 256;
+	constexpr unsigned chunk_frames = 100;
+	constexpr unsigned n_frames = chunk_frames * 4;
+
+	PcmVolume pv;
+	pv.SetDither(false);
+	CPPUNIT_ASSERT(pv.Open(F, IgnoreError()));
+	pv.SetRamp(channels, ramp_frames);
+
+	value_type src[chunk_frames * channels];
+	std::fill_n(src, chunk_frames * channels, value);
+
+	static constexpr struct {
+		unsigned from, to;
+	} ramps[] = {
+		{ PCM_VOLUME_1, 0 },
+		{ 0, PCM_VOLUME_1 },
+		{ PCM_VOLUME_1 / 4, PCM_VOLUME_1 / 2 },
+	};
+
+	for (const auto &ramp : ramps) {
+		/* settle at the start level */
+		pv.SetVolume(ramp.from);
+		while (pv.IsRamping())
+			pv.Apply({src, sizeof(src)});
+
+		pv.SetVolume(ramp.to);
+
+		value_type dest[n_frames * channels];
+		for (unsigned i = 0; i < n_frames; i += chunk_frames) {
+			const auto result = pv.Apply({src, sizeof(src)});
+			CPPUNIT_ASSERT_EQUAL(sizeof(src), result.size);
+			memcpy(dest + i * channels, result.data, result.size);
+		}
+
+		CPPUNIT_ASSERT(!pv.IsRamping());
+
+		/* the ramp starts exactly at the old level */
+		PcmVolume reference;
+		reference.SetDither(false);
+		CPPUNIT_ASSERT(reference.Open(F, IgnoreError()));
+		reference.SetVolume(ramp.from);
+		const auto start = ConstBuffer<value_type>::FromVoid(
+			reference.Apply({src, sizeof(src)}));
+		CPPUNIT_ASSERT(start[0] == dest[0]);
+
+		/* after the ramp, it is exactly the new level */
+		reference.SetVolume(ramp.to);
+		const auto end = ConstBuffer<value_type>::FromVoid(
+			reference.Apply({src, sizeof(src)}));
+		for (unsigned i = ramp_frames * channels;
+		     i < n_frames * channels; ++i)
+			CPPUNIT_ASSERT(end[0] == dest[i]);
+
+		reference.Close();
+
+		for (unsigned i = 0; i < ramp_frames; ++i) {
+			/* all channels of a frame get the same level */
+			for (unsigned c = 1; c < channels; ++c)
+				CPPUNIT_ASSERT(dest[i * channels] ==
+					       dest[i * channels + c]);
+
+			/* monotonic, and never beyond the target */
+			const value_type a = dest[i * channels];
+			const value_type b = dest[(i + 1) * channels];
+			if (ramp.to < ramp.from) {
+				CPPUNIT_ASSERT(b <= a);
+				CPPUNIT_ASSERT(a >= end[0]);
+			} else {
+				CPPUNIT_ASSERT(b >= a);
+				CPPUNIT_ASSERT(a <= end[0]);
+			}
+		}
+	}
+
+	pv.Close();
+}
+
+void
+PcmVolumeTest::TestRamp16()
+{
+	TestRamp<SampleFormat::S16>(20000);
+}
+
+void
+PcmVolumeTest::TestRampFloat()
+{
+	TestRamp<SampleFormat::FLOAT>(0.75f);
+}
@@ -8,6 +8,10 @@
 #include <cppunit/ui/text/TestRunner.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <vector>
+
+#include <stdlib.h>
+
 Tag::Tag(const Tag &) {}
 void Tag::Clear() {}
 
@@ -27,13 +31,27 @@ check_descending_priority(const Queue *queue,
 	}
 }
 
+static void
+check_inverse_order(const Queue &queue)
+{
+	for (unsigned order = 0; order < queue.GetLength(); ++order)
+		CPPUNIT_ASSERT_EQUAL(order,
+				     queue.PositionToOrder(queue.OrderToPosition(order)));
+}
+
 class QueuePriorityTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(QueuePriorityTest);
 	CPPUNIT_TEST(TestPriority);
+	CPPUNIT_TEST(TestPriorityGroups);
+	CPPUNIT_TEST(TestInverseOrder);
+	CPPUNIT_TEST(TestChanges);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestPriority();
+	void TestPriorityGroups();
+	void TestInverseOrder();
+	void TestChanges();
 };
 
 void
@@ -193,6 +211,263 @@ QueuePriorityTest::TestPriority()
 	CPPUNIT_ASSERT_EQUAL(6u, a_order);
 }
 
+/**
+ * Count the songs after the specified order with a priority bigger
+ * than the specified one.
+ */
+static unsigned
+count_higher_priority(const Queue &queue, unsigned start_order,
+		      uint8_t priority)
+{
+	unsigned n = 0;
+	for (unsigned order = start_order; order < queue.GetLength(); ++order)
+		if (queue.items[queue.OrderToPosition(order)].priority > priority)
+			++n;
+	return n;
+}
+
+/**
+ * Call Queue::SetPriority() and verify that the songs after the
+ * current one are still grouped by priority, that the song has been
+ * moved into its new group, and that the songs which have already
+ * been played keep their order.
+ */
+static void
+set_priority_checked(Queue &queue, unsigned position, uint8_t priority,
+		     unsigned current_position)
+{
+	const unsigned current_order = queue.PositionToOrder(current_position);
+	const unsigned old_order = queue.PositionToOrder(position);
+	const uint8_t old_priority = queue.items[position].priority;
+	const uint8_t current_priority =
+		queue.items[current_position].priority;
+
+	/* a song which has already been played is enqueued again only
+	   if its priority becomes bigger than the current one's */
+	const bool enqueue = old_order < current_order &&
+		old_priority <= current_priority &&
+		priority > current_priority;
+
+	std::vector<unsigned> played;
+	for (unsigned order = 0; order < current_order; ++order)
+		if (order != old_order || !enqueue)
+			played.push_back(queue.OrderToPosition(order));
+
+	queue.SetPriority(position, priority, current_order);
+	check_inverse_order(queue);
+	CPPUNIT_ASSERT_EQUAL(priority, queue.items[position].priority);
+
+	const unsigned new_current_order =
+		queue.PositionToOrder(current_position);
+	CPPUNIT_ASSERT_EQUAL(unsigned(played.size()), new_current_order);
+	for (unsigned order = 0; order < new_current_order; ++order)
+		CPPUNIT_ASSERT_EQUAL(played[order],
+				     queue.OrderToPosition(order));
+
+	if (position == current_position)
+		return;
+
+	if (old_order > current_order || enqueue) {
+		/* the song must be within its priority group */
+		const unsigned first = new_current_order + 1;
+		const unsigned new_order = queue.PositionToOrder(position);
+		CPPUNIT_ASSERT(new_order >= first);
+
+		const unsigned group_start =
+			first + count_higher_priority(queue, first, priority);
+		const unsigned group_end =
+			first + count_higher_priority(queue, first,
+						      uint8_t(priority - 1));
+		CPPUNIT_ASSERT(new_order >= group_start);
+		CPPUNIT_ASSERT(priority == 0 || new_order < group_end);
+	}
+
+	check_descending_priority(&queue, new_current_order + 1);
+}
+
+void
+QueuePriorityTest::TestPriorityGroups()
+{
+	Queue queue(64);
+
+	for (unsigned i = 0; i < 48; ++i)
+		queue.Append(DetachedSong("foo.ogg"), (i % 4) * 10);
+
+	queue.random = true;
+	queue.ShuffleOrder();
+	check_descending_priority(&queue, 0);
+
+	const unsigned current_position = queue.OrderToPosition(5);
+
+	/* up across all groups: a new group right after the current
+	   song */
+
+	unsigned position = queue.OrderToPosition(queue.GetLength() - 1);
+	CPPUNIT_ASSERT_EQUAL(0u, unsigned(queue.items[position].priority));
+	set_priority_checked(queue, position, 50, current_position);
+	CPPUNIT_ASSERT_EQUAL(6u, queue.PositionToOrder(position));
+
+	/* up across one group into an existing one */
+
+	position = queue.OrderToPosition(queue.GetLength() - 1);
+	set_priority_checked(queue, position, 20, current_position);
+
+	/* down across several groups into a new one */
+
+	position = queue.OrderToPosition(6);
+	CPPUNIT_ASSERT_EQUAL(50u, unsigned(queue.items[position].priority));
+	set_priority_checked(queue, position, 5, current_position);
+	CPPUNIT_ASSERT_EQUAL(6 + count_higher_priority(queue, 6, 5),
+			     queue.PositionToOrder(position));
+
+	/* down across all groups to the end */
+
+	position = queue.OrderToPosition(7);
+	set_priority_checked(queue, position, 0, current_position);
+
+	/* the current song and songs which have already been played */
+
+	set_priority_checked(queue, current_position, 90, current_position);
+	set_priority_checked(queue, queue.OrderToPosition(2), 1,
+			     current_position);
+	set_priority_checked(queue, queue.OrderToPosition(3), 100,
+			     current_position);
+
+	/* random moves up and down */
+
+	srand(42);
+	for (unsigned i = 0; i < 1000; ++i)
+		set_priority_checked(queue, rand() % queue.GetLength(),
+				     (rand() % 8) * 10, current_position);
+}
+
+void
+QueuePriorityTest::TestInverseOrder()
+{
+	Queue queue(32);
+
+	for (unsigned i = 0; i < 16; ++i)
+		queue.Append(DetachedSong("foo.ogg"), 0);
+
+	queue.random = true;
+	queue.SetPriorityRange(2, 6, 10, -1);
+	queue.ShuffleOrder();
+	check_inverse_order(queue);
+
+	queue.SetPriority(12, 20, 3);
+	check_inverse_order(queue);
+
+	const unsigned id = queue.PositionToId(3);
+	const unsigned order = queue.PositionToOrder(3);
+
+	queue.MovePostion(3, 11);
+	check_inverse_order(queue);
+	CPPUNIT_ASSERT_EQUAL(11, queue.IdToPosition(id));
+	CPPUNIT_ASSERT_EQUAL(order, queue.PositionToOrder(11));
+
+	queue.MovePostion(11, 1);
+	check_inverse_order(queue);
+	CPPUNIT_ASSERT_EQUAL(order, queue.PositionToOrder(1));
+
+	queue.MoveRange(0, 4, 9);
+	check_inverse_order(queue);
+	CPPUNIT_ASSERT_EQUAL(order, queue.PositionToOrder(10));
+
+	queue.MoveRange(10, 14, 2);
+	check_inverse_order(queue);
+	CPPUNIT_ASSERT_EQUAL(order, queue.PositionToOrder(2));
+
+	queue.SwapPositions(2, 7);
+	check_inverse_order(queue);
+
+	queue.DeletePosition(5);
+	check_inverse_order(queue);
+
+	const unsigned id2 = queue.PositionToId(12);
+	const unsigned order2 = queue.PositionToOrder(12);
+	queue.DeleteRange(3, 8);
+	CPPUNIT_ASSERT_EQUAL(10u, queue.GetLength());
+	check_inverse_order(queue);
+	CPPUNIT_ASSERT_EQUAL(7, queue.IdToPosition(id2));
+	CPPUNIT_ASSERT(queue.PositionToOrder(7) <= order2);
+
+	queue.ShuffleOrderLast(0, queue.GetLength());
+	check_inverse_order(queue);
+
+	queue.random = false;
+	queue.RestoreOrder();
+	check_inverse_order(queue);
+	CPPUNIT_ASSERT_EQUAL(4u, queue.PositionToOrder(4));
+}
+
+/**
+ * Compare Queue::VisitChanges() with a full scan for all versions.
+ */
+static void
+check_changes(const Queue &queue)
+{
+	for (uint32_t version = 0; version <= queue.version + 1; ++version) {
+		unsigned expected = 0;
+		for (unsigned i = 0; i < queue.GetLength(); ++i)
+			if (queue.IsNewerAtPosition(i, version))
+				++expected;
+
+		unsigned n = 0, last = 0;
+		queue.VisitChanges(version, [&](unsigned position){
+				CPPUNIT_ASSERT(n == 0 || position > last);
+				CPPUNIT_ASSERT(queue.IsNewerAtPosition(position,
+								       version));
+				last = position;
+				++n;
+			});
+
+		CPPUNIT_ASSERT_EQUAL(expected, n);
+	}
+}
+
+void
+QueuePriorityTest::TestChanges()
+{
+	Queue queue(32);
+
+	for (unsigned i = 0; i < 16; ++i) {
+		queue.Append(DetachedSong("foo.ogg"), 0);
+		queue.IncrementVersion();
+	}
+
+	check_changes(queue);
+
+	queue.ModifyAtPosition(3);
+	queue.IncrementVersion();
+	check_changes(queue);
+
+	queue.MoveRange(10, 12, 2);
+	queue.IncrementVersion();
+	check_changes(queue);
+
+	queue.SwapPositions(0, 15);
+	queue.IncrementVersion();
+	check_changes(queue);
+
+	queue.DeleteRange(4, 7);
+	queue.IncrementVersion();
+	check_changes(queue);
+
+	queue.DeletePosition(12);
+	queue.IncrementVersion();
+	check_changes(queue);
+
+	/* overflow the log */
+	for (unsigned i = 0; i < QueueChangeLog::CAPACITY + 10; ++i) {
+		queue.ModifyAtPosition((i * 2) % queue.GetLength());
+		queue.IncrementVersion();
+	}
+
+	check_changes(queue);
+	CPPUNIT_ASSERT(!queue.changes.Covers(1));
+	CPPUNIT_ASSERT(queue.changes.Covers(queue.version));
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(QueuePriorityTest);
 
 int
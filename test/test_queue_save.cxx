@@ -0,0 +1,343 @@
+/*
+ * Unit tests for src/queue/QueueSave.cxx and src/queue/QueueBinary.cxx
+ */
+
+#include "config.h"
+#include "queue/QueueSave.hxx"
+#include "queue/QueueBinary.hxx"
+#include "queue/Queue.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "DetachedSong.hxx"
+#include "SongLoader.hxx"
+#include "SongSave.hxx"
+#include "Mapper.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Tag.hxx"
+#include "fs/Path.hxx"
+#include "fs/TextFile.hxx"
+#include "util/Domain.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void
+Log(const Domain &domain, gcc_unused LogLevel level, const char *msg)
+{
+	fprintf(stderr, "[%s] %s\n", domain.GetName(), msg);
+}
+
+/* the songs in this test are neither looked up in a database nor
+   mapped to the music directory */
+
+bool
+playlist_check_translate_song(gcc_unused DetachedSong &song,
+			      gcc_unused const char *base_uri,
+			      gcc_unused const SongLoader &loader)
+{
+	return true;
+}
+
+void
+map_song_compact(gcc_unused DetachedSong &song)
+{
+}
+
+static constexpr unsigned MAX_LENGTH = 64;
+static constexpr uint32_t GENERATION = 0x12345678;
+static constexpr time_t DB_STAMP = 1400000000;
+
+static DetachedSong
+MakeSong(const char *uri, unsigned n)
+{
+	TagBuilder tag;
+	tag.SetTime(180 + n);
+	tag.AddItem(TAG_TITLE, "title");
+
+	/* multi-value tags, and values shared with other songs */
+	tag.AddItem(TAG_ARTIST, "artist_a");
+	if (n % 2 == 0)
+		tag.AddItem(TAG_ARTIST, "artist_b");
+	tag.AddItem(TAG_GENRE, n % 3 == 0 ? "Rock" : "Jazz");
+
+	DetachedSong song(uri, tag.Commit());
+	song.SetLastModified(1300000000 + n);
+	if (n % 4 == 1) {
+		song.SetStartMS(1000 * n);
+		song.SetEndMS(1000 * n + 500);
+	}
+
+	return song;
+}
+
+static void
+Fill(Queue &queue, unsigned n)
+{
+	static const char *const uris[] = {
+		"http://example.com/stream.ogg",
+		"/music/absolute.flac",
+		"http://example.com/other.mp3",
+	};
+
+	for (unsigned i = 0; i < n; ++i)
+		queue.Append(MakeSong(uris[i % 3], i), i * 37 % 256);
+}
+
+/**
+ * Serialize the queue in the text format, which contains everything
+ * the snapshot formats must preserve.
+ */
+static std::string
+Dump(const Queue &queue)
+{
+	char *data;
+	size_t size;
+	FILE *fp = open_memstream(&data, &size);
+
+	for (unsigned i = 0; i < queue.GetLength(); ++i) {
+		fprintf(fp, "prio=%u\n", queue.GetPriorityAtPosition(i));
+		song_save(fp, queue.Get(i));
+	}
+
+	fclose(fp);
+	std::string result(data, size);
+	free(data);
+	return result;
+}
+
+class QueueSaveTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(QueueSaveTest);
+	CPPUNIT_TEST(TestBinaryEmpty);
+	CPPUNIT_TEST(TestBinaryRoundTrip);
+	CPPUNIT_TEST(TestBinaryTruncated);
+	CPPUNIT_TEST(TestBinaryCorrupt);
+	CPPUNIT_TEST(TestTextEmpty);
+	CPPUNIT_TEST(TestTextRoundTrip);
+	CPPUNIT_TEST(TestTextTruncated);
+	CPPUNIT_TEST(TestJournal);
+	CPPUNIT_TEST_SUITE_END();
+
+	char path[32];
+
+	const SongLoader loader{nullptr, nullptr};
+
+public:
+	void setUp() {
+		strcpy(path, "/tmp/test_queue_save.XXXXXX");
+		int fd = mkstemp(path);
+		CPPUNIT_ASSERT(fd >= 0);
+		close(fd);
+	}
+
+	void tearDown() {
+		unlink(path);
+	}
+
+	void TestBinaryEmpty() {
+		Queue queue(MAX_LENGTH);
+		SaveBinary(queue);
+
+		Queue loaded(MAX_LENGTH);
+		uint32_t generation = 0;
+		CPPUNIT_ASSERT(LoadBinary(loaded, generation));
+		CPPUNIT_ASSERT_EQUAL(GENERATION, generation);
+		CPPUNIT_ASSERT_EQUAL(0u, loaded.GetLength());
+	}
+
+	void TestBinaryRoundTrip() {
+		Queue queue(MAX_LENGTH);
+		Fill(queue, 12);
+		SaveBinary(queue);
+
+		Queue loaded(MAX_LENGTH);
+		uint32_t generation = 0;
+		CPPUNIT_ASSERT(LoadBinary(loaded, generation));
+		CPPUNIT_ASSERT_EQUAL(GENERATION, generation);
+		CPPUNIT_ASSERT_EQUAL(Dump(queue), Dump(loaded));
+	}
+
+	void TestBinaryTruncated() {
+		Queue queue(MAX_LENGTH);
+		Fill(queue, 5);
+		const std::string data = SaveBinary(queue);
+
+		/* every proper prefix of the file must be rejected */
+		for (size_t length = 0; length < data.length(); ++length) {
+			WriteFile(data.data(), length);
+
+			Queue loaded(MAX_LENGTH);
+			CPPUNIT_ASSERT(!LoadBinary(loaded));
+		}
+	}
+
+	void TestBinaryCorrupt() {
+		Queue queue(MAX_LENGTH);
+		Fill(queue, 5);
+		const std::string data = SaveBinary(queue);
+
+		/* corrupted bytes may or may not be detected, but must
+		   never crash the loader */
+		for (size_t i = 0; i < data.length(); ++i) {
+			std::string copy = data;
+			copy[i] ^= 0xff;
+			WriteFile(copy.data(), copy.length());
+
+			Queue loaded(MAX_LENGTH);
+			LoadBinary(loaded);
+		}
+	}
+
+	void TestTextEmpty() {
+		Queue queue(MAX_LENGTH);
+		SaveText(queue);
+
+		Queue loaded(MAX_LENGTH);
+		LoadText(loaded);
+		CPPUNIT_ASSERT_EQUAL(0u, loaded.GetLength());
+	}
+
+	void TestTextRoundTrip() {
+		Queue queue(MAX_LENGTH);
+		Fill(queue, 12);
+		SaveText(queue);
+
+		Queue loaded(MAX_LENGTH);
+		LoadText(loaded);
+		CPPUNIT_ASSERT_EQUAL(Dump(queue), Dump(loaded));
+	}
+
+	void TestTextTruncated() {
+		Queue queue(MAX_LENGTH);
+		Fill(queue, 5);
+		const std::string data = SaveText(queue);
+
+		/* a truncated state file yields a prefix of the queue;
+		   the last song may be incomplete */
+		for (size_t length = 0; length < data.length(); ++length) {
+			WriteFile(data.data(), length);
+
+			Queue loaded(MAX_LENGTH);
+			LoadText(loaded);
+			CPPUNIT_ASSERT(loaded.GetLength() <= queue.GetLength());
+
+			for (unsigned i = 0; i + 1 < loaded.GetLength(); ++i)
+				CPPUNIT_ASSERT_EQUAL(std::string(queue.Get(i).GetURI()),
+						     std::string(loaded.Get(i).GetURI()));
+		}
+	}
+
+	void TestJournal() {
+		Queue queue(MAX_LENGTH);
+		Fill(queue, 8);
+
+		FILE *fp = fopen(path, "w");
+		CPPUNIT_ASSERT(fp != nullptr);
+		queue_save(fp, queue);
+
+		/* replace one song */
+		TagBuilder tag;
+		tag.AddItem(TAG_ARTIST, "replaced_a");
+		tag.AddItem(TAG_ARTIST, "replaced_b");
+		queue.Get(2).SetURI("http://example.com/replaced.ogg");
+		queue.Get(2).SetTag(tag.Commit());
+		queue.SetPriority(2, 99, -1);
+		queue.ModifyAtPosition(2);
+		queue_journal_save_song(fp, queue, 2);
+
+		/* replace the tail */
+		queue.DeleteRange(5, queue.GetLength());
+		queue.Append(MakeSong("/music/new1.flac", 100), 7);
+		queue.Append(MakeSong("/music/new2.flac", 101), 0);
+		queue_journal_save_tail(fp, queue, 5);
+
+		/* truncate to fewer songs */
+		queue.DeleteRange(6, queue.GetLength());
+		queue_journal_save_tail(fp, queue, 6);
+
+		fclose(fp);
+
+		Queue loaded(MAX_LENGTH);
+		LoadText(loaded);
+		CPPUNIT_ASSERT_EQUAL(Dump(queue), Dump(loaded));
+	}
+
+private:
+	void WriteFile(const void *data, size_t size) {
+		FILE *fp = fopen(path, "wb");
+		CPPUNIT_ASSERT(fp != nullptr);
+		CPPUNIT_ASSERT_EQUAL(size, fwrite(data, 1, size, fp));
+		fclose(fp);
+	}
+
+	std::string ReadFile() {
+		FILE *fp = fopen(path, "rb");
+		CPPUNIT_ASSERT(fp != nullptr);
+
+		std::string result;
+		char buffer[4096];
+		size_t nbytes;
+		while ((nbytes = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+			result.append(buffer, nbytes);
+
+		fclose(fp);
+		return result;
+	}
+
+	std::string SaveBinary(const Queue &queue) {
+		FILE *fp = fopen(path, "wb");
+		CPPUNIT_ASSERT(fp != nullptr);
+		queue_save_binary(fp, queue, GENERATION, DB_STAMP);
+		fclose(fp);
+		return ReadFile();
+	}
+
+	bool LoadBinary(Queue &queue, uint32_t &generation) {
+		Error error;
+		return queue_load_binary(Path::FromFS(path), loader, DB_STAMP,
+					 queue, generation, error);
+	}
+
+	bool LoadBinary(Queue &queue) {
+		uint32_t generation;
+		return LoadBinary(queue, generation);
+	}
+
+	std::string SaveText(const Queue &queue) {
+		FILE *fp = fopen(path, "w");
+		CPPUNIT_ASSERT(fp != nullptr);
+		queue_save(fp, queue);
+		fclose(fp);
+		return ReadFile();
+	}
+
+	void LoadText(Queue &queue) {
+		TextFile file(Path::FromFS(path));
+		CPPUNIT_ASSERT(!file.HasFailed());
+
+		const char *line;
+		while ((line = file.ReadLine()) != nullptr)
+			if (!queue_journal_load(file, loader, line, queue))
+				queue_load_song(file, loader, line, queue);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(QueueSaveTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,347 @@
+/*
+ * Unit tests for src/db/plugins/simple/SongIndex.cxx: the results
+ * obtained from the index are compared with a full scan of all
+ * songs.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SongIndex.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/LightSong.hxx"
+#include "db/Stats.hxx"
+#include "SongFilter.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Set.hxx"
+#include "util/Error.hxx"
+#include "util/Macros.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *const artists[] = {
+	"Foo", "foo", "FOO fighters", "Bar Baz", "bar", "Quux",
+};
+
+static const char *const albums[] = {
+	"Album 1", "Album 2", "album 2", "Best of Bar",
+};
+
+static const char *const genres[] = {
+	"Rock", "Jazz", "Rock and Roll",
+};
+
+template<typename T, size_t N>
+static const T &
+Pick(const T (&array)[N])
+{
+	return array[rand() % N];
+}
+
+static Tag
+MakeRandomTag(unsigned n)
+{
+	TagBuilder tag;
+
+	/* songs without a duration, without "artist", with several
+	   values of the same type, and "album artist" which some
+	   songs don't have */
+
+	if (n % 5 != 0)
+		tag.SetTime(60 + rand() % 600);
+
+	if (n % 7 != 0)
+		tag.AddItem(TAG_ARTIST, Pick(artists));
+	if (n % 3 == 0)
+		tag.AddItem(TAG_ARTIST, Pick(artists));
+	if (n % 4 == 0)
+		tag.AddItem(TAG_ALBUM_ARTIST, Pick(artists));
+	if (n % 6 != 0)
+		tag.AddItem(TAG_ALBUM, Pick(albums));
+	if (n % 2 == 0)
+		tag.AddItem(TAG_GENRE, Pick(genres));
+
+	char title[32];
+	snprintf(title, sizeof(title), "Title %u", n % 20);
+	tag.AddItem(TAG_TITLE, title);
+
+	return tag.Commit();
+}
+
+static void
+CollectSongs(const Directory &directory, std::vector<const Song *> &songs)
+{
+	for (const auto &song : directory.songs)
+		songs.push_back(&song);
+
+	for (const auto &child : directory.children)
+		CollectSongs(child, songs);
+}
+
+class SongIndexTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SongIndexTest);
+	CPPUNIT_TEST(TestEmpty);
+	CPPUNIT_TEST(TestIndex);
+	CPPUNIT_TEST_SUITE_END();
+
+	SongIndex index;
+	Directory *root;
+	std::vector<Directory *> directories;
+	unsigned next_song;
+
+public:
+	void setUp() override {
+		db_lock();
+		root = Directory::NewRoot();
+		root->song_index = &index;
+
+		directories = {
+			root,
+			root->MakeChild("a"),
+			root->MakeChild("a")->MakeChild("b"),
+			root->MakeChild("c"),
+		};
+		db_unlock();
+
+		next_song = 0;
+		srand(42);
+	}
+
+	void tearDown() override {
+		db_lock();
+		delete root;
+		db_unlock();
+		index.Clear();
+	}
+
+	void TestEmpty() {
+		Check();
+	}
+
+	void TestIndex() {
+		for (unsigned i = 0; i < 200; ++i)
+			AddRandomSong();
+
+		Check();
+
+		/* modify some tags */
+
+		db_lock();
+		std::vector<const Song *> songs;
+		CollectSongs(*root, songs);
+		for (unsigned i = 0; i < songs.size(); i += 3) {
+			Song &song = const_cast<Song &>(*songs[i]);
+			song.parent->UnindexSong(song);
+			song.tag = MakeRandomTag(next_song++);
+			song.parent->IndexSong(song);
+		}
+		db_unlock();
+
+		Check();
+
+		/* remove some songs, including all songs with a value */
+
+		db_lock();
+		songs.clear();
+		CollectSongs(*root, songs);
+		for (unsigned i = 0; i < songs.size(); ++i) {
+			Song *song = const_cast<Song *>(songs[i]);
+			if (i % 2 == 0 || song->tag.HasType(TAG_GENRE)) {
+				song->parent->RemoveSong(song);
+				song->Free();
+			}
+		}
+		db_unlock();
+
+		Check();
+
+		/* add more songs, and remove a whole directory */
+
+		for (unsigned i = 0; i < 50; ++i)
+			AddRandomSong();
+
+		db_lock();
+		Directory *a = root->MakeChild("a");
+		a->Delete();
+		directories = { root, root->MakeChild("c") };
+		db_unlock();
+
+		Check();
+
+		/* remove everything */
+
+		db_lock();
+		songs.clear();
+		CollectSongs(*root, songs);
+		for (const Song *song : songs) {
+			song->parent->RemoveSong(const_cast<Song *>(song));
+			const_cast<Song *>(song)->Free();
+		}
+		db_unlock();
+
+		Check();
+	}
+
+private:
+	void AddRandomSong() {
+		const unsigned n = next_song++;
+		Directory &parent = *directories[n % directories.size()];
+
+		char name[32];
+		snprintf(name, sizeof(name), "%u.ogg", n);
+
+		db_lock();
+		Song *song = Song::NewFile(name, parent);
+		song->tag = MakeRandomTag(n);
+		parent.AddSong(song);
+		db_unlock();
+	}
+
+	void Check() {
+		db_lock_shared();
+
+		std::vector<const Song *> songs;
+		CollectSongs(*root, songs);
+
+		CheckStats(songs);
+
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			CheckUniqueTags(songs, TagType(i));
+
+		CheckFilter(songs, true, TAG_ARTIST, "Foo");
+		CheckFilter(songs, true, TAG_ARTIST, "Quux");
+		CheckFilter(songs, true, TAG_ARTIST, "nonexistent");
+		CheckFilter(songs, true, TAG_ALBUM_ARTIST, "Foo");
+		CheckFilter(songs, true, TAG_ALBUM_ARTIST, "bar");
+		CheckFilter(songs, true, TAG_TITLE, "Title 7");
+		CheckFilter(songs, true, LOCATE_TAG_ANY_TYPE, "foo", true);
+		CheckFilter(songs, true, LOCATE_TAG_ANY_TYPE, "bar", true);
+		CheckFilter(songs, true, LOCATE_TAG_ANY_TYPE, "and roll", true);
+		CheckFilter(songs, true, TAG_ALBUM, "ALBUM 2", true);
+		CheckFilter(songs, true, TAG_ALBUM_ARTIST, "baz", true);
+		CheckFilter(songs, true, TAG_TITLE, "xyz", true);
+
+		/* these cannot be looked up in the index */
+		CheckFilter(songs, false, TAG_GENRE, "");
+		CheckFilter(songs, false, LOCATE_TAG_ANY_TYPE, "Foo");
+		CheckFilter(songs, false, LOCATE_TAG_ANY_TYPE, "fo", true);
+
+		/* several items: the index picks one of them */
+		SongFilter filter(TAG_ARTIST, "Foo");
+		filter.Parse("album", "Album 2");
+		filter.Parse("any", "rock", true);
+		CheckFilter(songs, true, filter);
+
+		db_unlock_shared();
+	}
+
+	void CheckStats(const std::vector<const Song *> &songs) {
+		DatabaseStats expected;
+		expected.Clear();
+
+		std::set<std::string> artist_set, album_set;
+		for (const Song *song : songs) {
+			const Tag &tag = song->tag;
+			++expected.song_count;
+			if (tag.time > 0)
+				expected.total_duration += tag.time;
+
+			for (unsigned i = 0; i < tag.num_items; ++i) {
+				const TagItem &item = *tag.items[i];
+				if (item.type == TAG_ARTIST)
+					artist_set.insert(item.value);
+				else if (item.type == TAG_ALBUM)
+					album_set.insert(item.value);
+			}
+		}
+
+		expected.artist_count = artist_set.size();
+		expected.album_count = album_set.size();
+
+		DatabaseStats stats;
+		index.GetStats(stats);
+		CPPUNIT_ASSERT_EQUAL(expected.song_count, stats.song_count);
+		CPPUNIT_ASSERT_EQUAL(expected.total_duration,
+				     stats.total_duration);
+		CPPUNIT_ASSERT_EQUAL(expected.artist_count, stats.artist_count);
+		CPPUNIT_ASSERT_EQUAL(expected.album_count, stats.album_count);
+	}
+
+	/**
+	 * Compare SongIndex::VisitUniqueTags() with the #TagSet
+	 * which ::VisitUniqueTags() builds.
+	 */
+	void CheckUniqueTags(const std::vector<const Song *> &songs,
+			     TagType type) {
+		TagSet set;
+		for (const Song *song : songs)
+			set.InsertUnique(song->tag, type, 0);
+
+		std::vector<std::string> expected;
+		for (const Tag &tag : set)
+			expected.push_back(tag.GetValue(type));
+
+		std::vector<std::string> values;
+		Error error;
+		CPPUNIT_ASSERT(index.VisitUniqueTags(type,
+						     [&values, type](const Tag &tag,
+								     Error &){
+							     values.push_back(tag.GetValue(type));
+							     return true;
+						     },
+						     error));
+
+		CPPUNIT_ASSERT(expected == values);
+	}
+
+	void CheckFilter(const std::vector<const Song *> &songs,
+			 bool indexed, unsigned tag, const char *value,
+			 bool fold_case=false) {
+		CheckFilter(songs, indexed, SongFilter(tag, value, fold_case));
+	}
+
+	/**
+	 * The candidates returned by SongIndex::Collect() must
+	 * include all songs matched by the filter.
+	 */
+	void CheckFilter(const std::vector<const Song *> &songs,
+			 bool indexed, const SongFilter &filter) {
+		std::vector<const Song *> candidates;
+		CPPUNIT_ASSERT_EQUAL(indexed, index.Collect(filter, candidates));
+		if (!indexed)
+			return;
+
+		std::sort(candidates.begin(), candidates.end());
+
+		for (const Song *song : songs) {
+			const bool match = filter.Match(song->Export());
+			const bool found =
+				std::binary_search(candidates.begin(),
+						   candidates.end(), song);
+			CPPUNIT_ASSERT(found || !match);
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SongIndexTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+/*
+ * Unit tests for src/tag/Tag.cxx
+ */
+
+#include "config.h"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/TagPool.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static size_t
+GetPoolItemCount()
+{
+	TagPoolStats stats;
+	tag_pool_get_stats(stats);
+	return stats.n_items;
+}
+
+static Tag
+MakeTag()
+{
+	TagBuilder builder;
+	builder.SetTime(42);
+	builder.AddItem(TAG_ARTIST, "foo");
+	builder.AddItem(TAG_TITLE, "bar");
+	return builder.Commit();
+}
+
+class TagTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagTest);
+	CPPUNIT_TEST(TestTypeMask);
+	CPPUNIT_TEST(TestShare);
+	CPPUNIT_TEST(TestMoveShared);
+	CPPUNIT_TEST(TestMoveUnique);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestTypeMask() {
+		Tag tag = MakeTag();
+		CPPUNIT_ASSERT(tag.HasType(TAG_ARTIST));
+		CPPUNIT_ASSERT(tag.HasType(TAG_TITLE));
+		CPPUNIT_ASSERT(!tag.HasType(TAG_ALBUM));
+		CPPUNIT_ASSERT(tag.GetValue(TAG_ALBUM) == nullptr);
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(tag.GetValue(TAG_TITLE), "bar"));
+
+		tag.Clear();
+		CPPUNIT_ASSERT(!tag.HasType(TAG_ARTIST));
+		CPPUNIT_ASSERT_EQUAL(size_t(0), GetPoolItemCount());
+	}
+
+	void TestShare() {
+		Tag *a = new Tag(MakeTag());
+		Tag *b = new Tag(*a);
+
+		/* the copy shares the item arrays */
+		CPPUNIT_ASSERT(a->items.own == b->items.own);
+		CPPUNIT_ASSERT(a->items.group == b->items.group);
+		CPPUNIT_ASSERT_EQUAL(42, b->time);
+		CPPUNIT_ASSERT_EQUAL(2u, unsigned(b->num_items));
+
+		delete a;
+		CPPUNIT_ASSERT_EQUAL(size_t(2), GetPoolItemCount());
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(b->GetValue(TAG_ARTIST), "foo"));
+
+		delete b;
+		CPPUNIT_ASSERT_EQUAL(size_t(0), GetPoolItemCount());
+	}
+
+	void TestMoveShared() {
+		Tag a = MakeTag();
+		Tag b(a);
+
+		/* modifying a shared tag must not affect the copy */
+		TagBuilder builder(std::move(a));
+		builder.AddItem(TAG_ALBUM, "baz");
+		builder.Commit(a);
+
+		CPPUNIT_ASSERT(a.items.own != b.items.own);
+		CPPUNIT_ASSERT_EQUAL(3u, unsigned(a.num_items));
+		CPPUNIT_ASSERT_EQUAL(2u, unsigned(b.num_items));
+		CPPUNIT_ASSERT(!b.HasType(TAG_ALBUM));
+
+		a.Clear();
+		b.Clear();
+		CPPUNIT_ASSERT_EQUAL(size_t(0), GetPoolItemCount());
+	}
+
+	void TestMoveUnique() {
+		Tag a = MakeTag();
+
+		TagBuilder builder(std::move(a));
+		CPPUNIT_ASSERT(a.items.own == nullptr);
+		CPPUNIT_ASSERT(a.items.group == nullptr);
+		CPPUNIT_ASSERT_EQUAL(size_t(2), GetPoolItemCount());
+
+		builder = MakeTag();
+		CPPUNIT_ASSERT_EQUAL(size_t(2), GetPoolItemCount());
+
+		builder.Clear();
+		CPPUNIT_ASSERT_EQUAL(size_t(0), GetPoolItemCount());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,152 @@
+/*
+ * Unit tests for src/tag/TagPool.cxx
+ */
+
+#include "config.h"
+#include "tag/TagPool.hxx"
+#include "tag/TagItem.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static TagItem *
+GetItem(TagType type, const char *value)
+{
+	return tag_pool_get_item(type, value, strlen(value));
+}
+
+static size_t
+GetItemCount()
+{
+	TagPoolStats stats;
+	tag_pool_get_stats(stats);
+	return stats.n_items;
+}
+
+class TagPoolTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagPoolTest);
+	CPPUNIT_TEST(TestShare);
+	CPPUNIT_TEST(TestOverflow);
+	CPPUNIT_TEST(TestGrow);
+	CPPUNIT_TEST(TestThreads);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestShare() {
+		TagItem *a = GetItem(TAG_ARTIST, "foo");
+		TagItem *b = GetItem(TAG_ARTIST, "foo");
+		TagItem *c = GetItem(TAG_ALBUM, "foo");
+		CPPUNIT_ASSERT(a == b);
+		CPPUNIT_ASSERT(a != c);
+		CPPUNIT_ASSERT_EQUAL(TAG_ALBUM, c->type);
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(c->value, "foo"));
+		CPPUNIT_ASSERT_EQUAL(size_t(2), GetItemCount());
+
+		CPPUNIT_ASSERT(tag_pool_dup_item(a) == a);
+
+		tag_pool_put_item(a);
+		tag_pool_put_item(b);
+		tag_pool_put_item(c);
+		CPPUNIT_ASSERT_EQUAL(size_t(1), GetItemCount());
+		tag_pool_put_item(a);
+		CPPUNIT_ASSERT_EQUAL(size_t(0), GetItemCount());
+	}
+
+	void TestOverflow() {
+		/* more references than the 8 bit counter can hold */
+		std::vector<TagItem *> items;
+		for (unsigned i = 0; i < 1000; ++i)
+			items.push_back(GetItem(TAG_GENRE, "Rock"));
+
+		CPPUNIT_ASSERT(GetItemCount() > 1);
+
+		for (unsigned i = 0; i < 1000; ++i)
+			items.push_back(tag_pool_dup_item(items[i]));
+
+		for (auto i : items) {
+			CPPUNIT_ASSERT_EQUAL(0, strcmp(i->value, "Rock"));
+			tag_pool_put_item(i);
+		}
+
+		CPPUNIT_ASSERT_EQUAL(size_t(0), GetItemCount());
+	}
+
+	void TestGrow() {
+		TagPoolStats before;
+		tag_pool_get_stats(before);
+
+		static constexpr unsigned N = 50000;
+		std::vector<TagItem *> items;
+		for (unsigned i = 0; i < N; ++i) {
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "title %u", i);
+			items.push_back(GetItem(TAG_TITLE, buffer));
+		}
+
+		TagPoolStats stats;
+		tag_pool_get_stats(stats);
+		CPPUNIT_ASSERT_EQUAL(size_t(N), stats.n_items);
+		CPPUNIT_ASSERT(stats.n_resizes > before.n_resizes);
+		CPPUNIT_ASSERT(stats.n_items <= 2 * stats.n_buckets);
+		CPPUNIT_ASSERT(stats.n_used_buckets <= stats.n_items);
+
+		/* the items are still found after the tables have
+		   been resized */
+		for (unsigned i = 0; i < N; ++i) {
+			char buffer[32];
+			snprintf(buffer, sizeof(buffer), "title %u", i);
+			TagItem *item = GetItem(TAG_TITLE, buffer);
+			CPPUNIT_ASSERT(item == items[i]);
+			tag_pool_put_item(item);
+		}
+
+		for (auto i : items)
+			tag_pool_put_item(i);
+
+		CPPUNIT_ASSERT_EQUAL(size_t(0), GetItemCount());
+	}
+
+	void TestThreads() {
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < 4; ++t) {
+			threads.emplace_back([](){
+					for (unsigned i = 0; i < 20000; ++i) {
+						char buffer[32];
+						snprintf(buffer, sizeof(buffer),
+							 "%u", i % 500);
+						TagItem *a = GetItem(TAG_ARTIST,
+								     buffer);
+						TagItem *b = tag_pool_dup_item(a);
+						tag_pool_put_item(a);
+						tag_pool_put_item(b);
+					}
+				});
+		}
+
+		for (auto &t : threads)
+			t.join();
+
+		CPPUNIT_ASSERT_EQUAL(size_t(0), GetItemCount());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagPoolTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
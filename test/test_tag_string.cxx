@@ -0,0 +1,173 @@
+/*
+ * Unit tests for src/tag/TagString.cxx
+ */
+
+#include "config.h"
+#include "tag/TagString.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdlib.h>
+#include <string.h>
+
+static bool
+IsSafe(const char *s)
+{
+	return IsSafeTagString(s, strlen(s));
+}
+
+/**
+ * Check the sequence alone, and embedded in ASCII text at all
+ * positions relative to the 16 byte blocks of the vectorised path.
+ */
+static bool
+IsSafeEverywhere(const char *sequence)
+{
+	const bool result = IsSafe(sequence);
+
+	for (unsigned prefix = 0; prefix <= 33; ++prefix) {
+		for (unsigned suffix : {0, 1, 15, 16, 17}) {
+			std::string s(prefix, 'a');
+			s.append(sequence);
+			s.append(suffix, 'z');
+
+			CPPUNIT_ASSERT_EQUAL(result,
+					     IsSafeTagString(s.data(),
+							     s.length()));
+		}
+	}
+
+	return result;
+}
+
+class TagStringTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagStringTest);
+	CPPUNIT_TEST(TestASCII);
+	CPPUNIT_TEST(TestValid);
+	CPPUNIT_TEST(TestOverlong);
+	CPPUNIT_TEST(TestSurrogates);
+	CPPUNIT_TEST(TestRange);
+	CPPUNIT_TEST(TestInvalidBytes);
+	CPPUNIT_TEST(TestTruncated);
+	CPPUNIT_TEST(TestFix);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestASCII() {
+		CPPUNIT_ASSERT(IsSafeTagString("", 0));
+		CPPUNIT_ASSERT(IsSafeEverywhere(" "));
+		CPPUNIT_ASSERT(IsSafeEverywhere("~\x7f"));
+		CPPUNIT_ASSERT(IsSafe("The quick brown fox jumps over the lazy dog"));
+
+		/* control characters */
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\t"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\n"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\x1f"));
+		CPPUNIT_ASSERT(!IsSafeTagString("a\0b", 3));
+	}
+
+	void TestValid() {
+		/* the smallest and largest code point of each length */
+		CPPUNIT_ASSERT(IsSafeEverywhere("\xc2\x80"));
+		CPPUNIT_ASSERT(IsSafeEverywhere("\xdf\xbf"));
+		CPPUNIT_ASSERT(IsSafeEverywhere("\xe0\xa0\x80"));
+		CPPUNIT_ASSERT(IsSafeEverywhere("\xef\xbf\xbf"));
+		CPPUNIT_ASSERT(IsSafeEverywhere("\xf0\x90\x80\x80"));
+		CPPUNIT_ASSERT(IsSafeEverywhere("\xf4\x8f\xbf\xbf"));
+
+		/* next to the surrogates */
+		CPPUNIT_ASSERT(IsSafeEverywhere("\xed\x9f\xbf"));
+		CPPUNIT_ASSERT(IsSafeEverywhere("\xee\x80\x80"));
+
+		CPPUNIT_ASSERT(IsSafe("Bj\xc3\xb6rk \xe2\x80\x93 J\xc3\xb3ga"));
+		CPPUNIT_ASSERT(IsSafe("\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88"));
+	}
+
+	void TestOverlong() {
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xc0\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xc1\xbf"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xe0\x80\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xe0\x9f\xbf"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf0\x80\x80\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf0\x8f\xbf\xbf"));
+	}
+
+	void TestSurrogates() {
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xed\xa0\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xed\xaf\xbf"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xed\xb0\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xed\xbf\xbf"));
+
+		/* an encoded surrogate pair (CESU-8) */
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xed\xa0\xbd\xed\xb8\x80"));
+	}
+
+	void TestRange() {
+		/* U+110000 and beyond */
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf4\x90\x80\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf4\xbf\xbf\xbf"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf5\x80\x80\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf7\xbf\xbf\xbf"));
+
+		/* the obsolete 5 and 6 byte forms */
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf8\x88\x80\x80\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xfc\x84\x80\x80\x80\x80"));
+	}
+
+	void TestInvalidBytes() {
+		/* continuation bytes without a lead byte */
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xbf"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xc3\xb6\x80"));
+
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xfe"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xff"));
+
+		/* ISO-8859-1 */
+		CPPUNIT_ASSERT(!IsSafeEverywhere("Bj\xf6rk"));
+	}
+
+	void TestTruncated() {
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xc3"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xe2\x80"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf0\x9f\x8e"));
+
+		/* a lead byte followed by ASCII */
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xc3" "a"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xe2\x80" "a"));
+		CPPUNIT_ASSERT(!IsSafeEverywhere("\xf0\x9f\x8e" "a"));
+
+		/* the length cuts a valid sequence */
+		CPPUNIT_ASSERT(!IsSafeTagString("a\xe2\x80\x93", 3));
+		CPPUNIT_ASSERT(IsSafeTagString("a\xe2\x80\x93", 4));
+	}
+
+	void TestFix() {
+		/* valid strings are not copied */
+		CPPUNIT_ASSERT(FixTagString("foo", 3) == nullptr);
+		CPPUNIT_ASSERT(FixTagString("\xc3\xb6", 2) == nullptr);
+
+		/* control characters become spaces */
+		char *p = FixTagString("a\tb", 3);
+		CPPUNIT_ASSERT(p != nullptr);
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(p, "a b"));
+		free(p);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagStringTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
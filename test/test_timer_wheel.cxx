@@ -0,0 +1,188 @@
+/*
+ * Unit tests for src/event/TimerWheel.cxx
+ */
+
+#include "config.h"
+#include "event/Loop.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <functional>
+#include <vector>
+
+#include <stdlib.h>
+
+class RecordingTimer final : public TimeoutMonitor {
+	std::vector<unsigned> &log;
+
+public:
+	unsigned n;
+	unsigned scheduled_ms, expected_ms;
+	unsigned fired_ms;
+
+	RecordingTimer(EventLoop &_loop, std::vector<unsigned> &_log)
+		:TimeoutMonitor(_loop), log(_log), fired_ms(0) {}
+
+	void Start(unsigned _n, unsigned ms) {
+		n = _n;
+		scheduled_ms = GetEventLoop().GetTimeMS();
+		expected_ms = scheduled_ms + ms;
+		Schedule(ms);
+	}
+
+protected:
+	void OnTimeout() override {
+		fired_ms = GetEventLoop().GetTimeMS();
+		log.push_back(n);
+	}
+};
+
+class BreakTimer final : public TimeoutMonitor {
+public:
+	BreakTimer(EventLoop &_loop):TimeoutMonitor(_loop) {}
+
+protected:
+	void OnTimeout() override {
+		GetEventLoop().Break();
+	}
+};
+
+/**
+ * Runs the given function inside the #EventLoop.  The timers are
+ * started from there, because EventLoop::GetTimeMS() may only be
+ * called inside the loop.
+ */
+class SetupTimer final : public TimeoutMonitor {
+	std::function<void()> f;
+
+public:
+	SetupTimer(EventLoop &_loop, std::function<void()> &&_f)
+		:TimeoutMonitor(_loop), f(std::move(_f)) {
+		Schedule(0);
+	}
+
+protected:
+	void OnTimeout() override {
+		f();
+	}
+};
+
+class TimerWheelTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TimerWheelTest);
+	CPPUNIT_TEST(TestOrder);
+	CPPUNIT_TEST(TestCancel);
+	CPPUNIT_TEST(TestReschedule);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestOrder() {
+		EventLoop loop;
+		std::vector<unsigned> log;
+		unsigned start_ms = 0;
+
+		static constexpr unsigned N = 200;
+		std::vector<RecordingTimer *> timers;
+		for (unsigned i = 0; i < N; ++i)
+			timers.push_back(new RecordingTimer(loop, log));
+
+		RecordingTimer far(loop, log);
+		BreakTimer stop(loop);
+
+		SetupTimer setup(loop, [&](){
+				start_ms = loop.GetTimeMS();
+
+				/* spread the timers over the first two
+				   levels of the wheel */
+				for (unsigned i = 0; i < N; ++i)
+					timers[i]->Start(i, random() % 300);
+
+				/* this one is far away and must not
+				   fire */
+				far.Start(N, 3600 * 1000);
+
+				stop.Schedule(400);
+			});
+		loop.Run();
+
+		CPPUNIT_ASSERT_EQUAL(size_t(N), log.size());
+		CPPUNIT_ASSERT(far.IsActive());
+
+		unsigned last_due = start_ms;
+		for (unsigned n : log) {
+			const RecordingTimer &t = *timers[n];
+			CPPUNIT_ASSERT(!t.IsActive());
+			CPPUNIT_ASSERT(int(t.fired_ms - t.expected_ms) >= 0);
+			CPPUNIT_ASSERT(int(t.expected_ms - last_due) >= 0);
+			last_due = t.expected_ms;
+		}
+
+		far.Cancel();
+		for (auto t : timers)
+			delete t;
+	}
+
+	void TestCancel() {
+		EventLoop loop;
+		std::vector<unsigned> log;
+
+		RecordingTimer a(loop, log), b(loop, log), c(loop, log);
+		BreakTimer stop(loop);
+
+		SetupTimer setup(loop, [&](){
+				a.Start(0, 10);
+				b.Start(1, 20);
+				c.Start(2, 100 * 1000);
+
+				b.Cancel();
+				CPPUNIT_ASSERT(!b.IsActive());
+
+				stop.Schedule(50);
+			});
+		loop.Run();
+
+		CPPUNIT_ASSERT_EQUAL(size_t(1), log.size());
+		CPPUNIT_ASSERT_EQUAL(0u, log.front());
+
+		/* the destructor cancels, too */
+		CPPUNIT_ASSERT(c.IsActive());
+	}
+
+	void TestReschedule() {
+		EventLoop loop;
+		std::vector<unsigned> log;
+
+		RecordingTimer a(loop, log), b(loop, log);
+		BreakTimer stop(loop);
+
+		SetupTimer setup(loop, [&](){
+				a.Start(0, 5000);
+				b.Start(1, 30);
+
+				/* move "a" from a high level to level 0 */
+				a.Start(0, 10);
+
+				stop.Schedule(60);
+			});
+		loop.Run();
+
+		CPPUNIT_ASSERT_EQUAL(size_t(2), log.size());
+		CPPUNIT_ASSERT_EQUAL(0u, log[0]);
+		CPPUNIT_ASSERT_EQUAL(1u, log[1]);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimerWheelTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
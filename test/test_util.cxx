@@ -5,6 +5,7 @@
 #include "config.h"
 #include "util/UriUtil.hxx"
 #include "TestCircularBuffer.hxx"
+#include "TestPeakBuffer.hxx"
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -52,6 +53,7 @@ public:
 
 CPPUNIT_TEST_SUITE_REGISTRATION(UriUtilTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(TestCircularBuffer);
+CPPUNIT_TEST_SUITE_REGISTRATION(TestPeakBuffer);
 
 int
 main(gcc_unused int argc, gcc_unused char **argv)
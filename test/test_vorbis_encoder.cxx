@@ -38,7 +38,7 @@ encoder_to_stdout(Encoder &encoder)
 	size_t length;
 	static char buffer[32768];
 
-	while ((length = encoder_read(&encoder, buffer, sizeof(buffer))) > 0) {
+	while ((length = encoder_read(&encoder, { buffer, sizeof(buffer) })) > 0) {
 		gcc_unused ssize_t ignored = write(1, buffer, length);
 	}
 }
@@ -69,7 +69,7 @@ main(gcc_unused int argc, gcc_unused char **argv)
 
 	/* write a block of data */
 
-	success = encoder_write(encoder, zero, sizeof(zero), IgnoreError());
+	success = encoder_write(encoder, { zero, sizeof(zero) }, IgnoreError());
 	assert(success);
 
 	encoder_to_stdout(*encoder);
@@ -97,7 +97,7 @@ main(gcc_unused int argc, gcc_unused char **argv)
 
 	/* write another block of data */
 
-	success = encoder_write(encoder, zero, sizeof(zero), IgnoreError());
+	success = encoder_write(encoder, { zero, sizeof(zero) }, IgnoreError());
 	assert(success);
 
 	/* finish */
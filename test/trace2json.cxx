@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2003-2014 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program converts a trace file written by MPD (see
+ * "trace_file") to the Chrome trace event format, which can be
+ * viewed with chrome://tracing or Perfetto.
+ *
+ */
+
+#include "config.h"
+#include "Trace.hxx"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *
+ObjectName(TraceObject object)
+{
+	switch (object) {
+	case TraceObject::NONE:
+		break;
+
+	case TraceObject::PLAYER:
+		return "player";
+
+	case TraceObject::DECODER:
+		return "decoder";
+
+	case TraceObject::OUTPUT:
+		return "output";
+	}
+
+	return "unknown";
+}
+
+static void
+PrintString(const char *s)
+{
+	putchar('"');
+	for (; *s != 0; ++s) {
+		if (*s == '"' || *s == '\\')
+			putchar('\\');
+		if ((unsigned char)*s >= 0x20)
+			putchar(*s);
+	}
+	putchar('"');
+}
+
+static void
+PrintRecord(const TraceRecord &r, uint64_t t0)
+{
+	const uint64_t ts = r.time - t0;
+	const char *object = ObjectName(r.object);
+
+	switch (r.event) {
+	case TraceEvent::CHUNK_PUSH:
+	case TraceEvent::CHUNK_SHIFT:
+		printf("{\"name\":\"pipe\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,"
+		       "\"ts\":%llu,\"args\":{\"chunks\":%llu}}",
+		       r.thread, (unsigned long long)ts,
+		       (unsigned long long)r.argument);
+		break;
+
+	case TraceEvent::OUTPUT_PLAY_BEGIN:
+		printf("{\"name\":\"play\",\"ph\":\"B\",\"pid\":1,\"tid\":%u,"
+		       "\"ts\":%llu,\"args\":{\"bytes\":%llu}}",
+		       r.thread, (unsigned long long)ts,
+		       (unsigned long long)r.argument);
+		break;
+
+	case TraceEvent::OUTPUT_PLAY_END:
+		printf("{\"name\":\"play\",\"ph\":\"E\",\"pid\":1,\"tid\":%u,"
+		       "\"ts\":%llu,\"args\":{\"bytes\":%llu}}",
+		       r.thread, (unsigned long long)ts,
+		       (unsigned long long)r.argument);
+		break;
+
+	case TraceEvent::MUTEX_WAIT:
+		/* the record is written after the wait */
+		printf("{\"name\":\"lock %s\",\"ph\":\"X\",\"pid\":1,"
+		       "\"tid\":%u,\"ts\":%llu,\"dur\":%llu}",
+		       object, r.thread,
+		       (unsigned long long)(ts > r.argument
+					    ? ts - r.argument : 0),
+		       (unsigned long long)r.argument);
+		break;
+
+	case TraceEvent::COND_SIGNAL:
+		printf("{\"name\":\"signal %s\",\"ph\":\"i\",\"s\":\"t\","
+		       "\"pid\":1,\"tid\":%u,\"ts\":%llu}",
+		       object, r.thread, (unsigned long long)ts);
+		break;
+
+	case TraceEvent::UNDERRUN:
+		printf("{\"name\":\"underrun %s\",\"ph\":\"i\",\"s\":\"g\","
+		       "\"pid\":1,\"tid\":%u,\"ts\":%llu}",
+		       object, r.thread, (unsigned long long)ts);
+		break;
+
+	default:
+		printf("{\"name\":\"event %u\",\"ph\":\"i\",\"s\":\"t\","
+		       "\"pid\":1,\"tid\":%u,\"ts\":%llu}",
+		       unsigned(r.event), r.thread, (unsigned long long)ts);
+		break;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: trace2json FILE >OUT.json\n");
+		return EXIT_FAILURE;
+	}
+
+	FILE *file = fopen(argv[1], "rb");
+	if (file == nullptr) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	TraceFileHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	    memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+		fprintf(stderr, "Not a MPD trace file\n");
+		return EXIT_FAILURE;
+	}
+
+	if (header.version != TRACE_VERSION) {
+		fprintf(stderr, "Unsupported trace file version %u\n",
+			header.version);
+		return EXIT_FAILURE;
+	}
+
+	printf("{\"traceEvents\":[\n");
+
+	bool first = true;
+	for (unsigned i = 0; i < header.n_threads; ++i) {
+		char name[TRACE_THREAD_NAME_SIZE];
+		if (fread(name, sizeof(name), 1, file) != 1) {
+			fprintf(stderr, "Truncated trace file\n");
+			return EXIT_FAILURE;
+		}
+
+		name[sizeof(name) - 1] = 0;
+
+		if (!first)
+			printf(",\n");
+		first = false;
+
+		printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		       "\"tid\":%u,\"args\":{\"name\":", i + 1);
+		PrintString(name);
+		printf("}}");
+	}
+
+	uint64_t t0 = 0;
+	TraceRecord r;
+	for (uint64_t i = 0; i < header.n_records; ++i) {
+		if (fread(&r, sizeof(r), 1, file) != 1) {
+			fprintf(stderr, "Truncated trace file\n");
+			break;
+		}
+
+		if (i == 0)
+			t0 = r.time;
+		else if (r.time < t0)
+			/* garbled by a concurrent write */
+			continue;
+
+		if (!first)
+			printf(",\n");
+		first = false;
+
+		PrintRecord(r, t0);
+	}
+
+	printf("\n]}\n");
+	fclose(file);
+	return EXIT_SUCCESS;
+}